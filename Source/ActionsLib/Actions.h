@@ -43,7 +43,11 @@ void DoDumpNodes(const ConfigParameters& config);
 template <typename ElemType>
 void DoEdit(const ConfigParameters& config);
 template <typename ElemType>
+void DoOptimizeForInference(const ConfigParameters& config);
+template <typename ElemType>
 void DoBatchNormalizationStat(const ConfigParameters& config);
+template <typename ElemType>
+void DoCalibrateQuantization(const ConfigParameters& config);
 
 // evaluation (EvalActions.cpp)
 template <typename ElemType>
@@ -57,12 +61,24 @@ void DoWriteOutput(const ConfigParameters& config);
 template <typename ElemType>
 void DoCreateLabelMap(const ConfigParameters& config);
 template <typename ElemType>
+void DoReaderBenchmark(const ConfigParameters& config);
+template <typename ElemType>
 void DoParameterSVD(const ConfigParameters& config);
 template <typename ElemType>
 void DoWriteWordAndClassInfo(const ConfigParameters& config);
 template <typename ElemType>
 void DoTopologyPlot(const ConfigParameters& config);
 
+// distributed training (DistributedActions.cpp)
+template <typename ElemType>
+void DoCommBenchmark(const ConfigParameters& config);
+
+// data and model conversion (ConvertActions.cpp)
+template <typename ElemType>
+void DoConvertTextToBinary(const ConfigParameters& config);
+template <typename ElemType>
+void DoConvertModelPrecision(const ConfigParameters& config);
+
 // special purpose (SpecialPurposeActions.cpp)
 template <typename ElemType>
 void DoConvertFromDbn(const ConfigParameters& config);
@@ -0,0 +1,320 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE.md file in the project root for full license information.
+//
+// ConvertActions.cpp -- CNTK data and model conversion actions
+//
+
+#define _CRT_SECURE_NO_WARNINGS // "secure" CRT not available on all platforms
+
+#include "stdafx.h"
+#include "Basics.h"
+#include "Actions.h"
+#include "Config.h"
+#include "BestGpu.h"
+#include "ComputationNetwork.h"
+#include "DataReader.h"
+#include "DataReaderHelpers.h"
+#include "../Readers/CNTKTextFormatReader/TextParser.h"
+#include "../Readers/CNTKBinaryReader/BinaryChunkWriter.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <future>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+using namespace std;
+using namespace Microsoft::MSR;
+using namespace Microsoft::MSR::CNTK;
+
+// ===========================================================================
+// DoConvertTextToBinary() - implements CNTK "convertTextToBinary" command
+//
+// Converts a file in the CNTK text format into the format of the CNTKBinaryReader.
+// Config parameters:
+//  - reader:           the CNTKTextFormatReader section of the input (file, input streams, chunkSizeInBytes, ...).
+//                      Each text chunk becomes a chunk of the binary file.
+//  - outputFile:       the binary file to write
+//  - numThreads:       number of chunks converted in parallel, 0 for one per core (default)
+//  - storeDenseAsHalf: if true, dense inputs are stored in half precision (default false)
+//  - storeDenseAsInt8: if true, dense inputs are stored as int8 with a scale per chunk (default false)
+//  - compression:      codec the chunks are compressed with: none (default), lz4 or zstd.
+//                      The codecs are only available if CNTK was built with them.
+//  - compressionLevel: compression level of zstd (default 3)
+// ===========================================================================
+
+// Loads, serializes and compresses one chunk of the input.
+template <typename ElemType>
+static void ConvertChunk(TextParser<ElemType>& parser, const BinaryChunkWriter& writer, ChunkIdType chunkId,
+                         vector<char>& buffer, vector<bool>& hasMultipleSamples, size_t& uncompressedSize, size_t& numSequences, size_t& numSamples)
+{
+    vector<SequenceDescription> descriptions;
+    parser.GetSequencesForChunk(chunkId, descriptions);
+    auto chunk = parser.GetChunk(chunkId);
+
+    vector<vector<SequenceDataPtr>> sequences(descriptions.size());
+    numSamples = 0;
+    for (size_t i = 0; i < descriptions.size(); i++)
+    {
+        chunk->GetSequence(descriptions[i].m_id, sequences[i]);
+        numSamples += descriptions[i].m_numberOfSamples;
+    }
+    numSequences = descriptions.size();
+
+    uncompressedSize = writer.SerializeChunk<ElemType>(sequences, buffer, hasMultipleSamples);
+}
+
+template <typename ElemType>
+void DoConvertTextToBinary(const ConfigParameters& config)
+{
+    ConfigParameters readerConfig(config(L"reader"));
+    wstring outputFile = config(L"outputFile");
+    size_t numThreads = config(L"numThreads", (size_t)0);
+    bool storeDenseAsHalf = config(L"storeDenseAsHalf", false);
+    bool storeDenseAsInt8 = config(L"storeDenseAsInt8", false);
+    if (storeDenseAsHalf && storeDenseAsInt8)
+        InvalidArgument("Only one of storeDenseAsHalf and storeDenseAsInt8 can be set.");
+    ChunkCompression compression = CNTKBinaryCompression::Parse((wstring)config(L"compression", L"none"));
+    int compressionLevel = config(L"compressionLevel", 3);
+    if (numThreads == 0)
+        numThreads = max<size_t>(thread::hardware_concurrency(), 1);
+
+    // Every thread needs its own parser. The first one builds the index and stores it next to the input,
+    // the others load it from there.
+    if (numThreads > 1 && !readerConfig.ExistsCurrent(L"cacheIndex"))
+        readerConfig.Insert("cacheIndex", "true");
+    TextConfigHelper helper(readerConfig);
+    auto corpus = make_shared<CorpusDescriptor>(true);
+
+    vector<unique_ptr<TextParser<ElemType>>> parsers;
+    parsers.push_back(make_unique<TextParser<ElemType>>(corpus, helper, true));
+    auto chunks = parsers[0]->GetChunkDescriptions();
+    numThreads = max<size_t>(min(numThreads, chunks.size()), 1);
+    while (parsers.size() < numThreads)
+        parsers.push_back(make_unique<TextParser<ElemType>>(corpus, helper, true));
+
+    vector<BinaryChunkWriter::Input> inputs;
+    for (const auto& stream : helper.GetStreams())
+    {
+        BinaryChunkWriter::Input input;
+        input.m_name = msra::strfun::utf8(stream.m_name);
+        input.m_storageType = stream.m_storageType;
+        input.m_dimension = stream.m_sampleDimension;
+        input.m_isSequence = false;
+        if (stream.m_storageType == StorageType::dense && storeDenseAsHalf)
+            input.m_elementType = BinaryElementType::Half;
+        else if (stream.m_storageType == StorageType::dense && storeDenseAsInt8)
+            input.m_elementType = BinaryElementType::Int8;
+        else
+            input.m_elementType = is_same<ElemType, float>::value ? BinaryElementType::Float : BinaryElementType::Double;
+        inputs.push_back(input);
+    }
+
+    fprintf(stderr, "Converting '%ls' into '%ls': %d chunks with %d threads, %s compression.\n",
+            helper.GetFilePath().c_str(), outputFile.c_str(), (int)chunks.size(), (int)numThreads, CNTKBinaryCompression::GetName(compression));
+    auto start = chrono::system_clock::now();
+
+    BinaryChunkWriter writer(outputFile, inputs, chunks.size(), compression, compressionLevel);
+
+    // Chunks are converted in rounds of one chunk per thread and written in their original order.
+    vector<vector<char>> buffers(numThreads);
+    vector<vector<bool>> hasMultipleSamples(numThreads);
+    vector<size_t> uncompressedSizes(numThreads), numSequences(numThreads), numSamples(numThreads);
+    size_t totalUncompressedSize = 0, totalSize = 0;
+    for (size_t first = 0; first < chunks.size(); first += numThreads)
+    {
+        size_t count = min(numThreads, chunks.size() - first);
+        vector<future<void>> workers;
+        for (size_t t = 0; t < count; t++)
+        {
+            workers.push_back(async(launch::async, [&, t]()
+            {
+                ConvertChunk(*parsers[t], writer, chunks[first + t]->m_id, buffers[t], hasMultipleSamples[t], uncompressedSizes[t], numSequences[t], numSamples[t]);
+            }));
+        }
+
+        // Wait for all of them before get() rethrows an error, the others still use the buffers.
+        for (auto& worker : workers)
+            worker.wait();
+
+        for (size_t t = 0; t < count; t++)
+        {
+            workers[t].get();
+            writer.WriteChunk(buffers[t], uncompressedSizes[t], numSequences[t], numSamples[t]);
+            totalUncompressedSize += uncompressedSizes[t];
+            totalSize += buffers[t].size();
+            for (size_t j = 0; j < inputs.size(); j++)
+            {
+                if (hasMultipleSamples[t][j])
+                    writer.SetIsSequence(j);
+            }
+        }
+
+        fprintf(stderr, "Converted %d of %d chunks.\n", (int)(first + count), (int)chunks.size());
+    }
+
+    writer.Close();
+
+    chrono::duration<double> seconds = chrono::system_clock::now() - start;
+    fprintf(stderr, "Conversion done in %.1f seconds, %.1f MB of chunks stored in %.1f MB.\n",
+            seconds.count(), totalUncompressedSize / 1048576.0, totalSize / 1048576.0);
+}
+
+template void DoConvertTextToBinary<float>(const ConfigParameters& config);
+template void DoConvertTextToBinary<double>(const ConfigParameters& config);
+
+// ===========================================================================
+// DoConvertModelPrecision() - implements CNTK "convertPrecision" command
+//
+// Loads a model as 'precision', converting the values of a model saved in the other precision while they are read (as
+// 'convertPrecision' does for the model of other commands and of CNTKEval), and saves it in that precision.
+// Config parameters:
+//  - modelPath:       the model to convert
+//  - outputModelPath: the converted model
+//  - reader:          optional sample data. If given, the outputs of the converted and of the original model are computed
+//                     on it, and the maximum absolute deviation of each output is reported.
+//  - outputNodeNames: the outputs to compare (default: the output nodes of the model)
+//  - numMinibatches:  number of minibatches compared (default 10)
+//  - minibatchSize:   (default 256)
+// ===========================================================================
+
+// Computes the outputs of a network on the minibatches of its own reader of the same precision.
+template <typename ElemType>
+class OutputSampler
+{
+public:
+    OutputSampler(ComputationNetworkPtr net, const vector<wstring>& outputNodeNames, ConfigParameters readerConfig, size_t mbSize, size_t numMinibatches)
+        : m_net(net), m_modeGuard(net, NetworkOperationMode::inferring)
+    {
+        m_outputNodes = m_net->OutputNodesByName(outputNodeNames);
+        m_inputNodes = m_net->InputNodesForOutputs(outputNodeNames);
+        m_net->AllocateAllMatrices(m_outputNodes, vector<ComputationNodeBasePtr>(), nullptr);
+        for (auto& node : m_inputNodes)
+            m_inputMatrices.AddInput(node->NodeName(), node->ValuePtr(), node->GetMBLayout(), node->GetSampleLayout());
+
+        readerConfig.Insert("precision", sizeof(ElemType) == sizeof(float) ? "float" : "double");
+        m_reader = make_shared<DataReader>(readerConfig);
+        m_reader->StartMinibatchLoop(mbSize, 0, m_inputMatrices.GetStreamDescriptions(), mbSize * numMinibatches);
+        m_net->StartEvaluateMinibatchLoop(m_outputNodes);
+    }
+
+    // computes the next minibatch, values[i] being those of output i with zeros in the gaps
+    bool Next(vector<vector<double>>& values)
+    {
+        size_t actualMBSize = 0;
+        if (!DataReaderHelpers::GetMinibatchIntoNetwork<ElemType>(*m_reader, m_net, nullptr, /*useDistributedMBReading=*/false, /*useParallelTrain=*/false,
+                                                                  m_inputMatrices, actualMBSize, nullptr))
+            return false;
+
+        ComputationNetwork::BumpEvalTimeStamp(m_inputNodes);
+        m_net->ForwardProp(m_outputNodes);
+
+        values.resize(m_outputNodes.size());
+        for (size_t i = 0; i < m_outputNodes.size(); i++)
+        {
+            auto node = dynamic_pointer_cast<ComputationNode<ElemType>>(m_outputNodes[i]);
+            if (!node || node->Value().GetMatrixType() != DENSE)
+                InvalidArgument("convertPrecision: Output %ls must be a dense %ls.", m_outputNodes[i]->NodeName().c_str(), ElemTypeName<ElemType>());
+            if (node->HasMBLayout())
+                node->MaskMissingValueColumnsToZero(FrameRange(node->GetMBLayout()));
+
+            vector<ElemType> buffer(node->Value().GetNumElements());
+            ElemType* data = buffer.data();
+            size_t size = buffer.size();
+            node->Value().CopyToArray(data, size);
+            values[i].assign(buffer.begin(), buffer.end());
+        }
+        return true;
+    }
+
+    const vector<ComputationNodeBasePtr>& OutputNodes() const { return m_outputNodes; }
+
+private:
+    ComputationNetworkPtr m_net;
+    ScopedNetworkOperationMode m_modeGuard;
+    vector<ComputationNodeBasePtr> m_outputNodes;
+    vector<ComputationNodeBasePtr> m_inputNodes;
+    StreamMinibatchInputs m_inputMatrices;
+    shared_ptr<DataReader> m_reader;
+};
+
+// reports the maximum absolute deviation of the outputs of 'net' from those of 'sourceNet', the model it was converted from
+template <typename ElemType, typename SourceElemType>
+static void ReportOutputDeviation(ComputationNetworkPtr net, ComputationNetworkPtr sourceNet, const vector<wstring>& outputNodeNames,
+                                  const ConfigParameters& readerConfig, size_t mbSize, size_t numMinibatches)
+{
+    OutputSampler<ElemType> converted(net, outputNodeNames, readerConfig, mbSize, numMinibatches);
+    OutputSampler<SourceElemType> original(sourceNet, outputNodeNames, readerConfig, mbSize, numMinibatches);
+
+    size_t numOutputs = converted.OutputNodes().size();
+    vector<double> maxDeviations(numOutputs, 0), maxValues(numOutputs, 0);
+    vector<vector<double>> values, sourceValues;
+    size_t numMinibatchesRead = 0;
+    while (numMinibatchesRead < numMinibatches && converted.Next(values) && original.Next(sourceValues))
+    {
+        for (size_t i = 0; i < numOutputs; i++)
+        {
+            if (values[i].size() != sourceValues[i].size())
+                LogicError("convertPrecision: The readers of the two models returned different minibatches.");
+            for (size_t j = 0; j < values[i].size(); j++)
+            {
+                maxDeviations[i] = max(maxDeviations[i], fabs(values[i][j] - sourceValues[i][j]));
+                maxValues[i] = max(maxValues[i], fabs(sourceValues[i][j]));
+            }
+        }
+        numMinibatchesRead++;
+    }
+    if (numMinibatchesRead == 0)
+        RuntimeError("convertPrecision: No data read to compare the outputs.");
+
+    fprintf(stderr, "Maximum absolute deviation of the outputs of the converted model over %d minibatches:\n", (int) numMinibatchesRead);
+    for (size_t i = 0; i < numOutputs; i++)
+        fprintf(stderr, "\t%ls: %.9g (largest absolute value %.9g)\n", converted.OutputNodes()[i]->NodeName().c_str(), maxDeviations[i], maxValues[i]);
+}
+
+template <typename ElemType>
+void DoConvertModelPrecision(const ConfigParameters& config)
+{
+    wstring modelPath = config(L"modelPath");
+    wstring outputModelPath = config(L"outputModelPath");
+    DEVICEID_TYPE deviceId = DeviceFromConfig(config);
+
+    auto net = make_shared<ComputationNetwork>(deviceId);
+    net->SetTraceLevel(config(L"traceLevel", 0));
+    net->Load<ElemType>(modelPath, /*convertPrecision=*/true);
+    net->Save(outputModelPath);
+    fprintf(stderr, "Saved '%ls' as %ls in '%ls'.\n", modelPath.c_str(), ElemTypeName<ElemType>(), outputModelPath.c_str());
+
+    if (!config.Exists(L"reader"))
+        return;
+
+    ConfigParameters readerConfig(config(L"reader"));
+    readerConfig.Insert("traceLevel", config(L"traceLevel", "0"));
+    ConfigArray outputNodeNamesConfig = config(L"outputNodeNames", ConfigArray(""));
+    vector<wstring> outputNodeNames;
+    for (size_t i = 0; i < outputNodeNamesConfig.size(); i++)
+    {
+        wstring name = outputNodeNamesConfig[i];
+        if (!name.empty())
+            outputNodeNames.push_back(name);
+    }
+    size_t numMinibatches = config(L"numMinibatches", (size_t) 10);
+    ConfigArray minibatchSize = config(L"minibatchSize", "256");
+    intargvector mbSize = minibatchSize;
+
+    // the original model, in the precision it was saved in
+    auto sourceNet = make_shared<ComputationNetwork>(deviceId);
+    sourceNet->SetTraceLevel(config(L"traceLevel", 0));
+    sourceNet->Load<ElemType>(modelPath);
+    if (ComputationNetwork::IsNodePtr<ComputationNode<double>>(sourceNet->OutputNodesByName(outputNodeNames).front()))
+        ReportOutputDeviation<ElemType, double>(net, sourceNet, outputNodeNames, readerConfig, mbSize[0], numMinibatches);
+    else
+        ReportOutputDeviation<ElemType, float>(net, sourceNet, outputNodeNames, readerConfig, mbSize[0], numMinibatches);
+}
+
+template void DoConvertModelPrecision<float>(const ConfigParameters& config);
+template void DoConvertModelPrecision<double>(const ConfigParameters& config);
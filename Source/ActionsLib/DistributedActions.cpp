@@ -0,0 +1,291 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE.md file in the project root for full license information.
+//
+// DistributedActions.cpp -- CNTK actions for distributed training
+//
+
+#define _CRT_NONSTDC_NO_DEPRECATE // make VS accept POSIX functions without _
+
+#include "stdafx.h"
+#include "Basics.h"
+#include "Actions.h"
+#include "ComputationNetwork.h"
+#include "ComputationNode.h"
+#include "InputAndParamNodes.h"
+#include "Config.h"
+#include "BestGpu.h"
+#include "MPIWrapper.h"
+#include "NcclComm.h"
+#include "SimpleDistGradAggregator.h"
+#include "QuantizedDistGradAggregator.h"
+
+#include <string>
+#include <chrono>
+#include <algorithm>
+#include <vector>
+#include <memory>
+
+using namespace std;
+using namespace Microsoft::MSR;
+using namespace Microsoft::MSR::CNTK;
+
+// ===========================================================================
+// DoCommBenchmark() - implements CNTK "commBenchmark" command
+// ===========================================================================
+
+static const size_t CommBenchmarkWarmupIterations = 3;
+
+// Runs 'op' a few times to warm up, then 'numIterations' times between barriers of 'comm'; returns the mean seconds
+// per run of the slowest worker, which is what a synchronous training step waits for.
+template <class F>
+static double TimeCollective(MPI_Comm comm, size_t numIterations, F&& op)
+{
+    for (size_t i = 0; i < CommBenchmarkWarmupIterations; i++)
+        op();
+    MPI_Barrier(comm) || MpiFail("commBenchmark: MPI_Barrier");
+    auto start = chrono::high_resolution_clock::now();
+    for (size_t i = 0; i < numIterations; i++)
+        op();
+    double seconds = chrono::duration<double>(chrono::high_resolution_clock::now() - start).count() / numIterations;
+    MPI_Allreduce(MPI_IN_PLACE, &seconds, 1, MPI_DOUBLE, MPI_MAX, comm) || MpiFail("commBenchmark: MPI_Allreduce");
+    return seconds;
+}
+
+// Like nccl-tests: the algorithm bandwidth is the message size over the time; the bus bandwidth scales it by the share
+// of the data that crosses the links in a ring all-reduce, 2 (n - 1) / n, so it can be compared with the link speed.
+static void PrintCollectiveResult(const char* op, size_t numWorkers, size_t numBytes, double seconds, double busFactor)
+{
+    double algorithmBandwidth = numBytes / seconds / 1e9;
+    fprintf(stderr, "commBenchmark: %-24s %4d workers %12d bytes: %10.1f us, algbw %8.3f GB/s, busbw %8.3f GB/s\n",
+            op, (int) numWorkers, (int) numBytes, 1e6 * seconds, algorithmBandwidth, algorithmBandwidth * busFactor);
+}
+
+// the gradients of all learnable parameters that are updated, in the shapes of the model
+template <typename ElemType>
+static vector<shared_ptr<Matrix<ElemType>>> CreateModelGradients(const ConfigParameters& config, DEVICEID_TYPE deviceId)
+{
+    vector<pair<size_t, size_t>> shapes; // rows, columns
+    if (config.Exists(L"modelPath"))
+    {
+        wstring modelPath = config(L"modelPath");
+        auto net = ComputationNetwork::CreateFromFile<ElemType>(deviceId, modelPath);
+        for (const auto& node : net->GetNodesWithType(OperationNameOf(LearnableParameter)))
+        {
+            if (node->IsParameterUpdateRequired())
+                shapes.push_back(make_pair(node->GetAsMatrixNumRows(), node->GetAsMatrixNumCols()));
+        }
+    }
+    else if (config.Exists(L"parameterSizes"))
+    {
+        ConfigArray sizes = config(L"parameterSizes");
+        for (size_t i = 0; i < sizes.size(); i++)
+            shapes.push_back(make_pair((size_t) sizes[i], (size_t) 1));
+    }
+
+    vector<shared_ptr<Matrix<ElemType>>> gradients;
+    for (const auto& shape : shapes)
+    {
+        gradients.push_back(make_shared<Matrix<ElemType>>(shape.first, shape.second, deviceId));
+        gradients.back()->SetUniformRandomValue(-1, 1, (unsigned long) gradients.size());
+    }
+    return gradients;
+}
+
+// Times one aggregation of 'gradients' with 'aggregator', as SGD does it for every minibatch.
+template <typename ElemType>
+static double TimeAggregation(const MPIWrapperPtr& mpi, IDistGradAggregator<ElemType>& aggregator, const vector<shared_ptr<Matrix<ElemType>>>& gradients, size_t numIterations)
+{
+    vector<Matrix<ElemType>*> gradientPtrs;
+    for (const auto& gradient : gradients)
+        gradientPtrs.push_back(gradient.get());
+    DistGradHeader* header = DistGradHeader::Create(0);
+    bool resetState = true;
+    double seconds = TimeCollective(mpi->Communicator(), numIterations, [&]
+    {
+        header->Clear();
+        header->numSamples = 1;
+        header->numSamplesWithLabel = 1;
+        aggregator.AggregateGradients(gradientPtrs, header, resetState);
+        resetState = false;
+    });
+    DistGradHeader::Destroy(header);
+    return seconds;
+}
+
+// Measures the collectives that the distributed gradient aggregators are built on, and the aggregators themselves,
+// on the workers of this job:
+//  - MPI all-reduce and broadcast of host buffers, for every message size from 'minBytes' to 'maxBytes' (multiplied by
+//    'sizeFactor'), on the first 2, 4, 8, ... workers and all of them;
+//  - NcclComm all-reduce and broadcast of device buffers (if the workers are on GPUs and NCCL is available);
+//  - SimpleDistGradAggregator and the QuantizedDistGradAggregator with each of 'numGradientBits', on one gradient
+//    of each size, including the copies to and from the device, quantization and unquantization.
+// Given the parameters of a model, through 'modelPath' or 'parameterSizes' (numbers of elements), it also times the
+// aggregation of all of its gradients with each aggregator and recommends the fastest; with 'minibatchSeconds', the
+// compute time of a minibatch, it recommends the block size of BMUF that keeps the model averaging below 10% of the time.
+template <typename ElemType>
+void DoCommBenchmark(const ConfigParameters& config)
+{
+    auto mpi = MPIWrapper::GetInstance();
+    if (mpi == nullptr || mpi->NumNodesInUse() < 2)
+    {
+        fprintf(stderr, "commBenchmark: needs more than one worker; run it with mpiexec and parallelTrain = true.\n");
+        return;
+    }
+    DEVICEID_TYPE deviceId = DeviceFromConfig(config);
+    size_t minBytes = config(L"minBytes", (size_t) 1024);
+    size_t maxBytes = config(L"maxBytes", (size_t) 256 * 1024 * 1024);
+    size_t sizeFactor = config(L"sizeFactor", (size_t) 4);
+    size_t numIterations = config(L"numIterations", (size_t) 20);
+    ConfigArray numGradientBitsArray = config(L"numGradientBits", "1:2:4");
+    vector<size_t> numGradientBits;
+    for (size_t i = 0; i < numGradientBitsArray.size(); i++)
+        numGradientBits.push_back(numGradientBitsArray[i]);
+    if (minBytes < sizeof(ElemType) || maxBytes < minBytes || sizeFactor < 2)
+        InvalidArgument("commBenchmark: invalid message sizes, minBytes %d, maxBytes %d, sizeFactor %d.", (int) minBytes, (int) maxBytes, (int) sizeFactor);
+
+    vector<size_t> numElementsSweep;
+    for (size_t numBytes = minBytes; numBytes <= maxBytes; numBytes *= sizeFactor)
+        numElementsSweep.push_back(numBytes / sizeof(ElemType));
+
+    size_t numWorkers = mpi->NumNodesInUse();
+    bool isMainNode = mpi->IsMainNode();
+    if (isMainNode)
+        fprintf(stderr, "commBenchmark: %d workers on %s, device %d, %d iterations per measurement.\n",
+                (int) numWorkers, mpi->IsMultiHost() ? "multiple hosts" : "a single host", (int) deviceId, (int) numIterations);
+
+    // MPI collectives on the first n workers
+    vector<size_t> workerCounts;
+    for (size_t n = 2; n < numWorkers; n *= 2)
+        workerCounts.push_back(n);
+    workerCounts.push_back(numWorkers);
+    vector<ElemType> hostBuffer(numElementsSweep.back(), 1);
+    for (size_t n : workerCounts)
+    {
+        MPI_Comm comm;
+        MPI_Comm_split(mpi->Communicator(), mpi->CurrentNodeRank() < n ? 0 : MPI_UNDEFINED, (int) mpi->CurrentNodeRank(), &comm) || MpiFail("commBenchmark: MPI_Comm_split");
+        if (comm != MPI_COMM_NULL)
+        {
+            MPI_Datatype dataType = MPIWrapper::GetDataType(hostBuffer.data());
+            for (size_t numElements : numElementsSweep)
+            {
+                double seconds = TimeCollective(comm, numIterations, [&]
+                {
+                    MPI_Allreduce(MPI_IN_PLACE, hostBuffer.data(), (int) numElements, dataType, MPI_SUM, comm) || MpiFail("commBenchmark: MPI_Allreduce");
+                });
+                if (isMainNode)
+                    PrintCollectiveResult("MPI all-reduce", n, numElements * sizeof(ElemType), seconds, 2.0 * (n - 1) / n);
+            }
+            for (size_t numElements : numElementsSweep)
+            {
+                double seconds = TimeCollective(comm, numIterations, [&]
+                {
+                    MPI_Bcast(hostBuffer.data(), (int) numElements, dataType, 0, comm) || MpiFail("commBenchmark: MPI_Bcast");
+                });
+                if (isMainNode)
+                    PrintCollectiveResult("MPI broadcast", n, numElements * sizeof(ElemType), seconds, 1.0);
+            }
+            MPI_Comm_free(&comm) || MpiFail("commBenchmark: MPI_Comm_free");
+        }
+        MPI_Barrier(mpi->Communicator()) || MpiFail("commBenchmark: MPI_Barrier");
+    }
+
+    // NCCL on the devices of all workers
+    if (deviceId != CPUDEVICE)
+    {
+        NcclComm nccl(deviceId, mpi);
+        if (nccl.IsSupported())
+        {
+            Matrix<ElemType> deviceBuffer(numElementsSweep.back(), 1, deviceId);
+            deviceBuffer.SetValue(1);
+            for (size_t numElements : numElementsSweep)
+            {
+                double seconds = TimeCollective(mpi->Communicator(), numIterations, [&]
+                {
+                    nccl.AllReduce(deviceBuffer.Data(), numElements);
+                    nccl.Sync();
+                });
+                if (isMainNode)
+                    PrintCollectiveResult("NCCL all-reduce", numWorkers, numElements * sizeof(ElemType), seconds, 2.0 * (numWorkers - 1) / numWorkers);
+            }
+            for (size_t numElements : numElementsSweep)
+            {
+                double seconds = TimeCollective(mpi->Communicator(), numIterations, [&]
+                {
+                    nccl.Broadcast(deviceBuffer.Data(), numElements);
+                    nccl.Sync();
+                });
+                if (isMainNode)
+                    PrintCollectiveResult("NCCL broadcast", numWorkers, numElements * sizeof(ElemType), seconds, 1.0);
+            }
+        }
+        else if (isMainNode)
+            fprintf(stderr, "commBenchmark: NCCL is not available, skipping it.\n");
+    }
+
+    // the aggregators, on a gradient of each size; the bandwidths are of the full-precision gradient
+    auto simpleAggregator = make_shared<SimpleDistGradAggregator<ElemType>>(mpi, false, deviceId, 0);
+    for (size_t numElements : numElementsSweep)
+    {
+        size_t numRows = min(numElements, (size_t) 1024);
+        vector<shared_ptr<Matrix<ElemType>>> gradients(1, make_shared<Matrix<ElemType>>(numRows, numElements / numRows, deviceId));
+        gradients[0]->SetUniformRandomValue(-1, 1, 1);
+        double seconds = TimeAggregation(mpi, *simpleAggregator, gradients, numIterations);
+        if (isMainNode)
+            PrintCollectiveResult("SimpleDistGradAggregator", numWorkers, numElements * sizeof(ElemType), seconds, 2.0 * (numWorkers - 1) / numWorkers);
+        for (size_t bits : numGradientBits)
+        {
+            QuantizedDistGradAggregator<ElemType> quantizedAggregator(mpi, bits, nullptr, true, 0);
+            double quantizedSeconds = TimeAggregation(mpi, quantizedAggregator, gradients, numIterations);
+            if (isMainNode)
+            {
+                string name = "Quantized, " + to_string(bits) + " bits";
+                PrintCollectiveResult(name.c_str(), numWorkers, numElements * sizeof(ElemType), quantizedSeconds, 2.0 * (numWorkers - 1) / numWorkers);
+            }
+        }
+    }
+
+    // recommendation for the gradients of a model
+    auto modelGradients = CreateModelGradients<ElemType>(config, deviceId);
+    if (modelGradients.empty())
+        return;
+    size_t modelElements = 0;
+    for (const auto& gradient : modelGradients)
+        modelElements += gradient->GetNumElements();
+
+    vector<pair<double, string>> candidates;
+    candidates.push_back(make_pair(TimeAggregation(mpi, *simpleAggregator, modelGradients, numIterations), string("SimpleDistGradAggregator, one reduction per gradient")));
+    size_t bucketSizeInBytes = config(L"bucketSizeInBytes", (size_t) 16 * 1024 * 1024);
+    SimpleDistGradAggregator<ElemType> bucketedAggregator(mpi, false, deviceId, 0, false, bucketSizeInBytes);
+    candidates.push_back(make_pair(TimeAggregation(mpi, bucketedAggregator, modelGradients, numIterations),
+                                   "SimpleDistGradAggregator, gradients bucketed into " + to_string(bucketSizeInBytes) + " bytes"));
+    for (size_t bits : numGradientBits)
+    {
+        QuantizedDistGradAggregator<ElemType> quantizedAggregator(mpi, bits, nullptr, true, 0);
+        candidates.push_back(make_pair(TimeAggregation(mpi, quantizedAggregator, modelGradients, numIterations),
+                                       "QuantizedDistGradAggregator, " + to_string(bits) + " bits (numGradientBits = " + to_string(bits) + ")"));
+    }
+    if (!isMainNode)
+        return;
+
+    fprintf(stderr, "commBenchmark: model with %d parameters, %d elements (%.1f MB):\n",
+            (int) modelGradients.size(), (int) modelElements, modelElements * sizeof(ElemType) / 1e6);
+    double fullPrecisionSeconds = candidates[0].first;
+    sort(candidates.begin(), candidates.end());
+    for (const auto& candidate : candidates)
+        fprintf(stderr, "commBenchmark:     %10.3f ms per minibatch with %s\n", 1e3 * candidate.first, candidate.second.c_str());
+    fprintf(stderr, "commBenchmark: recommended data-parallel aggregation: %s.\n", candidates.front().second.c_str());
+    fprintf(stderr, "commBenchmark: quantization loses precision that its residuals only make up over time; prefer full precision unless it is clearly faster.\n");
+
+    // BMUF averages the model (the size of the gradients) once per block of minibatches
+    double minibatchSeconds = config(L"minibatchSeconds", 0.0);
+    if (minibatchSeconds > 0)
+    {
+        size_t blockSize = (size_t) ceil(fullPrecisionSeconds / (0.1 * minibatchSeconds));
+        fprintf(stderr, "commBenchmark: data-parallel aggregation takes %.0f%% of a %.3f ms minibatch; BMUF keeps model averaging below 10%% with a block of %d minibatches per worker.\n",
+                100 * fullPrecisionSeconds / (minibatchSeconds + fullPrecisionSeconds), 1e3 * minibatchSeconds, (int) max(blockSize, (size_t) 1));
+    }
+}
+
+template void DoCommBenchmark<float>(const ConfigParameters& config);
+template void DoCommBenchmark<double>(const ConfigParameters& config);
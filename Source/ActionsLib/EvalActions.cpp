@@ -30,6 +30,7 @@
 #include <queue>
 #include <set>
 #include <memory>
+#include <future>
 
 #ifndef let
 #define let const auto
@@ -95,7 +96,12 @@ void DoEval(const ConfigParameters& config)
         readerConfig.Insert("randomize", "None");
     }
 
+    // create the CUDA context and the library handles while the reader indexes its data
+    DEVICEID_TYPE deviceId = DeviceFromConfig(config);
+    auto deviceInitialization = async(launch::async, [deviceId]() { Matrix<ElemType>::InitializeDevice(deviceId); });
+
     DataReader testDataReader(readerConfig);
+    deviceInitialization.get();
     DoEvalBase<ElemType>(config, testDataReader);
 }
 
@@ -224,7 +230,12 @@ void DoWriteOutput(const ConfigParameters& config)
     ConfigParameters readerConfig(config(L"reader"));
     readerConfig.Insert("randomize", "None"); // we don't want randomization when output results
 
+    // create the CUDA context and the library handles while the reader indexes its data
+    DEVICEID_TYPE deviceId = DeviceFromConfig(config);
+    auto deviceInitialization = async(launch::async, [deviceId]() { Matrix<ElemType>::InitializeDevice(deviceId); });
+
     DataReader testDataReader(readerConfig);
+    deviceInitialization.get();
 
     ConfigArray minibatchSize = config(L"minibatchSize", "2048");
     intargvector mbSize = minibatchSize;
@@ -258,6 +269,10 @@ void DoWriteOutput(const ConfigParameters& config)
         wstring outputPath = config(L"outputPath");
         WriteFormattingOptions formattingOptions(config);
         bool nodeUnitTest = config(L"nodeUnitTest", "false");
+        size_t maxPendingMinibatches = config(L"maxPendingMinibatches", "2"); // minibatches written in the background while the next ones are computed
+        bool binaryOutput = config(L"binaryOutput", "false");
+        writer.SetMaxPendingMinibatches(maxPendingMinibatches);
+        writer.SetBinaryOutput(binaryOutput);
         writer.WriteOutput(testDataReader, mbSize[0], outputPath, outputNodeNamesVector, formattingOptions, epochSize, nodeUnitTest);
     }
     else
@@ -179,12 +179,73 @@ ComputationNetworkPtr GetModelFromConfig(const ConfigRecordType& config, const w
         // By not compiling the network before patching, we avoid double log output for validation.
         net = make_shared<ComputationNetwork>(deviceId);
         net->SetTraceLevel(config(L"traceLevel", 0));
-        net->Read<ElemType>(modelPath);
+        // 'convertPrecision' loads a model saved in the other precision, e.g. a double model for float evaluation
+        net->Read<ElemType>(modelPath, config(L"convertPrecision", false));
         if (outputNodeNames.size() > 0)
             PatchOutputNodes(net, outputNodeNames, outputNodeNamesVector);
         net->CompileNetwork();
     }
 
+    // inference: fold BatchNormalization into the preceding Convolution or Times, see FoldBatchNormalization().
+    // Done before quantization so that the folded weights are the ones that get quantized.
+    if (config(L"foldBatchNormalization", false))
+        net->FoldBatchNormalization<ElemType>();
+
+    // inference: remove what the output nodes do not need and precompute constant values, see OptimizeForInference()
+    if (config(L"optimizeForInference", false))
+        net->OptimizeForInference<ElemType>();
+
+    // CPU inference with 16-bit fixed-point products by the weights. The bit shifts trade accuracy for headroom against
+    // integer overflow (see SymmetricQuantizer); with shifts below 2, the slower reference product is used instead of
+    // BlockMultiplier. Products that need full precision, e.g. the output layer, can be excluded.
+    if (config(L"quantizedInference", false))
+    {
+        ConfigArray excludedNodes = config(L"quantizedInferenceExcludedNodes", ConfigArray(""));
+        set<wstring> excludedNodeNames;
+        for (wstring name : excludedNodes)
+        {
+            if (!name.empty())
+                excludedNodeNames.insert(name);
+        }
+        net->QuantizeTimesNodes<ElemType>(config(L"quantizedInferenceBitShiftWeights", (size_t) 2), config(L"quantizedInferenceBitShiftData", (size_t) 2), excludedNodeNames);
+    }
+
+    // inference with pruned weights: keep the weights that are mostly zeros as sparse matrices, see SparsifyTimesWeights()
+    if (config(L"sparseWeights", false))
+        net->SparsifyTimesWeights<ElemType>(config(L"sparseWeightsMaxDensity", 0.3));
+
+    // CPU inference with MKL: keep the weights of Times operations packed for the GEMM kernels, see PackTimesWeights().
+    // Done after the steps above, which may replace or switch the weights.
+    if (config(L"packedWeights", false))
+        net->PackTimesWeights<ElemType>();
+
+    // inference: approximate Sigmoid, Tanh, Exp and Log within about 1e-6, see EnableFastMath()
+    if (config(L"fastMath", false))
+        net->EnableFastMath();
+
+    // inference: compute chains of elementwise ops outside recurrent loops in one pass each, see FuseElementwiseChains()
+    if (config(L"fuseElementwiseOps", false))
+        net->EnableElementwiseFusion(true);
+
+    // compute activations like ReLU or Sigmoid in place over their input where nothing else reads it, see EnableInPlaceExecution()
+    if (config(L"inPlaceActivations", false))
+        net->EnableInPlaceExecution(true);
+
+    // compute products by a RowStack (Splice) of several towers from the towers directly, see EnableRowStackElimination()
+    if (config(L"eliminateRowStack", false))
+        net->EnableRowStackElimination(true);
+    // compute products by a Transpose of weights with the transposition flag of GEMM, see EnableTransposeAbsorption()
+    if (config(L"absorbTranspose", false))
+        net->EnableTransposeAbsorption(true);
+
+    // inference on the CPU: compute independent branches concurrently, see EnableConcurrentBranches()
+    if (config(L"concurrentBranches", false))
+        net->EnableConcurrentBranches(true);
+
+    // GPU: replay the forward and backward passes as recorded GPU graphs while their shapes stay the same, see EnableGPUGraphReplay()
+    if (config(L"gpuGraphReplay", false))
+        net->EnableGPUGraphReplay(true);
+
     return net;
 }
 
@@ -16,6 +16,7 @@
 #include "Config.h"
 #include "ScriptableObjects.h"
 #include "BrainScriptEvaluator.h"
+#include "BestGpu.h"
 
 #include <string>
 #include <chrono>
@@ -26,6 +27,7 @@
 #include <set>
 #include <memory>
 #include <map>
+#include <numeric>
 
 #ifndef let
 #define let const auto
@@ -112,6 +114,119 @@ void DoCreateLabelMap(const ConfigParameters& config)
 template void DoCreateLabelMap<float>(const ConfigParameters& config);
 template void DoCreateLabelMap<double>(const ConfigParameters& config);
 
+// ===========================================================================
+// DoReaderBenchmark() - implements CNTK "readerBenchmark" command
+// ===========================================================================
+
+// Drains the minibatches of the 'reader' section without any network, to measure the reader pipeline on its own.
+// The streams are the ones named in 'streams', else the inputs of the deserializers, else the feature and label
+// sections of a legacy reader. Inputs with format = "sparse" are read into sparse matrices. With verbosity > 0 (the
+// default here) the reader also logs the time of its deserialize, transform, pack and copy stages per epoch.
+template <typename ElemType>
+void DoReaderBenchmark(const ConfigParameters& config)
+{
+    ConfigParameters readerConfig(config(L"reader"));
+    if (!readerConfig.ExistsCurrent(L"verbosity"))
+        readerConfig.Insert("verbosity", "1");
+    size_t minibatchSize = config(L"minibatchSize", "256");
+    size_t epochSize = config(L"epochSize", "0");
+    size_t numEpochs = config(L"numEpochs", "1");
+    size_t maxMinibatches = config(L"maxMinibatches", "0"); // 0 means all of the epoch
+    if (epochSize == 0)
+        epochSize = requestDataSize;
+    DEVICEID_TYPE deviceId = DeviceFromConfig(config);
+
+    // the names of the streams, and whether they are sparse
+    std::vector<std::pair<std::wstring, bool>> streams;
+    if (config.ExistsCurrent(L"streams"))
+    {
+        ConfigArray names = config(L"streams");
+        for (size_t i = 0; i < names.size(); i++)
+            streams.push_back(make_pair(msra::strfun::utf16(names[i]), false));
+    }
+    else if (readerConfig.ExistsCurrent(L"deserializers"))
+    {
+        argvector<ConfigValue> deserializerConfigs = readerConfig(L"deserializers");
+        for (size_t i = 0; i < deserializerConfigs.size(); i++)
+        {
+            ConfigParameters deserializerConfig = deserializerConfigs[i];
+            if (!deserializerConfig.ExistsCurrent(L"input"))
+                continue;
+            ConfigParameters input = deserializerConfig(L"input");
+            for (const auto& id : input.GetMemberIds())
+            {
+                if (!input.CanBeConfigRecord(id))
+                    continue;
+                ConfigParameters streamConfig = input(id);
+                std::string format = streamConfig.Find("format", "dense");
+                streams.push_back(make_pair(id, EqualCI(format, "sparse")));
+            }
+        }
+    }
+    else
+    {
+        std::vector<std::wstring> featureNames;
+        std::vector<std::wstring> labelNames;
+        GetFileConfigNames(readerConfig, featureNames, labelNames);
+        for (const auto& name : featureNames)
+            streams.push_back(make_pair(name, false));
+        for (const auto& name : labelNames)
+            streams.push_back(make_pair(name, false));
+    }
+    if (streams.empty())
+        InvalidArgument("ReaderBenchmark: no streams found in the reader configuration, specify them with 'streams'.");
+
+    StreamMinibatchInputs matrices;
+    for (const auto& stream : streams)
+    {
+        auto matrix = stream.second ? make_shared<Matrix<ElemType>>(0, 0, deviceId, SPARSE, matrixFormatSparseCSC)
+                                    : make_shared<Matrix<ElemType>>(deviceId);
+        matrices.AddInput(stream.first, matrix, make_shared<MBLayout>(), TensorShape());
+    }
+
+    DataReader dataReader(readerConfig);
+    for (size_t epoch = 0; epoch < numEpochs; epoch++)
+    {
+        std::vector<double> latencies; // of each GetMinibatch() call, in seconds
+        size_t numSamples = 0, numDenseBytes = 0;
+        auto start = std::chrono::high_resolution_clock::now();
+        dataReader.StartMinibatchLoop(minibatchSize, epoch, matrices.GetStreamDescriptions(), epochSize);
+        for (;;)
+        {
+            auto requested = std::chrono::high_resolution_clock::now();
+            if (!dataReader.GetMinibatch(matrices))
+                break;
+            latencies.push_back(std::chrono::duration<double>(std::chrono::high_resolution_clock::now() - requested).count());
+
+            numSamples += matrices.GetInput(streams.front().first).pMBLayout->GetActualNumSamples();
+            for (const auto& stream : streams)
+            {
+                if (!stream.second)
+                    numDenseBytes += matrices.GetInputMatrix<ElemType>(stream.first).GetNumElements() * sizeof(ElemType);
+            }
+            if (maxMinibatches > 0 && latencies.size() >= maxMinibatches)
+                break;
+        }
+        double seconds = std::chrono::duration<double>(std::chrono::high_resolution_clock::now() - start).count();
+
+        if (latencies.empty())
+        {
+            fprintf(stderr, "ReaderBenchmark: epoch %d returned no minibatches.\n", (int) epoch + 1);
+            continue;
+        }
+        double meanLatency = std::accumulate(latencies.begin(), latencies.end(), 0.0) / latencies.size();
+        std::sort(latencies.begin(), latencies.end());
+        auto percentile = [&latencies](double p) { return latencies[std::min(latencies.size() - 1, (size_t) (p * latencies.size()))]; };
+        fprintf(stderr, "ReaderBenchmark: epoch %d: %d minibatches, %d samples in %.3fs = %.1f samples/s, %.1f MB/s of dense data.\n",
+                (int) epoch + 1, (int) latencies.size(), (int) numSamples, seconds, numSamples / seconds, numDenseBytes / seconds / (1024 * 1024));
+        fprintf(stderr, "ReaderBenchmark: epoch %d: minibatch latency mean %.3fms, p50 %.3fms, p99 %.3fms, max %.3fms.\n",
+                (int) epoch + 1, 1000 * meanLatency, 1000 * percentile(0.5), 1000 * percentile(0.99), 1000 * latencies.back());
+    }
+}
+
+template void DoReaderBenchmark<float>(const ConfigParameters& config);
+template void DoReaderBenchmark<double>(const ConfigParameters& config);
+
 // ===========================================================================
 // DoParameterSVD() - implements CNTK "SVD" command
 // ===========================================================================
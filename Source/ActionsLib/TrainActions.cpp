@@ -36,6 +36,7 @@
 #include <queue>
 #include <set>
 #include <memory>
+#include <future>
 
 #ifndef let
 #define let const auto
@@ -67,6 +68,54 @@ shared_ptr<C> CreateObject(const ConfigParameters& config, const wchar_t* id)
     return make_shared<C>(readerConfig);                           // old CNTK config specifies a dictionary which then must be explicitly instantiated
 }
 
+// the text of the reader configuration, which identifies the training data for SGD's preComputeCache
+static std::string GetReaderConfigText(const ConfigParameters& config)
+{
+    return config(L"reader");
+}
+static std::string GetReaderConfigText(const ScriptableObjects::IConfigRecord&)
+{
+    return std::string(); // BrainScript records have no text form
+}
+
+// a hash of the names, operations and dimensions of the nodes of a network, and of whether the precomputed ones are computed
+static size_t GetNetworkSignature(const ComputationNetwork& net)
+{
+    wstring signature;
+    for (const auto& node : net.GetAllNodes())
+    {
+        signature += node->NodeName() + L" " + node->OperationName();
+        for (auto dim : node->GetSampleLayout().GetDims())
+            signature += L" " + std::to_wstring(dim);
+        auto preComputeNode = dynamic_pointer_cast<IPreComputeNode>(node);
+        if (preComputeNode)
+            signature += preComputeNode->HasComputed() ? L" computed" : L" not computed";
+        signature += L"\n";
+    }
+    return std::hash<wstring>()(signature);
+}
+
+// In distributed training only the main node reads the model of the checkpoint, so that not all workers load it from the
+// shared file system at once. The others create the network from its description, and SGD::Train() copies the parameters
+// of the main node into it. If that network differs from the checkpoint otherwise (e.g. in precomputed statistics, which
+// are not copied, or because the model was edited), the worker loads the checkpoint after all.
+template <typename ElemType>
+static ComputationNetworkPtr LoadCheckpointOnMainNode(const MPIWrapperPtr& mpi, DEVICEID_TYPE deviceId, const wstring& modelFileName,
+                                                      const function<ComputationNetworkPtr(DEVICEID_TYPE)>& createNetworkFn)
+{
+    ComputationNetworkPtr net = mpi->IsMainNode() ? ComputationNetwork::CreateFromFile<ElemType>(deviceId, modelFileName) : createNetworkFn(deviceId);
+
+    size_t signature = GetNetworkSignature(*net);
+    size_t mainNodeSignature = signature;
+    mpi->Bcast(&mainNodeSignature, 1, mpi->MainNodeRank());
+    if (signature != mainNodeSignature)
+    {
+        LOGPRINTF(stderr, "The network created from its description does not match the checkpoint, loading it from '%ls'.\n", modelFileName.c_str());
+        net = ComputationNetwork::CreateFromFile<ElemType>(deviceId, modelFileName);
+    }
+    return net;
+}
+
 template <class ConfigRecordType, typename ElemType>
 void DoTrain(const ConfigRecordType& config)
 {
@@ -93,6 +142,9 @@ void DoTrain(const ConfigRecordType& config)
         return;
     }
 
+    // creating the CUDA context and the library handles takes seconds, do it while the network and the readers are set up
+    auto deviceInitialization = async(launch::async, [deviceId]() { Matrix<ElemType>::InitializeDevice(deviceId); });
+
     wstring modelFileName = optimizer->GetModelNameForEpoch(int(startEpoch) - 1);
     bool loadNetworkFromCheckpoint = startEpoch >= 0;
     if (loadNetworkFromCheckpoint)
@@ -107,7 +159,17 @@ void DoTrain(const ConfigRecordType& config)
     createNetworkFn = GetNetworkFactory<ConfigRecordType, ElemType>(config);
 
     // create or load from checkpoint
-    shared_ptr<ComputationNetwork> net = !loadNetworkFromCheckpoint ? createNetworkFn(deviceId) : ComputationNetwork::CreateFromFile<ElemType>(deviceId, modelFileName);
+    // A checkpoint of a single worker is loaded on another thread while the readers are created, as that only reads the
+    // model file. Creating the network from its description evaluates the config, which must stay on this thread.
+    auto mpi = MPIWrapper::GetInstance();
+    shared_ptr<ComputationNetwork> net;
+    future<ComputationNetworkPtr> checkpointLoading;
+    if (!loadNetworkFromCheckpoint)
+        net = createNetworkFn(deviceId);
+    else if (mpi != nullptr && mpi->NumNodesInUse() > 1)
+        net = LoadCheckpointOnMainNode<ElemType>(mpi, deviceId, modelFileName, createNetworkFn);
+    else
+        checkpointLoading = async(launch::async, [deviceId, modelFileName]() { return ComputationNetwork::CreateFromFile<ElemType>(deviceId, modelFileName); });
 
     auto dataReader = CreateObject<DataReader>(config, L"reader");
 
@@ -115,7 +177,12 @@ void DoTrain(const ConfigRecordType& config)
     if (config.Exists(L"cvReader"))
         cvDataReader = CreateObject<DataReader>(config, L"cvReader");
 
-    optimizer->InitMPI(MPIWrapper::GetInstance());
+    if (checkpointLoading.valid())
+        net = checkpointLoading.get();
+    deviceInitialization.get(); // (rethrows its errors)
+
+    optimizer->InitMPI(mpi);
+    optimizer->SetPreComputeCacheKey(GetReaderConfigText(config));
     optimizer->Train(net, deviceId, dataReader.get(), cvDataReader.get(), startEpoch, loadNetworkFromCheckpoint);
 }
 
@@ -261,6 +328,34 @@ void DoEdit(const ConfigParameters& config)
 template void DoEdit<double>(const ConfigParameters& config);
 template void DoEdit<float>(const ConfigParameters& config);
 
+// ===========================================================================
+// DoOptimizeForInference() - implements CNTK "optimizeForInference" command
+// ===========================================================================
+
+// loads 'modelPath' for the given 'outputNodeNames', applies the inference optimizations (see
+// ComputationNetwork::OptimizeForInference()), and saves the result as 'outputModelPath' for deployment
+template <typename ElemType>
+void DoOptimizeForInference(const ConfigParameters& config)
+{
+    bool makeMode = config(L"makeMode", true);
+    wstring outputPathname = config(L"outputModelPath");
+    if (makeMode && File::Exists(outputPathname))
+    {
+        LOGPRINTF(stderr, "'%ls' exists, skipping. Specify makeMode=false to force executing the action.\n", outputPathname.c_str());
+        return;
+    }
+
+    vector<wstring> outputNodeNames;
+    ComputationNetworkPtr net = GetModelFromConfig<ConfigParameters, ElemType>(config, L"outputNodeNames", outputNodeNames);
+    if (!config(L"optimizeForInference", false)) // (else already done by GetModelFromConfig())
+        net->OptimizeForInference<ElemType>();
+    net->Save(outputPathname);
+    LOGPRINTF(stderr, "\nModel with %d nodes saved as '%ls'.\n", (int)net->GetTotalNumberOfNodes(), outputPathname.c_str());
+}
+
+template void DoOptimizeForInference<double>(const ConfigParameters& config);
+template void DoOptimizeForInference<float>(const ConfigParameters& config);
+
 // ===========================================================================
 // DoBatchNormalizationStat() - implements CNTK "bnstat" command
 // ===========================================================================
@@ -303,3 +398,58 @@ void DoBatchNormalizationStat(const ConfigParameters& config)
 template void DoBatchNormalizationStat<double>(const ConfigParameters& config);
 template void DoBatchNormalizationStat<float>(const ConfigParameters& config);
 
+// ===========================================================================
+// DoCalibrateQuantization() - implements CNTK "calibrateQuantization" command
+// ===========================================================================
+
+// loads 'modelPath', replaces its Times operations by weights with QuantizedTimes ones whose data ranges are picked from
+// 'numMinibatches' minibatches of the reader (see PostComputingActions::QuantizationCalibration()), and saves the
+// result as 'outputModelPath'
+template <typename ElemType>
+void DoCalibrateQuantization(const ConfigParameters& config)
+{
+    bool makeMode = config(L"makeMode", true);
+    wstring outputPathname = config(L"outputModelPath");
+    if (makeMode && File::Exists(outputPathname))
+    {
+        LOGPRINTF(stderr, "'%ls' exists, skipping. Specify makeMode=false to force executing the action.\n", outputPathname.c_str());
+        return;
+    }
+
+    ConfigParameters readerConfig(config(L"reader"));
+    readerConfig.Insert("traceLevel", config(L"traceLevel", "0"));
+    auto dataReader = make_shared<DataReader>(readerConfig);
+
+    int traceLevel = config(L"traceLevel", "0");
+    int numMinibatches = config(L"numMinibatches", 100);
+    ConfigArray minibatchSize = config(L"minibatchSize", "256");
+    intargvector mbSize = minibatchSize;
+
+    // As with 'quantizedInference', shifts of at least 2 keep the products on the fast block multiplier.
+    size_t bitShiftWeights = config(L"bitShiftWeights", (size_t) 2);
+    size_t bitShiftData = config(L"bitShiftData", (size_t) 2);
+    double percentile = config(L"percentile", 99.99);
+    if (percentile <= 0 || percentile > 100)
+        InvalidArgument("calibrateQuantization: 'percentile' must be in (0, 100].");
+
+    ConfigArray excludedNodes = config(L"excludedNodes", ConfigArray(""));
+    set<wstring> excludedNodeNames;
+    for (size_t i = 0; i < excludedNodes.size(); i++)
+    {
+        wstring name = excludedNodes[i];
+        if (!name.empty())
+            excludedNodeNames.insert(name);
+    }
+
+    std::vector<std::wstring> evalNodeNames;
+    let net = GetModelFromConfig<ConfigParameters, ElemType>(config, L"evalNodeNames", evalNodeNames);
+
+    // (runs on the main worker only, see commandstoRunOnAllRanks)
+    PostComputingActions<ElemType> postComputingActions(net, /*mpi=*/nullptr, /*enableDistributedMBReading=*/false, traceLevel);
+    postComputingActions.QuantizationCalibration(dataReader.get(), evalNodeNames, outputPathname, mbSize[0], numMinibatches,
+                                                 percentile, bitShiftWeights, bitShiftData, excludedNodeNames);
+}
+
+template void DoCalibrateQuantization<double>(const ConfigParameters& config);
+template void DoCalibrateQuantization<float>(const ConfigParameters& config);
+
@@ -646,13 +646,10 @@ static ConfigValuePtr Evaluate(const ExpressionPtr &e, const IConfigRecordPtr &s
                     let failfn = argVal.GetFailFn();         // note: do before argVal gets destroyed in the upcoming move()
                     argScope->Add(id, failfn, move(argVal)); // TODO: is the failfn the right one?
                 }
-                // get the macro name for the exprPath
-                wstring macroId = exprPath;
-                let pos = macroId.find(L".");
-                if (pos != wstring::npos)
-                    macroId.erase(0, pos + 1);
                 // now evaluate the function
-                return Evaluate(fnExpr, argScope, callerExprPath, L"" /*L"[" + macroId + L"]"*/); // bring args into scope; keep lex scope of '=>' as upwards chain
+                // Note: The macro name is not part of the expression path (it would be exprPath after its first '.').
+                // This runs for each expansion of the macro, so we do not form it.
+                return Evaluate(fnExpr, argScope, callerExprPath, L""); // bring args into scope; keep lex scope of '=>' as upwards chain
             };
             // positional args
             vector<wstring> paramNames;
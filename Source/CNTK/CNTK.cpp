@@ -25,6 +25,8 @@
 #include "CPUMatrix.h" // used for SetNumThreads()
 #include "GPUMatrix.h" // used for SyncGuard::EnableSync()
 #include "CommonMatrix.h"
+#include "ConvolutionAutotuneCache.h"
+#include "MatrixTransitionTracker.h"
 #include "SGD.h"
 #include "MPIWrapper.h"
 #include "Config.h"
@@ -149,6 +151,15 @@ static void DisableLegacyTruncationSettings(const ConfigParameters& TopLevelConf
         }
     }
 }
+// implicit moves of matrices between devices and between dense and sparse during training and evaluation, see MatrixTransitionTracker
+template <class ConfigRecordType>
+static void SetUpMatrixTransitionTracking(const ConfigRecordType& config)
+{
+    MatrixTransitionTracker::SetMode((wstring) config(L"matrixTransitions", L"off"));
+    stringargvector allowedScopes = config(L"allowedMatrixTransitions", ConfigRecordType::Array(stringargvector()));
+    MatrixTransitionTracker::SetAllowedScopes(allowedScopes);
+}
+
 static void DisableLegacyUsage(const ConfigParameters& TopLevelConfig, const ConfigArray& commands)
 {
     for (size_t i = 0; i < commands.size(); i++)
@@ -160,7 +171,7 @@ static void DisableLegacyUsage(const ConfigParameters& TopLevelConfig, const Con
 
 // When running in parallel with MPI, only commands in 'commandstoRunOnAllRanks' should
 // be run in parallel across multiple ranks. Others should only run on rank 0
-const std::set<std::string> commandstoRunOnAllRanks = { "train", "trainRNN", "adapt", "test", "eval", "cv", "devtest", "bnstat" };
+const std::set<std::string> commandstoRunOnAllRanks = { "train", "trainRNN", "adapt", "test", "eval", "cv", "devtest", "bnstat", "commBenchmark" };
 
 // process the command
 template <typename ElemType>
@@ -275,6 +286,10 @@ void DoCommands(const ConfigParameters& config, const shared_ptr<MPIWrapper>& mp
                 {
                     DoBatchNormalizationStat<ElemType>(commandParams);
                 }
+                else if (thisAction == "calibrateQuantization")
+                {
+                    DoCalibrateQuantization<ElemType>(commandParams);
+                }
                 else if (thisAction == "adapt")
                 {
                     DoAdapt<ElemType>(commandParams);
@@ -287,6 +302,10 @@ void DoCommands(const ConfigParameters& config, const shared_ptr<MPIWrapper>& mp
                 {
                     DoEdit<ElemType>(commandParams);
                 }
+                else if (thisAction == "optimizeForInference")
+                {
+                    DoOptimizeForInference<ElemType>(commandParams);
+                }
                 else if (thisAction == "cv")
                 {
                     DoCrossValidate<ElemType>(commandParams);
@@ -315,6 +334,14 @@ void DoCommands(const ConfigParameters& config, const shared_ptr<MPIWrapper>& mp
                 {
                     DoCreateLabelMap<ElemType>(commandParams);
                 }
+                else if (thisAction == "commBenchmark")
+                {
+                    DoCommBenchmark<ElemType>(commandParams);
+                }
+                else if (thisAction == "readerBenchmark")
+                {
+                    DoReaderBenchmark<ElemType>(commandParams);
+                }
                 else if (thisAction == "writeWordAndClass")
                 {
                     DoWriteWordAndClassInfo<ElemType>(commandParams);
@@ -327,6 +354,14 @@ void DoCommands(const ConfigParameters& config, const shared_ptr<MPIWrapper>& mp
                 {
                     DoParameterSVD<ElemType>(commandParams);
                 }
+                else if (thisAction == "convertTextToBinary")
+                {
+                    DoConvertTextToBinary<ElemType>(commandParams);
+                }
+                else if (thisAction == "convertPrecision")
+                {
+                    DoConvertModelPrecision<ElemType>(commandParams);
+                }
                 else
                 {
                     RuntimeError("unknown action: %s  in command set: %s", thisAction.c_str(), command[i].c_str());
@@ -565,10 +600,19 @@ int wmainWithBS(int argc, wchar_t* argv[]) // called from wmain which is a wrapp
         Globals::EnableShareNodeValueMatrices();
     if (config(L"hyperCompressMemory", false))
         Globals::EnableHyperCompressMemory();
+    Globals::SetMemorySharingPolicy((wstring)config(L"memorySharing", L"lifo"));
+    Globals::SetMemorySharingReportPath((wstring)config(L"memorySharingReport", L""));
+    Globals::SetValidationCacheDirectory((wstring)config(L"validationCacheDir", L""));
     if (config(L"optimizeGradientAccumulation", true))
         Globals::EnableGradientAccumulationOptimization();
+    if (config(L"skipGapColumns", false))
+        Globals::EnableGapColumnSkipping();
 
     TracingGPUMemoryAllocator::SetTraceLevel(config(L"traceGPUMemoryAllocations", 0));
+    TracingGPUMemoryAllocator::SetCachingEnabled(config(L"cacheGPUMemory", false));
+    ConvolutionAutotuneCache::Instance().SetEngineAutotuning(config(L"autotuneConvolutionEngines", false));
+    ConvolutionAutotuneCache::Instance().SetFile((wstring)config(L"convolutionAutotuneCache", L""));
+    SetUpMatrixTransitionTracking(config);
 
     bool synchronizeCUDAKernelExecutions = config(L"synchronizeCUDAKernelExecutions", false);
     if (synchronizeCUDAKernelExecutions)
@@ -634,6 +678,10 @@ int wmainWithBS(int argc, wchar_t* argv[]) // called from wmain which is a wrapp
         fprintf(fp, "successfully finished at %s on %s\n", TimeDateStamp().c_str(), GetHostName().c_str());
         fcloseOrDie(fp);
     }
+    // the ones since the last training epoch, e.g. of evaluation
+    if (MatrixTransitionTracker::IsEnabled())
+        MatrixTransitionTracker::LogSummary(stderr);
+
     // TODO: change this back to COMPLETED, double underscores don't look good in output
     LOGPRINTF(stderr, "__COMPLETED__\n");
     fflush(stderr);
@@ -712,10 +760,19 @@ int wmainOldCNTKConfig(int argc, wchar_t* argv[])
         Globals::EnableShareNodeValueMatrices();
     if (config(L"hyperCompressMemory", false))
         Globals::EnableHyperCompressMemory();
+    Globals::SetMemorySharingPolicy((wstring)config(L"memorySharing", L"lifo"));
+    Globals::SetMemorySharingReportPath((wstring)config(L"memorySharingReport", L""));
+    Globals::SetValidationCacheDirectory((wstring)config(L"validationCacheDir", L""));
     if (config(L"optimizeGradientAccumulation", true))
         Globals::EnableGradientAccumulationOptimization();
+    if (config(L"skipGapColumns", false))
+        Globals::EnableGapColumnSkipping();
 
     TracingGPUMemoryAllocator::SetTraceLevel(config(L"traceGPUMemoryAllocations", 0));
+    TracingGPUMemoryAllocator::SetCachingEnabled(config(L"cacheGPUMemory", false));
+    ConvolutionAutotuneCache::Instance().SetEngineAutotuning(config(L"autotuneConvolutionEngines", false));
+    ConvolutionAutotuneCache::Instance().SetFile((wstring)config(L"convolutionAutotuneCache", L""));
+    SetUpMatrixTransitionTracking(config);
 
     if (logpath != L"")
     {
@@ -799,6 +856,10 @@ int wmainOldCNTKConfig(int argc, wchar_t* argv[])
     else
         RuntimeError("CNTK: Invalid precision string: \"%s\", must be \"float\" or \"double\"", type.c_str());
 
+    // the ones since the last training epoch, e.g. of evaluation
+    if (MatrixTransitionTracker::IsEnabled())
+        MatrixTransitionTracker::LogSummary(stderr);
+
     // if completed then write a doneFile if requested
     if (!doneFile.empty())
     {
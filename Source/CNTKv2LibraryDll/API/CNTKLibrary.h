@@ -405,6 +405,7 @@ namespace CNTK
         friend class PackedValue;
         friend class MPICommunicatorImpl;
         friend class BlockMomentumDistributedLearner;
+        friend class Trainer;
         friend class Internal::VariableResolver;
 
         template <typename T, typename ...CtorArgTypes>
@@ -418,6 +419,14 @@ namespace CNTK
         ///
         CNTK_API NDArrayView(::CNTK::DataType dataType, const NDShape& viewShape, void* dataBuffer, size_t bufferSizeInBytes, const DeviceDescriptor& device, bool readOnly = false);
 
+        ///
+        /// Construct a NDArrayView with the specified 'dataBuffer' as the backing storage, without copying it.
+        /// The 'dataBuffer' must have been allocated on the specified 'device' and must be at least as large as the total size of the specified 'viewShape'.
+        /// 'bufferOwner' keeps the 'dataBuffer' alive; it is released when neither the created NDArrayView nor any alias of it refers to the buffer anymore.
+        /// This allows wrapping buffers owned by another framework, e.g. a NumPy array or a device array exposed by a language binding.
+        ///
+        CNTK_API NDArrayView(::CNTK::DataType dataType, const NDShape& viewShape, void* dataBuffer, size_t bufferSizeInBytes, const DeviceDescriptor& device, bool readOnly, const std::shared_ptr<void>& bufferOwner);
+
         /// Construct a read-only NDArrayView with the specified 'dataBuffer' as the backing storage.
         /// The 'dataBuffer' must have been allocated on the specified 'device', must be at least
         /// as large as the total size of the specified 'viewShape' and must outlive the created NDArrayView object.
@@ -683,6 +692,7 @@ namespace CNTK
     class NDMask final : public std::enable_shared_from_this<NDMask>
     {
         friend class CompositeFunction;
+        friend class Utils;
 
         template <typename T, typename ...CtorArgTypes>
         friend inline std::shared_ptr<T> MakeSharedObject(CtorArgTypes&& ...ctorArgs);
@@ -779,6 +789,12 @@ namespace CNTK
 
         Microsoft::MSR::CNTK::Matrix<char>* GetMatrix() const;
 
+        // If 'this' mask has one run of valid steps per sequence, returns the sequence begin flags and lengths
+        bool GetSequenceRuns(std::vector<bool>& sequenceBeginFlags, std::vector<size_t>& sequenceLengths) const;
+
+        bool MarkSequenceRunsAs(size_t rowOffset, size_t sliceRowLength, size_t colOffset, size_t sliceColLength, MaskKind maskKind);
+        void DiscardSequenceRuns();
+
         // Disallow copy and move construction and assignment
         NDMask(const NDMask&) = delete; NDMask& operator=(const NDMask&) = delete; NDMask& operator=(NDMask&&) = delete; NDMask(NDMask&& other) = delete;
 
@@ -787,6 +803,13 @@ namespace CNTK
         NDShape m_maskShape;
 
         std::shared_ptr<Microsoft::MSR::CNTK::Matrix<char>> m_matrixView;
+
+        // Run-length form of a [#steps x #sequences] mask: the steps [0, length) of every sequence are Valid, the first
+        // one SequenceBegin if flagged, the rest are Invalid. While it is used, the matrix is only written when it is accessed.
+        bool m_hasSequenceRuns;
+        mutable bool m_isMatrixStale;
+        std::vector<bool> m_sequenceBeginFlags;
+        std::vector<size_t> m_sequenceLengths;
     };
 
     /// 
@@ -843,6 +866,23 @@ namespace CNTK
             return Create(sampleShape, sequences, {}, device, readOnly);
         }
 
+        ///
+        /// Create a new Value object containing a collection of variable length sequences that are already padded to the same length,
+        /// i.e. 'paddedSequences' (dense or SparseCSC) has the shape 'sampleShape' x the padded sequence length x the number of sequences,
+        /// and sequence i occupies the first sequenceLengths[i] samples of its column.
+        /// The created Value object refers to the 'paddedSequences' data on its device without copying it; only the mask is created.
+        ///
+        CNTK_API static ValuePtr Create(const NDShape& sampleShape, const NDArrayViewPtr& paddedSequences, const std::vector<size_t>& sequenceLengths, const std::vector<bool>& sequenceStartFlags, bool readOnly = false);
+
+        ///
+        /// Create a new Value object containing a collection of variable length sequences that are already padded to the same length.
+        /// The created Value object refers to the 'paddedSequences' data on its device without copying it; only the mask is created.
+        ///
+        static ValuePtr Create(const NDShape& sampleShape, const NDArrayViewPtr& paddedSequences, const std::vector<size_t>& sequenceLengths, bool readOnly = false)
+        {
+            return Create(sampleShape, paddedSequences, sequenceLengths, std::vector<bool>(), readOnly);
+        }
+
         ///
         /// Create a new Value object containing a collection of variable length sequences of one hot vectors
         /// The created Value object contains a copy of the specified 'sequences' data.
@@ -1256,6 +1296,10 @@ namespace CNTK
             AllocateDataPtr(value);
         }
 
+        // These take over the contents instead of copying them (e.g. the tensors when serializing a model).
+        CNTK_API DictionaryValue(std::vector<::CNTK::DictionaryValue>&& value);
+        CNTK_API DictionaryValue(::CNTK::Dictionary&& value);
+
         template <typename T>
         DictionaryValue(const T& value) : m_valueType(GetValueType<T>())
         {
@@ -2639,6 +2683,13 @@ namespace CNTK
     ///
     CNTK_API FunctionPtr Hardmax(const Variable& operand, const std::wstring& name = L"");
 
+    ///
+    /// Create an instance of the CNTK built-in top-k operation on specified tensor input operand. The outputs are the k largest
+    /// values of the operand in descending order, and their (0-based) indices into the flattened operand, both of shape [k].
+    /// Only these are computed on the device and copied back, which for large outputs is much less than the operand.
+    ///
+    CNTK_API FunctionPtr TopK(const Variable& operand, size_t k, const std::wstring& name = L"");
+
     ///
     /// Create an instance of the CNTK built-in transpose dimensions operation on specified tensor input operand
     ///
@@ -3222,6 +3273,9 @@ namespace CNTK
     {
         double l1RegularizationWeight = 0.0;
         double l2RegularizationWeight = 0.0;
+        // decoupled weight decay: the parameters decay as by an L2 regularization of this weight with plain SGD, but besides the
+        // update instead of through the gradient, so that adaptive learners do not rescale it
+        double weightDecay = 0.0;
 #ifdef SWIG //for python interop (swig does not fully support "using")
         TrainingParameterPerUnitSchedule<double, TrainingParameterSchedule<double>::UnitType::Minibatch> gaussianNoiseInjectionStdDev = 0.0;
 #else
@@ -3354,7 +3408,7 @@ namespace CNTK
     static MomentumSchedule DefaultVarianceMomentum = MomentumAsTimeConstantSchedule(2 * 3600 * 100);
 
     ///
-    /// Create an instance of the CNTK built-in Adam learner (only the low-memory variant is supported at the moment).
+    /// Create an instance of the CNTK built-in Adam learner. The low-memory variant is FSAdaGrad; otherwise it is Adam with bias correction.
     ///
     CNTK_API LearnerPtr AdamLearner(const std::vector<Parameter>& parameters,
                                     const LearningRateSchedule& learningRateSchedule,
@@ -3363,6 +3417,30 @@ namespace CNTK
                                     bool lowMemory = true,
                                     AdditionalLearningOptions additionalOptions = AdditionalLearningOptions());
 
+    ///
+    /// Create an instance of the CNTK built-in AdamW learner: Adam with bias correction and weight decay decoupled from the gradient,
+    /// i.e. the step of each parameter value w is learningRate * (m / (sqrt(v) + epsilon) + weightDecay * w).
+    ///
+    CNTK_API LearnerPtr AdamWLearner(const std::vector<Parameter>& parameters,
+                                     const LearningRateSchedule& learningRateSchedule,
+                                     const MomentumSchedule& momentumSchedule,
+                                     const MomentumSchedule& varianceMomentumSchedule,
+                                     double weightDecay,
+                                     double epsilon = 1e-8,
+                                     AdditionalLearningOptions additionalOptions = AdditionalLearningOptions());
+
+    ///
+    /// Create an instance of the CNTK built-in LAMB learner for large minibatches: the AdamW step of each parameter is scaled by the
+    /// ratio of the norm of the parameter to the norm of the step.
+    ///
+    CNTK_API LearnerPtr LAMBLearner(const std::vector<Parameter>& parameters,
+                                    const LearningRateSchedule& learningRateSchedule,
+                                    const MomentumSchedule& momentumSchedule,
+                                    const MomentumSchedule& varianceMomentumSchedule,
+                                    double weightDecay,
+                                    double epsilon = 1e-6,
+                                    AdditionalLearningOptions additionalOptions = AdditionalLearningOptions());
+
     ///
     /// Create an instance of the CNTK built-in AdaGrad learner.
     ///
@@ -3491,6 +3569,16 @@ namespace CNTK
         // TODO: Add overload for multiple evaluation criterion
         CNTK_API Trainer(const FunctionPtr& model, const FunctionPtr& lossFunction, const FunctionPtr& evaluationFunction, const std::vector<LearnerPtr>& parameterLearners);
 
+        ///
+        /// Construct a Trainer that trains a replica of the model on each of the specified 'devices' of this process, without MPI.
+        /// 'model' and its parameters must be on the first device; the replicas on the other devices are created from it.
+        /// TrainMinibatch splits each minibatch by sequences across the devices, sums the gradients of the replicas on the first device
+        /// (with NCCL if CNTK was built with it and all devices are GPUs), updates the parameters there, and copies them to the other replicas.
+        /// The 'computeDevice' argument of TrainMinibatch is ignored, and 'outputsToFetch' are those of the first device's part of the minibatch.
+        /// The learners may be distributed, in which case each process aggregates the summed gradients of its devices with the other workers.
+        ///
+        CNTK_API Trainer(const FunctionPtr& model, const FunctionPtr& lossFunction, const FunctionPtr& evaluationFunction, const std::vector<LearnerPtr>& parameterLearners, const std::vector<DeviceDescriptor>& devices);
+
         ///
         /// Optimize model parameters using the specified 'arguments' minibatch of training samples.
         /// Returns false if all parameter learners indicate end of learning (through their Update method's return value).
@@ -3562,13 +3650,37 @@ namespace CNTK
         ///
         CNTK_API size_t TotalNumberOfSamplesSeen() const;
 
+        ///
+        /// Devices that 'this' Trainer trains replicas of the model on; empty unless constructed with a list of devices.
+        ///
+        const std::vector<DeviceDescriptor>& ReplicaDevices() const { return m_replicaDevices; }
+
     private:
+        struct Replica;
+
         void ExecuteForwardBackward(
             const std::unordered_map<Variable, ValuePtr>& arguments,
             std::unordered_map<Variable, ValuePtr>& outputsToFetch,
             const DeviceDescriptor& computeDevice,
             std::unordered_map<Variable, ValuePtr>& parameterGradients);
 
+        void ExecuteReplicatedForwardBackward(
+            const std::unordered_map<Variable, ValuePtr>& arguments,
+            std::unordered_map<Variable, ValuePtr>& outputsToFetch,
+            std::unordered_map<Variable, ValuePtr>& parameterGradients);
+
+        void CreateReplica(const DeviceDescriptor& device);
+        std::vector<std::unordered_map<Variable, ValuePtr>> SplitMinibatch(const std::unordered_map<Variable, ValuePtr>& arguments);
+        void ReduceReplicaGradients(std::unordered_map<Variable, ValuePtr>& parameterGradients, size_t numActiveReplicas);
+        void BroadcastParameters();
+        NDArrayViewPtr DenseGradient(ValuePtr& gradient);
+
+        template <typename ElementType>
+        void Reduce(const std::vector<NDArrayViewPtr>& views, bool useNccl);
+
+        template <typename ElementType>
+        void Broadcast(const std::vector<NDArrayViewPtr>& views, bool useNccl);
+
         bool TrainLocalMinibatch(const std::unordered_map<Variable, ValuePtr>& arguments, std::unordered_map<Variable, ValuePtr>& outputsToFetch, const DeviceDescriptor& computeDevice);
         bool TrainDistributedMinibatch(const std::unordered_map<Variable, ValuePtr>& arguments, std::unordered_map<Variable, ValuePtr>& outputsToFetch, const DeviceDescriptor& computeDevice);
 
@@ -3589,6 +3701,11 @@ namespace CNTK
         size_t   m_prevMinibatchNumSamples;
         ValuePtr m_prevMinibatchAggregateTrainingLossValue;
         ValuePtr m_prevMinibatchAggregateEvalCriterionValue;
+
+        // single-process data parallelism: m_replicaDevices[0] is the device of the model itself, m_replicas[i] the replica on m_replicaDevices[i + 1]
+        std::vector<DeviceDescriptor> m_replicaDevices;
+        std::vector<std::shared_ptr<Replica>> m_replicas;
+        std::shared_ptr<Microsoft::MSR::CNTK::LocalNcclComm> m_localNcclComm;
     };
 
     ///
@@ -3710,6 +3827,9 @@ namespace CNTK
 
     ///
     /// Instantiate the CNTK built-in composite minibatch source.
+    /// Unless 'prefetch' is set to false in the configuration, the next minibatches are read, packed and uploaded to the device
+    /// of GetNextMinibatch in the background while the current one is processed; 'prefetchDepth' (default 1) sets how many are read ahead.
+    /// The Values returned by GetNextMinibatch are on that device, and remain valid until the next call.
     ///
     CNTK_API MinibatchSourcePtr CreateCompositeMinibatchSource(const Dictionary& configuration);
 
@@ -57,6 +57,8 @@ namespace Microsoft { namespace MSR { namespace CNTK {
 
     class ComputationNodeBase;
     typedef std::shared_ptr<ComputationNodeBase> ComputationNodeBasePtr;
+
+    class LocalNcclComm;
 }}}
 
 // TODO: The following should be reconciled with the equivalent code in the CNTK implementation
@@ -238,7 +240,18 @@ namespace CNTK
         CNTK_API void SetComputationNetworkTraceLevel(int traceLevel);
         int GetComputationNetworkTraceLevel();
 
+        // Load the models of the V1 format in this precision, converting the values of those saved in the other one while
+        // they are read, e.g. to evaluate a double model as float. DataType::Unknown (the default) loads them as saved.
+        CNTK_API void SetLegacyModelDataType(DataType dataType);
+        DataType GetLegacyModelDataType();
+
         CNTK_API void SetGPUMemoryAllocationTraceLevel(int traceLevel);
+        CNTK_API void SetGPUMemoryCaching(bool enable);
+        CNTK_API void EmptyGPUMemoryCache(const DeviceDescriptor& device);
+
+        // Returns the CUDA stream (a cudaStream_t) on which the calling thread queues the computations on the specified device,
+        // so that user-defined Functions can enqueue their kernels behind them without synchronizing the device; null for the CPU.
+        CNTK_API void* GetComputeStream(const DeviceDescriptor& device);
 
         CNTK_API void ForceSynchronousCUDAKernelExecutions();
 
@@ -249,6 +262,11 @@ namespace CNTK
 
         CNTK_API void EnableForwardValuesSharing();
         CNTK_API void EnableHyperMemoryCompress();
+        CNTK_API void SetMemorySharingPolicy(const std::wstring& policy);
+
+        // Keep the validated node dimensions of the ComputationNetworks built for Function evaluation in this directory,
+        // keyed by the network structure and input shapes, and restore them when the same network is built again.
+        CNTK_API void SetNetworkValidationCacheDirectory(const std::wstring& directory);
 
         CNTK_API void EnableGradientAccumulationOptimization();
         CNTK_API void DisableGradientAccumulationOptimization();
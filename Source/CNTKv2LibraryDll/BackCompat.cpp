@@ -78,6 +78,14 @@ namespace CNTK
             }
 
         private:
+            // The Parameter/Constant adopts the specified view over a matrix of the legacy network instead of copying it;
+            // the matrix storage is reference counted and thus outlives the legacy network discarded after the conversion.
+            static Variable ParameterOrConstantOver(const NDArrayViewPtr& value, bool isConstant, const std::wstring& name, const std::wstring& uid)
+            {
+                auto kind = isConstant ? VariableKind::Constant : VariableKind::Parameter;
+                return Variable(value->Shape(), kind, value->GetDataType(), value, /*needsGradient =*/ !isConstant, {}, name, uid);
+            }
+
             template<class ElementType>
             Variable ResolveLeaf(const ComputationNodeBasePtr& node)
             {
@@ -110,7 +118,7 @@ namespace CNTK
 
                     auto kind = isConstant ? VariableKind::Constant : VariableKind::Parameter;
                     std::tie(varUid, varName) = UidAndNameFromCNTKInternalNodeName(node->NodeName(), kind);
-                    return isConstant ? (Variable)Constant(value, varName, varUid) : Parameter(value, varName, varUid);
+                    return ParameterOrConstantOver(value, isConstant, varName, varUid);
                 }
 
                 LogicError("CNTK::LoadLegacyModel: Unsupported legacy CNTK node named '%S'", node->NodeName().c_str());
@@ -152,6 +160,14 @@ namespace CNTK
                     opType = PrimitiveOpType::Softmax;
                 else if (node->OperationName() == OperationNameOf(HardmaxNode))
                     opType = PrimitiveOpType::Hardmax;
+                else if (node->OperationName() == OperationNameOf(TopKNode))
+                {
+                    auto topKNode = node->As<TopKNode<ElementType>>();
+                    primitiveFunctionConfigParameters[PrimitiveFunction::AttributeNameTopK] = topKNode->K();
+                    primitiveFunctionConfigParameters[PrimitiveFunction::AttributeNameOutputIndices] = topKNode->OutputsIndices();
+
+                    opType = PrimitiveOpType::TopK;
+                }
                 else if (node->OperationName() == OperationNameOf(TransposeDimensionsNode))
                 {
                     auto transposeDimensionsNode = node->As<TransposeDimensionsNode<ElementType>>();
@@ -309,22 +325,27 @@ namespace CNTK
                     auto& convolutionMapVar = inputVars[0];
                     if (convolutionNode->IsConvolution2D())
                     {
-                        assert(convolutionMapVar.Shape().Rank() == 2);
-                        assert(convolutionMapVar.IsConstant() || convolutionMapVar.IsParameter());
                         auto kernelShape = AsNDShape(convolutionNode->KernelShape());
                         NDShape actualConvolutionMapShape = kernelShape.AppendShape({ convolutionMapVar.Shape()[0] });
 
-                        if (actualConvolutionMapShape.TotalSize() != convolutionMapVar.Shape().TotalSize())
-                            LogicError("The convolutionMap tensor shape's (%S) size does not match the size (%d) of the legacy 2D convolution map!", AsStringForErrorReporting(actualConvolutionMapShape).c_str(), (int)convolutionMapVar.Shape().TotalSize());
+                        // A convolution map shared with an earlier convolution node has already been reshaped
+                        if (convolutionMapVar.Shape() != actualConvolutionMapShape)
+                        {
+                            assert(convolutionMapVar.Shape().Rank() == 2);
+                            assert(convolutionMapVar.IsConstant() || convolutionMapVar.IsParameter());
+                            if (actualConvolutionMapShape.TotalSize() != convolutionMapVar.Shape().TotalSize())
+                                LogicError("The convolutionMap tensor shape's (%S) size does not match the size (%d) of the legacy 2D convolution map!", AsStringForErrorReporting(actualConvolutionMapShape).c_str(), (int)convolutionMapVar.Shape().TotalSize());
 
-                        auto oldConvolutionMapValue = convolutionMapVar.IsConstant() ? Constant(convolutionMapVar).Value() : Parameter(convolutionMapVar).Value();
-                        auto oldConvolutionMapMatrix = oldConvolutionMapValue->GetMatrix<ElementType>();
+                            auto oldConvolutionMapValue = convolutionMapVar.IsConstant() ? Constant(convolutionMapVar).Value() : Parameter(convolutionMapVar).Value();
+                            auto oldConvolutionMapMatrix = oldConvolutionMapValue->GetMatrix<ElementType>();
 
-                        auto tensorView = new TensorView<ElementType>(std::make_shared<Matrix<ElementType>>(oldConvolutionMapMatrix->AsReference()), AsTensorViewShape(actualConvolutionMapShape));
-                        auto newConvolutionMapValue = MakeSharedObject<NDArrayView>(oldConvolutionMapValue->GetDataType(), oldConvolutionMapValue->Device(), oldConvolutionMapValue->GetStorageFormat(), actualConvolutionMapShape, oldConvolutionMapValue->IsReadOnly(), tensorView);
+                            auto tensorView = new TensorView<ElementType>(std::make_shared<Matrix<ElementType>>(oldConvolutionMapMatrix->AsReference()), AsTensorViewShape(actualConvolutionMapShape));
+                            auto newConvolutionMapValue = MakeSharedObject<NDArrayView>(oldConvolutionMapValue->GetDataType(), oldConvolutionMapValue->Device(), oldConvolutionMapValue->GetStorageFormat(), actualConvolutionMapShape, oldConvolutionMapValue->IsReadOnly(), tensorView);
 
-                        // Lets replace the convolutionMapVar with a new properly reshaped Parameter/Constant
-                        convolutionMapVar = convolutionMapVar.IsConstant() ? Variable(Constant(newConvolutionMapValue, convolutionMapVar.Name(), convolutionMapVar.Uid())) : Variable(Parameter(newConvolutionMapValue, convolutionMapVar.Name(), convolutionMapVar.Uid()));
+                            // Lets replace the convolutionMapVar with a new properly reshaped Parameter/Constant over the same storage
+                            convolutionMapVar = ParameterOrConstantOver(newConvolutionMapValue, convolutionMapVar.IsConstant(), convolutionMapVar.Name(), convolutionMapVar.Uid());
+                            m_nodeToVariableMap[node->Input(0)] = convolutionMapVar;
+                        }
                     }
 
                     primitiveFunctionConfigParameters[PrimitiveFunction::AttributeNameStrides] = AsNDShape(convolutionNode->Strides());
@@ -444,20 +465,29 @@ namespace CNTK
             ComputationNetworkPtr net = make_shared<ComputationNetwork>(AsCNTKImplDeviceId(computeDevice));
             net->SetTraceLevel(Internal::GetComputationNetworkTraceLevel());
 
-            auto dataType = DetectLegacyModelDataType(modelFile);
-            switch (dataType)
+            // see SetLegacyModelDataType()
+            auto conversionDataType = GetLegacyModelDataType();
+            if (conversionDataType == DataType::Float)
+                net->Load<float>(modelFile, /*convertPrecision=*/true);
+            else if (conversionDataType == DataType::Double)
+                net->Load<double>(modelFile, /*convertPrecision=*/true);
+            else
             {
-            case LegacyModelDataType::Auto:
-                net->Load<float>(modelFile); // the actual template type will be ignored.
-                break;
-            case LegacyModelDataType::Float:
-                net->Load<float>(modelFile);
-                break;
-            case LegacyModelDataType::Double:
-                net->Load<double>(modelFile);
-                break;
-            default:
-                NOT_IMPLEMENTED;
+                auto dataType = DetectLegacyModelDataType(modelFile);
+                switch (dataType)
+                {
+                case LegacyModelDataType::Auto:
+                    net->Load<float>(modelFile); // the actual template type will be ignored.
+                    break;
+                case LegacyModelDataType::Float:
+                    net->Load<float>(modelFile);
+                    break;
+                case LegacyModelDataType::Double:
+                    net->Load<double>(modelFile);
+                    break;
+                default:
+                    NOT_IMPLEMENTED;
+                }
             }
 
             // Now traverse the model and construct the Function graph
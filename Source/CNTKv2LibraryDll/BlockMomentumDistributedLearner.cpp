@@ -0,0 +1,318 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE.md file in the project root for full license information.
+//
+
+#include "stdafx.h"
+#include "BlockMomentumDistributedLearner.h"
+#include "Utils.h"
+#include <algorithm>
+#include <cmath>
+
+namespace CNTK
+{
+    static const std::wstring s_blockStartedKey = L"blockMomentumStarted";
+    static const std::wstring s_localSamplesSinceLastSyncKey = L"localSamplesSinceLastSync";
+    static const std::wstring s_blockStartValuesKey = L"blockStartValues";
+    static const std::wstring s_blockSmoothedGradientsKey = L"blockSmoothedGradients";
+
+    DistributedLearnerPtr CreateBlockMomentumDistributedLearner(
+        DistributedCommunicatorPtr communicator,
+        LearnerPtr learner,
+        size_t distributeAfterSamples,
+        size_t blockSize,
+        bool useNestrovMomentum,
+        bool resetSGDMomentumAfterAggregation,
+        double blockLearningRate)
+    {
+        return MakeSharedObject<BlockMomentumDistributedLearner>(
+            communicator,
+            learner,
+            distributeAfterSamples,
+            blockSize,
+            useNestrovMomentum,
+            resetSGDMomentumAfterAggregation,
+            blockLearningRate);
+    }
+
+    DistributedLearnerPtr CreateBlockMomentumDistributedLearner(
+        DistributedCommunicatorPtr communicator,
+        LearnerPtr learner,
+        size_t distributeAfterSamples,
+        size_t blockSize,
+        double blockMomentumAsTimeConstant,
+        bool useNestrovMomentum,
+        bool resetSGDMomentumAfterAggregation,
+        double blockLearningRate)
+    {
+        return MakeSharedObject<BlockMomentumDistributedLearner>(
+            communicator,
+            learner,
+            distributeAfterSamples,
+            blockSize,
+            useNestrovMomentum,
+            resetSGDMomentumAfterAggregation,
+            blockLearningRate,
+            blockMomentumAsTimeConstant);
+    }
+
+    /*static*/ double BlockMomentumDistributedLearner::TimeConstant2Momentum(double timeConstant, size_t blockSize)
+    {
+        if (timeConstant == 0)
+            return 0;
+        return exp(-((double)blockSize) / timeConstant);
+    }
+
+    /*static*/ double BlockMomentumDistributedLearner::Momentum2TimeConstant(double blockMomentum, size_t blockSize)
+    {
+        if (blockMomentum < 0 || blockMomentum >= 1)
+            InvalidArgument("Block momentum must be in [0, 1), got %f.", blockMomentum);
+        if (blockMomentum == 0)
+            return 0;
+        return -((double)blockSize) / log(blockMomentum);
+    }
+
+    BlockMomentumDistributedLearner::BlockMomentumDistributedLearner(
+        DistributedCommunicatorPtr communicator,
+        LearnerPtr learner,
+        size_t distributeAfterSamples,
+        size_t blockSize,
+        bool useNesterovMomentum,
+        bool resetSGDMomentumAfterAggregation,
+        double blockLearningRate)
+        : BlockMomentumDistributedLearner(
+            communicator,
+            learner,
+            distributeAfterSamples,
+            blockSize,
+            useNesterovMomentum,
+            resetSGDMomentumAfterAggregation,
+            blockLearningRate,
+            communicator ? Momentum2TimeConstant(1.0 - 1.0 / communicator->Workers().size(), blockSize) : 0.0)
+    {
+    }
+
+    BlockMomentumDistributedLearner::BlockMomentumDistributedLearner(
+        DistributedCommunicatorPtr communicator,
+        LearnerPtr learner,
+        size_t distributeAfterSamples,
+        size_t blockSize,
+        bool useNesterovMomentum,
+        bool resetSGDMomentumAfterAggregation,
+        double blockLearningRate,
+        double blockMomentumAsTimeConstant)
+        : DistributedLearnerBase(communicator, learner, distributeAfterSamples),
+          m_syncPeriodPerWorker(std::max<size_t>(blockSize / communicator->Workers().size(), 1)),
+          m_useNesterovMomentum(useNesterovMomentum),
+          m_resetSGDMomentumAfterAggregation(resetSGDMomentumAfterAggregation),
+          m_blockLearningRate(blockLearningRate),
+          m_blockMomentum(TimeConstant2Momentum(blockMomentumAsTimeConstant, blockSize)),
+          m_isFirstBlockStarted(false),
+          m_localSamplesSinceLastSync(0)
+    {
+        if (blockSize == 0)
+            InvalidArgument("The block size of the block momentum distributed learner must be positive.");
+        if (blockMomentumAsTimeConstant < 0)
+            InvalidArgument("The block momentum time constant must not be negative, got %f.", blockMomentumAsTimeConstant);
+
+        size_t numberOfWorkers = m_communicator->Workers().size();
+        if ((1 - m_blockMomentum) * m_blockLearningRate * numberOfWorkers >= 2.0)
+            fprintf(stderr, "WARNING: (1-blockMomentumPerSync)*blockLearningRate is larger than 2*numWorkers; it is possible to overshoot.\n");
+        if (m_blockMomentum == 0.0)
+            fprintf(stderr, "WARNING: blockMomentum equals to zero. \n");
+
+        // all workers exchange the models in this order
+        m_parametersInSyncOrder = Parameters();
+        std::sort(m_parametersInSyncOrder.begin(), m_parametersInSyncOrder.end(),
+            [](const Parameter& a, const Parameter& b) { return a.Uid() < b.Uid(); });
+
+        for (const auto& parameter : m_parametersInSyncOrder)
+        {
+            const auto& value = parameter.Value();
+            m_blockStartValues.push_back(MakeSharedObject<NDArrayView>(0, value->GetDataType(), value->Shape(), value->Device()));
+            m_blockSmoothedGradients.push_back(MakeSharedObject<NDArrayView>(0, value->GetDataType(), value->Shape(), value->Device()));
+            m_aggregatedValues.push_back(MakeSharedObject<NDArrayView>(0, value->GetDataType(), value->Shape(), value->Device()));
+        }
+    }
+
+    bool BlockMomentumDistributedLearner::Update(std::unordered_map<Parameter, NDArrayViewPtr>& gradientValues, MinibatchInfo& info)
+    {
+        if (m_sampleCount < m_distributeAfterSamples)
+        {
+            m_sampleCount += info.numberOfSamples;
+            if (info.IsEmpty())
+                return false;
+
+            return m_learner->Update(gradientValues, info.numberOfSamples);
+        }
+
+        if (!m_isFirstBlockStarted)
+            StartFirstBlock();
+
+        // a worker without data meets the others at their next synchronization
+        if (info.IsEmpty())
+            return SynchronizeModel() > 0;
+
+        bool updated = m_learner->Update(gradientValues, info.numberOfSamples);
+        m_sampleCount += info.numberOfSamples;
+        m_localSamplesSinceLastSync += info.numberOfSamples;
+
+        if (m_localSamplesSinceLastSync >= m_syncPeriodPerWorker)
+            SynchronizeModel();
+
+        return updated;
+    }
+
+    size_t BlockMomentumDistributedLearner::SynchronizeModel()
+    {
+        // a worker that processed no samples since the last synchronization, e.g. at the end of its data, does not hold the others back
+        for (size_t i = 0; i < m_parametersInSyncOrder.size(); ++i)
+        {
+            switch (m_parametersInSyncOrder[i].GetDataType())
+            {
+            case DataType::Float:
+                ScaleParameterValue<float>(i, (double)m_localSamplesSinceLastSync, m_aggregatedValues[i]);
+                break;
+            case DataType::Double:
+                ScaleParameterValue<double>(i, (double)m_localSamplesSinceLastSync, m_aggregatedValues[i]);
+                break;
+            default:
+                LogicError("Unsupported DataType %s", DataTypeName(m_parametersInSyncOrder[i].GetDataType()));
+            }
+        }
+
+        auto numberOfSamples = MakeSharedObject<NDArrayView>(static_cast<double>(m_localSamplesSinceLastSync), NDShape{ 1 }, DeviceDescriptor::CPUDevice());
+        std::vector<NDArrayViewPtr> valuesToAggregate(m_aggregatedValues);
+        valuesToAggregate.push_back(numberOfSamples);
+        m_communicator->AggregateInPlace(valuesToAggregate, m_communicator->Workers());
+
+        auto totalNumberOfSamples = static_cast<size_t>(*numberOfSamples->WritableDataBuffer<double>());
+        m_sampleCount += totalNumberOfSamples - m_localSamplesSinceLastSync;
+        m_localSamplesSinceLastSync = 0;
+
+        // the models have not changed
+        if (totalNumberOfSamples == 0)
+            return 0;
+
+        for (size_t i = 0; i < m_parametersInSyncOrder.size(); ++i)
+        {
+            if (m_parametersInSyncOrder[i].GetDataType() == DataType::Float)
+                ApplyBlockMomentum<float>(i, (double)totalNumberOfSamples);
+            else
+                ApplyBlockMomentum<double>(i, (double)totalNumberOfSamples);
+        }
+
+        if (m_resetSGDMomentumAfterAggregation)
+            m_learner->ResetSmoothedGradients();
+
+        return totalNumberOfSamples;
+    }
+
+    void BlockMomentumDistributedLearner::StartFirstBlock()
+    {
+        // the workers normally start alike, this makes sure of it
+        for (size_t i = 0; i < m_parametersInSyncOrder.size(); ++i)
+            m_aggregatedValues[i]->CopyFrom(*m_parametersInSyncOrder[i].Value());
+        m_communicator->AggregateInPlace(m_aggregatedValues, m_communicator->Workers());
+
+        double numberOfWorkers = (double)m_communicator->Workers().size();
+        for (size_t i = 0; i < m_parametersInSyncOrder.size(); ++i)
+        {
+            const auto& value = m_parametersInSyncOrder[i].Value();
+            if (value->GetDataType() == DataType::Float)
+                Microsoft::MSR::CNTK::Matrix<float>::Scale(float(1 / numberOfWorkers), *m_aggregatedValues[i]->GetMatrix<float>(), *value->GetWritableMatrix<float>());
+            else
+                Microsoft::MSR::CNTK::Matrix<double>::Scale(1 / numberOfWorkers, *m_aggregatedValues[i]->GetMatrix<double>(), *value->GetWritableMatrix<double>());
+
+            auto parameter = m_parametersInSyncOrder[i];
+            parameter.RecordValueUpdate();
+            m_blockStartValues[i]->CopyFrom(*value);
+            m_blockSmoothedGradients[i]->SetValue(0.0);
+        }
+
+        m_localSamplesSinceLastSync = 0;
+        m_isFirstBlockStarted = true;
+    }
+
+    template <typename ElementType>
+    void BlockMomentumDistributedLearner::ScaleParameterValue(size_t i, double scale, const NDArrayViewPtr& result)
+    {
+        const auto& value = m_parametersInSyncOrder[i].Value();
+        Microsoft::MSR::CNTK::Matrix<ElementType>::Scale(ElementType(scale), *value->GetMatrix<ElementType>(), *result->GetWritableMatrix<ElementType>());
+    }
+
+    template <typename ElementType>
+    void BlockMomentumDistributedLearner::ApplyBlockMomentum(size_t i, double totalNumberOfSamples)
+    {
+        typedef Microsoft::MSR::CNTK::Matrix<ElementType> Matrix;
+
+        auto value = m_parametersInSyncOrder[i].Value()->GetWritableMatrix<ElementType>();
+        auto blockStartValue = m_blockStartValues[i]->GetWritableMatrix<ElementType>();
+        auto blockSmoothedGradient = m_blockSmoothedGradients[i]->GetWritableMatrix<ElementType>();
+        auto average = m_aggregatedValues[i]->GetWritableMatrix<ElementType>();
+
+        // the average of the models, less W(t-1), is -G(t)
+        Matrix::Scale(ElementType(1.0 / totalNumberOfSamples), *average);
+        Matrix::ScaleAndAdd(ElementType(-1), *blockStartValue, *average);
+
+        // D(t) = blockMomentum * D(t-1) + blockLearningRate * G(t)
+        Matrix::ScaleAndAdd(ElementType(-m_blockLearningRate), *average, ElementType(m_blockMomentum), *blockSmoothedGradient);
+
+        // W(t) = W(t-1) - D(t)
+        Matrix::ScaleAndAdd(ElementType(-1), *blockSmoothedGradient, *blockStartValue);
+
+        value->SetValue(*blockStartValue);
+        if (m_useNesterovMomentum)
+            Matrix::ScaleAndAdd(ElementType(-m_blockMomentum), *blockSmoothedGradient, *value);
+
+        auto parameter = m_parametersInSyncOrder[i];
+        parameter.RecordValueUpdate();
+    }
+
+    Dictionary BlockMomentumDistributedLearner::CreateCheckpoint()
+    {
+        auto result = DistributedLearnerBase::CreateCheckpoint();
+        result[s_blockStartedKey] = m_isFirstBlockStarted;
+        result[s_localSamplesSinceLastSyncKey] = m_localSamplesSinceLastSync;
+
+        Dictionary blockStartValues, blockSmoothedGradients;
+        for (size_t i = 0; i < m_parametersInSyncOrder.size(); ++i)
+        {
+            blockStartValues[m_parametersInSyncOrder[i].Uid()] = *m_blockStartValues[i];
+            blockSmoothedGradients[m_parametersInSyncOrder[i].Uid()] = *m_blockSmoothedGradients[i];
+        }
+        result[s_blockStartValuesKey] = blockStartValues;
+        result[s_blockSmoothedGradientsKey] = blockSmoothedGradients;
+        return result;
+    }
+
+    void BlockMomentumDistributedLearner::RestoreFromCheckpoint(const Dictionary& checkpoint)
+    {
+        DistributedLearnerBase::RestoreFromCheckpoint(checkpoint);
+
+        // e.g. of a data parallel distributed learner, the first block starts from the restored model
+        m_isFirstBlockStarted = checkpoint.Contains(s_blockStartedKey) && checkpoint[s_blockStartedKey].Value<bool>();
+        m_localSamplesSinceLastSync = 0;
+        if (!m_isFirstBlockStarted)
+            return;
+
+        m_localSamplesSinceLastSync = checkpoint[s_localSamplesSinceLastSyncKey].Value<size_t>();
+        const auto& blockStartValues = checkpoint[s_blockStartValuesKey].Value<Dictionary>();
+        const auto& blockSmoothedGradients = checkpoint[s_blockSmoothedGradientsKey].Value<Dictionary>();
+        for (size_t i = 0; i < m_parametersInSyncOrder.size(); ++i)
+        {
+            const auto& uid = m_parametersInSyncOrder[i].Uid();
+            if (!blockStartValues.Contains(uid) || !blockSmoothedGradients.Contains(uid))
+                LogicError("Checkpoint does not contain the block momentum state for parameter %ls", uid.c_str());
+
+            const auto& blockStartValue = blockStartValues[uid].Value<NDArrayView>();
+            const auto& blockSmoothedGradient = blockSmoothedGradients[uid].Value<NDArrayView>();
+            if (blockStartValue.Shape() != m_blockStartValues[i]->Shape() || blockStartValue.GetDataType() != m_blockStartValues[i]->GetDataType() ||
+                blockSmoothedGradient.Shape() != m_blockSmoothedGradients[i]->Shape() || blockSmoothedGradient.GetDataType() != m_blockSmoothedGradients[i]->GetDataType())
+                LogicError("The block momentum state restored from a checkpoint for parameter %ls does not match the parameter", uid.c_str());
+
+            m_blockStartValues[i]->CopyFrom(blockStartValue);
+            m_blockSmoothedGradients[i]->CopyFrom(blockSmoothedGradient);
+        }
+    }
+}
@@ -0,0 +1,92 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE.md file in the project root for full license information.
+//
+
+#pragma  once
+
+#include "CNTKLibrary.h"
+#include "DistributedLearnerBase.h"
+
+namespace CNTK
+{
+    ///
+    /// Block momentum distributed learner (blockwise model update and filtering, BMUF), as BlockMomentumSGD of the V1 SGD.
+    ///
+    /// Each worker updates its model with its local learner, without communication, until the workers have processed about
+    /// 'blockSize' samples since the last synchronization (blockSize / number of workers each). Then the models are averaged,
+    /// weighted by the samples each worker processed since, and the change of the averaged model over the block is filtered
+    /// with block momentum:
+    ///     G(t) = W(t-1) - average of the models
+    ///     D(t) = blockMomentum * D(t-1) + blockLearningRate * G(t)
+    ///     W(t) = W(t-1) - D(t)
+    /// and every worker continues from W(t) - blockMomentum * D(t) with Nesterov momentum, from W(t) otherwise.
+    /// A block momentum of 0 with a block learning rate of 1 is model averaging.
+    ///
+    /// A worker whose minibatch is empty (at the end of its data) goes to the synchronization right away, so that it meets the
+    /// others; Update() returns false once no worker processed any samples since the last synchronization.
+    /// Before 'distributeAfterSamples' the workers are expected to process the same data, and only update their models locally.
+    ///
+    class BlockMomentumDistributedLearner : public DistributedLearnerBase
+    {
+    public:
+        BlockMomentumDistributedLearner(
+            DistributedCommunicatorPtr communicator,
+            LearnerPtr learner,
+            size_t distributeAfterSamples,
+            size_t blockSize,
+            bool useNesterovMomentum,
+            bool resetSGDMomentumAfterAggregation,
+            double blockLearningRate,
+            double blockMomentumAsTimeConstant);
+
+        // the equivalent of V1 BlockMomentumSGD's default: block momentum 1 - 1 / number of workers, so that each block contributes equally
+        BlockMomentumDistributedLearner(
+            DistributedCommunicatorPtr communicator,
+            LearnerPtr learner,
+            size_t distributeAfterSamples,
+            size_t blockSize,
+            bool useNesterovMomentum,
+            bool resetSGDMomentumAfterAggregation,
+            double blockLearningRate);
+
+        bool Update(std::unordered_map<Parameter, NDArrayViewPtr>& gradientValues, MinibatchInfo& info) override;
+
+        Dictionary CreateCheckpoint() override;
+
+        void RestoreFromCheckpoint(const Dictionary& checkpoint) override;
+
+        // conversions between the block momentum per synchronization of blockSize samples and its time constant (in samples)
+        static double TimeConstant2Momentum(double timeConstant, size_t blockSize);
+        static double Momentum2TimeConstant(double blockMomentum, size_t blockSize);
+
+    private:
+        // Averages the models of the workers, weighted by their samples since the last synchronization, and applies block momentum.
+        // Returns the number of samples all workers processed since the last synchronization.
+        size_t SynchronizeModel();
+
+        // Starts the first block from the average of the models.
+        void StartFirstBlock();
+
+        // Sets 'result' to 'scale' times the value of m_parametersInSyncOrder[i].
+        template <typename ElementType>
+        void ScaleParameterValue(size_t i, double scale, const NDArrayViewPtr& result);
+
+        template <typename ElementType>
+        void ApplyBlockMomentum(size_t i, double totalNumberOfSamples);
+
+        std::vector<Parameter> m_parametersInSyncOrder; // the same on all workers
+        std::vector<NDArrayViewPtr> m_blockStartValues;         // [i] W(t-1) of m_parametersInSyncOrder[i]
+        std::vector<NDArrayViewPtr> m_blockSmoothedGradients;   // [i] D(t-1)
+        std::vector<NDArrayViewPtr> m_aggregatedValues;         // [i] buffer for the average of the models
+
+        const size_t m_syncPeriodPerWorker;
+        const bool m_useNesterovMomentum;
+        const bool m_resetSGDMomentumAfterAggregation;
+        const double m_blockLearningRate;
+        const double m_blockMomentum;
+
+        bool m_isFirstBlockStarted;
+        size_t m_localSamplesSinceLastSync;
+    };
+}
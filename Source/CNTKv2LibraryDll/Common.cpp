@@ -70,6 +70,16 @@ namespace CNTK
             Microsoft::MSR::CNTK::Globals::EnableHyperCompressMemory();
         }
 
+        void SetMemorySharingPolicy(const std::wstring& policy)
+        {
+            Microsoft::MSR::CNTK::Globals::SetMemorySharingPolicy(policy);
+        }
+
+        void SetNetworkValidationCacheDirectory(const std::wstring& directory)
+        {
+            Microsoft::MSR::CNTK::Globals::SetValidationCacheDirectory(directory);
+        }
+
         void EnableGradientAccumulationOptimization()
         {
             Microsoft::MSR::CNTK::Globals::EnableGradientAccumulationOptimization();
@@ -337,11 +347,43 @@ namespace CNTK
             return s_computationNetworkTraceLevel.load();
         }
 
+        std::atomic<DataType> s_legacyModelDataType(DataType::Unknown);
+        void SetLegacyModelDataType(DataType dataType)
+        {
+            if (dataType != DataType::Unknown && dataType != DataType::Float && dataType != DataType::Double)
+                InvalidArgument("SetLegacyModelDataType: Only float and double are supported.");
+            s_legacyModelDataType.store(dataType);
+        }
+
+        DataType GetLegacyModelDataType()
+        {
+            return s_legacyModelDataType.load();
+        }
+
         void SetGPUMemoryAllocationTraceLevel(int traceLevel)
         {
             Microsoft::MSR::CNTK::TracingGPUMemoryAllocator::SetTraceLevel(traceLevel);
         }
 
+        void SetGPUMemoryCaching(bool enable)
+        {
+            Microsoft::MSR::CNTK::TracingGPUMemoryAllocator::SetCachingEnabled(enable);
+        }
+
+        void EmptyGPUMemoryCache(const DeviceDescriptor& device)
+        {
+            if (device.Type() == DeviceKind::GPU)
+                Microsoft::MSR::CNTK::TracingGPUMemoryAllocator::EmptyCache(device.Id());
+        }
+
+        void* GetComputeStream(const DeviceDescriptor& device)
+        {
+            if (device.Type() != DeviceKind::GPU)
+                return nullptr;
+
+            return ::GetStream();
+        }
+
         void ForceSynchronousCUDAKernelExecutions()
         {
             Microsoft::MSR::CNTK::SyncGuard::EnableSync();
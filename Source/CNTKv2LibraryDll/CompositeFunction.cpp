@@ -382,22 +382,25 @@ namespace CNTK
         if (variable.IsParameter() || variable.IsConstant())
         {
             auto internalNodeName = CNTKInternalNodeNameFromUidAndName(variable.Uid(), variable.Name());
-            computationNodePtr = builder.CreateLearnableParameter(internalNodeName, AsTensorShape(variable.Shape()));
-            network->InitLearnableParameters(computationNodePtr, L"fixedValue", 0); // must call this to follow protocol; can overwrite later
-            if (!variable.NeedsGradient())
-                computationNodePtr->SetLearningRateMultiplier(0.0);
-
             NDArrayViewPtr value = variable.IsConstant() ? Constant(variable).Value() : Parameter(variable).Value();
             std::shared_ptr<const Matrix<ElementType>> valueMatrix = variable.IsConstant() ? value->GetMatrix<ElementType>() : value->GetWritableMatrix<ElementType>();
 
+            // The node refers to the storage of the Parameter/Constant itself, so that all the networks of Functions sharing it
+            // (e.g. clones with ParameterCloningMethod::Share) use the same matrix on the device, and nothing is allocated per network
             if (variable.IsParameter() || (valueMatrix->GetDeviceId() == network->GetDeviceId()))
-                computationNodePtr->Value() = valueMatrix->AsReference();
+                computationNodePtr = builder.CreateLearnableParameter(internalNodeName, AsTensorShape(variable.Shape()), *valueMatrix);
             else
             {
+                computationNodePtr = builder.CreateLearnableParameter(internalNodeName, AsTensorShape(variable.Shape()));
+                network->InitLearnableParameters(computationNodePtr, L"fixedValue", 0); // must call this to follow protocol; can overwrite later
+
                 Matrix<ElementType> clonedMatrix(valueMatrix->GetNumRows(), valueMatrix->GetNumCols(), network->GetDeviceId(), valueMatrix->GetMatrixType(), valueMatrix->GetFormat());
                 clonedMatrix.AssignValuesOf(*valueMatrix);
                 computationNodePtr->Value() = std::move(clonedMatrix);
             }
+
+            if (!variable.NeedsGradient())
+                computationNodePtr->SetLearningRateMultiplier(0.0);
         }
         else if (variable.IsInput())
         {
@@ -739,6 +742,13 @@ namespace CNTK
             case PrimitiveOpType::Pass:
                 computationNodePtr = New<PassNode<ElementType>>(network->GetDeviceId(), internalNodeName);
                 break;
+            case PrimitiveOpType::TopK:
+            {
+                auto k = functionConfig[PrimitiveFunction::AttributeNameTopK].Value<size_t>();
+                auto outputIndices = functionConfig[PrimitiveFunction::AttributeNameOutputIndices].Value<bool>();
+                computationNodePtr = New<TopKNode<ElementType>>(network->GetDeviceId(), internalNodeName, k, outputIndices);
+                break;
+            }
             default:
                 LogicError("Specified op %S not yet supported", PrimitiveOpTypeName(op).c_str());
                 break;
@@ -993,14 +1003,14 @@ namespace CNTK
     }
 
     template <typename ElementType>
-    /*static*/ void CompositeFunction::PopulateComputationNodeValue(const std::pair<Variable, ValuePtr>& variableValue, ComputationNodeBasePtr& computationNode)
+    /*static*/ void CompositeFunction::PopulateComputationNodeValue(const std::pair<Variable, ValuePtr>& variableValue, ComputationNodeBasePtr& computationNode, ValueConversionCache* cache /*= nullptr*/)
     {
         std::pair<std::shared_ptr<const Matrix<ElementType>>, MBLayoutPtr> CNTKMatrixAndMBLayout;
         auto packedValue = dynamic_cast<PackedValue*>(variableValue.second.get());
         if (packedValue)
             CNTKMatrixAndMBLayout = packedValue->PackedData<ElementType>();
         else
-            CNTKMatrixAndMBLayout = Utils::GetCNTKImplMatrixAndMBLayoutFromValueObject<ElementType>(variableValue.first, variableValue.second);
+            CNTKMatrixAndMBLayout = Utils::GetCNTKImplMatrixAndMBLayoutFromValueObject<ElementType>(variableValue.first, variableValue.second, cache);
 
         MBLayoutPtr layout = CNTKMatrixAndMBLayout.second;
 
@@ -1008,7 +1018,11 @@ namespace CNTK
 
         // Switch the node matrix to the right matrix type
         nodeData.AssignValuesOf(*CNTKMatrixAndMBLayout.first);
-        computationNode->GetMBLayout()->CopyFrom(layout);
+
+        // An unchanged layout is not copied, which keeps what the node's layout has cached, e.g. its column masks on the device
+        auto nodeLayout = computationNode->GetMBLayout();
+        if ((layout == nullptr) || (*nodeLayout != *layout))
+            nodeLayout->CopyFrom(layout);
     }
 
     void CompositeFunction::PopulateNetworkInputs(const std::unordered_map<Variable, ValuePtr>& arguments)
@@ -1027,10 +1041,10 @@ namespace CNTK
             switch (argumentValue->GetDataType())
             {
             case DataType::Float:
-                PopulateComputationNodeValue<float>({ argument, argumentValue }, argumentComputationNode);
+                PopulateComputationNodeValue<float>({ argument, argumentValue }, argumentComputationNode, &m_argumentValueConversions[argument]);
                 break;
             case DataType::Double:
-                PopulateComputationNodeValue<double>({ argument, argumentValue }, argumentComputationNode);
+                PopulateComputationNodeValue<double>({ argument, argumentValue }, argumentComputationNode, &m_argumentValueConversions[argument]);
                 break;
             default:
                 LogicError("Unsupported DataType %s", DataTypeName(argumentValue->GetDataType()));
@@ -1042,14 +1056,14 @@ namespace CNTK
     }
 
     template <typename ElementType>
-    /*static*/ void CompositeFunction::PopulateComputationNodeGradient(const std::pair<Variable, ValuePtr>& variableGradient, Microsoft::MSR::CNTK::ComputationNodeBasePtr& computationNode)
+    /*static*/ void CompositeFunction::PopulateComputationNodeGradient(const std::pair<Variable, ValuePtr>& variableGradient, Microsoft::MSR::CNTK::ComputationNodeBasePtr& computationNode, ValueConversionCache* cache /*= nullptr*/)
     {
         std::pair<std::shared_ptr<const Matrix<ElementType>>, MBLayoutPtr> CNTKMatrixAndMBLayout;
         auto packedValue = dynamic_cast<PackedValue*>(variableGradient.second.get());
         if (packedValue)
             CNTKMatrixAndMBLayout = packedValue->PackedData<ElementType>();
         else
-            CNTKMatrixAndMBLayout = Utils::GetCNTKImplMatrixAndMBLayoutFromValueObject<ElementType>(variableGradient.first, variableGradient.second);
+            CNTKMatrixAndMBLayout = Utils::GetCNTKImplMatrixAndMBLayoutFromValueObject<ElementType>(variableGradient.first, variableGradient.second, cache);
 
         MBLayoutPtr layout = CNTKMatrixAndMBLayout.second;
         auto nodeLayout = computationNode->GetMBLayout();
@@ -1070,10 +1084,10 @@ namespace CNTK
             switch (gradientValue->GetDataType())
             {
             case DataType::Float:
-                PopulateComputationNodeGradient<float>(gradientVarValuePair, outputComputationNode);
+                PopulateComputationNodeGradient<float>(gradientVarValuePair, outputComputationNode, &m_rootGradientValueConversions[gradientVarValuePair.first]);
                 break;
             case DataType::Double:
-                PopulateComputationNodeGradient<double>(gradientVarValuePair, outputComputationNode);
+                PopulateComputationNodeGradient<double>(gradientVarValuePair, outputComputationNode, &m_rootGradientValueConversions[gradientVarValuePair.first]);
                 break;
             default:
                 LogicError("Unsupported DataType %s", DataTypeName(gradientValue->GetDataType()));
@@ -1103,7 +1117,7 @@ namespace CNTK
         return NDShape(outputShapeDims);
     }
 
-    /*static*/ void CompositeFunction::GetNodeOutputOrGradient(Variable var, ValuePtr& varValue, Microsoft::MSR::CNTK::ComputationNodeBasePtr& computationNode, bool getGradient)
+    /*static*/ void CompositeFunction::GetNodeOutputOrGradient(Variable var, ValuePtr& varValue, Microsoft::MSR::CNTK::ComputationNodeBasePtr& computationNode, bool getGradient, ValueConversionCache* cache /*= nullptr*/)
     {
         auto valueShape = GetValueShape(var, computationNode);
         if (varValue != nullptr)
@@ -1123,7 +1137,7 @@ namespace CNTK
             if (varValue == nullptr)
                 nodeValue = MakeSharedObject<PackedValue>(var.Shape(), std::make_shared<Matrix<float>>(matrix.AsReference()), layout, /*readOnly =*/ false);
             else
-                nodeValue = Utils::GetValueObjectFromCNTKImplMatrixAndMBLayout<float>(var, matrix, layout);
+                nodeValue = Utils::GetValueObjectFromCNTKImplMatrixAndMBLayout<float>(var, matrix, layout, /*readOnly =*/ true, cache);
             break;
         }
         case DataType::Double:
@@ -1132,7 +1146,7 @@ namespace CNTK
             if (varValue == nullptr)
                 nodeValue = MakeSharedObject<PackedValue>(var.Shape(), std::make_shared<Matrix<double>>(matrix.AsReference()), layout, /*readOnly =*/ false);
             else
-                nodeValue = Utils::GetValueObjectFromCNTKImplMatrixAndMBLayout<double>(var, matrix, layout);
+                nodeValue = Utils::GetValueObjectFromCNTKImplMatrixAndMBLayout<double>(var, matrix, layout, /*readOnly =*/ true, cache);
             break;
         }
         default:
@@ -1150,7 +1164,7 @@ namespace CNTK
     {
         // Now copy the Forward values of output nodes from the network to outputs' Value objects
         for (auto outputVarValuePair : outputs)
-            GetNodeOutputOrGradient(outputVarValuePair.first, outputs[outputVarValuePair.first], m_variableToNodeMap[outputVarValuePair.first], false /*getGradient*/);
+            GetNodeOutputOrGradient(outputVarValuePair.first, outputs[outputVarValuePair.first], m_variableToNodeMap[outputVarValuePair.first], false /*getGradient*/, &m_outputValueConversions[outputVarValuePair.first]);
     }
 
     void CompositeFunction::GetNetworkGradients(std::unordered_map<Variable, ValuePtr>& gradients)
@@ -1172,7 +1186,7 @@ namespace CNTK
             if (!computationNodePtr->NeedsGradient())
                 LogicError("Backpropagated gradient value cannot be read from a ComputationNode that has NeedsGradient set to false");
 
-            GetNodeOutputOrGradient(gradientVarValuePair.first, gradients[gradientVarValuePair.first], computationNodePtr, true /*getGradient*/);
+            GetNodeOutputOrGradient(gradientVarValuePair.first, gradients[gradientVarValuePair.first], computationNodePtr, true /*getGradient*/, &m_gradientValueConversions[gradientVarValuePair.first]);
         }
     }
 
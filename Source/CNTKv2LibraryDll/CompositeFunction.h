@@ -197,14 +197,14 @@ namespace CNTK
                                                                     std::unordered_map<Variable, bool>& isVariableRootMap);
 
         template <typename ElementType>
-        static void PopulateComputationNodeValue(const std::pair<Variable, ValuePtr>& variableValue, Microsoft::MSR::CNTK::ComputationNodeBasePtr& computationNode);
+        static void PopulateComputationNodeValue(const std::pair<Variable, ValuePtr>& variableValue, Microsoft::MSR::CNTK::ComputationNodeBasePtr& computationNode, ValueConversionCache* cache = nullptr);
         void PopulateNetworkInputs(const std::unordered_map<Variable, ValuePtr>& arguments);
 
         template <typename ElementType>
-        static void PopulateComputationNodeGradient(const std::pair<Variable, ValuePtr>& variableGradient, Microsoft::MSR::CNTK::ComputationNodeBasePtr& computationNode);
+        static void PopulateComputationNodeGradient(const std::pair<Variable, ValuePtr>& variableGradient, Microsoft::MSR::CNTK::ComputationNodeBasePtr& computationNode, ValueConversionCache* cache = nullptr);
         void PopulateNetworkGradients(const std::unordered_map<Variable, ValuePtr>& gradients);
 
-        static void GetNodeOutputOrGradient(Variable var, ValuePtr& varValue, Microsoft::MSR::CNTK::ComputationNodeBasePtr& computationNode, bool getGradient);
+        static void GetNodeOutputOrGradient(Variable var, ValuePtr& varValue, Microsoft::MSR::CNTK::ComputationNodeBasePtr& computationNode, bool getGradient, ValueConversionCache* cache = nullptr);
         void GetNetworkOutputs(std::unordered_map<Variable, ValuePtr>& outputs);
         void GetNetworkGradients(std::unordered_map<Variable, ValuePtr>& gradients);
 
@@ -224,6 +224,13 @@ namespace CNTK
         // A map that tells whether a Variable in the graph underlying 'this' Function is a root of the graph
         std::unordered_map<Variable, bool> m_isVariableRootMap;
 
+        // The last conversions of the argument and root gradient Values passed to, and the output and gradient Values returned from
+        // the Forward and Backward calls, which the next calls reuse when the masks and layouts do not change
+        std::unordered_map<Variable, ValueConversionCache> m_argumentValueConversions;
+        std::unordered_map<Variable, ValueConversionCache> m_rootGradientValueConversions;
+        std::unordered_map<Variable, ValueConversionCache> m_outputValueConversions;
+        std::unordered_map<Variable, ValueConversionCache> m_gradientValueConversions;
+
         Microsoft::MSR::CNTK::ComputationNetworkPtr m_computationNetwork;
 
         // The backpropRoots sepecified in the most recent 'Forward' call on 'this' Function.
@@ -7,11 +7,11 @@
 #include "DataParallelDistributedLearner.h"
 #include "DistributedCommunicator.h"
 #include "Learner.h"
+#include <functional>
 
 #ifdef CNTK_PARALLEL_TRAINING_SUPPORT
 #include "QuantizedDistributedCommunicator.h"
 #include "QuantizedDataParallelDistributedLearner.h"
-#include "BlockMomentumDistributedLearner.h"
 #endif
 
 namespace CNTK
@@ -31,46 +31,6 @@ namespace CNTK
         return MakeSharedObject<QuantizedDataParallelDistributedLearner>(communicator, learner, distributeAfterSamples, useAsyncBufferedParameterUpdate);
     }
 
-    DistributedLearnerPtr CreateBlockMomentumDistributedLearner(
-        DistributedCommunicatorPtr communicator,
-        LearnerPtr learner,
-        size_t distributeAfterSamples,
-        size_t blockSize,
-        bool useNestrovMomentum,
-        bool resetSGDMomentumAfterAggregation,
-        double blockLearningRate)
-    {
-        return MakeSharedObject<BlockMomentumDistributedLearner>(
-            communicator,
-            learner,
-            distributeAfterSamples,
-            blockSize,
-            useNestrovMomentum,
-            resetSGDMomentumAfterAggregation,
-            blockLearningRate);
-    }
-
-    DistributedLearnerPtr CreateBlockMomentumDistributedLearner(
-        DistributedCommunicatorPtr communicator,
-        LearnerPtr learner,
-        size_t distributeAfterSamples,
-        size_t blockSize,
-        double blockMomentumAsTimeConstant,
-        bool useNestrovMomentum,
-        bool resetSGDMomentumAfterAggregation,
-        double blockLearningRate)
-    {
-        return MakeSharedObject<BlockMomentumDistributedLearner>(
-            communicator,
-            learner,
-            distributeAfterSamples,
-            blockSize,
-            useNestrovMomentum,
-            resetSGDMomentumAfterAggregation,
-            blockLearningRate,
-            blockMomentumAsTimeConstant);
-    }
-
 #else
     QuantizedDistributedCommunicatorPtr QuantizedMPICommunicator(bool, bool, size_t)
     {
@@ -81,31 +41,6 @@ namespace CNTK
     {
         LogicError("Quantized Distributed Trainer is not supported for this build. The 1BitSGD build is needed, see CNTK wiki for details.");
     }
-
-    DistributedLearnerPtr CreateBlockMomentumDistributedLearner(
-        DistributedCommunicatorPtr /*communicator*/,
-        LearnerPtr,
-        size_t /*distributeAfterSamples*/,
-        size_t /*blockSize*/,
-        bool /*useNestrovMomentum*/,
-        bool /*resetSGDMomentumAfterAggregation*/,
-        double /*blockLearningRate*/)
-    {
-        LogicError("Block Momentum Distributed Trainer is not supported for this build. The 1BitSGD build is needed, see CNTK wiki for details.");
-    }
-
-    DistributedLearnerPtr CreateBlockMomentumDistributedLearner(
-        DistributedCommunicatorPtr /*communicator*/,
-        LearnerPtr,
-        size_t /*distributeAfterSamples*/,
-        size_t /*blockSize*/,
-        double /*blockMomentumAsTimeConstant*/,
-        bool /*useNestrovMomentum*/,
-        bool /*resetSGDMomentumAfterAggregation*/,
-        double /*blockLearningRate*/)
-    {
-        LogicError("Block Momentum Distributed Trainer is not supported for this build. The 1BitSGD build is needed, see CNTK wiki for details.");
-    }
 #endif
 
     DistributedLearnerPtr CreateDataParallelDistributedLearner(DistributedCommunicatorPtr communicator, LearnerPtr learner, size_t distributedAfterSamples, bool useAsyncBufferedParameterUpdate)
@@ -122,6 +57,11 @@ namespace CNTK
 
     bool DataParallelDistributedLearner::Update(std::unordered_map<Parameter, NDArrayViewPtr>& gradientValues, MinibatchInfo& info)
     {
+        auto communicator = std::dynamic_pointer_cast<MPICommunicatorImpl>(m_communicator);
+        auto learner = std::dynamic_pointer_cast<LearnerBase>(m_learner);
+        if (m_sampleCount >= m_distributeAfterSamples && communicator && learner)
+            return PipelinedUpdate(*communicator, *learner, gradientValues, info);
+
         if (m_sampleCount >= m_distributeAfterSamples)
         {
             if (info.IsEmpty())
@@ -149,4 +89,36 @@ namespace CNTK
 
         return m_learner->Update(gradientValues, info.numberOfSamples);
     }
+
+    // The learner updates each parameter as soon as its gradient is aggregated, while the later ones are still in flight.
+    // The number of samples the learning rate depends on is aggregated first, with the criterion and the loss.
+    bool DataParallelDistributedLearner::PipelinedUpdate(MPICommunicatorImpl& communicator, LearnerBase& learner,
+                                                         std::unordered_map<Parameter, NDArrayViewPtr>& gradientValues, MinibatchInfo& info)
+    {
+        if (info.IsEmpty())
+            PrepaireZeroGradients(gradientValues, info);
+
+        auto value = MakeSharedObject<NDArrayView>(static_cast<double>(info.numberOfSamples), NDShape{ 1 }, DeviceDescriptor::CPUDevice());
+        communicator.AggregateInPlace({ info.evalCriterionValue, info.trainingLossValue, value }, communicator.Workers());
+        info.numberOfSamples = static_cast<size_t>(*value->WritableDataBuffer<double>());
+
+        // the same on all workers, so the gradients are aggregated by all of them or by none
+        m_sampleCount += info.numberOfSamples;
+        if (info.IsEmpty() || !learner.BeginUpdate(info.numberOfSamples))
+            return false;
+
+        ConvertToOrdered(gradientValues, m_gradientBuffer);
+        std::vector<NDArrayViewPtr> valuesToAggregate;
+        for (const auto& i : m_gradientBuffer)
+            valuesToAggregate.push_back(i.second);
+
+        communicator.AggregateInPlace(valuesToAggregate, communicator.Workers(), [&](size_t i)
+        {
+            learner.UpdateParameter(m_gradientBuffer[i].first, m_gradientBuffer[i].second, info.numberOfSamples);
+        });
+        m_gradientBuffer.clear();
+
+        learner.EndUpdate(info.numberOfSamples);
+        return true;
+    }
 }
@@ -10,6 +10,9 @@
 
 namespace CNTK
 {
+    class MPICommunicatorImpl;
+    class LearnerBase;
+
     ///
     /// Distributed Trainer.
     ///
@@ -20,5 +23,9 @@ namespace CNTK
 
         // Optional override that gets called per minibatch after finishing gradient computation but before updating model parameters
         bool Update(std::unordered_map<Parameter, NDArrayViewPtr>& gradientValues, MinibatchInfo& trainingSampleCount) override;
+
+    private:
+        bool PipelinedUpdate(MPICommunicatorImpl& communicator, LearnerBase& learner,
+                             std::unordered_map<Parameter, NDArrayViewPtr>& gradientValues, MinibatchInfo& info);
     };
 }
\ No newline at end of file
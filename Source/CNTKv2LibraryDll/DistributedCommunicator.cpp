@@ -12,7 +12,9 @@
 #include "CUDAPageLockedMemAllocator.h"
 #include "MatrixQuantizerImpl.h"
 #include "GPUDataTransferer.h"
+#include "NcclComm.h"
 #include <numeric>
+#include <algorithm>
 
 using namespace Microsoft::MSR::CNTK;
 
@@ -24,7 +26,7 @@ namespace CNTK
         for (size_t i = 0; i < values.size(); ++i)
         {
             const auto inputView = values[i];
-            output[i] = MakeSharedObject<NDArrayView>(inputView->GetDataType(), inputView->Shape(), inputView->Device());
+            output[i] = MakeSharedObject<NDArrayView>(inputView->GetDataType(), inputView->GetStorageFormat(), inputView->Shape(), inputView->Device());
         }
     }
 
@@ -43,6 +45,7 @@ namespace CNTK
         assert(deviceID >= 0);
         Buffer buffer;
         buffer.totalSize = totalSize;
+        buffer.deviceId = deviceID;
         buffer.data = std::shared_ptr<void>(
             CUDAPageLockedMemAllocator::Malloc(totalSize, deviceID),
             [deviceID](void* p) { CUDAPageLockedMemAllocator::Free(p, deviceID); });
@@ -81,6 +84,16 @@ namespace CNTK
                 // TOOD: Nodes have to exchange their names.
                 m_workers.insert({ i,  L"" });
         }
+
+        m_cudaAwareMpi = m_mpi->IsCudaAware();
+        if (m_cudaAwareMpi)
+            fprintf(stderr, "MPICommunicatorImpl: the MPI is CUDA-aware, GPU values are passed to it directly\n");
+    }
+
+    MPICommunicatorImpl::~MPICommunicatorImpl()
+    {
+        if (m_pendingOperation.valid())
+            m_pendingOperation.wait();
     }
 
     void MPICommunicatorImpl::Initialize(const std::vector<NDArrayViewPtr>& values)
@@ -94,29 +107,79 @@ namespace CNTK
             auto view = values[i];
             auto device = view->Device();
 
-            // Make sure none of the values are sparse - we currently do not support aggregation of sparse matrices
+            // sparse values are reduced through dense views, see PrepareSparseValues()
             if (view->GetStorageFormat() != StorageFormat::Dense)
-                RuntimeError("Aggregation for sparse matrices is currently not supported!");
+                LogicError("Sparse values must be prepared for aggregation.");
 
             // TODO: device.Type should be called Kind.
-            if (device.Type() != DeviceKind::GPU)
-            {
-                m_intermediateCPUBuffers[i] = Buffer();
-                m_gpuDataTransferers[i] = nullptr;
-            }
-            else
+            if (device.Type() == DeviceKind::GPU)
             {
                 if (lastGpuDevice.Type() == DeviceKind::CPU)
                     lastGpuDevice = device;
                 else if (device.Id() != lastGpuDevice.Id()) // For the time being, assume all devices have the same id.
                     LogicError("Not all values are on the same GPU device id");
-
-                auto requiredSize = GetBufferSize(view);
-                m_gpuDataTransferers[i] = std::make_shared<GPUDataTransferer>(device.Id(), true);
-                if (m_intermediateCPUBuffers[i].totalSize < requiredSize)
-                    m_intermediateCPUBuffers[i] = AllocateIntermediateBuffer(device.Id(), requiredSize);
             }
         }
+
+        // created with the first values, by all workers at the same time
+        if (!m_nccl)
+            m_nccl = std::make_unique<NcclComm>(lastGpuDevice.Type() == DeviceKind::GPU ? (int) lastGpuDevice.Id() : CPUDEVICE, m_mpi);
+    }
+
+    // The transferer and the page-locked buffer of the i-th value are kept for the next values of the same device and at most this size.
+    void MPICommunicatorImpl::PrepareTransfer(size_t i, const NDArrayViewPtr& view)
+    {
+        auto deviceId = (int) view->Device().Id();
+        auto requiredSize = GetBufferSize(view);
+        auto& buffer = m_intermediateCPUBuffers[i];
+        if (buffer.deviceId != deviceId || buffer.totalSize < requiredSize)
+        {
+            if (buffer.deviceId != deviceId)
+                m_gpuDataTransferers[i] = nullptr;
+            buffer = AllocateIntermediateBuffer(deviceId, requiredSize);
+        }
+        if (!m_gpuDataTransferers[i])
+            m_gpuDataTransferers[i] = std::make_shared<GPUDataTransferer>(deviceId, true);
+    }
+
+    std::shared_ptr<MatrixComputeStreamEvent> MPICommunicatorImpl::SynchronizeWithMainStream(const std::vector<NDArrayViewPtr>& values)
+    {
+        auto device = GetNonCPUDevice(values);
+        if (device.Type() == DeviceKind::CPU)
+            return nullptr;
+
+            // Since we will be copying the gradients asynchronously, let us
+            // ensure that the gradient matrices have been computed before starting to aggregate
+            // them asynchronously on another thread. This essentially means that when we are using
+            // a GPU device, we will synchronize on the main GPU compute stream before starting
+            // the gradient aggregation asynchronously on a separate stream
+        std::shared_ptr<MatrixComputeStreamEvent> mainStreamSyncEvent(MatrixComputeStreamEvent::Create(device.Id()));
+        mainStreamSyncEvent->SynchronizeDataTransferFetchStreamWithEvent<float>();
+        return mainStreamSyncEvent;
+    }
+
+    std::shared_future<void> MPICommunicatorImpl::StartAsync(std::function<void()>&& operation, const DeviceDescriptor& device)
+    {
+        WaitForPendingOperation();
+
+        int deviceId = device.Type() == DeviceKind::CPU ? CPUDEVICE : (int) device.Id();
+        m_pendingOperation = std::async(std::launch::async, [deviceId, operation] {
+            // We are starting on a new thread. Make sure the new thread is
+            // setup to use the right device
+            if (deviceId != CPUDEVICE)
+                Matrix<float>::SetDevice(deviceId);
+            operation();
+        }).share();
+        return m_pendingOperation;
+    }
+
+    void MPICommunicatorImpl::WaitForPendingOperation()
+    {
+        if (!m_pendingOperation.valid())
+            return;
+
+        auto pendingOperation = std::move(m_pendingOperation);
+        pendingOperation.get();
     }
 
     const std::unordered_set<DistributedWorkerDescriptor>& MPICommunicatorImpl::Workers() const
@@ -149,18 +212,26 @@ namespace CNTK
             NOT_IMPLEMENTED;
         }
 
-        auto device = GetNonCPUDevice(values);
-        if (device.Type() != DeviceKind::CPU)
+        WaitForPendingOperation();
+        AggregateImpl(values, outputValues, sendToWorkers, SynchronizeWithMainStream(values));
+    }
+
+    std::shared_future<void> MPICommunicatorImpl::AggregateAsync(const std::vector<NDArrayViewPtr>& values,
+        std::vector<NDArrayViewPtr>& outputValues,
+        const std::unordered_set<DistributedWorkerDescriptor>& sendToWorkers)
+    {
+        if (outputValues.empty())
         {
-            // Since we will be copying the gradients asynchronously, let us
-            // ensure that the gradient matrices have been computed before starting to aggregate
-            // them asynchronously on another thread. This essentially means that when we are using
-            // a GPU device, we will synchronize on the main GPU compute stream before starting
-            // the gradient aggregation asynchronously on a separate stream
-            std::unique_ptr<MatrixComputeStreamEvent> mainStreamSyncEvent(MatrixComputeStreamEvent::Create(device.Id()));
-            mainStreamSyncEvent->SynchronizeDataTransferFetchStreamWithEvent<float>();
+            Recreate(values, outputValues);
         }
-        AggregateImpl(values, outputValues, sendToWorkers);
+        else if (outputValues.size() != values.size())
+        {
+            NOT_IMPLEMENTED;
+        }
+
+        auto mainStreamSyncEvent = SynchronizeWithMainStream(values);
+        std::vector<NDArrayViewPtr> output(outputValues);
+        return StartAsync([=] { AggregateImpl(values, output, sendToWorkers, mainStreamSyncEvent); }, GetNonCPUDevice(values));
     }
 
     DistributedCommunicatorPtr MPICommunicatorImpl::SubGroup(const std::unordered_set<DistributedWorkerDescriptor>&) const
@@ -178,6 +249,7 @@ namespace CNTK
         std::vector<std::shared_ptr<Dictionary>>& output,
         const std::unordered_set<DistributedWorkerDescriptor>& sendToWorkers)
     {
+        WaitForPendingOperation();
         CheckWorkers(sendToWorkers);
 
         std::stringstream dict;
@@ -228,9 +300,26 @@ namespace CNTK
         // TODO: Currently we only support concatenation of inputs of the same size.
         CheckWorkers(workers);
 
-        // Check inputs, currently we support only CPU
+        WaitForPendingOperation();
+        PrepareConcatenation(input, output);
+        ConcatenateImpl(input, output, SynchronizeWithMainStream(input));
+    }
+
+    std::shared_future<void> MPICommunicatorImpl::ConcatenateAsync(const std::vector<NDArrayViewPtr>& input, std::vector<NDArrayViewPtr>& output, const std::unordered_set<DistributedWorkerDescriptor>& workers)
+    {
+        CheckWorkers(workers);
+
+        PrepareConcatenation(input, output);
+        auto mainStreamSyncEvent = SynchronizeWithMainStream(input);
+        std::vector<NDArrayViewPtr> outputValues(output);
+        return StartAsync([=] { ConcatenateImpl(input, outputValues, mainStreamSyncEvent); }, GetNonCPUDevice(input));
+    }
+
+    void MPICommunicatorImpl::PrepareConcatenation(const std::vector<NDArrayViewPtr>& input, std::vector<NDArrayViewPtr>& output)
+    {
+        // Check inputs, without a CUDA-aware MPI we support only CPU
         auto nonCpu = std::find_if(input.begin(), input.end(), [](const NDArrayViewPtr& v) { return v->Device() != DeviceDescriptor::CPUDevice(); });
-        if (nonCpu != input.end())
+        if (nonCpu != input.end() && !m_cudaAwareMpi)
             LogicError("Currently only CPU located buffers are supported for concatenation.");
 
         output.resize(input.size());
@@ -240,12 +329,21 @@ namespace CNTK
         {
             if (output[i] == nullptr || 
                 output[i]->Shape().TotalSize() != m_mpi->NumNodesInUse() * input[i]->Shape().TotalSize() ||
-                output[i]->GetDataType() != input[i]->GetDataType())
+                output[i]->GetDataType() != input[i]->GetDataType() ||
+                output[i]->Device() != input[i]->Device())
             {
                 // Allocating flat array for all ranks.
-                output[i] = std::make_shared<NDArrayView>(input[i]->GetDataType(), NDShape{ input[i]->Shape().TotalSize() * m_mpi->NumNodesInUse() }, DeviceDescriptor::CPUDevice());
+                output[i] = std::make_shared<NDArrayView>(input[i]->GetDataType(), NDShape{ input[i]->Shape().TotalSize() * m_mpi->NumNodesInUse() }, input[i]->Device());
             }
         }
+    }
+
+    void MPICommunicatorImpl::ConcatenateImpl(const std::vector<NDArrayViewPtr>& input, const std::vector<NDArrayViewPtr>& output,
+                                              const std::shared_ptr<MatrixComputeStreamEvent>& mainStreamSyncEvent)
+    {
+        // GPU values are passed to the MPI once they are computed
+        if (mainStreamSyncEvent)
+            mainStreamSyncEvent->SynchronizeEvent();
 
         // Initiate concatenation.
         std::vector<MPI_Request> allReduceRequests(input.size());
@@ -270,31 +368,165 @@ namespace CNTK
         const std::vector<NDArrayViewPtr>& values,
         const std::unordered_set<DistributedWorkerDescriptor>& sendToWorkers)
     {
-        auto device = GetNonCPUDevice(values);
-        if (device.Type() != DeviceKind::CPU)
+        WaitForPendingOperation();
+        AggregateImpl(values, values, sendToWorkers, SynchronizeWithMainStream(values));
+    }
+
+    std::shared_future<void> MPICommunicatorImpl::AggregateInPlaceAsync(
+        const std::vector<NDArrayViewPtr>& values,
+        const std::unordered_set<DistributedWorkerDescriptor>& sendToWorkers)
+    {
+        auto mainStreamSyncEvent = SynchronizeWithMainStream(values);
+        return StartAsync([=] { AggregateImpl(values, values, sendToWorkers, mainStreamSyncEvent); }, GetNonCPUDevice(values));
+    }
+
+    void MPICommunicatorImpl::AggregateInPlace(
+        const std::vector<NDArrayViewPtr>& values,
+        const std::unordered_set<DistributedWorkerDescriptor>& sendToWorkers,
+        const std::function<void(size_t)>& valueAggregated)
+    {
+        WaitForPendingOperation();
+        AggregateImpl(values, values, sendToWorkers, SynchronizeWithMainStream(values), valueAggregated);
+    }
+
+    // SparseBlockCol values, e.g. the gradients of embeddings, exchange only the blocks of the columns some worker holds.
+    // All workers lay out their blocks alike for the union of these columns, and the block values are then reduced as a dense value.
+    // If some workers hold a sparse value and others a dense one (e.g. the zero gradients of an empty minibatch), it is reduced densely.
+    bool MPICommunicatorImpl::PrepareSparseValues(std::vector<NDArrayViewPtr>& inputValues, std::vector<NDArrayViewPtr>& outputValues, std::vector<size_t>& valueIndices)
+    {
+        auto numValues = inputValues.size();
+        std::vector<int> numSparseWorkers(numValues);
+        for (size_t i = 0; i < numValues; ++i)
+            numSparseWorkers[i] = inputValues[i]->IsSparse() ? 1 : 0;
+        m_mpi->AllReduce(numSparseWorkers.data(), numSparseWorkers.size());
+
+        bool hasSparseValues = false;
+        std::vector<NDArrayViewPtr> denseInputValues, denseOutputValues;
+        valueIndices.clear();
+        for (size_t i = 0; i < numValues; ++i)
         {
-            // Since we will be copying the gradients asynchronously, let us
-            // ensure that the gradient matrices have been computed before starting to aggregate
-            // them asynchronously on another thread. This essentially means that when we are using
-            // a GPU device, we will synchronize on the main GPU compute stream before starting
-            // the gradient aggregation asynchronously on a separate stream
-            std::unique_ptr<MatrixComputeStreamEvent> mainStreamSyncEvent(MatrixComputeStreamEvent::Create(device.Id()));
-            mainStreamSyncEvent->SynchronizeDataTransferFetchStreamWithEvent<float>();
+            if (numSparseWorkers[i] == 0)
+            {
+                denseInputValues.push_back(inputValues[i]);
+                denseOutputValues.push_back(outputValues[i]);
+                valueIndices.push_back(i);
+                continue;
+            }
+
+            // reduced in place in the output
+            auto& value = outputValues[i];
+            if (value != inputValues[i])
+                value->CopyFrom(*inputValues[i]);
+
+            NDArrayViewPtr denseValue;
+            bool allWorkersSparse = numSparseWorkers[i] == (int) m_mpi->NumNodesInUse();
+            if (!value->IsSparse())
+                denseValue = value;
+            else if (value->GetDataType() == DataType::Float)
+                denseValue = PrepareSparseValue<float>(value, allWorkersSparse);
+            else if (value->GetDataType() == DataType::Double)
+                denseValue = PrepareSparseValue<double>(value, allWorkersSparse);
+            else
+                LogicError("Unknown DataType");
+
+            if (denseValue) // nullptr if no worker holds a block
+            {
+                denseInputValues.push_back(denseValue);
+                denseOutputValues.push_back(denseValue);
+                valueIndices.push_back(i);
+            }
+            hasSparseValues = true;
+        }
+
+        inputValues.swap(denseInputValues);
+        outputValues.swap(denseOutputValues);
+        return hasSparseValues;
+    }
+
+    template <typename ElementType>
+    NDArrayViewPtr MPICommunicatorImpl::PrepareSparseValue(const NDArrayViewPtr& value, bool allWorkersSparse)
+    {
+        auto matrix = GetWritableMatrix<ElementType>(value);
+        if (!allWorkersSparse)
+        {
+            matrix->SwitchToMatrixType(MatrixType::DENSE, MatrixFormat::matrixFormatDense, true);
+            return MakeSharedObject<NDArrayView>(value->GetDataType(), NDShape{ matrix->GetNumElements() }, matrix->Data(), sizeof(ElementType) * matrix->GetNumElements(), value->Device());
+        }
+
+        if (matrix->GetFormat() != MatrixFormat::matrixFormatSparseBlockCol)
+            RuntimeError("Aggregation for sparse matrices is only supported for the SparseBlockCol format.");
+
+        std::vector<size_t> columnIds;
+        matrix->GetSparseBlockColumnIds(columnIds);
+
+        // exchange the columns, all workers get their union
+        int numColumnIds = (int) columnIds.size();
+        std::vector<int> counts(m_mpi->NumNodesInUse());
+        m_mpi->AllGather(&numColumnIds, 1, counts.data(), 1);
+        std::vector<int> offsets(counts.size());
+        int totalNumColumnIds = 0;
+        for (size_t i = 0; i < counts.size(); ++i)
+        {
+            offsets[i] = totalNumColumnIds;
+            totalNumColumnIds += counts[i];
         }
-        AggregateImpl(values, values, sendToWorkers);
+        std::vector<size_t> allColumnIds(std::max(totalNumColumnIds, 1)); // buffer should be at least of size 1.
+        m_mpi->AllGatherv(columnIds.data(), columnIds.size(), allColumnIds.data(), counts.data(), offsets.data());
+        allColumnIds.resize(totalNumColumnIds);
+        std::sort(allColumnIds.begin(), allColumnIds.end());
+        allColumnIds.erase(std::unique(allColumnIds.begin(), allColumnIds.end()), allColumnIds.end());
+
+        matrix->ExpandSparseBlockColumns(allColumnIds);
+        size_t numBlockValues = matrix->GetNumRows() * allColumnIds.size();
+        if (numBlockValues == 0)
+            return nullptr;
+        return MakeSharedObject<NDArrayView>(value->GetDataType(), NDShape{ numBlockValues }, matrix->Data(), sizeof(ElementType) * numBlockValues, value->Device());
     }
 
     void  MPICommunicatorImpl::AggregateImpl(
-        const std::vector<NDArrayViewPtr>& inputValues,
-        const std::vector<NDArrayViewPtr>& outputValues,
-        const std::unordered_set<DistributedWorkerDescriptor>& sendToWorkers)
+        const std::vector<NDArrayViewPtr>& inputValuesToAggregate,
+        const std::vector<NDArrayViewPtr>& outputValuesToAggregate,
+        const std::unordered_set<DistributedWorkerDescriptor>& sendToWorkers,
+        std::shared_ptr<MatrixComputeStreamEvent> mainStreamSyncEvent,
+        const std::function<void(size_t)>& valueAggregated)
     {
         CheckWorkers(sendToWorkers);
 
         if (m_mpi->NumNodesInUse() == 1) // No need to aggregate anything.
+        {
+            for (size_t i = 0; valueAggregated && i < inputValuesToAggregate.size(); ++i)
+                valueAggregated(i);
             return;
+        }
+
+        assert(inputValuesToAggregate.size() == outputValuesToAggregate.size());
 
-        assert(inputValues.size() == outputValues.size());
+        std::vector<NDArrayViewPtr> inputValues(inputValuesToAggregate), outputValues(outputValuesToAggregate);
+        std::vector<size_t> valueIndices;
+        bool hasSparseValues = PrepareSparseValues(inputValues, outputValues, valueIndices);
+
+        // sparse values of which no worker holds a block have nothing to reduce
+        if (valueAggregated && valueIndices.size() < inputValuesToAggregate.size())
+        {
+            for (size_t i = 0, j = 0; i < inputValuesToAggregate.size(); ++i)
+            {
+                if (j < valueIndices.size() && valueIndices[j] == i)
+                    j++;
+                else
+                    valueAggregated(i);
+            }
+        }
+
+        if (hasSparseValues)
+        {
+            // the blocks were laid out on the main GPU compute stream, see Aggregate()
+            auto device = GetNonCPUDevice(inputValues);
+            if (device.Type() != DeviceKind::CPU)
+            {
+                mainStreamSyncEvent.reset(MatrixComputeStreamEvent::Create(device.Id()));
+                mainStreamSyncEvent->SynchronizeDataTransferFetchStreamWithEvent<float>();
+            }
+        }
 
         auto numValues = inputValues.size();
         if (numValues == 0)
@@ -302,24 +534,81 @@ namespace CNTK
 
         Initialize(inputValues);
 
-        // for all values residing on GPU initiate async transfer to CPU buffers.
+        // values residing on GPU that are reduced in place are reduced by NCCL if possible, and do not take part in the MPI reduction below
+        std::vector<bool> reducedByNccl(numValues, false);
+        std::vector<bool> reportedAggregated(numValues, false);
+        size_t numReducedByNccl = 0;
+        for (auto i = 0; i < numValues; ++i)
+        {
+            auto view = inputValues[i];
+            if (!m_nccl->IsSupported() || view->Device() == DeviceDescriptor::CPUDevice() || GetDataBuffer(view) != GetDataBuffer(outputValues[i]))
+                continue;
+
+            if (view->GetDataType() == DataType::Float)
+                m_nccl->AllReduce(static_cast<float*>(GetDataBuffer(view)), view->Shape().TotalSize());
+            else if (view->GetDataType() == DataType::Double)
+                m_nccl->AllReduce(static_cast<double*>(GetDataBuffer(view)), view->Shape().TotalSize());
+            else
+                LogicError("Unknown DataType");
+            reducedByNccl[i] = true;
+            numReducedByNccl++;
+        }
+
+        // the work queued for them on the compute stream waits for their reductions, unless these are only done by Sync()
+        for (size_t i = 0, reduction = 0; valueAggregated && i < numValues; ++i)
+        {
+            if (reducedByNccl[i] && m_nccl->MakeComputeStreamWaitForReduction(reduction++))
+            {
+                valueAggregated(valueIndices[i]);
+                reportedAggregated[i] = true;
+            }
+        }
+
+        // the other values residing on GPU are reduced in page-locked CPU buffers, unless a CUDA-aware MPI reduces them in place
+        std::vector<bool> staged(numValues, false);
+        bool passesGPUValues = false;
+        for (auto i = 0; i < numValues; ++i)
+        {
+            auto view = inputValues[i];
+            if (view->Device() == DeviceDescriptor::CPUDevice() || reducedByNccl[i])
+                continue;
+
+            staged[i] = !m_cudaAwareMpi || GetDataBuffer(view) != GetDataBuffer(outputValues[i]);
+            passesGPUValues = passesGPUValues || !staged[i];
+        }
+
+        // MPI gets the GPU memory once it is computed
+        if (passesGPUValues)
+        {
+            assert(mainStreamSyncEvent);
+            mainStreamSyncEvent->SynchronizeEvent();
+        }
+
+        // for all staged values initiate async transfer to CPU buffers.
         for (auto i = 0; i < numValues; ++i)
         {
             auto view = inputValues[i];
-            if (view->Device() != DeviceDescriptor::CPUDevice())
+            if (staged[i])
             {
+                PrepareTransfer(i, view);
                 auto& transferer = m_gpuDataTransferers[i];
                 auto& buffer = m_intermediateCPUBuffers[i];
                 transferer->CopyGPUToCPUAsync(GetDataBuffer(view), GetBufferSize(view), buffer.data.get());
             }
         }
 
-        std::vector<MPI_Request> allReduceRequests(numValues);
+        // on multiple hosts the values are reduced within the hosts, then across them, see MPIWrapper::UseHierarchicalAllReduce()
+        bool hierarchical = m_mpi->UseHierarchicalAllReduce();
+        std::vector<MPI_Request> allReduceRequests(numValues, MPI_REQUEST_NULL);
+        std::vector<MPIWrapper::HierarchicalAllReduceRequest> hierarchicalRequests(hierarchical ? numValues : 0);
         for (auto i = 0; i < numValues; ++i)
         {
+            if (reducedByNccl[i])
+                continue;
+
             auto inputValue = inputValues[i];
 
-            if (inputValue->Device() != DeviceDescriptor::CPUDevice())
+            if (staged[i])
             {
                 // TODO: actually, we can start reducing all cpu values first, and then wait for the gpu->cpu transfer to finish.
                 m_gpuDataTransferers[i]->WaitForCopyGPUToCPUAsync();
@@ -334,10 +623,23 @@ namespace CNTK
             assert(dataType == outputValue->GetDataType());
             assert(inputValue->Device() == outputValue->Device());
 
-            void* inputData = (inputValue->Device() != DeviceDescriptor::CPUDevice()) ? m_intermediateCPUBuffers[i].data.get() : GetDataBuffer(inputValue);
-            void* outputData = (inputValue->Device() != DeviceDescriptor::CPUDevice()) ? m_intermediateCPUBuffers[i].data.get() : GetDataBuffer(outputValue);
+            void* inputData = staged[i] ? m_intermediateCPUBuffers[i].data.get() : GetDataBuffer(inputValue);
+            void* outputData = staged[i] ? m_intermediateCPUBuffers[i].data.get() : GetDataBuffer(outputValue);
 
-            if (dataType == DataType::Float)
+            if (hierarchical)
+            {
+                // the two-level all-reduce works in place
+                if (inputData != outputData)
+                    memcpy(outputData, inputData, GetBufferSize(outputValue));
+
+                if (dataType == DataType::Float)
+                    m_mpi->HierarchicalAllReduceAsync<float>(static_cast<float*>(outputData), numElements, &hierarchicalRequests[i]);
+                else if (dataType == DataType::Double)
+                    m_mpi->HierarchicalAllReduceAsync<double>(static_cast<double*>(outputData), numElements, &hierarchicalRequests[i]);
+                else
+                    LogicError("Unknown DataType");
+            }
+            else if (dataType == DataType::Float)
             {
                 if (inputData == outputData)
                     m_mpi->AllReduceAsync<float>(static_cast<float*>(outputData), numElements, &allReduceRequests[i]);
@@ -357,11 +659,23 @@ namespace CNTK
 
         // wait for async all reduce to complete. As soon as one of the requests is finished,
         // check if corresponding value is gpu bound and, if it is the case, initiate a cpu-to-gpu transfer.
+        // The two-level all-reduces are waited for in the order they were started, which is the order they complete in.
         size_t numAllReduceRequestsCompleted = 0;
-        while (numAllReduceRequestsCompleted < numValues)
+        size_t nextHierarchicalRequest = 0;
+        while (numAllReduceRequestsCompleted < numValues - numReducedByNccl)
         {
             int idx = MPI_UNDEFINED;
-            m_mpi->WaitAny(allReduceRequests.data(), (int)allReduceRequests.size(), &idx);
+            if (hierarchical)
+            {
+                while (nextHierarchicalRequest < numValues && reducedByNccl[nextHierarchicalRequest])
+                    nextHierarchicalRequest++;
+                if (nextHierarchicalRequest == numValues)
+                    break;
+                idx = (int)nextHierarchicalRequest++;
+                m_mpi->WaitHierarchicalAllReduce(&hierarchicalRequests[idx]);
+            }
+            else
+                m_mpi->WaitAny(allReduceRequests.data(), (int)allReduceRequests.size(), &idx);
             if (idx == MPI_UNDEFINED)
             {
                 break;
@@ -370,28 +684,45 @@ namespace CNTK
             numAllReduceRequestsCompleted++;
 
             assert(idx < inputValues.size());
-            auto value = inputValues[idx];
 
-            if (value->Device() != DeviceDescriptor::CPUDevice())
+            if (staged[idx])
             {
                 auto view = outputValues[idx];
                 auto size = GetBufferSize(view);
                 auto& transferer = m_gpuDataTransferers[idx];
                 auto& buffer = m_intermediateCPUBuffers[idx];
                 transferer->CopyCPUToGPUAsync(buffer.data.get(), size, GetDataBuffer(view));
+                if (valueAggregated)
+                    transferer->WaitForCopyCPUToGPUAsync();
+            }
+
+            if (valueAggregated)
+            {
+                valueAggregated(valueIndices[idx]);
+                reportedAggregated[idx] = true;
             }
         }
 
         // TODO: Should not wait, simply publishing event on the compute stream should be sufficient.
         for (auto i = 0; i < numValues; ++i)
         {
-            if (inputValues[i]->Device() != DeviceDescriptor::CPUDevice())
+            if (staged[i])
                 m_gpuDataTransferers[i]->WaitForCopyCPUToGPUAsync();
         }
+
+        if (numReducedByNccl > 0)
+            m_nccl->Sync();
+
+        for (size_t i = 0; valueAggregated && i < numValues; ++i)
+        {
+            if (!reportedAggregated[i])
+                valueAggregated(valueIndices[i]);
+        }
     }
 
     void  MPICommunicatorImpl::Barrier()
     {
+        WaitForPendingOperation();
         m_mpi->WaitAll();
     }
 }
\ No newline at end of file
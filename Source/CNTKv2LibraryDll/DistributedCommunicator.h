@@ -7,9 +7,11 @@
 
 #include "CNTKLibrary.h"
 #include <MatrixQuantizerImpl.h>
+#include <future>
 
 namespace Microsoft { namespace MSR { namespace CNTK {
     class GPUDataTransferer;
+    class NcclComm;
 
     class MPIWrapper;
     typedef std::shared_ptr<MPIWrapper> MPIWrapperPtr;
@@ -50,27 +52,82 @@ namespace CNTK
             const std::vector<NDArrayViewPtr>& values,
             const std::unordered_set<DistributedWorkerDescriptor>& sendToWorkers) override;
 
+        // As above, calling valueAggregated(i) as soon as values[i] is aggregated, in the order the values complete, while the
+        // others are still in flight. For a value on the GPU, this may be before it is aggregated, once the work queued on the
+        // compute stream waits for it.
+        void AggregateInPlace(
+            const std::vector<NDArrayViewPtr>& values,
+            const std::unordered_set<DistributedWorkerDescriptor>& sendToWorkers,
+            const std::function<void(size_t)>& valueAggregated);
+
         virtual void Aggregate(
             const std::vector<NDArrayViewPtr>& inValues,
             std::vector<NDArrayViewPtr>& outValues,
             const std::unordered_set<DistributedWorkerDescriptor>& sendToWorkers) override;
 
+        // Non-blocking variants of AggregateInPlace(), Aggregate() and Concatenate(): the operation runs on a separate thread, and the returned
+        // future is ready once it is done (and rethrows its error). Until then the values must not be used, and the process must not start
+        // other MPI operations; the other operations of this communicator wait for it first.
+        std::shared_future<void> AggregateInPlaceAsync(
+            const std::vector<NDArrayViewPtr>& values,
+            const std::unordered_set<DistributedWorkerDescriptor>& sendToWorkers);
+
+        std::shared_future<void> AggregateAsync(
+            const std::vector<NDArrayViewPtr>& inValues,
+            std::vector<NDArrayViewPtr>& outValues,
+            const std::unordered_set<DistributedWorkerDescriptor>& sendToWorkers);
+
+        std::shared_future<void> ConcatenateAsync(
+            const std::vector<NDArrayViewPtr>& input,
+            std::vector<NDArrayViewPtr>& output,
+            const std::unordered_set<DistributedWorkerDescriptor>& sendToWorkers);
+
         virtual void Barrier() override;
 
-        virtual ~MPICommunicatorImpl() {}
+        virtual ~MPICommunicatorImpl();
 
     private:
         void Initialize(const std::vector<NDArrayViewPtr>& values);
 
+        // Makes sure the i-th value, on a GPU, can be transferred to and from m_intermediateCPUBuffers[i].
+        void PrepareTransfer(size_t i, const NDArrayViewPtr& view);
+
+        // Makes the GPU transfers wait for the work queued on the main compute stream so far, see AggregateInPlace(). Returns the
+        // event recorded for it (nullptr for CPU values), which the host waits for before passing GPU memory to MPI.
+        std::shared_ptr<Microsoft::MSR::CNTK::MatrixComputeStreamEvent> SynchronizeWithMainStream(const std::vector<NDArrayViewPtr>& values);
+
         void AggregateImpl(
-            const std::vector<NDArrayViewPtr>& inputValues,
-            const std::vector<NDArrayViewPtr>& outputValues,
-            const std::unordered_set<DistributedWorkerDescriptor>& sendToWorkers);
+            const std::vector<NDArrayViewPtr>& inputValuesToAggregate,
+            const std::vector<NDArrayViewPtr>& outputValuesToAggregate,
+            const std::unordered_set<DistributedWorkerDescriptor>& sendToWorkers,
+            std::shared_ptr<Microsoft::MSR::CNTK::MatrixComputeStreamEvent> mainStreamSyncEvent,
+            const std::function<void(size_t)>& valueAggregated = nullptr);
+
+        // Allocates the outputs of Concatenate(), which ConcatenateImpl() then fills.
+        void PrepareConcatenation(const std::vector<NDArrayViewPtr>& input, std::vector<NDArrayViewPtr>& output);
+        void ConcatenateImpl(
+            const std::vector<NDArrayViewPtr>& input,
+            const std::vector<NDArrayViewPtr>& output,
+            const std::shared_ptr<Microsoft::MSR::CNTK::MatrixComputeStreamEvent>& mainStreamSyncEvent);
+
+        // Runs 'operation' on a separate thread using 'device', once the pending operation is done.
+        std::shared_future<void> StartAsync(std::function<void()>&& operation, const DeviceDescriptor& device);
+
+        // Waits for the operation started by one of the ...Async() methods, if any, and rethrows its error.
+        void WaitForPendingOperation();
+
+        // Replaces the sparse values by dense views of what needs to be reduced, see definition. Returns whether there were any.
+        // valueIndices[i] is the index of the value that inputValues[i] is then reduced for.
+        bool PrepareSparseValues(std::vector<NDArrayViewPtr>& inputValues, std::vector<NDArrayViewPtr>& outputValues, std::vector<size_t>& valueIndices);
+
+        template <typename ElementType>
+        NDArrayViewPtr PrepareSparseValue(const NDArrayViewPtr& value, bool allWorkersSparse);
 
         struct Buffer
         {
             std::shared_ptr<void> data = nullptr;
             size_t totalSize = 0;
+            int deviceId = CPUDEVICE; // the page-locked memory was allocated for
         };
 
         static Buffer AllocateIntermediateBuffer(int deviceID, size_t totalSize);
@@ -82,6 +139,14 @@ namespace CNTK
         // TODO: these two are always parallel, merge them together?
         std::vector<std::shared_ptr<Microsoft::MSR::CNTK::GPUDataTransferer>> m_gpuDataTransferers;
 
+        // reduces GPU values in place if all workers can use NCCL, see NcclComm
+        std::unique_ptr<Microsoft::MSR::CNTK::NcclComm> m_nccl;
+
+        // with a CUDA-aware MPI, GPU values are passed to it directly instead of through m_intermediateCPUBuffers
+        bool m_cudaAwareMpi;
+
+        std::shared_future<void> m_pendingOperation;
+
     protected:
         DeviceDescriptor GetNonCPUDevice(const std::vector<NDArrayViewPtr>& values)
         {
@@ -7,6 +7,7 @@
 #include "CNTKLibrary.h"
 #include "PrimitiveFunction.h"
 #include "CompositeFunction.h"
+#include "Serialization.h"
 
 using namespace Microsoft::MSR::CNTK;
 
@@ -190,14 +191,18 @@ namespace CNTK
     {
         Dictionary model = Serialize();
         auto stream = GetFstream(modelFilePath, false);
-        *stream << model;
+        SaveStreamedModel(model, *stream);
         stream->flush();
     }
 
     /*static*/ FunctionPtr Function::LoadModel(const std::wstring& modelFile, const DeviceDescriptor& computeDevice)
     {
         auto stream = GetFstream(modelFile, true);
-        if (!Internal::IsLegacyModel(*stream))
+        if (IsStreamedModel(*stream))
+        {
+            return Function::Deserialize(LoadStreamedModel(*stream), computeDevice);
+        }
+        else if (!Internal::IsLegacyModel(*stream))
         {
             Dictionary model;
             *stream >> model;
@@ -212,7 +217,12 @@ namespace CNTK
     void Function::RestoreModel(const std::wstring& modelFilePath)
     {
         auto stream = GetFstream(modelFilePath, true);
-        if (!Internal::IsLegacyModel(*stream))
+        if (IsStreamedModel(*stream))
+        {
+            RestoreFromCheckpoint(LoadStreamedModel(*stream));
+            return;
+        }
+        else if (!Internal::IsLegacyModel(*stream))
         {
             Dictionary model;
             *stream >> model;
@@ -631,6 +641,19 @@ namespace CNTK
         return UnaryOp(PrimitiveOpType::Hardmax, operand, Dictionary(), name);
     }
 
+    FunctionPtr TopK(const Variable& operand, size_t k, const std::wstring& name)
+    {
+        auto topK = [&](bool outputIndices)
+        {
+            auto additionalProperties = Dictionary();
+            additionalProperties[PrimitiveFunction::AttributeNameTopK] = k;
+            additionalProperties[PrimitiveFunction::AttributeNameOutputIndices] = outputIndices;
+            return UnaryOp(PrimitiveOpType::TopK, operand, std::move(additionalProperties), L"");
+        };
+
+        return Combine({ topK(false)->Output(), topK(true)->Output() }, name);
+    }
+
     FunctionPtr TransposeAxes(const Variable& operand, const Axis& axis1, const Axis& axis2, const std::wstring& name)
     {
         auto additionalProperties = Dictionary();
@@ -22,6 +22,32 @@
         NOT_IMPLEMENTED;                                                                                      \
     }
 
+#define CATCH_UP_LAZY_MOMENTUM_FUNCTION                                                                       \
+    switch (smoothedGradientValue->GetDataType())                                                             \
+    {                                                                                                         \
+    case DataType::Float:                                                                                     \
+        CatchUpLazyMomentum<float>(parameter, gradientValue, smoothedGradientValue, trainingSampleCount);     \
+        break;                                                                                                \
+    case DataType::Double:                                                                                    \
+        CatchUpLazyMomentum<double>(parameter, gradientValue, smoothedGradientValue, trainingSampleCount);    \
+        break;                                                                                                \
+    default:                                                                                                  \
+        NOT_IMPLEMENTED;                                                                                      \
+    }
+
+#define MULTI_TENSOR_UPDATE_FUNCTION                                                                          \
+    switch (smoothedGradientValues.front()->GetDataType())                                                    \
+    {                                                                                                         \
+    case DataType::Float:                                                                                     \
+        MultiTensorUpdate<float>(parameters, gradientValues, smoothedGradientValues, trainingSampleCount);    \
+        break;                                                                                                \
+    case DataType::Double:                                                                                    \
+        MultiTensorUpdate<double>(parameters, gradientValues, smoothedGradientValues, trainingSampleCount);   \
+        break;                                                                                                \
+    default:                                                                                                  \
+        NOT_IMPLEMENTED;                                                                                      \
+    }
+
 using namespace Microsoft::MSR::CNTK;
 using namespace std;
 
@@ -75,6 +101,9 @@ namespace CNTK
 
     void LearnerBase::ResetSmoothedGradients()
     {
+        // with zero smoothed gradients, there is nothing to catch up
+        m_lastSparseUpdates.clear();
+
         for(auto v : m_smoothedGradientValues)
         {
             if (v.second->GetDataType() == DataType::Float)
@@ -109,15 +138,18 @@ namespace CNTK
     }
 
     // Performs additional preprocessing before calling the update method 
-    // (gradient clipping and L2 regularization depending on the additional learning parameters).
+    // (gradient clipping, L2 regularization and weight decay depending on the additional learning parameters).
     template <typename ElementType>
-    void LearnerBase::PreProcess(const NDArrayViewPtr& parameterValue, const NDArrayViewPtr& gradientValue, size_t actualMBSize) const
+    void LearnerBase::PreProcess(const NDArrayViewPtr& parameterValue, const NDArrayViewPtr& gradientValue, size_t actualMBSize, bool regularizationFused) const
     {
         const auto& gradientMatrix = gradientValue->GetWritableMatrix<ElementType>();
 
         // clipping gradients to prevent outliers
         ClipGradient<ElementType>(*gradientMatrix, actualMBSize);
 
+        if (regularizationFused)
+            return;
+
         // L2 regularizer
         if (m_additionalOptions.l2RegularizationWeight > 0)
         {
@@ -126,12 +158,33 @@ namespace CNTK
             const auto& parameterMatrix = parameterValue->GetWritableMatrix<ElementType>();
             Matrix<ElementType>::ScaleAndAdd(ElementType(weight), *parameterMatrix, *gradientMatrix);
         }
+
+        // decoupled weight decay; the update does not depend on the parameter, so it may decay before it
+        if (m_additionalOptions.weightDecay > 0)
+        {
+            const auto decay = LearningRate(actualMBSize) * m_additionalOptions.weightDecay * actualMBSize;
+            *parameterValue->GetWritableMatrix<ElementType>() *= ElementType(1 - decay);
+        }
+    }
+
+    template <typename ElementType>
+    UpdateRegularization<ElementType> LearnerBase::FusedRegularization(size_t actualMBSize) const
+    {
+        // scaled as by PreProcess() and PostProcess()
+        const auto learningRate = LearningRate(actualMBSize);
+        UpdateRegularization<ElementType> regularization;
+        regularization.l2Weight = ElementType(m_additionalOptions.l2RegularizationWeight * actualMBSize);
+        regularization.weightDecay = ElementType(learningRate * m_additionalOptions.weightDecay * actualMBSize);
+        regularization.l1Threshold = 0;
+        if (GetCurrentTrainingParameterValue(m_additionalOptions.gaussianNoiseInjectionStdDev) == 0)
+            regularization.l1Threshold = ElementType(learningRate * m_additionalOptions.l1RegularizationWeight * actualMBSize);
+        return regularization;
     }
 
     // Performs additional postprocessing after the update method has been executed
     // (noise injection and L1 regularization specified by the additional learning parameters).
     template <typename ElementType>
-    void LearnerBase::PostProcess(const Parameter& parameter, const NDArrayViewPtr& gradientValue, size_t actualMBSize) const
+    void LearnerBase::PostProcess(const Parameter& parameter, const NDArrayViewPtr& gradientValue, size_t actualMBSize, bool regularizationFused) const
     {
         const auto& parameterValue = parameter.Value();
         const auto& parameterMatrix = parameterValue->GetWritableMatrix<ElementType>();
@@ -154,7 +207,7 @@ namespace CNTK
         }
 
         // L1 regularizer with proximal gradient descent method
-        if (m_additionalOptions.l1RegularizationWeight > 0)
+        if (m_additionalOptions.l1RegularizationWeight > 0 && !(regularizationFused && gaussianNoiseInjectionStdDev == 0))
         {
             const auto learningRate = LearningRate(actualMBSize);
             // multiply by actualMBSize so that it's invariant to minibatch size since learning rate is per sample
@@ -223,6 +276,27 @@ namespace CNTK
     }
 
     /*virtual*/ bool LearnerBase::Update(unordered_map<Parameter, NDArrayViewPtr>& gradientValues, size_t trainingSampleCount) /*override*/
+    {
+        if (!BeginUpdate(trainingSampleCount))
+        {
+            return false;
+        }
+
+        unordered_set<Parameter> updatedParameters;
+        if (SupportsMultiTensorUpdate())
+            UpdateDenseParametersTogether(gradientValues, trainingSampleCount, updatedParameters);
+
+        for (const auto& parameter : Parameters())
+        {
+            if (updatedParameters.find(parameter) == updatedParameters.end())
+                UpdateParameter(parameter, gradientValues.at(parameter), trainingSampleCount);
+        }
+
+        EndUpdate(trainingSampleCount);
+        return true;
+    }
+
+    bool LearnerBase::BeginUpdate(size_t trainingSampleCount) const
     {
         if (LearningRate(trainingSampleCount) == 0.0)
         {
@@ -231,47 +305,50 @@ namespace CNTK
 
         // make sure trainingSampleCount is a valid value
         assert(trainingSampleCount > 0);
+        return true;
+    }
 
-        for (const auto& parameter : Parameters())
-        {
-            const auto& smoothedGradientValue = m_smoothedGradientValues.at(parameter);
-            const auto& gradientValue = gradientValues.at(parameter);
-            // TODO: make this a runtime parameter.
+    void LearnerBase::UpdateParameter(const Parameter& parameter, const NDArrayViewPtr& gradientValue, size_t trainingSampleCount)
+    {
+        const auto& smoothedGradientValue = m_smoothedGradientValues.at(parameter);
+        // TODO: make this a runtime parameter.
 #if DUMPOUTPUT
-            LOGPRINTF(stderr, "Update_%ls\n", parameter.Uid().c_str());
+        LOGPRINTF(stderr, "Update_%ls\n", parameter.Uid().c_str());
 #endif
 
 #ifdef _DEBUG
-            if (HasNan(smoothedGradientValue, "TrainOneEpoch/UpdateWeights/Learner::Update(): "))
-                LogicError("%ls has NaNs in smoothedGradient.", parameter.Uid().c_str());
+        if (HasNan(smoothedGradientValue, "TrainOneEpoch/UpdateWeights/Learner::Update(): "))
+            LogicError("%ls has NaNs in smoothedGradient.", parameter.Uid().c_str());
 #endif
 
 #if DUMPOUTPUT
-            const auto learningRate = LearningRate(trainingSampleCount);
-            const auto momentum = MomentumValueForMB(trainingSampleCount);
-            LOGPRINTF(stderr, "learnRatePerSample=%0.8f, momentum=%0.8f, actualMBSize=%ld\n",
-                      learningRate, momentum, trainingSampleCount);
-            LOGPRINTF(stderr, "GradUpdateType()=%s, GradientUpdateNoiseStd()=%0.8f\n",
-                      LearnerType().c_str(), m_additionalOptions.gaussianNoiseInjectionStdDev);
-            Print(gradientValue, "Gradient Update");
-            Print(smoothedGradientValue, "Smoothed Gradient Input");
+        const auto learningRate = LearningRate(trainingSampleCount);
+        const auto momentum = MomentumValueForMB(trainingSampleCount);
+        LOGPRINTF(stderr, "learnRatePerSample=%0.8f, momentum=%0.8f, actualMBSize=%ld\n",
+                  learningRate, momentum, trainingSampleCount);
+        LOGPRINTF(stderr, "GradUpdateType()=%s, GradientUpdateNoiseStd()=%0.8f\n",
+                  LearnerType().c_str(), m_additionalOptions.gaussianNoiseInjectionStdDev);
+        Print(gradientValue, "Gradient Update");
+        Print(smoothedGradientValue, "Smoothed Gradient Input");
 #endif
-            UPDATE_FUNCTION;
+        UPDATE_FUNCTION;
 
 #if DUMPOUTPUT
-            Print(parameter.Value(), "Parameter Update");
+        Print(parameter.Value(), "Parameter Update");
 #endif
 
 #ifdef _DEBUG
-            const auto& parameterValue = parameter.Value();
-            if (HasNan(parameterValue, "TrainOneEpoch/UpdateWeights/Learner::Update(): "))
-                LogicError("%ls has NaNs in parameter values after parameter update.", parameter.Uid().c_str());
+        const auto& parameterValue = parameter.Value();
+        if (HasNan(parameterValue, "TrainOneEpoch/UpdateWeights/Learner::Update(): "))
+            LogicError("%ls has NaNs in parameter values after parameter update.", parameter.Uid().c_str());
 #endif
-        }
+    }
+
+    void LearnerBase::EndUpdate(size_t trainingSampleCount)
+    {
         m_sampleCount += trainingSampleCount;
         m_minibatchCount++;
         // TODO: sweep count also needs to be updated.
-        return true;
     }
 
     template <typename ElementType>
@@ -279,6 +356,9 @@ namespace CNTK
     {
         const auto& parameterValue = parameter.Value();
         PreProcess<ElementType>(parameterValue, gradientValue, trainingSampleCount);
+        // sparse gradients only update their columns, a dense one after them catches up all columns first
+        if (GetMatrix<ElementType>(gradientValue)->GetMatrixType() == MatrixType::SPARSE || m_lastSparseUpdates.find(parameter) != m_lastSparseUpdates.end())
+            CatchUpLazyMomentum(parameter, gradientValue, smoothedGradientValue, trainingSampleCount);
         Update(parameter, gradientValue, smoothedGradientValue, trainingSampleCount);
         PostProcess<ElementType>(parameter, gradientValue, trainingSampleCount);
 
@@ -286,6 +366,129 @@ namespace CNTK
         paramRef.RecordValueUpdate();
     }
 
+    void LearnerBase::UpdateDenseParametersTogether(const unordered_map<Parameter, NDArrayViewPtr>& gradientValues, size_t trainingSampleCount,
+                                                    unordered_set<Parameter>& updatedParameters) const
+    {
+        struct ParameterGroup
+        {
+            DataType dataType;
+            DeviceDescriptor device;
+            vector<Parameter> parameters;
+            vector<NDArrayViewPtr> gradientValues;
+            vector<NDArrayViewPtr> smoothedGradientValues;
+        };
+
+        // sparse gradients, and dense ones after them, which catch up lazily, are updated one by one
+        vector<ParameterGroup> groups;
+        for (const auto& parameter : Parameters())
+        {
+            const auto& gradientValue = gradientValues.at(parameter);
+            const auto& smoothedGradientValue = m_smoothedGradientValues.at(parameter);
+            const auto device = parameter.Value()->Device();
+            if (gradientValue->IsSparse() || m_lastSparseUpdates.find(parameter) != m_lastSparseUpdates.end() ||
+                gradientValue->Device() != device || smoothedGradientValue->Device() != device)
+                continue;
+
+            auto group = find_if(groups.begin(), groups.end(), [&](const ParameterGroup& g) { return g.dataType == parameter.GetDataType() && g.device == device; });
+            if (group == groups.end())
+                group = groups.insert(groups.end(), ParameterGroup{ parameter.GetDataType(), device, {}, {}, {} });
+
+            group->parameters.push_back(parameter);
+            group->gradientValues.push_back(gradientValue);
+            group->smoothedGradientValues.push_back(smoothedGradientValue);
+        }
+
+        for (const auto& group : groups)
+        {
+            // nothing to gain for a single parameter
+            if (group.parameters.size() < 2)
+                continue;
+
+            switch (group.dataType)
+            {
+            case DataType::Float:
+                UpdateTogether<float>(group.parameters, group.gradientValues, group.smoothedGradientValues, trainingSampleCount);
+                break;
+            case DataType::Double:
+                UpdateTogether<double>(group.parameters, group.gradientValues, group.smoothedGradientValues, trainingSampleCount);
+                break;
+            default:
+                NOT_IMPLEMENTED;
+            }
+
+            updatedParameters.insert(group.parameters.begin(), group.parameters.end());
+        }
+    }
+
+    template <typename ElementType>
+    void LearnerBase::UpdateTogether(const vector<Parameter>& parameters, const vector<NDArrayViewPtr>& gradientValues,
+                                     const vector<NDArrayViewPtr>& smoothedGradientValues, size_t trainingSampleCount) const
+    {
+        for (size_t i = 0; i < parameters.size(); i++)
+            PreProcess<ElementType>(parameters[i].Value(), gradientValues[i], trainingSampleCount, /*regularizationFused*/ true);
+
+        MultiTensorUpdate(parameters, gradientValues, smoothedGradientValues, trainingSampleCount);
+
+        for (size_t i = 0; i < parameters.size(); i++)
+        {
+            PostProcess<ElementType>(parameters[i], gradientValues[i], trainingSampleCount, /*regularizationFused*/ true);
+
+#ifdef _DEBUG
+            if (HasNan(parameters[i].Value(), "TrainOneEpoch/UpdateWeights/Learner::Update(): "))
+                LogicError("%ls has NaNs in parameter values after parameter update.", parameters[i].Uid().c_str());
+#endif
+            auto paramRef = parameters[i];
+            paramRef.RecordValueUpdate();
+        }
+    }
+
+    template <typename ElementType>
+    /*static*/ void LearnerBase::GetWritableMatrices(const vector<Parameter>& parameters, const vector<NDArrayViewPtr>& gradientValues, const vector<NDArrayViewPtr>& smoothedGradientValues,
+                                                     vector<shared_ptr<Matrix<ElementType>>>& matrices,
+                                                     vector<Matrix<ElementType>*>& parameterMatrices, vector<Matrix<ElementType>*>& gradientMatrices, vector<Matrix<ElementType>*>& smoothedGradientMatrices)
+    {
+        for (size_t i = 0; i < parameters.size(); i++)
+        {
+            matrices.push_back(GetWritableMatrix<ElementType>(parameters[i].Value()));
+            parameterMatrices.push_back(matrices.back().get());
+            matrices.push_back(GetWritableMatrix<ElementType>(gradientValues[i]));
+            gradientMatrices.push_back(matrices.back().get());
+            matrices.push_back(GetWritableMatrix<ElementType>(smoothedGradientValues[i]));
+            smoothedGradientMatrices.push_back(matrices.back().get());
+        }
+    }
+
+    template <typename ElementType>
+    void LearnerBase::CatchUpSkippedSteps(const Parameter& parameter, const Matrix<ElementType>& gradient, const NDArrayViewPtr& smoothedGradientValue,
+                                          double learningRate, double momentum, bool useNesterovMomentum, bool hasVarianceAccumulator, double varMomentum) const
+    {
+        bool isSparse = gradient.GetMatrixType() == MatrixType::SPARSE;
+        if (isSparse && gradient.GetFormat() != MatrixFormat::matrixFormatSparseBlockCol)
+            return; // updated as before
+
+        auto lastUpdates = m_lastSparseUpdates.find(parameter);
+        if (lastUpdates == m_lastSparseUpdates.end())
+        {
+            if (!isSparse)
+                return;
+
+            // so far, all columns were updated in every minibatch
+            const auto shape = GetMatrixShape(parameter);
+            NDArrayViewPtr view = AllocateNDArrayView(parameter, { 1, shape[1] });
+            GetWritableMatrix<ElementType>(view)->SetValue(ElementType(m_minibatchCount) - 1);
+            lastUpdates = m_lastSparseUpdates.insert(make_pair(parameter, view)).first;
+        }
+
+        const auto& smoothedGradientMatrix = GetWritableMatrix<ElementType>(smoothedGradientValue);
+        const auto& parameterMatrix = GetWritableMatrix<ElementType>(parameter.Value());
+        smoothedGradientMatrix->CatchUpLazyMomentum(gradient, *parameterMatrix, *GetWritableMatrix<ElementType>(lastUpdates->second), m_minibatchCount,
+                                                    ElementType(learningRate), ElementType(momentum), useNesterovMomentum, hasVarianceAccumulator, ElementType(varMomentum));
+
+        // all columns are up to date
+        if (!isSparse)
+            m_lastSparseUpdates.erase(lastUpdates);
+    }
+
     string LearnerBase::LearnerType() const
     {
         return Typename(this);
@@ -303,6 +506,22 @@ namespace CNTK
         checkpoint[minibatchCountKey] = m_minibatchCount;
         checkpoint[learningRateScheduleKey] = m_learningRateSchedule.Serialize();
 
+        // the columns of parameters with sparse gradients catch up the minibatches they skipped, so that the checkpointed
+        // smoothed gradients (and the model saved with them) are the same as if all columns had been updated in each minibatch
+        for (const auto& parameter : Parameters())
+        {
+            if (m_lastSparseUpdates.find(parameter) == m_lastSparseUpdates.end())
+                continue;
+
+            // the parameter value is dense, i.e. selects all columns
+            const auto averageMinibatchSize = (m_minibatchCount > 0) ? m_sampleCount / m_minibatchCount : 0;
+            CatchUpLazyMomentum(parameter, parameter.Value(), m_smoothedGradientValues.at(parameter), averageMinibatchSize);
+            m_lastSparseUpdates.erase(parameter);
+
+            auto paramRef = parameter;
+            paramRef.RecordValueUpdate();
+        }
+
         // TODO: should we also save momentum schedule into the checkpoint?
         // If that is the case, need to be able to override this method in subclasses,
         // TODO: we now store mapping from UID to Parameter value in the checkpoint,
@@ -334,6 +553,7 @@ namespace CNTK
         // TODO: which learning rate schedule should take precedence here? 
         // The one given at construction time or the one loaded from a checkpoint?
         m_learningRateSchedule = TrainingParameterSchedule<double>::Deserialize(checkpoint[learningRateScheduleKey].Value<Dictionary>());
+        m_lastSparseUpdates.clear();
 
         const auto parameters = Parameters();
 
@@ -387,6 +607,44 @@ namespace CNTK
                                            learningRate, momentum, UseNesterovMomentum());
     }
 
+    /*virtual*/ void LearnerSGD::MultiTensorUpdate(const vector<Parameter>& parameters, const vector<NDArrayViewPtr>& gradientValues,
+                                                   const vector<NDArrayViewPtr>& smoothedGradientValues, size_t trainingSampleCount) const /*override*/
+    {
+        MULTI_TENSOR_UPDATE_FUNCTION;
+    }
+
+    template <typename ElementType>
+    void LearnerSGD::MultiTensorUpdate(const vector<Parameter>& parameters, const vector<NDArrayViewPtr>& gradientValues,
+                                       const vector<NDArrayViewPtr>& smoothedGradientValues, size_t trainingSampleCount) const
+    {
+        vector<shared_ptr<Matrix<ElementType>>> matrices;
+        vector<Matrix<ElementType>*> parameterMatrices, gradientMatrices, smoothedGradientMatrices;
+        GetWritableMatrices<ElementType>(parameters, gradientValues, smoothedGradientValues, matrices, parameterMatrices, gradientMatrices, smoothedGradientMatrices);
+
+        const auto learningRate = ElementType(LearningRate(trainingSampleCount));
+        const auto momentum = ElementType(MomentumValueForMB(trainingSampleCount));
+
+        Matrix<ElementType>::MultiNormalGrad(smoothedGradientMatrices, gradientMatrices, parameterMatrices, learningRate, momentum, UseNesterovMomentum(),
+                                             FusedRegularization<ElementType>(trainingSampleCount));
+    }
+
+    /*virtual*/ void LearnerSGD::CatchUpLazyMomentum(const Parameter& parameter, const NDArrayViewPtr& gradientValue, const NDArrayViewPtr& smoothedGradientValue, size_t trainingSampleCount) const /*override*/
+    {
+        CATCH_UP_LAZY_MOMENTUM_FUNCTION;
+    }
+
+    template <typename ElementType>
+    void LearnerSGD::CatchUpLazyMomentum(const Parameter& parameter, const NDArrayViewPtr& gradientValue, const NDArrayViewPtr& smoothedGradientValue, size_t trainingSampleCount) const
+    {
+        // without momentum, there are no smoothed gradients to decay
+        const auto momentum = MomentumValueForMB(trainingSampleCount);
+        if (momentum == 0.0)
+            return;
+
+        CatchUpSkippedSteps<ElementType>(parameter, *GetMatrix<ElementType>(gradientValue), smoothedGradientValue,
+                                         LearningRate(trainingSampleCount), momentum, UseNesterovMomentum());
+    }
+
     double LearnerMomentumSGD::MomentumValueForMB(const MomentumSchedule& schedule, size_t minibatchSize) const
     {
         double currentMomentum = GetCurrentTrainingParameterValue(schedule);
@@ -441,6 +699,28 @@ namespace CNTK
         Matrix<ElementType>::ScaleAndAdd(ElementType(-learningRate / aveMultiplier), *gradientMatrix, *parameterMatrix);
     }
 
+    /*virtual*/ void LearnerAdaGrad::MultiTensorUpdate(const vector<Parameter>& parameters, const vector<NDArrayViewPtr>& gradientValues,
+                                                       const vector<NDArrayViewPtr>& smoothedGradientValues, size_t trainingSampleCount) const /*override*/
+    {
+        MULTI_TENSOR_UPDATE_FUNCTION;
+    }
+
+    template <typename ElementType>
+    void LearnerAdaGrad::MultiTensorUpdate(const vector<Parameter>& parameters, const vector<NDArrayViewPtr>& gradientValues,
+                                           const vector<NDArrayViewPtr>& smoothedGradientValues, size_t trainingSampleCount) const
+    {
+        assert(!m_needAveMultiplier);
+
+        vector<shared_ptr<Matrix<ElementType>>> matrices;
+        vector<Matrix<ElementType>*> parameterMatrices, gradientMatrices, smoothedGradientMatrices;
+        GetWritableMatrices<ElementType>(parameters, gradientValues, smoothedGradientValues, matrices, parameterMatrices, gradientMatrices, smoothedGradientMatrices);
+
+        const auto learningRate = LearningRate(trainingSampleCount);
+
+        Matrix<ElementType>::MultiAdagrad(smoothedGradientMatrices, gradientMatrices, parameterMatrices, ElementType(learningRate),
+                                          FusedRegularization<ElementType>(trainingSampleCount));
+    }
+
     /*static*/ const double LearnerFSAdaGrad::s_targetAdagradAvDenom = 1.0;
 
     LearnerFSAdaGrad::LearnerFSAdaGrad(const vector<Parameter>& parameters,
@@ -483,6 +763,108 @@ namespace CNTK
         smoothedGradientMatrix->FSAdagradUpdate(trainingSampleCount, *gradientMatrix, *parameterMatrix, smoothedCount, learningRate, s_targetAdagradAvDenom, momentum, varMomentum);
     }
 
+    /*virtual*/ void LearnerFSAdaGrad::MultiTensorUpdate(const vector<Parameter>& parameters, const vector<NDArrayViewPtr>& gradientValues,
+                                                         const vector<NDArrayViewPtr>& smoothedGradientValues, size_t trainingSampleCount) const /*override*/
+    {
+        MULTI_TENSOR_UPDATE_FUNCTION;
+    }
+
+    template <typename ElementType>
+    void LearnerFSAdaGrad::MultiTensorUpdate(const vector<Parameter>& parameters, const vector<NDArrayViewPtr>& gradientValues,
+                                             const vector<NDArrayViewPtr>& smoothedGradientValues, size_t trainingSampleCount) const
+    {
+        vector<shared_ptr<Matrix<ElementType>>> matrices;
+        vector<Matrix<ElementType>*> parameterMatrices, gradientMatrices, smoothedGradientMatrices;
+        GetWritableMatrices<ElementType>(parameters, gradientValues, smoothedGradientValues, matrices, parameterMatrices, gradientMatrices, smoothedGradientMatrices);
+
+        const auto learningRate = LearningRate(trainingSampleCount);
+        const auto momentum = MomentumValueForMB(trainingSampleCount);
+
+        const auto varMomentum = VarianceMomentumValueForMB(trainingSampleCount);
+
+        vector<double*> smoothedCounts;
+        for (const auto& parameter : parameters)
+            smoothedCounts.push_back(&m_smoothedCounts.at(parameter));
+
+        Matrix<ElementType>::MultiFSAdagradUpdate(trainingSampleCount, smoothedGradientMatrices, gradientMatrices, parameterMatrices, smoothedCounts,
+                                                  learningRate, s_targetAdagradAvDenom, momentum, varMomentum,
+                                                  FusedRegularization<ElementType>(trainingSampleCount));
+    }
+
+    /*virtual*/ void LearnerFSAdaGrad::CatchUpLazyMomentum(const Parameter& parameter, const NDArrayViewPtr& gradientValue, const NDArrayViewPtr& smoothedGradientValue, size_t trainingSampleCount) const /*override*/
+    {
+        CATCH_UP_LAZY_MOMENTUM_FUNCTION;
+    }
+
+    template <typename ElementType>
+    void LearnerFSAdaGrad::CatchUpLazyMomentum(const Parameter& parameter, const NDArrayViewPtr& gradientValue, const NDArrayViewPtr& smoothedGradientValue, size_t trainingSampleCount) const
+    {
+        // both the mean and the variance accumulators decay
+        CatchUpSkippedSteps<ElementType>(parameter, *GetMatrix<ElementType>(gradientValue), smoothedGradientValue,
+                                         LearningRate(trainingSampleCount), MomentumValueForMB(trainingSampleCount), /*useNesterovMomentum*/ false,
+                                         /*hasVarianceAccumulator*/ true, VarianceMomentumValueForMB(trainingSampleCount));
+    }
+
+    LearnerAdam::LearnerAdam(const vector<Parameter>& parameters,
+                             const LearningRateSchedule& learningRateSchedule,
+                             const MomentumSchedule& momentumSchedule,
+                             const MomentumSchedule& varianceMomentumSchedule,
+                             double epsilon,
+                             double weightDecay,
+                             bool layerwiseAdaptive,
+                             AdditionalLearningOptions additionalOptions)
+                             : LearnerMomentumSGD(parameters, learningRateSchedule, momentumSchedule, additionalOptions, /*allocateSmoothGradients*/ false),
+                             m_varianceMomentumSchedule(varianceMomentumSchedule),
+                             m_epsilon(epsilon),
+                             m_weightDecay(weightDecay),
+                             m_layerwiseAdaptive(layerwiseAdaptive)
+    {
+        if (epsilon <= 0)
+            InvalidArgument("Adam learner: epsilon (%g) must be positive.", epsilon);
+        if (weightDecay < 0)
+            InvalidArgument("Adam learner: weight decay (%g) must not be negative.", weightDecay);
+
+        for (const auto& parameter : parameters)
+        {
+            const auto shape = GetMatrixShape(parameter);
+            NDArrayViewPtr view = AllocateNDArrayView(parameter, { shape[0], 2 * shape[1] });
+            m_smoothedGradientValues.insert(make_pair(parameter, view));
+        }
+    }
+
+    /*virtual*/ void LearnerAdam::Update(const Parameter& parameter, const NDArrayViewPtr& gradientValue, const NDArrayViewPtr& smoothedGradientValue, size_t trainingSampleCount) const /*override*/
+    {
+        UPDATE_FUNCTION;
+    }
+
+    template <typename ElementType>
+    void LearnerAdam::Update(const Parameter& parameter, const NDArrayViewPtr& gradientValue, const NDArrayViewPtr& smoothedGradientValue, size_t trainingSampleCount) const
+    {
+        const auto& parameterValue = parameter.Value();
+        const auto& smoothedGradientMatrix = GetWritableMatrix<ElementType>(smoothedGradientValue);
+        const auto& gradientMatrix = GetWritableMatrix<ElementType>(gradientValue);
+        const auto& parameterMatrix = GetWritableMatrix<ElementType>(parameterValue);
+
+        const auto learningRate = LearningRate(trainingSampleCount);
+        const auto momentum = MomentumValueForMB(trainingSampleCount);
+
+        const auto varMomentum = VarianceMomentumValueForMB(trainingSampleCount);
+
+        // the minibatch count is incremented after the update of all parameters
+        const size_t timestep = m_minibatchCount + 1;
+
+        smoothedGradientMatrix->AdamUpdate(*gradientMatrix, *parameterMatrix, timestep, learningRate, momentum, varMomentum, m_epsilon, m_weightDecay,
+                                           /*updateFunctionValues*/ !m_layerwiseAdaptive);
+        if (!m_layerwiseAdaptive)
+            return;
+
+        // LAMB: the gradient now holds the Adam step, which is scaled by the trust ratio ||parameter|| / ||step||
+        const double parameterNorm = parameterMatrix->FrobeniusNorm();
+        const double stepNorm = gradientMatrix->FrobeniusNorm();
+        const double trustRatio = (parameterNorm > 0 && stepNorm > 0) ? parameterNorm / stepNorm : 1.0;
+        Matrix<ElementType>::ScaleAndAdd(ElementType(-learningRate * trustRatio), *gradientMatrix, *parameterMatrix);
+    }
+
     LearnerRMSProp::LearnerRMSProp(const vector<Parameter>& parameters,
                                    const LearningRateSchedule& learningRateSchedule,
                                    double gamma, double inc, double dec, double max, double min,
@@ -534,6 +916,33 @@ namespace CNTK
         Matrix<ElementType>::ScaleAndAdd(ElementType(-learningRate / aveMultiplier), *gradientMatrix, *parameterMatrix);
     }
 
+    /*virtual*/ void LearnerRMSProp::MultiTensorUpdate(const vector<Parameter>& parameters, const vector<NDArrayViewPtr>& gradientValues,
+                                                       const vector<NDArrayViewPtr>& smoothedGradientValues, size_t trainingSampleCount) const /*override*/
+    {
+        MULTI_TENSOR_UPDATE_FUNCTION;
+    }
+
+    template <typename ElementType>
+    void LearnerRMSProp::MultiTensorUpdate(const vector<Parameter>& parameters, const vector<NDArrayViewPtr>& gradientValues,
+                                           const vector<NDArrayViewPtr>& smoothedGradientValues, size_t trainingSampleCount) const
+    {
+        assert(!m_needAveMultiplier);
+
+        vector<shared_ptr<Matrix<ElementType>>> matrices;
+        vector<Matrix<ElementType>*> parameterMatrices, gradientMatrices, smoothedGradientMatrices;
+        GetWritableMatrices<ElementType>(parameters, gradientValues, smoothedGradientValues, matrices, parameterMatrices, gradientMatrices, smoothedGradientMatrices);
+
+        const auto learningRate = LearningRate(trainingSampleCount);
+
+        Matrix<ElementType>::MultiRmsProp(smoothedGradientMatrices, gradientMatrices, parameterMatrices, ElementType(learningRate),
+                                          ElementType(m_gamma),
+                                          ElementType(m_inc),
+                                          ElementType(m_max),
+                                          ElementType(m_dec),
+                                          ElementType(m_min),
+                                          FusedRegularization<ElementType>(trainingSampleCount));
+    }
+
     // Explicit template instantiations
     template shared_ptr<Matrix<float>> LearnerBase::GetWritableMatrix<float>(const NDArrayViewPtr& arrayView);
     template shared_ptr<Matrix<double>> LearnerBase::GetWritableMatrix<double>(const NDArrayViewPtr& arrayView);
@@ -570,11 +979,36 @@ namespace CNTK
     {
         if (!lowMemory)
         {
-            LogicError("AdamLearner: only the low-memory variant is supported at the moment.");
+            return MakeSharedObject<LearnerAdam>(parameters, learningRateSchedule, momentumSchedule, varianceMomentumSchedule,
+                                                 /*epsilon*/ 1e-8, /*weightDecay*/ 0.0, /*layerwiseAdaptive*/ false, additionalOptions);
         }
         return MakeSharedObject<LearnerFSAdaGrad>(parameters, learningRateSchedule, momentumSchedule, varianceMomentumSchedule, additionalOptions);
     }
 
+    LearnerPtr AdamWLearner(const vector<Parameter>& parameters,
+                            const LearningRateSchedule& learningRateSchedule,
+                            const MomentumSchedule& momentumSchedule,
+                            const MomentumSchedule& varianceMomentumSchedule,
+                            double weightDecay,
+                            double epsilon, /*= 1e-8*/
+                            AdditionalLearningOptions additionalOptions /*= AdditionalLearningOptions()*/)
+    {
+        return MakeSharedObject<LearnerAdam>(parameters, learningRateSchedule, momentumSchedule, varianceMomentumSchedule,
+                                             epsilon, weightDecay, /*layerwiseAdaptive*/ false, additionalOptions);
+    }
+
+    LearnerPtr LAMBLearner(const vector<Parameter>& parameters,
+                           const LearningRateSchedule& learningRateSchedule,
+                           const MomentumSchedule& momentumSchedule,
+                           const MomentumSchedule& varianceMomentumSchedule,
+                           double weightDecay,
+                           double epsilon, /*= 1e-6*/
+                           AdditionalLearningOptions additionalOptions /*= AdditionalLearningOptions()*/)
+    {
+        return MakeSharedObject<LearnerAdam>(parameters, learningRateSchedule, momentumSchedule, varianceMomentumSchedule,
+                                             epsilon, weightDecay, /*layerwiseAdaptive*/ true, additionalOptions);
+    }
+
     LearnerPtr AdaGradLearner(const vector<Parameter>& parameters,
                               const LearningRateSchedule& learningRateSchedule,
                               bool needAveMultiplier /*= true*/,
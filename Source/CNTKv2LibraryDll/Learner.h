@@ -9,6 +9,11 @@
 #include "CNTKLibrary.h"
 #include <numeric>
 
+namespace Microsoft { namespace MSR { namespace CNTK {
+    template <class ElemType>
+    struct UpdateRegularization;
+}}}
+
 namespace CNTK 
 {
     // An abstract base class at the root of the standard learners hierarchy
@@ -19,6 +24,13 @@ namespace CNTK
     public:
         virtual bool Update(std::unordered_map<Parameter, NDArrayViewPtr>& gradientValues, size_t trainingSampleCount) override final;
 
+        // Update() one parameter at a time, e.g. as the gradients arrive from the other workers: BeginUpdate() returns whether the
+        // minibatch updates anything, if so UpdateParameter() is called once for each parameter in any order, and EndUpdate() completes
+        // the minibatch. The parameters are not updated together as with SupportsMultiTensorUpdate().
+        bool BeginUpdate(size_t trainingSampleCount) const;
+        void UpdateParameter(const Parameter& parameter, const NDArrayViewPtr& gradientValue, size_t trainingSampleCount);
+        void EndUpdate(size_t trainingSampleCount);
+
         virtual Dictionary CreateCheckpoint() override final;
 
         virtual size_t CurrentVersion() const override final { return s_serializationVersion; }
@@ -39,6 +51,27 @@ namespace CNTK
 
         virtual void Update(const Parameter& parameter, const NDArrayViewPtr& gradientValue, const NDArrayViewPtr& smoothedGradientValue, size_t trainingSampleCount) const = 0;
 
+        // Learners that return true here update the parameters with dense gradients of each data type and device together, with
+        // MultiTensorUpdate() (on the GPU, a few kernel launches for all of them) instead of Update(), after preprocessing each gradient.
+        // MultiTensorUpdate() applies the regularization of FusedRegularization() in the same pass.
+        virtual bool SupportsMultiTensorUpdate() const { return false; }
+
+        virtual void MultiTensorUpdate(const std::vector<Parameter>& /*parameters*/, const std::vector<NDArrayViewPtr>& /*gradientValues*/,
+                                       const std::vector<NDArrayViewPtr>& /*smoothedGradientValues*/, size_t /*trainingSampleCount*/) const
+        {
+            NOT_IMPLEMENTED;
+        }
+
+        // Sparse (SparseBlockCol) gradients only update the columns of a parameter they hold. Learners whose smoothed gradients decay
+        // in every minibatch catch up the other columns lazily here, before the update: the columns of 'gradientValue' if it is sparse,
+        // all columns if it is dense. The default does nothing.
+        virtual void CatchUpLazyMomentum(const Parameter& /*parameter*/, const NDArrayViewPtr& /*gradientValue*/, const NDArrayViewPtr& /*smoothedGradientValue*/, size_t /*trainingSampleCount*/) const {}
+
+        // Implements CatchUpLazyMomentum() with Matrix::CatchUpLazyMomentum(), tracking the last update of each column in m_lastSparseUpdates.
+        template <typename ElementType>
+        void CatchUpSkippedSteps(const Parameter& parameter, const Microsoft::MSR::CNTK::Matrix<ElementType>& gradient, const NDArrayViewPtr& smoothedGradientValue,
+                                 double learningRate, double momentum, bool useNesterovMomentum, bool hasVarianceAccumulator = false, double varMomentum = 0.0) const;
+
         std::string LearnerType() const;
 
         // Returns current (per-sample) learning rate.
@@ -58,6 +91,9 @@ namespace CNTK
 
         std::unordered_map<Parameter, NDArrayViewPtr> m_smoothedGradientValues;
 
+        // for the parameters whose columns are caught up lazily: the minibatch at which each column was last updated, [1 x #columns]
+        mutable std::unordered_map<Parameter, NDArrayViewPtr> m_lastSparseUpdates;
+
         // The following four static protected methods expose private methods of NDArrayView class
         // (which declares LearnerBase as friend class), so that they are available to subclasses.
         template <typename ElementType>
@@ -72,18 +108,32 @@ namespace CNTK
         template <typename ElementType>
         static Microsoft::MSR::CNTK::TensorView<ElementType>* GetWritableTensorView(const NDArrayViewPtr& arrayView);
 
+        // Gets the matrices of the parameters, gradients and smoothed gradients of MultiTensorUpdate(), which 'matrices' keeps alive.
+        template <typename ElementType>
+        static void GetWritableMatrices(const std::vector<Parameter>& parameters, const std::vector<NDArrayViewPtr>& gradientValues, const std::vector<NDArrayViewPtr>& smoothedGradientValues,
+                                        std::vector<std::shared_ptr<Microsoft::MSR::CNTK::Matrix<ElementType>>>& matrices,
+                                        std::vector<Microsoft::MSR::CNTK::Matrix<ElementType>*>& parameterMatrices,
+                                        std::vector<Microsoft::MSR::CNTK::Matrix<ElementType>*>& gradientMatrices,
+                                        std::vector<Microsoft::MSR::CNTK::Matrix<ElementType>*>& smoothedGradientMatrices);
+
         template <typename ElementType>
         void ClipGradient(Microsoft::MSR::CNTK::Matrix<ElementType>& gradient, size_t actualMBSize) const;
 
         // Performs additional preprocessing before calling the update method 
-        // (gradient clipping and L2 regularization depending on the additional learning parameters).
+        // (gradient clipping, L2 regularization and weight decay depending on the additional learning parameters).
+        // With 'regularizationFused', the update applies the regularization of FusedRegularization() instead.
         template <typename ElementType>
-        void PreProcess(const NDArrayViewPtr& parameterValue, const NDArrayViewPtr& gradientValue, size_t actualMBSize) const;
+        void PreProcess(const NDArrayViewPtr& parameterValue, const NDArrayViewPtr& gradientValue, size_t actualMBSize, bool regularizationFused = false) const;
 
         // Performs additional postprocessing after the update method has been executed
         // (noise injection and L1 regularization specified by the additional learning parameters).
         template <typename ElementType>
-        void PostProcess(const Parameter& parameter, const NDArrayViewPtr& gradientValue, size_t actualMBSize) const;
+        void PostProcess(const Parameter& parameter, const NDArrayViewPtr& gradientValue, size_t actualMBSize, bool regularizationFused = false) const;
+
+        // The regularization that MultiTensorUpdate() applies in its pass over the parameters. L1 regularization follows noise
+        // injection, so it is left to PostProcess() with noise.
+        template <typename ElementType>
+        Microsoft::MSR::CNTK::UpdateRegularization<ElementType> FusedRegularization(size_t actualMBSize) const;
 
         // Returns an NDArrayView with the required shape, with the same data type as parameter value
         // and allocated on the same device.
@@ -100,6 +150,16 @@ namespace CNTK
         template <typename ElementType>
         void Update(const Parameter& parameter, const NDArrayViewPtr& gradientValue, const NDArrayViewPtr& smoothedGradientValue, size_t trainingSampleCount) const;
 
+        // Updates the parameters with dense gradients whose data type and device they share with others by MultiTensorUpdate(),
+        // and adds them to 'updatedParameters'.
+        void UpdateDenseParametersTogether(const std::unordered_map<Parameter, NDArrayViewPtr>& gradientValues, size_t trainingSampleCount,
+                                           std::unordered_set<Parameter>& updatedParameters) const;
+
+        // Templatized counterpart of the update function above for the parameters of one data type on one device.
+        template <typename ElementType>
+        void UpdateTogether(const std::vector<Parameter>& parameters, const std::vector<NDArrayViewPtr>& gradientValues,
+                            const std::vector<NDArrayViewPtr>& smoothedGradientValues, size_t trainingSampleCount) const;
+
         // TODO: make these functions friends of NDViewArray and move to Utils?
         static bool HasNan(const NDArrayViewPtr& value, const char* name);
         static void Print(const NDArrayViewPtr& value, const char* msg);
@@ -135,6 +195,20 @@ namespace CNTK
 
         template <typename ElementType>
         void Update(const Parameter& parameter, const NDArrayViewPtr& gradientValue, const NDArrayViewPtr& smoothedGradientValue, size_t trainingSampleCount) const;
+
+        virtual bool SupportsMultiTensorUpdate() const override { return true; }
+
+        virtual void MultiTensorUpdate(const std::vector<Parameter>& parameters, const std::vector<NDArrayViewPtr>& gradientValues,
+                                       const std::vector<NDArrayViewPtr>& smoothedGradientValues, size_t trainingSampleCount) const override;
+
+        template <typename ElementType>
+        void MultiTensorUpdate(const std::vector<Parameter>& parameters, const std::vector<NDArrayViewPtr>& gradientValues,
+                               const std::vector<NDArrayViewPtr>& smoothedGradientValues, size_t trainingSampleCount) const;
+
+        virtual void CatchUpLazyMomentum(const Parameter& parameter, const NDArrayViewPtr& gradientValue, const NDArrayViewPtr& smoothedGradientValue, size_t trainingSampleCount) const override;
+
+        template <typename ElementType>
+        void CatchUpLazyMomentum(const Parameter& parameter, const NDArrayViewPtr& gradientValue, const NDArrayViewPtr& smoothedGradientValue, size_t trainingSampleCount) const;
     };
 
     // SGD optimization with momentum. 
@@ -197,6 +271,16 @@ namespace CNTK
 
         template <typename ElementType>
         void Update(const Parameter& parameter, const NDArrayViewPtr& gradientValue, const NDArrayViewPtr& smoothedGradientValue, size_t trainingSampleCount) const;
+
+        // the average multiplier is a reduction over each parameter
+        virtual bool SupportsMultiTensorUpdate() const override { return !m_needAveMultiplier; }
+
+        virtual void MultiTensorUpdate(const std::vector<Parameter>& parameters, const std::vector<NDArrayViewPtr>& gradientValues,
+                                       const std::vector<NDArrayViewPtr>& smoothedGradientValues, size_t trainingSampleCount) const override;
+
+        template <typename ElementType>
+        void MultiTensorUpdate(const std::vector<Parameter>& parameters, const std::vector<NDArrayViewPtr>& gradientValues,
+                               const std::vector<NDArrayViewPtr>& smoothedGradientValues, size_t trainingSampleCount) const;
     };
 
     class LearnerFSAdaGrad : public LearnerMomentumSGD
@@ -216,6 +300,18 @@ namespace CNTK
         template <typename ElementType>
         void Update(const Parameter& parameter, const NDArrayViewPtr& gradientValue, const NDArrayViewPtr& smoothedGradientValue, size_t trainingSampleCount) const;
 
+        virtual void MultiTensorUpdate(const std::vector<Parameter>& parameters, const std::vector<NDArrayViewPtr>& gradientValues,
+                                       const std::vector<NDArrayViewPtr>& smoothedGradientValues, size_t trainingSampleCount) const override;
+
+        template <typename ElementType>
+        void MultiTensorUpdate(const std::vector<Parameter>& parameters, const std::vector<NDArrayViewPtr>& gradientValues,
+                               const std::vector<NDArrayViewPtr>& smoothedGradientValues, size_t trainingSampleCount) const;
+
+        virtual void CatchUpLazyMomentum(const Parameter& parameter, const NDArrayViewPtr& gradientValue, const NDArrayViewPtr& smoothedGradientValue, size_t trainingSampleCount) const override;
+
+        template <typename ElementType>
+        void CatchUpLazyMomentum(const Parameter& parameter, const NDArrayViewPtr& gradientValue, const NDArrayViewPtr& smoothedGradientValue, size_t trainingSampleCount) const;
+
     private:
         static const double s_targetAdagradAvDenom;
 
@@ -229,6 +325,49 @@ namespace CNTK
         MomentumSchedule m_varianceMomentumSchedule;
     };
 
+    // Adam with bias correction, optionally with AdamW's decoupled weight decay, and with LAMB's scaling of the step of each
+    // parameter by the ratio of the norms of the parameter and of the step if 'layerwiseAdaptive'. The smoothed gradients are laid out as
+    // for FSAdaGrad: the variance accumulators followed by the mean accumulators. The bias correction uses the minibatch count, which
+    // is checkpointed by LearnerBase. The columns of a parameter without sparse gradients in a minibatch keep their accumulators (as
+    // "lazy" Adam does).
+    class LearnerAdam : public LearnerMomentumSGD
+    {
+    public:
+
+        LearnerAdam(const std::vector<Parameter>& parameters,
+                    const LearningRateSchedule& learningRateSchedule,
+                    const MomentumSchedule& momentumSchedule,
+                    const MomentumSchedule& varianceMomentumSchedule,
+                    double epsilon,
+                    double weightDecay,
+                    bool layerwiseAdaptive,
+                    AdditionalLearningOptions additionalOptions);
+
+    protected:
+
+        virtual void Update(const Parameter& parameter, const NDArrayViewPtr& gradientValue, const NDArrayViewPtr& smoothedGradientValue, size_t trainingSampleCount) const override;
+
+        template <typename ElementType>
+        void Update(const Parameter& parameter, const NDArrayViewPtr& gradientValue, const NDArrayViewPtr& smoothedGradientValue, size_t trainingSampleCount) const;
+
+        // the update rules of LearnerMomentumSGD do not apply
+        virtual bool SupportsMultiTensorUpdate() const override { return false; }
+
+        virtual void CatchUpLazyMomentum(const Parameter& /*parameter*/, const NDArrayViewPtr& /*gradientValue*/, const NDArrayViewPtr& /*smoothedGradientValue*/, size_t /*trainingSampleCount*/) const override {}
+
+    private:
+        // returns current per-minibatch variance momentum value.
+        double VarianceMomentumValueForMB(size_t minibatchSize) const
+        {
+            return MomentumValueForMB(m_varianceMomentumSchedule, minibatchSize);
+        }
+
+        MomentumSchedule m_varianceMomentumSchedule;
+        double m_epsilon;
+        double m_weightDecay;
+        bool m_layerwiseAdaptive;
+    };
+
     class LearnerRMSProp : public LearnerBase
     {
     public:
@@ -252,5 +391,15 @@ namespace CNTK
 
         template <typename ElementType>
         void Update(const Parameter& parameter, const NDArrayViewPtr& gradientValue, const NDArrayViewPtr& smoothedGradientValue, size_t trainingSampleCount) const;
+
+        // the average multiplier is a reduction over each parameter
+        virtual bool SupportsMultiTensorUpdate() const override { return !m_needAveMultiplier; }
+
+        virtual void MultiTensorUpdate(const std::vector<Parameter>& parameters, const std::vector<NDArrayViewPtr>& gradientValues,
+                                       const std::vector<NDArrayViewPtr>& smoothedGradientValues, size_t trainingSampleCount) const override;
+
+        template <typename ElementType>
+        void MultiTensorUpdate(const std::vector<Parameter>& parameters, const std::vector<NDArrayViewPtr>& gradientValues,
+                               const std::vector<NDArrayViewPtr>& smoothedGradientValues, size_t trainingSampleCount) const;
     };
 }
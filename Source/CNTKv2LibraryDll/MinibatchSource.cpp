@@ -73,6 +73,7 @@ namespace CNTK
     CompositeMinibatchSource::CompositeMinibatchSource(const Dictionary& configuration)
         : m_epochEndReached(false),
           m_prevMinibatchSize(0),
+          m_device(DeviceDescriptor::CPUDevice()),
           m_epochSize(MinibatchSource::InfinitelyRepeat),
           m_truncationLength(0),
           m_numWorkers(1),
@@ -141,6 +142,12 @@ namespace CNTK
         else if (m_epochSize == MinibatchSource::InfinitelyRepeat)
             m_epochSize = std::numeric_limits<size_t>::max()/2;
 
+        // The next minibatches are read, packed and uploaded to the device in the background ('prefetch', on by default),
+        // 'prefetchDepth' of them ahead. The reader shim reads these settings from the configuration.
+        const wchar_t* prefetchDepthConfigurationKey = L"prefetchDepth";
+        if (augmentedConfiguration.Contains(prefetchDepthConfigurationKey) && (augmentedConfiguration[prefetchDepthConfigurationKey].Value<size_t>() == 0))
+            InvalidArgument("The prefetch depth of a MinibatchSource must be at least 1");
+
         const wchar_t* truncatedConfigurationKey = L"truncated";
         const wchar_t* truncationLengthConfigurationKey = L"truncationLength";
         if (augmentedConfiguration.Contains(truncatedConfigurationKey) &&
@@ -217,8 +224,14 @@ namespace CNTK
                 }
             }
 
-            if (m_prevMinibatchSize == 0)
+            // The read-ahead buffers are on the device of the minibatches returned, so a change of the device restarts
+            // the reading at the current position
+            bool isDeviceChanged = (m_prevMinibatchSize != 0) && (device != m_device);
+            if ((m_prevMinibatchSize == 0) || isDeviceChanged)
             {
+                size_t samplePosition = m_shim->GetCurrentSamplePosition();
+                m_device = device;
+
                 EpochConfiguration epochConfig;
                 epochConfig.m_numberOfWorkers = m_distributed ? m_numWorkers : 1;
                 epochConfig.m_workerRank = m_distributed ? m_workerRank : 0;
@@ -253,6 +266,9 @@ namespace CNTK
                 }
 
                 m_shim->StartEpoch(epochConfig, inputs);
+                if (isDeviceChanged)
+                    m_shim->SetCurrentSamplePosition(samplePosition);
+
                 m_prevMinibatchSize = minibatchSizeInSamples;
                 wasDistributed = m_distributed;
             }
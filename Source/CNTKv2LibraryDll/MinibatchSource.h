@@ -54,6 +54,7 @@ namespace CNTK
         size_t m_workerRank;
         size_t m_distributedAfterSampleCount;
         size_t m_prevMinibatchSize;
+        DeviceDescriptor m_device; // the minibatches are read ahead and uploaded to this device
         size_t m_epochSize;
         size_t m_truncationLength;
         std::unordered_map<StreamInformation, MinibatchData> m_minibatchData;
@@ -19,7 +19,8 @@ namespace CNTK
     static TensorView<ElementType>* AllocateTensorView(const NDShape& viewShape,
                                                        const DeviceDescriptor& device,
                                                        void* dataBuffer,
-                                                       size_t bufferSizeInBytes)
+                                                       size_t bufferSizeInBytes,
+                                                       const std::shared_ptr<void>& bufferOwner)
     {
         if (dataBuffer == nullptr)
             InvalidArgument("Cannot create a NDArrayView over a null data buffer");
@@ -28,7 +29,15 @@ namespace CNTK
             InvalidArgument("Size of the specified buffer for creating the NDArrayView is smaller than the specified view shape");
 
         auto matrixDims = GetMatrixDimensions(viewShape);
-        std::shared_ptr<Matrix<ElementType>> matrix = std::make_shared<Matrix<ElementType>>(matrixDims.first, matrixDims.second, (ElementType*)dataBuffer, AsCNTKImplDeviceId(device), matrixFlagDontOwnBuffer);
+        std::shared_ptr<Matrix<ElementType>> matrix;
+        if (bufferOwner)
+        {
+            // the owner of the external buffer is released together with the last reference to the matrix over it
+            matrix = std::shared_ptr<Matrix<ElementType>>(new Matrix<ElementType>(matrixDims.first, matrixDims.second, (ElementType*)dataBuffer, AsCNTKImplDeviceId(device), matrixFlagDontOwnBuffer),
+                                                          [bufferOwner](Matrix<ElementType>* matrix) { delete matrix; });
+        }
+        else
+            matrix = std::make_shared<Matrix<ElementType>>(matrixDims.first, matrixDims.second, (ElementType*)dataBuffer, AsCNTKImplDeviceId(device), matrixFlagDontOwnBuffer);
         return new TensorView<ElementType>(matrix, AsTensorViewShape(viewShape));
     }
 
@@ -36,14 +45,15 @@ namespace CNTK
                                     const NDShape& viewShape,
                                     const DeviceDescriptor& device,
                                     void* dataBuffer,
-                                    size_t bufferSizeInBytes)
+                                    size_t bufferSizeInBytes,
+                                    const std::shared_ptr<void>& bufferOwner)
     {
         switch (dataType)
         {
         case DataType::Float:
-            return AllocateTensorView<float>(viewShape, device, dataBuffer, bufferSizeInBytes);
+            return AllocateTensorView<float>(viewShape, device, dataBuffer, bufferSizeInBytes, bufferOwner);
         case DataType::Double:
-            return AllocateTensorView<double>(viewShape, device, dataBuffer, bufferSizeInBytes);
+            return AllocateTensorView<double>(viewShape, device, dataBuffer, bufferSizeInBytes, bufferOwner);
         default:
             LogicError("Unsupported DataType %s", DataTypeName(dataType));
             break;
@@ -82,7 +92,12 @@ namespace CNTK
     }
 
     NDArrayView::NDArrayView(CNTK::DataType dataType, const NDShape& viewShape, void* dataBuffer, size_t bufferSizeInBytes, const DeviceDescriptor& device, bool readOnly/* = false*/)
-        : NDArrayView(dataType, device, StorageFormat::Dense, viewShape, readOnly, AllocateTensorView(dataType, viewShape, device, dataBuffer, bufferSizeInBytes))
+        : NDArrayView(dataType, device, StorageFormat::Dense, viewShape, readOnly, AllocateTensorView(dataType, viewShape, device, dataBuffer, bufferSizeInBytes, nullptr))
+    {
+    }
+
+    NDArrayView::NDArrayView(CNTK::DataType dataType, const NDShape& viewShape, void* dataBuffer, size_t bufferSizeInBytes, const DeviceDescriptor& device, bool readOnly, const std::shared_ptr<void>& bufferOwner)
+        : NDArrayView(dataType, device, StorageFormat::Dense, viewShape, readOnly, AllocateTensorView(dataType, viewShape, device, dataBuffer, bufferSizeInBytes, bufferOwner))
     {
     }
 
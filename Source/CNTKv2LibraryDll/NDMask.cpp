@@ -8,6 +8,7 @@
 #include "Utils.h"
 #include "Matrix.h"
 #include <algorithm>
+#include <numeric>
 #include "TensorShape.h"
 
 using namespace Microsoft::MSR::CNTK;
@@ -21,7 +22,7 @@ namespace CNTK
     }
 
     NDMask::NDMask(const NDShape& shape, Matrix<char>* matrix)
-        : m_device(AsDeviceDescriptor(matrix->GetDeviceId())), m_maskShape(shape)
+        : m_device(AsDeviceDescriptor(matrix->GetDeviceId())), m_maskShape(shape), m_hasSequenceRuns(false), m_isMatrixStale(false)
     {
         m_matrixView = std::shared_ptr<Matrix<char>>(matrix, [](Matrix<char>* ptr) { delete ptr; });
     }
@@ -55,11 +56,17 @@ namespace CNTK
 
         NDShape shape = sectionShape.AppendShape(NDShape(m_maskShape.Rank() - sectionShape.Rank(), NDShape::InferredDimension));
 
-        auto maskMatrix = GetMatrix();
+        auto maskMatrix = m_matrixView.get();
         size_t rowOffset = offset[0];
         size_t colOffset = offset[1];
         size_t sliceRowLength = (shape[0] != NDShape::InferredDimension) ? shape[0] : (maskMatrix->GetNumRows() - rowOffset);
         size_t sliceColLength = (shape[1] != NDShape::InferredDimension) ? shape[1] : (maskMatrix->GetNumCols() - colOffset);
+
+        // The sections that sequences are made of are marked in O(#sequences), without touching the matrix
+        if (MarkSequenceRunsAs(rowOffset, sliceRowLength, colOffset, sliceColLength, maskKind))
+            return;
+
+        DiscardSequenceRuns();
         if ((rowOffset == 0) && (sliceRowLength == maskMatrix->GetNumRows()))
             maskMatrix->ColumnSlice(colOffset, sliceColLength).SetValue((char)maskKind);
         else
@@ -74,14 +81,96 @@ namespace CNTK
         }
     }
 
+    bool NDMask::MarkSequenceRunsAs(size_t rowOffset, size_t sliceRowLength, size_t colOffset, size_t sliceColLength, MaskKind maskKind)
+    {
+        if (!m_hasSequenceRuns)
+            return false;
+
+        size_t numSteps = m_maskShape[0];
+        size_t colEnd = colOffset + sliceColLength;
+        if ((maskKind == MaskKind::Invalid) && ((rowOffset + sliceRowLength) == numSteps))
+        {
+            // cut the sequences at 'rowOffset'
+            for (size_t i = colOffset; i < colEnd; ++i)
+            {
+                m_sequenceLengths[i] = std::min(m_sequenceLengths[i], rowOffset);
+                if (m_sequenceLengths[i] == 0)
+                    m_sequenceBeginFlags[i] = false;
+            }
+        }
+        else if ((maskKind == MaskKind::SequenceBegin) && (rowOffset == 0) && (sliceRowLength == 1))
+        {
+            if (std::find(m_sequenceLengths.begin() + colOffset, m_sequenceLengths.begin() + colEnd, 0) != m_sequenceLengths.begin() + colEnd)
+                return false; // (a sequence begin after a masked step)
+
+            for (size_t i = colOffset; i < colEnd; ++i)
+                m_sequenceBeginFlags[i] = true;
+        }
+        else if ((maskKind == MaskKind::Valid) && (sliceRowLength > 0))
+        {
+            // extend the sequences to 'rowOffset + sliceRowLength'; a gap of masked steps cannot be represented
+            for (size_t i = colOffset; i < colEnd; ++i)
+            {
+                if (rowOffset > m_sequenceLengths[i])
+                    return false;
+            }
+
+            for (size_t i = colOffset; i < colEnd; ++i)
+            {
+                m_sequenceLengths[i] = std::max(m_sequenceLengths[i], rowOffset + sliceRowLength);
+                if (rowOffset == 0)
+                    m_sequenceBeginFlags[i] = false;
+            }
+        }
+        else
+            return false;
+
+        m_isMatrixStale = true;
+        return true;
+    }
+
+    void NDMask::DiscardSequenceRuns()
+    {
+        GetMatrix(); // (brings the matrix up to date)
+        m_hasSequenceRuns = false;
+        m_sequenceBeginFlags.clear();
+        m_sequenceLengths.clear();
+    }
+
+    bool NDMask::GetSequenceRuns(std::vector<bool>& sequenceBeginFlags, std::vector<size_t>& sequenceLengths) const
+    {
+        if (!m_hasSequenceRuns)
+            return false;
+
+        sequenceBeginFlags = m_sequenceBeginFlags;
+        sequenceLengths = m_sequenceLengths;
+        return true;
+    }
+
     void NDMask::Clear()
     {
         // Clear the mask by marking all samples as Valid
-        GetMatrix()->SetValue((char)MaskKind::Valid);
+        if (m_maskShape.Rank() == 2)
+        {
+            m_hasSequenceRuns = true;
+            m_isMatrixStale = true;
+            m_sequenceBeginFlags.assign(m_maskShape[1], false);
+            m_sequenceLengths.assign(m_maskShape[1], m_maskShape[0]);
+        }
+        else
+            GetMatrix()->SetValue((char)MaskKind::Valid);
     }
 
     size_t NDMask::MaskedCount() const
     {
+        if (m_hasSequenceRuns)
+        {
+            size_t numSteps = m_maskShape[0];
+            return std::accumulate(m_sequenceLengths.begin(), m_sequenceLengths.end(), (size_t)0, [numSteps](size_t count, size_t length) {
+                return count + (numSteps - length);
+            });
+        }
+
         auto maskMatrix = GetMatrix();
         std::unique_ptr<char[]> maskData(maskMatrix->CopyToArray());
         return std::count_if(maskData.get(), maskData.get() + maskMatrix->GetNumElements(), [](const char& val) {
@@ -100,6 +189,24 @@ namespace CNTK
 
     Matrix<char>* NDMask::GetMatrix() const
     {
+        if (m_isMatrixStale)
+        {
+            // Write the sequence runs into the matrix with a single transfer
+            size_t numSteps = m_maskShape[0];
+            size_t numSequences = m_maskShape[1];
+            std::vector<char> maskData(numSteps * numSequences, (char)MaskKind::Invalid);
+            for (size_t i = 0; i < numSequences; ++i)
+            {
+                auto sequenceBegin = maskData.begin() + (i * numSteps);
+                std::fill(sequenceBegin, sequenceBegin + m_sequenceLengths[i], (char)MaskKind::Valid);
+                if (m_sequenceBeginFlags[i])
+                    *sequenceBegin = (char)MaskKind::SequenceBegin;
+            }
+
+            m_matrixView->SetValue(numSteps, numSequences, m_matrixView->GetDeviceId(), maskData.data());
+            m_isMatrixStale = false;
+        }
+
         return m_matrixView.get();
     }
 
@@ -108,7 +215,21 @@ namespace CNTK
         if (source.Shape() != Shape())
             InvalidArgument("NDMask::CopyFrom: The 'source' mask's shape must be same as the shape of this NDMask");
 
-        GetMatrix()->AssignValuesOf(*source.GetMatrix());
+        if (source.m_hasSequenceRuns)
+        {
+            m_hasSequenceRuns = true;
+            m_isMatrixStale = true;
+            m_sequenceBeginFlags = source.m_sequenceBeginFlags;
+            m_sequenceLengths = source.m_sequenceLengths;
+        }
+        else
+        {
+            m_hasSequenceRuns = false;
+            m_isMatrixStale = false;
+            m_sequenceBeginFlags.clear();
+            m_sequenceLengths.clear();
+            m_matrixView->AssignValuesOf(*source.GetMatrix());
+        }
     }
 
     NDMaskPtr NDMask::DeepClone(const DeviceDescriptor& device) const
@@ -121,6 +242,8 @@ namespace CNTK
 
     NDMaskPtr NDMask::Alias() const
     {
+        // The alias shares the matrix only, so 'this' mask is kept in the matrix from now on
+        const_cast<NDMask*>(this)->DiscardSequenceRuns();
         return MakeSharedObject<NDMask>(this->Shape(), new Matrix<char>(GetMatrix()->AsReference()));
     }
 }
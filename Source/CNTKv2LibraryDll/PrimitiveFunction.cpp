@@ -67,6 +67,8 @@ namespace CNTK
     /*static*/ const std::wstring PrimitiveFunction::AttributeNameNumLayers = L"numLayers";
     /*static*/ const std::wstring PrimitiveFunction::AttributeNameHiddenSize = L"hiddenSize";
     /*static*/ const std::wstring PrimitiveFunction::AttributeNameRecurrentOp = L"recurrentOp";
+    /*static*/ const std::wstring PrimitiveFunction::AttributeNameTopK = L"topK";
+    /*static*/ const std::wstring PrimitiveFunction::AttributeNameOutputIndices = L"outputIndices";
     /*static*/ const std::wstring PrimitiveFunction::AttributeNameRngSeed = L"rngSeed";
     /*static*/ const std::wstring PrimitiveFunction::AttributeNameRngOffset = L"rngOffset";
 
@@ -547,6 +549,18 @@ namespace CNTK
 
                 break;
             }
+            case PrimitiveOpType::TopK:
+            {
+                assert(inputs.size() == 1);
+                auto k = functionConfig[PrimitiveFunction::AttributeNameTopK].Value<size_t>();
+                if (k == 0)
+                    InvalidArgument("TopK: k must be at least 1.");
+                if (!inputs[0].Shape().HasInferredDimension() && (k > inputs[0].Shape().TotalSize()))
+                    InvalidArgument("TopK: k (%lu) must not exceed the size of the operand (%lu).", k, inputs[0].Shape().TotalSize());
+
+                outputShape = NDShape({ k });
+                break;
+            }
             case PrimitiveOpType::OptimizedRNNStack:
             {
                 assert(inputs.size() == 2);
@@ -637,7 +651,7 @@ namespace CNTK
         // The hard requirement that the serialization depends on is that
         // new op type values are only added to the end of the list, after Combine.
         // This also applies to other enums (DataType, VariableKind, etc.)
-        if (op > PrimitiveOpType::Pass)
+        if (op > PrimitiveOpType::TopK)
         {
             LogicError("Unexpected op '%ls':'%u' (%s).", 
                         opKey.c_str(), 
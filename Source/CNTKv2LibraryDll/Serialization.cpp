@@ -6,11 +6,14 @@
 #include "stdafx.h"
 #include "CNTKLibrary.h"
 #include "Utils.h"
+#include "Serialization.h"
 #include <istream>
 #include <ostream>
 #include <string>
 #include <vector>
 #include <limits>
+#include <algorithm>
+#include <cstring>
 
 #ifdef _MSC_VER
 #include <io.h>
@@ -38,6 +41,9 @@ namespace CNTK
         friend class Dictionary;
         friend class DictionaryValue;
 
+        friend void SaveStreamedModel(Dictionary& model, std::ostream& stream);
+        friend Dictionary LoadStreamedModel(std::istream& stream);
+
     private:
         static proto::DictionaryValue* CreateProto(const DictionaryValue& src, Arena* arena = nullptr);
         static proto::Dictionary* CreateProto(const Dictionary& src, Arena* arena = nullptr);
@@ -55,6 +61,27 @@ namespace CNTK
         static void Copy(const DictionaryValue& src, proto::DictionaryValue& dst, Arena* arena = nullptr);
         static void Copy(const proto::DictionaryValue& src, DictionaryValue& dst);
 
+        static void ExtractPayloads(DictionaryValue& value, std::vector<DictionaryValue>& payloads);
+        static void FindPayloadReferences(DictionaryValue& value, std::vector<DictionaryValue*>& references);
+        static void ExtractPayloads(Dictionary& dictionary, std::vector<DictionaryValue>& payloads)
+        {
+            for (auto& kv : *dictionary.m_dictionaryData)
+                ExtractPayloads(kv.second, payloads);
+        }
+        static void FindPayloadReferences(Dictionary& dictionary, std::vector<DictionaryValue*>& references)
+        {
+            for (auto& kv : *dictionary.m_dictionaryData)
+                FindPayloadReferences(kv.second, references);
+        }
+        // takes over 'view' without copying it, unlike DictionaryValue(const NDArrayView&)
+        static void SetValue(DictionaryValue& dst, NDArrayView* view)
+        {
+            DictionaryValue value;
+            value.m_valueType = DictionaryValue::Type::NDArrayView;
+            value.m_data.m_ptr = view;
+            dst = std::move(value);
+        }
+
         static proto::NDArrayView::DataType ToProtoType(DataType type)
         {
             if (!proto::NDArrayView::DataType_IsValid((int)type))
@@ -371,6 +398,67 @@ namespace CNTK
         }
     }
 
+    static const std::wstring s_payloadTypeValue = L"TensorPayload";
+
+    // Dense tensors are replaced by a dictionary that refers to their payload.
+    /*static*/ void Serializer::ExtractPayloads(DictionaryValue& value, std::vector<DictionaryValue>& payloads)
+    {
+        switch (value.ValueType())
+        {
+        case DictionaryValue::Type::NDArrayView:
+        {
+            const auto& view = value.Value<NDArrayView>();
+            if (view.GetStorageFormat() != StorageFormat::Dense ||
+                (view.GetDataType() != DataType::Float && view.GetDataType() != DataType::Double))
+                break;
+
+            Dictionary reference;
+            reference[typeKey] = s_payloadTypeValue;
+            reference[payloadIndexKey] = payloads.size();
+            reference[dataTypeKey] = static_cast<size_t>(view.GetDataType());
+            reference[shapeKey] = view.Shape();
+            payloads.push_back(std::move(value));
+            value = DictionaryValue(std::move(reference));
+            break;
+        }
+        case DictionaryValue::Type::Vector:
+            for (auto& element : value.Value<std::vector<DictionaryValue>>())
+                ExtractPayloads(element, payloads);
+            break;
+        case DictionaryValue::Type::Dictionary:
+            ExtractPayloads(value.Value<Dictionary>(), payloads);
+            break;
+        default:
+            break;
+        }
+    }
+
+    /*static*/ void Serializer::FindPayloadReferences(DictionaryValue& value, std::vector<DictionaryValue*>& references)
+    {
+        if (value.ValueType() == DictionaryValue::Type::Vector)
+        {
+            for (auto& element : value.Value<std::vector<DictionaryValue>>())
+                FindPayloadReferences(element, references);
+        }
+        else if (value.ValueType() == DictionaryValue::Type::Dictionary)
+        {
+            auto& dictionary = value.Value<Dictionary>();
+            if (!dictionary.Contains(typeKey) || dictionary[typeKey].ValueType() != DictionaryValue::Type::String ||
+                dictionary[typeKey].Value<std::wstring>() != s_payloadTypeValue)
+            {
+                FindPayloadReferences(dictionary, references);
+                return;
+            }
+
+            auto index = dictionary[payloadIndexKey].Value<size_t>();
+            if (references.size() <= index)
+                references.resize(index + 1, nullptr);
+            if (references[index] != nullptr)
+                RuntimeError("Corrupt model file: Tensor payload %d is referenced twice.", (int)index);
+            references[index] = &value;
+        }
+    }
+
     static void SetUTF8Locale()
     {   
 #ifndef _MSC_VER
@@ -472,6 +560,108 @@ namespace CNTK
         return stream;
     }
 
+    // Streamed model files
+    // The protobuf of a model holds a copy of every tensor, so that saving took three times the size of the model,
+    // and loading twice. Streamed model files hold the model dictionary with its tensors replaced by references, and
+    // after it the raw elements of the tensors, which are written from and read into the NDArrayViews directly:
+    //  - magic (s_streamedModelMagic)
+    //  - uint64 size of the protobuf, the protobuf
+    //  - uint64 number of tensors, the elements of each, in the order of their payload index
+    // (Sparse tensors stay in the protobuf.)
+    static const char s_streamedModelMagic[8] = { 'C', 'N', 'T', 'K', 'V', '2', 'S', 1 };
+    static const size_t s_payloadChunkSize = 64 * 1024 * 1024; // bytes per read() or write()
+
+    bool IsStreamedModel(std::istream& stream)
+    {
+        char buffer[sizeof(s_streamedModelMagic)] = {};
+        const auto position = stream.tellg();
+        stream.read(buffer, sizeof(buffer));
+        bool isStreamed = stream.gcount() == sizeof(buffer) && memcmp(buffer, s_streamedModelMagic, sizeof(buffer)) == 0;
+        stream.clear();
+        stream.seekg(position);
+        return isStreamed;
+    }
+
+    void SaveStreamedModel(Dictionary& model, std::ostream& stream)
+    {
+        UsingUTF8 locale;
+        std::vector<DictionaryValue> payloads;
+        Serializer::ExtractPayloads(model, payloads);
+
+        std::string metadata;
+        {
+            Arena arena;
+            proto::Dictionary* proto(Serializer::CreateProto(model, &arena));
+            if (!proto->SerializeToString(&metadata))
+                RuntimeError("Failed to serialize the model.");
+        }
+
+        uint64_t size = metadata.size();
+        stream.write(s_streamedModelMagic, sizeof(s_streamedModelMagic));
+        stream.write(reinterpret_cast<const char*>(&size), sizeof(size));
+        stream.write(metadata.data(), metadata.size());
+        size = payloads.size();
+        stream.write(reinterpret_cast<const char*>(&size), sizeof(size));
+        for (const auto& payload : payloads)
+        {
+            const auto& view = payload.Value<NDArrayView>();
+            const char* data = view.GetDataType() == DataType::Float ? reinterpret_cast<const char*>(view.DataBuffer<float>()) : reinterpret_cast<const char*>(view.DataBuffer<double>());
+            size_t numBytes = view.Shape().TotalSize() * DataTypeSize(view.GetDataType());
+            for (size_t offset = 0; offset < numBytes; offset += s_payloadChunkSize)
+                stream.write(data + offset, std::min(s_payloadChunkSize, numBytes - offset));
+        }
+        if (stream.fail())
+            RuntimeError("Failed to write the model.");
+    }
+
+    Dictionary LoadStreamedModel(std::istream& stream)
+    {
+        UsingUTF8 locale;
+        char magic[sizeof(s_streamedModelMagic)];
+        uint64_t size = 0;
+        stream.read(magic, sizeof(magic));
+        stream.read(reinterpret_cast<char*>(&size), sizeof(size));
+        if (stream.fail() || memcmp(magic, s_streamedModelMagic, sizeof(magic)) != 0)
+            RuntimeError("Not a streamed model file.");
+
+        std::string metadata(size, '\0');
+        stream.read(&metadata[0], metadata.size());
+        proto::Dictionary proto;
+        io::CodedInputStream input(reinterpret_cast<const uint8*>(metadata.data()), (int)metadata.size());
+        if (stream.fail() || !ParseMessage(input, proto))
+            RuntimeError("Failed to parse the model.");
+        metadata.clear();
+
+        Dictionary model;
+        for (const auto& kv : proto.data())
+            Serializer::Copy(kv.second, model[ToWString(kv.first)]);
+
+        std::vector<DictionaryValue*> references;
+        Serializer::FindPayloadReferences(model, references);
+        stream.read(reinterpret_cast<char*>(&size), sizeof(size));
+        if (stream.fail() || size != references.size() || std::find(references.begin(), references.end(), nullptr) != references.end())
+            RuntimeError("Corrupt model file: The tensor payloads do not match their references.");
+
+        for (auto reference : references)
+        {
+            const auto& dictionary = reference->Value<Dictionary>();
+            auto dataType = DataType(dictionary[dataTypeKey].Value<size_t>());
+            if (dataType != DataType::Float && dataType != DataType::Double)
+                RuntimeError("Corrupt model file: Invalid tensor data type %d.", (int)dataType);
+
+            std::unique_ptr<NDArrayView> view(new NDArrayView(dataType, dictionary[shapeKey].Value<NDShape>(), DeviceDescriptor::CPUDevice()));
+            char* data = dataType == DataType::Float ? reinterpret_cast<char*>(view->WritableDataBuffer<float>()) : reinterpret_cast<char*>(view->WritableDataBuffer<double>());
+            size_t numBytes = view->Shape().TotalSize() * DataTypeSize(dataType);
+            for (size_t offset = 0; offset < numBytes && !stream.fail(); offset += s_payloadChunkSize)
+                stream.read(data + offset, std::min(s_payloadChunkSize, numBytes - offset));
+            if (stream.fail())
+                RuntimeError("Corrupt model file: Unexpected end of the tensor payloads.");
+
+            Serializer::SetValue(*reference, view.release());
+        }
+        return model;
+    }
+
     void Dictionary::Save(const std::wstring& filename)
     {
         UsingUTF8 locale;
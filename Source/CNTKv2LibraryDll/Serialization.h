@@ -36,6 +36,13 @@ namespace CNTK
     const std::wstring stateKey = L"state";
     const std::wstring rngSeedKey = L"rng_seed";
     const std::wstring rngOffsetKey = L"rng_offset";
+    const std::wstring payloadIndexKey = L"payload_index";
+
+    // Model files that keep the tensors out of the protobuf, and stream them from and to the file (see Serialization.cpp).
+    // SaveStreamedModel() moves the tensors out of 'model'.
+    bool IsStreamedModel(std::istream& stream);
+    void SaveStreamedModel(Dictionary& model, std::ostream& stream);
+    Dictionary LoadStreamedModel(std::istream& stream);
 
     template <typename T> 
     inline std::string GetVersionsString(size_t currentVersion, size_t dictVersion)
@@ -7,6 +7,11 @@
 #include "CNTKLibrary.h"
 #include "Utils.h"
 #include "Learner.h"
+#include "Value.h"
+#include "NcclComm.h"
+
+using namespace Microsoft::MSR::CNTK;
+
 namespace
 {
     const std::wstring learnersPropertyName = L"Learners";
@@ -75,6 +80,74 @@ namespace CNTK
         m_distributed = m_parameterLearners->IsDistributed();
     }
 
+    // A replica of the model on one of the devices of single-process data parallelism, and its part of the current minibatch
+    struct Trainer::Replica
+    {
+        Replica(const DeviceDescriptor& device) : m_device(device) {}
+
+        DeviceDescriptor m_device;
+        FunctionPtr m_combinedTrainingFunction;
+        std::unordered_map<Variable, Variable> m_variables; // the arguments, outputs and parameters of the model -> those of the replica
+        ValuePtr m_rootGradientValue;
+        std::unordered_map<Variable, ValuePtr> m_outputs;
+        std::unordered_map<Variable, ValuePtr> m_parameterGradients;
+    };
+
+    Trainer::Trainer(const FunctionPtr& model, const FunctionPtr& lossFunction, const FunctionPtr& evaluationFunction, const std::vector<LearnerPtr>& parameterLearners, const std::vector<DeviceDescriptor>& devices)
+        : Trainer(model, lossFunction, evaluationFunction, parameterLearners)
+    {
+        if (devices.empty())
+            InvalidArgument("Trainer ctor: At least one device must be specified to train replicas of the model on");
+
+        for (size_t i = 0; i < devices.size(); i++)
+        {
+            if (std::find(devices.begin(), devices.begin() + i, devices[i]) != devices.begin() + i)
+                InvalidArgument("Trainer ctor: The devices to train replicas of the model on must be distinct");
+        }
+
+        for (const auto& parameter : m_combinedTrainingFunction->Parameters())
+        {
+            if (parameter.Value()->Device() != devices[0])
+                InvalidArgument("Trainer ctor: Parameter%S of the model is not on the first of the devices to train replicas of the model on", ParanthesizedName(parameter.Name()).c_str());
+        }
+
+        m_replicaDevices = devices;
+        for (size_t i = 1; i < devices.size(); i++)
+            CreateReplica(devices[i]);
+
+        std::vector<int> deviceIds;
+        for (const auto& device : devices)
+            deviceIds.push_back(AsCNTKImplDeviceId(device));
+        m_localNcclComm = std::make_shared<LocalNcclComm>(deviceIds);
+
+        BroadcastParameters();
+    }
+
+    // The replica is a clone of the combined training function with parameters and arguments of its own, so that its networks
+    // are compiled for 'device'. The values of the parameters are set by BroadcastParameters().
+    void Trainer::CreateReplica(const DeviceDescriptor& device)
+    {
+        auto replica = std::make_shared<Replica>(device);
+
+        for (const auto& parameter : m_combinedTrainingFunction->Parameters())
+            replica->m_variables.insert({ parameter, Parameter(MakeSharedObject<NDArrayView>(parameter.GetDataType(), parameter.Shape(), device), parameter.Name()) });
+
+        for (const auto& argument : m_combinedTrainingFunction->Arguments())
+            replica->m_variables.insert({ argument, InputVariable(argument.Shape(), argument.IsSparse(), argument.GetDataType(), argument.NeedsGradient(), argument.Name(), argument.DynamicAxes()) });
+
+        replica->m_combinedTrainingFunction = m_combinedTrainingFunction->Clone(ParameterCloningMethod::Share, replica->m_variables);
+
+        // The outputs of a clone are in the same order as those of the original
+        auto outputs = m_combinedTrainingFunction->Outputs();
+        auto replicaOutputs = replica->m_combinedTrainingFunction->Outputs();
+        if (outputs.size() != replicaOutputs.size())
+            LogicError("Trainer: The replica of the model has %d outputs, the model %d", (int) replicaOutputs.size(), (int) outputs.size());
+        for (size_t i = 0; i < outputs.size(); i++)
+            replica->m_variables.insert({ outputs[i], replicaOutputs[i] });
+
+        m_replicas.push_back(replica);
+    }
+
 
     static double GetScalarValue(const ValuePtr& value)
     {
@@ -137,9 +210,12 @@ namespace CNTK
 
     bool Trainer::TrainMinibatch(const std::unordered_map<Variable, ValuePtr>& arguments, std::unordered_map<Variable, ValuePtr>& outputsToFetch, const DeviceDescriptor& computeDevice /*= DeviceDescriptor::UseDefaultDevice()*/)
     {
-        if (!m_distributed)
-            return TrainLocalMinibatch(arguments, outputsToFetch, computeDevice);
-        return TrainDistributedMinibatch(arguments, outputsToFetch, computeDevice);
+        bool updated = m_distributed ? TrainDistributedMinibatch(arguments, outputsToFetch, computeDevice) : TrainLocalMinibatch(arguments, outputsToFetch, computeDevice);
+
+        // The learners updated the parameters of the model itself
+        if (!m_replicas.empty())
+            BroadcastParameters();
+        return updated;
     }
 
     bool Trainer::TrainLocalMinibatch(const std::unordered_map<Variable, ValuePtr>& arguments, std::unordered_map<Variable, ValuePtr>& outputsToFetch, const DeviceDescriptor& computeDevice /*= DeviceDescriptor::UseDefaultDevice()*/)
@@ -149,7 +225,10 @@ namespace CNTK
             return false;
 
         std::unordered_map<Variable, ValuePtr> parameterGradients;
-        ExecuteForwardBackward(arguments, outputsToFetch, computeDevice, parameterGradients);
+        if (m_replicas.empty())
+            ExecuteForwardBackward(arguments, outputsToFetch, computeDevice, parameterGradients);
+        else
+            ExecuteReplicatedForwardBackward(arguments, outputsToFetch, parameterGradients);
 
         std::unordered_map<Parameter, NDArrayViewPtr> gradients;
         for (const auto& parameter : m_combinedTrainingFunction->Parameters())
@@ -177,7 +256,10 @@ namespace CNTK
         {
             // Get gradients after forward/backward pass.
             std::unordered_map<Variable, ValuePtr> parameterGradients;
-            ExecuteForwardBackward(arguments, outputsToFetch, computeDevice, parameterGradients);
+            if (m_replicas.empty())
+                ExecuteForwardBackward(arguments, outputsToFetch, computeDevice, parameterGradients);
+            else
+                ExecuteReplicatedForwardBackward(arguments, outputsToFetch, parameterGradients);
             for (const auto& parameter : modelParameters)
                 gradients[parameter] = parameterGradients[parameter]->Data();
             trainingLoss = m_prevMinibatchAggregateTrainingLossValue->Data();
@@ -198,6 +280,24 @@ namespace CNTK
         return updated;
     }
 
+    // (Re)creates the gradient of 1 that the backprop of 'lossVariable' starts from, unless the one from the last minibatch fits
+    static void PrepareRootGradientValue(ValuePtr& rootGradientValue, const Variable& lossVariable, const ValuePtr& lossValue, const DeviceDescriptor& computeDevice)
+    {
+        if (!rootGradientValue ||
+            lossVariable.GetDataType() != rootGradientValue->GetDataType() ||
+            lossValue->Shape() != rootGradientValue->Shape() ||
+            computeDevice != rootGradientValue->Device() ||
+            lossValue->Mask() != rootGradientValue->Mask())
+        {
+            rootGradientValue = MakeSharedObject<Value>(MakeSharedObject<NDArrayView>(lossVariable.GetDataType(), lossValue->Shape(), computeDevice), lossValue->Mask());
+        }
+
+        if (lossVariable.GetDataType() == DataType::Float)
+            rootGradientValue->Data()->SetValue(1.0f);
+        else
+            rootGradientValue->Data()->SetValue(1.0);
+    }
+
     void Trainer::ExecuteForwardBackward(const std::unordered_map<Variable, ValuePtr>& arguments, std::unordered_map<Variable, ValuePtr>& outputsToFetch, const DeviceDescriptor& computeDevice, std::unordered_map<Variable, ValuePtr>& parameterGradients)
     {
         std::unordered_map<Variable, ValuePtr> outputs = { { m_aggregatedLossFunction, nullptr }, { m_trainingSampleCountVar, nullptr } };
@@ -217,19 +317,7 @@ namespace CNTK
                 outputsToFetch[outputToFetch.first] = outputs[outputToFetch.first];
         }
 
-        if(!m_rootGradientValue ||
-            m_aggregatedLossFunction->Output().GetDataType() != m_rootGradientValue->GetDataType() ||
-            m_prevMinibatchAggregateTrainingLossValue->Shape() != m_rootGradientValue->Shape() ||
-            computeDevice != m_rootGradientValue->Device() ||
-            outputs.at(m_aggregatedLossFunction)->Mask() != m_rootGradientValue->Mask())
-        {
-            m_rootGradientValue = MakeSharedObject<Value>(MakeSharedObject<NDArrayView>(m_aggregatedLossFunction->Output().GetDataType(), m_prevMinibatchAggregateTrainingLossValue->Shape(), computeDevice), outputs.at(m_aggregatedLossFunction)->Mask());
-        }
-
-        if (m_aggregatedLossFunction->Output().GetDataType() == DataType::Float)
-            m_rootGradientValue->Data()->SetValue(1.0f);
-        else
-            m_rootGradientValue->Data()->SetValue(1.0);
+        PrepareRootGradientValue(m_rootGradientValue, m_aggregatedLossFunction, outputs.at(m_aggregatedLossFunction), computeDevice);
 
         auto modelParameters = m_combinedTrainingFunction->Parameters();
         for (const auto& parameter : modelParameters)
@@ -242,6 +330,256 @@ namespace CNTK
         m_prevMinibatchNumSamples = GetSampleCount(m_trainingSampleCountVar, outputs[m_trainingSampleCountVar]);
     }
 
+    // The matrix and layout of a minibatch argument; those of a Value from a MinibatchSource are used as they are
+    template <typename ElementType>
+    static std::pair<std::shared_ptr<const Matrix<ElementType>>, MBLayoutPtr> GetMatrixAndLayout(const Variable& var, const ValuePtr& value)
+    {
+        auto packedValue = std::dynamic_pointer_cast<PackedValue>(value);
+        if (packedValue && packedValue->IsPacked())
+            return packedValue->PackedData<ElementType>();
+        return Utils::GetCNTKImplMatrixAndMBLayoutFromValueObject<ElementType>(var, value);
+    }
+
+    // The parallel sequences [begin, end) of a minibatch argument, as a Value on 'device'
+    template <typename ElementType>
+    static ValuePtr SliceParallelSequences(const Variable& var, const Matrix<ElementType>& matrix, const MBLayoutPtr& layout, size_t begin, size_t end, const DeviceDescriptor& device)
+    {
+        size_t numParallelSequences = layout->GetNumParallelSequences();
+        size_t numTimeSteps = layout->GetNumTimeSteps();
+
+        auto sliceLayout = std::make_shared<MBLayout>(end - begin, numTimeSteps, L"");
+        sliceLayout->SetAxisName(layout->GetAxisName());
+        for (auto sequence : layout->GetAllSequences())
+        {
+            if (sequence.s < begin || sequence.s >= end)
+                continue;
+            sequence.s -= begin;
+            sliceLayout->AddSequence(sequence);
+        }
+
+        // the columns are ordered by time step, then parallel sequence
+        std::vector<ElementType> columns;
+        columns.reserve(numTimeSteps * (end - begin));
+        for (size_t t = 0; t < numTimeSteps; t++)
+        {
+            for (size_t s = begin; s < end; s++)
+                columns.push_back((ElementType) (t * numParallelSequences + s));
+        }
+        Matrix<ElementType> columnIndices(1, columns.size(), columns.data(), matrix.GetDeviceId());
+
+        auto slice = std::make_shared<Matrix<ElementType>>(0, 0, matrix.GetDeviceId(), matrix.GetMatrixType(), matrix.GetFormat());
+        slice->DoGatherColumnsOf(0, columnIndices, matrix, 1);
+        slice->TransferToDeviceIfNotThere(AsCNTKImplDeviceId(device), /*isBeingMoved=*/true);
+        return MakeSharedObject<PackedValue>(var.Shape(), slice, sliceLayout, /*isReadOnly =*/ false);
+    }
+
+    // Splits a minibatch into a part for each replica by its parallel sequences, like DataReaderHelpers::DecimateMinibatch() for
+    // data-parallel SGD; there are fewer parts if there are fewer parallel sequences than devices. Part i is for m_replicaDevices[i]
+    // and keyed by the arguments of its replica.
+    std::vector<std::unordered_map<Variable, ValuePtr>> Trainer::SplitMinibatch(const std::unordered_map<Variable, ValuePtr>& arguments)
+    {
+        size_t numParts = m_replicaDevices.size();
+        std::unordered_map<Variable, std::pair<std::shared_ptr<const MatrixBase>, MBLayoutPtr>> packedArguments;
+        for (const auto& argument : arguments)
+        {
+            const auto& var = argument.first;
+            if (var.DynamicAxes().empty())
+                InvalidArgument("Trainer::TrainMinibatch: Argument%S has no dynamic axes, and cannot be split across the devices of the replicas of the model", ParanthesizedName(var.Name()).c_str());
+
+            auto& packedArgument = packedArguments[var];
+            if (var.GetDataType() == DataType::Float)
+                packedArgument = GetMatrixAndLayout<float>(var, argument.second);
+            else if (var.GetDataType() == DataType::Double)
+                packedArgument = GetMatrixAndLayout<double>(var, argument.second);
+            else
+                LogicError("Unsupported DataType %s", DataTypeName(var.GetDataType()));
+            numParts = std::min(numParts, packedArgument.second->GetNumParallelSequences());
+        }
+
+        std::vector<std::unordered_map<Variable, ValuePtr>> parts(std::max<size_t>(numParts, 1));
+        if (parts.size() == 1)
+        {
+            parts[0] = arguments;
+            return parts;
+        }
+
+        for (const auto& packedArgument : packedArguments)
+        {
+            const auto& var = packedArgument.first;
+            const auto& layout = packedArgument.second.second;
+            size_t numParallelSequences = layout->GetNumParallelSequences();
+            for (size_t i = 0; i < parts.size(); i++)
+            {
+                size_t begin = numParallelSequences * i / parts.size();
+                size_t end = numParallelSequences * (i + 1) / parts.size();
+                Variable partVar = (i == 0) ? var : m_replicas[i - 1]->m_variables.at(var);
+                if (var.GetDataType() == DataType::Float)
+                    parts[i][partVar] = SliceParallelSequences(var, *std::static_pointer_cast<const Matrix<float>>(packedArgument.second.first), layout, begin, end, m_replicaDevices[i]);
+                else
+                    parts[i][partVar] = SliceParallelSequences(var, *std::static_pointer_cast<const Matrix<double>>(packedArgument.second.first), layout, begin, end, m_replicaDevices[i]);
+            }
+        }
+        return parts;
+    }
+
+    // The forward and backward passes of the replicas are queued from this thread one after the other, and run on their devices
+    // concurrently. The gradients of the replicas are summed into those of the model, as are the loss, evaluation criterion and
+    // number of samples.
+    void Trainer::ExecuteReplicatedForwardBackward(const std::unordered_map<Variable, ValuePtr>& arguments, std::unordered_map<Variable, ValuePtr>& outputsToFetch, std::unordered_map<Variable, ValuePtr>& parameterGradients)
+    {
+        auto parts = SplitMinibatch(arguments);
+
+        for (size_t i = 1; i < parts.size(); i++)
+        {
+            auto& replica = *m_replicas[i - 1];
+            Variable lossVariable = replica.m_variables.at(m_aggregatedLossFunction);
+            replica.m_outputs = { { lossVariable, nullptr }, { replica.m_variables.at(m_trainingSampleCountVar), nullptr } };
+            if (m_aggregatedEvaluationFunction)
+                replica.m_outputs.insert({ replica.m_variables.at(m_aggregatedEvaluationFunction), nullptr });
+
+            auto backPropState = replica.m_combinedTrainingFunction->Forward(parts[i], replica.m_outputs, replica.m_device, { lossVariable });
+            PrepareRootGradientValue(replica.m_rootGradientValue, lossVariable, replica.m_outputs.at(lossVariable), replica.m_device);
+
+            replica.m_parameterGradients.clear();
+            for (const auto& parameter : replica.m_combinedTrainingFunction->Parameters())
+                replica.m_parameterGradients[parameter] = nullptr;
+            replica.m_combinedTrainingFunction->Backward(backPropState, { { lossVariable, replica.m_rootGradientValue } }, replica.m_parameterGradients);
+        }
+
+        // the model itself takes the first part (this sets m_prevMinibatch* for it)
+        ExecuteForwardBackward(parts[0], outputsToFetch, m_replicaDevices[0], parameterGradients);
+
+        size_t numActiveReplicas = parts.size() - 1;
+        ReduceReplicaGradients(parameterGradients, numActiveReplicas);
+
+        double trainingLoss = GetScalarValue(m_prevMinibatchAggregateTrainingLossValue);
+        double evalCriterion = m_aggregatedEvaluationFunction ? GetScalarValue(m_prevMinibatchAggregateEvalCriterionValue) : 0;
+        for (size_t i = 0; i < numActiveReplicas; i++)
+        {
+            const auto& replica = *m_replicas[i];
+            trainingLoss += GetScalarValue(replica.m_outputs.at(replica.m_variables.at(m_aggregatedLossFunction)));
+            if (m_aggregatedEvaluationFunction)
+                evalCriterion += GetScalarValue(replica.m_outputs.at(replica.m_variables.at(m_aggregatedEvaluationFunction)));
+            Variable sampleCountVar = replica.m_variables.at(m_trainingSampleCountVar);
+            m_prevMinibatchNumSamples += GetSampleCount(sampleCountVar, replica.m_outputs.at(sampleCountVar));
+        }
+
+        m_prevMinibatchAggregateTrainingLossValue = MakeSharedObject<Value>(MakeSharedObject<NDArrayView>(trainingLoss, m_prevMinibatchAggregateTrainingLossValue->GetDataType(), m_prevMinibatchAggregateTrainingLossValue->Shape(), m_replicaDevices[0]));
+        if (m_aggregatedEvaluationFunction)
+            m_prevMinibatchAggregateEvalCriterionValue = MakeSharedObject<Value>(MakeSharedObject<NDArrayView>(evalCriterion, m_prevMinibatchAggregateEvalCriterionValue->GetDataType(), m_prevMinibatchAggregateEvalCriterionValue->Shape(), m_replicaDevices[0]));
+    }
+
+    // The gradients are reduced as dense matrices; a sparse one (e.g. of an embedding) is replaced by a dense copy
+    NDArrayViewPtr Trainer::DenseGradient(ValuePtr& gradient)
+    {
+        if (!gradient->IsSparse())
+            return gradient->Data();
+
+        auto denseGradient = MakeSharedObject<NDArrayView>(gradient->GetDataType(), gradient->Shape(), gradient->Device());
+        denseGradient->SetValue(0.0);
+        if (gradient->GetDataType() == DataType::Float)
+        {
+            auto denseMatrix = denseGradient->GetWritableMatrix<float>();
+            Matrix<float>::ScaleAndAdd(1, *gradient->Data()->GetMatrix<float>(), *denseMatrix);
+        }
+        else
+        {
+            auto denseMatrix = denseGradient->GetWritableMatrix<double>();
+            Matrix<double>::ScaleAndAdd(1, *gradient->Data()->GetMatrix<double>(), *denseMatrix);
+        }
+        gradient = MakeSharedObject<Value>(denseGradient);
+        return denseGradient;
+    }
+
+    // Sums the gradients of the first 'numActiveReplicas' replicas into 'parameterGradients'. NCCL requires all devices to take
+    // part, so a minibatch with fewer parts than devices is reduced by copies.
+    void Trainer::ReduceReplicaGradients(std::unordered_map<Variable, ValuePtr>& parameterGradients, size_t numActiveReplicas)
+    {
+        if (numActiveReplicas == 0)
+            return;
+
+        bool useNccl = m_localNcclComm->IsSupported() && (numActiveReplicas == m_replicas.size());
+        for (const auto& parameter : m_combinedTrainingFunction->Parameters())
+        {
+            std::vector<NDArrayViewPtr> gradients = { DenseGradient(parameterGradients[parameter]) };
+            for (size_t i = 0; i < numActiveReplicas; i++)
+                gradients.push_back(DenseGradient(m_replicas[i]->m_parameterGradients[m_replicas[i]->m_variables.at(parameter)]));
+
+            if (parameter.GetDataType() == DataType::Float)
+                Reduce<float>(gradients, useNccl);
+            else
+                Reduce<double>(gradients, useNccl);
+        }
+
+        if (useNccl)
+            m_localNcclComm->Sync();
+    }
+
+    // Copies the parameters of the model to its replicas
+    void Trainer::BroadcastParameters()
+    {
+        bool useNccl = m_localNcclComm->IsSupported();
+        for (const auto& parameter : m_combinedTrainingFunction->Parameters())
+        {
+            std::vector<NDArrayViewPtr> values = { parameter.Value() };
+            for (const auto& replica : m_replicas)
+                values.push_back(Parameter(replica->m_variables.at(parameter)).Value());
+
+            if (parameter.GetDataType() == DataType::Float)
+                Broadcast<float>(values, useNccl);
+            else
+                Broadcast<double>(values, useNccl);
+        }
+
+        if (useNccl)
+            m_localNcclComm->Sync();
+    }
+
+    // Matrix::AssignValuesOf() would move the target to the GPU of the source, so the copies between devices are moved instead
+    template <typename ElementType>
+    void Trainer::Reduce(const std::vector<NDArrayViewPtr>& views, bool useNccl)
+    {
+        std::vector<std::shared_ptr<Matrix<ElementType>>> matrices;
+        std::vector<Matrix<ElementType>*> buffers;
+        for (const auto& view : views)
+        {
+            matrices.push_back(view->GetWritableMatrix<ElementType>());
+            buffers.push_back(matrices.back().get());
+        }
+
+        if (useNccl)
+            return m_localNcclComm->Reduce(buffers);
+
+        for (size_t i = 1; i < matrices.size(); i++)
+        {
+            Matrix<ElementType> copy = matrices[i]->DeepClone();
+            copy.TransferToDeviceIfNotThere(matrices[0]->GetDeviceId(), /*isBeingMoved=*/true);
+            *matrices[0] += copy;
+        }
+    }
+
+    template <typename ElementType>
+    void Trainer::Broadcast(const std::vector<NDArrayViewPtr>& views, bool useNccl)
+    {
+        std::vector<std::shared_ptr<Matrix<ElementType>>> matrices;
+        std::vector<Matrix<ElementType>*> buffers;
+        for (const auto& view : views)
+        {
+            matrices.push_back(view->GetWritableMatrix<ElementType>());
+            buffers.push_back(matrices.back().get());
+        }
+
+        if (useNccl)
+            return m_localNcclComm->Broadcast(buffers);
+
+        for (size_t i = 1; i < matrices.size(); i++)
+        {
+            Matrix<ElementType> copy = matrices[0]->DeepClone();
+            copy.TransferToDeviceIfNotThere(matrices[i]->GetDeviceId(), /*isBeingMoved=*/true);
+            matrices[i]->AssignValuesOf(copy);
+        }
+    }
+
     static std::wstring GetTrainerStateCheckpointFilePath(const std::wstring& modelFilePath)
     {
         const wchar_t* checkpointExt = L".ckp";
@@ -301,6 +639,9 @@ namespace CNTK
         auto learnerState = checkpoint[learnersPropertyName].Value<std::vector<DictionaryValue>>();
         auto externalState = checkpoint[externalStatePropertyName].Value<Dictionary>();
 
+        if (!m_replicas.empty())
+            BroadcastParameters();
+
         if (!m_distributed)
         {
             m_parameterLearners->RestoreFromCheckpoint(learnerState);
@@ -37,6 +37,16 @@ namespace CNTK
         return viewPtr;
     }
 
+    DictionaryValue::DictionaryValue(vector<DictionaryValue>&& value) : m_valueType(GetValueType<vector<DictionaryValue>>())
+    {
+        m_data.m_ptr = new vector<DictionaryValue>(std::move(value));
+    }
+
+    DictionaryValue::DictionaryValue(Dictionary&& value) : m_valueType(GetValueType<Dictionary>())
+    {
+        m_data.m_ptr = new Dictionary(std::move(value));
+    }
+
     template <typename T>
     void DictionaryValue::AllocateDataPtr(const T& value)
     {
@@ -457,7 +467,7 @@ namespace CNTK
     }
 
     template <typename ElementType>
-    std::pair<std::shared_ptr<const Matrix<ElementType>>, MBLayoutPtr> Utils::GetCNTKImplMatrixAndMBLayoutFromValueObject(const Variable& var, const ValuePtr& value)
+    std::pair<std::shared_ptr<const Matrix<ElementType>>, MBLayoutPtr> Utils::GetCNTKImplMatrixAndMBLayoutFromValueObject(const Variable& var, const ValuePtr& value, ValueConversionCache* cache /*= nullptr*/)
     {
         if (var.GetDataType() != value->GetDataType())
             LogicError("The Variable's DataType %s does not match the corresponding Value's DataType %s", DataTypeName(var.GetDataType()), DataTypeName(value->GetDataType()));
@@ -505,7 +515,59 @@ namespace CNTK
         auto mask = value->Mask();
         if ((mask != nullptr) && ((varShape.Rank() + mask->Shape().Rank()) != valueShape.Rank()))
             InvalidArgument("Invalid Value object; the sum of the rank of the mask and data does not equal the Variable's rank + number of dynamic axes");
-        
+
+        // A mask kept as sequence runs is read in O(#sequences), without a copy from the device
+        std::vector<bool> maskSequenceBeginFlags;
+        std::vector<size_t> maskSequenceLengths;
+        bool maskHasSequenceRuns = (mask != nullptr) && mask->GetSequenceRuns(maskSequenceBeginFlags, maskSequenceLengths);
+
+        if ((mask != nullptr) && !maskHasSequenceRuns && (mask->Device() != DeviceDescriptor::CPUDevice()))
+            mask = mask->DeepClone(DeviceDescriptor::CPUDevice());
+
+        size_t maskSize = ((mask != nullptr) && !maskHasSequenceRuns) ? mask->Shape().TotalSize() : 0;
+        auto isCachedMaskFunc = [&]() {
+            if (cache->m_maskHasSequenceRuns != maskHasSequenceRuns)
+                return false;
+
+            if (maskHasSequenceRuns)
+                return (cache->m_maskSequenceBeginFlags == maskSequenceBeginFlags) && (cache->m_maskSequenceLengths == maskSequenceLengths);
+
+            return (cache->m_maskData.size() == maskSize) && std::equal(cache->m_maskData.begin(), cache->m_maskData.end(), (maskSize > 0) ? mask->DataBuffer() : nullptr);
+        };
+
+        if ((cache != nullptr) && cache->m_isValid && (cache->m_device == value->Device()) && (cache->m_valueShape == valueShape) && isCachedMaskFunc())
+        {
+            auto gatherIdxMatrix = std::dynamic_pointer_cast<Matrix<ElementType>>(cache->m_shuffleIndices);
+            if (!cache->m_shuffleIndices)
+                return{ value->Data()->GetMatrix<ElementType>(varShape.Rank()), cache->m_layout };
+            else if (gatherIdxMatrix)
+            {
+                auto matrixData = std::make_shared<Matrix<ElementType>>(varShape.TotalSize(),
+                    cache->m_layout->GetNumCols(),
+                    AsCNTKImplDeviceId(value->Device()),
+                    value->IsSparse() ? MatrixType::SPARSE : MatrixType::DENSE,
+                    AsCNTKImplMatrixFormat(value->GetStorageFormat()));
+                matrixData->DoGatherColumnsOf(0, *gatherIdxMatrix, *(value->Data()->GetMatrix<ElementType>(varShape.Rank())), 1);
+                return{ matrixData, cache->m_layout };
+            }
+        }
+
+        auto updateCacheFunc = [&](const MBLayoutPtr& layout, const MatrixBasePtr& gatherIndices) {
+            if (cache == nullptr)
+                return;
+
+            cache->m_isValid = true;
+            cache->m_device = value->Device();
+            cache->m_valueShape = valueShape;
+            cache->m_maskData.assign((maskSize > 0) ? mask->DataBuffer() : nullptr, (maskSize > 0) ? mask->DataBuffer() + maskSize : nullptr);
+            cache->m_maskHasSequenceRuns = maskHasSequenceRuns;
+            cache->m_maskSequenceBeginFlags = maskSequenceBeginFlags;
+            cache->m_maskSequenceLengths = maskSequenceLengths;
+            cache->m_layout = layout;
+            cache->m_mask = nullptr;
+            cache->m_shuffleIndices = gatherIndices;
+        };
+
         auto getNumTimeStepsAndSequencesFunc = [numDynamicAxes](const NDShape& maskShape, size_t numDynamicAxes) {
             size_t maxNumTimeSteps = 1;
             size_t numSequences = 1;
@@ -536,15 +598,27 @@ namespace CNTK
         size_t maxNumTimeSteps, numSequences;
         std::tie(maxNumTimeSteps, numSequences) = getNumTimeStepsAndSequencesFunc(valueShape.SubShape(varShape.Rank()), numDynamicAxes);
 
-        auto getSequenceStartsAndLengthsFunc = [&getNumTimeStepsAndSequencesFunc](const NDMaskPtr& mask, std::vector<ptrdiff_t>& sequenceBeginIndices, std::vector<size_t>& sequenceLengths, size_t numDynamicAxes) {
-            auto cpuMask = mask;
-            if (mask->Device() != DeviceDescriptor::CPUDevice())
-                cpuMask = mask->DeepClone(DeviceDescriptor::CPUDevice());
-
-            const MaskKind* maskBuffer = cpuMask->DataBuffer();
+        auto getSequenceStartsAndLengthsFunc = [&](const NDMaskPtr& mask, std::vector<ptrdiff_t>& sequenceBeginIndices, std::vector<size_t>& sequenceLengths, size_t numDynamicAxes) {
             size_t maxNumTimeSteps, numSequences;
             std::tie(maxNumTimeSteps, numSequences) = getNumTimeStepsAndSequencesFunc(mask->Shape(), numDynamicAxes);
 
+            if (maskHasSequenceRuns)
+            {
+                for (size_t i = 0; i < numSequences; ++i)
+                {
+                    if (maskSequenceLengths[i] == 0)
+                        LogicError("The first entry of a mask should be Valid or SequenceBegin");
+
+                    sequenceBeginIndices[i] = maskSequenceBeginFlags[i] ? 0 : Microsoft::MSR::CNTK::SentinelValueIndicatingUnspecifedSequenceBeginIdx;
+                    sequenceLengths[i] = maskSequenceLengths[i];
+                }
+
+                return;
+            }
+
+            // The mask has already been moved to the CPU
+            const MaskKind* maskBuffer = mask->DataBuffer();
+
             for (size_t i = 0; i < numSequences; ++i)
             {
                 MaskKind firstMaskEntry = maskBuffer[i * maxNumTimeSteps];
@@ -601,6 +675,7 @@ namespace CNTK
                     layout->AddSequence(i, i, sequenceBeginIndices[i], sequenceLengths[i]);
             }
 
+            updateCacheFunc(layout, nullptr);
             return{ matrixData, layout };
         }
         else
@@ -674,12 +749,13 @@ namespace CNTK
 
             auto gatherIdxMatrix = std::make_shared<Matrix<ElementType>>(1, layout->GetNumCols(), gatherIndicesVector.data(), AsCNTKImplDeviceId(value->Device()));
             matrixData->DoGatherColumnsOf(0, *gatherIdxMatrix, *(value->Data()->GetMatrix<ElementType>(varShape.Rank())), 1);
+            updateCacheFunc(layout, gatherIdxMatrix);
             return{ matrixData, layout };
         }
     }
 
     template <typename ElementType>
-    ValuePtr Utils::GetValueObjectFromCNTKImplMatrixAndMBLayout(const NDShape& sampleShape, const Matrix<ElementType>& matrix, const MBLayoutPtr& layout, bool readOnly /*= true*/)
+    ValuePtr Utils::GetValueObjectFromCNTKImplMatrixAndMBLayout(const NDShape& sampleShape, const Matrix<ElementType>& matrix, const MBLayoutPtr& layout, bool readOnly /*= true*/, ValueConversionCache* cache /*= nullptr*/)
     {
         NDShape valueDataShape = sampleShape;
 
@@ -746,6 +822,21 @@ namespace CNTK
             return mask;
         };
 
+        // The mask and the scatter indices of the last conversion of the same layout are reused
+        auto device = AsDeviceDescriptor(matrix.GetDeviceId());
+        bool isCached = (cache != nullptr) && cache->m_isValid && (layout != nullptr) && (cache->m_device == device) && (*cache->m_layout == *layout);
+        auto updateCacheFunc = [cache, &layout, &device](const NDMaskPtr& mask, const MatrixBasePtr& scatterIndices) {
+            if ((cache == nullptr) || (layout == nullptr))
+                return;
+
+            cache->m_isValid = true;
+            cache->m_device = device;
+            cache->m_layout = std::make_shared<MBLayout>();
+            cache->m_layout->CopyFrom(layout);
+            cache->m_mask = mask;
+            cache->m_shuffleIndices = scatterIndices;
+        };
+
         // No data shuffling needed if no layout or the layout has just one time-step or just one sequence
         std::vector<size_t> sequencesShorterThanLongestSequence;
         if ((maxNumTimeSteps == 1) || (numSequences == 1))
@@ -757,7 +848,11 @@ namespace CNTK
                 return MakeSharedObject<Value>(data);
             else
             {
+                if (isCached)
+                    return MakeSharedObject<Value>(data, cache->m_mask);
+
                 auto mask = createMaskFunc(layout, AsDeviceDescriptor(matrix.GetDeviceId()), sequencesShorterThanLongestSequence);
+                updateCacheFunc(mask, nullptr);
                 return MakeSharedObject<Value>(data, mask);
             }
         }
@@ -765,9 +860,21 @@ namespace CNTK
         if (layout->GetNumCols() != matrix.GetNumCols())
             LogicError("Bad MBLayout: The number of columns in the MBLayout does not match the number of columns in the data matrix!");
 
+        auto shuffleData = [&](const Matrix<ElementType>& scatterIdxMatrix, const NDMaskPtr& mask) {
+            auto shuffledMatrixData = std::make_shared<Matrix<ElementType>>(matrix.GetNumRows(), maxNumTimeSteps * numSequences, matrix.GetDeviceId(), matrix.GetMatrixType(), matrix.GetFormat());
+            shuffledMatrixData->DoScatterColumnsOf(0, scatterIdxMatrix, matrix, 1);
+
+            auto tensorView = new TensorView<ElementType>(shuffledMatrixData, AsTensorViewShape(valueDataShape));
+            auto data = MakeSharedObject<NDArrayView>(AsDataType<ElementType>(), AsDeviceDescriptor(matrix.GetDeviceId()), AsStorageFormat(shuffledMatrixData->GetFormat()), valueDataShape, readOnly, tensorView);
+            return MakeSharedObject<Value>(data, mask);
+        };
+
+        auto cachedScatterIdxMatrix = isCached ? std::dynamic_pointer_cast<Matrix<ElementType>>(cache->m_shuffleIndices) : nullptr;
+        if (cachedScatterIdxMatrix)
+            return shuffleData(*cachedScatterIdxMatrix, cache->m_mask);
+
         // Reshuffle to data to unpack and uninterleave the CNTK form packed data
         // Now generate the scatter indices
-        auto shuffledMatrixData = std::make_shared<Matrix<ElementType>>(matrix.GetNumRows(), maxNumTimeSteps * numSequences, matrix.GetDeviceId(), matrix.GetMatrixType(), matrix.GetFormat());
         auto mask = createMaskFunc(layout, AsDeviceDescriptor(matrix.GetDeviceId()), sequencesShorterThanLongestSequence);
 
         // Set the target location of all gaps to be the last step of the first sequence that is shorter than the longest sequence in the batch
@@ -793,15 +900,12 @@ namespace CNTK
         }
 
         auto scatterIdxMatrix = std::make_shared<Matrix<ElementType>>(1, layout->GetNumCols(), scatterIndicesVector.data(), matrix.GetDeviceId());
-        shuffledMatrixData->DoScatterColumnsOf(0, *scatterIdxMatrix, matrix, 1);
-
-        auto tensorView = new TensorView<ElementType>(shuffledMatrixData, AsTensorViewShape(valueDataShape));
-        auto data = MakeSharedObject<NDArrayView>(AsDataType<ElementType>(), AsDeviceDescriptor(matrix.GetDeviceId()), AsStorageFormat(shuffledMatrixData->GetFormat()), valueDataShape, readOnly, tensorView);
-        return MakeSharedObject<Value>(data, mask);
+        updateCacheFunc(mask, scatterIdxMatrix);
+        return shuffleData(*scatterIdxMatrix, mask);
     }
 
     template <typename ElementType>
-    ValuePtr Utils::GetValueObjectFromCNTKImplMatrixAndMBLayout(const Variable& var, const Matrix<ElementType>& matrix, const MBLayoutPtr& layout, bool readOnly /*= true*/)
+    ValuePtr Utils::GetValueObjectFromCNTKImplMatrixAndMBLayout(const Variable& var, const Matrix<ElementType>& matrix, const MBLayoutPtr& layout, bool readOnly /*= true*/, ValueConversionCache* cache /*= nullptr*/)
     {
         if (var.DynamicAxes().size() > 2)
             LogicError("More than 2 dynamic axis for a variable is currently unsupported");
@@ -812,7 +916,7 @@ namespace CNTK
         if ((layout != nullptr) && (matrix.GetNumRows() != var.Shape().TotalSize()))
             LogicError("Unexpected matrix layout: The number of rows in the matrix does not match the sample size of the Variable");
 
-        return GetValueObjectFromCNTKImplMatrixAndMBLayout(var.Shape(), matrix, layout, readOnly);
+        return GetValueObjectFromCNTKImplMatrixAndMBLayout(var.Shape(), matrix, layout, readOnly, cache);
     }
     template void DictionaryValue::AllocateDataPtr<NDShape>(const NDShape& value);
     template void DictionaryValue::AllocateDataPtr<Axis>(const Axis& value);
@@ -922,12 +1026,12 @@ namespace CNTK
         }
     }
 
-    template std::pair<std::shared_ptr<const Matrix<float>>, MBLayoutPtr> Utils::GetCNTKImplMatrixAndMBLayoutFromValueObject<float>(const Variable& var, const ValuePtr& value);
-    template std::pair<std::shared_ptr<const Matrix<double>>, MBLayoutPtr> Utils::GetCNTKImplMatrixAndMBLayoutFromValueObject<double>(const Variable& var, const ValuePtr& value);
+    template std::pair<std::shared_ptr<const Matrix<float>>, MBLayoutPtr> Utils::GetCNTKImplMatrixAndMBLayoutFromValueObject<float>(const Variable& var, const ValuePtr& value, ValueConversionCache* cache);
+    template std::pair<std::shared_ptr<const Matrix<double>>, MBLayoutPtr> Utils::GetCNTKImplMatrixAndMBLayoutFromValueObject<double>(const Variable& var, const ValuePtr& value, ValueConversionCache* cache);
 
-    template ValuePtr Utils::GetValueObjectFromCNTKImplMatrixAndMBLayout<float>(const NDShape& sampleShape, const Matrix<float>& matrix, const MBLayoutPtr& layout, bool readOnly /*= true*/);
-    template ValuePtr Utils::GetValueObjectFromCNTKImplMatrixAndMBLayout<double>(const NDShape& sampleShape, const Matrix<double>& matrix, const MBLayoutPtr& layout, bool readOnly /*= true*/);
+    template ValuePtr Utils::GetValueObjectFromCNTKImplMatrixAndMBLayout<float>(const NDShape& sampleShape, const Matrix<float>& matrix, const MBLayoutPtr& layout, bool readOnly /*= true*/, ValueConversionCache* cache /*= nullptr*/);
+    template ValuePtr Utils::GetValueObjectFromCNTKImplMatrixAndMBLayout<double>(const NDShape& sampleShape, const Matrix<double>& matrix, const MBLayoutPtr& layout, bool readOnly /*= true*/, ValueConversionCache* cache /*= nullptr*/);
 
-    template ValuePtr Utils::GetValueObjectFromCNTKImplMatrixAndMBLayout<float>(const Variable& var, const Matrix<float>& matrix, const MBLayoutPtr& layout, bool readOnly /*= true*/);
-    template ValuePtr Utils::GetValueObjectFromCNTKImplMatrixAndMBLayout<double>(const Variable& var, const Matrix<double>& matrix, const MBLayoutPtr& layout, bool readOnly /*= true*/);
+    template ValuePtr Utils::GetValueObjectFromCNTKImplMatrixAndMBLayout<float>(const Variable& var, const Matrix<float>& matrix, const MBLayoutPtr& layout, bool readOnly /*= true*/, ValueConversionCache* cache /*= nullptr*/);
+    template ValuePtr Utils::GetValueObjectFromCNTKImplMatrixAndMBLayout<double>(const Variable& var, const Matrix<double>& matrix, const MBLayoutPtr& layout, bool readOnly /*= true*/, ValueConversionCache* cache /*= nullptr*/);
 }
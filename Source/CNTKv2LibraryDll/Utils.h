@@ -535,16 +535,33 @@ namespace CNTK
         bool m_isDistributed;
     };
 
+    // The result of the last conversion between Value objects and CNTK Matrix/MBLayout pairs of one Variable, which is
+    // reused by the next conversion if the Value has the same shape and mask contents, or the MBLayout the same sequences.
+    // A Value object created with a cache shares the cached mask, so it must only be copied from.
+    struct ValueConversionCache
+    {
+        bool m_isValid = false;
+        DeviceDescriptor m_device = DeviceDescriptor::CPUDevice();
+        NDShape m_valueShape;
+        std::vector<MaskKind> m_maskData;               // contents of the Value's mask; empty if it has none or it is kept as sequence runs
+        bool m_maskHasSequenceRuns = false;
+        std::vector<bool> m_maskSequenceBeginFlags;     // the sequence runs of the Value's mask, see NDMask::GetSequenceRuns()
+        std::vector<size_t> m_maskSequenceLengths;
+        Microsoft::MSR::CNTK::MBLayoutPtr m_layout;
+        NDMaskPtr m_mask;
+        Microsoft::MSR::CNTK::MatrixBasePtr m_shuffleIndices; // gather/scatter indices of the columns; null if the data need not be shuffled
+    };
+
     class Utils
     {
     public:
         template <typename ElementType>
-        static std::pair<std::shared_ptr<const Microsoft::MSR::CNTK::Matrix<ElementType>>, Microsoft::MSR::CNTK::MBLayoutPtr> GetCNTKImplMatrixAndMBLayoutFromValueObject(const Variable& var, const ValuePtr& value);
+        static std::pair<std::shared_ptr<const Microsoft::MSR::CNTK::Matrix<ElementType>>, Microsoft::MSR::CNTK::MBLayoutPtr> GetCNTKImplMatrixAndMBLayoutFromValueObject(const Variable& var, const ValuePtr& value, ValueConversionCache* cache = nullptr);
 
         template <typename ElementType>
-        static ValuePtr GetValueObjectFromCNTKImplMatrixAndMBLayout(const NDShape& sampleShape, const Microsoft::MSR::CNTK::Matrix<ElementType>& matrix, const Microsoft::MSR::CNTK::MBLayoutPtr& layout, bool readOnly = true);
+        static ValuePtr GetValueObjectFromCNTKImplMatrixAndMBLayout(const NDShape& sampleShape, const Microsoft::MSR::CNTK::Matrix<ElementType>& matrix, const Microsoft::MSR::CNTK::MBLayoutPtr& layout, bool readOnly = true, ValueConversionCache* cache = nullptr);
 
         template <typename ElementType>
-        static ValuePtr GetValueObjectFromCNTKImplMatrixAndMBLayout(const Variable& var, const Microsoft::MSR::CNTK::Matrix<ElementType>& matrix, const Microsoft::MSR::CNTK::MBLayoutPtr& layout, bool readOnly = true);
+        static ValuePtr GetValueObjectFromCNTKImplMatrixAndMBLayout(const Variable& var, const Microsoft::MSR::CNTK::Matrix<ElementType>& matrix, const Microsoft::MSR::CNTK::MBLayoutPtr& layout, bool readOnly = true, ValueConversionCache* cache = nullptr);
     };
 }
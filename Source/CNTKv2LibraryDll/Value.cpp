@@ -39,7 +39,8 @@ namespace CNTK
         }
     }
 
-    static NDMaskPtr CreateMask(const std::vector<size_t>& sequenceLengths, const std::vector<bool>& sequenceStartFlags, const DeviceDescriptor& device)
+    // The mask is for sequences padded to 'paddedSequenceLength', or to the longest one if that is 0.
+    static NDMaskPtr CreateMask(const std::vector<size_t>& sequenceLengths, const std::vector<bool>& sequenceStartFlags, const DeviceDescriptor& device, size_t paddedSequenceLength = 0)
     {
         size_t numSequences = sequenceLengths.size();
 
@@ -50,7 +51,7 @@ namespace CNTK
         if (actualStarts.empty())
             actualStarts.resize(numSequences, true);
 
-        size_t maxSequenceLength = 0;
+        size_t maxSequenceLength = paddedSequenceLength;
         for (size_t i = 0; i < numSequences; ++i)
             maxSequenceLength = std::max(maxSequenceLength, sequenceLengths[i]);
 
@@ -131,7 +132,6 @@ namespace CNTK
     /*static*/ void Value::AppendSparseSequenceData(const NDArrayViewPtr& sequenceData, std::vector<SparseIndexType>& colStarts, std::vector<SparseIndexType>& rowIndices, std::vector<char>& nonZeroValues, size_t maxSequenceLength)
     {
         size_t existingNumNonZeroValues = nonZeroValues.size() / sizeof(ElementType);
-        std::vector<SparseIndexType> currentSequencePaddedColStarts(maxSequenceLength);
 
         auto matrix = sequenceData->GetMatrix<ElementType>();
         matrix->TransferToDeviceIfNotThere(AsCNTKImplDeviceId(DeviceDescriptor::CPUDevice()), true);
@@ -139,16 +139,14 @@ namespace CNTK
         auto currentSequenceNumCols = matrix->GetNumCols();
         auto currentSequenceColStarts = cpuSparseMatrix->SecondaryIndexLocation();
         auto currentSequenceNumNonZeroValues = currentSequenceColStarts[currentSequenceNumCols] - currentSequenceColStarts[0];
-        std::copy(cpuSparseMatrix->MajorIndexLocation(), cpuSparseMatrix->MajorIndexLocation() + currentSequenceNumNonZeroValues, std::back_inserter(rowIndices));
-        std::copy((char*)(cpuSparseMatrix->Data()), (char*)(cpuSparseMatrix->Data() + currentSequenceNumNonZeroValues), std::back_inserter(nonZeroValues));
+        rowIndices.insert(rowIndices.end(), cpuSparseMatrix->MajorIndexLocation(), cpuSparseMatrix->MajorIndexLocation() + currentSequenceNumNonZeroValues);
+        nonZeroValues.insert(nonZeroValues.end(), (const char*)(cpuSparseMatrix->Data()), (const char*)(cpuSparseMatrix->Data() + currentSequenceNumNonZeroValues));
 
+        // The columns of the sequence, padded to 'maxSequenceLength' with empty ones, are appended to the CSC column starts of the batch.
         for (size_t j = 0; j < currentSequenceNumCols; ++j)
-            currentSequencePaddedColStarts[j] = existingNumNonZeroValues + (currentSequenceColStarts[j] - currentSequenceColStarts[0]);
-
-        for (size_t j = currentSequenceNumCols; j < maxSequenceLength; ++j)
-            currentSequencePaddedColStarts[j] = existingNumNonZeroValues + currentSequenceNumNonZeroValues;
+            colStarts.push_back((SparseIndexType)(existingNumNonZeroValues + (currentSequenceColStarts[j] - currentSequenceColStarts[0])));
 
-        std::copy(currentSequencePaddedColStarts.begin(), currentSequencePaddedColStarts.end(), std::back_inserter(colStarts));
+        colStarts.resize(colStarts.size() + (maxSequenceLength - currentSequenceNumCols), (SparseIndexType)(existingNumNonZeroValues + currentSequenceNumNonZeroValues));
     }
 
     /*static*/ ValuePtr Value::Create(const NDShape& sampleShape, const std::vector<NDArrayViewPtr>& sequences, const std::vector<bool>& sequenceStartFlags, const DeviceDescriptor& device, bool readOnly, bool createNewCopy)
@@ -209,9 +207,11 @@ namespace CNTK
                 if (storageFormat != StorageFormat::SparseCSC)
                     LogicError("Value::Create currently only SparseCSC format data is supported");
 
+                // The batch is assembled in CSC form, and handed to the target device as such.
                 std::vector<SparseIndexType> colStarts;
                 std::vector<SparseIndexType> rowIndices;
                 std::vector<char> nonZeroValues;
+                colStarts.reserve((numSequences * maxSequenceLength) + 1);
                 for (size_t i = 0; i < numSequences; ++i)
                 {
                     switch (dataType)
@@ -233,7 +233,6 @@ namespace CNTK
                 switch (dataType)
                 {
                 case DataType::Float:
-                    // TODO: In case of sparse we can directly create on target device
                     valueData = MakeSharedObject<NDArrayView>(valueDataShape, colStarts.data(), rowIndices.data(), (float*)nonZeroValues.data(), totalNumNonZeroValues, device, readOnly);
                     break;
                 case DataType::Double:
@@ -291,6 +290,36 @@ namespace CNTK
         return MakeSharedObject<Value>(deviceValueData, deviceValueMask);
     }
 
+    /*static*/ ValuePtr Value::Create(const NDShape& sampleShape, const NDArrayViewPtr& paddedSequences, const std::vector<size_t>& sequenceLengths, const std::vector<bool>& sequenceStartFlags, bool readOnly)
+    {
+        auto numSequences = sequenceLengths.size();
+        if (numSequences == 0)
+            InvalidArgument("Value::Create:: The number of sequences is 0");
+
+        auto dataShape = paddedSequences->Shape();
+        if ((dataShape.Rank() != (sampleShape.Rank() + 2)) || (dataShape.SubShape(0, sampleShape.Rank()) != sampleShape) || (dataShape[dataShape.Rank() - 1] != numSequences))
+            InvalidArgument("Value::Create:: The shape of the padded sequences (%S) is not the sample shape (%S) followed by the sequence and batch axes of %lu sequences", AsStringForErrorReporting(dataShape).c_str(), AsStringForErrorReporting(sampleShape).c_str(), (unsigned long)numSequences);
+
+        if (paddedSequences->IsSparse())
+        {
+            if (sampleShape[0] != sampleShape.TotalSize())
+                InvalidArgument("Value::Create:: The sample shape's leading axis dimensionality must equal the total size of the sample for sparse data");
+
+            if (paddedSequences->GetStorageFormat() != StorageFormat::SparseCSC)
+                LogicError("Value::Create currently only SparseCSC format data is supported");
+        }
+
+        size_t paddedSequenceLength = dataShape[dataShape.Rank() - 2];
+        for (size_t i = 0; i < numSequences; ++i)
+        {
+            if (sequenceLengths[i] > paddedSequenceLength)
+                InvalidArgument("Value::Create:: The length (%lu) of the sequence %lu exceeds the padded sequence length (%lu)", (unsigned long)sequenceLengths[i], (unsigned long)i, (unsigned long)paddedSequenceLength);
+        }
+
+        NDMaskPtr deviceValueMask = CreateMask(sequenceLengths, sequenceStartFlags, DeviceDescriptor::CPUDevice(), paddedSequenceLength);
+        return MakeSharedObject<Value>(readOnly ? paddedSequences->Alias(readOnly) : paddedSequences, deviceValueMask);
+    }
+
     template <typename ElementType>
     /*static*/ ValuePtr Value::Create(const NDShape& sampleShape, const std::vector<std::vector<ElementType>>& sequences, const std::vector<bool>& sequenceStartFlags, const DeviceDescriptor& device, bool readOnly)
     {
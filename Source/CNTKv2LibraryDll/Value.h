@@ -34,6 +34,7 @@ namespace CNTK
         }
 
         void Unpack() const;
+        bool IsPacked() const { return m_isPacked; }
 
         const NDShape& Shape() const override { return m_unpackedShape; }
         DeviceDescriptor Device() const override { return m_isPacked ? m_packedData->Device() : Value::Device(); }
@@ -41,13 +41,17 @@ int bestGPUDummy = 42; // put something into this CPP, as to avoid a linker warn
 #define PATH_DELIMITER '\\'
 #elif defined(__UNIX__)
 #define PATH_DELIMITER '/'
+#include <sched.h>
+#include <unistd.h>
 #endif // __WINDOWS__
 #include <stdio.h>
 #include <string.h>
 #include <algorithm>
+#include <limits>
 
 #include <memory>
 #include "CrossProcessMutex.h"
+#include "Telemetry.h"
 
 // ---------------------------------------------------------------------------
 // BestGpu class
@@ -55,6 +59,13 @@ int bestGPUDummy = 42; // put something into this CPP, as to avoid a linker warn
 
 namespace Microsoft { namespace MSR { namespace CNTK {
 
+// CPU sets in the format of nvmlDeviceGetCpuAffinity(): bit i of word w is CPU w * bits per word + i
+static const size_t CpuSetWords = 1024 / (8 * sizeof(unsigned long));
+struct CpuSet
+{
+    unsigned long words[CpuSetWords];
+};
+
 struct ProcessorData
 {
     int cores;
@@ -65,8 +76,74 @@ struct ProcessorData
     size_t cudaTotalMem;
     bool cntkFound;
     int deviceId; // the deviceId (cuda side) for this processor
+    bool nvmlDeviceValid;
+    nvmlDevice_t nvmlDevice;
+    nvmlPciInfo_t pci;
+    bool cpuAffinityValid;
+    CpuSet cpuAffinity; // the CPUs close to the GPU (of its NUMA node)
 };
 
+// GetBoundCpus - Get the CPUs the calling thread may run on; returns false if those are all of them.
+static bool GetBoundCpus(CpuSet& cpus)
+{
+    memset(cpus.words, 0, sizeof(cpus.words));
+    const size_t bitsPerWord = 8 * sizeof(unsigned long);
+#ifdef __WINDOWS__
+    DWORD_PTR processMask, systemMask;
+    if (!GetProcessAffinityMask(GetCurrentProcess(), &processMask, &systemMask))
+        return false;
+    for (size_t cpu = 0; cpu < 8 * sizeof(DWORD_PTR) && cpu < CpuSetWords * bitsPerWord; cpu++)
+    {
+        if (processMask & ((DWORD_PTR)1 << cpu))
+            cpus.words[cpu / bitsPerWord] |= 1ul << (cpu % bitsPerWord);
+    }
+    return processMask != systemMask;
+#else
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    if (sched_getaffinity(0, sizeof(set), &set) != 0)
+        return false;
+    for (size_t cpu = 0; cpu < CPU_SETSIZE && cpu < CpuSetWords * bitsPerWord; cpu++)
+    {
+        if (CPU_ISSET(cpu, &set))
+            cpus.words[cpu / bitsPerWord] |= 1ul << (cpu % bitsPerWord);
+    }
+    return CPU_COUNT(&set) < sysconf(_SC_NPROCESSORS_ONLN);
+#endif
+}
+
+static bool Overlap(const CpuSet& a, const CpuSet& b)
+{
+    for (size_t w = 0; w < CpuSetWords; w++)
+    {
+        if (a.words[w] & b.words[w])
+            return true;
+    }
+    return false;
+}
+
+// CpuSetToString - e.g. "0-9,20-29"
+static std::string CpuSetToString(const CpuSet& cpus)
+{
+    const size_t bitsPerWord = 8 * sizeof(unsigned long);
+    const size_t numCpus = CpuSetWords * bitsPerWord;
+    auto contains = [&](size_t cpu) { return cpu < numCpus && (cpus.words[cpu / bitsPerWord] & (1ul << (cpu % bitsPerWord))) != 0; };
+    std::string result;
+    for (size_t cpu = 0; cpu < numCpus; cpu++)
+    {
+        if (!contains(cpu))
+            continue;
+        size_t last = cpu;
+        while (contains(last + 1))
+            last++;
+        result += msra::strfun::strprintf(result.empty() ? "%d" : ",%d", (int)cpu);
+        if (last > cpu)
+            result += msra::strfun::strprintf("-%d", (int)last);
+        cpu = last;
+    }
+    return result.empty() ? "none" : result;
+}
+
 enum BestGpuFlags
 {
     bestGpuNormal = 0,
@@ -75,6 +152,7 @@ enum BestGpuFlags
     bestGpuFavorUtilization = 4, // favor low utilization
     bestGpuFavorSpeed = 8,       // favor fastest processor
     bestGpuExclusiveLock = 16,   // obtain mutex for selected GPU
+    bestGpuFavorTopology = 32,   // favor GPUs close to those of the other processes, and to the CPUs the process runs on
     bestGpuRequery = 256,        // rerun the last query, updating statistics
 };
 
@@ -118,9 +196,14 @@ public:
     std::vector<int> GetDevices(int number = AllDevices, BestGpuFlags flags = bestGpuNormal); // get multiple devices
     std::vector<ProcessorData *> GetProcessorData();
     void UnlockDevice(int deviceId);
+    void BindToDeviceCpus(int deviceId);                                                      // run this thread, and those it creates, on the CPUs close to the GPU
+    void ReportDeviceSelection(int deviceId);
 
 private:
     bool LockDevice(int deviceId, bool trial = true);
+    ProcessorData* FindProcessorData(int deviceId);
+    double Closeness(const ProcessorData* pd, const ProcessorData* other, std::string* how = nullptr);
+    std::vector<int> m_devicesOfOthers; // locked by other processes at the last query
 };
 
 static DEVICEID_TYPE s_bestDeviceId = DEVICEID_NOTYETDETERMINED;
@@ -132,7 +215,8 @@ static std::unique_ptr<BestGpu> s_bestGpu = nullptr;
 // 'cpu'  - use the CPU
 // 0      - or some other single number, use a single GPU with CUDA ID same as the number
 // This can only be called with the same parameters each time, and 'auto' is determined upon first call.
-static DEVICEID_TYPE SelectDevice(DEVICEID_TYPE deviceId, bool bLockGPU, const intargvector& excludedDevices)
+// With 'bindToGpuCpus', an auto-selected GPU's process is bound to the CPUs close to it, unless it was bound already (e.g. by mpirun).
+static DEVICEID_TYPE SelectDevice(DEVICEID_TYPE deviceId, bool bLockGPU, const intargvector& excludedDevices, bool bindToGpuCpus = false)
 {
     // This can only be called with the same parameter.
     static DEVICEID_TYPE selectedDeviceId = DEVICEID_NOTYETDETERMINED;
@@ -158,7 +242,13 @@ static DEVICEID_TYPE SelectDevice(DEVICEID_TYPE deviceId, bool bLockGPU, const i
                 s_bestGpu->DisallowUnsupportedDevices();
             }
 
-            s_bestDeviceId = (DEVICEID_TYPE)s_bestGpu->GetDevice(BestGpuFlags(bLockGPU ? (bestGpuAvoidSharing | bestGpuExclusiveLock) : bestGpuAvoidSharing));
+            s_bestDeviceId = (DEVICEID_TYPE)s_bestGpu->GetDevice(BestGpuFlags(bestGpuAvoidSharing | bestGpuFavorTopology | (bLockGPU ? bestGpuExclusiveLock : 0)));
+            if (s_bestDeviceId >= 0)
+            {
+                if (bindToGpuCpus)
+                    s_bestGpu->BindToDeviceCpus(s_bestDeviceId);
+                s_bestGpu->ReportDeviceSelection(s_bestDeviceId);
+            }
             // TODO: Do we need to hold this pointer at all? We will only query it once. Or is it used to hold lock to a GPU?
         }
         // already chosen
@@ -186,6 +276,91 @@ void OnDeviceSelected(DEVICEID_TYPE deviceId)
     }
 }
 
+void AddNvmlTelemetryGauges(DEVICEID_TYPE deviceId)
+{
+    if (deviceId < 0)
+        return;
+
+    // NVML counts its initializations; this one stays for the lifetime of the process, as the gauges do
+    char busId[32];
+    nvmlDevice_t device;
+    if (cudaDeviceGetPCIBusId(busId, sizeof(busId), deviceId) != cudaSuccess)
+        return;
+    if (nvmlInit() != NVML_SUCCESS)
+        return;
+    if (nvmlDeviceGetHandleByPciBusId(busId, &device) != NVML_SUCCESS)
+    {
+        nvmlShutdown();
+        return;
+    }
+
+    std::string labels = "device=\"" + std::to_string(deviceId) + "\"";
+    // utilization over the sample period of the driver (between 1/6 s and 1 s, depending on the device)
+    auto utilization = [device](bool memory) -> double
+    {
+        nvmlUtilization_t rates;
+        if (nvmlDeviceGetUtilizationRates(device, &rates) != NVML_SUCCESS)
+            return std::numeric_limits<double>::quiet_NaN();
+        return (memory ? rates.memory : rates.gpu) / 100.0;
+    };
+    // throughput over the last 20 ms, in KB/s
+    auto pcieThroughput = [device](nvmlPcieUtilCounter_t counter) -> double
+    {
+        unsigned int value;
+        if (nvmlDeviceGetPcieThroughput(device, counter, &value) != NVML_SUCCESS)
+            return std::numeric_limits<double>::quiet_NaN();
+        return value * 1024.0;
+    };
+    Telemetry::AddGauge("cntk_gpu_sm_utilization_ratio", labels, "Fraction of time a kernel ran on the GPU.",
+                        [utilization]() { return utilization(false); });
+    Telemetry::AddGauge("cntk_gpu_memory_utilization_ratio", labels, "Fraction of time the GPU memory was read or written.",
+                        [utilization]() { return utilization(true); });
+    Telemetry::AddGauge("cntk_gpu_pcie_tx_bytes_per_second", labels, "PCIe throughput from the GPU.",
+                        [pcieThroughput]() { return pcieThroughput(NVML_PCIE_UTIL_TX_BYTES); });
+    Telemetry::AddGauge("cntk_gpu_pcie_rx_bytes_per_second", labels, "PCIe throughput to the GPU.",
+                        [pcieThroughput]() { return pcieThroughput(NVML_PCIE_UTIL_RX_BYTES); });
+}
+
+int GetDeviceNumaNode(DEVICEID_TYPE deviceId)
+{
+    char busId[32];
+    if (deviceId < 0 || cudaDeviceGetPCIBusId(busId, sizeof(busId), deviceId) != cudaSuccess)
+        return -1;
+#ifdef __WINDOWS__
+    // the node of the first CPU that NVML reports as close to the GPU
+    if (nvmlInit() != NVML_SUCCESS)
+        return -1;
+    int node = -1;
+    nvmlDevice_t device;
+    CpuSet cpus;
+    if (nvmlDeviceGetHandleByPciBusId(busId, &device) == NVML_SUCCESS && nvmlDeviceGetCpuAffinity(device, CpuSetWords, cpus.words) == NVML_SUCCESS)
+    {
+        const size_t bitsPerWord = 8 * sizeof(unsigned long);
+        for (size_t cpu = 0; cpu < CpuSetWords * bitsPerWord && node < 0; cpu++)
+        {
+            USHORT n;
+            PROCESSOR_NUMBER processor = { (WORD)(cpu / 64), (BYTE)(cpu % 64), 0 };
+            if ((cpus.words[cpu / bitsPerWord] & (1ul << (cpu % bitsPerWord))) && GetNumaProcessorNodeEx(&processor, &n) && n != 0xffff)
+                node = n;
+        }
+    }
+    nvmlShutdown();
+    return node;
+#else
+    // sysfs names the device in lower case, e.g. /sys/bus/pci/devices/0000:3b:00.0/numa_node
+    for (char* p = busId; *p; p++)
+        *p = (char) tolower(*p);
+    FILE* f = fopen(msra::strfun::strprintf("/sys/bus/pci/devices/%s/numa_node", busId).c_str(), "r");
+    if (f == nullptr)
+        return -1;
+    int node = -1;
+    if (fscanf(f, "%d", &node) != 1)
+        node = -1;
+    fclose(f);
+    return node; // -1 on machines without NUMA
+#endif
+}
+
 //#ifdef MATH_EXPORTS
 //__declspec(dllexport)
 //#endif
@@ -193,10 +368,11 @@ DEVICEID_TYPE DeviceFromConfig(const ScriptableObjects::IConfigRecord& config)
 {
     intargvector excludedDevices = ConfigArray(config(L"excludedDevices", ""), ':', false);
     bool bLockGPU = config(L"lockGPU", true);
+    bool bindToGpuCpus = config(L"bindToGpuCpus", true);
     // we need to deal with the old CNTK config semantics where 'deviceId' can be either a string or an int
     auto valpp = config.Find(L"deviceId");
     if (!valpp)
-        return SelectDevice(DEVICEID_AUTO, bLockGPU, excludedDevices); // not given at all: default
+        return SelectDevice(DEVICEID_AUTO, bLockGPU, excludedDevices, bindToGpuCpus); // not given at all: default
     auto valp = *valpp;                               // (the type is not determined at this point)
     if (valp.Is<ScriptableObjects::String>())
     {
@@ -204,7 +380,7 @@ DEVICEID_TYPE DeviceFromConfig(const ScriptableObjects::IConfigRecord& config)
         if (val == L"cpu")
             return SelectDevice(CPUDEVICE, false, excludedDevices);
         else if (val == L"auto")
-            return SelectDevice(DEVICEID_AUTO, bLockGPU, excludedDevices);
+            return SelectDevice(DEVICEID_AUTO, bLockGPU, excludedDevices, bindToGpuCpus);
         else
             InvalidArgument("Invalid value '%ls' for deviceId parameter. Allowed are 'auto' and 'cpu' (case-sensitive).", val.c_str());
     }
@@ -220,9 +396,10 @@ DEVICEID_TYPE DeviceFromConfig(const ConfigParameters& config)
     intargvector excludedDevices = ConfigArray(config("excludedDevices", ""), ':', false);
     ConfigValue val = config("deviceId", "auto");
     bool bLockGPU = config(L"lockGPU", true);
+    bool bindToGpuCpus = config(L"bindToGpuCpus", true);
 
     if (EqualCI(val, "cpu"))  return SelectDevice(CPUDEVICE, false, excludedDevices);
-    else if (EqualCI(val, "auto")) return SelectDevice(DEVICEID_AUTO, bLockGPU, excludedDevices);
+    else if (EqualCI(val, "auto")) return SelectDevice(DEVICEID_AUTO, bLockGPU, excludedDevices, bindToGpuCpus);
     else                           return SelectDevice((int)val, bLockGPU, excludedDevices);
 }
 
@@ -451,6 +628,8 @@ std::vector<int> BestGpu::GetDevices(int number, BestGpuFlags p_bestFlags)
     double speedW = 0.2;
     double freeMemW = 0.2;
     double mlAppRunningW = 0.2;
+    double topologyW = 0.3;
+    double numaW = 0.3;
 
     // if it's a requery, just use the same flags as last time
     if (bestFlags & bestGpuRequery)
@@ -475,6 +654,22 @@ std::vector<int> BestGpu::GetDevices(int number, BestGpuFlags p_bestFlags)
         speedW *= 2;
     }
 
+    // The GPUs locked by other processes are those of the other ranks of a job, if any: the GPUs closest to them
+    // exchange the gradients fastest. If the process was bound to some CPUs, the GPUs of their NUMA node are favored.
+    CpuSet processCpus;
+    bool processBound = false;
+    if (bestFlags & bestGpuFavorTopology)
+    {
+        m_devicesOfOthers.clear();
+        for (ProcessorData* pd : m_procData)
+        {
+            auto ours = m_GPUMutex.find(pd->deviceId);
+            if ((ours == m_GPUMutex.end() || !ours->second) && !LockDevice(pd->deviceId, true))
+                m_devicesOfOthers.push_back(pd->deviceId);
+        }
+        processBound = GetBoundCpus(processCpus);
+    }
+
     for (ProcessorData* pd : m_procData)
     {
         double score = 0.0;
@@ -492,6 +687,15 @@ std::vector<int> BestGpu::GetDevices(int number, BestGpuFlags p_bestFlags)
             mem = pd->cudaFreeMem / (double) pd->cudaTotalMem;
         score += mem * freeMemW;
         score += (pd->cntkFound ? 0 : 1) * mlAppRunningW;
+        if (bestFlags & bestGpuFavorTopology)
+        {
+            double closeness = 0;
+            for (int other : m_devicesOfOthers)
+                closeness = std::max(closeness, Closeness(pd, FindProcessorData(other)));
+            score += closeness * topologyW;
+            if (processBound && pd->cpuAffinityValid)
+                score += (Overlap(pd->cpuAffinity, processCpus) ? 1 : 0) * numaW;
+        }
         for (int i = 0; i < best.size(); i++)
         {
             // look for a better score
@@ -627,6 +831,133 @@ std::vector<ProcessorData*> BestGpu::GetProcessorData()
     return m_procData;
 }
 
+ProcessorData* BestGpu::FindProcessorData(int deviceId)
+{
+    for (ProcessorData* pd : m_procData)
+    {
+        if (pd->deviceId == deviceId)
+            return pd;
+    }
+    return nullptr;
+}
+
+// Closeness - How close two GPUs are on the interconnect, from 1 (NVLink) to 0 (behind different CPUs, or unknown)
+double BestGpu::Closeness(const ProcessorData* pd, const ProcessorData* other, std::string* how)
+{
+    if (how)
+        *how = "unknown";
+    if (!pd || !other || !pd->nvmlDeviceValid || !other->nvmlDeviceValid)
+        return 0;
+
+#ifdef NVML_NVLINK_MAX_LINKS
+    for (unsigned int link = 0; link < NVML_NVLINK_MAX_LINKS; link++)
+    {
+        nvmlEnableState_t active;
+        nvmlPciInfo_t remote;
+        if (nvmlDeviceGetNvLinkState(pd->nvmlDevice, link, &active) != NVML_SUCCESS)
+            break;
+        if (active == NVML_FEATURE_ENABLED && nvmlDeviceGetNvLinkRemotePciInfo(pd->nvmlDevice, link, &remote) == NVML_SUCCESS &&
+            remote.domain == other->pci.domain && remote.bus == other->pci.bus && remote.device == other->pci.device)
+        {
+            if (how)
+                *how = "NVLink";
+            return 1.0;
+        }
+    }
+#endif
+
+    // (not supported on Windows)
+    nvmlGpuTopologyLevel_t level;
+    if (nvmlDeviceGetTopologyCommonAncestor(pd->nvmlDevice, other->nvmlDevice, &level) != NVML_SUCCESS)
+        return 0;
+
+    // (the level between the host bridge and the system is that of the CPU, or NUMA node)
+    const char* path = "across CPUs";
+    double closeness = 0;
+    if (level <= NVML_TOPOLOGY_INTERNAL)
+    {
+        path = "same board";
+        closeness = 0.9;
+    }
+    else if (level <= NVML_TOPOLOGY_SINGLE)
+    {
+        path = "PCIe switch";
+        closeness = 0.8;
+    }
+    else if (level <= NVML_TOPOLOGY_MULTIPLE)
+    {
+        path = "PCIe switches";
+        closeness = 0.6;
+    }
+    else if (level <= NVML_TOPOLOGY_HOSTBRIDGE)
+    {
+        path = "PCIe host bridge";
+        closeness = 0.4;
+    }
+    else if (level < NVML_TOPOLOGY_SYSTEM)
+    {
+        path = "same CPU";
+        closeness = 0.2;
+    }
+    if (how)
+        *how = path;
+    return closeness;
+}
+
+// BindToDeviceCpus - Bind the calling thread to the CPUs close to the GPU, unless the process was bound already.
+// Threads created afterwards (e.g. those of the readers) inherit this.
+void BestGpu::BindToDeviceCpus(int deviceId)
+{
+    ProcessorData* pd = FindProcessorData(deviceId);
+    CpuSet bound;
+    if (!pd || !pd->cpuAffinityValid || GetBoundCpus(bound))
+        return;
+
+    const size_t bitsPerWord = 8 * sizeof(unsigned long);
+#ifdef __WINDOWS__
+    DWORD_PTR mask = 0;
+    for (size_t cpu = 0; cpu < 8 * sizeof(DWORD_PTR) && cpu < CpuSetWords * bitsPerWord; cpu++)
+    {
+        if (pd->cpuAffinity.words[cpu / bitsPerWord] & (1ul << (cpu % bitsPerWord)))
+            mask |= (DWORD_PTR)1 << cpu;
+    }
+    bool succeeded = mask != 0 && SetProcessAffinityMask(GetCurrentProcess(), mask);
+#else
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    for (size_t cpu = 0; cpu < CPU_SETSIZE && cpu < CpuSetWords * bitsPerWord; cpu++)
+    {
+        if (pd->cpuAffinity.words[cpu / bitsPerWord] & (1ul << (cpu % bitsPerWord)))
+            CPU_SET(cpu, &set);
+    }
+    bool succeeded = CPU_COUNT(&set) > 0 && sched_setaffinity(0, sizeof(set), &set) == 0;
+#endif
+    if (!succeeded)
+        fprintf(stderr, "BindToDeviceCpus: Failed to bind to the CPUs %s of GPU %d.\n", CpuSetToString(pd->cpuAffinity).c_str(), deviceId);
+}
+
+// ReportDeviceSelection - Log the GPU of this process, the CPUs it is close to, and its connections to the GPUs of the other processes
+void BestGpu::ReportDeviceSelection(int deviceId)
+{
+    ProcessorData* pd = FindProcessorData(deviceId);
+    if (!pd)
+        return;
+
+    std::string others;
+    for (int other : m_devicesOfOthers)
+    {
+        std::string how;
+        Closeness(pd, FindProcessorData(other), &how);
+        others += msra::strfun::strprintf(" %d (%s)", other, how.c_str());
+    }
+    CpuSet bound;
+    bool processBound = GetBoundCpus(bound);
+    fprintf(stderr, "SelectDevice: Process %d selected GPU %d (PCI %s), close to CPUs %s; the process runs on CPUs %s%s%s.\n",
+            (int)GetCurrentProcessId(), deviceId, pd->nvmlDeviceValid ? pd->pci.busId : "unknown",
+            pd->cpuAffinityValid ? CpuSetToString(pd->cpuAffinity).c_str() : "unknown", processBound ? CpuSetToString(bound).c_str() : "all",
+            others.empty() ? "" : "; GPUs of other processes:", others.c_str());
+}
+
 // QueryNvmlData - Query data from the Nvidia Management Library, and accumulate counters,
 // In case failure, this function simply backs out without filling in the data structure and without setting m_nvmlData.
 void BestGpu::QueryNvmlData()
@@ -665,6 +996,12 @@ void BestGpu::QueryNvmlData()
         if (curPd == NULL)
             continue;
 
+        curPd->nvmlDevice = device;
+        curPd->pci = pci;
+        curPd->nvmlDeviceValid = true;
+        if (!curPd->cpuAffinityValid)
+            curPd->cpuAffinityValid = nvmlDeviceGetCpuAffinity(device, CpuSetWords, curPd->cpuAffinity.words) == NVML_SUCCESS;
+
         // Get the memory usage, will only work for TCC drivers
         result = nvmlDeviceGetMemoryInfo(device, &memory);
         if (NVML_SUCCESS != result)
@@ -3,6 +3,7 @@
 // Licensed under the MIT license. See LICENSE.md file in the project root for full license information.
 //
 
+#include "Basics.h"
 #include "Globals.h"
 
 using namespace std;
@@ -15,6 +16,22 @@ namespace Microsoft { namespace MSR { namespace CNTK {
 
     std::atomic<bool> Globals::m_enableShareNodeValueMatrices(false);
     std::atomic<bool> Globals::m_enableHyperCompressMemory(false);
+    std::atomic<MemorySharingPolicy> Globals::m_memorySharingPolicy(MemorySharingPolicy::LIFO);
+    std::wstring Globals::m_memorySharingReportPath;
+    std::wstring Globals::m_validationCacheDirectory;
     std::atomic<bool> Globals::m_optimizeGradientAccumulation(true);
+    std::atomic<bool> Globals::m_skipGapColumns(false);
+
+    /*static*/ void Globals::SetMemorySharingPolicy(const std::wstring& policy)
+    {
+        if (policy == L"off")
+            SetMemorySharingPolicy(MemorySharingPolicy::Off);
+        else if (policy == L"lifo")
+            SetMemorySharingPolicy(MemorySharingPolicy::LIFO);
+        else if (policy == L"sizeAware")
+            SetMemorySharingPolicy(MemorySharingPolicy::SizeAware);
+        else
+            InvalidArgument("memorySharing: invalid policy '%ls'. Valid values are 'off', 'lifo' and 'sizeAware'.", policy.c_str());
+    }
 
 }}}
@@ -48,6 +48,12 @@ public:
     // -----------------------------------------------------------------------
     virtual void WaitAsyncBuffer() = 0;
 
+    // -----------------------------------------------------------------------
+    // FinishTraining() -- Tell the other nodes that this one has no more syncs, so that they do not wait for it
+    // when the staleness is bounded
+    // -----------------------------------------------------------------------
+    virtual void FinishTraining() = 0;
+
 };  // Class ASGDHelper
 
 // Factory method to create a ASGDHelper instance
@@ -62,6 +68,11 @@ ASGDHelper<ElemType>* NewASGDHelper(
     double adjustCoef = 0.2,                                                 // see in DecayCoefficient()
     size_t adjustPerMinibatches = 600,                                       //
     int traceLevel = 0,                                                      // log level
-    int syncPerfStats = 0);                                                  // shown perf data every syncPerfStats
+    int syncPerfStats = 0,                                                   // shown perf data every syncPerfStats
+    size_t sparseSyncMinColumns = 0,                                         // parameters with at least this many columns only sync their changed columns, 0: none
+    size_t sparseSyncFullPullPeriod = 10,                                    // ... and pull all columns every this many syncs
+    size_t stalenessBound = 0,                                               // a node more than this many syncs ahead of the slowest one waits, 0: unbounded
+    bool adaptiveStaleness = false,                                          // adapt the bound to the time nodes wait, between 1 and maxStalenessBound
+    size_t maxStalenessBound = 0);                                           // 0: 4 * stalenessBound
 
 }}}
@@ -0,0 +1,211 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE.md file in the project root for full license information.
+//
+// BatchingEvaluator.h -- dynamic batching of single evaluation requests on top of IEvaluateModelExtended
+//
+// This is a header-only client-side helper, so that no STL objects with threads or futures cross the DLL boundary.
+//
+#pragma once
+
+#include <algorithm>
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <future>
+#include <mutex>
+#include <stdexcept>
+#include <thread>
+#include <vector>
+#include "Eval.h"
+
+namespace Microsoft { namespace MSR { namespace CNTK {
+
+// what a BatchingEvaluator did so far
+struct BatchingStatistics
+{
+    size_t m_numRequests = 0;
+    size_t m_numBatches = 0;
+    std::vector<size_t> m_batchSizeHistogram; // [n] = number of batches of n requests
+    // latency from Submit() until the result is available, in microseconds, over the most recent requests
+    double m_latencyP50 = 0;
+    double m_latencyP90 = 0;
+    double m_latencyP99 = 0;
+    double m_latencyMax = 0;
+};
+
+// BatchingEvaluator -- evaluates requests from many threads in shared minibatches
+// Requests are queued by Submit(). A background thread takes up to 'maxBatchSize' of them as soon as that many are
+// waiting, or 'maxWait' after the oldest one arrived, evaluates them with one ForwardPassBatch() (each request is one
+// sequence; lengths may differ), and hands each its outputs through its future. A failing batch passes the exception
+// to all its requests.
+// Each output buffer is sized for as many samples as the longest input of its request.
+template <typename ElemType>
+class BatchingEvaluator
+{
+public:
+    // 'eval' must have been started by StartForwardEvaluation(). From now on it is only used by the batching thread,
+    // and it must outlive this object.
+    BatchingEvaluator(IEvaluateModelExtended<ElemType>* eval, size_t maxBatchSize, std::chrono::microseconds maxWait, size_t numLatencySamples = 10000)
+        : m_eval(eval), m_maxBatchSize(std::max(maxBatchSize, (size_t)1)), m_maxWait(maxWait),
+          m_inputSchema(eval->GetInputSchema()), m_outputSchema(eval->GetOutputSchema()),
+          m_numLatencySamples(std::max(numLatencySamples, (size_t)1)), m_nextLatencySample(0), m_stopping(false)
+    {
+        m_statistics.m_batchSizeHistogram.resize(m_maxBatchSize + 1, 0);
+        m_thread = std::thread([this] { Run(); });
+    }
+
+    // evaluates the pending requests, then stops
+    ~BatchingEvaluator()
+    {
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            m_stopping = true;
+        }
+        m_requestAvailable.notify_one();
+        m_thread.join();
+    }
+
+    BatchingEvaluator(const BatchingEvaluator&) = delete;
+    BatchingEvaluator& operator=(const BatchingEvaluator&) = delete;
+
+    // queue a request with one buffer per input, as for ForwardPass(); may be called from any thread
+    std::future<Values<ElemType>> Submit(Values<ElemType> inputs)
+    {
+        Request request;
+        request.m_inputs = std::move(inputs);
+        request.m_submitted = std::chrono::steady_clock::now();
+        auto result = request.m_result.get_future();
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            if (m_stopping)
+                throw std::logic_error("BatchingEvaluator: Submit() called while stopping.");
+            m_queue.push_back(std::move(request));
+        }
+        m_requestAvailable.notify_one();
+        return result;
+    }
+
+    BatchingStatistics GetStatistics() const
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        BatchingStatistics statistics = m_statistics;
+        if (!m_latencies.empty())
+        {
+            auto latencies = m_latencies;
+            std::sort(latencies.begin(), latencies.end());
+            auto percentile = [&latencies](double p) { return latencies[std::min((size_t)(p * latencies.size()), latencies.size() - 1)]; };
+            statistics.m_latencyP50 = percentile(0.5);
+            statistics.m_latencyP90 = percentile(0.9);
+            statistics.m_latencyP99 = percentile(0.99);
+            statistics.m_latencyMax = latencies.back();
+        }
+        return statistics;
+    }
+
+private:
+    struct Request
+    {
+        Values<ElemType> m_inputs;
+        std::promise<Values<ElemType>> m_result;
+        std::chrono::steady_clock::time_point m_submitted;
+    };
+
+    void Run()
+    {
+        std::unique_lock<std::mutex> lock(m_mutex);
+        for (;;)
+        {
+            m_requestAvailable.wait(lock, [this] { return m_stopping || !m_queue.empty(); });
+            if (m_queue.empty()) // stopping, and nothing left to do
+                return;
+
+            // wait for a full batch, but not longer than the oldest request may wait
+            auto deadline = m_queue.front().m_submitted + m_maxWait;
+            m_requestAvailable.wait_until(lock, deadline, [this] { return m_stopping || m_queue.size() >= m_maxBatchSize; });
+
+            std::vector<Request> batch;
+            while (!m_queue.empty() && batch.size() < m_maxBatchSize)
+            {
+                batch.push_back(std::move(m_queue.front()));
+                m_queue.pop_front();
+            }
+
+            lock.unlock();
+            Evaluate(batch);
+            auto now = std::chrono::steady_clock::now();
+            lock.lock();
+
+            m_statistics.m_numRequests += batch.size();
+            m_statistics.m_numBatches++;
+            m_statistics.m_batchSizeHistogram[batch.size()]++;
+            for (const auto& request : batch)
+            {
+                double latency = (double)std::chrono::duration_cast<std::chrono::microseconds>(now - request.m_submitted).count();
+                if (m_latencies.size() < m_numLatencySamples)
+                    m_latencies.push_back(latency);
+                else
+                    m_latencies[m_nextLatencySample] = latency;
+                m_nextLatencySample = (m_nextLatencySample + 1) % m_numLatencySamples;
+            }
+        }
+    }
+
+    void Evaluate(std::vector<Request>& batch)
+    {
+        std::vector<Values<ElemType>> inputs;
+        std::vector<Values<ElemType>> outputs;
+        for (auto& request : batch)
+        {
+            outputs.push_back(m_outputSchema.template CreateBuffers<ElemType>(std::vector<size_t>(m_outputSchema.size(), GetNumSamples(request.m_inputs))));
+            inputs.push_back(std::move(request.m_inputs));
+        }
+
+        try
+        {
+            m_eval->ForwardPassBatch(inputs, outputs);
+        }
+        catch (...)
+        {
+            auto exception = std::current_exception();
+            for (auto& request : batch)
+                request.m_result.set_exception(exception);
+            return;
+        }
+        for (size_t i = 0; i < batch.size(); ++i)
+            batch[i].m_result.set_value(std::move(outputs[i]));
+    }
+
+    // length of the longest input of a request
+    size_t GetNumSamples(const Values<ElemType>& inputs) const
+    {
+        size_t numSamples = 1;
+        for (size_t i = 0; i < inputs.size() && i < m_inputSchema.size(); ++i)
+        {
+            if (!inputs[i].m_colIndices.empty())
+                numSamples = std::max(numSamples, inputs[i].m_colIndices.size() - 1);
+            else if (m_inputSchema[i].m_numElements > 0)
+                numSamples = std::max(numSamples, inputs[i].m_buffer.size() / m_inputSchema[i].m_numElements);
+        }
+        return numSamples;
+    }
+
+    IEvaluateModelExtended<ElemType>* m_eval;
+    const size_t m_maxBatchSize;
+    const std::chrono::microseconds m_maxWait;
+    const VariableSchema m_inputSchema;
+    VariableSchema m_outputSchema;
+
+    mutable std::mutex m_mutex; // for all below
+    std::condition_variable m_requestAvailable;
+    std::deque<Request> m_queue;
+    BatchingStatistics m_statistics;
+    std::vector<double> m_latencies; // ring buffer of the most recent latencies
+    const size_t m_numLatencySamples;
+    size_t m_nextLatencySample;
+    bool m_stopping;
+
+    std::thread m_thread; // (last, so that it starts after everything is initialized)
+};
+
+}}}
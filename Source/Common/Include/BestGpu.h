@@ -57,6 +57,12 @@ DEVICEID_TYPE GetBestDevice();
 // is different from the best GPU id.
 void OnDeviceSelected(DEVICEID_TYPE deviceId);
 
+// Registers Telemetry gauges for the SM utilization and the PCIe throughput of a GPU, as NVML reports them.
+void AddNvmlTelemetryGauges(DEVICEID_TYPE deviceId);
+
+// Returns the NUMA node the GPU is attached to, or -1 if that is not known (e.g. the machine is not NUMA).
+int GetDeviceNumaNode(DEVICEID_TYPE deviceId);
+
 #else
 
 static inline DEVICEID_TYPE GetBestDevice()
@@ -66,6 +72,10 @@ static inline DEVICEID_TYPE GetBestDevice()
 
 static inline void OnDeviceSelected(DEVICEID_TYPE) {}
 
+static inline void AddNvmlTelemetryGauges(DEVICEID_TYPE) {}
+
+static inline int GetDeviceNumaNode(DEVICEID_TYPE) { return -1; }
+
 template <class ConfigRecordType>
 static inline DEVICEID_TYPE DeviceFromConfig(const ConfigRecordType& /*config*/)
 {
@@ -296,6 +296,40 @@ class VariableSchema : public std::vector<VariableLayout>
         }
 };
 
+//
+// State of one stream of a recurrent model between calls of IEvaluateModelExtended::ForwardPassStreams(), e.g. of one
+// audio stream that is evaluated chunk by chunk. Created by CreateStreamState(); released by Destroy().
+//
+class IEvalStreamState
+{
+public:
+    virtual void Destroy() = 0;
+
+protected:
+    virtual ~IEvalStreamState() {}
+};
+
+//
+// Settings of IEvaluateModelExtended::BeamSearch().
+//
+struct BeamSearchOptions
+{
+    std::wstring m_tokenInput; // name of the input that takes the last token, one-hot
+    size_t m_beamWidth;  // number of hypotheses kept after each step
+    size_t m_maxLength;  // maximum number of tokens of a hypothesis
+    size_t m_startToken; // fed to the first step
+    size_t m_endToken;   // completes a hypothesis
+};
+
+//
+// A token sequence found by IEvaluateModelExtended::BeamSearch(), with its score: the sum of the scores of its tokens.
+//
+struct BeamSearchHypothesis
+{
+    std::vector<size_t> m_tokens; // without the start token; ends with the end token, unless m_maxLength was reached
+    double m_score;
+};
+
 //
 // Extended interface, allowing for sparse input.
 // Implementation constraints: 
@@ -355,6 +389,50 @@ public:
     // resetRNN - flags whether to reset memory cells of RNN. 
     //
     virtual void ForwardPass(const ValueRefs<ElemType>& inputs, ValueRefs<ElemType>& output, bool resetRNN) = 0;
+
+    //
+    // CreateSharedEvaluator - create another evaluator for the model of this one (after CreateNetwork()) that shares
+    // the model parameters with it instead of loading them again. Each evaluator has its own activation buffers and
+    // state, so that evaluators can run ForwardPass() concurrently, one per thread. The new evaluator needs its own
+    // StartForwardEvaluation() and Destroy(); the parameters are freed when the last evaluator is destroyed.
+    // Concurrent evaluation is supported on the CPU; evaluators on the same GPU should not run at the same time.
+    //
+    virtual IEvaluateModelExtended<ElemType>* CreateSharedEvaluator() = 0;
+
+    //
+    // ForwardPassBatch - Evaluate several independent sequences in one forward pass, e.g. requests of different
+    // clients (see BatchingEvaluator.h). The sequences are packed side by side into one minibatch; RNN state is reset
+    // for each.
+    // inputs - one vector of input buffers per sequence, each as for ForwardPass(). Sequences may differ in length.
+    // outputs - one vector of output buffers per sequence, each preallocated as for ForwardPass(). Each receives the
+    //           samples of its own sequence.
+    //
+    virtual void ForwardPassBatch(const std::vector<Values<ElemType>>& inputs, std::vector<Values<ElemType>>& outputs) = 0;
+
+    //
+    // CreateStreamState - create the state of a new stream for ForwardPassStreams() (after StartForwardEvaluation()).
+    //
+    virtual IEvalStreamState* CreateStreamState() = 0;
+
+    //
+    // ForwardPassStreams - Same as ForwardPassBatch(), but each sequence is the next chunk of a stream, which continues
+    // from where the previous chunk of that stream left off. This way, one evaluator can serve many streams, in any mix
+    // per call. The carried state is that of PastValue nodes with a time step of 1; models with other delays or with
+    // OptimizedRNNStack are not supported.
+    // states - one per sequence, all different; a new one starts the stream. Is updated to the end of the chunk.
+    //
+    virtual void ForwardPassStreams(const std::vector<Values<ElemType>>& inputs, std::vector<Values<ElemType>>& outputs, const std::vector<IEvalStreamState*>& states) = 0;
+
+    //
+    // BeamSearch - Decode a token sequence with a recurrent model (e.g. the decoder of a sequence-to-sequence model), one
+    // token per step. All hypotheses of the beam are evaluated in one forward pass per step, as parallel sequences; the
+    // state carried from one step to the next is that of PastValue nodes with a time step of 1, as for ForwardPassStreams().
+    // The model has a single output (after StartForwardEvaluation()): the scores of the next token, e.g. log-probabilities.
+    // contextInputs - one sample for each input as given by GetInputSchema(), except options.m_tokenInput, given to every
+    //                 hypothesis at every step (e.g. an encoding of the source sequence).
+    // hypotheses - receives at most m_beamWidth hypotheses, best first. Those that end with the end token come first.
+    //
+    virtual void BeamSearch(const Values<ElemType>& contextInputs, const BeamSearchOptions& options, std::vector<BeamSearchHypothesis>& hypotheses) = 0;
 };
 
 template <typename ElemType>
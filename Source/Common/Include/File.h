@@ -101,6 +101,21 @@ private:
     int m_options;       // FileOptions ored togther
     void Init(const wchar_t* filename, int fileOptions);
 
+    // for GetFloatingPointArray()
+    template <typename TFile, typename T>
+    File& GetConvertedArray(T* data, size_t count)
+    {
+        std::vector<TFile> buffer(count < 65536 ? count : 65536);
+        for (size_t i = 0; i < count; i += buffer.size())
+        {
+            size_t n = count - i < buffer.size() ? count - i : buffer.size();
+            GetArray(buffer.data(), n);
+            for (size_t j = 0; j < n; j++)
+                data[i + j] = (T) buffer[j];
+        }
+        return *this;
+    }
+
 public:
     File(const std::wstring& filename, int fileOptions);
     File(const std::string&  filename, int fileOptions);
@@ -195,6 +210,47 @@ public:
         return *this;
     }
 
+    // put/get an array of basic types, e.g. the elements of a matrix; in one block for binary files
+    template <typename T>
+    File& PutArray(const T* data, size_t count)
+    {
+        if (IsTextBased())
+        {
+            for (size_t i = 0; i < count; i++)
+                *this << data[i];
+        }
+        else if (count > 0)
+            fwriteOrDie(data, sizeof(T), count, m_file);
+        return *this;
+    }
+    template <typename T>
+    File& GetArray(T* data, size_t count)
+    {
+        if (IsTextBased())
+        {
+            for (size_t i = 0; i < count; i++)
+                *this >> data[i];
+        }
+        else if (count > 0)
+            freadOrDie(data, sizeof(T), count, m_file);
+        return *this;
+    }
+    // get an array of floating-point values that may have been put in the other precision, e.g. the elements of a double
+    // matrix into a float one, where 'fileElementSize' is the size of an element in the file. The values are converted in
+    // blocks, so that they are never all in memory in the precision of the file.
+    template <typename T>
+    File& GetFloatingPointArray(T* data, size_t count, size_t fileElementSize)
+    {
+        if (fileElementSize == sizeof(T))
+            return GetArray(data, count);
+        else if (fileElementSize == sizeof(float))
+            return GetConvertedArray<float>(data, count);
+        else if (fileElementSize == sizeof(double))
+            return GetConvertedArray<double>(data, count);
+        else
+            RuntimeError("GetFloatingPointArray: Unexpected element size %d in the file.", (int) fileElementSize);
+    }
+
     void WriteString(const char* str, int size = 0);                   // zero terminated strings use size=0
     void ReadString(char* str, int size);                              // read up to size bytes, or a zero terminator (or space in text mode)
     void WriteString(const wchar_t* str, int size = 0);                // zero terminated strings use size=0
@@ -6,9 +6,18 @@
 #pragma once
 
 #include <atomic>
+#include <string>
 
 namespace Microsoft { namespace MSR { namespace CNTK {
 
+    // How ComputationNode matrices are shared through the MatrixPool
+    enum class MemorySharingPolicy
+    {
+        Off,      // no sharing; every matrix gets its own buffer
+        LIFO,     // reuse the most recently released matrix, regardless of its size
+        SizeAware // plan buffers from node lifetimes and requested sizes (best fit)
+    };
+
     // Class containing global configuration for CNTK.
     class Globals
     {
@@ -23,6 +32,10 @@ namespace Microsoft { namespace MSR { namespace CNTK {
         static void DisableGradientAccumulationOptimization() { m_optimizeGradientAccumulation = false; }
         static bool ShouldOptimizeGradientAccumulation() { return m_optimizeGradientAccumulation; }
 
+        // if set, products of a parameter by dense minibatch data with many gaps (padding) are computed on the valid columns only
+        static void EnableGapColumnSkipping() { m_skipGapColumns = true; }
+        static bool ShouldSkipGapColumns() { return m_skipGapColumns; }
+
         // TODO: Currently the flag is set to false. Should be switched to true after more rigorous testing.
         static bool UseV2Aggregator() { return false; }
 
@@ -46,13 +59,53 @@ namespace Microsoft { namespace MSR { namespace CNTK {
             return m_enableHyperCompressMemory;
         }
 
+        // accepts "off", "lifo" or "sizeAware"
+        static void SetMemorySharingPolicy(const std::wstring& policy);
+        static void SetMemorySharingPolicy(MemorySharingPolicy policy)
+        {
+            m_memorySharingPolicy = policy;
+        }
+
+        static MemorySharingPolicy GetMemorySharingPolicy()
+        {
+            return m_memorySharingPolicy;
+        }
+
+        // if set, ComputationNetwork writes a JSON report of the memory-sharing structure to this file
+        static void SetMemorySharingReportPath(const std::wstring& path)
+        {
+            m_memorySharingReportPath = path;
+        }
+
+        static const std::wstring& GetMemorySharingReportPath()
+        {
+            return m_memorySharingReportPath;
+        }
+
+        // if set, ComputationNetwork keeps the results of network validation in this directory, and restores them
+        // when it compiles a network with the same structure and input shapes again
+        static void SetValidationCacheDirectory(const std::wstring& directory)
+        {
+            m_validationCacheDirectory = directory;
+        }
+
+        static const std::wstring& GetValidationCacheDirectory()
+        {
+            return m_validationCacheDirectory;
+        }
+
     private:
         static std::atomic<bool> m_forceDeterministicAlgorithms;
         // The global flag to enable matrices values in forward and backward prop
         static std::atomic<bool> m_enableShareNodeValueMatrices;
         // The global flag to enable hyper memory compression 
         static std::atomic<bool> m_enableHyperCompressMemory;
+        // How node matrices are shared (see MatrixPool)
+        static std::atomic<MemorySharingPolicy> m_memorySharingPolicy;
+        static std::wstring m_memorySharingReportPath;
+        static std::wstring m_validationCacheDirectory;
         static std::atomic<bool> m_forceConstantRandomSeed;
         static std::atomic<bool> m_optimizeGradientAccumulation;
+        static std::atomic<bool> m_skipGapColumns;
     };
 }}}
@@ -17,6 +17,9 @@
 #pragma warning(pop)
 #else
 #include "mpi.h"
+#if defined(OPEN_MPI) && OPEN_MPI
+#include "mpi-ext.h" // for MPIX_Query_cuda_support()
+#endif
 #endif
 #pragma comment(lib, "msmpi.lib")
 
@@ -82,6 +85,13 @@ class MPIWrapper : public std::enable_shared_from_this<MPIWrapper>
     // MPI communicator that reflects the current subset selection
     MPI_Comm m_currentComm;
 
+    // sub-communicators of m_currentComm for the two-level all-reduce, see HierarchicalAllReduceAsync()
+    MPI_Comm m_localComm; // the workers on this host
+    MPI_Comm m_crossComm; // the workers with our local rank, one per host
+    int m_localRank;
+    int m_localSize;
+    bool m_useHierarchicalAllReduce;
+
     static MPIWrapperPtr s_mpi;
 
     // MPI_Init() with delay-loading the msmpi.dll (possibly causing a failure if missing; we want to catch that)
@@ -132,7 +142,7 @@ class MPIWrapper : public std::enable_shared_from_this<MPIWrapper>
 
 public:
     MPIWrapper()
-        : m_currentComm(MPI_COMM_WORLD)
+        : m_currentComm(MPI_COMM_WORLD), m_localComm(MPI_COMM_NULL), m_crossComm(MPI_COMM_NULL), m_localRank(0), m_localSize(1), m_useHierarchicalAllReduce(false)
     {
         static bool initialized = false;
         if (initialized)
@@ -342,6 +352,40 @@ private:
                 msg, (int) m_numNodesInUse, (int) m_numMPINodes, m_multiHost ? "multiple hosts" : "a single host",
                 (int) requestednodes, (int) CurrentNodeRank(), IsIdle() ? "out (idle)" : "in (participating)");
         fflush(stderr);
+
+        SplitByHost(msg);
+    }
+
+    // Creates the node-local and cross-node sub-communicators. The two-level all-reduce is used when there are
+    // multiple hosts with more than one worker each; it partitions the data by local rank, so all hosts must
+    // run the same number of workers.
+    void SplitByHost(const char *msg)
+    {
+        if (m_localComm != MPI_COMM_NULL)
+            MPI_Comm_free(&m_localComm) || MpiFail("requestnodes: MPI_Comm_free");
+        if (m_crossComm != MPI_COMM_NULL)
+            MPI_Comm_free(&m_crossComm) || MpiFail("requestnodes: MPI_Comm_free");
+
+        int rank = (int) CurrentNodeRank();
+        MPI_Comm_split_type(m_currentComm, MPI_COMM_TYPE_SHARED, rank, MPI_INFO_NULL, &m_localComm) || MpiFail("requestnodes: MPI_Comm_split_type");
+        MPI_Comm_rank(m_localComm, &m_localRank) || MpiFail("requestnodes: MPI_Comm_rank");
+        MPI_Comm_size(m_localComm, &m_localSize) || MpiFail("requestnodes: MPI_Comm_size");
+        MPI_Comm_split(m_currentComm, m_localRank, rank, &m_crossComm) || MpiFail("requestnodes: MPI_Comm_split");
+
+        // the largest and (negated) smallest number of workers per host
+        std::array<int, 2> localSizes = { m_localSize, -m_localSize };
+        MPI_Allreduce(MPI_IN_PLACE, localSizes.data(), (int) localSizes.size(), MPI_INT, MPI_MAX, m_currentComm) || MpiFail("requestnodes: MPI_Allreduce");
+        bool sameLocalSize = localSizes[0] == -localSizes[1];
+
+        int numHosts = 0;
+        MPI_Comm_size(m_crossComm, &numHosts) || MpiFail("requestnodes: MPI_Comm_size");
+        m_useHierarchicalAllReduce = m_multiHost && sameLocalSize && m_localSize > 1 && numHosts > 1;
+
+        if (m_useHierarchicalAllReduce)
+            fprintf(stderr, "requestnodes [%s]: %d workers on each of %d hosts, using two-level all-reduce\n", msg, m_localSize, numHosts);
+        else if (m_multiHost && !sameLocalSize)
+            fprintf(stderr, "requestnodes [%s]: %d to %d workers per host, not using two-level all-reduce\n", msg, -localSizes[1], localSizes[0]);
+        fflush(stderr);
     }
 
 public:
@@ -402,6 +446,37 @@ public:
         return m_multiHost;
     }
 
+    // whether AllReduce within the hosts, then across them, can be used, see HierarchicalAllReduceAsync()
+    bool UseHierarchicalAllReduce() const
+    {
+        return m_useHierarchicalAllReduce;
+    }
+    // whether the MPI implementation takes pointers to GPU memory (a CUDA-aware Open MPI)
+    bool IsCudaAware() const
+    {
+#if defined(MPIX_CUDA_AWARE_SUPPORT) && MPIX_CUDA_AWARE_SUPPORT
+        return MPIX_Query_cuda_support() == 1;
+#else
+        return false;
+#endif
+    }
+    size_t LocalNodeRank() const
+    {
+        return m_localRank;
+    }
+    size_t NumLocalNodes() const
+    {
+        return m_localSize;
+    }
+    MPI_Comm LocalCommunicator() const
+    {
+        return m_localComm;
+    }
+    MPI_Comm CrossCommunicator() const
+    {
+        return m_crossComm;
+    }
+
     // -----------------------------------------------------------------------
     // data-exchange functions (wrappers around MPI functions)
     // -----------------------------------------------------------------------
@@ -464,6 +539,27 @@ public:
         MPI_Allgather(sendData, (int)numSendElements, GetDataType(receiveData), receiveData, (int)numRecvElements, GetDataType(receiveData), Communicator()) || MpiFail("AllReduceAsync: MPI_Allgather");
     }
 
+    template <class ElemType>
+    void AllGatherv(const ElemType *sendData, size_t numSendElements, ElemType *receiveData, int recvCounts[], int offsets[]) const
+    {
+        MPI_Allgatherv(sendData, (int)numSendElements, GetDataType(receiveData), receiveData, recvCounts, offsets, GetDataType(receiveData), Communicator()) || MpiFail("AllGatherv: MPI_Allgatherv");
+    }
+
+    // every worker sends sendCounts[i] elements from sendData + sendOffsets[i] to worker i, and receives recvCounts[i]
+    // elements from worker i into receiveData + recvOffsets[i]
+    template <class ElemType>
+    void AllToAllv(const ElemType *sendData, int sendCounts[], int sendOffsets[], ElemType *receiveData, int recvCounts[], int recvOffsets[]) const
+    {
+        MPI_Alltoallv(sendData, sendCounts, sendOffsets, GetDataType(receiveData), receiveData, recvCounts, recvOffsets, GetDataType(receiveData), Communicator()) || MpiFail("AllToAllv: MPI_Alltoallv");
+    }
+
+    // sums 'sendData' over all workers; worker i receives the recvCounts[i] elements of the sum that follow those of workers 0..i-1
+    template <class ElemType>
+    void ReduceScatter(const ElemType *sendData, ElemType *receiveData, int recvCounts[], MPI_Op op = MPI_SUM) const
+    {
+        MPI_Reduce_scatter(sendData, receiveData, recvCounts, GetDataType(receiveData), op, Communicator()) || MpiFail("ReduceScatter: MPI_Reduce_scatter");
+    }
+
     template <class ElemType>
     void AllReduceAsync(ElemType *sendData, ElemType *receiveData, size_t numElements, MPI_Request* request, MPI_Op op = MPI_SUM) const
     {
@@ -476,6 +572,106 @@ public:
         MPI_Allreduce(sendData, receiveData, (int)numElements, GetDataType(sendData), op, Communicator()) || MpiFail("AllReduce: MPI_Allreduce");
     }
 
+    // State of a two-level all-reduce in flight. It runs as a reduce-scatter among the workers of a host, an all-reduce
+    // of each worker's part with the workers of the same local rank on the other hosts, and an all-gather within the host,
+    // so that only 1/NumLocalNodes() of the data crosses the slower links between the hosts per worker.
+    struct HierarchicalAllReduceRequest
+    {
+        enum class Phase { Done, ReduceScatter, CrossNode, AllGather };
+        Phase m_phase = Phase::Done;
+        MPI_Request m_request = MPI_REQUEST_NULL;
+        void* m_data = nullptr;
+        MPI_Datatype m_dataType = MPI_DATATYPE_NULL;
+        MPI_Op m_op = MPI_SUM;
+        std::vector<int> m_counts;  // number of elements of the part of each local rank
+        std::vector<int> m_offsets;
+        std::vector<char> m_part;   // our part of the data
+    };
+
+    // in-place two-level all-reduce, requires UseHierarchicalAllReduce(); progressed by TestHierarchicalAllReduce() and WaitHierarchicalAllReduce()
+    template <class ElemType>
+    void HierarchicalAllReduceAsync(ElemType *data, size_t numElements, HierarchicalAllReduceRequest* request, MPI_Op op = MPI_SUM) const
+    {
+        if (!m_useHierarchicalAllReduce)
+            LogicError("HierarchicalAllReduceAsync: two-level all-reduce cannot be used with this set of workers");
+        if (request->m_phase != HierarchicalAllReduceRequest::Phase::Done)
+            LogicError("HierarchicalAllReduceAsync: the request is still in flight");
+
+        request->m_data = data;
+        request->m_dataType = GetDataType(data);
+        request->m_op = op;
+        request->m_counts.resize(m_localSize);
+        request->m_offsets.resize(m_localSize);
+        int offset = 0;
+        for (int i = 0; i < m_localSize; i++)
+        {
+            request->m_counts[i] = (int) (numElements / m_localSize + (i < (int) (numElements % m_localSize) ? 1 : 0));
+            request->m_offsets[i] = offset;
+            offset += request->m_counts[i];
+        }
+        request->m_part.resize(request->m_counts[m_localRank] * sizeof(ElemType));
+
+        request->m_phase = HierarchicalAllReduceRequest::Phase::ReduceScatter;
+        MPI_Ireduce_scatter(data, request->m_part.data(), request->m_counts.data(), request->m_dataType, op, m_localComm, &request->m_request)
+            || MpiFail("HierarchicalAllReduceAsync: MPI_Ireduce_scatter");
+    }
+
+    template <class ElemType>
+    void HierarchicalAllReduce(ElemType *data, size_t numElements, MPI_Op op = MPI_SUM) const
+    {
+        HierarchicalAllReduceRequest request;
+        HierarchicalAllReduceAsync(data, numElements, &request, op);
+        WaitHierarchicalAllReduce(&request);
+    }
+
+    // starts the next phases of the request whose current ones have completed; returns whether the all-reduce is done
+    bool TestHierarchicalAllReduce(HierarchicalAllReduceRequest* request) const
+    {
+        while (request->m_phase != HierarchicalAllReduceRequest::Phase::Done)
+        {
+            int completed = 0;
+            MPI_Test(&request->m_request, &completed, MPI_STATUS_IGNORE) || MpiFail("TestHierarchicalAllReduce: MPI_Test");
+            if (!completed)
+                return false;
+            StartNextPhase(request);
+        }
+        return true;
+    }
+
+    void WaitHierarchicalAllReduce(HierarchicalAllReduceRequest* request) const
+    {
+        while (request->m_phase != HierarchicalAllReduceRequest::Phase::Done)
+        {
+            MPI_Wait(&request->m_request, MPI_STATUS_IGNORE) || MpiFail("WaitHierarchicalAllReduce: MPI_Wait");
+            StartNextPhase(request);
+        }
+    }
+
+private:
+    void StartNextPhase(HierarchicalAllReduceRequest* request) const
+    {
+        typedef HierarchicalAllReduceRequest::Phase Phase;
+        int count = request->m_counts[m_localRank];
+        switch (request->m_phase)
+        {
+        case Phase::ReduceScatter:
+            request->m_phase = Phase::CrossNode;
+            MPI_Iallreduce(MPI_IN_PLACE, request->m_part.data(), count, request->m_dataType, request->m_op, m_crossComm, &request->m_request)
+                || MpiFail("HierarchicalAllReduce: MPI_Iallreduce");
+            break;
+        case Phase::CrossNode:
+            request->m_phase = Phase::AllGather;
+            MPI_Iallgatherv(request->m_part.data(), count, request->m_dataType, request->m_data, request->m_counts.data(), request->m_offsets.data(),
+                            request->m_dataType, m_localComm, &request->m_request)
+                || MpiFail("HierarchicalAllReduce: MPI_Iallgatherv");
+            break;
+        default:
+            request->m_phase = Phase::Done;
+            break;
+        }
+    }
+
+public:
     template <class ElemType>
     void Gather(const ElemType *sendData, size_t numSendElements, ElemType *receiveData, size_t numRecvElements, size_t rootRank) const
     {
@@ -494,6 +690,12 @@ public:
         MPI_Bcast(pData, (int) nData, GetDataType(pData), (int) srcRank, Communicator()) || MpiFail("Bcast: MPI_Bcast");
     }
 
+    template <class ElemType>
+    void BcastAsync(ElemType *pData, size_t nData, size_t srcRank, MPI_Request* request)
+    {
+        MPI_Ibcast(pData, (int) nData, GetDataType(pData), (int) srcRank, Communicator(), request) || MpiFail("BcastAsync: MPI_Ibcast");
+    }
+
     // wait for an async request to finish
     void Wait(MPI_Request* request)
     {
@@ -0,0 +1,122 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE.md file in the project root for full license information.
+//
+
+#pragma once
+
+#ifdef __unix__
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <sys/mman.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+#include <errno.h>
+#include <string.h>
+#include <memory>
+#include <string>
+#include "Basics.h"
+
+namespace Microsoft { namespace MSR { namespace CNTK {
+
+// A read-only mapping of a whole file into memory. The pages are backed by the OS page cache,
+// so the processes on one machine that map the same file share a single copy of it.
+class MappedFile
+{
+public:
+    explicit MappedFile(const std::wstring& pathname)
+        : m_data(nullptr), m_size(0)
+    {
+#ifdef __WINDOWS__
+        m_file = CreateFileW(pathname.c_str(), GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+        if (m_file == INVALID_HANDLE_VALUE)
+            RuntimeError("Error opening file '%ls' for mapping, error %d.", pathname.c_str(), (int)GetLastError());
+
+        LARGE_INTEGER size;
+        if (!GetFileSizeEx(m_file, &size))
+        {
+            CloseHandle(m_file);
+            RuntimeError("Error getting the size of file '%ls', error %d.", pathname.c_str(), (int)GetLastError());
+        }
+        m_size = (size_t)size.QuadPart;
+
+        m_mapping = CreateFileMappingW(m_file, NULL, PAGE_READONLY, 0, 0, NULL);
+        if (m_mapping == NULL)
+        {
+            CloseHandle(m_file);
+            RuntimeError("Error mapping file '%ls', error %d.", pathname.c_str(), (int)GetLastError());
+        }
+
+        m_data = (const char*)MapViewOfFile(m_mapping, FILE_MAP_READ, 0, 0, 0);
+        if (m_data == nullptr)
+        {
+            CloseHandle(m_mapping);
+            CloseHandle(m_file);
+            RuntimeError("Error mapping file '%ls', error %d.", pathname.c_str(), (int)GetLastError());
+        }
+#else
+        std::string name = msra::strfun::utf8(pathname);
+        int fd = open(name.c_str(), O_RDONLY);
+        if (fd < 0)
+            RuntimeError("Error opening file '%s' for mapping: %s.", name.c_str(), strerror(errno));
+
+        struct stat st;
+        if (fstat(fd, &st) != 0)
+        {
+            close(fd);
+            RuntimeError("Error getting the size of file '%s': %s.", name.c_str(), strerror(errno));
+        }
+        m_size = (size_t)st.st_size;
+
+        void* data = mmap(nullptr, m_size, PROT_READ, MAP_SHARED, fd, 0);
+        // The mapping keeps its own reference to the file.
+        close(fd);
+        if (data == MAP_FAILED)
+            RuntimeError("Error mapping file '%s': %s.", name.c_str(), strerror(errno));
+        m_data = (const char*)data;
+#endif
+    }
+
+    ~MappedFile()
+    {
+#ifdef __WINDOWS__
+        UnmapViewOfFile(m_data);
+        CloseHandle(m_mapping);
+        CloseHandle(m_file);
+#else
+        munmap((void*)m_data, m_size);
+#endif
+    }
+
+    const char* GetData() const { return m_data; }
+    size_t GetSize() const { return m_size; }
+
+    // Tells the OS that the given range is going to be read soon, so that it can be paged in ahead.
+    void WillNeed(size_t offset, size_t size) const
+    {
+#ifdef __unix__
+        // madvise() wants a page aligned start.
+        size_t pageSize = (size_t)sysconf(_SC_PAGESIZE);
+        size_t start = offset / pageSize * pageSize;
+        madvise((void*)(m_data + start), size + offset - start, MADV_WILLNEED);
+#else
+        UNUSED(offset);
+        UNUSED(size);
+#endif
+    }
+
+private:
+    const char* m_data;
+    size_t m_size;
+#ifdef __WINDOWS__
+    HANDLE m_file;
+    HANDLE m_mapping;
+#endif
+
+    DISABLE_COPY_AND_MOVE(MappedFile);
+};
+
+typedef std::shared_ptr<MappedFile> MappedFilePtr;
+
+}}}
@@ -7,8 +7,10 @@
 
 #include <memory>     // for shared_ptr<>
 #include <functional> // for function<>
+#include <algorithm>
 #include <map>
 #include <set>
+#include <unordered_map>
 
 namespace Microsoft { namespace MSR { namespace ScriptableObjects {
 
@@ -530,7 +532,8 @@ class ConfigRecord : public Object, public IConfigRecord // all configuration ar
 {
     function<void(const std::wstring &)> failfn; // function to call in case of failure due to this value
     // change to ContextInsensitiveMap<ConfigValuePtr>
-    std::map<std::wstring, ConfigValuePtr> members;
+    // Hashed, since generated configurations can have records with many thousands of members, e.g. one per node.
+    std::unordered_map<std::wstring, ConfigValuePtr> members;
     IConfigRecordPtr parentScope; // we look up the chain
     ConfigRecord()
     {
@@ -581,11 +584,14 @@ public:
     }
     // get member ids; use this when you intend to consume all record entries and do not know the names
     // Note that unlike Find() and operator[], which return parent matches, this only returns entries in this record.
+    // The ids are sorted, so that consumers (e.g. the order in which a network is constructed) do not depend on the hashing.
     virtual std::vector<std::wstring> /*IConfigRecord::*/ GetMemberIds() const
     {
         std::vector<std::wstring> ids;
+        ids.reserve(members.size());
         for (auto &member : members)
             ids.push_back(member.first);
+        std::sort(ids.begin(), ids.end());
         return ids;
     }
 };
@@ -802,7 +808,7 @@ struct CustomConfigRecord : public IConfigRecord // any class that exposes confi
 
 protected:
     // cached return values from IConfigRecord implementation
-    mutable std::map<std::wstring, ScriptableObjects::ConfigValuePtr> members; // [id] -> cached ConfigValuePtr
+    mutable std::unordered_map<std::wstring, ScriptableObjects::ConfigValuePtr> members; // [id] -> cached ConfigValuePtr
 };
 
 // -----------------------------------------------------------------------
@@ -10,6 +10,7 @@
 #include <vector>
 #include <memory> // for shared_ptr
 #include <mutex>
+#include <list>
 #include "Basics.h"
 #include "Matrix.h"
 
@@ -109,7 +110,7 @@ struct MBLayout
     // -------------------------------------------------------------------
 
     MBLayout(size_t numParallelSequences, size_t numTimeSteps, const std::wstring &name)
-        : m_distanceToStart(CPUDEVICE), m_distanceToEnd(CPUDEVICE), m_columnsValidityMask(CPUDEVICE)
+        : m_distanceToStart(CPUDEVICE), m_distanceToEnd(CPUDEVICE)
     {
         Init(numParallelSequences, numTimeSteps);
         SetUniqueAxisName(name != L"" ? name : L"DynamicAxis");
@@ -139,7 +140,7 @@ struct MBLayout
 
         m_timeStepHasGap = other->m_timeStepHasGap;
 
-        m_columnsValidityMask.SetValue(other->m_columnsValidityMask);
+        m_columnsValidityMask = other->m_columnsValidityMask; // immutable, hence shared
         m_writable = other->m_writable;
 
         if (!keepName)
@@ -186,7 +187,7 @@ public:
         m_distanceToNearestStart.assign(m_numTimeSteps, PTRDIFF_MAX);
         m_distanceToNearestEnd.assign(m_numTimeSteps, PTRDIFF_MAX);
         m_timeStepHasGap.assign(m_numTimeSteps, false);
-        m_columnsValidityMask.Resize(0, 0); // invalidate
+        m_columnsValidityMask = nullptr; // invalidate
         // reset state
         m_numFramesDeclared = 0;
         m_numGapFrames = 0;
@@ -304,7 +305,9 @@ public:
     // This is used by MeanNode and InvStdDevNode, and by statistics reporting.
     size_t GetActualNumSamples() const;
 
-    const Matrix<char>& GetColumnsValidityMask(DEVICEID_TYPE deviceId) const;
+    // The mask is shared by all layouts with the same gaps and looked up by their hash, so that identical layouts
+    // (common with bucketing) upload it only once. A transferer uploads it asynchronously, e.g. with the data by the reader.
+    const Matrix<char>& GetColumnsValidityMask(DEVICEID_TYPE deviceId, DataTransferer* transferer = nullptr) const;
 
     // compare whether two layouts are the same
     bool operator==(const MBLayout& other) const
@@ -569,7 +572,27 @@ private:
     // TODO: We actually just need a boolean matrix for this.
     // A value of 1 indicates that the column has valid content
     // and 0 indicates invalid (aka MinibatchPackingFlags::NoInput)
-    mutable Matrix<char> m_columnsValidityMask;
+    mutable std::shared_ptr<const Matrix<char>> m_columnsValidityMask;
+
+    // the validity masks of the recently used layouts, by device
+    struct ColumnsValidityMaskCache
+    {
+        struct Entry
+        {
+            size_t m_hash;
+            std::vector<size_t> m_key; // device, dimensions and sequences without ids
+            std::shared_ptr<const Matrix<char>> m_mask;
+        };
+        static const size_t s_maxEntries = 64;
+        std::mutex m_mutex;
+        std::list<Entry> m_entries; // most recently used first
+    };
+    // never destroyed, because the masks would be freed after the device was released at exit
+    static ColumnsValidityMaskCache& GetColumnsValidityMaskCache()
+    {
+        static ColumnsValidityMaskCache* cache = new ColumnsValidityMaskCache();
+        return *cache;
+    }
 
     // A boolean flag indicating whether the MBLayout can be further modified
     // When it's value is false, no set operations are allowed on the MBLayout.
@@ -874,23 +897,52 @@ inline bool MBLayout::IsBeyondStartOrEnd(const FrameRange &fr) const
 inline size_t MBLayout::GetActualNumSamples() const { return m_numFramesDeclared - m_numGapFrames; }
 
 // return m_columnsValidityMask(,), which is lazily created here upon first call
-// only called from MaskMissingColumnsTo()
+// called from MaskMissingColumnsTo(), and by the ReaderShim to upload it with the data
 // TODO: Can probably be faster by using the sequence array directly.
-// TODO: Or should we just blast m_distanceToStart to GPU, and maks based on that? It is small compared to features.
-inline const Matrix<char>& MBLayout::GetColumnsValidityMask(DEVICEID_TYPE deviceId) const
+inline const Matrix<char>& MBLayout::GetColumnsValidityMask(DEVICEID_TYPE deviceId, DataTransferer* transferer) const
 {
     CheckIsValid();
-    // lazily compute the validity mask
-    if (m_columnsValidityMask.IsEmpty())
+    // lazily look up or compute the validity mask
+    if (!m_columnsValidityMask || m_columnsValidityMask->GetDeviceId() != deviceId)
     {
         assert(HasGaps()); // must only be called if there are gaps
         Lock();
 
-        // Determine indices of all invalid columns in the minibatch
-        // TODO: This can be done more efficiently by using m_sequences[].
         size_t nT = GetNumTimeSteps();
         size_t nS = GetNumParallelSequences();
 
+        // the mask depends on the placement of the sequences, not on their ids
+        std::vector<size_t> key;
+        key.reserve(3 + 4 * m_sequences.size());
+        key.push_back((size_t) deviceId);
+        key.push_back(nS);
+        key.push_back(nT);
+        for (const auto& seq : m_sequences)
+        {
+            key.push_back(seq.s);
+            key.push_back((size_t) seq.tBegin);
+            key.push_back(seq.tEnd);
+            key.push_back(seq.seqId == GAP_SEQUENCE_ID);
+        }
+        size_t hash = 14695981039346656037ull; // FNV-1a
+        for (size_t value : key)
+            hash = (hash ^ value) * 1099511628211ull;
+
+        auto& cache = GetColumnsValidityMaskCache();
+        {
+            std::lock_guard<std::mutex> lock(cache.m_mutex);
+            for (auto entry = cache.m_entries.begin(); entry != cache.m_entries.end(); ++entry)
+            {
+                if (entry->m_hash == hash && entry->m_key == key)
+                {
+                    cache.m_entries.splice(cache.m_entries.begin(), cache.m_entries, entry);
+                    m_columnsValidityMask = entry->m_mask;
+                    return *m_columnsValidityMask;
+                }
+            }
+        }
+
+        // Determine indices of all invalid columns in the minibatch
         std::vector<char> columnsValidityMask(nT * nS, 1); // form the mask in a CPU-side STL vector first
         size_t gapsFound = 0;
         for (size_t t = 0; t < nT; t++)
@@ -910,11 +962,22 @@ inline const Matrix<char>& MBLayout::GetColumnsValidityMask(DEVICEID_TYPE device
         }
         assert(gapsFound == m_numGapFrames); // sanity check
 
-        if (deviceId != m_columnsValidityMask.GetDeviceId())
-            m_columnsValidityMask = Matrix<char>(deviceId);
-        m_columnsValidityMask.SetValue(1, nS * nT, deviceId, columnsValidityMask.data());
+        auto mask = std::make_shared<Matrix<char>>(deviceId);
+        mask->SetValue(1, nS * nT, deviceId, columnsValidityMask.data(), matrixFlagNormal, transferer);
+        // other threads may only use it once it arrived (and the host vector must live until then)
+        if (transferer)
+        {
+            transferer->RecordCPUToGPUCopy();
+            transferer->WaitForCopyCPUToGPU();
+        }
+        m_columnsValidityMask = mask;
+
+        std::lock_guard<std::mutex> lock(cache.m_mutex);
+        cache.m_entries.push_front(ColumnsValidityMaskCache::Entry{ hash, std::move(key), mask });
+        if (cache.m_entries.size() > ColumnsValidityMaskCache::s_maxEntries)
+            cache.m_entries.pop_back();
     }
-    return m_columnsValidityMask;
+    return *m_columnsValidityMask;
 }
 
 // class for defining an iteration over a sequence, forward and backward
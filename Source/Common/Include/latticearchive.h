@@ -17,10 +17,12 @@
 #include "latticestorage.h"
 #include "simple_checked_arrays.h"
 #include "fileutil.h"
+#include "MappedFile.h"
 #include <vector>
 #include <string>
 #include <unordered_map>
 #include <algorithm> // for find()
+#include <random>
 #include "simplesenonehmm.h"
 #include "Matrix.h"
 
@@ -1078,6 +1080,7 @@ public:
         }; // true if functions in here are available or not
         void copyalignments(edgealignments& edgealignments);
         void entercomputation(const class msra::asr::simplesenonehmm& hmms, const mbrclassdefinition mbrclassdef); // pass models in (to GPU)
+        void setlatticecachesize(size_t bytes); // keep up to this much of uploaded lattices on the GPU for reuse (0 = none)
         // no exitcomputation(); tear down the object instead
         struct parallelstateimpl* operator->()
         {
@@ -1198,7 +1201,15 @@ class archive
         }
         return idmap;
     }
-    // all lattices read so far
+    // all lattices referenced by the TOC files
+    // Each TOC file is compiled into a binary index, which is kept next to it as TOCPATH.idx. While that is up to date,
+    // it is memory-mapped instead of parsing the TOC, so that startup costs next to nothing and all processes on a
+    // machine share one copy. Its layout:
+    //  - tocindexheader
+    //  - tocindexentry[numentries], sorted by key hash
+    //  - the keys, UTF-8, each 0-terminated (keybytes in total)
+    //  - the archive paths as written in the TOC, UTF-8, each 0-terminated; latticeref::archiveindex counts these
+    // A key is looked up by binary search for its hash; the key itself is compared to tell apart hash collisions.
     struct latticeref
     {
         uint64_t offset : 48;
@@ -1210,9 +1221,196 @@ class archive
     };
     static_assert(sizeof(latticeref) == 8, "unexpected byte size of struct latticeref");
 
-    mutable size_t currentarchiveindex;               // which archive is open
-    mutable auto_file_ptr f;                          // cached archive file handle of currentarchiveindex
-    std::unordered_map<std::wstring, latticeref> toc; // [key] -> (file, offset)  --table of content (.toc file)
+    struct tocindexheader
+    {
+        char magic[8]; // "LATIDX1"
+        uint64_t tocsize; // of the TOC file it was compiled from
+        uint64_t numentries;
+        uint64_t keybytes;
+        uint64_t archivepathbytes;
+    };
+    struct tocindexentry
+    {
+        uint64_t keyhash;
+        latticeref ref;     // archiveindex counts the archive paths of this TOC file
+        uint64_t keyoffset; // into the keys
+    };
+    static_assert(sizeof(tocindexentry) == 24, "unexpected byte size of struct tocindexentry");
+
+    struct tocindex
+    {
+        Microsoft::MSR::CNTK::MappedFilePtr mappedfile; // the index file, or
+        std::vector<char> compiled;                     // the index compiled from the TOC file if there was no usable index file
+        const tocindexentry* entries;
+        size_t numentries;
+        const char* keys;
+        std::vector<size_t> archiveindices; // [archiveindex in TOC file] -> archiveindex in archivepaths[]
+    };
+
+    mutable size_t currentarchiveindex; // which archive is open
+    mutable auto_file_ptr f;            // cached archive file handle of currentarchiveindex
+    std::vector<tocindex> tocs;         // [TOC file]  --table of content (.toc files); a key in several of them refers to the first
+    size_t numlattices;                 // in all tocs
+
+    static uint64_t hashkey(const char* key) // FNV-1a
+    {
+        uint64_t hash = 14695981039346656037ull;
+        for (; *key; key++)
+            hash = (hash ^ (unsigned char) *key) * 1099511628211ull;
+        return hash;
+    }
+
+    // parse the TOC file into the index format
+    static std::vector<char> compiletoc(const std::wstring& tocpath, uint64_t tocsize)
+    {
+        std::vector<char> textbuffer;
+        auto toclines = msra::files::fgetfilelines(tocpath, textbuffer, 3);
+
+        std::vector<tocindexentry> entries;
+        entries.reserve(toclines.size());
+        std::string keys;
+        std::vector<std::string> archivepaths;
+        size_t archiveindex = SIZE_MAX; // its index
+        foreach_index (i, toclines)
+        {
+            const char* line = toclines[i];
+            const char* p = strchr(line, '=');
+            if (p == NULL)
+                RuntimeError("open: invalid TOC line (no = sign): %s", line);
+            const size_t keyoffset = keys.size();
+            keys.append(line, p - line);
+            keys.push_back(0);
+            p++;
+            const char* q = strchr(p, '[');
+            if (q == NULL)
+                RuntimeError("open: invalid TOC line (no [): %s", line);
+            if (q != p)
+            {
+                std::string archivepath(p, q - p);
+                archiveindex = std::find(archivepaths.begin(), archivepaths.end(), archivepath) - archivepaths.begin();
+                if (archiveindex == archivepaths.size())
+                    archivepaths.push_back(archivepath);
+            }
+            if (archiveindex == SIZE_MAX)
+                RuntimeError("open: invalid TOC line (empty archive pathname): %s", line);
+            char c;
+            uint64_t offset;
+#ifdef _WIN32
+            if (sscanf_s(q, "[%I64u]%c", &offset, &c, (unsigned int)sizeof(c)) != 1)
+#else
+
+            if (sscanf(q, "[%" PRIu64 "]%c", &offset, &c) != 1)
+#endif
+                RuntimeError("open: invalid TOC line (bad [] expression): %s", line);
+            entries.push_back(tocindexentry{hashkey(keys.c_str() + keyoffset), latticeref(offset, archiveindex), keyoffset});
+        }
+
+        std::sort(entries.begin(), entries.end(), [&keys](const tocindexentry& a, const tocindexentry& b)
+                  {
+                      return a.keyhash != b.keyhash ? a.keyhash < b.keyhash : strcmp(keys.c_str() + a.keyoffset, keys.c_str() + b.keyoffset) < 0;
+                  });
+        for (size_t i = 1; i < entries.size(); i++)
+            if (entries[i].keyhash == entries[i - 1].keyhash && strcmp(keys.c_str() + entries[i].keyoffset, keys.c_str() + entries[i - 1].keyoffset) == 0)
+                RuntimeError("open: TOC entry leads to duplicate key: %s", keys.c_str() + entries[i].keyoffset);
+
+        std::string archivepathtext;
+        for (const auto& archivepath : archivepaths)
+        {
+            archivepathtext.append(archivepath);
+            archivepathtext.push_back(0);
+        }
+
+        tocindexheader header = {};
+        memcpy(header.magic, "LATIDX1", sizeof(header.magic));
+        header.tocsize = tocsize;
+        header.numentries = entries.size();
+        header.keybytes = keys.size();
+        header.archivepathbytes = archivepathtext.size();
+
+        std::vector<char> compiled(sizeof(header) + entries.size() * sizeof(tocindexentry) + keys.size() + archivepathtext.size());
+        char* out = compiled.data();
+        memcpy(out, &header, sizeof(header));
+        out += sizeof(header);
+        memcpy(out, entries.data(), entries.size() * sizeof(tocindexentry));
+        out += entries.size() * sizeof(tocindexentry);
+        memcpy(out, keys.data(), keys.size());
+        out += keys.size();
+        memcpy(out, archivepathtext.data(), archivepathtext.size());
+        return compiled;
+    }
+
+    // write the compiled index next to the TOC file for the next time; it is not an error if that is not possible
+    // It is written under a temporary name and renamed, so that processes opening the same TOC never see it partially.
+    static void savetocindex(const std::wstring& indexpath, const std::vector<char>& compiled)
+    {
+        const std::wstring tmppath = indexpath + L".tmp" + std::to_wstring(std::random_device()());
+        try
+        {
+            {
+                auto_file_ptr findex(fopenOrDie(tmppath, L"wb"));
+                fwriteOrDie(compiled.data(), sizeof(char), compiled.size(), findex);
+                fflushOrDie(findex);
+            }
+            renameOrDie(tmppath, indexpath);
+        }
+        catch (const std::exception& e)
+        {
+            fprintf(stderr, "open: could not save the lattice TOC index '%ls', parsing the TOC again next time: %s\n", indexpath.c_str(), e.what());
+            if (fexists(tmppath))
+                _wunlink(tmppath.c_str());
+        }
+    }
+
+    // set up the pointers into an index of 'size' bytes at 'data'; false if it is not a valid index of a TOC of 'tocsize' bytes
+    bool attachtocindex(tocindex& index, const char* data, size_t size, uint64_t tocsize)
+    {
+        tocindexheader header;
+        if (size < sizeof(header))
+            return false;
+        memcpy(&header, data, sizeof(header));
+        if (memcmp(header.magic, "LATIDX1", sizeof(header.magic)) != 0 || header.tocsize != tocsize ||
+            size != sizeof(header) + header.numentries * sizeof(tocindexentry) + header.keybytes + header.archivepathbytes)
+            return false;
+        index.entries = (const tocindexentry*) (data + sizeof(header));
+        index.numentries = header.numentries;
+        index.keys = data + sizeof(header) + header.numentries * sizeof(tocindexentry);
+        const char* archivepathtext = index.keys + header.keybytes;
+        for (const char* p = archivepathtext; p < archivepathtext + header.archivepathbytes; p += strlen(p) + 1)
+        {
+            std::wstring archivepath = msra::strfun::utf16(p);
+            if (!prefixPathInToc.empty())
+            {
+                archivepath = prefixPathInToc + L"/" + archivepath;
+            }
+            // TODO: should we allow paths relative to TOC file?
+            index.archiveindices.push_back(getarchiveindex(archivepath));
+        }
+        return true;
+    }
+
+    // find a lattice in the tocs; NULL if not found
+    const tocindexentry* findlattice(const std::wstring& key, const tocindex*& foundtoc) const
+    {
+        const std::string utf8key = msra::strfun::utf8(key);
+        const uint64_t keyhash = hashkey(utf8key.c_str());
+        for (const auto& toc : tocs)
+        {
+            auto entry = std::lower_bound(toc.entries, toc.entries + toc.numentries, keyhash, [](const tocindexentry& e, uint64_t h)
+                                          {
+                                              return e.keyhash < h;
+                                          });
+            for (; entry != toc.entries + toc.numentries && entry->keyhash == keyhash; entry++)
+            {
+                if (strcmp(toc.keys + entry->keyoffset, utf8key.c_str()) == 0)
+                {
+                    foundtoc = &toc;
+                    return entry;
+                }
+            }
+        }
+        return NULL;
+    }
+
 public:
     // construct = open the archive
     // archive() : currentarchiveindex (SIZE_MAX) {}
@@ -1228,7 +1426,7 @@ public:
 
     // construct from a list of TOC files
     archive(const std::vector<std::wstring>& tocpaths, const std::unordered_map<std::string, size_t>& modelsymmap, const std::wstring prefixPath = L"")
-        : currentarchiveindex(SIZE_MAX), modelsymmap(modelsymmap), prefixPathInToc(prefixPath), verbosity(0)
+        : currentarchiveindex(SIZE_MAX), numlattices(0), modelsymmap(modelsymmap), prefixPathInToc(prefixPath), verbosity(0)
     {
         if (tocpaths.empty()) // nothing to read--keep silent
             return;
@@ -1240,7 +1438,7 @@ public:
                 fprintf(stderr, ".");
             open(tocpaths[i]);
         }
-        fprintf(stderr, " %d total lattices referenced in %d archive files\n", (int) toc.size(), (int) archivepaths.size());
+        fprintf(stderr, " %d total lattices referenced in %d archive files\n", (int) numlattices, (int) archivepaths.size());
     }
 
     // open an archive
@@ -1249,47 +1447,28 @@ public:
     void open(const std::wstring& tocpath)
     {
         // BUGBUG: we only really support one archive file at this point
-        // read the TOC in one swoop
-        std::vector<char> textbuffer;
-        auto toclines = msra::files::fgetfilelines(tocpath, textbuffer, 3);
-
-        // parse it one by one
-        size_t archiveindex = SIZE_MAX; // its index
-        foreach_index (i, toclines)
+        // map the compiled index if it is up to date, otherwise compile the TOC and save the index for next time
+        const std::wstring indexpath = tocpath + L".idx";
+        const uint64_t tocsize = (uint64_t) filesize64(tocpath.c_str());
+        tocs.push_back(tocindex());
+        tocindex& index = tocs.back();
+        if (msra::files::fuptodate(indexpath, tocpath))
         {
-            const char* line = toclines[i];
-            const char* p = strchr(line, '=');
-            if (p == NULL)
-                RuntimeError("open: invalid TOC line (no = sign): %s", line);
-            const std::wstring key = msra::strfun::utf16(std::string(line, p - line));
-            p++;
-            const char* q = strchr(p, '[');
-            if (q == NULL)
-                RuntimeError("open: invalid TOC line (no [): %s", line);
-            if (q != p)
+            index.mappedfile = std::make_shared<Microsoft::MSR::CNTK::MappedFile>(indexpath);
+            if (!attachtocindex(index, index.mappedfile->GetData(), index.mappedfile->GetSize(), tocsize))
             {
-                std::wstring archivepath = msra::strfun::utf16(std::string(p, q - p));
-                if (!prefixPathInToc.empty())
-                {
-                    archivepath = prefixPathInToc + L"/" + archivepath;
-                }
-                // TODO: should we allow paths relative to TOC file?
-                archiveindex = getarchiveindex(archivepath);
+                fprintf(stderr, "open: ignoring invalid lattice TOC index '%ls'\n", indexpath.c_str());
+                index = tocindex();
             }
-            if (archiveindex == SIZE_MAX)
-                RuntimeError("open: invalid TOC line (empty archive pathname): %s", line);
-            char c;
-            uint64_t offset;
-#ifdef _WIN32
-            if (sscanf_s(q, "[%I64u]%c", &offset, &c, (unsigned int)sizeof(c)) != 1)
-#else
-
-            if (sscanf(q, "[%" PRIu64 "]%c", &offset, &c) != 1)
-#endif
-                RuntimeError("open: invalid TOC line (bad [] expression): %s", line);
-            if (!toc.insert(make_pair(key, latticeref(offset, archiveindex))).second)
-                RuntimeError("open: TOC entry leads to duplicate key: %s", line);
         }
+        if (!index.mappedfile)
+        {
+            index.compiled = compiletoc(tocpath, tocsize);
+            savetocindex(indexpath, index.compiled);
+            if (!attachtocindex(index, index.compiled.data(), index.compiled.size(), tocsize))
+                LogicError("open: compiled lattice TOC index is inconsistent");
+        }
+        numlattices += index.numentries;
 
         // initialize symmaps  --alloc the array, but actually read the symmap on demand
         symmaps.resize(archivepaths.size());
@@ -1298,7 +1477,8 @@ public:
     // check if a lattice for a given key is available  --do this during initial check ideally
     bool haslattice(const std::wstring& key) const
     {
-        return toc.find(key) != toc.end();
+        const tocindex* toc;
+        return findlattice(key, toc) != NULL;
     }
 
 #if 0 // TODO: change design to keep the #frames in the TOC, so we can check for mismatches before entering the training iteration
@@ -1321,12 +1501,13 @@ public:
     void getlattice(const std::wstring& key, lattice& L,
                     size_t expectedframes = SIZE_MAX /*if unknown*/) const
     {
-        auto iter = toc.find(key);
-        if (iter == toc.end())
+        const tocindex* toc;
+        auto entry = findlattice(key, toc);
+        if (entry == NULL)
             LogicError("getlattice: requested lattice for non-existent key; haslattice() should have been used to check availability");
         // get the archive that the lattice lives in and its byte offset
-        const size_t archiveindex = iter->second.archiveindex;
-        const auto offset = iter->second.offset;
+        const size_t archiveindex = toc->archiveindices[entry->ref.archiveindex];
+        const uint64_t offset = entry->ref.offset;
         // get id map (used below); this may lazily load a .symlist file. We do it here rather than later w.r.t. an outer retry loop.
         auto& idmap = getcachedidmap(archiveindex, modelsymmap); // at first time, this will load the .symlist file and create a mapping to the user SYMMAP
         const size_t spunit = idmap.back();                      // ugh--getcachedidmap() just appends it to the end
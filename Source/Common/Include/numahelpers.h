@@ -10,6 +10,9 @@
 #ifndef __unix__
 #include <Windows.h>
 #include "pplhelpers.h"
+#else
+#include <sched.h>
+#include <unistd.h>
 #endif
 #include <stdexcept>
 #include "simple_checked_arrays.h"
@@ -26,6 +29,7 @@ static inline void overridenode(int n = -1)
     node_override = n;
 }
 
+#ifndef __unix__
 // get the number of NUMA nodes we would like to distinguish
 static inline size_t getnumnodes()
 {
@@ -186,6 +190,70 @@ static inline size_t getmostspaciousnumanode()
     return bestnode;
 }
 
+#else // __unix__: the nodes as the kernel lists them in sysfs
+
+// get the number of NUMA nodes we would like to distinguish
+static inline size_t getnumnodes()
+{
+    size_t n = 0;
+    while (access(msra::strfun::strprintf("/sys/devices/system/node/node%d", (int) n).c_str(), F_OK) == 0)
+        n++;
+    return n > 0 ? n : 1;
+}
+
+// get the current NUMA node
+static inline size_t getcurrentnode()
+{
+    if (node_override >= 0)
+        return (size_t) node_override;
+    int cpu = sched_getcpu();
+    if (cpu < 0)
+        return 0;
+    const size_t n = getnumnodes();
+    for (size_t i = 0; i < n; i++)
+    {
+        if (access(msra::strfun::strprintf("/sys/devices/system/node/node%d/cpu%d", (int) i, cpu).c_str(), F_OK) == 0)
+            return i;
+    }
+    return 0;
+}
+#endif
+
+// bind the calling thread, and the threads it creates from now on, to the CPUs of a NUMA node
+// Memory is placed on the node of the CPU that touches it first, so the buffers this thread fills will be local to that node.
+// Returns false if the node does not exist or the binding failed.
+static inline bool bindcurrentthreadtonode(size_t node)
+{
+    if (node >= getnumnodes())
+        return false;
+#ifndef __unix__
+    GROUP_AFFINITY affinity = {};
+    return GetNumaNodeProcessorMaskEx((USHORT) node, &affinity) && affinity.Mask != 0 && SetThreadGroupAffinity(GetCurrentThread(), &affinity, NULL);
+#else
+    // the CPUs of the node, e.g. "0-7,16-23"
+    FILE* f = fopen(msra::strfun::strprintf("/sys/devices/system/node/node%d/cpulist", (int) node).c_str(), "r");
+    if (f == nullptr)
+        return false;
+    char buf[4096];
+    bool haveList = fgets(buf, sizeof(buf), f) != nullptr;
+    fclose(f);
+    if (!haveList)
+        return false;
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    for (char* p = buf; *p >= '0' && *p <= '9';)
+    {
+        long first = strtol(p, &p, 10);
+        long last = *p == '-' ? strtol(p + 1, &p, 10) : first;
+        for (long cpu = first; cpu <= last && cpu < CPU_SETSIZE; cpu++)
+            CPU_SET(cpu, &set);
+        if (*p == ',')
+            p++;
+    }
+    return CPU_COUNT(&set) > 0 && sched_setaffinity(0, sizeof(set), &set) == 0;
+#endif
+}
+
 #if 0 // this is no longer used (we now parallelize the big matrix products directly)
 // class to manage multiple copies of data on local NUMA nodes
 template<class DATATYPE,class CACHEDTYPE> class numalocaldatacache
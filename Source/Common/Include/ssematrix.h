@@ -20,6 +20,7 @@
 #include "numahelpers.h"
 #endif
 #include "fileutil.h" // for saving and reading matrices
+#include "CPUTensorKernels.h" // for the vectorized kernels of the host's instruction set
 #include <limits>     // for NaN
 #include <malloc.h>
 
@@ -372,6 +373,12 @@ public:
         return result;
     }
 
+    // c = alpha * a + beta * c, for the instruction set of the host
+    static Microsoft::MSR::CNTK::CPUUnaryTensorKernel copykernel()
+    {
+        return Microsoft::MSR::CNTK::CPUTensorKernels::Get().Unary(Microsoft::MSR::CNTK::ElementWiseOperator::opCopy);
+    }
+
     // dot product of two vectors (which may or may not be columns matrices)
     // If 'addtoresult' then scale the result then add to it weighted, rather than overwriting it.
     static void dotprod(const_array_ref<float> a, const_array_ref<float> b, float &result)
@@ -383,21 +390,14 @@ public:
                         bool addtoresult, const float thisscale, const float weight)
     {
         assert(a.size() == b.size());
-        assert((15 & reinterpret_cast<uintptr_t>(&a[0])) == 0);
-        assert((15 & reinterpret_cast<uintptr_t>(&b[0])) == 0); // enforce SSE alignment
-
-        size_t nlong = (a.size() + 3) / 4; // number of SSE elements
-        const msra::math::float4 *pa = (const msra::math::float4 *) &a[0];
-        const msra::math::float4 *pb = (const msra::math::float4 *) &b[0];
 
-        msra::math::float4 acc = pa[0] * pb[0];
-        for (size_t m = 1; m < nlong; m++)
-            acc += pa[m] * pb[m];
-        // final sum
+        float dot = 0.0f;
+        if (a.size() > 0)
+            Microsoft::MSR::CNTK::CPUTensorKernels::Get().Dot()(&a[0], &b[0], 0, 1, a.size(), &dot);
         if (addtoresult)
-            result = result * thisscale + weight * acc.sum();
+            result = result * thisscale + weight * dot;
         else
-            result = acc.sum();
+            result = dot;
     }
 
     // dot product of a matrix row with 4 columns at the same time
@@ -418,76 +418,22 @@ public:
         // What this function computes is this:
         // for (size_t k = 0; k < 4; k++)
         //     dotprod (row, const_array_ref<float> (&cols4[k * cols4stride], cols4stride), usij[k * usijstride]);
+        // The kernel is that of the widest instruction set of the host (baseline, AVX2 or AVX-512), chosen at run time.
 
-        assert((15 & reinterpret_cast<uintptr_t>(&row[0])) == 0);
-        assert((15 & reinterpret_cast<uintptr_t>(&cols4[0])) == 0);
-        assert((15 & reinterpret_cast<uintptr_t>(&cols4[cols4stride])) == 0);
-        // assert (cols4stride * 4 == cols4.size());     // (passed in one vector with 4 columns stacked on top of each other)
         // assert (row.size() * 4 == cols4.size());  // this assert is no longer appropriate because of further breaking into blocks
+        assert(cols4.size() >= 3 * cols4stride + row.size());
 
-        // perform multiple columns in parallel
-        const size_t nlong = (row.size() + 3) / 4; // number of SSE elements
-
-        // row
-        const msra::math::float4 *prow = (const msra::math::float4 *) &row[0];
-
-        // columns
-        const msra::math::float4 *pcol0 = (const msra::math::float4 *) &cols4[0 * cols4stride];
-        const msra::math::float4 *pcol1 = (const msra::math::float4 *) &cols4[1 * cols4stride];
-        const msra::math::float4 *pcol2 = (const msra::math::float4 *) &cols4[2 * cols4stride];
-        const msra::math::float4 *pcol3 = (const msra::math::float4 *) &cols4[3 * cols4stride];
-
-        // accumulation loop
-        msra::math::float4 acc0 = prow[0] * pcol0[0];
-        msra::math::float4 acc1 = prow[0] * pcol1[0];
-        msra::math::float4 acc2 = prow[0] * pcol2[0];
-        msra::math::float4 acc3 = prow[0] * pcol3[0];
-#if 1 // prefetch is not helping
-        for (size_t m = 1; m < nlong; m++)
-        {
-            acc0 += prow[m] * pcol0[m];
-            acc1 += prow[m] * pcol1[m];
-            acc2 += prow[m] * pcol2[m];
-            acc3 += prow[m] * pcol3[m];
-        }
-#else
-        const size_t prefetch = 1; // 128/sizeof(acc0);
-        size_t m;
-        for (m = 1; m < nlong - prefetch; m++)
-        {
-            acc0 += prow[m] * pcol0[m];
-            acc1 += prow[m] * pcol1[m];
-            acc2 += prow[m] * pcol2[m];
-            acc3 += prow[m] * pcol3[m];
-            msra::math::float4::prefetch(&prow[m + prefetch]);
-            msra::math::float4::prefetch(&pcol0[m + prefetch]);
-            msra::math::float4::prefetch(&pcol1[m + prefetch]);
-            msra::math::float4::prefetch(&pcol2[m + prefetch]);
-            msra::math::float4::prefetch(&pcol3[m + prefetch]);
-        }
-        for (; m < nlong; m++)
-        {
-            acc0 += prow[m] * pcol0[m];
-            acc1 += prow[m] * pcol1[m];
-            acc2 += prow[m] * pcol2[m];
-            acc3 += prow[m] * pcol3[m];
-        }
-#endif
+        float dots[4] = {0.0f, 0.0f, 0.0f, 0.0f};
+        if (row.size() > 0)
+            Microsoft::MSR::CNTK::CPUTensorKernels::Get().Dot()(&row[0], &cols4[0], cols4stride, 4, row.size(), dots);
 
         // final sum
-        if (addtoresult)
+        for (size_t k = 0; k < 4; k++)
         {
-            usij[0 * usijstride] = usij[0 * usijstride] * thisscale + weight * acc0.sum();
-            usij[1 * usijstride] = usij[1 * usijstride] * thisscale + weight * acc1.sum();
-            usij[2 * usijstride] = usij[2 * usijstride] * thisscale + weight * acc2.sum();
-            usij[3 * usijstride] = usij[3 * usijstride] * thisscale + weight * acc3.sum();
-        }
-        else
-        {
-            usij[0 * usijstride] = acc0.sum();
-            usij[1 * usijstride] = acc1.sum();
-            usij[2 * usijstride] = acc2.sum();
-            usij[3 * usijstride] = acc3.sum();
+            if (addtoresult)
+                usij[k * usijstride] = usij[k * usijstride] * thisscale + weight * dots[k];
+            else
+                usij[k * usijstride] = dots[k];
         }
     }
 
@@ -778,38 +724,9 @@ public:
     // this = thisweight * this + other * weight
     void addweighted(float thisweight, const ssematrixbase &other, float weight)
     {
-        auto &us = *this;
-        assert(rows() == other.rows() && cols() == other.cols());
-
-        // get data as long vectors
-        // ... why do I need to explicitly use operator T ()?
-        array_ref<msra::math::float4> us4(us.operator array_ref<msra::math::float4>());
-        const_array_ref<msra::math::float4> other4(other.operator const_array_ref<msra::math::float4>());
-        assert(us4.size() == other4.size());
-
-        // perform the operation on one long vector
-        msra::math::float4 weight4(weight);
-        if (thisweight == 1.0f)
-        {
-            foreach_index (i, us4)
-            {
-                us4[i] = us4[i] + other4[i] * weight4;
-            }
-        }
-        else if (thisweight == 0.0f)
-        {
-            foreach_index (i, us4)
-            {
-                us4[i] = other4[i] * weight4;
-            }
-        }
-        else
-        {
-            foreach_index (i, us4)
-            {
-                us4[i] = us4[i] * thisweight + other4[i] * weight4;
-            }
-        }
+        assert(rows() == other.rows() && cols() == other.cols() && colstride == other.colstride);
+        // on the matrices as long vectors (this is not read if thisweight is 0)
+        copykernel()(other.p, p, colstride * numcols, weight, thisweight);
     }
 
     // set the value to zero if less than threshold
@@ -872,37 +789,14 @@ public:
     // this = this * scale
     void scale(const float factor)
     {
-        auto &us = *this;
-
-        // get data as long vectors
-        array_ref<msra::math::float4> us4(us.operator array_ref<msra::math::float4>());
-
-        // perform the operation on one long vector
-        msra::math::float4 scale4(factor);
-        foreach_index (i, us4)
-        {
-            us4[i] = us4[i] * scale4;
-        }
+        copykernel()(p, p, colstride * numcols, factor, 0.0f);
     }
 
     // this = this * thisscale + other
     void scaleandadd(const float thisscale, const ssematrixbase &other)
     {
-        auto &us = *this;
-        assert(rows() == other.rows() && cols() == other.cols());
-
-        // get data as long vectors
-        // ... why do I need to explicitly use operator T ()?
-        array_ref<msra::math::float4> us4(us.operator array_ref<msra::math::float4>());
-        const_array_ref<msra::math::float4> other4(other.operator const_array_ref<msra::math::float4>());
-        assert(us4.size() == other4.size());
-
-        // perform the operation on one long vector
-        msra::math::float4 thisscale4(thisscale);
-        foreach_index (i, us4)
-        {
-            us4[i] = us4[i] * thisscale4 + other4[i];
-        }
+        assert(rows() == other.rows() && cols() == other.cols() && colstride == other.colstride);
+        copykernel()(other.p, p, colstride * numcols, 1.0f, thisscale);
     }
 
     // special function for DBN
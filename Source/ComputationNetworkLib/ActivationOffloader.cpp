@@ -0,0 +1,153 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE.md file in the project root for full license information.
+//
+
+#define _CRT_SECURE_NO_WARNINGS // "secure" CRT not available on all platforms  --add this at the top of all CPP files that give "function or variable may be unsafe" warnings
+
+#include "Basics.h"
+#include "ActivationOffloader.h"
+#include "ComputationNode.h"
+#include "GPUDataTransferer.h"
+#include "CUDAPageLockedMemAllocator.h"
+
+using namespace std;
+
+namespace Microsoft { namespace MSR { namespace CNTK {
+
+ActivationOffloader::ActivationOffloader()
+{
+}
+
+ActivationOffloader::~ActivationOffloader()
+{
+}
+
+ActivationOffloader::Entry::~Entry()
+{
+    if (m_hostBuffer)
+        CUDAPageLockedMemAllocator::Free(m_hostBuffer, m_node->GetDeviceId());
+}
+
+void ActivationOffloader::Add(const ComputationNodeBasePtr& node, const ComputationNodeBasePtr& lastConsumer,
+                              const ComputationNodeBasePtr& nextNode, const ComputationNodeBasePtr& nodeAfterNext)
+{
+    auto entry = make_unique<Entry>();
+    entry->m_node = node;
+    entry->m_transferer = make_unique<OffloadGPUDataTransferer>(node->GetDeviceId());
+    m_offloadAfterForward[lastConsumer].push_back(entry.get());
+    m_waitBeforeForward[nodeAfterNext].push_back(entry.get());
+    m_prefetchBeforeBackprop[nextNode].push_back(entry.get());
+    m_waitBeforeBackprop[lastConsumer].push_back(entry.get());
+    m_entries.push_back(move(entry));
+}
+
+template <class ElemType>
+/*static*/ bool ActivationOffloader::TryOffload(Entry& entry)
+{
+    auto node = dynamic_pointer_cast<ComputationNode<ElemType>>(entry.m_node);
+    if (!node)
+        return false;
+    const auto& value = node->Value();
+    if (value.GetMatrixType() != DENSE || value.GetCurrentMatrixLocation() != CurrentDataLocation::GPU)
+        LogicError("ActivationOffloader: Value of %ls %ls operation is not a dense matrix on the GPU.", node->NodeName().c_str(), node->OperationName().c_str());
+    entry.m_numRows = value.GetNumRows();
+    entry.m_numCols = value.GetNumCols();
+    entry.m_numBytes = value.GetNumElements() * sizeof(ElemType);
+    if (entry.m_numBytes > entry.m_hostBufferSize) // grows to the largest minibatch
+    {
+        if (entry.m_hostBuffer)
+            CUDAPageLockedMemAllocator::Free(entry.m_hostBuffer, node->GetDeviceId());
+        entry.m_hostBuffer = CUDAPageLockedMemAllocator::Malloc(entry.m_numBytes, node->GetDeviceId());
+        entry.m_hostBufferSize = entry.m_numBytes;
+    }
+    if (entry.m_numBytes > 0)
+        entry.m_transferer->CopyGPUToCPUAsync(value.Data(), entry.m_numBytes, entry.m_hostBuffer);
+    return true;
+}
+
+template <class ElemType>
+/*static*/ bool ActivationOffloader::TryPrefetch(Entry& entry)
+{
+    auto node = dynamic_pointer_cast<ComputationNode<ElemType>>(entry.m_node);
+    if (!node)
+        return false;
+    // The buffer is shared with other matrices, which may have resized it in the meantime.
+    auto& value = node->Value();
+    value.Resize(entry.m_numRows, entry.m_numCols);
+    if (entry.m_numBytes > 0)
+        entry.m_transferer->CopyCPUToGPUAsync(entry.m_hostBuffer, entry.m_numBytes, value.Data());
+    return true;
+}
+
+void ActivationOffloader::WaitFor(Entry& entry)
+{
+    if (!entry.m_isCopyPending)
+        return;
+    entry.m_transferer->WaitForCopyOnComputeStreamAsync();
+    entry.m_isCopyPending = false;
+}
+
+// before the buffer of an offloaded value can be reused
+void ActivationOffloader::BeforeForwardProp(const ComputationNodeBasePtr& nestedNode)
+{
+    auto iter = m_waitBeforeForward.find(nestedNode);
+    if (iter == m_waitBeforeForward.end())
+        return;
+    for (auto entry : iter->second)
+        WaitFor(*entry);
+}
+
+void ActivationOffloader::AfterForwardProp(const ComputationNodeBasePtr& nestedNode)
+{
+    auto iter = m_offloadAfterForward.find(nestedNode);
+    if (iter == m_offloadAfterForward.end())
+        return;
+    for (auto entry : iter->second)
+    {
+        WaitFor(*entry); // (a copy back from the last minibatch that was never waited for)
+        if (!TryOffload<float>(*entry) && !TryOffload<double>(*entry))
+            LogicError("ActivationOffloader: Unexpected element type of %ls %ls operation.", entry->m_node->NodeName().c_str(), entry->m_node->OperationName().c_str());
+        entry->m_isCopyPending = true;
+        entry->m_isOnHost = true;
+        m_statistics.m_numOffloads++;
+        m_statistics.m_bytesOffloaded += entry->m_numBytes;
+    }
+}
+
+void ActivationOffloader::BeforeBackprop(const ComputationNodeBasePtr& nestedNode)
+{
+    auto iter = m_prefetchBeforeBackprop.find(nestedNode);
+    if (iter != m_prefetchBeforeBackprop.end())
+    {
+        for (auto entry : iter->second)
+        {
+            if (!entry->m_isOnHost) // e.g. forward prop did not run since the last backprop
+                continue;
+            WaitFor(*entry); // the copy to host must be complete (it normally is, long since)
+            if (!TryPrefetch<float>(*entry) && !TryPrefetch<double>(*entry))
+                LogicError("ActivationOffloader: Unexpected element type of %ls %ls operation.", entry->m_node->NodeName().c_str(), entry->m_node->OperationName().c_str());
+            entry->m_isCopyPending = true;
+            entry->m_isOnHost = false;
+            m_statistics.m_bytesPrefetched += entry->m_numBytes;
+        }
+    }
+
+    iter = m_waitBeforeBackprop.find(nestedNode);
+    if (iter != m_waitBeforeBackprop.end())
+    {
+        for (auto entry : iter->second)
+            WaitFor(*entry);
+    }
+}
+
+ActivationOffloader::Statistics ActivationOffloader::CollectStatistics()
+{
+    for (auto& entry : m_entries)
+        m_statistics.m_stallSeconds += entry->m_transferer->CollectStallSeconds();
+    Statistics statistics = m_statistics;
+    m_statistics = Statistics();
+    return statistics;
+}
+
+}}}
@@ -0,0 +1,86 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE.md file in the project root for full license information.
+//
+
+#pragma once
+
+#include "Basics.h"
+#include <map>
+#include <memory>
+#include <vector>
+
+namespace Microsoft { namespace MSR { namespace CNTK {
+
+class ComputationNodeBase;
+typedef std::shared_ptr<ComputationNodeBase> ComputationNodeBasePtr;
+class OffloadGPUDataTransferer;
+
+// ===========================================================================
+// ActivationOffloader -- values needed for backprop that wait in page-locked host memory instead of on the GPU
+//
+// Planned by ComputationNetwork::AllocateAllMatrices() for the values selected by SetActivationOffloading(). The
+// schedule refers to the nested nodes of the criterion's PARTraversalFlowControlNode, whose ForwardProp() and
+// Backprop() call the hooks below:
+//  - Once the last forward consumer of an offloaded value has run, the value is copied to host memory.
+//  - The MatrixPool releases its buffer one nested node later, so that the copy overlaps with that node. Before the
+//    nested node after that, which may reuse the buffer, the compute stream waits for the copy.
+//  - In backprop, the value gets its buffer back one nested node before the first one that reads it (its last
+//    forward consumer). The copy back overlaps with that node, and the compute stream waits for it before the reader.
+// Values are only offloaded while training; a forward pass for evaluation does not need them afterwards.
+// ===========================================================================
+
+class ActivationOffloader
+{
+public:
+    ActivationOffloader();
+    ~ActivationOffloader();
+
+    // offload the value of 'node' after the forward prop of 'lastConsumer' until the backprop of 'lastConsumer';
+    // 'nextNode' and 'nodeAfterNext' are the nested nodes that follow 'lastConsumer' in evaluation order
+    void Add(const ComputationNodeBasePtr& node, const ComputationNodeBasePtr& lastConsumer,
+             const ComputationNodeBasePtr& nextNode, const ComputationNodeBasePtr& nodeAfterNext);
+    size_t GetNumOffloadedValues() const { return m_entries.size(); }
+
+    // called by PARTraversalFlowControlNode around its nested nodes
+    void BeforeForwardProp(const ComputationNodeBasePtr& nestedNode);
+    void AfterForwardProp(const ComputationNodeBasePtr& nestedNode);
+    void BeforeBackprop(const ComputationNodeBasePtr& nestedNode);
+
+    struct Statistics
+    {
+        size_t m_numOffloads = 0;
+        size_t m_bytesOffloaded = 0;  // to host memory
+        size_t m_bytesPrefetched = 0; // back to the GPU
+        double m_stallSeconds = 0;    // how long the compute stream waited for the copies
+    };
+    // statistics since the last call; waits for the last copies to be waited for
+    Statistics CollectStatistics();
+
+private:
+    struct Entry
+    {
+        ComputationNodeBasePtr m_node;
+        std::unique_ptr<OffloadGPUDataTransferer> m_transferer;
+        void* m_hostBuffer = nullptr; // page-locked
+        size_t m_hostBufferSize = 0;
+        size_t m_numRows = 0, m_numCols = 0; // of the offloaded value
+        size_t m_numBytes = 0;
+        bool m_isCopyPending = false; // a copy was started that the compute stream has not waited for yet
+        bool m_isOnHost = false;      // the value was offloaded and not brought back yet
+        ~Entry();
+    };
+
+    template <class ElemType> static bool TryOffload(Entry& entry);
+    template <class ElemType> static bool TryPrefetch(Entry& entry);
+    void WaitFor(Entry& entry);
+
+    std::vector<std::unique_ptr<Entry>> m_entries;
+    std::map<ComputationNodeBasePtr, std::vector<Entry*>> m_offloadAfterForward; // [nested node] -> values to copy to host after its forward prop
+    std::map<ComputationNodeBasePtr, std::vector<Entry*>> m_waitBeforeForward;   // [nested node] -> copies to wait for before its forward prop
+    std::map<ComputationNodeBasePtr, std::vector<Entry*>> m_prefetchBeforeBackprop; // [nested node] -> values to copy back before its backprop
+    std::map<ComputationNodeBasePtr, std::vector<Entry*>> m_waitBeforeBackprop;     // [nested node] -> copies to wait for before its backprop
+    Statistics m_statistics;
+};
+
+}}}
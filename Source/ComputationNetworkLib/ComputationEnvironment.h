@@ -7,6 +7,7 @@
 
 #include "Basics.h"
 #include <memory>
+#include <functional>
 
 namespace Microsoft { namespace MSR { namespace CNTK {
 
@@ -48,6 +49,13 @@ struct ComputationEnvironment
     // Extreme tracing of node outputs. Make space on your disk.
     bool IsLogLevelNodeTrace() const { return traceLevel >= 1000000; }
 
+    // if set, ForwardProp() and Backprop() of the nodes are timed, see ComputationNodeProfiler
+    std::shared_ptr<class ComputationNodeProfiler> nodeProfiler;
+
+    // if set, called during Backprop() with each node of the outer traversal once its gradient is final,
+    // i.e. all its parents have backpropagated into it, e.g. to start exchanging parameter gradients early
+    std::function<void(const std::shared_ptr<class ComputationNodeBase>&)> gradientComputedCallback;
+
     // more properties should be added here as needed
 };
 typedef std::shared_ptr<ComputationEnvironment> ComputationEnvironmentPtr;
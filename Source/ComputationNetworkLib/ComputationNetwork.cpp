@@ -20,6 +20,7 @@
 #include "EvaluationNodes.h"
 #include "SpecialPurposeNodes.h"
 #include "DeprecatedNodes.h" // (for SaveToDbnFile(), which is also deprecated)
+#include "ModelParallelNodes.h"
 #include "MPIWrapper.h" // TODO: does not belong here
 #include <string>
 #include <vector>
@@ -47,6 +48,30 @@ vector<shared_ptr<Matrix<double>>>& MatrixPool::GetReleasedMatrices<double>()
     return m_releasedDoubleMatrices;
 }
 
+template <>
+vector<MatrixPool::MemRequestInfo<float>>& MatrixPool::GetMemRequestInfoVec<float>()
+{
+    return m_floatMemRequestInfoVec;
+}
+
+template <>
+vector<MatrixPool::MemRequestInfo<double>>& MatrixPool::GetMemRequestInfoVec<double>()
+{
+    return m_doubleMemRequestInfoVec;
+}
+
+template <>
+vector<weak_ptr<Matrix<float>>>& MatrixPool::GetBuffers<float>()
+{
+    return m_floatBuffers;
+}
+
+template <>
+vector<weak_ptr<Matrix<double>>>& MatrixPool::GetBuffers<double>()
+{
+    return m_doubleBuffers;
+}
+
 // -----------------------------------------------------------------------
 // construction
 // -----------------------------------------------------------------------
@@ -76,6 +101,8 @@ void ComputationNetwork::ClearNetwork()
     }
 
     m_nameToNodeMap.clear();
+    m_numUniqueNamePrefixes.clear();
+    m_configNameToNodeMap.clear();
 
     m_pMBLayoutOfNetwork->Init(1, 0);
 }
@@ -94,7 +121,8 @@ void ComputationNetwork::SaveEdited(const wstring& fileName, const FileOptions f
 
 void ComputationNetwork::Save(const wstring& fileName, const FileOptions fileFormat) const
 {
-    VerifyIsCompiled("Save");
+    if (!m_isSnapshotForSaving)
+        VerifyIsCompiled("Save");
     // Saving into temporary file and then renaming it to the requested fileName
     // This is a standard trick to avoid havign corrupted model files if process dies during writing
     wstring tmpFileName = fileName + L".tmp";
@@ -115,13 +143,23 @@ void ComputationNetwork::SaveToFileImpl(const wstring& fileName, const FileOptio
     fstream << (size_t) CURRENT_CNTK_MODEL_VERSION;
     fstream.PutMarker(FileMarker::fileMarkerEndSection, L"EVersion");
 
-    fstream << (size_t) m_nameToNodeMap.size();
+    // the transfers between the stages of a pipelined network are not part of the model; their consumers are saved
+    // with the transferred values as inputs
+    auto isPipelineTransfer = [](const ComputationNodeBasePtr& node) { return node && node->Is<IPipelineTransferNode>(); };
+    size_t numPipelineTransfers = 0;
+    for (auto nodeIter = m_nameToNodeMap.begin(); nodeIter != m_nameToNodeMap.end(); nodeIter++)
+        if (isPipelineTransfer(nodeIter->second))
+            numPipelineTransfers++;
+
+    fstream << (size_t) (m_nameToNodeMap.size() - numPipelineTransfers);
 
     // put all node info first
     fstream.PutMarker(FileMarker::fileMarkerBeginSection, L"BNodeList");
     for (auto nodeIter = m_nameToNodeMap.begin(); nodeIter != m_nameToNodeMap.end(); nodeIter++)
     {
         ComputationNodeBasePtr nodePtr = nodeIter->second;
+        if (isPipelineTransfer(nodePtr))
+            continue;
         // type
 #if CURRENT_CNTK_MODEL_VERSION >= CNTK_MODEL_VERSION_7
         wstring precision;
@@ -146,11 +184,15 @@ void ComputationNetwork::SaveToFileImpl(const wstring& fileName, const FileOptio
     for (auto nodeIter = m_nameToNodeMap.begin(); nodeIter != m_nameToNodeMap.end(); nodeIter++)
     {
         ComputationNodeBasePtr nodePtr = nodeIter->second;
+        if (isPipelineTransfer(nodePtr))
+            continue;
         fstream << nodePtr->NodeName() << nodePtr->GetNumInputs();
         for (size_t i = 0; i < nodePtr->GetNumInputs(); i++)
         {
             if (!nodePtr->Input(i))
                 fprintf(stderr, "Warning: node %ls 's child is null, please check your ndl/mel file.\n", nodePtr->NodeName().c_str());
+            else if (isPipelineTransfer(nodePtr->Input(i)))
+                fstream << nodePtr->Input(i)->Input(0)->NodeName();
             else
                 fstream << nodePtr->Input(i)->NodeName();
         }
@@ -200,7 +242,7 @@ void ComputationNetwork::SaveToFileImpl(const wstring& fileName, const FileOptio
 // This is also used for reloading a model without recreating it, e.g. during training.
 // TODO: Why not just reload it? Because SGD::Train() holds pointers to the parameters directly? That should be fixed.
 template <class ElemType> // ElemType is the default for models prior to CNTK_MODEL_VERSION_7; after that, it is serialized, and ElemType is ignored
-void ComputationNetwork::ReadPersistableParameters(File& fstream, bool create)
+void ComputationNetwork::ReadPersistableParameters(File& fstream, bool create, bool convertPrecision)
 {
     fstream.GetMarker(FileMarker::fileMarkerBeginSection, L"BCN");
 
@@ -218,6 +260,7 @@ void ComputationNetwork::ReadPersistableParameters(File& fstream, bool create)
     fstream >> numNodes;
 
     // get all node info first
+    size_t numConvertedNodes = 0;
     fstream.GetMarker(FileMarker::fileMarkerBeginSection, L"BNodeList");
     for (size_t i = 0; i < numNodes; i++)
     {
@@ -229,14 +272,26 @@ void ComputationNetwork::ReadPersistableParameters(File& fstream, bool create)
         fstream >> opName >> nodeName;
 
         ComputationNodeBasePtr node;
+        DEVICEID_TYPE deviceId = GetDeviceIdForNewNode(nodeName);
         if (!create) // reloading existing
             node = GetNodeFromName(nodeName);
+        else if (convertPrecision) // the matrices tell their precision, and convert themselves when read
+        {
+            node = ComputationNetworkBuilder<ElemType>::NewNode(opName, deviceId, nodeName);
+            if (precision != L"" && precision != ElemTypeName<ElemType>())
+            {
+                auto convertingNode = dynamic_pointer_cast<IConvertsPrecisionOnLoad>(node);
+                if (convertingNode)
+                    convertingNode->SetFileElementSize(precision == L"float" ? sizeof(float) : sizeof(double));
+                numConvertedNodes++;
+            }
+        }
         else if (precision == L"float")
-            node = ComputationNetworkBuilder<float>::NewNode(opName, m_deviceId, nodeName);
+            node = ComputationNetworkBuilder<float>::NewNode(opName, deviceId, nodeName);
         else if (precision == L"double")
-            node = ComputationNetworkBuilder<double>::NewNode(opName, m_deviceId, nodeName);
+            node = ComputationNetworkBuilder<double>::NewNode(opName, deviceId, nodeName);
         else if (precision == L"") // old file format: default to <ElemType>
-            node = ComputationNetworkBuilder<ElemType>::NewNode(opName, m_deviceId, nodeName);
+            node = ComputationNetworkBuilder<ElemType>::NewNode(opName, deviceId, nodeName);
         else
             RuntimeError("Read: Unexpected precision tag '%ls'", precision.c_str());
 
@@ -259,18 +314,21 @@ void ComputationNetwork::ReadPersistableParameters(File& fstream, bool create)
     }
 
     fstream.GetMarker(FileMarker::fileMarkerEndSection, L"ENodeList");
+
+    if (numConvertedNodes > 0)
+        fprintf(stderr, "Read: Converted %d nodes to %ls.\n", (int) numConvertedNodes, ElemTypeName<ElemType>());
 }
 
 // deserialize the model
 // This does not post-process the model (CompileNetwork()). Use Load() instead.
 template <class ElemType> // for ReadPersistableParameters()
-void ComputationNetwork::Read(const wstring& fileName)
+void ComputationNetwork::Read(const wstring& fileName, bool convertPrecision)
 {
     ClearNetwork();
 
     File fstream(fileName, FileOptions::fileOptionsBinary | FileOptions::fileOptionsRead);
 
-    ReadPersistableParameters<ElemType>(fstream, true);
+    ReadPersistableParameters<ElemType>(fstream, true, convertPrecision);
 
     size_t numNodes = m_nameToNodeMap.size();
 
@@ -547,6 +605,16 @@ template <class ElemType>
     prevDropoutRate = dropoutRate;
 }
 
+template <class ElemType>
+/*static*/ void ComputationNetwork::SetCounterBasedDropout(ComputationNetworkPtr net, const ComputationNodeBasePtr& criterionNode, bool useCounterBasedMask)
+{
+    if (net->AreMatricesAllocated())
+        LogicError("SetCounterBasedDropout: The dropout mode must be set before the matrices are allocated.");
+
+    for (auto& nodeIter : net->GetNodesWithType(OperationNameOf(DropoutNode), criterionNode))
+        dynamic_pointer_cast<DropoutNode<ElemType>>(nodeIter)->SetCounterBasedMask(useCounterBasedMask);
+}
+
 template <class ElemType>
 /* static */ void ComputationNetwork::SetIRngUserSeed(ComputationNetworkPtr net, const ComputationNodeBasePtr& node, size_t randSeedBase)
 {
@@ -607,12 +675,15 @@ void ComputationNetwork::SetSeqParam(ComputationNetworkPtr net,
                                      const double& lmf /*= 14.0f*/,
                                      const double& wp /*= 0.0f*/,
                                      const double& bMMIfactor /*= 0.0f*/,
-                                     const bool& sMBR /*= false*/
+                                     const bool& sMBR /*= false*/,
+                                     const size_t latticeCacheMB /*= 0*/
                                      )
 {
     fprintf(stderr, "Setting Hsmoothing weight to %.8g and frame-dropping threshhold to %.8g\n", hsmoothingWeight, frameDropThresh);
     fprintf(stderr, "Setting SeqGammar-related parameters: amf=%.2f, lmf=%.2f, wp=%.2f, bMMIFactor=%.2f, usesMBR=%s\n",
             amf, lmf, wp, bMMIfactor, sMBR ? "true" : "false");
+    if (latticeCacheMB > 0)
+        fprintf(stderr, "Keeping up to %d MB of lattices on the GPU across minibatches\n", (int) latticeCacheMB);
     list<ComputationNodeBasePtr> seqNodes = net->GetNodesWithType(OperationNameOf(SequenceWithSoftmaxNode), criterionNode);
     if (seqNodes.size() == 0)
     {
@@ -627,6 +698,7 @@ void ComputationNetwork::SetSeqParam(ComputationNetworkPtr net,
             node->SetFrameDropThresh(frameDropThresh);
             node->SetReferenceAlign(doreferencealign);
             node->SetGammarCalculationParam(amf, lmf, wp, bMMIfactor, sMBR);
+            node->SetLatticeCacheSize(latticeCacheMB * 1024 * 1024);
         }
     }
 }
@@ -654,6 +726,739 @@ void ComputationNetwork::SetSeqParam(ComputationNetworkPtr net,
     }
 }
 
+template <class ElemType>
+size_t ComputationNetwork::QuantizeTimesNodes(size_t bitShiftWeights, size_t bitShiftData, const set<wstring>& excludedNodeNames)
+{
+    if (GetDeviceId() != CPUDEVICE)
+        InvalidArgument("QuantizeTimesNodes: Quantized products are only supported on the CPU.");
+
+    size_t numQuantized = 0, numTimesNodes = 0;
+    for (const auto& node : GetNodesWithType(OperationNameOf(TimesNode)))
+    {
+        auto timesNode = dynamic_pointer_cast<TimesNode<ElemType>>(node);
+        if (!timesNode)
+            continue;
+        numTimesNodes++;
+        if (excludedNodeNames.find(node->NodeName()) != excludedNodeNames.end())
+            continue;
+        if (timesNode->EnableQuantizedInference(bitShiftWeights, bitShiftData))
+            numQuantized++;
+        else if (TraceLevel() > 0)
+            fprintf(stderr, "QuantizeTimesNodes: %ls does not multiply by weights, left unquantized.\n", node->NodeName().c_str());
+    }
+    fprintf(stderr, "QuantizeTimesNodes: %d of %d Times operations use 16-bit products (weight bit shift %d, data bit shift %d).\n",
+            (int)numQuantized, (int)numTimesNodes, (int)bitShiftWeights, (int)bitShiftData);
+    return numQuantized;
+}
+
+template <class ElemType>
+size_t ComputationNetwork::PackTimesWeights()
+{
+    if (GetDeviceId() != CPUDEVICE)
+    {
+        fprintf(stderr, "PackTimesWeights: Packed weights are only used on the CPU, ignored.\n");
+        return 0;
+    }
+
+    size_t numPacked = 0, numTimesNodes = 0;
+    for (const auto& node : GetNodesWithType(OperationNameOf(TimesNode)))
+    {
+        auto timesNode = dynamic_pointer_cast<TimesNode<ElemType>>(node);
+        if (!timesNode)
+            continue;
+        numTimesNodes++;
+        if (timesNode->EnablePackedWeights())
+        {
+            // the packed copy would not see updates
+            dynamic_pointer_cast<LearnableParameter<ElemType>>(node->GetInputs()[0])->FreezeParameters();
+            numPacked++;
+        }
+        else if (TraceLevel() > 0)
+            fprintf(stderr, "PackTimesWeights: %ls does not multiply by dense weights, or the BLAS library cannot pack them; left unpacked.\n", node->NodeName().c_str());
+    }
+    fprintf(stderr, "PackTimesWeights: %d of %d Times operations use packed weights.\n", (int)numPacked, (int)numTimesNodes);
+    return numPacked;
+}
+
+size_t ComputationNetwork::EnableFastMath()
+{
+    size_t numSwitched = 0;
+    for (const auto& node : GetAllNodes())
+    {
+        if (node->EnableFastMath())
+            numSwitched++;
+    }
+    fprintf(stderr, "EnableFastMath: %d Sigmoid, Tanh, Exp and Log operations use approximations.\n", (int)numSwitched);
+    return numSwitched;
+}
+
+template <class ElemType>
+size_t ComputationNetwork::SparsifyTimesWeights(double maxDensity)
+{
+    map<ComputationNodeBasePtr, vector<ComputationNodeBasePtr>> parentsMap;
+    for (const auto& node : GetAllNodes())
+        for (const auto& input : node->GetInputs())
+            parentsMap[input].push_back(node);
+
+    size_t numSparse = 0, numWeights = 0;
+    for (const auto& node : GetNodesWithType(OperationNameOf(LearnableParameter)))
+    {
+        auto weights = dynamic_pointer_cast<LearnableParameter<ElemType>>(node);
+        const auto& parents = parentsMap[node];
+        if (!weights || parents.empty())
+            continue;
+        bool onlyTimesWeights = std::all_of(parents.begin(), parents.end(), [&node](const ComputationNodeBasePtr& parent)
+        {
+            auto timesNode = dynamic_pointer_cast<TimesNode<ElemType>>(parent);
+            return timesNode && parent->OperationName() == OperationNameOf(TimesNode) &&
+                   parent->GetInputs()[0] == node && parent->GetInputs()[1] != node && timesNode->CanUseSparseWeights();
+        });
+        if (!onlyTimesWeights)
+            continue;
+        numWeights++;
+        if (weights->SwitchToSparseValue(maxDensity))
+            numSparse++;
+        else if (TraceLevel() > 0)
+            fprintf(stderr, "SparsifyTimesWeights: %ls has more than %.0f%% nonzero elements, left dense.\n", node->NodeName().c_str(), 100 * maxDensity);
+    }
+    fprintf(stderr, "SparsifyTimesWeights: %d of %d weight matrices of Times operations are sparse (at most %.0f%% nonzero elements).\n",
+            (int)numSparse, (int)numWeights, 100 * maxDensity);
+    return numSparse;
+}
+
+template <class ElemType>
+size_t ComputationNetwork::FoldBatchNormalization()
+{
+    size_t numFolded = 0, numBatchNormNodes = 0;
+    for (const auto& node : GetNodesWithType(OperationNameOf(BatchNormalizationNode)))
+    {
+        if (!dynamic_pointer_cast<BatchNormalizationNode<ElemType>>(node))
+            continue;
+        numBatchNormNodes++;
+        if (FoldBatchNormalizationNode<ElemType>(node))
+            numFolded++;
+        else if (TraceLevel() > 0)
+            fprintf(stderr, "FoldBatchNormalization: %ls does not follow a Convolution or Times by weights used by nothing else, left unchanged.\n", node->NodeName().c_str());
+    }
+    fprintf(stderr, "FoldBatchNormalization: %d of %d BatchNormalization operations folded into the preceding Convolution or Times operation.\n",
+            (int)numFolded, (int)numBatchNormNodes);
+
+    if (numFolded > 0)
+        CompileNetwork();
+    return numFolded;
+}
+
+// Inference computes y = scale * (x - runMean) / sqrt(runVariance + epsilon) + bias = a * x + c per channel, where
+// x = W * input (+ b). This replaces the node by Plus(W' * input, c'), with W' = a * W (for each output channel) and c' = c (+ a * b).
+template <class ElemType>
+bool ComputationNetwork::FoldBatchNormalizationNode(const ComputationNodeBasePtr& node)
+{
+    auto batchNormNode = dynamic_pointer_cast<BatchNormalizationNode<ElemType>>(node);
+    auto isParameter = [](const ComputationNodeBasePtr& n) { return n->OperationName() == OperationNameOf(LearnableParameter); };
+    auto isInNodeGroup = [this](const ComputationNodeBasePtr& n)
+    {
+        for (auto group : GetAllNodeGroups())
+        {
+            if (std::find(group->begin(), group->end(), n) != group->end())
+                return true;
+        }
+        return false;
+    };
+    // values that change here must not be seen by anyone else
+    auto isUsedOnlyBy = [&](const ComputationNodeBasePtr& n, const ComputationNodeBasePtr& parent)
+    {
+        auto parents = GetParentNodes(n->NodeName());
+        return !isInNodeGroup(n) && std::all_of(parents.begin(), parents.end(), [&](const ComputationNodeBasePtr& p) { return p == parent; });
+    };
+
+    for (size_t i = 1; i < node->GetNumInputs(); i++)
+    {
+        if (!isParameter(node->Input(i)))
+            return false;
+    }
+
+    // the product, and the bias added to it if any
+    ComputationNodeBasePtr product = node->Input(0);
+    ComputationNodeBasePtr plusNode, oldBias;
+    if (product->OperationName() == OperationNameOf(PlusNode))
+    {
+        plusNode = product;
+        for (size_t i = 0; i < 2; i++)
+        {
+            if (isParameter(plusNode->Input(i)) && !isParameter(plusNode->Input(1 - i)))
+            {
+                oldBias = plusNode->Input(i);
+                product = plusNode->Input(1 - i);
+            }
+        }
+        if (!oldBias || !isUsedOnlyBy(plusNode, node) || !isUsedOnlyBy(oldBias, plusNode) ||
+            plusNode->GetSampleLayout() != product->GetSampleLayout())
+            return false;
+    }
+    if (!isUsedOnlyBy(product, plusNode ? plusNode : node))
+        return false;
+
+    // the scale is per channel, which is the last axis for spatial batch normalization
+    const auto& outputLayout = product->GetSampleLayout();
+    const size_t numChannels = node->Input(1)->GetSampleLayout().GetNumElements();
+    const bool perElement = numChannels == outputLayout.GetNumElements();
+    if (!perElement && !(batchNormNode->Spatial() && outputLayout.GetRank() > 0 && outputLayout.GetDims().back() == numChannels))
+        return false;
+
+    // the weights, whose rows (Times) or blocks (Convolution, CHW only) each make one output channel
+    ComputationNodeBasePtr weights = product->GetNumInputs() == 2 ? product->Input(0) : nullptr;
+    if (!weights || !isParameter(weights) || !isUsedOnlyBy(weights, product) || weights->GetSampleLayout().GetNumElements() % numChannels != 0)
+        return false;
+    bool isConvolution;
+    if (dynamic_pointer_cast<TimesNode<ElemType>>(product))
+    {
+        if (!perElement)
+            return false;
+        isConvolution = false;
+    }
+    else if (auto convolutionNode = dynamic_pointer_cast<ConvolutionNode<ElemType>>(product))
+    {
+        if (convolutionNode->Transpose() || convolutionNode->PoolingKind() != PoolKind::None || !convolutionNode->IsImageLayoutCHW() ||
+            outputLayout.GetDims().back() != numChannels ||
+            convolutionNode->KernelShape().GetNumElements() * numChannels != weights->GetSampleLayout().GetNumElements())
+            return false;
+        isConvolution = true;
+    }
+    else
+        return false;
+
+    if (oldBias)
+    {
+        // the bias must broadcast like the folded one
+        const auto& biasLayout = oldBias->GetSampleLayout();
+        if (biasLayout.GetNumElements() != numChannels || biasLayout.GetRank() > outputLayout.GetRank())
+            return false;
+        for (size_t k = 0; k + 1 < outputLayout.GetRank(); k++)
+        {
+            if ((k < biasLayout.GetRank() ? biasLayout[k] : 1) != (perElement ? outputLayout[k] : 1))
+                return false;
+        }
+    }
+
+    InvalidateCompiledNetwork();
+
+    auto valueOf = [numChannels](const ComputationNodeBasePtr& n) { return dynamic_pointer_cast<ComputationNode<ElemType>>(n)->Value().Reshaped(numChannels, 1); };
+    // cuDNN raises epsilon to its minimum
+    const double epsilon = batchNormNode->UseCNTKEngine() ? batchNormNode->Epsilon() : max(batchNormNode->Epsilon(), 1e-5);
+    Matrix<ElemType> a = valueOf(node->Input(4)).DeepClone();
+    a += (ElemType)epsilon;
+    a.InplaceSqrt();
+    a.ElementInverse();
+    a.ElementMultiplyWith(valueOf(node->Input(1)));
+    Matrix<ElemType> c = valueOf(node->Input(2)).DeepClone();
+    Matrix<ElemType> term(m_deviceId);
+    term.AssignElementProductOf(a, valueOf(node->Input(3)));
+    c -= term;
+    if (oldBias)
+    {
+        term.AssignElementProductOf(a, valueOf(oldBias));
+        c += term;
+    }
+
+    auto& weightValue = dynamic_pointer_cast<ComputationNode<ElemType>>(weights)->Value();
+    const size_t numWeightsPerChannel = weightValue.GetNumElements() / numChannels;
+    if (isConvolution)
+        weightValue.Reshaped(numWeightsPerChannel, numChannels).RowElementMultiplyWith(a.Reshaped(1, numChannels));
+    else
+        weightValue.Reshaped(numChannels, numWeightsPerChannel).ColumnElementMultiplyWith(a);
+
+    // the folded bias broadcasts over all but the channel axis
+    TensorShape biasShape = outputLayout;
+    if (!perElement)
+    {
+        SmallVector<size_t> dims(outputLayout.GetRank(), 1);
+        dims.back() = numChannels;
+        biasShape = TensorShape(dims);
+    }
+    const wstring name = node->NodeName();
+    auto newBias = AddNodeToNetWithElemType(New<LearnableParameter<ElemType>>(m_deviceId, name + L".foldedBias", biasShape));
+    InitLearnableParameters(newBias, L"fixedValue", 0); // follow the protocol; otherwise deferred initialization will overwrite the value in validation
+    newBias->Value().SetValue(c.Reshaped(newBias->Value().GetNumRows(), newBias->Value().GetNumCols()));
+
+    // replace the node by a Plus of the same name, and remove the nodes that only it used
+    auto newPlus = New<PlusNode<ElemType>>(m_deviceId, name);
+    ChangeNodeInputs(node, newPlus);
+    for (auto group : GetAllNodeGroups())
+        std::replace(group->begin(), group->end(), node, (ComputationNodeBasePtr)newPlus);
+    auto batchNormParameters = node->GetInputs();
+    batchNormParameters.erase(batchNormParameters.begin());
+    node->DetachInputs();
+    RemoveNodeFromNet(node);
+    AddNodeToNetAndAttachInputs(newPlus, { product, newBias });
+    if (plusNode)
+    {
+        plusNode->DetachInputs();
+        RemoveNodeFromNet(plusNode);
+        RemoveNodeFromNet(oldBias);
+    }
+    for (const auto& parameter : batchNormParameters)
+    {
+        if (GetParentNodes(parameter->NodeName()).empty() && !isInNodeGroup(parameter))
+            RemoveNodeFromNet(parameter);
+    }
+    return true;
+}
+
+template <class ElemType>
+void ComputationNetwork::OptimizeForInference()
+{
+    if (OutputNodes().empty())
+        InvalidArgument("OptimizeForInference: The network has no output nodes.");
+    if (!IsCompiled())
+        CompileNetwork();
+
+    const size_t numNodesBefore = GetTotalNumberOfNodes();
+    // replaces 'node' by 'newNode' in all node groups and as an input of all nodes, and removes it
+    auto replaceNode = [this](const ComputationNodeBasePtr& node, const ComputationNodeBasePtr& newNode)
+    {
+        ChangeNodeInputs(node, newNode);
+        for (auto group : GetAllNodeGroups())
+            std::replace(group->begin(), group->end(), node, newNode);
+        node->DetachInputs();
+        RemoveNodeFromNet(node);
+    };
+    // removes all nodes the output nodes do not depend on, also from the other node groups
+    auto pruneNodes = [this]()
+    {
+        auto neededNodes = ComputationNodeBase::EnumerateNodes(OutputNodes());
+        set<ComputationNodeBasePtr> needed(neededNodes.begin(), neededNodes.end());
+        for (auto group : GetAllNodeGroups())
+            group->erase(std::remove_if(group->begin(), group->end(), [&](const ComputationNodeBasePtr& node) { return needed.find(node) == needed.end(); }), group->end());
+        vector<ComputationNodeBasePtr> unneededNodes;
+        for (const auto& iter : m_nameToNodeMap)
+        {
+            if (needed.find(iter.second) == needed.end())
+                unneededNodes.push_back(iter.second);
+        }
+        for (const auto& node : unneededNodes)
+        {
+            node->DetachInputs(); // (circular references)
+            RemoveNodeFromNet(node);
+        }
+    };
+
+    InvalidateCompiledNetwork();
+
+    // STEP: Dropout is the identity in inference. (Outputs keep their names.)
+    size_t numDropoutNodes = 0;
+    for (const auto& node : GetNodesWithType(OperationNameOf(DropoutNode)))
+    {
+        if (std::find(OutputNodes().begin(), OutputNodes().end(), node) != OutputNodes().end())
+            continue;
+        replaceNode(node, node->Input(0));
+        numDropoutNodes++;
+    }
+    pruneNodes();
+    CompileNetwork();
+
+    // STEP: Find the values that do not change from one minibatch to the next: parameters, precomputed nodes, and
+    // nodes computed from them only, unless they are random. Those used by other nodes (or outputs) are computed once.
+    set<ComputationNodeBasePtr> constantNodes;
+    for (const auto& node : GetEvalOrder(nullptr))
+    {
+        bool isConstant;
+        if (node->OperationName() == OperationNameOf(LearnableParameter))
+            isConstant = true;
+        else if (node->RequiresPreCompute())
+            isConstant = dynamic_pointer_cast<IPreComputeNode>(node)->HasComputed();
+        else
+        {
+            isConstant = !node->IsLeaf() && !node->HasMBLayout() && !node->IsPartOfLoop() && !dynamic_pointer_cast<IRngUser>(node) &&
+                         std::all_of(node->GetInputs().begin(), node->GetInputs().end(), [&](const ComputationNodeBasePtr& input) { return constantNodes.find(input) != constantNodes.end(); });
+        }
+        if (isConstant && dynamic_pointer_cast<ComputationNode<ElemType>>(node))
+            constantNodes.insert(node);
+    }
+    set<ComputationNodeBasePtr> nodesToFold;
+    for (const auto& node : constantNodes)
+    {
+        if (node->OperationName() == OperationNameOf(LearnableParameter))
+            continue;
+        auto parents = GetParentNodes(node->NodeName());
+        if (parents.empty() || std::any_of(parents.begin(), parents.end(), [&](const ComputationNodeBasePtr& parent) { return constantNodes.find(parent) == constantNodes.end(); }))
+            nodesToFold.insert(node);
+    }
+
+    // STEP: Compute them, in evaluation order, and replace them by parameters of the same name.
+    // Each gets its own matrices, so that intermediate values are not overwritten before they are used.
+    if (!nodesToFold.empty())
+    {
+        MatrixPool matrixPool;
+        matrixPool.SetPolicy(MemorySharingPolicy::Off);
+        auto previousOperationMode = Environment().SetOperationMode(NetworkOperationMode::inferring);
+        map<ComputationNodeBasePtr, shared_ptr<LearnableParameter<ElemType>>> foldedValues;
+        for (const auto& node : GetEvalOrder(nullptr))
+        {
+            if (constantNodes.find(node) == constantNodes.end() || node->OperationName() == OperationNameOf(LearnableParameter))
+                continue;
+            if (!node->RequiresPreCompute())
+            {
+                node->RequestMatricesBeforeForwardProp(matrixPool);
+                node->BeginForwardProp();
+                node->ForwardProp(FrameRange(nullptr));
+                node->EndForwardProp();
+            }
+            if (nodesToFold.find(node) != nodesToFold.end())
+            {
+                auto parameter = New<LearnableParameter<ElemType>>(m_deviceId, node->NodeName(), node->GetSampleLayout());
+                InitLearnableParameters(parameter, L"fixedValue", 0);
+                parameter->Value().SetValue(dynamic_pointer_cast<ComputationNode<ElemType>>(node)->Value());
+                ComputationNodeBasePtr(parameter)->SetLearningRateMultiplier(0);
+                foldedValues[node] = parameter;
+            }
+        }
+        Environment().SetOperationMode(previousOperationMode);
+
+        InvalidateCompiledNetwork();
+        for (const auto& iter : foldedValues)
+        {
+            replaceNode(iter.first, iter.second);
+            AddNodeToNet(iter.second);
+        }
+        pruneNodes();
+    }
+
+    EnableElementwiseFusion(true);
+    CompileNetwork();
+
+    fprintf(stderr, "OptimizeForInference: %d Dropout operations removed, %d constant values precomputed, %d of %d nodes left.\n",
+            (int)numDropoutNodes, (int)nodesToFold.size(), (int)GetTotalNumberOfNodes(), (int)numNodesBefore);
+}
+
+// -----------------------------------------------------------------------
+// model parallelism
+// -----------------------------------------------------------------------
+
+template <class ElemType>
+static bool TrySliceParameterRows(const ComputationNodeBasePtr& node, size_t beginRow, size_t endRow)
+{
+    auto parameter = dynamic_pointer_cast<ComputationNode<ElemType>>(node);
+    if (!parameter)
+        return false;
+    auto shard = make_shared<Matrix<ElemType>>(parameter->GetDeviceId());
+    shard->AssignRowSliceValuesOf(parameter->Value(), beginRow, endRow - beginRow);
+    parameter->ValuePtrRef() = shard;
+    return true;
+}
+
+void ComputationNetwork::ShardParameterRows(const std::shared_ptr<MPIWrapper>& mpi)
+{
+    if (AreMatricesAllocated())
+        LogicError("ShardParameterRows: Must be called before the matrices are allocated.");
+    if (!mpi || mpi->NumNodesInUse() <= 1 || HasRowShardedParameters())
+        return;
+
+    // [parameter name] -> the row-sharded nodes, which must be its only consumers
+    std::map<std::wstring, std::vector<ComputationNodeBasePtr>> shardedNodesOfParameters;
+    for (const auto& iter : m_nameToNodeMap)
+        if (dynamic_cast<IRowShardedNode*>(iter.second.get()))
+            shardedNodesOfParameters[iter.second->Input(0)->NodeName()].push_back(iter.second);
+    for (const auto& iter : m_nameToNodeMap)
+    {
+        for (const auto& input : iter.second->GetInputs())
+        {
+            if (shardedNodesOfParameters.find(input->NodeName()) != shardedNodesOfParameters.end() && !dynamic_cast<IRowShardedNode*>(iter.second.get()))
+                InvalidArgument("ShardParameterRows: %ls is used by row-sharded nodes, and also by %ls.", input->NodeDescription().c_str(), iter.second->NodeDescription().c_str());
+        }
+    }
+
+    size_t numWorkers = mpi->NumNodesInUse();
+    for (const auto& iter : shardedNodesOfParameters)
+    {
+        auto parameter = GetNodeFromName(iter.first);
+        size_t numRows = parameter->GetAsMatrixNumRows();
+        size_t numCols = parameter->GetAsMatrixNumCols();
+        for (const auto& node : iter.second)
+            dynamic_cast<IRowShardedNode*>(node.get())->SetRowSharding(mpi, numRows);
+
+        auto rows = GetRowShard(numRows, numWorkers, mpi->CurrentNodeRank());
+        if (!TrySliceParameterRows<float>(parameter, rows.first, rows.second) && !TrySliceParameterRows<double>(parameter, rows.first, rows.second))
+            LogicError("ShardParameterRows: Unexpected element type of %ls.", parameter->NodeDescription().c_str());
+        parameter->SetDims(TensorShape(rows.second - rows.first, numCols), false);
+        m_rowShardedParameters.push_back(RowShardedParameter{ parameter, numRows, nullptr });
+
+        if (TraceLevel() > 0)
+            fprintf(stderr, "ShardParameterRows: %ls keeps rows [%d, %d) of %d.\n", parameter->NodeDescription().c_str(), (int) rows.first, (int) rows.second, (int) numRows);
+    }
+    m_rowShardingMPI = mpi;
+}
+
+// the shards arrive one after the other, each column-major
+template <class ElemType>
+static bool TryGatherParameterRows(const std::shared_ptr<MPIWrapper>& mpi, const ComputationNodeBasePtr& node, size_t numFullRows, MatrixBasePtr& shard)
+{
+    auto parameter = dynamic_pointer_cast<ComputationNode<ElemType>>(node);
+    if (!parameter)
+        return false;
+
+    const auto& value = parameter->Value();
+    size_t numCols = value.GetNumCols();
+    std::vector<ElemType> sendBuffer(value.GetNumElements());
+    if (!sendBuffer.empty())
+        value.CopySection(value.GetNumRows(), numCols, sendBuffer.data(), value.GetNumRows());
+
+    size_t numWorkers = mpi->NumNodesInUse();
+    std::vector<int> recvCounts(numWorkers), recvOffsets(numWorkers);
+    for (size_t worker = 0; worker < numWorkers; worker++)
+    {
+        auto rows = GetRowShard(numFullRows, numWorkers, worker);
+        recvCounts[worker]  = (int) ((rows.second - rows.first) * numCols);
+        recvOffsets[worker] = (int) (rows.first * numCols);
+    }
+    std::vector<ElemType> recvBuffer(mpi->IsMainNode() ? numFullRows * numCols : 0);
+    mpi->Gatherv(sendBuffer.data(), sendBuffer.size(), recvBuffer.data(), recvCounts.data(), recvOffsets.data(), mpi->MainNodeRank());
+    if (!mpi->IsMainNode())
+        return true;
+
+    std::vector<ElemType> fullBuffer(numFullRows * numCols);
+    for (size_t worker = 0; worker < numWorkers; worker++)
+    {
+        auto rows = GetRowShard(numFullRows, numWorkers, worker);
+        size_t numRows = rows.second - rows.first;
+        for (size_t j = 0; j < numCols; j++)
+            std::copy_n(recvBuffer.data() + recvOffsets[worker] + j * numRows, numRows, fullBuffer.data() + j * numFullRows + rows.first);
+    }
+    shard = parameter->ValuePtr();
+    parameter->ValuePtrRef() = make_shared<Matrix<ElemType>>(numFullRows, numCols, fullBuffer.data(), CPUDEVICE); // (only for saving)
+    parameter->SetDims(TensorShape(numFullRows, numCols), false);
+    return true;
+}
+
+template <class ElemType>
+static bool TryRestoreParameterRows(const ComputationNodeBasePtr& node, const MatrixBasePtr& shard)
+{
+    auto parameter = dynamic_pointer_cast<ComputationNode<ElemType>>(node);
+    if (!parameter)
+        return false;
+    parameter->ValuePtrRef() = dynamic_pointer_cast<Matrix<ElemType>>(shard);
+    parameter->SetDims(TensorShape(parameter->Value().GetNumRows(), parameter->Value().GetNumCols()), false);
+    return true;
+}
+
+void ComputationNetwork::GatherRowShardedParameters()
+{
+    for (auto& sharded : m_rowShardedParameters)
+    {
+        if (sharded.m_shard)
+            LogicError("GatherRowShardedParameters: %ls was already gathered.", sharded.m_node->NodeDescription().c_str());
+        if (!TryGatherParameterRows<float>(m_rowShardingMPI, sharded.m_node, sharded.m_numFullRows, sharded.m_shard) &&
+            !TryGatherParameterRows<double>(m_rowShardingMPI, sharded.m_node, sharded.m_numFullRows, sharded.m_shard))
+            LogicError("GatherRowShardedParameters: Unexpected element type of %ls.", sharded.m_node->NodeDescription().c_str());
+    }
+}
+
+void ComputationNetwork::RestoreRowShardedParameters()
+{
+    for (auto& sharded : m_rowShardedParameters)
+    {
+        if (!sharded.m_shard) // (not the main worker)
+            continue;
+        if (!TryRestoreParameterRows<float>(sharded.m_node, sharded.m_shard) && !TryRestoreParameterRows<double>(sharded.m_node, sharded.m_shard))
+            LogicError("RestoreRowShardedParameters: Unexpected element type of %ls.", sharded.m_node->NodeDescription().c_str());
+        sharded.m_shard = nullptr;
+    }
+}
+
+// in the order of ForwardProp() and Backprop(); the nodes do not support recomputation, which would repeat exchanges
+void ComputationNetwork::PropagateRowShardedNodesWithoutData(const std::vector<ComputationNodeBasePtr>& evalNodes, const ComputationNodeBasePtr& criterionNode, bool backprop)
+{
+    std::vector<ComputationNodeBasePtr> roots(evalNodes);
+    if (criterionNode)
+        roots.push_back(criterionNode);
+    std::set<ComputationNodeBasePtr> visited; // (a node is computed once for all roots)
+    for (const auto& root : roots)
+    {
+        for (const auto& node : GetEvalOrder(root))
+        {
+            auto shardedNode = dynamic_cast<IRowShardedNode*>(node.get());
+            if (shardedNode && shardedNode->IsRowSharded() && visited.insert(node).second)
+                shardedNode->ForwardPropWithoutData();
+        }
+    }
+    if (!criterionNode || !backprop)
+        return;
+
+    ZeroInputGradients(criterionNode);
+    const auto& evalOrder = GetEvalOrder(criterionNode);
+    for (auto iter = evalOrder.rbegin(); iter != evalOrder.rend(); iter++)
+    {
+        auto shardedNode = dynamic_cast<IRowShardedNode*>(iter->get());
+        if (shardedNode && shardedNode->IsRowSharded() && (*iter)->NeedsGradient())
+            shardedNode->BackpropWithoutData();
+    }
+}
+
+// -----------------------------------------------------------------------
+// pipeline parallelism
+// -----------------------------------------------------------------------
+
+static ComputationNodeBasePtr NewPipelineTransferNode(const ComputationNodeBasePtr& input, DEVICEID_TYPE deviceId, const wstring& name)
+{
+    if (input->Is<ComputationNode<float>>())
+        return New<PipelineTransferNode<float>>(deviceId, name);
+    else if (input->Is<ComputationNode<double>>())
+        return New<PipelineTransferNode<double>>(deviceId, name);
+    LogicError("CreatePipelined: Unexpected element type of %ls.", input->NodeDescription().c_str());
+}
+
+// A computed node is in the latest stage of its inputs, or in the next one after an input that is a stage boundary.
+// A leaf (input, parameter) is in the earliest stage that uses it. The network is saved and loaded again with each
+// node on the GPU of its stage, so that whatever a node keeps on its device is created there, too.
+template <class ElemType>
+/*static*/ ComputationNetworkPtr ComputationNetwork::CreatePipelined(const ComputationNetworkPtr& net, const std::vector<std::wstring>& stageBoundaryNodeNames,
+                                                                     const std::vector<DEVICEID_TYPE>& deviceIds, const ComputationNodeBasePtr& criterionNode,
+                                                                     const std::vector<ComputationNodeBasePtr>& evalNodes, const std::wstring& tempFileName)
+{
+    net->VerifyIsCompiled("CreatePipelined");
+    size_t numStages = stageBoundaryNodeNames.size() + 1;
+    if (stageBoundaryNodeNames.empty())
+        InvalidArgument("CreatePipelined: At least one stage boundary is required.");
+    if (deviceIds.size() != numStages)
+        InvalidArgument("CreatePipelined: %d stages require as many devices, but %d were given.", (int) numStages, (int) deviceIds.size());
+    for (size_t stage = 0; stage < numStages; stage++)
+    {
+        if (deviceIds[stage] < 0 || find(deviceIds.begin(), deviceIds.begin() + stage, deviceIds[stage]) != deviceIds.begin() + stage)
+            InvalidArgument("CreatePipelined: The stages must be on distinct GPUs.");
+    }
+
+    map<ComputationNodeBasePtr, size_t> boundaries; // [boundary node] -> the stage it ends
+    for (size_t stage = 0; stage + 1 < numStages; stage++)
+    {
+        auto node = net->GetNodeFromName(stageBoundaryNodeNames[stage]);
+        if (node->IsLeaf() || node->IsPartOfLoop())
+            InvalidArgument("CreatePipelined: The stage boundary %ls must be a computed node outside of recurrent loops.", node->NodeDescription().c_str());
+        if (!boundaries.insert(make_pair(node, stage)).second)
+            InvalidArgument("CreatePipelined: %ls is given as stage boundary twice.", node->NodeDescription().c_str());
+    }
+
+    // stages of the computed nodes, until they no longer change (a loop may pass its stage back to its start)
+    const auto& evalOrder = net->GetEvalOrder(nullptr);
+    map<ComputationNodeBasePtr, size_t> stages;
+    for (bool changed = true; changed;)
+    {
+        changed = false;
+        for (const auto& node : evalOrder)
+        {
+            size_t stage = 0;
+            for (const auto& input : node->GetInputs())
+                stage = max(stage, stages[input] + (boundaries.find(input) != boundaries.end() ? 1 : 0));
+            if (stages[node] != stage)
+            {
+                stages[node] = stage;
+                changed = true;
+            }
+        }
+    }
+    map<ComputationNodeBasePtr, size_t> leafStages;
+    for (const auto& node : evalOrder)
+    {
+        for (const auto& input : node->GetInputs())
+        {
+            if (!input->IsLeaf())
+                continue;
+            auto iter = leafStages.find(input);
+            leafStages[input] = iter == leafStages.end() ? stages[node] : min(iter->second, stages[node]);
+        }
+    }
+    for (const auto& iter : leafStages)
+        stages[iter.first] = iter.second;
+
+    for (const auto& iter : boundaries)
+    {
+        if (stages[iter.first] != iter.second)
+            InvalidArgument("CreatePipelined: The stage boundary %ls would end stage %d instead of %d; each boundary must depend on the one before it.",
+                            iter.first->NodeDescription().c_str(), (int) stages[iter.first], (int) iter.second);
+    }
+    std::vector<ComputationNodeBasePtr> lastStageNodes(evalNodes);
+    lastStageNodes.push_back(criterionNode);
+    for (const auto& node : lastStageNodes)
+    {
+        if (stages[node] + 1 != numStages)
+            InvalidArgument("CreatePipelined: %ls must be computed in the last stage, after all stage boundaries.", node->NodeDescription().c_str());
+    }
+
+    // the stages of all micro-batches but the last one are recomputed before their backprop, which must reproduce the
+    // values that the later stages got
+    for (const auto& node : net->GetEvalOrder(criterionNode))
+    {
+        if (node->IsLeaf() || node->RequiresPreCompute())
+            continue;
+        if (!node->SupportsValueRecomputation() || node->Is<IRngUser>())
+            InvalidArgument("CreatePipelined: %ls cannot be pipelined, since recomputing it would not reproduce its value.", node->NodeDescription().c_str());
+    }
+
+    // the copy, with each node on the GPU of its stage
+    auto pipelined = make_shared<ComputationNetwork>(deviceIds.back());
+    pipelined->SetTraceLevel(net->TraceLevel());
+    for (const auto& iter : stages)
+        pipelined->m_nodeDeviceIds[iter.first->NodeName()] = deviceIds[iter.second];
+    net->Save(tempFileName);
+    pipelined->Load<ElemType>(tempFileName);
+    _wunlink(tempFileName.c_str());
+
+    auto stageOf = [&](const ComputationNodeBasePtr& node)
+    {
+        auto iter = stages.find(net->GetNodeFromName(node->NodeName()));
+        return iter != stages.end() ? iter->second : numStages - 1; // (not used by any root)
+    };
+    for (const auto& iter : pipelined->m_nameToNodeMap)
+        pipelined->m_pipelineStages[iter.second] = stageOf(iter.second);
+
+    // a transfer for each value and later stage that uses it
+    map<pair<ComputationNodeBasePtr, size_t>, ComputationNodeBasePtr> transfers; // [(input, consuming stage)] -> transfer
+    std::vector<ComputationNodeBasePtr> consumers;
+    for (const auto& iter : pipelined->m_nameToNodeMap)
+        consumers.push_back(iter.second);
+    for (const auto& node : consumers)
+    {
+        size_t stage = pipelined->m_pipelineStages[node];
+        for (size_t i = 0; i < node->GetNumInputs(); i++)
+        {
+            auto input = node->Input(i);
+            size_t inputStage = pipelined->m_pipelineStages[input];
+            if (inputStage >= stage)
+                continue;
+            auto& transfer = transfers[make_pair(input, stage)];
+            if (!transfer)
+            {
+                transfer = pipelined->AddNodeToNetAndAttachInputs(NewPipelineTransferNode(input, deviceIds[stage], input->NodeName() + L".pipelineTo" + std::to_wstring(stage)), { input });
+                pipelined->m_pipelineStages[transfer] = inputStage;
+                pipelined->m_pipelineTransferNodes.push_back(transfer);
+            }
+            node->SetInput(i, transfer);
+        }
+    }
+    pipelined->m_pipelineDeviceIds = deviceIds;
+    pipelined->CompileNetwork();
+
+    if (pipelined->TraceLevel() > 0)
+    {
+        fprintf(stderr, "CreatePipelined: %d stages, %d values transferred between them:\n", (int) numStages, (int) transfers.size());
+        for (const auto& transfer : pipelined->m_pipelineTransferNodes)
+            fprintf(stderr, "\t%ls: stage %d -> GPU %d\n", transfer->Input(0)->NodeDescription().c_str(), (int) pipelined->m_pipelineStages[transfer], (int) transfer->GetDeviceId());
+    }
+    return pipelined;
+}
+
+size_t ComputationNetwork::GetPipelineStage(const ComputationNodeBasePtr& node) const
+{
+    auto iter = m_pipelineStages.find(node);
+    if (iter == m_pipelineStages.end())
+        LogicError("GetPipelineStage: %ls was added after the network was pipelined.", node->NodeDescription().c_str());
+    return iter->second;
+}
+
+void ComputationNetwork::SetPipelineMicroBatch(size_t microBatch, bool replay)
+{
+    for (const auto& node : m_pipelineTransferNodes)
+        dynamic_cast<IPipelineTransferNode&>(*node).SetPipelineMicroBatch(microBatch, replay);
+}
+
 // -----------------------------------------------------------------------
 // unit test
 // -----------------------------------------------------------------------
@@ -1503,26 +2308,44 @@ void ComputationNetwork::SaveToDbnFile(ComputationNetworkPtr net, const std::wst
 }
 
 template void ComputationNetwork::InitLearnableParametersWithBilinearFill<float>(const ComputationNodeBasePtr& node, size_t kernelWidth, size_t kernelHeight);
-template void ComputationNetwork::Read<float>(const wstring& fileName);
-template void ComputationNetwork::ReadPersistableParameters<float>(File& fstream, bool create);
+template void ComputationNetwork::Read<float>(const wstring& fileName, bool convertPrecision);
+template void ComputationNetwork::ReadPersistableParameters<float>(File& fstream, bool create, bool convertPrecision);
 template void ComputationNetwork::PerformSVDecomposition<float>(const map<wstring, float>& SVDConfig, size_t alignedsize);
 template /*static*/ void ComputationNetwork::SetDropoutRate<float>(ComputationNetworkPtr net, const ComputationNodeBasePtr& criterionNode, const double dropoutRate, double& prevDropoutRate);
+template /*static*/ void ComputationNetwork::SetCounterBasedDropout<float>(ComputationNetworkPtr net, const ComputationNodeBasePtr& criterionNode, bool useCounterBasedMask);
 template /*static*/ void ComputationNetwork::SetIRngUserSeed<float>(ComputationNetworkPtr net, const ComputationNodeBasePtr& criterionNode, size_t randSeedBase);
 template /*static*/ void ComputationNetwork::SetBatchNormalizationTimeConstants<float>(ComputationNetworkPtr net, const ComputationNodeBasePtr& criterionNode, const double normalizationTimeConstant, double& prevNormalizationTimeConstant, double blendTimeConstant, double& prevBlendTimeConstant);
 template void ComputationNetwork::SetSeqParam<float>(ComputationNetworkPtr net, const ComputationNodeBasePtr criterionNode, const double& hsmoothingWeight, const double& frameDropThresh, const bool& doreferencealign,
-                                                     const double& amf, const double& lmf, const double& wp, const double& bMMIfactor, const bool& sMBR);
+                                                     const double& amf, const double& lmf, const double& wp, const double& bMMIfactor, const bool& sMBR, const size_t latticeCacheMB);
 template void ComputationNetwork::SaveToDbnFile<float>(ComputationNetworkPtr net, const std::wstring& fileName) const;
+template size_t ComputationNetwork::QuantizeTimesNodes<float>(size_t bitShiftWeights, size_t bitShiftData, const set<wstring>& excludedNodeNames);
+template size_t ComputationNetwork::SparsifyTimesWeights<float>(double maxDensity);
+template size_t ComputationNetwork::PackTimesWeights<float>();
+template size_t ComputationNetwork::FoldBatchNormalization<float>();
+template void ComputationNetwork::OptimizeForInference<float>();
+template /*static*/ ComputationNetworkPtr ComputationNetwork::CreatePipelined<float>(const ComputationNetworkPtr& net, const std::vector<std::wstring>& stageBoundaryNodeNames,
+                                                                                  const std::vector<DEVICEID_TYPE>& deviceIds, const ComputationNodeBasePtr& criterionNode,
+                                                                                  const std::vector<ComputationNodeBasePtr>& evalNodes, const std::wstring& tempFileName);
 
 template void ComputationNetwork::InitLearnableParametersWithBilinearFill<double>(const ComputationNodeBasePtr& node, size_t kernelWidth, size_t kernelHeight);
-template void ComputationNetwork::Read<double>(const wstring& fileName);
-template void ComputationNetwork::ReadPersistableParameters<double>(File& fstream, bool create);
+template void ComputationNetwork::Read<double>(const wstring& fileName, bool convertPrecision);
+template void ComputationNetwork::ReadPersistableParameters<double>(File& fstream, bool create, bool convertPrecision);
 template void ComputationNetwork::PerformSVDecomposition<double>(const map<wstring, float>& SVDConfig, size_t alignedsize);
 template /*static*/ void ComputationNetwork::SetDropoutRate<double>(ComputationNetworkPtr net, const ComputationNodeBasePtr& criterionNode, const double dropoutRate, double& prevDropoutRate);
+template /*static*/ void ComputationNetwork::SetCounterBasedDropout<double>(ComputationNetworkPtr net, const ComputationNodeBasePtr& criterionNode, bool useCounterBasedMask);
 template /*static*/ void ComputationNetwork::SetIRngUserSeed<double>(ComputationNetworkPtr net, const ComputationNodeBasePtr& criterionNode, size_t randSeedBase);
 template /*static*/ void ComputationNetwork::SetBatchNormalizationTimeConstants<double>(ComputationNetworkPtr net, const ComputationNodeBasePtr& criterionNode, const double normalizationTimeConstant, double& prevNormalizationTimeConstant, double blendTimeConstant, double& prevBlendTimeConstant);
 template void ComputationNetwork::SetSeqParam<double>(ComputationNetworkPtr net, const ComputationNodeBasePtr criterionNode, const double& hsmoothingWeight, const double& frameDropThresh, const bool& doreferencealign,
-                                                      const double& amf, const double& lmf, const double& wp, const double& bMMIfactor, const bool& sMBR);
+                                                      const double& amf, const double& lmf, const double& wp, const double& bMMIfactor, const bool& sMBR, const size_t latticeCacheMB);
 template void ComputationNetwork::SaveToDbnFile<double>(ComputationNetworkPtr net, const std::wstring& fileName) const;
+template size_t ComputationNetwork::QuantizeTimesNodes<double>(size_t bitShiftWeights, size_t bitShiftData, const set<wstring>& excludedNodeNames);
+template size_t ComputationNetwork::SparsifyTimesWeights<double>(double maxDensity);
+template size_t ComputationNetwork::PackTimesWeights<double>();
+template size_t ComputationNetwork::FoldBatchNormalization<double>();
+template void ComputationNetwork::OptimizeForInference<double>();
+template /*static*/ ComputationNetworkPtr ComputationNetwork::CreatePipelined<double>(const ComputationNetworkPtr& net, const std::vector<std::wstring>& stageBoundaryNodeNames,
+                                                                                   const std::vector<DEVICEID_TYPE>& deviceIds, const ComputationNodeBasePtr& criterionNode,
+                                                                                   const std::vector<ComputationNodeBasePtr>& evalNodes, const std::wstring& tempFileName);
 
 // register ComputationNetwork with the ScriptableObject system
 ScriptableObjects::ConfigurableRuntimeTypeRegister::Add<ComputationNetwork> registerComputationNetwork(L"ComputationNetwork");
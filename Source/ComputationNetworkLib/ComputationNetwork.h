@@ -13,6 +13,9 @@
 #include "ComputationNode.h"
 #include "ScriptableObjects.h"
 #include "ComputationEnvironment.h"
+#include "FusedElementwiseChain.h"
+#include "GPUGraphReplay.h"
+#include "ActivationOffloader.h"
 
 #include <map>
 #include <string>
@@ -32,6 +35,8 @@
 
 namespace Microsoft { namespace MSR { namespace CNTK {
 
+class MPIWrapper;
+
 // ===========================================================================
 // ComputationNetwork -- computation graph and operations
 // ===========================================================================
@@ -52,6 +57,15 @@ public:
         m_randomSeedOffset(0),
         m_isCompiled(false),
         m_areMatricesAllocated(false),
+        m_isSnapshotForSaving(false),
+        m_activationCheckpointInterval(0),
+        m_activationOffloadMinSampleSize(0),
+        m_parameterGradientAccumulation(false),
+        m_elementwiseFusion(false),
+        m_inPlaceExecution(false),
+        m_rowStackElimination(false),
+        m_transposeAbsorption(false),
+        m_concurrentBranches(false),
         m_pMBLayoutOfNetwork(make_shared<MBLayout>(1, 0, L"*")),
         m_environment(make_shared<ComputationEnvironment>())
     {
@@ -90,7 +104,7 @@ public:
     // -----------------------------------------------------------------------
 
     template <class ElemType>
-    void ReadPersistableParameters(File& fstream, bool create);
+    void ReadPersistableParameters(File& fstream, bool create, bool convertPrecision = false);
     // reload node content only, e.g. used by SGD::Train() when going back to an older model that had better training objective
     template <class ElemType>
     void RereadPersistableParameters(const std::wstring& fileName)
@@ -100,10 +114,12 @@ public:
     }
     // design BUGBUG: binary files do not know whether they are float or double.
     // TODO: modify file format to know this; then eliminate the <ElemType> dependency (and in some future, allow nodes to be different)
-    template <class ElemType> void Read(const std::wstring& fileName);
-    template <class ElemType> void Load(const std::wstring& fileName)
+    // With 'convertPrecision', all nodes are created as ElemType, and the values of a model saved in the other precision are
+    // converted while they are read, e.g. to evaluate a double model as float without ever holding it as double.
+    template <class ElemType> void Read(const std::wstring& fileName, bool convertPrecision = false);
+    template <class ElemType> void Load(const std::wstring& fileName, bool convertPrecision = false)
     {
-        Read<ElemType>(fileName);
+        Read<ElemType>(fileName, convertPrecision);
         // perform all further post-processing, caching, etc.
         CompileNetwork();
     }
@@ -134,7 +150,10 @@ public:
     void ForwardProp(const ComputationNodeBasePtr rootNode);
 
     // main entry point for backprop
-    void Backprop(const ComputationNodeBasePtr rootNode);
+    // 'rootGradient' scales all gradients, e.g. for loss scaling with half-precision computation
+    // 'accumulateParameterGradients' adds to the gradients of the learnable parameters left by the previous call,
+    // instead of resetting them (gradient accumulation, requires EnableParameterGradientAccumulation())
+    void Backprop(const ComputationNodeBasePtr rootNode, double rootGradient = 1, bool accumulateParameterGradients = false);
 
     template <class NODESET> // version that takes multiple nodes
     void ForwardProp(const NODESET& nodes)
@@ -175,7 +194,12 @@ public:
 
 private:
     void ValidateNetwork();
-    size_t ValidateNodes(list<ComputationNodeBasePtr> nodes, bool isFirstPass, bool isFinalValidationPass);
+    void ValidateNetworkNodes(const list<ComputationNodeBasePtr>& nodes);
+    bool ValidateNodeInPass(const ComputationNodeBasePtr& node, bool isFirstPass, bool isFinalValidationPass, bool& changed);
+    wstring GetValidationCachePath(const list<ComputationNodeBasePtr>& nodes) const;
+    bool RestoreValidation(const list<ComputationNodeBasePtr>& nodes, const wstring& path);
+    void SaveValidation(const list<ComputationNodeBasePtr>& nodes, const wstring& path) const;
+    size_t ValidateNodes(const list<ComputationNodeBasePtr>& nodes, bool isFirstPass, bool isFinalValidationPass);
     bool ValidateNode(ComputationNodeBasePtr node, bool isFinalValidationPass) const;
     void MarkValueNonSharableNodes();
     void ChangeNodeInputs(ComputationNodeBasePtr fromNode, ComputationNodeBasePtr toNode);
@@ -190,12 +214,170 @@ private:
     void VerifyIsCompiled(const char* where) const;
 public:
     void AllocateAllMatrices(const std::vector<ComputationNodeBasePtr>& evalRootNodes, const std::vector<ComputationNodeBasePtr>& outValueRootNodes, ComputationNodeBasePtr trainRootNode);
+    void WriteMemorySharingReport(const std::wstring& path) const;
+    // bytes currently allocated by the shared buffers of the matrix pool
+    size_t GetMatrixPoolAllocatedBytes() const { return m_matrixPool.GetAllocatedBytes(); }
+
+    // activation checkpointing: of the values computed for the training criterion, keep only those of the named
+    // nodes and of every 'interval'-th node in evaluation order; recompute the others right before their backprop.
+    // Must be called before AllocateAllMatrices(). Requires (and selects) the SizeAware memory sharing policy.
+    void SetActivationCheckpoints(size_t interval, const std::vector<std::wstring>& nodeNames)
+    {
+        for (const auto& name : nodeNames)
+            if (!NodeNameExists(name))
+                InvalidArgument("SetActivationCheckpoints: No node named '%ls'.", name.c_str());
+        m_activationCheckpointInterval = interval;
+        m_activationCheckpointNodeNames = nodeNames;
+    }
+    bool IsActivationCheckpointingEnabled() const { return m_activationCheckpointInterval > 0 || !m_activationCheckpointNodeNames.empty(); }
+
+    // activation offloading: while training, values that are kept for backprop wait in page-locked host memory instead
+    // of on the GPU (see ActivationOffloader). Selected are the named nodes, and, if minSampleSize > 0, all nodes whose
+    // samples have at least minSampleSize elements. Must be called before AllocateAllMatrices().
+    void SetActivationOffloading(size_t minSampleSize, const std::vector<std::wstring>& nodeNames)
+    {
+        for (const auto& name : nodeNames)
+            if (!NodeNameExists(name))
+                InvalidArgument("SetActivationOffloading: No node named '%ls'.", name.c_str());
+        m_activationOffloadMinSampleSize = minSampleSize;
+        m_activationOffloadNodeNames = nodeNames;
+    }
+    bool IsActivationOffloadingEnabled() const { return m_activationOffloadMinSampleSize > 0 || !m_activationOffloadNodeNames.empty(); }
+    // statistics of the offloaded values since the last call
+    ActivationOffloader::Statistics CollectActivationOffloadStatistics()
+    {
+        return m_activationOffloader ? m_activationOffloader->CollectStatistics() : ActivationOffloader::Statistics();
+    }
+
+    // gradient accumulation: parameter gradients are summed over several Backprop() calls, so no parent may overwrite
+    // them instead of adding to them. Must be called before AllocateAllMatrices().
+    void EnableParameterGradientAccumulation(bool enable)
+    {
+        if (AreMatricesAllocated())
+            LogicError("EnableParameterGradientAccumulation: Must be called before the matrices are allocated.");
+        m_parameterGradientAccumulation = enable;
+    }
+
+    // model parallelism: the parameters of row-sharded nodes (see ModelParallelNodes.h) keep the rows of this worker
+    // only. Must be called by all workers, before AllocateAllMatrices(). The other functions below are collective, too.
+    void ShardParameterRows(const std::shared_ptr<MPIWrapper>& mpi);
+    bool HasRowShardedParameters() const { return !m_rowShardedParameters.empty(); }
+    // for saving the model: on the main worker, the sharded parameters hold their full values until restored
+    void GatherRowShardedParameters();
+    void RestoreRowShardedParameters();
+    // for a worker without data for a minibatch: the exchanges of the row-sharded nodes in ForwardProp() of the eval
+    // nodes and of the criterion (if not null), and, if 'backprop', in Backprop() of the criterion
+    void PropagateRowShardedNodesWithoutData(const std::vector<ComputationNodeBasePtr>& evalNodes, const ComputationNodeBasePtr& criterionNode, bool backprop);
+    bool IsRowShardedParameter(const ComputationNodeBasePtr& node) const
+    {
+        for (const auto& sharded : m_rowShardedParameters)
+            if (sharded.m_node == node)
+                return true;
+        return false;
+    }
+
+    // pipeline parallelism: a copy of 'net' whose nodes are split into consecutive stages, each on its own GPU. Stage k
+    // ends with stageBoundaryNodeNames[k] and runs on deviceIds[k]; the criterion and eval nodes must be in the last
+    // stage. The values passed between the stages are copied by PipelineTransferNodes (see ModelParallelNodes.h). A
+    // minibatch is trained as micro-batches: forward prop of each of them, then, last one first, backprop of each stage,
+    // where the stages of all but the last micro-batch first recompute their values. 'net' is saved to 'tempFileName'
+    // to create the copy.
+    template <class ElemType>
+    static ComputationNetworkPtr CreatePipelined(const ComputationNetworkPtr& net, const std::vector<std::wstring>& stageBoundaryNodeNames,
+                                                 const std::vector<DEVICEID_TYPE>& deviceIds, const ComputationNodeBasePtr& criterionNode,
+                                                 const std::vector<ComputationNodeBasePtr>& evalNodes, const std::wstring& tempFileName);
+    bool IsPipelined() const { return !m_pipelineDeviceIds.empty(); }
+    size_t GetNumPipelineStages() const { return m_pipelineDeviceIds.size(); }
+    // select the values of micro-batch 'microBatch' passed between the stages; with 'replay', the values are the ones
+    // kept from its forward prop, for ForwardPropPipelineStage()
+    void SetPipelineMicroBatch(size_t microBatch, bool replay);
+    // recompute the values of one stage for the micro-batch selected with 'replay', before backprop of that stage
+    void ForwardPropPipelineStage(const ComputationNodeBasePtr& rootNode, size_t stage);
+    // Backprop() of one stage; the last one sets the root gradient, the others need the later stages done
+    void BackpropPipelineStage(const ComputationNodeBasePtr& rootNode, size_t stage, double rootGradient = 1.0);
+
+    // inference: compute chains of elementwise nodes whose intermediate values are not used otherwise in one pass
+    // each (see FusedElementwiseChain). This applies while the network is inferring, and is kept when it is compiled
+    // again. Must be called before AllocateAllMatrices().
+    void EnableElementwiseFusion(bool enable);
+
+    // let nodes that support it (ForwardPropCanRunInPlace(), e.g. Sigmoid or ReLU) compute their value in place over that
+    // of their input, if the input is read by no other node and not needed for backprop. This saves one value matrix per
+    // such node; the memory sharing report lists both nodes with the same buffer. Nodes in recurrent loops or fused
+    // chains are not computed in place, nor are any with activation checkpointing, activation offloading, pipelining or
+    // hyperCompressMemory. Since the input's value is overwritten, it cannot be traced or inspected after forward prop.
+    // Must be called before AllocateAllMatrices().
+    void EnableInPlaceExecution(bool enable);
+
+    // concatenation elimination: a RowStack (or Splice) along the last axis whose only consumer is a product by weights,
+    // as in the projection after the towers of a multi-tower model, is not computed. Instead, the product is computed as
+    // the sum of the products of the matching column stripes of the weights by the stacked inputs, and its gradient
+    // goes straight into theirs. This saves the copies in both directions and the stacked value and gradient matrices.
+    // It is decided when the network is compiled, and undone for RowStacks that turn out to be roots when the matrices
+    // are allocated. Must be called before AllocateAllMatrices().
+    void EnableRowStackElimination(bool enable);
+
+    // transpose absorption: a Transpose (TransposeDimensions of the two leading axes) of weights or other matrices that
+    // are not minibatch data, whose only consumer is a product with it as the left argument, as with tied embeddings, is
+    // not computed. The product reads the matrix with swapped strides, i.e. with the transposition flag of GEMM, and adds
+    // its gradient into that of the matrix in the same way. This saves the copy in both directions and its matrices.
+    // Must be called before AllocateAllMatrices().
+    void EnableTransposeAbsorption(bool enable);
+
+    // inference on the CPU: nodes that neither depend on each other nor share matrices are computed concurrently, by
+    // running the nodes of each level of their dependency graph on the CPUThreadPool. The graph is built from the
+    // input links and from the matrices assigned by memory sharing, so must be called before AllocateAllMatrices().
+    // Stacked recurrent loops are computed as a wavefront, where a loop computes a time step while the loop below it
+    // computes the next one.
+    void EnableConcurrentBranches(bool enable);
+
+    // GPU: each ForwardProp() and Backprop() of a root is recorded as a GPU graph once it has run a few times on the
+    // same matrices and MBLayouts, and then replayed with a single launch while they stay the same (see
+    // GPUGraphReplay). Passes that cannot be recorded are computed node by node as usual.
+    void EnableGPUGraphReplay(bool enable) { m_gpuGraphReplay = enable ? make_shared<GPUGraphReplay>() : nullptr; }
 
     // From the set of nodes extract all nodes which are used as accumulator nodes.
     std::set<ComputationNodeBasePtr> ExtractNodesWhichAccumulateResult(std::set<ComputationNodeBasePtr> nodes);
 
 private:
+    void FuseElementwiseChains();
+    void ElideInputs();
+    void PlanConcurrentBranches();
+    bool CanReplayGPUGraphs() const;
     void PrintMemorySharingStructure(const std::vector<ComputationNodeBasePtr>& nodes);
+    void PrintMemoryAllocationPlan() const;
+    size_t GetPipelineStage(const ComputationNodeBasePtr& node) const;
+    // the device of a node that is loaded from a model file, see CreatePipelined()
+    DEVICEID_TYPE GetDeviceIdForNewNode(const std::wstring& nodeName) const
+    {
+        auto iter = m_nodeDeviceIds.find(nodeName);
+        return iter != m_nodeDeviceIds.end() ? iter->second : m_deviceId;
+    }
+
+    // result of PlanActivationRecomputation()
+    // The criterion's evaluation order is cut into consecutive segments, each ending in a checkpoint node.
+    struct ActivationRecomputationPlan
+    {
+        std::unordered_map<ComputationNodeBasePtr, size_t> m_segmentOf;      // [node] -> segment index, for all nodes in the criterion's evaluation order
+        std::vector<ComputationNodeBasePtr> m_segmentFirstNodes;             // [segment] first node in evaluation order
+        std::vector<ComputationNodeBasePtr> m_segmentLastNodes;              // [segment] last node in evaluation order
+        std::vector<std::vector<ComputationNodeBasePtr>> m_recomputedNodes;  // [segment] nodes to recompute before the segment's backprop, in evaluation order
+    };
+    ActivationRecomputationPlan PlanActivationRecomputation(const ComputationNodeBasePtr& trainRootNode,
+                                                            std::unordered_map<ComputationNodeBasePtr, bool>& outputValueNeededDuringBackProp,
+                                                            const std::unordered_map<ComputationNodeBasePtr, std::unordered_set<ComputationNodeBasePtr>>& parentsMap);
+
+    // result of PlanActivationOffloading()
+    // Positions refer to the nested nodes of the criterion's PARTraversalFlowControlNode (loops count as one).
+    struct ActivationOffloadPlan
+    {
+        std::vector<ComputationNodeBasePtr> m_nestedNodes;                     // criterion's evaluation order, with loops collapsed
+        std::vector<std::pair<ComputationNodeBasePtr, size_t>> m_offloadedNodes; // (node, index of its last forward consumer)
+        std::set<ComputationNodeBasePtr> m_offloadedNodeSet;
+    };
+    ActivationOffloadPlan PlanActivationOffloading(const ComputationNodeBasePtr& trainRootNode,
+                                                   const std::unordered_map<ComputationNodeBasePtr, bool>& outputValueNeededDuringBackProp,
+                                                   const std::unordered_map<ComputationNodeBasePtr, std::unordered_set<ComputationNodeBasePtr>>& parentsMap);
     void ReleaseMatricesAfterEvalForChildren(ComputationNodeBasePtr n, std::unordered_map<ComputationNodeBasePtr, int>& parentCount);
     void AllocateGradientMatricesForInputs(ComputationNodeBasePtr parentNode);
 
@@ -214,9 +396,9 @@ private:
     void FormRecurrentLoops(const ComputationNodeBasePtr& rootNode);
     void DetermineSCCs(const ComputationNodeBasePtr& rootNode);
     void DetermineSCCsR(ComputationNodeBasePtr cur, std::list<ComputationNodeBasePtr>& sccStack, size_t& index, size_t& loopId);
+    void CloseSCC(const ComputationNodeBasePtr& cur, std::list<ComputationNodeBasePtr>& sccStack, size_t& loopId);
     void DetermineLoopForwardOrderR(std::unordered_set<ComputationNodeBasePtr>& visited, std::unordered_set<ComputationNodeBasePtr>& recStack, std::list<ComputationNodeBasePtr>& nodesStack, ComputationNodeBasePtr cur);
-    void GatherLoopNodesR(const ComputationNodeBasePtr& rootNode, std::unordered_set<ComputationNodeBasePtr>& visited, std::map<int, std::list<ComputationNodeBasePtr>>& recurrentResult, std::list<ComputationNodeBasePtr>& noRecurrentResult);
-    void ReorderLoops(std::list<ComputationNodeBasePtr>& nodes, const std::map<int, std::list<ComputationNodeBasePtr>>& /*recurrentNodes*/, const std::list<ComputationNodeBasePtr>& /*noRecurrentNodes*/);
+    void ReorderLoops(std::list<ComputationNodeBasePtr>& nodes);
 
 public:
     // -----------------------------------------------------------------------
@@ -241,18 +423,32 @@ public:
         if (!rootNode) // this creates the global one
         {
             evalOrder = ComputationNodeBase::EnumerateNodes(m_allRoots);
+            m_globalEvalOrderPositions.clear();
         }
         else // this creates a subset of the global eval order of all nodes that rootNode depends on
         {
-            auto rawTraversalForRoot = ComputationNodeBase::EnumerateNodes({ rootNode }); // traverse to find the set (we ignore the order)
-            set<ComputationNodeBasePtr> rawSet(rawTraversalForRoot.begin(), rawTraversalForRoot.end());
-            for (const auto& node : GetEvalOrder(nullptr)) // iterate over global one and pull out everything that is included in the set for rootNode
+            // index the global one once, so that the cost for each root is that of its own nodes
+            if (m_globalEvalOrderPositions.empty())
             {
-                if (rawSet.find(node) != rawSet.end())
-                    evalOrder.push_back(node);
+                for (const auto& node : GetEvalOrder(nullptr))
+                    m_globalEvalOrderPositions.insert(make_pair(node, m_globalEvalOrderPositions.size()));
             }
+            // traverse to find the set (we ignore the order), and sort it by the global order
+            std::vector<std::pair<size_t, ComputationNodeBasePtr>> positionedNodes;
+            for (const auto& node : ComputationNodeBase::EnumerateNodes({ rootNode }))
+            {
+                auto position = m_globalEvalOrderPositions.find(node);
+                if (position != m_globalEvalOrderPositions.end())
+                    positionedNodes.push_back(make_pair(position->second, node));
+            }
+            sort(positionedNodes.begin(), positionedNodes.end(), [](const std::pair<size_t, ComputationNodeBasePtr>& a, const std::pair<size_t, ComputationNodeBasePtr>& b)
+            {
+                return a.first < b.first;
+            });
+            for (const auto& positionedNode : positionedNodes)
+                evalOrder.push_back(positionedNode.second);
         }
-        m_evalOrders[rootNode] = evalOrder;
+        m_evalOrders[rootNode] = move(evalOrder);
     }
 
     // replace an existing eval order with an updated one
@@ -261,6 +457,8 @@ public:
     {
         GetEvalOrder(rootNode); // verify that there is already an entry for rootNode
         m_evalOrders[rootNode] = nodes;
+        if (!rootNode)
+            m_globalEvalOrderPositions.clear();
     }
 
     bool EvalOrderExists(const ComputationNodeBasePtr& rootNode) const
@@ -375,6 +573,8 @@ public:
     ComputationNodeBasePtr CopyNode(const ComputationNetwork& fromNet, const std::wstring fromName, std::wstring toName, const CopyNodeFlags flags);
     void CopySubTree(const ComputationNetwork& fromNet, const std::wstring fromName, std::wstring toNamePrefix, const CopyNodeFlags flags);
     void CopyInputs(const std::wstring fromName, std::wstring toName);
+    ComputationNetworkPtr CloneSharingParameters() const;
+    ComputationNetworkPtr CreateSnapshotForSaving() const;
     void RenameNode(const std::wstring& nodeNameOrig, const std::wstring& nodeNameNew);
     void RenameNode(ComputationNodeBasePtr node, const std::wstring& newNodeName);
     void DeleteNode(const std::wstring& nodeName);
@@ -449,6 +649,10 @@ public:
     template <class ElemType>
     static void SetDropoutRate(ComputationNetworkPtr net, const ComputationNodeBasePtr& criterionNode, const double dropoutRate, double& prevDropoutRate);
 
+    // dropout masks computed by a counter-based RNG instead of stored, see DropoutNode; must be set before AllocateAllMatrices()
+    template <class ElemType>
+    static void SetCounterBasedDropout(ComputationNetworkPtr net, const ComputationNodeBasePtr& criterionNode, bool useCounterBasedMask);
+
     template <class ElemType>
     static void SetIRngUserSeed(ComputationNetworkPtr net, const ComputationNodeBasePtr& criterionNode, size_t randSeedBase);
     
@@ -467,9 +671,51 @@ public:
                             const double& lmf = 14.0f,
                             const double& wp = 0.0f,
                             const double& bMMIfactor = 0.0f,
-                            const bool& sMBR = false);
+                            const bool& sMBR = false,
+                            const size_t latticeCacheMB = 0);
     static void SetMaxTempMemSizeForCNN(ComputationNetworkPtr net, const ComputationNodeBasePtr& criterionNode, const size_t maxTempMemSizeInSamples);
 
+    // CPU inference with 16-bit fixed-point products: the TimesNodes that multiply by weights, except 'excludedNodeNames',
+    // quantize their weights once, here, and then the data in each evaluation. Returns the number of nodes switched.
+    template <class ElemType>
+    size_t QuantizeTimesNodes(size_t bitShiftWeights, size_t bitShiftData, const std::set<std::wstring>& excludedNodeNames);
+
+    // CPU inference with MKL: the TimesNodes that multiply by weights keep them packed for the GEMM kernels, see
+    // TimesNodeBase::EnablePackedWeights(). The packed weights are frozen. Returns the number of nodes switched.
+    template <class ElemType>
+    size_t PackTimesWeights();
+
+    // inference: Sigmoid, Tanh, Exp and Log nodes compute approximations instead, within the bounds given with
+    // FastExp() in TensorOps.h (about 1e-6 absolute for Sigmoid and Tanh). Returns the number of nodes switched.
+    size_t EnableFastMath();
+
+    // inference with pruned weights: the weights of TimesNodes with at most 'maxDensity' nonzero elements, that nothing
+    // else uses, are stored as sparse matrices, so that the products go to the sparse-by-dense kernels (cuSPARSE on the
+    // GPU) and a saved model stores them sparse as well. Returns the number of weight matrices switched.
+    template <class ElemType>
+    size_t SparsifyTimesWeights(double maxDensity);
+
+    // inference: BatchNormalization nodes whose input is a Convolution or Times by weights (optionally plus a bias) are
+    // replaced by a Plus of that product and a bias, with the running statistics, scale and bias folded into the weights
+    // and the bias. The weights are modified in place, so the network is not meant to be trained further.
+    // Returns the number of nodes folded.
+    template <class ElemType>
+    size_t FoldBatchNormalization();
+
+    // inference: reduces the network to what the output nodes need. Dropout becomes the identity, the values of
+    // subgraphs that only depend on parameters (and of precomputed nodes) become constant parameters, and all nodes and
+    // node groups the output nodes do not depend on, e.g. criteria and labels, are removed. Elementwise fusion is enabled
+    // (it covers e.g. Plus and ReLU following a Times or Convolution). The result can be saved to deploy it; it is not
+    // meant to be trained further.
+    template <class ElemType>
+    void OptimizeForInference();
+
+private:
+    template <class ElemType>
+    bool FoldBatchNormalizationNode(const ComputationNodeBasePtr& batchNormNode);
+
+public:
+
     // -----------------------------------------------------------------------
     // node-group access
     // -----------------------------------------------------------------------
@@ -789,6 +1035,7 @@ public:
         auto result = m_nameToNodeMap.insert(make_pair(node->NodeName(), node));
         if (!result.second)
             RuntimeError("AddNodeToNet: Duplicated name for %ls %ls operation.", node->NodeName().c_str(), node->OperationName().c_str());
+        m_configNameToNodeMap.clear();
         node->SetEnvironment(m_environment);
         return node; // allows e.g. return AddNodeToNet(New...);
     }
@@ -817,13 +1064,24 @@ public:
         auto result = m_nameToNodeMap.insert(make_pair(node->NodeName(), node));
         // if there's already one under this name, it better be node
         // unless user requested 'makeUniqueName', then we will modify the name
-        while (!result.second/*if already there*/ && result.first->second != node)
+        if (!result.second/*if already there*/ && result.first->second != node)
         {
             if (!makeUniqueName || node->NodeName().find_first_of(L".[]") == wstring::npos)
                 RuntimeError("AddNodeToNetIfNotYet: Duplicated name for %ls %ls operation (%d vs. %d).", node->NodeName().c_str(), node->OperationName().c_str(), (int)node->m_uniqueNumericId, (int)result.first->second->m_uniqueNumericId);
-            node->SetName(L"_" + node->NodeName());
-            result = m_nameToNodeMap.insert(make_pair(node->NodeName(), node));
+            // prepend '_' until the name is unique
+            // Macros expanded many times can yield thousands of nodes with the same name, so we remember how many
+            // prefixes are taken instead of trying them all again for each.
+            const wstring name = node->NodeName();
+            auto& numPrefixes = m_numUniqueNamePrefixes[name];
+            do
+            {
+                numPrefixes++;
+                node->SetName(wstring(numPrefixes, L'_') + name);
+                result = m_nameToNodeMap.insert(make_pair(node->NodeName(), node));
+            } while (!result.second && result.first->second != node);
         }
+        if (result.second)
+            m_configNameToNodeMap.clear();
         node->SetEnvironment(m_environment); // (note: redundant if already part of the network)
         return result.second;
     }
@@ -836,6 +1094,8 @@ public:
     {
         node->SetEnvironment(nullptr);
         m_nameToNodeMap.erase(node->NodeName());
+        m_numUniqueNamePrefixes.clear(); // names may have become available again
+        m_configNameToNodeMap.clear();
         return node;
     }
 public:
@@ -1039,6 +1299,9 @@ protected:
         virtual void ReleaseMatricesAfterBackprop(MatrixPool& matrixPool);
         virtual bool IsOutOfDateWrtInputs() const override;
 
+        // one iteration of ForwardProp(), between BeginForwardProp() and EndForwardProp()
+        void ForwardPropTimeStep(const FrameRange& t);
+
     public:
         ComputationNodeBasePtr m_sourceNode; // one of the nodes of the loop   --TODO: What is the special meaning of this node? It seems to always be a delay node.
         int m_loopId;                        // unique loop id, index in m_allSEQNodes array
@@ -1050,6 +1313,20 @@ protected:
         {
             SetNodeName(L"Loop_" + m_sourceNode->NodeName());
         }
+
+        // elementwise fusion: [last node] -> chain, and the other nodes of all chains, which are skipped in each
+        // time step while inferring. Chains of other loops or outside of loops are ignored.
+        void SetFusedElementwiseChains(const std::map<ComputationNodeBasePtr, std::shared_ptr<IFusedElementwiseChain>>& chains, const std::set<ComputationNodeBasePtr>& fusedNodes)
+        {
+            m_fusedElementwiseChains = chains;
+            m_fusedElementwiseNodes = fusedNodes;
+        }
+
+    private:
+        std::map<ComputationNodeBasePtr, std::shared_ptr<IFusedElementwiseChain>> m_fusedElementwiseChains;
+        std::set<ComputationNodeBasePtr> m_fusedElementwiseNodes;
+        std::vector<IFusedElementwiseChain*> m_fusedChainOfNestedNode; // [nested node] -> the chain it ends, for this ForwardProp()
+        std::vector<bool> m_isFusedNestedNode;                          // [nested node] -> computed by a later node of its chain
     };
 
     // -----------------------------------------------------------------------
@@ -1102,6 +1379,65 @@ protected:
         // There is currently no other constructor for inner nested PAR-traversed sub-networks, but there will be.
         PARTraversalFlowControlNode(const std::vector<shared_ptr<SEQTraversalFlowControlNode>>& recurrentInfo, const std::list<ComputationNodeBasePtr>& allNodes);
         // Base::m_nestedNodes contains all top-level nodes, in evaluation order
+
+        // activation checkpointing: [nested node] -> nodes whose values are recomputed (in this order) right before its Backprop()
+        void SetRecomputationPlan(std::map<ComputationNodeBasePtr, std::vector<ComputationNodeBasePtr>>&& recomputeBeforeBackprop)
+        {
+            m_recomputeBeforeBackprop = std::move(recomputeBeforeBackprop);
+        }
+
+        // activation offloading: copies of values to host memory and back, scheduled around the nested nodes
+        void SetActivationOffloader(const std::shared_ptr<ActivationOffloader>& offloader)
+        {
+            m_activationOffloader = offloader;
+        }
+
+        // elementwise fusion: [last node] -> chain, and the other nodes of all chains, which are skipped while inferring
+        void SetFusedElementwiseChains(const std::map<ComputationNodeBasePtr, std::shared_ptr<IFusedElementwiseChain>>& chains, const std::set<ComputationNodeBasePtr>& fusedNodes)
+        {
+            m_fusedElementwiseChains = chains;
+            m_fusedElementwiseNodes = fusedNodes;
+        }
+
+        // pipeline parallelism: the stage of each nested node (of the nodes of a loop), see CreatePipelined()
+        void SetPipelineStages(const std::unordered_map<ComputationNodeBasePtr, size_t>& stages);
+        // the nested nodes of one stage: forward prop again with the same inputs (not the leaves and precomputed nodes,
+        // which are not recomputed), and backprop
+        void ForwardPropPipelineStage(const FrameRange& fr, size_t stage);
+        void BackpropPipelineStage(const FrameRange& fr, size_t stage);
+
+        // concurrent branches: group the nested nodes into levels whose nodes can be computed concurrently, and stacked
+        // loops into wavefronts. 'poolMatrices' are the matrices other than gradients that each node got from the matrix pool.
+        void PlanConcurrentLevels(const std::map<std::wstring, std::set<const MatrixBase*>>& poolMatrices);
+        void ClearConcurrentLevels()
+        {
+            m_concurrentUnits.clear();
+            m_concurrentLevels.clear();
+        }
+
+    private:
+        // consecutive nested nodes that are scheduled together: one nested node, or a wavefront of stacked loops, where
+        // each stage is a loop, preceded by the nodes between it and the previous loop. Stage i computes time step
+        // t while stage i-1 computes t+1.
+        struct ConcurrentUnit
+        {
+            size_t m_begin, m_end;             // range of m_nestedNodes
+            std::vector<size_t> m_stageBegins; // wavefront: first nested node of each stage; empty for a single nested node
+        };
+
+        void ForwardPropNestedNode(const ComputationNodeBasePtr& node, const FrameRange& fr, ComputationNodeProfiler* profiler);
+        void BackpropNestedNode(const ComputationNodeBasePtr& node, const FrameRange& fr, ComputationNodeProfiler* profiler);
+        void ForwardPropUnit(const ConcurrentUnit& unit, const FrameRange& fr);
+        void ForwardPropWavefront(const ConcurrentUnit& unit);
+        std::vector<ConcurrentUnit> FindWavefronts(const std::vector<std::set<const MatrixBase*>>& writes) const;
+
+        std::vector<ConcurrentUnit> m_concurrentUnits;       // covering m_nestedNodes in order
+        std::vector<std::vector<size_t>> m_concurrentLevels; // [level] -> indices into m_concurrentUnits; empty: sequential
+        std::map<ComputationNodeBasePtr, std::vector<ComputationNodeBasePtr>> m_recomputeBeforeBackprop;
+        std::shared_ptr<ActivationOffloader> m_activationOffloader;
+        std::map<ComputationNodeBasePtr, std::shared_ptr<IFusedElementwiseChain>> m_fusedElementwiseChains;
+        std::set<ComputationNodeBasePtr> m_fusedElementwiseNodes;
+        std::vector<size_t> m_nestedNodeStages; // [index into m_nestedNodes] -> pipeline stage; empty if not pipelined
     };
 
 public:
@@ -1124,6 +1460,8 @@ private:
 
     // main node holder
     std::map<const std::wstring, ComputationNodeBasePtr, nocase_compare> m_nameToNodeMap; // [name] -> node; this is the main container that holds this networks' nodes
+    std::map<const std::wstring, size_t, nocase_compare> m_numUniqueNamePrefixes;          // [name] -> number of '_' prefixes taken, see AddNodeToNetIfNotYet()
+    mutable std::map<std::wstring, ComputationNodeBasePtr> m_configNameToNodeMap;         // [name with '.' replaced by '_'] -> node, built on demand by LazyCreateConfigMember()
 
     // node groups
     // These are specified by the user by means of tags or explicitly listing the node groups.
@@ -1162,9 +1500,58 @@ private:
     // cache for evaluation ordering:
     bool m_isCompiled; // CompileNetwork has been called
     bool m_areMatricesAllocated; // AllocateAllMatrices has been called
+    bool m_isSnapshotForSaving;  // made by CreateSnapshotForSaving(): can be saved without being compiled
+
+    // activation checkpointing, see SetActivationCheckpoints()
+    size_t m_activationCheckpointInterval;
+    std::vector<std::wstring> m_activationCheckpointNodeNames;
+
+    // activation offloading, see SetActivationOffloading()
+    size_t m_activationOffloadMinSampleSize;
+    std::vector<std::wstring> m_activationOffloadNodeNames;
+    std::shared_ptr<ActivationOffloader> m_activationOffloader; // planned by AllocateAllMatrices()
+
+    // see EnableParameterGradientAccumulation()
+    bool m_parameterGradientAccumulation;
+
+    // model parallelism, see ShardParameterRows()
+    struct RowShardedParameter
+    {
+        ComputationNodeBasePtr m_node;
+        size_t m_numFullRows;
+        MatrixBasePtr m_shard; // while GatherRowShardedParameters() has replaced it on the main worker
+    };
+    std::vector<RowShardedParameter> m_rowShardedParameters; // in the same order on all workers
+    std::shared_ptr<MPIWrapper> m_rowShardingMPI;
+
+    // pipeline parallelism, see CreatePipelined()
+    std::vector<DEVICEID_TYPE> m_pipelineDeviceIds;                      // [stage]; empty if not pipelined
+    std::unordered_map<ComputationNodeBasePtr, size_t> m_pipelineStages; // [node] -> stage; a transfer belongs to the stage of its input
+    std::vector<ComputationNodeBasePtr> m_pipelineTransferNodes;
+    std::map<std::wstring, DEVICEID_TYPE> m_nodeDeviceIds;               // [node name] -> device when loaded, if not m_deviceId
+
+    // elementwise fusion, see EnableElementwiseFusion()
+    bool m_elementwiseFusion;
+    std::map<ComputationNodeBasePtr, std::shared_ptr<IFusedElementwiseChain>> m_fusedElementwiseChains; // [last node of a chain] -> chain
+    std::set<ComputationNodeBasePtr> m_fusedElementwiseNodes;                                            // the other nodes of all chains
+
+    // see EnableInPlaceExecution()
+    bool m_inPlaceExecution;
+
+    // concatenation elimination and transpose absorption, see EnableRowStackElimination() and EnableTransposeAbsorption()
+    bool m_rowStackElimination;
+    bool m_transposeAbsorption;
+    std::map<ComputationNodeBasePtr, ComputationNodeBasePtr> m_elidedInputs; // [Times node] -> its elided RowStack or TransposeDimensions input
+
+    // concurrent branches, see EnableConcurrentBranches()
+    bool m_concurrentBranches;
+
+    // recorded passes, see EnableGPUGraphReplay()
+    std::shared_ptr<GPUGraphReplay> m_gpuGraphReplay;
 
     // cached network iterations
     std::map<const ComputationNodeBasePtr, std::list<ComputationNodeBasePtr>> m_evalOrders; // [out node] flat depth-first traversal starting from out node
+    std::unordered_map<ComputationNodeBasePtr, size_t> m_globalEvalOrderPositions;          // [node] -> position in m_evalOrders[nullptr], see FormEvalOrder()
     std::map<const ComputationNodeBasePtr, ComputationNodeBasePtr> m_nestedNetworks;        // [out node] network rewritten as recursive traveral, potentially optimized; execution plan
 
     // cached quick-access list for inputs and parameters
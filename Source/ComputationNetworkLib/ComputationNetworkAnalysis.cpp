@@ -45,7 +45,11 @@ void ComputationNetwork::FormRecurrentLoops(const ComputationNodeBasePtr& rootNo
     // initialize the node state owned by us
     // TODO: Verify that the other call to this function is unecessary, then inline this function here.
     for (auto& node : nodes)
+    {
         node->PurgeStateForFormingRecurrentLoops();
+        if (m_allSEQNodes.empty()) // a fresh analysis: clear what a previous compilation left, so that FindInRecurrentLoops() can rely on it
+            node->m_isPartOfLoop = false;
+    }
 
     // determine the strongly connected cliques -> m_allSEQNodes[]
     DetermineSCCs(rootNode);
@@ -100,11 +104,13 @@ void ComputationNetwork::FormRecurrentLoops(const ComputationNodeBasePtr& rootNo
 
         // set m_numNonDelayedParentsInLoop to all nodes that are part of this loop and have a non-delay-node parent
         // This value is only used in this current block.
+#ifdef _DEBUG
         for (let& node : nodes) // reset it
         {
             if (node->m_loopId == iter->m_loopId)
                 assert(node->m_numNonDelayedParentsInLoop == 0); // (in PurgeStateForFormingRecurrentLoops())
         }
+#endif
         for (let& node : nestedNodes)
         {
             for (auto& input : node->GetInputs())
@@ -138,27 +144,12 @@ void ComputationNetwork::FormRecurrentLoops(const ComputationNodeBasePtr& rootNo
     // TODO: This should go away, and be done locally in PAR constructor, no need to modify global eval order  --TODO: ...or is it? What are global eval orders used for besides this?
     if (m_allSEQNodes.size() > 0)
     {
-        unordered_set<ComputationNodeBasePtr> visited;
-
-        // get set of all nodes in and outside loops hanging off rootNode
-        map<int, list<ComputationNodeBasePtr>> recurrentNodes;
-        list<ComputationNodeBasePtr> noRecurrentNodes;
-#if 1 // will soon no longer be allowed
-        if (rootNode)
-            GatherLoopNodesR(rootNode, visited, recurrentNodes, noRecurrentNodes);
-        else
-#endif
-        {
-            for (const auto& rootNode2 : m_allRoots)
-                GatherLoopNodesR(rootNode2, visited, recurrentNodes, noRecurrentNodes);
-        }
-
         auto reorderedNodes = nodes;
 
         // first sort by the updated m_visitedOrder, which is identical for all nodes in a loop
         reorderedNodes.sort([](const ComputationNodeBasePtr& lhs, const ComputationNodeBasePtr& rhs) { return lhs->m_visitedOrder < rhs->m_visitedOrder; });
 
-        ReorderLoops(reorderedNodes, recurrentNodes, noRecurrentNodes); // group nodes in loops together
+        ReorderLoops(reorderedNodes); // group nodes in loops together
 
         UpdateEvalOrder(rootNode, reorderedNodes); // TODO: Get rid of this after-the-fact patch.
     }
@@ -223,51 +214,80 @@ void ComputationNetwork::DetermineSCCs(const ComputationNodeBasePtr& rootNode)
             DetermineSCCsR(rootNode2, sccStack, index, loopId);
 }
 
-// (recursive part of DetermineSCCs())
+// (depth-first part of DetermineSCCs())
+// This is Tarjan's recursion, with an explicit stack of [node, index of its next input to visit], since unrolled networks
+// can be deeper than the call stack. Nodes are visited and loops are closed in the same order as by the recursion.
 void ComputationNetwork::DetermineSCCsR(ComputationNodeBasePtr cur,
                                         list<ComputationNodeBasePtr>& sccStack,
                                         size_t& index, size_t& loopId)
 {
     assert(!cur->m_visited);
 
-    // set the index (in order of visitation)
-    // Each node is assigned a unique integer m_index, which numbers the nodes consecutively in the order in which they are discovered.
-    cur->m_index = index;    // TODO: can this be used as m_visitedOrder?
-    cur->m_minIndex = index; // also set m_minIndex
-    index++;
-
-    cur->m_visited = true;
-
-    // The nodes are placed on a stack in the order in which they are visited.
-    // When the depth-first search recursively explores a node 'cur' and its descendants,
-    // those nodes are not all necessarily popped from the stack when this recursive call returns.
-    // The crucial invariant property is that a node remains on the stack after exploration if and only if it has a path to some node earlier on the stack.
-    // At the end of the call that explores 'cur' and its descendants, we know whether 'cur' itself has a path to any node earlier on the stack.
-    // If so, the call returns, leaving 'cur' on the stack to preserve the stack invariant.
-    // If not, then 'cur' must be the root of its strongly connected component, which consists of 'cur' together with any later nodes on the stack
-    // (such nodes all have paths back to 'cur' but not to any earlier node,
-    // because if they had paths to earlier nodes then 'cur' would also have paths to earlier nodes which is false).
-    // This entire component is then popped from the stack and returned, again preserving the invariant. [Wikipedia]
-    sccStack.push_back(cur);
-    cur->m_inStack = true;
-
-    // set m_minIndex to min over m_minIndex of children
-    // m_minIndex (lowlink in Tarjan's notation) represents (roughly speaking) the smallest index of any node known to be reachable from 'cur', including 'cur' itself. [Wikipedia]
-    for (let& input : cur->GetInputs())
+    vector<pair<ComputationNodeBasePtr, size_t>> callStack;
+    auto visit = [&](const ComputationNodeBasePtr& node)
+    {
+        // set the index (in order of visitation)
+        // Each node is assigned a unique integer m_index, which numbers the nodes consecutively in the order in which they are discovered.
+        node->m_index = index;    // TODO: can this be used as m_visitedOrder?
+        node->m_minIndex = index; // also set m_minIndex
+        index++;
+
+        node->m_visited = true;
+
+        // The nodes are placed on a stack in the order in which they are visited.
+        // When the depth-first search recursively explores a node 'cur' and its descendants,
+        // those nodes are not all necessarily popped from the stack when this recursive call returns.
+        // The crucial invariant property is that a node remains on the stack after exploration if and only if it has a path to some node earlier on the stack.
+        // At the end of the call that explores 'cur' and its descendants, we know whether 'cur' itself has a path to any node earlier on the stack.
+        // If so, the call returns, leaving 'cur' on the stack to preserve the stack invariant.
+        // If not, then 'cur' must be the root of its strongly connected component, which consists of 'cur' together with any later nodes on the stack
+        // (such nodes all have paths back to 'cur' but not to any earlier node,
+        // because if they had paths to earlier nodes then 'cur' would also have paths to earlier nodes which is false).
+        // This entire component is then popped from the stack and returned, again preserving the invariant. [Wikipedia]
+        sccStack.push_back(node);
+        node->m_inStack = true;
+
+        callStack.push_back(make_pair(node, (size_t)0));
+    };
+
+    visit(cur);
+    while (!callStack.empty())
     {
-        if (!input->m_visited)
+        let node = callStack.back().first;
+        size_t& i = callStack.back().second;
+
+        // set m_minIndex to min over m_minIndex of children
+        // m_minIndex (lowlink in Tarjan's notation) represents (roughly speaking) the smallest index of any node known to be reachable from 'cur', including 'cur' itself. [Wikipedia]
+        if (i < node->GetNumInputs())
         {
-            // successor w has not yet been visited; recurse on it
-            DetermineSCCsR(input, sccStack, index, loopId);
-            cur->m_minIndex = min(cur->m_minIndex, input->m_minIndex);
+            let input = node->Input(i++);
+            if (!input->m_visited)
+            {
+                // successor w has not yet been visited; recurse on it (the min is taken when it is done, below)
+                visit(input);
+            }
+            else if (input->m_inStack)
+            {
+                // successor w is in stack S and hence in the current SCC
+                node->m_minIndex = min(node->m_minIndex, input->m_minIndex);
+            }
+            continue;
         }
-        else if (input->m_inStack)
+
+        // all inputs are done
+        callStack.pop_back();
+        CloseSCC(node, sccStack, loopId);
+        if (!callStack.empty()) // return to the parent
         {
-            // successor w is in stack S and hence in the current SCC
-            cur->m_minIndex = min(cur->m_minIndex, input->m_minIndex);
+            let& parent = callStack.back().first;
+            parent->m_minIndex = min(parent->m_minIndex, node->m_minIndex);
         }
     }
+}
 
+// (part of DetermineSCCsR(), after all inputs of 'cur' have been explored)
+void ComputationNetwork::CloseSCC(const ComputationNodeBasePtr& cur, list<ComputationNodeBasePtr>& sccStack, size_t& loopId)
+{
     // if 'cur' is a root node, then we closed a loop; create an entry in m_allSEQNodes
     // 'cur' must be left on the stack if m_minIndex < m_index,
     // whereas it must be removed as the root of a strongly connected component if m_minIndex == m_index.
@@ -277,7 +297,6 @@ void ComputationNetwork::DetermineSCCsR(ComputationNodeBasePtr cur,
     {
         // gather the list of all nodes in this loop
         vector<ComputationNodeBasePtr> nestedNodes;
-        SEQTraversalFlowControlNode rInfo(m_allSEQNodes.size() /*loopId*/, cur);
         for (;;)
         {
             ComputationNodeBasePtr node = sccStack.back();
@@ -300,25 +319,17 @@ void ComputationNetwork::DetermineSCCsR(ComputationNodeBasePtr cur,
             //  - the first root takes the first delay node's value, the second root that of the second delay node
             //    I.e. the depth-first tree traversals enter the loop at two different places (m_sourceNode).
             //  -> Are these two loops detected as identical? (determined by m_minIndex, but m_index depends on traversal from each root, so maybe not)
-            bool bFound = false; // find a dup
-            for (let& iter : m_allSEQNodes)
-            {
-                for (let& iter2 : iter->m_nestedNodes)
-            {
-                    if (iter2 == cur)
-                {
-                    bFound = true;
-                        // validate that the loop is really the same, by a set comparison
-                        unordered_set<ComputationNodeBasePtr> newLoop     (        nestedNodes.begin(),         nestedNodes.end());
-                        unordered_set<ComputationNodeBasePtr> existingLoop(iter->m_nestedNodes.begin(), iter->m_nestedNodes.end());
-                        if (newLoop != existingLoop)
-                            LogicError("DetermineSCCsR: %ls %ls operation rediscovered in a loop, but that loop is not the same as last time.", cur->NodeName().c_str(), cur->OperationName().c_str());
-                    break;
-                }
-            }
-            }
+            let existing = FindInRecurrentLoops(m_allSEQNodes, cur); // find a dup
+            bool bFound = existing != nullptr;
             if (bFound)
+            {
+                // validate that the loop is really the same, by a set comparison
+                unordered_set<ComputationNodeBasePtr> newLoop     (            nestedNodes.begin(),             nestedNodes.end());
+                unordered_set<ComputationNodeBasePtr> existingLoop(existing->m_nestedNodes.begin(), existing->m_nestedNodes.end());
+                if (newLoop != existingLoop)
+                    LogicError("DetermineSCCsR: %ls %ls operation rediscovered in a loop, but that loop is not the same as last time.", cur->NodeName().c_str(), cur->OperationName().c_str());
                 fprintf(stderr, "\nDetermineSCCsR: %ls %ls operation was discovered multiple times as as loop participant", cur->NodeName().c_str(), cur->OperationName().c_str());
+            }
             // TODO: Once we forbid FormRecurrentLoops() from non-NULL, can we ever re-hit a loop here? If not, then turn bFound into a LogicError().
             if (!bFound)
             {
@@ -379,37 +390,13 @@ void ComputationNetwork::DetermineLoopForwardOrderR(unordered_set<ComputationNod
         LogicError("%ls %ls operation is part of an infinite loop that cannot be unrolled.", cur->NodeName().c_str(), cur->OperationName().c_str());
 }
 
-// traverse sub-graph feeding this node (which is a top-level node at start, e.g. training criterion) and list
-//  - all nodes that participate in a loop -> recurrentResult[loopId][]
-//  - all nodes that don't                 -> noRecurrentResult[]
-// in order of traversal (depth-first).
-// This is part of the FormRecurrentLoops() process, and only called from there from one place.
-void ComputationNetwork::GatherLoopNodesR(const ComputationNodeBasePtr& node, unordered_set<ComputationNodeBasePtr>& visited,
-                                          map<int, list<ComputationNodeBasePtr>>& recurrentResult,
-                                          list<ComputationNodeBasePtr>& noRecurrentResult)
-{
-    if (visited.find(node) != visited.end())
-        return; // do each node only once
-    visited.insert(node);
-
-    for (int i = 0; i < node->GetNumInputs(); i++)
-        GatherLoopNodesR(node->Input(i), visited, recurrentResult, noRecurrentResult);
-
-    if (node->m_loopId >= 0)
-        recurrentResult[node->m_loopId].push_back(node);
-    else
-        noRecurrentResult.push_back(node);
-}
-
 // takes a list of nodes and modifies it such that all nodes of the same loop are consecutive
 //  - 'nodes' is in some traversal order
 //  - that order is preserved for all nodes outside loops
 //  - each node that belongs to a loop is replaced by all nodes of that loop in loop order
 //    TODO: But where? Start? End?
 // Called only from FormRecurrentLoops().
-void ComputationNetwork::ReorderLoops(list<ComputationNodeBasePtr>& nodes,
-                                      const map<int, list<ComputationNodeBasePtr>>& /*recurrentNodes*/,
-                                      const list<ComputationNodeBasePtr>& /*noRecurrentNodes*/)
+void ComputationNetwork::ReorderLoops(list<ComputationNodeBasePtr>& nodes)
 {
     list<ComputationNodeBasePtr> newList;
 
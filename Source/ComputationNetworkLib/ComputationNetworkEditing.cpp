@@ -103,6 +103,103 @@ void ComputationNetwork::CopyInputs(const std::wstring fromName, std::wstring to
     CopyNode(*this, fromName, toName, CopyNodeFlags::copyNodeInputLinks);
 }
 
+// create a copy of the network that shares the values of all LearnableParameters with this one, for inference
+// Each copy has its own nodes, and thus its own activation matrices, MBLayouts and evaluation state, so that copies
+// can be evaluated concurrently as long as nobody modifies the parameters.
+ComputationNetworkPtr ComputationNetwork::CloneSharingParameters() const
+{
+    auto net = make_shared<ComputationNetwork>(GetDeviceId());
+    net->SetTraceLevel(TraceLevel());
+    net->m_elementwiseFusion = m_elementwiseFusion;
+    net->m_inPlaceExecution = m_inPlaceExecution;
+    net->m_rowStackElimination = m_rowStackElimination;
+    net->m_transposeAbsorption = m_transposeAbsorption;
+    net->m_concurrentBranches = m_concurrentBranches;
+    net->EnableGPUGraphReplay(m_gpuGraphReplay != nullptr);
+
+    map<ComputationNodeBasePtr, ComputationNodeBasePtr> clones;
+    for (const auto& iter : m_nameToNodeMap)
+    {
+        const auto& node = iter.second;
+        bool isParameter = node->OperationName() == OperationNameOf(LearnableParameter);
+        auto clone = node->Duplicate(node->NodeName(), isParameter ? (CopyNodeFlags)(CopyNodeFlags::copyNodeAll | CopyNodeFlags::copyNodeShareValue) : CopyNodeFlags::copyNodeAll);
+        clones[node] = clone;
+        net->AddNodeToNet(clone);
+    }
+    for (const auto& iter : clones)
+    {
+        for (size_t i = 0; i < iter.first->GetNumInputs(); i++)
+        {
+            const auto& input = iter.first->GetInputs()[i];
+            iter.second->SetInput(i, input ? clones.at(input) : nullptr);
+        }
+    }
+
+    auto groups = const_cast<ComputationNetwork&>(*this).GetAllNodeGroups();
+    auto newGroups = net->GetAllNodeGroups();
+    for (size_t k = 0; k < groups.size(); k++)
+    {
+        for (const auto& node : *groups[k])
+            newGroups[k]->push_back(clones.at(node));
+    }
+
+    net->CompileNetwork();
+    return net;
+}
+
+template <class ElemType>
+static bool TryMoveSnapshotValueToCPU(const ComputationNodeBasePtr& node, bool keepValue)
+{
+    auto typedNode = dynamic_pointer_cast<ComputationNode<ElemType>>(node);
+    if (!typedNode)
+        return false;
+    auto& value = typedNode->ValuePtrRef();
+    if (keepValue && value)
+        value = make_shared<Matrix<ElemType>>(value->DeepCloneToCPU());
+    else
+        value = nullptr;
+    return true;
+}
+
+// create a copy of the network that holds CPU copies of the values that Save() writes (LearnableParameters and
+// PreCompute nodes), and no other matrices, for saving it on another thread while this one keeps training
+// The snapshot is not compiled and can only be saved.
+ComputationNetworkPtr ComputationNetwork::CreateSnapshotForSaving() const
+{
+    auto net = make_shared<ComputationNetwork>(GetDeviceId());
+    net->SetTraceLevel(TraceLevel());
+    net->m_isSnapshotForSaving = true;
+
+    map<ComputationNodeBasePtr, ComputationNodeBasePtr> clones;
+    for (const auto& iter : m_nameToNodeMap)
+    {
+        const auto& node = iter.second;
+        auto clone = node->Duplicate(node->NodeName(), (CopyNodeFlags)(CopyNodeFlags::copyNodeAll | CopyNodeFlags::copyNodeShareValue));
+        bool keepValue = node->OperationName() == OperationNameOf(LearnableParameter) || dynamic_pointer_cast<IPreComputeNode>(node);
+        if (!TryMoveSnapshotValueToCPU<float>(clone, keepValue) && !TryMoveSnapshotValueToCPU<double>(clone, keepValue))
+            LogicError("CreateSnapshotForSaving: Unexpected node type.");
+        clones[node] = clone;
+        net->AddNodeToNet(clone);
+    }
+    for (const auto& iter : clones)
+    {
+        for (size_t i = 0; i < iter.first->GetNumInputs(); i++)
+        {
+            const auto& input = iter.first->GetInputs()[i];
+            iter.second->SetInput(i, input ? clones.at(input) : nullptr);
+        }
+    }
+
+    auto groups = const_cast<ComputationNetwork&>(*this).GetAllNodeGroups();
+    auto newGroups = net->GetAllNodeGroups();
+    for (size_t k = 0; k < groups.size(); k++)
+    {
+        for (const auto& node : *groups[k])
+            newGroups[k]->push_back(clones.at(node));
+    }
+    return net;
+}
+
 // RenameNode - Rename a node to another name
 // nodeNameOrig - original node name
 // nodeNameNew - new node name
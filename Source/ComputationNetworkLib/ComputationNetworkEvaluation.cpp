@@ -11,6 +11,12 @@
 #include "RecurrentNodes.h"
 #include "InputAndParamNodes.h"
 #include "LinearAlgebraNodes.h"
+#include "ReshapingNodes.h"
+#include "fileutil.h"
+#include "TimelineTracer.h"
+#include "ComputationNodeProfiler.h"
+#include "MatrixTransitionTracker.h"
+#include "CPUThreadPool.h"
 #include <string>
 #include <vector>
 #include <list>
@@ -41,20 +47,24 @@ void ComputationNetwork::ForwardProp(const ComputationNodeBasePtr rootNode)
     VerifyIsCompiled("ForwardProp");
 
     // traverse all nodes in the pre-determined evaluation order
-    GetNestedNetwork(rootNode)->ForwardProp(FrameRange(nullptr));
+    auto run = [&]() { GetNestedNetwork(rootNode)->ForwardProp(FrameRange(nullptr)); };
+    if (CanReplayGPUGraphs())
+        m_gpuGraphReplay->ForwardProp(rootNode, GetEvalOrder(rootNode), run);
+    else
+        run();
 }
 
-// set the gradient matrix of a (root) node 1.0
+// set the gradient matrix of a (root) node to a scalar, usually 1.0
 // Returns false if the node is not a ComputationNode<ElemType>; see Backprop() below for intended use.
 template <class ElemType>
-static bool SetRootGradientToScalarOne(ComputationNodeBasePtr nodep)
+static bool SetRootGradientToScalar(ComputationNodeBasePtr nodep, double value)
 {
     auto node = dynamic_pointer_cast<ComputationNode<ElemType>>(nodep);
     bool hasMatchingType = (node != nullptr);
     if (hasMatchingType)
     {
-        // reset the root gradient to 1
-        node->ResetGradient(1);
+        // reset the root gradient to the value
+        node->ResetGradient((ElemType) value);
     }
     return hasMatchingType;
 }
@@ -64,20 +74,73 @@ static bool SetRootGradientToScalarOne(ComputationNodeBasePtr nodep)
 //  - ForwardProp() for eval nodes
 //  - ForwardProp() for the training criterion (which will reuse computation results from the previous step)
 //  - Backprop() for the training criterion
-void ComputationNetwork::Backprop(const ComputationNodeBasePtr rootNode) // training criterion to compute the gradients for
+void ComputationNetwork::Backprop(const ComputationNodeBasePtr rootNode, double rootGradient, bool accumulateParameterGradients) // training criterion to compute the gradients for
 {
     if (!Environment().IsTraining())
         LogicError("Backprop: Requires network is to be in training mode.");
+    if (accumulateParameterGradients && !m_parameterGradientAccumulation)
+        LogicError("Backprop: Accumulating parameter gradients requires EnableParameterGradientAccumulation().");
+
+    auto run = [&]()
+    {
+        // initialize root gradient with a scalar value of 1.0 (or the loss scale)
+        if (!SetRootGradientToScalar<float>(rootNode, rootGradient) && !SetRootGradientToScalar<double>(rootNode, rootGradient))
+            LogicError("Backprop: Training criterion is neither ComputationNode<float> nor ComputationNode<double>.");
 
-    // initialize root gradient with a scalar value of 1.0
-    if (!SetRootGradientToScalarOne<float>(rootNode) && !SetRootGradientToScalarOne<double>(rootNode))
-        LogicError("Backprop: Training criterion is neither ComputationNode<float> nor ComputationNode<double>.");
+        // when accumulating, the parameter gradients left by the previous Backprop() are kept and added to
+        std::vector<ComputationNodeBasePtr> keptGradients;
+        if (accumulateParameterGradients)
+        {
+            for (auto& node : GetAllNodesForRoot(rootNode))
+                if (node->OperationName() == OperationNameOf(LearnableParameter) && node->IsGradientInitialized())
+                    keptGradients.push_back(node);
+        }
 
-    // reset all gradients below rootNode to zero (actually, internally, this is lazy, but we don't care here)
-    ZeroInputGradients(rootNode);
+        // reset all gradients below rootNode to zero (actually, internally, this is lazy, but we don't care here)
+        ZeroInputGradients(rootNode);
+        for (auto& node : keptGradients)
+            node->KeepGradient();
+
+        // backpropagate through the network
+        GetNestedNetwork(rootNode)->Backprop(FrameRange(nullptr), true, true);
+    };
+    // (a gradient callback must see the gradients one by one; a recorded graph resets the parameter gradients)
+    if (CanReplayGPUGraphs() && !Environment().gradientComputedCallback && !accumulateParameterGradients)
+        m_gpuGraphReplay->Backprop(rootNode, GetEvalOrder(rootNode), rootGradient, run);
+    else
+        run();
+}
 
-    // backpropagate through the network
-    GetNestedNetwork(rootNode)->Backprop(FrameRange(nullptr), true, true);
+// pipeline parallelism, see CreatePipelined(); the stages are on different GPUs, so these return as soon as the
+// stage's work is queued on its GPU
+void ComputationNetwork::ForwardPropPipelineStage(const ComputationNodeBasePtr& rootNode, size_t stage)
+{
+    VerifyIsCompiled("ForwardPropPipelineStage");
+    dynamic_pointer_cast<PARTraversalFlowControlNode>(GetNestedNetwork(rootNode))->ForwardPropPipelineStage(FrameRange(nullptr), stage);
+}
+
+void ComputationNetwork::BackpropPipelineStage(const ComputationNodeBasePtr& rootNode, size_t stage, double rootGradient)
+{
+    if (!Environment().IsTraining())
+        LogicError("BackpropPipelineStage: Requires network is to be in training mode.");
+    if (stage >= GetNumPipelineStages())
+        LogicError("BackpropPipelineStage: Stage %d does not exist.", (int) stage);
+
+    if (stage + 1 == GetNumPipelineStages())
+    {
+        if (!SetRootGradientToScalar<float>(rootNode, rootGradient) && !SetRootGradientToScalar<double>(rootNode, rootGradient))
+            LogicError("BackpropPipelineStage: Training criterion is neither ComputationNode<float> nor ComputationNode<double>.");
+        ZeroInputGradients(rootNode);
+    }
+    dynamic_pointer_cast<PARTraversalFlowControlNode>(GetNestedNetwork(rootNode))->BackpropPipelineStage(FrameRange(nullptr), stage);
+}
+
+// whether passes go through GPUGraphReplay; not while profiling or tracing, which look at the nodes one by one, nor
+// with activation offloading, row-sharded parameters or pipeline stages, whose copies and exchanges are run by the host
+// between the nodes
+bool ComputationNetwork::CanReplayGPUGraphs() const
+{
+    return m_gpuGraphReplay && !m_activationOffloader && !m_rowShardingMPI && m_pipelineDeviceIds.empty() && !Environment().nodeProfiler && !Environment().IsLogLevelNodeTrace();
 }
 
 void ComputationNetwork::FormNestedNetwork(const ComputationNodeBasePtr& rootNode)
@@ -85,7 +148,11 @@ void ComputationNetwork::FormNestedNetwork(const ComputationNodeBasePtr& rootNod
     if (m_nestedNetworks.find(rootNode) != m_nestedNetworks.end())
         fprintf(stderr, "FormNestedNetwork: WARNING: Was called twice for %ls %ls operation\n", rootNode->NodeName().c_str(), rootNode->OperationName().c_str());
 
-    m_nestedNetworks[rootNode] = make_shared<PARTraversalFlowControlNode>(m_allSEQNodes, GetEvalOrder(rootNode));
+    auto nestedNetwork = make_shared<PARTraversalFlowControlNode>(m_allSEQNodes, GetEvalOrder(rootNode));
+    nestedNetwork->SetEnvironment(m_environment); // gives it the node profiler
+    if (IsPipelined())
+        nestedNetwork->SetPipelineStages(m_pipelineStages);
+    m_nestedNetworks[rootNode] = nestedNetwork;
 }
 
 ComputationNodeBasePtr ComputationNetwork::GetNestedNetwork(const ComputationNodeBasePtr& rootNode)
@@ -134,41 +201,451 @@ ComputationNetwork::PARTraversalFlowControlNode::PARTraversalFlowControlNode(con
 }
 /*virtual*/ void ComputationNetwork::PARTraversalFlowControlNode::ForwardProp(const FrameRange& fr) /*override*/
 {
+    ComputationNodeProfiler* profiler = HasEnvironmentPtr() ? Environment().nodeProfiler.get() : nullptr;
+
+    // concurrent branches, see PlanConcurrentLevels(); not while profiling or tracing, which expect one node at a time
+    if (!m_concurrentLevels.empty() && HasEnvironmentPtr() && Environment().IsInferring() && !profiler && !Environment().IsLogLevelNodeTrace())
+    {
+        for (const auto& level : m_concurrentLevels)
+        {
+            if (level.size() == 1) // on this thread, so that the node's own parallel loops use all threads
+                ForwardPropUnit(m_concurrentUnits[level.front()], fr);
+            else
+                CPUThreadPool::Instance().ParallelFor(level.size(), 1, [&](size_t begin, size_t end)
+                {
+                    for (size_t i = begin; i < end; i++)
+                        ForwardPropUnit(m_concurrentUnits[level[i]], fr);
+                });
+        }
+        return;
+    }
+
+    // activation offloading, see ActivationOffloader; a forward pass that is not followed by backprop keeps its values
+    bool offload = m_activationOffloader && HasEnvironmentPtr() && Environment().IsTraining();
+
     for (auto& node : m_nestedNodes)
     {
 #if 0
         if (dynamic_pointer_cast<LearnableParameter<float>>(node))
             dynamic_pointer_cast<ComputationNode<float>>(node)->DebugLogMinibatch();
 #endif
+        if (offload)
+            m_activationOffloader->BeforeForwardProp(node);
+        ForwardPropNestedNode(node, fr, profiler);
+        if (offload)
+            m_activationOffloader->AfterForwardProp(node);
+
+        // Extreme Tracing, part 1/4
+        if (node->HasEnvironmentPtr() && node->Environment().IsLogLevelNodeTrace())
+            DumpNode<float>(node, /*dumpGradient=*/false) || DumpNode<double>(node, false);
+    }
+}
+
+void ComputationNetwork::PARTraversalFlowControlNode::ForwardPropNestedNode(const ComputationNodeBasePtr& node, const FrameRange& fr, ComputationNodeProfiler* profiler)
+{
+    // elementwise fusion: the values of the other nodes of a chain are computed by its last node, see FuseElementwiseChains()
+    bool fuse = HasEnvironmentPtr() && Environment().IsInferring() && !m_fusedElementwiseChains.empty();
+    if (fuse && m_fusedElementwiseNodes.find(node) != m_fusedElementwiseNodes.end())
+    {
         if (node->IsOutOfDateWrtInputs())
-        {
-            node->BeginForwardProp();
+            node->BumpEvalTimeStamp();
+        return;
+    }
+    auto fusedChain = fuse ? m_fusedElementwiseChains.find(node) : m_fusedElementwiseChains.end();
+
+    if (node->IsOutOfDateWrtInputs())
+    {
+        TimelineEvent event("ForwardProp", node->NodeName(), node->GetDeviceId());
+        ComputationNodeProfiler::Scope profile(profiler, node, /*forward=*/true);
+        MatrixTransitionScope transitions("ForwardProp", node);
+        node->BeginForwardProp();
+        if (fusedChain != m_fusedElementwiseChains.end())
+            fusedChain->second->ForwardProp(fr.WithLayout(node->GetMBLayout()));
+        else
             node->ForwardProp(fr.WithLayout(node->GetMBLayout()));
-            node->EndForwardProp();
+        node->EndForwardProp();
 
-            node->BumpEvalTimeStamp();
+        node->BumpEvalTimeStamp();
+    }
+}
+
+void ComputationNetwork::PARTraversalFlowControlNode::ForwardPropUnit(const ConcurrentUnit& unit, const FrameRange& fr)
+{
+    if (unit.m_stageBegins.empty())
+    {
+        ForwardPropNestedNode(m_nestedNodes[unit.m_begin], fr, nullptr);
+        return;
+    }
+
+    bool isOutOfDate = false;
+    for (size_t k = unit.m_begin; k < unit.m_end; k++)
+        isOutOfDate = isOutOfDate || m_nestedNodes[k]->IsOutOfDateWrtInputs();
+    if (!isOutOfDate)
+        return;
+
+    // leaves are computed as usual; the nodes in between the loops and the loops are computed by time step
+    vector<ComputationNodeBasePtr> stepNodes;
+    for (size_t k = unit.m_begin; k < unit.m_end; k++)
+    {
+        if (m_nestedNodes[k]->IsLeaf())
+            ForwardPropNestedNode(m_nestedNodes[k], fr, nullptr);
+        else
+            stepNodes.push_back(m_nestedNodes[k]);
+    }
+    for (auto& node : stepNodes)
+        node->BeginForwardProp();
+    ForwardPropWavefront(unit);
+    for (auto& node : stepNodes)
+    {
+        node->EndForwardProp();
+        node->BumpEvalTimeStamp();
+    }
+}
+
+// stage i computes time step s - i, in the loops' direction, so that each stage sees the steps of the stages before
+// it that it depends on, and its own earlier steps
+void ComputationNetwork::PARTraversalFlowControlNode::ForwardPropWavefront(const ConcurrentUnit& unit)
+{
+    auto loop = dynamic_pointer_cast<SEQTraversalFlowControlNode>(m_nestedNodes[unit.m_begin]);
+    const auto& pMBLayout = loop->GetMBLayout();
+    size_t numTimeSteps = pMBLayout->GetNumTimeSteps();
+    size_t numStages = unit.m_stageBegins.size();
+    if (numTimeSteps == 0)
+        return;
+
+    bool fuse = !m_fusedElementwiseChains.empty(); // (only while inferring)
+    auto forwardPropStage = [&](size_t stage, size_t step)
+    {
+        FrameRange t(pMBLayout, loop->m_steppingDirection > 0 ? step : numTimeSteps - 1 - step);
+        size_t end = stage + 1 < numStages ? unit.m_stageBegins[stage + 1] : unit.m_end;
+        for (size_t k = unit.m_stageBegins[stage]; k < end; k++)
+        {
+            const auto& node = m_nestedNodes[k];
+            auto stageLoop = dynamic_pointer_cast<SEQTraversalFlowControlNode>(node);
+            if (stageLoop)
+                stageLoop->ForwardPropTimeStep(t);
+            else if (node->IsLeaf() || (fuse && m_fusedElementwiseNodes.find(node) != m_fusedElementwiseNodes.end()))
+                continue;
+            else
+            {
+                MatrixTransitionScope transitions("ForwardProp", node);
+                auto fusedChain = fuse ? m_fusedElementwiseChains.find(node) : m_fusedElementwiseChains.end();
+                if (fusedChain != m_fusedElementwiseChains.end())
+                    fusedChain->second->ForwardProp(t);
+                else
+                    node->ForwardProp(t);
+            }
         }
+    };
 
-        // Extreme Tracing, part 1/4
-        if (node->HasEnvironmentPtr() && node->Environment().IsLogLevelNodeTrace())
-            DumpNode<float>(node, /*dumpGradient=*/false) || DumpNode<double>(node, false);
+    for (size_t s = 0; s + 1 < numTimeSteps + numStages; s++)
+    {
+        size_t firstStage = s < numTimeSteps ? 0 : s - numTimeSteps + 1;
+        size_t lastStage = min(s, numStages - 1);
+        if (firstStage == lastStage)
+            forwardPropStage(firstStage, s - firstStage);
+        else
+            CPUThreadPool::Instance().ParallelFor(lastStage - firstStage + 1, 1, [&](size_t begin, size_t end)
+            {
+                for (size_t stage = firstStage + begin; stage < firstStage + end; stage++)
+                    forwardPropStage(stage, s - stage);
+            });
     }
 }
+
+// a node whose value at a time step depends only on its inputs at that time step, so that it can be computed step by step
+static bool IsComputableByTimeStep(const ComputationNodeBasePtr& node)
+{
+    return node->ForwardElementwiseOp() != opNone || node->OperationName() == OperationNameOf(TimesNode);
+}
+
+// A nested node (a node or a loop) must come after the nested nodes that compute its inputs, and, for each matrix,
+// after the last one that wrote it if it uses it, and after all that used it since then if it writes it. A node
+// writes its value and the other non-gradient matrices it got from the pool, and reads the values of its inputs.
+// Stacked loops are first combined into wavefronts (see FindWavefronts()), which are then scheduled like one nested
+// node. Each unit goes into the level after the highest level of those it must come after, so that the units of a
+// level can be computed in any order, or concurrently.
+void ComputationNetwork::PARTraversalFlowControlNode::PlanConcurrentLevels(const std::map<std::wstring, std::set<const MatrixBase*>>& poolMatrices)
+{
+    ClearConcurrentLevels();
+
+    vector<std::set<const MatrixBase*>> readsOf(m_nestedNodes.size()), writesOf(m_nestedNodes.size());
+    for (size_t k = 0; k < m_nestedNodes.size(); k++)
+    {
+        auto loop = dynamic_pointer_cast<SEQTraversalFlowControlNode>(m_nestedNodes[k]);
+        for (const auto& node : loop ? loop->m_nestedNodes : vector<ComputationNodeBasePtr>{ m_nestedNodes[k] })
+        {
+            writesOf[k].insert(node->ValuePtr().get());
+            auto pool = poolMatrices.find(node->NodeName());
+            if (pool != poolMatrices.end())
+                writesOf[k].insert(pool->second.begin(), pool->second.end());
+            for (const auto& input : node->GetInputs())
+                if (input)
+                    readsOf[k].insert(input->ValuePtr().get());
+        }
+        readsOf[k].erase(nullptr);
+        writesOf[k].erase(nullptr);
+    }
+
+    auto units = FindWavefronts(writesOf);
+    bool hasWavefronts = units.size() < m_nestedNodes.size();
+
+    map<ComputationNodeBasePtr, size_t> unitOf; // [node] -> index of the unit that computes it
+    for (size_t u = 0; u < units.size(); u++)
+    {
+        for (size_t k = units[u].m_begin; k < units[u].m_end; k++)
+        {
+            auto loop = dynamic_pointer_cast<SEQTraversalFlowControlNode>(m_nestedNodes[k]);
+            for (const auto& node : loop ? loop->m_nestedNodes : vector<ComputationNodeBasePtr>{ m_nestedNodes[k] })
+                unitOf[node] = u;
+        }
+    }
+
+    vector<size_t> levelOf(units.size(), 0);
+    auto mustComeAfter = [&levelOf](size_t u, size_t before)
+    {
+        if (before != u)
+            levelOf[u] = max(levelOf[u], levelOf[before] + 1);
+    };
+
+    map<const MatrixBase*, size_t> lastWriter;
+    map<const MatrixBase*, vector<size_t>> readersSinceWrite;
+    size_t numLevels = 0;
+    for (size_t u = 0; u < units.size(); u++)
+    {
+        std::set<const MatrixBase*> reads, writes;
+        for (size_t k = units[u].m_begin; k < units[u].m_end; k++)
+        {
+            reads.insert(readsOf[k].begin(), readsOf[k].end());
+            writes.insert(writesOf[k].begin(), writesOf[k].end());
+            auto loop = dynamic_pointer_cast<SEQTraversalFlowControlNode>(m_nestedNodes[k]);
+            for (const auto& node : loop ? loop->m_nestedNodes : vector<ComputationNodeBasePtr>{ m_nestedNodes[k] })
+            {
+                for (const auto& input : node->GetInputs())
+                {
+                    auto producer = input ? unitOf.find(input) : unitOf.end();
+                    if (producer != unitOf.end())
+                        mustComeAfter(u, producer->second);
+                }
+            }
+        }
+
+        for (auto matrix : reads)
+        {
+            auto writer = lastWriter.find(matrix);
+            if (writer != lastWriter.end())
+                mustComeAfter(u, writer->second);
+            readersSinceWrite[matrix].push_back(u);
+        }
+        for (auto matrix : writes)
+        {
+            auto writer = lastWriter.find(matrix);
+            if (writer != lastWriter.end())
+                mustComeAfter(u, writer->second);
+            for (auto reader : readersSinceWrite[matrix])
+                mustComeAfter(u, reader);
+            lastWriter[matrix] = u;
+            readersSinceWrite[matrix].clear();
+        }
+        numLevels = max(numLevels, levelOf[u] + 1);
+    }
+
+    if (numLevels == units.size() && !hasWavefronts) // a chain: nothing to run concurrently
+        return;
+    m_concurrentUnits = move(units);
+    m_concurrentLevels.resize(numLevels);
+    for (size_t u = 0; u < m_concurrentUnits.size(); u++)
+        m_concurrentLevels[levelOf[u]].push_back(u);
+}
+
+// Stacked recurrent layers: a loop, and consecutive nested nodes after it that end in another loop, where loop 2 only
+// uses values of the loop below it and of the nodes between them at the same time step, can be computed as a
+// wavefront, in which loop 2 computes step t while loop 1 computes step t+1. All of them must have the loop's MBLayout,
+// the loops the same direction, and the nodes in between and those of loop 2 that use them must be computable by time
+// step. As the steps of different nodes interleave, each matrix may be written by one nested node of a wavefront only,
+// and the others may read it only as the value of a node that this one computes, i.e. memory sharing must not have
+// given it to two of them.
+std::vector<ComputationNetwork::PARTraversalFlowControlNode::ConcurrentUnit> ComputationNetwork::PARTraversalFlowControlNode::FindWavefronts(const std::vector<std::set<const MatrixBase*>>& writes) const
+{
+    auto nodesOf = [this](size_t k)
+    {
+        auto loop = dynamic_pointer_cast<SEQTraversalFlowControlNode>(m_nestedNodes[k]);
+        return loop ? loop->m_nestedNodes : vector<ComputationNodeBasePtr>{ m_nestedNodes[k] };
+    };
+    auto isHazardFree = [&](size_t begin, size_t end)
+    {
+        map<const MatrixBase*, size_t> writerOf;
+        map<ComputationNodeBasePtr, size_t> nestedNodeOf;
+        for (size_t k = begin; k < end; k++)
+        {
+            for (auto matrix : writes[k])
+                if (!writerOf.insert(make_pair(matrix, k)).second)
+                    return false;
+            for (const auto& node : nodesOf(k))
+                nestedNodeOf[node] = k;
+        }
+        for (size_t k = begin; k < end; k++)
+        {
+            for (const auto& node : nodesOf(k))
+            {
+                for (const auto& input : node->GetInputs())
+                {
+                    auto writer = input ? writerOf.find(input->ValuePtr().get()) : writerOf.end();
+                    if (writer == writerOf.end() || writer->second == k)
+                        continue;
+                    auto producer = nestedNodeOf.find(input);
+                    if (producer == nestedNodeOf.end() || producer->second != writer->second)
+                        return false;
+                }
+            }
+        }
+        return true;
+    };
+
+    std::vector<ConcurrentUnit> units;
+    for (size_t k = 0; k < m_nestedNodes.size();)
+    {
+        ConcurrentUnit unit = { k, k + 1, {} };
+        auto loop = dynamic_pointer_cast<SEQTraversalFlowControlNode>(m_nestedNodes[k]);
+        if (loop)
+        {
+            std::set<ComputationNodeBasePtr> unitNodes(loop->m_nestedNodes.begin(), loop->m_nestedNodes.end());
+            unit.m_stageBegins.push_back(k);
+            for (size_t stageBegin = k + 1, end = k + 1; end < m_nestedNodes.size(); end++)
+            {
+                // a node between the loops, or the loop that ends the next stage
+                const auto& nestedNode = m_nestedNodes[end];
+                if (nestedNode->IsLeaf()) // e.g. the weights of the next layer; computed before the first step
+                    continue;
+                auto nextLoop = dynamic_pointer_cast<SEQTraversalFlowControlNode>(nestedNode);
+                if (nestedNode->GetMBLayout() != loop->GetMBLayout() || (nextLoop ? nextLoop->m_steppingDirection != loop->m_steppingDirection : !IsComputableByTimeStep(nestedNode)))
+                    break;
+                auto nodes = nodesOf(end);
+                bool computableByTimeStep = true;
+                for (const auto& node : nodes)
+                {
+                    for (const auto& input : node->GetInputs())
+                    {
+                        bool fromUnit = input && unitNodes.find(input) != unitNodes.end();
+                        if ((fromUnit && !IsComputableByTimeStep(node)) || (input && input->HasMBLayout() && input->GetMBLayout() != loop->GetMBLayout()))
+                            computableByTimeStep = false;
+                    }
+                }
+                if (!computableByTimeStep)
+                    break;
+                unitNodes.insert(nodes.begin(), nodes.end());
+                if (!nextLoop)
+                    continue;
+
+                // the stage [stageBegin, end] is complete
+                if (!isHazardFree(k, end + 1))
+                    break;
+                unit.m_stageBegins.push_back(stageBegin);
+                unit.m_end = end + 1;
+                stageBegin = end + 1;
+            }
+            if (unit.m_stageBegins.size() < 2)
+                unit.m_stageBegins.clear();
+        }
+        units.push_back(unit);
+        k = unit.m_end;
+    }
+    return units;
+}
+
 /*virtual*/ void ComputationNetwork::PARTraversalFlowControlNode::Backprop(const FrameRange& fr, bool childrenInThisLoop, bool childrenInOuterLoop) /*override*/
 {
     childrenInThisLoop, childrenInOuterLoop; // TODO: think through what these mean when coming from PAR mode
+    ComputationNodeProfiler* profiler = HasEnvironmentPtr() ? Environment().nodeProfiler.get() : nullptr;
     // process nodes in pre-determined order
     for (auto pnode = m_nestedNodes.rbegin(); pnode != m_nestedNodes.rend(); pnode++) // iterate backwards over evaluation order
+        BackpropNestedNode(*pnode, fr, profiler);
+}
+
+void ComputationNetwork::PARTraversalFlowControlNode::BackpropNestedNode(const ComputationNodeBasePtr& node, const FrameRange& fr, ComputationNodeProfiler* profiler)
+{
+    // all users of this node come later in evaluation order, so its gradient is complete
+    if (HasEnvironmentPtr() && Environment().gradientComputedCallback && node->NeedsGradient())
+        Environment().gradientComputedCallback(node);
+
+    // activation offloading: bring back values that wait in host memory, see ActivationOffloader
+    if (m_activationOffloader)
+        m_activationOffloader->BeforeBackprop(node);
+
+    // activation checkpointing: bring back values that were not kept from forward prop, see PlanActivationRecomputation()
+    // The values are recomputed from the same inputs, so the eval timestamps are left alone.
+    auto recompute = m_recomputeBeforeBackprop.find(node);
+    if (recompute != m_recomputeBeforeBackprop.end())
     {
-        auto& node = *pnode;
+        for (auto& recomputedNode : recompute->second)
+        {
+            TimelineEvent event("ForwardProp", recomputedNode->NodeName(), recomputedNode->GetDeviceId());
+            ComputationNodeProfiler::Scope profile(profiler, recomputedNode, /*forward=*/true);
+            MatrixTransitionScope transitions("ForwardProp", recomputedNode);
+            recomputedNode->BeginForwardProp();
+            recomputedNode->ForwardProp(fr.WithLayout(recomputedNode->GetMBLayout()));
+            recomputedNode->EndForwardProp();
+        }
+    }
 
+    {
+        TimelineEvent event("BackpropTo", node->NodeName(), node->GetDeviceId());
+        ComputationNodeProfiler::Scope profile(profiler, node, /*forward=*/false);
+        MatrixTransitionScope transitions("BackpropTo", node);
         node->BeginBackprop();
         node->Backprop(fr.WithLayout(node->GetMBLayout()), true /*childrenInThisLoop*/, true /*childrenInOuterLoop*/);
         node->EndBackprop();
+    }
 
-        // Extreme Tracing, part 2/4
-        if (node->HasEnvironmentPtr() && node->Environment().IsLogLevelNodeTrace() && node->NeedsGradient())
-            DumpNode<float>(node, /*dumpGradient=*/true) || DumpNode<double>(node, true);
+    // Extreme Tracing, part 2/4
+    if (node->HasEnvironmentPtr() && node->Environment().IsLogLevelNodeTrace() && node->NeedsGradient())
+        DumpNode<float>(node, /*dumpGradient=*/true) || DumpNode<double>(node, true);
+}
+
+void ComputationNetwork::PARTraversalFlowControlNode::SetPipelineStages(const std::unordered_map<ComputationNodeBasePtr, size_t>& stages)
+{
+    m_nestedNodeStages.clear();
+    for (const auto& node : m_nestedNodes)
+    {
+        auto loop = dynamic_pointer_cast<SEQTraversalFlowControlNode>(node);
+        auto iter = stages.find(loop ? loop->m_nestedNodes.front() : node);
+        if (iter == stages.end())
+            LogicError("SetPipelineStages: %ls %ls operation has no pipeline stage.", node->NodeName().c_str(), node->OperationName().c_str());
+        m_nestedNodeStages.push_back(iter->second);
+    }
+}
+
+// The recomputed values come from the same inputs as the ones of forward prop (replayed transfers, the same
+// micro-batch), so the eval timestamps are left alone.
+void ComputationNetwork::PARTraversalFlowControlNode::ForwardPropPipelineStage(const FrameRange& fr, size_t stage)
+{
+    if (m_nestedNodeStages.size() != m_nestedNodes.size())
+        LogicError("ForwardPropPipelineStage: The network is not pipelined.");
+    ComputationNodeProfiler* profiler = HasEnvironmentPtr() ? Environment().nodeProfiler.get() : nullptr;
+    for (size_t i = 0; i < m_nestedNodes.size(); i++)
+    {
+        const auto& node = m_nestedNodes[i];
+        bool isLoop = dynamic_pointer_cast<SEQTraversalFlowControlNode>(node) != nullptr; // (which has no inputs of its own)
+        if (m_nestedNodeStages[i] != stage || (!isLoop && (node->IsLeaf() || node->RequiresPreCompute())))
+            continue;
+        TimelineEvent event("ForwardProp", node->NodeName(), node->GetDeviceId());
+        ComputationNodeProfiler::Scope profile(profiler, node, /*forward=*/true);
+        MatrixTransitionScope transitions("ForwardProp", node);
+        node->BeginForwardProp();
+        node->ForwardProp(fr.WithLayout(node->GetMBLayout()));
+        node->EndForwardProp();
+    }
+}
+
+void ComputationNetwork::PARTraversalFlowControlNode::BackpropPipelineStage(const FrameRange& fr, size_t stage)
+{
+    if (m_nestedNodeStages.size() != m_nestedNodes.size())
+        LogicError("BackpropPipelineStage: The network is not pipelined.");
+    ComputationNodeProfiler* profiler = HasEnvironmentPtr() ? Environment().nodeProfiler.get() : nullptr;
+    for (size_t i = m_nestedNodes.size(); i-- > 0;)
+    {
+        if (m_nestedNodeStages[i] == stage)
+            BackpropNestedNode(m_nestedNodes[i], fr, profiler);
     }
 }
 /*virtual*/ void ComputationNetwork::PARTraversalFlowControlNode::RequestMatricesBeforeForwardProp(MatrixPool& matrixPool) /*override*/
@@ -226,6 +703,20 @@ static bool DumpNode(ComputationNodeBasePtr nodep, bool dumpGradient)
                        m_nestedNodes[0]->NodeName().c_str(), m_nestedNodes[0]->GetMBLayoutAxisString().c_str());
     }
 
+    // elementwise fusion: per nested node, the chain it ends; nodes computed by a later node of their chain are skipped
+    m_fusedChainOfNestedNode.assign(m_nestedNodes.size(), nullptr);
+    m_isFusedNestedNode.assign(m_nestedNodes.size(), false);
+    if (!m_fusedElementwiseChains.empty() && m_nestedNodes[0]->HasEnvironmentPtr() && m_nestedNodes[0]->Environment().IsInferring())
+    {
+        for (size_t i = 0; i < m_nestedNodes.size(); i++)
+        {
+            auto fusedChain = m_fusedElementwiseChains.find(m_nestedNodes[i]);
+            if (fusedChain != m_fusedElementwiseChains.end())
+                m_fusedChainOfNestedNode[i] = fusedChain->second.get();
+            m_isFusedNestedNode[i] = m_fusedElementwiseNodes.find(m_nestedNodes[i]) != m_fusedElementwiseNodes.end();
+        }
+    }
+
     // tell all that loop is about to commence
     for (auto& node : m_nestedNodes)
         node->BeginForwardProp();
@@ -246,13 +737,7 @@ static bool DumpNode(ComputationNodeBasePtr nodep, bool dumpGradient)
     // if we implement an according FrameRangeIteration.
     FrameRangeIteration range(GetMBLayout(), m_steppingDirection);
     for (auto t = range.begin(); t != range.end(); t++)
-    {
-        for (auto& node : m_nestedNodes)
-        {
-            node->ForwardProp(t);
-            node->BumpEvalTimeStamp();
-        }
-    }
+        ForwardPropTimeStep(t);
 
     // Extreme Tracing, part 3/4
     for (auto& node : m_nestedNodes)
@@ -264,6 +749,20 @@ static bool DumpNode(ComputationNodeBasePtr nodep, bool dumpGradient)
     }
 }
 
+void ComputationNetwork::SEQTraversalFlowControlNode::ForwardPropTimeStep(const FrameRange& t)
+{
+    for (size_t i = 0; i < m_nestedNodes.size(); i++)
+    {
+        auto& node = m_nestedNodes[i];
+        MatrixTransitionScope transitions("ForwardProp", node);
+        if (m_fusedChainOfNestedNode[i])
+            m_fusedChainOfNestedNode[i]->ForwardProp(t);
+        else if (!m_isFusedNestedNode[i])
+            node->ForwardProp(t);
+        node->BumpEvalTimeStamp();
+    }
+}
+
 /*virtual*/ void ComputationNetwork::SEQTraversalFlowControlNode::EndForwardProp() /*override*/
 {
     // tell all that loop is done  --e.g. PastValueNode will capture its state for BPTT processing
@@ -289,6 +788,7 @@ static bool DumpNode(ComputationNodeBasePtr nodep, bool dumpGradient)
         for (auto nodeIter2 = recurrentNodes.rbegin(); nodeIter2 != recurrentNodes.rend(); ++nodeIter2)
         {
             auto& node2 = *nodeIter2;
+            MatrixTransitionScope transitions("BackpropTo", node2);
             node2->Backprop(t, true /*childrenInThisLoop*/, false /*childrenInOuterLoop*/);
             // The above flags tell Backprop() to skip back-propagation from inside a node into
             // a node that is outside the loop, which is done later in EndBackprop() in PAR mode.
@@ -313,6 +813,7 @@ static bool DumpNode(ComputationNodeBasePtr nodep, bool dumpGradient)
     for (auto nodeIter2 = m_nestedNodes.rbegin(); nodeIter2 != m_nestedNodes.rend(); ++nodeIter2)
     {
         auto& node2 = *nodeIter2;
+        MatrixTransitionScope transitions("BackpropTo", node2);
         node2->Backprop(FrameRange(m_nestedNodes[0]->GetMBLayout()), false /*childrenInThisLoop*/, true /*childrenInOuterLoop*/);
     }
 
@@ -353,8 +854,17 @@ static bool DumpNode(ComputationNodeBasePtr nodep, bool dumpGradient)
 // If found then return a pointer to the list of nodes of this loop.
 /*static*/ shared_ptr<ComputationNetwork::SEQTraversalFlowControlNode> ComputationNetwork::FindInRecurrentLoops(const std::vector<std::shared_ptr<SEQTraversalFlowControlNode>>& recurrentInfo, const ComputationNodeBasePtr& node)
 {
-    // look in all recurrent loops of the network
-    // TODO: Check for IsPartOfLoop(). Also why not store the loop id in the node for direct lookup?
+    if (!node->IsPartOfLoop())
+        return nullptr;
+
+    // the loop id is an index into 'recurrentInfo' (m_allSEQNodes) until the next analysis
+    if (node->m_loopId >= 0 && node->m_loopId < (int)recurrentInfo.size() && recurrentInfo[node->m_loopId]->m_loopId == node->m_loopId)
+    {
+        assert(std::find(recurrentInfo[node->m_loopId]->m_nestedNodes.begin(), recurrentInfo[node->m_loopId]->m_nestedNodes.end(), node) != recurrentInfo[node->m_loopId]->m_nestedNodes.end());
+        return recurrentInfo[node->m_loopId];
+    }
+
+    // otherwise look in all recurrent loops of the network
     for (auto& iter : recurrentInfo)
     {
         if (std::find(iter->m_nestedNodes.begin(), iter->m_nestedNodes.end(), node) != iter->m_nestedNodes.end()) // TODO: should this loop need to be a method of SEQTraversalFlowControlNode?
@@ -429,7 +939,10 @@ void ComputationNetwork::InvalidateCompiledNetwork()
     m_isCompiled = false;
     m_allSEQNodes.clear();
     m_evalOrders.clear();
+    m_globalEvalOrderPositions.clear();
     m_nestedNetworks.clear();
+    m_fusedElementwiseChains.clear();
+    m_fusedElementwiseNodes.clear();
     m_inputValues.clear();
     m_learnableParameters.clear();
 }
@@ -486,6 +999,15 @@ void ComputationNetwork::CompileNetwork()
     //for (auto& node : m_allRoots)
     //    FormRecurrentLoops(node); // BUGBUG: These calls are needed because they patch EvalOrders. Will be unnecessary once we move this out.
 
+    // STEP: Pipeline parallelism: all nodes of a stage before those of the next one, see CreatePipelined().
+    // The order within each stage is kept, and with it the nodes of each loop together.
+    if (IsPipelined())
+    {
+        auto nodes = GetEvalOrder(nullptr);
+        nodes.sort([this](const ComputationNodeBasePtr& a, const ComputationNodeBasePtr& b) { return GetPipelineStage(a) < GetPipelineStage(b); });
+        UpdateEvalOrder(nullptr, nodes);
+    }
+
     // STEP: Create loop-corrected depth-first traversals and cached input/parameter sets for every actual root node.
     for (auto& root : m_allRoots)
     {
@@ -501,7 +1023,11 @@ void ComputationNetwork::CompileNetwork()
     ValidateNetwork();
 
     // STEP: Optimize the network.
-    // :)
+    FuseElementwiseChains();
+    if (!AreMatricesAllocated())
+        ElideInputs();
+    if (AreMatricesAllocated())
+        PlanConcurrentBranches();
 
     // STEP: Some final details.
     ResetEvalTimeStamps(); // invalidate all m_value fields. Really belongs into StartEvaluateMinibatchLoop()
@@ -511,6 +1037,310 @@ void ComputationNetwork::CompileNetwork()
     m_isCompiled = true;
 }
 
+void ComputationNetwork::EnableElementwiseFusion(bool enable)
+{
+    if (AreMatricesAllocated())
+        LogicError("EnableElementwiseFusion: Must be called before the matrices are allocated.");
+    m_elementwiseFusion = enable;
+    if (IsCompiled())
+        FuseElementwiseChains();
+}
+
+void ComputationNetwork::EnableInPlaceExecution(bool enable)
+{
+    if (AreMatricesAllocated())
+        LogicError("EnableInPlaceExecution: Must be called before the matrices are allocated.");
+    m_inPlaceExecution = enable;
+}
+
+void ComputationNetwork::EnableRowStackElimination(bool enable)
+{
+    if (AreMatricesAllocated())
+        LogicError("EnableRowStackElimination: Must be called before the matrices are allocated.");
+    m_rowStackElimination = enable;
+    if (IsCompiled())
+        ElideInputs();
+}
+
+void ComputationNetwork::EnableTransposeAbsorption(bool enable)
+{
+    if (AreMatricesAllocated())
+        LogicError("EnableTransposeAbsorption: Must be called before the matrices are allocated.");
+    m_transposeAbsorption = enable;
+    if (IsCompiled())
+        ElideInputs();
+}
+
+void ComputationNetwork::EnableConcurrentBranches(bool enable)
+{
+    if (AreMatricesAllocated())
+        LogicError("EnableConcurrentBranches: Must be called before the matrices are allocated.");
+    m_concurrentBranches = enable;
+}
+
+// plan the levels of concurrently computed nodes for EnableConcurrentBranches(), from the last memory allocation
+// GPU networks are computed one node at a time, since all nodes of a device share one CUDA stream and its handles.
+void ComputationNetwork::PlanConcurrentBranches()
+{
+    for (auto& iter : m_nestedNetworks)
+        dynamic_pointer_cast<PARTraversalFlowControlNode>(iter.second)->ClearConcurrentLevels();
+    if (!m_concurrentBranches)
+        return;
+    if (GetDeviceId() != CPUDEVICE)
+    {
+        fprintf(stderr, "EnableConcurrentBranches: Only supported on the CPU; nodes are computed one at a time.\n");
+        return;
+    }
+
+    map<wstring, set<const MatrixBase*>> poolMatrices;
+    for (const auto& entry : m_matrixPool.GetMemoryReport())
+    {
+        auto buffer = entry.m_matrixName != L"gradient" ? m_matrixPool.GetBuffer(entry.m_bufferId) : nullptr;
+        if (buffer)
+            poolMatrices[entry.m_nodeName].insert(buffer);
+    }
+
+    for (auto& iter : m_nestedNetworks)
+        dynamic_pointer_cast<PARTraversalFlowControlNode>(iter.second)->PlanConcurrentLevels(poolMatrices);
+}
+
+// let 'times' compute from the inputs of 'rowStack' if it can, or compute it normally again
+template <class ElemType>
+static bool SetStackedArgument(const ComputationNodeBasePtr& times, const ComputationNodeBasePtr& rowStack, bool enable)
+{
+    auto timesNode = dynamic_pointer_cast<TimesNode<ElemType>>(times);
+    auto rowStackNode = dynamic_pointer_cast<RowStackNode<ElemType>>(rowStack);
+    if (!timesNode || !rowStackNode)
+        return false;
+    if (!enable)
+    {
+        timesNode->SetStackedArgument(std::vector<size_t>());
+        rowStackNode->SetValueElided(false);
+        return true;
+    }
+
+    // the stripe of each input must be a range of the last axis, without broadcasting
+    const auto& shape = rowStack->GetSampleLayout();
+    size_t rank = shape.GetRank();
+    const auto& firstIndices = rowStackNode->GetFirstIndices();
+    if (!timesNode->CanComputeStackedArgument() || rowStackNode->GetSpliceDim() != (int)rank || firstIndices.size() != rowStack->GetNumInputs() + 1)
+        return false;
+    for (size_t i = 0; i < rowStack->GetNumInputs(); i++)
+    {
+        auto input = dynamic_pointer_cast<ComputationNode<ElemType>>(rowStack->GetInputs()[i]);
+        if (!input || input->GetMBLayout() != rowStack->GetMBLayout() || input->GetSampleLayout().GetRank() > rank ||
+            input->OperationName() == OperationNameOf(SparseInputValue))
+            return false;
+        for (size_t k = 0; k < rank; k++)
+        {
+            size_t dim = k + 1 < rank ? shape[k] : firstIndices[i + 1] - firstIndices[i];
+            if (input->GetSampleLayout().GetDimPadded(k) != dim)
+                return false;
+        }
+    }
+    timesNode->SetStackedArgument(firstIndices);
+    rowStackNode->SetValueElided(true);
+    return true;
+}
+
+// let 'times' read the input of 'transpose' with swapped strides if it can, or compute it normally again
+template <class ElemType>
+static bool SetTransposedArgument(const ComputationNodeBasePtr& times, const ComputationNodeBasePtr& transpose, bool enable)
+{
+    auto timesNode = dynamic_pointer_cast<TimesNode<ElemType>>(times);
+    auto transposeNode = dynamic_pointer_cast<TransposeDimensionsNode<ElemType>>(transpose);
+    if (!timesNode || !transposeNode)
+        return false;
+    if (!enable)
+    {
+        timesNode->SetTransposedArgument(false);
+        transposeNode->SetValueElided(false);
+        return true;
+    }
+
+    // a matrix transpose, i.e. of the two leading axes of a matrix or vector
+    auto input = transpose->GetInputs()[0];
+    if (!timesNode->CanAbsorbTransposedArgument() || std::min(transposeNode->Axis1(), transposeNode->Axis2()) != 1 ||
+        std::max(transposeNode->Axis1(), transposeNode->Axis2()) != 2 || input->HasMBLayout() || input->GetSampleLayout().GetRank() > 2 ||
+        times->GetInputs()[1]->OperationName() == OperationNameOf(SparseInputValue))
+        return false;
+    timesNode->SetTransposedArgument(true);
+    transposeNode->SetValueElided(true);
+    return true;
+}
+
+// compute the elided input of 'times' again
+static void RestoreElidedInput(const ComputationNodeBasePtr& times, const ComputationNodeBasePtr& input)
+{
+    SetStackedArgument<float>(times, input, false) || SetStackedArgument<double>(times, input, false) ||
+    SetTransposedArgument<float>(times, input, false) || SetTransposedArgument<double>(times, input, false);
+}
+
+// find the RowStacks for EnableRowStackElimination() and the Transposes for EnableTransposeAbsorption()
+// An input of a TimesNode is elided if the TimesNode is its only consumer, neither is in a recurrent loop, and it is
+// no root or member of a node group, whose values must be available. A RowStack must be the right argument, a
+// Transpose the left one.
+void ComputationNetwork::ElideInputs()
+{
+    for (const auto& iter : m_elidedInputs)
+        RestoreElidedInput(iter.first, iter.second);
+    m_elidedInputs.clear();
+
+    if (!m_rowStackElimination && !m_transposeAbsorption)
+        return;
+
+    std::map<ComputationNodeBasePtr, std::vector<ComputationNodeBasePtr>> parentsMap;
+    for (const auto& node : GetAllNodes())
+        for (const auto& input : node->GetInputs())
+            parentsMap[input].push_back(node);
+    std::set<ComputationNodeBasePtr> nodesInGroups(m_allRoots.begin(), m_allRoots.end());
+    for (auto* group : GetAllNodeGroups())
+        nodesInGroups.insert(group->begin(), group->end());
+
+    size_t numRowStacks = 0, numTransposes = 0;
+    for (const auto& node : GetAllNodes())
+    {
+        bool isRowStack  = m_rowStackElimination && node->OperationName() == OperationNameOf(RowStackNode);
+        bool isTranspose = m_transposeAbsorption && node->OperationName() == OperationNameOf(TransposeDimensionsNode);
+        if ((!isRowStack && !isTranspose) || node->IsPartOfLoop() || nodesInGroups.find(node) != nodesInGroups.end())
+            continue;
+        const auto& parents = parentsMap[node];
+        if (parents.size() != 1)
+            continue;
+        const auto& times = parents.front();
+        if (times->OperationName() != OperationNameOf(TimesNode) || times->IsPartOfLoop() || times->GetInputs()[0] == times->GetInputs()[1])
+            continue;
+        if (isRowStack && times->GetInputs()[1] == node && (SetStackedArgument<float>(times, node, true) || SetStackedArgument<double>(times, node, true)))
+            numRowStacks++;
+        else if (isTranspose && times->GetInputs()[0] == node && (SetTransposedArgument<float>(times, node, true) || SetTransposedArgument<double>(times, node, true)))
+            numTransposes++;
+        else
+            continue;
+        m_elidedInputs[times] = node;
+    }
+
+    if (TraceLevel() > 0 && !m_elidedInputs.empty())
+        fprintf(stderr, "ElideInputs: %d RowStack and %d Transpose operations are computed by their consumer.\n", (int)numRowStacks, (int)numTransposes);
+}
+
+// find chains of elementwise nodes for EnableElementwiseFusion()
+// Going backwards through the evaluation order, each unassigned elementwise node starts a chain, which then grows
+// by those of its inputs whose value is used by the chain only. All nodes of a chain and its inputs from outside
+// have samples of the same size and the same MBLayout (inputs may also have none), so that a chain is one
+// elementwise op over matrices of the same size, or single columns. A chain is either outside of all loops, or all
+// its nodes are in the same loop, which then computes it once per time step.
+void ComputationNetwork::FuseElementwiseChains()
+{
+    m_fusedElementwiseChains.clear();
+    m_fusedElementwiseNodes.clear();
+
+    if (m_elementwiseFusion)
+    {
+        std::map<ComputationNodeBasePtr, std::set<ComputationNodeBasePtr>> parentsMap;
+        for (const auto& node : GetAllNodes())
+            for (const auto& input : node->GetInputs())
+                parentsMap[input].insert(node);
+        std::set<ComputationNodeBasePtr> nodesInGroups(m_allRoots.begin(), m_allRoots.end());
+        for (auto* group : GetAllNodeGroups())
+            nodesInGroups.insert(group->begin(), group->end());
+
+        const auto& evalOrder = GetEvalOrder(nullptr);
+        std::map<ComputationNodeBasePtr, size_t> evalPosition;
+        for (const auto& node : evalOrder)
+            evalPosition[node] = evalPosition.size();
+
+        auto isSameElemType = [](const ComputationNodeBasePtr& a, const ComputationNodeBasePtr& b)
+        {
+            return (dynamic_pointer_cast<ComputationNode<float>>(a) && dynamic_pointer_cast<ComputationNode<float>>(b)) ||
+                   (dynamic_pointer_cast<ComputationNode<double>>(a) && dynamic_pointer_cast<ComputationNode<double>>(b));
+        };
+        // chains inside a recurrent loop are computed per time step, so all their nodes must be in the same loop
+        std::map<ComputationNodeBasePtr, const SEQTraversalFlowControlNode*> loopOf;
+        for (const auto& loop : m_allSEQNodes)
+            for (const auto& node : loop->m_nestedNodes)
+                loopOf[node] = loop.get();
+        auto getLoop = [&](const ComputationNodeBasePtr& node) -> const SEQTraversalFlowControlNode*
+        {
+            auto found = loopOf.find(node);
+            return found != loopOf.end() ? found->second : nullptr;
+        };
+        // a node that can be computed by a chain ending in 'last'
+        auto isFusable = [&](const ComputationNodeBasePtr& node, const ComputationNodeBasePtr& last)
+        {
+            if (node->ForwardElementwiseOp() == opNone || getLoop(node) != getLoop(last) || node->GetNumInputs() < 1 || node->GetNumInputs() > 3 ||
+                !isSameElemType(node, last) || node->GetMBLayout() != last->GetMBLayout() ||
+                node->GetSampleLayout().GetNumElements() != last->GetSampleLayout().GetNumElements())
+                return false;
+            for (const auto& input : node->GetInputs())
+            {
+                if (!isSameElemType(input, last) || (input->HasMBLayout() && input->GetMBLayout() != last->GetMBLayout()) ||
+                    input->GetSampleLayout().GetNumElements() != last->GetSampleLayout().GetNumElements())
+                    return false;
+            }
+            return true;
+        };
+        auto countInputs = [](const std::set<ComputationNodeBasePtr>& nodes)
+        {
+            std::set<ComputationNodeBasePtr> inputs;
+            for (const auto& node : nodes)
+                for (const auto& input : node->GetInputs())
+                    if (nodes.find(input) == nodes.end())
+                        inputs.insert(input);
+            return inputs.size();
+        };
+
+        std::set<ComputationNodeBasePtr> assigned;
+        for (auto iter = evalOrder.rbegin(); iter != evalOrder.rend(); iter++)
+        {
+            const auto& last = *iter;
+            if (assigned.find(last) != assigned.end() || !isFusable(last, last))
+                continue;
+            std::set<ComputationNodeBasePtr> chainNodes = { last };
+            for (bool grown = true; grown;)
+            {
+                grown = false;
+                for (const auto& node : std::set<ComputationNodeBasePtr>(chainNodes))
+                {
+                    for (const auto& input : node->GetInputs())
+                    {
+                        if (chainNodes.size() >= FusedElementwiseProgram::MaxSteps || chainNodes.find(input) != chainNodes.end() ||
+                            assigned.find(input) != assigned.end() || nodesInGroups.find(input) != nodesInGroups.end() || !isFusable(input, last))
+                            continue;
+                        const auto& parents = parentsMap[input];
+                        if (!std::all_of(parents.begin(), parents.end(), [&](const ComputationNodeBasePtr& parent) { return chainNodes.find(parent) != chainNodes.end(); }))
+                            continue;
+                        chainNodes.insert(input);
+                        if (countInputs(chainNodes) > FusedElementwiseProgram::MaxInputs)
+                            chainNodes.erase(input);
+                        else
+                            grown = true;
+                    }
+                }
+            }
+            if (chainNodes.size() < 2 || countInputs(chainNodes) > FusedElementwiseProgram::MaxInputs)
+                continue;
+
+            std::vector<ComputationNodeBasePtr> nodes(chainNodes.begin(), chainNodes.end());
+            std::sort(nodes.begin(), nodes.end(), [&](const ComputationNodeBasePtr& a, const ComputationNodeBasePtr& b) { return evalPosition[a] < evalPosition[b]; });
+            if (dynamic_pointer_cast<ComputationNode<float>>(last))
+                m_fusedElementwiseChains[last] = make_shared<FusedElementwiseChain<float>>(nodes);
+            else
+                m_fusedElementwiseChains[last] = make_shared<FusedElementwiseChain<double>>(nodes);
+            assigned.insert(nodes.begin(), nodes.end());
+            m_fusedElementwiseNodes.insert(nodes.begin(), nodes.end() - 1);
+        }
+
+        if (TraceLevel() > 0)
+            fprintf(stderr, "\nElementwise fusion: %d chains computing %d nodes.\n",
+                    (int)m_fusedElementwiseChains.size(), (int)(m_fusedElementwiseChains.size() + m_fusedElementwiseNodes.size()));
+    }
+
+    for (auto& iter : m_nestedNetworks)
+        dynamic_pointer_cast<PARTraversalFlowControlNode>(iter.second)->SetFusedElementwiseChains(m_fusedElementwiseChains, m_fusedElementwiseNodes);
+    for (auto& loop : m_allSEQNodes)
+        loop->SetFusedElementwiseChains(m_fusedElementwiseChains, m_fusedElementwiseNodes);
+}
+
 // determine the set of all root nodes
 // Roots are nodes that ForwardProp() may be called for.
 //  - training criterion, eval criteria
@@ -619,21 +1449,99 @@ void ComputationNetwork::ResetMBLayouts()
     }
 }
 
-// -----------------------------------------------------------------------
-// validation
-// -----------------------------------------------------------------------
-
-// validate sub-network needed to evalute a specific output node
-// This calls Validate() on every node in evaluation order (allowing to propagate things forwards through the net).
-// This is called lazily but once only per node until next ClearCache().
-// MBLayout links are expected to have been set up already for inputs, and reset to nullptr for all other nodes.
-void ComputationNetwork::ValidateNetwork()
+// -----------------------------------------------------------------------
+// validation
+// -----------------------------------------------------------------------
+
+// validate sub-network needed to evalute a specific output node
+// This calls Validate() on every node in evaluation order (allowing to propagate things forwards through the net).
+// This is called lazily but once only per node until next ClearCache().
+// MBLayout links are expected to have been set up already for inputs, and reset to nullptr for all other nodes.
+void ComputationNetwork::ValidateNetwork()
+{
+    const auto& nodes = GetEvalOrder(nullptr);
+
+    // With a validation cache, the dimensions inferred for a network of the same structure and input shapes are restored
+    // and then only verified by a final validation pass. If that fails, e.g. since a node creates its own MBLayout,
+    // the network is validated from scratch.
+    wstring cachePath;
+    if (!Globals::GetValidationCacheDirectory().empty())
+        cachePath = GetValidationCachePath(nodes);
+
+    bool isRestored = false;
+    if (!cachePath.empty() && fexists(cachePath))
+    {
+        try
+        {
+            isRestored = RestoreValidation(nodes, cachePath);
+        }
+        catch (const exception& e)
+        {
+            fprintf(stderr, "ValidateNetwork: Not using the validation cache %ls: %s\n", cachePath.c_str(), e.what());
+        }
+
+        if (!isRestored && TraceLevel() > 0)
+            fprintf(stderr, "\nValidation cache %ls does not match the network.\n", cachePath.c_str());
+    }
+
+    if (!isRestored)
+    {
+        ValidateNetworkNodes(nodes);
+        if (!cachePath.empty())
+        {
+            try
+            {
+                SaveValidation(nodes, cachePath);
+            }
+            catch (const exception& e)
+            {
+                fprintf(stderr, "ValidateNetwork: Could not write the validation cache %ls: %s\n", cachePath.c_str(), e.what());
+            }
+        }
+    }
+
+    // propagate some info to SEQTraversalFlowControlNode
+    // TODO: In the future we should validate not on the flat list but the PARTraversalFlowControlNode structure. Then this will be unnecessary.
+    for (auto& recInfo : m_allSEQNodes)
+    {
+        auto& node = recInfo->m_sourceNode;
+        recInfo->m_needsGradient = node->m_needsGradient;
+        recInfo->LinkToMBLayout(node->GetMBLayout());
+    }
+
+    for (auto& node : nodes)
+    {
+        // nodes must output non-zero dimensional data, otherwise assume user error
+        if (node->GetSampleLayout().GetNumElements() == 0)
+            RuntimeError("%ls operation has 0 elements", node->NodeName().c_str());
+    }
+    if (TraceLevel() > 0)
+    fprintf(stderr, "\n\n");
+
+    // logging the non-default-layout nodes
+    vector<ComputationNodeBasePtr> nonDefaultNodes;
+    for (auto node : nodes)
+    {
+        if (!(node->GetMBLayout() == m_pMBLayoutOfNetwork))
+            nonDefaultNodes.push_back(node);
+    }
+#if 0 // this message is no longer necessary
+    if (TraceLevel() > 0 && !nonDefaultNodes.empty())
+    {
+        fprintf(stderr, "%d out of %d nodes do not share the minibatch layout with the input data.\n", (int)nonDefaultNodes.size(), (int)nodes.size());
+        // for (auto node : nonDefaultNodes)
+        //    fprintf(stderr, "    %ls\n", node->NodeName().c_str());
+        // fprintf(stderr, "\n\n");
+    }
+#endif
+}
+
+// infer the dimensions and MBLayouts of all nodes, given in evaluation order
+void ComputationNetwork::ValidateNetworkNodes(const list<ComputationNodeBasePtr>& nodes)
 {
     // we call all nodes' Validate() in order to validate, that is, set up MBLayout and FunctionValues dimension
     // A problem is that recurrent loops may require partial validation.
     // Nodes validated on partial input (i.e. some children not yet validated) will be revisited.
-    const auto& nodes = GetEvalOrder(nullptr);
-
     for (auto& node : nodes)
     {
         node->m_visited = false;
@@ -644,15 +1552,54 @@ void ComputationNetwork::ValidateNetwork()
     // steps:
     //  - validate (not final)          // not final means no dimension checks
     //    Keep going through the list until all nodes have been validated and all inputs have been validated as well.
+    //    After the first pass, only nodes that are not valid yet, or whose inputs changed since they were validated, are
+    //    validated again, so that a pass costs in the number of changes rather than in the size of the network.
     //  - validate (final)              // final means consistency checks
     //    Fail if any change during this stage.
+    vector<ComputationNodeBasePtr> order(nodes.begin(), nodes.end());
+    unordered_map<ComputationNodeBasePtr, size_t> positions;
+    for (size_t i = 0; i < order.size(); i++)
+        positions[order[i]] = i;
+    vector<vector<size_t>> consumers(order.size()); // [i] -> positions of the nodes that have order[i] as an input
+    for (size_t i = 0; i < order.size(); i++)
+    {
+        for (const auto& input : order[i]->GetInputs())
+        {
+            auto position = positions.find(input);
+            if (position != positions.end())
+                consumers[position->second].push_back(i);
+        }
+    }
+
+    vector<char> isPending(order.size(), 1);
     size_t pass = 1;
-    size_t toValidate = nodes.size();
+    size_t toValidate = order.size();
     while (toValidate > 0)
     {
         if (TraceLevel() > 0)
         fprintf(stderr, "\nValidating network. %d nodes to process in pass %d.\n\n", (int) toValidate, (int) pass);
-        toValidate = ValidateNodes(nodes, /*isFirstPass=*/pass == 1, false /*isFinalValidationPass*/);
+        for (size_t i = 0; i < order.size(); i++)
+        {
+            if (!isPending[i])
+                continue;
+            bool changed;
+            isPending[i] = !ValidateNodeInPass(order[i], /*isFirstPass=*/pass == 1, false /*isFinalValidationPass*/, changed);
+            if (!changed)
+                continue;
+            // a change of the node, or of one of its inputs (which some nodes infer), invalidates their consumers;
+            // those later in the order are validated again in this pass, the others in the next one
+            for (size_t j : consumers[i])
+                isPending[j] = 1;
+            for (const auto& input : order[i]->GetInputs())
+            {
+                auto position = positions.find(input);
+                if (position != positions.end())
+                    for (size_t j : consumers[position->second])
+                        if (j != i)
+                            isPending[j] = 1;
+            }
+        }
+        toValidate = count(isPending.begin(), isPending.end(), (char)1);
         pass++;
     }
     if (TraceLevel() > 0)
@@ -660,41 +1607,140 @@ void ComputationNetwork::ValidateNetwork()
     toValidate = ValidateNodes(nodes, /*isFirstPass=*/pass == 1, true /*isFinalValidationPass*/);
     if (toValidate != 0)
         LogicError("ValidateSubNetwork: ValidateNodes(true) unexpectedly returned with work left to do.");
+}
 
-    // propagate some info to SEQTraversalFlowControlNode
-    // TODO: In the future we should validate not on the flat list but the PARTraversalFlowControlNode structure. Then this will be unnecessary.
-    for (auto& recInfo : m_allSEQNodes)
+// -----------------------------------------------------------------------
+// validation cache
+// -----------------------------------------------------------------------
+
+static const size_t ValidationCacheVersion = 1;
+
+// The cache file of a network is named by a hash of its structure (operations, node names and inputs in evaluation
+// order) and of the shapes of its leaves, i.e. the shapes of its inputs and parameters.
+wstring ComputationNetwork::GetValidationCachePath(const list<ComputationNodeBasePtr>& nodes) const
+{
+    uint64_t hash = 14695981039346656037ull; // FNV-1a
+    auto hashBytes = [&hash](const void* data, size_t size)
     {
-        auto& node = recInfo->m_sourceNode;
-        recInfo->m_needsGradient = node->m_needsGradient;
-        recInfo->LinkToMBLayout(node->GetMBLayout());
+        for (size_t i = 0; i < size; i++)
+            hash = (hash ^ ((const unsigned char*)data)[i]) * 1099511628211ull;
+    };
+    auto hashString = [&hashBytes](const wstring& s)
+    {
+        hashBytes(s.c_str(), (s.size() + 1) * sizeof(wchar_t));
+    };
+    auto hashValue = [&hashBytes](size_t value)
+    {
+        hashBytes(&value, sizeof(value));
+    };
+
+    hashValue(ValidationCacheVersion);
+    for (const auto& node : nodes)
+    {
+        hashString(node->OperationName());
+        hashString(node->NodeName());
+        hashValue(node->GetNumInputs());
+        for (const auto& input : node->GetInputs())
+            hashString(input ? input->NodeName() : L"");
+        if (node->IsLeaf())
+        {
+            const auto& sampleLayout = node->GetSampleLayout();
+            hashValue(sampleLayout.GetRank());
+            for (size_t k = 0; k < sampleLayout.GetRank(); k++)
+                hashValue(sampleLayout[k]);
+            hashValue(node->HasMBLayout());
+        }
     }
 
+    wchar_t fileName[64];
+    swprintf(fileName, _countof(fileName), L"%016llx.validation", (unsigned long long)hash);
+    return Globals::GetValidationCacheDirectory() + L"/" + fileName;
+}
+
+// Restore the dimensions, MBLayouts and m_needsGradient of all inner nodes from the cache, and verify them by the final
+// validation pass. Returns false, or throws, if they do not match the network; it is then validated from scratch.
+bool ComputationNetwork::RestoreValidation(const list<ComputationNodeBasePtr>& nodes, const wstring& path)
+{
+    File fstream(path, FileOptions::fileOptionsBinary | FileOptions::fileOptionsRead);
+    fstream.GetMarker(FileMarker::fileMarkerBeginSection, L"BValidation");
+    size_t version, numNodes;
+    fstream >> version >> numNodes;
+    if (version != ValidationCacheVersion || numNodes != nodes.size())
+        return false;
+
     for (auto& node : nodes)
     {
-        // nodes must output non-zero dimensional data, otherwise assume user error
-        if (node->GetSampleLayout().GetNumElements() == 0)
-            RuntimeError("%ls operation has 0 elements", node->NodeName().c_str());
+        node->m_visited = true;
+        node->m_needsGradient = node->IsParameterUpdateRequired();
+    }
+
+    for (auto& node : nodes)
+    {
+        wstring nodeName, layoutSourceName;
+        TensorShape sampleLayout;
+        char needsGradient;
+        fstream >> nodeName;
+        sampleLayout.Load(fstream);
+        fstream >> layoutSourceName >> needsGradient;
+        if (nodeName != node->NodeName())
+            return false;
+
+        // leaves are set up by their creator, and validated as usual
+        if (node->IsLeaf())
+            continue;
+
+        // the MBLayout is the one of the node it was shared with; a node that created its own keeps what it has
+        MBLayoutPtr pMBLayout;
+        if (!layoutSourceName.empty())
+        {
+            pMBLayout = (layoutSourceName == nodeName) ? node->GetMBLayout() : GetNodeFromName(layoutSourceName)->GetMBLayout();
+            if (!pMBLayout)
+                return false;
+        }
+
+        node->LinkToMBLayout(pMBLayout);
+        node->SetDims(sampleLayout, pMBLayout != nullptr);
+        node->m_needsGradient = (needsGradient != 0);
     }
+    fstream.GetMarker(FileMarker::fileMarkerEndSection, L"EValidation");
+
     if (TraceLevel() > 0)
-    fprintf(stderr, "\n\n");
+        fprintf(stderr, "\nValidating network from cache %ls, final pass.\n\n", path.c_str());
+    return ValidateNodes(nodes, /*isFirstPass=*/true, true /*isFinalValidationPass*/) == 0;
+}
 
-    // logging the non-default-layout nodes
-    vector<ComputationNodeBasePtr> nonDefaultNodes;
-    for (auto node : nodes)
+void ComputationNetwork::SaveValidation(const list<ComputationNodeBasePtr>& nodes, const wstring& path) const
+{
+    // Each MBLayout is recorded by the name of a node that holds it, preferably a leaf, which already has it before
+    // validation; otherwise the first node in evaluation order, which created it.
+    map<const MBLayout*, wstring> layoutSourceNames;
+    for (const auto& node : nodes)
     {
-        if (!(node->GetMBLayout() == m_pMBLayoutOfNetwork))
-            nonDefaultNodes.push_back(node);
+        if (node->HasMBLayout() && node->IsLeaf())
+            layoutSourceNames.insert(make_pair(node->GetMBLayout().get(), node->NodeName()));
     }
-#if 0 // this message is no longer necessary
-    if (TraceLevel() > 0 && !nonDefaultNodes.empty())
+    for (const auto& node : nodes)
     {
-        fprintf(stderr, "%d out of %d nodes do not share the minibatch layout with the input data.\n", (int)nonDefaultNodes.size(), (int)nodes.size());
-        // for (auto node : nonDefaultNodes)
-        //    fprintf(stderr, "    %ls\n", node->NodeName().c_str());
-        // fprintf(stderr, "\n\n");
+        if (node->HasMBLayout())
+            layoutSourceNames.insert(make_pair(node->GetMBLayout().get(), node->NodeName()));
     }
-#endif
+
+    // write to a temporary file first, so that concurrent processes never read a partial cache
+    wstring tmpPath = path + L".tmp" + msra::strfun::wstrprintf(L"%d", (int)GetCurrentProcessId());
+    {
+        File fstream(tmpPath, FileOptions::fileOptionsBinary | FileOptions::fileOptionsWrite);
+        fstream.PutMarker(FileMarker::fileMarkerBeginSection, L"BValidation");
+        fstream << ValidationCacheVersion << nodes.size();
+        for (const auto& node : nodes)
+        {
+            fstream << node->NodeName();
+            node->GetSampleLayout().Save(fstream);
+            fstream << (node->HasMBLayout() ? layoutSourceNames[node->GetMBLayout().get()] : wstring());
+            fstream << (char)(node->m_needsGradient ? 1 : 0);
+        }
+        fstream.PutMarker(FileMarker::fileMarkerEndSection, L"EValidation");
+    }
+    renameOrDie(tmpPath, path);
 }
 
 // helper to discover dimension changes
@@ -735,66 +1781,76 @@ bool ComputationNetwork::ValidateNode(ComputationNodeBasePtr node, bool isFinalV
 
 // perform one pass of validation over the topologically-sorted node set
 // returns how many nodes either could not yet be validated yet or have changed and thus must be redone
-size_t ComputationNetwork::ValidateNodes(list<ComputationNodeBasePtr> nodes, bool isFirstPass, bool isFinalValidationPass)
+size_t ComputationNetwork::ValidateNodes(const list<ComputationNodeBasePtr>& nodes, bool isFirstPass, bool isFinalValidationPass)
 {
     size_t todo = 0;
     for (auto& node : nodes)
     {
-        const auto& children = node->GetInputs();
-        const bool isLeaf = node->IsLeaf();
-        // only validate a node if it has at least one child
-        bool hasVisitedChild = false;
-        bool allChildrenVisited = true;
-        for (auto& child : children)
-        {
-            hasVisitedChild |= child->m_visited; // if not a single visited child then no point in validating
-            allChildrenVisited &= child->m_visited;
+        bool changed;
+        if (!ValidateNodeInPass(node, isFirstPass, isFinalValidationPass, changed))
+            todo++; // count those that we need to redo
+    }
+    return todo;
+}
 
-            // Make sure we don't use DynamicAxis in places where it was not designed for.
-            // This is a stop-gap. We need a more coherent concept for passing of shapes.
-            if (child->OperationName() == L"DynamicAxis")
-                RuntimeError("%ls: Cannot be used as input to another node. It can only be used on the 'dynamicAxis' property of an Input node.", child->NodeDescription().c_str());
-        }
+// validate one node in a pass of validation
+// Returns whether the node is valid, i.e. all its inputs are validated and nothing changed; 'changed' tells whether
+// the node or its inputs changed, i.e. whether its consumers must be validated again.
+bool ComputationNetwork::ValidateNodeInPass(const ComputationNodeBasePtr& node, bool isFirstPass, bool isFinalValidationPass, bool& changed)
+{
+    changed = false;
+    const auto& children = node->GetInputs();
+    const bool isLeaf = node->IsLeaf();
+    // only validate a node if it has at least one child
+    bool hasVisitedChild = false;
+    bool allChildrenVisited = true;
+    for (auto& child : children)
+    {
+        hasVisitedChild |= child->m_visited; // if not a single visited child then no point in validating
+        allChildrenVisited &= child->m_visited;
+
+        // Make sure we don't use DynamicAxis in places where it was not designed for.
+        // This is a stop-gap. We need a more coherent concept for passing of shapes.
+        if (child->OperationName() == L"DynamicAxis")
+            RuntimeError("%ls: Cannot be used as input to another node. It can only be used on the 'dynamicAxis' property of an Input node.", child->NodeDescription().c_str());
+    }
 
-        // if there is not at least one visited child
-        bool valid = false;
-        if (hasVisitedChild || isLeaf) // got at least one child: it makes sense to call Validate()
+    // if there is not at least one visited child
+    bool valid = false;
+    if (hasVisitedChild || isLeaf) // got at least one child: it makes sense to call Validate()
+    {
+        string prevPrototype = node->FormatOperationPrototype("");
+        bool unchanged;
+        try
         {
-            string prevPrototype = node->FormatOperationPrototype("");
-            bool unchanged;
-            try
-            {
-                unchanged = !ValidateNode(node, isFinalValidationPass);
-                string updatedPrototype = node->FormatOperationPrototype("");
+            unchanged = !ValidateNode(node, isFinalValidationPass);
+            string updatedPrototype = node->FormatOperationPrototype("");
 #if 0           // print prototype in final validation pass. Problematic for tracking down validation errors in loops.
-                unchanged;
-                if (isFinalValidationPass)
+            unchanged;
+            if (isFinalValidationPass)
 #else           // print prototype upon every change (useful for debugging)
-                if (isFirstPass || !unchanged || prevPrototype != updatedPrototype)
+            if (isFirstPass || !unchanged || prevPrototype != updatedPrototype)
 #endif
-                    if (TraceLevel() > 0)
-                    fprintf(stderr, "Validating --> %s\n", updatedPrototype.c_str());
-            }
-            catch (...) // if validation failed then print the prototype anyway so one can see the input args
-            {
-                fprintf(stderr, "Validating --> %s FAILED\n", prevPrototype.c_str());
-                throw;
-            }
-            node->m_visited = true;
-            // print the new type
-            // sanity checks
-            if (isFinalValidationPass && !unchanged)
-                LogicError("ValidateSubNetwork: %ls %ls operation changed during final validation.", node->NodeName().c_str(), node->OperationName().c_str());
-            if (isFinalValidationPass && !allChildrenVisited)
-                LogicError("ValidateSubNetwork: %ls %ls operation in final validation although not all children were visited?", node->NodeName().c_str(), node->OperationName().c_str());
-            // if all children valid then
-            valid = (allChildrenVisited && unchanged) || isLeaf;
+                if (TraceLevel() > 0)
+                fprintf(stderr, "Validating --> %s\n", updatedPrototype.c_str());
+        }
+        catch (...) // if validation failed then print the prototype anyway so one can see the input args
+        {
+            fprintf(stderr, "Validating --> %s FAILED\n", prevPrototype.c_str());
+            throw;
         }
-        // count those that we need to redo
-        if (!valid)
-            todo++;
+        changed = !unchanged || !node->m_visited;
+        node->m_visited = true;
+        // print the new type
+        // sanity checks
+        if (isFinalValidationPass && !unchanged)
+            LogicError("ValidateSubNetwork: %ls %ls operation changed during final validation.", node->NodeName().c_str(), node->OperationName().c_str());
+        if (isFinalValidationPass && !allChildrenVisited)
+            LogicError("ValidateSubNetwork: %ls %ls operation in final validation although not all children were visited?", node->NodeName().c_str(), node->OperationName().c_str());
+        // if all children valid then
+        valid = (allChildrenVisited && unchanged) || isLeaf;
     }
-    return todo;
+    return valid;
 }
 
 // -----------------------------------------------------------------------
@@ -989,6 +2045,10 @@ void ComputationNetwork::AllocateAllMatrices(const std::vector<ComputationNodeBa
 
     VerifyIsCompiled("AllocateAllMatrices");
 
+    // With the SizeAware policy, the pool only records requests and their lifetimes while we simulate the
+    // forward/backward pass below; actual buffers are assigned by OptimizedMemoryAllocation() at the end.
+    m_matrixPool.SetPolicy(Globals::GetMemorySharingPolicy());
+
     std::vector<ComputationNodeBasePtr> forwardPropRoots;
     forwardPropRoots.insert(forwardPropRoots.end(), evalRootNodes.begin(), evalRootNodes.end());
     forwardPropRoots.insert(forwardPropRoots.end(), outValueRootNodes.begin(), outValueRootNodes.end());
@@ -1004,6 +2064,26 @@ void ComputationNetwork::AllocateAllMatrices(const std::vector<ComputationNodeBa
 
     bool performingBackPropagation = (trainRootNode != nullptr) || (Globals::ShouldEnableHyperCompressMemory());
 
+    // concatenation elimination and transpose absorption: elided inputs whose value turned out to be needed are computed
+    // again, as are all where other features expect each node to hold its value (or hyperCompressMemory would free the
+    // inputs of the elided node after it)
+    bool keepInputsElided = !Globals::ShouldEnableHyperCompressMemory() && !IsPipelined() &&
+                            !(trainRootNode != nullptr && (IsActivationCheckpointingEnabled() || IsActivationOffloadingEnabled()));
+    for (auto iter = m_elidedInputs.begin(); iter != m_elidedInputs.end();)
+    {
+        if (keepInputsElided && iter->second->IsValueSharable())
+            iter++;
+        else
+        {
+            RestoreElidedInput(iter->first, iter->second);
+            iter = m_elidedInputs.erase(iter);
+        }
+    }
+
+    // Without backprop, a node's value lives until its last consumer, and its temp matrices only during its own
+    // forward prop, so that the peak is set by the widest part of the graph rather than by what backprop would need.
+    bool forwardOnly = !performingBackPropagation;
+
     // Create a composite Eval order with the specified nodes as roots
     // For each node determine parents and whether the output of the
     // node is needed during back propagation
@@ -1033,6 +2113,71 @@ void ComputationNetwork::AllocateAllMatrices(const std::vector<ComputationNodeBa
         }
     }
 
+    // the product by an elided node reads its inputs instead
+    for (const auto& iter : m_elidedInputs)
+    {
+        if (outputValueNeededDuringBackProp[iter.second])
+        {
+            for (const auto& input : iter.second->GetInputs())
+                outputValueNeededDuringBackProp[input] = true;
+        }
+    }
+
+    // pipeline parallelism: the LIFO policy shares matrices regardless of the device they are on
+    if (IsPipelined())
+    {
+        if (Globals::ShouldEnableHyperCompressMemory())
+            InvalidArgument("AllocateAllMatrices: Pipeline parallelism cannot be combined with hyperCompressMemory.");
+        if (m_matrixPool.GetPolicy() != MemorySharingPolicy::SizeAware)
+        {
+            fprintf(stderr, "AllocateAllMatrices: Pipeline parallelism requires size-aware memory sharing; using memorySharing=sizeAware.\n");
+            m_matrixPool.SetPolicy(MemorySharingPolicy::SizeAware);
+        }
+    }
+
+    // activation checkpointing: decide which values are recomputed instead of kept; these are released after forward prop
+    bool recomputeActivations = (trainRootNode != nullptr) && IsActivationCheckpointingEnabled();
+    for (auto& node : GetAllNodes())
+        node->SetValueRecomputedBeforeBackprop(false);
+    ActivationRecomputationPlan recomputationPlan;
+    if (recomputeActivations)
+    {
+        if (Globals::ShouldEnableHyperCompressMemory())
+            InvalidArgument("AllocateAllMatrices: Activation checkpointing cannot be combined with hyperCompressMemory.");
+        if (m_matrixPool.GetPolicy() != MemorySharingPolicy::SizeAware)
+        {
+            fprintf(stderr, "AllocateAllMatrices: Activation checkpointing requires size-aware memory sharing; using memorySharing=sizeAware.\n");
+            m_matrixPool.SetPolicy(MemorySharingPolicy::SizeAware);
+        }
+        recomputationPlan = PlanActivationRecomputation(trainRootNode, outputValueNeededDuringBackProp, parentsMap);
+    }
+
+    // activation offloading: decide which values wait in host memory between forward prop and backprop
+    bool offloadActivations = (trainRootNode != nullptr) && IsActivationOffloadingEnabled();
+    m_activationOffloader.reset();
+    ActivationOffloadPlan offloadPlan;
+    std::unordered_map<ComputationNodeBasePtr, std::vector<ComputationNodeBasePtr>> offloadedAfterForwardProp; // [nested node] -> values released after it
+    std::unordered_map<ComputationNodeBasePtr, std::vector<ComputationNodeBasePtr>> offloadedBeforeBackprop;   // [nested node] -> values re-acquired before it
+    if (offloadActivations)
+    {
+        if (recomputeActivations)
+            InvalidArgument("AllocateAllMatrices: Activation offloading cannot be combined with activation checkpointing.");
+        if (Globals::ShouldEnableHyperCompressMemory())
+            InvalidArgument("AllocateAllMatrices: Activation offloading cannot be combined with hyperCompressMemory.");
+        if (m_matrixPool.GetPolicy() != MemorySharingPolicy::SizeAware)
+        {
+            fprintf(stderr, "AllocateAllMatrices: Activation offloading requires size-aware memory sharing; using memorySharing=sizeAware.\n");
+            m_matrixPool.SetPolicy(MemorySharingPolicy::SizeAware);
+        }
+        offloadPlan = PlanActivationOffloading(trainRootNode, outputValueNeededDuringBackProp, parentsMap);
+        for (const auto& offloaded : offloadPlan.m_offloadedNodes)
+        {
+            size_t lastConsumer = offloaded.second;
+            offloadedAfterForwardProp[offloadPlan.m_nestedNodes[lastConsumer + 1]].push_back(offloaded.first);
+            offloadedBeforeBackprop[offloadPlan.m_nestedNodes[lastConsumer + 1]].push_back(offloaded.first);
+        }
+    }
+
     std::unordered_map<ComputationNodeBasePtr, int> parentCount;
     for (auto& keyValue : parentsMap)
     {
@@ -1040,8 +2185,10 @@ void ComputationNetwork::AllocateAllMatrices(const std::vector<ComputationNodeBa
 
         // Indicate on the node that it's parent overwrites its gradient if the node is not part of a loop
         // and has exactly one parent who implements the gradient overwrite optimization
+        // Parameter gradients that are accumulated over several backprops must always be added to.
         if (Globals::ShouldOptimizeGradientAccumulation() &&
             !keyValue.first->IsPartOfLoop() &&
+            !(m_parameterGradientAccumulation && keyValue.first->OperationName() == OperationNameOf(LearnableParameter)) &&
             (keyValue.second.size() == 1) &&
             (*keyValue.second.begin())->ImplementsGradientOverwriteOptimization())
         {
@@ -1068,6 +2215,24 @@ void ComputationNetwork::AllocateAllMatrices(const std::vector<ComputationNodeBa
         }
     }
 
+    // in-place execution: a node may overwrite the value of its only input if that is read by no other node and not
+    // kept for backprop (which includes the node's own backprop). The features that give values a second lifetime,
+    // and hyperCompressMemory, which shrinks the input's value after its consumer, exclude it.
+    bool inPlaceExecution = m_inPlaceExecution && m_matrixPool.GetPolicy() != MemorySharingPolicy::Off &&
+                            !recomputeActivations && !offloadActivations && !IsPipelined() && !Globals::ShouldEnableHyperCompressMemory();
+    auto isFused = [this](const ComputationNodeBasePtr& node)
+    {
+        return m_fusedElementwiseChains.find(node) != m_fusedElementwiseChains.end() || m_fusedElementwiseNodes.find(node) != m_fusedElementwiseNodes.end();
+    };
+    auto canRunInPlace = [&](const ComputationNodeBasePtr& node)
+    {
+        if (!inPlaceExecution || !node->ForwardPropCanRunInPlace() || node->GetNumInputs() != 1 || isFused(node))
+            return false;
+        const auto& input = node->GetInputs()[0];
+        return !input->IsPartOfLoop() && !isFused(input) && parentsMap[input].size() == 1 && !outputValueNeededDuringBackProp[input];
+    };
+    size_t numInPlace = 0;
+
     set<ComputationNodeBasePtr> completedEvaluate;
     for (auto& nodeIter : compositeForwardPropEvalOrder)
     {
@@ -1086,14 +2251,53 @@ void ComputationNetwork::AllocateAllMatrices(const std::vector<ComputationNodeBa
                 {
                     ReleaseMatricesAfterEvalForChildren(nodeLoopIter, parentCount);
                 }
+
+                // (the loop runs all its time steps at once)
+                if (forwardOnly)
+                {
+                    for (auto& nodeLoopIter : recInfo->m_nestedNodes)
+                        nodeLoopIter->ReleaseMatricesKeptForBackprop(m_matrixPool);
+                }
             }
         }
         else
         {
+            if (canRunInPlace(nodeIter) && nodeIter->RequestMatricesBeforeForwardPropInPlace(m_matrixPool))
+                numInPlace++;
             nodeIter->RequestMatricesBeforeForwardProp(m_matrixPool);
             // we only release matrices for the children since the root node's information will be used and should not be shared
             // with others
-            ReleaseMatricesAfterEvalForChildren(nodeIter, parentCount);
+            // Elementwise fusion: the inputs of all nodes of a chain are used by its last node, so they live until then.
+            auto fusedChain = m_fusedElementwiseChains.find(nodeIter);
+            if (fusedChain != m_fusedElementwiseChains.end())
+            {
+                for (const auto& node : fusedChain->second->GetNodes())
+                    ReleaseMatricesAfterEvalForChildren(node, parentCount);
+            }
+            else if (m_fusedElementwiseNodes.find(nodeIter) == m_fusedElementwiseNodes.end() && !nodeIter->IsValueElided())
+                ReleaseMatricesAfterEvalForChildren(nodeIter, parentCount);
+
+            // The inputs of an elided node are read by its consumer, so they live until then.
+            auto elidedInput = m_elidedInputs.find(nodeIter);
+            if (elidedInput != m_elidedInputs.end())
+                ReleaseMatricesAfterEvalForChildren(elidedInput->second, parentCount);
+
+            if (forwardOnly)
+                nodeIter->ReleaseMatricesKeptForBackprop(m_matrixPool);
+        }
+
+        // activation offloading: the buffer of an offloaded value is free once the nested node after its last consumer
+        // has its matrices, since the compute stream waits for the copy before the nested node after that
+        if (offloadActivations)
+        {
+            ComputationNodeBasePtr nestedNode = nodeIter->IsPartOfLoop() ? FindInRecurrentLoops(m_allSEQNodes, nodeIter) : nodeIter;
+            auto offloaded = offloadedAfterForwardProp.find(nestedNode);
+            if (offloaded != offloadedAfterForwardProp.end())
+            {
+                for (auto& offloadedNode : offloaded->second)
+                    offloadedNode->ReleaseMatricesAfterOffload(m_matrixPool);
+                offloadedAfterForwardProp.erase(offloaded); // (a loop is seen once per member)
+            }
         }
     }
 
@@ -1107,9 +2311,33 @@ void ComputationNetwork::AllocateAllMatrices(const std::vector<ComputationNodeBa
         // we need to call it here since we always compute gradients for children and root node is not children of other node
         trainRootNode->RequestMatricesBeforeBackprop(m_matrixPool);
 
+        // activation checkpointing: recomputed values live from the start of their segment's backprop to its end
+        std::vector<bool> segmentRecomputed(recomputationPlan.m_recomputedNodes.size(), false);
+
         for (auto iter = backPropNodes.rbegin(); iter != backPropNodes.rend(); iter++) // for gradient computation, traverse in reverse order
         {
             auto n = *iter;
+            size_t segment = recomputeActivations ? recomputationPlan.m_segmentOf.at(n) : 0;
+            if (recomputeActivations && !segmentRecomputed[segment])
+            {
+                segmentRecomputed[segment] = true;
+                for (auto& recomputedNode : recomputationPlan.m_recomputedNodes[segment])
+                    recomputedNode->RequestMatricesBeforeRecompute(m_matrixPool);
+            }
+
+            // activation offloading: offloaded values get their buffer back before the nested node after their last consumer
+            if (offloadActivations)
+            {
+                ComputationNodeBasePtr nestedNode = n->IsPartOfLoop() ? FindInRecurrentLoops(m_allSEQNodes, n) : n;
+                auto offloaded = offloadedBeforeBackprop.find(nestedNode);
+                if (offloaded != offloadedBeforeBackprop.end())
+                {
+                    for (auto& offloadedNode : offloaded->second)
+                        offloadedNode->RequestMatricesBeforeRecompute(m_matrixPool);
+                    offloadedBeforeBackprop.erase(offloaded);
+                }
+            }
+
             if (n->IsPartOfLoop())
             {
                 std::vector<ComputationNodeBasePtr> recurrentNodes;
@@ -1128,25 +2356,334 @@ void ComputationNetwork::AllocateAllMatrices(const std::vector<ComputationNodeBa
             {
                 // PAR mode: we can allocate and immediately deallocate one by one
                 n->AllocateGradientMatricesForInputs(m_matrixPool);
+                // (the product by an elided node adds to the gradients of its inputs)
+                auto elidedInput = m_elidedInputs.find(n);
+                if (elidedInput != m_elidedInputs.end())
+                    elidedInput->second->AllocateGradientMatricesForInputs(m_matrixPool);
                 // Root node's information will be used and should not be shared with others, also it's small (1x1)
                 if ((n != trainRootNode) && n->NeedsGradient())
                     n->ReleaseMatricesAfterBackprop(m_matrixPool);
             }
+
+            if (recomputeActivations && n == recomputationPlan.m_segmentFirstNodes[segment])
+            {
+                for (auto& recomputedNode : recomputationPlan.m_recomputedNodes[segment])
+                    recomputedNode->ReleaseMatricesAfterRecompute(m_matrixPool);
+            }
+
+            // ... until their own backprop, which comes after that of all their consumers
+            if (offloadActivations && offloadPlan.m_offloadedNodeSet.find(n) != offloadPlan.m_offloadedNodeSet.end())
+                n->ReleaseMatricesAfterRecompute(m_matrixPool);
+        }
+    }
+
+    // hand the recomputation schedule to the criterion's execution plan
+    // Recomputation is triggered by the nested node (PAR node or loop) that holds the last node of each segment.
+    if (recomputeActivations)
+    {
+        std::map<ComputationNodeBasePtr, std::vector<ComputationNodeBasePtr>> recomputeBeforeBackprop;
+        size_t numRecomputed = 0;
+        for (size_t segment = 0; segment < recomputationPlan.m_recomputedNodes.size(); segment++)
+        {
+            const auto& recomputedNodes = recomputationPlan.m_recomputedNodes[segment];
+            if (recomputedNodes.empty())
+                continue;
+            ComputationNodeBasePtr trigger = recomputationPlan.m_segmentLastNodes[segment];
+            if (trigger->IsPartOfLoop())
+                trigger = FindInRecurrentLoops(m_allSEQNodes, trigger);
+            auto& nodes = recomputeBeforeBackprop[trigger];
+            nodes.insert(nodes.end(), recomputedNodes.begin(), recomputedNodes.end());
+            numRecomputed += recomputedNodes.size();
+        }
+        dynamic_pointer_cast<PARTraversalFlowControlNode>(GetNestedNetwork(trainRootNode))->SetRecomputationPlan(std::move(recomputeBeforeBackprop));
+
+        if (TraceLevel() > 0)
+            fprintf(stderr, "\nActivation checkpointing: %d segments, %d node values recomputed before backprop.\n",
+                    (int)recomputationPlan.m_recomputedNodes.size(), (int)numRecomputed);
+    }
+
+    // hand the offload schedule to the criterion's execution plan
+    if (offloadActivations && !offloadPlan.m_offloadedNodes.empty())
+    {
+        m_activationOffloader = make_shared<ActivationOffloader>();
+        for (const auto& offloaded : offloadPlan.m_offloadedNodes)
+        {
+            size_t lastConsumer = offloaded.second;
+            m_activationOffloader->Add(offloaded.first, offloadPlan.m_nestedNodes[lastConsumer],
+                                       offloadPlan.m_nestedNodes[lastConsumer + 1], offloadPlan.m_nestedNodes[lastConsumer + 2]);
         }
     }
+    if (trainRootNode != nullptr)
+        dynamic_pointer_cast<PARTraversalFlowControlNode>(GetNestedNetwork(trainRootNode))->SetActivationOffloader(m_activationOffloader);
+    if (offloadActivations && TraceLevel() > 0)
+        fprintf(stderr, "\nActivation offloading: %d node values wait in host memory between forward prop and backprop.\n",
+                (int)offloadPlan.m_offloadedNodes.size());
+
+    if (inPlaceExecution && TraceLevel() > 0)
+        fprintf(stderr, "\nIn-place execution: %d nodes compute their value over that of their input.\n", (int)numInPlace);
+
+    m_matrixPool.OptimizedMemoryAllocation();
 
     m_areMatricesAllocated = true;
 
+    PlanConcurrentBranches();
+    if (m_gpuGraphReplay)
+        m_gpuGraphReplay->Clear(); // the graphs refer to the matrices of the last allocation
+
     // print the memory sharing structure
     if (TraceLevel() > 0)
-    PrintMemorySharingStructure(GetAllNodes());
+    {
+        PrintMemoryAllocationPlan();
+        PrintMemorySharingStructure(GetAllNodes());
+    }
+
+    if (!Globals::GetMemorySharingReportPath().empty())
+        WriteMemorySharingReport(Globals::GetMemorySharingReportPath());
+}
+
+// print summary of the size-aware allocation plan to the log
+// Sizes are in bytes per sample for minibatch-sized matrices. The planned peak is the largest sum of matrices that are
+// alive at the same time, i.e. the lower bound any sharing scheme can reach for this evaluation order.
+void ComputationNetwork::PrintMemoryAllocationPlan() const
+{
+    static const char* policyNames[] = { "off", "lifo", "sizeAware" };
+    const auto& stats = m_matrixPool.GetAllocationPlanStatistics();
+    fprintf(stderr, "\nMemory Allocation Plan (%s): %d requests assigned to %d buffers.\n", policyNames[(int)m_matrixPool.GetPolicy()], (int)stats.m_numRequests, (int)stats.m_numBuffers);
+    fprintf(stderr, "\tunshared: %10llu bytes/sample\n", (unsigned long long)stats.m_requestedBytes);
+    fprintf(stderr, "\tplanned peak: %6llu bytes/sample\n", (unsigned long long)stats.m_plannedPeakBytes);
+    fprintf(stderr, "\tallocated: %9llu bytes/sample (%.1f%% of planned peak)\n", (unsigned long long)stats.m_allocatedBytes,
+            stats.m_plannedPeakBytes > 0 ? 100.0 * stats.m_allocatedBytes / stats.m_plannedPeakBytes : 100.0);
+}
+
+static string JsonEscape(const wstring& s)
+{
+    string result;
+    for (auto c : msra::strfun::utf8(s))
+    {
+        if (c == '"' || c == '\\')
+            result.push_back('\\');
+        result.push_back(c);
+    }
+    return result;
+}
+
+// write the memory-sharing structure of the last AllocateAllMatrices() as JSON, one entry per node matrix:
+//   bytesPerSample    requested size (per sample if minibatch-scaled; 0 if only known at runtime)
+//   allocatedBytes    bytes currently allocated by the buffer (grows as minibatches are processed)
+//   buffer            buffer id; entries with the same id share memory
+//   liveInterval      [request step, release step] in the simulated forward/backward order; release -1 = never released
+//   recomputeInterval only for values recomputed before backprop (activation checkpointing): second live interval
+// This can be called again at any time, e.g. after the first minibatch, to update 'allocatedBytes'.
+void ComputationNetwork::WriteMemorySharingReport(const wstring& path) const
+{
+    static const char* policyNames[] = { "off", "lifo", "sizeAware" };
+    const auto& report = m_matrixPool.GetMemoryReport();
+    const auto& stats = m_matrixPool.GetAllocationPlanStatistics();
+
+    vector<size_t> numSharing(m_matrixPool.GetNumBuffers(), 0);
+    for (const auto& entry : report)
+        numSharing[entry.m_bufferId]++;
+
+    FILE* f = fopenOrDie(path, L"w");
+    fprintfOrDie(f, "{\n  \"policy\": \"%s\",\n", policyNames[(int)m_matrixPool.GetPolicy()]);
+    fprintfOrDie(f, "  \"summary\": { \"requests\": %llu, \"buffers\": %llu, \"unsharedBytesPerSample\": %llu, \"plannedPeakBytesPerSample\": %llu, \"allocatedBytesPerSample\": %llu },\n",
+                 (unsigned long long)stats.m_numRequests, (unsigned long long)stats.m_numBuffers, (unsigned long long)stats.m_requestedBytes,
+                 (unsigned long long)stats.m_plannedPeakBytes, (unsigned long long)stats.m_allocatedBytes);
+    fprintfOrDie(f, "  \"matrices\": [");
+    const char* delim = "\n";
+    for (const auto& entry : report)
+    {
+        fprintfOrDie(f, "%s    { \"node\": \"%s\", \"matrix\": \"%s\", \"bytesPerSample\": %llu, \"mbScale\": %s, \"allocatedBytes\": %llu, \"buffer\": %llu, \"sharedWith\": %llu, \"liveInterval\": [%llu, %lld]",
+                     delim, JsonEscape(entry.m_nodeName).c_str(), JsonEscape(entry.m_matrixName).c_str(),
+                     (unsigned long long)(entry.m_numElements * entry.m_elementSize), entry.m_mbScale ? "true" : "false",
+                     (unsigned long long)m_matrixPool.GetBufferAllocatedBytes(entry.m_bufferId),
+                     (unsigned long long)entry.m_bufferId, (unsigned long long)(numSharing[entry.m_bufferId] - 1),
+                     (unsigned long long)entry.m_allocStep, entry.m_releaseStep == SIZE_MAX ? -1LL : (long long)entry.m_releaseStep);
+        if (entry.m_recomputeAllocStep != SIZE_MAX)
+            fprintfOrDie(f, ", \"recomputeInterval\": [%llu, %lld]",
+                         (unsigned long long)entry.m_recomputeAllocStep, entry.m_recomputeReleaseStep == SIZE_MAX ? -1LL : (long long)entry.m_recomputeReleaseStep);
+        fprintfOrDie(f, " }");
+        delim = ",\n";
+    }
+    fprintfOrDie(f, "\n  ]\n}\n");
+    fcloseOrDie(f);
+}
+
+// determine which node values of the training criterion are recomputed right before backprop instead of being kept
+// The criterion's evaluation order is cut into consecutive segments after each checkpoint node, i.e. after the nodes
+// named in SetActivationCheckpoints() and after every m_activationCheckpointInterval-th non-leaf node. Within a segment,
+// a value that is needed during backprop is recomputed if
+//  - the node is a non-looping, sharable, non-leaf node whose ForwardProp() is repeatable (SupportsValueRecomputation()),
+//  - all its consumers in the criterion's evaluation order are in the same segment, and
+//  - its inputs are still alive at that time, i.e. they are leaves, kept, or recomputed earlier in the same segment.
+// Values that violate any of these conditions are kept (a released input is then kept alive as well, which is what
+// outputValueNeededDuringBackProp[] is updated for). Checkpoints can only sit on PAR nodes; loops are always kept.
+ComputationNetwork::ActivationRecomputationPlan ComputationNetwork::PlanActivationRecomputation(const ComputationNodeBasePtr& trainRootNode,
+                                                                                                 std::unordered_map<ComputationNodeBasePtr, bool>& outputValueNeededDuringBackProp,
+                                                                                                 const std::unordered_map<ComputationNodeBasePtr, std::unordered_set<ComputationNodeBasePtr>>& parentsMap)
+{
+    ActivationRecomputationPlan plan;
+    const auto& evalOrder = GetEvalOrder(trainRootNode);
+
+    std::unordered_set<ComputationNodeBasePtr> checkpoints;
+    for (const auto& name : m_activationCheckpointNodeNames)
+        checkpoints.insert(GetNodeFromName(name));
+
+    // cut into segments
+    size_t numNonLeaves = 0;
+    for (const auto& node : evalOrder)
+    {
+        if (plan.m_segmentFirstNodes.size() == plan.m_segmentLastNodes.size()) // previous segment is closed
+            plan.m_segmentFirstNodes.push_back(node);
+        plan.m_segmentOf[node] = plan.m_segmentFirstNodes.size() - 1;
+
+        bool isBoundary = false;
+        if (!node->IsLeaf() && !node->IsPartOfLoop())
+        {
+            numNonLeaves++;
+            bool isIntervalCheckpoint = m_activationCheckpointInterval > 0 && numNonLeaves % m_activationCheckpointInterval == 0;
+            if (isIntervalCheckpoint)
+                checkpoints.insert(node);
+            isBoundary = isIntervalCheckpoint || checkpoints.find(node) != checkpoints.end();
+        }
+        if (isBoundary || node == evalOrder.back())
+            plan.m_segmentLastNodes.push_back(node);
+    }
+    plan.m_recomputedNodes.resize(plan.m_segmentFirstNodes.size());
+
+    auto isRecomputable = [&](const ComputationNodeBasePtr& node)
+    {
+        return !node->IsLeaf() && !node->IsPartOfLoop() && node->IsValueSharable() && !node->RequiresPreCompute() &&
+               node->SupportsValueRecomputation() && checkpoints.find(node) == checkpoints.end();
+    };
+    auto isInSegment = [&](const ComputationNodeBasePtr& node, size_t segment)
+    {
+        auto iter = plan.m_segmentOf.find(node);
+        return iter != plan.m_segmentOf.end() && iter->second == segment;
+    };
+
+    // start with all values that would otherwise be kept for backprop, then iterate until consistent
+    std::unordered_set<ComputationNodeBasePtr> recomputed;
+    for (const auto& node : evalOrder)
+        if (outputValueNeededDuringBackProp[node] && isRecomputable(node))
+            recomputed.insert(node);
+
+    for (bool changed = true; changed;)
+    {
+        changed = false;
+        for (const auto& node : evalOrder)
+        {
+            if (recomputed.find(node) == recomputed.end())
+                continue;
+            size_t segment = plan.m_segmentOf.at(node);
+
+            // consumers outside the segment would find the value gone
+            bool isConsumedElsewhere = false;
+            auto parents = parentsMap.find(node);
+            if (parents != parentsMap.end())
+                for (const auto& parent : parents->second)
+                    if (plan.m_segmentOf.find(parent) != plan.m_segmentOf.end() && !isInSegment(parent, segment))
+                        isConsumedElsewhere = true;
+            if (isConsumedElsewhere)
+            {
+                recomputed.erase(node);
+                outputValueNeededDuringBackProp[node] = true;
+                changed = true;
+                continue;
+            }
+
+            // inputs must be available at recomputation time
+            for (const auto& input : node->GetInputs())
+            {
+                if (input->IsLeaf() || !input->IsValueSharable() || recomputed.find(input) != recomputed.end() || outputValueNeededDuringBackProp[input])
+                    continue;
+                // input is released after forward prop: recompute it as well if possible, otherwise keep it
+                if (isRecomputable(input) && isInSegment(input, segment))
+                    recomputed.insert(input);
+                else
+                    outputValueNeededDuringBackProp[input] = true;
+                changed = true;
+            }
+        }
+    }
+
+    for (const auto& node : evalOrder)
+    {
+        if (recomputed.find(node) != recomputed.end())
+        {
+            node->SetValueRecomputedBeforeBackprop(true);
+            plan.m_recomputedNodes[plan.m_segmentOf.at(node)].push_back(node);
+        }
+    }
+    return plan;
+}
+
+// choose the values that wait in host memory between forward prop and backprop (activation offloading)
+// Eligible are values of PAR nodes on the GPU that are kept for backprop and have minibatch data, selected by name or by
+// sample size. A value is copied after its last forward consumer, and its buffer is reused from the nested node after
+// the next one on, so there must be two nested nodes after that consumer.
+ComputationNetwork::ActivationOffloadPlan ComputationNetwork::PlanActivationOffloading(const ComputationNodeBasePtr& trainRootNode,
+                                                                                       const std::unordered_map<ComputationNodeBasePtr, bool>& outputValueNeededDuringBackProp,
+                                                                                       const std::unordered_map<ComputationNodeBasePtr, std::unordered_set<ComputationNodeBasePtr>>& parentsMap)
+{
+    ActivationOffloadPlan plan;
+    const auto& evalOrder = GetEvalOrder(trainRootNode);
+
+    // nested nodes as in PARTraversalFlowControlNode
+    std::unordered_map<ComputationNodeBasePtr, size_t> nestedIndexOf;
+    for (const auto& node : evalOrder)
+    {
+        ComputationNodeBasePtr nestedNode = node->IsPartOfLoop() ? FindInRecurrentLoops(m_allSEQNodes, node) : node;
+        if (plan.m_nestedNodes.empty() || plan.m_nestedNodes.back() != nestedNode)
+            plan.m_nestedNodes.push_back(nestedNode);
+        nestedIndexOf[node] = plan.m_nestedNodes.size() - 1;
+    }
+
+    std::set<std::wstring> selectedNames(m_activationOffloadNodeNames.begin(), m_activationOffloadNodeNames.end());
+    for (const auto& node : evalOrder)
+    {
+        if (node->IsLeaf() || node->IsPartOfLoop() || !node->IsValueSharable() || node->GetDeviceId() < 0 || !node->HasMBLayout())
+            continue;
+        auto needed = outputValueNeededDuringBackProp.find(node);
+        if (needed == outputValueNeededDuringBackProp.end() || !needed->second)
+            continue;
+        bool selected = selectedNames.find(node->NodeName()) != selectedNames.end() ||
+                        (m_activationOffloadMinSampleSize > 0 && node->GetSampleLayout().GetNumElements() >= m_activationOffloadMinSampleSize);
+        if (!selected)
+            continue;
+
+        // last forward consumer; all consumers must be computed by the criterion's forward prop
+        auto parents = parentsMap.find(node);
+        if (parents == parentsMap.end() || parents->second.empty())
+            continue;
+        size_t lastConsumer = 0;
+        bool allConsumersInCriterion = true;
+        for (const auto& parent : parents->second)
+        {
+            auto index = nestedIndexOf.find(parent);
+            if (index == nestedIndexOf.end())
+                allConsumersInCriterion = false;
+            else
+                lastConsumer = max(lastConsumer, index->second);
+        }
+        if (!allConsumersInCriterion || lastConsumer + 2 >= plan.m_nestedNodes.size())
+            continue;
+
+        plan.m_offloadedNodes.push_back(make_pair(node, lastConsumer));
+        plan.m_offloadedNodeSet.insert(node);
+    }
+    return plan;
 }
 
 void ComputationNetwork::ReleaseMatricesAfterEvalForChildren(ComputationNodeBasePtr n, std::unordered_map<ComputationNodeBasePtr, int>& parentCount)
 {
-    for (int i = 0; i < n->GetNumInputs(); i++)
+    const auto& inputs = n->GetInputs();
+    for (int i = 0; i < inputs.size(); i++)
     {
-        ComputationNodeBasePtr pNode = n->GetInputs()[i];
+        ComputationNodeBasePtr pNode = inputs[i];
+        // parentCount counts each parent once, also one that takes the same input twice, e.g. ElementTimes(x, x)
+        if (std::find(inputs.begin(), inputs.begin() + i, pNode) != inputs.begin() + i)
+            continue;
         parentCount[pNode]--;
         if (parentCount[pNode] == 0)
             pNode->ReleaseMatricesAfterForwardProp(m_matrixPool);
@@ -17,6 +17,7 @@
 
 #include "ComputationNetwork.h"
 #include "ComputationNetworkBuilder.h"
+#include "TimerUtility.h"
 
 #include <memory>
 #include <deque>
@@ -50,6 +51,11 @@ ComputationNetwork::ComputationNetwork(const IConfigRecordPtr configp) :
 
     deque<ComputationNodeBasePtr> workList;
 
+    // Resolving the members evaluates the BrainScript that creates the nodes, which, for large generated networks,
+    // can take longer than anything later on. With traceLevel > 0, we report the time of this and of the construction.
+    Timer timer;
+    timer.Start();
+
     // process 'special nodes'
     ProcessSpecialNodes(config, workList);
 
@@ -74,6 +80,10 @@ ComputationNetwork::ComputationNetwork(const IConfigRecordPtr configp) :
 
     // TODO: process "outputNodes" etc. arrays: Sync to node Tags, and make them all roots.
 
+    timer.Stop();
+    if (TraceLevel() > 0)
+        fprintf(stderr, "ComputationNetwork: Evaluated the BrainScript of %d root nodes in %.3f seconds.\n", (int)workList.size(), timer.ElapsedSeconds());
+
     // construct from roots
     ConstructFromRoots(deviceId, move(workList), map<ComputationNodeBasePtr, ComputationNodeBasePtr>()/*no mapping*/);
 }
@@ -108,6 +118,9 @@ void ComputationNetwork::ConstructFromRoots(DEVICEID_TYPE deviceId, deque<Comput
     SetDeviceId(deviceId);
     assert(this->GetTotalNumberOfNodes() == 0);
 
+    Timer timer;
+    timer.Start();
+
     // replace if requested
     // This happens for model editing.
     // workList operates on mapped nodes.
@@ -148,6 +161,9 @@ void ComputationNetwork::ConstructFromRoots(DEVICEID_TYPE deviceId, deque<Comput
         }
 
         // add it to the respective node groups based on the tags
+        // The network started out empty and each node gets here once, so it cannot be in the group of one of its tags yet,
+        // except through a legacy tag mapped to another of its tags. This saves AddToNodeGroup()'s search of the group.
+        let hasLegacyTags = node->HasTag(L"criteria") || node->HasTag(L"eval");
         for (auto tag : node->GetTags())
         {
 #if 1       // we keep this for a while (we already verified that our samples no longer use this)
@@ -155,7 +171,10 @@ void ComputationNetwork::ConstructFromRoots(DEVICEID_TYPE deviceId, deque<Comput
             if      (tag == L"criteria") tag = L"criterion";
             else if (tag == L"eval"    ) tag = L"evaluation";
 #endif
-            AddToNodeGroup(tag, node); // tag may be empty, or may have been set by array parameters
+            if (hasLegacyTags)
+                AddToNodeGroup(tag, node); // tag may be empty, or may have been set by array parameters
+            else
+                GetNodeGroup(tag).push_back(node); // (the node has the tag already)
         }
 
         // traverse children: append them to the end of the work list
@@ -180,6 +199,10 @@ void ComputationNetwork::ConstructFromRoots(DEVICEID_TYPE deviceId, deque<Comput
     if (TraceLevel() > 0 && numRelinked > 0)
         fprintf(stderr, "ConstructFromRoots: %d references were remapped.", (int)numRelinked);
 
+    timer.Stop();
+    if (TraceLevel() > 0)
+        fprintf(stderr, "ConstructFromRoots: Collected %d nodes in %.3f seconds.\n", (int)GetTotalNumberOfNodes(), timer.ElapsedSeconds());
+
     // perform all necessary post-processing
     CompileNetwork();
 }
@@ -195,16 +218,23 @@ void ComputationNetwork::ConstructFromRoots(DEVICEID_TYPE deviceId, deque<Comput
 void /*CustomConfigRecord::*/ ComputationNetwork::LazyCreateConfigMember(const wstring& id) const /*override*/
 {
     auto iter = m_nameToNodeMap.find(id);
-    if (iter == m_nameToNodeMap.end())
+    ComputationNodeBasePtr node;
+    if (iter != m_nameToNodeMap.end())
+        node = iter->second;
+    else
     {
         // workaround to allow to access members with '.' inside: change to _
-        for (iter = m_nameToNodeMap.begin(); iter != m_nameToNodeMap.end(); iter++)
-            if (msra::strfun::ReplaceAll<wstring>(iter->first, L".", L"_") == id)
-                break;
-        if (iter == m_nameToNodeMap.end())
+        // The names are translated once into an index, instead of all of them again for each lookup.
+        if (m_configNameToNodeMap.empty())
+        {
+            for (let& nameAndNode : m_nameToNodeMap)
+                m_configNameToNodeMap.insert(make_pair(msra::strfun::ReplaceAll<wstring>(nameAndNode.first, L".", L"_"), nameAndNode.second)); // (the first one wins, as in a search)
+        }
+        auto configIter = m_configNameToNodeMap.find(id);
+        if (configIter == m_configNameToNodeMap.end())
             return; // no such node
+        node = configIter->second;
     }
-    const ComputationNodeBasePtr& node = iter->second;
     // TODO: What is the expressionPath?
     let& nodeName = node->NodeName();   // failFn lambda below holds a copy of the name for the error message. Let's not hold an unneccessary shared_ptr to the node, risking cycles & stuff.
     auto valuep = ConfigValuePtr(node, [nodeName](const std::wstring &) { LogicError("ComputationNetwork: Failed to retrieve node '%ls'.", nodeName.c_str()); }, node->NodeName());
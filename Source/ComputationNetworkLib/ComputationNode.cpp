@@ -514,28 +514,37 @@ void ComputationNode<ElemType>::WriteMinibatchWithFormatting(FILE* f, const Fram
                                                              string valueFormatString,
                                                              bool outputGradient) const
 {
-    // get minibatch matrix -> matData, matRows, matStride
+    // get minibatch matrix -> matData
     const Matrix<ElemType>& outputValues = outputGradient ? Gradient() : Value();
-    let matRows   = outputValues.GetNumRows();
-    let matStride = matRows; // how to get from one column to the next
     unique_ptr<ElemType[]> matDataPtr(outputValues.CopyToArray());
-    ElemType* matData = matDataPtr.get();
-    let sampleLayout = GetSampleLayout(); // this is currently only used for sparse; dense tensors are linearized
+    WriteValuesWithFormatting(f, matDataPtr.get(), outputValues.GetNumRows(), outputValues.GetNumCols(), GetMBLayout(), GetSampleLayout(), fr,
+                              onlyUpToRow, onlyUpToT, transpose, isCategoryLabel, isSparse, labelMapping,
+                              sequenceSeparator, sequencePrologue, sequenceEpilogue, elementSeparator, sampleSeparator,
+                              valueFormatString);
+}
+
+template <class ElemType>
+/*static*/ void ComputationNode<ElemType>::WriteValuesWithFormatting(FILE* f, ElemType* matData, size_t matRows, size_t matCols, MBLayoutPtr pMBLayout, const TensorShape& sampleLayout,
+                                                                   const FrameRange& fr, size_t onlyUpToRow, size_t onlyUpToT, bool transpose, bool isCategoryLabel, bool isSparse,
+                                                                   const vector<string>& labelMapping, const string& sequenceSeparator,
+                                                                   const string& sequencePrologue, const string& sequenceEpilogue,
+                                                                   const string& elementSeparator, const string& sampleSeparator,
+                                                                   string valueFormatString)
+{
+    let matStride = matRows; // how to get from one column to the next
 
     // process all sequences one by one
-    MBLayoutPtr pMBLayout = GetMBLayout();
     if (!pMBLayout) // no MBLayout: We are printing aggregates (or LearnableParameters?)
     {
         pMBLayout = make_shared<MBLayout>();
-        pMBLayout->Init(1, outputValues.GetNumCols()); // treat this as if we have one single sequence consisting of the columns
-        pMBLayout->AddSequence(0, 0, 0, outputValues.GetNumCols());
+        pMBLayout->Init(1, matCols); // treat this as if we have one single sequence consisting of the columns
+        pMBLayout->AddSequence(0, 0, 0, matCols);
     }
     let& sequences = pMBLayout->GetAllSequences();
     let  width     = pMBLayout->GetNumTimeSteps();
 
-    TensorShape tensorShape = GetSampleLayout();
     stringstream str;
-    let dims = tensorShape.GetDims();
+    let dims = sampleLayout.GetDims();
     for (auto dim : dims)
         str << dim << ' ';
     let shape = str.str(); // BUGBUG: change to string(tensorShape) to make sure we always use the same format
@@ -603,7 +612,7 @@ void ComputationNode<ElemType>::WriteMinibatchWithFormatting(FILE* f, const Fram
         {
             if (formatChar == 's') // verify label dimension
             {
-                if (outputValues.GetNumRows() != labelMapping.size() &&
+                if (matRows != labelMapping.size() &&
                     sampleLayout[0] != labelMapping.size()) // if we match the first dim then use that
                 {
                     static size_t warnings = 0;
@@ -48,7 +48,9 @@
 #define CNTK_MODEL_VERSION_16 16 // save/load rng state for Dropout and RandomSample nodes.
 #define CNTK_MODEL_VERSION_17 17 // use 8 bytes for rng seeds on both platforms
 #define CNTK_MODEL_VERSION_18 18 // reserving 18 for dilated convolution, write out one more TensorShape 
-#define CURRENT_CNTK_MODEL_VERSION CNTK_MODEL_VERSION_18
+#define CNTK_MODEL_VERSION_19 19 // add new node: ContextWindowNode
+#define CNTK_MODEL_VERSION_20 20 // calibrated data range in QuantizedTimesNode
+#define CURRENT_CNTK_MODEL_VERSION CNTK_MODEL_VERSION_20
 
 
 // helper mode for debugging
@@ -63,7 +65,8 @@ enum CopyNodeFlags // flags to be passed to the CopyTo() function
     copyNodeValue          = 1, // copy everything except for the input links
     copyNodeInputLinks     = 2, // copy over input links
     copyNodeAll            = 3, // copy everything
-    copyNodeAcrossNetworks = 4  // allow a cross network child copy
+    copyNodeAcrossNetworks = 4, // allow a cross network child copy
+    copyNodeShareValue     = 8  // with copyNodeValue: share the value matrix instead of copying it, and no gradient
 };
 
 #pragma region base computation class
@@ -195,6 +198,10 @@ struct ComputationNetworkOwnedNodeState
 
     virtual bool ImplementsGradientOverwriteOptimization() const { return false; }
 
+    // Can the value be recomputed from the inputs right before backprop and still give the same result? (activation checkpointing)
+    // Override to false for nodes that draw random numbers or update internal state in ForwardProp().
+    virtual bool SupportsValueRecomputation() const { return true; }
+
 protected:                // TODO: should be fully encapsulated here
     bool m_needsGradient; // true if this node or any children need a gradient to be computed (for own consumption or propagation to somewhere in the child tree)
 
@@ -302,7 +309,7 @@ public:
     // -----------------------------------------------------------------------
 
     ComputationNodeBase(DEVICEID_TYPE deviceId, const wstring& name) :
-        m_deviceId(deviceId), m_outputNeededDuringBackprop(true), m_learningRateMultiplier(0),
+        m_deviceId(deviceId), m_outputNeededDuringBackprop(true), m_valueRecomputedBeforeBackprop(false), m_valueElided(false), m_learningRateMultiplier(0),
         m_gradientInitialized(false), m_nodeName(name == L"" ? CreateUniqNodeName() : name)
     {
         // TODO: should m_learningRateMultiplier be set to 0? Or should every node have a way to add its own say on the learning rate for all its inputs?
@@ -763,6 +770,10 @@ public:
             Input(i)->m_gradientInitialized = false;
     }
 
+    // undo the above for this node, so that the next backprop adds to its current gradient (gradient accumulation)
+    void KeepGradient() { m_gradientInitialized = true; }
+    bool IsGradientInitialized() const { return m_gradientInitialized; }
+
     // -----------------------------------------------------------------------
     // masking
     // -----------------------------------------------------------------------
@@ -773,6 +784,22 @@ public:
     virtual void InvalidateMissingValueColumns(const FrameRange&) = 0;
     virtual void InvalidateMissingGradientColumns(const FrameRange&) = 0;
 
+    // -----------------------------------------------------------------------
+    // cost estimates, see ComputationNodeProfiler
+    // -----------------------------------------------------------------------
+
+    // Estimated floating-point operations and bytes read and written for the current minibatch by ForwardProp()
+    // (forward) or by BackpropTo() of all inputs that need a gradient (!forward).
+    // Returns false if the node has no estimate. Overridden by the nodes that typically dominate the cost.
+    virtual bool EstimateCost(bool /*forward*/, double& /*flops*/, double& /*bytes*/) const { return false; }
+
+    // number of elements of the value of this node for the current minibatch, from its sample layout and MB layout
+    // (the matrices may not be allocated when this is needed)
+    double GetNumMinibatchElements() const
+    {
+        return (double) GetSampleLayout().GetNumElements() * (HasMBLayout() ? m_pMBLayout->GetNumCols() : 1);
+    }
+
     // -----------------------------------------------------------------------
     // memory sharing
     // -----------------------------------------------------------------------
@@ -790,10 +817,45 @@ public:
     void SetOutputNeededDuringBackprop(bool f) { m_outputNeededDuringBackprop = f; }
     bool IsOutputNeededDuringBackprop() const 
     { 
+        if (m_valueRecomputedBeforeBackprop) // value is released after forward prop and recomputed before backprop
+            return false;
         return (!Globals::ShouldEnableShareNodeValueMatrices() && !Globals::ShouldEnableHyperCompressMemory())
             || m_outputNeededDuringBackprop; 
     }
 
+    // activation checkpointing: set by ComputationNetwork::AllocateAllMatrices() for nodes whose value is recomputed
+    void SetValueRecomputedBeforeBackprop(bool f) { m_valueRecomputedBeforeBackprop = f; }
+    bool IsValueRecomputedBeforeBackprop() const { return m_valueRecomputedBeforeBackprop; }
+
+    // concatenation elimination and transpose absorption: set by ComputationNetwork::ElideInputs() for a node whose only consumer computes
+    // directly from the node's inputs. ForwardProp() and BackpropTo() then do nothing, and value and gradient stay empty.
+    void SetValueElided(bool f) { m_valueElided = f; }
+    bool IsValueElided() const { return m_valueElided; }
+
+    // The op if ForwardProp() is a single elementwise TensorOp of all inputs, e.g. opSum for Plus, else opNone.
+    // ComputationNetwork::FuseElementwiseChains() fuses chains of such nodes for inference.
+    virtual ElementWiseOperator ForwardElementwiseOp() const { return opNone; }
+
+    // fast-math inference: ForwardProp() computes an approximation of its op from now on, see FastMathOpOf().
+    // Returns false if the node has none. Called by ComputationNetwork::EnableFastMath().
+    virtual bool EnableFastMath() { return false; }
+
+    // ForwardProp() may write the value over that of input 0, which has the same size and MBLayout. Whether it does is
+    // decided by ComputationNetwork::AllocateAllMatrices(), see EnableInPlaceExecution().
+    virtual bool ForwardPropCanRunInPlace() const { return false; }
+
+    // re-acquire/release the value matrix around recomputation (only for nodes with IsValueRecomputedBeforeBackprop()),
+    // or around the copy back of an offloaded value (see ActivationOffloader)
+    virtual void RequestMatricesBeforeRecompute(MatrixPool& /*matrixPool*/) { LogicError("RequestMatricesBeforeRecompute: not supported by %ls.", NodeName().c_str()); }
+    virtual void ReleaseMatricesAfterRecompute(MatrixPool& /*matrixPool*/) { LogicError("ReleaseMatricesAfterRecompute: not supported by %ls.", NodeName().c_str()); }
+    // activation offloading: release the value matrix once its copy to host memory is under way
+    virtual void ReleaseMatricesAfterOffload(MatrixPool& /*matrixPool*/) { LogicError("ReleaseMatricesAfterOffload: not supported by %ls.", NodeName().c_str()); }
+    // forward-only allocation (no backprop follows): release the temp matrices that RequestMatricesBeforeForwardProp()
+    // requested and only ReleaseMatricesAfterBackprop() would release, right after the node's own forward prop
+    virtual void ReleaseMatricesKeptForBackprop(MatrixPool& /*matrixPool*/) { }
+    // in-place execution: take over the value matrix of input 0 instead of requesting a new one; false if not possible
+    virtual bool RequestMatricesBeforeForwardPropInPlace(MatrixPool& /*matrixPool*/) { return false; }
+
     // -----------------------------------------------------------------------
     // helpers for network traversal
     // -----------------------------------------------------------------------
@@ -802,13 +864,37 @@ public:
     // This creates a list such that children are evaluated before their parents.
     // If !forForwardProp then the order will be reversed, suitable for backprop.
     // TODO: This should be a method of ComputationNetwork, not ComputationNode.
+    // The traversal uses an explicit stack, since unrolled networks can be deeper than the call stack.
     static std::list<ComputationNodeBasePtr> EnumerateNodes(const std::vector<ComputationNodeBasePtr>& allRoots)
     {
         std::list<ComputationNodeBasePtr> nodes;
         std::unordered_set<ComputationNodeBasePtr> visited;
+        std::vector<std::pair<ComputationNodeBasePtr, size_t>> stack; // [node, index of its next input to visit]
 
         for (const auto& root : allRoots)
-            root->EnumerateNodesRec(visited, nodes); // call into the recursive portion of this function below
+        {
+            if (!visited.insert(root).second) // do not include a node twice
+                continue;
+            stack.push_back(std::make_pair(root, (size_t)0));
+            while (!stack.empty())
+            {
+                const auto& inputs = stack.back().first->m_inputs;
+                size_t& i = stack.back().second;
+                if (i < inputs.size())
+                {
+                    // children first for function evaluation
+                    const auto& input = inputs[i++];
+                    if (input && visited.insert(input).second)
+                        stack.push_back(std::make_pair(input, (size_t)0));
+                }
+                else
+                {
+                    // now that all children are in list before us, put ourselves
+                    nodes.push_back(stack.back().first);
+                    stack.pop_back();
+                }
+            }
+        }
 
         return nodes;
     }
@@ -819,24 +905,6 @@ public:
         return EnumerateNodes(std::vector<ComputationNodeBasePtr>{shared_from_this()});
     }
 
-private:
-    // Recursive part of EnumerateNodes().
-    void EnumerateNodesRec(std::unordered_set<ComputationNodeBasePtr>& visited, std::list<ComputationNodeBasePtr>& result) /*const*/ // const not working due to shared_from_this()
-    {
-        if (visited.find(shared_from_this()) == visited.end()) // do not include a node twice
-        {
-            visited.insert(shared_from_this()); // have visited tagged here to avoid infinite loop over children, children's children, etc
-
-            // children first for function evaluation
-            for (int i = 0; i < m_inputs.size(); i++)
-                if (m_inputs[i])
-                    m_inputs[i]->EnumerateNodesRec(visited, result);
-
-            // now that all children are in list before us, put ourselves
-            result.push_back(shared_from_this());
-        }
-    }
-
 public:
     // -----------------------------------------------------------------------
     // scripting integration
@@ -920,6 +988,8 @@ protected:
     float m_learningRateMultiplier;    // update parameters? Only used for LearnableParameters.    --TODO: Should we make this a member of LearnableParameters actually? And require a type cast? Currently it is read out for all leaves.
     bool m_gradientInitialized;        // indicates whether the gradient matrix has been resized and initialized to 0
     bool m_outputNeededDuringBackprop; // indicates whether the output value of the node is needed during backprop
+    bool m_valueRecomputedBeforeBackprop; // activation checkpointing: value is not kept from forward prop but recomputed before backprop
+    bool m_valueElided;                   // concatenation elimination: value and gradient are never computed, see SetValueElided()
 };
 typedef ComputationNodeBase::ComputationNodeBasePtr ComputationNodeBasePtr;
 
@@ -1158,6 +1228,15 @@ struct ITakesDynamicAxis
     virtual const std::wstring GetRequestedDynamicAxis() const = 0;
 };
 
+// =======================================================================
+// Nodes that serialize values of their element type outside of matrices (which store their element size) need to
+// implement this, so that they can be loaded from a model of the other precision, see ComputationNetwork::Read().
+// =======================================================================
+struct IConvertsPrecisionOnLoad
+{
+    virtual void SetFileElementSize(size_t elementSize) = 0;
+};
+
 // =======================================================================
 // ComputationNode -- abstract base class for computation nodes, deriving
 // from CompuationNodeBase, parameterized by float vs. double
@@ -1209,6 +1288,12 @@ public:
         if (flags & CopyNodeFlags::copyNodeValue)
         {
             auto node = DownCast(nodeP);
+            if (flags & CopyNodeFlags::copyNodeShareValue)
+            {
+                node->m_value = m_value;
+                node->m_gradient = nullptr;
+                return;
+            }
             if (m_value)
             {
                 node->CreateValueMatrixIfNull();
@@ -1566,7 +1651,12 @@ private:
     // determine the size that we should set our Matrix storage to
     void DetermineDataSize(size_t& rows, size_t& cols) const
     {
-        if (HasMBLayout())
+        if (IsValueElided())
+        {
+            rows = 0;
+            cols = 0;
+        }
+        else if (HasMBLayout())
         {
             rows = GetSampleMatrixNumRows();
             cols = GetSampleMatrixNumCols();
@@ -1768,20 +1858,51 @@ public:
     // request matrices needed to do node function value evaluation
     virtual void RequestMatricesBeforeForwardProp(MatrixPool& matrixPool) override
     {
-        if (IsValueSharable())
-            RequestMatrixFromPool(m_value, matrixPool);
+        if (IsValueSharable() && !IsValueElided())
+            RequestMatrixFromPool(m_value, matrixPool, GetSampleLayout().GetNumElements(), HasMBLayout());
         else
             CreateMatrixIfNull(m_value);
     }
 
+    // in-place execution: share the value matrix of input 0, see ForwardPropCanRunInPlace()
+    // Afterwards, RequestMatricesBeforeForwardProp() finds the value in place, and releasing the input's value does nothing.
+    virtual bool RequestMatricesBeforeForwardPropInPlace(MatrixPool& matrixPool) override
+    {
+        auto input = m_inputs.size() == 1 ? dynamic_pointer_cast<ComputationNode<ElemType>>(m_inputs[0]) : nullptr;
+        if (!input || m_value || !IsValueSharable() || !input->IsValueSharable() || !input->m_value || input->m_value->GetMatrixType() != DENSE ||
+            input->GetDeviceId() != m_deviceId || input->GetMBLayout() != GetMBLayout() ||
+            input->GetSampleLayout().GetNumElements() != GetSampleLayout().GetNumElements())
+            return false;
+        return matrixPool.RequestInPlace<ElemType>(&m_value, &input->m_value, NodeName(), L"value");
+    }
+
     // release temp matrices that are only used by forward computation
     // don't release matrices that need to be used in the gradient computation
     virtual void ReleaseMatricesAfterForwardProp(MatrixPool& matrixPool) override
     {
-        if (!IsOutputNeededDuringBackprop() && (m_value->GetMatrixType() != SPARSE) && IsValueSharable())
+        if (!IsOutputNeededDuringBackprop() && (m_value->GetMatrixType() != SPARSE) && IsValueSharable() && !IsValueElided())
             ReleaseMatrixToPool(m_value, matrixPool);
     }
 
+    // activation checkpointing: the value gets a second lifetime from its recomputation until the end of its segment's backprop
+    // (activation offloading: from its copy back until its own backprop)
+    virtual void RequestMatricesBeforeRecompute(MatrixPool& matrixPool) override
+    {
+        matrixPool.RequestForRecompute<ElemType>(&m_value);
+    }
+
+    virtual void ReleaseMatricesAfterRecompute(MatrixPool& matrixPool) override
+    {
+        ReleaseMatrixToPool(m_value, matrixPool);
+    }
+
+    // activation offloading: the value's first lifetime ends while it waits in host memory; the second starts before
+    // it is copied back, see RequestMatricesBeforeRecompute()
+    virtual void ReleaseMatricesAfterOffload(MatrixPool& matrixPool) override
+    {
+        ReleaseMatrixToPool(m_value, matrixPool);
+    }
+
     virtual void AllocateGradientMatricesForInputs(MatrixPool& matrixPool) override
     {
         for (int i = 0; i < m_inputs.size(); i++)
@@ -1794,13 +1915,16 @@ public:
     // request matrices that are needed for gradient computation
     virtual void RequestMatricesBeforeBackprop(MatrixPool& matrixPool) override
     {
-        RequestMatrixFromPool(m_gradient, matrixPool);
+        if (IsValueElided())
+            CreateMatrixIfNull(m_gradient);
+        else
+            RequestMatrixFromPool(m_gradient, matrixPool, GetSampleLayout().GetNumElements(), HasMBLayout());
     }
 
     // release gradient and temp matrices that no longer needed after all the children's gradients are computed.
     virtual void ReleaseMatricesAfterBackprop(MatrixPool& matrixPool) override
     {
-        if (!IsLeaf() && !RequiresPreCompute())
+        if (!IsLeaf() && !RequiresPreCompute() && !IsValueElided())
         {
             if (m_gradient != nullptr && m_gradient->GetMatrixType() != SPARSE) // since we don't have a sparse pool yet
                 ReleaseMatrixToPool(m_gradient, matrixPool);
@@ -1839,18 +1963,20 @@ protected:
             matrixPtr = make_shared<Matrix<ElemType>>(m_deviceId);
     }
 
-    void RequestMatrixFromPool(shared_ptr<Matrix<ElemType>>& matrixPtr, MatrixPool& matrixPool)
+    // 'matrixSize' is the number of elements (per sample if 'mbScale'); it is used for size-aware sharing, 0 means unknown
+    void RequestMatrixFromPool(shared_ptr<Matrix<ElemType>>& matrixPtr, MatrixPool& matrixPool, size_t matrixSize = 0, bool mbScale = true)
     {
         if (matrixPtr == nullptr)
         {
-            matrixPtr = matrixPool.Request<ElemType>(m_deviceId);
+            const wchar_t* matrixName = &matrixPtr == &m_value ? L"value" : &matrixPtr == &m_gradient ? L"gradient" : L"temp";
+            matrixPool.Request<ElemType>(m_deviceId, &matrixPtr, matrixSize, mbScale, NodeName(), matrixName);
         }
     }
 
     void ReleaseMatrixToPool(shared_ptr<Matrix<ElemType>>& matrixPtr, MatrixPool& matrixPool)
     {
         assert(matrixPtr != nullptr);
-        matrixPool.Release<ElemType>(matrixPtr);
+        matrixPool.Release<ElemType>(&matrixPtr);
     }
 
 public:
@@ -1867,6 +1993,14 @@ public:
                                       const std::string& sampleSeparator, std::string valueFormatString,
                                       bool outputGradient = false) const;
 
+    // same for a minibatch that has already been copied to the CPU, e.g. to format it while the next minibatch is computed
+    // Note: matData is modified in-place for category labels.
+    static void WriteValuesWithFormatting(FILE* f, ElemType* matData, size_t matRows, size_t matCols, MBLayoutPtr pMBLayout, const TensorShape& sampleLayout,
+                                          const FrameRange& fr, size_t onlyUpToRow, size_t onlyUpToT, bool transpose, bool isCategoryLabel, bool isSparse,
+                                          const std::vector<std::string>& labelMapping, const std::string& sequenceSeparator,
+                                          const std::string& sequencePrologue, const std::string& sequenceEpilogue, const std::string& elementSeparator,
+                                          const std::string& sampleSeparator, std::string valueFormatString);
+
     // simple helper to log the content of a minibatch
     void DebugLogMinibatch(bool outputGradient = false) const
     {
@@ -2119,6 +2253,22 @@ public:
     // non-looping node types instead implement these functions
     virtual void ForwardPropNonLooping() = 0;
     virtual void BackpropToNonLooping(size_t inputIndex) = 0;
+
+protected:
+    // the sequences of a minibatch in the form expected by the batched R-CRF functions, e.g. Matrix::RCRFForwardBackward()
+    std::vector<CRFSequence> GetCRFSequences(const MBLayoutPtr& pMBLayout) const
+    {
+        std::vector<CRFSequence> sequences;
+        for (const auto& seq : pMBLayout->GetAllSequences())
+        {
+            if (seq.seqId == GAP_SEQUENCE_ID)
+                continue;
+            if (seq.tBegin < 0 || seq.tEnd > pMBLayout->GetNumTimeSteps())
+                InvalidArgument("%ls: Sequences must be entirely contained in the minibatch (no truncated BPTT).", Base::NodeDescription().c_str());
+            sequences.push_back(CRFSequence{ (int) seq.s, (int) seq.tBegin, (int) seq.GetNumTimeSteps() });
+        }
+        return sequences;
+    }
 };
 
 // =======================================================================
@@ -2288,6 +2438,7 @@ protected:
     using Base::IsLeaf;                                                                                                                                  \
     using Base::IsOutOfDateWrtInputs;                                                                                                                    \
     using Base::IsPartOfLoop;                                                                                                                            \
+    using Base::IsValueElided;                                                                                                                           \
     using Base::LinkToMBLayout;                                                                                                                          \
     using Base::Load;                                                                                                                                    \
     using Base::LoadValue;                                                                                                                               \
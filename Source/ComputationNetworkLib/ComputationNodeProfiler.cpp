@@ -0,0 +1,132 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE.md file in the project root for full license information.
+//
+
+#define _CRT_SECURE_NO_WARNINGS // "secure" CRT not available on all platforms  --add this at the top of all CPP files that give "function or variable may be unsafe" warnings
+
+#include "Basics.h"
+#include "ComputationNodeProfiler.h"
+#include "ComputationNode.h"
+#include "MatrixQuantizerImpl.h" // for MatrixComputeStreamEvent
+#include <algorithm>
+
+using namespace std;
+
+namespace Microsoft { namespace MSR { namespace CNTK {
+
+// waits for all work queued on the device so far
+static void SynchronizeDevice(DEVICEID_TYPE deviceId)
+{
+    if (deviceId < 0)
+        return;
+    unique_ptr<MatrixComputeStreamEvent> event(MatrixComputeStreamEvent::Create(deviceId));
+    event->SynchronizeEvent();
+}
+
+ComputationNodeProfiler::Scope::Scope(ComputationNodeProfiler* profiler, const ComputationNodeBasePtr& node, bool forward)
+    : m_profiler(profiler), m_node(node), m_forward(forward)
+{
+    if (!m_profiler)
+        return;
+    SynchronizeDevice(m_profiler->m_deviceId);
+    m_timer.Start();
+}
+
+ComputationNodeProfiler::Scope::~Scope()
+{
+    if (!m_profiler)
+        return;
+    SynchronizeDevice(m_profiler->m_deviceId);
+    m_timer.Stop();
+    m_profiler->Record(m_node, m_forward, m_timer.ElapsedSeconds());
+}
+
+void ComputationNodeProfiler::Record(const ComputationNodeBasePtr& node, bool forward, double seconds)
+{
+    auto iter = m_stats.find(node);
+    if (iter == m_stats.end())
+    {
+        iter = m_stats.insert(make_pair(node, Stats())).first;
+        iter->second.m_name = node->NodeName();
+        iter->second.m_operation = node->OperationName();
+    }
+    auto& stats = iter->second;
+
+    if (forward)
+        stats.m_forwardSeconds += seconds;
+    else
+        stats.m_backwardSeconds += seconds;
+
+    double flops = 0, bytes = 0;
+    if (node->EstimateCost(forward, flops, bytes))
+    {
+        stats.m_flops += flops;
+        stats.m_bytes += bytes;
+        stats.m_hasCost = true;
+    }
+}
+
+/*static*/ void ComputationNodeProfiler::LogTable(FILE* f, const char* title, vector<Stats> rows, size_t maxNumRows, size_t numMinibatches, double totalSeconds)
+{
+    sort(rows.begin(), rows.end(), [](const Stats& a, const Stats& b) { return a.Seconds() > b.Seconds(); });
+    if (rows.size() > maxNumRows)
+        rows.resize(maxNumRows);
+
+    fprintf(f, "  %-40s %6s %12s %12s %7s %10s %10s\n", title, "nodes", "forward[ms]", "backward[ms]", "share", "GFLOP/s", "GB/s");
+    for (const auto& row : rows)
+    {
+        wstring name = row.m_name.size() > 40 ? row.m_name.substr(0, 37) + L"..." : row.m_name;
+        fprintf(f, "  %-40ls %6d %12.3f %12.3f %6.1f%%", name.c_str(), (int) row.m_numNodes,
+                1000 * row.m_forwardSeconds / numMinibatches, 1000 * row.m_backwardSeconds / numMinibatches,
+                totalSeconds > 0 ? 100 * row.Seconds() / totalSeconds : 0.0);
+        if (row.m_hasCost && row.Seconds() > 0)
+            fprintf(f, " %10.2f %10.2f\n", row.m_flops / row.Seconds() / 1e9, row.m_bytes / row.Seconds() / 1e9);
+        else
+            fprintf(f, " %10s %10s\n", "-", "-");
+    }
+}
+
+void ComputationNodeProfiler::LogSummary(FILE* f, size_t numMinibatches, size_t maxNumNodes) const
+{
+    if (m_stats.empty() || numMinibatches == 0)
+        return;
+
+    double totalSeconds = 0;
+    map<wstring, Stats> operations;
+    vector<Stats> nodes;
+    for (const auto& entry : m_stats)
+    {
+        const auto& stats = entry.second;
+        totalSeconds += stats.Seconds();
+        nodes.push_back(stats);
+
+        auto iter = operations.find(stats.m_operation);
+        if (iter == operations.end())
+        {
+            Stats sum = stats;
+            sum.m_name = stats.m_operation;
+            operations[stats.m_operation] = sum;
+            continue;
+        }
+        auto& sum = iter->second;
+        sum.m_numNodes++;
+        sum.m_forwardSeconds += stats.m_forwardSeconds;
+        sum.m_backwardSeconds += stats.m_backwardSeconds;
+        sum.m_flops += stats.m_flops;
+        sum.m_bytes += stats.m_bytes;
+        sum.m_hasCost |= stats.m_hasCost;
+    }
+
+    vector<Stats> operationRows;
+    for (const auto& entry : operations)
+        operationRows.push_back(entry.second);
+
+    fprintf(f, "Node profile (device-synchronized, per minibatch, over %d minibatches, %.3f ms per minibatch in nodes):\n",
+            (int) numMinibatches, 1000 * totalSeconds / numMinibatches);
+    LogTable(f, "operation", move(operationRows), SIZE_MAX, numMinibatches, totalSeconds);
+    LogTable(f, "node", move(nodes), maxNumNodes, numMinibatches, totalSeconds);
+    fflush(f);
+}
+
+}}}
@@ -0,0 +1,78 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE.md file in the project root for full license information.
+//
+
+#pragma once
+
+#include "Basics.h"
+#include "TimerUtility.h"
+#include "CommonMatrix.h" // for DEVICEID_TYPE
+#include <memory>
+#include <map>
+#include <string>
+#include <vector>
+
+namespace Microsoft { namespace MSR { namespace CNTK {
+
+class ComputationNodeBase;
+typedef std::shared_ptr<ComputationNodeBase> ComputationNodeBasePtr;
+
+// ===========================================================================
+// ComputationNodeProfiler -- accumulates wall time and estimated cost per node
+//
+// Installed in the ComputationEnvironment of a network, it gets every ForwardProp() and Backprop()
+// of the nodes (and recurrent loops) of the top-level traversal timed. The device is synchronized
+// before and after each of them, so the times are those of the node's own GPU work, at the price of
+// serializing the computation. The FLOPs and bytes moved come from ComputationNodeBase::EstimateCost().
+// ===========================================================================
+
+class ComputationNodeProfiler
+{
+public:
+    // 'deviceId' is the device the network runs on
+    ComputationNodeProfiler(DEVICEID_TYPE deviceId) : m_deviceId(deviceId) { }
+
+    // times ForwardProp() or Backprop() of a node for the lifetime of the object; does nothing without a profiler
+    class Scope
+    {
+    public:
+        Scope(ComputationNodeProfiler* profiler, const ComputationNodeBasePtr& node, bool forward);
+        ~Scope();
+
+    private:
+        ComputationNodeProfiler* m_profiler;
+        const ComputationNodeBasePtr& m_node;
+        bool m_forward;
+        Timer m_timer;
+    };
+
+    void Record(const ComputationNodeBasePtr& node, bool forward, double seconds);
+
+    // prints the accumulated numbers per operation and for the 'maxNumNodes' most expensive nodes, most expensive first
+    void LogSummary(FILE* f, size_t numMinibatches, size_t maxNumNodes = 20) const;
+
+    void Reset() { m_stats.clear(); }
+
+private:
+    struct Stats
+    {
+        std::wstring m_name;
+        std::wstring m_operation;
+        size_t m_numNodes = 1; // for the per-operation sums
+        double m_forwardSeconds = 0;
+        double m_backwardSeconds = 0;
+        double m_flops = 0;
+        double m_bytes = 0;
+        bool m_hasCost = false; // whether the node estimates its cost
+
+        double Seconds() const { return m_forwardSeconds + m_backwardSeconds; }
+    };
+
+    static void LogTable(FILE* f, const char* title, std::vector<Stats> rows, size_t maxNumRows, size_t numMinibatches, double totalSeconds);
+
+    DEVICEID_TYPE m_deviceId;
+    std::map<ComputationNodeBasePtr, Stats> m_stats;
+};
+
+}}}
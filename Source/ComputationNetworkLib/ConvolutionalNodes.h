@@ -150,6 +150,7 @@ public:
     bool Transpose() const { return m_transpose; }
     size_t MaxTempMemSizeInSamples() const { return m_maxTempMemSizeInSamples; }
     PoolKind PoolingKind() const { return m_poolKind; }
+    bool IsImageLayoutCHW() const { return m_imageLayout == ImageLayoutKind::CHW; }
 
     // bottomlessly expand shape to filterRank, then expand to inputRank using defaults or given 'from' values
     template<class V, typename T>
@@ -285,6 +286,26 @@ public:
 
     virtual bool ImplementsGradientOverwriteOptimization() const override { return m_convEng->ImplementsGradientOverwriteOptimization(); }
 
+    // Each element on the output side of the convolution (the input when transposed) takes one multiply-add per
+    // element of a kernel. Backprop does as much for the gradient of either input.
+    virtual bool EstimateCost(bool forward, double& flops, double& bytes) const override
+    {
+        double numKernels = max((size_t) 1, m_mapCount.GetNumElements());
+        double numWeightElements = Input(0)->GetNumMinibatchElements();
+        double numInputElements = Input(1)->GetNumMinibatchElements();
+        double numOutputElements = GetNumMinibatchElements();
+        flops = 2 * (m_transpose ? numInputElements : numOutputElements) * numWeightElements / numKernels;
+        bytes = sizeof(ElemType) * (numWeightElements + numInputElements + numOutputElements);
+
+        if (!forward)
+        {
+            double numGradients = (Input(0)->NeedsGradient() ? 1 : 0) + (Input(1)->NeedsGradient() ? 1 : 0);
+            flops *= numGradients;
+            bytes = numGradients * bytes + sizeof(ElemType) * ((Input(0)->NeedsGradient() ? numWeightElements : 0) + (Input(1)->NeedsGradient() ? numInputElements : 0));
+        }
+        return true;
+    }
+
 public:
     void Save(File& fstream) const override
     {
@@ -509,6 +530,12 @@ public:
         ReleaseMatrixToPool(m_tempMatrix, matrixPool);
     }
 
+    void ReleaseMatricesKeptForBackprop(MatrixPool& matrixPool) override
+    {
+        Base::ReleaseMatricesKeptForBackprop(matrixPool);
+        ReleaseMatrixToPool(m_tempMatrix, matrixPool);
+    }
+
     void SetmMaxTempMemSizeInSamples(const size_t maxTempMemSizeInSamples)
     {
         m_maxTempMemSizeInSamples = maxTempMemSizeInSamples;
@@ -597,6 +624,12 @@ public:
         ReleaseMatrixToPool(m_tempMatrix, matrixPool);
     }
 
+    void ReleaseMatricesKeptForBackprop(MatrixPool& matrixPool) override
+    {
+        Base::ReleaseMatricesKeptForBackprop(matrixPool);
+        ReleaseMatrixToPool(m_tempMatrix, matrixPool);
+    }
+
     // Input0: Images       [W x H x C x N]
     // Input1: ROIs         [4 x roisPerImage x N], 
     // output: Pooled ROIs  [PW x PH x C x roisPerImage x N]
@@ -782,22 +815,28 @@ public:
         Base::Validate(isFinalValidationPass);
         InferMBLayoutFromInputsForStandardCase(isFinalValidationPass);
 
-        if (m_imageLayout != ImageLayoutKind::CHW)
+        if (m_imageLayout != ImageLayoutKind::CHW && GetInputSampleLayout(0).GetRank() != 3)
         {
             InvalidArgument(
-                "%ls %ls supports only cuDNN (CHW) data layout. "
+                "%ls %ls supports the legacy (HWC) data layout only for images. "
                 "Please specify imageLayout=\"cudnn\" in %ls node in your script "
                 "and make sure input data layout is CHW", NodeName().c_str(), OperationName().c_str(), NodeName().c_str());
         }
 
-        const auto& inputShape = GetInputSampleLayout(0);
+        // ConvolveGeometry always uses CHW, so HWC images are described in the CHW order (cf. ConvolutionNode).
+        auto inputShape = GetInputSampleLayout(0);
+        if (m_imageLayout != ImageLayoutKind::CHW)
+            inputShape = ImageDimensions(inputShape, m_imageLayout).AsTensorShape(ImageLayoutKind::CHW);
 
         // infer reduction dimensions if not given
         InferReductionDims(inputShape, TensorShape());
 
         auto outDims = ConvolveGeometry::ComputeOutputShape(inputShape, m_kernelShape, m_mapCount, m_stride,
                                                             m_sharing, m_autoPad, m_lowerPad, m_upperPad);
-        SetDims(outDims, HasMBLayout());
+        if (m_imageLayout == ImageLayoutKind::CHW)
+            SetDims(outDims, HasMBLayout());
+        else
+            SetDims(ImageDimensions(outDims, ImageLayoutKind::CHW).AsTensorShape(m_imageLayout), HasMBLayout());
         if (isFinalValidationPass)
         {
             if (m_convEng == nullptr)
@@ -1083,10 +1122,11 @@ public:
         if (isFinalValidationPass)
         {
             // set up various engines and descriptor objects
-            m_geometry = std::make_shared<ConvolveGeometry>(inDims.AsTensorShape(m_imageLayoutKind),
-                                                            ImageDimensions(m_windowWidth, m_windowHeight, 1).AsTensorShape(m_imageLayoutKind),
+            // As in ConvolutionNode, ConvolveGeometry describes the image in the CHW order, for either layout.
+            m_geometry = std::make_shared<ConvolveGeometry>(inDims.AsTensorShape(ImageLayoutKind::CHW),
+                                                            ImageDimensions(m_windowWidth, m_windowHeight, 1).AsTensorShape(ImageLayoutKind::CHW),
                                                             TensorShape(1),
-                                                            ImageDimensions(m_horizontalSubsample, m_verticalSubsample, 1).AsTensorShape(m_imageLayoutKind),
+                                                            ImageDimensions(m_horizontalSubsample, m_verticalSubsample, 1).AsTensorShape(ImageLayoutKind::CHW),
                                                             ConvolveGeometry::BoolVec{true},
                                                             ConvolveGeometry::BoolVec{false},
                                                             TensorShape(0),
@@ -121,6 +121,9 @@ public:
         ReleaseMatrixToPool(m_maxValues, matrixPool);
     }
 
+    // the temporaries above are only allocated for the forward pass
+    virtual bool SupportsValueRecomputation() const override { return false; }
+
 private:
     shared_ptr<Matrix<ElemType>> m_maxIndexes0, m_maxIndexes1;
     shared_ptr<Matrix<ElemType>> m_maxValues;
@@ -478,53 +481,13 @@ class SequenceDecoderNode : public ComputationNodeNonLooping /*ComputationNode*/
         return L"SequenceDecoderNode";
     }
 
-private:
-    // TODO: member variables go to the end
-    Matrix<ElemType> mAlpha;
-    Matrix<ElemType> mBacktrace;
-
-    int mStartLab; // the starting output label
-    int mEndLab;   // the ending output label, if avaliable
-    ElemType m_default_activity;
-
 public:
     DeclareConstructorFromConfigWithNumInputs(SequenceDecoderNode);
     SequenceDecoderNode(DEVICEID_TYPE deviceId, const wstring& name)
-        : Base(deviceId, name),
-          mAlpha(deviceId),
-          mBacktrace(deviceId),
-          mStartLab(-1),
-          mEndLab(-1)
+        : Base(deviceId, name)
     {
     }
 
-    static void DecideStartEndingOutputLab(const Matrix<ElemType>& lbls, int& stt, int& stp)
-    {
-        if (stt != -1 && stp != -1)
-            return; // have computed before
-
-        int iNumPos = lbls.GetNumCols();
-
-        int firstLbl = -1;
-        for (int ik = 0; ik < lbls.GetNumRows(); ik++)
-            if (lbls(ik, 0) != 0)
-            {
-                firstLbl = ik;
-                break;
-            }
-
-        int lastLbl = -1;
-        for (int ik = 0; ik < lbls.GetNumRows(); ik++)
-            if (lbls(ik, iNumPos - 1) != 0)
-            {
-                lastLbl = ik;
-                break;
-            }
-
-        stt = firstLbl;
-        stp = lastLbl;
-    };
-
     virtual void BackpropToNonLooping(size_t /*inputIndex*/) override // scaled by 2*number of elements in the Matrix<ElemType>
     {
         LogicError("SequenceDecoder is used for evaluation only.");
@@ -539,102 +502,16 @@ public:
         return false;
     }
 
-    // compute posterior probability of label y at position t
+    // Viterbi decoding of all sequences of the minibatch at once (one GPU kernel launch)
+    // The labels only provide the first and last symbol of each sequence, which constrain the search.
     virtual void /*ComputationNodeNonLooping::*/ ForwardPropNonLooping() override
     {
-        DecideStartEndingOutputLab(InputRef(0).Value(), mStartLab, mEndLab);
-        ForwardPropS(mAlpha, mBacktrace, Value(), InputRef(1).Value(),
-                     InputRef(2).Value(), mStartLab, mEndLab);
+        let& pMBLayout = InputRef(0).GetMBLayout();
+        Matrix<ElemType>::RCRFViterbiDecode(InputRef(0).Value(), InputRef(1).Value(), InputRef(2).ValueAsMatrix(),
+                                            this->GetCRFSequences(pMBLayout), pMBLayout->GetNumParallelSequences(),
+                                            Value());
     }
 
-    // compute forward backward algorithm
-    void ForwardPropS(Matrix<ElemType>& alpha, Matrix<ElemType>& backtrace, Matrix<ElemType>& functionValues, const Matrix<ElemType>& pos_scores, const Matrix<ElemType>& pair_scores, const size_t stt, const size_t stp)
-    {
-        // to-do, each slice is for one sentence
-        // to-do, number of slices correspond to number of frames
-        // this implementation only supports one sentence per minibatch
-
-        // change to other values so can support multiple sentences in each minibatch
-        ForwardCompute(alpha, backtrace, pos_scores, pair_scores, stt);
-        BackwardCompute(functionValues, backtrace, stp);
-    };
-
-    // compute forward backward algorithm
-    static void ForwardCompute(Matrix<ElemType>& alpha,
-                               Matrix<ElemType>& backtrace,
-                               const Matrix<ElemType>& pos_scores, const Matrix<ElemType>& pair_scores,
-                               const size_t stt)
-    {
-        // to-do, shift more than 1 to support muliple sentences per minibatch
-        int iNumPos = pos_scores.GetNumCols();
-        int iNumLab = pos_scores.GetNumRows();
-        size_t iTmp = 0;
-
-        // need to have
-        alpha.Resize(iNumLab, iNumPos);
-        backtrace.Resize(iNumLab, iNumPos);
-
-        for (int t = 0; t < iNumPos; t++)
-        {
-            for (int k = 0; k < iNumLab; k++)
-            {
-                ElemType fTmp = (ElemType) LZERO;
-                if (t > 1)
-                {
-                    for (int j = 0; j < iNumLab; j++)
-                    {
-                        ElemType fAlpha = alpha(j, t - 1) + pair_scores(k, j);
-                        if (fAlpha > fTmp)
-                        {
-                            fTmp = fAlpha;
-                            iTmp = j;
-                        }
-                    }
-                    fTmp += pos_scores(k, t); // include position dependent score
-                }
-                else
-                {
-                    // with constrain that the first word is labeled as a given symbol
-                    iTmp = stt;
-                    fTmp = 0;
-                    if (t == 1)
-                    {
-                        fTmp = alpha(iTmp, t - 1);
-                        fTmp += pair_scores(k, iTmp);
-                        fTmp += pos_scores(k, t);
-                    }
-                    else
-                    {
-                        fTmp = (k == stt) ? pos_scores(k, t) : (ElemType) LZERO;
-                    }
-                }
-                alpha(k, t) = fTmp;
-                backtrace(k, t) = (ElemType) iTmp;
-            }
-        }
-    };
-
-    // compute backward algorithm
-    static void BackwardCompute(
-        Matrix<ElemType>& decodedpath,
-        const Matrix<ElemType>& backtrace, const size_t stp)
-    {
-        int iNumPos = backtrace.GetNumCols();
-        int iNumLab = backtrace.GetNumRows();
-
-        decodedpath.Resize(iNumLab, iNumPos);
-        decodedpath.SetValue(0);
-
-        size_t lastlbl = stp;
-        decodedpath(lastlbl, iNumPos - 1) = 1;
-
-        for (int t = iNumPos - 1; t > 0; t--)
-        {
-            lastlbl = (size_t) backtrace(lastlbl, t);
-            decodedpath(lastlbl, t - 1) = 1;
-        }
-    };
-
     // need to feed in pseudo label data, which tells the decoder what is the beginning
     // and ending output symbol. these symbols will constrain the search space
     virtual void /*ComputationNodeBase::*/ Validate(bool isFinalValidationPass) override
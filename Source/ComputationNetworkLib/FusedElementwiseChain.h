@@ -0,0 +1,136 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE.md file in the project root for full license information.
+//
+
+#pragma once
+
+#include "Basics.h"
+#include "ComputationNode.h"
+#include "Matrix.h"
+#include <algorithm>
+#include <memory>
+#include <vector>
+
+namespace Microsoft { namespace MSR { namespace CNTK {
+
+// ===========================================================================
+// FusedElementwiseChain -- consecutive elementwise nodes computed in one pass over memory
+//
+// A chain consists of nodes whose ForwardProp() is a single elementwise op (ForwardElementwiseOp()), e.g.
+// Plus -> Sigmoid -> ElementTimes, where the values of all but the last node are used by nothing else.
+// ComputationNetwork::EnableElementwiseFusion() finds them. While the network is inferring, the PAR
+// traversal skips all but the last node, which computes the whole chain with one
+// Matrix::FusedElementwiseOp() that reads the inputs and writes the output once, instead of one
+// TensorOp per node, each reading and writing full tensors.
+// Chains inside a recurrent loop are computed the same way by the SEQ traversal, one time step at a time, which
+// replaces the many small per-step TensorOps of, e.g., the gates of an LSTM cell by one.
+// ===========================================================================
+
+class IFusedElementwiseChain
+{
+public:
+    virtual ~IFusedElementwiseChain() { }
+
+    // the nodes in evaluation order; the last one is the chain's output
+    const std::vector<ComputationNodeBasePtr>& GetNodes() const { return m_nodes; }
+
+    // instead of ForwardProp() of the last node. The values of the others are only computed if the fused op
+    // cannot be used in this minibatch, e.g. for sparse inputs. 'fr' is all frames, or a time step of the loop
+    // the chain is part of.
+    virtual void ForwardProp(const FrameRange& fr) = 0;
+
+protected:
+    std::vector<ComputationNodeBasePtr> m_nodes;
+};
+
+template <class ElemType>
+class FusedElementwiseChain : public IFusedElementwiseChain
+{
+public:
+    // 'nodes' in evaluation order, at most FusedElementwiseProgram::MaxSteps, with at most
+    // FusedElementwiseProgram::MaxInputs inputs from outside the chain
+    FusedElementwiseChain(const std::vector<ComputationNodeBasePtr>& nodes)
+    {
+        m_nodes = nodes;
+        if (nodes.size() > FusedElementwiseProgram::MaxSteps)
+            LogicError("FusedElementwiseChain: Too many nodes.");
+
+        // values are numbered: first the inputs from outside the chain, then the nodes
+        auto indexOfNode = [&](const ComputationNodeBasePtr& node) { return std::find(nodes.begin(), nodes.end(), node) - nodes.begin(); };
+        for (const auto& node : nodes)
+        {
+            for (const auto& input : node->GetInputs())
+            {
+                if (indexOfNode(input) == (ptrdiff_t) nodes.size() && std::find(m_inputs.begin(), m_inputs.end(), input) == m_inputs.end())
+                    m_inputs.push_back(input);
+            }
+        }
+        if (m_inputs.size() > FusedElementwiseProgram::MaxInputs)
+            LogicError("FusedElementwiseChain: Too many inputs.");
+
+        m_program.numInputs = (int) m_inputs.size();
+        m_program.numSteps = (int) nodes.size();
+        for (size_t k = 0; k < nodes.size(); k++)
+        {
+            auto& step = m_program.steps[k];
+            step.op = nodes[k]->ForwardElementwiseOp();
+            step.arity = (int) nodes[k]->GetNumInputs();
+            for (int i = 0; i < step.arity; i++)
+            {
+                const auto& input = nodes[k]->GetInputs()[i];
+                ptrdiff_t index = indexOfNode(input);
+                if (index < (ptrdiff_t) nodes.size())
+                    step.args[i] = m_program.numInputs + (int) index;
+                else
+                    step.args[i] = (int) (std::find(m_inputs.begin(), m_inputs.end(), input) - m_inputs.begin());
+            }
+        }
+    }
+
+    virtual void ForwardProp(const FrameRange& fr) override
+    {
+        // A time step is a contiguous range of columns of all values that have the loop's layout.
+        auto& lastNode = dynamic_cast<ComputationNode<ElemType>&>(*m_nodes.back());
+        bool canFuse = (fr.IsAllFrames() || fr.seqIndex == SIZE_MAX) && lastNode.Value().GetMatrixType() == MatrixType::DENSE;
+        Matrix<ElemType> output = canFuse ? lastNode.ValueFor(fr) : lastNode.Value().AsReference();
+        std::vector<Matrix<ElemType>> values;
+        values.reserve(m_inputs.size());
+        for (const auto& input : m_inputs)
+        {
+            auto& inputNode = dynamic_cast<ComputationNode<ElemType>&>(*input);
+            const auto& value = inputNode.Value();
+            canFuse = canFuse && value.GetMatrixType() == MatrixType::DENSE && value.GetDeviceId() == output.GetDeviceId() && value.GetNumRows() == output.GetNumRows();
+            if (!canFuse)
+                break;
+            values.push_back(input->HasMBLayout() ? inputNode.ValueFor(fr) : value.AsReference());
+            canFuse = values.back().GetNumCols() == output.GetNumCols() || values.back().GetNumCols() == 1;
+        }
+        if (canFuse)
+        {
+            std::vector<const Matrix<ElemType>*> inputs;
+            for (const auto& value : values)
+                inputs.push_back(&value);
+            output.FusedElementwiseOp(m_program, inputs);
+            return;
+        }
+
+        // node by node, as without fusion
+        // In a loop, the SEQ traversal calls BeginForwardProp() and EndForwardProp() of all nodes around all steps.
+        for (size_t k = 0; k + 1 < m_nodes.size(); k++)
+        {
+            if (fr.IsAllFrames())
+                m_nodes[k]->BeginForwardProp();
+            m_nodes[k]->ForwardProp(fr.WithLayout(m_nodes[k]->GetMBLayout()));
+            if (fr.IsAllFrames())
+                m_nodes[k]->EndForwardProp();
+        }
+        m_nodes.back()->ForwardProp(fr);
+    }
+
+private:
+    std::vector<ComputationNodeBasePtr> m_inputs; // inputs from outside the chain, in the order of the program
+    FusedElementwiseProgram m_program;
+};
+
+}}}
@@ -0,0 +1,297 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE.md file in the project root for full license information.
+//
+
+#define _CRT_SECURE_NO_WARNINGS // "secure" CRT not available on all platforms  --add this at the top of all CPP files that give "function or variable may be unsafe" warnings
+
+#include "Basics.h"
+#include "GPUGraphReplay.h"
+#include "Globals.h"
+#include "ComputationNode.h"
+#include "InputAndParamNodes.h"
+#include "LinearAlgebraNodes.h"
+#include "NonlinearityNodes.h"
+#include "ConvolutionalNodes.h"
+#include "ReshapingNodes.h"
+#include "TrainingNodes.h"
+#include "EvaluationNodes.h"
+#include <cstring>
+#include <set>
+
+using namespace std;
+
+namespace Microsoft { namespace MSR { namespace CNTK {
+
+static const size_t maxNumFailedCaptures = 2;
+
+// operations whose ForwardProp() and Backprop() queue the same GPU work for the same matrices, and whose state on
+// the host does not change from one minibatch to the next (besides the elementwise ones)
+static bool IsReplayableOperation(const ComputationNodeBasePtr& node)
+{
+    static const set<wstring> operations =
+    {
+        OperationNameOf(InputValue), OperationNameOf(LearnableParameter),
+        OperationNameOf(TimesNode), OperationNameOf(TransposeTimesNode), OperationNameOf(SumElementsNode),
+        OperationNameOf(ConvolutionNode), OperationNameOf(PoolingNode), OperationNameOf(MaxPoolingNode), OperationNameOf(AveragePoolingNode),
+        OperationNameOf(SoftmaxNode), OperationNameOf(LogSoftmaxNode),
+        OperationNameOf(ReshapeNode), OperationNameOf(SliceNode), OperationNameOf(ReduceElementsNode),
+        OperationNameOf(SquareErrorNode), OperationNameOf(CrossEntropyWithSoftmaxNode), OperationNameOf(CrossEntropyNode),
+        OperationNameOf(LogisticNode), OperationNameOf(ClassificationErrorNode),
+    };
+    return node->ForwardElementwiseOp() != opNone || operations.find(node->OperationName()) != operations.end();
+}
+
+template <class ElemType>
+static bool TryAppendMatrixSignature(vector<size_t>& signature, const ComputationNodeBasePtr& nodep, bool isStaged, bool backprop)
+{
+    auto node = dynamic_pointer_cast<ComputationNode<ElemType>>(nodep);
+    if (!node)
+        return false;
+    auto append = [&signature](const shared_ptr<Matrix<ElemType>>& matrix, bool withAddress)
+    {
+        signature.push_back(matrix ? matrix->GetNumRows() : 0);
+        signature.push_back(matrix ? matrix->GetNumCols() : 0);
+        signature.push_back(matrix && withAddress && !matrix->IsEmpty() ? (size_t) matrix->Data() : 0);
+    };
+    append(node->ValuePtrRef(), !isStaged); // the graph reads a staged input from a buffer of its own
+    if (backprop)
+        append(node->GradientPtrRef(), true);
+    return true;
+}
+
+template <class ElemType>
+static bool TryStageInput(const ComputationNodeBasePtr& nodep, MatrixBasePtr& staged)
+{
+    auto node = dynamic_pointer_cast<ComputationNode<ElemType>>(nodep);
+    if (!node)
+        return false;
+    if (!staged)
+        staged = make_shared<Matrix<ElemType>>(node->GetDeviceId());
+    dynamic_pointer_cast<Matrix<ElemType>>(staged)->SetValue(node->Value());
+    return true;
+}
+
+template <class ElemType>
+static bool TrySwapStagedInput(const ComputationNodeBasePtr& nodep, MatrixBasePtr& staged)
+{
+    auto node = dynamic_pointer_cast<ComputationNode<ElemType>>(nodep);
+    if (!node)
+        return false;
+    auto matrix = dynamic_pointer_cast<Matrix<ElemType>>(staged);
+    node->ValuePtrRef().swap(matrix);
+    staged = matrix;
+    return true;
+}
+
+static vector<TimeStamp> SaveTimeStamps(const list<ComputationNodeBasePtr>& evalOrder)
+{
+    vector<TimeStamp> timeStamps(evalOrder.size());
+    size_t i = 0;
+    for (const auto& node : evalOrder)
+        static_cast<const TimeStamp&>(*node).CopyTo(timeStamps[i++]);
+    return timeStamps;
+}
+
+static void RestoreTimeStamps(const list<ComputationNodeBasePtr>& evalOrder, const vector<TimeStamp>& timeStamps)
+{
+    size_t i = 0;
+    for (const auto& node : evalOrder)
+        timeStamps[i++].CopyTo(*node);
+}
+
+GPUGraphReplay::GPUGraphReplay(size_t numWarmupPasses)
+    : m_numWarmupPasses(numWarmupPasses)
+{
+}
+
+GPUGraphReplay::~GPUGraphReplay()
+{
+}
+
+bool GPUGraphReplay::IsReplayable(Pass& pass, const ComputationNodeBasePtr& root, const list<ComputationNodeBasePtr>& evalOrder)
+{
+    if (pass.m_isChecked)
+        return pass.m_isReplayable;
+    pass.m_isChecked = true;
+
+    pass.m_deviceId = root->GetDeviceId();
+    const ComputationNodeBasePtr* reason = nullptr;
+    for (const auto& node : evalOrder)
+    {
+        if (node->GetDeviceId() != pass.m_deviceId || node->IsPartOfLoop() || !IsReplayableOperation(node) ||
+            (node->ValuePtr() && node->ValuePtr()->GetMatrixType() != DENSE))
+        {
+            reason = &node;
+            break;
+        }
+        if (node->OperationName() == OperationNameOf(InputValue))
+            pass.m_inputs.push_back(node);
+    }
+    pass.m_stagedInputValues.resize(pass.m_inputs.size());
+
+    pass.m_isReplayable = !reason && GPUGraph::IsSupported(pass.m_deviceId) && !Globals::ShouldEnableHyperCompressMemory();
+    if (reason)
+        fprintf(stderr, "GPUGraphReplay: Passes of %ls are not recorded, because of %ls %ls operation.\n",
+                root->NodeName().c_str(), (*reason)->NodeName().c_str(), (*reason)->OperationName().c_str());
+    else if (!pass.m_isReplayable)
+        fprintf(stderr, "GPUGraphReplay: Passes of %ls are not recorded, since GPU graphs are not supported for the device.\n", root->NodeName().c_str());
+    return pass.m_isReplayable;
+}
+
+// returns false if the MBLayouts have gaps, whose masks are uploaded for each minibatch
+// The sequence ids differ from one minibatch to the next, but do not take part in the computation.
+bool GPUGraphReplay::AppendMatrixSignature(vector<size_t>& signature, const list<ComputationNodeBasePtr>& evalOrder, bool backprop) const
+{
+    set<MBLayoutPtr> layoutsSeen;
+    for (const auto& node : evalOrder)
+    {
+        bool isStaged = node->OperationName() == OperationNameOf(InputValue);
+        if (!TryAppendMatrixSignature<float>(signature, node, isStaged, backprop) && !TryAppendMatrixSignature<double>(signature, node, isStaged, backprop))
+            LogicError("GPUGraphReplay: %ls %ls operation is neither ComputationNode<float> nor ComputationNode<double>.", node->NodeName().c_str(), node->OperationName().c_str());
+
+        const auto& layout = node->GetMBLayout();
+        if (!layout || !layoutsSeen.insert(layout).second)
+            continue;
+        if (layout->HasGaps())
+            return false;
+        signature.push_back(layout->GetNumParallelSequences());
+        signature.push_back(layout->GetNumTimeSteps());
+        for (const auto& sequence : layout->GetAllSequences())
+        {
+            signature.push_back(sequence.s);
+            signature.push_back((size_t) sequence.tBegin);
+            signature.push_back(sequence.tEnd);
+        }
+    }
+    return true;
+}
+
+// The nodes are computed by the pass in evaluation order, so which ones are out of date, and thus computed, follows
+// from bumping the time stamps in that order, as PARTraversalFlowControlNode::ForwardProp() does.
+void GPUGraphReplay::ForwardProp(const ComputationNodeBasePtr& root, const list<ComputationNodeBasePtr>& evalOrder, const function<void()>& run)
+{
+    auto& pass = m_passes[make_pair(root, false)];
+    if (!IsReplayable(pass, root, evalOrder))
+        return run();
+
+    vector<size_t> signature;
+    bool isStatic = AppendMatrixSignature(signature, evalOrder, /*backprop=*/false);
+    auto timeStamps = SaveTimeStamps(evalOrder);
+    bool isAnyOutOfDate = false;
+    for (const auto& node : evalOrder)
+    {
+        bool isOutOfDate = node->IsOutOfDateWrtInputs();
+        if (isOutOfDate)
+            node->BumpEvalTimeStamp();
+        signature.push_back(isOutOfDate);
+        isAnyOutOfDate |= isOutOfDate;
+    }
+    if (!isAnyOutOfDate) // nothing to compute; this says nothing about the next passes
+        return run();
+    if (isStatic && pass.m_graph && signature == pass.m_graphSignature) // (the nodes have their new time stamps)
+    {
+        StageInputs(pass);
+        pass.m_graph->Launch();
+        return;
+    }
+    RestoreTimeStamps(evalOrder, timeStamps);
+    Run(pass, root, evalOrder, /*backprop=*/false, move(signature), isStatic, run);
+}
+
+void GPUGraphReplay::Backprop(const ComputationNodeBasePtr& root, const list<ComputationNodeBasePtr>& evalOrder, double rootGradient, const function<void()>& run)
+{
+    auto& pass = m_passes[make_pair(root, true)];
+    if (!IsReplayable(pass, root, evalOrder))
+        return run();
+
+    vector<size_t> signature;
+    bool isStatic = AppendMatrixSignature(signature, evalOrder, /*backprop=*/true);
+    uint64_t rootGradientBits;
+    static_assert(sizeof(rootGradientBits) == sizeof(rootGradient), "double is expected to have 64 bits");
+    memcpy(&rootGradientBits, &rootGradient, sizeof(rootGradient)); // the root gradient is set inside the graph
+    signature.push_back((size_t) rootGradientBits);
+    signature.push_back((size_t) (rootGradientBits >> 32));
+    if (isStatic && pass.m_graph && signature == pass.m_graphSignature)
+    {
+        StageInputs(pass);
+        pass.m_graph->Launch();
+        return;
+    }
+    Run(pass, root, evalOrder, /*backprop=*/true, move(signature), isStatic, run);
+}
+
+// runs the pass normally, or records it as a graph once its signature has been the same for the warm-up passes
+void GPUGraphReplay::Run(Pass& pass, const ComputationNodeBasePtr& root, const list<ComputationNodeBasePtr>& evalOrder, bool backprop,
+                         vector<size_t>&& signature, bool isStatic, const function<void()>& run)
+{
+    // the matrices or the layout changed, so the graph no longer applies; neither may the temporaries of the nodes
+    pass.m_graph.reset();
+
+    if (isStatic && signature == pass.m_lastSignature)
+        pass.m_numIdenticalPasses++;
+    else
+    {
+        pass.m_lastSignature = isStatic ? signature : vector<size_t>();
+        pass.m_numIdenticalPasses = isStatic ? 1 : 0;
+    }
+    if (pass.m_numIdenticalPasses <= m_numWarmupPasses || pass.m_numFailedCaptures >= maxNumFailedCaptures)
+        return run();
+
+    // record the pass instead of running it
+    // The state on the host, i.e. the time stamps and the lazy gradient initialization, is changed as by running it.
+    // Backprop() resets the latter first, so only the time stamps need to be restored to run it again.
+    auto timeStamps = SaveTimeStamps(evalOrder);
+    StageInputs(pass);
+    unique_ptr<GPUGraph> graph(new GPUGraph(pass.m_deviceId));
+    bool isCaptured = false;
+    SwapStagedInputs(pass);
+    try
+    {
+        graph->BeginCapture();
+        run();
+        isCaptured = graph->EndCapture();
+    }
+    catch (const exception& e)
+    {
+        graph->EndCapture();
+        fprintf(stderr, "GPUGraphReplay: Recording the %s pass of %ls failed: %s\n", backprop ? "backward" : "forward", root->NodeName().c_str(), e.what());
+    }
+    SwapStagedInputs(pass);
+
+    // the nodes must not have allocated new matrices, since the graph works on those it recorded
+    vector<size_t> signatureAfter;
+    if (isCaptured && (!AppendMatrixSignature(signatureAfter, evalOrder, backprop) || !equal(signatureAfter.begin(), signatureAfter.end(), signature.begin())))
+        isCaptured = false;
+
+    if (!isCaptured)
+    {
+        if (++pass.m_numFailedCaptures >= maxNumFailedCaptures)
+            fprintf(stderr, "GPUGraphReplay: The %s pass of %ls cannot be recorded; it is computed node by node from now on.\n", backprop ? "backward" : "forward", root->NodeName().c_str());
+        pass.m_numIdenticalPasses = 0;
+        RestoreTimeStamps(evalOrder, timeStamps);
+        return run();
+    }
+
+    pass.m_graph = move(graph);
+    pass.m_graphSignature = move(signature);
+    pass.m_graph->Launch(); // the recorded work of this pass has not been executed yet
+}
+
+// copies the input values into the buffers that the graphs read them from
+void GPUGraphReplay::StageInputs(Pass& pass)
+{
+    for (size_t i = 0; i < pass.m_inputs.size(); i++)
+        if (!TryStageInput<float>(pass.m_inputs[i], pass.m_stagedInputValues[i]))
+            TryStageInput<double>(pass.m_inputs[i], pass.m_stagedInputValues[i]);
+}
+
+// swaps the input values with the buffers that the graphs read them from
+void GPUGraphReplay::SwapStagedInputs(Pass& pass)
+{
+    for (size_t i = 0; i < pass.m_inputs.size(); i++)
+        if (!TrySwapStagedInput<float>(pass.m_inputs[i], pass.m_stagedInputValues[i]))
+            TrySwapStagedInput<double>(pass.m_inputs[i], pass.m_stagedInputValues[i]);
+}
+
+}}}
@@ -0,0 +1,82 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE.md file in the project root for full license information.
+//
+
+#pragma once
+
+#include "Basics.h"
+#include "Matrix.h" // for DEVICEID_TYPE, MatrixBasePtr
+#include "GPUGraph.h"
+#include <functional>
+#include <list>
+#include <map>
+#include <memory>
+#include <utility>
+#include <vector>
+
+namespace Microsoft { namespace MSR { namespace CNTK {
+
+class ComputationNodeBase;
+typedef std::shared_ptr<ComputationNodeBase> ComputationNodeBasePtr;
+
+// ===========================================================================
+// GPUGraphReplay -- forward and backward passes recorded once as GPU graphs and replayed while nothing changes
+//
+// Installed by ComputationNetwork::EnableGPUGraphReplay(), it gets each ForwardProp() and Backprop() of a root.
+// Once a pass has run a few times with the same signature, it is recorded as a GPUGraph, and from then on
+// launched as a whole instead of calling the nodes. The signature consists of the addresses and dimensions of the
+// value and gradient matrices of all nodes of the pass, their MBLayouts, which nodes the forward pass computes, and
+// the root gradient. When it changes, e.g. for a shorter minibatch, the pass runs normally again, and is recorded
+// again once the new signature is stable.
+// Readers pass each minibatch in different buffers, so the values of the input nodes are copied into buffers kept
+// here, which are what the graphs read.
+// Only passes over dense GPU nodes without loops whose operations keep no state on the host (so not Dropout or
+// BatchNormalization) are recorded. A pass that cannot be recorded, e.g. because a node synchronizes with the
+// host, runs normally, and is not tried again after a few failures.
+// ===========================================================================
+
+class GPUGraphReplay
+{
+public:
+    GPUGraphReplay(size_t numWarmupPasses = 3);
+    ~GPUGraphReplay();
+
+    // 'run' computes ForwardProp() of 'root', whose evaluation order is 'evalOrder'
+    void ForwardProp(const ComputationNodeBasePtr& root, const std::list<ComputationNodeBasePtr>& evalOrder, const std::function<void()>& run);
+    // 'run' sets the root gradient to 'rootGradient' and computes Backprop() of 'root'
+    void Backprop(const ComputationNodeBasePtr& root, const std::list<ComputationNodeBasePtr>& evalOrder, double rootGradient, const std::function<void()>& run);
+
+    // drops all graphs, e.g. since the matrices have been allocated again
+    void Clear() { m_passes.clear(); }
+
+private:
+    struct Pass
+    {
+        bool m_isChecked = false;  // whether m_isReplayable was determined
+        bool m_isReplayable = false;
+        DEVICEID_TYPE m_deviceId = CPUDEVICE;
+        size_t m_numFailedCaptures = 0;
+
+        std::vector<size_t> m_lastSignature; // of the most recent passes that ran normally
+        size_t m_numIdenticalPasses = 0;     // how many of them in a row had that signature
+
+        std::unique_ptr<GPUGraph> m_graph;
+        std::vector<size_t> m_graphSignature;
+
+        std::vector<ComputationNodeBasePtr> m_inputs;  // input nodes of the pass
+        std::vector<MatrixBasePtr> m_stagedInputValues; // [i] the buffer the graph reads m_inputs[i]'s value from
+    };
+
+    bool IsReplayable(Pass& pass, const ComputationNodeBasePtr& root, const std::list<ComputationNodeBasePtr>& evalOrder);
+    bool AppendMatrixSignature(std::vector<size_t>& signature, const std::list<ComputationNodeBasePtr>& evalOrder, bool backprop) const;
+    void Run(Pass& pass, const ComputationNodeBasePtr& root, const std::list<ComputationNodeBasePtr>& evalOrder, bool backprop,
+             std::vector<size_t>&& signature, bool isStatic, const std::function<void()>& run);
+    void StageInputs(Pass& pass);
+    void SwapStagedInputs(Pass& pass);
+
+    size_t m_numWarmupPasses;
+    std::map<std::pair<ComputationNodeBasePtr, bool>, Pass> m_passes; // [root, backprop]
+};
+
+}}}
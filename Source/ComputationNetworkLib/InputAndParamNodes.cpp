@@ -633,6 +633,20 @@ template <class ElemType>
     SetLearningRateMultiplier(0);
 }
 
+template <class ElemType>
+bool LearnableParameter<ElemType>::SwitchToSparseValue(double maxDensity)
+{
+    auto& value = Value();
+    if (value.GetMatrixType() != DENSE || value.GetNumElements() == 0)
+        return false;
+    double density = (double) value.MatrixNorm0() / value.GetNumElements();
+    if (density > maxDensity)
+        return false;
+    value.SwitchToMatrixType(SPARSE, matrixFormatSparseCSC, /*keepValues=*/true);
+    FreezeParameters();
+    return true;
+}
+
 template class LearnableParameter<float>;
 template class LearnableParameter<double>;
 
@@ -61,6 +61,19 @@ public:
         LearnableParameter(deviceId, name, TensorShape(rows, cols))
     {
     }
+    // Uses the storage of 'sharedValue' as its value, without allocating or initializing anything.
+    // This lets several networks share one set of parameters on the device.
+    LearnableParameter(DEVICEID_TYPE deviceId, const wstring& name, const TensorShape& shape, const Matrix<ElemType>& sharedValue) :
+        LearnableParameter(deviceId, name)
+    {
+        if (shape.GetNumElements() != sharedValue.GetNumElements())
+            LogicError("LearnableParameter: The shared value of %ls has %d elements, but its shape [%s] has %d.",
+                       NodeDescription().c_str(), (int)sharedValue.GetNumElements(), string(shape).c_str(), (int)shape.GetNumElements());
+        SetDims(shape, false);
+        CreateValueMatrixIfNull();
+        Value() = sharedValue.AsReference();
+        m_initString.clear(); // (nothing to initialize)
+    }
     LearnableParameter(const ScriptableObjects::IConfigRecordPtr configp);
 
     // initialize after plain constructor; for use by NDL
@@ -145,6 +158,11 @@ public:
     // called from CloneFunction(..., parameters="constant")
     virtual void FreezeParameters() override; // from IFreezable
 
+    // inference with pruned weights: stores the value as a sparse CSC matrix if at most 'maxDensity' of its elements are
+    // nonzero, which is then also how it is saved. The parameter is frozen, since the learners expect dense parameters.
+    // Returns whether the value was switched.
+    bool SwitchToSparseValue(double maxDensity);
+
     // Setting the reg multiplier for a learnable node, effecting L1Reg and L2Reg both.
     void SetRegMultiplier(float regMultiplier)
     {
@@ -50,6 +50,8 @@ public:
         result.AssignSumOf(input0, input1);
     }
 
+    virtual ElementWiseOperator ForwardElementwiseOp() const override { return opSum; }
+
     virtual void /*ComputationNode::*/ BackpropTo(const size_t inputIndex, const FrameRange& fr) override
     {
         size_t rank = DetermineElementwiseTensorRank();
@@ -100,6 +102,8 @@ public:
         result.AssignLogSumOf(input0, input1);
     }
 
+    virtual ElementWiseOperator ForwardElementwiseOp() const override { return opLogSum; }
+
     virtual void /*ComputationNode::*/ BackpropTo(const size_t inputIndex, const FrameRange& fr) override
     {
         size_t rank = DetermineElementwiseTensorRank();
@@ -156,6 +160,8 @@ public:
         result.AssignDifferenceOf(input0, input1);
     }
 
+    virtual ElementWiseOperator ForwardElementwiseOp() const override { return opDifference; }
+
     virtual void /*ComputationNode::*/ BackpropTo(const size_t inputIndex, const FrameRange& fr) override
     {
         size_t rank = DetermineElementwiseTensorRank();
@@ -202,6 +208,8 @@ public:
         ForwardPropImpl(*this, fr, true/*allowBroadcast*/);
     }
 
+    virtual ElementWiseOperator ForwardElementwiseOp() const override { return opElementwiseProduct; }
+
     virtual void /*ComputationNode::*/ BackpropTo(const size_t inputIndex, const FrameRange& fr) override
     {
         BackpropToImpl(*this, inputIndex, fr, true/*allowBroadcast*/);
@@ -300,6 +308,8 @@ protected:
     // where each sample is treated as a separate matrix object (as a consequence, it then also applies to B and the result as well)
     TensorView<ElemType> OneSampleTensorFor(int inputIndex/*-1 for output*/, bool gradient/*instead of value*/, const FrameRange& fr)
     {
+        if (inputIndex == 0 && m_transposedArgument)
+            return TransposedArgumentTensorFor(gradient, fr);
         auto input = inputIndex < 0 ? this : Input(inputIndex).get();
         auto data = gradient ? input->GradientPtr() : input->ValuePtr();
         size_t rank = input->GetSampleLayout().GetRank();
@@ -311,6 +321,45 @@ protected:
         return TensorView<ElemType>(data, tensorShape);
     }
 
+    // A is an absorbed TransposeDimensions (see SetTransposedArgument()): the matrix of its input with the axes swapped,
+    // which TensorView::DoMatrixProductOf() reads with the opposite transposition flag
+    TensorView<ElemType> TransposedArgumentTensorFor(bool gradient/*instead of value*/, const FrameRange& fr)
+    {
+        auto& input = TransposedInputRef();
+        auto data = gradient ? input.GradientPtr() : input.ValuePtr();
+        auto tensorShape = input.DataTensorFor(data, 2, fr).GetShape();
+        tensorShape.SwapDimsInPlace(0, 1);
+        return TensorView<ElemType>(data, tensorShape);
+    }
+
+    ComputationNode<ElemType>& TransposedInputRef()
+    {
+        return dynamic_cast<ComputationNode<ElemType>&>(*InputRef(0).GetInputs()[0]);
+    }
+
+    // the gradient of A goes into the input of an absorbed TransposeDimensions, whose parent does not overwrite it
+    bool OverwritesGradientOf(size_t inputIndex)
+    {
+        if (inputIndex == 0 && m_transposedArgument)
+            return TransposedInputRef().ParentOverwritesGradient();
+        return Input(inputIndex)->ParentOverwritesGradient();
+    }
+
+    // same for a range of samples of A, each a separate matrix, as a tensor with the (seq, time) axes as batch axes
+    // An input without MBLayout gets singleton batch axes, i.e. is the same for all of them.
+    TensorView<ElemType> BatchTensorFor(int inputIndex/*-1 for output*/, bool gradient/*instead of value*/, const FrameRange& fr)
+    {
+        auto input = inputIndex < 0 ? this : Input(inputIndex).get();
+        auto data = gradient ? input->GradientPtr() : input->ValuePtr();
+        size_t rank = input->GetSampleLayout().GetRank();
+        if (inputIndex == 0 && m_transpose && rank == 1)
+            rank = 2;
+        auto tensorShape = input->GetTensorSliceFor(rank, fr);
+        if (!input->HasMBLayout())
+            tensorShape.PadRankInPlace(rank + 2);
+        return TensorView<ElemType>(data, tensorShape);
+    }
+
 private:
     // Check if TimesNodeBase could be simplified to ElementTimes to avoid unroll when:
     // 1. input0: DENSE, is rank-1 and transposed, or is rank-2 with Dim(0)==1
@@ -339,9 +388,198 @@ private:
         return input0_ok && input1_ok && outputScalar;
     }
 
+    // If A is minibatch data, the products of all its samples in 'fr' can be computed by a single batched GEMM instead of
+    // one GEMM call each, if all sequences are requested and the matrices are dense, and B and the output are per sample
+    // with the same layout. B may also be the same for all samples, except for its gradient, which is then a sum of products.
+    bool CanUseBatchMatrixProduct(const FrameRange& fr, int gradientIndex/*-1 for forward*/)
+    {
+        if (fr.seqIndex != SIZE_MAX || this->m_pQuantizedMultiplier || GetMBLayout() != InputRef(0).GetMBLayout() ||
+            (InputRef(1).HasMBLayout() && InputRef(1).GetMBLayout() != InputRef(0).GetMBLayout()) || (gradientIndex == 1 && !InputRef(1).HasMBLayout()))
+            return false;
+        if (InputRef(0).Value().GetMatrixType() != DENSE || InputRef(1).Value().GetMatrixType() != DENSE)
+            return false;
+        return gradientIndex < 0 || (Gradient().GetMatrixType() == DENSE && InputRef(gradientIndex).Gradient().GetMatrixType() == DENSE);
+    }
+
+    // With Globals::ShouldSkipGapColumns(), the product of an A that is not minibatch data by dense minibatch data B that is
+    // padded (e.g. sequence-to-sequence minibatches of sequences of different lengths) is computed on the valid columns only:
+    // they are gathered into a compact matrix as by GatherPacked(), multiplied, and scattered back as by ScatterPacked().
+    // The gap columns of the result and of the gradient into B are 0, and the gradient into A ignores them just like
+    // masking them would. The nodes around keep the padded layout; they are cheap compared to the product.
+    bool IsGapColumnSkippingCandidate() const
+    {
+        return Globals::ShouldSkipGapColumns() && m_stackedFirstIndices.empty() && !Input(0)->HasMBLayout() && HasMBLayout() && Input(1)->GetMBLayout() == GetMBLayout();
+    }
+
+    bool CanSkipGapColumns(const FrameRange& fr, const shared_ptr<Matrix<ElemType>>& compactTemp, int gradientIndex/*-1 for forward*/)
+    {
+        if (!compactTemp || !fr.IsAllFrames() || fr.seqIndex != SIZE_MAX || fr.m_pMBLayout != GetMBLayout() || this->m_pQuantizedMultiplier)
+            return false;
+        if (InputRef(1).Value().GetMatrixType() != DENSE || Value().GetMatrixType() != DENSE)
+            return false;
+        if (gradientIndex >= 0 && (Gradient().GetMatrixType() != DENSE || InputRef(gradientIndex).Gradient().GetMatrixType() != DENSE))
+            return false;
+        const auto& pMBLayout = GetMBLayout();
+        if (!pMBLayout->HasGaps() || pMBLayout->GetActualNumSamples() * 8 > pMBLayout->GetNumCols() * 7) // too few gaps to pay for gather and scatter
+            return false;
+        UpdateValidColumnsIndex();
+        return true;
+    }
+
+    // (re-)build the gather/scatter index of the valid columns, in increasing order, unless the layout is still the same
+    void UpdateValidColumnsIndex()
+    {
+        const auto& pMBLayout = GetMBLayout();
+        size_t numParallelSequences = pMBLayout->GetNumParallelSequences();
+        size_t numTimeSteps         = pMBLayout->GetNumTimeSteps();
+        if (m_validColumnsIndex && m_validColumnsIndexNumParallelSequences == numParallelSequences &&
+            m_validColumnsIndexNumTimeSteps == numTimeSteps && m_validColumnsIndexSequences == pMBLayout->GetAllSequences())
+            return;
+
+        vector<char> isValid(pMBLayout->GetNumCols(), 0);
+        for (const auto& seq : pMBLayout->GetAllSequences())
+        {
+            if (seq.seqId == GAP_SEQUENCE_ID)
+                continue;
+            size_t tEnd = min(seq.tEnd, numTimeSteps);
+            for (size_t t = (size_t) max(seq.tBegin, (ptrdiff_t) 0); t < tEnd; t++)
+                isValid[t * numParallelSequences + seq.s] = 1;
+        }
+        vector<ElemType> index;
+        index.reserve(pMBLayout->GetActualNumSamples());
+        for (size_t j = 0; j < isValid.size(); j++)
+            if (isValid[j])
+                index.push_back((ElemType) j);
+
+        if (!m_validColumnsIndex)
+            m_validColumnsIndex = make_shared<Matrix<ElemType>>(m_deviceId);
+        m_validColumnsIndex->SetValue(1, index.size(), m_deviceId, index.data());
+        m_validColumnsIndexNumParallelSequences = numParallelSequences;
+        m_validColumnsIndexNumTimeSteps         = numTimeSteps;
+        m_validColumnsIndexSequences            = pMBLayout->GetAllSequences();
+    }
+
+    // a compact matrix of samples of the given layout as a tensor
+    static TensorView<ElemType> CompactTensorFor(const shared_ptr<Matrix<ElemType>>& data, const TensorShape& sampleLayout)
+    {
+        auto tensorShape = sampleLayout;
+        tensorShape.AppendInPlace(tensorShape.GetRank(), data->GetNumCols());
+        return TensorView<ElemType>(data, tensorShape);
+    }
+
+    void ForwardPropSkippingGapColumns(const FrameRange& fr)
+    {
+        const auto& index = *m_validColumnsIndex;
+        m_compactArgument->DoGatherColumnsOf(/*beta=*/0, index, InputRef(1).Value(), /*alpha=*/1);
+        m_compactResult->Resize(GetSampleMatrixNumRows(), index.GetNumCols());
+
+        auto input0 = OneSampleTensorFor(0, /*gradient=*/false, fr.AllowBroadcast());
+        auto input1 = CompactTensorFor(m_compactArgument, InputRef(1).GetSampleLayout());
+        auto output = CompactTensorFor(m_compactResult, GetSampleLayout());
+        output.AssignMatrixProductOf(false/*transC*/, input0, m_transpose/*transA*/, input1, false/*transB*/, 1.0f, nullptr, m_pPackedWeights);
+
+        Value().SetValue(0);
+        Value().DoScatterColumnsOf(/*beta=*/0, index, *m_compactResult, /*alpha=*/1);
+    }
+
+    void BackpropToSkippingGapColumns(const size_t inputIndex, const FrameRange& fr)
+    {
+        const auto& index = *m_validColumnsIndex;
+        m_compactGradient->DoGatherColumnsOf(/*beta=*/0, index, Gradient(), /*alpha=*/1);
+        auto outputGradient = CompactTensorFor(m_compactGradient, GetSampleLayout());
+
+        if (inputIndex == 0) // dA = dC * B' over the valid columns
+        {
+            m_compactTemp->DoGatherColumnsOf(/*beta=*/0, index, InputRef(1).Value(), /*alpha=*/1);
+            auto input0Gradient = OneSampleTensorFor(0, /*gradient=*/true, fr.AllowBroadcast());
+            auto input1         = CompactTensorFor(m_compactTemp, InputRef(1).GetSampleLayout());
+            if (OverwritesGradientOf(0))
+                input0Gradient.AssignMatrixProductOf(m_transpose/*transC*/, outputGradient, false/*transA*/, input1, true/*transB*/);
+            else
+                input0Gradient.AddMatrixProductOf(m_transpose/*transC*/, outputGradient, false/*transA*/, input1, true/*transB*/);
+        }
+        else // dB = op(A)' * dC, scattered into the valid columns
+        {
+            m_compactTemp->Resize(InputRef(1).GetSampleMatrixNumRows(), index.GetNumCols());
+            auto input0         = OneSampleTensorFor(0, /*gradient=*/false, fr.AllowBroadcast());
+            auto input1Gradient = CompactTensorFor(m_compactTemp, InputRef(1).GetSampleLayout());
+            input1Gradient.AssignMatrixProductOf(false/*transC*/, input0, !m_transpose/*transA*/, outputGradient, false/*transB*/);
+
+            bool overwrite = Input(inputIndex)->ParentOverwritesGradient();
+            if (overwrite)
+                InputRef(1).Gradient().SetValue(0);
+            InputRef(1).Gradient().DoScatterColumnsOf(/*beta=*/overwrite ? 0 : 1, index, *m_compactTemp, /*alpha=*/1);
+        }
+    }
+
+    // B is an elided RowStack (see SetStackedArgument()): input 'i' of the RowStack, and the columns of A it is multiplied by
+    ComputationNode<ElemType>& StackedInputRef(size_t i)
+    {
+        return dynamic_cast<ComputationNode<ElemType>&>(*InputRef(1).GetInputs()[i]);
+    }
+
+    TensorView<ElemType> StripeOfA(bool gradient, const FrameRange& fr, size_t i)
+    {
+        auto input0 = OneSampleTensorFor(0, gradient, fr.AllowBroadcast());
+        auto shape = input0.GetShape();
+        shape.NarrowTo(m_outputRank + InputRef(1).GetSampleLayout().GetRank() - 1, m_stackedFirstIndices[i], m_stackedFirstIndices[i + 1]);
+        return TensorView<ElemType>(gradient ? InputRef(0).GradientPtr() : InputRef(0).ValuePtr(), shape);
+    }
+
+    // C = sum_i A_i * B_i, where A_i are the columns of A that match the stripe of input i of the RowStack
+    void ForwardPropStacked(const FrameRange& fr)
+    {
+        size_t rank = InputRef(1).GetSampleLayout().GetRank();
+        auto output = OneSampleTensorFor(-1, /*gradient=*/false, fr);
+        for (size_t i = 0; i + 1 < m_stackedFirstIndices.size(); i++)
+        {
+            auto input1 = StackedInputRef(i).ValueTensorFor(rank, fr.AllowBroadcast());
+            output.DoMatrixProductOf(i == 0 ? 0.0f : 1.0f, false/*transC*/, StripeOfA(/*gradient=*/false, fr, i), false/*transA*/, input1, false/*transB*/, 1.0f);
+        }
+    }
+
+    // dA_i = dC * B_i', and dB_i = A_i' * dC straight into the gradients of the inputs of the RowStack
+    void BackpropToStacked(const size_t inputIndex, const FrameRange& fr)
+    {
+        size_t rank = InputRef(1).GetSampleLayout().GetRank();
+        auto outputGradient = OneSampleTensorFor(-1, /*gradient=*/true, fr);
+        if (inputIndex == 0)
+        {
+            if (Input(0)->ReducesInTimeWrt(shared_from_this()))
+                MaskMissingGradientColumnsToZero(fr);
+            bool maskInputs = Input(0)->ReducesInTimeWrt(Input(1));
+            ElemType beta = Input(0)->ParentOverwritesGradient() ? 0.0f : 1.0f;
+            for (size_t i = 0; i + 1 < m_stackedFirstIndices.size(); i++)
+            {
+                if (maskInputs)
+                    StackedInputRef(i).MaskMissingValueColumnsToZero(fr);
+                auto input1 = StackedInputRef(i).ValueTensorFor(rank, fr.AllowBroadcast());
+                StripeOfA(/*gradient=*/true, fr, i).DoMatrixProductOf(beta, false/*transC*/, outputGradient, false/*transA*/, input1, true/*transB*/, 1.0f);
+            }
+        }
+        else
+        {
+            for (size_t i = 0; i + 1 < m_stackedFirstIndices.size(); i++)
+            {
+                auto& input = StackedInputRef(i);
+                if (!input.NeedsGradient())
+                    continue;
+                input.LazyZeroGradient();
+                auto inputGradient = input.GradientTensorFor(rank, fr.AllowBroadcast());
+                inputGradient.DoMatrixProductOf(input.ParentOverwritesGradient() ? 0.0f : 1.0f, false/*transC*/, StripeOfA(/*gradient=*/false, fr, i), true/*transA*/, outputGradient, false/*transB*/, 1.0f);
+            }
+        }
+    }
+
 public:
     virtual void /*ComputationNode::*/ ForwardProp(const FrameRange& fr) override
     {
+        if (!m_stackedFirstIndices.empty())
+        {
+            ForwardPropStacked(fr);
+            return;
+        }
+
         // If argument A is minibatch data, then this must be performed frame-by-frame, sequence-by-sequence, one GEMM call each.
         // This will be inefficient. We hope this will be the baseline of a future, more efficient TensorView-based implementation.
         if (!fr.IsOneColumnWrt(InputRef(0).GetMBLayout()))
@@ -353,6 +591,16 @@ public:
                 return;
             }
 
+            // or compute all products with one batched GEMM
+            if (CanUseBatchMatrixProduct(fr, /*gradientIndex=*/-1))
+            {
+                auto input0 = BatchTensorFor(0,  /*gradient=*/false, fr.AllowBroadcast());
+                auto input1 = BatchTensorFor(1,  /*gradient=*/false, fr.AllowBroadcast());
+                auto output = BatchTensorFor(-1, /*gradient=*/false, fr);
+                output.AssignBatchMatrixProductOf(input0, m_transpose/*transA*/, input1, false/*transB*/, /*numBatchAxes=*/2);
+                return;
+            }
+
             // recursively call ourselves for each individual time and sequence
             auto timeRange     = fr.GetTimeRange();
             auto sequenceRange = fr.GetSequenceRange();
@@ -362,17 +610,31 @@ public:
             return;
         }
 
+        if (CanSkipGapColumns(fr, m_compactArgument, /*gradientIndex=*/-1))
+        {
+            ForwardPropSkippingGapColumns(fr);
+            return;
+        }
+
         // TensorView::DoMatrixProductOf() will reduce each tensor object into a 2D tensor (or fail if it cannot)
         // and recreate actual Matrix objects (in case of sparse, they must be identical to the original tensor storage object).
         // Transposition is applied after flattening into 2D, but only allowed if the input sample is 2D anyway.
         auto input0 = OneSampleTensorFor(0,  /*gradient=*/false, fr.AllowBroadcast());
         auto input1 = OneSampleTensorFor(1,  /*gradient=*/false, fr.AllowBroadcast());
         auto output = OneSampleTensorFor(-1, /*gradient=*/false, fr);
-        output.AssignMatrixProductOf(false/*transC*/, input0, m_transpose/*transA*/, input1, false/*transB*/, 1.0f, this->m_pQuantizedMultiplier);
+        output.AssignMatrixProductOf(false/*transC*/, input0, m_transpose/*transA*/, input1, false/*transB*/, 1.0f, this->m_pQuantizedMultiplier, m_pPackedWeights);
     }
 
     virtual void /*ComputationNode::*/ BackpropTo(const size_t inputIndex, const FrameRange& fr) override
     {
+        if (!m_stackedFirstIndices.empty())
+        {
+            BackpropToStacked(inputIndex, fr);
+            return;
+        }
+        if (inputIndex == 0 && m_transposedArgument)
+            TransposedInputRef().LazyZeroGradient();
+
         // special treatment if A is minibatch data; see Forward() for comment
         if (!fr.IsOneColumnWrt(InputRef(0).GetMBLayout()))
         {
@@ -383,6 +645,29 @@ public:
                 return;
             }
 
+            // or compute all products with one batched GEMM, as in forward
+            if (CanUseBatchMatrixProduct(fr, (int) inputIndex))
+            {
+                ElemType beta = Input(inputIndex)->ParentOverwritesGradient() ? (ElemType) 0 : (ElemType) 1;
+                auto outputGradient = BatchTensorFor(-1, /*gradient=*/true, fr);
+                if (inputIndex == 0) // dA = dC * B', or B * dC' if A is transposed
+                {
+                    auto input0Gradient = BatchTensorFor(0, /*gradient=*/true,  fr.AllowBroadcast());
+                    auto input1         = BatchTensorFor(1, /*gradient=*/false, fr.AllowBroadcast());
+                    if (!m_transpose)
+                        input0Gradient.DoBatchMatrixProductOf(beta, outputGradient, false/*transA*/, input1, true/*transB*/, 1.0f, /*numBatchAxes=*/2);
+                    else
+                        input0Gradient.DoBatchMatrixProductOf(beta, input1, false/*transA*/, outputGradient, true/*transB*/, 1.0f, /*numBatchAxes=*/2);
+                }
+                else // dB = op(A)' * dC
+                {
+                    auto input0         = BatchTensorFor(0, /*gradient=*/false, fr.AllowBroadcast());
+                    auto input1Gradient = BatchTensorFor(1, /*gradient=*/true,  fr.AllowBroadcast());
+                    input1Gradient.DoBatchMatrixProductOf(beta, input0, !m_transpose/*transA*/, outputGradient, false/*transB*/, 1.0f, /*numBatchAxes=*/2);
+                }
+                return;
+            }
+
             auto timeRange     = fr.GetTimeRange();
             auto sequenceRange = fr.GetSequenceRange();
             for (auto t = timeRange.first; t < timeRange.second; t++) // step left to right to allow to build a sparse matrix
@@ -391,6 +676,12 @@ public:
             return;
         }
 
+        if (CanSkipGapColumns(fr, m_compactGradient, (int) inputIndex))
+        {
+            BackpropToSkippingGapColumns(inputIndex, fr);
+            return;
+        }
+
         // this potentially computes inner products over time, so we must mask gaps to 0
         if (Input(inputIndex)->ReducesInTimeWrt(shared_from_this()))
             MaskMissingGradientColumnsToZero(fr);
@@ -401,7 +692,7 @@ public:
         {
             // currently we only support one combination when the input is sparse
             // If input data is sparse, then gradient is block sparse.
-            if (InputRef(1).Value().GetMatrixType() == SPARSE && InputRef(0).Gradient().GetMatrixType() == DENSE && Gradient().GetMatrixType() == DENSE)
+            if (!m_transposedArgument && InputRef(1).Value().GetMatrixType() == SPARSE && InputRef(0).Gradient().GetMatrixType() == DENSE && Gradient().GetMatrixType() == DENSE)
             {
                 // We need a sparse matrix for the gradient. We allocate a new one instead of switching the type in place
                 // since switching in place may affect other nodes who share this matrix due to memory sharing
@@ -420,7 +711,7 @@ public:
             auto input0Gradient = OneSampleTensorFor(0,  /*gradient=*/true,  fr.AllowBroadcast());
             auto input1         = OneSampleTensorFor(1,  /*gradient=*/false, fr.AllowBroadcast());
             auto outputGradient = OneSampleTensorFor(-1, /*gradient=*/true,  fr);
-            if (Input(inputIndex)->ParentOverwritesGradient())
+            if (OverwritesGradientOf(0))
                 input0Gradient.AssignMatrixProductOf(m_transpose/*transC*/, outputGradient, false/*transA*/, input1, true/*transB*/);
             else
                 input0Gradient.AddMatrixProductOf(m_transpose/*transC*/, outputGradient, false/*transA*/, input1, true/*transB*/);
@@ -443,6 +734,34 @@ public:
 
     virtual bool ImplementsGradientOverwriteOptimization() const override { return true; }
 
+    // Each output column takes one multiply-add per element of a sample of A, for the product as well as for the
+    // gradient into either input. A sparse B is taken to be one-hot, i.e. a lookup of one column of A.
+    virtual bool EstimateCost(bool forward, double& flops, double& bytes) const override
+    {
+        double numColumns  = HasMBLayout() ? (double) GetMBLayout()->GetNumCols() : 1;
+        double numAElements = Input(0)->GetNumMinibatchElements();
+        double numBElements = Input(1)->GetNumMinibatchElements();
+        double numOutputElements = GetNumMinibatchElements();
+        auto valueB = Input(1)->ValuePtr();
+        if (valueB && valueB->GetMatrixType() == SPARSE)
+        {
+            flops = 2 * numOutputElements;
+            numBElements = numColumns;
+        }
+        else
+            flops = 2 * Input(0)->GetSampleLayout().GetNumElements() * numColumns;
+        bytes = sizeof(ElemType) * (numAElements + numBElements + numOutputElements);
+
+        if (!forward)
+        {
+            // one product per input, which also reads and writes the input's gradient
+            double numGradients = (Input(0)->NeedsGradient() ? 1 : 0) + (Input(1)->NeedsGradient() ? 1 : 0);
+            flops *= numGradients;
+            bytes = numGradients * bytes + sizeof(ElemType) * ((Input(0)->NeedsGradient() ? numAElements : 0) + (Input(1)->NeedsGradient() ? numBElements : 0));
+        }
+        return true;
+    }
+
     virtual void /*ComputationNodeBase::*/ Validate(bool isFinalValidationPass) override
     {
         Base::Validate(isFinalValidationPass);
@@ -596,15 +915,145 @@ public:
         Base::AllocateGradientMatricesForInputs(matrixPool);
     }
 
+    virtual void RequestMatricesBeforeForwardProp(MatrixPool& matrixPool) override
+    {
+        Base::RequestMatricesBeforeForwardProp(matrixPool);
+        if (IsGapColumnSkippingCandidate())
+        {
+            RequestMatrixFromPool(m_compactArgument, matrixPool);
+            RequestMatrixFromPool(m_compactResult, matrixPool);
+        }
+    }
+
+    virtual void ReleaseMatricesAfterForwardProp(MatrixPool& matrixPool) override
+    {
+        Base::ReleaseMatricesAfterForwardProp(matrixPool);
+        if (m_compactArgument)
+        {
+            ReleaseMatrixToPool(m_compactArgument, matrixPool);
+            ReleaseMatrixToPool(m_compactResult, matrixPool);
+        }
+    }
+
+    virtual void RequestMatricesBeforeBackprop(MatrixPool& matrixPool) override
+    {
+        Base::RequestMatricesBeforeBackprop(matrixPool);
+        if (IsGapColumnSkippingCandidate())
+        {
+            RequestMatrixFromPool(m_compactGradient, matrixPool);
+            RequestMatrixFromPool(m_compactTemp, matrixPool);
+        }
+    }
+
+    virtual void ReleaseMatricesAfterBackprop(MatrixPool& matrixPool) override
+    {
+        Base::ReleaseMatricesAfterBackprop(matrixPool);
+        if (m_compactGradient)
+        {
+            ReleaseMatrixToPool(m_compactGradient, matrixPool);
+            ReleaseMatrixToPool(m_compactTemp, matrixPool);
+        }
+    }
+
     size_t OutputRank() const { return m_outputRank; }
     int InferInputRankToMap() const { return m_inferInputRankToMap; }
 
+    // concatenation elimination: B is a RowStack along the last axis of its samples whose value is never computed; the
+    // product is the sum of the products of the matching column stripes of A by the inputs of the RowStack, which receive
+    // their gradients directly as well (see ComputationNetwork::ElideInputs()). This needs a plain product by
+    // weights, i.e. no transposition, quantization or mapped input ranks, that reduces over all axes of B.
+    // 'firstIndices' are those of the RowStack (see RowStackNode::GetFirstIndices()), or empty to compute B normally.
+    bool CanComputeStackedArgument() const
+    {
+        return !m_transpose && !m_pQuantizedMultiplier && m_inferInputRankToMap < 0 &&
+               Input(0)->OperationName() == OperationNameOf(LearnableParameter) &&
+               Input(0)->GetSampleLayout().GetRank() == m_outputRank + Input(1)->GetSampleLayout().GetRank();
+    }
+
+    void SetStackedArgument(const std::vector<size_t>& firstIndices) { m_stackedFirstIndices = firstIndices; }
+
+    // transpose absorption: A is a TransposeDimensions of the two leading axes of a matrix that is not minibatch data,
+    // e.g. tied weights, whose value is never computed. The product reads the matrix through a view with swapped
+    // strides, which GEMM takes with its transposition flag, and the gradient of A goes into that of the matrix through
+    // the same view (see ComputationNetwork::ElideInputs()). This needs a plain product by a 2D A with one output axis.
+    bool CanAbsorbTransposedArgument() const
+    {
+        return !m_transpose && !m_pQuantizedMultiplier && m_stackedFirstIndices.empty() && m_outputRank == 1 &&
+               Input(0)->GetSampleLayout().GetRank() == 2 && !Input(0)->HasMBLayout();
+    }
+
+    void SetTransposedArgument(bool transposed) { m_transposedArgument = transposed; }
+
+    // inference with pruned weights: A can be a sparse matrix (see LearnableParameter::SwitchToSparseValue()) if the
+    // product uses its value matrix as it is, i.e. A is flattened to [first axis x the others], and it is not quantized.
+    bool CanUseSparseWeights() const
+    {
+        return !m_transpose && !m_pQuantizedMultiplier && m_outputRank == 1 && !Input(0)->HasMBLayout();
+    }
+
+    // Switches the node to fixed-point products for inference on the CPU, like QuantizedTimesNode: the weights (input 0)
+    // are quantized to 16-bit integers and laid out for the product right away, the data (input 1) is quantized in each
+    // ForwardProp(). See SymmetricQuantizer for the bit shifts. Returns false if the node does not multiply by weights.
+    bool EnableQuantizedInference(size_t bitShiftA, size_t bitShiftB)
+    {
+        auto weights = dynamic_pointer_cast<LearnableParameter<ElemType>>(Input(0));
+        if (!weights || m_transpose || weights->Value().GetDeviceId() != CPUDEVICE || weights->Value().GetMatrixType() != DENSE)
+            return false;
+        size_t m = GetSampleLayout().GetNumElements();
+        size_t numWeights = weights->Value().GetNumElements();
+        if (m == 0 || numWeights % m != 0 || numWeights > INT_MAX)
+            return false;
+
+        auto pQA = make_shared<SymmetricQuantizer<ElemType, short>>(bitShiftA);
+        auto pQB = make_shared<SymmetricQuantizer<ElemType, short>>(bitShiftB);
+        m_pQuantizedMultiplier = make_shared<QuantizedMultiplier<ElemType>>(pQA, /*isAConstant=*/true, pQB, /*isBConstant=*/false);
+        m_pQuantizedMultiplier->PrepareConstantA((int)m, (int)(numWeights / m), weights->Value().Data());
+        return true;
+    }
+
+    // CPU inference: keeps a copy of the weights (input 0) in the internal layout of the GEMM kernels, which the products
+    // use instead of cblas_?gemm copying the weights into it in every call, see PackedGemmMatrix. The weights must not
+    // change afterwards. Returns false if the node does not multiply by dense weights on the CPU, or nothing is packed
+    // because the BLAS library has no packed GEMM (only MKL has).
+    bool EnablePackedWeights()
+    {
+        auto weights = dynamic_pointer_cast<LearnableParameter<ElemType>>(Input(0));
+        if (!weights || m_pQuantizedMultiplier || m_outputRank != 1 || m_transposedArgument || !m_stackedFirstIndices.empty() ||
+            weights->Value().GetDeviceId() != CPUDEVICE || weights->Value().GetMatrixType() != DENSE)
+            return false;
+        const auto& value = weights->Value();
+        if (value.IsEmpty() || value.GetNumRows() > INT_MAX || value.GetNumCols() > INT_MAX)
+            return false;
+
+        // the product flattens A to the [first axis x the others] of its value matrix, so op(A) is that, or its transpose
+        int rows = (int)value.GetNumRows(), cols = (int)value.GetNumCols();
+        auto packedWeights = make_shared<PackedGemmMatrix<ElemType>>(value.Data(), m_transpose ? cols : rows, m_transpose ? rows : cols, m_transpose);
+        if (!packedWeights->IsPacked())
+            return false;
+        m_pPackedWeights = packedWeights;
+        return true;
+    }
+
 protected: 
     shared_ptr<QuantizedMultiplier<ElemType>> m_pQuantizedMultiplier;
+    shared_ptr<PackedGemmMatrix<ElemType>> m_pPackedWeights; // see EnablePackedWeights()
 
 private:
     size_t m_outputRank;
     int m_inferInputRankToMap;  // -1 (not specified) or says how to expand shape of W, to keep this many mapping dims
+
+    // for skipping the gap columns, see CanSkipGapColumns()
+    shared_ptr<Matrix<ElemType>> m_validColumnsIndex; // [1 x number of valid columns], and the layout it was built for
+    size_t m_validColumnsIndexNumParallelSequences = 0;
+    size_t m_validColumnsIndexNumTimeSteps = 0;
+    vector<MBLayout::SequenceInfo> m_validColumnsIndexSequences;
+    shared_ptr<Matrix<ElemType>> m_compactArgument; // valid columns of B in ForwardProp()
+    shared_ptr<Matrix<ElemType>> m_compactResult;
+    shared_ptr<Matrix<ElemType>> m_compactGradient; // valid columns of the gradient in BackpropTo()
+    shared_ptr<Matrix<ElemType>> m_compactTemp;
+
+    std::vector<size_t> m_stackedFirstIndices; // B is an elided RowStack, see SetStackedArgument()
+    bool m_transposedArgument = false;         // A is an absorbed TransposeDimensions, see SetTransposedArgument()
 };
 
 // -----------------------------------------------------------------------
@@ -677,13 +1126,16 @@ template class TransposeTimesNode<double>;
 // Fixed-point matrix product. This scales inputs to 16bit signed integers by Symmetric quantizers, performs
 // integer multiplication using SSE/AVX2, and transforms the results back.
 // Only dense untransposed matrix multiplication will be quantized. If at least one matrix is sparse then it will fall back to un-quantized default evaluation
-// Currently it works for CPU only. On GPU logicError will be thrown.
+// On the GPU, the product is not quantized either, so that a quantized model can still be evaluated there.
 // One way to include this node to the network is with the Edit command:
 // ...
 // node => if node.name == 'LSTMoutput1.output' then QuantizedTimes(node.inputs[0], node.inputs[1], bitShiftA=1, bitShiftB=2) else node,
 // ...
+// The other is the "calibrateQuantization" command, which replaces the Times nodes by weights with this node and sets rangeB
+// from the values of B seen in sample data, see PostComputingActions::QuantizationCalibration().
 // bitShift(A|B) - bit shift parameters of quantizers for matrices A and B, see the quantizers for more details. Decreases the maximum range of quantziation by 2^bitShift to prevent integer overflow during BLAS routines.
 // bitShift=0 doesn't change the range; higher bitShift will decrease precision of quantization, but will make BLAS routines less prone to overflow.
+// rangeB - calibrated absolute max of B, beyond which its values are clipped; 0 to take the absolute max of each minibatch.
 // Other parameters - refer to the base multiplication class
 template <class ElemType>
 class QuantizedTimesNode : public TimesNodeBase<ElemType, false>
@@ -699,22 +1151,21 @@ private:
     // Quantizer bit shift for matrices A and B
     size_t m_bitShiftA; 
     size_t m_bitShiftB; 
+    // Calibrated range of B, or 0
+    double m_rangeB;
 
 public:
-    QuantizedTimesNode(DEVICEID_TYPE deviceId, const wstring& name, size_t bitShiftA = 1, size_t bitShiftB = 1, size_t outputRank = 1, int inferInputRankToMap = -1)
-        : Base(deviceId, name, outputRank, inferInputRankToMap), m_bitShiftA(bitShiftA), m_bitShiftB(bitShiftB)
+    QuantizedTimesNode(DEVICEID_TYPE deviceId, const wstring& name, size_t bitShiftA = 1, size_t bitShiftB = 1, size_t outputRank = 1, int inferInputRankToMap = -1, double rangeB = 0)
+        : Base(deviceId, name, outputRank, inferInputRankToMap), m_bitShiftA(bitShiftA), m_bitShiftB(bitShiftB), m_rangeB(rangeB)
     {
-        // TODO support multiplication on GPUs as well.
         if (deviceId != CPUDEVICE)
-            LogicError("Quantized operation is supposed to be used on CPU device only.");
-
-        shared_ptr<SymmetricQuantizer<ElemType, short>> pQA(new SymmetricQuantizer<ElemType, short>(m_bitShiftA));
-        shared_ptr<SymmetricQuantizer<ElemType, short>> qQB(new SymmetricQuantizer<ElemType, short>(m_bitShiftB));
-        this->m_pQuantizedMultiplier = shared_ptr<QuantizedMultiplier<ElemType>>(new QuantizedMultiplier<ElemType>(pQA, qQB));
+            fprintf(stderr, "QuantizedTimes: There are no quantized products on the GPU, %ls will use floating-point products.\n", name.c_str());
+        CreateQuantizedMultiplier();
     }
 
     QuantizedTimesNode(const ScriptableObjects::IConfigRecordPtr configp)
-        : QuantizedTimesNode(configp->Get(L"deviceId"), L"<placeholder>", configp->Get(L"bitShiftA"), configp->Get(L"bitShiftB"), configp->Get(L"outputRank"), configp->Get(L"inferInputRankToMap"))
+        : QuantizedTimesNode(configp->Get(L"deviceId"), L"<placeholder>", configp->Get(L"bitShiftA"), configp->Get(L"bitShiftB"), configp->Get(L"outputRank"), configp->Get(L"inferInputRankToMap"),
+                             configp->Find(L"rangeB") ? (double)configp->Get(L"rangeB") : 0.0)
     {
         AttachInputsFromConfig(configp, this->GetExpectedNumInputs());
     }
@@ -727,6 +1178,8 @@ public:
             auto node = dynamic_pointer_cast<QuantizedTimesNode<ElemType>>(nodeP);
             node->m_bitShiftA = m_bitShiftA;
             node->m_bitShiftB = m_bitShiftB;
+            node->m_rangeB = m_rangeB;
+            node->CreateQuantizedMultiplier();
         }
     }
 
@@ -735,6 +1188,7 @@ public:
         Base::Save(fstream);
         fstream << m_bitShiftA;
         fstream << m_bitShiftB;
+        fstream << m_rangeB;
     }
 
     virtual void Load(File& fstream, size_t modelVersion) override
@@ -742,6 +1196,9 @@ public:
         Base::Load(fstream, modelVersion);
         fstream >> m_bitShiftA;
         fstream >> m_bitShiftB;
+        if (modelVersion >= CNTK_MODEL_VERSION_20)
+            fstream >> m_rangeB;
+        CreateQuantizedMultiplier();
     }
 
     virtual void /*ComputationNode::*/ ForwardProp(const FrameRange& fr) override
@@ -759,6 +1216,16 @@ public:
         // This operation is intended only for inference
         NOT_IMPLEMENTED;
     }
+
+    double RangeB() const { return m_rangeB; }
+
+private:
+    void CreateQuantizedMultiplier()
+    {
+        shared_ptr<SymmetricQuantizer<ElemType, short>> pQA(new SymmetricQuantizer<ElemType, short>(m_bitShiftA));
+        shared_ptr<SymmetricQuantizer<ElemType, short>> qQB(new SymmetricQuantizer<ElemType, short>(m_bitShiftB, (ElemType)m_rangeB));
+        this->m_pQuantizedMultiplier = shared_ptr<QuantizedMultiplier<ElemType>>(new QuantizedMultiplier<ElemType>(pQA, qQB));
+    }
 };
 
 template class QuantizedTimesNode<float>;
@@ -884,6 +1351,9 @@ private:
 public:
     virtual void /*ComputationNode::*/ ForwardProp(const FrameRange& fr) override
     {
+        if (IsValueElided()) // the consumer reads the input with swapped strides, see ComputationNetwork::ElideInputs()
+            return;
+
         size_t rank = DetermineElementwiseTensorRank();
         auto output =                                  ValueTensorFor(                         rank, fr);
         auto input  = TensorView<ElemType>(InputRef(0).ValuePtr(), GetTransposedTensorSliceFor(rank, fr));
@@ -892,6 +1362,9 @@ public:
 
     virtual void /*ComputationNode::*/ BackpropTo(const size_t inputIndex, const FrameRange& fr) override
     {
+        if (IsValueElided()) // (and computes its gradient as well)
+            return;
+
         size_t rank = DetermineElementwiseTensorRank();
         auto outputGradient =                                  GradientTensorFor(                         rank, fr);
         auto inputGradient  = TensorView<ElemType>(InputRef(0).GradientPtr(), GetTransposedTensorSliceFor(rank, fr));
@@ -1164,116 +1637,21 @@ public:
     {
     }
 
+    // The cosines of all positive and negative pairs, and their gradients, are computed by one fused Matrix operation each,
+    // which computes the column norms once and does not materialize the shifted copies of the inputs.
     virtual void /*ComputationNode::*/ BackpropTo(const size_t inputIndex, const FrameRange& fr) override
     {
+        if (inputIndex > 1)
+            return; // shift and #neg are constants
+
         Matrix<ElemType> sliceInput0Value = InputRef(0).ValueFor(fr);
         Matrix<ElemType> sliceInput1Value = InputRef(1).ValueFor(fr);
         Matrix<ElemType> sliceOutputValue = ValueFor(fr);
         Matrix<ElemType> sliceInputGrad = Input(inputIndex)->GradientFor(fr);
         Matrix<ElemType> sliceThisGrad = GradientFor(fr);
 
-        BackpropToS(inputIndex, *m_invNorm0, *m_invNorm1, sliceOutputValue, *m_temp, *m_rightTerm, *m_leftTerm, *m_invNormSquare, sliceInput0Value, sliceInput1Value, InputRef(2).Value(), InputRef(3).Value(), sliceInputGrad, sliceThisGrad);
-    }
-
-    // functionValues, invNorm0, invNorm1 - output from the EvaluateNode() method
-    // temp, rightTerm, leftTerm - temporary matrices
-    // in0, in1, in2, in3 - input functionValues from other nodes
-    // inputGradientValues(x) - gradients to update, where x matches inputIndex
-    /*TODO: merge with call site*/ void BackpropToS(const size_t inputIndex, const Matrix<ElemType>& invNorm0, const Matrix<ElemType>& invNorm1, const Matrix<ElemType>& functionValues,
-                                                    Matrix<ElemType>& temp, Matrix<ElemType>& rightTerm, Matrix<ElemType>& leftTerm, Matrix<ElemType>& invNormSquare, // the temporary variables
-                                                    const Matrix<ElemType>& in0, const Matrix<ElemType>& in1, const Matrix<ElemType>& in2, const Matrix<ElemType>& in3,
-                                                    Matrix<ElemType>& inputGradientValues, Matrix<ElemType>& thisGradientValues)
-    {
-        size_t shift = (size_t) in2.Get00Element();
-        size_t negNumber = (size_t) in3.Get00Element();
-        size_t numCols = in0.GetNumCols(); // used in computing right child's graident
-
-        if (inputIndex == 0) // left derivative
-        {
-            invNormSquare.AssignElementProductOf(invNorm0, invNorm0);
-
-            for (long m = 0; m < negNumber + 1; m++)
-            {
-                temp.GetARowByIndex(functionValues, m); // set this matrx to be the m-th row in functionValues
-                temp.ElementMultiplyWith(invNormSquare);
-
-                Matrix<ElemType>::ConductRowElementMultiplyWithShift(temp, in0, rightTerm, 0, true);
-
-                if (m == 0)
-                {
-                    temp.AssignElementProductOf(invNorm0, invNorm1);
-
-                    Matrix<ElemType>::ConductRowElementMultiplyWithShift(temp, in1, leftTerm, 0, true);
-                }
-                else
-                {
-                    size_t currshift = m + shift - 1; // for current line, how much should we shift
-
-                    temp.AssignElementProductOfWithShift(invNorm0, invNorm1, currshift); // this is a row vector
-
-                    Matrix<ElemType>::ConductRowElementMultiplyWithShift(temp, in1, leftTerm, currshift, true);
-                }
-
-                leftTerm -= rightTerm;
-
-                temp.GetARowByIndex(thisGradientValues, m);
-
-                Matrix<ElemType>::ConductRowElementMultiplyWithShift(temp, leftTerm, rightTerm, 0, true);
-
-                inputGradientValues += rightTerm;
-            }
-        }
-        else // right part
-        {
-            invNormSquare.AssignElementProductOf(invNorm1, invNorm1); // this matrix should be save and unchanged. It should not be changed
-
-            for (long m = 0; m < negNumber + 1; m++)
-            {
-                temp.GetARowByIndex(functionValues, m); // set this matrx to be the m-th row in functionValues
-
-                if (m == 0) // this is the first line. computation should be symmetric
-                {
-                    // the following is for the right part
-                    temp.ElementMultiplyWith(invNormSquare);
-
-                    Matrix<ElemType>::ConductRowElementMultiplyWithShift(temp, in1, rightTerm, 0, true);
-
-                    // the following is for the left part
-                    temp.AssignElementProductOf(invNorm0, invNorm1);
-
-                    Matrix<ElemType>::ConductRowElementMultiplyWithShift(temp, in0, leftTerm, 0, true);
-
-                    leftTerm -= rightTerm;
-
-                    temp.GetARowByIndex(thisGradientValues, m);
-
-                    Matrix<ElemType>::ConductRowElementMultiplyWithShift(temp, leftTerm, rightTerm, 0, true);
-
-                    inputGradientValues += rightTerm;
-                }
-                else // this requires shift
-                {
-                    size_t currshift = (m + shift - 1) % numCols;
-                    size_t reverseshift = numCols - currshift;
-
-                    leftTerm.AssignElementProductOfWithShift(invNormSquare, temp, reverseshift); // use leftTerm as a temp variable here
-
-                    Matrix<ElemType>::ConductRowElementMultiplyWithShift(leftTerm, in1, rightTerm, 0, true);
-
-                    temp.AssignElementProductOfWithShift(invNorm1, invNorm0, reverseshift);
-
-                    Matrix<ElemType>::ConductRowElementMultiplyWithShift(temp, in0, leftTerm, reverseshift, true);
-
-                    leftTerm -= rightTerm;
-
-                    temp.GetARowByIndex(thisGradientValues, m);
-
-                    Matrix<ElemType>::ConductRowElementMultiplyWithShift(temp, leftTerm, rightTerm, reverseshift, false);
-
-                    inputGradientValues += rightTerm;
-                }
-            }
-        }
+        size_t shift = (size_t) InputRef(2).Get00Element();
+        sliceInputGrad.AddCosDistanceWithNegativeSamplesGradientOf(sliceThisGrad, sliceOutputValue, sliceInput0Value, sliceInput1Value, *m_invNorm0, *m_invNorm1, shift, /*isRightInput=*/inputIndex == 1);
     }
 
     virtual void /*ComputationNode::*/ ForwardProp(const FrameRange& fr) override
@@ -1282,31 +1660,11 @@ public:
         Matrix<ElemType> sliceInput1Value = InputRef(1).ValueFor(fr);
         Matrix<ElemType> sliceOutputValue = ValueFor(fr);
 
-        ForwardPropS(*m_invNorm0, *m_invNorm1, sliceOutputValue, sliceInput0Value, sliceInput1Value, InputRef(2).Value(), InputRef(3).Value(), *m_leftTerm, *m_rightTerm);
-    }
-
-    /*TODO: merge with call site*/ void ForwardPropS(Matrix<ElemType>& invNorm0, Matrix<ElemType>& invNorm1, Matrix<ElemType>& functionValues, Matrix<ElemType>& in0, Matrix<ElemType>& in1, Matrix<ElemType>& in2, Matrix<ElemType>& in3, Matrix<ElemType>& leftTermTemp, Matrix<ElemType>& rightTermTemp)
-    {
-        invNorm0.AssignVectorNorm2Of(in0, true); // seems to modify input (in0)
-        invNorm0.AssignElementInverseOf(invNorm0);
-
-        invNorm1.AssignVectorNorm2Of(in1, true); // seems to modify the input (in1)
-        invNorm1.AssignElementInverseOf(invNorm1);
+        size_t shift = (size_t) InputRef(2).Get00Element();
+        size_t negNumber = (size_t) InputRef(3).Get00Element();
 
-        size_t shift = (size_t) in2.Get00Element();
-        size_t negNumber = (size_t) in3.Get00Element();
-
-        // mutiply invNorm0 and invNorm1 with shift and neg.
-        // The result is a matrix of (numberneg+1, invNorm0.Cols)
-        leftTermTemp.AssignElementProductOfWithShiftNeg(invNorm0, invNorm1, shift, negNumber);
-
-        // compute the right values
-        // Again, the output is a matrix of (negNumber+1, invNorm0.cols)
-        rightTermTemp.AssignInnerProductOfWithShiftNeg(in0, in1, true, shift, negNumber);
-
-        // compute the evaluation result matrix by multiply these two matrices, element by element
-        // we get a (negNumber+1, n) matrix
-        functionValues.AssignElementProductOf(leftTermTemp, rightTermTemp);
+        // the result is a matrix of (negNumber+1, n); invNorm0 and invNorm1 are kept for the gradient
+        sliceOutputValue.AssignCosDistanceWithNegativeSamplesOf(sliceInput0Value, sliceInput1Value, shift, negNumber, *m_invNorm0, *m_invNorm1);
     }
 
     virtual void /*ComputationNodeBase::*/ Validate(bool isFinalValidationPass) override
@@ -1337,10 +1695,6 @@ public:
             auto node = dynamic_pointer_cast<CosDistanceWithNegativeSamplesNode<ElemType>>(nodeP);
             node->m_invNorm0->SetValue(*m_invNorm0);
             node->m_invNorm1->SetValue(*m_invNorm1);
-            node->m_invNormSquare->SetValue(*m_invNormSquare);
-            node->m_leftTerm->SetValue(*m_leftTerm);
-            node->m_rightTerm->SetValue(*m_rightTerm);
-            node->m_temp->SetValue(*m_temp);
         }
     }
     // request matrices needed to do node function value evaluation
@@ -1349,16 +1703,6 @@ public:
         Base::RequestMatricesBeforeForwardProp(matrixPool);
         RequestMatrixFromPool(m_invNorm0, matrixPool);
         RequestMatrixFromPool(m_invNorm1, matrixPool);
-        RequestMatrixFromPool(m_leftTerm, matrixPool);
-        RequestMatrixFromPool(m_rightTerm, matrixPool);
-    }
-
-    // request matrices that are needed for gradient computation
-    virtual void RequestMatricesBeforeBackprop(MatrixPool& matrixPool)
-    {
-        Base::RequestMatricesBeforeBackprop(matrixPool);
-        RequestMatrixFromPool(m_invNormSquare, matrixPool);
-        RequestMatrixFromPool(m_temp, matrixPool);
     }
 
     // release gradient and temp matrices that no longer needed after all the children's gradients are computed.
@@ -1367,21 +1711,12 @@ public:
         Base::ReleaseMatricesAfterBackprop(matrixPool);
         ReleaseMatrixToPool(m_invNorm0, matrixPool);
         ReleaseMatrixToPool(m_invNorm1, matrixPool);
-        ReleaseMatrixToPool(m_leftTerm, matrixPool);
-        ReleaseMatrixToPool(m_rightTerm, matrixPool);
-        ReleaseMatrixToPool(m_invNormSquare, matrixPool);
-        ReleaseMatrixToPool(m_temp, matrixPool);
     }
 
 private:
     // invNorm nodes tranfer data between ForwardProp and BackpropTo
     shared_ptr<Matrix<ElemType>> m_invNorm0;
     shared_ptr<Matrix<ElemType>> m_invNorm1;
-    shared_ptr<Matrix<ElemType>> m_leftTerm;
-    shared_ptr<Matrix<ElemType>> m_rightTerm;
-    // the rest are temporaries, values don't need to be maintained
-    shared_ptr<Matrix<ElemType>> m_invNormSquare;
-    shared_ptr<Matrix<ElemType>> m_temp;
 };
 
 template class CosDistanceWithNegativeSamplesNode<float>;
@@ -1430,6 +1765,9 @@ public:
 
     virtual bool InputUsedInComputingInputNodesGradients(size_t /*childIndex*/) const override { return false; }
 
+    // accumulates in ForwardProp(), so it must not run twice per minibatch
+    virtual bool SupportsValueRecomputation() const override { return false; }
+
     virtual void OnEpochStart() override;
 
     virtual void /*ComputationNodeNonLooping::*/ ForwardPropNonLooping() override;
@@ -8,36 +8,151 @@
 #include <string>
 #include <stdexcept>
 #include <vector>
+#include <map>
 #include <algorithm>
+#include <type_traits>
 #include <stdlib.h>
 
 #include "Basics.h"
+#include "Globals.h"
 #include "Matrix.h"
-#include "ComputationNode.h"
 
 namespace Microsoft { namespace MSR { namespace CNTK {
 
 // MatrixPool -- class to support memory sharing
 // Despite the gather general name of this class, it is specifically designed to support the memory sharing of ComputationNodes.
-// Note: see #define SUPRESS_MEMSHARING below as for how to temporarily disable memory sharing altogether, for debugging
+//
+// The pool operates according to a MemorySharingPolicy (see Globals.h), selected at runtime:
+//  - Off: every Request() creates a new matrix; nothing is shared. Useful for debugging.
+//  - LIFO (default): Request() hands out whatever matrix was released last, regardless of size.
+//  - SizeAware: Request() and Release() are only recorded, together with the requested size and a step counter
+//    that defines the lifetime of each request. Once ComputationNetwork::AllocateAllMatrices() has simulated
+//    the complete forward/backward pass, OptimizedMemoryAllocation() assigns the actual buffers by best-fit
+//    size class such that requests with overlapping lifetimes never share a buffer. A request may have a second
+//    lifetime if its value is recomputed before backprop (activation checkpointing, see RequestForRecompute()).
+// In all modes, requests are logged so that the resulting sharing structure can be reported (GetMemoryReport()).
+// Except with Off, a request can be handed on to a node that computes its value in place over it (RequestInPlace()).
 class MatrixPool
 {
+    // one recorded request
+    template <class ElemType>
+    struct MemRequestInfo
+    {
+        // a slot that handed this request on with RequestInPlace(); it keeps sharing the matrix
+        struct InPlaceSlot
+        {
+            shared_ptr<Matrix<ElemType>>* m_pMatrixPtr;
+            std::wstring m_ownerName;
+            std::wstring m_matrixName;
+        };
+
+        DEVICEID_TYPE m_deviceId;
+        shared_ptr<Matrix<ElemType>>* m_pMatrixPtr; // the slot (owned by the node) that receives the shared buffer
+        size_t m_matrixSize;                         // requested number of elements (per sample if m_mbScale); 0 if unknown
+        bool m_mbScale;                              // size scales with the minibatch size
+        size_t m_allocStep;                          // step at which the matrix was requested
+        size_t m_releaseStep;                        // step at which the matrix was released; SIZE_MAX if alive until the end
+        size_t m_recomputeAllocStep;                 // second live interval if the value is recomputed before backprop (see RequestForRecompute())
+        size_t m_recomputeReleaseStep;               // SIZE_MAX if none or alive until the end
+        int m_bufferId;                              // buffer it was assigned to by OptimizedMemoryAllocation(); -1 if not yet planned
+        std::wstring m_ownerName;                    // for reporting: name of the requesting node
+        std::wstring m_matrixName;                   // for reporting: which of the node's matrices, e.g. L"value"
+        std::vector<InPlaceSlot> m_inPlaceSlots;     // earlier owners of the matrix, see RequestInPlace()
+
+        MemRequestInfo(DEVICEID_TYPE deviceId, shared_ptr<Matrix<ElemType>>* pMatrixPtr, size_t matrixSize, bool mbScale, size_t allocStep,
+                       const std::wstring& ownerName, const std::wstring& matrixName)
+            : m_deviceId(deviceId), m_pMatrixPtr(pMatrixPtr), m_matrixSize(matrixSize), m_mbScale(mbScale),
+              m_allocStep(allocStep), m_releaseStep(SIZE_MAX), m_recomputeAllocStep(SIZE_MAX), m_recomputeReleaseStep(SIZE_MAX),
+              m_bufferId(-1), m_ownerName(ownerName), m_matrixName(matrixName)
+        {
+        }
+
+        bool HasRecomputeInterval() const { return m_recomputeAllocStep != SIZE_MAX; }
+
+        bool HasInPlaceSlot(const shared_ptr<Matrix<ElemType>>* pMatrixPtr) const
+        {
+            return std::any_of(m_inPlaceSlots.begin(), m_inPlaceSlots.end(), [pMatrixPtr](const InPlaceSlot& slot) { return slot.m_pMatrixPtr == pMatrixPtr; });
+        }
+
+        bool OverlapsWith(const MemRequestInfo& other) const
+        {
+            auto overlaps = [](size_t begin1, size_t end1, size_t begin2, size_t end2)
+            {
+                return begin1 < end2 && begin2 < end1;
+            };
+            return overlaps(m_allocStep, m_releaseStep, other.m_allocStep, other.m_releaseStep) ||
+                   (HasRecomputeInterval() && overlaps(m_recomputeAllocStep, m_recomputeReleaseStep, other.m_allocStep, other.m_releaseStep)) ||
+                   (other.HasRecomputeInterval() && overlaps(m_allocStep, m_releaseStep, other.m_recomputeAllocStep, other.m_recomputeReleaseStep)) ||
+                   (HasRecomputeInterval() && other.HasRecomputeInterval() && overlaps(m_recomputeAllocStep, m_recomputeReleaseStep, other.m_recomputeAllocStep, other.m_recomputeReleaseStep));
+        }
+    };
+
+    // one buffer of the allocation plan, shared by all requests assigned to it
+    struct MemBufferInfo
+    {
+        DEVICEID_TYPE m_deviceId;
+        bool m_mbScale;
+        size_t m_bufferSize;          // largest size of all requests assigned to this buffer
+        std::vector<size_t> m_requests; // indices into the request vector
+    };
+
     vector<shared_ptr<Matrix<float>>>  m_releasedFloatMatrices;
     vector<shared_ptr<Matrix<double>>> m_releasedDoubleMatrices;
 
+    vector<MemRequestInfo<float>>  m_floatMemRequestInfoVec;
+    vector<MemRequestInfo<double>> m_doubleMemRequestInfoVec;
+
+    MemorySharingPolicy m_policy = MemorySharingPolicy::LIFO;
+    size_t m_stepCounter = 0; // logical clock that orders requests and releases
+
     template <class ElemType>
     vector<shared_ptr<Matrix<ElemType>>>& GetReleasedMatrices();
 
+    template <class ElemType>
+    vector<MemRequestInfo<ElemType>>& GetMemRequestInfoVec();
+
 public:
+    // select the sharing policy; must be called before the first Request()
+    void SetPolicy(MemorySharingPolicy policy)
+    {
+        if (!m_floatMemRequestInfoVec.empty() || !m_doubleMemRequestInfoVec.empty())
+            LogicError("MatrixPool::SetPolicy: cannot change the policy while requests are pending.");
+        m_policy = policy;
+    }
+
+    MemorySharingPolicy GetPolicy() const { return m_policy; }
+
     // release here means the matrix can be put back and shared by others
     template <class ElemType>
-    void Release(shared_ptr<Matrix<ElemType>> freeMatrix)
+    void Release(shared_ptr<Matrix<ElemType>>* pMatrixPtr)
     {
-        if (freeMatrix == nullptr || freeMatrix->GetMatrixType() == SPARSE)
+        if (pMatrixPtr == nullptr || *pMatrixPtr == nullptr || (*pMatrixPtr)->GetMatrixType() == SPARSE)
             LogicError("MatrixPool::Release: freeMatrix should not be null or sparse.");
-//#define SUPRESS_MEMSHARING // #define this to disable memory sharing through this structure
-        // TODO: Make this a runtime option.
-#ifndef SUPRESS_MEMSHARING
+
+        // Find the pending request for this slot. Matrices not obtained through Request() are not shared.
+        auto& memInfoVec = GetMemRequestInfoVec<ElemType>();
+        auto iter = std::find_if(memInfoVec.rbegin(), memInfoVec.rend(), [pMatrixPtr](const MemRequestInfo<ElemType>& info)
+        {
+            return info.m_pMatrixPtr == pMatrixPtr;
+        });
+        if (iter == memInfoVec.rend())
+        {
+            // A slot that handed its request on with RequestInPlace() has nothing to release; the matrix lives on.
+            if (std::any_of(memInfoVec.begin(), memInfoVec.end(), [pMatrixPtr](const MemRequestInfo<ElemType>& info) { return info.HasInPlaceSlot(pMatrixPtr); }))
+                return;
+        }
+        else
+        {
+            if (iter->m_releaseStep == SIZE_MAX)
+                iter->m_releaseStep = m_stepCounter++;
+            else if (iter->HasRecomputeInterval() && iter->m_recomputeReleaseStep == SIZE_MAX)
+                iter->m_recomputeReleaseStep = m_stepCounter++;
+        }
+
+        if (m_policy != MemorySharingPolicy::LIFO)
+            return;
+
+        const auto& freeMatrix = *pMatrixPtr;
         vector<shared_ptr<Matrix<ElemType>>>& releasedMatrices = GetReleasedMatrices<ElemType>();
 #ifdef _DEBUG
         for (int i = 0; i < releasedMatrices.size(); i++)
@@ -48,17 +163,22 @@ public:
 
 #endif
         releasedMatrices.push_back(freeMatrix);
-#endif
     }
 
+    // request a matrix for the slot 'pMatrixPtr'
+    // 'matrixSize' is the number of elements the matrix will hold (per sample if 'mbScale'), or 0 if not known upfront.
+    // With the SizeAware policy, the slot receives an empty placeholder that is replaced by OptimizedMemoryAllocation().
     template <class ElemType>
-    shared_ptr<Matrix<ElemType>> Request(DEVICEID_TYPE deviceId)
+    void Request(DEVICEID_TYPE deviceId, shared_ptr<Matrix<ElemType>>* pMatrixPtr, size_t matrixSize = 0, bool mbScale = true,
+                 const std::wstring& ownerName = std::wstring(), const std::wstring& matrixName = std::wstring())
     {
-        vector<shared_ptr<Matrix<ElemType>>>& releasedMatrices = GetReleasedMatrices<ElemType>();
+        GetMemRequestInfoVec<ElemType>().push_back(MemRequestInfo<ElemType>(deviceId, pMatrixPtr, matrixSize, mbScale, m_stepCounter++, ownerName, matrixName));
+
         shared_ptr<Matrix<ElemType>> matrixPtr;
-        if (releasedMatrices.empty())
+        vector<shared_ptr<Matrix<ElemType>>>& releasedMatrices = GetReleasedMatrices<ElemType>();
+        if (m_policy != MemorySharingPolicy::LIFO || releasedMatrices.empty())
         {
-            matrixPtr = make_shared<Matrix<ElemType>>(deviceId);
+            matrixPtr = make_shared<Matrix<ElemType>>(deviceId); // (for SizeAware, a placeholder: an empty matrix holds no memory)
         }
         else
         {
@@ -69,7 +189,267 @@ public:
         if (!matrixPtr) // this can't really happen
             LogicError("MatrixPool::Request: failed to get a valid matrix.");
 
-        return matrixPtr;
+        *pMatrixPtr = matrixPtr;
+    }
+
+    // hand the pending request of 'pInputMatrixPtr' on to the slot 'pMatrixPtr', for a node that computes its value in
+    // place over that of its input: both slots then share the matrix, which lives until the new owner releases it, and a
+    // Release() of the input's slot does nothing. Returns false if the input's matrix cannot be taken over: with the Off
+    // policy, if it was not requested from the pool, if it has been released already, or if it is recomputed.
+    template <class ElemType>
+    bool RequestInPlace(shared_ptr<Matrix<ElemType>>* pMatrixPtr, shared_ptr<Matrix<ElemType>>* pInputMatrixPtr,
+                        const std::wstring& ownerName = std::wstring(), const std::wstring& matrixName = std::wstring())
+    {
+        if (m_policy == MemorySharingPolicy::Off)
+            return false;
+
+        auto& memInfoVec = GetMemRequestInfoVec<ElemType>();
+        auto iter = std::find_if(memInfoVec.rbegin(), memInfoVec.rend(), [pInputMatrixPtr](const MemRequestInfo<ElemType>& info)
+        {
+            return info.m_pMatrixPtr == pInputMatrixPtr;
+        });
+        if (iter == memInfoVec.rend() || iter->m_releaseStep != SIZE_MAX || iter->HasRecomputeInterval())
+            return false;
+
+        iter->m_inPlaceSlots.push_back(typename MemRequestInfo<ElemType>::InPlaceSlot{ iter->m_pMatrixPtr, iter->m_ownerName, iter->m_matrixName });
+        iter->m_pMatrixPtr = pMatrixPtr;
+        iter->m_ownerName = ownerName;
+        iter->m_matrixName = matrixName;
+        *pMatrixPtr = *pInputMatrixPtr;
+        return true;
+    }
+
+    // open a second live interval for a matrix that was requested and released before
+    // This is used for values that are released after forward prop and recomputed right before their backprop
+    // (activation checkpointing), or copied to host memory and back (activation offloading). Only the SizeAware policy
+    // can honor this, since the slot keeps its buffer:
+    // in between, the buffer is available to other requests. The interval is closed by the next Release().
+    template <class ElemType>
+    void RequestForRecompute(shared_ptr<Matrix<ElemType>>* pMatrixPtr)
+    {
+        if (m_policy != MemorySharingPolicy::SizeAware)
+            LogicError("MatrixPool::RequestForRecompute: requires the SizeAware memory sharing policy.");
+
+        auto& memInfoVec = GetMemRequestInfoVec<ElemType>();
+        auto iter = std::find_if(memInfoVec.rbegin(), memInfoVec.rend(), [pMatrixPtr](const MemRequestInfo<ElemType>& info)
+        {
+            return info.m_pMatrixPtr == pMatrixPtr;
+        });
+        if (iter == memInfoVec.rend() || iter->m_releaseStep == SIZE_MAX || iter->HasRecomputeInterval())
+            LogicError("MatrixPool::RequestForRecompute: matrix must have been requested and released exactly once before.");
+        iter->m_recomputeAllocStep = m_stepCounter++;
+    }
+
+    // close the current round of requests
+    // With the SizeAware policy, this assigns buffers to all recorded requests and hands them to the requesting slots.
+    // Requests are processed from largest to smallest. Each request goes into the smallest existing buffer (same
+    // device and size class) that is not in use during its lifetime; a new buffer is created if there is none.
+    // For all policies, the sharing structure is retained for GetAllocationPlanStatistics() and GetMemoryReport().
+    void OptimizedMemoryAllocation()
+    {
+        m_planStatistics = AllocationPlanStatistics();
+        m_report.clear();
+        m_floatBuffers.clear();
+        m_doubleBuffers.clear();
+        OptimizedMemoryAllocation<float>();
+        OptimizedMemoryAllocation<double>();
+        m_stepCounter = 0;
+    }
+
+    // summary of the last allocation round, in bytes per sample for minibatch-scaled requests
+    struct AllocationPlanStatistics
+    {
+        size_t m_numRequests = 0;
+        size_t m_numBuffers = 0;
+        size_t m_requestedBytes = 0;   // sum of all requests, i.e. without any sharing
+        size_t m_plannedPeakBytes = 0; // largest sum of simultaneously live requests (lower bound for any sharing scheme)
+        size_t m_allocatedBytes = 0;   // sum of all buffers (what will actually be allocated)
+    };
+
+    const AllocationPlanStatistics& GetAllocationPlanStatistics() const { return m_planStatistics; }
+
+    // one request of the last allocation round, for reporting
+    struct MemoryReportEntry
+    {
+        std::wstring m_nodeName;
+        std::wstring m_matrixName;
+        size_t m_elementSize;
+        size_t m_numElements;  // per sample if m_mbScale; 0 if not known at allocation time
+        bool m_mbScale;
+        size_t m_allocStep;
+        size_t m_releaseStep;  // SIZE_MAX if never released
+        size_t m_recomputeAllocStep;   // SIZE_MAX if the value is not recomputed before backprop
+        size_t m_recomputeReleaseStep;
+        size_t m_bufferId;     // requests with the same buffer id share memory
+    };
+
+    const std::vector<MemoryReportEntry>& GetMemoryReport() const { return m_report; }
+
+    size_t GetNumBuffers() const { return m_floatBuffers.size() + m_doubleBuffers.size(); }
+
+    // bytes currently allocated by a buffer of the last allocation round; 0 once it has been freed
+    size_t GetBufferAllocatedBytes(size_t bufferId) const
+    {
+        if (bufferId < m_floatBuffers.size())
+        {
+            auto matrix = m_floatBuffers[bufferId].lock();
+            return matrix ? matrix->BufferSize() : 0;
+        }
+        auto matrix = m_doubleBuffers.at(bufferId - m_floatBuffers.size()).lock();
+        return matrix ? matrix->BufferSize() : 0;
+    }
+
+    size_t GetAllocatedBytes() const
+    {
+        size_t bytes = 0;
+        for (size_t i = 0; i < GetNumBuffers(); i++)
+            bytes += GetBufferAllocatedBytes(i);
+        return bytes;
+    }
+
+    // the matrix of a buffer of the last allocation round; nullptr once it has been freed
+    const MatrixBase* GetBuffer(size_t bufferId) const
+    {
+        if (bufferId < m_floatBuffers.size())
+            return m_floatBuffers[bufferId].lock().get();
+        return m_doubleBuffers.at(bufferId - m_floatBuffers.size()).lock().get();
+    }
+
+private:
+    AllocationPlanStatistics m_planStatistics;
+    std::vector<MemoryReportEntry> m_report;
+    std::vector<std::weak_ptr<Matrix<float>>> m_floatBuffers;   // buffer ids [0, #float buffers)
+    std::vector<std::weak_ptr<Matrix<double>>> m_doubleBuffers; // buffer ids following the float ones
+
+    template <class ElemType>
+    std::vector<std::weak_ptr<Matrix<ElemType>>>& GetBuffers();
+
+    template <class ElemType>
+    void OptimizedMemoryAllocation()
+    {
+        auto& memInfoVec = GetMemRequestInfoVec<ElemType>();
+        if (memInfoVec.empty())
+            return;
+
+        if (m_policy == MemorySharingPolicy::SizeAware)
+            AssignBuffersBestFit(memInfoVec);
+
+        // Determine the resulting buffers from matrix identity. This covers all policies.
+        auto& buffers = GetBuffers<ElemType>();
+        std::map<const Matrix<ElemType>*, size_t> bufferIds;
+        std::vector<size_t> bufferSizes;
+        for (const auto& request : memInfoVec)
+        {
+            const auto& matrixPtr = *request.m_pMatrixPtr;
+            auto result = bufferIds.insert(make_pair(matrixPtr.get(), buffers.size()));
+            if (result.second)
+            {
+                buffers.push_back(matrixPtr);
+                bufferSizes.push_back(0);
+            }
+            size_t bufferId = result.first->second;
+            bufferSizes[bufferId] = std::max(bufferSizes[bufferId], request.m_matrixSize);
+
+            size_t reportedBufferId = bufferId + (std::is_same<ElemType, double>::value ? m_floatBuffers.size() : 0);
+            for (const auto& slot : request.m_inPlaceSlots)
+                m_report.push_back(MemoryReportEntry{ slot.m_ownerName, slot.m_matrixName, sizeof(ElemType), request.m_matrixSize, request.m_mbScale,
+                                                      request.m_allocStep, request.m_releaseStep, request.m_recomputeAllocStep, request.m_recomputeReleaseStep,
+                                                      reportedBufferId });
+            m_report.push_back(MemoryReportEntry{ request.m_ownerName, request.m_matrixName, sizeof(ElemType), request.m_matrixSize, request.m_mbScale,
+                                                  request.m_allocStep, request.m_releaseStep, request.m_recomputeAllocStep, request.m_recomputeReleaseStep,
+                                                  reportedBufferId });
+        }
+
+        // statistics: peak of simultaneously live requests follows from a sweep over the sorted alloc/release events
+        std::vector<std::pair<size_t, long long>> events; // (step, +/- bytes)
+        size_t requestedBytes = 0;
+        for (const auto& request : memInfoVec)
+        {
+            size_t bytes = request.m_matrixSize * sizeof(ElemType);
+            requestedBytes += bytes;
+            events.push_back(make_pair(request.m_allocStep, (long long)bytes));
+            if (request.m_releaseStep != SIZE_MAX)
+                events.push_back(make_pair(request.m_releaseStep, -(long long)bytes));
+            if (request.HasRecomputeInterval())
+            {
+                events.push_back(make_pair(request.m_recomputeAllocStep, (long long)bytes));
+                if (request.m_recomputeReleaseStep != SIZE_MAX)
+                    events.push_back(make_pair(request.m_recomputeReleaseStep, -(long long)bytes));
+            }
+        }
+        std::sort(events.begin(), events.end());
+        long long live = 0, peak = 0;
+        for (const auto& e : events)
+        {
+            live += e.second;
+            peak = std::max(peak, live);
+        }
+
+        size_t allocatedBytes = 0;
+        for (auto bufferSize : bufferSizes)
+            allocatedBytes += bufferSize * sizeof(ElemType);
+
+        m_planStatistics.m_numRequests      += memInfoVec.size();
+        m_planStatistics.m_numBuffers       += bufferSizes.size();
+        m_planStatistics.m_requestedBytes   += requestedBytes;
+        m_planStatistics.m_plannedPeakBytes += (size_t)peak;
+        m_planStatistics.m_allocatedBytes   += allocatedBytes;
+
+        memInfoVec.clear();
+    }
+
+    template <class ElemType>
+    void AssignBuffersBestFit(vector<MemRequestInfo<ElemType>>& memInfoVec)
+    {
+        // largest first; requests of unknown size come last and never grow a buffer
+        std::vector<size_t> order(memInfoVec.size());
+        for (size_t i = 0; i < order.size(); i++)
+            order[i] = i;
+        std::stable_sort(order.begin(), order.end(), [&memInfoVec](size_t a, size_t b)
+        {
+            return memInfoVec[a].m_matrixSize > memInfoVec[b].m_matrixSize;
+        });
+
+        std::vector<MemBufferInfo> buffers;
+        for (auto requestIndex : order)
+        {
+            auto& request = memInfoVec[requestIndex];
+            int bestFit = -1;
+            for (int b = 0; b < (int)buffers.size(); b++)
+            {
+                const auto& buffer = buffers[b];
+                if (buffer.m_deviceId != request.m_deviceId || buffer.m_mbScale != request.m_mbScale)
+                    continue;
+                if (bestFit >= 0 && buffers[bestFit].m_bufferSize <= buffer.m_bufferSize)
+                    continue;
+                bool isFree = std::none_of(buffer.m_requests.begin(), buffer.m_requests.end(), [&](size_t other)
+                {
+                    return memInfoVec[other].OverlapsWith(request);
+                });
+                if (isFree)
+                    bestFit = b;
+            }
+
+            if (bestFit < 0)
+            {
+                buffers.push_back(MemBufferInfo{ request.m_deviceId, request.m_mbScale, request.m_matrixSize, {} });
+                bestFit = (int)buffers.size() - 1;
+            }
+            buffers[bestFit].m_requests.push_back(requestIndex);
+            request.m_bufferId = bestFit;
+        }
+
+        // create one matrix per buffer and hand it to all slots sharing it
+        for (const auto& buffer : buffers)
+        {
+            auto matrixPtr = make_shared<Matrix<ElemType>>(buffer.m_deviceId);
+            for (auto requestIndex : buffer.m_requests)
+            {
+                *memInfoVec[requestIndex].m_pMatrixPtr = matrixPtr;
+                for (const auto& slot : memInfoVec[requestIndex].m_inPlaceSlots)
+                    *slot.m_pMatrixPtr = matrixPtr;
+            }
+        }
     }
 };
 
@@ -0,0 +1,466 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE.md file in the project root for full license information.
+//
+// ModelParallelNodes.cpp -- nodes for model parallelism: parameters distributed over the workers of data-parallel training,
+// and the transfers between the GPUs of pipeline stages
+//
+
+#include "Basics.h"
+#include "ModelParallelNodes.h"
+#include "InputAndParamNodes.h"
+#include "MPIWrapper.h"
+#include "GPUDataTransferer.h"
+
+#include <algorithm>
+#include <numeric>
+#include <vector>
+
+namespace Microsoft { namespace MSR { namespace CNTK {
+
+// dense matrices are exchanged through host buffers
+
+template <class ElemType>
+static void CopyToHost(const Matrix<ElemType>& matrix, std::vector<ElemType>& buffer)
+{
+    buffer.resize(matrix.GetNumElements());
+    if (!buffer.empty())
+        matrix.CopySection(matrix.GetNumRows(), matrix.GetNumCols(), buffer.data(), matrix.GetNumRows());
+}
+
+template <class ElemType>
+static void CopyFromHost(std::vector<ElemType>& buffer, size_t numRows, size_t numCols, Matrix<ElemType>& matrix)
+{
+    if (matrix.GetMatrixType() != DENSE)
+        matrix.SwitchToMatrixType(DENSE, matrixFormatDense, /*keepValues=*/false);
+    if (buffer.empty())
+        matrix.Resize(numRows, numCols);
+    else
+        matrix.SetValue(numRows, numCols, matrix.GetDeviceId(), buffer.data());
+}
+
+// -----------------------------------------------------------------------
+// RowShardedTimesNodeBase
+// -----------------------------------------------------------------------
+
+template <class ElemType, bool m_transpose>
+/*virtual*/ void RowShardedTimesNodeBase<ElemType, m_transpose>::SetRowSharding(const std::shared_ptr<MPIWrapper>& mpi, size_t numRows) /*override*/
+{
+    size_t numWorkers = mpi->NumNodesInUse();
+    if (numRows < numWorkers)
+        InvalidArgument("%ls: The %d rows of the parameter cannot be distributed over %d workers.", NodeDescription().c_str(), (int) numRows, (int) numWorkers);
+
+    m_mpi = mpi;
+    m_numFullRows = numRows;
+    m_rowBegins.resize(numWorkers + 1);
+    for (size_t worker = 0; worker < numWorkers; worker++)
+        m_rowBegins[worker] = GetRowShard(numRows, numWorkers, worker).first;
+    m_rowBegins[numWorkers] = numRows;
+
+    m_exchangedInput    = make_shared<Matrix<ElemType>>(m_deviceId);
+    m_exchangedGradient = make_shared<Matrix<ElemType>>(m_deviceId);
+    m_partialResult     = make_shared<Matrix<ElemType>>(m_deviceId);
+    m_inputGradient     = make_shared<Matrix<ElemType>>(m_deviceId);
+}
+
+template <class ElemType, bool m_transpose>
+size_t RowShardedTimesNodeBase<ElemType, m_transpose>::CurrentWorker() const
+{
+    return m_mpi->CurrentNodeRank();
+}
+
+template <class ElemType, bool m_transpose>
+/*virtual*/ void RowShardedTimesNodeBase<ElemType, m_transpose>::ForwardPropNonLooping() /*override*/
+{
+    // the products sum over the columns in backprop
+    if (InputRef(1).Value().GetMatrixType() == DENSE)
+        InputRef(1).MaskMissingValueColumnsToZero(FrameRange(InputRef(1).GetMBLayout()));
+
+    if (IsRowSharded())
+        ForwardPropSharded(InputRef(1).Value(), Value());
+    else
+        Matrix<ElemType>::Multiply(InputRef(0).Value(), m_transpose, InputRef(1).Value(), false, Value());
+}
+
+template <class ElemType, bool m_transpose>
+/*virtual*/ void RowShardedTimesNodeBase<ElemType, m_transpose>::BackpropToNonLooping(size_t inputIndex) /*override*/
+{
+    MaskMissingGradientColumnsToZero(FrameRange(GetMBLayout()));
+
+    ElemType beta = InputRef(inputIndex).ParentOverwritesGradient() ? 0 : 1;
+    if (IsRowSharded())
+    {
+        BackpropToSharded(inputIndex, Gradient());
+        if (inputIndex == 1 && beta == 0)
+            InputRef(1).Gradient().AssignValuesOf(*m_inputGradient);
+        else if (inputIndex == 1)
+            InputRef(1).Gradient() += *m_inputGradient;
+    }
+    else if (inputIndex == 0)
+    {
+        if (!m_transpose) // dW = dy x'
+            Matrix<ElemType>::MultiplyAndWeightedAdd(1, Gradient(), false, InputRef(1).Value(), true, beta, InputRef(0).Gradient());
+        else              // dE = x dz'
+            Matrix<ElemType>::MultiplyAndWeightedAdd(1, InputRef(1).Value(), false, Gradient(), true, beta, InputRef(0).Gradient());
+    }
+    else // dx = W' dy, or E dz
+        Matrix<ElemType>::MultiplyAndWeightedAdd(1, InputRef(0).Value(), !m_transpose, Gradient(), false, beta, InputRef(1).Gradient());
+}
+
+template <class ElemType, bool m_transpose>
+/*virtual*/ void RowShardedTimesNodeBase<ElemType, m_transpose>::ForwardPropWithoutData() /*override*/
+{
+    const auto& input = InputRef(1).Value();
+    Matrix<ElemType> noInput(InputRef(1).GetSampleMatrixNumRows(), 0, m_deviceId, input.GetMatrixType(), input.GetFormat());
+    Matrix<ElemType> noResult(GetSampleMatrixNumRows(), 0, m_deviceId);
+    ForwardPropSharded(noInput, noResult);
+}
+
+// in the order of ComputationNode::Backprop(); the parameter gradient must have been reset with the others
+template <class ElemType, bool m_transpose>
+/*virtual*/ void RowShardedTimesNodeBase<ElemType, m_transpose>::BackpropWithoutData() /*override*/
+{
+    Matrix<ElemType> noGradient(GetSampleMatrixNumRows(), 0, m_deviceId);
+    if (InputRef(0).NeedsGradient())
+    {
+        InputRef(0).LazyZeroGradient();
+        BackpropToSharded(0, noGradient);
+    }
+    if (InputRef(1).NeedsGradient())
+        BackpropToSharded(1, noGradient);
+}
+
+template <class ElemType, bool m_transpose>
+void RowShardedTimesNodeBase<ElemType, m_transpose>::ForwardPropSharded(const Matrix<ElemType>& input, Matrix<ElemType>& result)
+{
+    AllGatherNumColumns(input.GetNumCols());
+    m_isExchangedGradientCurrent = false;
+
+    const auto& param = InputRef(0).Value();
+    if (!m_transpose)
+    {
+        if (input.GetMatrixType() != DENSE)
+            InvalidArgument("%ls: When sharded, the input must be dense.", NodeDescription().c_str());
+        AllGatherColumns(input, *m_exchangedInput);                                          // x of all workers
+        Matrix<ElemType>::Multiply(param, false, *m_exchangedInput, false, *m_partialResult); // this worker's rows of W x
+        ExchangeColumnsForRows(*m_partialResult, result);                                    // all rows of this worker's columns
+    }
+    else
+    {
+        if (input.GetMatrixType() == SPARSE)
+            ExchangeSparseRowsForColumns(input, *m_exchangedInput);                          // this worker's rows of x of all workers
+        else
+            ExchangeRowsForColumns(input, *m_exchangedInput);
+        Matrix<ElemType>::Multiply(param, true, *m_exchangedInput, false, *m_partialResult);  // this worker's part of E' x
+        ReduceScatterColumns(*m_partialResult, result);                                      // summed over the workers, for this worker's columns
+    }
+}
+
+// leaves the gradient of x in m_inputGradient
+template <class ElemType, bool m_transpose>
+void RowShardedTimesNodeBase<ElemType, m_transpose>::BackpropToSharded(size_t inputIndex, const Matrix<ElemType>& gradient)
+{
+    if (!m_isExchangedGradientCurrent) // once for both inputs
+    {
+        if (!m_transpose)
+            ExchangeRowsForColumns(gradient, *m_exchangedGradient); // this worker's rows of the gradient of all workers
+        else
+            AllGatherColumns(gradient, *m_exchangedGradient);       // the gradient of all workers
+        m_isExchangedGradientCurrent = true;
+    }
+
+    if (inputIndex == 0) // the gradient of the shard covers the minibatches of all workers
+    {
+        ElemType beta = InputRef(0).ParentOverwritesGradient() ? 0 : 1;
+        if (!m_transpose)
+            Matrix<ElemType>::MultiplyAndWeightedAdd(1, *m_exchangedGradient, false, *m_exchangedInput, true, beta, InputRef(0).Gradient());
+        else
+            Matrix<ElemType>::MultiplyAndWeightedAdd(1, *m_exchangedInput, false, *m_exchangedGradient, true, beta, InputRef(0).Gradient());
+    }
+    else
+    {
+        Matrix<ElemType>::Multiply(InputRef(0).Value(), !m_transpose, *m_exchangedGradient, false, *m_partialResult);
+        if (!m_transpose)
+            ReduceScatterColumns(*m_partialResult, *m_inputGradient);   // W' dy summed over the rows of all workers
+        else
+            ExchangeColumnsForRows(*m_partialResult, *m_inputGradient); // all rows of E dz of this worker's columns
+    }
+}
+
+// -----------------------------------------------------------------------
+// the exchanges
+// Column blocks are contiguous in the column-major host buffers; row blocks are packed and unpacked column by column.
+// -----------------------------------------------------------------------
+
+template <class ElemType, bool m_transpose>
+void RowShardedTimesNodeBase<ElemType, m_transpose>::AllGatherNumColumns(size_t numColumns)
+{
+    int numOwnColumns = (int) numColumns;
+    std::vector<int> numColumnsOfWorkers(NumWorkers());
+    m_mpi->AllGather(&numOwnColumns, 1, numColumnsOfWorkers.data(), 1);
+
+    m_columnBegins.assign(1, 0);
+    for (int n : numColumnsOfWorkers)
+        m_columnBegins.push_back(m_columnBegins.back() + n);
+}
+
+// [R x own columns] -> [R x columns of all workers]
+template <class ElemType, bool m_transpose>
+void RowShardedTimesNodeBase<ElemType, m_transpose>::AllGatherColumns(const Matrix<ElemType>& own, Matrix<ElemType>& all) const
+{
+    size_t numRows = own.GetNumRows();
+    std::vector<int> recvCounts(NumWorkers()), recvOffsets(NumWorkers());
+    for (size_t worker = 0; worker < NumWorkers(); worker++)
+    {
+        recvCounts[worker]  = (int) (numRows * (m_columnBegins[worker + 1] - m_columnBegins[worker]));
+        recvOffsets[worker] = (int) (numRows * m_columnBegins[worker]);
+    }
+
+    std::vector<ElemType> sendBuffer, recvBuffer(numRows * m_columnBegins.back());
+    CopyToHost(own, sendBuffer);
+    m_mpi->AllGatherv(sendBuffer.data(), sendBuffer.size(), recvBuffer.data(), recvCounts.data(), recvOffsets.data());
+    CopyFromHost(recvBuffer, numRows, m_columnBegins.back(), all);
+}
+
+// [R x columns of all workers], partial sums -> [R x own columns], summed over the workers
+template <class ElemType, bool m_transpose>
+void RowShardedTimesNodeBase<ElemType, m_transpose>::ReduceScatterColumns(const Matrix<ElemType>& all, Matrix<ElemType>& own) const
+{
+    size_t numRows = all.GetNumRows();
+    std::vector<int> recvCounts(NumWorkers());
+    for (size_t worker = 0; worker < NumWorkers(); worker++)
+        recvCounts[worker] = (int) (numRows * (m_columnBegins[worker + 1] - m_columnBegins[worker]));
+
+    size_t me = CurrentWorker();
+    std::vector<ElemType> sendBuffer, recvBuffer(recvCounts[me]);
+    CopyToHost(all, sendBuffer);
+    m_mpi->ReduceScatter(sendBuffer.data(), recvBuffer.data(), recvCounts.data());
+    CopyFromHost(recvBuffer, numRows, m_columnBegins[me + 1] - m_columnBegins[me], own);
+}
+
+// [all rows x own columns] -> [own rows x columns of all workers]
+template <class ElemType, bool m_transpose>
+void RowShardedTimesNodeBase<ElemType, m_transpose>::ExchangeRowsForColumns(const Matrix<ElemType>& own, Matrix<ElemType>& shard) const
+{
+    if (own.GetNumRows() != m_numFullRows)
+        LogicError("%ls: ExchangeRowsForColumns: Expected %d rows, got %d.", NodeDescription().c_str(), (int) m_numFullRows, (int) own.GetNumRows());
+
+    size_t me = CurrentWorker();
+    size_t numOwnColumns = own.GetNumCols();
+    std::vector<ElemType> ownBuffer;
+    CopyToHost(own, ownBuffer);
+
+    std::vector<ElemType> sendBuffer(ownBuffer.size()), recvBuffer(ShardRows(me) * m_columnBegins.back());
+    std::vector<int> sendCounts(NumWorkers()), sendOffsets(NumWorkers()), recvCounts(NumWorkers()), recvOffsets(NumWorkers());
+    size_t sendOffset = 0;
+    for (size_t worker = 0; worker < NumWorkers(); worker++)
+    {
+        // the rows of 'worker' of the own columns
+        size_t numRows = ShardRows(worker);
+        for (size_t j = 0; j < numOwnColumns; j++)
+            std::copy_n(ownBuffer.data() + j * m_numFullRows + m_rowBegins[worker], numRows, sendBuffer.data() + sendOffset + j * numRows);
+        sendCounts[worker]  = (int) (numRows * numOwnColumns);
+        sendOffsets[worker] = (int) sendOffset;
+        sendOffset += numRows * numOwnColumns;
+
+        // the own rows of the columns of 'worker'
+        recvCounts[worker]  = (int) (ShardRows(me) * (m_columnBegins[worker + 1] - m_columnBegins[worker]));
+        recvOffsets[worker] = (int) (ShardRows(me) * m_columnBegins[worker]);
+    }
+
+    m_mpi->AllToAllv(sendBuffer.data(), sendCounts.data(), sendOffsets.data(), recvBuffer.data(), recvCounts.data(), recvOffsets.data());
+    CopyFromHost(recvBuffer, ShardRows(me), m_columnBegins.back(), shard);
+}
+
+// the same for sparse x, exchanging only the nonzeros, as (column, row within the shard) pairs and values
+template <class ElemType, bool m_transpose>
+void RowShardedTimesNodeBase<ElemType, m_transpose>::ExchangeSparseRowsForColumns(const Matrix<ElemType>& own, Matrix<ElemType>& shard) const
+{
+    if (own.GetNumRows() != m_numFullRows)
+        LogicError("%ls: ExchangeSparseRowsForColumns: Expected %d rows, got %d.", NodeDescription().c_str(), (int) m_numFullRows, (int) own.GetNumRows());
+
+    size_t me = CurrentWorker();
+    size_t numOwnColumns = own.GetNumCols();
+    std::vector<CPUSPARSE_INDEX_TYPE> columnStarts(1, 0), rowIndices;
+    std::vector<ElemType> values;
+    if (numOwnColumns > 0)
+        own.GetSparseCSCData(columnStarts, rowIndices, values);
+    auto workerOfRow = [&](CPUSPARSE_INDEX_TYPE row)
+    {
+        return (size_t) (std::upper_bound(m_rowBegins.begin(), m_rowBegins.end(), (size_t) row) - m_rowBegins.begin() - 1);
+    };
+
+    // the numbers of nonzeros
+    std::vector<int> sendCounts(NumWorkers(), 0), recvCounts(NumWorkers());
+    for (auto row : rowIndices)
+        sendCounts[workerOfRow(row)]++;
+    std::vector<int> ones(NumWorkers(), 1), workers(NumWorkers());
+    std::iota(workers.begin(), workers.end(), 0);
+    m_mpi->AllToAllv(sendCounts.data(), ones.data(), workers.data(), recvCounts.data(), ones.data(), workers.data());
+
+    std::vector<int> sendOffsets(NumWorkers(), 0), recvOffsets(NumWorkers(), 0);
+    std::partial_sum(sendCounts.begin(), sendCounts.end() - 1, sendOffsets.begin() + 1);
+    std::partial_sum(recvCounts.begin(), recvCounts.end() - 1, recvOffsets.begin() + 1);
+    size_t numSend = values.size();
+    size_t numRecv = recvOffsets.back() + recvCounts.back();
+
+    // the nonzeros, grouped by destination, in column order
+    std::vector<int> sendIndices(2 * numSend), recvIndices(2 * numRecv);
+    std::vector<ElemType> sendValues(numSend), recvValues(numRecv);
+    std::vector<int> next = sendOffsets;
+    for (size_t j = 0; j < numOwnColumns; j++)
+    {
+        for (auto k = columnStarts[j]; k < columnStarts[j + 1]; k++)
+        {
+            size_t worker = workerOfRow(rowIndices[k]);
+            int i = next[worker]++;
+            sendIndices[2 * i]     = (int) j;
+            sendIndices[2 * i + 1] = rowIndices[k] - (int) m_rowBegins[worker];
+            sendValues[i] = values[k];
+        }
+    }
+    m_mpi->AllToAllv(sendValues.data(), sendCounts.data(), sendOffsets.data(), recvValues.data(), recvCounts.data(), recvOffsets.data());
+    for (size_t worker = 0; worker < NumWorkers(); worker++)
+    {
+        sendCounts[worker] *= 2; sendOffsets[worker] *= 2;
+        recvCounts[worker] *= 2; recvOffsets[worker] *= 2;
+    }
+    m_mpi->AllToAllv(sendIndices.data(), sendCounts.data(), sendOffsets.data(), recvIndices.data(), recvCounts.data(), recvOffsets.data());
+
+    // they arrive ordered by worker, and thus by column
+    size_t numColumns = m_columnBegins.back();
+    std::vector<CPUSPARSE_INDEX_TYPE> shardColumnStarts(numColumns + 1, 0), shardRowIndices(numRecv);
+    for (size_t worker = 0; worker < NumWorkers(); worker++)
+    {
+        for (size_t i = recvOffsets[worker] / 2; i < (recvOffsets[worker] + recvCounts[worker]) / 2; i++)
+        {
+            shardColumnStarts[m_columnBegins[worker] + recvIndices[2 * i] + 1]++;
+            shardRowIndices[i] = recvIndices[2 * i + 1];
+        }
+    }
+    std::partial_sum(shardColumnStarts.begin(), shardColumnStarts.end(), shardColumnStarts.begin());
+
+    if (shard.GetMatrixType() != SPARSE)
+        shard.SwitchToMatrixType(SPARSE, matrixFormatSparseCSC, /*keepValues=*/false);
+    shard.SetMatrixFromCSCFormat(shardColumnStarts.data(), shardRowIndices.data(), recvValues.data(), numRecv, ShardRows(me), numColumns);
+}
+
+// [own rows x columns of all workers] -> [all rows x own columns]
+template <class ElemType, bool m_transpose>
+void RowShardedTimesNodeBase<ElemType, m_transpose>::ExchangeColumnsForRows(const Matrix<ElemType>& shard, Matrix<ElemType>& own) const
+{
+    size_t me = CurrentWorker();
+    size_t numOwnColumns = m_columnBegins[me + 1] - m_columnBegins[me];
+    std::vector<ElemType> sendBuffer;
+    CopyToHost(shard, sendBuffer);
+
+    std::vector<ElemType> recvBuffer(m_numFullRows * numOwnColumns), ownBuffer(m_numFullRows * numOwnColumns);
+    std::vector<int> sendCounts(NumWorkers()), sendOffsets(NumWorkers()), recvCounts(NumWorkers()), recvOffsets(NumWorkers());
+    for (size_t worker = 0; worker < NumWorkers(); worker++)
+    {
+        // the own rows of the columns of 'worker'
+        sendCounts[worker]  = (int) (ShardRows(me) * (m_columnBegins[worker + 1] - m_columnBegins[worker]));
+        sendOffsets[worker] = (int) (ShardRows(me) * m_columnBegins[worker]);
+
+        // the rows of 'worker' of the own columns
+        recvCounts[worker]  = (int) (ShardRows(worker) * numOwnColumns);
+        recvOffsets[worker] = (int) (m_rowBegins[worker] * numOwnColumns);
+    }
+
+    m_mpi->AllToAllv(sendBuffer.data(), sendCounts.data(), sendOffsets.data(), recvBuffer.data(), recvCounts.data(), recvOffsets.data());
+    for (size_t worker = 0; worker < NumWorkers(); worker++)
+    {
+        size_t numRows = ShardRows(worker);
+        for (size_t j = 0; j < numOwnColumns; j++)
+            std::copy_n(recvBuffer.data() + recvOffsets[worker] + j * numRows, numRows, ownBuffer.data() + j * m_numFullRows + m_rowBegins[worker]);
+    }
+    CopyFromHost(ownBuffer, m_numFullRows, numOwnColumns, own);
+}
+
+template <class ElemType, bool m_transpose>
+/*virtual*/ void RowShardedTimesNodeBase<ElemType, m_transpose>::Validate(bool isFinalValidationPass) /*override*/
+{
+    Base::Validate(isFinalValidationPass);
+    InferMBLayoutFromInputsForStandardCase(isFinalValidationPass);
+
+    if (isFinalValidationPass)
+    {
+        if (Input(0)->OperationName() != OperationNameOf(LearnableParameter) || Input(0)->GetSampleLayout().GetRank() != 2)
+            InvalidArgument("%ls requires a matrix parameter as its first input.", NodeDescription().c_str());
+        if (!HasMBLayout())
+            InvalidArgument("%ls requires minibatch data as its second input.", NodeDescription().c_str());
+        if (IsRowSharded() && Input(0)->GetAsMatrixNumRows() != ShardRows(CurrentWorker()))
+            LogicError("%ls: The parameter does not hold the rows of this worker.", NodeDescription().c_str());
+    }
+
+    // the parameter is [V x D]
+    size_t numRows = IsRowSharded() ? m_numFullRows : Input(0)->GetAsMatrixNumRows();
+    size_t numCols = Input(0)->GetAsMatrixNumCols();
+    size_t inputDim = m_transpose ? numRows : numCols;
+    if (isFinalValidationPass && Input(1)->GetSampleLayout().GetNumElements() != inputDim)
+        InvalidArgument("%ls: The input dimension %d does not match the parameter [%d x %d].", NodeDescription().c_str(),
+                        (int) Input(1)->GetSampleLayout().GetNumElements(), (int) numRows, (int) numCols);
+
+    SetDims(TensorShape(m_transpose ? numCols : numRows), HasMBLayout());
+}
+
+// -----------------------------------------------------------------------
+// PipelineTransferNode
+// -----------------------------------------------------------------------
+
+template <class ElemType>
+/*virtual*/ void PipelineTransferNode<ElemType>::SetPipelineMicroBatch(size_t microBatch, bool replay) /*override*/
+{
+    if (m_stashedValues.empty())
+        m_stashedValues.push_back(this->ValuePtrRef()); // (the one allocated as usual)
+    while (m_stashedValues.size() <= microBatch)
+        m_stashedValues.push_back(make_shared<Matrix<ElemType>>(m_deviceId));
+    this->ValuePtrRef() = m_stashedValues[microBatch];
+    m_replay = replay;
+}
+
+template <class ElemType>
+/*virtual*/ void PipelineTransferNode<ElemType>::ForwardPropNonLooping() /*override*/
+{
+    if (m_replay) // the value of this micro-batch is still there
+        return;
+
+    const auto& input = InputRef(0).Value();
+    if (input.GetMatrixType() != DENSE)
+        InvalidArgument("%ls: Only dense values can be passed between pipeline stages.", NodeDescription().c_str());
+    auto& value = Value();
+    value.Resize(input.GetNumRows(), input.GetNumCols());
+    if (!m_forwardTransferer)
+        m_forwardTransferer = make_shared<PeerGPUDataTransferer>(InputRef(0).GetDeviceId(), m_deviceId);
+    if (input.GetNumElements() > 0)
+        m_forwardTransferer->CopyAsync(input.Data(), input.GetNumElements() * sizeof(ElemType), value.Data());
+}
+
+template <class ElemType>
+/*virtual*/ void PipelineTransferNode<ElemType>::BackpropToNonLooping(size_t /*inputIndex*/) /*override*/
+{
+    const auto& gradient = Gradient();
+    if (!m_inputGradient)
+        m_inputGradient = make_shared<Matrix<ElemType>>(InputRef(0).GetDeviceId());
+    m_inputGradient->Resize(gradient.GetNumRows(), gradient.GetNumCols());
+    if (!m_backwardTransferer)
+        m_backwardTransferer = make_shared<PeerGPUDataTransferer>(m_deviceId, InputRef(0).GetDeviceId());
+    if (gradient.GetNumElements() > 0)
+        m_backwardTransferer->CopyAsync(gradient.Data(), gradient.GetNumElements() * sizeof(ElemType), m_inputGradient->Data());
+    InputRef(0).Gradient() += *m_inputGradient;
+}
+
+template class RowShardedTimesNodeBase<float, false>;
+template class RowShardedTimesNodeBase<double, false>;
+template class RowShardedTimesNodeBase<float, true>;
+template class RowShardedTimesNodeBase<double, true>;
+
+template class RowShardedTimesNode<float>;
+template class RowShardedTimesNode<double>;
+template class RowShardedTransposeTimesNode<float>;
+template class RowShardedTransposeTimesNode<double>;
+
+template class PipelineTransferNode<float>;
+template class PipelineTransferNode<double>;
+
+}}}
@@ -0,0 +1,214 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE.md file in the project root for full license information.
+//
+// ModelParallelNodes.h -- nodes for model parallelism: parameters distributed over the workers of data-parallel training,
+// and the transfers between the GPUs of pipeline stages
+//
+
+#pragma once
+
+#include "Basics.h"
+#include "ComputationNode.h"
+#include "Matrix.h"
+
+#include <algorithm>
+#include <memory>
+#include <utility>
+#include <vector>
+
+namespace Microsoft { namespace MSR { namespace CNTK {
+
+class MPIWrapper;
+class PeerGPUDataTransferer;
+
+// rows [first, second) of a parameter with 'numRows' rows that are kept by 'worker';
+// if the rows do not divide evenly, the first workers get one more
+inline std::pair<size_t, size_t> GetRowShard(size_t numRows, size_t numWorkers, size_t worker)
+{
+    size_t rowsPerWorker = numRows / numWorkers;
+    size_t numLargerShards = numRows % numWorkers;
+    size_t begin = worker * rowsPerWorker + std::min(worker, numLargerShards);
+    return std::make_pair(begin, begin + rowsPerWorker + (worker < numLargerShards ? 1 : 0));
+}
+
+// implemented by the row-sharded nodes, for ComputationNetwork::ShardParameterRows() and friends
+struct IRowShardedNode
+{
+    virtual ~IRowShardedNode() { }
+
+    // distribute the rows of the parameter (input 0), which has 'numRows' rows in full, over the workers of 'mpi'
+    virtual void SetRowSharding(const std::shared_ptr<MPIWrapper>& mpi, size_t numRows) = 0;
+    virtual bool IsRowSharded() const = 0;
+
+    // take part in the exchanges of a minibatch of the other workers, with no data of this worker
+    virtual void ForwardPropWithoutData() = 0;
+    virtual void BackpropWithoutData() = 0;
+};
+
+// -----------------------------------------------------------------------
+// RowShardedTimesNode (W, x)          -- W * x, e.g. for an output layer
+// RowShardedTransposeTimesNode (E, x) -- E' * x, e.g. for an embedding, where x is typically sparse
+//
+// W and E are matrix parameters [V x D], x is minibatch data. Without sharding (no MPI, a single worker, or before
+// ComputationNetwork::ShardParameterRows()), these are plain Times and TransposeTimes. Sharded, each worker keeps a
+// contiguous range of the rows of the parameter only, and the workers compute the product for the minibatches of all
+// workers together:
+//  - RowShardedTimes: the columns of x are all-gathered, each worker computes its rows of W * x for all of them, and
+//    an all-to-all exchange gives each worker all rows of its own columns. Backprop runs the all-to-all the other way
+//    and reduce-scatters the gradient of x.
+//  - RowShardedTransposeTimes: an all-to-all exchange gives each worker its rows of x of all columns (for sparse x only
+//    the nonzeros, i.e. the rows that are looked up), each worker computes its part of E' * x, and the parts are
+//    reduce-scattered. Backprop all-gathers the gradient.
+// Either way, the gradient of a parameter shard covers the minibatches of all workers, so it is not aggregated like the
+// gradients of the other parameters. All workers must run the node for every minibatch, also the ones that got no
+// data (ComputationNetwork::PropagateRowShardedNodesWithoutData()). The exchanges are staged through host memory.
+// -----------------------------------------------------------------------
+
+template <class ElemType, bool m_transpose>
+class RowShardedTimesNodeBase : public ComputationNodeNonLooping<ElemType>, public NumInputs<2>, public IRowShardedNode
+{
+    typedef ComputationNodeNonLooping<ElemType> Base; UsingComputationNodeMembers; using Base::OperationName;
+
+public:
+    RowShardedTimesNodeBase(DEVICEID_TYPE deviceId, const wstring& name)
+        : Base(deviceId, name), m_numFullRows(0), m_isExchangedGradientCurrent(false)
+    {
+    }
+
+    virtual void /*ComputationNodeNonLooping::*/ ForwardPropNonLooping() override;
+    virtual void /*ComputationNodeNonLooping::*/ BackpropToNonLooping(size_t inputIndex) override;
+    virtual bool OutputUsedInComputingInputNodesGradients() const override { return false; }
+    // sharded, the node keeps the exchanged minibatch input itself
+    virtual bool InputUsedInComputingInputNodesGradients(size_t childIndex) const override { return childIndex == 0 || !IsRowSharded(); }
+    // recomputing the value for backprop would repeat the exchanges on some workers only
+    virtual bool SupportsValueRecomputation() const override { return false; }
+    virtual void Validate(bool isFinalValidationPass) override;
+
+    virtual void /*IRowShardedNode::*/ SetRowSharding(const std::shared_ptr<MPIWrapper>& mpi, size_t numRows) override;
+    virtual bool /*IRowShardedNode::*/ IsRowSharded() const override { return m_mpi != nullptr; }
+    virtual void /*IRowShardedNode::*/ ForwardPropWithoutData() override;
+    virtual void /*IRowShardedNode::*/ BackpropWithoutData() override;
+
+private:
+    void ForwardPropSharded(const Matrix<ElemType>& input, Matrix<ElemType>& result);
+    void BackpropToSharded(size_t inputIndex, const Matrix<ElemType>& gradient);
+
+    // the exchanges between the workers
+    void AllGatherNumColumns(size_t numColumns);
+    void AllGatherColumns(const Matrix<ElemType>& own, Matrix<ElemType>& all) const;
+    void ReduceScatterColumns(const Matrix<ElemType>& all, Matrix<ElemType>& own) const;
+    void ExchangeRowsForColumns(const Matrix<ElemType>& own, Matrix<ElemType>& shard) const;
+    void ExchangeSparseRowsForColumns(const Matrix<ElemType>& own, Matrix<ElemType>& shard) const;
+    void ExchangeColumnsForRows(const Matrix<ElemType>& shard, Matrix<ElemType>& own) const;
+
+    size_t NumWorkers() const { return m_rowBegins.size() - 1; }
+    size_t ShardRows(size_t worker) const { return m_rowBegins[worker + 1] - m_rowBegins[worker]; }
+    size_t CurrentWorker() const;
+
+    std::shared_ptr<MPIWrapper> m_mpi; // null if not sharded
+    size_t m_numFullRows;              // of the parameter, if sharded
+    std::vector<size_t> m_rowBegins;   // [worker] -> first row of its shard; [NumWorkers()] = m_numFullRows
+    std::vector<size_t> m_columnBegins; // [worker] -> first column of its minibatch among those of all workers, for the current minibatch
+
+    // not from the MatrixPool: kept from forward prop to backprop, and sparse if the input is
+    shared_ptr<Matrix<ElemType>> m_exchangedInput;    // RowShardedTimes: x of all workers; RowShardedTransposeTimes: this worker's rows of x of all workers
+    shared_ptr<Matrix<ElemType>> m_exchangedGradient; // RowShardedTimes: this worker's rows of the gradient of all workers; RowShardedTransposeTimes: the gradient of all workers
+    shared_ptr<Matrix<ElemType>> m_partialResult;     // this worker's part of a product, before it is exchanged
+    shared_ptr<Matrix<ElemType>> m_inputGradient;     // of x, for this worker's minibatch
+    bool m_isExchangedGradientCurrent;                // m_exchangedGradient belongs to the current backprop
+};
+
+// -----------------------------------------------------------------------
+// RowShardedTimesNode (W, x)
+// -----------------------------------------------------------------------
+
+template <class ElemType>
+class RowShardedTimesNode : public RowShardedTimesNodeBase<ElemType, false>
+{
+    typedef RowShardedTimesNodeBase<ElemType, false> Base; UsingComputationNodeMembersBoilerplate;
+    static const std::wstring TypeName() { return L"RowShardedTimes"; }
+
+public:
+    DeclareConstructorFromConfigWithNumInputs(RowShardedTimesNode);
+    RowShardedTimesNode(DEVICEID_TYPE deviceId, const wstring& name)
+        : Base(deviceId, name)
+    {
+    }
+};
+
+// -----------------------------------------------------------------------
+// RowShardedTransposeTimesNode (E, x)
+// -----------------------------------------------------------------------
+
+template <class ElemType>
+class RowShardedTransposeTimesNode : public RowShardedTimesNodeBase<ElemType, true>
+{
+    typedef RowShardedTimesNodeBase<ElemType, true> Base; UsingComputationNodeMembersBoilerplate;
+    static const std::wstring TypeName() { return L"RowShardedTransposeTimes"; }
+
+public:
+    DeclareConstructorFromConfigWithNumInputs(RowShardedTransposeTimesNode);
+    RowShardedTransposeTimesNode(DEVICEID_TYPE deviceId, const wstring& name)
+        : Base(deviceId, name)
+    {
+    }
+};
+
+
+// implemented by PipelineTransferNode, for ComputationNetwork::SetPipelineMicroBatch()
+struct IPipelineTransferNode
+{
+    virtual ~IPipelineTransferNode() { }
+
+    // make the value the one kept for micro-batch 'microBatch' of the minibatch; with 'replay', forward prop leaves it as
+    // it is instead of copying the input again, so that a later stage can be recomputed from it
+    virtual void SetPipelineMicroBatch(size_t microBatch, bool replay) = 0;
+};
+
+// -----------------------------------------------------------------------
+// PipelineTransferNode (x) -- x, on the GPU of a later pipeline stage
+//
+// ComputationNetwork::CreatePipelined() inserts one for each value that is consumed on a later stage than it is
+// computed on. The node lives on the GPU of the consuming stage, its input on the one of the producing stage; forward
+// prop copies the value to it, and backprop copies the gradient back and adds it to the input's. The copies go GPU to
+// GPU (PeerGPUDataTransferer), and neither GPU waits for the other other than for the copy itself.
+// The node keeps its value for each micro-batch of a minibatch, since the later stages of all but the last micro-batch
+// are recomputed from it right before their backprop. Belonging to the producing stage, it is forward-propagated and
+// backpropagated with it. Model files do not contain these nodes (ComputationNetwork::Save()).
+// -----------------------------------------------------------------------
+
+template <class ElemType>
+class PipelineTransferNode : public ComputationNodeNonLooping<ElemType>, public NumInputs<1>, public IPipelineTransferNode
+{
+    typedef ComputationNodeNonLooping<ElemType> Base; UsingComputationNodeMembersBoilerplate;
+    static const std::wstring TypeName() { return L"PipelineTransfer"; }
+
+public:
+    DeclareConstructorFromConfigWithNumInputs(PipelineTransferNode);
+    PipelineTransferNode(DEVICEID_TYPE deviceId, const wstring& name)
+        : Base(deviceId, name), m_replay(false)
+    {
+        MarkValueNonSharable(); // the value is one of m_stashedValues
+    }
+
+    virtual void /*ComputationNodeNonLooping::*/ ForwardPropNonLooping() override;
+    virtual void /*ComputationNodeNonLooping::*/ BackpropToNonLooping(size_t inputIndex) override;
+    virtual bool OutputUsedInComputingInputNodesGradients() const override { return false; }
+    virtual bool InputUsedInComputingInputNodesGradients(size_t /*childIndex*/) const override { return false; }
+    virtual void Validate(bool isFinalValidationPass) override
+    {
+        Base::Validate(isFinalValidationPass);
+        ValidateUnaryMap(isFinalValidationPass);
+    }
+
+    virtual void /*IPipelineTransferNode::*/ SetPipelineMicroBatch(size_t microBatch, bool replay) override;
+
+private:
+    std::vector<shared_ptr<Matrix<ElemType>>> m_stashedValues; // [micro-batch]
+    bool m_replay;
+    shared_ptr<Matrix<ElemType>> m_inputGradient; // the gradient, on the GPU of the input
+    shared_ptr<PeerGPUDataTransferer> m_forwardTransferer, m_backwardTransferer; // created on first use
+};
+
+}}}
@@ -43,7 +43,7 @@ class UnaryElementWiseWithOpCodeNodeBase : public ComputationNode<ElemType>, pub
 
 public:
     UnaryElementWiseWithOpCodeNodeBase(DEVICEID_TYPE deviceId, const wstring& name)
-        : Base(deviceId, name)
+        : Base(deviceId, name), m_fastMath(false)
     {
     }
 
@@ -52,7 +52,7 @@ public:
         size_t rank = DetermineElementwiseTensorRank();
         auto result =             ValueTensorFor(rank, fr);
         auto input  = InputRef(0).ValueTensorFor(rank, fr);
-        result.DoUnaryOpOf(0, input, 1, opForward, opSum);
+        result.DoUnaryOpOf(0, input, 1, ForwardElementwiseOp(), opSum);
     }
 
     virtual void /*ComputationNode::*/ BackpropTo(const size_t inputIndex, const FrameRange& fr) override
@@ -99,7 +99,32 @@ public:
         return opType == binaryWithInputGradient;
     }
 
+    virtual ElementWiseOperator ForwardElementwiseOp() const override { return m_fastMath ? FastMathOpOf(opForward) : opForward; }
+
+    // the gradients use the exact derivatives, which for Sigmoid, Tanh and Exp are computed from the approximate output
+    virtual bool EnableFastMath() override
+    {
+        m_fastMath = FastMathOpOf(opForward) != opForward;
+        return m_fastMath;
+    }
+
+    virtual void CopyTo(ComputationNodeBasePtr nodeP, const std::wstring& newName, const CopyNodeFlags flags) const override
+    {
+        Base::CopyTo(nodeP, newName, flags);
+        if (flags & CopyNodeFlags::copyNodeValue)
+        {
+            auto node = dynamic_pointer_cast<UnaryElementWiseWithOpCodeNodeBase<ElemType, opForward, opBackward, opType>>(nodeP);
+            node->m_fastMath = m_fastMath;
+        }
+    }
+
+    // elementwise, so the value can overwrite the input (unless backprop still needs it, see InputUsedInComputingInputNodesGradients())
+    virtual bool ForwardPropCanRunInPlace() const override { return true; }
+
     virtual bool ImplementsGradientOverwriteOptimization() const override { return (opType != noGradient); }
+
+private:
+    bool m_fastMath; // see EnableFastMath()
 };
 
 #define UnaryElementWiseWithOpCodeNodeBaseMembers UsingComputationNodeMembersBoilerplate;
@@ -429,6 +454,108 @@ public:
 template class HardmaxNode<float>;
 template class HardmaxNode<double>;
 
+// -----------------------------------------------------------------------
+// TopK (input, k, outputIndices=false)
+// The k largest values of each sample of the input, in descending order, or with outputIndices their (0-based)
+// positions in the sample, e.g. the best classes of an output layer. Equal values are ordered by position.
+// Meant for inference with large outputs: only [k x T] instead of the whole output is copied back from the GPU,
+// where the values are selected per column (see GPUMatrix::VectorMax()) without sorting the whole output.
+// Values and indices come from separate nodes, each doing the selection. Like Hardmax, it has no gradient.
+// -----------------------------------------------------------------------
+
+template <class ElemType>
+class TopKNode : public ComputationNode<ElemType>, public NumInputs<1>
+{
+    typedef ComputationNode<ElemType> Base; UsingComputationNodeMembersBoilerplate;
+    static const std::wstring TypeName() { return L"TopK"; }
+
+public:
+    TopKNode(DEVICEID_TYPE deviceId, const wstring& name, size_t k = 1, bool outputIndices = false)
+        : Base(deviceId, name), m_k(k), m_outputIndices(outputIndices)
+    {
+    }
+    TopKNode(const ScriptableObjects::IConfigRecordPtr configp)
+        : TopKNode(configp->Get(L"deviceId"), L"<placeholder>", configp->Get(L"k"), configp->Find(L"outputIndices") ? (bool) configp->Get(L"outputIndices") : false)
+    {
+        AttachInputsFromConfig(configp, this->GetExpectedNumInputs());
+    }
+
+    virtual void Save(File& fstream) const override
+    {
+        Base::Save(fstream);
+        fstream << m_k << m_outputIndices;
+    }
+
+    virtual void Load(File& fstream, size_t modelVersion) override
+    {
+        Base::Load(fstream, modelVersion);
+        fstream >> m_k >> m_outputIndices;
+    }
+
+    virtual void CopyTo(ComputationNodeBasePtr nodeP, const std::wstring& newName, const CopyNodeFlags flags) const override
+    {
+        Base::CopyTo(nodeP, newName, flags);
+        auto node = dynamic_pointer_cast<TopKNode<ElemType>>(nodeP);
+        node->m_k = m_k;
+        node->m_outputIndices = m_outputIndices;
+    }
+
+    size_t K() const { return m_k; }
+    bool OutputsIndices() const { return m_outputIndices; }
+
+    virtual void /*ComputationNode::*/ ForwardProp(const FrameRange& fr) override
+    {
+        auto input  = InputRef(0).ValueFor(fr);
+        auto result =             ValueFor(fr);
+        if (m_outputIndices)
+            input.VectorMax(result, *m_otherResult, /*isColWise=*/true, (int) m_k);
+        else
+            input.VectorMax(*m_otherResult, result, /*isColWise=*/true, (int) m_k);
+    }
+
+    virtual void /*ComputationNode::*/ BackpropTo(const size_t /*inputIndex*/, const FrameRange& /*fr*/) override
+    {
+        // no gradient, but like Hardmax it may be part of a decoding loop that is trained
+    }
+
+    virtual bool OutputUsedInComputingInputNodesGradients() const override { return false; }
+    virtual bool InputUsedInComputingInputNodesGradients(size_t /*childIndex*/) const override { return false; }
+
+    virtual void /*ComputationNodeBase::*/ Validate(bool isFinalValidationPass) override
+    {
+        Base::Validate(isFinalValidationPass);
+        InferMBLayoutFromInputsForStandardCase(isFinalValidationPass);
+
+        size_t inputDim = Input(0)->GetSampleLayout().GetNumElements();
+        if (isFinalValidationPass && (m_k == 0 || m_k > inputDim))
+            InvalidArgument("%ls %ls operation: k (%d) must be between 1 and the dimension of the input (%d).", NodeName().c_str(), OperationName().c_str(), (int) m_k, (int) inputDim);
+        SetDims(TensorShape(m_k), HasMBLayout());
+    }
+
+    // the values if the node outputs the indices, and vice versa
+    virtual void RequestMatricesBeforeForwardProp(MatrixPool& matrixPool) override
+    {
+        Base::RequestMatricesBeforeForwardProp(matrixPool);
+        RequestMatrixFromPool(m_otherResult, matrixPool);
+    }
+
+    virtual void ReleaseMatricesAfterForwardProp(MatrixPool& matrixPool) override
+    {
+        Base::ReleaseMatricesAfterForwardProp(matrixPool);
+        ReleaseMatrixToPool(m_otherResult, matrixPool);
+    }
+
+    virtual bool SupportsValueRecomputation() const override { return false; }
+
+private:
+    size_t m_k;
+    bool m_outputIndices;
+    shared_ptr<Matrix<ElemType>> m_otherResult;
+};
+
+template class TopKNode<float>;
+template class TopKNode<double>;
+
 // -----------------------------------------------------------------------
 // If (flag, ifValue, elseValue)
 // -----------------------------------------------------------------------
@@ -15,6 +15,7 @@
 #include <map>
 #include <stdexcept>
 #include <string>
+#include <vector>
 
 // this file will contain computation nodes that require several atomic computation.
 
@@ -53,6 +54,7 @@ public:
     }
 
     virtual bool RequiresPreCompute() const override { return true; }
+    virtual bool SupportsValueRecomputation() const override { return false; }
 
     virtual void Save(File& fstream) const override
     {
@@ -173,6 +175,10 @@ public:
         }
     }
 
+    // Sets the accumulators, between MarkComputed(false) and MarkComputed(true), from statistics of the input
+    // that were gathered without forward passes (SGD's preComputeFromReader).
+    virtual void SetAccumulatedStatistics(const std::vector<double>& mean, const std::vector<double>& variance, size_t numSamples) = 0;
+
     virtual void BackpropToNonLooping(size_t /*inputIndex*/) override
     {
         // LogicError("Mean operation should not be involved in the gradient calculation.");
@@ -193,13 +199,25 @@ public:
 protected:
     size_t m_numSamples; // (SIZE_MAX while outside accumulation state)
     bool IsAccumulating() const { return m_numSamples != SIZE_MAX; }
+
+    // copies an accumulated statistic into a [dim x 1] matrix
+    void SetStatistic(Matrix<ElemType>& m, const std::vector<double>& statistic)
+    {
+        if (!IsAccumulating())
+            LogicError("%ls %ls operation: MarkComputed(false) has not been called.", NodeName().c_str(), OperationName().c_str());
+        if (statistic.size() != GetSampleLayout().GetNumElements())
+            LogicError("%ls %ls operation: Statistics of dimension %d given for an input of dimension %d.", NodeName().c_str(), OperationName().c_str(), (int) statistic.size(), (int) GetSampleLayout().GetNumElements());
+        std::vector<ElemType> values(statistic.begin(), statistic.end());
+        m.SetValue(values.size(), 1, m.GetDeviceId(), values.data());
+    }
 };
 
 #define UsingMeanInvStdDevNodeBaseNodeMembers \
     ComputationNodeBoilerplate;               \
     UsingPreComputedNodeMembers;              \
     using Base::m_numSamples;                 \
-    using Base::IsAccumulating
+    using Base::IsAccumulating;               \
+    using Base::SetStatistic
 
 // -----------------------------------------------------------------------
 // MeanNode (features)
@@ -233,6 +251,12 @@ public:
         // no else branch because ForwardPropNonLooping() already leaves a valid mean in m_value
     }
 
+    virtual void SetAccumulatedStatistics(const std::vector<double>& mean, const std::vector<double>& /*variance*/, size_t numSamples) override
+    {
+        SetStatistic(Value(), mean);
+        m_numSamples = numSamples;
+    }
+
     virtual void /*ComputationNodeNonLooping::*/ ForwardPropNonLooping() override
     {
         FrameRange fr(InputRef(0).GetMBLayout());
@@ -300,6 +324,13 @@ public:
         }
     }
 
+    virtual void SetAccumulatedStatistics(const std::vector<double>& mean, const std::vector<double>& variance, size_t numSamples) override
+    {
+        SetStatistic(*m_mean, mean);
+        SetStatistic(*m_var, variance);
+        m_numSamples = numSamples;
+    }
+
     virtual void /*ComputationNodeNonLooping::*/ ForwardPropNonLooping() override
     {
         FrameRange fr(InputRef(0).GetMBLayout());
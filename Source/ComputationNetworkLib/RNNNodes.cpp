@@ -22,7 +22,6 @@
 
 namespace Microsoft { namespace MSR { namespace CNTK {
 
-vector<size_t> numSequencesForFrame;
 // -----------------------------------------------------------------------
 // OptimizedRNNStackNode
 // -----------------------------------------------------------------------
@@ -130,8 +129,8 @@ void OptimizedRNNStackNode<ElemType>::ForwardProp(const FrameRange& fr)
         shapeYT = TensorShape(shapeYT.GetDims());
 
         // create a vector with the correct number of timesteps(shapeXT[2]) containing the sequence count (shapeXT[1])
-        numSequencesForFrame = vector<size_t>(shapeXT[2], shapeXT[1]);
-        m_transposedOutput->RNNForward(*m_transposedInput, paramW, shapeXT[0], shapeYT[0], numSequencesForFrame, m_rnnAttributes, *m_reserve, *m_workspace);
+        m_numSequencesForFrame.assign(shapeXT[2], shapeXT[1]);
+        m_transposedOutput->RNNForward(*m_transposedInput, paramW, shapeXT[0], shapeYT[0], m_numSequencesForFrame, m_rnnAttributes, *m_reserve, *m_workspace);
 
         // No one uses shapeY, but it is necessary
         TensorShape shapeY;
@@ -146,12 +145,12 @@ void OptimizedRNNStackNode<ElemType>::ForwardProp(const FrameRange& fr)
         shapeYT = TensorShape(          GetTensorSliceFor(SIZE_MAX, fr));
 
         // This changes the data from "minibatch paking" in InputRef(0).Value() to "dense CuDNN packing" in m_transposedInput
-        this->PackSequencesForCuDNN(InputRef(1).Value(), *m_transposedInput, numSequencesForFrame);
+        this->PackSequencesForCuDNN(InputRef(1).Value(), *m_transposedInput);
 
         // ensure enough storage
         m_transposedOutput->Resize(this->Value().GetNumRows(), m_transposedInput->GetNumCols());
 
-        m_transposedOutput->RNNForward(*m_transposedInput, paramW, shapeXT[0], shapeYT[0], numSequencesForFrame, m_rnnAttributes, *m_reserve, *m_workspace);
+        m_transposedOutput->RNNForward(*m_transposedInput, paramW, shapeXT[0], shapeYT[0], m_numSequencesForFrame, m_rnnAttributes, *m_reserve, *m_workspace);
         this->UnpackSequencesFromCuDNN(*m_transposedOutput, this->Value());
     }
     m_BackwardDataCalledYet = false;
@@ -261,75 +260,79 @@ void OptimizedRNNStackNode<ElemType>::Validate(bool isFinalValidationPass)
     }
 };
 
+// The permutation into the CuDNN packing only depends on the MBLayout. It is kept on the device and only recomputed when
+// the layout changes, which is rare e.g. with bucketing or with a fixed number of sequences per minibatch in evaluation.
 template<class ElemType>
-void OptimizedRNNStackNode<ElemType>::PackSequencesForCuDNN(const Matrix<ElemType>& src, Matrix<ElemType>& dst, vector<size_t>& numSequencesForFrame2)
+void OptimizedRNNStackNode<ElemType>::PackSequencesForCuDNN(const Matrix<ElemType>& src, Matrix<ElemType>& dst)
 {
     MBLayoutPtr mb = this->GetMBLayout();
-    if (mb->HasSequenceBeyondBegin())
-        RuntimeError("Invalid MBLayout: Only whole-utterance processing is supported");
+    if (!m_packedMBLayout || *m_packedMBLayout != *mb || m_packingIndex->GetDeviceId() != src.GetDeviceId())
+    {
+        if (mb->HasSequenceBeyondBegin())
+            RuntimeError("Invalid MBLayout: Only whole-utterance processing is supported");
 #if 0
-    BUGBUG: Disable this check to mask a problem with the way EvalReader creates segments.
-    if (mb->HasSequenceBeyondEnd())
-        RuntimeError("Invalid MBLayout: Only whole-utterance processing is supported");
+        BUGBUG: Disable this check to mask a problem with the way EvalReader creates segments.
+        if (mb->HasSequenceBeyondEnd())
+            RuntimeError("Invalid MBLayout: Only whole-utterance processing is supported");
 #endif
 
-    // retrieve only the non-gap sequences
-    vector<MBLayout::SequenceInfo> seq;
-    std::copy_if(
-        mb->GetAllSequences().begin(),
-        mb->GetAllSequences().end(),
-        back_inserter<vector<MBLayout::SequenceInfo>>(seq),
-        [](const MBLayout::SequenceInfo& x) { return x.seqId != GAP_SEQUENCE_ID; });
-
-    // sequenceOrder[i] will eventually be the i'th longest sequence,
-    // after sorting from longest to shortest. Ties are broken by the sequence id.
-    size_t numSequences = seq.size();
-    vector<size_t> sequenceOrder(numSequences);
-    for (size_t j = 0; j<numSequences; j++)
-        sequenceOrder[j] = j;
-    sort(sequenceOrder.begin(), sequenceOrder.end(), [&](size_t a, size_t b)
-    {
-        // sort in decreasing order of length
-        if (seq[a].GetNumTimeSteps() > seq[b].GetNumTimeSteps())
-            return true;
-        // break ties with increasing seqId
-        else if (seq[a].GetNumTimeSteps() == seq[b].GetNumTimeSteps())
-            return seq[a].seqId < seq[b].seqId;
-        return false;
-    });
-
-    size_t maxSeqLength = seq[sequenceOrder[0]].GetNumTimeSteps();
-    // BUGBUG: This forces the sequences to fit, due to a very bad convention in the evaldll interface.
-    if (maxSeqLength > mb->GetNumTimeSteps())
-        maxSeqLength = mb->GetNumTimeSteps();
-
-    // a count of how many sequnces are packed for a particular frame.
-    // reset to zero, and compute from current layout information
-    // this information is useful when creating the tensor descriptors for CuDNN.
-    numSequencesForFrame2.resize(maxSeqLength);
-    fill(numSequencesForFrame2.begin(), numSequencesForFrame2.end(), 0L);
-
-    // make sure the index is on CPU so we can use SetValue()
-    // 
-    m_packingIndex->TransferToDeviceIfNotThere(-1, true/*isBeingMoved*/, false/*emptyTransfer*/, false/*updatePreferredDevice*/);
-
-    // Reserve one element for every valid sample. DoGatherColumnsOf() requires it to be a row vector
-    m_packingIndex->Resize(1, mb->GetActualNumSamples());
-
-    size_t dst_frame = 0;
-    for (size_t fr = 0; fr < maxSeqLength; fr++)
-    {
-        for (size_t j = 0; j < numSequences && seq[sequenceOrder[j]].GetNumTimeSteps()>fr; j++)
+        // retrieve only the non-gap sequences
+        vector<MBLayout::SequenceInfo> seq;
+        std::copy_if(
+            mb->GetAllSequences().begin(),
+            mb->GetAllSequences().end(),
+            back_inserter<vector<MBLayout::SequenceInfo>>(seq),
+            [](const MBLayout::SequenceInfo& x) { return x.seqId != GAP_SEQUENCE_ID; });
+
+        // sequenceOrder[i] will eventually be the i'th longest sequence,
+        // after sorting from longest to shortest. Ties are broken by the sequence id.
+        size_t numSequences = seq.size();
+        vector<size_t> sequenceOrder(numSequences);
+        for (size_t j = 0; j<numSequences; j++)
+            sequenceOrder[j] = j;
+        sort(sequenceOrder.begin(), sequenceOrder.end(), [&](size_t a, size_t b)
         {
-            m_packingIndex->SetValue(0, dst_frame++, (ElemType)mb->GetColumnIndex(seq[sequenceOrder[j]], fr));
-            numSequencesForFrame2[fr]++;
+            // sort in decreasing order of length
+            if (seq[a].GetNumTimeSteps() > seq[b].GetNumTimeSteps())
+                return true;
+            // break ties with increasing seqId
+            else if (seq[a].GetNumTimeSteps() == seq[b].GetNumTimeSteps())
+                return seq[a].seqId < seq[b].seqId;
+            return false;
+        });
+
+        size_t maxSeqLength = seq[sequenceOrder[0]].GetNumTimeSteps();
+        // BUGBUG: This forces the sequences to fit, due to a very bad convention in the evaldll interface.
+        if (maxSeqLength > mb->GetNumTimeSteps())
+            maxSeqLength = mb->GetNumTimeSteps();
+
+        // a count of how many sequnces are packed for a particular frame.
+        // this information is useful when creating the tensor descriptors for CuDNN.
+        m_numSequencesForFrame.assign(maxSeqLength, 0);
+
+        // one element for every valid sample, as a row vector for DoGatherColumnsOf()
+        vector<ElemType> packingIndex;
+        packingIndex.reserve(mb->GetActualNumSamples());
+        for (size_t fr = 0; fr < maxSeqLength; fr++)
+        {
+            for (size_t j = 0; j < numSequences && seq[sequenceOrder[j]].GetNumTimeSteps()>fr; j++)
+            {
+                packingIndex.push_back((ElemType)mb->GetColumnIndex(seq[sequenceOrder[j]], fr));
+                m_numSequencesForFrame[fr]++;
+            }
         }
+        m_packingIndex->SetValue(1, packingIndex.size(), src.GetDeviceId(), packingIndex.data());
+
+        if (!m_packedMBLayout)
+            m_packedMBLayout = make_shared<MBLayout>();
+        m_packedMBLayout->CopyFrom(mb);
     }
 
     // this->gather(beta,idx,a,alpha) operation is defined as
     // *this[:,j] = a[:,idx[j]] * alpha + *this[:,j] * beta
     dst.DoGatherColumnsOf(0.0, *(this->m_packingIndex), src, 1.0);
 }
+
 template<class ElemType>
 void OptimizedRNNStackNode<ElemType>::UnpackSequencesFromCuDNN(const Matrix<ElemType>& src, Matrix<ElemType>& dst)
 {
@@ -57,6 +57,7 @@ public:
         RequestMatrixFromPool(m_reserve, matrixPool);
         RequestMatrixFromPool(m_workspace, matrixPool);
         RequestMatrixFromPool(m_packingIndex, matrixPool);
+        m_packedMBLayout = nullptr; // (a new m_packingIndex)
     }
 
     // request matrices needed to do node derivative value evaluation
@@ -82,10 +83,34 @@ public:
 #endif
     }
 
+    // (m_packingIndex is kept, it caches the packing of the last MBLayout)
+    virtual void ReleaseMatricesKeptForBackprop(MatrixPool& matrixPool) override
+    {
+        Base::ReleaseMatricesKeptForBackprop(matrixPool);
+        ReleaseMatrixToPool(m_transposedInput, matrixPool);
+        ReleaseMatrixToPool(m_transposedOutput, matrixPool);
+    }
+
     virtual bool OutputUsedInComputingInputNodesGradients() const { return false; }
     virtual bool InputUsedInComputingInputNodesGradients(size_t childIndex) const { return 0 == childIndex; }
     RnnAttributes Attributes() const { return m_rnnAttributes; }
 
+    // Each weight takes one multiply-add per frame, counting the gaps of the packed sequences.
+    // Backprop computes the gradients for the data and for the weights, about twice that.
+    virtual bool EstimateCost(bool forward, double& flops, double& bytes) const override
+    {
+        double numWeightElements = Input(0)->GetNumMinibatchElements();
+        double numFrames = Input(1)->HasMBLayout() ? (double) Input(1)->GetMBLayout()->GetNumCols() : 1;
+        flops = 2 * numWeightElements * numFrames;
+        bytes = sizeof(ElemType) * (numWeightElements + Input(1)->GetNumMinibatchElements() + GetNumMinibatchElements());
+        if (!forward)
+        {
+            flops *= 2;
+            bytes *= 2;
+        }
+        return true;
+    }
+
 protected:
     bool m_BackwardDataCalledYet;
     TensorShape shapeXT;
@@ -97,11 +122,13 @@ protected:
     shared_ptr<Matrix<ElemType>> m_workspace;
     shared_ptr<Matrix<ElemType>> m_reserve;
     shared_ptr<Matrix<ElemType>> m_packingIndex;
+    MBLayoutPtr m_packedMBLayout;           // the layout that m_packingIndex and m_numSequencesForFrame were computed for
+    vector<size_t> m_numSequencesForFrame;  // number of sequences of each frame of the packed data
 
 private:
     void TransposeHelper(const MatrixBasePtr matX, const TensorShape &shapeX, MatrixBasePtr matY, TensorShape &shapeY);
 
-    void PackSequencesForCuDNN(const Matrix<ElemType>& src, Matrix<ElemType>& dst, vector<size_t>& numSequencesForFrame);
+    void PackSequencesForCuDNN(const Matrix<ElemType>& src, Matrix<ElemType>& dst);
     void UnpackSequencesFromCuDNN(const Matrix<ElemType>& src, Matrix<ElemType>& dst);
 
     RnnAttributes m_rnnAttributes;
@@ -35,6 +35,7 @@ DelayedValueNodeBase<ElemType, direction>::DelayedValueNodeBase(DEVICEID_TYPE de
 {
     m_initialStateValue = initialState;
     m_timeStep = 1;
+    m_fileElementSize = sizeof(ElemType);
     CreateMatrixIfNull(m_value);
     SetDims(sampleLayout, HasMBLayout() /*false at this point*/);
     m_initialStateValueMatrix->Resize(1, 1);
@@ -89,7 +90,7 @@ template<class ElemType, int direction>
 
     if (modelVersion >= CNTK_MODEL_VERSION_2)
     {
-        fstream >> m_initialStateValue;
+        fstream.GetFloatingPointArray(&m_initialStateValue, 1, m_fileElementSize);
         m_initialStateValueMatrix->SetValue(m_initialStateValue);
     }
 }
@@ -340,6 +341,64 @@ template<class ElemType, int direction>
     Base::EndForwardProp();
 }
 
+template<class ElemType, int direction>
+size_t DelayedValueNodeBase<ElemType, direction>::GetCarriedFrameColumn(size_t s) const
+{
+    if (direction != -1 || m_timeStep != 1)
+        RuntimeError("%ls %ls operation: Only a PastValue with a time step of 1 can carry its state over.", NodeName().c_str(), OperationName().c_str());
+    if (!m_delayedActivationMBLayout)
+        LogicError("%ls %ls operation: GetCarriedFrame() called before the first minibatch.", NodeName().c_str(), OperationName().c_str());
+
+    // the sequence that parallel sequence s ends with
+    const MBLayout::SequenceInfo* last = nullptr;
+    for (const auto& sequenceInfo : m_delayedActivationMBLayout->GetAllSequences())
+    {
+        if (sequenceInfo.seqId != GAP_SEQUENCE_ID && sequenceInfo.s == s && (!last || last->tBegin < sequenceInfo.tBegin))
+            last = &sequenceInfo;
+    }
+    if (!last)
+        LogicError("%ls %ls operation: Parallel sequence %d of the last minibatch is empty.", NodeName().c_str(), OperationName().c_str(), (int)s);
+
+    size_t t = std::min(last->tEnd, m_delayedActivationMBLayout->GetNumTimeSteps()) - 1;
+    return t * m_delayedActivationMBLayout->GetNumParallelSequences() + s;
+}
+
+template<class ElemType, int direction>
+void DelayedValueNodeBase<ElemType, direction>::GetCarriedFrame(size_t s, Matrix<ElemType>& frame) const
+{
+    frame.SetValue(m_delayedValue->ColumnSlice(GetCarriedFrameColumn(s), 1));
+}
+
+template<class ElemType, int direction>
+void DelayedValueNodeBase<ElemType, direction>::GatherCarriedFrames(const std::vector<size_t>& parallelSequences)
+{
+    std::vector<ElemType> columns;
+    for (size_t s : parallelSequences)
+        columns.push_back((ElemType)GetCarriedFrameColumn(s));
+    Matrix<ElemType> idx(1, columns.size(), columns.data(), m_deviceId);
+    Matrix<ElemType> frames(m_deviceId);
+    frames.DoGatherColumnsOf(0, idx, *m_delayedValue, 1);
+    SetCarriedFrames(frames);
+}
+
+// This poses as a minibatch of one frame per parallel sequence, so that BeginForwardProp() and ForwardProp() take the
+// frames like those of a truncated previous minibatch.
+template<class ElemType, int direction>
+void DelayedValueNodeBase<ElemType, direction>::SetCarriedFrames(const Matrix<ElemType>& frames)
+{
+    if (direction != -1 || m_timeStep != 1)
+        RuntimeError("%ls %ls operation: Only a PastValue with a time step of 1 can carry its state over.", NodeName().c_str(), OperationName().c_str());
+    if (frames.GetNumRows() != GetSampleLayout().GetNumElements())
+        LogicError("%ls %ls operation: Expected carried frames of dimension %d, but got %d.", NodeName().c_str(), OperationName().c_str(), (int)GetSampleLayout().GetNumElements(), (int)frames.GetNumRows());
+
+    m_delayedValue->SetValue(frames);
+    if (!m_delayedActivationMBLayout)
+        m_delayedActivationMBLayout = make_shared<MBLayout>();
+    m_delayedActivationMBLayout->Init(frames.GetNumCols(), 1);
+    for (size_t s = 0; s < frames.GetNumCols(); s++)
+        m_delayedActivationMBLayout->AddSequence(s, s, 0, 1);
+}
+
 template<class ElemType, int direction>
 /*virtual*/ void DelayedValueNodeBase<ElemType,direction>::/*ComputationNode::*/ BackpropTo(const size_t inputIndex, const FrameRange& fr) /*override*/
 {
@@ -24,7 +24,7 @@ template <class ElemType> class DelayedValueNodeState;
 
 // TODO: 'direction' is really too general. signOfTimeOffset?
 template <class ElemType, int direction /*-1 for Past/left-to-right or +1 for Future/right-to-left*/ /*, MinibatchPackingFlags SequenceStart_or_End/*-Start or -End*/>
-class DelayedValueNodeBase : public ComputationNode<ElemType>, public IRecurrentNode, public ILateAttachingNode, public IStatefulNode
+class DelayedValueNodeBase : public ComputationNode<ElemType>, public IRecurrentNode, public ILateAttachingNode, public IStatefulNode, public IConvertsPrecisionOnLoad
 {
     typedef ComputationNode<ElemType> Base; UsingComputationNodeMembers; using Base::OperationName;
     typedef std::shared_ptr<DelayedValueNodeState<ElemType>> DelayedNodeStatePtr;
@@ -73,12 +73,26 @@ public:
     virtual int /*IRecurrentNode::*/ GetRecurrenceSteppingDirection() const override { return -direction; }
     virtual NodeStatePtr /*IStatefulNode::*/ ExportState() override;
     virtual void /*IStatefulNode::*/ ImportState(const NodeStatePtr& pImportedState) override;
+    virtual void /*IConvertsPrecisionOnLoad::*/ SetFileElementSize(size_t elementSize) override { m_fileElementSize = elementSize; }
     int TimeStep() const { return m_timeStep; }
     ElemType InitialActivationValue() const { return m_initialStateValue; }
 
+    // carry-over for streaming evaluation (PastValue with timeStep 1 only): the frame that parallel sequence 's' of the last
+    // minibatch ends with, and, to be read by the sequences of the next minibatch that do not begin in it, one such frame per
+    // parallel sequence
+    void GetCarriedFrame(size_t s, Matrix<ElemType>& frame) const;
+    void SetCarriedFrames(const Matrix<ElemType>& frames);
+    // same as SetCarriedFrames() with the frames that the given parallel sequences of the last minibatch end with, e.g. to
+    // reorder the hypotheses of a beam search; gathered on the device
+    void GatherCarriedFrames(const std::vector<size_t>& parallelSequences);
+
+private:
+    size_t GetCarriedFrameColumn(size_t s) const;
+
 protected:
     ElemType m_initialStateValue;                           // starting value for hidden activation vector at boundary
     int m_timeStep;                                         // delay in frames (typ. 1)
+    size_t m_fileElementSize;                               // of m_initialStateValue in a model being loaded, see SetFileElementSize()
 
     function<void()> m_attachInputsFn;                      // for late expansion of inputs (scripting)
 
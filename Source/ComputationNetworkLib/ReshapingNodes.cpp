@@ -215,11 +215,10 @@ template class ReduceElementsNode<double>;
 // wrapper class to pass MBLayout sequence vector to PackSequences()
 struct SequenceLengthVector
 {
-    typedef vector<vector<size_t>> SequenceVector;
     typedef MBLayout::SequenceInfo SequenceInfo;
-    const SequenceVector& m_sequenceVector;        // vector of sequences (to get sequence length)
+    const vector<size_t>& m_sequenceLengths;       // [sequence index] length of the new sequence
     const vector<SequenceInfo>& m_sequenceInfo;    // original sequence info (for seqId)
-    SequenceLengthVector(const vector<SequenceInfo>& sequenceInfo, const SequenceVector& sequenceVector) : m_sequenceInfo(sequenceInfo), m_sequenceVector(sequenceVector) { }
+    SequenceLengthVector(const vector<SequenceInfo>& sequenceInfo, const vector<size_t>& sequenceLengths) : m_sequenceInfo(sequenceInfo), m_sequenceLengths(sequenceLengths) { }
     size_t size() const { return m_sequenceInfo.size(); }
     MBLayout::SequenceInfo operator[](size_t i) const // return a descriptor of the new sequence
     {
@@ -227,7 +226,7 @@ struct SequenceLengthVector
         seq.seqId = m_sequenceInfo[i].seqId;
         seq.s = i;
         seq.tBegin = 0;
-        seq.tEnd = m_sequenceVector[i].size();
+        seq.tEnd = m_sequenceLengths[i];
         return seq;
     }
     void operator=(const SequenceLengthVector&) = delete;
@@ -237,52 +236,56 @@ struct SequenceLengthVector
 //       BeginForwardProp() should generally have no access to the actual values,
 //       while ForwardProp() might be too late. We may have to define the semantics here.
 // BUGBUG: This is the first node with value-dependent MBLayout. It resizes Value(), which we otherwise always do before.
+// The stream compaction runs on the device of the condition; only the number of indices of each sequence is brought
+// to the CPU, to create the new MBLayout there.
 template <class ElemType>
 /*virtual*/ void WhereNode<ElemType>::ForwardPropNonLooping() /*override*/
 {
-    // gather all sequences
+    // describe the sequences to the device: first column and number of time steps
     let& inMBLayout = InputRef(0).GetMBLayout();
     let& input = InputRef(0).Value();
     let& sequences = inMBLayout->GetAllSequences();
-    auto& indexSequences = m_indexSequenceBuffer;
-    if (indexSequences.size() < sequences.size())
-        indexSequences.resize(sequences.size());
-    for (size_t i = 0; i < sequences.size(); i++)
+    m_sequencesBuffer.clear();
+    for (let& seq : sequences)
     {
-        let& seq = sequences[i];
         if (seq.seqId == GAP_SEQUENCE_ID)
             continue;
-        auto& indexSequence = indexSequences[i];
-        indexSequence.clear();
-        for (size_t t = 0; t < seq.GetNumTimeSteps(); t++)
-            if (input(0, inMBLayout->GetColumnIndex(seq, t))) // this is the condition check that this node performs; the meat
-                indexSequence.push_back(t);
-        // Note: The above accesses m_value directly on the CPU, putting it into BOTH state, possibly for other consumers as well.
+        let numSteps = seq.GetNumTimeSteps();
+        m_sequencesBuffer.push_back((ElemType)(numSteps > 0 ? inMBLayout->GetColumnIndex(seq, 0) : 0));
+        m_sequencesBuffer.push_back((ElemType)numSteps);
     }
-    input.CollapseDataLocation(); // BUGBUG: Move back, since BOTH state is broken at present.
+    let numSequences = m_sequencesBuffer.size() / 2;
+    CreateMatrixIfNull(m_sequences);
+    CreateMatrixIfNull(m_counts);
+    m_sequences->SetValue(2, numSequences, input.GetDeviceId(), m_sequencesBuffer.data(), MatrixFormat::matrixFormatColMajor);
+    m_counts->AssignNonZeroCountsOfSequences(input, inMBLayout->GetNumParallelSequences(), *m_sequences); // this is the condition check that this node performs; the meat
+
+    // get the lengths of the result sequences
+    m_countsBuffer.resize(numSequences);
+    if (numSequences > 0)
+        m_counts->CopySection(1, numSequences, m_countsBuffer.data(), 1);
+    m_sequenceLengthsBuffer.assign(sequences.size(), 0);
+    for (size_t i = 0, k = 0; i < sequences.size(); i++)
+        if (sequences[i].seqId != GAP_SEQUENCE_ID)
+            m_sequenceLengthsBuffer[i] = (size_t)m_countsBuffer[k++];
+
     // create a new MBLayout
     let& outMBLayout = GetMBLayout();
-    outMBLayout->InitAsPackedSequences(SequenceLengthVector(sequences, indexSequences), /*temp*/m_placementBuffer, /*temp*/m_rowAllocationsBuffer);
-    // copy to output
-    vector<ElemType> buf(outMBLayout->GetNumCols(), numeric_limits<ElemType>::quiet_NaN()); // STL cannot easily avoid initializing, so we might as well init with NaN for gaps
-    let size = min(sequences.size(), outMBLayout->GetAllSequences().size()); // no non-gap sequence has an index beyond this
-    for (size_t i = 0; i < size; i++)
-    {
-        let& seq = outMBLayout->GetAllSequences()[i];
-        if (seq.seqId == GAP_SEQUENCE_ID) // gaps will keep the NaN
-            continue;
-        let& indexSequence = indexSequences[i];
-        for (size_t t = 0; t < seq.GetNumTimeSteps(); t++)
-            buf[outMBLayout->GetColumnIndex(seq, t)] = (ElemType)indexSequence[t];
-    }
-    // there may be dangling gaps at the end. Take the opportunity to verify this.
-    for (size_t i = size; i < sequences.size(); i++)
-        assert(sequences[i].seqId == GAP_SEQUENCE_ID);
-    for (size_t i = size; i < outMBLayout->GetAllSequences().size(); i++)
-        assert(outMBLayout->GetAllSequences()[i].seqId == GAP_SEQUENCE_ID);
-    // the result will be kept in CPUDEVICE, since most likely we will access it again in PackedIndexNode
-    Value().TransferToDeviceIfNotThere(CPUDEVICE, /*isBeingMoved=*/ true, /*emptyTransfer=*/ true, /*updatePreferredDevice=*/ true);
-    Value().SetValue(1, outMBLayout->GetNumCols(), CPUDEVICE, buf.data(), MatrixFormat::matrixFormatColMajor);
+    outMBLayout->InitAsPackedSequences(SequenceLengthVector(sequences, m_sequenceLengthsBuffer), /*temp*/m_placementBuffer, /*temp*/m_rowAllocationsBuffer);
+
+    // write the indices into the result sequences, as placed by InitAsPackedSequences()
+    m_outputFirstColumnsBuffer.clear();
+    for (size_t i = 0; i < sequences.size(); i++)
+        if (sequences[i].seqId != GAP_SEQUENCE_ID)
+            m_outputFirstColumnsBuffer.push_back((ElemType)(m_placementBuffer[i].second * outMBLayout->GetNumParallelSequences() + m_placementBuffer[i].first));
+    CreateMatrixIfNull(m_outputFirstColumns);
+    m_outputFirstColumns->SetValue(1, numSequences, input.GetDeviceId(), m_outputFirstColumnsBuffer.data(), MatrixFormat::matrixFormatColMajor);
+
+    // the result stays on the device of the condition, and gaps are NaN
+    Value().TransferToDeviceIfNotThere(input.GetDeviceId(), /*isBeingMoved=*/ true, /*emptyTransfer=*/ true, /*updatePreferredDevice=*/ true);
+    Value().Resize(1, outMBLayout->GetNumCols());
+    Value().SetValue(numeric_limits<ElemType>::quiet_NaN());
+    Value().DoScatterNonZeroStepsOfSequences(input, inMBLayout->GetNumParallelSequences(), *m_sequences, *m_outputFirstColumns, outMBLayout->GetNumParallelSequences());
 }
 
 template <class ElemType>
@@ -326,24 +329,26 @@ template <class ElemType>
     auto& result =                   Value(); // packed index values as mapped to sourceData's layout
     // loop over sourceSequences
     // Input matrix contains time indices for each sequence that refer to frames inside that sequence.
-    // We replace every per-sequence index by the resolved column index w.r.t. the same MBLayout.
+    // We replace every per-sequence index t by the resolved column index w.r.t. the same MBLayout,
+    // which is the column of the first frame of the source sequence plus t times the number of parallel sequences.
+    // Only these first columns are determined here on the CPU; the index values never leave their device.
+    // Note: Unlike MBLayout::GetColumnIndex(), this does not range-check the index values, which Where() keeps inside their sequences.
     let& sourceSequences = sourceMBLayout->GetAllSequences();
+    m_sourceColumnsBuffer.assign(indexMBLayout->GetNumCols(), numeric_limits<ElemType>::quiet_NaN()); // gaps will keep the NaN
     for (size_t i = 0; i < sourceSequences.size(); i++)
     {
         let& sourceSeq = sourceSequences[i];
         if (sourceSeq.seqId == GAP_SEQUENCE_ID)
             continue;
         let& indexSeq = indexMBLayout->FindSequence(sourceSeq.seqId);          // find corresponding entry in indexMBLayout
+        let jSourceBegin = sourceSeq.tBegin * (ptrdiff_t)sourceMBLayout->GetNumParallelSequences() + (ptrdiff_t)sourceSeq.s;
         for (size_t tIndex = 0; tIndex < indexSeq.GetNumTimeSteps(); tIndex++) // map all index values in index sequence
-        {
-            let jIndex  = indexMBLayout->GetColumnIndex(indexSeq, tIndex);    // map time index to actual location in the matrix storage object
-            let tSource = (size_t)index(0, jIndex);                           // the new time location (relative to source sequence)
-            let jSource = sourceMBLayout->GetColumnIndex(sourceSeq, tSource); // map new time index as well. This performs a range check.
-            result(0, jIndex) = (ElemType)jSource;
-        }
+            m_sourceColumnsBuffer[indexMBLayout->GetColumnIndex(indexSeq, tIndex)] = (ElemType)jSourceBegin;
     }
-    // Note: maybe this is no longer needed, now that we do the same inside UpdateFunctionValueSize() for all nodes.
-    result.CollapseDataLocation(); // BUGBUG: Move back, since BOTH state is broken at present.
+    CreateMatrixIfNull(m_sourceColumns);
+    m_sourceColumns->SetValue(1, m_sourceColumnsBuffer.size(), result.GetDeviceId(), m_sourceColumnsBuffer.data(), MatrixFormat::matrixFormatColMajor);
+    result.SetValue(*m_sourceColumns);
+    Matrix<ElemType>::ScaleAndAdd((ElemType)sourceMBLayout->GetNumParallelSequences(), index, result);
 }
 
 template <class ElemType>
@@ -374,6 +379,83 @@ template <class ElemType>
 template class PackedIndexNode<float>;
 template class PackedIndexNode<double>;
 
+// -----------------------------------------------------------------------
+// ContextWindowNode(input, leftContext, rightContext) -- splice neighbor frames
+// -----------------------------------------------------------------------
+
+// Seen as a [inputDim x (WindowSize() * numCols)] matrix, column k + j * WindowSize() of the output is frame k of the
+// window of output column j, so that the whole window is gathered by one DoGatherColumnsOf() with the indices built here.
+template <class ElemType>
+void ContextWindowNode<ElemType>::UpdateSourceColumns()
+{
+    const auto& layout = *GetMBLayout();
+    const size_t windowSize = WindowSize();
+    const size_t T = layout.GetNumTimeSteps();
+
+    m_sourceColumnsBuffer.assign(windowSize * layout.GetNumCols(), (ElemType)-1); // gaps are skipped by gather and scatter
+    for (const auto& seq : layout.GetAllSequences())
+    {
+        if (seq.seqId == GAP_SEQUENCE_ID)
+            continue;
+
+        // frames of the sequence within this minibatch, relative to the sequence begin
+        ptrdiff_t tFirst = std::max<ptrdiff_t>(0, -seq.tBegin);
+        ptrdiff_t tLast = (ptrdiff_t)std::min<size_t>(seq.tEnd, T) - seq.tBegin - 1;
+        for (ptrdiff_t t = tFirst; t <= tLast; t++)
+        {
+            size_t j = layout.GetColumnIndex(seq, (size_t)t);
+            for (size_t k = 0; k < windowSize; k++)
+            {
+                ptrdiff_t tSource = t + (ptrdiff_t)k - (ptrdiff_t)m_leftContext;
+                tSource = std::min(std::max(tSource, tFirst), tLast); // duplicate the boundary frames
+                m_sourceColumnsBuffer[k + j * windowSize] = (ElemType)layout.GetColumnIndex(seq, (size_t)tSource);
+            }
+        }
+    }
+
+    if (!m_sourceColumns)
+        m_sourceColumns = make_shared<Matrix<ElemType>>(m_deviceId);
+    m_sourceColumns->SetValue(1, m_sourceColumnsBuffer.size(), m_deviceId, m_sourceColumnsBuffer.data());
+}
+
+template <class ElemType>
+/*virtual*/ void ContextWindowNode<ElemType>::ForwardPropNonLooping() /*override*/
+{
+    UpdateSourceColumns();
+
+    let& input = InputRef(0).Value();
+    auto output = Value().Reshaped(input.GetNumRows(), WindowSize() * input.GetNumCols());
+    output.DoGatherColumnsOf(/*beta=*/0, *m_sourceColumns, input, /*alpha=*/1);
+}
+
+template <class ElemType>
+/*virtual*/ void ContextWindowNode<ElemType>::BackpropToNonLooping(size_t /*inputIndex*/) /*override*/
+{
+    // m_sourceColumns still describes the layout of the forward pass
+    auto& inputGradient = InputRef(0).Gradient();
+    let outputGradient = Gradient().Reshaped(inputGradient.GetNumRows(), WindowSize() * inputGradient.GetNumCols());
+    inputGradient.DoScatterColumnsOf(/*beta=*/1, *m_sourceColumns, outputGradient, /*alpha=*/1);
+}
+
+template <class ElemType>
+/*virtual*/ void ContextWindowNode<ElemType>::Validate(bool isFinalValidationPass) /*override*/
+{
+    Base::Validate(isFinalValidationPass);
+    InferMBLayoutFromInputsForStandardCase(isFinalValidationPass);
+
+    if (isFinalValidationPass && !HasMBLayout())
+        InvalidArgument("%ls requires its input to be a time sequence.", NodeDescription().c_str());
+
+    // the window is stacked along the trailing dimension
+    SmallVector<size_t> dims = GetInputSampleLayout(0).GetDims();
+    dims.back() *= WindowSize();
+
+    SetDims(TensorShape(dims), HasMBLayout());
+}
+
+template class ContextWindowNode<float>;
+template class ContextWindowNode<double>;
+
 // -----------------------------------------------------------------------
 // GatherPackedNode(packedIndex, sourceData) -- gather operation
 // -----------------------------------------------------------------------
@@ -577,6 +577,9 @@ private:
 public:
     virtual void /*ComputationNode::*/ ForwardProp(const FrameRange& fr) override
     {
+        if (IsValueElided()) // the consumer reads the stripes from the inputs, see ComputationNetwork::ElideInputs()
+            return;
+
         size_t rank = DetermineElementwiseTensorRank();
         let outputSlice = GetTensorSliceFor(rank, fr); // tensor slice that represents the entire output for FrameRange
 
@@ -591,6 +594,9 @@ public:
 
     virtual void /*ComputationNode::*/ BackpropTo(const size_t inputIndex, const FrameRange& fr) override
     {
+        if (IsValueElided()) // the consumer has added to the inputs' gradients directly
+            return;
+
         size_t rank = DetermineElementwiseTensorRank();
         let outputSlice = GetTensorSliceFor(rank, fr); // tensor slice that represents the entire output for FrameRange
 
@@ -654,6 +660,7 @@ public:
     }
 
     int GetSpliceDim() const { return m_spliceDim; }
+    const std::vector<size_t>& GetFirstIndices() const { return m_firstIndices; }
 
 private:
     std::vector<size_t> m_firstIndices; // start row number in the stacked matrix of each input (child) (cumsum of matrix heights); plus one final entry that equals the total dimension
@@ -745,6 +752,84 @@ private:
 template class RowRepeatNode<float>;
 template class RowRepeatNode<double>;
 
+// -----------------------------------------------------------------------
+// ContextWindowNode(input, leftContext, rightContext) -- splice neighbor frames
+// Each output frame stacks the input frames t-leftContext..t+rightContext of
+// the same sequence along the trailing dimension. Frames beyond a sequence
+// boundary are replaced by the first or last frame of the sequence, like the
+// context window augmentation of the HTK reader. This lets a reader deliver
+// the raw frames (see HTKDataDeserializer's expandContextOnDevice) and have the
+// window built on the device with a single column gather.
+// Sequences cut off by the minibatch (truncated BPTT) are clamped at the cut.
+// -----------------------------------------------------------------------
+
+template <class ElemType>
+class ContextWindowNode : public ComputationNodeNonLooping<ElemType>, public NumInputs<1>
+{
+    typedef ComputationNodeNonLooping<ElemType> Base; UsingComputationNodeMembersBoilerplate;
+    static const std::wstring TypeName() { return L"ContextWindow"; }
+
+public:
+    ContextWindowNode(DEVICEID_TYPE deviceId, const wstring& name, size_t leftContext = 0, size_t rightContext = 0)
+        : Base(deviceId, name), m_leftContext(leftContext), m_rightContext(rightContext)
+    {
+    }
+    ContextWindowNode(const ScriptableObjects::IConfigRecordPtr configp)
+        : ContextWindowNode(configp->Get(L"deviceId"), L"<placeholder>", configp->Get(L"leftContext"), configp->Get(L"rightContext"))
+    {
+        AttachInputsFromConfig(configp, this->GetExpectedNumInputs());
+    }
+
+    virtual void CopyTo(ComputationNodeBasePtr nodeP, const std::wstring& newName, const CopyNodeFlags flags) const override
+    {
+        Base::CopyTo(nodeP, newName, flags);
+        if (flags & CopyNodeFlags::copyNodeValue)
+        {
+            auto node = dynamic_pointer_cast<ContextWindowNode<ElemType>>(nodeP);
+            node->m_leftContext = m_leftContext;
+            node->m_rightContext = m_rightContext;
+        }
+    }
+
+    virtual void Save(File& fstream) const override
+    {
+        Base::Save(fstream);
+        fstream << m_leftContext << m_rightContext;
+    }
+
+    virtual void Load(File& fstream, size_t modelVersion) override
+    {
+        Base::Load(fstream, modelVersion);
+        fstream >> m_leftContext >> m_rightContext;
+    }
+
+    virtual std::string FormatOperationPrototype(const std::string& extraArgs) const override
+    {
+        return Base::FormatOperationPrototype(extraArgs + msra::strfun::strprintf(", leftContext=%lu, rightContext=%lu", m_leftContext, m_rightContext));
+    }
+
+    virtual void /*ComputationNodeNonLooping::*/ ForwardPropNonLooping() override;
+    virtual void /*ComputationNodeNonLooping::*/ BackpropToNonLooping(size_t /*inputIndex*/) override;
+    virtual bool OutputUsedInComputingInputNodesGradients() const override { return false; }
+    virtual bool InputUsedInComputingInputNodesGradients(size_t /*childIndex*/) const override { return false; }
+    virtual void Validate(bool isFinalValidationPass) override;
+
+    size_t LeftContext() const { return m_leftContext; }
+    size_t RightContext() const { return m_rightContext; }
+
+private:
+    size_t WindowSize() const { return 1 + m_leftContext + m_rightContext; }
+    void UpdateSourceColumns();
+
+    size_t m_leftContext;
+    size_t m_rightContext;
+
+    // input column of each frame of the window of each output column ([k + j * WindowSize()]), or -1 for gaps;
+    // built on the CPU from the MBLayout and kept as object state to avoid memory allocations
+    std::vector<ElemType> m_sourceColumnsBuffer;
+    shared_ptr<Matrix<ElemType>> m_sourceColumns;
+};
+
 // -----------------------------------------------------------------------
 // WhereNode(cond) -- extract indices of non-0 values in a sequence
 // As this implies a runtime-value dependent reduction in dimension, it can
@@ -805,9 +890,15 @@ public:
 
 private:
     // buffers for creating the result sequences (kept as object state to avoid memory allocations)
-    std::vector<std::vector<size_t>>   m_indexSequenceBuffer; // [sequenceIndex][t] for creating the result sequences
+    std::vector<ElemType>                 m_sequencesBuffer; // [2 x non-gap sequence] first column and number of time steps of the input sequences
+    std::vector<ElemType>                    m_countsBuffer; // [non-gap sequence] number of indices, from the device
+    std::vector<size_t>             m_sequenceLengthsBuffer; // [sequenceIndex] length of the result sequence
+    std::vector<ElemType>        m_outputFirstColumnsBuffer; // [non-gap sequence] first column of the result sequence
     std::vector<size_t>               m_rowAllocationsBuffer; // [row] for determining new MBLayout packing
     std::vector<std::pair<size_t, size_t>> m_placementBuffer; // [sequenceIndex] assigned location for a sequence
+    shared_ptr<Matrix<ElemType>> m_sequences;                // the above buffers on the device of the input
+    shared_ptr<Matrix<ElemType>> m_counts;
+    shared_ptr<Matrix<ElemType>> m_outputFirstColumns;
     std::wstring m_dynamicAxisName;
 };
 
@@ -844,6 +935,10 @@ public:
     virtual bool OutputUsedInComputingInputNodesGradients() const override { return false; }
     virtual bool InputUsedInComputingInputNodesGradients(size_t /*childIndex*/) const override { return false; }
     virtual void Validate(bool isFinalValidationPass) override;
+
+private:
+    std::vector<ElemType> m_sourceColumnsBuffer; // [index column] column of the first frame of the source sequence (kept as object state to avoid memory allocations)
+    shared_ptr<Matrix<ElemType>> m_sourceColumns;
 };
 
 // -----------------------------------------------------------------------
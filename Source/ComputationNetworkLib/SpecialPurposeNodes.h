@@ -71,7 +71,7 @@ private:
 // calculates the log likelihood of a feature given parameters of a Gaussian mixture model (GMM) with shared diagonal variance
 //  - unnormedPrior: mix weights, #rows = #mixture components
 //  - means: means, all mix means concatenated  (i.e. dim = feature dim x prior dim)
-//  - logStdDevs: std deviations, pooled across mix (i.e. same dim as features)
+//  - logStdDevs: log std deviations, one per mixture component, shared by all feature dimensions
 // UnnormedPrior, means, and logStdDevs can be either a single column or one per sample, e.g.
 // when parameters are computed by other nodes.
 // -----------------------------------------------------------------------
@@ -91,266 +91,31 @@ public:
 
     virtual void /*ComputationNode::*/ BackpropTo(const size_t inputIndex, const FrameRange& fr) override
     {
-        // get the right slice
-        const size_t colsPrior = Input(0)->GetSampleMatrixNumCols();
-
-        Matrix<ElemType> sliceGradientValue = DataFor(*m_gradient, fr);
-        Matrix<ElemType> slicePosterior = DataFor(*m_posterior, fr);
-
-        switch (inputIndex)
-        {
-        case 0:
-        {
-            if (colsPrior == 1)
-                BackpropToUnnormedPrior(Input(0)->Gradient(), sliceGradientValue, *m_prior, slicePosterior, *m_temp);
-            else
-            {
-                Matrix<ElemType> sliceUnnormedPriorGradient = Input(0)->GradientFor(fr);
-                Matrix<ElemType> slicePrior = DataFor(*m_prior, fr); // TODO: use the right MBLayout, then we won't need the special case
-                BackpropToUnnormedPrior(sliceUnnormedPriorGradient, sliceGradientValue, slicePrior, slicePosterior, *m_temp);
-            }
-        }
-        break;
-        case 1:
-        {
-            Matrix<ElemType> sliceNormedDeviationVectors = DataFor(*m_normedDeviationVectors, fr);
-            if (colsPrior == 1)
-                BackpropToMean(Input(1)->Gradient(), sliceGradientValue, sliceNormedDeviationVectors, slicePosterior, *m_temp);
-            else
-            {
-                Matrix<ElemType> sliceMeanGradient = Input(1)->GradientFor(fr);
-                BackpropToMean(sliceMeanGradient, sliceGradientValue, sliceNormedDeviationVectors, slicePosterior, *m_temp);
-            }
-        }
-        break;
-        case 2:
-        {
-            Matrix<ElemType> sliceNormedDeviation = DataFor(*m_normedDeviation, fr);
-            if (colsPrior == 1)
-                BackpropToLogStddev(Input(2)->Gradient(), sliceGradientValue, sliceNormedDeviation, slicePosterior, *m_temp);
-            else
-            {
-                Matrix<ElemType> sliceLotStddevGradient = Input(2)->GradientFor(fr);
-                BackpropToLogStddev(sliceLotStddevGradient, sliceGradientValue, sliceNormedDeviation, slicePosterior, *m_temp);
-            }
-        }
-        break;
-        case 3:
-        {
-            Matrix<ElemType> sliceNormedDeviationVectors = DataFor(*m_normedDeviationVectors, fr);
-            Matrix<ElemType> sliceFeatureGradient = Input(3)->GradientFor(fr);
-            BackpropToFeature(sliceFeatureGradient, sliceGradientValue, sliceNormedDeviationVectors, slicePosterior, *m_temp);
-        }
-        break;
-        default:
+        if (inputIndex > 3)
             InvalidArgument("GMMLogLikelihoodNode criterion only takes four inputs.");
-        }
-    }
-
-    virtual bool OutputUsedInComputingInputNodesGradients() const override { return false; }
-    virtual bool InputUsedInComputingInputNodesGradients(size_t /*childIndex*/) const override { return false; }
-
-    void BackpropToUnnormedPrior(Matrix<ElemType>& unnormedPriorGradientValues, const Matrix<ElemType>& gradientValues,
-                                 const Matrix<ElemType>& prior, const Matrix<ElemType>& posterior, Matrix<ElemType>& temp)
-    {
-        temp.AssignDifferenceOf(posterior, prior);
-        temp.RowElementMultiplyWith(gradientValues);
-        if (prior.GetNumCols() == posterior.GetNumCols())
-            unnormedPriorGradientValues += temp;
-        else if (prior.GetNumCols() == 1)
-            Matrix<ElemType>::MultiplyAndAdd(temp, false, ConstOnes(posterior.GetNumCols(), 1, unnormedPriorGradientValues.GetDeviceId()), false, unnormedPriorGradientValues);
-        else
-            RuntimeError("GMMLogLikelihoodNode: UnnormedPrior should either have same number of columns as the features or have only one column.");
-    }
-
-    void BackpropToMean(Matrix<ElemType>& meanGradientValues, const Matrix<ElemType>& gradientValues, const Matrix<ElemType>& normedDeviationVectors,
-                        Matrix<ElemType>& posterior, Matrix<ElemType>& temp)
-    {
-        size_t numComponent = posterior.GetNumRows();
-        size_t numSamples = posterior.GetNumCols();
-        size_t featureSize = normedDeviationVectors.GetNumRows() / numComponent;
-
-        temp.SetValue(normedDeviationVectors); // recall normedDeviationVectors <-- (x-u_c)/(stddev^2)
-        temp.Reshape(featureSize, numSamples * numComponent);
-
-        posterior.Reshape(1, numSamples * numComponent);
-        temp.RowElementMultiplyWith(posterior); // temp <-- posterior * (x-u_c)/(stddev^2)
-
-        posterior.Reshape(numComponent, numSamples);          // reshape back
-        temp.Reshape(featureSize * numComponent, numSamples); // reshape back
-
-        temp.RowElementMultiplyWith(gradientValues);
-
-        if (numSamples == meanGradientValues.GetNumCols())
-            meanGradientValues += temp;
-        else if (meanGradientValues.GetNumCols() == 1)
-            Matrix<ElemType>::MultiplyAndAdd(temp, false, ConstOnes(numSamples, 1, meanGradientValues.GetDeviceId()), false, meanGradientValues);
-        else
-            RuntimeError("GMMLogLikelihoodNode: stddev should either have same number of columns as the features or have only one column.");
-    }
-
-    void BackpropToLogStddev(Matrix<ElemType>& logStddevGradientValues, const Matrix<ElemType>& gradientValues, const Matrix<ElemType>& normedDeviation,
-                             const Matrix<ElemType>& posterior, Matrix<ElemType>& temp)
-    {
-        size_t numComponent = posterior.GetNumRows();
-        size_t numSamples = posterior.GetNumCols();
-
-        temp.AssignDifferenceOf(normedDeviation, (ElemType) numComponent);
-        temp.ElementMultiplyWith(posterior);
-        temp.RowElementMultiplyWith(gradientValues);
-        if (logStddevGradientValues.GetNumCols() == numSamples)
-            logStddevGradientValues += temp;
-        else if (logStddevGradientValues.GetNumCols() == 1)
-            Matrix<ElemType>::MultiplyAndAdd(temp, false, ConstOnes(numSamples, 1, logStddevGradientValues.GetDeviceId()), false, logStddevGradientValues);
-        else
-            RuntimeError("GMMLogLikelihoodNode: stddev should either have same number of columns as the features or have only one column.");
-    }
 
-    void BackpropToFeature(Matrix<ElemType>& featureGradientValues, const Matrix<ElemType>& gradientValues, const Matrix<ElemType>& normedDeviationVectors,
-                           Matrix<ElemType>& posterior, Matrix<ElemType>& temp)
-    {
-        size_t numComponent = posterior.GetNumRows();
-        size_t numSamples = posterior.GetNumCols();
-        size_t featureSize = normedDeviationVectors.GetNumRows() / numComponent;
-
-        temp.SetValue(normedDeviationVectors);
-        temp *= -1;
-        temp.Reshape(featureSize, numSamples * numComponent);
-        posterior.Reshape(1, numSamples * numComponent);
-        temp.RowElementMultiplyWith(posterior);
-
-        posterior.Reshape(numComponent, numSamples);
-        temp.Reshape(featureSize * numComponent, numSamples);
-        temp.RowElementMultiplyWith(gradientValues);
-
-        for (int i = 0; i < numComponent; i++)
-            featureGradientValues.AddWithRowSliceValuesOf(temp, i * featureSize, featureSize);
+        // the gradient of a parameter with a single column is summed over the samples
+        Matrix<ElemType> sliceInputGradient = inputIndex < 3 && Input(inputIndex)->GetSampleMatrixNumCols() == 1 ? Input(inputIndex)->Gradient().AsReference() : Input(inputIndex)->GradientFor(fr);
+        sliceInputGradient.AddGMMLogLikelihoodGradientOf(inputIndex, GradientFor(fr), ParameterValueFor(0, fr), ParameterValueFor(1, fr), ParameterValueFor(2, fr),
+                                                         Input(3)->ValueFor(fr), DataFor(*m_posterior, fr));
     }
 
-    virtual void UpdateFunctionMBSize() override
-    {
-        Base::UpdateFunctionMBSize();
-
-        size_t numCols = Input(3)->GetSampleMatrixNumCols();
-        size_t numComponents = Input(0)->GetSampleMatrixNumRows();
-        size_t colsPrior = Input(0)->GetSampleMatrixNumCols(); // may be 1
-        size_t featureSize = Input(3)->GetSampleMatrixNumRows();
-
-        m_prior->Resize(numComponents, colsPrior);
-        m_stddev->Resize(numComponents, colsPrior);
-        m_normedDeviation->Resize(numComponents, numCols);
-        m_normedDeviationVectors->Resize(numComponents * featureSize, numCols);
-        m_posterior->Resize(numComponents, numCols);
-    }
+    virtual bool OutputUsedInComputingInputNodesGradients() const override { return false; }
 
     // input0=unnormedPrior, input1=mean, input2=logstddev, input3=feature
+    // The log-likelihoods of the components are reduced with a running log-sum-exp in a single pass over the features,
+    // and only their posteriors are kept for the gradients, see Matrix::AssignGMMLogLikelihoodOf().
     virtual void /*ComputationNode::*/ ForwardProp(const FrameRange& fr) override
     {
-        size_t colsPrior = Input(0)->GetSampleMatrixNumCols();
-        size_t numSamples = Input(3)->GetSampleMatrixNumCols();
-
-        // get the right slice
         Matrix<ElemType> sliceOutputValue = ValueFor(fr);
-        Matrix<ElemType> sliceFeature = Input(3)->ValueFor(fr);
-        Matrix<ElemType> sliceNormedDeviation = DataFor(*m_normedDeviation, fr);
-        Matrix<ElemType> sliceNormedDeviationVectors = DataFor(*m_normedDeviationVectors, fr);
         Matrix<ElemType> slicePosterior = DataFor(*m_posterior, fr);
-
-        if (colsPrior == 1)
-        {
-            ForwardPropS(sliceOutputValue, Input(0)->Value(), Input(1)->Value(), Input(2)->Value(), sliceFeature,
-                         *m_prior, *m_stddev, sliceNormedDeviationVectors, sliceNormedDeviation, slicePosterior, *m_temp);
-        }
-        else if (colsPrior == numSamples)
-        {
-            Matrix<ElemType> sliceUnnormedPrior = Input(0)->ValueFor(fr);
-            Matrix<ElemType> sliceMean = Input(1)->ValueFor(fr);
-            Matrix<ElemType> sliceLogstddev = Input(2)->ValueFor(fr);
-
-            Matrix<ElemType> slicePrior = DataFor(*m_prior, fr);
-            Matrix<ElemType> sliceStddev = DataFor(*m_stddev, fr);
-
-            ForwardPropS(sliceOutputValue, sliceUnnormedPrior, sliceMean, sliceLogstddev, sliceFeature,
-                         slicePrior, sliceStddev, sliceNormedDeviationVectors, sliceNormedDeviation, slicePosterior, *m_temp);
-        }
-        else // should not reach the code since validation should fail already
-            RuntimeError("GMMLogLikelihoodNode: UnnormedPrior should either have same number of columns as the features or have only one column.");
+        sliceOutputValue.AssignGMMLogLikelihoodOf(ParameterValueFor(0, fr), ParameterValueFor(1, fr), ParameterValueFor(2, fr), Input(3)->ValueFor(fr), slicePosterior);
     }
 
-    // input0=unnormedPrior, input1=mean, input2=logstddev, input3=feature
-    // If we want to speed up we need to replace following code with a several specialized GPU functions
-    /*TODO: merge with call site*/ void ForwardPropS(Matrix<ElemType>& functionValues, const Matrix<ElemType>& unnormedPrior, const Matrix<ElemType>& mean, Matrix<ElemType>& logstddev,
-                                                     const Matrix<ElemType>& feature, Matrix<ElemType>& prior, Matrix<ElemType>& stddev, Matrix<ElemType>& normedDeviationVectors,
-                                                     Matrix<ElemType>& normedDeviation, Matrix<ElemType>& posterior, Matrix<ElemType>& temp)
+    virtual void UpdateFunctionMBSize() override
     {
-        int numComponent = unnormedPrior.GetNumRows();
-        size_t numSamples = feature.GetNumCols();
-        size_t featureDim = feature.GetNumRows();
-
-        // compute prior which is softmax of unnormedPrior
-        prior.AssignLogSoftmaxOf(unnormedPrior, true); // log prior
-
-        prior.InplaceExp();
-
-        // compute stddev
-        stddev.AssignExpOf(logstddev);
-
-#if DUMPOUTPUT
-        unnormedPrior.Print("unnormedPrior", 0, min(5, unnormedPrior.GetNumRows() - 1), 0, min(10, unnormedPrior.GetNumCols() - 1));
-        mean.Print("mean", 0, min(5, mean.GetNumRows() - 1), 0, min(10, mean.GetNumCols() - 1));
-        logstddev.Print("logstddev", 0, min(5, logstddev.GetNumRows() - 1), 0, min(10, logstddev.GetNumCols() - 1));
-
-        prior.Print("prior", 0, min(5, prior.GetNumRows() - 1), 0, min(10, prior.GetNumCols() - 1));
-        stddev.Print("stddev", 0, min(5, stddev.GetNumRows() - 1), 0, min(10, stddev.GetNumCols() - 1));
-#endif
-
-        // compute normedDeviation <-- ||x-u_c||^2/(stddev^2)
-        normedDeviationVectors.AssignRepeatOf(feature, numComponent, 1);
-        normedDeviationVectors -= mean;                                        // each column of the mean has multiple mean components
-        normedDeviationVectors.Reshape(featureDim, numSamples * numComponent); // now each column is feature-mean_i
-
-        normedDeviation.AssignVectorNorm2Of(normedDeviationVectors, true);
-        normedDeviation ^= 2;
-        temp.AssignRepeatOf(stddev, 1, numSamples / stddev.GetNumCols()); // stddev.GetNumCols() is either 1 or =numSamples
-        temp.Reshape(1, temp.GetNumElements());                           // one stddev value for each component for each sample
-        temp ^= 2;
-        normedDeviation.ElementDivideBy(temp); // normedDeviation and temp have same dim (1, numSamples* numComponent)
-
-        // compute  normedDeviationVectors <-- (x-u_c)/(stddev^2)
-        normedDeviationVectors.RowElementDivideBy(temp);                       // divide twice
-        normedDeviationVectors.Reshape(featureDim * numComponent, numSamples); // reshape back
-
-        // compute per-component likelihood
-        posterior.AssignProductOf(-0.5f, normedDeviation); // posterior  <-- -||x-u_c||^2/(stddev^2)/2 and in (1, numSamples* numComponent) dim
-        temp.InplaceLog();
-        temp *= ((ElemType) numComponent / 2.0f);                   // temp <-- stddev^c and in (1, numSamples* numComponent) dim
-        posterior -= temp;                                          // posterior  <-- exp[-||x-u_c||^2/(stddev^2)/2]/(stddev^c)
-        posterior -= (ElemType)(numComponent / 2.0f * log(TWO_PI)); // likelihood for each component and sample is now computed and stored in posterior
-        posterior.InplaceExp();                                     // posterior  <-- exp(-||x-u_c||^2/(stddev^2)/2)
-
-        normedDeviation.Reshape(numComponent, numSamples); // reshape back
-        posterior.Reshape(numComponent, numSamples);       // reshape back
-
-        // compute posterior <-- prior_i * likelihood_i
-        if (unnormedPrior.GetNumCols() == numSamples) // each sample has different prior
-            posterior.ElementMultiplyWith(prior);
-        else // all samples share the same prior
-            posterior.ColumnElementMultiplyWith(prior);
-
-        // compute GMM log-likelihood
-        Matrix<ElemType>::Multiply(ConstOnes(1, numComponent, posterior.GetDeviceId()), false, posterior, false, functionValues); // functionValues <-- total likelihood
-        posterior.RowElementDivideBy(functionValues);                                                                             // posterior <-- per-comp likelihood / total likelihood
-        functionValues.InplaceLog();                                                                                              // log likelihood
-
-#if DUMPOUTPUT
-        temp.Print("temp", 0, min(5, temp.GetNumRows() - 1), 0, min(10, temp.GetNumCols() - 1));
-        normedDeviation.Print("normedDeviation", 0, min(5, normedDeviation.GetNumRows() - 1), 0, min(10, normedDeviation.GetNumCols() - 1));
-
-        posterior.Print("posterior", 0, min(5, posterior.GetNumRows() - 1), 0, min(10, posterior.GetNumCols() - 1));
-        functionValues.Print("functionValues", 0, min(5, functionValues.GetNumRows() - 1), 0, min(10, functionValues.GetNumCols() - 1));
-
-        functionValues.Print("GMMLogLikelihoodNode");
-#endif
+        Base::UpdateFunctionMBSize();
+        m_posterior->Resize(Input(0)->GetSampleMatrixNumRows(), Input(3)->GetSampleMatrixNumCols());
     }
 
     virtual void /*ComputationNodeBase::*/ Validate(bool isFinalValidationPass) override
@@ -385,11 +150,7 @@ public:
         if (flags & CopyNodeFlags::copyNodeValue)
         {
             auto node = dynamic_pointer_cast<GMMLogLikelihoodNode<ElemType>>(nodeP);
-            *node->m_prior = *m_prior;
-            *node->m_normedDeviation = *m_normedDeviation;
-            *node->m_normedDeviationVectors = *m_normedDeviationVectors;
-            *node->m_stddev = *m_stddev;
-            *node->m_posterior = *m_posterior;
+            node->m_posterior->SetValue(*m_posterior);
         }
     }
 
@@ -397,33 +158,24 @@ public:
     virtual void RequestMatricesBeforeForwardProp(MatrixPool& matrixPool)
     {
         Base::RequestMatricesBeforeForwardProp(matrixPool);
-        RequestMatrixFromPool(m_prior, matrixPool);
-        RequestMatrixFromPool(m_normedDeviation, matrixPool);
-        RequestMatrixFromPool(m_normedDeviationVectors, matrixPool);
-        RequestMatrixFromPool(m_stddev, matrixPool);
         RequestMatrixFromPool(m_posterior, matrixPool);
-        RequestMatrixFromPool(m_temp, matrixPool);
     }
 
     // release gradient and temp matrices that no longer needed after all the children's gradients are computed.
     virtual void ReleaseMatricesAfterBackprop(MatrixPool& matrixPool)
     {
         Base::ReleaseMatricesAfterBackprop(matrixPool);
-        ReleaseMatrixToPool(m_prior, matrixPool);
-        ReleaseMatrixToPool(m_normedDeviation, matrixPool);
-        ReleaseMatrixToPool(m_normedDeviationVectors, matrixPool);
-        ReleaseMatrixToPool(m_stddev, matrixPool);
         ReleaseMatrixToPool(m_posterior, matrixPool);
-        ReleaseMatrixToPool(m_temp, matrixPool);
     }
 
 protected:
-    shared_ptr<Matrix<ElemType>> m_prior;
-    shared_ptr<Matrix<ElemType>> m_normedDeviation;
-    shared_ptr<Matrix<ElemType>> m_normedDeviationVectors;
-    shared_ptr<Matrix<ElemType>> m_stddev;
-    shared_ptr<Matrix<ElemType>> m_posterior;
-    shared_ptr<Matrix<ElemType>> m_temp;
+    // a parameter has either one column, shared by all samples, or one per sample
+    Matrix<ElemType> ParameterValueFor(size_t inputIndex, const FrameRange& fr)
+    {
+        return Input(inputIndex)->GetSampleMatrixNumCols() == 1 ? Input(inputIndex)->Value().AsReference() : Input(inputIndex)->ValueFor(fr);
+    }
+
+    shared_ptr<Matrix<ElemType>> m_posterior; // [components x samples]
 };
 
 template class GMMLogLikelihoodNode<float>;
@@ -642,6 +394,8 @@ public:
         m_gammaCalculator.SetGammarCalculationParams(param);
     }
 
+    void SetLatticeCacheSize(size_t bytes) { m_gammaCalculator.SetLatticeCacheSize(bytes); }
+
     void gettime(unsigned long long& gammatime, unsigned long long& partialtime)
     {
         gammatime = m_gammatime;
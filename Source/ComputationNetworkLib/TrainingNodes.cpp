@@ -8,6 +8,59 @@
 
 namespace Microsoft { namespace MSR { namespace CNTK {
 
+// Vose's method: the classes are distributed over numClasses buckets of equal probability, each of which holds
+// (part of) the probability mass of at most two classes.
+void WeightedSampler::BuildAliasTable()
+{
+    const size_t numClasses = m_weights.size();
+    m_totalWeight = 0;
+    for (auto weight : m_weights)
+    {
+        if (!(weight >= 0))
+            InvalidArgument("Sampling weights contain negative number %f.", weight);
+        m_totalWeight += weight;
+    }
+    if (numClasses == 0 || m_totalWeight <= 0)
+        InvalidArgument("Sampling weights must contain a positive number.");
+
+    std::vector<double> scaledProbabilities(numClasses);
+    std::vector<size_t> small, large;
+    for (size_t i = 0; i < numClasses; i++)
+    {
+        scaledProbabilities[i] = m_weights[i] * numClasses / m_totalWeight;
+        (scaledProbabilities[i] < 1 ? small : large).push_back(i);
+    }
+
+    m_acceptProbabilities.assign(numClasses, 1);
+    m_aliases.resize(numClasses);
+    for (size_t i = 0; i < numClasses; i++)
+        m_aliases[i] = i;
+    while (!small.empty() && !large.empty())
+    {
+        size_t s = small.back();
+        small.pop_back();
+        size_t l = large.back();
+        m_acceptProbabilities[s] = scaledProbabilities[s];
+        m_aliases[s] = l;
+        scaledProbabilities[l] -= 1 - scaledProbabilities[s];
+        if (scaledProbabilities[l] < 1)
+        {
+            large.pop_back();
+            small.push_back(l);
+        }
+    }
+    // what remains is 1 up to rounding errors, and keeps the default of always accepting
+}
+
+size_t WeightedSampler::Sample(std::mt19937_64& generator) const
+{
+    const size_t numClasses = m_weights.size();
+    boost::random::uniform_real_distribution<double> r(0, (double) numClasses);
+    double x = r(generator);
+    size_t bucket = std::min((size_t) x, numClasses - 1);
+    return x - bucket < m_acceptProbabilities[bucket] ? bucket : m_aliases[bucket];
+}
+
 template<class ElemType>
 void RandomSampleNodeBase<ElemType>::Validate(bool isFinalValidationPass)
 {
@@ -58,21 +111,11 @@ void RandomSampleNodeBase<ElemType>::Load(File& fstream, size_t modelVersion)
     RngUser::Load(fstream, modelVersion);
 }
 
+// The weights are copied from the device once, and the sampler is only rebuilt when they change.
 template<class ElemType>
-void RandomSampleNodeBase<ElemType>::UpdateWeightsPrefixSum()
+void RandomSampleNodeBase<ElemType>::UpdateSampler()
 {
-    const Matrix<ElemType>& samplingWeights = Input(0)->ValueAsMatrix();
-    m_samplingWeightsPrefixSum.clear();
-    double runningWeightsSum = 0;
-    for (int iClass = 0; iClass < samplingWeights.GetNumRows(); iClass++)
-    {
-        ElemType currentWeight = samplingWeights.GetValue(iClass, 0);
-        if (currentWeight < 0)
-            InvalidArgument("Sampling weights contain negative number %f.", currentWeight);
-
-        runningWeightsSum += currentWeight;
-        m_samplingWeightsPrefixSum.push_back(runningWeightsSum);
-    }
+    m_sampler.SetWeights(Input(0)->ValueAsMatrix());
 }
 
 // Runs the sampling returning a vector with the id's of the samples. The parameter nTries is used to return the number of draws that was needed
@@ -80,7 +123,6 @@ void RandomSampleNodeBase<ElemType>::UpdateWeightsPrefixSum()
 template<class ElemType>
 const std::vector<size_t> RandomSampleNodeBase<ElemType>::RunSampling(size_t& nTries)
 {
-    boost::random::uniform_real_distribution<double> r(0, m_samplingWeightsPrefixSum.back());
     std::unordered_set<int> alreadySampled;
     std::vector<size_t> samples;
     CPURNGHandle* cpuRNGHandle = dynamic_cast<CPURNGHandle*>(&GetRNGHandle(CPUDEVICE));
@@ -94,11 +136,8 @@ const std::vector<size_t> RandomSampleNodeBase<ElemType>::RunSampling(size_t& nT
     auto offset = GetRngOffset();
     while (samples.size() < m_sizeOfSampledSet)
     {
-        double randomValue = r(cpuRNGHandle->Generator());
+        int idx = (int)m_sampler.Sample(cpuRNGHandle->Generator());
         offset++;
-        // Find the first index where value[idx] >= randomValue.
-        auto lower = std::lower_bound(m_samplingWeightsPrefixSum.begin(), m_samplingWeightsPrefixSum.end(), randomValue);
-        int idx = (int)(lower - m_samplingWeightsPrefixSum.begin());
 
         if (m_allowDuplicates)
             samples.push_back(idx);
@@ -127,7 +166,7 @@ const std::vector<size_t> RandomSampleNodeBase<ElemType>::RunSampling(size_t& nT
 template<class ElemType>
 void RandomSampleNode<ElemType>::ForwardPropNonLooping()
 {
-    Base::UpdateWeightsPrefixSum();
+    Base::UpdateSampler();
 
     if (ValueAsMatrix().GetMatrixType() != SPARSE)
     {
@@ -226,22 +265,19 @@ double RandomSampleInclusionFrequencyNode<ElemType>::EstimateInSampleFrequency(d
 template<class ElemType>
 void RandomSampleInclusionFrequencyNode<ElemType>::ForwardPropNonLooping()
 {
-    Base::UpdateWeightsPrefixSum();
+    Base::UpdateSampler();
     Matrix<ElemType>& valueMatrix = ValueAsMatrix();
     valueMatrix.TransferToDeviceIfNotThere(CPUDEVICE, /*ismoved =*/ true/*means: BOTH state not ok */, /*emptyTransfer =*/ true, /*updatePreferredDevice =*/ false);
     valueMatrix.SetDevice(CPUDEVICE);
 
     // BUGBUG: matrix type should be configured during validation
     valueMatrix.SwitchToMatrixType(DENSE, matrixFormatDense, false);
-    double sumOfWeights = Base::m_samplingWeightsPrefixSum.back();
-    const Matrix<ElemType>& samplingWeights = Input(0)->ValueAsMatrix();
-
     double estimatedNumTries = EstimateNumberOfTries();
 
-    for (int i = 0; i < Base::m_samplingWeightsPrefixSum.size(); i++)
+    for (int i = 0; i < Base::m_sampler.GetNumClasses(); i++)
     {
         // Get the sampling probablility for from the weights for i-th class.
-        double samplingProb = samplingWeights.GetValue(i, 0) / sumOfWeights;
+        double samplingProb = Base::m_sampler.GetProbability(i);
         double estimatedCount = EstimateInSampleFrequency(samplingProb, estimatedNumTries);
         valueMatrix.SetValue(i, 0, (ElemType)estimatedCount);
     }
@@ -264,6 +300,184 @@ void RandomSampleInclusionFrequencyNode<ElemType>::Validate(bool isFinalValidati
 template class RandomSampleInclusionFrequencyNode<float>;
 template class RandomSampleInclusionFrequencyNode<double>;
 
+template<class ElemType>
+void SampledCrossEntropyWithSoftmaxNode<ElemType>::CopyTo(ComputationNodeBasePtr nodeP, const std::wstring& newName, const CopyNodeFlags flags) const
+{
+    Base::CopyTo(nodeP, newName, flags);
+    if (flags & CopyNodeFlags::copyNodeValue)
+    {
+        auto node = dynamic_pointer_cast<SampledCrossEntropyWithSoftmaxNode<ElemType>>(nodeP);
+        node->m_sizeOfSampledSet = m_sizeOfSampledSet;
+        node->SetRngState(GetRngSeed(), GetRngOffset());
+    }
+}
+
+template<class ElemType>
+void SampledCrossEntropyWithSoftmaxNode<ElemType>::Save(File& fstream) const
+{
+    Base::Save(fstream);
+    fstream << m_sizeOfSampledSet;
+    RngUser::Save(fstream);
+}
+
+template<class ElemType>
+void SampledCrossEntropyWithSoftmaxNode<ElemType>::Load(File& fstream, size_t modelVersion)
+{
+    Base::Load(fstream, modelVersion);
+    fstream >> m_sizeOfSampledSet;
+    RngUser::Load(fstream, modelVersion);
+}
+
+template<class ElemType>
+void SampledCrossEntropyWithSoftmaxNode<ElemType>::Validate(bool isFinalValidationPass)
+{
+    Base::Validate(isFinalValidationPass);
+    m_pMBLayout = nullptr; // this node does not hold mini-batch data
+
+    if (m_sizeOfSampledSet == 0)
+        InvalidArgument("%ls %ls operation: Number of requested samples is zero.", NodeName().c_str(), OperationName().c_str());
+
+    const size_t numClasses = Input(0)->GetSampleMatrixNumRows();
+    const size_t hiddenDim = Input(1)->GetSampleMatrixNumRows();
+    Input(2)->ValidateInferInputDimsFrom(TensorShape(hiddenDim, numClasses));
+
+    if (isFinalValidationPass)
+    {
+        if (!Input(0)->HasMBLayout() || !Input(1)->HasMBLayout())
+            LogicError("%ls: Expected MBLayout in Inputs 0 and 1.", NodeDescription().c_str());
+        if (Input(2)->HasMBLayout() || Input(2)->GetSampleMatrixNumRows() != hiddenDim || Input(2)->GetSampleMatrixNumCols() != numClasses)
+            InvalidArgument("%ls %ls operation: The weights must be a [%d x %d] matrix without a dynamic axis.", NodeName().c_str(), OperationName().c_str(), (int) hiddenDim, (int) numClasses);
+        if (Input(3)->HasMBLayout() || Input(3)->GetSampleLayout().GetNumElements() != numClasses)
+            InvalidArgument("%ls %ls operation: The sampling weights must be a vector of dimension %d without a dynamic axis.", NodeName().c_str(), OperationName().c_str(), (int) numClasses);
+    }
+    SetDims(TensorShape(1), false);
+}
+
+template<class ElemType>
+void SampledCrossEntropyWithSoftmaxNode<ElemType>::DrawSampledClasses()
+{
+    const double numDraws = (double) m_sizeOfSampledSet;
+    if (m_sampler.SetWeights(InputRef(3).Value()))
+    {
+        std::vector<ElemType> labelLogitOffsets(m_sampler.GetNumClasses());
+        for (size_t i = 0; i < labelLogitOffsets.size(); i++)
+            labelLogitOffsets[i] = (ElemType) -log(std::max(numDraws * m_sampler.GetProbability(i), std::numeric_limits<double>::min()));
+        CreateMatrixIfNull(m_labelLogitOffsets);
+        m_labelLogitOffsets->SetValue(1, labelLogitOffsets.size(), m_deviceId, labelLogitOffsets.data());
+    }
+
+    // the draws are few, and cheap with the alias table; only their classes and offsets go to the device
+    CPURNGHandle* cpuRNGHandle = dynamic_cast<CPURNGHandle*>(&GetRNGHandle(CPUDEVICE));
+    std::map<size_t, size_t> numDrawsOfClass;
+    for (size_t k = 0; k < m_sizeOfSampledSet; k++)
+        numDrawsOfClass[m_sampler.Sample(cpuRNGHandle->Generator())]++;
+    UpdateRngOffset(GetRngOffset() + m_sizeOfSampledSet);
+
+    std::vector<ElemType> sampledClasses, sampledLogitOffsets;
+    for (const auto& entry : numDrawsOfClass)
+    {
+        sampledClasses.push_back((ElemType) entry.first);
+        sampledLogitOffsets.push_back((ElemType) log(entry.second / (numDraws * m_sampler.GetProbability(entry.first))));
+    }
+    CreateMatrixIfNull(m_sampledClasses);
+    CreateMatrixIfNull(m_sampledLogitOffsets);
+    m_sampledClasses->SetValue(1, sampledClasses.size(), m_deviceId, sampledClasses.data());
+    m_sampledLogitOffsets->SetValue(1, sampledLogitOffsets.size(), m_deviceId, sampledLogitOffsets.data());
+}
+
+template<class ElemType>
+void SampledCrossEntropyWithSoftmaxNode<ElemType>::ForwardPropNonLooping()
+{
+    FrameRange fr(InputRef(0).GetMBLayout());
+    // flatten all gaps to zero, such that gaps will contribute zero to the logits of the labels and the gradients
+    InputRef(0).MaskedValueFor(fr);
+    InputRef(1).MaskedValueFor(fr);
+    const auto& labels = InputRef(0).Value();
+    const auto& hidden = InputRef(1).Value();
+    const size_t hiddenDim = hidden.GetNumRows();
+    const size_t numCols = hidden.GetNumCols();
+    if (labels.GetNumCols() != numCols)
+        LogicError("%ls %ls operation: The labels and the hidden input have different numbers of columns.", NodeName().c_str(), OperationName().c_str());
+
+    DrawSampledClasses();
+    const size_t numSampled = m_sampledClasses->GetNumCols();
+
+    // logits of the sampled classes, with the gathered columns of the weights
+    m_sampledWeights->DoGatherColumnsOf(0, *m_sampledClasses, InputRef(2).Value(), 1);
+    m_logits->Resize(numCols, 1 + numSampled);
+    auto sampledLogits = m_logits->ColumnSlice(1, numSampled);
+    Matrix<ElemType>::MultiplyAndWeightedAdd(1, hidden, true, *m_sampledWeights, false, 0, sampledLogits);
+    TensorView<ElemType>(m_logits, TensorShape(numCols, 1 + numSampled).NarrowTo(1, 1, 1 + numSampled))
+        .DoUnaryOpOf(1, ToTensor(m_sampledLogitOffsets, 1, numSampled), 1, opCopy, opSum);
+
+    // logits of the labels, with the columns of the weights selected by the labels, into the first column of m_logits
+    auto labelLogits = ToTensor(m_logits, 1, numCols);
+    m_labelWeights->Resize(hiddenDim, numCols);
+    Matrix<ElemType>::MultiplyAndWeightedAdd(1, InputRef(2).Value(), false, labels, false, 0, *m_labelWeights);
+    labelLogits.DoBinaryOpOf(0, ToTensor(m_labelWeights, hiddenDim, numCols), ToTensor(InputRef(1).ValuePtrRef(), hiddenDim, numCols), 1, opElementwiseProduct, opSum);
+    m_logSumExp->Resize(1, numCols);
+    Matrix<ElemType>::MultiplyAndWeightedAdd(1, *m_labelLogitOffsets, false, labels, false, 0, *m_logSumExp);
+    labelLogits.DoUnaryOpOf(1, ToTensor(m_logSumExp, 1, numCols), 1, opCopy, opSum);
+
+    auto logits = ToTensor(m_logits, numCols, 1 + numSampled);
+    auto logSumExp = ToTensor(m_logSumExp, numCols, 1);
+    logSumExp.DoUnaryOpOf(0, logits, 1, opCopy, opLogSum);
+
+    m_mask->Resize(1, numCols);
+    m_mask->SetValue(1);
+    MaskMissingColumnsToZero(*m_mask, InputRef(0).GetMBLayout(), fr);
+
+    // reduce mask .* (logSumExp - labelLogits) over all frames
+    auto value = ToTensor(ValuePtrRef(), 1, 1);
+    value.DoBinaryOpOf(0, ToTensor(m_mask, 1, numCols), logSumExp, 1, opElementwiseProduct, opSum);
+    value.DoBinaryOpOf(1, ToTensor(m_mask, 1, numCols), labelLogits, -1, opElementwiseProduct, opSum);
+#if NANCHECK
+    Value().HasNan("SampledCrossEntropyWithSoftmax");
+#endif
+
+    // replace the logits by the gradient w.r.t. them, mask .* (softmax(logits) - [1 0 ... 0])
+    auto columnMask = ToTensor(m_mask, numCols, 1);
+    logits.DoTernaryOpOf(0, columnMask, logits, logSumExp, 1, opElementwiseProductWithExpOfDiff, opSum);
+    ToTensor(m_logits, numCols, 1).DoUnaryOpOf(1, columnMask, -1, opCopy, opSum);
+}
+
+template<class ElemType>
+void SampledCrossEntropyWithSoftmaxNode<ElemType>::BackpropToNonLooping(size_t inputIndex)
+{
+    if (inputIndex != 1 && inputIndex != 2) // no gradient for the labels and the sampling weights
+        return;
+
+    const auto& hidden = InputRef(1).Value();
+    const size_t hiddenDim = hidden.GetNumRows();
+    const size_t numCols = hidden.GetNumCols();
+    const size_t numSampled = m_sampledClasses->GetNumCols();
+
+    m_logitsGradient->Resize(numCols, 1 + numSampled);
+    ToTensor(m_logitsGradient, numCols, 1 + numSampled).DoBinaryOpOf(0, ToTensor(GradientPtrRef(), 1, 1), ToTensor(m_logits, numCols, 1 + numSampled), 1, opElementwiseProduct, opSum);
+    auto labelLogitsGradient = ToTensor(m_logitsGradient, 1, numCols);
+    auto sampledLogitsGradient = m_logitsGradient->ColumnSlice(1, numSampled);
+
+    if (inputIndex == 1) // hidden: labelWeights .* labelLogitsGradient + sampledWeights * sampledLogitsGradient^T
+    {
+        ToTensor(InputRef(1).GradientPtrRef(), hiddenDim, numCols).DoBinaryOpOf(1, ToTensor(m_labelWeights, hiddenDim, numCols), labelLogitsGradient, 1, opElementwiseProduct, opSum);
+        Matrix<ElemType>::MultiplyAndWeightedAdd(1, *m_sampledWeights, false, sampledLogitsGradient, true, 1, InputRef(1).Gradient());
+    }
+    else // weights: hidden * sampledLogitsGradient into the sampled columns, and (hidden .* labelLogitsGradient) * labels^T into those of the labels
+    {
+        auto& inputGradient = InputRef(2).Gradient();
+        m_weightsGradient->Resize(hiddenDim, numSampled);
+        Matrix<ElemType>::MultiplyAndWeightedAdd(1, hidden, false, sampledLogitsGradient, false, 0, *m_weightsGradient);
+        inputGradient.DoScatterColumnsOf(1, *m_sampledClasses, *m_weightsGradient, 1); // the sampled classes are distinct
+
+        m_weightsGradient->Resize(hiddenDim, numCols);
+        ToTensor(m_weightsGradient, hiddenDim, numCols).DoBinaryOpOf(0, ToTensor(InputRef(1).ValuePtrRef(), hiddenDim, numCols), labelLogitsGradient, 1, opElementwiseProduct, opSum);
+        Matrix<ElemType>::MultiplyAndWeightedAdd(1, *m_weightsGradient, false, InputRef(0).Value(), true, 1, inputGradient);
+    }
+}
+
+template class SampledCrossEntropyWithSoftmaxNode<float>;
+template class SampledCrossEntropyWithSoftmaxNode<double>;
+
 template<class ElemType>
 void DropoutNode<ElemType>::Save(File& fstream) const
 {
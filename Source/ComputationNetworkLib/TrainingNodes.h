@@ -108,6 +108,8 @@ template class SquareErrorNode<double>;
 // -----------------------------------------------------------------------
 // CrossEntropyWithSoftmaxNode (labels, prediction)
 // calculates: -sum(left_i * log(softmax_i(right)))
+// The softmax is not materialized. With the log-sum-exp of each column of 'right', log(softmax_i(right)) is
+// right_i - logSumExp, so that the only temporary is one row, and loss and gradients take a few passes over the inputs.
 // -----------------------------------------------------------------------
 
 template <class ElemType>
@@ -125,39 +127,36 @@ public:
 
     virtual void BackpropToNonLooping(size_t inputIndex) override
     {
-        FrameRange fr(InputRef(0).GetMBLayout());
-        // left input is scalar
-        if (inputIndex == 0) // left derivative
-        {
-#if DUMPOUTPUT
-            m_logSoftmaxOfRight->Print("CrossEntropyWithSoftmax Partial-logSoftmaxOfRight");
-            Gradient().Print("CrossEntropyWithSoftmax Partial-gradientValues");
-            InputRef(0).GradientFor(fr).Print("CrossEntropyWithSoftmaxNode Partial-Left-in");
-#endif
+        auto gradient = ToTensor(GradientPtrRef()); // [1 x 1], broadcast
+        auto logSumExp = ToTensor(m_logSumExpOfRight);
+        auto right = ToTensor(InputRef(1).ValuePtrRef());
+        // a gradient that no other node adds to is overwritten, which saves clearing it
+        ElemType beta = Input(inputIndex)->ParentOverwritesGradient() ? (ElemType) 0 : (ElemType) 1;
 
-            auto gradient = InputRef(0).GradientFor(fr);
-            Matrix<ElemType>::Multiply1x1AndWeightedAdd(-1.0f, Gradient() /*1x1*/, *m_logSoftmaxOfRight, 1.0f, gradient);
 #if DUMPOUTPUT
-            InputRef(0).GradientFor(fr).Print("CrossEntropyWithSoftmaxNode Partial-Left-out");
+        Gradient().Print("CrossEntropyWithSoftmax Partial-gradientValues");
+        m_logSumExpOfRight->Print("CrossEntropyWithSoftmax Partial-logSumExpOfRight");
 #endif
-        }
-
-        else if (inputIndex == 1) // right derivative
+        if (inputIndex == 0) // left derivative: -gradient * log(softmax(right)) = gradient * (logSumExp - right)
         {
+            auto inputGradient = ToTensor(InputRef(0).GradientPtrRef());
+            inputGradient.DoBinaryOpOf(beta, gradient, logSumExp, 1, opElementwiseProduct, opSum);
+            inputGradient.DoBinaryOpOf(1, gradient, right, -1, opElementwiseProduct, opSum);
 #if DUMPOUTPUT
-            m_softmaxOfRight->Print("CrossEntropyWithSoftmax Partial-softmaxOfRight");
-            InputRef(0).ValueFor(fr).Print("CrossEntropyWithSoftmax Partial-inputFunctionValues");
-            Gradient().Print("CrossEntropyWithSoftmax Partial-gradientValues");
-            InputRef(1).GradientFor(fr).Print("CrossEntropyWithSoftmaxNode Partial-Right-in");
+            InputRef(0).Gradient().Print("CrossEntropyWithSoftmaxNode Partial-Left-out");
 #endif
+        }
 
-            auto gradient = InputRef(1).GradientFor(fr);
-            Matrix<ElemType>::AddScaledDifference(Gradient(), *m_softmaxOfRight, InputRef(0).ValueFor(fr), gradient);
+        else if (inputIndex == 1) // right derivative: gradient * (softmax(right) - left) = gradient * exp(right - logSumExp) - gradient * left
+        {
+            auto inputGradient = ToTensor(InputRef(1).GradientPtrRef());
+            inputGradient.DoTernaryOpOf(beta, gradient, right, logSumExp, 1, opElementwiseProductWithExpOfDiff, opSum);
+            inputGradient.DoBinaryOpOf(1, gradient, ToTensor(InputRef(0).ValuePtrRef()), -1, opElementwiseProduct, opSum);
 #if DUMPOUTPUT
-            InputRef(1).GradientFor(fr).Print("CrossEntropyWithSoftmaxNode Partial-Right");
+            InputRef(1).Gradient().Print("CrossEntropyWithSoftmaxNode Partial-Right");
 #endif
 #ifdef _DEBUG
-            InputRef(1).InvalidateMissingGradientColumns(fr); // TODO: This should not be necessary.
+            InputRef(1).InvalidateMissingGradientColumns(FrameRange(InputRef(0).GetMBLayout())); // TODO: This should not be necessary.
 #endif
         }
     }
@@ -167,26 +166,31 @@ public:
         return false;
     }
 
+    virtual bool ImplementsGradientOverwriteOptimization() const override { return true; }
+
     virtual void UpdateFunctionMBSize() override
     {
-        m_logSoftmaxOfRight->Resize(Input(1)->Value());
-        m_softmaxOfRight->Resize(*m_logSoftmaxOfRight);
+        m_logSumExpOfRight->Resize(1, Input(1)->Value().GetNumCols());
     }
 
-    virtual void /*ComputationNodeNonLooping::*/ ForwardPropNonLooping() override // -sum(left_i * log(softmax_i(right)))
+    virtual void /*ComputationNodeNonLooping::*/ ForwardPropNonLooping() override // -sum(left_i * log(softmax_i(right))) = sum(left_i * (logSumExp - right_i))
     {
         FrameRange fr(InputRef(0).GetMBLayout());
-        // first compute the softmax (column-wise)
-        // Note that we need both log and non-log for gradient computation.
-        m_logSoftmaxOfRight->AssignLogSoftmaxOf(InputRef(1).ValueFor(fr), true);
-        // BUGBUG: No need to compute m_softmaxOfRight in ForwardProp, should be moved to BackpropTo().
-        m_softmaxOfRight->SetValue(*m_logSoftmaxOfRight);
-        m_softmaxOfRight->InplaceExp();
         // flatten all gaps to zero, such that gaps will contribute zero to the sum
-        MaskMissingColumnsToZero(*m_logSoftmaxOfRight, InputRef(1).GetMBLayout(), fr);
+        InputRef(0).MaskedValueFor(fr);
+        InputRef(1).MaskedValueFor(fr);
+        auto left = ToTensor(InputRef(0).ValuePtrRef());
+        auto right = ToTensor(InputRef(1).ValuePtrRef());
+
+        // the log-sum-exp of each column (column-wise, reducing with a running max), which the gradients need as well
+        auto logSumExp = ToTensor(m_logSumExpOfRight);
+        logSumExp.DoUnaryOpOf(0, right, 1, opCopy, opLogSum);
+        MaskMissingColumnsToZero(*m_logSumExpOfRight, InputRef(1).GetMBLayout(), fr);
+
         // reduce over all frames
-        Value().AssignInnerProductOfMatrices(InputRef(0).MaskedValueFor(fr), *m_logSoftmaxOfRight);
-        Value() *= -1;
+        auto value = ToTensor(ValuePtrRef());
+        value.DoBinaryOpOf(0, left, logSumExp, 1, opElementwiseProduct, opSum);
+        value.DoBinaryOpOf(1, left, right, -1, opElementwiseProduct, opSum);
 #if NANCHECK
         Value().HasNan("CrossEntropyWithSoftmax");
 #endif
@@ -206,8 +210,7 @@ public:
         if (flags & CopyNodeFlags::copyNodeValue)
         {
             auto node = dynamic_pointer_cast<CrossEntropyWithSoftmaxNode<ElemType>>(nodeP);
-            node->m_logSoftmaxOfRight->SetValue(*m_logSoftmaxOfRight);
-            node->m_softmaxOfRight->SetValue(*m_softmaxOfRight);
+            node->m_logSumExpOfRight->SetValue(*m_logSumExpOfRight);
         }
     }
 
@@ -215,13 +218,17 @@ public:
     virtual void RequestMatricesBeforeForwardProp(MatrixPool& matrixPool)
     {
         Base::RequestMatricesBeforeForwardProp(matrixPool);
-        RequestMatrixFromPool(m_logSoftmaxOfRight, matrixPool);
-        RequestMatrixFromPool(m_softmaxOfRight, matrixPool);
+        RequestMatrixFromPool(m_logSumExpOfRight, matrixPool);
     }
 
 protected:
-    shared_ptr<Matrix<ElemType>> m_logSoftmaxOfRight;
-    shared_ptr<Matrix<ElemType>> m_softmaxOfRight;
+    // a matrix as a [rows x cols] tensor, for reducing over and broadcasting along its columns
+    static TensorView<ElemType> ToTensor(const shared_ptr<Matrix<ElemType>>& matrix)
+    {
+        return TensorView<ElemType>(matrix, TensorShape(matrix->GetNumRows(), matrix->GetNumCols()));
+    }
+
+    shared_ptr<Matrix<ElemType>> m_logSumExpOfRight; // [1 x T], zero in the gaps
 };
 
 template class CrossEntropyWithSoftmaxNode<float>;
@@ -474,66 +481,11 @@ public:
     {
         FrameRange fr(Input(0)->GetMBLayout());
 
-        if (inputIndex == 1 &&  // right derivative
-            m_numberOfUrlPairs > 0)   // 
+        if (inputIndex == 1) // right derivative
         {
+            // the lambdas of the url pairs of each query, with the discounts of the ranks from ForwardProp
             auto gradient = Input(1)->GradientFor(fr);
-
-            // sigma * (si - sj)
-            *m_pairwiseDifferences *= m_sigma;
-            // exp(sigma * (si - sj))
-            m_lambdas->AssignExpOf(*m_pairwiseDifferences);
-            // 1 + exp(sigma * (si - sj))
-            *m_lambdas += 1;
-            // 1 / (1 + exp(sigma * (si - sj)))
-            m_lambdas->AssignElementInverseOf(*m_lambdas);
-            // -sigma/(1+exp(sigma*(si - sj)))
-            m_lambdas->AssignProductOf(-m_sigma, *m_lambdas);
-
-            // Get the update of weight.
-            const Matrix<ElemType>& lambdas = *m_lambdas;
-            m_weightUpdate->SetValue(gradient);
-            size_t pairsCount = 0;
-            ElemType discountI, discountJ;
-            ElemType gainI;
-            ElemType lambdaIJ;
-            for (auto qu : m_queryUrls)
-            {
-                ElemType idealMetric = qu.m_idealMetric;
-                for (typename std::vector<Url>::iterator itUrlI = qu.m_urls.begin(); itUrlI != qu.m_urls.end(); itUrlI++)
-                {
-                    Url& UrlI = *itUrlI;
-                    size_t k = UrlI.m_K;
-                    discountI = m_logWeights[UrlI.m_rank];
-                    gainI = UrlI.m_gain;
-                    if (k == 0) continue;
-                    for (typename std::vector<Url>::iterator itUrlJ = itUrlI + 1; itUrlJ <= itUrlI + k; itUrlJ++)
-                    {
-                        Url& UrlJ = *itUrlJ;
-                        discountJ = m_logWeights[UrlJ.m_rank];
-                        if (abs(gainI - UrlJ.m_gain) < 0.0000001)
-                        {
-                            continue;
-                        }
-
-                        // delta DCG
-                        lambdaIJ = (gainI - UrlJ.m_gain) * (discountI - discountJ) / (discountI * discountJ);
-
-                        // |delta NDCG|
-                        lambdaIJ = (idealMetric == 0.0 ? (ElemType) 0.0 : abs(lambdaIJ / idealMetric));
-
-                        // Combine lambda
-                        lambdaIJ = lambdas(0, pairsCount++) * lambdaIJ;
-
-                        // Assign to gradient
-                        (*m_weightUpdate)(0, UrlI.m_id) += lambdaIJ;
-                        (*m_weightUpdate)(0, UrlJ.m_id) -= lambdaIJ;
-                        
-                    }
-                }
-            }
-
-            gradient.SetValue(*m_weightUpdate);
+            gradient.AddLambdaRankGradientOf(m_sigma, Input(0)->ValueFor(fr), Input(1)->ValueFor(fr), Input(2)->ValueFor(fr), *m_urlDiscounts);
         }
     }
 
@@ -542,35 +494,6 @@ public:
         return false;
     }
 
-    virtual void UpdateFunctionMBSize() override
-    {
-        UpdateCounts();
-
-        // clean up first
-        if (!m_queryUrls.empty()) m_queryUrls.clear();
-        if (!m_urlSorter.empty()) m_urlSorter.clear();
-        if (!m_logWeights.empty()) m_logWeights.clear();
-
-        m_pairwiseDifferences->Resize(1, m_numberOfUrlPairs);
-        m_lambdas->Resize(1, m_numberOfUrlPairs);
-
-        m_urlGain0->Resize(1, m_numberOfQueryUrls);
-        m_urlGain1->Resize(1, m_numberOfQueryUrls);
-        m_urlDiscount0->Resize(1, m_numberOfQueryUrls);
-        m_urlDiscount1->Resize(1, m_numberOfQueryUrls);
-
-        // keep one additional space to avoid pointer moving out
-        m_urlSorter.resize(m_maxNumberOfUrlsPerQuery + 1);
-        
-        // prepared lookup table
-        m_logWeights.resize(m_maxNumberOfUrlsPerQuery);
-        size_t i = 0;
-        for (typename std::vector<ElemType>::iterator it = m_logWeights.begin(); it != m_logWeights.end(); it++, i++)
-        {
-            *it = (ElemType) log(2.0 + i);
-        }
-    }
-
     virtual void /*ComputationNodeNonLooping::*/ ForwardPropNonLooping() override
     {
         // Inputs:
@@ -585,134 +508,18 @@ public:
         // 3,   0.4,    1
         // 0,   0.5,    1
         // 0,   0.3,    1
+        // The urls of a query are consecutive and in descending order of gain. The ranking by score within each query
+        // and the metric are computed on the device of the inputs, see Matrix::AssignLambdaRankMetricOf().
         FrameRange fr(Input(0)->GetMBLayout());
 
-        // Construct matrices for further computation.
         const Matrix<ElemType>& gains = Input(0)->ValueFor(fr);
-        const Matrix<ElemType>& preds = Input(1)->ValueFor(fr);
-        const Matrix<ElemType>& queryIds = Input(2)->ValueFor(fr);
-
-        // Iterate through all samples
-        size_t numberOfSamples = gains.GetNumCols();
-        QueryUrls aqu;
-        int previousQueryId = -1;
-        int numberOfQueries = 0;
-
-        // Iterate all samples and populate m_queryUrls table. 
-        for (size_t i = 0; i < numberOfSamples; i++)
-        {
-            int queryId = (int)queryIds(0, i);
-            // Samples are grouped by queries. Find all the urls 
-            // belonging to each individual query.
-            if (queryId != previousQueryId)
-            {
-                m_queryUrls.push_back(aqu);
-                numberOfQueries++;
-                previousQueryId = queryId;
-            }
-
-            // Get the last QueryUrls and add the Url.
-            QueryUrls& qu = m_queryUrls.back();
-            Url u(i, qu.m_urls.size(), preds(0, i), gains(0, i));
-            qu.m_urls.push_back(u);
-        }
-
-        // Update K (number of url pairs that have smaller or equal gain), rk (rank of 
-        // score in descending order) and and m_pairwiseDifferences (save for gradient 
-        // computation).
-        size_t pairCount = 0;
-        for (auto &qu : m_queryUrls)
-        {
-            std::vector<Url>& urls = qu.m_urls;
-            size_t numberOfUrls = urls.size();
-            // Urls are pre-sorted in descending order of gains.
-            ElemType minGain = urls[numberOfUrls - 1].m_gain;
-            for (size_t j = 0; j < urls.size(); j++)
-            {
-                if (urls[j].m_gain > minGain)
-                {
-                    size_t numberOfPairs = numberOfUrls - j - 1;
-                    urls[j].m_K = numberOfPairs;
-                    if (numberOfPairs > 0)
-                    {
-                        for (size_t k = 0; k < numberOfPairs; k++)
-                        {
-                            (*m_pairwiseDifferences)(0, pairCount++) = urls[j].m_score - urls[j + 1 + k].m_score;
-                        }
-                    }
-                }
-                // Skip urls with gain equal to min (0).
-                else 
-                {
-                    urls[j].m_K = 0;
-                }
-            }
-
-            typename std::vector<Url>::iterator its = m_urlSorter.begin(), it = urls.begin();
-            typename std::vector<Url>::iterator its0 = its;
-            its = std::copy(it, urls.end(), its);
-            std::sort(its0, its);
-            // Set the sorted rk order to each url and 
-            // the urls are still in the original order
-            int rk = 0;
-            for (it = its0; it != its; it++)
-            {
-                urls[it->m_rank0].m_rank = rk++;
-            }
-        }
-
-        // Compute ir metric.
-        size_t sampleCount = 0;
-        for (const auto &qu: m_queryUrls)
-        {
-            for (const auto &url : qu.m_urls)
-            {
-                (*m_urlGain0)(0, sampleCount) = url.m_gain;
-                (*m_urlGain1)(0, sampleCount) = url.m_gain;
-                (*m_urlDiscount0)(0, sampleCount) = (ElemType)url.m_rank0;
-                (*m_urlDiscount1)(0, sampleCount) = (ElemType)url.m_rank;
-                sampleCount++;
-            }
-        }
-        
-        // log(2+rank)
-        *m_urlDiscount0 += 2.0;
-        m_urlDiscount0->InplaceLog();
-        *m_urlDiscount1 += 2.0;
-        m_urlDiscount1->InplaceLog();
-        // gain/log(2+rank)
-        m_urlGain0->AssignElementDivisionOf(*m_urlGain0, *m_urlDiscount0);
-        m_urlGain1->AssignElementDivisionOf(*m_urlGain1, *m_urlDiscount1);
-
-        // Aggregate at query level.
-        const Matrix<ElemType>& urlDiscountedGain0 = *m_urlGain0;
-        const Matrix<ElemType>& urlDiscountedGain1 = *m_urlGain1;
-        ElemType irMetricValue = 0.0;
-        for (auto &qu : m_queryUrls)
-        {
-            qu.m_idealMetric = 0.0;
-            qu.m_metric = 0.0;
-
-            for (const auto &url : qu.m_urls)
-            {
-                qu.m_idealMetric += urlDiscountedGain0(0, url.m_id);
-                qu.m_metric += urlDiscountedGain1(0, url.m_id);
-            }
-
-            if (qu.m_idealMetric != 0.0)
-            {
-                irMetricValue += (qu.m_metric / qu.m_idealMetric);
-            }
-        }
-
-        if (numberOfQueries == 0)
+        if (gains.GetNumCols() == 0)
         {
             LogicError("In %ls %ls numberOfQueries==0, check your data.", NodeName().c_str(), OperationName().c_str());
         }
 
-        // to make up the reporting
-        irMetricValue = (1.0f - irMetricValue / numberOfQueries) * 100 * numberOfSamples;
-        Value().SetValue(irMetricValue);
+        // reports (1 - average NDCG) * 100 * number of urls
+        Value().AssignLambdaRankMetricOf(gains, Input(1)->ValueFor(fr), Input(2)->ValueFor(fr), *m_urlDiscounts);
     }
 
     virtual void /*ComputationNodeBase::*/ Validate(bool isFinalValidationPass) override
@@ -735,17 +542,7 @@ public:
         if (flags & CopyNodeFlags::copyNodeValue)
         {
             auto node = dynamic_pointer_cast<LambdaRankNode<ElemType>>(nodeP);
-            node->m_pairwiseDifferences->SetValue(*m_pairwiseDifferences);
-            node->m_lambdas->SetValue(*m_lambdas);
-            node->m_weightUpdate->SetValue(*m_weightUpdate);
-            node->m_urlGain0->SetValue(*m_urlGain0);
-            node->m_urlGain1->SetValue(*m_urlGain1);
-            node->m_urlDiscount0->SetValue(*m_urlDiscount0);
-            node->m_urlDiscount1->SetValue(*m_urlDiscount1);
-
-            node->m_queryUrls = m_queryUrls;
-            node->m_urlSorter = m_urlSorter;
-            node->m_logWeights = m_logWeights;
+            node->m_urlDiscounts->SetValue(*m_urlDiscounts);
         }
     }
 
@@ -753,154 +550,20 @@ public:
     virtual void RequestMatricesBeforeForwardProp(MatrixPool& matrixPool)
     {
         Base::RequestMatricesBeforeForwardProp(matrixPool);
-        RequestMatrixFromPool(m_pairwiseDifferences, matrixPool);
-        RequestMatrixFromPool(m_lambdas, matrixPool);
-        RequestMatrixFromPool(m_weightUpdate, matrixPool);
-        RequestMatrixFromPool(m_urlGain0, matrixPool);
-        RequestMatrixFromPool(m_urlGain1, matrixPool);
-        RequestMatrixFromPool(m_urlDiscount0, matrixPool);
-        RequestMatrixFromPool(m_urlDiscount1, matrixPool);
+        RequestMatrixFromPool(m_urlDiscounts, matrixPool);
     }
 
     // release gradient and temp matrices that no longer needed after all the children's gradients are computed.
     virtual void ReleaseMatricesAfterBackprop(MatrixPool& matrixPool)
     {
         Base::ReleaseMatricesAfterBackprop(matrixPool);
-        ReleaseMatrixToPool(m_pairwiseDifferences, matrixPool);
-        ReleaseMatrixToPool(m_lambdas, matrixPool);
-        ReleaseMatrixToPool(m_weightUpdate, matrixPool);
-        ReleaseMatrixToPool(m_urlGain0, matrixPool);
-        ReleaseMatrixToPool(m_urlGain1, matrixPool);
-        ReleaseMatrixToPool(m_urlDiscount0, matrixPool);
-        ReleaseMatrixToPool(m_urlDiscount1, matrixPool);
-        
-        // is this the right place?  it was not called after bp.
-        m_queryUrls.clear();
-        m_urlSorter.clear();
-        m_logWeights.clear();
+        ReleaseMatrixToPool(m_urlDiscounts, matrixPool);
     }
 
 protected:
-
-    void UpdateCounts()
-    {
-        FrameRange fr(Input(0)->GetMBLayout());
-        const Matrix<ElemType>& gains = Input(0)->ValueFor(fr);
-        const Matrix<ElemType>& queryIds = Input(2)->ValueFor(fr);
-        const size_t numberOfQueryUrls = gains.GetNumCols();
-        int previousQueryId = -1;
-
-        // Number of urls we have seen for the current query
-        size_t numberOfUrls = 0;
-
-        // Number of urls that have gains greater than 0 for the current query 
-        size_t numberOfUrlsWithNonZeroGain = 0;
-        size_t numberOfUrlPairs = 0;
-        size_t maxNumberOfUrlsPerQuery = 0;
-        for (size_t i = 0; i < numberOfQueryUrls; i++)
-        {
-            int queryId = (int)queryIds(0, i);
-            ElemType gain = gains(0, i);
-            if (queryId != previousQueryId)
-            {
-                // Ignore pairs between urls with zero gains.
-                numberOfUrlPairs += (2 * numberOfUrls - 1 - numberOfUrlsWithNonZeroGain) * numberOfUrlsWithNonZeroGain / 2;
-                if (numberOfUrls > maxNumberOfUrlsPerQuery)
-                {
-                    maxNumberOfUrlsPerQuery = numberOfUrls;
-                }
-
-                // New query
-                numberOfUrls = 0;
-                numberOfUrlsWithNonZeroGain = 0;
-                previousQueryId = queryId;
-            }
-            
-            numberOfUrls++;
-            if (gain > 0)
-            {
-                numberOfUrlsWithNonZeroGain++;
-            }
-        }
-
-        // Add last query.
-        {
-            numberOfUrlPairs += (2 * numberOfUrls - 1 - numberOfUrlsWithNonZeroGain) * numberOfUrlsWithNonZeroGain / 2;
-            if (numberOfUrls > maxNumberOfUrlsPerQuery)
-            {
-                maxNumberOfUrlsPerQuery = numberOfUrls;
-            }
-        }
-
-        m_numberOfQueryUrls = numberOfQueryUrls;
-        m_numberOfUrlPairs = numberOfUrlPairs;
-        m_maxNumberOfUrlsPerQuery = maxNumberOfUrlsPerQuery;
-    }
-
-    struct Url
-    {
-        Url()
-        {
-            m_id = 0;
-            m_rank0 = 0;
-            m_rank = 0;
-            m_score = (ElemType)0;
-            m_gain = (ElemType)0;
-            m_K = 0;
-        }
-
-        Url(int id, int rk0, ElemType sc, ElemType gn) : m_id(id), m_rank0(rk0), m_rank(0), m_score(sc), m_gain(gn), m_K(0) {}
-
-        int m_id;           // sample id
-        int m_rank0;        // original rank based on label
-        int m_rank;         // rank based on s in the associated query
-        ElemType m_score;   // score
-        ElemType m_gain;    // gain
-        int m_K;            // the pair index
-        bool operator < (const Url &url) const {
-            // tie breaking
-            if (m_score == url.m_score || std::isnan(m_score) || std::isnan(url.m_score))
-            {
-                return m_gain < url.m_gain;
-            }
-
-            return m_score > url.m_score;
-        }
-    };
-
-    struct QueryUrls
-    {
-        ElemType m_idealMetric;  // the ideal NDCG
-        ElemType m_metric;   // NDCG based on the current scores
-
-        std::vector<Url> m_urls;
-    };
-
-    // master data structure
-    std::list<QueryUrls> m_queryUrls;
-    // buffer for sorting
-    std::vector<Url> m_urlSorter;
-    // lookup table for position based weights
-    std::vector<ElemType> m_logWeights;
-
-    size_t m_numberOfQueryUrls;
-    size_t m_numberOfUrlPairs;
-    size_t m_maxNumberOfUrlsPerQuery;
-
     ElemType m_sigma;
-    // Score differences between url pairs
-    shared_ptr<Matrix<ElemType>> m_pairwiseDifferences;
-    // 1/(1+exp(sigma*(si - sj)))
-    shared_ptr<Matrix<ElemType>> m_lambdas;
-    
-    // update of weight matrix
-    shared_ptr<Matrix<ElemType>> m_weightUpdate;
-    
-    // store the gains and position discounts
-    shared_ptr<Matrix<ElemType>> m_urlGain0;
-    shared_ptr<Matrix<ElemType>> m_urlGain1;
-    shared_ptr<Matrix<ElemType>> m_urlDiscount0;
-    shared_ptr<Matrix<ElemType>> m_urlDiscount1;
+    // log(2 + rank by score within the query) of each url
+    shared_ptr<Matrix<ElemType>> m_urlDiscounts;
 };
 
 template class LambdaRankNode<float>;
@@ -1224,6 +887,46 @@ protected:
     std::shared_ptr<RNGHandle> m_RNGHandle;
 };
 
+// ------------------------------------------------------------------------------------------------------------------------------------------------
+// WeightedSampler: draws classes with probabilities proportional to a vector of weights >= 0, in constant time per draw
+// by the alias method (Walker, Vose). The table is built in O(numClasses) from a single copy of the weights to the CPU,
+// and only when the weights have changed since the last call to SetWeights().
+// --------------------------------------------------------------------------------------------------------------------------------------------------
+
+class WeightedSampler
+{
+public:
+    WeightedSampler() : m_totalWeight(0) {}
+
+    // sets the weights from a [numClasses x 1] matrix; returns whether they have changed
+    template <class ElemType>
+    bool SetWeights(const Matrix<ElemType>& weights)
+    {
+        std::vector<ElemType> buffer(weights.GetNumElements());
+        weights.CopySection(weights.GetNumRows(), weights.GetNumCols(), buffer.data(), weights.GetNumRows());
+        if (buffer.size() == m_weights.size() && std::equal(buffer.begin(), buffer.end(), m_weights.begin()))
+            return false;
+        m_weights.assign(buffer.begin(), buffer.end());
+        BuildAliasTable();
+        return true;
+    }
+
+    // draws a class
+    size_t Sample(std::mt19937_64& generator) const;
+
+    size_t GetNumClasses() const { return m_weights.size(); }
+    double GetTotalWeight() const { return m_totalWeight; }
+    double GetProbability(size_t i) const { return m_weights[i] / m_totalWeight; }
+
+private:
+    void BuildAliasTable();
+
+    std::vector<double> m_weights;
+    double m_totalWeight;
+    std::vector<double> m_acceptProbabilities; // a draw of bucket i keeps class i with this probability,
+    std::vector<size_t> m_aliases;             // and takes this class otherwise
+};
+
 // ------------------------------------------------------------------------------------------------------------------------------------------------
 // RandomSampleNodeBase(samplingWeights, sizeOfSampledSet, allowDuplicates): 
 // Base class for RandomSampleNode and RandomSampleInclusionFrequencyNode.
@@ -1259,9 +962,12 @@ public:
     virtual void Save(File& fstream) const override;
     virtual void Load(File& fstream, size_t modelVersion) override;
 
+    // draws random numbers, so recomputation would not reproduce the value
+    virtual bool SupportsValueRecomputation() const override { return false; }
+
 protected:
 
-    void UpdateWeightsPrefixSum();
+    void UpdateSampler();
 
     // Runs the sampling returning a vector with the id's of the samples. The parameter nTries is used to return the number of draws that was needed
     // to get the expected number of samples.
@@ -1279,7 +985,7 @@ public:
 protected:
     bool m_allowDuplicates; // The node can create samples allowing for duplicates (sampling with replacement) or not (sampling without replacement).
     size_t m_sizeOfSampledSet; // Requested size of sample in case of run-mode = CREATE_SAMPLES.
-    std::vector<double> m_samplingWeightsPrefixSum;
+    WeightedSampler m_sampler;
 };
 
 // ------------------------------------------------------------------------------------------------------------------------------------------------
@@ -1360,6 +1066,118 @@ private:
     double EstimateNumberOfTries();
 };
 
+// ------------------------------------------------------------------------------------------------------------------------------------------------
+// SampledCrossEntropyWithSoftmaxNode(labels, hidden, weights, samplingWeights, sizeOfSampledSet):
+// Sampled softmax: an estimate of CrossEntropyWithSoftmax(labels, TransposeTimes(weights, hidden)) for a large number of classes,
+// which computes the logits of only the label of each column and of 'sizeOfSampledSet' classes drawn for the minibatch.
+// The classes are drawn with replacement, with probabilities proportional to 'samplingWeights' (e.g. the unigram distribution,
+// or log((i+2)/(i+1)) for a log-uniform distribution over classes sorted by frequency), and each logit is corrected by the log
+// of the expected number of draws of its class. Draws of the same class are merged, such that the sampled classes are distinct.
+// Only the columns of 'weights' of the labels and the sampled classes are gathered, and only those get a gradient.
+// Accidental hits of the label among the sampled classes are not removed.
+//
+// Parameters:
+// * Input(0): labels, one-hot [numClasses x T]. Sparse labels keep the cost independent of numClasses.
+// * Input(1): hidden [hiddenDim x T]
+// * Input(2): weights [hiddenDim x numClasses], one column per class
+// * Input(3): sampling weights [numClasses x 1] >= 0; like the labels, they get no gradient.
+// * sizeOfSampledSet: the number of draws per minibatch
+// The value is the sum of the losses over the minibatch. Evaluation should use CrossEntropyWithSoftmax.
+// --------------------------------------------------------------------------------------------------------------------------------------------------
+
+template <class ElemType>
+class SampledCrossEntropyWithSoftmaxNode : public ComputationNodeNonLooping /*ComputationNode*/<ElemType>, public NumInputs<4>, public RngUser
+{
+    typedef ComputationNodeNonLooping<ElemType> Base; UsingComputationNodeMembersBoilerplate;
+    static const std::wstring TypeName() { return L"SampledCrossEntropyWithSoftmax"; }
+
+public:
+    SampledCrossEntropyWithSoftmaxNode(DEVICEID_TYPE deviceId, const wstring& name, size_t sizeOfSampledSet = 0)
+        : Base(deviceId, name), m_sizeOfSampledSet(sizeOfSampledSet)
+    {
+        SetRngState(CreateUniqId());
+    }
+
+    SampledCrossEntropyWithSoftmaxNode(const ScriptableObjects::IConfigRecordPtr configp)
+        : SampledCrossEntropyWithSoftmaxNode(CPUDEVICE, L"<placeholder>", configp->Get(L"sizeOfSampledSet"))
+    {
+        AttachInputsFromConfig(configp, this->GetExpectedNumInputs());
+    }
+
+    virtual void CopyTo(ComputationNodeBasePtr nodeP, const std::wstring& newName, const CopyNodeFlags flags) const override;
+    virtual void Save(File& fstream) const override;
+    virtual void Load(File& fstream, size_t modelVersion) override;
+
+    virtual void /*ComputationNodeNonLooping::*/ ForwardPropNonLooping() override;
+    virtual void /*ComputationNodeNonLooping::*/ BackpropToNonLooping(size_t inputIndex) override;
+    virtual void /*ComputationNodeBase::*/ Validate(bool isFinalValidationPass) override;
+
+    virtual bool OutputUsedInComputingInputNodesGradients() const override { return false; }
+    virtual bool InputUsedInComputingInputNodesGradients(size_t childIndex) const override { return childIndex == 0 || childIndex == 1; }
+
+    // draws random numbers, so recomputation would not reproduce the value
+    virtual bool SupportsValueRecomputation() const override { return false; }
+
+    size_t GetNumSamples() const { return m_sizeOfSampledSet; }
+
+    virtual void RequestMatricesBeforeForwardProp(MatrixPool& matrixPool) override
+    {
+        Base::RequestMatricesBeforeForwardProp(matrixPool);
+        RequestMatrixFromPool(m_sampledWeights, matrixPool);
+        RequestMatrixFromPool(m_labelWeights, matrixPool);
+        RequestMatrixFromPool(m_logits, matrixPool);
+        RequestMatrixFromPool(m_logSumExp, matrixPool);
+        RequestMatrixFromPool(m_mask, matrixPool);
+    }
+
+    virtual void RequestMatricesBeforeBackprop(MatrixPool& matrixPool) override
+    {
+        Base::RequestMatricesBeforeBackprop(matrixPool);
+        RequestMatrixFromPool(m_logitsGradient, matrixPool);
+        RequestMatrixFromPool(m_weightsGradient, matrixPool);
+    }
+
+    virtual void ReleaseMatricesAfterBackprop(MatrixPool& matrixPool) override
+    {
+        Base::ReleaseMatricesAfterBackprop(matrixPool);
+        ReleaseMatrixToPool(m_sampledWeights, matrixPool);
+        ReleaseMatrixToPool(m_labelWeights, matrixPool);
+        ReleaseMatrixToPool(m_logits, matrixPool);
+        ReleaseMatrixToPool(m_logSumExp, matrixPool);
+        ReleaseMatrixToPool(m_mask, matrixPool);
+        ReleaseMatrixToPool(m_logitsGradient, matrixPool);
+        ReleaseMatrixToPool(m_weightsGradient, matrixPool);
+    }
+
+protected:
+    // draws the classes, and sets m_sampledClasses and m_sampledLogitOffsets
+    void DrawSampledClasses();
+
+    // a matrix as a [rows x cols] tensor
+    static TensorView<ElemType> ToTensor(const shared_ptr<Matrix<ElemType>>& matrix, size_t rows, size_t cols)
+    {
+        return TensorView<ElemType>(matrix, TensorShape(rows, cols));
+    }
+
+    size_t m_sizeOfSampledSet;
+    WeightedSampler m_sampler;
+
+    // uploaded when the sampling weights change or per minibatch, respectively
+    shared_ptr<Matrix<ElemType>> m_labelLogitOffsets;   // [1 x numClasses], -log(expected number of draws of each class)
+    shared_ptr<Matrix<ElemType>> m_sampledClasses;      // [1 x numSampled], the distinct sampled classes
+    shared_ptr<Matrix<ElemType>> m_sampledLogitOffsets; // [1 x numSampled], log(number of draws / expected number of draws)
+
+    shared_ptr<Matrix<ElemType>> m_sampledWeights; // [hiddenDim x numSampled], the gathered columns of the weights
+    shared_ptr<Matrix<ElemType>> m_labelWeights;   // [hiddenDim x T], the column of the weights of the label of each column
+    shared_ptr<Matrix<ElemType>> m_logits;         // [T x (1 + numSampled)], the corrected logits of the label and the sampled classes,
+                                                   // replaced in ForwardProp by the gradient of the loss w.r.t. them
+    shared_ptr<Matrix<ElemType>> m_logSumExp;      // [1 x T]
+    shared_ptr<Matrix<ElemType>> m_mask;           // [1 x T], zero in the gaps
+
+    shared_ptr<Matrix<ElemType>> m_logitsGradient;  // m_logits times the gradient of the node
+    shared_ptr<Matrix<ElemType>> m_weightsGradient; // [hiddenDim x numSampled], or [hiddenDim x T] for the labels
+};
+
 // -----------------------------------------------------------------------
 // ClassBasedCrossEntropyWithSoftmaxNode (labeldata(.,t), inputdata(.,t), embeddingMatrix, clsProbBeforeSoftmaxData(.,t))
 //  - Input(0) [4 x T] label in dense matrix in
@@ -1631,7 +1449,7 @@ template class ClassBasedCrossEntropyWithSoftmaxNode<double>;
 //    in the R-CRF case, it is the RNN output score before softmax
 //  - transition scores: square transition matrix,  --TODO: log?
 //    in the R-CRF case, it is the transition probability between labels
-// BUGBUG: This node cannot operate with truncated BPTT, but does not detect it. It also does not handle gaps or test boundary flags.
+// All sequences of the minibatch are processed at once. Sequences must be entirely contained in the minibatch (no truncated BPTT).
 // -----------------------------------------------------------------------
 
 /**
@@ -1665,43 +1483,23 @@ public:
         : Base(deviceId, name),
           mAlpha(deviceId),
           mBeta(deviceId),
-          mPostProb(deviceId)
+          mPostProb(deviceId),
+          mObjectives(deviceId)
     {
     }
 
     // compute posterior probability of label y at position t
+    // All sequences of the minibatch are processed by a single call (one GPU kernel launch).
     virtual void /*ComputationNodeNonLooping::*/ ForwardPropNonLooping() override
     {
-        FrameRange fr(InputRef(0).GetMBLayout());
-        size_t nrow = InputRef(0).Value().GetNumRows();
-        size_t ncol = InputRef(0).Value().GetNumCols();
-
-        mAlpha.Resize(nrow, ncol);
-        mBeta.Resize(nrow, ncol);
-        mPostProb.Resize(nrow, ncol);
-
-        Value().SetValue(0.0);
-        Matrix<ElemType> funcVal = Value(); // TODO: This just creates a 1x1 matrix set to 0.
-
-        size_t nS = InputRef(0).GetNumParallelSequences();
-        if (nS != 1)
-            LogicError("CRFNode: >1 parallel sequences are curently not implemented correctly.");
-        for (size_t i = 0; i < nS; i++) // process parallel sequences one by one  --BUGBUG: We should loop over individual sequences.
-        {
-            FrameRange sequenceRange = fr.Sequence(i); // FrameRange to select one sequence
-            // BUGBUG: This ^^ is neither supported nor correct, since this code does not handle gaps or start/end flags.
-            ForwardPropS(
-                DataWithMBLayoutFor(mPostProb, sequenceRange, InputRef(0).GetMBLayout()),
-                DataWithMBLayoutFor(mAlpha, sequenceRange, InputRef(0).GetMBLayout()),
-                DataWithMBLayoutFor(mBeta, sequenceRange, InputRef(0).GetMBLayout()),
-                funcVal,
-                InputRef(0).ValueFor(sequenceRange),
-                InputRef(1).ValueFor(sequenceRange),
-                InputRef(2).ValueAsMatrix(), mStartLbl,
-                mEndLbl);
-
-            Value() += funcVal; // aggregate over sequences
-        }
+        let& pMBLayout = InputRef(0).GetMBLayout();
+        Matrix<ElemType>::RCRFForwardBackward(InputRef(0).Value(), InputRef(1).Value(), InputRef(2).ValueAsMatrix(),
+                                              this->GetCRFSequences(pMBLayout), pMBLayout->GetNumParallelSequences(),
+                                              mAlpha, mBeta, mObjectives);
+        // mBeta holds the log posteriors (LZERO in gaps)
+        mPostProb.SetValue(mBeta);
+        mPostProb.InplaceExp();
+        Value().AssignSumOfElements(mObjectives); // aggregate over sequences
     }
 
     virtual void BackpropToNonLooping(size_t inputIndex) override // scaled by 2*number of colmns (samples) in the Matrix<ElemType>
@@ -1719,17 +1517,23 @@ public:
         else if (inputIndex == 2)
         {
             assert(InputRef(inputIndex).GradientFor(fr).GetNumElements() > 0);
-            size_t nS = InputRef(0).GetNumParallelSequences();
-            for (size_t i = 0; i < nS; i++) // process all sequences one by one
+            let& pMBLayout = InputRef(0).GetMBLayout();
+            if (pMBLayout->GetNumParallelSequences() != 1)
+                LogicError("CRFNode: The gradient of the transition scores is currently only implemented for one parallel sequence.");
+            auto& gradient = InputRef(2).GradientAsMatrix();
+            for (const auto& seq : this->GetCRFSequences(pMBLayout)) // process all sequences one by one
             {
-                FrameRange sequenceRange = fr.Sequence(i); // FrameRange to select one sequence
-                auto& gradient = InputRef(2).GradientAsMatrix();
-                TransGrdCompute(InputRef(0).ValueFor(sequenceRange),
-                                DataWithMBLayoutFor(mAlpha, sequenceRange, InputRef(0).GetMBLayout()),
-                                DataWithMBLayoutFor(mBeta, sequenceRange, InputRef(0).GetMBLayout()),
+                let lbls = InputRef(0).Value().ColumnSlice(seq.tBegin, seq.numFrames);
+                int startLbl = -1;
+                for (int ik = 0; ik < lbls.GetNumRows() && startLbl < 0; ik++)
+                    if (lbls(ik, 0) != 0)
+                        startLbl = ik;
+                TransGrdCompute(lbls,
+                                mAlpha.ColumnSlice(seq.tBegin, seq.numFrames),
+                                mBeta.ColumnSlice(seq.tBegin, seq.numFrames),
                                 InputRef(2).ValueAsMatrix(),
                                 gradient,
-                                mStartLbl, 1);
+                                startLbl, 1);
             }
         }
         else
@@ -1741,118 +1545,6 @@ public:
         return false;
     }
 
-    // compute forward backward algorithm
-    /*TODO: merge with call site*/ void ForwardPropS(Matrix<ElemType> postprob, Matrix<ElemType> alpha, Matrix<ElemType> beta, Matrix<ElemType>& functionValues, const Matrix<ElemType>& lbls, const Matrix<ElemType>& pos_scores, const Matrix<ElemType>& pair_scores, int& firstLbl, int& lastLbl, const int iStep = 1)
-    {
-        // to-do, each slice is for one sentence
-        // to-do, number of slices correspond to number of frames
-        // this implementation only supports one sentence per minibatch
-
-        int nObs = lbls.GetNumCols();
-
-        // change to other values so can support multiple sentences in each minibatch
-        assert(iStep == 1);
-        ForwardCompute(alpha, lbls, pos_scores, pair_scores);
-        BackwardCompute(alpha, beta, functionValues, lbls, pos_scores, pair_scores, iStep);
-        PostProbCompute(postprob, alpha, beta);
-
-        firstLbl = -1;
-        for (int ik = 0; ik < lbls.GetNumRows(); ik++)
-            if (lbls(ik, 0) != 0)
-            {
-                firstLbl = ik;
-                break;
-            }
-
-        lastLbl = -1;
-        for (int ik = 0; ik < lbls.GetNumRows(); ik++)
-            if (lbls(ik, nObs - 1) != 0)
-            {
-                lastLbl = ik;
-                break;
-            }
-
-        functionValues.AssignInnerProductOfMatrices(lbls, pos_scores);
-
-        Matrix<ElemType> a = alpha.ColumnSlice(nObs - 1, 1);
-        ElemType fAlpha;
-        fAlpha = a.LogSumOfElements();
-
-        // transition score
-        ElemType tscore = 0;
-        for (int t = 0; t < nObs - 1; t++)
-        {
-            int i = -1;
-            for (int ik = 0; ik < lbls.GetNumRows(); ik++)
-                if (lbls(ik, t) != 0)
-                {
-                    i = ik;
-                    break;
-                }
-            int j = -1;
-            for (int ik = 0; ik < lbls.GetNumRows(); ik++)
-                if (lbls(ik, t + 1) != 0)
-                {
-                    j = ik;
-                    break;
-                }
-            tscore += pair_scores(j, i);
-        }
-        tscore += functionValues.Get00Element(); // correct path score
-        tscore -= fAlpha;                        // reduced by the scores from all paths
-        functionValues.SetValue(tscore);
-
-        functionValues *= (-1);
-    }
-
-    // compute forward backward algorithm
-    static void ForwardCompute(Matrix<ElemType>& alpha,
-                               const Matrix<ElemType>& lbls,
-                               const Matrix<ElemType>& pos_scores, const Matrix<ElemType>& pair_scores)
-    {
-        // to-do, shift more than 1 to support muliple sentences per minibatch
-        int iNumPos = lbls.GetNumCols();
-        int iNumLab = lbls.GetNumRows();
-
-        int firstLbl = -1;
-        for (int ik = 0; ik < lbls.GetNumRows(); ik++)
-            if (lbls(ik, 0) != 0)
-            {
-                firstLbl = ik;
-                break;
-            }
-
-        // need to have
-        alpha.Resize(iNumLab, iNumPos);
-
-        for (int t = 0; t < iNumPos; t++)
-        {
-            for (int k = 0; k < iNumLab; k++)
-            {
-                ElemType fTmp = (ElemType) LZERO;
-                for (int j = 0; j < iNumLab; j++)
-                {
-                    ElemType fAlpha = (j == firstLbl) ? (ElemType) 0.0 : (ElemType) LZERO;
-                    if (t > 0)
-                        fAlpha = alpha(j, t - 1);
-                    fTmp = alpha.LogAdd(fTmp, fAlpha + pair_scores(k, j));
-                }
-                fTmp += pos_scores(k, t); // include position dependent score
-                alpha(k, t) = fTmp;
-            }
-        }
-    }
-
-    // compute backward algorithm
-    static void BackwardCompute(const Matrix<ElemType>& alpha, Matrix<ElemType>& beta,
-                                Matrix<ElemType>& functionValues, const Matrix<ElemType>& lbls,
-                                const Matrix<ElemType>& pos_scores, const Matrix<ElemType>& pair_scores, const int shift = 1)
-    {
-        assert(shift == 1);
-
-        alpha.RCRFBackwardCompute(alpha, beta, functionValues, lbls, pos_scores, pair_scores, shift);
-    }
-
     static void TransGrdCompute(const Matrix<ElemType>& lbls,
                                 const Matrix<ElemType>& alpha,
                                 const Matrix<ElemType>& beta,
@@ -1871,17 +1563,6 @@ public:
                                   startLbl, shift);
     }
 
-    // compute forward backward algorithm
-    static void PostProbCompute(Matrix<ElemType>& postprob, const Matrix<ElemType>& alpha, const Matrix<ElemType>& beta)
-    {
-        int iNumPos = alpha.GetNumCols();
-        int iNumLab = alpha.GetNumRows();
-
-        postprob.Resize(iNumLab, iNumPos);
-        postprob.SetValue(beta);
-        postprob.InplaceExp();
-    }
-
     virtual void /*ComputationNodeBase::*/ Validate(bool isFinalValidationPass) override
     {
         Base::Validate(isFinalValidationPass);
@@ -1909,9 +1590,7 @@ public:
             node->mAlpha = mAlpha;
             node->mBeta = mBeta;
             node->mPostProb = mPostProb;
-
-            node->mStartLbl = mStartLbl;
-            node->mEndLbl = mEndLbl;
+            node->mObjectives = mObjectives;
         }
     }
 
@@ -1919,8 +1598,7 @@ private:
     Matrix<ElemType> mAlpha; // TODO: m_Alpha etc.
     Matrix<ElemType> mBeta;
     Matrix<ElemType> mPostProb;
-    int mStartLbl;
-    int mEndLbl;
+    Matrix<ElemType> mObjectives; // [1 x #sequences] negative log likelihood of each sequence
 };
 
 #endif
@@ -2103,6 +1781,9 @@ template class LogisticNode<double>;
 // -----------------------------------------------------------------------
 // DropoutNode (input) -- perform drop-out
 // Output is scaled such that no post-scaling is necessary.
+// With a counter-based mask (SetCounterBasedMask()), the mask is not drawn from the stateful RNG handle and stored for
+// backprop, but computed by PhiloxRNG from the RNG seed and a range of the RNG offset reserved for the minibatch, in
+// forward prop as well as in backprop. This saves the memory of the mask, and makes the value recomputable.
 // -----------------------------------------------------------------------
 
 template <class ElemType>
@@ -2119,7 +1800,9 @@ public:
     DeclareConstructorFromConfigWithNumInputs(DropoutNode);
     DropoutNode(DEVICEID_TYPE deviceId, const wstring& name)
         : Base(deviceId, name),
-        m_dropoutRate(0)
+        m_dropoutRate(0),
+        m_useCounterBasedMask(false),
+        m_maskRngOffset(0)
     {
         SetRngState(CreateUniqId());
     }
@@ -2127,12 +1810,17 @@ public:
     virtual void Save(File& fstream) const override;
     virtual void Load(File& fstream, size_t modelVersion) override;
 
+    // draws random numbers, so recomputation would not reproduce the value, unless they are counter-based
+    virtual bool SupportsValueRecomputation() const override { return m_useCounterBasedMask; }
+
     virtual void /*ComputationNode::*/ BackpropTo(const size_t inputIndex, const FrameRange& fr) override
     {
         Matrix<ElemType> sliceInput0Grad = InputRef(0).GradientFor(fr);
         Matrix<ElemType> sliceOutputGrad = GradientFor(fr);
 
-        if (m_dropoutRate > 0)
+        if (m_dropoutRate > 0 && m_useCounterBasedMask)
+            sliceInput0Grad.DoElementProductOfCounterBasedMask(1, sliceOutputGrad, (ElemType)m_dropoutRate, (ElemType)(1.0 / (1.0 - m_dropoutRate)), GetRngSeed(), MaskOffsetFor(Gradient(), fr));
+        else if (m_dropoutRate > 0)
             sliceInput0Grad.AddElementProductOf(sliceOutputGrad, DataFor(*m_maskOfDropout, fr));
         else
             sliceInput0Grad += sliceOutputGrad;
@@ -2145,10 +1833,23 @@ public:
     {
         Base::UpdateFunctionMBSize();
         // resize temporaries to their proper size
-        if (m_dropoutRate > 0)
+        if (m_dropoutRate > 0 && !m_useCounterBasedMask)
             m_maskOfDropout->Resize(Input(0)->Value());
     }
 
+    virtual void /*ComputationNode::*/ BeginForwardProp() override
+    {
+        Base::BeginForwardProp();
+
+        // Each minibatch reserves the random numbers of its elements. A recomputation for activation checkpointing finds
+        // the value up to date w.r.t. the inputs, and reuses the range of the forward prop (loops are never recomputed).
+        if (m_useCounterBasedMask && (IsPartOfLoop() || IsOutOfDateWrtInputs()))
+        {
+            m_maskRngOffset = GetRngOffset();
+            UpdateRngOffset(m_maskRngOffset + Value().GetNumElements());
+        }
+    }
+
     virtual void /*ComputationNode::*/ ForwardProp(const FrameRange& fr) override
     {
         Matrix<ElemType> sliceInput0Value = Input(0)->ValueFor(fr);
@@ -2158,6 +1859,10 @@ public:
         {
             sliceOutputValue.SetValue(sliceInput0Value);
         }
+        else if (m_useCounterBasedMask)
+        {
+            sliceOutputValue.DoElementProductOfCounterBasedMask(0, sliceInput0Value, (ElemType)m_dropoutRate, (ElemType)(1.0 / (1.0 - m_dropoutRate)) /*pre-scaled*/, GetRngSeed(), MaskOffsetFor(Value(), fr));
+        }
         else
         {
             // determine drop-out mask for this minibatch
@@ -2182,6 +1887,12 @@ public:
         m_dropoutRate = val;
     }
 
+    // must be set before the matrices are allocated, since the mask matrix is not needed then
+    void SetCounterBasedMask(bool useCounterBasedMask)
+    {
+        m_useCounterBasedMask = useCounterBasedMask;
+    }
+
     RNGHandle& GetRNGHandle()
     {
         return RngUser::GetRNGHandle(ValuePtr()->GetDeviceId());
@@ -2196,27 +1907,47 @@ public:
             node->m_dropoutRate = m_dropoutRate;
             node->SetRngState(GetRngSeed(), GetRngOffset());
             node->m_maskOfDropout = m_maskOfDropout;
+            node->m_useCounterBasedMask = m_useCounterBasedMask;
+            node->m_maskRngOffset = m_maskRngOffset;
         }
     }
     // request matrices needed to do node function value evaluation
     virtual void RequestMatricesBeforeForwardProp(MatrixPool& matrixPool)
     {
         Base::RequestMatricesBeforeForwardProp(matrixPool);
-        RequestMatrixFromPool(m_maskOfDropout, matrixPool);
+        if (!m_useCounterBasedMask)
+            RequestMatrixFromPool(m_maskOfDropout, matrixPool);
     }
 
     // release gradient and temp matrices that no longer needed after all the children's gradients are computed.
     virtual void ReleaseMatricesAfterBackprop(MatrixPool& matrixPool)
     {
         Base::ReleaseMatricesAfterBackprop(matrixPool);
-        ReleaseMatrixToPool(m_maskOfDropout, matrixPool);
+        if (!m_useCounterBasedMask)
+            ReleaseMatrixToPool(m_maskOfDropout, matrixPool);
+    }
+
+    virtual void ReleaseMatricesKeptForBackprop(MatrixPool& matrixPool) override
+    {
+        Base::ReleaseMatricesKeptForBackprop(matrixPool);
+        if (!m_useCounterBasedMask)
+            ReleaseMatrixToPool(m_maskOfDropout, matrixPool);
     }
 
     double GetDropoutRate() const { return m_dropoutRate; }
 
 private:
+    // the RNG offset of the first element of the slice 'fr' of 'data', a value or gradient of this node
+    uint64_t MaskOffsetFor(const Matrix<ElemType>& data, const FrameRange& fr) const
+    {
+        size_t firstColumn = ColumnRangeWithMBLayoutFor(data.GetNumCols(), fr, GetMBLayout()).first;
+        return m_maskRngOffset + (uint64_t)firstColumn * GetSampleMatrixNumRows();
+    }
+
     double m_dropoutRate;
     shared_ptr<Matrix<ElemType>> m_maskOfDropout;
+    bool m_useCounterBasedMask;
+    uint64_t m_maskRngOffset; // RNG offset of the first element of the current minibatch's mask
 };
 
 // -----------------------------------------------------------------------
@@ -2399,6 +2130,9 @@ public:
 
     size_t GetSamplesSeen() const { return m_samplesSeen; }
 
+    // updates the running statistics in ForwardProp(), so it must not run twice per minibatch
+    bool SupportsValueRecomputation() const override { return false; }
+
 private: // time-constant conversions
 
     // map time constants to exp avg factor
@@ -2575,7 +2309,8 @@ public:
             auto paramLayout = Input(i)->GetSampleLayout();
             if (paramLayout.GetRank() == 2 && paramLayout[0] == 0 && paramLayout[1] == 1 && inputLayout.GetNumElements() > 0) // [0 x 1]
             {
-                size_t total = m_spatial ? inputLayout.GetDims().back() : inputLayout.GetNumElements();
+                // For spatial batch normalization, that is the number of channels, which is the first dimension in the HWC layout.
+                size_t total = !m_spatial ? inputLayout.GetNumElements() : m_imageLayoutKind == CHW ? inputLayout.GetDims().back() : inputLayout[0];
                 Input(i)->ValidateInferInputDimsFrom(TensorShape(total, 1));
             }
         }
@@ -2619,10 +2354,10 @@ public:
                         InvalidArgument("%ls: Data input cannot broadcast.", NodeDescription().c_str());
 #endif
             }
-            if (m_spatial && m_imageLayoutKind != CHW)
+            if (m_spatial && m_imageLayoutKind != CHW && inputLayout.GetRank() != 3)
             {
                 InvalidArgument(
-                    "%ls %ls currently supports only cuDNN (CHW) data layout. " 
+                    "%ls %ls supports the legacy (HWC) data layout only for images. "
                     "Please specify imageLayout=\"cudnn\" in BatchNormalization node in your NDL/BrainScript "
                     "and make sure your input data layout is CHW", NodeName().c_str(), OperationName().c_str());
             }
@@ -2665,6 +2400,14 @@ public:
         ReleaseMatrixToPool(m_dBias, matrixPool);
     }
 
+    // (in inference, ForwardProp() does not even fill them)
+    void ReleaseMatricesKeptForBackprop(MatrixPool& matrixPool) override
+    {
+        Base::ReleaseMatricesKeptForBackprop(matrixPool);
+        ReleaseMatrixToPool(m_savedMean, matrixPool);
+        ReleaseMatrixToPool(m_savedInvStdDev, matrixPool);
+    }
+
     void SetNormalizationTimeConstants(double normalizationTimeConstant, double prevNormalizationTimeConstant,
                                        double blendTimeConstant, double prevBlendTimeConstant)
     {
@@ -34,6 +34,9 @@ public:
             LogicError("UserDefinedV2FunctionNode ctor should never be called with externalFunction == nullptr");
     }
 
+    // the external function may keep backward state from its forward call, which recomputation would overwrite
+    virtual bool SupportsValueRecomputation() const override { return false; }
+
     virtual void ForwardPropNonLooping() override
     {
         // Get the arguments of the external function
@@ -53,15 +56,21 @@ public:
         }
         assert(j == arguments.size());
 
-        // TODO: Instead of passing null for output values, we should have the forward call directly produce the outputs in the output Value() of this node
-        std::unordered_map<::CNTK::Variable, ::CNTK::ValuePtr> outputValue = { { m_externalFunction->Output(), nullptr } };
+        // The external function computes its output directly into Value() of this node whenever Value() can be viewed as
+        // an unpacked Value object without shuffling its columns; otherwise it allocates the output and we copy it over
+        auto output = m_externalFunction->Output();
+        auto outputValueView = CanViewAsUnpackedValue(Value(), GetMBLayout()) ? ::CNTK::Utils::GetValueObjectFromCNTKImplMatrixAndMBLayout(output, Value(), GetMBLayout(), /*readOnly =*/ false) : nullptr;
+        std::unordered_map<::CNTK::Variable, ::CNTK::ValuePtr> outputValue = { { output, outputValueView } };
         std::unordered_set<::CNTK::Variable> outputsToRetainBackwardStateFor;
         if (Environment().IsTraining())
-            outputsToRetainBackwardStateFor.insert(m_externalFunction->Output());
+            outputsToRetainBackwardStateFor.insert(output);
 
         auto computeDevice = ::CNTK::AsDeviceDescriptor(InputRef(0).Value().GetDeviceId());
         m_currentBackpropStatePtr = m_externalFunction->Forward(argumentValues, outputValue, computeDevice, outputsToRetainBackwardStateFor);
 
+        if (outputValueView && (outputValue.begin()->second == outputValueView))
+            return;
+
         // Copy the computed output to Value() of this node
         // TODO: We currently assume that the external Function does not generate a new MBLayout
         auto outputMatrixAndLayout = ::CNTK::Utils::GetCNTKImplMatrixAndMBLayoutFromValueObject<ElemType>(outputValue.begin()->first, outputValue.begin()->second);
@@ -77,16 +86,22 @@ public:
 
         auto gradientValue = ::CNTK::Utils::GetValueObjectFromCNTKImplMatrixAndMBLayout(m_externalFunction->Output(), Gradient(), GetMBLayout());
         std::unordered_map<::CNTK::Variable, ::CNTK::ValuePtr> outputGradientValue = { { m_externalFunction->Output(), gradientValue } };
-        std::unordered_map<::CNTK::Variable, ::CNTK::ValuePtr> inputGradientValue = { { input, nullptr } };
+
+        // The input gradient has been zeroed or holds the gradients of other parents, and the external function aggregates
+        // into the storage it is passed, so we hand it a view of the input's Gradient() whenever the layout allows one
+        auto& inputNode = InputRef(inputIndex);
+        auto inputGradientView = CanViewAsUnpackedValue(inputNode.Gradient(), inputNode.GetMBLayout()) ? ::CNTK::Utils::GetValueObjectFromCNTKImplMatrixAndMBLayout(input, inputNode.Gradient(), inputNode.GetMBLayout(), /*readOnly =*/ false) : nullptr;
+        std::unordered_map<::CNTK::Variable, ::CNTK::ValuePtr> inputGradientValue = { { input, inputGradientView } };
         m_externalFunction->Backward(m_currentBackpropStatePtr, outputGradientValue, inputGradientValue);
 
+        if (inputGradientView && (inputGradientValue.begin()->second == inputGradientView))
+            return;
+
         // Accumulate the computed input gradient value into the existing input gradient value
-        // TODO: We should directly pass the actual input gradient tensor to the Backward method 
-        // instead of allocating a new value and accumulating it ourselves
         auto newInputGradientMatrixAndLayout = ::CNTK::Utils::GetCNTKImplMatrixAndMBLayoutFromValueObject<ElemType>(inputGradientValue.begin()->first, inputGradientValue.begin()->second);
-        InputRef(inputIndex).Gradient() += *newInputGradientMatrixAndLayout.first;
+        inputNode.Gradient() += *newInputGradientMatrixAndLayout.first;
 
-        if (InputRef(inputIndex).GetMBLayout() != newInputGradientMatrixAndLayout.second)
+        if (inputNode.GetMBLayout() != newInputGradientMatrixAndLayout.second)
             LogicError("The MBLayout of the input (%lu) gradient computed by the external function (%S) does not match the expected MBLayout", (unsigned long)inputIndex, this->GetName().c_str());
     }
 
@@ -134,6 +149,16 @@ public:
         SetDims(outputTensorShape, HasMBLayout());
     }
 
+private:
+    // A matrix is exposed as a Value object without a copy if it is dense and its MBLayout has no sequences to uninterleave
+    static bool CanViewAsUnpackedValue(const Matrix<ElemType>& matrix, const MBLayoutPtr& layout)
+    {
+        if (matrix.GetMatrixType() != MatrixType::DENSE)
+            return false;
+
+        return !layout || (layout->GetNumTimeSteps() == 1) || (layout->GetNumSequences() == 1);
+    }
+
 private:
     ::CNTK::FunctionPtr m_externalFunction;
     ::CNTK::BackPropStatePtr m_currentBackpropStatePtr;
@@ -29,7 +29,10 @@
 #include "InputAndParamNodes.h"
 #include "latticearchive.h"
 #include <limits>
+#include <set>
+#include <algorithm>
 #include "RecurrentNodes.h"
+#include "RNNNodes.h"
 
 namespace Microsoft { namespace MSR { namespace CNTK {
 
@@ -44,6 +47,9 @@ void CNTKEvalBase<ElemType>::Init(const std::string& config)
         Globals::EnableShareNodeValueMatrices();
     if (m_config(L"hyperCompressMemory", false))
         Globals::EnableHyperCompressMemory();
+    Globals::SetMemorySharingPolicy((wstring)m_config(L"memorySharing", L"lifo"));
+    Globals::SetMemorySharingReportPath((wstring)m_config(L"memorySharingReport", L""));
+    Globals::SetValidationCacheDirectory((wstring)m_config(L"validationCacheDir", L""));
 }
 
 
@@ -267,6 +273,13 @@ void CNTKEvalExtended<ElemType>::StartForwardEvaluation(const std::vector<wstrin
     this->m_net->StartEvaluateMinibatchLoop(m_outputNodes);
     m_inputMatrices = DataReaderHelpers::RetrieveInputMatrices(m_inputNodes);
 
+    m_recurrentNodes.clear();
+    for (const auto& node : ComputationNodeBase::EnumerateNodes(m_outputNodes))
+    {
+        if (dynamic_pointer_cast<IRecurrentNode>(node) || node->OperationName() == OperationNameOf(OptimizedRNNStackNode))
+            m_recurrentNodes.push_back(node);
+    }
+
     for (const auto& node : m_outputNodes)
     {
         shared_ptr<Matrix<ElemType>> outputMatrix = dynamic_pointer_cast<Matrix<ElemType>>(node->ValuePtr());
@@ -363,7 +376,11 @@ void CNTKEvalExtended<ElemType>::ForwardPassT(const std::vector<ValueBuffer<Elem
         // SentinelValueIndicatingUnspecifedSequenceBeginIdx is used to specify the lower bound of look-back step of recurrent nodes
         inputNode->GetMBLayout()->AddSequence(0, 0, resetRNN ? 0 : SentinelValueIndicatingUnspecifedSequenceBeginIdx, numCols);
 
-        if (type == MatrixType::DENSE)
+        // On the CPU, a dense input matrix wraps the caller's buffer for the duration of the call instead of copying it.
+        // It is wrapped again (or replaced) by the next call before anything reads it.
+        if (type == MatrixType::DENSE && matrix->GetDeviceId() == CPUDEVICE)
+            matrix->SetValue(numRows, numCols, CPUDEVICE, buffer.m_buffer.data(), matrixFlagDontOwnBuffer);
+        else if (type == MatrixType::DENSE)
             matrix->SetValue(numRows, numCols, matrix->GetDeviceId(), buffer.m_buffer.data(), matrixFlagNormal);
         else if (type == MatrixType::SPARSE)
         {
@@ -434,6 +451,402 @@ void CNTKEvalExtended<ElemType>::ForwardPass(const ValueRefs<ElemType>& inputs,
     ForwardPassT(inputs, outputs, resetRNN);
 }
 
+template<typename ElemType>
+void CNTKEvalExtended<ElemType>::ForwardPassBatch(const std::vector<Values<ElemType>>& inputs, std::vector<Values<ElemType>>& outputs)
+{
+    if (!m_started)
+        RuntimeError("ForwardPassBatch() called before StartForwardEvaluation()");
+
+    ForwardPassBatchT(inputs, outputs, nullptr);
+}
+
+// The sequences are packed side by side: sample t of sequence s goes to column t * numSequences + s, and the
+// shorter sequences are padded with gaps.
+// A sequence that continues a stream is marked as beginning before this minibatch; the PastValue nodes pose the
+// stream's last frame of its previous chunk as the end of a previous minibatch (see DelayedValueNodeBase::SetCarriedFrames()).
+template<typename ElemType>
+void CNTKEvalExtended<ElemType>::ForwardPassBatchT(const std::vector<Values<ElemType>>& inputs, std::vector<Values<ElemType>>& outputs,
+                                                   const std::vector<CNTKEvalStreamState<ElemType>*>* states)
+{
+    const size_t numSequences = inputs.size();
+    if (numSequences == 0)
+        RuntimeError("ForwardPassBatch: Expected at least one sequence.");
+    if (outputs.size() != numSequences)
+        RuntimeError("ForwardPassBatch: Expected outputs for %d sequences, but got %d.", (int)numSequences, (int)outputs.size());
+
+    std::map<MBLayoutPtr, std::vector<size_t>> sequenceLengths; // of each MBLayout of the inputs
+    for (size_t i = 0; i < m_inputNodes.size(); ++i)
+    {
+        auto& inputNode = m_inputNodes[i];
+        auto matrix = dynamic_pointer_cast<Matrix<ElemType>>(inputNode->ValuePtr());
+        bool isSparse = matrix->GetMatrixType() == MatrixType::SPARSE;
+        size_t numRows = inputNode->GetSampleLayout().GetNumElements();
+
+        std::vector<size_t> lengths(numSequences);
+        for (size_t s = 0; s < numSequences; ++s)
+        {
+            if (inputs[s].size() != m_inputNodes.size())
+                RuntimeError("ForwardPassBatch: Sequence %d: Expected %d inputs, but got %d.", (int)s, (int)m_inputNodes.size(), (int)inputs[s].size());
+            const auto& buffer = inputs[s][i];
+            if (isSparse)
+            {
+                if (buffer.m_colIndices.size() < 2 || buffer.m_colIndices[0] != 0 || buffer.m_colIndices.back() != buffer.m_indices.size() ||
+                    buffer.m_indices.size() != buffer.m_buffer.size())
+                    RuntimeError("ForwardPassBatch: Input %ls, sequence %d: Invalid sparse data.", inputNode->GetName().c_str(), (int)s);
+                lengths[s] = buffer.m_colIndices.size() - 1;
+            }
+            else
+            {
+                if (buffer.m_buffer.size() == 0 || buffer.m_buffer.size() % numRows != 0)
+                    RuntimeError("ForwardPassBatch: Input %ls, sequence %d: Expected input data to be a non-zero multiple of %" PRIu64 ", but it is %" PRIu64 ".",
+                                 inputNode->GetName().c_str(), (int)s, numRows, buffer.m_buffer.size());
+                lengths[s] = buffer.m_buffer.size() / numRows;
+            }
+        }
+        size_t numTimeSteps = *std::max_element(lengths.begin(), lengths.end());
+
+        // inputs on the same dynamic axis share the MBLayout
+        auto pMBLayout = inputNode->GetMBLayout();
+        auto found = sequenceLengths.find(pMBLayout);
+        if (found == sequenceLengths.end())
+        {
+            sequenceLengths[pMBLayout] = lengths;
+            pMBLayout->Init(numSequences, numTimeSteps);
+            for (size_t s = 0; s < numSequences; ++s)
+            {
+                bool continues = states && !(*states)[s]->m_carriedFrames.empty();
+                pMBLayout->AddSequence(s, s, continues ? SentinelValueIndicatingUnspecifedSequenceBeginIdx : 0, lengths[s]);
+                if (lengths[s] < numTimeSteps)
+                    pMBLayout->AddGap(s, lengths[s], numTimeSteps);
+            }
+        }
+        else if (found->second != lengths)
+            RuntimeError("ForwardPassBatch: Input %ls: Sequence lengths differ from those of another input on the same dynamic axis.", inputNode->GetName().c_str());
+
+        if (isSparse)
+        {
+            std::vector<int> colIndices(1, 0), rowIndices;
+            std::vector<ElemType> values;
+            for (size_t t = 0; t < numTimeSteps; ++t)
+            {
+                for (size_t s = 0; s < numSequences; ++s)
+                {
+                    if (t < lengths[s])
+                    {
+                        const auto& buffer = inputs[s][i];
+                        for (int k = buffer.m_colIndices[t]; k < buffer.m_colIndices[t + 1]; ++k)
+                        {
+                            rowIndices.push_back(buffer.m_indices[k]);
+                            values.push_back(buffer.m_buffer[k]);
+                        }
+                    }
+                    colIndices.push_back((int)rowIndices.size());
+                }
+            }
+            matrix->SetMatrixFromCSCFormat(colIndices.data(), rowIndices.data(), values.data(), values.size(), numRows, numTimeSteps * numSequences);
+        }
+        else
+        {
+            std::vector<ElemType> data(numRows * numTimeSteps * numSequences, 0);
+            for (size_t s = 0; s < numSequences; ++s)
+            {
+                for (size_t t = 0; t < lengths[s]; ++t)
+                    std::copy_n(inputs[s][i].m_buffer.begin() + t * numRows, numRows, data.begin() + (t * numSequences + s) * numRows);
+            }
+            // (on the CPU, like ForwardPass(), the matrix only wraps the packed data; it is not read after this call)
+            matrix->SetValue(numRows, numTimeSteps * numSequences, matrix->GetDeviceId(), data.data(), matrix->GetDeviceId() == CPUDEVICE ? matrixFlagDontOwnBuffer : matrixFlagNormal);
+        }
+    }
+
+    if (states)
+    {
+        for (const auto& node : m_recurrentNodes)
+        {
+            auto pastValueNode = dynamic_pointer_cast<PastValueNode<ElemType>>(node);
+            size_t numRows = node->GetSampleLayout().GetNumElements();
+            std::vector<ElemType> frames(numRows * numSequences, 0); // (those of new streams are not read)
+            for (size_t s = 0; s < numSequences; ++s)
+            {
+                const auto& carriedFrames = (*states)[s]->m_carriedFrames;
+                auto found = carriedFrames.find(node->NodeName());
+                if (found != carriedFrames.end())
+                    std::copy(found->second.begin(), found->second.end(), frames.begin() + s * numRows);
+            }
+            pastValueNode->SetCarriedFrames(Matrix<ElemType>(numRows, numSequences, frames.data(), node->GetDeviceId()));
+        }
+    }
+
+    ComputationNetwork::BumpEvalTimeStamp(m_inputNodes);
+
+    for (size_t o = 0; o < m_outputNodes.size(); ++o)
+    {
+        auto node = m_outputNodes[o];
+        this->m_net->ForwardProp(node);
+        shared_ptr<Matrix<ElemType>> outputMatrix = dynamic_pointer_cast<Matrix<ElemType>>(node->ValuePtr());
+        size_t numRows = outputMatrix->GetNumRows();
+        size_t numElements = outputMatrix->GetNumElements();
+        std::vector<ElemType> values(numElements);
+        ElemType* data = values.data();
+        outputMatrix->CopyToArray(data, numElements);
+
+        // gather the columns of each sequence, found by its id in the output's layout
+        auto pMBLayout = node->GetMBLayout();
+        for (size_t s = 0; s < numSequences; ++s)
+        {
+            if (outputs[s].size() != m_outputNodes.size())
+                RuntimeError("ForwardPassBatch: Sequence %d: Expected %d outputs, but got %d.", (int)s, (int)m_outputNodes.size(), (int)outputs[s].size());
+            auto& vec = outputs[s][o].m_buffer;
+            std::vector<size_t> columns;
+            if (!pMBLayout) // not a sequence, the same for all
+            {
+                for (size_t j = 0; j < outputMatrix->GetNumCols(); ++j)
+                    columns.push_back(j);
+            }
+            else
+            {
+                const auto& sequences = pMBLayout->GetAllSequences();
+                auto seq = std::find_if(sequences.begin(), sequences.end(), [s](const MBLayout::SequenceInfo& info) { return info.seqId == s; });
+                if (seq == sequences.end())
+                    RuntimeError("ForwardPassBatch: Output %ls has no data for sequence %d.", node->GetName().c_str(), (int)s);
+                for (size_t t = (size_t)std::max(seq->tBegin, (ptrdiff_t)0); t < std::min(seq->tEnd, pMBLayout->GetNumTimeSteps()); ++t)
+                    columns.push_back(t * pMBLayout->GetNumParallelSequences() + seq->s);
+            }
+
+            if (vec.capacity() < columns.size() * numRows)
+                RuntimeError("Not enough space in output buffer for output '%ls' of sequence %d.", node->GetName().c_str(), (int)s);
+            vec.resize(columns.size() * numRows);
+            for (size_t j = 0; j < columns.size(); ++j)
+                std::copy_n(values.begin() + columns[j] * numRows, numRows, vec.begin() + j * numRows);
+        }
+    }
+}
+
+template <typename ElemType>
+IEvalStreamState* CNTKEvalExtended<ElemType>::CreateStreamState()
+{
+    if (!m_started)
+        RuntimeError("CreateStreamState() called before StartForwardEvaluation()");
+
+    return new CNTKEvalStreamState<ElemType>();
+}
+
+template <typename ElemType>
+void CNTKEvalExtended<ElemType>::ForwardPassStreams(const std::vector<Values<ElemType>>& inputs, std::vector<Values<ElemType>>& outputs, const std::vector<IEvalStreamState*>& states)
+{
+    if (!m_started)
+        RuntimeError("ForwardPassStreams() called before StartForwardEvaluation()");
+    if (states.size() != inputs.size())
+        RuntimeError("ForwardPassStreams: Expected states for %d sequences, but got %d.", (int)inputs.size(), (int)states.size());
+
+    std::vector<CNTKEvalStreamState<ElemType>*> streamStates;
+    for (const auto& state : states)
+    {
+        auto streamState = dynamic_cast<CNTKEvalStreamState<ElemType>*>(state);
+        if (!streamState)
+            RuntimeError("ForwardPassStreams: Expected states created by CreateStreamState().");
+        if (std::find(streamStates.begin(), streamStates.end(), streamState) != streamStates.end())
+            RuntimeError("ForwardPassStreams: A stream can only have one chunk per call.");
+        streamStates.push_back(streamState);
+    }
+    VerifyStateCanBeCarried("ForwardPassStreams");
+
+    ForwardPassBatchT(inputs, outputs, &streamStates);
+
+    // keep the frame each stream ended with
+    for (const auto& node : m_recurrentNodes)
+    {
+        auto pastValueNode = dynamic_pointer_cast<PastValueNode<ElemType>>(node);
+        Matrix<ElemType> frame(node->GetDeviceId());
+        for (size_t s = 0; s < streamStates.size(); ++s)
+        {
+            pastValueNode->GetCarriedFrame(s, frame);
+            auto& carriedFrame = streamStates[s]->m_carriedFrames[node->NodeName()];
+            carriedFrame.resize(frame.GetNumElements());
+            ElemType* data = carriedFrame.data();
+            size_t numElements = carriedFrame.size();
+            frame.CopyToArray(data, numElements);
+        }
+    }
+}
+
+template <typename ElemType>
+void CNTKEvalExtended<ElemType>::VerifyStateCanBeCarried(const char* function) const
+{
+    for (const auto& node : m_recurrentNodes)
+    {
+        auto pastValueNode = dynamic_pointer_cast<PastValueNode<ElemType>>(node);
+        if (!pastValueNode || pastValueNode->TimeStep() != 1)
+            RuntimeError("%s: Cannot carry the state of %ls %ls operation over; only PastValue with a time step of 1 is supported.",
+                         function, node->NodeName().c_str(), node->OperationName().c_str());
+    }
+}
+
+// Each step is a minibatch of one time step, with one parallel sequence per hypothesis, which continues the hypothesis
+// it extends: the PastValue nodes gather the frames they carry over from the parallel sequences of the previous step
+// (see DelayedValueNodeBase::GatherCarriedFrames()). The total scores of all extensions are ranked on the device; only
+// the best m_beamWidth are copied back.
+template <typename ElemType>
+void CNTKEvalExtended<ElemType>::BeamSearch(const Values<ElemType>& contextInputs, const BeamSearchOptions& options, std::vector<BeamSearchHypothesis>& hypotheses)
+{
+    if (!m_started)
+        RuntimeError("BeamSearch() called before StartForwardEvaluation()");
+    if (m_outputNodes.size() != 1)
+        RuntimeError("BeamSearch: Expected one output (the scores of the next token), but got %d.", (int)m_outputNodes.size());
+    if (contextInputs.size() + 1 != m_inputNodes.size())
+        RuntimeError("BeamSearch: Expected %d context inputs, but got %d.", (int)m_inputNodes.size() - 1, (int)contextInputs.size());
+    if (options.m_beamWidth == 0)
+        RuntimeError("BeamSearch: Expected a beam width of at least 1.");
+    VerifyStateCanBeCarried("BeamSearch");
+
+    auto tokenNode = std::find_if(m_inputNodes.begin(), m_inputNodes.end(), [&](const ComputationNodeBasePtr& node) { return node->GetName() == options.m_tokenInput; });
+    if (tokenNode == m_inputNodes.end())
+        RuntimeError("BeamSearch: There is no input %ls.", options.m_tokenInput.c_str());
+    auto tokenMatrix = dynamic_pointer_cast<Matrix<ElemType>>((*tokenNode)->ValuePtr());
+    size_t tokenDim = (*tokenNode)->GetSampleLayout().GetNumElements();
+    auto& outputNode = m_outputNodes[0];
+    size_t numTokens = outputNode->GetSampleLayout().GetNumElements();
+    if (options.m_startToken >= tokenDim || options.m_endToken >= tokenDim || options.m_endToken >= numTokens)
+        RuntimeError("BeamSearch: The start and end tokens must be less than the dimensions of input %ls and output %ls.",
+                     options.m_tokenInput.c_str(), outputNode->GetName().c_str());
+
+    // the other inputs, with their sample
+    std::vector<std::pair<ComputationNodeBasePtr, const std::vector<ElemType>*>> contextNodes;
+    for (const auto& inputNode : m_inputNodes)
+    {
+        if (inputNode == *tokenNode)
+            continue;
+        const auto& sample = contextInputs[contextNodes.size()].m_buffer;
+        auto matrix = dynamic_pointer_cast<Matrix<ElemType>>(inputNode->ValuePtr());
+        if (matrix->GetMatrixType() != MatrixType::DENSE || sample.size() != inputNode->GetSampleLayout().GetNumElements())
+            RuntimeError("BeamSearch: Context input %ls: Expected one dense sample.", inputNode->GetName().c_str());
+        contextNodes.push_back(std::make_pair(inputNode, &sample));
+    }
+
+    DEVICEID_TYPE deviceId = outputNode->GetDeviceId();
+    Matrix<ElemType> hypothesisScores(deviceId), totalScores(deviceId), bestIndices(deviceId), bestScores(deviceId);
+    std::vector<BeamSearchHypothesis> live(1, BeamSearchHypothesis{ {}, 0 }), completed;
+    std::vector<size_t> parents; // of each live hypothesis, the parallel sequence of the previous step it extends
+    for (size_t step = 0; step < options.m_maxLength && !live.empty() && completed.size() < options.m_beamWidth; ++step)
+    {
+        size_t numHypotheses = live.size();
+
+        // inputs on the same dynamic axis share the MBLayout
+        std::set<MBLayoutPtr> layouts;
+        for (const auto& inputNode : m_inputNodes)
+        {
+            auto pMBLayout = inputNode->GetMBLayout();
+            if (!layouts.insert(pMBLayout).second)
+                continue;
+            pMBLayout->Init(numHypotheses, 1);
+            for (size_t s = 0; s < numHypotheses; ++s)
+                pMBLayout->AddSequence(s, s, step == 0 ? 0 : SentinelValueIndicatingUnspecifedSequenceBeginIdx, 1);
+        }
+
+        // the last token of each hypothesis
+        std::vector<size_t> lastTokens;
+        for (const auto& hypothesis : live)
+            lastTokens.push_back(hypothesis.m_tokens.empty() ? options.m_startToken : hypothesis.m_tokens.back());
+        if (tokenMatrix->GetMatrixType() == MatrixType::SPARSE)
+        {
+            std::vector<int> colIndices, rowIndices;
+            std::vector<ElemType> values(numHypotheses, 1);
+            for (size_t s = 0; s < numHypotheses; ++s)
+            {
+                colIndices.push_back((int)s);
+                rowIndices.push_back((int)lastTokens[s]);
+            }
+            colIndices.push_back((int)numHypotheses);
+            tokenMatrix->SetMatrixFromCSCFormat(colIndices.data(), rowIndices.data(), values.data(), values.size(), tokenDim, numHypotheses);
+        }
+        else
+        {
+            std::vector<ElemType> data(tokenDim * numHypotheses, 0);
+            for (size_t s = 0; s < numHypotheses; ++s)
+                data[s * tokenDim + lastTokens[s]] = 1;
+            tokenMatrix->SetValue(tokenDim, numHypotheses, tokenMatrix->GetDeviceId(), data.data(), matrixFlagNormal);
+        }
+
+        // the context, the same for each
+        for (const auto& contextNode : contextNodes)
+        {
+            auto matrix = dynamic_pointer_cast<Matrix<ElemType>>(contextNode.first->ValuePtr());
+            const auto& sample = *contextNode.second;
+            std::vector<ElemType> data;
+            for (size_t s = 0; s < numHypotheses; ++s)
+                data.insert(data.end(), sample.begin(), sample.end());
+            matrix->SetValue(sample.size(), numHypotheses, matrix->GetDeviceId(), data.data(), matrixFlagNormal);
+        }
+
+        if (step > 0)
+        {
+            for (const auto& node : m_recurrentNodes)
+                dynamic_pointer_cast<PastValueNode<ElemType>>(node)->GatherCarriedFrames(parents);
+        }
+
+        ComputationNetwork::BumpEvalTimeStamp(m_inputNodes);
+        this->m_net->ForwardProp(outputNode);
+        auto scores = dynamic_pointer_cast<Matrix<ElemType>>(outputNode->ValuePtr());
+        if (scores->GetNumRows() != numTokens || scores->GetNumCols() != numHypotheses)
+            RuntimeError("BeamSearch: Expected output %ls to have one sample per hypothesis.", outputNode->GetName().c_str());
+
+        // rank the extensions of all hypotheses by their total score, as one column [token + numTokens * hypothesis]
+        std::vector<ElemType> liveScores;
+        for (const auto& hypothesis : live)
+            liveScores.push_back((ElemType)hypothesis.m_score);
+        hypothesisScores.SetValue(1, numHypotheses, deviceId, liveScores.data());
+        totalScores.SetValue(*scores);
+        Matrix<ElemType>::ScaleAndAdd(1, hypothesisScores, totalScores);
+        totalScores.Reshape(numTokens * numHypotheses, 1);
+        int numBest = (int)std::min(options.m_beamWidth, numTokens * numHypotheses);
+        totalScores.VectorMax(bestIndices, bestScores, /*isColWise=*/true, numBest);
+
+        std::vector<ElemType> indices(numBest), values(numBest);
+        ElemType* data = indices.data();
+        size_t numElements = indices.size();
+        bestIndices.CopyToArray(data, numElements);
+        data = values.data();
+        bestScores.CopyToArray(data, numElements);
+
+        std::vector<BeamSearchHypothesis> extended;
+        parents.clear();
+        for (int k = 0; k < numBest; ++k)
+        {
+            size_t parent = (size_t)indices[k] / numTokens;
+            BeamSearchHypothesis hypothesis{ live[parent].m_tokens, (double)values[k] };
+            hypothesis.m_tokens.push_back((size_t)indices[k] % numTokens);
+            if (hypothesis.m_tokens.back() == options.m_endToken)
+                completed.push_back(std::move(hypothesis));
+            else
+            {
+                extended.push_back(std::move(hypothesis));
+                parents.push_back(parent);
+            }
+        }
+        live = std::move(extended);
+    }
+
+    auto byScore = [](const BeamSearchHypothesis& a, const BeamSearchHypothesis& b) { return a.m_score > b.m_score; };
+    std::sort(completed.begin(), completed.end(), byScore);
+    std::sort(live.begin(), live.end(), byScore);
+    hypotheses = std::move(completed);
+    for (size_t k = 0; k < live.size() && hypotheses.size() < options.m_beamWidth; ++k)
+        hypotheses.push_back(std::move(live[k]));
+    if (hypotheses.size() > options.m_beamWidth)
+        hypotheses.resize(options.m_beamWidth);
+}
+
+template <typename ElemType>
+IEvaluateModelExtended<ElemType>* CNTKEvalExtended<ElemType>::CreateSharedEvaluator()
+{
+    if (this->m_net == nullptr)
+        RuntimeError("CreateSharedEvaluator() called before CreateNetwork()");
+
+    auto eval = new CNTKEvalExtended<ElemType>();
+    eval->m_config = this->m_config;
+    eval->m_net = this->m_net->CloneSharingParameters();
+    return eval;
+}
+
 template <typename ElemType>
 void CNTKEvalExtended<ElemType>::Destroy()
 {
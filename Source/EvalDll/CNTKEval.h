@@ -86,6 +86,20 @@ public:
 // ------------------------------------------------------------------------
 // Extended interface
 // ------------------------------------------------------------------------
+
+// state of one stream for ForwardPassStreams(): the frame carried over by each PastValue node, by node name
+template <typename ElemType>
+class CNTKEvalStreamState : public IEvalStreamState
+{
+public:
+    virtual void Destroy() override
+    {
+        delete this;
+    }
+
+    std::map<std::wstring, std::vector<ElemType>> m_carriedFrames; // empty before the first chunk
+};
+
 template <typename ElemType>
 class CNTKEvalExtended : public CNTKEvalBase<ElemType>, public IEvaluateModelExtended<ElemType>
 {
@@ -107,6 +121,16 @@ public:
 
     virtual void ForwardPass(const ValueRefs<ElemType>& inputs, ValueRefs<ElemType>& output, bool resetRNN) override;
 
+    virtual IEvaluateModelExtended<ElemType>* CreateSharedEvaluator() override;
+
+    virtual void ForwardPassBatch(const std::vector<Values<ElemType>>& inputs, std::vector<Values<ElemType>>& outputs) override;
+
+    virtual IEvalStreamState* CreateStreamState() override;
+
+    virtual void ForwardPassStreams(const std::vector<Values<ElemType>>& inputs, std::vector<Values<ElemType>>& outputs, const std::vector<IEvalStreamState*>& states) override;
+
+    virtual void BeamSearch(const Values<ElemType>& contextInputs, const BeamSearchOptions& options, std::vector<BeamSearchHypothesis>& hypotheses) override;
+
     virtual void Destroy() override;
 
     virtual void CreateNetwork(const std::string& networkDescription) override
@@ -125,11 +149,19 @@ private:
     std::shared_ptr<ScopedNetworkOperationMode> m_scopedNetworkOperationMode;
     std::vector<ComputationNodeBasePtr> m_inputNodes;
     StreamMinibatchInputs m_inputMatrices;
+    std::vector<ComputationNodeBasePtr> m_recurrentNodes; // needed for the outputs, see ForwardPassStreams()
     bool m_started;
 
     template<template<typename> class ValueContainer> 
     void ForwardPassT(const std::vector < ValueBuffer<ElemType, ValueContainer> >& inputs,
                       std::vector < ValueBuffer<ElemType, ValueContainer> >& outputs, bool resetRNN);
 
+    // ForwardPassBatch(), with the states of the streams the sequences continue, if any
+    void ForwardPassBatchT(const std::vector<Values<ElemType>>& inputs, std::vector<Values<ElemType>>& outputs,
+                           const std::vector<CNTKEvalStreamState<ElemType>*>* states);
+
+    // fails unless the state of all recurrent nodes can be carried from one call to the next
+    void VerifyStateCanBeCarried(const char* function) const;
+
 };
 } } }
@@ -165,6 +165,121 @@ public:
         }
 };
 
+//
+// A set of native buffers for ForwardPass(), one for every input or output, that is set up once and reused
+// across calls. The buffers are given as native pointers, e.g. to memory from Marshal::AllocHGlobal(), or to
+// arrays that the caller keeps pinned (GCHandle::Alloc(array, GCHandleType::Pinned)) for as long as they are used.
+// ForwardPass() hands them to the native model as they are, without marshalling, copying or allocating.
+//
+template<typename ElemType>
+public ref class NativeValueBuffers : IDisposable
+{
+public:
+    NativeValueBuffers(int count)
+    {
+        if (count < 0)
+        {
+            throw gcnew ArgumentOutOfRangeException("count");
+        }
+
+        m_valueRefs = new Native::ValueRefs<ElemType>(count);
+    }
+
+    ~NativeValueBuffers()
+    {
+        this->!NativeValueBuffers();
+    }
+
+    property int Count
+    {
+        int get() { return (int)Refs().size(); }
+    }
+
+    //
+    // Sets dense data of 'size' elements in a buffer of 'capacity' elements.
+    // For outputs, 'size' is ignored and the model sets the actual size, see GetSize().
+    //
+    void SetDense(int index, IntPtr buffer, int capacity, int size)
+    {
+        auto& vb = At(index);
+        vb.m_buffer.InitFrom(static_cast<ElemType*>(buffer.ToPointer()), capacity, size);
+        vb.m_indices.InitFrom(nullptr, 0, 0);
+        vb.m_colIndices.InitFrom(nullptr, 0, 0);
+    }
+
+    //
+    // Sets sparse data in CSC format, see ValueBuffer: 'numNonZeros' values and row indices,
+    // and 'numColIndices' (number of samples + 1) column indices.
+    //
+    void SetSparse(int index, IntPtr buffer, IntPtr indices, int numNonZeros, IntPtr colIndices, int numColIndices)
+    {
+        auto& vb = At(index);
+        vb.m_buffer.InitFrom(static_cast<ElemType*>(buffer.ToPointer()), numNonZeros, numNonZeros);
+        vb.m_indices.InitFrom(static_cast<int*>(indices.ToPointer()), numNonZeros, numNonZeros);
+        vb.m_colIndices.InitFrom(static_cast<int*>(colIndices.ToPointer()), numColIndices, numColIndices);
+    }
+
+    //
+    // Number of elements used in a buffer, e.g. the actual size of an output after ForwardPass().
+    //
+    int GetSize(int index)
+    {
+        return (int)At(index).m_buffer.m_size;
+    }
+
+internal:
+    Native::ValueRefs<ElemType>& Refs()
+    {
+        if (m_valueRefs == nullptr)
+        {
+            throw gcnew ObjectDisposedException("Object has been disposed.");
+        }
+
+        return *m_valueRefs;
+    }
+
+protected:
+    !NativeValueBuffers()
+    {
+        delete m_valueRefs;
+        m_valueRefs = nullptr;
+    }
+
+private:
+    Native::ValueBuffer<ElemType, Native::VectorRef>& At(int index)
+    {
+        auto& valueRefs = Refs();
+        if (index < 0 || index >= (int)valueRefs.size())
+        {
+            throw gcnew ArgumentOutOfRangeException("index");
+        }
+
+        return valueRefs[index];
+    }
+
+    Native::ValueRefs<ElemType>* m_valueRefs;
+};
+
+/// <summary>Float-specific native value buffers</summary>
+public ref class NativeValueBuffersF : NativeValueBuffers<float>
+{
+public:
+    NativeValueBuffersF(int count)
+        : NativeValueBuffers(count)
+    {
+    }
+};
+
+/// <summary>Double-specific native value buffers</summary>
+public ref class NativeValueBuffersD : NativeValueBuffers<double>
+{
+public:
+    NativeValueBuffersD(int count)
+        : NativeValueBuffers(count)
+    {
+    }
+};
+
 /// Managed wrapper for the native evaluation model
 template<typename ElemType>
 public ref class ModelEvaluationExtended : IDisposable
@@ -326,6 +441,32 @@ public:
         }
     }
 
+    //
+    // Same as above, with inputs and outputs in native buffers that are reused across calls.
+    // The actual output sizes are available from outputs->GetSize() afterwards.
+    //
+    void ForwardPass(NativeValueBuffers<ElemType>^ inputs, NativeValueBuffers<ElemType>^ outputs, bool resetRNN)
+    {
+        if (m_eval == nullptr)
+        {
+            throw gcnew ObjectDisposedException("Object has been disposed.");
+        }
+
+        if (inputs == nullptr || outputs == nullptr)
+        {
+            throw gcnew ArgumentNullException(inputs == nullptr ? "inputs" : "outputs");
+        }
+
+        try
+        {
+            m_eval->ForwardPass(inputs->Refs(), outputs->Refs(), resetRNN);
+        }
+        catch (const exception& ex)
+        {
+            throw GetCustomException(ex);
+        }
+    }
+
     ~ModelEvaluationExtended()
     {
         if (m_eval == nullptr)
@@ -551,6 +692,12 @@ void EmitExtended()
     f.GetOutputSchema();
     f.StartForwardEvaluation(nullptr);
     f.ForwardPass(nullptr, nullptr);
+    f.ForwardPass((NativeValueBuffers<float>^)nullptr, nullptr, true);
+
+    NativeValueBuffersF nbf(0);
+    nbf.SetDense(0, IntPtr::Zero, 0, 0);
+    nbf.SetSparse(0, IntPtr::Zero, IntPtr::Zero, 0, IntPtr::Zero, 0);
+    nbf.GetSize(0);
 
     ModelEvaluationExtendedD d;
     d.CreateNetwork("");
@@ -558,6 +705,12 @@ void EmitExtended()
     d.GetOutputSchema();
     d.StartForwardEvaluation(nullptr);
     d.ForwardPass(nullptr, nullptr);
+    d.ForwardPass((NativeValueBuffers<double>^)nullptr, nullptr, true);
+
+    NativeValueBuffersD nbd(0);
+    nbd.SetDense(0, IntPtr::Zero, 0, 0);
+    nbd.SetSparse(0, IntPtr::Zero, IntPtr::Zero, 0, IntPtr::Zero, 0);
+    nbd.GetSize(0);
 
     VariableSchema sc;
     sc.CreateBuffers<float>();
@@ -94,21 +94,43 @@ protected:
 
     void EnsureCompatible() override
     {
-        if (m_spatial && m_imageLayout == ImageLayoutKind::HWC)
-            InvalidArgument("CNTK batch normalization supports only cudnn(CHW) layout.");
     }
 
     void ForwardCore(const Mat& in, const Mat& scale, const Mat& bias, bool inferenceOnly, double expAvgFactor, double blendFactor, Mat& runMean, Mat& runVariance,
                      Mat& out, double epsilon, Mat& savedMean, Mat& savedInvStdDev) override
     {
+        if (IsSpatialHWC())
+        {
+            // The channel is the innermost dimension, so spatial batch normalization of the [C x W*H] samples is
+            // the non-spatial one of the [C] pixels.
+            size_t numPixels = in.GetNumElements() / scale.GetNumRows();
+            Mat outPixels = out.Reshaped(scale.GetNumRows(), numPixels);
+            in.Reshaped(scale.GetNumRows(), numPixels).BatchNormalizationForward(scale, bias, inferenceOnly, expAvgFactor, blendFactor, runMean, runVariance,
+                                                                                 outPixels, epsilon, savedMean, savedInvStdDev);
+            return;
+        }
         in.BatchNormalizationForward(scale, bias, inferenceOnly, expAvgFactor, blendFactor, runMean, runVariance, out, epsilon, savedMean, savedInvStdDev);
     }
 
     void BackwardCore(const Mat& in, const Mat& srcGrad, Mat& grad, const Mat& scale, double blendFactor, const Mat& savedMean, const Mat& savedInvStdDev,
                       Mat& scaleGrad, Mat& biasGrad) override
     {
+        if (IsSpatialHWC())
+        {
+            size_t numPixels = in.GetNumElements() / scale.GetNumRows();
+            Mat gradPixels = grad.Reshaped(scale.GetNumRows(), numPixels);
+            srcGrad.Reshaped(scale.GetNumRows(), numPixels).BatchNormalizationBackward(in.Reshaped(scale.GetNumRows(), numPixels), gradPixels, scale, blendFactor,
+                                                                                       savedMean, savedInvStdDev, scaleGrad, biasGrad);
+            return;
+        }
         srcGrad.BatchNormalizationBackward(in, grad, scale, blendFactor, savedMean, savedInvStdDev, scaleGrad, biasGrad);
     }
+
+private:
+    bool IsSpatialHWC() const
+    {
+        return m_spatial && m_imageLayout == ImageLayoutKind::HWC;
+    }
 };
 
 template class CntkBatchNormEngine<float>;
@@ -0,0 +1,324 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE.md file in the project root for full licence information.
+//
+#include "stdafx.h"
+
+// AVX-512 exists on x64 only, see BlockHandlerSSE.cpp.
+#if !defined(__aarch64__)
+
+#include <immintrin.h>
+#include <climits>
+
+#include "BlockHandlerAVX512.h"
+#include "BlockMultiplierMatrixUtil.h"
+#include "CPUFeatures.h"
+
+// The VNNI kernels are compiled separately from the others, otherwise the compiler would be free
+// to fuse multiplies and adds of the AVX512BW kernels into VNNI instructions.
+#define BEGIN_AVX512_CODE BEGIN_TARGET_CODE("avx512f,avx512bw")
+#define BEGIN_AVX512VNNI_CODE BEGIN_TARGET_CODE("avx512f,avx512bw,avx512vnni")
+#define END_AVX512_CODE END_TARGET_CODE
+
+namespace Microsoft { namespace MSR { namespace CNTK {
+
+bool BlockHandlerAVX512::IsSupported()
+{
+    return CPUSupportsAVX512();
+}
+
+bool BlockHandlerAVX512::HasVNNI()
+{
+    return CPUSupportsAVX512VNNI();
+}
+
+bool BlockHandlerAVX512VNNI::IsSupported()
+{
+    return CPUSupportsAVX512VNNI();
+}
+
+// The layouts written by BlockMultiplier::RewriteAInBlockOrder and RewriteBInBlockOrder, as in BlockHandlerSSE
+static int RowToColOffsetRewrittenA(int row, int kOffset, int blockSize, int rowsPerBlock, int origCols)
+{
+    int rowIdx = row / rowsPerBlock;
+    int offsetFromBlockBeginning = row % rowsPerBlock;
+    int colIdx = kOffset * rowsPerBlock * blockSize + (offsetFromBlockBeginning * blockSize);
+    return (rowIdx * (origCols / blockSize) * rowsPerBlock * blockSize) + colIdx;
+}
+
+static int RowToColOffsetRewrittenB(int col, int kOffset, int blockSize, int origCols)
+{
+    return (origCols * blockSize * kOffset) + (col * blockSize);
+}
+
+// Blocks of 8 are a single SSE register, the partial sums are kept in __m128i.
+// 8-bit values are widened to 16 bits first.
+template <int Rows>
+static void MultiplyBlocks8x(int currBlock, int startRow, int k, int n, const short* newA, const short* B, __m128i* resultStorage)
+{
+    const short* currA = newA + RowToColOffsetRewrittenA(startRow, currBlock, 8, Rows, k);
+    __m128i a[Rows];
+    for (int r = 0; r < Rows; ++r)
+        a[r] = _mm_loadu_si128((const __m128i*) (currA + r * 8));
+    for (int c = 0; c < n; ++c)
+    {
+        __m128i b = _mm_loadu_si128((const __m128i*) (B + RowToColOffsetRewrittenB(c, currBlock, 8, n)));
+        for (int r = 0; r < Rows; ++r)
+            resultStorage[RowColToOffset(r, c, n)] = _mm_add_epi32(resultStorage[RowColToOffset(r, c, n)], _mm_madd_epi16(a[r], b));
+    }
+}
+
+BEGIN_AVX512_CODE
+
+template <int Rows>
+static void MultiplyBlocks8x(int currBlock, int startRow, int k, int n, const int8_t* newA, const int8_t* B, __m128i* resultStorage)
+{
+    const int8_t* currA = newA + RowToColOffsetRewrittenA(startRow, currBlock, 8, Rows, k);
+    __m128i a[Rows];
+    for (int r = 0; r < Rows; ++r)
+        a[r] = _mm_cvtepi8_epi16(_mm_loadl_epi64((const __m128i*) (currA + r * 8)));
+    for (int c = 0; c < n; ++c)
+    {
+        __m128i b = _mm_cvtepi8_epi16(_mm_loadl_epi64((const __m128i*) (B + RowToColOffsetRewrittenB(c, currBlock, 8, n))));
+        for (int r = 0; r < Rows; ++r)
+            resultStorage[RowColToOffset(r, c, n)] = _mm_add_epi32(resultStorage[RowColToOffset(r, c, n)], _mm_madd_epi16(a[r], b));
+    }
+}
+
+// The block is loaded into (BlockSize + 31) / 32 registers per row, the last one masked if the block is shorter.
+// For each column of B one partial sum per row is added to resultStorage. The 128 handlers do two blocks per call.
+template <int BlockSize, int Rows>
+static void MultiplyBlocks(int currBlock, int startRow, int k, int n, const short* newA, const short* B, int blockCnt, __m512i* resultStorage)
+{
+    const int numVectors = (BlockSize + 31) / 32;
+    const __mmask32 lastMask = (BlockSize % 32 == 0) ? (__mmask32) 0xFFFFFFFF : (__mmask32) ((1u << (BlockSize % 32)) - 1);
+    for (int block = currBlock; block < currBlock + blockCnt; ++block)
+    {
+        const short* currA = newA + RowToColOffsetRewrittenA(startRow, block, BlockSize, Rows, k);
+        __m512i a[Rows][numVectors];
+        for (int r = 0; r < Rows; ++r)
+            for (int v = 0; v < numVectors; ++v)
+                a[r][v] = _mm512_maskz_loadu_epi16(v == numVectors - 1 ? lastMask : (__mmask32) 0xFFFFFFFF, currA + r * BlockSize + v * 32);
+
+        for (int c = 0; c < n; ++c)
+        {
+            const short* currB = B + RowToColOffsetRewrittenB(c, block, BlockSize, n);
+            __m512i b[numVectors];
+            for (int v = 0; v < numVectors; ++v)
+                b[v] = _mm512_maskz_loadu_epi16(v == numVectors - 1 ? lastMask : (__mmask32) 0xFFFFFFFF, currB + v * 32);
+            for (int r = 0; r < Rows; ++r)
+            {
+                __m512i* result = resultStorage + RowColToOffset(r, c, n);
+                __m512i accum = _mm512_loadu_si512(result);
+                for (int v = 0; v < numVectors; ++v)
+                    accum = _mm512_add_epi32(accum, _mm512_madd_epi16(a[r][v], b[v]));
+                _mm512_storeu_si512(result, accum);
+            }
+        }
+    }
+}
+
+int32_t BlockHandlerAVX512::HorizontalAdd(const __m512i* hAddMe)
+{
+    __m512i partialSums = _mm512_loadu_si512(hAddMe);
+    __m512i low = _mm512_cvtepi32_epi64(_mm512_castsi512_si256(partialSums));
+    __m512i high = _mm512_cvtepi32_epi64(_mm512_extracti64x4_epi64(partialSums, 1));
+    long long sum = _mm512_reduce_add_epi64(_mm512_add_epi64(low, high));
+    if (sum > INT_MAX)
+        return INT_MAX;
+    if (sum < INT_MIN)
+        return INT_MIN;
+    return (int32_t) sum;
+}
+
+END_AVX512_CODE
+
+BEGIN_AVX512VNNI_CODE
+
+// Same as MultiplyBlocks, with vpdpwssd
+template <int BlockSize, int Rows>
+static void MultiplyBlocksVNNI(int currBlock, int startRow, int k, int n, const short* newA, const short* B, int blockCnt, __m512i* resultStorage)
+{
+    const int numVectors = (BlockSize + 31) / 32;
+    const __mmask32 lastMask = (BlockSize % 32 == 0) ? (__mmask32) 0xFFFFFFFF : (__mmask32) ((1u << (BlockSize % 32)) - 1);
+    for (int block = currBlock; block < currBlock + blockCnt; ++block)
+    {
+        const short* currA = newA + RowToColOffsetRewrittenA(startRow, block, BlockSize, Rows, k);
+        __m512i a[Rows][numVectors];
+        for (int r = 0; r < Rows; ++r)
+            for (int v = 0; v < numVectors; ++v)
+                a[r][v] = _mm512_maskz_loadu_epi16(v == numVectors - 1 ? lastMask : (__mmask32) 0xFFFFFFFF, currA + r * BlockSize + v * 32);
+
+        for (int c = 0; c < n; ++c)
+        {
+            const short* currB = B + RowToColOffsetRewrittenB(c, block, BlockSize, n);
+            __m512i b[numVectors];
+            for (int v = 0; v < numVectors; ++v)
+                b[v] = _mm512_maskz_loadu_epi16(v == numVectors - 1 ? lastMask : (__mmask32) 0xFFFFFFFF, currB + v * 32);
+            for (int r = 0; r < Rows; ++r)
+            {
+                __m512i* result = resultStorage + RowColToOffset(r, c, n);
+                __m512i accum = _mm512_loadu_si512(result);
+                for (int v = 0; v < numVectors; ++v)
+                    accum = _mm512_dpwssd_epi32(accum, a[r][v], b[v]);
+                _mm512_storeu_si512(result, accum);
+            }
+        }
+    }
+}
+
+// 8-bit version, with vpdpbusd on A + 128, see BlockHandlerAVX512VNNI. The column sums of B are computed
+// with the same instruction, as the products with a vector of ones, and shared by the rows.
+template <int BlockSize, int Rows>
+static void MultiplyBlocksVNNI(int currBlock, int startRow, int k, int n, const int8_t* newA, const int8_t* B, int blockCnt, __m512i* resultStorage)
+{
+    const int numVectors = (BlockSize + 63) / 64;
+    const __mmask64 lastMask = (BlockSize % 64 == 0) ? (__mmask64) ~0ull : (__mmask64) ((1ull << (BlockSize % 64)) - 1);
+    const __m512i signBits = _mm512_set1_epi8((char) 0x80);
+    const __m512i ones = _mm512_set1_epi8(1);
+    for (int block = currBlock; block < currBlock + blockCnt; ++block)
+    {
+        const int8_t* currA = newA + RowToColOffsetRewrittenA(startRow, block, BlockSize, Rows, k);
+        __m512i a[Rows][numVectors];
+        for (int r = 0; r < Rows; ++r)
+            for (int v = 0; v < numVectors; ++v)
+                a[r][v] = _mm512_xor_si512(_mm512_maskz_loadu_epi8(v == numVectors - 1 ? lastMask : (__mmask64) ~0ull, currA + r * BlockSize + v * 64), signBits);
+
+        for (int c = 0; c < n; ++c)
+        {
+            const int8_t* currB = B + RowToColOffsetRewrittenB(c, block, BlockSize, n);
+            __m512i b[numVectors];
+            __m512i columnSums = _mm512_setzero_si512();
+            for (int v = 0; v < numVectors; ++v)
+            {
+                // the masked out elements of B are zero, so the ones of A + 128 there do not matter
+                b[v] = _mm512_maskz_loadu_epi8(v == numVectors - 1 ? lastMask : (__mmask64) ~0ull, currB + v * 64);
+                columnSums = _mm512_dpbusd_epi32(columnSums, ones, b[v]);
+            }
+            __m512i correction = _mm512_slli_epi32(columnSums, 7);
+            for (int r = 0; r < Rows; ++r)
+            {
+                __m512i* result = resultStorage + RowColToOffset(r, c, n);
+                __m512i accum = _mm512_sub_epi32(_mm512_loadu_si512(result), correction);
+                for (int v = 0; v < numVectors; ++v)
+                    accum = _mm512_dpbusd_epi32(accum, a[r][v], b[v]);
+                _mm512_storeu_si512(result, accum);
+            }
+        }
+    }
+}
+
+END_AVX512_CODE
+
+template <int BlockSize, int Rows>
+static void MultiplyBlocks16Bit(int currBlock, int startRow, int k, int n, const short* newA, const short* B, int blockCnt, __m512i* resultStorage)
+{
+    if (BlockHandlerAVX512::HasVNNI())
+        MultiplyBlocksVNNI<BlockSize, Rows>(currBlock, startRow, k, n, newA, B, blockCnt, resultStorage);
+    else
+        MultiplyBlocks<BlockSize, Rows>(currBlock, startRow, k, n, newA, B, blockCnt, resultStorage);
+}
+
+void BlockHandlerAVX512::HandleBlock8x4(int currBlock, int startRow, int k, int n, short* newA, short* B, int /*blockCnt*/, __m128i* resultStorage)
+{
+    MultiplyBlocks8x<4>(currBlock, startRow, k, n, newA, B, resultStorage);
+}
+
+void BlockHandlerAVX512::HandleBlock16x4(int currBlock, int startRow, int k, int n, short* newA, short* B, int blockCnt, VectorT* resultStorage)
+{
+    MultiplyBlocks16Bit<16, 4>(currBlock, startRow, k, n, newA, B, blockCnt, resultStorage);
+}
+
+void BlockHandlerAVX512::HandleBlock32x4(int currBlock, int startRow, int k, int n, short* newA, short* B, int blockCnt, VectorT* resultStorage)
+{
+    MultiplyBlocks16Bit<32, 4>(currBlock, startRow, k, n, newA, B, blockCnt, resultStorage);
+}
+
+void BlockHandlerAVX512::HandleBlock64x4(int currBlock, int startRow, int k, int n, short* newA, short* B, int blockCnt, VectorT* resultStorage)
+{
+    MultiplyBlocks16Bit<64, 4>(currBlock, startRow, k, n, newA, B, blockCnt, resultStorage);
+}
+
+void BlockHandlerAVX512::HandleBlock128x4(int currBlock, int startRow, int k, int n, short* newA, short* B, int blockCnt, VectorT* resultStorage, VectorT* /*subtractMe*/)
+{
+    MultiplyBlocks16Bit<128, 4>(currBlock, startRow, k, n, newA, B, blockCnt, resultStorage);
+}
+
+void BlockHandlerAVX512::HandleBlock8x1(int currBlock, int startRow, int k, int n, short* newA, short* B, int /*blockCnt*/, __m128i* resultStorage)
+{
+    MultiplyBlocks8x<1>(currBlock, startRow, k, n, newA, B, resultStorage);
+}
+
+void BlockHandlerAVX512::HandleBlock16x1(int currBlock, int startRow, int k, int n, short* newA, short* B, int blockCnt, VectorT* resultStorage)
+{
+    MultiplyBlocks16Bit<16, 1>(currBlock, startRow, k, n, newA, B, blockCnt, resultStorage);
+}
+
+void BlockHandlerAVX512::HandleBlock32x1(int currBlock, int startRow, int k, int n, short* newA, short* B, int blockCnt, VectorT* resultStorage)
+{
+    MultiplyBlocks16Bit<32, 1>(currBlock, startRow, k, n, newA, B, blockCnt, resultStorage);
+}
+
+void BlockHandlerAVX512::HandleBlock64x1(int currBlock, int startRow, int k, int n, short* newA, short* B, int blockCnt, VectorT* resultStorage)
+{
+    MultiplyBlocks16Bit<64, 1>(currBlock, startRow, k, n, newA, B, blockCnt, resultStorage);
+}
+
+void BlockHandlerAVX512::HandleBlock128x1(int currBlock, int startRow, int k, int n, short* newA, short* B, int blockCnt, VectorT* resultStorage, VectorT* /*subtractMe*/)
+{
+    MultiplyBlocks16Bit<128, 1>(currBlock, startRow, k, n, newA, B, blockCnt, resultStorage);
+}
+
+void BlockHandlerAVX512VNNI::HandleBlock8x4(int currBlock, int startRow, int k, int n, int8_t* newA, int8_t* B, int /*blockCnt*/, __m128i* resultStorage)
+{
+    MultiplyBlocks8x<4>(currBlock, startRow, k, n, newA, B, resultStorage);
+}
+
+void BlockHandlerAVX512VNNI::HandleBlock16x4(int currBlock, int startRow, int k, int n, int8_t* newA, int8_t* B, int blockCnt, VectorT* resultStorage)
+{
+    MultiplyBlocksVNNI<16, 4>(currBlock, startRow, k, n, newA, B, blockCnt, resultStorage);
+}
+
+void BlockHandlerAVX512VNNI::HandleBlock32x4(int currBlock, int startRow, int k, int n, int8_t* newA, int8_t* B, int blockCnt, VectorT* resultStorage)
+{
+    MultiplyBlocksVNNI<32, 4>(currBlock, startRow, k, n, newA, B, blockCnt, resultStorage);
+}
+
+void BlockHandlerAVX512VNNI::HandleBlock64x4(int currBlock, int startRow, int k, int n, int8_t* newA, int8_t* B, int blockCnt, VectorT* resultStorage)
+{
+    MultiplyBlocksVNNI<64, 4>(currBlock, startRow, k, n, newA, B, blockCnt, resultStorage);
+}
+
+void BlockHandlerAVX512VNNI::HandleBlock128x4(int currBlock, int startRow, int k, int n, int8_t* newA, int8_t* B, int blockCnt, VectorT* resultStorage, VectorT* /*subtractMe*/)
+{
+    MultiplyBlocksVNNI<128, 4>(currBlock, startRow, k, n, newA, B, blockCnt, resultStorage);
+}
+
+void BlockHandlerAVX512VNNI::HandleBlock8x1(int currBlock, int startRow, int k, int n, int8_t* newA, int8_t* B, int /*blockCnt*/, __m128i* resultStorage)
+{
+    MultiplyBlocks8x<1>(currBlock, startRow, k, n, newA, B, resultStorage);
+}
+
+void BlockHandlerAVX512VNNI::HandleBlock16x1(int currBlock, int startRow, int k, int n, int8_t* newA, int8_t* B, int blockCnt, VectorT* resultStorage)
+{
+    MultiplyBlocksVNNI<16, 1>(currBlock, startRow, k, n, newA, B, blockCnt, resultStorage);
+}
+
+void BlockHandlerAVX512VNNI::HandleBlock32x1(int currBlock, int startRow, int k, int n, int8_t* newA, int8_t* B, int blockCnt, VectorT* resultStorage)
+{
+    MultiplyBlocksVNNI<32, 1>(currBlock, startRow, k, n, newA, B, blockCnt, resultStorage);
+}
+
+void BlockHandlerAVX512VNNI::HandleBlock64x1(int currBlock, int startRow, int k, int n, int8_t* newA, int8_t* B, int blockCnt, VectorT* resultStorage)
+{
+    MultiplyBlocksVNNI<64, 1>(currBlock, startRow, k, n, newA, B, blockCnt, resultStorage);
+}
+
+void BlockHandlerAVX512VNNI::HandleBlock128x1(int currBlock, int startRow, int k, int n, int8_t* newA, int8_t* B, int blockCnt, VectorT* resultStorage, VectorT* /*subtractMe*/)
+{
+    MultiplyBlocksVNNI<128, 1>(currBlock, startRow, k, n, newA, B, blockCnt, resultStorage);
+}
+
+}}}
+
+#endif
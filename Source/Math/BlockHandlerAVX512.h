@@ -0,0 +1,111 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE.md file in the project root for full licence information.
+//
+#pragma once
+#include "BlockMultiplierPlatform.h"
+#include <immintrin.h>
+#include <emmintrin.h>
+#include <assert.h>
+#include <cstdint>
+#include "CommonMatrix.h"
+
+namespace Microsoft { namespace MSR { namespace CNTK {
+
+// Block handlers for AVX-512 processors. Unlike BlockHandlerSSE and BlockHandlerAVX the kernels are not
+// inlined into BlockMultiplier: they live in BlockHandlerAVX512.cpp, which is the only place compiled for
+// AVX-512, so the binary still runs on any x64 processor. Only instantiate a BlockMultiplier with these
+// handlers after IsSupported() returned true, e.g. through QuantizedBlockProduct, which picks the widest
+// handler the host supports.
+//
+// The loads are unaligned, so the handlers do not depend on the alignment BlockMultiplier allocates with.
+
+// 16-bit integers, like BlockHandlerSSE, 32 products per instruction. Needs AVX512F and AVX512BW;
+// with AVX512_VNNI the multiply and the accumulation are fused into one instruction (vpdpwssd).
+class MATH_API BlockHandlerAVX512
+{
+    public:
+        typedef __m512i VectorT;
+        typedef int16_t ScalarAT;
+        typedef int16_t ScalarBT;
+        typedef int32_t ScalarCT;
+
+        static bool IsSupported();
+        static bool HasVNNI();
+
+        static void HandleBlock8x4(int currBlock, int startRow, int k, int n, short* newA, short* B, int blockCnt,
+                                   __m128i* resultStorage);
+        static void HandleBlock16x4(int currBlock, int startRow, int k, int n, short* newA, short* B, int blockCnt,
+                                    VectorT* resultStorage);
+        static void HandleBlock32x4(int currBlock, int startRow, int k, int n, short* newA, short* B, int blockCnt,
+                                    VectorT* resultStorage);
+        static void HandleBlock64x4(int currBlock, int startRow, int k, int n, short* newA, short* B, int blockCnt,
+                                    VectorT* resultStorage);
+        static void HandleBlock128x4(int currBlock, int startRow, int k, int n, short* newA, short* B, int blockCnt,
+                                     VectorT* resultStorage, VectorT* subtractMe);
+        static void HandleBlock8x1(int currBlock, int startRow, int k, int n, short* newA, short* B, int blockCnt,
+                                   __m128i* resultStorage);
+        static void HandleBlock16x1(int currBlock, int startRow, int k, int n, short* newA, short* B, int blockCnt,
+                                    VectorT* resultStorage);
+        static void HandleBlock32x1(int currBlock, int startRow, int k, int n, short* newA, short* B, int blockCnt,
+                                    VectorT* resultStorage);
+        static void HandleBlock64x1(int currBlock, int startRow, int k, int n, short* newA, short* B, int blockCnt,
+                                    VectorT* resultStorage);
+        static void HandleBlock128x1(int currBlock, int startRow, int k, int n, short* newA, short* B, int blockCnt,
+                                     VectorT* resultStorage, VectorT* subtractMe);
+
+        // Saturated horizontal add of the 16 partial sums, for BlockMultiplier::my_hadd()
+        static int32_t HorizontalAdd(const VectorT* hAddMe);
+
+        static VectorT* PrepareExtraB(const ScalarBT* prepareMe, int k, int n)
+        {
+            prepareMe;  k; n; //warning re. unreferenced params
+            return nullptr;
+        }
+        static void FreePreparedB(VectorT* freeMe) { freeMe;  assert(nullptr == freeMe); }
+};
+
+// 8-bit integers with AVX512_VNNI, 64 products per instruction (vpdpbusd). vpdpbusd multiplies unsigned
+// bytes of A with signed bytes of B, so the kernels flip the sign bit of A, which adds 128 to every element,
+// and subtract 128 times the sums of the columns of B again. The products are accumulated in 32 bits
+// without saturation.
+class MATH_API BlockHandlerAVX512VNNI
+{
+    public:
+        typedef __m512i VectorT;
+        typedef int8_t ScalarAT;
+        typedef int8_t ScalarBT;
+        typedef int32_t ScalarCT;
+
+        static bool IsSupported();
+
+        static void HandleBlock8x4(int currBlock, int startRow, int k, int n, int8_t* newA, int8_t* B, int blockCnt,
+                                   __m128i* resultStorage);
+        static void HandleBlock16x4(int currBlock, int startRow, int k, int n, int8_t* newA, int8_t* B, int blockCnt,
+                                    VectorT* resultStorage);
+        static void HandleBlock32x4(int currBlock, int startRow, int k, int n, int8_t* newA, int8_t* B, int blockCnt,
+                                    VectorT* resultStorage);
+        static void HandleBlock64x4(int currBlock, int startRow, int k, int n, int8_t* newA, int8_t* B, int blockCnt,
+                                    VectorT* resultStorage);
+        static void HandleBlock128x4(int currBlock, int startRow, int k, int n, int8_t* newA, int8_t* B, int blockCnt,
+                                     VectorT* resultStorage, VectorT* subtractMe);
+        static void HandleBlock8x1(int currBlock, int startRow, int k, int n, int8_t* newA, int8_t* B, int blockCnt,
+                                   __m128i* resultStorage);
+        static void HandleBlock16x1(int currBlock, int startRow, int k, int n, int8_t* newA, int8_t* B, int blockCnt,
+                                    VectorT* resultStorage);
+        static void HandleBlock32x1(int currBlock, int startRow, int k, int n, int8_t* newA, int8_t* B, int blockCnt,
+                                    VectorT* resultStorage);
+        static void HandleBlock64x1(int currBlock, int startRow, int k, int n, int8_t* newA, int8_t* B, int blockCnt,
+                                    VectorT* resultStorage);
+        static void HandleBlock128x1(int currBlock, int startRow, int k, int n, int8_t* newA, int8_t* B, int blockCnt,
+                                     VectorT* resultStorage, VectorT* subtractMe);
+
+        static VectorT* PrepareExtraB(const ScalarBT* prepareMe, int k, int n)
+        {
+            prepareMe;  k; n; //warning re. unreferenced params
+            return nullptr;
+        }
+        static void FreePreparedB(VectorT* freeMe) { freeMe;  assert(nullptr == freeMe); }
+};
+
+}}}
@@ -0,0 +1,82 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE.md file in the project root for full license information.
+//
+// CPUFeatures.cpp -- run-time detection of the instruction sets of the host
+//
+
+#include "stdafx.h"
+#include "CPUFeatures.h"
+#ifdef _MSC_VER
+#include <intrin.h>
+#elif !defined(__aarch64__)
+#include <cpuid.h>
+#endif
+
+namespace Microsoft { namespace MSR { namespace CNTK {
+
+// Checks feature bits of cpuid leaf 1 (ecx) and leaf 7 (ebx, ecx), and that the OS saves the register state in 'xcr0Bits'.
+static bool HostSupports(unsigned int leaf1EcxBits, unsigned int leaf7EbxBits, unsigned int leaf7EcxBits, unsigned long long xcr0Bits)
+{
+#if defined(__aarch64__)
+    return false;
+#else
+    const unsigned int osxsave = 1u << 27;
+    unsigned int eax, ebx, ecx, edx;
+    unsigned long long xcr0;
+#ifdef _MSC_VER
+    int info[4];
+    __cpuid(info, 0);
+    if (info[0] < 7)
+        return false;
+    __cpuid(info, 1);
+    ecx = info[2];
+    if ((ecx & (leaf1EcxBits | osxsave)) != (leaf1EcxBits | osxsave))
+        return false;
+    xcr0 = _xgetbv(0);
+    __cpuidex(info, 7, 0);
+    ebx = info[1];
+    ecx = info[2];
+#else
+    if (__get_cpuid_max(0, nullptr) < 7)
+        return false;
+    __cpuid(1, eax, ebx, ecx, edx);
+    if ((ecx & (leaf1EcxBits | osxsave)) != (leaf1EcxBits | osxsave))
+        return false;
+    unsigned int xcr0Low, xcr0High;
+    __asm__("xgetbv" : "=a"(xcr0Low), "=d"(xcr0High) : "c"(0));
+    xcr0 = ((unsigned long long) xcr0High << 32) | xcr0Low;
+    __cpuid_count(7, 0, eax, ebx, ecx, edx);
+#endif
+    return (xcr0 & xcr0Bits) == xcr0Bits && (ebx & leaf7EbxBits) == leaf7EbxBits && (ecx & leaf7EcxBits) == leaf7EcxBits;
+#endif
+}
+
+static const unsigned int c_cpuid1FMA = 1u << 12;
+static const unsigned int c_cpuid1AVX = 1u << 28;
+static const unsigned int c_cpuid7AVX2 = 1u << 5;
+static const unsigned int c_cpuid7AVX512F = 1u << 16;
+static const unsigned int c_cpuid7AVX512BW = 1u << 30;
+static const unsigned int c_cpuid7AVX512VNNI = 1u << 11;
+static const unsigned long long c_xcr0AVX = 0x6;     // SSE and AVX state
+static const unsigned long long c_xcr0AVX512 = 0xE6; // and opmask, upper halves of ZMM0-15, ZMM16-31
+
+bool CPUSupportsAVX2()
+{
+    static const bool supported = HostSupports(c_cpuid1AVX | c_cpuid1FMA, c_cpuid7AVX2, 0, c_xcr0AVX);
+    return supported;
+}
+
+bool CPUSupportsAVX512()
+{
+    static const bool supported = HostSupports(c_cpuid1AVX | c_cpuid1FMA, c_cpuid7AVX2 | c_cpuid7AVX512F | c_cpuid7AVX512BW, 0, c_xcr0AVX512);
+    return supported;
+}
+
+bool CPUSupportsAVX512VNNI()
+{
+    static const bool supported = CPUSupportsAVX512() && HostSupports(0, 0, c_cpuid7AVX512VNNI, c_xcr0AVX512);
+    return supported;
+}
+
+}}}
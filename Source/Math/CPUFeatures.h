@@ -0,0 +1,39 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE.md file in the project root for full license information.
+//
+// CPUFeatures.h -- run-time detection of the instruction sets of the host
+//
+// The build targets a baseline x64 processor. Kernels for wider instruction sets are compiled for them
+// function by function, between BEGIN_TARGET_CODE("isa,...") and END_TARGET_CODE, and may only be
+// called after the corresponding CPUSupports...() returned true. Such a region must not contain inline
+// functions or templates used elsewhere, so put the headers it needs before it.
+//
+
+#pragma once
+
+#include "CommonMatrix.h" // for MATH_API
+
+namespace Microsoft { namespace MSR { namespace CNTK {
+
+// AVX2 and FMA, and the OS saves the YMM registers
+MATH_API bool CPUSupportsAVX2();
+// AVX512F and AVX512BW, and the OS saves the opmask and ZMM registers
+MATH_API bool CPUSupportsAVX512();
+// AVX512_VNNI in addition
+MATH_API bool CPUSupportsAVX512VNNI();
+
+}}}
+
+// MSVC compiles the intrinsics of any instruction set without flags.
+#define CPU_FEATURES_PRAGMA(x) _Pragma(#x)
+#if defined(__clang__)
+#define BEGIN_TARGET_CODE(isa) CPU_FEATURES_PRAGMA(clang attribute push (__attribute__((target(isa))), apply_to = function))
+#define END_TARGET_CODE _Pragma("clang attribute pop")
+#elif defined(__GNUC__)
+#define BEGIN_TARGET_CODE(isa) _Pragma("GCC push_options") CPU_FEATURES_PRAGMA(GCC target(isa))
+#define END_TARGET_CODE _Pragma("GCC pop_options")
+#else
+#define BEGIN_TARGET_CODE(isa)
+#define END_TARGET_CODE
+#endif
@@ -11,6 +11,10 @@
 
 #include "CPUMatrix.h"
 #include "TensorOps.h"
+#include "CPUTensorKernels.h"
+#include "CPUThreadPool.h"
+#include "PhiloxRNG.h"
+#include "RNNCommon.h"
 #include <assert.h>
 #include <stdexcept>
 #include <omp.h>
@@ -21,6 +25,7 @@
 #include <thread>
 #include <iostream>
 #include <algorithm>
+#include <numeric>
 #pragma warning(push)
 #pragma warning(disable:4244) // 'conversion' conversion from 'type1' to 'type2', possible loss of data
 #include <boost/random/normal_distribution.hpp>
@@ -67,6 +72,7 @@
 namespace Microsoft { namespace MSR { namespace CNTK {
 
 int MATH_API TracingGPUMemoryAllocator::m_traceLevel = 0;
+bool MATH_API TracingGPUMemoryAllocator::m_cachingEnabled = false;
 
 void TracingGPUMemoryAllocator::SetTraceLevel(int traceLevel)
 {
@@ -78,6 +84,16 @@ bool TracingGPUMemoryAllocator::IsTraceEnabled()
     return (m_traceLevel > 0);
 }
 
+void TracingGPUMemoryAllocator::SetCachingEnabled(bool enable)
+{
+    m_cachingEnabled = enable;
+}
+
+bool TracingGPUMemoryAllocator::IsCachingEnabled()
+{
+    return m_cachingEnabled;
+}
+
 #pragma region Helpful Enum Definitions
 enum class MatrixOrder
 {
@@ -683,7 +699,9 @@ CPUMatrix<ElemType>& CPUMatrix<ElemType>::DoScatterColumnsOf(ElemType beta, cons
 
     // pre-scale with beta upfront
     // Scatter may add more than one source column to the same target, so we must pre-scale with beta, and then just keep adding.
-    Scale(beta, us); // if beta is 0, then this will be a memset()
+    // With beta = 1, only the target columns are touched, e.g. for a gradient of a few columns of a large matrix.
+    if (beta != 1)
+        Scale(beta, us); // if beta is 0, then this will be a memset()
 
 #pragma omp parallel for // TODO: Depending in circumstance, it may be more efficient to parallelize over rows.
     foreach_column(jIn, a)
@@ -700,6 +718,62 @@ CPUMatrix<ElemType>& CPUMatrix<ElemType>::DoScatterColumnsOf(ElemType beta, cons
     return *this;
 }
 
+// *this[0,i] = number of non-zero values of sequence i of 'condition', see Matrix::AssignNonZeroCountsOfSequences()
+template <class ElemType>
+CPUMatrix<ElemType>& CPUMatrix<ElemType>::AssignNonZeroCountsOfSequences(const CPUMatrix<ElemType>& condition, size_t conditionStride, const CPUMatrix<ElemType>& sequences)
+{
+    if (condition.GetNumRows() != 1 || sequences.GetNumRows() != 2)
+        InvalidArgument("AssignNonZeroCountsOfSequences: Condition must be a row vector and sequences must have two rows.");
+
+    RequireSize(1, sequences.GetNumCols());
+
+    auto& us = *this;
+#pragma omp parallel for
+    foreach_column(i, sequences)
+    {
+        size_t firstColumn = (size_t)sequences(0, i);
+        size_t numSteps    = (size_t)sequences(1, i);
+        size_t count = 0;
+        for (size_t t = 0; t < numSteps; t++)
+            if (condition(0, firstColumn + t * conditionStride) != 0)
+                count++;
+        us(0, i) = (ElemType)count;
+    }
+
+    return *this;
+}
+
+// *this[0, outputFirstColumns[0,i] + k * outputStride] = time step of the k-th non-zero value of sequence i of 'condition'
+template <class ElemType>
+CPUMatrix<ElemType>& CPUMatrix<ElemType>::DoScatterNonZeroStepsOfSequences(const CPUMatrix<ElemType>& condition, size_t conditionStride, const CPUMatrix<ElemType>& sequences, const CPUMatrix<ElemType>& outputFirstColumns, size_t outputStride)
+{
+    if (condition.GetNumRows() != 1 || sequences.GetNumRows() != 2 || GetNumRows() != 1)
+        InvalidArgument("DoScatterNonZeroStepsOfSequences: Condition and output must be row vectors and sequences must have two rows.");
+    if (outputFirstColumns.GetNumElements() != sequences.GetNumCols())
+        InvalidArgument("DoScatterNonZeroStepsOfSequences: There must be one output column per sequence.");
+
+    auto& us = *this;
+#pragma omp parallel for
+    foreach_column(i, sequences)
+    {
+        size_t firstColumn = (size_t)sequences(0, i);
+        size_t numSteps    = (size_t)sequences(1, i);
+        size_t jOut        = (size_t)outputFirstColumns(0, i);
+        for (size_t t = 0; t < numSteps; t++)
+        {
+            if (condition(0, firstColumn + t * conditionStride) != 0)
+            {
+                if (jOut >= GetNumCols())
+                    InvalidArgument("DoScatterNonZeroStepsOfSequences: Output out of bounds.");
+                us(0, jOut) = (ElemType)t;
+                jOut += outputStride;
+            }
+        }
+    }
+
+    return *this;
+}
+
 template <class ElemType>
 void CPUMatrix<ElemType>::SetValue(const ElemType v)
 {
@@ -766,6 +840,67 @@ void CPUMatrix<ElemType>::MaskColumnsValue(const CPUMatrix<char>& columnsMask, E
     }
 }
 
+// The same as the GPU kernels of GPUMatrix::AssignAugmentedImages().
+template <class ElemType>
+void CPUMatrix<ElemType>::AssignAugmentedImages(const CPUMatrix<char>& images, CPUMatrix<ElemType>& params, const CPUMatrix<ElemType>& mean,
+                                                size_t width, size_t height, size_t channels, bool toCHW)
+{
+    size_t numPixels = width * height;
+    size_t numImages = images.GetNumCols();
+    if (channels == 0 || channels > 4 || images.GetNumRows() < numPixels * channels)
+        InvalidArgument("AssignAugmentedImages: The images must have 1 to 4 channels and fit into the columns.");
+    if (params.GetNumRows() != 3 + channels || params.GetNumCols() != numImages)
+        InvalidArgument("AssignAugmentedImages: There must be %d parameters for each image.", (int) (3 + channels));
+    if (!mean.IsEmpty() && mean.GetNumElements() != numPixels * channels)
+        InvalidArgument("AssignAugmentedImages: The mean must have the dimensions of the images.");
+
+    RequireSize(numPixels * channels, numImages);
+    const ElemType* meanData = mean.IsEmpty() ? nullptr : mean.Data();
+
+#pragma omp parallel for
+    for (long j = 0; j < (long) numImages; j++)
+    {
+        const unsigned char* src = reinterpret_cast<const unsigned char*>(images.Data()) + j * images.GetNumRows();
+        ElemType* p = params.Data() + j * params.GetNumRows();
+        ElemType* dst = Data() + j * GetNumRows();
+
+        double sum = 0;
+        for (size_t i = 0; i < numPixels * channels; i++)
+            sum += src[i];
+        p[1] *= (ElemType) (sum / (numPixels * channels));
+        const ElemType contrast = p[0];
+        const ElemType brightness = p[1];
+        const ElemType saturation = p[2];
+
+        for (size_t pixel = 0; pixel < numPixels; pixel++)
+        {
+            ElemType values[4];
+            for (size_t c = 0; c < channels; c++)
+                values[c] = std::min(std::max(src[pixel * channels + c] * contrast + brightness, (ElemType) 0), (ElemType) 255);
+
+            if (channels == 3 && saturation != 1)
+            {
+                ElemType v = std::max(std::max(values[0], values[1]), values[2]);
+                ElemType s = v > 0 ? (v - std::min(std::min(values[0], values[1]), values[2])) / v : 0;
+                if (s > 0)
+                {
+                    ElemType ratio = std::min(s * saturation, (ElemType) 1) / s;
+                    for (size_t c = 0; c < 3; c++)
+                        values[c] = v - ratio * (v - values[c]);
+                }
+            }
+
+            for (size_t c = 0; c < channels; c++)
+            {
+                ElemType value = std::min(std::max(values[c] + p[3 + c], (ElemType) 0), (ElemType) 255);
+                if (meanData)
+                    value -= meanData[pixel * channels + c];
+                dst[toCHW ? c * numPixels + pixel : pixel * channels + c] = value;
+            }
+        }
+    }
+}
+
 template <class ElemType>
 void CPUMatrix<ElemType>::SetColumn(const ElemType* colPointer, size_t j)
 {
@@ -882,8 +1017,9 @@ void CPUMatrix<ElemType>::SetValue(const size_t numRows, const size_t numCols, E
     // if it's externally managed, then populate the structure
     if (matrixFlags & matrixFlagDontOwnBuffer)
     {
-        // free previous array allocation if any before overwriting
-        delete[] Buffer();
+        // free previous array allocation if any before overwriting (unless it is external as well, e.g. when re-wrapping)
+        if (OwnBuffer())
+            delete[] Buffer();
 
         m_numRows = numRows;
         m_numCols = numCols;
@@ -1092,6 +1228,39 @@ void CPUMatrix<ElemType>::AddGaussianRandomValue(const ElemType mean, const Elem
 
 //maskRate: percentage of values masked out (similar to dropout rate)
 //scaleValue: which scale value to set to the left ones (unmasked items).
+template <class ElemType>
+CPUMatrix<ElemType>& CPUMatrix<ElemType>::DoElementProductOfCounterBasedMask(ElemType beta, const CPUMatrix<ElemType>& a, const ElemType maskRate, const ElemType scaleValue, uint64_t seed, uint64_t offset)
+{
+    if (a.IsEmpty())
+        LogicError("DoElementProductOfCounterBasedMask: Matrix is empty.");
+
+    if (!(a.GetNumRows() == GetNumRows() && a.GetNumCols() == GetNumCols()))
+        InvalidArgument("DoElementProductOfCounterBasedMask: The input matrix dimensions do not match [this].");
+
+    auto& us = *this;
+    long m = (long) GetNumRows(), n = (long) GetNumCols();
+#pragma omp parallel for
+    for (long j = 0; j < n; j++)
+    {
+        // each counter yields the random numbers of four consecutive elements
+        uint32_t random[4];
+        uint64_t counter = UINT64_MAX;
+        for (long i = 0; i < m; i++)
+        {
+            uint64_t index = offset + (uint64_t) j * m + i;
+            if (index / 4 != counter)
+            {
+                counter = index / 4;
+                PhiloxRNG::Generate4(seed, counter, random);
+            }
+            ElemType value = PhiloxRNG::ToUniform(random[index % 4]) <= maskRate ? 0 : a(i, j) * scaleValue;
+            us(i, j) = beta == 0 ? value : beta * us(i, j) + value;
+        }
+    }
+
+    return *this;
+}
+
 template <class ElemType>
 void CPUMatrix<ElemType>::SetUniformRandomMask(const ElemType maskRate, const ElemType scaleValue, RNGHandle& rngHandle)
 {
@@ -1243,6 +1412,50 @@ void CPUMatrix<ElemType>::FSAdagrad(CPUMatrix<ElemType>& gradients,
     }
 }
 
+template <class ElemType>
+void CPUMatrix<ElemType>::Adam(CPUMatrix<ElemType>& gradients,
+                               CPUMatrix<ElemType>& functionValues,
+                               ElemType learnRatePerSample,
+                               ElemType meanMomentum,
+                               ElemType varMomentum,
+                               ElemType meanCorrection,
+                               ElemType varCorrection,
+                               ElemType epsilon,
+                               ElemType weightDecay,
+                               bool updateFunctionValues)
+{
+    size_t numColsNeeded = 2 * gradients.GetNumCols();
+
+    if (IsEmpty() || (GetNumCols() < numColsNeeded))
+    {
+        RequireSize(gradients.GetNumRows(), numColsNeeded);
+        SetValue(0.0);
+    }
+
+    assert((GetNumRows() == gradients.GetNumRows()) && (GetNumCols() == numColsNeeded));
+
+    size_t n = gradients.GetNumElements();
+    ElemType* grad = gradients.Data();
+    ElemType* smoothVar = Data();
+    ElemType* smoothMean = Data() + n;
+    ElemType* val = functionValues.Data();
+#pragma omp parallel for
+    for (long i = 0; i < n; i++)
+    {
+        ElemType g = grad[i];
+        ElemType mean = meanMomentum * smoothMean[i] + (1.0f - meanMomentum) * g;
+        ElemType var = varMomentum * smoothVar[i] + (1.0f - varMomentum) * g * g;
+        smoothMean[i] = mean;
+        smoothVar[i] = var;
+
+        ElemType step = meanCorrection * mean / (sqrt(varCorrection * var) + epsilon) + weightDecay * val[i];
+        if (updateFunctionValues)
+            val[i] -= learnRatePerSample * step;
+        else
+            grad[i] = step;
+    }
+}
+
 template <class ElemType>
 ElemType CPUMatrix<ElemType>::RmsProp(CPUMatrix<ElemType>& gradients,
                                       ElemType RMS_GAMMA,
@@ -3422,12 +3635,12 @@ void CPUMatrix<ElemType>::VectorMax(CPUMatrix<ElemType>& maxIndexes, CPUMatrix<E
             ElemType* curMax       =  maxValues.Data();
             for (int icol = 0; icol < n; icol++, curVal += m, curIdx += topK, curMax += topK)
             {
-                // Partial sort, descending order.
-                std::nth_element(indices.begin(), indices.begin() + topK, indices.end(),
-                                 [curVal](const int& a, const int& b)
-                                 {
-                                     return curVal[a] > curVal[b];
-                                 });
+                // Partial sort, descending order, equal values by the row index like the GPU.
+                std::partial_sort(indices.begin(), indices.begin() + topK, indices.end(),
+                                  [curVal](const int& a, const int& b)
+                                  {
+                                      return curVal[a] > curVal[b] || (curVal[a] == curVal[b] && a < b);
+                                  });
                 // REVIEW alexeyk: the following produces warning (see SCL_SECURE_NO_WARNINGS) so use loop instead.
                 // std::transform(indices.begin(), indices.begin() + topK, curIdx, [](const int& a) { return static_cast<ElemType>(a); });
                 for (int i2 = 0; i2 < topK; i2++)
@@ -3557,6 +3770,265 @@ CPUMatrix<ElemType>& CPUMatrix<ElemType>::AssignNumOfDiff(const CPUMatrix<ElemTy
     return *this;
 }
 
+// whether url j is ranked before url i of the same query: by descending score, with NaN scores last,
+// and ties broken by ascending gain and then by position; must match _lambdaRankPrecedes() of the GPU
+template <class ElemType>
+static bool LambdaRankPrecedes(ElemType scoreJ, ElemType gainJ, size_t j, ElemType scoreI, ElemType gainI, size_t i)
+{
+    bool nanJ = std::isnan(scoreJ), nanI = std::isnan(scoreI);
+    if (nanJ != nanI)
+        return nanI;
+    if (!nanJ && scoreJ != scoreI)
+        return scoreJ > scoreI;
+    if (gainJ != gainI)
+        return gainJ < gainI;
+    return j < i;
+}
+
+// the end of the query of url 'begin', i.e. of the consecutive columns with its query id
+template <class ElemType>
+static size_t LambdaRankQueryEnd(const CPUMatrix<ElemType>& queryIds, size_t begin)
+{
+    int queryId = (int) queryIds(0, begin);
+    size_t end = begin + 1;
+    while (end < queryIds.GetNumCols() && (int) queryIds(0, end) == queryId)
+        end++;
+    return end;
+}
+
+template <class ElemType>
+CPUMatrix<ElemType>& CPUMatrix<ElemType>::AssignLambdaRankMetricOf(const CPUMatrix<ElemType>& gains, const CPUMatrix<ElemType>& scores, const CPUMatrix<ElemType>& queryIds, CPUMatrix<ElemType>& discounts)
+{
+    const size_t n = gains.GetNumCols();
+    if (scores.GetNumCols() != n || queryIds.GetNumCols() != n)
+        InvalidArgument("AssignLambdaRankMetricOf: gains, scores and query ids must have the same number of columns.");
+
+    discounts.RequireSize(1, n);
+    ElemType sum = 0;
+    size_t numQueries = 0;
+    vector<size_t> ranking;
+    for (size_t begin = 0, end; begin < n; begin = end)
+    {
+        end = LambdaRankQueryEnd(queryIds, begin);
+        ranking.resize(end - begin);
+        iota(ranking.begin(), ranking.end(), begin);
+        sort(ranking.begin(), ranking.end(), [&](size_t j, size_t i)
+        {
+            return LambdaRankPrecedes(scores(0, j), gains(0, j), j, scores(0, i), gains(0, i), i);
+        });
+
+        // the urls come in descending order of gain, which is the ideal ranking
+        ElemType idealMetric = 0;
+        ElemType metric = 0;
+        for (size_t rank = 0; rank < ranking.size(); rank++)
+        {
+            ElemType discount = (ElemType) log(2.0 + rank);
+            discounts(0, ranking[rank]) = discount;
+            idealMetric += gains(0, begin + rank) / discount;
+            metric += gains(0, ranking[rank]) / discount;
+        }
+        if (idealMetric != 0)
+            sum += metric / idealMetric;
+        numQueries++;
+    }
+
+    RequireSize(1, 1);
+    (*this)(0, 0) = (1 - sum / numQueries) * 100 * n;
+    return *this;
+}
+
+template <class ElemType>
+CPUMatrix<ElemType>& CPUMatrix<ElemType>::AddLambdaRankGradientOf(ElemType sigma, const CPUMatrix<ElemType>& gains, const CPUMatrix<ElemType>& scores, const CPUMatrix<ElemType>& queryIds, const CPUMatrix<ElemType>& discounts)
+{
+    const size_t n = gains.GetNumCols();
+    if (scores.GetNumCols() != n || queryIds.GetNumCols() != n || discounts.GetNumCols() != n)
+        InvalidArgument("AddLambdaRankGradientOf: gains, scores, query ids and discounts must have the same number of columns.");
+    if (GetNumRows() != 1 || GetNumCols() != n)
+        InvalidArgument("AddLambdaRankGradientOf: the gradient must be a row vector with a column for each url.");
+
+    for (size_t begin = 0, end; begin < n; begin = end)
+    {
+        end = LambdaRankQueryEnd(queryIds, begin);
+        ElemType idealMetric = 0;
+        for (size_t k = begin; k < end; k++)
+            idealMetric += gains(0, k) / (ElemType) log(2.0 + (k - begin));
+        if (idealMetric == 0)
+            continue;
+
+        // pairs of urls where the first has a larger gain, which excludes the urls with the smallest gain, the last one
+        ElemType minGain = gains(0, end - 1);
+        for (size_t i = begin; i < end; i++)
+        {
+            if (!(gains(0, i) > minGain))
+                continue;
+            for (size_t j = i + 1; j < end; j++)
+            {
+                if (abs(gains(0, i) - gains(0, j)) < 0.0000001)
+                    continue;
+
+                // |delta NDCG| * -sigma / (1 + exp(sigma * (si - sj)))
+                ElemType deltaMetric = abs((gains(0, i) - gains(0, j)) * (discounts(0, i) - discounts(0, j)) / (discounts(0, i) * discounts(0, j)) / idealMetric);
+                ElemType lambda = -sigma / (1 + exp(sigma * (scores(0, i) - scores(0, j)))) * deltaMetric;
+                (*this)(0, i) += lambda;
+                (*this)(0, j) -= lambda;
+            }
+        }
+    }
+    return *this;
+}
+
+// column stride of a parameter of AssignGMMLogLikelihoodOf() with 'rows' rows: 0 if all samples share its single column
+template <class ElemType>
+static size_t GMMParameterStride(const char* function, const char* name, const CPUMatrix<ElemType>& parameter, size_t rows, size_t numSamples)
+{
+    if (parameter.GetNumRows() != rows || (parameter.GetNumCols() != 1 && parameter.GetNumCols() != numSamples))
+        InvalidArgument("%s: %s must have %d rows and either one column or a column for each sample.", function, name, (int) rows);
+    return parameter.GetNumCols() == 1 ? 0 : rows;
+}
+
+// log p(x) = log sum_c prior_c N(x; mean_c, stddev_c^2 I), computed for each sample with a running log-sum-exp over the
+// components, whose log-likelihoods are kept in 'posteriors' until the total is known
+template <class ElemType>
+CPUMatrix<ElemType>& CPUMatrix<ElemType>::AssignGMMLogLikelihoodOf(const CPUMatrix<ElemType>& unnormedPriors, const CPUMatrix<ElemType>& means, const CPUMatrix<ElemType>& logStddevs,
+                                                                   const CPUMatrix<ElemType>& features, CPUMatrix<ElemType>& posteriors)
+{
+    const size_t numComponents = unnormedPriors.GetNumRows();
+    const size_t dim = features.GetNumRows();
+    const size_t numSamples = features.GetNumCols();
+    const size_t priorsStride = GMMParameterStride("AssignGMMLogLikelihoodOf", "unnormedPriors", unnormedPriors, numComponents, numSamples);
+    const size_t meansStride = GMMParameterStride("AssignGMMLogLikelihoodOf", "means", means, numComponents * dim, numSamples);
+    const size_t logStddevsStride = GMMParameterStride("AssignGMMLogLikelihoodOf", "logStddevs", logStddevs, numComponents, numSamples);
+
+    RequireSize(1, numSamples);
+    posteriors.RequireSize(numComponents, numSamples);
+    const ElemType logNormalizer = (ElemType) (dim * 0.5 * log(TWO_PI));
+
+#pragma omp parallel for
+    for (long t = 0; t < (long) numSamples; t++)
+    {
+        const ElemType* u = unnormedPriors.Data() + t * priorsStride;
+        const ElemType* mean = means.Data() + t * meansStride;
+        const ElemType* logStddev = logStddevs.Data() + t * logStddevsStride;
+        const ElemType* x = features.Data() + t * dim;
+        ElemType* posterior = posteriors.Data() + t * numComponents;
+
+        // log of the normalizer of softmax(unnormedPriors)
+        ElemType maxU = *std::max_element(u, u + numComponents);
+        ElemType sumU = 0;
+        for (size_t c = 0; c < numComponents; c++)
+            sumU += exp(u[c] - maxU);
+        const ElemType logPriorNormalizer = maxU + log(sumU);
+
+        ElemType maxLL = std::numeric_limits<ElemType>::lowest();
+        ElemType sumLL = 0;
+        for (size_t c = 0; c < numComponents; c++)
+        {
+            ElemType distance = 0;
+            for (size_t d = 0; d < dim; d++)
+            {
+                ElemType diff = x[d] - mean[c * dim + d];
+                distance += diff * diff;
+            }
+            ElemType ll = u[c] - logPriorNormalizer - (ElemType) 0.5 * distance * exp(-2 * logStddev[c]) - dim * logStddev[c] - logNormalizer;
+            posterior[c] = ll;
+            if (ll > maxLL)
+            {
+                sumLL = sumLL * exp(maxLL - ll) + 1;
+                maxLL = ll;
+            }
+            else
+                sumLL += exp(ll - maxLL);
+        }
+
+        const ElemType logLikelihood = maxLL + log(sumLL);
+        Data()[t] = logLikelihood;
+        for (size_t c = 0; c < numComponents; c++)
+            posterior[c] = exp(posterior[c] - logLikelihood);
+    }
+    return *this;
+}
+
+// With g the gradient of the log-likelihood of a sample, whose posteriors are p_c:
+//  - unnormedPriors: g (p_c - prior_c)
+//  - means:          g p_c (x - mean_c) / stddev_c^2
+//  - logStddevs:     g p_c (|x - mean_c|^2 / stddev_c^2 - D)
+//  - features:       -g sum_c p_c (x - mean_c) / stddev_c^2
+template <class ElemType>
+CPUMatrix<ElemType>& CPUMatrix<ElemType>::AddGMMLogLikelihoodGradientOf(size_t inputIndex, const CPUMatrix<ElemType>& gradient, const CPUMatrix<ElemType>& unnormedPriors, const CPUMatrix<ElemType>& means,
+                                                                        const CPUMatrix<ElemType>& logStddevs, const CPUMatrix<ElemType>& features, const CPUMatrix<ElemType>& posteriors)
+{
+    const size_t numComponents = unnormedPriors.GetNumRows();
+    const size_t dim = features.GetNumRows();
+    const size_t numSamples = features.GetNumCols();
+    const size_t priorsStride = GMMParameterStride("AddGMMLogLikelihoodGradientOf", "unnormedPriors", unnormedPriors, numComponents, numSamples);
+    const size_t meansStride = GMMParameterStride("AddGMMLogLikelihoodGradientOf", "means", means, numComponents * dim, numSamples);
+    const size_t logStddevsStride = GMMParameterStride("AddGMMLogLikelihoodGradientOf", "logStddevs", logStddevs, numComponents, numSamples);
+    if (gradient.GetNumElements() != numSamples || posteriors.GetNumRows() != numComponents || posteriors.GetNumCols() != numSamples)
+        InvalidArgument("AddGMMLogLikelihoodGradientOf: gradient and posteriors must have a column for each sample.");
+
+    const CPUMatrix<ElemType>& input = inputIndex == 0 ? unnormedPriors : inputIndex == 1 ? means : inputIndex == 2 ? logStddevs : features;
+    if (inputIndex > 3 || GetNumRows() != input.GetNumRows() || GetNumCols() != input.GetNumCols())
+        InvalidArgument("AddGMMLogLikelihoodGradientOf: the gradient of input %d must have the dimensions of that input.", (int) inputIndex);
+    const size_t gradientStride = GetNumCols() == 1 && numSamples != 1 ? 0 : GetNumRows();
+
+    if (inputIndex == 3)
+    {
+#pragma omp parallel for
+        for (long t = 0; t < (long) numSamples; t++)
+        {
+            for (size_t c = 0; c < numComponents; c++)
+            {
+                const ElemType* mean = means.Data() + t * meansStride + c * dim;
+                const ElemType w = gradient.Data()[t] * posteriors(c, t) * exp(-2 * logStddevs.Data()[t * logStddevsStride + c]);
+                for (size_t d = 0; d < dim; d++)
+                    (*this)(d, t) -= w * (features(d, t) - mean[d]);
+            }
+        }
+        return *this;
+    }
+
+    // the rows of a component are only updated by its own iteration, also when the gradient is summed over the samples
+#pragma omp parallel for
+    for (long c = 0; c < (long) numComponents; c++)
+    {
+        for (size_t t = 0; t < numSamples; t++)
+        {
+            ElemType* result = Data() + t * gradientStride;
+            const ElemType g = gradient.Data()[t] * posteriors(c, t);
+            if (inputIndex == 0)
+            {
+                const ElemType* u = unnormedPriors.Data() + t * priorsStride;
+                ElemType maxU = *std::max_element(u, u + numComponents);
+                ElemType sumU = 0;
+                for (size_t k = 0; k < numComponents; k++)
+                    sumU += exp(u[k] - maxU);
+                result[c] += g - gradient.Data()[t] * exp(u[c] - maxU) / sumU;
+                continue;
+            }
+
+            const ElemType* mean = means.Data() + t * meansStride + c * dim;
+            const ElemType logStddev = logStddevs.Data()[t * logStddevsStride + c];
+            const ElemType invVariance = exp(-2 * logStddev);
+            if (inputIndex == 1)
+            {
+                for (size_t d = 0; d < dim; d++)
+                    result[c * dim + d] += g * invVariance * (features(d, t) - mean[d]);
+            }
+            else
+            {
+                ElemType distance = 0;
+                for (size_t d = 0; d < dim; d++)
+                {
+                    ElemType diff = features(d, t) - mean[d];
+                    distance += diff * diff;
+                }
+                result[c] += g * (distance * invVariance - dim);
+            }
+        }
+    }
+    return *this;
+}
+
 #pragma endregion Member BLAS Functions
 
 #pragma region Other helper Functions
@@ -4347,7 +4819,8 @@ void CPUMatrix<ElemType>::ROIPoolingForward(const size_t numRois, const size_t n
                     {
                         // [W x H x C x R x N]; R = ROIs per image
                         size_t outputIdx = roiIdx * roiOutputSize + outw + outh * pooledWidth + c * pooledHeight * pooledWidth;
-                        size_t maxidx = 0;
+                        // empty bins have no argmax (-1), they get no gradient.
+                        int maxidx = -1;
                         ElemType maxval = isempty ? (ElemType)0 : -FLT_MAX;
                         size_t baseIdx = c * height * width;
 
@@ -4360,7 +4833,7 @@ void CPUMatrix<ElemType>::ROIPoolingForward(const size_t numRois, const size_t n
                                 if (img(baseIdx + dataIdx, 0) > maxval)
                                 {
                                     maxval = img(baseIdx + dataIdx, 0);
-                                    maxidx = dataIdx;
+                                    maxidx = (int)dataIdx;
                                 }
                             }
                         }
@@ -4373,83 +4846,37 @@ void CPUMatrix<ElemType>::ROIPoolingForward(const size_t numRois, const size_t n
     }
 }
 
-// This function loops over locations in the input to the ROIPoolingNode (image locations).
-// It loops over the ROIs corresponding to that image, seeing which ones could contain the current location
-// in their output. For each ROI, it checks the argmax data to see if that ROI indeed chose
-// this pixel location as the maximum. If so, it increments the gradient term for the input location.
+// This function loops over locations in the output of the ROIPoolingNode, and adds their gradient
+// to the input location that the forward pass chose as the maximum (stored in argmax), which costs
+// as much as the forward pass. Images are processed in parallel, so that no two threads write the same gradient.
 template <class ElemType>
 void CPUMatrix<ElemType>::ROIPoolingBackward(const size_t numRois, const size_t numImg, const size_t channels, const size_t width, const size_t height,
-                                             const size_t pooledWidth, const size_t pooledHeight, const CPUMatrix<ElemType>& roiData, CPUMatrix<ElemType>& grad, 
+                                             const size_t pooledWidth, const size_t pooledHeight, const CPUMatrix<ElemType>& /*roiData*/, CPUMatrix<ElemType>& grad, 
                                              CPUMatrix<ElemType>& argmax) const
 {
+    size_t pooledSize = pooledWidth * pooledHeight;
+
     // loop over images in the batch.
 #pragma omp parallel for
-    for (int imgIdx = 0; imgIdx < numImg; imgIdx++) 
+    for (int imgIdx = 0; imgIdx < (int)numImg; imgIdx++) 
     {
-        // ROIs for this image. length 4*numRois;
-        auto rois = roiData.ColumnSlice(imgIdx, 1).Data();
         // gradient values for all ROIs from this image. length numRois*pooledHeight*pooledWidth*channels;
         auto pooledGrad = ColumnSlice(imgIdx, 1).Data();
         auto argmaxCol = argmax.ColumnSlice(imgIdx, 1).Data();
+        auto imgGrad = grad.ColumnSlice(imgIdx, 1).Data();
 
-        // loop over spatial locations in the image.
-#pragma omp parallel for
-        for (int w = 0; w < width; w++) 
+        for (size_t roiN = 0; roiN < numRois; roiN++)
         {
-#pragma omp parallel for
-            for (int h = 0; h < width; h++) 
+            for (size_t c = 0; c < channels; c++)
             {
-                // loop over the ROIs seeing which ones contain this location.
-                for (int roiN = 0; roiN < numRois; roiN++) 
+                // go right up to channel c of the current ROI; argmax is relative to the channel.
+                size_t offset = (roiN * channels + c) * pooledSize;
+                ElemType* channelGrad = imgGrad + c * height * width;
+                for (size_t i = 0; i < pooledSize; i++)
                 {
-                    // each ROI is 4 elements: (x, y, w, h).
-                    int roiOffset = roiN * 4;
-
-                    // ROI data is relative to original image size
-                    size_t roiStartW =     (size_t)round(rois[roiOffset + 0] * width);
-                    size_t roiStartH =     (size_t)round(rois[roiOffset + 1] * height);
-                    size_t roiWidth  = max((size_t)round(rois[roiOffset + 2] * width),  (size_t)1);
-                    size_t roiHeight = max((size_t)round(rois[roiOffset + 3] * height), (size_t)1);
-
-                    // skip this ROI if it doesn't contain the current input location.
-                    const bool inROI = (w >= roiStartW && w < roiStartW + roiWidth &&
-                                        h >= roiStartH && h < roiStartH + roiHeight);
-                    if (!inROI)
-                        continue;
-
-                    ElemType winH = (ElemType)roiHeight / (ElemType)pooledHeight;
-                    ElemType winW = (ElemType)roiWidth  / (ElemType)pooledWidth;
-
-                    // what pooled nodes in the output for this ROI could have pooled this input location?
-                    size_t phstart = (size_t)((h - roiStartH) / winH);
-                    size_t pwstart = (size_t)((w - roiStartW) / winW);
-                    size_t phend   = (size_t)(ceil((h - roiStartH + 1) / winH));
-                    size_t pwend   = (size_t)(ceil((w - roiStartW + 1) / winW));
-
-                    phstart = min(max(phstart, (size_t)0), pooledHeight);
-                    phend   = min(max(phend,   (size_t)0), pooledHeight);
-                    pwstart = min(max(pwstart, (size_t)0), pooledWidth);
-                    pwend   = min(max(pwend,   (size_t)0), pooledWidth);
-
-                    for (size_t c = 0; c < channels; c++) 
-                    {
-                        ElemType gradient = 0;
-                        // [W x H x C x N]
-                        size_t index = w + h*width + c*height*width;
-                        // go right up to channel c of the current ROI.
-                        size_t offset = (roiN * channels + c) * pooledWidth * pooledHeight;
-                        const ElemType* offsetPoolGrad = pooledGrad + offset;
-                        const ElemType* offsetArgmax = argmaxCol + offset;
-                        for (size_t ph = phstart; ph < phend; ph++)
-                        {
-                            for (size_t pw = pwstart; pw < pwend; pw++)
-                            {
-                                if ((size_t)offsetArgmax[ph * pooledWidth + pw] == (w + h * width))
-                                    gradient += offsetPoolGrad[ph * pooledWidth + pw];
-                            }
-                        }
-                        grad(index, imgIdx) = gradient;
-                    }
+                    int maxidx = (int)argmaxCol[offset + i];
+                    if (maxidx >= 0)
+                        channelGrad[maxidx] += pooledGrad[offset + i];
                 }
             }
         }
@@ -4606,6 +5033,179 @@ void CPUMatrix<ElemType>::BatchNormalizationBackward(const CPUMatrix<ElemType>&
     RuntimeError("Batch normalization training on CPU is not yet implemented.");
 }
 
+// Inference of a stack of RNN layers on the CPU, with the parameters in the layout of cuDNN, so that models trained with
+// CuDnnRNN run unchanged:
+//  - first the weights of all layers; for each layer and direction (forward first), the input weights of all gates,
+//    then the recurrent weights of all gates; each gate's matrix is [inputDim x hiddenSize] (column-major)
+//  - then the biases; for each layer and direction, the input biases of all gates, then the recurrent biases
+//  - gate order: lstm input, forget, cell, output; gru reset, update, new
+// The sequences are packed as for cuDNN (see OptimizedRNNStackNode::PackSequencesForCuDNN()): frame t has
+// numSequencesForFrame[t] columns, of the longest sequences first. For each layer and direction, the input projection
+// of all frames is one GEMM. The recurrence then takes one GEMM per frame, followed by the gate functions, which run
+// over the hidden units of one sequence at a time.
+template <class ElemType>
+void CPUMatrix<ElemType>::RNNForward(const CPUMatrix<ElemType>& inputX, const CPUMatrix<ElemType>& paramW, size_t xDim, size_t yDim, const vector<size_t>& numSequencesForFrame,
+                                     const RnnAttributes& rnnAttributes, CPUMatrix<ElemType>& reserve, CPUMatrix<ElemType>& workspace)
+{
+    UNUSED(reserve); // only needed for backprop
+
+    enum class Cell { lstm, gru, relu, tanh };
+    Cell cell = rnnAttributes.m_recurrentOp == L"lstm" ? Cell::lstm :
+                rnnAttributes.m_recurrentOp == L"gru"  ? Cell::gru  :
+                rnnAttributes.m_recurrentOp == L"rnnReLU" ? Cell::relu : Cell::tanh;
+    const size_t numGates = cell == Cell::lstm ? 4 : cell == Cell::gru ? 3 : 1;
+    const size_t hiddenSize = rnnAttributes.m_hiddenSize;
+    const size_t gatesDim = numGates * hiddenSize;
+    const size_t numDirections = rnnAttributes.m_bidirectional ? 2 : 1;
+    const size_t numLayers = rnnAttributes.m_numLayers;
+    const size_t numFrames = numSequencesForFrame.size();
+    const size_t numCols = inputX.GetNumCols();
+
+    if (numLayers == 0)
+        InvalidArgument("RNNForward: Expected at least one layer.");
+    if (yDim != numDirections * hiddenSize)
+        InvalidArgument("RNNForward: Output leading dimension must be twice hidden size for bidirectional networks");
+    if (inputX.GetNumRows() != xDim)
+        InvalidArgument("RNNForward: Expected input of dimension %d, but got %d.", (int)xDim, (int)inputX.GetNumRows());
+    auto numParameters = rnnAttributes.GetNumParameters(xDim);
+    if (paramW.GetNumElements() != numParameters.first * numParameters.second)
+        InvalidArgument("RNN needs %ld parameters, but %ld were allocated", (long)(numParameters.first * numParameters.second), (long)paramW.GetNumElements());
+
+    // the first column of each frame
+    vector<size_t> frameBegin(numFrames + 1, 0);
+    for (size_t t = 0; t < numFrames; t++)
+    {
+        if (t > 0 && numSequencesForFrame[t] > numSequencesForFrame[t - 1])
+            InvalidArgument("RNNForward: The sequences must be sorted by decreasing length.");
+        frameBegin[t + 1] = frameBegin[t] + numSequencesForFrame[t];
+    }
+    if (frameBegin[numFrames] != numCols)
+        InvalidArgument("RNNForward: The frames have %d columns, but the input has %d.", (int)frameBegin[numFrames], (int)numCols);
+    const size_t maxSequences = numFrames > 0 ? numSequencesForFrame[0] : 0;
+
+    RequireSize(yDim, numCols);
+    if (numCols == 0)
+        return;
+
+    // workspace: the input projections [gatesDim x numCols] and the recurrent ones of a frame [gatesDim x maxSequences],
+    // the hidden and cell states [hiddenSize x maxSequences], and the outputs of the layers below the last, alternately
+    size_t numLayerOutputs = std::min(numLayers, (size_t)3) - 1;
+    workspace.RequireSize(gatesDim * (numCols + maxSequences) + 2 * hiddenSize * maxSequences + numLayerOutputs * yDim * numCols, 1);
+    ElemType* pWork = workspace.Data();
+    CPUMatrix<ElemType> inputProjections(gatesDim, numCols, pWork, matrixFlagDontOwnBuffer);
+    pWork += gatesDim * numCols;
+    CPUMatrix<ElemType> recurrentProjections(gatesDim, maxSequences, pWork, matrixFlagDontOwnBuffer);
+    pWork += gatesDim * maxSequences;
+    ElemType* hidden = pWork;
+    pWork += hiddenSize * maxSequences;
+    ElemType* cellState = pWork;
+    pWork += hiddenSize * maxSequences;
+    vector<CPUMatrix<ElemType>> layerOutputs;
+    for (size_t i = 0; i < numLayerOutputs; i++, pWork += yDim * numCols)
+        layerOutputs.push_back(CPUMatrix<ElemType>(yDim, numCols, pWork, matrixFlagDontOwnBuffer));
+
+    auto sigmoid = [](ElemType x) { return (ElemType)1 / (1 + exp(-x)); };
+
+    ElemType* weights = paramW.Data();
+    size_t numWeights = 0;
+    for (size_t layer = 0, inputDim = xDim; layer < numLayers; layer++, inputDim = yDim)
+        numWeights += numDirections * gatesDim * (inputDim + hiddenSize);
+    const ElemType* biases = paramW.Data() + numWeights;
+
+    const CPUMatrix<ElemType>* layerInput = &inputX;
+    for (size_t layer = 0; layer < numLayers; layer++)
+    {
+        const size_t inputDim = layer == 0 ? xDim : yDim;
+        CPUMatrix<ElemType>& layerOutput = layer + 1 == numLayers ? *this : layerOutputs[layer % 2];
+        for (size_t direction = 0; direction < numDirections; direction++)
+        {
+            CPUMatrix<ElemType> inputWeights(inputDim, gatesDim, weights, matrixFlagDontOwnBuffer);
+            weights += inputDim * gatesDim;
+            CPUMatrix<ElemType> recurrentWeights(hiddenSize, gatesDim, weights, matrixFlagDontOwnBuffer);
+            weights += hiddenSize * gatesDim;
+            const ElemType* inputBias = biases;
+            const ElemType* recurrentBias = biases + gatesDim;
+            biases += 2 * gatesDim;
+
+            // the input projection of all frames at once
+            MultiplyAndWeightedAdd(1, inputWeights, true, *layerInput, false, 0, inputProjections);
+
+            memset(hidden, 0, sizeof(ElemType) * hiddenSize * maxSequences);
+            memset(cellState, 0, sizeof(ElemType) * hiddenSize * maxSequences);
+            for (size_t i = 0; i < numFrames; i++)
+            {
+                // backwards, the sequences that end in frame t (the last ones of it) begin
+                size_t t = direction == 0 ? i : numFrames - 1 - i;
+                size_t numSequences = numSequencesForFrame[t];
+                if (direction == 1)
+                {
+                    size_t numContinuing = t + 1 < numFrames ? numSequencesForFrame[t + 1] : 0;
+                    memset(hidden + hiddenSize * numContinuing, 0, sizeof(ElemType) * hiddenSize * (numSequences - numContinuing));
+                    memset(cellState + hiddenSize * numContinuing, 0, sizeof(ElemType) * hiddenSize * (numSequences - numContinuing));
+                }
+
+                CPUMatrix<ElemType> previousHidden(hiddenSize, numSequences, hidden, matrixFlagDontOwnBuffer);
+                CPUMatrix<ElemType> recurrentProjection = recurrentProjections.ColumnSlice(0, numSequences);
+                MultiplyAndWeightedAdd(1, recurrentWeights, true, previousHidden, false, 0, recurrentProjection);
+
+#pragma omp parallel for
+                for (long j = 0; j < (long)numSequences; j++)
+                {
+                    ElemType* x = inputProjections.Data() + (frameBegin[t] + j) * gatesDim;
+                    const ElemType* r = recurrentProjections.Data() + j * gatesDim;
+                    ElemType* h = hidden + j * hiddenSize;
+                    ElemType* c = cellState + j * hiddenSize;
+                    ElemType* y = layerOutput.Data() + (frameBegin[t] + j) * yDim + direction * hiddenSize;
+
+                    // the pre-activations of all gates, in place of the input projection
+                    if (cell != Cell::gru)
+                    {
+                        for (size_t k = 0; k < gatesDim; k++)
+                            x[k] += inputBias[k] + r[k] + recurrentBias[k];
+                    }
+                    else // the new gate applies the reset gate to the recurrent part only
+                    {
+                        for (size_t k = 0; k < 2 * hiddenSize; k++)
+                            x[k] += inputBias[k] + r[k] + recurrentBias[k];
+                        for (size_t k = 2 * hiddenSize; k < gatesDim; k++)
+                            x[k] += inputBias[k];
+                    }
+
+                    switch (cell)
+                    {
+                    case Cell::lstm:
+                        for (size_t k = 0; k < hiddenSize; k++)
+                        {
+                            ElemType in = sigmoid(x[k]), forget = sigmoid(x[hiddenSize + k]), out = sigmoid(x[3 * hiddenSize + k]);
+                            c[k] = forget * c[k] + in * tanh(x[2 * hiddenSize + k]);
+                            h[k] = out * tanh(c[k]);
+                        }
+                        break;
+                    case Cell::gru:
+                        for (size_t k = 0; k < hiddenSize; k++)
+                        {
+                            ElemType reset = sigmoid(x[k]), update = sigmoid(x[hiddenSize + k]);
+                            ElemType candidate = tanh(x[2 * hiddenSize + k] + reset * (r[2 * hiddenSize + k] + recurrentBias[2 * hiddenSize + k]));
+                            h[k] = (1 - update) * candidate + update * h[k];
+                        }
+                        break;
+                    case Cell::relu:
+                        for (size_t k = 0; k < hiddenSize; k++)
+                            h[k] = x[k] > 0 ? x[k] : 0;
+                        break;
+                    case Cell::tanh:
+                        for (size_t k = 0; k < hiddenSize; k++)
+                            h[k] = tanh(x[k]);
+                        break;
+                    }
+                    memcpy(y, h, sizeof(ElemType) * hiddenSize);
+                }
+            }
+        }
+        layerInput = &layerOutput;
+    }
+}
+
 
 #pragma region Static BLAS Functions
 
@@ -4619,7 +5219,8 @@ void CPUMatrix<ElemType>::BatchNormalizationBackward(const CPUMatrix<ElemType>&
 /// <param name="c">Resulting matrix, user is responsible for allocating this</param>
 template <class ElemType>
 void CPUMatrix<ElemType>::MultiplyAndWeightedAdd(ElemType alpha, const CPUMatrix<ElemType>& a, const bool transposeA, const CPUMatrix<ElemType>& b, const bool transposeB,
-                                                 ElemType beta, CPUMatrix<ElemType>& c, shared_ptr<QuantizedMultiplier<ElemType>> pQuantizedMultiplier)
+                                                 ElemType beta, CPUMatrix<ElemType>& c, shared_ptr<QuantizedMultiplier<ElemType>> pQuantizedMultiplier,
+                                                 shared_ptr<PackedGemmMatrix<ElemType>> pPackedA)
 {
     if (a.IsEmpty() || b.IsEmpty())
         return;
@@ -4671,7 +5272,11 @@ void CPUMatrix<ElemType>::MultiplyAndWeightedAdd(ElemType alpha, const CPUMatrix
 
     ldc = (int) c.GetNumRows();
 
-    if (pQuantizedMultiplier == nullptr)
+    if (pQuantizedMultiplier == nullptr && pPackedA && alpha == 1 && pPackedA->Matches(a.Data(), m, k, transposeA))
+    {
+        pPackedA->MultiplyAndWeightedAdd(n, b.Data(), ldb, transposeB, beta, c.Data(), ldc);
+    }
+    else if (pQuantizedMultiplier == nullptr)
     {
         if (sizeof(ElemType) == sizeof(double))
         {
@@ -4693,6 +5298,60 @@ void CPUMatrix<ElemType>::MultiplyAndWeightedAdd(ElemType alpha, const CPUMatrix
     }
 }
 
+template <class ElemType>
+PackedGemmMatrix<ElemType>::PackedGemmMatrix(const ElemType* a, int m, int k, bool transposeA)
+    : m_source(a), m_m(m), m_k(k), m_transposeA(transposeA), m_packed(nullptr), m_sizeInBytes(0)
+{
+#ifdef USE_MKL
+    // the packed layout of A does not depend on the number of columns of B, which is not known yet
+    CBLAS_TRANSPOSE mklTransA = transposeA ? CBLAS_TRANSPOSE::CblasTrans : CBLAS_TRANSPOSE::CblasNoTrans;
+    int lda = transposeA ? k : m;
+    if (sizeof(ElemType) == sizeof(double))
+    {
+        m_sizeInBytes = cblas_dgemm_pack_get_size(CblasAMatrix, m, /*n=*/1, k);
+        m_packed = (ElemType*) mkl_malloc(m_sizeInBytes, 64);
+        if (m_packed)
+            cblas_dgemm_pack(CblasColMajor, CblasAMatrix, mklTransA, m, /*n=*/1, k, /*alpha=*/1.0, reinterpret_cast<const double*>(a), lda, reinterpret_cast<double*>(m_packed));
+    }
+    else
+    {
+        m_sizeInBytes = cblas_sgemm_pack_get_size(CblasAMatrix, m, /*n=*/1, k);
+        m_packed = (ElemType*) mkl_malloc(m_sizeInBytes, 64);
+        if (m_packed)
+            cblas_sgemm_pack(CblasColMajor, CblasAMatrix, mklTransA, m, /*n=*/1, k, /*alpha=*/1.0f, reinterpret_cast<const float*>(a), lda, reinterpret_cast<float*>(m_packed));
+    }
+    if (!m_packed)
+        m_sizeInBytes = 0; // out of memory: the products just don't use it
+#endif
+}
+
+template <class ElemType>
+PackedGemmMatrix<ElemType>::~PackedGemmMatrix()
+{
+#ifdef USE_MKL
+    if (m_packed)
+        mkl_free(m_packed);
+#endif
+}
+
+template <class ElemType>
+void PackedGemmMatrix<ElemType>::MultiplyAndWeightedAdd(int n, const ElemType* b, int ldb, bool transposeB, ElemType beta, ElemType* c, int ldc) const
+{
+    if (!IsPacked())
+        LogicError("PackedGemmMatrix::MultiplyAndWeightedAdd: The matrix is not packed.");
+#ifdef USE_MKL
+    MKL_INT mklTransB = transposeB ? CBLAS_TRANSPOSE::CblasTrans : CBLAS_TRANSPOSE::CblasNoTrans;
+    if (sizeof(ElemType) == sizeof(double))
+        cblas_dgemm_compute(CblasColMajor, CblasPacked, mklTransB, m_m, n, m_k, reinterpret_cast<const double*>(m_packed), /*lda (ignored)=*/m_m,
+                            reinterpret_cast<const double*>(b), ldb, beta, reinterpret_cast<double*>(c), ldc);
+    else
+        cblas_sgemm_compute(CblasColMajor, CblasPacked, mklTransB, m_m, n, m_k, reinterpret_cast<const float*>(m_packed), /*lda (ignored)=*/m_m,
+                            reinterpret_cast<const float*>(b), ldb, beta, reinterpret_cast<float*>(c), ldc);
+#else
+    UNUSED(n); UNUSED(b); UNUSED(ldb); UNUSED(transposeB); UNUSED(beta); UNUSED(c); UNUSED(ldc); // (nothing is packed without MKL)
+#endif
+}
+
 template <class ElemType>
 void CPUMatrix<ElemType>::Multiply1x1AndWeightedAdd(ElemType alpha, const CPUMatrix<ElemType>& a, const CPUMatrix<ElemType>& b,
                                                     ElemType beta, CPUMatrix<ElemType>& c)
@@ -4710,6 +5369,52 @@ void CPUMatrix<ElemType>::Multiply1x1AndWeightedAdd(ElemType alpha, const CPUMat
             c(i, j) = b(i, j) * f + c(i, j) * beta;
 }
 
+// batches of products of up to c_batchGemmMaxParallelSize multiply-adds each are spread over the thread pool, in tasks of
+// at least c_batchGemmMinTaskSize multiply-adds; larger products are computed one after the other with the threads of the BLAS
+static const size_t c_batchGemmMaxParallelSize = 64 * 64 * 64;
+static const size_t c_batchGemmMinTaskSize = 32 * 1024;
+
+/// <summary>Batch of independent matrix products: column j of c = alpha * op(A_j) * op(B_j) + beta * column j of c</summary>
+/// <param name="a">Input matrices, one [m x k] (or [k x m] if transposeA) per column, or a single one for all products</param>
+/// <param name="b">Input matrices, one [k x n] (or [n x k] if transposeB) per column, or a single one for all products</param>
+/// <param name="c">Resulting matrices, one [m x n] per column; user is responsible for allocating this</param>
+template <class ElemType>
+void CPUMatrix<ElemType>::BatchMultiplyAndWeightedAdd(ElemType alpha, const CPUMatrix<ElemType>& a, const bool transposeA, const CPUMatrix<ElemType>& b, const bool transposeB,
+                                                      ElemType beta, CPUMatrix<ElemType>& c, size_t m, size_t n, size_t k)
+{
+    CBLAS_TRANSPOSE mklTransA = transposeA ? CBLAS_TRANSPOSE::CblasTrans : CBLAS_TRANSPOSE::CblasNoTrans;
+    CBLAS_TRANSPOSE mklTransB = transposeB ? CBLAS_TRANSPOSE::CblasTrans : CBLAS_TRANSPOSE::CblasNoTrans;
+    int lda = (int) (transposeA ? k : m);
+    int ldb = (int) (transposeB ? n : k);
+    int ldc = (int) m;
+    size_t strideA = a.GetNumCols() == 1 ? 0 : a.GetNumRows();
+    size_t strideB = b.GetNumCols() == 1 ? 0 : b.GetNumRows();
+    size_t strideC = c.GetNumRows();
+
+    auto multiply = [&](size_t begin, size_t end)
+    {
+        for (size_t j = begin; j < end; j++)
+        {
+            if (sizeof(ElemType) == sizeof(double))
+            {
+                cblas_dgemm((CBLAS_ORDER) (int)MatrixOrder::ColMajor, mklTransA, mklTransB, (int) m, (int) n, (int) k, alpha, reinterpret_cast<double*>(a.Data() + j * strideA), lda,
+                            reinterpret_cast<double*>(b.Data() + j * strideB), ldb, beta, reinterpret_cast<double*>(c.Data() + j * strideC), ldc);
+            }
+            else
+            {
+#pragma warning(suppress : 4244)
+                cblas_sgemm((CBLAS_ORDER) (int)MatrixOrder::ColMajor, mklTransA, mklTransB, (int) m, (int) n, (int) k, alpha, reinterpret_cast<float*>(a.Data() + j * strideA), lda,
+                            reinterpret_cast<float*>(b.Data() + j * strideB), ldb, beta, reinterpret_cast<float*>(c.Data() + j * strideC), ldc);
+            }
+        }
+    };
+    size_t productSize = max(m * n * k, (size_t) 1);
+    if (productSize <= c_batchGemmMaxParallelSize)
+        CPUThreadPool::Instance().ParallelFor(c.GetNumCols(), max((size_t) 1, c_batchGemmMinTaskSize / productSize), multiply);
+    else
+        multiply(0, c.GetNumCols());
+}
+
 /* compute singular value decomposition as
     A = U*SIGMA*VT
     W is used as temp working memory
@@ -5654,6 +6359,100 @@ void CPUMatrix<ElemType>::InnerProductWithShiftNeg(const CPUMatrix<ElemType>& a,
     }
 }
 
+// column of b that row m of the CosDistanceWithNegativeSamples result pairs with column j of a
+static inline size_t CosDistanceWithNegativeSamplesColumn(size_t j, size_t m, size_t shift, size_t n)
+{
+    return m == 0 ? j : (j + shift + m - 1) % n;
+}
+
+template <class ElemType>
+CPUMatrix<ElemType>& CPUMatrix<ElemType>::AssignCosDistanceWithNegativeSamplesOf(const CPUMatrix<ElemType>& a, const CPUMatrix<ElemType>& b, const size_t shift, const size_t negnumber, CPUMatrix<ElemType>& invNormA, CPUMatrix<ElemType>& invNormB)
+{
+    if (a.IsEmpty() || b.IsEmpty())
+        LogicError("AssignCosDistanceWithNegativeSamplesOf: one of the input matrices is empty.");
+
+    const long m = (long) a.GetNumRows();
+    const long n = (long) a.GetNumCols();
+    if (b.GetNumRows() != m || b.GetNumCols() != n)
+        InvalidArgument("AssignCosDistanceWithNegativeSamplesOf: Matrices a and b should have same dimension.");
+
+    auto& us = *this;
+    us.RequireSize(negnumber + 1, n);
+    invNormA.RequireSize(1, n);
+    invNormB.RequireSize(1, n);
+
+    // the norms are computed once per column, then shared by all rows of the result
+#pragma omp parallel for
+    for (long j = 0; j < n; j++)
+    {
+        ElemType sumA = 0, sumB = 0;
+        for (long i = 0; i < m; i++)
+        {
+            sumA += a(i, j) * a(i, j);
+            sumB += b(i, j) * b(i, j);
+        }
+        invNormA(0, j) = 1 / max(sqrt(sumA), (ElemType) EPS_IN_INVERSE);
+        invNormB(0, j) = 1 / max(sqrt(sumB), (ElemType) EPS_IN_INVERSE);
+    }
+
+#pragma omp parallel for
+    for (long j = 0; j < n; j++)
+    {
+        const ElemType* aCol = a.Data() + a.LocateColumn(j);
+        for (size_t k = 0; k <= negnumber; k++)
+        {
+            size_t p = CosDistanceWithNegativeSamplesColumn(j, k, shift, n);
+            const ElemType* bCol = b.Data() + b.LocateColumn(p);
+            ElemType dot = 0;
+            for (long i = 0; i < m; i++)
+                dot += aCol[i] * bCol[i];
+            us(k, j) = dot * invNormA(0, j) * invNormB(0, p);
+        }
+    }
+
+    return *this;
+}
+
+// d cos(x_q, y_p) / d x_q = invNorm(x_q) * invNorm(y_p) * y_p - cos(x_q, y_p) * invNorm(x_q)^2 * x_q
+// Each column q of the input gradient gathers the contributions of all rows of the result it takes part in, so no two columns are written to concurrently.
+template <class ElemType>
+CPUMatrix<ElemType>& CPUMatrix<ElemType>::AddCosDistanceWithNegativeSamplesGradientOf(const CPUMatrix<ElemType>& gradient, const CPUMatrix<ElemType>& value, const CPUMatrix<ElemType>& a, const CPUMatrix<ElemType>& b,
+                                                                                      const CPUMatrix<ElemType>& invNormA, const CPUMatrix<ElemType>& invNormB, const size_t shift, const bool isRightInput)
+{
+    const auto& x     = isRightInput ? b : a; // the input whose gradient this is
+    const auto& y     = isRightInput ? a : b; // its partner
+    const auto& invNormX = isRightInput ? invNormB : invNormA;
+    const auto& invNormY = isRightInput ? invNormA : invNormB;
+
+    const long m = (long) x.GetNumRows();
+    const long n = (long) x.GetNumCols();
+    const size_t numRows = gradient.GetNumRows();
+
+    auto& us = *this;
+#pragma omp parallel for
+    for (long q = 0; q < n; q++)
+    {
+        ElemType selfCoef = 0;
+        for (size_t k = 0; k < numRows; k++)
+        {
+            // partner column p, and the result column j that pairs x(:,q) with y(:,p)
+            size_t s = CosDistanceWithNegativeSamplesColumn(0, k, shift, n);
+            size_t p = isRightInput ? (q + n - s) % n : (q + s) % n;
+            size_t j = isRightInput ? p : q;
+            ElemType g = gradient(k, j);
+            ElemType coef = g * invNormX(0, q) * invNormY(0, p);
+            selfCoef += g * value(k, j);
+            for (long i = 0; i < m; i++)
+                us(i, q) += coef * y(i, p);
+        }
+        selfCoef *= invNormX(0, q) * invNormX(0, q);
+        for (long i = 0; i < m; i++)
+            us(i, q) -= selfCoef * x(i, q);
+    }
+
+    return *this;
+}
+
 template <class ElemType>
 CPUMatrix<ElemType>& CPUMatrix<ElemType>::GetARowByIndex(const CPUMatrix<ElemType>& a, size_t index)
 {
@@ -6004,6 +6803,162 @@ void CPUMatrix<ElemType>::_rcrfTransGrdCompute(size_t i,
         }
     }
 };
+
+// index of the (one-hot) label in column j of lbls, or -1 if the column has none
+template <class ElemType>
+static int RCRFLabelOf(const CPUMatrix<ElemType>& lbls, size_t j)
+{
+    for (size_t k = 0; k < lbls.GetNumRows(); k++)
+        if (lbls(k, j) != 0)
+            return (int) k;
+    return -1;
+}
+
+template <class ElemType>
+void CPUMatrix<ElemType>::RCRFForwardBackward(const CPUMatrix<ElemType>& lbls, const CPUMatrix<ElemType>& pos_scores, const CPUMatrix<ElemType>& pair_scores,
+                                              const std::vector<CRFSequence>& sequences, size_t numParallelSequences,
+                                              CPUMatrix<ElemType>& alpha, CPUMatrix<ElemType>& beta, CPUMatrix<ElemType>& objectives)
+{
+    const int iNumLab = (int) pos_scores.GetNumRows();
+    const size_t S = numParallelSequences;
+
+    alpha.RequireSize(iNumLab, pos_scores.GetNumCols());
+    beta.RequireSize(iNumLab, pos_scores.GetNumCols());
+    objectives.RequireSize(1, sequences.size());
+    alpha.SetValue((ElemType) LZERO); // (gaps)
+    beta.SetValue((ElemType) LZERO);
+
+#pragma omp parallel for
+    for (int i = 0; i < (int) sequences.size(); i++)
+    {
+        const auto& seq = sequences[i];
+        auto col = [&](int t) { return (seq.tBegin + t) * S + seq.s; };
+        const int T = seq.numFrames;
+        const int firstLbl = RCRFLabelOf(lbls, col(0));
+
+        // forward: alpha(k,t) = log sum_j exp(alpha(j,t-1) + pair(k,j)) + pos(k,t); at t=0 we come from the first label
+        for (int t = 0; t < T; t++)
+        {
+            for (int k = 0; k < iNumLab; k++)
+            {
+                ElemType fTmp;
+                if (t == 0)
+                    fTmp = firstLbl >= 0 ? pair_scores(k, firstLbl) : 0;
+                else
+                {
+                    fTmp = (ElemType) LZERO;
+                    for (int j = 0; j < iNumLab; j++)
+                        fTmp = (ElemType) LogAddD(fTmp, alpha(j, col(t - 1)) + pair_scores(k, j));
+                }
+                alpha(k, col(t)) = fTmp + pos_scores(k, col(t));
+            }
+        }
+
+        ElemType logZ = (ElemType) LZERO;
+        for (int k = 0; k < iNumLab; k++)
+            logZ = (ElemType) LogAddD(logZ, alpha(k, col(T - 1)));
+
+        // backward: beta = log posteriors, same recursion as _rcrfBackwardCompute()
+        vector<ElemType> zeta(iNumLab);
+        for (int t = T - 1; t >= 0; t--)
+        {
+            if (t == T - 1)
+            {
+                for (int k = 0; k < iNumLab; k++)
+                    beta(k, col(t)) = alpha(k, col(t)) - logZ;
+                continue;
+            }
+            for (int j = 0; j < iNumLab; j++)
+            {
+                ElemType fSum = (ElemType) LZERO;
+                for (int m = 0; m < iNumLab; m++)
+                    fSum = (ElemType) LogAddD(fSum, alpha(m, col(t)) + pair_scores(j, m));
+                zeta[j] = fSum;
+            }
+            for (int k = 0; k < iNumLab; k++)
+            {
+                ElemType fTmp = (ElemType) LZERO;
+                for (int j = 0; j < iNumLab; j++)
+                    fTmp = (ElemType) LogAddD(fTmp, beta(j, col(t + 1)) + alpha(k, col(t)) + pair_scores(j, k) - zeta[j]);
+                beta(k, col(t)) = fTmp;
+            }
+        }
+
+        // score of the labeled path, reduced by the scores of all paths
+        ElemType pathScore = 0;
+        int prevLbl = -1;
+        for (int t = 0; t < T; t++)
+        {
+            int lbl = RCRFLabelOf(lbls, col(t));
+            if (lbl >= 0)
+                pathScore += pos_scores(lbl, col(t));
+            if (lbl >= 0 && prevLbl >= 0)
+                pathScore += pair_scores(lbl, prevLbl);
+            prevLbl = lbl;
+        }
+        objectives(0, i) = logZ - pathScore;
+    }
+}
+
+template <class ElemType>
+void CPUMatrix<ElemType>::RCRFViterbiDecode(const CPUMatrix<ElemType>& lbls, const CPUMatrix<ElemType>& pos_scores, const CPUMatrix<ElemType>& pair_scores,
+                                            const std::vector<CRFSequence>& sequences, size_t numParallelSequences,
+                                            CPUMatrix<ElemType>& decodedPath)
+{
+    const int iNumLab = (int) pos_scores.GetNumRows();
+    const size_t S = numParallelSequences;
+
+    decodedPath.RequireSize(iNumLab, pos_scores.GetNumCols());
+    decodedPath.SetValue(0);
+
+#pragma omp parallel for
+    for (int i = 0; i < (int) sequences.size(); i++)
+    {
+        const auto& seq = sequences[i];
+        auto col = [&](int t) { return (seq.tBegin + t) * S + seq.s; };
+        const int T = seq.numFrames;
+        const int firstLbl = RCRFLabelOf(lbls, col(0));
+        const int lastLbl = RCRFLabelOf(lbls, col(T - 1));
+
+        vector<ElemType> delta(iNumLab), prevDelta(iNumLab);
+        vector<int> backtrace((size_t) iNumLab * T);
+        for (int t = 0; t < T; t++)
+        {
+            for (int k = 0; k < iNumLab; k++)
+            {
+                ElemType fMax = (ElemType) LZERO;
+                int iMax = firstLbl;
+                if (t == 0)
+                    fMax = (firstLbl < 0 || k == firstLbl) ? 0 : (ElemType) LZERO;
+                else
+                {
+                    for (int j = 0; j < iNumLab; j++)
+                    {
+                        ElemType fTmp = prevDelta[j] + pair_scores(k, j);
+                        if (j == 0 || fTmp > fMax)
+                        {
+                            fMax = fTmp;
+                            iMax = j;
+                        }
+                    }
+                }
+                delta[k] = fMax + pos_scores(k, col(t));
+                backtrace[(size_t) t * iNumLab + k] = iMax;
+            }
+            swap(delta, prevDelta);
+        }
+
+        int lbl = lastLbl;
+        if (lbl < 0) // unconstrained end: best final score
+            lbl = (int) (max_element(prevDelta.begin(), prevDelta.end()) - prevDelta.begin());
+        for (int t = T - 1; t >= 0; t--)
+        {
+            decodedPath(lbl, col(t)) = 1;
+            lbl = backtrace[(size_t) t * iNumLab + lbl];
+        }
+    }
+}
+
 template <class ElemType>
 CPUMatrix<ElemType>& CPUMatrix<ElemType>::DropFrame(const CPUMatrix<ElemType>& label, const CPUMatrix<ElemType>& gamma, const ElemType& threshhold)
 {
@@ -6069,6 +7024,8 @@ int CPUMatrix<ElemType>::SetNumThreads(int numThreads)
         openblas_set_num_threads(numThreads);
     #endif
 #endif
+    // the parallel loops of the CPU ops, the readers and the evaluation
+    CPUThreadPool::Instance().SetNumThreads(numThreads);
     return numThreads;
 }
 
@@ -6147,6 +7104,9 @@ struct TensorOpReduction<ElemType, OPFN, ReductionOp, N, -1>
 // perform loop over regular index k for N-nary operations (N counting the output)
 // -----------------------------------------------------------------------
 
+// Elements per thread below which the parallel loops run serially; the kernels of CPUTensorKernels.h have their own.
+static const size_t c_tensorOpMinGrain = 8192;
+
 // perform loop over regular index k and reducing index m for N operands (counting the output)
 template <class ElemType, typename OPFN, typename ReductionOp, size_t N, bool vectorizable, int m, int k>
 struct TensorOpIteration
@@ -6184,21 +7144,19 @@ struct TensorOpIteration<ElemType, OPFN, ReductionOp, 3, true /*vectorizable*/,
         ElemType* pc = pointers[2];
         size_t K = regularOpDims[0];
         // special-case beta and alpha to allow the compiler to short-circuit it
-        if (beta != 0)
-#pragma omp parallel for
-            for (int k = 0; k < (int) K; k++)
-                TensorOpIteration<ElemType, OPFN, ReductionOp, 3, true /*vectorizable*/, -1 /*no reduction*/, -1 /*scalar*/>::Loop(beta, array<ElemType*, 3>{pa + k, pb + k, pc + k}, alpha, opfn, reductionOp, regularOpDims, regularStrides, reducingOpDims, reducingStrides);
-        else if (alpha != 1)
-#pragma omp parallel for
-            for (int k = 0; k < (int) K; k++)
-                TensorOpIteration<ElemType, OPFN, ReductionOp, 3, true /*vectorizable*/, -1 /*no reduction*/, -1 /*scalar*/>::Loop(0, array<ElemType*, 3>{pa + k, pb + k, pc + k}, alpha, opfn, reductionOp, regularOpDims, regularStrides, reducingOpDims, reducingStrides);
-        else
-#pragma omp parallel for
-            for (int k = 0; k < (int) K; k++)
-                TensorOpIteration<ElemType, OPFN, ReductionOp, 3, true /*vectorizable*/, -1 /*no reduction*/, -1 /*scalar*/>::Loop(0, array<ElemType*, 3>{pa + k, pb + k, pc + k}, 1, opfn, reductionOp, regularOpDims, regularStrides, reducingOpDims, reducingStrides);
+        CPUThreadPool::Instance().ParallelFor(K, c_tensorOpMinGrain, [&](size_t begin, size_t end)
+        {
+            if (beta != 0)
+                for (size_t k = begin; k < end; k++)
+                    TensorOpIteration<ElemType, OPFN, ReductionOp, 3, true /*vectorizable*/, -1 /*no reduction*/, -1 /*scalar*/>::Loop(beta, array<ElemType*, 3>{pa + k, pb + k, pc + k}, alpha, opfn, reductionOp, regularOpDims, regularStrides, reducingOpDims, reducingStrides);
+            else if (alpha != 1)
+                for (size_t k = begin; k < end; k++)
+                    TensorOpIteration<ElemType, OPFN, ReductionOp, 3, true /*vectorizable*/, -1 /*no reduction*/, -1 /*scalar*/>::Loop(0, array<ElemType*, 3>{pa + k, pb + k, pc + k}, alpha, opfn, reductionOp, regularOpDims, regularStrides, reducingOpDims, reducingStrides);
+            else
+                for (size_t k = begin; k < end; k++)
+                    TensorOpIteration<ElemType, OPFN, ReductionOp, 3, true /*vectorizable*/, -1 /*no reduction*/, -1 /*scalar*/>::Loop(0, array<ElemType*, 3>{pa + k, pb + k, pc + k}, 1, opfn, reductionOp, regularOpDims, regularStrides, reducingOpDims, reducingStrides);
+        });
         // TODO: According to Amit, the VS compiler is not able to vectorize into lambdas. Solution: change the lambda to take an N, or to implement the loop inside (with 1 element by default).
-        // TODO: The signedness of k (required for omp) causes an extra sign-extend.
-        // TODO: OMP adds LOTS of overhead. Do we need a guard, a min size when to use it?
     }
 };
 // and unary
@@ -6213,18 +7171,18 @@ struct TensorOpIteration<ElemType, OPFN, ReductionOp, 2, true /*vectorizable*/,
         ElemType* pb = pointers[1];
         size_t K = regularOpDims[0];
         // special-case beta and alpha to allow the compiler to short-circuit it
-        if (beta != 0)
-#pragma omp parallel for
-            for (int k = 0; k < (int) K; k++)
-                TensorOpIteration<ElemType, OPFN, ReductionOp, 2, true /*vectorizable*/, -1 /*no reduction*/, -1 /*scalar*/>::Loop(beta, array<ElemType*, 2>{pa + k, pb + k}, alpha, opfn, reductionOp, regularOpDims, regularStrides, reducingOpDims, reducingStrides);
-        else if (alpha != 1)
-#pragma omp parallel for
-            for (int k = 0; k < (int) K; k++)
-                TensorOpIteration<ElemType, OPFN, ReductionOp, 2, true /*vectorizable*/, -1 /*no reduction*/, -1 /*scalar*/>::Loop(0, array<ElemType*, 2>{pa + k, pb + k}, alpha, opfn, reductionOp, regularOpDims, regularStrides, reducingOpDims, reducingStrides);
-        else
-#pragma omp parallel for
-            for (int k = 0; k < (int) K; k++)
-                TensorOpIteration<ElemType, OPFN, ReductionOp, 2, true /*vectorizable*/, -1 /*no reduction*/, -1 /*scalar*/>::Loop(0, array<ElemType*, 2>{pa + k, pb + k}, 1, opfn, reductionOp, regularOpDims, regularStrides, reducingOpDims, reducingStrides);
+        CPUThreadPool::Instance().ParallelFor(K, c_tensorOpMinGrain, [&](size_t begin, size_t end)
+        {
+            if (beta != 0)
+                for (size_t k = begin; k < end; k++)
+                    TensorOpIteration<ElemType, OPFN, ReductionOp, 2, true /*vectorizable*/, -1 /*no reduction*/, -1 /*scalar*/>::Loop(beta, array<ElemType*, 2>{pa + k, pb + k}, alpha, opfn, reductionOp, regularOpDims, regularStrides, reducingOpDims, reducingStrides);
+            else if (alpha != 1)
+                for (size_t k = begin; k < end; k++)
+                    TensorOpIteration<ElemType, OPFN, ReductionOp, 2, true /*vectorizable*/, -1 /*no reduction*/, -1 /*scalar*/>::Loop(0, array<ElemType*, 2>{pa + k, pb + k}, alpha, opfn, reductionOp, regularOpDims, regularStrides, reducingOpDims, reducingStrides);
+            else
+                for (size_t k = begin; k < end; k++)
+                    TensorOpIteration<ElemType, OPFN, ReductionOp, 2, true /*vectorizable*/, -1 /*no reduction*/, -1 /*scalar*/>::Loop(0, array<ElemType*, 2>{pa + k, pb + k}, 1, opfn, reductionOp, regularOpDims, regularStrides, reducingOpDims, reducingStrides);
+        });
     }
 };
 
@@ -6343,6 +7301,154 @@ static void TensorOpWithFn(ElemType beta, array<ElemType*, N> pointers, ElemType
     }
 }
 
+// -----------------------------------------------------------------------
+// vectorized kernels for float, see CPUTensorKernels.h
+// -----------------------------------------------------------------------
+
+// Elements per thread below which the kernels run serially. The ops that compute exp() cost some 10 times more.
+static size_t TensorKernelMinGrain(ElementWiseOperator op)
+{
+    switch (op)
+    {
+    case ElementWiseOperator::opSigmoid:
+    case ElementWiseOperator::opTanh:
+    case ElementWiseOperator::opExp:
+    case ElementWiseOperator::opFastSigmoid:
+    case ElementWiseOperator::opFastTanh:
+    case ElementWiseOperator::opFastExp:
+    case ElementWiseOperator::opFastLog:
+    case ElementWiseOperator::opElementwiseProductWithLogDerivativeFromOutput:
+    case ElementWiseOperator::opElementwiseProductWithLogSumDerivative:
+    case ElementWiseOperator::opElementwiseProductWithExpOfDiff:
+    case ElementWiseOperator::opLogSum: // as reduction
+        return 4096;
+    default:
+        return 32768;
+    }
+}
+
+static CPUUnaryTensorKernel GetTensorKernel(const CPUTensorKernels& kernels, ElementWiseOperator op, const array<float*, 2>&) { return kernels.Unary(op); }
+static CPUBinaryTensorKernel GetTensorKernel(const CPUTensorKernels& kernels, ElementWiseOperator op, const array<float*, 3>&) { return kernels.Binary(op); }
+static CPUTernaryTensorKernel GetTensorKernel(const CPUTensorKernels& kernels, ElementWiseOperator op, const array<float*, 4>&) { return kernels.Ternary(op); }
+
+static void CallTensorKernel(CPUUnaryTensorKernel kernel, const array<float*, 2>& pointers, size_t n, float alpha, float beta)
+{
+    kernel(pointers[0], pointers[1], n, alpha, beta);
+}
+static void CallTensorKernel(CPUBinaryTensorKernel kernel, const array<float*, 3>& pointers, size_t n, float alpha, float beta)
+{
+    kernel(pointers[0], pointers[1], pointers[2], n, alpha, beta);
+}
+static void CallTensorKernel(CPUTernaryTensorKernel kernel, const array<float*, 4>& pointers, size_t n, float alpha, float beta)
+{
+    kernel(pointers[0], pointers[1], pointers[2], pointers[3], n, alpha, beta);
+}
+
+// Elementwise op over one or two regular dimensions, the first contiguous in all operands. Two dimensions
+// cover broadcasting along the second one, e.g. adding a bias to every column.
+template <size_t N>
+static bool TensorOpWithElementwiseKernel(float beta, const array<float*, N>& pointers, float alpha, ElementWiseOperator op,
+                                          const SmallVector<size_t>& regularOpDims, const array<SmallVector<ptrdiff_t>, N>& regularStrides)
+{
+    if (regularOpDims.size() < 1 || regularOpDims.size() > 2)
+        return false;
+    for (size_t i = 0; i < N; i++)
+        if (regularStrides[i][0] != 1)
+            return false;
+    auto kernel = GetTensorKernel(CPUTensorKernels::Get(), op, pointers);
+    if (!kernel)
+        return false;
+
+    // the ranges of the thread pool run over the rows one after the other
+    size_t rowLength = regularOpDims[0];
+    size_t numRows = regularOpDims.size() > 1 ? regularOpDims[1] : 1;
+    CPUThreadPool::Instance().ParallelFor(rowLength * numRows, TensorKernelMinGrain(op), [&](size_t begin, size_t end)
+    {
+        while (begin < end)
+        {
+            size_t row = begin / rowLength;
+            size_t column = begin % rowLength;
+            size_t length = min(end - begin, rowLength - column);
+            array<float*, N> rowPointers;
+            for (size_t i = 0; i < N; i++)
+                rowPointers[i] = pointers[i] + (numRows > 1 ? (ptrdiff_t) row * regularStrides[i][1] : 0) + column;
+            CallTensorKernel(kernel, rowPointers, length, alpha, beta);
+            begin += length;
+        }
+    });
+    return true;
+}
+
+// Reduction over one contiguous dimension without an elementwise op, e.g. the sum or the log-sum of every column.
+static bool TensorOpWithReductionKernel(float beta, const array<float*, 2>& pointers, float alpha, ElementWiseOperator op, ElementWiseOperator reductionOp,
+                                        const SmallVector<size_t>& regularOpDims, const array<SmallVector<ptrdiff_t>, 2>& regularStrides,
+                                        const SmallVector<size_t>& reducingOpDims, const array<SmallVector<ptrdiff_t>, 2>& reducingStrides)
+{
+    if (op != ElementWiseOperator::opCopy || reducingOpDims.size() != 1 || reducingStrides[0][0] != 1 || regularOpDims.size() > 1)
+        return false;
+    auto kernel = CPUTensorKernels::Get().Reduction(reductionOp);
+    if (!kernel)
+        return false;
+
+    size_t reductionLength = reducingOpDims[0];
+    size_t numOutputs = regularOpDims.empty() ? 1 : regularOpDims[0];
+    ptrdiff_t inputStride = regularOpDims.empty() ? 0 : regularStrides[0][0];
+    ptrdiff_t outputStride = regularOpDims.empty() ? 0 : regularStrides[1][0];
+    size_t minGrain = max((size_t) 1, TensorKernelMinGrain(reductionOp) / reductionLength);
+    CPUThreadPool::Instance().ParallelFor(numOutputs, minGrain, [&](size_t begin, size_t end)
+    {
+        for (size_t j = begin; j < end; j++)
+        {
+            // same scaling and rounding as the m = -1 case of TensorOpIteration
+            float val = (float) kernel(pointers[0] + (ptrdiff_t) j * inputStride, reductionLength);
+            val *= alpha;
+            float* pout = pointers[1] + (ptrdiff_t) j * outputStride;
+            if (beta != 0)
+                val += beta * *pout;
+            *pout = val;
+        }
+    });
+    return true;
+}
+
+// binary and ternary reductions are left to the generic loops
+static bool TensorOpWithReductionKernel(float, const array<float*, 3>&, float, ElementWiseOperator, ElementWiseOperator,
+                                        const SmallVector<size_t>&, const array<SmallVector<ptrdiff_t>, 3>&,
+                                        const SmallVector<size_t>&, const array<SmallVector<ptrdiff_t>, 3>&)
+{
+    return false;
+}
+static bool TensorOpWithReductionKernel(float, const array<float*, 4>&, float, ElementWiseOperator, ElementWiseOperator,
+                                        const SmallVector<size_t>&, const array<SmallVector<ptrdiff_t>, 4>&,
+                                        const SmallVector<size_t>&, const array<SmallVector<ptrdiff_t>, 4>&)
+{
+    return false;
+}
+
+// Runs the op with a vectorized kernel if there is one for it and the layout of the tensors, else returns false.
+// Only float has kernels; the generic loops compute everything else.
+template <class ElemType, size_t N>
+static bool TensorOpWithKernel(ElemType, const array<ElemType*, N>&, ElemType, ElementWiseOperator, ElementWiseOperator,
+                               const array<size_t, N>&,
+                               const SmallVector<size_t>&, const array<SmallVector<ptrdiff_t>, N>&,
+                               const SmallVector<size_t>&, const array<SmallVector<ptrdiff_t>, N>&)
+{
+    return false;
+}
+
+template <size_t N>
+static bool TensorOpWithKernel(float beta, array<float*, N> pointers, float alpha, ElementWiseOperator op, ElementWiseOperator reductionOp,
+                               const array<size_t, N>& offsets,
+                               const SmallVector<size_t>& regularOpDims, const array<SmallVector<ptrdiff_t>, N>& regularStrides,
+                               const SmallVector<size_t>& reducingOpDims, const array<SmallVector<ptrdiff_t>, N>& reducingStrides)
+{
+    for (size_t i = 0; i < N; i++)
+        pointers[i] += offsets[i];
+    if (reducingOpDims.empty())
+        return TensorOpWithElementwiseKernel(beta, pointers, alpha, op, regularOpDims, regularStrides);
+    return TensorOpWithReductionKernel(beta, pointers, alpha, op, reductionOp, regularOpDims, regularStrides, reducingOpDims, reducingStrides);
+}
+
 // -----------------------------------------------------------------------
 // entry points from Matrix.cpp; also map op to a lambda
 // -----------------------------------------------------------------------
@@ -6371,6 +7477,8 @@ void CPUMatrix<ElemType>::TensorOp(ElemType beta, const CPUMatrix<ElemType>& a,
                               reductionOp, offsets, regularOpDims, regularStrides, reducingOpDims, reducingStrides)
 
     array<ElemType*, 2> pointers = {a.Data(), Data()};
+    if (TensorOpWithKernel(beta, pointers, alpha, op, reductionOp, offsets, regularOpDims, regularStrides, reducingOpDims, reducingStrides))
+        return;
     switch (op)
     {
         ForAllUnaryOps(CaseUnaryTensorOp);
@@ -6399,6 +7507,8 @@ void CPUMatrix<ElemType>::TensorOp(ElemType beta, const CPUMatrix<ElemType>& a,
                               reductionOp, offsets, regularOpDims, regularStrides, reducingOpDims, reducingStrides)
 
     array<ElemType*, 3> pointers = {a.Data(), b.Data(), Data()};
+    if (TensorOpWithKernel(beta, pointers, alpha, op, reductionOp, offsets, regularOpDims, regularStrides, reducingOpDims, reducingStrides))
+        return;
     switch (op)
     {
         ForAllBinaryOps(CaseBinaryTensorOp);
@@ -6427,6 +7537,8 @@ void CPUMatrix<ElemType>::TensorOp(ElemType beta, const CPUMatrix<ElemType>& a,
                               reductionOp, offsets, regularOpDims, regularStrides, reducingOpDims, reducingStrides)
 
     array<ElemType*, 4> pointers = {a.Data(), b.Data(), c.Data(), Data()};
+    if (TensorOpWithKernel(beta, pointers, alpha, op, reductionOp, offsets, regularOpDims, regularStrides, reducingOpDims, reducingStrides))
+        return;
     switch (op)
     {
         ForAllTernaryOps(CaseTernaryTensorOp);
@@ -6435,11 +7547,148 @@ void CPUMatrix<ElemType>::TensorOp(ElemType beta, const CPUMatrix<ElemType>& a,
     }
 }
 
+// -----------------------------------------------------------------------
+// fused chains of elementwise ops, see FusedElementwiseProgram
+// -----------------------------------------------------------------------
+
+// elements per block; the intermediate results of a block stay in the L1 cache
+static const size_t c_fusedElementwiseBlockSize = 256;
+
+// float steps run with the vectorized kernels where there is one
+static bool FusedElementwiseStepWithKernel(const FusedElementwiseStep& step, const float* const* values, float* result, size_t n)
+{
+    const auto& kernels = CPUTensorKernels::Get();
+    const float* a = values[step.args[0]];
+    if (step.arity == 1)
+    {
+        auto kernel = kernels.Unary(step.op);
+        if (kernel)
+            kernel(a, result, n, 1, 0);
+        return kernel != nullptr;
+    }
+    const float* b = values[step.args[1]];
+    if (step.arity == 2)
+    {
+        auto kernel = kernels.Binary(step.op);
+        if (kernel)
+            kernel(a, b, result, n, 1, 0);
+        return kernel != nullptr;
+    }
+    auto kernel = kernels.Ternary(step.op);
+    if (kernel)
+        kernel(a, b, values[step.args[2]], result, n, 1, 0);
+    return kernel != nullptr;
+}
+
+template <class ElemType>
+static bool FusedElementwiseStepWithKernel(const FusedElementwiseStep&, const ElemType* const*, ElemType*, size_t)
+{
+    return false;
+}
+
+// result[j] = op(args[j]) for j < n
+template <class ElemType>
+static void ComputeFusedElementwiseStep(const FusedElementwiseStep& step, const ElemType* const* values, ElemType* result, size_t n)
+{
+    if (FusedElementwiseStepWithKernel(step, values, result, n))
+        return;
+
+    const ElemType* a = values[step.args[0]];
+    const ElemType* b = step.arity > 1 ? values[step.args[1]] : nullptr;
+    const ElemType* c = step.arity > 2 ? values[step.args[2]] : nullptr;
+#define CaseFusedUnaryOp(oper)          \
+    case ElementWiseOperator::op##oper: \
+        for (size_t j = 0; j < n; j++)  \
+            result[j] = Op##oper(a[j]); \
+        return
+#define CaseFusedBinaryOp(oper)               \
+    case ElementWiseOperator::op##oper:       \
+        for (size_t j = 0; j < n; j++)        \
+            result[j] = Op##oper(a[j], b[j]); \
+        return
+#define CaseFusedTernaryOp(oper)                    \
+    case ElementWiseOperator::op##oper:             \
+        for (size_t j = 0; j < n; j++)              \
+            result[j] = Op##oper(a[j], b[j], c[j]); \
+        return
+    if (step.arity == 1)
+    {
+        switch (step.op)
+        {
+            ForAllUnaryOps(CaseFusedUnaryOp);
+        default:
+            break;
+        }
+    }
+    else if (step.arity == 2)
+    {
+        switch (step.op)
+        {
+            ForAllBinaryOps(CaseFusedBinaryOp);
+        default:
+            break;
+        }
+    }
+    else
+    {
+        switch (step.op)
+        {
+            ForAllTernaryOps(CaseFusedTernaryOp);
+        default:
+            break;
+        }
+    }
+    LogicError("FusedElementwiseOp: Unknown op code %d with %d arguments.", (int) step.op, step.arity);
+}
+
+// this = program(inputs), block by block, so that each input is read and the output written only once
+template <class ElemType>
+void CPUMatrix<ElemType>::FusedElementwiseOp(const FusedElementwiseProgram& program, const std::vector<const CPUMatrix<ElemType>*>& inputs)
+{
+    const size_t numRows = GetNumRows(), numCols = GetNumCols();
+    const size_t blockSize = c_fusedElementwiseBlockSize;
+    ElemType* output = Data();
+    // one element costs about as much as one element of every step's TensorOp
+    size_t minGrain = max((size_t) 1, c_tensorOpMinGrain / program.numSteps);
+    CPUThreadPool::Instance().ParallelFor(GetNumElements(), minGrain, [&](size_t begin, size_t end)
+    {
+        vector<ElemType> buffer((program.numInputs + program.numSteps) * blockSize);
+        const ElemType* values[FusedElementwiseProgram::MaxInputs + FusedElementwiseProgram::MaxSteps];
+        for (size_t blockBegin = begin; blockBegin < end; blockBegin += blockSize)
+        {
+            size_t length = min(blockSize, end - blockBegin);
+            for (int i = 0; i < program.numInputs; i++)
+            {
+                const ElemType* input = inputs[i]->Data();
+                if (inputs[i]->GetNumCols() == numCols)
+                {
+                    values[i] = input + blockBegin;
+                    continue;
+                }
+                // a single column for all columns
+                ElemType* column = &buffer[i * blockSize];
+                for (size_t j = 0; j < length; j++)
+                    column[j] = input[(blockBegin + j) % numRows];
+                values[i] = column;
+            }
+            for (int k = 0; k < program.numSteps; k++)
+            {
+                bool isLast = k + 1 == program.numSteps;
+                ElemType* result = isLast ? output + blockBegin : &buffer[(program.numInputs + k) * blockSize];
+                ComputeFusedElementwiseStep(program.steps[k], values, result, length);
+                values[program.numInputs + k] = result;
+            }
+        }
+    });
+}
+
 // =======================================================================
 // explicit instantiations
 // =======================================================================
 template class MATH_API CPUMatrix<float>;
 template class MATH_API CPUMatrix<double>;
+template class MATH_API PackedGemmMatrix<float>;
+template class MATH_API PackedGemmMatrix<double>;
 
 // We use Matrix<char> as the backing store for QuantizedMatrix
 // Let's explicitly instantiate the methods we need for that purpose
@@ -93,6 +93,8 @@ public:
 
     ElemType Adagrad(CPUMatrix<ElemType>& gradients, const bool needAveMultiplier);
     void FSAdagrad(CPUMatrix<ElemType>& gradients, CPUMatrix<ElemType>& functionValues, ElemType learnRatePerSample, ElemType momentum, ElemType adaWeight, ElemType adaMul);
+    void Adam(CPUMatrix<ElemType>& gradients, CPUMatrix<ElemType>& functionValues, ElemType learnRatePerSample, ElemType meanMomentum, ElemType varMomentum,
+              ElemType meanCorrection, ElemType varCorrection, ElemType epsilon, ElemType weightDecay, bool updateFunctionValues);
     ElemType RmsProp(CPUMatrix<ElemType>& gradients,
                      ElemType RMS_GAMMA,
                      ElemType RMS_WGT_INC,
@@ -139,6 +141,8 @@ public:
     void SetValue(const size_t numRows, const size_t numCols, ElemType* pArray, size_t matrixFlags = matrixFlagNormal);
 
     void MaskColumnsValue(const CPUMatrix<char>& columnsMask, ElemType val);
+    void AssignAugmentedImages(const CPUMatrix<char>& images, CPUMatrix<ElemType>& params, const CPUMatrix<ElemType>& mean,
+                               size_t width, size_t height, size_t channels, bool toCHW);
 
     void SetColumn(const ElemType* colPointer, size_t colInd);
     void SetColumn(const CPUMatrix<ElemType>& valMat, size_t colInd);
@@ -149,6 +153,9 @@ public:
     void SetUniformRandomValue(const ElemType low, const ElemType high, unsigned long seed = USE_TIME_BASED_SEED);
     void SetGaussianRandomValue(const ElemType mean, const ElemType sigma, unsigned long seed = USE_TIME_BASED_SEED);
     void SetUniformRandomMask(const ElemType maskRate, const ElemType scaleValue, RNGHandle& rngHandle);
+    // this = beta * this + a .* mask, with mask(i) = 0 with probability maskRate and scaleValue otherwise, for the element i
+    // in column-major order: mask(i) is drawn by PhiloxRNG for (seed, offset + i), so the same arguments give the same mask.
+    CPUMatrix<ElemType>& DoElementProductOfCounterBasedMask(ElemType beta, const CPUMatrix<ElemType>& a, const ElemType maskRate, const ElemType scaleValue, uint64_t seed, uint64_t offset);
     void AddGaussianRandomValue(const ElemType mean, const ElemType sigma, unsigned long seed = USE_TIME_BASED_SEED);
 
     CPUMatrix<ElemType> Transpose();
@@ -157,6 +164,9 @@ public:
     CPUMatrix<ElemType>& DoGatherColumnsOf (ElemType beta, const CPUMatrix<ElemType>& idx, const CPUMatrix<ElemType>& a, ElemType alpha);
     CPUMatrix<ElemType>& DoScatterColumnsOf(ElemType beta, const CPUMatrix<ElemType>& idx, const CPUMatrix<ElemType>& a, ElemType alpha);
 
+    CPUMatrix<ElemType>& AssignNonZeroCountsOfSequences(const CPUMatrix<ElemType>& condition, size_t conditionStride, const CPUMatrix<ElemType>& sequences);
+    CPUMatrix<ElemType>& DoScatterNonZeroStepsOfSequences(const CPUMatrix<ElemType>& condition, size_t conditionStride, const CPUMatrix<ElemType>& sequences, const CPUMatrix<ElemType>& outputFirstColumns, size_t outputStride);
+
     CPUMatrix<ElemType>& operator+=(const ElemType alpha);
     CPUMatrix<ElemType>  operator+(const ElemType alpha) const;
     CPUMatrix<ElemType>& AssignSumOf(const ElemType alpha, const CPUMatrix<ElemType>& a);
@@ -315,6 +325,13 @@ public:
 
     CPUMatrix<ElemType>& AssignNumOfDiff(const CPUMatrix<ElemType>& a, const CPUMatrix<ElemType>& b, bool searchInCol = false);
 
+    CPUMatrix<ElemType>& AssignLambdaRankMetricOf(const CPUMatrix<ElemType>& gains, const CPUMatrix<ElemType>& scores, const CPUMatrix<ElemType>& queryIds, CPUMatrix<ElemType>& discounts);
+    CPUMatrix<ElemType>& AddLambdaRankGradientOf(ElemType sigma, const CPUMatrix<ElemType>& gains, const CPUMatrix<ElemType>& scores, const CPUMatrix<ElemType>& queryIds, const CPUMatrix<ElemType>& discounts);
+
+    CPUMatrix<ElemType>& AssignGMMLogLikelihoodOf(const CPUMatrix<ElemType>& unnormedPriors, const CPUMatrix<ElemType>& means, const CPUMatrix<ElemType>& logStddevs, const CPUMatrix<ElemType>& features, CPUMatrix<ElemType>& posteriors);
+    CPUMatrix<ElemType>& AddGMMLogLikelihoodGradientOf(size_t inputIndex, const CPUMatrix<ElemType>& gradient, const CPUMatrix<ElemType>& unnormedPriors, const CPUMatrix<ElemType>& means, const CPUMatrix<ElemType>& logStddevs,
+                                               const CPUMatrix<ElemType>& features, const CPUMatrix<ElemType>& posteriors);
+
     void Print(const char* matrixName, ptrdiff_t rowStart, ptrdiff_t rowEnd, ptrdiff_t colStart, ptrdiff_t colEnd) const;
     void Print(const char* matrixName = nullptr) const; // print whole matrix. can be expensive
 
@@ -386,6 +403,9 @@ public:
     void BatchNormalizationBackward(const CPUMatrix<ElemType>& in, CPUMatrix<ElemType>& grad, const CPUMatrix<ElemType>& scale, double blendFactor, const CPUMatrix<ElemType>& saveMean, const CPUMatrix<ElemType>& saveInvStdDev,
                                     CPUMatrix<ElemType>& scaleGrad, CPUMatrix<ElemType>& biasGrad) const;
 
+    // RNN support functions (inference only)
+    void RNNForward(const CPUMatrix<ElemType>& inputX, const CPUMatrix<ElemType>& paramW, size_t xDim, size_t yDim, const vector<size_t>& numSequencesForFrame, const struct RnnAttributes& rnnAttributes, CPUMatrix<ElemType>& reserve, CPUMatrix<ElemType>& workspace);
+
 public:
     // This functions do not depend on <ElemType>, i.e. you can call them on any <ElemType>
     static int SetNumThreads(int numThreads);
@@ -396,11 +416,12 @@ public:
     // static BLAS functions
     static void SVD(const CPUMatrix<ElemType>& A, CPUMatrix<ElemType>& SIGMA, CPUMatrix<ElemType>& U, CPUMatrix<ElemType>& VT, CPUMatrix<ElemType>& W);
 
-    static void MultiplyAndWeightedAdd(ElemType alpha, const CPUMatrix<ElemType>& a, const bool transposeA, const CPUMatrix<ElemType>& b, const bool transposeB, ElemType beta, CPUMatrix<ElemType>& c, shared_ptr<QuantizedMultiplier<ElemType>> pQuantizedMultiplier=nullptr);
+    static void MultiplyAndWeightedAdd(ElemType alpha, const CPUMatrix<ElemType>& a, const bool transposeA, const CPUMatrix<ElemType>& b, const bool transposeB, ElemType beta, CPUMatrix<ElemType>& c, shared_ptr<QuantizedMultiplier<ElemType>> pQuantizedMultiplier=nullptr, shared_ptr<PackedGemmMatrix<ElemType>> pPackedA=nullptr);
     static void MultiplyAndAdd(const CPUMatrix<ElemType>& a, const bool transposeA, const CPUMatrix<ElemType>& b, const bool transposeB, CPUMatrix<ElemType>& c);
     static void Multiply(const CPUMatrix<ElemType>& a, const bool transposeA, const CPUMatrix<ElemType>& b, const bool transposeB, CPUMatrix<ElemType>& c);
     static void Multiply(const CPUMatrix<ElemType>& a, const CPUMatrix<ElemType>& b, CPUMatrix<ElemType>& c);
     static void Multiply1x1AndWeightedAdd(ElemType alpha, const CPUMatrix<ElemType>& a, const CPUMatrix<ElemType>& b, ElemType beta, CPUMatrix<ElemType>& c);
+    static void BatchMultiplyAndWeightedAdd(ElemType alpha, const CPUMatrix<ElemType>& a, const bool transposeA, const CPUMatrix<ElemType>& b, const bool transposeB, ElemType beta, CPUMatrix<ElemType>& c, size_t m, size_t n, size_t k);
 
     static void ScaleAndAdd(ElemType alpha, const CPUMatrix<ElemType>& a, CPUMatrix<ElemType>& c);
     static void AddScaledDifference(const ElemType alpha, const CPUMatrix<ElemType>& a, const CPUMatrix<ElemType>& b, CPUMatrix<ElemType>& c);
@@ -435,6 +456,7 @@ public:
                   const std::array<size_t, 4>& offsets,
                   const SmallVector<size_t>& regularOpDims, const std::array<SmallVector<ptrdiff_t>, 4>& regularStrides,
                   const SmallVector<size_t>& reducingOpDims, const std::array<SmallVector<ptrdiff_t>, 4>& reducingStrides);
+    void FusedElementwiseOp(const FusedElementwiseProgram& program, const std::vector<const CPUMatrix<ElemType>*>& inputs);
 
     static CPUMatrix<ElemType> Ones(const size_t rows, const size_t cols);
     static CPUMatrix<ElemType> Zeros(const size_t rows, const size_t cols);
@@ -452,26 +474,23 @@ public:
     CPUMatrix<ElemType>& GetARowByIndex(const CPUMatrix<ElemType>& a, const size_t index);
     static void ConductRowElementMultiplyWithShift(const CPUMatrix<ElemType>& a, const CPUMatrix<ElemType>& b, CPUMatrix<ElemType>& c, const size_t shift, bool bFirstmatrixfixed);
     CPUMatrix<ElemType>& AssignElementProductOfWithShift(const CPUMatrix<ElemType>& a, const CPUMatrix<ElemType>& b, const size_t shift);
+    CPUMatrix<ElemType>& AssignCosDistanceWithNegativeSamplesOf(const CPUMatrix<ElemType>& a, const CPUMatrix<ElemType>& b, const size_t shift, const size_t negnumber, CPUMatrix<ElemType>& invNormA, CPUMatrix<ElemType>& invNormB);
+    CPUMatrix<ElemType>& AddCosDistanceWithNegativeSamplesGradientOf(const CPUMatrix<ElemType>& gradient, const CPUMatrix<ElemType>& value, const CPUMatrix<ElemType>& a, const CPUMatrix<ElemType>& b,
+                                                                     const CPUMatrix<ElemType>& invNormA, const CPUMatrix<ElemType>& invNormB, const size_t shift, const bool isRightInput);
 
 public:
     friend File& operator>>(File& stream, CPUMatrix<ElemType>& us)
     {
         stream.GetMarker(fileMarkerBeginSection, std::wstring(L"BMAT"));
-        size_t elsize;
+        size_t elsize; // (a matrix of the other precision is converted, e.g. when a double model is loaded as float)
         stream >> elsize;
-        if (sizeof(ElemType) != elsize)
-            RuntimeError("Template argument size doesn't match those in file");
         std::wstring matrixName;
         size_t numRows, numCols;
         int format;
         stream >> matrixName >> format >> numRows >> numCols;
-        ElemType* d_array = new ElemType[numRows * numCols];
-        for (size_t i = 0; i < numRows * numCols; ++i)
-            stream >> d_array[i];
+        us.RequireSize(numRows, numCols);
+        stream.GetFloatingPointArray(us.Data(), numRows * numCols, elsize); // (straight into the matrix)
         stream.GetMarker(fileMarkerEndSection, std::wstring(L"EMAT"));
-        us.SetValue(numRows, numCols, d_array, matrixFlagNormal);
-
-        delete[] d_array;
         return stream;
     }
     friend File& operator<<(File& stream, const CPUMatrix<ElemType>& us)
@@ -484,8 +503,7 @@ public:
         stream << s << format;
 
         stream << us.m_numRows << us.m_numCols;
-        for (size_t i = 0; i < us.GetNumElements(); ++i)
-            stream << us.Buffer()[i];
+        stream.PutArray(us.Data(), us.GetNumElements());
         stream.PutMarker(fileMarkerEndSection, std::wstring(L"EMAT"));
         return stream;
     }
@@ -516,6 +534,13 @@ public:
                                      CPUMatrix<ElemType>& grd,
                                      const size_t tPos // position
                                      );
+    // batched over all sequences of a minibatch
+    static void RCRFForwardBackward(const CPUMatrix<ElemType>& lbls, const CPUMatrix<ElemType>& pos_scores, const CPUMatrix<ElemType>& pair_scores,
+                                    const std::vector<CRFSequence>& sequences, size_t numParallelSequences,
+                                    CPUMatrix<ElemType>& alpha, CPUMatrix<ElemType>& beta, CPUMatrix<ElemType>& objectives);
+    static void RCRFViterbiDecode(const CPUMatrix<ElemType>& lbls, const CPUMatrix<ElemType>& pos_scores, const CPUMatrix<ElemType>& pair_scores,
+                                  const std::vector<CRFSequence>& sequences, size_t numParallelSequences,
+                                  CPUMatrix<ElemType>& decodedPath);
 
 protected:
     size_t LocateElement(const size_t i, const size_t j) const;
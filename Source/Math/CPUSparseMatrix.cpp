@@ -933,12 +933,80 @@ void CPUSparseMatrix<ElemType>::MultiplyAndWeightedAdd(ElemType alpha, const CPU
         MultiplyDenseAndSparse<ElemType, true /* dense times sparse */, false /* transposeA */, false  /*transposeB*/>::MultiplyAndWeightedAdd(alpha, b /*sparse*/, a /* dense */, beta, c /* matrix beeing updated */);
 }
 
+// c = alpha * op(a) * b + beta * c for sparse CSC a, e.g. pruned weights, and dense b, e.g. a minibatch of activations
+// Each column of c only depends on the same column of b, so the columns are computed in parallel, each going through the
+// nonzeros of a in storage order: op(a) * b(:,j) is the sum of the columns of a weighted by b(:,j), and op(a)' * b(:,j)
+// the dot products of the columns of a with b(:,j).
+template <class ElemType>
+static void MultiplySparseCSCByDenseColumns(ElemType alpha, const CPUSparseMatrix<ElemType>& a, const bool transposeA,
+                                            const CPUMatrix<ElemType>& b, ElemType beta, CPUMatrix<ElemType>& c)
+{
+    size_t m = transposeA ? a.GetNumCols() : a.GetNumRows();
+    size_t k = transposeA ? a.GetNumRows() : a.GetNumCols();
+    size_t n = b.GetNumCols();
+    if (k != b.GetNumRows())
+        InvalidArgument("CPUSparseMatrix::MultiplyAndWeightedAdd: The inner dimensions of a (= %lu) and b (= %lu) don't match.", k, b.GetNumRows());
+
+    if (beta == 0)
+        c.RequireSize(m, n);
+    else
+        c.VerifySize(m, n); // Can't resize if beta != 0
+
+    const ElemType* values = a.Buffer() + *a.SecondaryIndexLocation(); // (of the current view)
+    const CPUSPARSE_INDEX_TYPE* rowIndices = a.MajorIndexLocation();
+    const CPUSPARSE_INDEX_TYPE* columnStarts = a.SecondaryIndexLocation();
+    const CPUSPARSE_INDEX_TYPE firstNonzero = columnStarts[0];
+    size_t numColsA = a.GetNumCols();
+    ElemType* dataB = b.Data();
+    ElemType* dataC = c.Data();
+
+#pragma omp parallel for
+    for (long j = 0; j < (long) n; j++)
+    {
+        const ElemType* bj = dataB + j * k;
+        ElemType* cj = dataC + j * m;
+        if (beta == 0)
+            memset(cj, 0, sizeof(ElemType) * m);
+        else if (beta != 1)
+        {
+            for (size_t i = 0; i < m; i++)
+                cj[i] *= beta;
+        }
+        for (size_t col = 0; col < numColsA; col++)
+        {
+            size_t begin = columnStarts[col] - firstNonzero;
+            size_t end = columnStarts[col + 1] - firstNonzero;
+            if (!transposeA) // c(:,j) += alpha * b(col,j) * a(:,col)
+            {
+                ElemType weight = alpha * bj[col];
+                if (weight == 0)
+                    continue;
+                for (size_t p = begin; p < end; p++)
+                    cj[rowIndices[p]] += weight * values[p];
+            }
+            else // c(col,j) += alpha * a(:,col)' * b(:,j)
+            {
+                ElemType sum = 0;
+                for (size_t p = begin; p < end; p++)
+                    sum += values[p] * bj[rowIndices[p]];
+                cj[col] += alpha * sum;
+            }
+        }
+    }
+}
+
 // c = alpha * lhs * rhs + beta * c
 // sparse * dense -> dense
 template <class ElemType>
 void CPUSparseMatrix<ElemType>::MultiplyAndWeightedAdd(ElemType alpha, const CPUSparseMatrix<ElemType>& a, const bool transposeA,
     const CPUMatrix<ElemType>& b, const bool transposeB, ElemType beta, CPUMatrix<ElemType>& c)
 {
+    if (!transposeB && a.GetFormat() == matrixFormatSparseCSC && !a.IsEmpty() && !b.IsEmpty())
+    {
+        MultiplySparseCSCByDenseColumns(alpha, a, transposeA, b, beta, c);
+        return;
+    }
+
     // Mapping variables to compile time template parameters for efficiency
     if (transposeA &&  transposeB)
         MultiplyDenseAndSparse<ElemType, false /* dense times sparse */,  true /* transposeA */,  true /*transposeB*/>::MultiplyAndWeightedAdd(alpha, a /*sparse*/, b /* dense */, beta, c /* matrix beeing updated */);
@@ -1230,6 +1298,182 @@ ElemType CPUSparseMatrix<ElemType>::Adagrad(CPUMatrix<ElemType>& c, const bool n
         return 1;
 }
 
+// FSAdagrad update (cf. CPUMatrix::FSAdagrad()) of the elements of a SparseBlockCol gradient (this)
+template <class ElemType>
+void CPUSparseMatrix<ElemType>::FSAdagrad(CPUMatrix<ElemType>& c, CPUMatrix<ElemType>& functionValues, ElemType learnRatePerSample, ElemType momentum, ElemType adaWeight, ElemType adaMul) const
+{
+    if (GetFormat() != MatrixFormat::matrixFormatSparseBlockCol)
+        RuntimeError("CPUSparseMatrix::FSAdagrad() only supports the SparseBlockCol format");
+
+    size_t numColsNeeded = 2 * GetNumCols();
+    if (c.IsEmpty() || (c.GetNumCols() < numColsNeeded))
+    {
+        c.RequireSize(GetNumRows(), numColsNeeded);
+        c.SetValue(0.0);
+    }
+
+    assert((c.GetNumRows() == GetNumRows()) && (c.GetNumCols() == numColsNeeded));
+
+    const size_t numRows = GetNumRows();
+    ElemType* smoothAda = c.Data();
+    ElemType* smoothMom = c.Data() + GetNumElements();
+    ElemType* val = functionValues.Data();
+#pragma omp parallel for
+    for (long j = 0; j < (long) GetBlockSize(); j++)
+    {
+        const ElemType* grad = Buffer() + j * numRows;
+        const size_t start = (GetBlockIds()[j] - GetBlockIdShift()) * numRows;
+        for (size_t row = 0; row < numRows; row++)
+        {
+            size_t i = start + row;
+            ElemType g = grad[row];
+            ElemType adaSqr = adaWeight * smoothAda[i] + (1.0f - adaWeight) * g * g;
+            smoothAda[i] = adaSqr;
+            if (adaSqr != 0.0f)
+            {
+                ElemType ada = sqrt(adaSqr);
+                ElemType w = adaMul * ((ElemType) 1.0 / ada);
+
+                if (w > 10.0f)
+                    w = 10.0f;
+                g *= w;
+            }
+
+            if (momentum > 0.0f)
+            {
+                g = momentum * smoothMom[i] + (1.0f - momentum) * g;
+                smoothMom[i] = g;
+            }
+
+            val[i] -= learnRatePerSample * g;
+        }
+    }
+}
+
+// Adam update (cf. CPUMatrix::Adam()) of the elements of a SparseBlockCol gradient (this); the accumulators of the other columns are left as they are
+template <class ElemType>
+void CPUSparseMatrix<ElemType>::Adam(CPUMatrix<ElemType>& c, CPUMatrix<ElemType>& functionValues, ElemType learnRatePerSample, ElemType meanMomentum, ElemType varMomentum,
+                                     ElemType meanCorrection, ElemType varCorrection, ElemType epsilon, ElemType weightDecay, bool updateFunctionValues)
+{
+    if (GetFormat() != MatrixFormat::matrixFormatSparseBlockCol)
+        RuntimeError("CPUSparseMatrix::Adam() only supports the SparseBlockCol format");
+
+    size_t numColsNeeded = 2 * GetNumCols();
+    if (c.IsEmpty() || (c.GetNumCols() < numColsNeeded))
+    {
+        c.RequireSize(GetNumRows(), numColsNeeded);
+        c.SetValue(0.0);
+    }
+
+    assert((c.GetNumRows() == GetNumRows()) && (c.GetNumCols() == numColsNeeded));
+
+    const size_t numRows = GetNumRows();
+    ElemType* smoothVar = c.Data();
+    ElemType* smoothMean = c.Data() + GetNumElements();
+    ElemType* val = functionValues.Data();
+#pragma omp parallel for
+    for (long j = 0; j < (long) GetBlockSize(); j++)
+    {
+        ElemType* grad = Buffer() + j * numRows;
+        const size_t start = (GetBlockIds()[j] - GetBlockIdShift()) * numRows;
+        for (size_t row = 0; row < numRows; row++)
+        {
+            size_t i = start + row;
+            ElemType g = grad[row];
+            ElemType mean = meanMomentum * smoothMean[i] + (1.0f - meanMomentum) * g;
+            ElemType var = varMomentum * smoothVar[i] + (1.0f - varMomentum) * g * g;
+            smoothMean[i] = mean;
+            smoothVar[i] = var;
+
+            ElemType step = meanCorrection * mean / (sqrt(varCorrection * var) + epsilon) + weightDecay * val[i];
+            if (updateFunctionValues)
+                val[i] -= learnRatePerSample * step;
+            else
+                grad[row] = step;
+        }
+    }
+}
+
+// applies the steps skipped since the columns of a SparseBlockCol gradient (this) were last updated, see Matrix::CatchUpLazyMomentum()
+template <class ElemType>
+void CPUSparseMatrix<ElemType>::CatchUpLazyMomentum(CPUMatrix<ElemType>& c, CPUMatrix<ElemType>& functionValues, CPUMatrix<ElemType>& lastUpdates, ElemType timestamp,
+                                                    ElemType learnRateScale, ElemType momentum, bool hasVarianceAccumulator, ElemType varMomentum) const
+{
+    if (GetFormat() != MatrixFormat::matrixFormatSparseBlockCol)
+        RuntimeError("CPUSparseMatrix::CatchUpLazyMomentum() only supports the SparseBlockCol format");
+
+    const size_t numRows = GetNumRows();
+    ElemType* smoothedVariance = hasVarianceAccumulator ? c.Data() : nullptr;
+    ElemType* smoothedMomentum = c.Data() + (hasVarianceAccumulator ? GetNumElements() : 0);
+    ElemType* val = functionValues.Data();
+#pragma omp parallel for
+    for (long j = 0; j < (long) GetBlockSize(); j++)
+    {
+        const size_t col = GetBlockIds()[j] - GetBlockIdShift();
+        const ElemType numSkipped = timestamp - 1 - lastUpdates(0, col);
+        lastUpdates(0, col) = timestamp;
+        if (numSkipped <= 0)
+            continue;
+
+        const ElemType momentumDecay = pow(momentum, numSkipped);
+        const ElemType varianceDecay = pow(varMomentum, numSkipped);
+        // sum of momentum^i for i = 1..numSkipped
+        const ElemType decaySum = (momentum == 1) ? numSkipped : momentum * (1 - momentumDecay) / (1 - momentum);
+        for (size_t i = col * numRows; i < (col + 1) * numRows; i++)
+        {
+            val[i] -= learnRateScale * decaySum * smoothedMomentum[i];
+            smoothedMomentum[i] *= momentumDecay;
+            if (smoothedVariance)
+                smoothedVariance[i] *= varianceDecay;
+        }
+    }
+}
+
+template <class ElemType>
+void CPUSparseMatrix<ElemType>::GetBlockColumnIds(std::vector<size_t>& columnIds) const
+{
+    if (GetFormat() != MatrixFormat::matrixFormatSparseBlockCol)
+        NOT_IMPLEMENTED;
+
+    columnIds.resize(GetBlockSize());
+    for (size_t j = 0; j < columnIds.size(); j++)
+        columnIds[j] = GetBlockIds()[j] - GetBlockIdShift();
+}
+
+template <class ElemType>
+void CPUSparseMatrix<ElemType>::ExpandBlockColumns(const std::vector<size_t>& columnIds)
+{
+    if (!OwnBuffer())
+        LogicError("Cannot modify since the buffer is managed externally.");
+    if (GetFormat() != MatrixFormat::matrixFormatSparseBlockCol)
+        NOT_IMPLEMENTED;
+    if (columnIds.size() < GetBlockSize())
+        InvalidArgument("CPUSparseMatrix::ExpandBlockColumns: The %d new blocks must include the %d current ones.", (int) columnIds.size(), (int) GetBlockSize());
+
+    const size_t numRows = GetNumRows();
+    map<size_t, size_t> col2BlockId;
+    for (size_t blockId = 0; blockId < GetBlockSize(); blockId++)
+        col2BlockId[GetBlockIds()[blockId] - GetBlockIdShift()] = blockId;
+
+    vector<ElemType> values(numRows * columnIds.size(), 0);
+    for (size_t j = 0; j < columnIds.size(); j++)
+    {
+        if (columnIds[j] >= GetNumCols())
+            InvalidArgument("CPUSparseMatrix::ExpandBlockColumns: Column %d is out of range.", (int) columnIds[j]);
+        auto iter = col2BlockId.find(columnIds[j]);
+        if (iter != col2BlockId.end())
+            memcpy(&values[j * numRows], Buffer() + iter->second * numRows, sizeof(ElemType) * numRows);
+    }
+
+    RequireSizeAndAllocate(numRows, GetNumCols(), values.size(), true, false);
+    SetBlockIdShift(0);
+    SetBlockSize(columnIds.size());
+    for (size_t j = 0; j < columnIds.size(); j++)
+        GetBlockIds()[j] = columnIds[j];
+    if (!values.empty())
+        memcpy(Buffer(), values.data(), sizeof(ElemType) * values.size());
+}
+
 template <class ElemType>
 CPUSparseMatrix<ElemType>& CPUSparseMatrix<ElemType>::InplaceTruncateTop(const ElemType threshold)
 {
@@ -1476,10 +1720,8 @@ MATH_API File& operator>>(File& stream, CPUSparseMatrix<ElemType>& us)
         LogicError("Cannot read into a managed external matrix");
 
     stream.GetMarker(fileMarkerBeginSection, std::wstring(L"BMAT"));
-    size_t elsize;
+    size_t elsize; // (a matrix of the other precision is converted, see File::GetFloatingPointArray())
     stream >> elsize;
-    if (sizeof(ElemType) != elsize)
-        RuntimeError("Template argument size doesn't match those in file");
     std::wstring matrixName;
 
     // now prepare this header to receive the data being read
@@ -1502,18 +1744,19 @@ MATH_API File& operator>>(File& stream, CPUSparseMatrix<ElemType>& us)
         CPUSPARSE_INDEX_TYPE* unCompressedIndex = us.MajorIndexLocation();
         CPUSPARSE_INDEX_TYPE* compressedIndex = us.SecondaryIndexLocation();
 
-        // read in the sparse matrix info
-        for (size_t i = 0; i < nz; ++i)
-        {
-            stream >> dataBuffer[i];
-        }
+        // read in the sparse matrix info (the indices are stored as size_t, as by GPUSparseMatrix)
+        stream.GetFloatingPointArray(dataBuffer, nz, elsize);
         for (size_t i = 0; i < nz; ++i)
         {
-            stream >> unCompressedIndex[i];
+            size_t val;
+            stream >> val;
+            unCompressedIndex[i] = (CPUSPARSE_INDEX_TYPE) val;
         }
         for (size_t i = 0; i < compressedSize; ++i)
         {
-            stream >> compressedIndex[i];
+            size_t val;
+            stream >> val;
+            compressedIndex[i] = (CPUSPARSE_INDEX_TYPE) val;
         }
     }
     stream.GetMarker(fileMarkerEndSection, std::wstring(L"EMAT"));
@@ -1534,7 +1777,7 @@ MATH_API File& operator<<(File& stream, const CPUSparseMatrix<ElemType>& us)
     stream << sizeof(ElemType);
     stream << std::wstring(L"nnmatrix"); // Note this is needed for compatability, and could potentially be an empty string
 
-    size_t nz, numRows, numCols;
+    size_t nz = us.NzCount(), numRows = us.GetNumRows(), numCols = us.GetNumCols();
     size_t compressedSize = us.SecondaryIndexCount();
     int format = us.GetFormat();
 
@@ -1542,7 +1785,8 @@ MATH_API File& operator<<(File& stream, const CPUSparseMatrix<ElemType>& us)
 
     if (nz > 0)
     {
-        ElemType* dataBuffer = us.NzValues();
+        // (of the current view, whose compressed index is rebased to 0)
+        const ElemType* dataBuffer = us.Buffer() + *us.SecondaryIndexLocation();
         CPUSPARSE_INDEX_TYPE* unCompressedIndex = us.MajorIndexLocation();
         CPUSPARSE_INDEX_TYPE* compressedIndex = us.SecondaryIndexLocation();
 
@@ -1552,11 +1796,13 @@ MATH_API File& operator<<(File& stream, const CPUSparseMatrix<ElemType>& us)
         }
         for (size_t i = 0; i < nz; ++i)
         {
-            stream << unCompressedIndex[i];
+            size_t val = unCompressedIndex[i];
+            stream << val;
         }
         for (size_t i = 0; i < compressedSize; ++i)
         {
-            stream << compressedIndex[i];
+            size_t val = compressedIndex[i] - compressedIndex[0];
+            stream << val;
         }
     }
     stream.PutMarker(fileMarkerEndSection, std::wstring(L"EMAT"));
@@ -219,6 +219,14 @@ public:
 public:
     void NormalGrad(CPUMatrix<ElemType>& c, const ElemType momentum);
     ElemType Adagrad(CPUMatrix<ElemType>& c, const bool needAveMultiplier);
+    void FSAdagrad(CPUMatrix<ElemType>& c, CPUMatrix<ElemType>& functionValues, ElemType learnRatePerSample, ElemType momentum, ElemType adaWeight, ElemType adaMul) const;
+    void Adam(CPUMatrix<ElemType>& c, CPUMatrix<ElemType>& functionValues, ElemType learnRatePerSample, ElemType meanMomentum, ElemType varMomentum,
+              ElemType meanCorrection, ElemType varCorrection, ElemType epsilon, ElemType weightDecay, bool updateFunctionValues);
+    void CatchUpLazyMomentum(CPUMatrix<ElemType>& c, CPUMatrix<ElemType>& functionValues, CPUMatrix<ElemType>& lastUpdates, ElemType timestamp,
+                             ElemType learnRateScale, ElemType momentum, bool hasVarianceAccumulator, ElemType varMomentum) const;
+
+    void GetBlockColumnIds(std::vector<size_t>& columnIds) const;
+    void ExpandBlockColumns(const std::vector<size_t>& columnIds);
 
 public:
     CPUSparseMatrix<ElemType>& InplaceTruncateTop(const ElemType threshold);
@@ -343,4 +351,10 @@ public:
 
 typedef CPUSparseMatrix<float> CPUSingleSparseMatrix;
 typedef CPUSparseMatrix<double> CPUDoubleSparseMatrix;
+
+// CSC and CSR only, in the format of GPUSparseMatrix, so that sparse values in model files load on either device
+template <class ElemType>
+MATH_API File& operator>>(File& stream, CPUSparseMatrix<ElemType>& us);
+template <class ElemType>
+MATH_API File& operator<<(File& stream, const CPUSparseMatrix<ElemType>& us);
 } } }
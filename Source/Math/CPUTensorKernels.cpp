@@ -0,0 +1,54 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE.md file in the project root for full license information.
+//
+// CPUTensorKernels.cpp -- the kernels of CPUTensorKernels.h for the baseline instruction set, and the choice of kernels
+//
+
+#include "stdafx.h"
+#include "CPUTensorKernels.h"
+#include "CPUFeatures.h"
+#include <math.h>
+#include <string.h>
+
+#include "CPUTensorKernelsImpl.h"
+
+namespace Microsoft { namespace MSR { namespace CNTK {
+
+// in CPUTensorKernelsAVX2.cpp and CPUTensorKernelsAVX512.cpp
+#if !defined(__aarch64__)
+const CPUTensorKernels& GetCPUTensorKernelsAVX2();
+const CPUTensorKernels& GetCPUTensorKernelsAVX512();
+#endif
+
+static const CPUTensorKernels& GetCPUTensorKernelsScalar()
+{
+    static const CPUTensorKernels kernels("scalar", &GetUnaryKernel<ScalarVector>, &GetBinaryKernel<ScalarVector>,
+                                          &GetTernaryKernel<ScalarVector>, &GetReductionKernel<ScalarVector>, &DotKernel<ScalarVector>);
+    return kernels;
+}
+
+const CPUTensorKernels* CPUTensorKernels::Get(ISA isa)
+{
+    switch (isa)
+    {
+    case ISA::Scalar:
+        return &GetCPUTensorKernelsScalar();
+#if !defined(__aarch64__)
+    case ISA::AVX2:
+        return CPUSupportsAVX2() ? &GetCPUTensorKernelsAVX2() : nullptr;
+    case ISA::AVX512:
+        return CPUSupportsAVX512() ? &GetCPUTensorKernelsAVX512() : nullptr;
+#endif
+    default:
+        return nullptr;
+    }
+}
+
+const CPUTensorKernels& CPUTensorKernels::Get()
+{
+    static const CPUTensorKernels* kernels = Get(ISA::AVX512) ? Get(ISA::AVX512) : Get(ISA::AVX2) ? Get(ISA::AVX2) : Get(ISA::Scalar);
+    return *kernels;
+}
+
+}}}
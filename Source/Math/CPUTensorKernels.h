@@ -0,0 +1,78 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE.md file in the project root for full license information.
+//
+// CPUTensorKernels.h -- explicitly vectorized float kernels for the most frequent elementwise TensorOps
+//
+// The kernels are compiled for several instruction sets (CPUTensorKernels.cpp, CPUTensorKernelsAVX2.cpp,
+// CPUTensorKernelsAVX512.cpp, all from the templates in CPUTensorKernelsImpl.h), and CPUTensorKernels::Get()
+// picks the widest one the host supports at run time. CPUMatrix<float>::TensorOp() uses them where the
+// innermost dimension is contiguous in all operands, and its generic loops everywhere else.
+//
+
+#pragma once
+
+#include "CommonMatrix.h"
+#include <cstddef>
+
+namespace Microsoft { namespace MSR { namespace CNTK {
+
+// c[i] = beta * c[i] + alpha * op(a[i]) for i < n; c is not read if beta is 0
+typedef void (*CPUUnaryTensorKernel)(const float* a, float* c, size_t n, float alpha, float beta);
+// c[i] = beta * c[i] + alpha * op(a[i], b[i])
+typedef void (*CPUBinaryTensorKernel)(const float* a, const float* b, float* c, size_t n, float alpha, float beta);
+// d[i] = beta * d[i] + alpha * op(a[i], b[i], c[i])
+typedef void (*CPUTernaryTensorKernel)(const float* a, const float* b, const float* c, float* d, size_t n, float alpha, float beta);
+// reductionOp over a[0..n), n > 0, aggregated in double like the generic loops
+typedef double (*CPUReductionTensorKernel)(const float* a, size_t n);
+// results[k] = sum of a[i] * b[k * bStride + i] over i < n, for k < numB <= 4, accumulated in float vectors
+// (a is loaded once for the numB vectors, as matrix products want it)
+typedef void (*CPUDotTensorKernel)(const float* a, const float* b, size_t bStride, size_t numB, size_t n, float* results);
+
+class MATH_API CPUTensorKernels
+{
+public:
+    enum class ISA
+    {
+        Scalar,
+        AVX2,   // and FMA
+        AVX512, // AVX512F
+    };
+
+    // the kernels for the widest instruction set of the host
+    static const CPUTensorKernels& Get();
+    // the kernels for 'isa', or nullptr if the host does not support it
+    static const CPUTensorKernels* Get(ISA isa);
+
+    typedef CPUUnaryTensorKernel (*UnaryKernelFn)(ElementWiseOperator op);
+    typedef CPUBinaryTensorKernel (*BinaryKernelFn)(ElementWiseOperator op);
+    typedef CPUTernaryTensorKernel (*TernaryKernelFn)(ElementWiseOperator op);
+    typedef CPUReductionTensorKernel (*ReductionKernelFn)(ElementWiseOperator reductionOp);
+
+    CPUTensorKernels(const char* name, UnaryKernelFn unary, BinaryKernelFn binary, TernaryKernelFn ternary, ReductionKernelFn reduction, CPUDotTensorKernel dot)
+        : m_name(name), m_unary(unary), m_binary(binary), m_ternary(ternary), m_reduction(reduction), m_dot(dot)
+    {
+    }
+
+    const char* Name() const { return m_name; }
+
+    // The kernel for 'op', or nullptr if there is none.
+    CPUUnaryTensorKernel Unary(ElementWiseOperator op) const { return m_unary(op); }
+    CPUBinaryTensorKernel Binary(ElementWiseOperator op) const { return m_binary(op); }
+    CPUTernaryTensorKernel Ternary(ElementWiseOperator op) const { return m_ternary(op); }
+    // The kernel reducing with 'reductionOp' (opSum, opLogSum, opMin, opMax) without an elementwise op (opCopy).
+    // opLogSum computes max + log(sum(exp(a[i] - max))), which rounds differently from chaining LogAdd().
+    CPUReductionTensorKernel Reduction(ElementWiseOperator reductionOp) const { return m_reduction(reductionOp); }
+    // dot products, e.g. for the matrix products of msra::math::ssematrix
+    CPUDotTensorKernel Dot() const { return m_dot; }
+
+private:
+    const char* m_name;
+    UnaryKernelFn m_unary;
+    BinaryKernelFn m_binary;
+    TernaryKernelFn m_ternary;
+    ReductionKernelFn m_reduction;
+    CPUDotTensorKernel m_dot;
+};
+
+}}}
@@ -0,0 +1,99 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE.md file in the project root for full license information.
+//
+// CPUTensorKernelsAVX2.cpp -- the kernels of CPUTensorKernels.h for AVX2 and FMA
+//
+
+#include "stdafx.h"
+#include "CPUTensorKernels.h"
+#include "CPUFeatures.h"
+#include <math.h>
+#include <string.h>
+#if !defined(__aarch64__)
+#include <immintrin.h>
+
+BEGIN_TARGET_CODE("avx2,fma")
+
+namespace Microsoft { namespace MSR { namespace CNTK { namespace {
+
+struct AVX2Vector
+{
+    typedef __m256 Vec;
+    typedef __m256 Mask;
+    struct Acc
+    {
+        __m256d low, high;
+    };
+    static const size_t Width = 8;
+
+    static Vec Set(float value) { return _mm256_set1_ps(value); }
+    static Vec Load(const float* p) { return _mm256_loadu_ps(p); }
+    static void Store(float* p, Vec a) { _mm256_storeu_ps(p, a); }
+    static Vec Add(Vec a, Vec b) { return _mm256_add_ps(a, b); }
+    static Vec Sub(Vec a, Vec b) { return _mm256_sub_ps(a, b); }
+    static Vec Mul(Vec a, Vec b) { return _mm256_mul_ps(a, b); }
+    static Vec Div(Vec a, Vec b) { return _mm256_div_ps(a, b); }
+    static Vec MulAdd(Vec a, Vec b, Vec c) { return _mm256_fmadd_ps(a, b, c); }
+    static Vec Max(Vec a, Vec b) { return _mm256_max_ps(a, b); }
+    static Vec Min(Vec a, Vec b) { return _mm256_min_ps(a, b); }
+    static Vec Neg(Vec a) { return _mm256_xor_ps(a, _mm256_set1_ps(-0.0f)); }
+    static Vec Abs(Vec a) { return _mm256_andnot_ps(_mm256_set1_ps(-0.0f), a); }
+    static Vec Floor(Vec a) { return _mm256_floor_ps(a); }
+    static Vec CopySign(Vec magnitude, Vec sign)
+    {
+        Vec signBit = _mm256_set1_ps(-0.0f);
+        return _mm256_or_ps(_mm256_andnot_ps(signBit, magnitude), _mm256_and_ps(signBit, sign));
+    }
+    static Vec Pow2(Vec n)
+    {
+        __m256i exponent = _mm256_add_epi32(_mm256_cvtps_epi32(n), _mm256_set1_epi32(127));
+        return _mm256_castsi256_ps(_mm256_slli_epi32(exponent, 23));
+    }
+    static Vec Exponent(Vec a)
+    {
+        __m256i exponent = _mm256_srli_epi32(_mm256_castps_si256(a), 23);
+        return _mm256_cvtepi32_ps(_mm256_sub_epi32(_mm256_and_si256(exponent, _mm256_set1_epi32(0xff)), _mm256_set1_epi32(127)));
+    }
+    static Vec Mantissa(Vec a)
+    {
+        __m256i bits = _mm256_and_si256(_mm256_castps_si256(a), _mm256_set1_epi32(0x007fffff));
+        return _mm256_castsi256_ps(_mm256_or_si256(bits, _mm256_set1_epi32(0x3f800000)));
+    }
+    static Mask Greater(Vec a, Vec b) { return _mm256_cmp_ps(a, b, _CMP_GT_OQ); }
+    static Mask GreaterEqual(Vec a, Vec b) { return _mm256_cmp_ps(a, b, _CMP_GE_OQ); }
+    static Mask IsNaN(Vec a) { return _mm256_cmp_ps(a, a, _CMP_UNORD_Q); }
+    static Vec Select(Mask mask, Vec a, Vec b) { return _mm256_blendv_ps(b, a, mask); }
+    static Acc AccZero() { return Acc{_mm256_setzero_pd(), _mm256_setzero_pd()}; }
+    static Acc AccAdd(Acc acc, Vec a)
+    {
+        acc.low = _mm256_add_pd(acc.low, _mm256_cvtps_pd(_mm256_castps256_ps128(a)));
+        acc.high = _mm256_add_pd(acc.high, _mm256_cvtps_pd(_mm256_extractf128_ps(a, 1)));
+        return acc;
+    }
+    static double AccSum(Acc acc)
+    {
+        double lanes[4];
+        _mm256_storeu_pd(lanes, _mm256_add_pd(acc.low, acc.high));
+        return (lanes[0] + lanes[1]) + (lanes[2] + lanes[3]);
+    }
+};
+
+}}}}
+
+#include "CPUTensorKernelsImpl.h"
+
+namespace Microsoft { namespace MSR { namespace CNTK {
+
+// only called after CPUSupportsAVX2() returned true
+const CPUTensorKernels& GetCPUTensorKernelsAVX2()
+{
+    static const CPUTensorKernels kernels("AVX2", &GetUnaryKernel<AVX2Vector>, &GetBinaryKernel<AVX2Vector>,
+                                          &GetTernaryKernel<AVX2Vector>, &GetReductionKernel<AVX2Vector>, &DotKernel<AVX2Vector>);
+    return kernels;
+}
+
+}}}
+
+END_TARGET_CODE
+#endif
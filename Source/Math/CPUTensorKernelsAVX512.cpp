@@ -0,0 +1,89 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE.md file in the project root for full license information.
+//
+// CPUTensorKernelsAVX512.cpp -- the kernels of CPUTensorKernels.h for AVX512F
+//
+
+#include "stdafx.h"
+#include "CPUTensorKernels.h"
+#include "CPUFeatures.h"
+#include <math.h>
+#include <string.h>
+#if !defined(__aarch64__)
+#include <immintrin.h>
+
+BEGIN_TARGET_CODE("avx512f,avx2,fma")
+
+namespace Microsoft { namespace MSR { namespace CNTK { namespace {
+
+// The bitwise float operations would need AVX512DQ, so they are done on integers.
+struct AVX512Vector
+{
+    typedef __m512 Vec;
+    typedef __mmask16 Mask;
+    struct Acc
+    {
+        __m512d low, high;
+    };
+    static const size_t Width = 16;
+
+    static Vec Set(float value) { return _mm512_set1_ps(value); }
+    static Vec Load(const float* p) { return _mm512_loadu_ps(p); }
+    static void Store(float* p, Vec a) { _mm512_storeu_ps(p, a); }
+    static Vec Add(Vec a, Vec b) { return _mm512_add_ps(a, b); }
+    static Vec Sub(Vec a, Vec b) { return _mm512_sub_ps(a, b); }
+    static Vec Mul(Vec a, Vec b) { return _mm512_mul_ps(a, b); }
+    static Vec Div(Vec a, Vec b) { return _mm512_div_ps(a, b); }
+    static Vec MulAdd(Vec a, Vec b, Vec c) { return _mm512_fmadd_ps(a, b, c); }
+    static Vec Max(Vec a, Vec b) { return _mm512_max_ps(a, b); }
+    static Vec Min(Vec a, Vec b) { return _mm512_min_ps(a, b); }
+    static Vec Neg(Vec a) { return _mm512_castsi512_ps(_mm512_xor_si512(_mm512_castps_si512(a), _mm512_set1_epi32(0x80000000))); }
+    static Vec Abs(Vec a) { return _mm512_abs_ps(a); }
+    static Vec Floor(Vec a) { return _mm512_roundscale_ps(a, _MM_FROUND_TO_NEG_INF | _MM_FROUND_NO_EXC); }
+    static Vec CopySign(Vec magnitude, Vec sign)
+    {
+        __m512i signBit = _mm512_set1_epi32(0x80000000);
+        return _mm512_castsi512_ps(_mm512_or_si512(_mm512_andnot_si512(signBit, _mm512_castps_si512(magnitude)),
+                                                   _mm512_and_si512(signBit, _mm512_castps_si512(sign))));
+    }
+    static Vec Pow2(Vec n)
+    {
+        __m512i exponent = _mm512_add_epi32(_mm512_cvtps_epi32(n), _mm512_set1_epi32(127));
+        return _mm512_castsi512_ps(_mm512_slli_epi32(exponent, 23));
+    }
+    static Vec Exponent(Vec a) { return _mm512_getexp_ps(a); }
+    static Vec Mantissa(Vec a) { return _mm512_getmant_ps(a, _MM_MANT_NORM_1_2, _MM_MANT_SIGN_zero); }
+    static Mask Greater(Vec a, Vec b) { return _mm512_cmp_ps_mask(a, b, _CMP_GT_OQ); }
+    static Mask GreaterEqual(Vec a, Vec b) { return _mm512_cmp_ps_mask(a, b, _CMP_GE_OQ); }
+    static Mask IsNaN(Vec a) { return _mm512_cmp_ps_mask(a, a, _CMP_UNORD_Q); }
+    static Vec Select(Mask mask, Vec a, Vec b) { return _mm512_mask_blend_ps(mask, b, a); }
+    static Acc AccZero() { return Acc{_mm512_setzero_pd(), _mm512_setzero_pd()}; }
+    static Acc AccAdd(Acc acc, Vec a)
+    {
+        __m256 high = _mm256_castpd_ps(_mm512_extractf64x4_pd(_mm512_castps_pd(a), 1));
+        acc.low = _mm512_add_pd(acc.low, _mm512_cvtps_pd(_mm512_castps512_ps256(a)));
+        acc.high = _mm512_add_pd(acc.high, _mm512_cvtps_pd(high));
+        return acc;
+    }
+    static double AccSum(Acc acc) { return _mm512_reduce_add_pd(_mm512_add_pd(acc.low, acc.high)); }
+};
+
+}}}}
+
+#include "CPUTensorKernelsImpl.h"
+
+namespace Microsoft { namespace MSR { namespace CNTK {
+
+// only called after CPUSupportsAVX512() returned true
+const CPUTensorKernels& GetCPUTensorKernelsAVX512()
+{
+    static const CPUTensorKernels kernels("AVX512", &GetUnaryKernel<AVX512Vector>, &GetBinaryKernel<AVX512Vector>,
+                                          &GetTernaryKernel<AVX512Vector>, &GetReductionKernel<AVX512Vector>, &DotKernel<AVX512Vector>);
+    return kernels;
+}
+
+}}}
+
+END_TARGET_CODE
+#endif
@@ -0,0 +1,503 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE.md file in the project root for full license information.
+//
+// CPUTensorKernelsImpl.h -- the kernels of CPUTensorKernels.h, written once against a vector type V
+//
+// Every CPUTensorKernels*.cpp includes this file, after its own headers and inside its BEGIN_TARGET_CODE
+// region, so that the templates are compiled for that instruction set. Everything here has internal
+// linkage, and the file includes nothing itself. A vector type provides:
+//
+//     Vec, Mask, Acc (double accumulators) and Width (floats per Vec),
+//     Set, Load, Store (unaligned), Add, Sub, Mul, Div, MulAdd (a * b + c), Max, Min, Neg, Abs,
+//     Floor, CopySign, Pow2 (2^n for integral n in [-127, 127]), Exponent and Mantissa (of a normal float
+//     a = Mantissa(a) * 2^Exponent(a) with Mantissa(a) in [1, 2)), Greater, GreaterEqual, IsNaN, Select,
+//     AccZero, AccAdd, AccSum.
+//
+// The transcendental functions follow the single-precision Cephes library (exp and tanh within 2 ulp);
+// ScalarVector uses the same formulas, for the scalar build and for the tails of the vector loops.
+// The Fast...() ones are the approximations of the fast-math inference mode, same as FastExp() etc. in TensorOps.h.
+//
+
+namespace Microsoft { namespace MSR { namespace CNTK { namespace {
+
+struct ScalarVector
+{
+    typedef float Vec;
+    typedef bool Mask;
+    typedef double Acc;
+    static const size_t Width = 1;
+
+    static Vec Set(float value) { return value; }
+    static Vec Load(const float* p) { return *p; }
+    static void Store(float* p, Vec a) { *p = a; }
+    static Vec Add(Vec a, Vec b) { return a + b; }
+    static Vec Sub(Vec a, Vec b) { return a - b; }
+    static Vec Mul(Vec a, Vec b) { return a * b; }
+    static Vec Div(Vec a, Vec b) { return a / b; }
+    static Vec MulAdd(Vec a, Vec b, Vec c) { return a * b + c; }
+    static Vec Max(Vec a, Vec b) { return a > b ? a : b; }
+    static Vec Min(Vec a, Vec b) { return a < b ? a : b; }
+    static Vec Neg(Vec a) { return -a; }
+    static Vec Abs(Vec a) { return fabsf(a); }
+    static Vec Floor(Vec a) { return floorf(a); }
+    static Vec CopySign(Vec magnitude, Vec sign) { return copysignf(magnitude, sign); }
+    static Vec Pow2(Vec n)
+    {
+        unsigned int bits = (unsigned int) ((int) n + 127) << 23;
+        float result;
+        memcpy(&result, &bits, sizeof(result));
+        return result;
+    }
+    static Vec Exponent(Vec a)
+    {
+        unsigned int bits;
+        memcpy(&bits, &a, sizeof(bits));
+        return (float) ((int) ((bits >> 23) & 0xff) - 127);
+    }
+    static Vec Mantissa(Vec a)
+    {
+        unsigned int bits;
+        memcpy(&bits, &a, sizeof(bits));
+        bits = (bits & 0x007fffff) | 0x3f800000;
+        float result;
+        memcpy(&result, &bits, sizeof(result));
+        return result;
+    }
+    static Mask Greater(Vec a, Vec b) { return a > b; }
+    static Mask GreaterEqual(Vec a, Vec b) { return a >= b; }
+    static Mask IsNaN(Vec a) { return a != a; }
+    static Vec Select(Mask mask, Vec a, Vec b) { return mask ? a : b; }
+    static Acc AccZero() { return 0; }
+    static Acc AccAdd(Acc acc, Vec a) { return acc + a; }
+    static double AccSum(Acc acc) { return acc; }
+};
+
+// -----------------------------------------------------------------------
+// math functions
+// -----------------------------------------------------------------------
+
+// exp(x) = 2^n * exp(r) with n = round(x / log(2)) and |r| <= log(2) / 2. 2^n is applied in two halves,
+// so that both are normal floats over the whole range down to the denormals.
+template <class V>
+typename V::Vec Exp(typename V::Vec x)
+{
+    typedef typename V::Vec Vec;
+    Vec input = x;
+    x = V::Min(V::Max(x, V::Set(-103.972f)), V::Set(88.72283905f));
+    Vec n = V::Floor(V::MulAdd(x, V::Set(1.44269504088896341f), V::Set(0.5f)));
+    // r = x - n * log(2), with log(2) split into two parts for precision
+    Vec r = V::MulAdd(n, V::Set(-0.693359375f), x);
+    r = V::MulAdd(n, V::Set(2.12194440e-4f), r);
+    Vec p = V::Set(1.9875691500E-4f);
+    p = V::MulAdd(p, r, V::Set(1.3981999507E-3f));
+    p = V::MulAdd(p, r, V::Set(8.3334519073E-3f));
+    p = V::MulAdd(p, r, V::Set(4.1665795894E-2f));
+    p = V::MulAdd(p, r, V::Set(1.6666665459E-1f));
+    p = V::MulAdd(p, r, V::Set(5.0000001201E-1f));
+    p = V::MulAdd(p, V::Mul(r, r), V::Add(r, V::Set(1)));
+    Vec n1 = V::Floor(V::Mul(n, V::Set(0.5f)));
+    Vec result = V::Mul(V::Mul(p, V::Pow2(n1)), V::Pow2(V::Sub(n, n1)));
+    result = V::Select(V::Greater(input, V::Set(88.72283905f)), V::Set(HUGE_VALF), result);
+    return V::Select(V::IsNaN(input), input, result);
+}
+
+// tanh(x) by a polynomial for |x| < 0.625, and by 1 - 2 / (exp(2|x|) + 1) beyond
+template <class V>
+typename V::Vec Tanh(typename V::Vec x)
+{
+    typedef typename V::Vec Vec;
+    Vec absX = V::Abs(x);
+    Vec large = V::Sub(V::Set(1), V::Div(V::Set(2), V::Add(Exp<V>(V::Add(absX, absX)), V::Set(1))));
+    large = V::CopySign(large, x);
+    Vec z = V::Mul(x, x);
+    Vec p = V::Set(-5.70498872745E-3f);
+    p = V::MulAdd(p, z, V::Set(2.06390887954E-2f));
+    p = V::MulAdd(p, z, V::Set(-5.37397155531E-2f));
+    p = V::MulAdd(p, z, V::Set(1.33314422036E-1f));
+    p = V::MulAdd(p, z, V::Set(-3.33332819422E-1f));
+    Vec small = V::MulAdd(V::Mul(p, z), x, x);
+    return V::Select(V::GreaterEqual(absX, V::Set(0.625f)), large, small);
+}
+
+// same formula as Sigmoid() in TensorOps.h
+template <class V>
+typename V::Vec Sigmoid(typename V::Vec x)
+{
+    return V::Div(V::Set(1), V::Add(Exp<V>(V::Neg(x)), V::Set(1)));
+}
+
+// the clamped range keeps 2^n a normal float, so it is applied at once
+template <class V>
+typename V::Vec FastExp(typename V::Vec x)
+{
+    typedef typename V::Vec Vec;
+    Vec input = x;
+    x = V::Min(V::Max(x, V::Set(-87.3365f)), V::Set(88.3762f));
+    Vec n = V::Floor(V::MulAdd(x, V::Set(1.44269504f), V::Set(0.5f)));
+    Vec r = V::MulAdd(n, V::Set(-0.693359375f), x);
+    r = V::MulAdd(n, V::Set(2.12194440e-4f), r);
+    Vec p = V::Set(0.0415138464f);
+    p = V::MulAdd(p, r, V::Set(0.167874743f));
+    p = V::MulAdd(p, r, V::Set(0.500030137f));
+    p = V::MulAdd(p, r, V::Set(0.999966836f));
+    p = V::MulAdd(p, r, V::Set(1));
+    return V::Select(V::IsNaN(input), input, V::Mul(p, V::Pow2(n)));
+}
+
+template <class V>
+typename V::Vec FastLog(typename V::Vec x)
+{
+    typedef typename V::Vec Vec;
+    // m in [1, 2) is moved to [sqrt(1/2), sqrt(2)]; inputs below EPS_IN_LOG are replaced afterwards
+    Vec normal = V::Max(x, V::Set(EPS_IN_LOG));
+    Vec m = V::Mantissa(normal);
+    Vec e = V::Exponent(normal);
+    auto upper = V::Greater(m, V::Set(1.41421356f));
+    m = V::Select(upper, V::Mul(m, V::Set(0.5f)), m);
+    e = V::Select(upper, V::Add(e, V::Set(1)), e);
+    Vec t = V::Div(V::Sub(m, V::Set(1)), V::Add(m, V::Set(1)));
+    Vec s = V::Mul(t, t);
+    Vec p = V::Set(0.41517709f);
+    p = V::MulAdd(p, s, V::Set(0.66644078f));
+    p = V::MulAdd(p, s, V::Set(2.00000084f));
+    Vec result = V::MulAdd(e, V::Set(0.693147181f), V::Mul(t, p));
+    result = V::Select(V::Greater(x, V::Set(3.40282347e38f)), x, result); // inf
+    result = V::Select(V::GreaterEqual(x, V::Set(EPS_IN_LOG)), result, V::Set(LOG_OF_EPS_IN_LOG));
+    return V::Select(V::IsNaN(x), x, result);
+}
+
+template <class V>
+typename V::Vec FastSigmoid(typename V::Vec x)
+{
+    return V::Div(V::Set(1), V::Add(FastExp<V>(V::Neg(x)), V::Set(1)));
+}
+
+template <class V>
+typename V::Vec FastTanh(typename V::Vec x)
+{
+    return V::Sub(V::Set(1), V::Div(V::Set(2), V::Add(FastExp<V>(V::Add(x, x)), V::Set(1))));
+}
+
+// -----------------------------------------------------------------------
+// the ops, same as the Op...() functions in TensorOps.h
+// -----------------------------------------------------------------------
+
+#define DefKernelOp(op, args, expr)                    \
+    template <class V>                                 \
+    struct KernelOp##op                                \
+    {                                                  \
+        typedef typename V::Vec Vec;                   \
+        static Vec Apply args                          \
+        {                                              \
+            return expr;                               \
+        }                                              \
+    }
+
+DefKernelOp(Copy, (Vec a), a);
+DefKernelOp(Negate, (Vec a), V::Neg(a));
+DefKernelOp(Sigmoid, (Vec a), Sigmoid<V>(a));
+DefKernelOp(Tanh, (Vec a), Tanh<V>(a));
+DefKernelOp(Exp, (Vec a), Exp<V>(a));
+DefKernelOp(Sqr, (Vec a), V::Mul(a, a));
+DefKernelOp(LinearRectifier, (Vec a), V::Select(V::Greater(a, V::Set(0)), a, V::Set(0)));
+DefKernelOp(FastSigmoid, (Vec a), FastSigmoid<V>(a));
+DefKernelOp(FastTanh, (Vec a), FastTanh<V>(a));
+DefKernelOp(FastExp, (Vec a), FastExp<V>(a));
+DefKernelOp(FastLog, (Vec a), FastLog<V>(a));
+
+DefKernelOp(Sum, (Vec a, Vec b), V::Add(a, b));
+DefKernelOp(Difference, (Vec a, Vec b), V::Sub(a, b));
+DefKernelOp(ElementwiseProduct, (Vec a, Vec b), V::Mul(a, b));
+DefKernelOp(ElementwiseProductWithSigmoidDerivativeFromOutput, (Vec a, Vec b), V::Mul(a, V::Mul(b, V::Sub(V::Set(1), b))));
+DefKernelOp(ElementwiseProductWithTanhDerivativeFromOutput, (Vec a, Vec b), V::Mul(a, V::Sub(V::Set(1), V::Mul(b, b))));
+DefKernelOp(ElementwiseProductWithLinearRectifierDerivativeFromOutput, (Vec a, Vec b), V::Select(V::Greater(b, V::Set(0)), a, V::Set(0)));
+DefKernelOp(ElementwiseProductWithLogDerivativeFromOutput, (Vec a, Vec b), V::Mul(a, Exp<V>(V::Neg(b))));
+
+DefKernelOp(ElementwiseProductWithLogSumDerivative, (Vec a, Vec b, Vec c), V::Mul(a, Sigmoid<V>(V::Sub(c, b))));
+DefKernelOp(ElementwiseProductWithExpOfDiff, (Vec a, Vec b, Vec c), V::Mul(a, Exp<V>(V::Sub(b, c))));
+
+#undef DefKernelOp
+
+#define ForAllKernelUnaryOps(Macro) \
+    Macro(Copy);                    \
+    Macro(Negate);                  \
+    Macro(Sigmoid);                 \
+    Macro(Tanh);                    \
+    Macro(Exp);                     \
+    Macro(Sqr);                     \
+    Macro(LinearRectifier);         \
+    Macro(FastSigmoid);             \
+    Macro(FastTanh);                \
+    Macro(FastExp);                 \
+    Macro(FastLog);
+
+#define ForAllKernelBinaryOps(Macro)                                 \
+    Macro(Sum);                                                      \
+    Macro(Difference);                                               \
+    Macro(ElementwiseProduct);                                       \
+    Macro(ElementwiseProductWithSigmoidDerivativeFromOutput);        \
+    Macro(ElementwiseProductWithTanhDerivativeFromOutput);           \
+    Macro(ElementwiseProductWithLinearRectifierDerivativeFromOutput); \
+    Macro(ElementwiseProductWithLogDerivativeFromOutput);
+
+#define ForAllKernelTernaryOps(Macro)              \
+    Macro(ElementwiseProductWithLogSumDerivative); \
+    Macro(ElementwiseProductWithExpOfDiff);
+
+// -----------------------------------------------------------------------
+// elementwise loops
+// -----------------------------------------------------------------------
+
+// alpha * value + beta * *c, short-circuited like TensorOpIteration in CPUMatrix.cpp
+template <class V, bool scaled, bool accumulate>
+inline typename V::Vec Combine(typename V::Vec value, const float* c, typename V::Vec alpha, typename V::Vec beta)
+{
+    if (scaled)
+        value = V::Mul(value, alpha);
+    if (accumulate)
+        value = V::MulAdd(V::Load(c), beta, value);
+    return value;
+}
+
+// The tails are done with ScalarVector; for V = ScalarVector the main loop leaves no tail.
+template <class V, template <class> class Op, bool scaled, bool accumulate>
+void UnaryLoop(const float* a, float* c, size_t n, float alpha, float beta)
+{
+    typename V::Vec alphaV = V::Set(alpha), betaV = V::Set(beta);
+    size_t i = 0;
+    for (; i + V::Width <= n; i += V::Width)
+        V::Store(c + i, Combine<V, scaled, accumulate>(Op<V>::Apply(V::Load(a + i)), c + i, alphaV, betaV));
+    if (i < n)
+        UnaryLoop<ScalarVector, Op, scaled, accumulate>(a + i, c + i, n - i, alpha, beta);
+}
+
+template <class V, template <class> class Op, bool scaled, bool accumulate>
+void BinaryLoop(const float* a, const float* b, float* c, size_t n, float alpha, float beta)
+{
+    typename V::Vec alphaV = V::Set(alpha), betaV = V::Set(beta);
+    size_t i = 0;
+    for (; i + V::Width <= n; i += V::Width)
+        V::Store(c + i, Combine<V, scaled, accumulate>(Op<V>::Apply(V::Load(a + i), V::Load(b + i)), c + i, alphaV, betaV));
+    if (i < n)
+        BinaryLoop<ScalarVector, Op, scaled, accumulate>(a + i, b + i, c + i, n - i, alpha, beta);
+}
+
+template <class V, template <class> class Op, bool scaled, bool accumulate>
+void TernaryLoop(const float* a, const float* b, const float* c, float* d, size_t n, float alpha, float beta)
+{
+    typename V::Vec alphaV = V::Set(alpha), betaV = V::Set(beta);
+    size_t i = 0;
+    for (; i + V::Width <= n; i += V::Width)
+        V::Store(d + i, Combine<V, scaled, accumulate>(Op<V>::Apply(V::Load(a + i), V::Load(b + i), V::Load(c + i)), d + i, alphaV, betaV));
+    if (i < n)
+        TernaryLoop<ScalarVector, Op, scaled, accumulate>(a + i, b + i, c + i, d + i, n - i, alpha, beta);
+}
+
+template <class V, template <class> class Op>
+void UnaryKernel(const float* a, float* c, size_t n, float alpha, float beta)
+{
+    if (beta != 0)
+        UnaryLoop<V, Op, true, true>(a, c, n, alpha, beta);
+    else if (alpha != 1)
+        UnaryLoop<V, Op, true, false>(a, c, n, alpha, beta);
+    else
+        UnaryLoop<V, Op, false, false>(a, c, n, alpha, beta);
+}
+
+template <class V, template <class> class Op>
+void BinaryKernel(const float* a, const float* b, float* c, size_t n, float alpha, float beta)
+{
+    if (beta != 0)
+        BinaryLoop<V, Op, true, true>(a, b, c, n, alpha, beta);
+    else if (alpha != 1)
+        BinaryLoop<V, Op, true, false>(a, b, c, n, alpha, beta);
+    else
+        BinaryLoop<V, Op, false, false>(a, b, c, n, alpha, beta);
+}
+
+template <class V, template <class> class Op>
+void TernaryKernel(const float* a, const float* b, const float* c, float* d, size_t n, float alpha, float beta)
+{
+    if (beta != 0)
+        TernaryLoop<V, Op, true, true>(a, b, c, d, n, alpha, beta);
+    else if (alpha != 1)
+        TernaryLoop<V, Op, true, false>(a, b, c, d, n, alpha, beta);
+    else
+        TernaryLoop<V, Op, false, false>(a, b, c, d, n, alpha, beta);
+}
+
+// -----------------------------------------------------------------------
+// reductions
+// -----------------------------------------------------------------------
+
+template <class V>
+double SumReduction(const float* a, size_t n)
+{
+    typename V::Acc acc = V::AccZero();
+    size_t i = 0;
+    for (; i + V::Width <= n; i += V::Width)
+        acc = V::AccAdd(acc, V::Load(a + i));
+    double sum = V::AccSum(acc);
+    for (; i < n; i++)
+        sum += a[i];
+    return sum;
+}
+
+// max (useMax) or min of a[0..n)
+template <class V, bool useMax>
+float ExtremumReduction(const float* a, size_t n)
+{
+    typedef typename V::Vec Vec;
+    size_t i = 0;
+    float result = a[0];
+    if (n >= V::Width)
+    {
+        Vec extremum = V::Load(a);
+        for (i = V::Width; i + V::Width <= n; i += V::Width)
+            extremum = useMax ? V::Max(extremum, V::Load(a + i)) : V::Min(extremum, V::Load(a + i));
+        float lanes[V::Width];
+        V::Store(lanes, extremum);
+        result = lanes[0];
+        for (size_t j = 1; j < V::Width; j++)
+            result = useMax ? ScalarVector::Max(result, lanes[j]) : ScalarVector::Min(result, lanes[j]);
+    }
+    for (; i < n; i++)
+        result = useMax ? ScalarVector::Max(result, a[i]) : ScalarVector::Min(result, a[i]);
+    return result;
+}
+
+template <class V>
+double MaxReduction(const float* a, size_t n)
+{
+    return ExtremumReduction<V, true>(a, n);
+}
+
+template <class V>
+double MinReduction(const float* a, size_t n)
+{
+    return ExtremumReduction<V, false>(a, n);
+}
+
+// max + log(sum(exp(a[i] - max))), so that no exp() overflows
+template <class V>
+double LogSumReduction(const float* a, size_t n)
+{
+    float max = ExtremumReduction<V, true>(a, n);
+    if (max - max != 0) // infinite or NaN
+        return max;
+    typename V::Vec maxV = V::Set(max);
+    typename V::Acc acc = V::AccZero();
+    size_t i = 0;
+    for (; i + V::Width <= n; i += V::Width)
+        acc = V::AccAdd(acc, Exp<V>(V::Sub(V::Load(a + i), maxV)));
+    double sum = V::AccSum(acc);
+    for (; i < n; i++)
+        sum += Exp<ScalarVector>(a[i] - max);
+    return max + log(sum);
+}
+
+// -----------------------------------------------------------------------
+// dot products
+// -----------------------------------------------------------------------
+
+template <class V>
+void DotKernel(const float* a, const float* b, size_t bStride, size_t numB, size_t n, float* results)
+{
+    typedef typename V::Vec Vec;
+    Vec acc[4] = {V::Set(0), V::Set(0), V::Set(0), V::Set(0)};
+    size_t i = 0;
+    for (; i + V::Width <= n; i += V::Width)
+    {
+        Vec x = V::Load(a + i);
+        for (size_t k = 0; k < numB; k++)
+            acc[k] = V::MulAdd(x, V::Load(b + k * bStride + i), acc[k]);
+    }
+    for (size_t k = 0; k < numB; k++)
+    {
+        float lanes[V::Width];
+        V::Store(lanes, acc[k]);
+        float sum = 0;
+        for (size_t j = 0; j < V::Width; j++)
+            sum += lanes[j];
+        for (size_t j = i; j < n; j++)
+            sum += a[j] * b[k * bStride + j];
+        results[k] = sum;
+    }
+}
+
+// -----------------------------------------------------------------------
+// lookup of the kernels by op, for CPUTensorKernels
+// -----------------------------------------------------------------------
+
+template <class V>
+CPUUnaryTensorKernel GetUnaryKernel(ElementWiseOperator op)
+{
+#define CaseUnaryKernel(oper)         \
+    case ElementWiseOperator::op##oper: \
+        return &UnaryKernel<V, KernelOp##oper>
+
+    switch (op)
+    {
+        ForAllKernelUnaryOps(CaseUnaryKernel);
+    default:
+        return nullptr;
+    }
+#undef CaseUnaryKernel
+}
+
+template <class V>
+CPUBinaryTensorKernel GetBinaryKernel(ElementWiseOperator op)
+{
+#define CaseBinaryKernel(oper)          \
+    case ElementWiseOperator::op##oper: \
+        return &BinaryKernel<V, KernelOp##oper>
+
+    switch (op)
+    {
+        ForAllKernelBinaryOps(CaseBinaryKernel);
+    default:
+        return nullptr;
+    }
+#undef CaseBinaryKernel
+}
+
+template <class V>
+CPUTernaryTensorKernel GetTernaryKernel(ElementWiseOperator op)
+{
+#define CaseTernaryKernel(oper)         \
+    case ElementWiseOperator::op##oper: \
+        return &TernaryKernel<V, KernelOp##oper>
+
+    switch (op)
+    {
+        ForAllKernelTernaryOps(CaseTernaryKernel);
+    default:
+        return nullptr;
+    }
+#undef CaseTernaryKernel
+}
+
+template <class V>
+CPUReductionTensorKernel GetReductionKernel(ElementWiseOperator reductionOp)
+{
+    switch (reductionOp)
+    {
+    case ElementWiseOperator::opSum:
+        return &SumReduction<V>;
+    case ElementWiseOperator::opLogSum:
+        return &LogSumReduction<V>;
+    case ElementWiseOperator::opMax:
+        return &MaxReduction<V>;
+    case ElementWiseOperator::opMin:
+        return &MinReduction<V>;
+    default:
+        return nullptr;
+    }
+}
+
+#undef ForAllKernelUnaryOps
+#undef ForAllKernelBinaryOps
+#undef ForAllKernelTernaryOps
+
+}}}}
@@ -0,0 +1,271 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE.md file in the project root for full license information.
+//
+// CPUThreadPool.cpp -- work-stealing thread pool for the parallel CPU loops
+//
+
+#include "stdafx.h"
+#include "CPUThreadPool.h"
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <exception>
+#include <mutex>
+#include <thread>
+#include <vector>
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
+namespace Microsoft { namespace MSR { namespace CNTK {
+
+// ranges per thread, so that threads that finish early can steal from the others
+static const size_t c_rangesPerThread = 4;
+// times an idle worker looks for work before it sleeps; consecutive ops come in quick succession
+static const int c_spinCount = 2000;
+
+// set on the workers and during ParallelFor(), so that nested loops run serially
+static thread_local bool t_inParallelFor = false;
+static thread_local size_t t_maxThreads = 0;
+
+struct CPUThreadPool::Impl
+{
+    // one ParallelFor() call
+    struct Job
+    {
+        RangeFn fn;
+        const void* body;
+        size_t remaining; // ranges not done yet, guarded by 'mutex'
+        std::mutex mutex;
+        std::condition_variable done;
+        std::exception_ptr exception;
+    };
+
+    struct Task
+    {
+        Job* job;
+        size_t begin, end;
+    };
+
+    // The owner takes tasks from the front, the other threads steal from the back.
+    struct WorkQueue
+    {
+        std::mutex mutex;
+        std::deque<Task> tasks;
+    };
+
+    size_t numThreads;
+    std::vector<std::unique_ptr<WorkQueue>> queues; // [0] is shared by the calling threads, [i] belongs to worker i
+    std::vector<std::thread> workers;
+    std::mutex startMutex;
+    std::atomic<size_t> numQueued;
+    std::mutex sleepMutex;
+    std::condition_variable wakeUp;
+    bool stop;
+
+    Impl()
+        : numQueued(0), stop(false)
+    {
+#ifdef _OPENMP
+        numThreads = omp_get_max_threads();
+#else
+        numThreads = std::max(1u, std::thread::hardware_concurrency());
+#endif
+    }
+
+    void Start()
+    {
+        std::lock_guard<std::mutex> lock(startMutex);
+        if (queues.size() == numThreads)
+            return;
+        stop = false;
+        queues.clear();
+        for (size_t i = 0; i < numThreads; i++)
+            queues.push_back(std::make_unique<WorkQueue>());
+        for (size_t i = 1; i < numThreads; i++)
+            workers.emplace_back([this, i]() { WorkerLoop(i); });
+    }
+
+    void Stop()
+    {
+        {
+            std::lock_guard<std::mutex> lock(sleepMutex);
+            stop = true;
+        }
+        wakeUp.notify_all();
+        for (auto& worker : workers)
+            worker.join();
+        workers.clear();
+        queues.clear();
+    }
+
+    void Push(size_t queueIndex, const Task& task)
+    {
+        WorkQueue& queue = *queues[queueIndex];
+        std::lock_guard<std::mutex> lock(queue.mutex);
+        queue.tasks.push_back(task);
+        numQueued++;
+    }
+
+    // from the front of the own queue, else from the back of another one
+    bool TryPop(size_t own, Task& task)
+    {
+        for (size_t k = 0; k < queues.size(); k++)
+        {
+            WorkQueue& queue = *queues[(own + k) % queues.size()];
+            std::lock_guard<std::mutex> lock(queue.mutex);
+            if (queue.tasks.empty())
+                continue;
+            if (k == 0)
+            {
+                task = queue.tasks.front();
+                queue.tasks.pop_front();
+            }
+            else
+            {
+                task = queue.tasks.back();
+                queue.tasks.pop_back();
+            }
+            numQueued--;
+            return true;
+        }
+        return false;
+    }
+
+    static void Execute(const Task& task)
+    {
+        Job& job = *task.job;
+        try
+        {
+            job.fn(job.body, task.begin, task.end);
+        }
+        catch (...)
+        {
+            std::lock_guard<std::mutex> lock(job.mutex);
+            if (!job.exception)
+                job.exception = std::current_exception();
+        }
+        // The job lives on the stack of the calling thread, which returns once it got the mutex after the last range.
+        std::lock_guard<std::mutex> lock(job.mutex);
+        if (--job.remaining == 0)
+            job.done.notify_all();
+    }
+
+    void WorkerLoop(size_t index)
+    {
+        t_inParallelFor = true;
+#ifdef _OPENMP
+        omp_set_num_threads(1);
+#endif
+        for (;;)
+        {
+            Task task;
+            bool found = false;
+            for (int spin = 0; spin < c_spinCount && !found; spin++)
+            {
+                found = numQueued > 0 && TryPop(index, task);
+                if (!found)
+                    std::this_thread::yield();
+            }
+            if (found)
+            {
+                Execute(task);
+                continue;
+            }
+
+            std::unique_lock<std::mutex> lock(sleepMutex);
+            wakeUp.wait(lock, [this]() { return stop || numQueued > 0; });
+            if (stop)
+                return;
+        }
+    }
+};
+
+CPUThreadPool& CPUThreadPool::Instance()
+{
+    // Never destroyed: joining threads while a DLL unloads can dead-lock, and the workers only wait at exit.
+    static CPUThreadPool* pool = new CPUThreadPool();
+    return *pool;
+}
+
+CPUThreadPool::CPUThreadPool()
+    : m_impl(new Impl())
+{
+}
+
+CPUThreadPool::~CPUThreadPool()
+{
+    m_impl->Stop();
+}
+
+size_t CPUThreadPool::NumThreads() const
+{
+    return m_impl->numThreads;
+}
+
+void CPUThreadPool::SetNumThreads(size_t numThreads)
+{
+    numThreads = std::max((size_t) 1, numThreads);
+    if (numThreads == m_impl->numThreads)
+        return;
+    m_impl->Stop();
+    m_impl->numThreads = numThreads;
+}
+
+void CPUThreadPool::SetThreadParallelism(size_t maxThreads)
+{
+    t_maxThreads = maxThreads;
+}
+
+bool CPUThreadPool::CanParallelize() const
+{
+    return !t_inParallelFor && m_impl->numThreads > 1 && t_maxThreads != 1;
+}
+
+void CPUThreadPool::Run(size_t n, size_t minGrain, RangeFn fn, const void* body)
+{
+    Impl& impl = *m_impl;
+    impl.Start();
+
+    // with a limit, one range per thread keeps the number of busy threads within it
+    size_t maxRanges = t_maxThreads > 0 ? std::min(t_maxThreads, impl.numThreads) : impl.numThreads * c_rangesPerThread;
+    size_t numRanges = std::min(n / std::max(minGrain, (size_t) 1), maxRanges);
+
+    Impl::Job job;
+    job.fn = fn;
+    job.body = body;
+    job.remaining = numRanges;
+    for (size_t r = 0; r < numRanges; r++)
+        impl.Push(r % impl.queues.size(), Impl::Task{&job, n * r / numRanges, n * (r + 1) / numRanges});
+    {
+        std::lock_guard<std::mutex> lock(impl.sleepMutex);
+    }
+    impl.wakeUp.notify_all();
+
+    // work along, then wait for the ranges taken by the workers
+    t_inParallelFor = true;
+    Impl::Task task;
+    for (;;)
+    {
+        {
+            std::lock_guard<std::mutex> lock(job.mutex);
+            if (job.remaining == 0)
+                break;
+        }
+        if (!impl.TryPop(0, task))
+            break;
+        Impl::Execute(task);
+    }
+    {
+        std::unique_lock<std::mutex> lock(job.mutex);
+        job.done.wait(lock, [&job]() { return job.remaining == 0; });
+    }
+    t_inParallelFor = false;
+
+    if (job.exception)
+        std::rethrow_exception(job.exception);
+}
+
+}}}
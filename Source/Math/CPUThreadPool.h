@@ -0,0 +1,72 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE.md file in the project root for full license information.
+//
+// CPUThreadPool.h -- the worker threads shared by the CPU math, the readers and the evaluation library
+//
+// OpenMP loops fork a team for every matrix, however small, and two threads running OpenMP loops at the
+// same time (e.g. the reader prefetch and the main thread) each fork a full team, plus MKL's own. All parallel
+// loops on CPUThreadPool share one set of workers that steal work from each other. Its size is set by
+// CPUMatrix<ElemType>::SetNumThreads(), together with OpenMP and MKL. Loop bodies must not call MKL, which is
+// parallel itself; OpenMP loops within them run single-threaded.
+//
+
+#pragma once
+
+#include "CommonMatrix.h" // for MATH_API
+#include <cstddef>
+#include <memory>
+
+namespace Microsoft { namespace MSR { namespace CNTK {
+
+class MATH_API CPUThreadPool
+{
+public:
+    static CPUThreadPool& Instance();
+
+    // the threads that work on a ParallelFor(), counting the calling thread
+    size_t NumThreads() const;
+    // Restarts the workers; must not be called while a ParallelFor() runs. CPUMatrix::SetNumThreads() calls this.
+    void SetNumThreads(size_t numThreads);
+
+    // Limits the ParallelFor() calls of the calling thread to 'maxThreads' threads (0: no limit), like
+    // omp_set_num_threads(), e.g. for a reader configured with numCPUThreads.
+    static void SetThreadParallelism(size_t maxThreads);
+
+    // Calls body(begin, end) on ranges that partition [0, n), with the workers and the calling thread, and returns
+    // when all are done. Ranges are at least 'minGrain' long, so that the cost of distributing them is small against
+    // the work; below 2 * minGrain, and when called from within a ParallelFor(), body(0, n) is called directly.
+    // The first exception thrown by body is rethrown after all ranges are done.
+    template <class Body>
+    void ParallelFor(size_t n, size_t minGrain, const Body& body)
+    {
+        if (n == 0)
+            return;
+        if (n < 2 * minGrain || !CanParallelize())
+            body((size_t) 0, n);
+        else
+            Run(n, minGrain, &CallBody<Body>, &body);
+    }
+
+    ~CPUThreadPool();
+
+private:
+    CPUThreadPool();
+    CPUThreadPool(const CPUThreadPool&) = delete;
+    CPUThreadPool& operator=(const CPUThreadPool&) = delete;
+
+    typedef void (*RangeFn)(const void* body, size_t begin, size_t end);
+    template <class Body>
+    static void CallBody(const void* body, size_t begin, size_t end)
+    {
+        (*static_cast<const Body*>(body))(begin, end);
+    }
+
+    bool CanParallelize() const;
+    void Run(size_t n, size_t minGrain, RangeFn fn, const void* body);
+
+    struct Impl;
+    std::unique_ptr<Impl> m_impl;
+};
+
+}}}
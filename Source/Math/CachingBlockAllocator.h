@@ -0,0 +1,237 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE.md file in the project root for full license information.
+//
+// CachingBlockAllocator.h -- keeps freed memory blocks in size-binned free lists for reuse
+//
+// This is used by TracingGPUMemoryAllocator to avoid a cudaMalloc()/cudaFree() pair (both of which synchronize the
+// device) each time a matrix is resized. Free lists are kept per stream: a block freed by work on one stream may be
+// handed out again right away for work on the same stream, since the stream orders the new work after the old.
+// Blocks are never moved between streams; EmptyCache() returns all cached blocks to the underlying allocator.
+// While a reservation is open, freed blocks are held for it instead, e.g. because a recorded GPU graph keeps using
+// them as temporaries when it is replayed; they return to the cache when the reservation is released.
+// The class itself does not depend on CUDA; the raw allocation functions are passed in.
+//
+
+#pragma once
+
+#include <cstddef>
+#include <functional>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <stdexcept>
+#include <unordered_map>
+#include <vector>
+
+namespace Microsoft { namespace MSR { namespace CNTK {
+
+class CachingBlockAllocator
+{
+public:
+    typedef const void* StreamKey; // e.g. a cudaStream_t
+
+    // raw allocation must return nullptr (not throw) if memory is exhausted
+    typedef std::function<void*(size_t /*bytes*/)> RawAllocateFunction;
+    typedef std::function<void(void*)> RawFreeFunction;
+
+    struct Statistics
+    {
+        size_t m_numRequests = 0;          // calls to Allocate()
+        size_t m_numCacheHits = 0;         // ... that were served from a free list
+        size_t m_numRawAllocations = 0;    // calls to the underlying allocator
+        size_t m_numRawFrees = 0;
+        size_t m_inUseBytes = 0;           // bytes of blocks currently handed out
+        size_t m_requestedBytes = 0;       // bytes actually requested for these blocks
+        size_t m_cachedBytes = 0;          // bytes of free blocks held in the cache
+        size_t m_reservedBytes = 0;        // bytes of freed blocks held for reservations
+
+        double HitRate() const { return m_numRequests > 0 ? (double)m_numCacheHits / m_numRequests : 0.0; }
+
+        // fraction of the reserved memory (in use + cached) that does not hold requested data
+        double Fragmentation() const
+        {
+            size_t reservedBytes = m_inUseBytes + m_cachedBytes;
+            return reservedBytes > 0 ? 1.0 - (double)m_requestedBytes / reservedBytes : 0.0;
+        }
+    };
+
+    // Requests up to 1 MB are rounded to multiples of 512 bytes, larger ones to multiples of 128 KB.
+    // A cached block is reused for a request if it is less than twice the rounded size.
+    static const size_t SmallBlockGranularity = 512;
+    static const size_t LargeBlockThreshold = 1 << 20;
+    static const size_t LargeBlockGranularity = 128 << 10;
+    static const size_t MaxOversizeFactor = 2;
+
+    CachingBlockAllocator(RawAllocateFunction rawAllocate, RawFreeFunction rawFree)
+        : m_rawAllocate(rawAllocate), m_rawFree(rawFree)
+    {
+    }
+
+    ~CachingBlockAllocator()
+    {
+        // blocks still in use belong to their owners; we can only release what is cached
+        EmptyCache();
+    }
+
+    static size_t RoundedSize(size_t bytes)
+    {
+        size_t granularity = SmallBlockGranularity;
+        if (bytes >= LargeBlockThreshold)
+            granularity = LargeBlockGranularity;
+        return bytes == 0 ? granularity : (bytes + granularity - 1) / granularity * granularity;
+    }
+
+    // returns nullptr if the underlying allocator failed even after emptying the cache
+    void* Allocate(size_t bytes, StreamKey stream)
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_statistics.m_numRequests++;
+
+        size_t blockSize = RoundedSize(bytes);
+        void* ptr = nullptr;
+
+        auto& freeBlocks = m_freeBlocks[stream];
+        auto hint = freeBlocks.lower_bound(blockSize);
+        if (hint != freeBlocks.end() && hint->first < blockSize * MaxOversizeFactor)
+        {
+            blockSize = hint->first;
+            ptr = hint->second;
+            freeBlocks.erase(hint);
+            m_statistics.m_cachedBytes -= blockSize;
+            m_statistics.m_numCacheHits++;
+        }
+        else
+        {
+            ptr = m_rawAllocate(blockSize);
+            if (!ptr) // out of memory: give back what we hold and try once more
+            {
+                EmptyCacheNoLock();
+                ptr = m_rawAllocate(blockSize);
+                if (!ptr)
+                    return nullptr;
+            }
+            m_statistics.m_numRawAllocations++;
+        }
+
+        m_liveBlocks[ptr] = BlockInfo{ blockSize, bytes, stream };
+        m_statistics.m_inUseBytes += blockSize;
+        m_statistics.m_requestedBytes += bytes;
+        return ptr;
+    }
+
+    // returns false if 'ptr' was not allocated here (the caller must free it by other means)
+    bool Free(void* ptr)
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        auto iter = m_liveBlocks.find(ptr);
+        if (iter == m_liveBlocks.end())
+            return false;
+
+        const auto& block = iter->second;
+        if (m_reservation)
+        {
+            m_reservation->m_blocks.push_back(ReservedBlock{ ptr, block.m_size, block.m_stream });
+            m_statistics.m_reservedBytes += block.m_size;
+        }
+        else
+        {
+            m_freeBlocks[block.m_stream].insert(std::make_pair(block.m_size, ptr));
+            m_statistics.m_cachedBytes += block.m_size;
+        }
+        m_statistics.m_inUseBytes -= block.m_size;
+        m_statistics.m_requestedBytes -= block.m_requestedSize;
+        m_liveBlocks.erase(iter);
+        return true;
+    }
+
+    struct ReservedBlock
+    {
+        void* m_ptr;
+        size_t m_size;
+        StreamKey m_stream;
+    };
+    struct Reservation
+    {
+        std::vector<ReservedBlock> m_blocks;
+    };
+
+    // blocks freed from now on until EndReservation() are not reused
+    void BeginReservation()
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        if (m_reservation)
+            throw std::logic_error("CachingBlockAllocator: A reservation is already open.");
+        m_reservation.reset(new Reservation());
+    }
+
+    // returns the blocks freed since BeginReservation(); they stay unused until ReleaseReservation()
+    Reservation EndReservation()
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        if (!m_reservation)
+            throw std::logic_error("CachingBlockAllocator: No reservation is open.");
+        Reservation reservation = std::move(*m_reservation);
+        m_reservation.reset();
+        return reservation;
+    }
+
+    // hands the blocks of a reservation to the cache
+    void ReleaseReservation(Reservation&& reservation)
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        for (const auto& block : reservation.m_blocks)
+        {
+            m_freeBlocks[block.m_stream].insert(std::make_pair(block.m_size, block.m_ptr));
+            m_statistics.m_reservedBytes -= block.m_size;
+            m_statistics.m_cachedBytes += block.m_size;
+        }
+        reservation.m_blocks.clear();
+    }
+
+    // release all cached (free) blocks to the underlying allocator
+    void EmptyCache()
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        EmptyCacheNoLock();
+    }
+
+    Statistics GetStatistics() const
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        return m_statistics;
+    }
+
+private:
+    struct BlockInfo
+    {
+        size_t m_size;          // rounded size of the block
+        size_t m_requestedSize; // size the current owner asked for
+        StreamKey m_stream;     // stream whose free list the block returns to
+    };
+
+    void EmptyCacheNoLock()
+    {
+        for (auto& streamBlocks : m_freeBlocks)
+        {
+            for (auto& block : streamBlocks.second)
+            {
+                m_rawFree(block.second);
+                m_statistics.m_numRawFrees++;
+            }
+        }
+        m_freeBlocks.clear();
+        m_statistics.m_cachedBytes = 0;
+    }
+
+    RawAllocateFunction m_rawAllocate;
+    RawFreeFunction m_rawFree;
+
+    std::unordered_map<StreamKey, std::multimap<size_t, void*>> m_freeBlocks; // [stream] -> (block size -> block)
+    std::unordered_map<void*, BlockInfo> m_liveBlocks;                        // blocks currently handed out
+    std::unique_ptr<Reservation> m_reservation;                               // the open reservation, if any
+    Statistics m_statistics;
+    mutable std::mutex m_mutex;
+};
+
+}}}
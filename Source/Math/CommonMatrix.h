@@ -15,6 +15,7 @@
 
 #include "Basics.h"
 #include "basetypes.h"
+#include "CachingBlockAllocator.h"
 #include <string>
 #include <stdint.h>
 #include <memory>
@@ -48,15 +49,30 @@ namespace Microsoft { namespace MSR { namespace CNTK {
 MATH_API void SetMathLibTraceLevel(int traceLevel);
 MATH_API int GetMathLibTraceLevel();
 
+// With half-precision GEMM enabled, GPU products of float matrices convert their operands to fp16 and accumulate
+// the products in fp32, on tensor cores where available. The matrices themselves stay in fp32.
+MATH_API void EnableHalfPrecisionGEMM(bool enable);
+MATH_API bool IsHalfPrecisionGEMMEnabled();
+
 class MATH_API TracingGPUMemoryAllocator
 {
 private:
     static int m_traceLevel;
+    static bool m_cachingEnabled;
 
 public:
     static void SetTraceLevel(int traceLevel);
     static bool IsTraceEnabled();
 
+    // With caching enabled, freed device memory is kept in per-device, per-stream free lists and reused
+    // by later allocations on the same stream instead of going through cudaFree()/cudaMalloc().
+    // See CachingBlockAllocator.h. If an allocation fails, the device's cache is emptied and the allocation retried.
+    static void SetCachingEnabled(bool enable);
+    static bool IsCachingEnabled();
+    // return all cached device memory of this device to CUDA
+    static void EmptyCache(int deviceId);
+    static CachingBlockAllocator::Statistics GetCachingStatistics(int deviceId);
+
     template <typename AllocatedElemType>
     static AllocatedElemType* Allocate(int deviceId, size_t numRows, size_t numCols);
 
@@ -88,6 +104,8 @@ enum ElementWiseOperator
     opCopy,
     opNegate, opNot, opAbs, opFloor, opReciprocal,
     opSigmoid, opTanh, opSqr, opSqrt, opExp, opLog, opLinearRectifier, opCosine, opSin,
+    // approximations of the above for inference, see FastMathOpOf()
+    opFastSigmoid, opFastTanh, opFastExp, opFastLog,
     // unary ops for use by Matrix class only (there is no TensorView implementation)
     opSigmoidDerivative, opLinearRectifierDerivative, opNegativeSine,
     // binary
@@ -111,6 +129,20 @@ enum ElementWiseOperator
     // Note: not all that's implemented in CNTK ComputationNodes has an opcode yet.
 };
 
+// The op that computes 'op' approximately, within the bounds given with FastExp() in TensorOps.h, or 'op' itself
+// if it has no approximation. Used by the fast-math inference mode, see ComputationNetwork::EnableFastMath().
+static inline ElementWiseOperator FastMathOpOf(ElementWiseOperator op)
+{
+    switch (op)
+    {
+    case opSigmoid: return opFastSigmoid;
+    case opTanh:    return opFastTanh;
+    case opExp:     return opFastExp;
+    case opLog:     return opFastLog;
+    default:        return op;
+    }
+}
+
 // helper to apply a C macro for all operations of each kind
 #define ForAllNullaryOps(Macro) \
     Macro(ConstOne);
@@ -130,7 +162,11 @@ enum ElementWiseOperator
     Macro(Log);               \
     Macro(LinearRectifier);   \
     Macro(Cosine);            \
-    Macro(Sin);
+    Macro(Sin);               \
+    Macro(FastSigmoid);       \
+    Macro(FastTanh);          \
+    Macro(FastExp);           \
+    Macro(FastLog);
 
 #define ForAllBinaryOps(Macro)                                        \
     Macro(CopyIf);                                                    \
@@ -171,6 +207,59 @@ enum ElementWiseOperator
     Macro(ElementwiseProductWithLogSumDerivative);      \
     Macro(ElementwiseProductWithExpOfDiff);
 
+// -----------------------------------------------------------------------
+// FusedElementwiseProgram -- a chain of elementwise operations that Matrix::FusedElementwiseOp() computes
+// in a single pass over memory, instead of one TensorOp per operation with all intermediate results in memory.
+// Values are numbered: [0, numInputs) are the inputs, numInputs + k is the result of step k. The last step's
+// result is the output. This is passed by value to CUDA kernels, so it must remain a POD.
+// -----------------------------------------------------------------------
+
+struct FusedElementwiseStep
+{
+    ElementWiseOperator op; // a unary, binary, or ternary op
+    int arity;              // 1, 2, or 3
+    int args[3];            // value numbers of the arguments
+};
+
+struct FusedElementwiseProgram
+{
+    static const int MaxInputs = 8;
+    static const int MaxSteps = 16;
+
+    int numInputs;
+    int numSteps;
+    FusedElementwiseStep steps[MaxSteps];
+};
+
+// -----------------------------------------------------------------------
+// CRFSequence -- one sequence of a minibatch for the batched R-CRF functions (Matrix::RCRFForwardBackward() etc.)
+// Frame t of the sequence is column (tBegin + t) * numParallelSequences + s, as laid out by an MBLayout.
+// This is copied to the GPU as is, so it must remain a POD.
+// -----------------------------------------------------------------------
+
+struct CRFSequence
+{
+    int s;         // parallel-sequence index
+    int tBegin;    // time step of the first frame
+    int numFrames; // sequence length
+};
+
+// -----------------------------------------------------------------------
+// UpdateRegularization -- the regularization that the multi-tensor updates (Matrix::MultiNormalGrad() etc.) apply in their
+// pass over a parameter w with gradient g: g + l2Weight * w is the gradient of the update, w decays by weightDecay * w besides
+// the update (decoupled weight decay, already scaled by the learning rate), and the proximal step of L1 regularization
+// w = sign(w) * max(|w| - l1Threshold, 0) follows it. Zeros disable them.
+// This is passed by value to CUDA kernels, so it must remain a POD.
+// -----------------------------------------------------------------------
+
+template <class ElemType>
+struct UpdateRegularization
+{
+    ElemType l2Weight;
+    ElemType weightDecay;
+    ElemType l1Threshold;
+};
+
 // -----------------------------------------------------------------------
 // various enums to describe
 // -----------------------------------------------------------------------
@@ -232,6 +232,9 @@ __device__ double round_(double a)
 // and image should populate that location, computes the subset of the image
 // corresponding to the ROI and which pixels in that subset should go into the
 // output location, then takes the max value over that window.
+// The locations are enumerated by image, then channel, then ROI (and bin within the ROI), so that
+// consecutive blocks pool all the ROIs of an image from the same channel, which stays in the cache,
+// rather than reading all channels of each ROI in turn.
 // src: Images              [W x H x C x N]
 // roiData: ROIs            [4 x numROIs x N], 
 // dst: Pooled ROIs         [PW x PH x C x numROIs x N]
@@ -248,22 +251,23 @@ __global__ void kROIPoolingForward(const int totalIterations,
     for (int index = blockIdx.x * blockDim.x + threadIdx.x;
          index < (totalIterations); index += blockDim.x * gridDim.x) 
     {
-        
-        // output is [W x H x C x N]
+        // (imgIdx, c, roiN, ph, pw), from the slowest to the fastest varying.
+        int pw     =  index % pooledWidth;
+        int ph     = (index / pooledWidth) % pooledHeight;
+        int roiN   = (index / pooledWidth  / pooledHeight) % numROIs;
+        int c      = (index / pooledWidth  / pooledHeight  / numROIs) % channels;
+        int imgIdx =  index / pooledWidth  / pooledHeight  / numROIs  / channels;
         // n is the global ROI index (the new batch index)
-        int pw =  index % pooledWidth;
-        int ph = (index / pooledWidth) % pooledHeight;
-        int c  = (index / pooledWidth  / pooledHeight) % channels;
-        int n  =  index / pooledWidth  / pooledHeight  / channels;
+        int n = imgIdx * numROIs + roiN;
 
         // each ROI is 4 elements: (x, y, w, h)
-        roiData += n * 4;
+        const ElemType* roi = roiData + n * 4;
 
         // roi data is relative to original image size
-        int roiStartW = (int)(    round_(roiData[0] * width));
-        int roiStartH = (int)(    round_(roiData[1] * height));
-        int roiWidth  = (int)(max(round_(roiData[2] * width),  (ElemType)1));
-        int roiHeight = (int)(max(round_(roiData[3] * height), (ElemType)1));
+        int roiStartW = (int)(    round_(roi[0] * width));
+        int roiStartH = (int)(    round_(roi[1] * height));
+        int roiWidth  = (int)(max(round_(roi[2] * width),  (ElemType)1));
+        int roiHeight = (int)(max(round_(roi[3] * height), (ElemType)1));
         
         ElemType winH = (ElemType)roiHeight / (ElemType)pooledHeight;
         ElemType winW = (ElemType)roiWidth / (ElemType)pooledWidth;
@@ -285,29 +289,31 @@ __global__ void kROIPoolingForward(const int totalIterations,
         ElemType maxval = isempty ? (ElemType)0 : -CUDART_INF_F;
         int maxidx = -1;
 
-        int imgIdx = n / numROIs;
-        src += (imgIdx * channels + c) * height * width;
+        const ElemType* channelSrc = src + (imgIdx * channels + c) * height * width;
         for (int h = hstart; h < hend; h++)
         {
             for (int w = wstart; w < wend; w++)
             {
                 int srcIndex = w + h * width;
-                if (src[srcIndex] > maxval)
+                if (channelSrc[srcIndex] > maxval)
                 {
-                    maxval = src[srcIndex];
+                    maxval = channelSrc[srcIndex];
                     maxidx = srcIndex;
                 }
             }
         }
-        dst[index] = maxval;
-        argmax[index] = maxidx;
+        int dstIndex = ((n * channels + c) * pooledHeight + ph) * pooledWidth + pw;
+        dst[dstIndex] = maxval;
+        argmax[dstIndex] = maxidx;
     }
 }
 
-// The kernel operates on one location in the input to the ROIPoolingNode (one image location).
-// It loops over the ROIs corresponding to that image, seeing which ones could contain the location
-// in their output. For each ROI, it checks the argmax data to see if that ROI indeed chose
-// this pixel location as the maximum. If so, it increments the gradient term for the input location.
+// The kernel operates on one location in the output of the ROIPoolingNode, and adds its gradient
+// to the input location that the forward pass chose as the maximum (stored in argmax).
+// The cost is thus proportional to the size of the output, while finding the output locations
+// of an input location would mean checking all the ROIs of its image. Locations are enumerated as
+// in kROIPoolingForward. The bins of an ROI are disjoint but for their borders, so the threads of a warp
+// seldom add to the same input location, only overlapping ROIs do, from different warps.
 template <typename ElemType>
 __global__ void kROIPoolingBackward(const int totalIterations,
     const int numROIs, const int numImg,
@@ -315,70 +321,23 @@ __global__ void kROIPoolingBackward(const int totalIterations,
     const int pooledWidth, const int pooledHeight, const ElemType* pooledGrad,
     const ElemType* roiData, ElemType* grad, const ElemType* argmax)
 {
-    // index loops over all input locations (locations in the original input tensor).
+    // index loops over all totalRois*c*pooledHeight*pooledWidth output locations.
     for (int index = blockIdx.x * blockDim.x + threadIdx.x;
-        index < (totalIterations); index += blockDim.x * gridDim.x)
+         index < (totalIterations); index += blockDim.x * gridDim.x)
     {
-        // images are laid out [W x H x C x N]
-        // (n, c, h, w) is an element in the input image
-        int w =  index % width;
-        int h = (index / width) % height;
-        int c = (index / width  / height) % channels;
-        int n =  index / width  / height  / channels;
-
-        // compute range of ROIs corresponding to this image:
-        int roiMin = n * numROIs;
-        int roiMax = (n + 1) * numROIs;
-
-        ElemType gradient = 0;
-
-        for (int roiN = roiMin; roiN < roiMax; roiN++)
-        {
-            // each ROI is 4 elements: (x, y, w, h)
-            const ElemType* roiOffset = roiData + roiN * 4;
-
-            // ROI data is relative to original image size
-            int roiStartW = (int)(    round_(roiOffset[0] * width));
-            int roiStartH = (int)(    round_(roiOffset[1] * height));
-            int roiWidth  = (int)(max(round_(roiOffset[2] * width), 1.0));
-            int roiHeight = (int)(max(round_(roiOffset[3] * height), 1.0));
-
-            // skip this ROI if it doesn't contain our input location.
-            const bool inROI = (w >= roiStartW && w < roiStartW + roiWidth &&
-                                h >= roiStartH && h < roiStartH + roiHeight);
-            if (!inROI)
-                continue;
-
-            ElemType winH = (ElemType)roiHeight / (ElemType)pooledHeight;
-            ElemType winW = (ElemType)roiWidth  / (ElemType)pooledWidth;
-
-            // what pooled nodes in the output for this ROI could have pooled this input location?
-            // we use int here since the computation can yield a negative result
-            int phstart = (int)(      (float)(h - roiStartH)     / winH);
-            int pwstart = (int)(      (float)(w - roiStartW)     / winW);
-            int phend   = (int)(ceilf((float)(h - roiStartH + 1) / winH));
-            int pwend   = (int)(ceilf((float)(w - roiStartW + 1) / winW));
-
-            phstart = min(max(phstart, 0), pooledHeight);
-            pwstart = min(max(pwstart, 0), pooledWidth);
-            phend   = min(max(phend, 0), pooledHeight);
-            pwend   = min(max(pwend, 0), pooledWidth);
-
-            // go right up to this channel of this ROI.
-            int offset = (roiN * channels + c) * pooledWidth * pooledHeight;
-            const ElemType* offsetPoolGrad = pooledGrad + offset;
-            const ElemType* offsetArgmax = argmax + offset;
-
-            for (int ph = phstart; ph < phend; ph++)
-            {
-                for (int pw = pwstart; pw < pwend; pw++)
-                {
-                    if ((int)offsetArgmax[ph * pooledWidth + pw] == (h * width + w))
-                        gradient += offsetPoolGrad[ph * pooledWidth + pw];
-                }
-            }
-        }
-        grad[index] = gradient;
+        int pw     =  index % pooledWidth;
+        int ph     = (index / pooledWidth) % pooledHeight;
+        int roiN   = (index / pooledWidth  / pooledHeight) % numROIs;
+        int c      = (index / pooledWidth  / pooledHeight  / numROIs) % channels;
+        int imgIdx =  index / pooledWidth  / pooledHeight  / numROIs  / channels;
+        int n = imgIdx * numROIs + roiN;
+
+        int srcIndex = ((n * channels + c) * pooledHeight + ph) * pooledWidth + pw;
+        // argmax is relative to the channel; empty bins have none.
+        int maxidx = (int)argmax[srcIndex];
+        if (maxidx < 0)
+            continue;
+        atomicAdd(&grad[(imgIdx * channels + c) * height * width + maxidx], pooledGrad[srcIndex]);
     }
 }
 
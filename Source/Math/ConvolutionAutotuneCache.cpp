@@ -0,0 +1,91 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE.md file in the project root for full license information.
+//
+// ConvolutionAutotuneCache.cpp -- the convolution engines and cuDNN algorithms picked by benchmarking, kept across processes
+//
+
+#include "stdafx.h"
+#include "ConvolutionAutotuneCache.h"
+#include "CuDnnFactories.h"
+#include "fileutil.h"
+#include <cstring>
+
+namespace Microsoft { namespace MSR { namespace CNTK {
+
+/*static*/ ConvolutionAutotuneCache& ConvolutionAutotuneCache::Instance()
+{
+    static ConvolutionAutotuneCache s_instance;
+    return s_instance;
+}
+
+void ConvolutionAutotuneCache::SetEngineAutotuning(bool enable)
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_engineAutotuning = enable;
+}
+
+bool ConvolutionAutotuneCache::IsEngineAutotuningEnabled() const
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return m_engineAutotuning;
+}
+
+void ConvolutionAutotuneCache::SetFile(const std::wstring& path)
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_path = path;
+    if (m_path.empty() || !fexists(m_path))
+        return;
+
+    FILE* f = fopenOrDie(m_path, L"r");
+    char line[4096];
+    size_t numEntries = 0;
+    while (fgets(line, sizeof(line), f) != nullptr)
+    {
+        size_t len = strlen(line);
+        while (len > 0 && (line[len - 1] == '\n' || line[len - 1] == '\r'))
+            line[--len] = 0;
+        const char* tab = strchr(line, '\t');
+        if (tab == nullptr) // e.g. a line cut off by a process that was killed while appending
+            continue;
+        m_entries[std::string(line, tab - line)] = tab + 1;
+        numEntries++;
+    }
+    fcloseOrDie(f);
+
+    if (GetMathLibTraceLevel() > 0)
+        fprintf(stderr, "Read %d convolution autotuning results from %ls.\n", (int) numEntries, m_path.c_str());
+}
+
+bool ConvolutionAutotuneCache::TryGet(const std::string& key, std::string& value) const
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    auto found = m_entries.find(key);
+    if (found == m_entries.end())
+        return false;
+    value = found->second;
+    return true;
+}
+
+void ConvolutionAutotuneCache::Set(const std::string& key, const std::string& value)
+{
+    if (key.find_first_of("\t\r\n") != std::string::npos || value.find_first_of("\r\n") != std::string::npos)
+        LogicError("ConvolutionAutotuneCache: Keys must not contain tabs or line breaks, values no line breaks.");
+
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_entries[key] = value;
+    if (m_path.empty())
+        return;
+
+    FILE* f = fopenOrDie(m_path, L"a");
+    fprintf(f, "%s\t%s\n", key.c_str(), value.c_str());
+    fcloseOrDie(f);
+}
+
+/*static*/ std::string ConvolutionAutotuneCache::DeviceDescription(DEVICEID_TYPE deviceId)
+{
+    return deviceId < 0 ? "CPU" : CuDnnDeviceDescription(deviceId);
+}
+
+}}}
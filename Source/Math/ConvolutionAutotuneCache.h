@@ -0,0 +1,55 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE.md file in the project root for full license information.
+//
+// ConvolutionAutotuneCache.h -- the convolution engines and cuDNN algorithms picked by benchmarking, kept across processes
+//
+
+#pragma once
+
+#include "CommonMatrix.h" // for MATH_API, DEVICEID_TYPE
+#include <string>
+#include <map>
+#include <mutex>
+
+namespace Microsoft { namespace MSR { namespace CNTK {
+
+// ConvolutionEngine::Create() can benchmark all engines that support a geometry and keep the fastest, and the
+// cuDNN engine benchmarks its algorithms for each minibatch size it sees. The winners are recorded here under keys
+// that name the device (CPU, or GPU model and cuDNN version), the geometry and the other tuning parameters.
+// With a cache file, the entries are read from it when it is set and new ones are appended to it, so that restarts
+// and evaluation jobs skip the tuning. Lines are "key<TAB>value"; later lines override earlier ones, so the file
+// can be shared by several processes.
+class MATH_API ConvolutionAutotuneCache
+{
+public:
+    static ConvolutionAutotuneCache& Instance();
+
+    // Enables benchmarking the engines in ConvolutionEngine::Create(); without it, the first eligible engine is used.
+    void SetEngineAutotuning(bool enable);
+    bool IsEngineAutotuningEnabled() const;
+
+    // Reads the entries of 'path' if it exists, and appends new ones to it. Empty: keep them in memory only.
+    void SetFile(const std::wstring& path);
+
+    bool TryGet(const std::string& key, std::string& value) const;
+    void Set(const std::string& key, const std::string& value);
+
+    // "CPU", or the name of the GPU and the cuDNN version, for the keys
+    static std::string DeviceDescription(DEVICEID_TYPE deviceId);
+
+private:
+    ConvolutionAutotuneCache()
+        : m_engineAutotuning(false)
+    {
+    }
+    ConvolutionAutotuneCache(const ConvolutionAutotuneCache&) = delete;
+    ConvolutionAutotuneCache& operator=(const ConvolutionAutotuneCache&) = delete;
+
+    mutable std::mutex m_mutex;
+    std::map<std::string, std::string> m_entries;
+    std::wstring m_path;
+    bool m_engineAutotuning;
+};
+
+}}}
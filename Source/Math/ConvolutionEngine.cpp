@@ -5,7 +5,10 @@
 
 #include "stdafx.h"
 #include "ConvolutionEngine.h"
+#include "ConvolutionAutotuneCache.h"
 #include "CuDnnFactories.h"
+#include <chrono>
+#include <sstream>
 
 namespace Microsoft { namespace MSR { namespace CNTK {
 
@@ -848,6 +851,427 @@ public:
     }
 };
 
+//------------------------------------------------------------------
+// Direct convolution engine implementation.
+// Computes 2D convolutions and poolings of CHW images on the CPU directly from the inputs, so unlike
+// the GEMM engine it needs no unrolled copy of them (and no temp memory at all).
+// Uses reference engine for max unpooling.
+//------------------------------------------------------------------
+template <class ElemType>
+class DirectConvolutionEngine : public ReferenceConvolutionEngine<ElemType>
+{
+public:
+    using Base = ReferenceConvolutionEngine<ElemType>;
+    using typename Base::Mat;
+
+public:
+    DirectConvolutionEngine(ConvolveGeometryPtr geometry, DEVICEID_TYPE deviceId, ImageLayoutKind imageLayout, size_t maxTempMemSizeInSamples, PoolKind poolKind)
+        : Base(geometry, deviceId, imageLayout, maxTempMemSizeInSamples, poolKind)
+    {
+        // Unsupported geometries are reported by EnsureCompatible, if the engine is actually used.
+        if (!IsSupported(deviceId, geometry, poolKind))
+            return;
+
+        const auto& inT = geometry->InputShape();
+        const auto& outT = geometry->OutputShape();
+        const auto& kernT = geometry->KernelShape();
+        m_inW = (int)inT[0];
+        m_inH = (int)inT[1];
+        m_inC = (int)inT[2];
+        m_outW = (int)outT[0];
+        m_outH = (int)outT[1];
+        m_outC = (int)outT[2];
+        m_kW = (int)kernT[0];
+        m_kH = (int)kernT[1];
+        m_strideX = (int)geometry->GetStride(0);
+        m_strideY = (int)geometry->GetStride(1);
+        m_padX = geometry->GetLowerPad(0);
+        m_padY = geometry->GetLowerPad(1);
+    }
+
+protected:
+    using Base::IsGpu;
+
+    using Base::m_geometry;
+    using Base::m_deviceId;
+    using Base::m_imageLayout;
+    using Base::m_poolKind;
+
+    void EnsureCompatible() override
+    {
+        if (m_imageLayout != ImageLayoutKind::CHW)
+            LogicError("Direct convolution engine supports only CHW/cudnn layout.");
+        if (!IsSupported(m_deviceId, m_geometry, m_poolKind))
+            LogicError("Direct convolution engine supports only 2D convolutions with full sharing and 2D poolings on the CPU. Geometry: %s", ((string)*m_geometry).c_str());
+    }
+
+    void EnsureConvolutionInitialized() override
+    {
+    }
+
+    // The notation is the one of the GEMM engine: the input is [WHC x N], the output [W'H'K x N] and the kernel
+    // weights are a row-major [K x XYC] matrix, where X, Y are the width and height of the kernel.
+    // Each (sample, block of output maps) is computed by one thread, as a sum over the input channels and the kernel
+    // offsets of the (strided) input rows scaled by the weight, so that the innermost loop runs along an output row.
+    void ForwardCore(const Mat& in, const Mat& kernel, Mat& out, Mat& /*workspace*/) override
+    {
+        const ElemType* src = in.Data();
+        const ElemType* weights = kernel.Data();
+        ElemType* dst = out.Data();
+        int64_t blockCount = (m_outC + MapBlockSize - 1) / MapBlockSize;
+        int64_t itemCount = (int64_t)in.GetNumCols() * blockCount;
+
+#pragma omp parallel for
+        for (int64_t item = 0; item < itemCount; item++)
+        {
+            int64_t sample = item / blockCount;
+            int k0 = (int)(item % blockCount) * MapBlockSize;
+            int kCount = min(MapBlockSize, m_outC - k0);
+            const ElemType* sampleIn = src + sample * InSize();
+            ElemType* mapsOut = dst + sample * OutSize() + (size_t)k0 * OutPlaneSize();
+            std::fill(mapsOut, mapsOut + (size_t)kCount * OutPlaneSize(), (ElemType)0);
+
+            for (int c = 0; c < m_inC; c++)
+            {
+                for (int ky = 0; ky < m_kH; ky++)
+                {
+                    int oyBegin, oyEnd;
+                    ValidRange(ky - m_padY, m_strideY, m_inH, m_outH, oyBegin, oyEnd);
+                    for (int kx = 0; kx < m_kW; kx++)
+                    {
+                        int oxBegin, oxEnd;
+                        ValidRange(kx - m_padX, m_strideX, m_inW, m_outW, oxBegin, oxEnd);
+                        size_t iwht = ((size_t)c * m_kH + ky) * m_kW + kx;
+                        for (int kb = 0; kb < kCount; kb++)
+                        {
+                            ElemType w = weights[(k0 + kb) * KernelSize() + iwht];
+                            ElemType* mapOut = mapsOut + (size_t)kb * OutPlaneSize();
+                            for (int oy = oyBegin; oy < oyEnd; oy++)
+                            {
+                                const ElemType* rowIn = sampleIn + ((size_t)c * m_inH + oy * m_strideY + ky - m_padY) * m_inW;
+                                ElemType* rowOut = mapOut + (size_t)oy * m_outW;
+                                for (int ox = oxBegin; ox < oxEnd; ox++)
+                                    rowOut[ox] += w * rowIn[ox * m_strideX + kx - m_padX];
+                            }
+                        }
+                    }
+                }
+            }
+        }
+    }
+
+    // The transpose of the forward pass: each (sample, input channel) is computed by one thread,
+    // which scatters the output gradient rows scaled by the weights back to the (strided) input rows.
+    void BackwardDataCore(const Mat& srcGrad, const Mat& kernel, Mat& grad, bool /*accumulateGradient*/, Mat& /*workspace*/) override
+    {
+        const ElemType* src = srcGrad.Data();
+        const ElemType* weights = kernel.Data();
+        ElemType* dst = grad.Data();
+        int64_t itemCount = (int64_t)srcGrad.GetNumCols() * m_inC;
+
+#pragma omp parallel for
+        for (int64_t item = 0; item < itemCount; item++)
+        {
+            int64_t sample = item / m_inC;
+            int c = (int)(item % m_inC);
+            const ElemType* sampleOutGrad = src + sample * OutSize();
+            ElemType* mapInGrad = dst + sample * InSize() + (size_t)c * InPlaneSize();
+
+            for (int k = 0; k < m_outC; k++)
+            {
+                const ElemType* mapOutGrad = sampleOutGrad + (size_t)k * OutPlaneSize();
+                for (int ky = 0; ky < m_kH; ky++)
+                {
+                    int oyBegin, oyEnd;
+                    ValidRange(ky - m_padY, m_strideY, m_inH, m_outH, oyBegin, oyEnd);
+                    for (int kx = 0; kx < m_kW; kx++)
+                    {
+                        int oxBegin, oxEnd;
+                        ValidRange(kx - m_padX, m_strideX, m_inW, m_outW, oxBegin, oxEnd);
+                        ElemType w = weights[k * KernelSize() + ((size_t)c * m_kH + ky) * m_kW + kx];
+                        for (int oy = oyBegin; oy < oyEnd; oy++)
+                        {
+                            const ElemType* rowOutGrad = mapOutGrad + (size_t)oy * m_outW;
+                            ElemType* rowInGrad = mapInGrad + (size_t)(oy * m_strideY + ky - m_padY) * m_inW;
+                            for (int ox = oxBegin; ox < oxEnd; ox++)
+                                rowInGrad[ox * m_strideX + kx - m_padX] += w * rowOutGrad[ox];
+                        }
+                    }
+                }
+            }
+        }
+    }
+
+    // Each (output map, input channel) slice of the kernel gradient is computed by one thread, over the whole minibatch,
+    // so that no two threads write the same weights and the result does not depend on the number of threads.
+    void BackwardKernelCore(const Mat& srcGrad, const Mat& in, Mat& kernelGrad, bool /*accumulateGradient*/, bool /*allowReuse*/, Mat& /*workspace*/) override
+    {
+        const ElemType* outGrad = srcGrad.Data();
+        const ElemType* src = in.Data();
+        ElemType* dst = kernelGrad.Data();
+        size_t batchSize = in.GetNumCols();
+        int64_t itemCount = (int64_t)m_outC * m_inC;
+
+#pragma omp parallel for
+        for (int64_t item = 0; item < itemCount; item++)
+        {
+            int k = (int)(item / m_inC);
+            int c = (int)(item % m_inC);
+            ElemType* sliceGrad = dst + k * KernelSize() + (size_t)c * m_kH * m_kW;
+
+            for (int ky = 0; ky < m_kH; ky++)
+            {
+                int oyBegin, oyEnd;
+                ValidRange(ky - m_padY, m_strideY, m_inH, m_outH, oyBegin, oyEnd);
+                for (int kx = 0; kx < m_kW; kx++)
+                {
+                    int oxBegin, oxEnd;
+                    ValidRange(kx - m_padX, m_strideX, m_inW, m_outW, oxBegin, oxEnd);
+                    ElemType sum = 0;
+                    for (size_t sample = 0; sample < batchSize; sample++)
+                    {
+                        const ElemType* mapOutGrad = outGrad + sample * OutSize() + (size_t)k * OutPlaneSize();
+                        const ElemType* mapIn = src + sample * InSize() + (size_t)c * InPlaneSize();
+                        for (int oy = oyBegin; oy < oyEnd; oy++)
+                        {
+                            const ElemType* rowOutGrad = mapOutGrad + (size_t)oy * m_outW;
+                            const ElemType* rowIn = mapIn + (size_t)(oy * m_strideY + ky - m_padY) * m_inW;
+                            for (int ox = oxBegin; ox < oxEnd; ox++)
+                                sum += rowOutGrad[ox] * rowIn[ox * m_strideX + kx - m_padX];
+                        }
+                    }
+                    sliceGrad[ky * m_kW + kx] += sum;
+                }
+            }
+        }
+    }
+
+    // Like the reference engine, the poolings only consider the cells of the window that are inside the image
+    // (that is, average pooling divides by their count), and max pooling backpropagates to the first maximum.
+    void ForwardPoolingCore(const Mat& in, Mat& out) override
+    {
+        if (m_poolKind != PoolKind::Max && m_poolKind != PoolKind::Average)
+            InvalidArgument("Pooling type %d is not supported.", (int)m_poolKind);
+
+        const ElemType* src = in.Data();
+        ElemType* dst = out.Data();
+        int64_t planeCount = (int64_t)in.GetNumCols() * m_inC;
+
+#pragma omp parallel for
+        for (int64_t plane = 0; plane < planeCount; plane++)
+        {
+            const ElemType* mapIn = src + plane * InPlaneSize();
+            ElemType* mapOut = dst + plane * OutPlaneSize();
+            for (int oy = 0; oy < m_outH; oy++)
+            {
+                int y0 = oy * m_strideY - m_padY;
+                int kyBegin = max(0, -y0);
+                int kyEnd = min(m_kH, m_inH - y0);
+                for (int ox = 0; ox < m_outW; ox++)
+                {
+                    int x0 = ox * m_strideX - m_padX;
+                    int kxBegin = max(0, -x0);
+                    int kxEnd = min(m_kW, m_inW - x0);
+                    ElemType res = m_poolKind == PoolKind::Max ? std::numeric_limits<ElemType>::lowest() : 0;
+                    for (int ky = kyBegin; ky < kyEnd; ky++)
+                    {
+                        const ElemType* rowIn = mapIn + (size_t)(y0 + ky) * m_inW;
+                        for (int kx = kxBegin; kx < kxEnd; kx++)
+                            res = m_poolKind == PoolKind::Max ? max(res, rowIn[x0 + kx]) : res + rowIn[x0 + kx];
+                    }
+                    if (m_poolKind == PoolKind::Average)
+                        res /= (kyEnd - kyBegin) * (kxEnd - kxBegin);
+                    mapOut[(size_t)oy * m_outW + ox] = res;
+                }
+            }
+        }
+    }
+
+    void BackwardPoolingCore(const Mat& out, const Mat& srcGrad, const Mat& in, Mat& grad) override
+    {
+        if (m_poolKind != PoolKind::Max && m_poolKind != PoolKind::Average)
+            InvalidArgument("Pooling type %d is not supported.", (int)m_poolKind);
+
+        const ElemType* poolOut = out.Data();
+        const ElemType* outGrad = srcGrad.Data();
+        const ElemType* src = in.Data();
+        ElemType* dst = grad.Data();
+        int64_t planeCount = (int64_t)in.GetNumCols() * m_inC;
+
+#pragma omp parallel for
+        for (int64_t plane = 0; plane < planeCount; plane++)
+        {
+            const ElemType* mapIn = src + plane * InPlaneSize();
+            ElemType* mapInGrad = dst + plane * InPlaneSize();
+            for (int oy = 0; oy < m_outH; oy++)
+            {
+                int y0 = oy * m_strideY - m_padY;
+                int kyBegin = max(0, -y0);
+                int kyEnd = min(m_kH, m_inH - y0);
+                for (int ox = 0; ox < m_outW; ox++)
+                {
+                    int x0 = ox * m_strideX - m_padX;
+                    int kxBegin = max(0, -x0);
+                    int kxEnd = min(m_kW, m_inW - x0);
+                    size_t iout = plane * OutPlaneSize() + (size_t)oy * m_outW + ox;
+                    if (m_poolKind == PoolKind::Max)
+                    {
+                        ElemType m = poolOut[iout];
+                        bool found = false;
+                        for (int ky = kyBegin; ky < kyEnd && !found; ky++)
+                        {
+                            size_t rowBase = (size_t)(y0 + ky) * m_inW;
+                            for (int kx = kxBegin; kx < kxEnd && !found; kx++)
+                            {
+                                if (mapIn[rowBase + x0 + kx] >= m)
+                                {
+                                    mapInGrad[rowBase + x0 + kx] += outGrad[iout];
+                                    found = true;
+                                }
+                            }
+                        }
+                    }
+                    else
+                    {
+                        ElemType g = outGrad[iout] / ((kyEnd - kyBegin) * (kxEnd - kxBegin));
+                        for (int ky = kyBegin; ky < kyEnd; ky++)
+                        {
+                            ElemType* rowInGrad = mapInGrad + (size_t)(y0 + ky) * m_inW;
+                            for (int kx = kxBegin; kx < kxEnd; kx++)
+                                rowInGrad[x0 + kx] += g;
+                        }
+                    }
+                }
+            }
+        }
+    }
+
+public:
+    // 2D convolutions of CHW images with full sharing, where the kernel spans all input channels (as in cuDNN),
+    // and 2D poolings of each channel.
+    static bool IsSupported(DEVICEID_TYPE deviceId, ConvolveGeometryPtr geometry, PoolKind poolKind)
+    {
+        const auto& inT = geometry->InputShape();
+        const auto& outT = geometry->OutputShape();
+        const auto& kernT = geometry->KernelShape();
+        if (deviceId >= 0 || inT.GetRank() != 3 ||
+            find(begin(geometry->Sharing()), end(geometry->Sharing()), false) != end(geometry->Sharing()) ||
+            geometry->GetLowerPad(2) != 0)
+            return false;
+        if (poolKind == PoolKind::None)
+            return kernT[2] == inT[2] && outT[2] == geometry->MapCount().GetNumElements();
+        return kernT[2] == 1 && geometry->GetStride(2) == 1 && outT[2] == inT[2];
+    }
+
+private:
+    // The range [begin, end) of output coordinates whose input coordinate (o * stride + offset) is inside the image.
+    static void ValidRange(int offset, int stride, int inSize, int outSize, int& begin, int& end)
+    {
+        begin = offset >= 0 ? 0 : (stride - 1 - offset) / stride;
+        end = inSize <= offset ? 0 : min(outSize, (inSize - offset + stride - 1) / stride);
+        if (end < begin)
+            end = begin;
+    }
+
+    size_t InPlaneSize() const { return (size_t)m_inW * m_inH; }
+    size_t InSize() const { return InPlaneSize() * m_inC; }
+    size_t OutPlaneSize() const { return (size_t)m_outW * m_outH; }
+    size_t OutSize() const { return OutPlaneSize() * m_outC; }
+    size_t KernelSize() const { return (size_t)m_kW * m_kH * m_inC; }
+
+    // The output maps that a thread computes together in the forward pass, so that their rows stay in the cache.
+    static const int MapBlockSize = 4;
+
+    int m_inW = 0, m_inH = 0, m_inC = 0;
+    int m_outW = 0, m_outH = 0, m_outC = 0;
+    int m_kW = 0, m_kH = 0;
+    int m_strideX = 1, m_strideY = 1;
+    int m_padX = 0, m_padY = 0;
+};
+
+// Minibatch size for benchmarking the engines. Small, as the data of all samples are allocated for each engine,
+// but large enough that per-call overheads do not dominate.
+static const size_t c_autotuneBatchSize = 8;
+
+// Seconds for one Forward(), BackwardData() and BackwardKernel() on random data, after a first call that
+// initializes the engine (e.g. picks the cuDNN algorithms).
+template <class ElemType>
+static double TimeConvolutionEngine(ConvolutionEngine<ElemType>& engine, const ConvolveGeometry& geometry, DEVICEID_TYPE deviceId)
+{
+    using Mat = Matrix<ElemType>;
+    size_t mapCount = geometry.GetMapCount(geometry.InputShape().GetRank() - 1);
+    Mat in(geometry.InputShape().GetNumElements(), c_autotuneBatchSize, deviceId);
+    Mat inGrad(geometry.InputShape().GetNumElements(), c_autotuneBatchSize, deviceId);
+    Mat kernel(mapCount, geometry.KernelShape().GetNumElements(), deviceId);
+    Mat kernelGrad(mapCount, geometry.KernelShape().GetNumElements(), deviceId);
+    Mat out(geometry.OutputShape().GetNumElements(), c_autotuneBatchSize, deviceId);
+    Mat workspace(deviceId);
+    in.SetUniformRandomValue(-1, 1, 1);
+    kernel.SetUniformRandomValue(-1, 1, 2);
+
+    auto run = [&]
+    {
+        engine.Forward(in, kernel, out, workspace);
+        engine.BackwardData(out, kernel, inGrad, /*accumulateGradient*/ false, workspace);
+        engine.BackwardKernel(out, in, kernelGrad, /*accumulateGradient*/ false, /*allowReuse*/ false, workspace);
+        kernelGrad.Get00Element(); // waits for the GPU
+    };
+    run();
+    auto start = std::chrono::steady_clock::now();
+    run();
+    return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
+// The fastest of the 'candidates' for the geometry, from ConvolutionAutotuneCache or by benchmarking them.
+template <class ElemType, class CreateEngine>
+static ConvolutionEngineKind AutotuneEngine(const ConvolveGeometry& geometry, DEVICEID_TYPE deviceId, size_t maxTempMemSizeInSamples,
+                                            const std::vector<ConvolutionEngineKind>& candidates, const CreateEngine& create, const std::wstring& logPrefix)
+{
+    auto& cache = ConvolutionAutotuneCache::Instance();
+    std::ostringstream key;
+    key << "Engine, " << ConvolutionAutotuneCache::DeviceDescription(deviceId) << ", " << (sizeof(ElemType) == sizeof(float) ? "float" : "double")
+        << ", " << (std::string)geometry << ", MaxTempMem: " << maxTempMemSizeInSamples << ", Candidates:";
+    for (auto candidate : candidates)
+        key << " " << (int)candidate;
+
+    std::string value;
+    if (cache.TryGet(key.str(), value))
+    {
+        auto cached = (ConvolutionEngineKind)atoi(value.c_str());
+        if (std::find(candidates.begin(), candidates.end(), cached) != candidates.end())
+            return cached;
+    }
+
+    auto best = candidates[0];
+    double bestTime = (std::numeric_limits<double>::max)();
+    for (auto candidate : candidates)
+    {
+        double time;
+        try
+        {
+            auto engine = create(candidate);
+            time = TimeConvolutionEngine(*engine, geometry, deviceId);
+        }
+        catch (const std::exception& e) // e.g. out of memory; the engine is not used then
+        {
+            if (GetMathLibTraceLevel() > 0)
+                fprintf(stderr, "%lsconvolution engine %d failed while autotuning: %s\n", logPrefix.c_str(), (int)candidate, e.what());
+            continue;
+        }
+        if (GetMathLibTraceLevel() > 0)
+            fprintf(stderr, "%lsconvolution engine %d takes %.3f ms for %d samples.\n", logPrefix.c_str(), (int)candidate, time * 1000, (int)c_autotuneBatchSize);
+        if (time < bestTime)
+        {
+            best = candidate;
+            bestTime = time;
+        }
+    }
+
+    if (bestTime < (std::numeric_limits<double>::max)())
+        cache.Set(key.str(), std::to_string((int)best));
+    return best;
+}
+
 template <class ElemType>
 std::unique_ptr<ConvolutionEngine<ElemType>> ConvolutionEngine<ElemType>::Create(ConvolveGeometryPtr geometry, DEVICEID_TYPE deviceId,
                                                                                  ImageLayoutKind imageLayout, size_t maxTempMemSizeInSamples, PoolKind poolKind,
@@ -861,9 +1285,18 @@ std::unique_ptr<ConvolutionEngine<ElemType>> ConvolutionEngine<ElemType>::Create
     // can be called from places like MEL with default parameters and never be used. 
     // The check will be done later in engine's EnsureCompatible call if the egnine is actually used.
     auto engStr = (std::string)(*geometry);
-    // Only legacy engine supports HWC layout.
+    // Only legacy and cuDNN engines support HWC layout. cuDNN consumes the HWC (NHWC) data as is, so it is preferred.
     if (imageLayout == ImageLayoutKind::HWC)
     {
+        if (isEnabled(ConvolutionEngineKind::CuDnn) &&
+            CuDnnConvolutionEngineFactory<ElemType>::IsSupported(deviceId, geometry, poolKind, imageLayout))
+        {
+            if (GetMathLibTraceLevel() > 0)
+                fprintf(stderr, "%lsusing cuDNN convolution engine for HWC geometry: %s.\n", logPrefix.c_str(), engStr.c_str());
+
+            return CuDnnConvolutionEngineFactory<ElemType>::Create(geometry, deviceId, imageLayout, maxTempMemSizeInSamples, poolKind, forceDeterministicAlgorithms);
+        }
+
         if (!isEnabled(ConvolutionEngineKind::Legacy))
             RuntimeError("Trying to use Legacy convolution engine when it's disabled.");
 
@@ -873,31 +1306,49 @@ std::unique_ptr<ConvolutionEngine<ElemType>> ConvolutionEngine<ElemType>::Create
         return std::make_unique<LegacyConvolutionEngine<ElemType>>(geometry, deviceId, imageLayout, maxTempMemSizeInSamples, poolKind);
     }
 
+    // Engines that support the geometry, in the order of preference.
     // Check if we can use cuDNN engine. Do not need to validate tensors as ConvolveGeometry has already done that.
+    std::vector<ConvolutionEngineKind> candidates;
     if (isEnabled(ConvolutionEngineKind::CuDnn) &&
-        CuDnnConvolutionEngineFactory<ElemType>::IsSupported(deviceId, geometry, poolKind))
-    {
-        if (GetMathLibTraceLevel() > 0)
-            fprintf(stderr, "%lsusing cuDNN convolution engine for geometry: %s.\n", logPrefix.c_str(), engStr.c_str());
+        CuDnnConvolutionEngineFactory<ElemType>::IsSupported(deviceId, geometry, poolKind, imageLayout))
+        candidates.push_back(ConvolutionEngineKind::CuDnn);
+    if (isEnabled(ConvolutionEngineKind::Direct) && DirectConvolutionEngine<ElemType>::IsSupported(deviceId, geometry, poolKind))
+        candidates.push_back(ConvolutionEngineKind::Direct);
+    if (isEnabled(ConvolutionEngineKind::Gemm) && GemmConvolutionEngine<ElemType>::IsSupported(deviceId, geometry))
+        candidates.push_back(ConvolutionEngineKind::Gemm);
+    if (isEnabled(ConvolutionEngineKind::Reference))
+        candidates.push_back(ConvolutionEngineKind::Reference);
 
-        return CuDnnConvolutionEngineFactory<ElemType>::Create(geometry, deviceId, imageLayout, maxTempMemSizeInSamples, poolKind, forceDeterministicAlgorithms);
-    }
+    if (candidates.empty())
+        RuntimeError("Reference convolution is disabled and no other engine supports such configuratin (or disabled).");
 
-    if (isEnabled(ConvolutionEngineKind::Gemm) && GemmConvolutionEngine<ElemType>::IsSupported(deviceId, geometry))
+    auto create = [&](ConvolutionEngineKind kind) -> std::unique_ptr<ConvolutionEngine<ElemType>>
     {
-        if (GetMathLibTraceLevel() > 0)
-            fprintf(stderr, "%lsusing GEMM convolution engine for geometry: %s.\n", logPrefix.c_str(), engStr.c_str());
-
-        return std::make_unique<GemmConvolutionEngine<ElemType>>(geometry, deviceId, imageLayout, maxTempMemSizeInSamples, poolKind);
+        if (kind == ConvolutionEngineKind::CuDnn)
+            return CuDnnConvolutionEngineFactory<ElemType>::Create(geometry, deviceId, imageLayout, maxTempMemSizeInSamples, poolKind, forceDeterministicAlgorithms);
+        if (kind == ConvolutionEngineKind::Gemm)
+            return std::make_unique<GemmConvolutionEngine<ElemType>>(geometry, deviceId, imageLayout, maxTempMemSizeInSamples, poolKind);
+        if (kind == ConvolutionEngineKind::Direct)
+            return std::make_unique<DirectConvolutionEngine<ElemType>>(geometry, deviceId, imageLayout, maxTempMemSizeInSamples, poolKind);
+        return std::make_unique<ReferenceConvolutionEngine<ElemType>>(geometry, deviceId, imageLayout, maxTempMemSizeInSamples, poolKind);
+    };
+
+    // Pooling is left to the first engine, and so are deterministic runs, as not all engines are deterministic on the GPU.
+    auto kind = candidates[0];
+    if (candidates.size() > 1 && poolKind == PoolKind::None && !forceDeterministicAlgorithms &&
+        ConvolutionAutotuneCache::Instance().IsEngineAutotuningEnabled())
+    {
+        kind = AutotuneEngine<ElemType>(*geometry, deviceId, maxTempMemSizeInSamples, candidates, create, logPrefix);
     }
 
-    if (!isEnabled(ConvolutionEngineKind::Reference))
-        RuntimeError("Reference convolution is disabled and no other engine supports such configuratin (or disabled).");
-
     if (GetMathLibTraceLevel() > 0)
-        fprintf(stderr, "%lsusing reference convolution engine for geometry: %s.\n", logPrefix.c_str(), engStr.c_str());
+    {
+        const char* name = kind == ConvolutionEngineKind::CuDnn ? "cuDNN" : kind == ConvolutionEngineKind::Gemm ? "GEMM" :
+                           kind == ConvolutionEngineKind::Direct ? "direct" : "reference";
+        fprintf(stderr, "%lsusing %s convolution engine for geometry: %s.\n", logPrefix.c_str(), name, engStr.c_str());
+    }
 
-    return std::make_unique<ReferenceConvolutionEngine<ElemType>>(geometry, deviceId, imageLayout, maxTempMemSizeInSamples, poolKind);
+    return create(kind);
 }
 
 template class ConvolutionEngine<float>;
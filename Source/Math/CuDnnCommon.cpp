@@ -18,7 +18,7 @@ const float Consts<float>::Zero = 0;
 template <>
 const double Consts<double>::Zero = 0;
 
-CuDnnTensor::CuDnnTensor(const TensorShape& src, cudnnDataType_t dataType)
+CuDnnTensor::CuDnnTensor(const TensorShape& src, cudnnDataType_t dataType, ImageLayoutKind layout)
     : m_tensor(nullptr)
 {
     CUDNN_CALL(cudnnCreateTensorDescriptor(&m_tensor));
@@ -33,9 +33,21 @@ CuDnnTensor::CuDnnTensor(const TensorShape& src, cudnnDataType_t dataType)
         dims[dims.size() - 1 - i] = (int)src[i];
         strides[dims.size() - 1 - i] = (int)stridesSrc[i];
     }
+    if (layout == ImageLayoutKind::HWC)
+    {
+        // NHWC: the channel dimension (dims[1]) is innermost, followed by the spatial dimensions, width first.
+        src.VerifyIsDense();
+        int stride = (int)src[src.GetRank() - 1];
+        strides[1] = 1;
+        for (int i = (int)dims.size() - 1; i >= 2; i--)
+        {
+            strides[i] = stride;
+            stride *= dims[i];
+        }
+    }
     // Set "minibatch"(aka N) dimension.
     dims[0] = 1;
-    strides[0] = strides[1] * dims[1];
+    strides[0] = layout == ImageLayoutKind::HWC ? (int)src.GetNumElements() : strides[1] * dims[1];
     CUDNN_CALL(cudnnSetTensorNdDescriptor(m_tensor, dataType, (int)dims.size(), dims.data(), strides.data()));
 }
 
@@ -18,7 +18,9 @@ namespace Microsoft { namespace MSR { namespace CNTK {
 class CuDnnTensor final
 {
 public:
-    CuDnnTensor(const TensorShape& src, cudnnDataType_t dataType);
+    // The shape is always given in CHW order (as in ConvolveGeometry). With the HWC layout, the channel (last)
+    // dimension is the innermost one in memory, that is, the tensor is described as NHWC.
+    CuDnnTensor(const TensorShape& src, cudnnDataType_t dataType, ImageLayoutKind layout = ImageLayoutKind::CHW);
     ~CuDnnTensor();
 
     void UpdateBatchSize(size_t batchSize);
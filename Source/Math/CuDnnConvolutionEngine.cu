@@ -5,9 +5,12 @@
 
 #include "stdafx.h"
 #include "CuDnnFactories.h"
+#include "ConvolutionAutotuneCache.h"
 #include "GPUMatrix.h"
+#include "GPUWatcher.h"
 #include <typeinfo>
 #include <typeindex>
+#include <sstream>
 #include "CuDnnCommon.h"
 
 template <>
@@ -19,6 +22,8 @@ const char* CudaErrString<cudnnStatus_t>(cudnnStatus_t x)
 // A note on the formats: CNTK originally used NHWC for input/output tensors and CHWN for kernels.
 // Such formats have very limited support in cuDNN and not used in other frameworks.
 // CNTK with cuDNN by default uses NCHW formats for both inputs/outputs and kernels.
+// For 2D convolutions in the HWC layout, the inputs/outputs are described to cuDNN as NHWC tensors, so that
+// the data need no conversion, and only the (small) CHWN kernels are transposed to NCHW.
 #define TENSOR_FORMAT CUDNN_TENSOR_NCHW
 #define FILTER_FORMAT CUDNN_TENSOR_NCHW
 
@@ -177,8 +182,9 @@ public:
                            : Base(geometry, deviceId, imageLayout, maxTempMemSizeInSamples, poolKind),
                            m_cudnn(CuDnn::Instance()),
                            m_dataType(CuDnnTensor::GetDataType<ElemType>()),
-                           m_inT(geometry->InputShape(), m_dataType),
-                           m_outT(geometry->OutputShape(), m_dataType),
+                           m_inT(geometry->InputShape(), m_dataType, imageLayout),
+                           m_outT(geometry->OutputShape(), m_dataType, imageLayout),
+                           m_kernelHWC(deviceId),
                            m_forceDeterministicAlgorithms(forceDeterministicAlgorithms)
     {
     }
@@ -194,8 +200,8 @@ protected:
 
     void EnsureCompatible() override
     {
-        if (m_imageLayout != ImageLayoutKind::CHW)
-            RuntimeError("cuDNN convolution engine supports only CHW/cudnn layout.");
+        if (m_imageLayout != ImageLayoutKind::CHW && (m_imageLayout != ImageLayoutKind::HWC || m_geometry->InputShape().GetRank() != 3))
+            RuntimeError("cuDNN convolution engine supports only CHW/cudnn layout, or HWC layout for 2D convolutions.");
         if (!IsGpu(m_deviceId))
             RuntimeError("cuDNN convolution engine supports GPU devices only.");
     }
@@ -209,8 +215,9 @@ protected:
         }
     }
 
-    void ForwardCore(const Mat& in, const Mat& kernel, Mat& out, Mat& workspace) override
+    void ForwardCore(const Mat& in, const Mat& kernelIn, Mat& out, Mat& workspace) override
     {
+        const Mat& kernel = KernelInCuDnnFormat(kernelIn);
         size_t batchSize = in.GetNumCols();
         // Find best algo and allocate temp buffer, if needed.
         auto finder = [this](int& calgo, cudnnConvolutionFwdAlgoPerf_t algoPerf[MaxAlgoCount]) -> cudnnStatus_t
@@ -231,9 +238,12 @@ protected:
         {
             return cudnnGetConvolutionForwardAlgorithm(*m_cudnn, m_inT, *m_kernelT, *m_conv, m_outT, CUDNN_CONVOLUTION_FWD_NO_WORKSPACE, 0, &algo);
         };
-        FindBestAlgo(batchSize, m_fwdAlgo, finder, staticFinder);
+        FindBestAlgo("Forward", batchSize, m_fwdAlgo, finder, staticFinder);
         if (m_fwdAlgo.Algo.memory > 0)
+        {
             workspace.Resize((m_fwdAlgo.Algo.memory + sizeof(ElemType) - 1) / sizeof(ElemType), 1);
+            GPUWatcher::RecordWorkspaceBytes(m_deviceId, m_fwdAlgo.Algo.memory);
+        }
         // Perform forward convolution operation.
         auto err = cudnnConvolutionForward(*m_cudnn, &C::One, m_inT, ptr(in), *m_kernelT, ptr(kernel), *m_conv,
                                            m_fwdAlgo.Algo.algo, ptr(workspace), m_fwdAlgo.Algo.memory, &C::Zero, m_outT, ptr(out));
@@ -257,8 +267,9 @@ protected:
         CUDNN_CALL(err);
     }
 
-    void BackwardDataCore(const Mat& srcGrad, const Mat& kernel, Mat& grad, bool accumulateGradient, Mat& workspace) override
+    void BackwardDataCore(const Mat& srcGrad, const Mat& kernelIn, Mat& grad, bool accumulateGradient, Mat& workspace) override
     {
+        const Mat& kernel = KernelInCuDnnFormat(kernelIn);
         size_t batchSize = srcGrad.GetNumCols();
         // Find best algo and allocate temp buffer, if needed.
         auto finder = [this](int& calgo, cudnnConvolutionBwdDataAlgoPerf_t algoPerf[MaxAlgoCount]) -> cudnnStatus_t
@@ -279,17 +290,27 @@ protected:
         {
             return cudnnGetConvolutionBackwardDataAlgorithm(*m_cudnn, *m_kernelT, m_outT, *m_conv, m_inT, CUDNN_CONVOLUTION_BWD_DATA_NO_WORKSPACE, 0, &algo);
         };
-        FindBestAlgo(batchSize, m_backDataAlgo, finder, staticFinder);
+        FindBestAlgo("BackwardData", batchSize, m_backDataAlgo, finder, staticFinder);
         if (m_backDataAlgo.Algo.memory > 0)
+        {
             workspace.Resize((m_backDataAlgo.Algo.memory + sizeof(ElemType) - 1) / sizeof(ElemType), 1);
+            GPUWatcher::RecordWorkspaceBytes(m_deviceId, m_backDataAlgo.Algo.memory);
+        }
         // Compute gradients with respect to the output tensor (data).
         CUDNN_CALL(cudnnConvolutionBackwardData(*m_cudnn, &C::One, *m_kernelT, ptr(kernel), m_outT, ptr(srcGrad), *m_conv, m_backDataAlgo.Algo.algo,
                                                 ptr(workspace), m_backDataAlgo.Algo.memory, accumulateGradient ? &C::One : &C::Zero, m_inT, ptr(grad)));
         workspace.Resize(0, 0);
     }
 
-    void BackwardKernelCore(const Mat& srcGrad, const Mat& in, Mat& kernelGrad, bool accumulateGradient, bool /*allowReuse*/, Mat& workspace) override
+    void BackwardKernelCore(const Mat& srcGrad, const Mat& in, Mat& kernelGradIn, bool accumulateGradient, bool /*allowReuse*/, Mat& workspace) override
     {
+        // In the HWC layout, the gradient is computed in the transposed (NCHW) format, and transposed back afterwards.
+        bool isHWC = m_imageLayout == ImageLayoutKind::HWC;
+        if (isHWC && accumulateGradient)
+            m_kernelHWC.AssignTransposeOf(kernelGradIn);
+        else if (isHWC)
+            m_kernelHWC.Resize(kernelGradIn.GetNumCols(), kernelGradIn.GetNumRows());
+        Mat& kernelGrad = isHWC ? m_kernelHWC : kernelGradIn;
         size_t batchSize = in.GetNumCols();
         // Find best algo and allocate temp buffer, if needed.
         auto finder = [this](int& calgo, cudnnConvolutionBwdFilterAlgoPerf_t algoPerf[MaxAlgoCount]) -> cudnnStatus_t
@@ -310,13 +331,18 @@ protected:
         {
             return cudnnGetConvolutionBackwardFilterAlgorithm(*m_cudnn, m_inT, m_outT, *m_conv, *m_kernelT, CUDNN_CONVOLUTION_BWD_FILTER_NO_WORKSPACE, 0, &algo);
         };
-        FindBestAlgo(batchSize, m_backFiltAlgo, finder, staticFinder);
+        FindBestAlgo("BackwardKernel", batchSize, m_backFiltAlgo, finder, staticFinder);
         if (m_backFiltAlgo.Algo.memory > 0)
+        {
             workspace.Resize((m_backFiltAlgo.Algo.memory + sizeof(ElemType) - 1) / sizeof(ElemType), 1);
+            GPUWatcher::RecordWorkspaceBytes(m_deviceId, m_backFiltAlgo.Algo.memory);
+        }
         // Compute gradients with respect to the output tensor (data).
         CUDNN_CALL(cudnnConvolutionBackwardFilter(*m_cudnn, &C::One, m_inT, ptr(in), m_outT, ptr(srcGrad), *m_conv, m_backFiltAlgo.Algo.algo,
                                                   ptr(workspace), m_backFiltAlgo.Algo.memory, accumulateGradient ? &C::One : &C::Zero, *m_kernelT, ptr(kernelGrad)));
         workspace.Resize(0, 0);
+        if (isHWC)
+            kernelGradIn.AssignTransposeOf(m_kernelHWC);
     }
 
     void EnsurePoolingInitialized() override
@@ -356,8 +382,17 @@ private:
 
     static const int MaxAlgoCount = 10;
 
+    // Legacy HWC kernels are stored as [mapCount x kW * kH * C] matrices (CHWN), cuDNN expects the map count outermost (NCHW).
+    const Mat& KernelInCuDnnFormat(const Mat& kernel)
+    {
+        if (m_imageLayout != ImageLayoutKind::HWC)
+            return kernel;
+        m_kernelHWC.AssignTransposeOf(kernel);
+        return m_kernelHWC;
+    }
+
     template <typename TAlgo, typename TFinder, typename TStaticFinder>
-    void FindBestAlgo(size_t batchSize, TAlgo& algo, TFinder finder, TStaticFinder staticFinder)
+    void FindBestAlgo(const char* direction, size_t batchSize, TAlgo& algo, TFinder finder, TStaticFinder staticFinder)
     {
         m_inT.UpdateBatchSize(batchSize);
         m_outT.UpdateBatchSize(batchSize);
@@ -365,6 +400,33 @@ private:
         if (!algo.NeedAutotuning(batchSize))
             return;
 
+        // The benchmarks depend only on the device, the geometry and the workspace limit, so they are done once
+        // for all processes that share the cache file.
+        auto& cache = ConvolutionAutotuneCache::Instance();
+        const std::string key = AutotuneKey(direction, batchSize);
+        std::string value;
+        if (cache.TryGet(key, value) && algo.Deserialize(value))
+        {
+            algo.MaxAllowedMBSizeForCurrentAlgo = batchSize;
+            return;
+        }
+
+        if (TuneAlgo(batchSize, algo, finder, staticFinder))
+            cache.Set(key, algo.Serialize());
+    }
+
+    std::string AutotuneKey(const char* direction, size_t batchSize) const
+    {
+        std::ostringstream key;
+        key << "cuDNN " << direction << ", " << ConvolutionAutotuneCache::DeviceDescription(m_deviceId) << ", " << (sizeof(ElemType) == sizeof(float) ? "float" : "double")
+            << ", " << (std::string)(*m_geometry) << ", Batch: " << batchSize << ", MaxTempMem: " << m_maxTempMemSizeInSamples
+            << (m_forceDeterministicAlgorithms ? ", deterministic" : "");
+        return key.str();
+    }
+
+    template <typename TAlgo, typename TFinder, typename TStaticFinder>
+    bool TuneAlgo(size_t batchSize, TAlgo& algo, TFinder finder, TStaticFinder staticFinder)
+    {
         using CuDnnAlgoT = decltype(TAlgo::Algo);
         CuDnnAlgoT algoPerf[MaxAlgoCount];
         int calgo = 0;
@@ -385,7 +447,7 @@ private:
             algo.Algo.memory = 0;
             algo.Algo.status = CUDNN_STATUS_SUCCESS;
             algo.NoWorkspaceAlgo = noMemAlgo;
-            return;
+            return false; // only a fallback, not worth caching
         }
         CUDNN_CALL(err);
         assert(calgo > 0);
@@ -401,7 +463,7 @@ private:
         algo.Algo = *res;
 
         if (m_forceDeterministicAlgorithms) // does not allow fallback.
-            return;
+            return true;
 
         // Find fastest algorithm that does NOT require workspace. It is used as a fallback algo in Forward function.
         // Currently all Forward algorithms are deterministic, so no need for checking.
@@ -414,6 +476,7 @@ private:
         }
         else
             algo.NoWorkspaceAlgo = (*res).algo;
+        return true;
     }
 
     static ElemType* ptr(Mat& src)
@@ -454,6 +517,26 @@ private:
             // REVIEW alexeyk: review once we get response from NVIDIA.
             return (Algo.status != CUDNN_STATUS_SUCCESS || batchSize > MaxAllowedMBSizeForCurrentAlgo);
         }
+
+        // "<algo> <workspace bytes> <no-workspace algo>", for ConvolutionAutotuneCache
+        std::string Serialize() const
+        {
+            return std::to_string((int)Algo.algo) + " " + std::to_string((unsigned long long)Algo.memory) + " " + std::to_string((int)NoWorkspaceAlgo);
+        }
+
+        bool Deserialize(const std::string& value)
+        {
+            int algo, noWorkspaceAlgo;
+            unsigned long long memory;
+            if (sscanf(value.c_str(), "%d %llu %d", &algo, &memory, &noWorkspaceAlgo) != 3)
+                return false;
+            Algo.algo = (CuDnnAlgoT)algo;
+            Algo.memory = (size_t)memory;
+            Algo.status = CUDNN_STATUS_SUCCESS;
+            Algo.time = 0;
+            NoWorkspaceAlgo = (CuDnnAlgoT)noWorkspaceAlgo;
+            return true;
+        }
     };
 
     CuDnn::ptr_t m_cudnn;
@@ -463,6 +546,8 @@ private:
     // Convolution specific.
     std::unique_ptr<CuDnnKernel> m_kernelT;
     std::unique_ptr<CuDnnConv> m_conv;
+    // The kernel (or its gradient) in the cuDNN format, for the HWC layout only.
+    Mat m_kernelHWC;
     // Pooling specific.
     std::unique_ptr<CuDnnPool> m_pool;
 
@@ -484,7 +569,7 @@ std::unique_ptr<ConvolutionEngine<ElemType>> CuDnnConvolutionEngineFactory<ElemT
 }
 
 template <class ElemType>
-bool CuDnnConvolutionEngineFactory<ElemType>::IsSupported(DEVICEID_TYPE deviceId, ConvolveGeometryPtr geometry, PoolKind poolKind)
+bool CuDnnConvolutionEngineFactory<ElemType>::IsSupported(DEVICEID_TYPE deviceId, ConvolveGeometryPtr geometry, PoolKind poolKind, ImageLayoutKind imageLayout)
 {
     // REVIEW alexeyk: IsSupported check should be performed by cuDNN itself. Is there a good way to do that?
 
@@ -500,7 +585,12 @@ bool CuDnnConvolutionEngineFactory<ElemType>::IsSupported(DEVICEID_TYPE deviceId
     // cuDNN supports 2D and 3D convolutions at the moment with full sharing.
     // In case map count size > 1, then it should have all ones except last dimension.
     // If pooling is requested, then cuDNN supports only 2D/3D inputs and 2D pooling kernels.
+    // The HWC layout is supported for square 2D inputs and kernels only: the legacy engine, which handles all
+    // other HWC geometries (including the sparse 1D ones), interprets the two image axes the other way round.
+    bool isSquareHWC = input.GetRank() == 3 && kernel.GetRank() >= 2 &&
+                       input[0] == input[1] && kernel[0] == kernel[1] && geometry->GetStride(0) == geometry->GetStride(1);
     return (input.GetRank() <= 4 &&
+            (imageLayout == ImageLayoutKind::CHW || imageLayout == ImageLayoutKind::HWC && isSquareHWC) &&
             std::find(begin(sharing), end(sharing), false) == sharing.end() &&
             mapCount.GetNumElements() == mapCount[mapCount.GetRank() - 1] &&
             (poolKind == PoolKind::None || 
@@ -510,4 +600,12 @@ bool CuDnnConvolutionEngineFactory<ElemType>::IsSupported(DEVICEID_TYPE deviceId
 template class CuDnnConvolutionEngineFactory<float>;
 template class CuDnnConvolutionEngineFactory<double>;
 
+std::string CuDnnDeviceDescription(DEVICEID_TYPE deviceId)
+{
+    cudaDeviceProp props = {0};
+    if ((cudaGetDeviceProperties(&props, deviceId) | cudaGetLastError()) != cudaSuccess)
+        RuntimeError("Could not get the properties of GPU %d.", (int)deviceId);
+    return std::string(props.name) + ", cuDNN " + std::to_string((unsigned long long)cudnnGetVersion());
+}
+
 } } }
@@ -17,7 +17,7 @@ public:
     static std::unique_ptr<ConvolutionEngine<ElemType>> Create(ConvolveGeometryPtr geometry, DEVICEID_TYPE deviceId,
                                                                ImageLayoutKind imageLayout, size_t maxTempMemSizeInSamples,
                                                                PoolKind poolKind, bool forceDeterministicAlgorithms);
-    static bool IsSupported(DEVICEID_TYPE deviceId, ConvolveGeometryPtr geometry, PoolKind poolKind);
+    static bool IsSupported(DEVICEID_TYPE deviceId, ConvolveGeometryPtr geometry, PoolKind poolKind, ImageLayoutKind imageLayout);
 };
 
 template <class ElemType>
@@ -28,6 +28,9 @@ public:
                                                              bool spatial, ImageLayoutKind imageLayout);
 };
 
+// The name of the GPU and the cuDNN version, e.g. to key autotuning results (see ConvolutionAutotuneCache).
+std::string CuDnnDeviceDescription(DEVICEID_TYPE deviceId);
+
 // REVIEW alexeyk: wrong place? It is currently used only in unit tests but I can't add it there because of the build issues.
 // Timer that can be used to measure CUDA calls. 
 // Uses CUDA event and will synchronize(!) the stream when Stop is called.
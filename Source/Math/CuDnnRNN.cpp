@@ -76,28 +76,36 @@ void CuDnnRNNExecutor<ElemType>::ForwardCore(
     if (m_yDim != (m_rnnT->isBidirectional() ? 2 : 1) * m_rnnT->GetNumHidden())
         InvalidArgument("CuDnn ForwardCore: Output leading dimension must be twice hidden size for bidirectional networks");
 
-    // set up the input and output descriptors
-    SetDescriptors(m_xDim, numSequencesForFrame, xDesc);
-    SetDescriptors(m_yDim, numSequencesForFrame, yDesc);
-
-    // ensure workspace and reserve are large enough
-    m_seqLength = numSequencesForFrame.size();
-    size_t workSize;
-    size_t reserveSize;
-
-    // Need for every pass
-    CUDNN_CALL(cudnnGetRNNWorkspaceSize(*m_cudnn, *m_rnnT, (int)m_seqLength, xDesc.data(), &workSize));
-    // Only needed in training, can't be touched between passes.
-    CUDNN_CALL(cudnnGetRNNTrainingReserveSize(*m_cudnn, *m_rnnT, (int)m_seqLength, xDesc.data(), &reserveSize));
-
-    // convert from bytes to ElemType
-    workSize = (workSize + sizeof(ElemType) - 1) / (sizeof(ElemType));
-    reserveSize = (reserveSize + sizeof(ElemType) - 1) / sizeof(ElemType);
+    // set up the input and output descriptors, unless the sequences are the same as in the last minibatch
+    // (always the case for spatial recurrence, and common with bucketing)
+    if (numSequencesForFrame != m_numSequencesForFrame)
+    {
+        m_rnnT->SelectAlgorithm(numSequencesForFrame.front());
+        SetDescriptors(m_xDim, numSequencesForFrame, xDesc);
+        SetDescriptors(m_yDim, numSequencesForFrame, yDesc);
+        m_seqLength = numSequencesForFrame.size();
+
+        size_t workSize;
+        size_t reserveSize;
+
+        // Need for every pass
+        CUDNN_CALL(cudnnGetRNNWorkspaceSize(*m_cudnn, *m_rnnT, (int)m_seqLength, xDesc.data(), &workSize));
+        // Only needed in training, can't be touched between passes.
+        CUDNN_CALL(cudnnGetRNNTrainingReserveSize(*m_cudnn, *m_rnnT, (int)m_seqLength, xDesc.data(), &reserveSize));
+
+        // convert from bytes to ElemType
+        m_workSize = (workSize + sizeof(ElemType) - 1) / (sizeof(ElemType));
+        m_reserveSize = (reserveSize + sizeof(ElemType) - 1) / sizeof(ElemType);
+        m_numSequencesForFrame = numSequencesForFrame;
+    }
 
-    reserve.Resize(reserveSize, 1);
-    workspace.Resize(workSize, 1);
+    // ensure workspace and reserve are large enough (they are kept by the caller, so this only allocates when they grow)
+    reserve.Resize(m_reserveSize, 1);
+    workspace.Resize(m_workSize, 1);
 
-    wDesc = make_unique<CuDnnFilter<ElemType>>(*m_rnnT, xDesc[0]);
+    // the parameter layout only depends on the RNN and the input dimension
+    if (!wDesc)
+        wDesc = make_unique<CuDnnFilter<ElemType>>(*m_rnnT, xDesc[0]);
     if (wDesc->GetSize() != weightsW.GetNumElements())
         InvalidArgument("RNN needs %ld parameters, but %ld were allocated", wDesc->GetSize(), weightsW.GetNumElements());
 
@@ -5,6 +5,7 @@
 #include "TensorShape.h"
 #include <typeinfo>
 #include <typeindex>
+#include <map>
 #include "CuDnnCommon.h"
 #include "RNNCommon.h"
 
@@ -59,10 +60,16 @@ template <class ElemType>
 class CuDnnRNN
 {
 private:
+    CuDnn::ptr_t m_cudnn;
     cudnnDataType_t m_dataType;
     cudnnRNNDescriptor_t m_rnnDesc;
     CuDnnDropout m_dropout;
     RnnAttributes m_rnnAttributes;
+#if CUDNN_MAJOR >= 6
+    cudnnRNNAlgo_t m_algo;
+    bool m_persistentSupported;                                      // by the device and data type, and not failed yet
+    std::map<size_t, cudnnPersistentRNNPlan_t> m_persistentPlans;    // by minibatch size
+#endif
 
     cudnnRNNMode_t GetMode()
     {
@@ -73,12 +80,40 @@ private:
         else InvalidArgument("Unknown cell type '%ls'. Supported values are 'lstm', 'gru', 'rnnReLU', 'rnnTanh'.", m_rnnAttributes.m_recurrentOp.c_str());
     }
 
+#if CUDNN_MAJOR >= 6
+    void SetDescriptor(cudnnRNNAlgo_t algo)
+    {
+        CUDNN_CALL(cudnnSetRNNDescriptor_v6(*m_cudnn, m_rnnDesc,
+            (int)m_rnnAttributes.m_hiddenSize,
+            (int)m_rnnAttributes.m_numLayers,
+            m_dropout,
+            CUDNN_LINEAR_INPUT, // We can also skip the input matrix transformation
+            m_rnnAttributes.m_bidirectional ? CUDNN_BIDIRECTIONAL : CUDNN_UNIDIRECTIONAL,
+            GetMode(),
+            algo,
+            m_dataType));
+        m_algo = algo;
+    }
+#endif
+
 public:
+    // Up to this many sequences, the persistent algorithm is used if possible. Larger minibatches are faster with the standard one.
+    static const size_t MaxPersistentMiniBatchSize = 32;
+
     CuDnnRNN(const RnnAttributes& rnnAttributes)
-        : m_rnnDesc(nullptr), m_dropout(0.0f), m_rnnAttributes(rnnAttributes),
+        : m_cudnn(CuDnn::Instance()), m_rnnDesc(nullptr), m_dropout(0.0f), m_rnnAttributes(rnnAttributes),
         m_dataType(CuDnnTensor::GetDataType<ElemType>())
     {
         CUDNN_CALL(cudnnCreateRNNDescriptor(&m_rnnDesc));
+#if CUDNN_MAJOR >= 6
+        // the persistent kernels need compute capability 6.0, and do not support double precision
+        int deviceId;
+        int major = 0;
+        CUDA_CALL(cudaGetDevice(&deviceId));
+        CUDA_CALL(cudaDeviceGetAttribute(&major, cudaDevAttrComputeCapabilityMajor, deviceId));
+        m_persistentSupported = major >= 6 && m_dataType == CUDNN_DATA_FLOAT;
+        SetDescriptor(CUDNN_RNN_ALGO_STANDARD);
+#else
         CUDNN_CALL(cudnnSetRNNDescriptor(m_rnnDesc,
             (int)m_rnnAttributes.m_hiddenSize,
             (int)m_rnnAttributes.m_numLayers,
@@ -87,10 +122,15 @@ public:
             m_rnnAttributes.m_bidirectional ? CUDNN_BIDIRECTIONAL : CUDNN_UNIDIRECTIONAL,
             GetMode(),
             m_dataType));
+#endif
     }
 
     ~CuDnnRNN()
     {
+#if CUDNN_MAJOR >= 6
+        for (auto& plan : m_persistentPlans)
+            cudnnDestroyPersistentRNNPlan(plan.second);
+#endif
         if (m_rnnDesc != nullptr)
         {
             cudnnDestroyRNNDescriptor(m_rnnDesc);
@@ -98,6 +138,38 @@ public:
         }
     }
 
+    // Selects the algorithm for a minibatch of the given number of sequences: the persistent one, which keeps the recurrent
+    // weights on chip across all time steps, for few sequences, else the standard one. The sizes of workspace and reserve
+    // depend on it. The plans of the persistent algorithm are made once per minibatch size.
+    void SelectAlgorithm(size_t miniBatchSize)
+    {
+#if CUDNN_MAJOR >= 6
+        if (m_persistentSupported && miniBatchSize <= MaxPersistentMiniBatchSize)
+        {
+            if (m_algo != CUDNN_RNN_ALGO_PERSIST_DYNAMIC)
+                SetDescriptor(CUDNN_RNN_ALGO_PERSIST_DYNAMIC);
+            auto plan = m_persistentPlans.find(miniBatchSize);
+            if (plan == m_persistentPlans.end())
+            {
+                cudnnPersistentRNNPlan_t newPlan;
+                if (cudnnCreatePersistentRNNPlan(m_rnnDesc, (int)miniBatchSize, m_dataType, &newPlan) == CUDNN_STATUS_SUCCESS)
+                    plan = m_persistentPlans.insert(make_pair(miniBatchSize, newPlan)).first;
+                else // e.g. the weights do not fit on chip
+                    m_persistentSupported = false;
+            }
+            if (m_persistentSupported)
+            {
+                CUDNN_CALL(cudnnSetPersistentRNNPlan(m_rnnDesc, plan->second));
+                return;
+            }
+        }
+        if (m_algo != CUDNN_RNN_ALGO_STANDARD)
+            SetDescriptor(CUDNN_RNN_ALGO_STANDARD);
+#else
+        UNUSED(miniBatchSize);
+#endif
+    }
+
     bool IsCompatible(const RnnAttributes& rnnAttributes) const
     {
         return this->m_rnnAttributes == rnnAttributes;
@@ -186,7 +258,7 @@ public:
     CuDnnRNNExecutor(size_t xDim, size_t yDim, const RnnAttributes& rnnAttributes ) :
         m_cudnn(CuDnn::Instance()),
         m_xDim(xDim), m_yDim(yDim),
-        m_seqLength(0),
+        m_seqLength(0), m_workSize(0), m_reserveSize(0),
         m_dataType(CuDnnTensor::GetDataType<ElemType>()),
         m_BackwardDataCalledYet(false)
     {
@@ -218,6 +290,11 @@ private:
     std::unique_ptr<CuDnnRNN<ElemType>> m_rnnT;
     bool m_BackwardDataCalledYet;
     size_t m_seqLength;
+
+    // the descriptors and the sizes of workspace and reserve (in ElemTypes) are kept for the frames of the last minibatch
+    vector<size_t> m_numSequencesForFrame;
+    size_t m_workSize;
+    size_t m_reserveSize;
 };
 
 } } }
\ No newline at end of file
@@ -180,6 +180,16 @@ void GPUDataTransferer::CopyGPUToCPUAsync(void* gpuBuffer, size_t totalSize, voi
     m_inner->RecordGPUToCPUCopy();
 }
 
+bool GPUDataTransferer::IsCopyGPUToCPUAsyncComplete()
+{
+    PrepareDevice(m_inner->m_deviceId);
+    auto rc = cudaEventQuery(m_inner->m_fetchCompleteEvent);
+    if (rc == cudaErrorNotReady)
+        return false;
+    rc || "cudaEventQuery failed";
+    return true;
+}
+
 void GPUDataTransferer::CopyCPUToGPUAsync(void* cpuBuffer, size_t totalSize, void* gpuBuffer)
 {
     m_inner->CopyCPUToGPUAsync(cpuBuffer, 1, totalSize, gpuBuffer);
@@ -198,6 +208,149 @@ void GPUDataTransferer::WaitForCopyCPUToGPUAsync()
     SyncEvent(m_inner->m_assignCompleteEvent);
 }
 
+/// OffloadGPUDataTransferer
+
+cudaStream_t OffloadGPUDataTransferer::s_offloadStream = NULL;
+
+cudaStream_t OffloadGPUDataTransferer::s_prefetchStream = NULL;
+
+OffloadGPUDataTransferer::OffloadGPUDataTransferer(int deviceId)
+    : m_copyCompleteEvent(nullptr),
+      m_stallBeginEvent(nullptr),
+      m_stallEndEvent(nullptr),
+      m_isStallMeasurementPending(false),
+      m_deviceId(deviceId),
+      m_stallSeconds(0)
+{
+    PrepareDevice(m_deviceId);
+
+    // BUGBUG: like the streams of GPUDataTransferer, these are never destroyed
+    if (s_offloadStream == NULL)
+    {
+        cudaStreamCreateWithFlags(&s_offloadStream, cudaStreamNonBlocking) || "cudaStreamCreateWithFlags failed";
+        cudaStreamCreateWithFlags(&s_prefetchStream, cudaStreamNonBlocking) || "cudaStreamCreateWithFlags failed";
+    }
+
+    cudaEventCreateWithFlags(&m_copyCompleteEvent, cudaEventDisableTiming) || "cudaEventCreateWithFlags failed";
+    cudaEventCreate(&m_stallBeginEvent) || "cudaEventCreate failed";
+    cudaEventCreate(&m_stallEndEvent) || "cudaEventCreate failed";
+}
+
+OffloadGPUDataTransferer::~OffloadGPUDataTransferer()
+{
+    // TODO: Check for error code and throw if !std::uncaught_exception()
+    cudaEventDestroy(m_copyCompleteEvent);
+    cudaEventDestroy(m_stallBeginEvent);
+    cudaEventDestroy(m_stallEndEvent);
+}
+
+void OffloadGPUDataTransferer::CopyGPUToCPUAsync(const void* gpuBuffer, size_t totalSize, void* cpuBuffer)
+{
+    PrepareDevice(m_deviceId);
+    // the value must have been computed
+    cudaEventRecord(m_copyCompleteEvent, GetStream()) || "cudaEventRecord failed";
+    cudaStreamWaitEvent(s_offloadStream, m_copyCompleteEvent, 0 /*flags 'must be 0'*/) || "cudaStreamWaitEvent failed";
+    cudaMemcpyAsync(cpuBuffer, gpuBuffer, totalSize, cudaMemcpyDeviceToHost, s_offloadStream) || "cudaMemcpyAsync failed";
+    cudaEventRecord(m_copyCompleteEvent, s_offloadStream) || "cudaEventRecord failed";
+}
+
+void OffloadGPUDataTransferer::CopyCPUToGPUAsync(const void* cpuBuffer, size_t totalSize, void* gpuBuffer)
+{
+    PrepareDevice(m_deviceId);
+    // the buffer's previous user must be done with it
+    cudaEventRecord(m_copyCompleteEvent, GetStream()) || "cudaEventRecord failed";
+    cudaStreamWaitEvent(s_prefetchStream, m_copyCompleteEvent, 0 /*flags 'must be 0'*/) || "cudaStreamWaitEvent failed";
+    cudaMemcpyAsync(gpuBuffer, cpuBuffer, totalSize, cudaMemcpyHostToDevice, s_prefetchStream) || "cudaMemcpyAsync failed";
+    cudaEventRecord(m_copyCompleteEvent, s_prefetchStream) || "cudaEventRecord failed";
+}
+
+void OffloadGPUDataTransferer::WaitForCopyOnComputeStreamAsync()
+{
+    PrepareDevice(m_deviceId);
+    FinishStallMeasurement(); // (the events are reused)
+    cudaEventRecord(m_stallBeginEvent, GetStream()) || "cudaEventRecord failed";
+    cudaStreamWaitEvent(GetStream(), m_copyCompleteEvent, 0 /*flags 'must be 0'*/) || "cudaStreamWaitEvent failed";
+    cudaEventRecord(m_stallEndEvent, GetStream()) || "cudaEventRecord failed";
+    m_isStallMeasurementPending = true;
+}
+
+void OffloadGPUDataTransferer::FinishStallMeasurement()
+{
+    if (!m_isStallMeasurementPending)
+        return;
+    cudaEventSynchronize(m_stallEndEvent) || "cudaEventSynchronize failed";
+    float milliseconds = 0;
+    cudaEventElapsedTime(&milliseconds, m_stallBeginEvent, m_stallEndEvent) || "cudaEventElapsedTime failed";
+    m_stallSeconds += milliseconds / 1000.0;
+    m_isStallMeasurementPending = false;
+}
+
+double OffloadGPUDataTransferer::CollectStallSeconds()
+{
+    PrepareDevice(m_deviceId);
+    FinishStallMeasurement();
+    double stallSeconds = m_stallSeconds;
+    m_stallSeconds = 0;
+    return stallSeconds;
+}
+
+/// PeerGPUDataTransferer
+
+PeerGPUDataTransferer::PeerGPUDataTransferer(int fromDeviceId, int toDeviceId)
+    : m_copyStream(NULL),
+      m_fromComputedEvent(nullptr),
+      m_toReleasedEvent(nullptr),
+      m_copyCompleteEvent(nullptr),
+      m_fromDeviceId(fromDeviceId),
+      m_toDeviceId(toDeviceId)
+{
+    PrepareDevice(m_toDeviceId);
+    cudaEventCreateWithFlags(&m_toReleasedEvent, cudaEventDisableTiming) || "cudaEventCreateWithFlags failed";
+
+    PrepareDevice(m_fromDeviceId);
+    cudaStreamCreateWithFlags(&m_copyStream, cudaStreamNonBlocking) || "cudaStreamCreateWithFlags failed";
+    cudaEventCreateWithFlags(&m_fromComputedEvent, cudaEventDisableTiming) || "cudaEventCreateWithFlags failed";
+    cudaEventCreateWithFlags(&m_copyCompleteEvent, cudaEventDisableTiming) || "cudaEventCreateWithFlags failed";
+
+    int canAccessPeer = 0;
+    cudaDeviceCanAccessPeer(&canAccessPeer, m_fromDeviceId, m_toDeviceId) || "cudaDeviceCanAccessPeer failed";
+    if (canAccessPeer)
+    {
+        cudaError_t rc = cudaDeviceEnablePeerAccess(m_toDeviceId, 0);
+        if (rc == cudaErrorPeerAccessAlreadyEnabled)
+            cudaGetLastError(); // (clear it)
+        else
+            rc || "cudaDeviceEnablePeerAccess failed";
+    }
+}
+
+PeerGPUDataTransferer::~PeerGPUDataTransferer()
+{
+    // TODO: Check for error code and throw if !std::uncaught_exception()
+    cudaStreamDestroy(m_copyStream);
+    cudaEventDestroy(m_fromComputedEvent);
+    cudaEventDestroy(m_toReleasedEvent);
+    cudaEventDestroy(m_copyCompleteEvent);
+}
+
+void PeerGPUDataTransferer::CopyAsync(const void* fromBuffer, size_t totalSize, void* toBuffer)
+{
+    PrepareDevice(m_toDeviceId);
+    cudaEventRecord(m_toReleasedEvent, GetStream()) || "cudaEventRecord failed";
+
+    PrepareDevice(m_fromDeviceId);
+    cudaEventRecord(m_fromComputedEvent, GetStream()) || "cudaEventRecord failed";
+    cudaStreamWaitEvent(m_copyStream, m_fromComputedEvent, 0 /*flags 'must be 0'*/) || "cudaStreamWaitEvent failed";
+    cudaStreamWaitEvent(m_copyStream, m_toReleasedEvent, 0 /*flags 'must be 0'*/) || "cudaStreamWaitEvent failed";
+    cudaMemcpyPeerAsync(toBuffer, m_toDeviceId, fromBuffer, m_fromDeviceId, totalSize, m_copyStream) || "cudaMemcpyPeerAsync failed";
+    cudaEventRecord(m_copyCompleteEvent, m_copyStream) || "cudaEventRecord failed";
+    // the source buffer may be overwritten by the next work of the source GPU
+    cudaStreamWaitEvent(GetStream(), m_copyCompleteEvent, 0 /*flags 'must be 0'*/) || "cudaStreamWaitEvent failed";
+
+    PrepareDevice(m_toDeviceId);
+    cudaStreamWaitEvent(GetStream(), m_copyCompleteEvent, 0 /*flags 'must be 0'*/) || "cudaStreamWaitEvent failed";
+}
+
 /// PrefetchGPUDataTransferer
 
 PrefetchGPUDataTransferer::PrefetchGPUDataTransferer(int deviceId) : GranularGPUDataTransferer(deviceId, nullptr, nullptr, true)
@@ -102,6 +102,8 @@ public:
     }
 
     void WaitForCopyGPUToCPUAsync();
+    // whether the last CopyGPUToCPUAsync() has completed, without waiting for it
+    bool IsCopyGPUToCPUAsyncComplete();
 
     // CPU to GPU
     void CopyCPUToGPUAsync(void* cpuBuffer, size_t totalSize, void* gpuBuffer);
@@ -129,6 +131,70 @@ private:
 #endif // !CPUONLY
 };
 
+// Copies of one buffer to page-locked host memory and back, for activation offloading during training.
+// The copies run on copy streams shared by all instances, after the work queued on the compute stream so far.
+// Their completion is waited for by the compute stream rather than the host, so that the host can keep queuing work;
+// how long the compute stream stalled on them is measured with timing events.
+class MATH_API OffloadGPUDataTransferer
+{
+public:
+    OffloadGPUDataTransferer(int deviceId);
+    ~OffloadGPUDataTransferer();
+
+    // Disallow copy and move construction and assignment
+    DISABLE_COPY_AND_MOVE(OffloadGPUDataTransferer);
+
+    void CopyGPUToCPUAsync(const void* gpuBuffer, size_t totalSize, void* cpuBuffer);
+    void CopyCPUToGPUAsync(const void* cpuBuffer, size_t totalSize, void* gpuBuffer);
+
+    // make the compute stream wait for the last copy
+    void WaitForCopyOnComputeStreamAsync();
+
+    // seconds the compute stream stalled in WaitForCopyOnComputeStreamAsync() since the last call
+    // This waits on the host for the last of these waits to have passed.
+    double CollectStallSeconds();
+
+private:
+#ifndef CPUONLY
+    void FinishStallMeasurement();
+
+    cudaEvent_t m_copyCompleteEvent;
+    cudaEvent_t m_stallBeginEvent, m_stallEndEvent; // around the last wait, with timing
+    bool m_isStallMeasurementPending;
+
+    static cudaStream_t s_offloadStream;  // device to host
+    static cudaStream_t s_prefetchStream; // host to device
+#endif // !CPUONLY
+    int m_deviceId;
+    double m_stallSeconds;
+};
+
+// Copies between the memories of two GPUs, for pipeline-parallel training. A copy runs on a copy stream of the source
+// GPU once the compute streams of both GPUs have done the work queued so far (the source is computed, the destination
+// is no longer read), and the compute streams of both GPUs wait for it before their later work, without the host waiting.
+// Peer access is enabled if the GPUs support it; otherwise the driver stages the copy through host memory.
+class MATH_API PeerGPUDataTransferer
+{
+public:
+    PeerGPUDataTransferer(int fromDeviceId, int toDeviceId);
+    ~PeerGPUDataTransferer();
+
+    // Disallow copy and move construction and assignment
+    DISABLE_COPY_AND_MOVE(PeerGPUDataTransferer);
+
+    void CopyAsync(const void* fromBuffer, size_t totalSize, void* toBuffer);
+
+private:
+#ifndef CPUONLY
+    cudaStream_t m_copyStream;       // on the source GPU
+    cudaEvent_t m_fromComputedEvent; // on the source GPU
+    cudaEvent_t m_toReleasedEvent;   // on the destination GPU
+    cudaEvent_t m_copyCompleteEvent; // on the source GPU
+#endif // !CPUONLY
+    int m_fromDeviceId;
+    int m_toDeviceId;
+};
+
 class PrefetchGPUDataTransferer : public GranularGPUDataTransferer
 {
 public:
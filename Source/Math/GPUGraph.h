@@ -0,0 +1,45 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE.md file in the project root for full license information.
+//
+// GPUGraph.h -- GPU work recorded once as a CUDA graph and replayed with a single launch
+//
+
+#pragma once
+
+#include "CommonMatrix.h" // for MATH_API, DEVICEID_TYPE
+#include <memory>
+
+namespace Microsoft { namespace MSR { namespace CNTK {
+
+// Between BeginCapture() and EndCapture(), the work that the calling thread queues on the current stream (GetStream())
+// for the device is recorded instead of executed; Launch() then executes all of it on the current stream at the cost
+// of one launch. The graph refers to the device memory the work used when it was recorded, so it may only be
+// replayed while those matrices keep their buffers. Temporaries that the work allocates and frees are taken from
+// the device memory cache and held for the graph until it is destroyed.
+// The work must not synchronize with the host; if it does, the capture fails.
+// Requires CUDA 10.1 or later; with the CPU-only build, IsSupported() is false.
+class MATH_API GPUGraph
+{
+public:
+    GPUGraph(DEVICEID_TYPE deviceId);
+    ~GPUGraph();
+
+    static bool IsSupported(DEVICEID_TYPE deviceId);
+
+    void BeginCapture();
+    // false if the work could not be recorded; none of it has been executed then. Also ends a capture after an
+    // exception, and returns false if there is none.
+    bool EndCapture();
+    bool IsCaptured() const;
+    void Launch();
+
+    GPUGraph(const GPUGraph&) = delete;
+    GPUGraph& operator=(const GPUGraph&) = delete;
+
+private:
+    struct Impl;
+    std::unique_ptr<Impl> m_impl;
+};
+
+}}}
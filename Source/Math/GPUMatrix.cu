@@ -27,6 +27,11 @@
 #include "CntkBatchNormalization.cuh"
 #include "Convolution.cuh"
 #include "CuDnnRNN.h"
+#include "TimelineTracer.h"
+#include "GradientSparsifier.h"
+#include "GPUGraph.h"
+#include "CuDnnCommon.h"
+#include <mutex>
 
 #pragma comment(lib, "cudart.lib") // instruct linker to reference these libs
 #pragma comment(lib, "cublas.lib")
@@ -158,6 +163,47 @@ SyncGuard::~SyncGuard()
     }
 }
 
+// per-device cache of freed device memory, used if TracingGPUMemoryAllocator::IsCachingEnabled()
+static CachingBlockAllocator& GetDeviceMemoryCache(int deviceId)
+{
+    static std::mutex cachesLock;
+    static std::map<int, std::unique_ptr<CachingBlockAllocator>> caches;
+
+    std::lock_guard<std::mutex> lock(cachesLock);
+    auto& cache = caches[deviceId];
+    if (!cache)
+    {
+        auto rawAllocate = [deviceId](size_t bytes) -> void*
+        {
+            void* ptr = nullptr;
+            PrepareDevice(deviceId);
+            if (cudaMalloc(&ptr, bytes) != cudaSuccess)
+            {
+                cudaGetLastError(); // clear the error, the cache will retry after emptying itself
+                return nullptr;
+            }
+            return ptr;
+        };
+        auto rawFree = [deviceId](void* ptr)
+        {
+            PrepareDevice(deviceId);
+            cudaFree(ptr); // (may run at process exit, after the runtime has shut down; nothing to report then)
+        };
+        cache.reset(new CachingBlockAllocator(rawAllocate, rawFree));
+    }
+    return *cache;
+}
+
+void TracingGPUMemoryAllocator::EmptyCache(int deviceId)
+{
+    GetDeviceMemoryCache(deviceId).EmptyCache();
+}
+
+CachingBlockAllocator::Statistics TracingGPUMemoryAllocator::GetCachingStatistics(int deviceId)
+{
+    return GetDeviceMemoryCache(deviceId).GetStatistics();
+}
+
 template <typename AllocatedElemType>
 AllocatedElemType* TracingGPUMemoryAllocator::Allocate(int deviceId, size_t numRows, size_t numCols)
 {
@@ -202,10 +248,14 @@ template <typename AllocatedElemType>
 void TracingGPUMemoryAllocator::Free(int deviceId, AllocatedElemType* bufferPtr, bool ignoreCUDARetCode /*= false*/)
 {
     PrepareDevice(deviceId);
-    if (ignoreCUDARetCode)
-        cudaFree((void*) bufferPtr);
-    else
-        CUDA_CALL(cudaFree((void*) bufferPtr));
+    // blocks from the cache go back to it, even if caching has been disabled since they were allocated
+    if (!GetDeviceMemoryCache(deviceId).Free((void*) bufferPtr))
+    {
+        if (ignoreCUDARetCode)
+            cudaFree((void*) bufferPtr);
+        else
+            CUDA_CALL(cudaFree((void*) bufferPtr));
+    }
 
     if (IsTraceEnabled())
     {
@@ -221,6 +271,15 @@ AllocatedElemType* TracingGPUMemoryAllocator::AllocateNoTrace(int deviceId, size
     AllocatedElemType* deviceBufferPtr;
 
     PrepareDevice(deviceId);
+    if (IsCachingEnabled())
+    {
+        // reuse a block freed on the current stream; the stream orders our use after that of the previous owner
+        deviceBufferPtr = (AllocatedElemType*) GetDeviceMemoryCache(deviceId).Allocate(sizeof(AllocatedElemType) * numElements, t_stream);
+        if (!deviceBufferPtr)
+            RuntimeError("TracingGPUMemoryAllocator: Out of memory allocating %llu bytes on DeviceId = %d.", (unsigned long long) (sizeof(AllocatedElemType) * numElements), (int) deviceId);
+        return deviceBufferPtr;
+    }
+
     CUDA_CALL(cudaMalloc((void**) &deviceBufferPtr, sizeof(AllocatedElemType) * numElements));
 
     return deviceBufferPtr;
@@ -237,6 +296,198 @@ std::pair<size_t, size_t> TracingGPUMemoryAllocator::GetFreeAndTotalMemoryInMBs(
     return {free / numBytesPerMB, total / numBytesPerMB};
 }
 
+// GPU side of the TimelineTracer: events on the current stream of the calling thread
+void* TimelineTracer::RecordGPUEvent(DEVICEID_TYPE deviceId)
+{
+    PrepareDevice(deviceId);
+    cudaEvent_t event;
+    CUDA_CALL(cudaEventCreate(&event));
+    CUDA_CALL(cudaEventRecord(event, t_stream));
+    return event;
+}
+
+float TimelineTracer::GPUEventElapsedMilliseconds(void* from, void* to)
+{
+    float milliseconds;
+    CUDA_CALL(cudaEventSynchronize((cudaEvent_t) to));
+    CUDA_CALL(cudaEventElapsedTime(&milliseconds, (cudaEvent_t) from, (cudaEvent_t) to));
+    return milliseconds;
+}
+
+void TimelineTracer::DestroyGPUEvent(void* event)
+{
+    cudaEventDestroy((cudaEvent_t) event);
+}
+
+// GPUGraph: the legacy default stream cannot be captured, so the work is recorded on a stream of the graph, which
+// the calling thread and the cuDNN handle use during the capture. That stream does not synchronize with the legacy
+// default stream, so that other threads, e.g. the readers' prefetch, may keep using it meanwhile. The capture is
+// relaxed, so that the device memory cache may still allocate new blocks for the temporaries.
+struct GPUGraph::Impl
+{
+    DEVICEID_TYPE m_deviceId;
+#if CUDA_VERSION >= 10010
+    cudaStream_t m_captureStream = nullptr;
+    cudaStream_t m_previousStream = nullptr;
+    cudaGraphExec_t m_graphExec = nullptr;
+    bool m_capturing = false;
+#endif
+    CachingBlockAllocator::Reservation m_reservation;
+};
+
+GPUGraph::GPUGraph(DEVICEID_TYPE deviceId)
+    : m_impl(new Impl())
+{
+    m_impl->m_deviceId = deviceId;
+}
+
+GPUGraph::~GPUGraph()
+{
+#if CUDA_VERSION >= 10010
+    PrepareDevice(m_impl->m_deviceId);
+    if (m_impl->m_graphExec)
+    {
+        cudaStreamSynchronize(GetStream()); // the last replay may still use the temporaries
+        cudaGraphExecDestroy(m_impl->m_graphExec);
+    }
+    if (m_impl->m_captureStream)
+        cudaStreamDestroy(m_impl->m_captureStream);
+#endif
+    GetDeviceMemoryCache(m_impl->m_deviceId).ReleaseReservation(std::move(m_impl->m_reservation));
+}
+
+/*static*/ bool GPUGraph::IsSupported(DEVICEID_TYPE deviceId)
+{
+#if CUDA_VERSION >= 10010
+    return deviceId >= 0 && TracingGPUMemoryAllocator::IsCachingEnabled();
+#else
+    return false;
+#endif
+}
+
+void GPUGraph::BeginCapture()
+{
+    if (!IsSupported(m_impl->m_deviceId))
+        LogicError("GPUGraph: Requires CUDA 10.1 or later, and the device memory cache.");
+#if CUDA_VERSION >= 10010
+    if (m_impl->m_capturing || m_impl->m_graphExec)
+        LogicError("GPUGraph: BeginCapture() called twice.");
+    PrepareDevice(m_impl->m_deviceId);
+    if (!m_impl->m_captureStream)
+        CUDA_CALL(cudaStreamCreateWithFlags(&m_impl->m_captureStream, cudaStreamNonBlocking));
+
+    // the new stream starts after the work queued so far
+    cudaEvent_t queued;
+    CUDA_CALL(cudaEventCreateWithFlags(&queued, cudaEventDisableTiming));
+    CUDA_CALL(cudaEventRecord(queued, GetStream()));
+    CUDA_CALL(cudaStreamWaitEvent(m_impl->m_captureStream, queued, 0));
+    CUDA_CALL(cudaEventDestroy(queued));
+
+    GetDeviceMemoryCache(m_impl->m_deviceId).BeginReservation();
+    m_impl->m_previousStream = GetStream();
+    m_impl->m_capturing = true; // from here on, EndCapture() undoes all of this
+    SetStream(m_impl->m_captureStream);
+    CUDNN_CALL(cudnnSetStream(*CuDnn::Instance(), m_impl->m_captureStream));
+    CUDA_CALL(cudaStreamBeginCapture(m_impl->m_captureStream, cudaStreamCaptureModeRelaxed));
+#endif
+}
+
+bool GPUGraph::EndCapture()
+{
+#if CUDA_VERSION >= 10010
+    if (!m_impl->m_capturing) // e.g. BeginCapture() failed
+        return false;
+    m_impl->m_capturing = false;
+
+    cudaGraph_t graph = nullptr;
+    bool captured = cudaStreamEndCapture(m_impl->m_captureStream, &graph) == cudaSuccess && graph != nullptr &&
+                    cudaGraphInstantiate(&m_impl->m_graphExec, graph, nullptr, nullptr, 0) == cudaSuccess;
+    if (graph)
+        cudaGraphDestroy(graph);
+    if (!captured)
+    {
+        m_impl->m_graphExec = nullptr;
+        cudaGetLastError(); // the failure is reported by the return value
+    }
+
+    SetStream(m_impl->m_previousStream);
+    cudnnSetStream(*CuDnn::Instance(), m_impl->m_previousStream);
+    m_impl->m_reservation = GetDeviceMemoryCache(m_impl->m_deviceId).EndReservation();
+    return captured;
+#else
+    return false;
+#endif
+}
+
+bool GPUGraph::IsCaptured() const
+{
+#if CUDA_VERSION >= 10010
+    return m_impl->m_graphExec != nullptr;
+#else
+    return false;
+#endif
+}
+
+void GPUGraph::Launch()
+{
+    if (!IsCaptured())
+        LogicError("GPUGraph: Launch() called without a captured graph.");
+#if CUDA_VERSION >= 10010
+    PrepareDevice(m_impl->m_deviceId);
+    CUDA_CALL(cudaGraphLaunch(m_impl->m_graphExec, GetStream()));
+#endif
+}
+
+// GPU side of the GradientSparsifier: the threshold is estimated on the CPU from a sample of the magnitudes,
+// then the entries above it are compacted on the GPU in no particular order
+template <class ElemType>
+size_t GradientSparsifier<ElemType>::SparsifyGPU(DEVICEID_TYPE deviceId, ElemType* data, size_t numElements, size_t k, size_t capacity, unsigned int* indices, ElemType* values)
+{
+    const size_t maxNumSamples = 1 << 16;
+    PrepareDevice(deviceId);
+
+    ElemType threshold = 0;
+    if (k < numElements)
+    {
+        CUDA_LONG numSamples = (CUDA_LONG) std::min(numElements, maxNumSamples);
+        ElemType* d_samples = TracingGPUMemoryAllocator::Allocate<ElemType>(deviceId, numSamples);
+        SyncGuard syncGuard;
+        _sampleMagnitudes<ElemType><<<GridDim(numSamples).m_blocksPerGrid, GridDim::maxThreadsPerBlock, 0, t_stream>>>(data, (CUDA_LONG) numElements, numSamples, d_samples);
+        std::vector<ElemType> samples(numSamples);
+        CUDA_CALL(cudaMemcpyAsync(samples.data(), d_samples, sizeof(ElemType) * numSamples, cudaMemcpyDeviceToHost, t_stream));
+        CUDA_CALL(cudaStreamSynchronize(t_stream));
+        TracingGPUMemoryAllocator::Free<ElemType>(deviceId, d_samples);
+
+        size_t rank = std::max((size_t) 1, (size_t) ((double) k * numSamples / numElements)) - 1;
+        std::nth_element(samples.begin(), samples.begin() + rank, samples.end(), std::greater<ElemType>());
+        threshold = samples[rank];
+    }
+
+    ElemType* d_values = TracingGPUMemoryAllocator::Allocate<ElemType>(deviceId, capacity);
+    unsigned int* d_indices = TracingGPUMemoryAllocator::Allocate<unsigned int>(deviceId, capacity + 1); // the last one counts the selected entries
+    unsigned int* d_numSelected = d_indices + capacity;
+    CUDA_CALL(cudaMemsetAsync(d_numSelected, 0, sizeof(unsigned int), t_stream));
+    {
+        SyncGuard syncGuard;
+        CUDA_LONG N = (CUDA_LONG) numElements;
+        _selectAboveThreshold<ElemType><<<GridDim(N).m_blocksPerGrid, GridDim::maxThreadsPerBlock, 0, t_stream>>>(data, N, threshold, (unsigned int) capacity, d_indices, d_values, d_numSelected);
+    }
+
+    unsigned int numSelected = 0;
+    CUDA_CALL(cudaMemcpyAsync(&numSelected, d_numSelected, sizeof(unsigned int), cudaMemcpyDeviceToHost, t_stream));
+    CUDA_CALL(cudaStreamSynchronize(t_stream));
+    numSelected = std::min(numSelected, (unsigned int) capacity);
+    CUDA_CALL(cudaMemcpyAsync(indices, d_indices, sizeof(unsigned int) * numSelected, cudaMemcpyDeviceToHost, t_stream));
+    CUDA_CALL(cudaMemcpyAsync(values, d_values, sizeof(ElemType) * numSelected, cudaMemcpyDeviceToHost, t_stream));
+    CUDA_CALL(cudaStreamSynchronize(t_stream));
+    TracingGPUMemoryAllocator::Free<unsigned int>(deviceId, d_indices);
+    TracingGPUMemoryAllocator::Free<ElemType>(deviceId, d_values);
+    return numSelected;
+}
+
+template size_t GradientSparsifier<float>::SparsifyGPU(DEVICEID_TYPE, float*, size_t, size_t, size_t, unsigned int*, float*);
+template size_t GradientSparsifier<double>::SparsifyGPU(DEVICEID_TYPE, double*, size_t, size_t, size_t, unsigned int*, double*);
+
 // PrepareDevice - Setup the correct cuda context for an operation
 // deviceId - the device on which the operation will take place
 void PrepareDevice(DEVICEID_TYPE deviceId)
@@ -307,6 +558,18 @@ void GPUMatrix<ElemType>::SetDevice(DEVICEID_TYPE deviceId)
     CUDA_CALL(cudaSetDevice(deviceId));
 }
 
+template <class ElemType>
+void GPUMatrix<ElemType>::InitializeDevice(DEVICEID_TYPE deviceId)
+{
+    Microsoft::MSR::CNTK::PrepareDevice(deviceId);
+    CUDA_CALL(cudaFree(nullptr)); // creates the context
+    GetCublasHandle(deviceId);
+    // CuDnn::Instance() is bound to the device of its first caller
+    cudaDeviceProp props = {0};
+    if (cudaGetDeviceProperties(&props, deviceId) == cudaSuccess && props.major >= 3)
+        CuDnn::Instance();
+}
+
 // PrepareDevice - Setup the correct cuda context for an operation
 // deviceId - the device on which the operation will take place
 //            defaults to -1, which means use matrices current device
@@ -871,10 +1134,14 @@ cublasHandle_t GPUMatrix<ElemType>::GetCublasHandle(int computeDevice /*=-1*/)
 
     if (computeDevice < 0 || computeDevice >= MaxGpus)
         LogicError("GetCublasHandle: Maximum GPU exceeded");
-    cublasHandle_t cuHandle = s_cuHandle[computeDevice];
-    if (cuHandle == NULL)
+    // the handle may be created by InitializeDevice() on another thread
+    static std::mutex s_cuHandleMutex;
+    cublasHandle_t cuHandle;
     {
-        s_cuHandle[computeDevice] = cuHandle = _initCUBLAS<ElemType>(computeDevice);
+        std::lock_guard<std::mutex> lock(s_cuHandleMutex);
+        cuHandle = s_cuHandle[computeDevice];
+        if (cuHandle == NULL)
+            s_cuHandle[computeDevice] = cuHandle = _initCUBLAS<ElemType>(computeDevice);
     }
     CUBLAS_CALL(cublasSetStream(cuHandle, t_stream));
 
@@ -1057,7 +1324,9 @@ GPUMatrix<ElemType>& GPUMatrix<ElemType>::DoScatterColumnsOf(ElemType beta, cons
 
     // pre-scale with beta upfront
     // Scatter may add more than one source column to the same target, so we must pre-scale with beta, and then just keep adding.
-    Scale(beta, us); // if beta is 0, then this will be a memset()
+    // With beta = 1, only the target columns are touched, e.g. for a gradient of a few columns of a large matrix.
+    if (beta != 1)
+        Scale(beta, us); // if beta is 0, then this will be a memset()
 
     // launch the kernel
     CUDA_LONG NN = (CUDA_LONG)(a.GetNumElements()); // linear space identifying each individual input element
@@ -1071,6 +1340,88 @@ GPUMatrix<ElemType>& GPUMatrix<ElemType>::DoScatterColumnsOf(ElemType beta, cons
     return *this;
 }
 
+// one thread per sequence, which walks the time steps of its sequence
+template <class ElemType>
+__global__ void _assignNonZeroCountsOfSequences(ElemType* us, const ElemType* condition, size_t conditionStride, const ElemType* sequences, CUDA_LONG numSequences)
+{
+    CUDA_LONG i = GridDim::GetLinearThreadId();
+    if (i >= numSequences)
+        return;
+
+    size_t firstColumn = (size_t)sequences[2 * i];
+    size_t numSteps    = (size_t)sequences[2 * i + 1];
+    size_t count = 0;
+    for (size_t t = 0; t < numSteps; t++)
+        if (condition[firstColumn + t * conditionStride] != 0)
+            count++;
+    us[i] = (ElemType)count;
+}
+
+template <class ElemType>
+__global__ void _doScatterNonZeroStepsOfSequences(ElemType* us, const ElemType* condition, size_t conditionStride, const ElemType* sequences, const ElemType* outputFirstColumns, size_t outputStride, CUDA_LONG numSequences)
+{
+    CUDA_LONG i = GridDim::GetLinearThreadId();
+    if (i >= numSequences)
+        return;
+
+    size_t firstColumn = (size_t)sequences[2 * i];
+    size_t numSteps    = (size_t)sequences[2 * i + 1];
+    size_t jOut        = (size_t)outputFirstColumns[i];
+    for (size_t t = 0; t < numSteps; t++)
+    {
+        if (condition[firstColumn + t * conditionStride] != 0)
+        {
+            us[jOut] = (ElemType)t;
+            jOut += outputStride;
+        }
+    }
+}
+
+// *this[0,i] = number of non-zero values of sequence i of 'condition', see Matrix::AssignNonZeroCountsOfSequences()
+template <class ElemType>
+GPUMatrix<ElemType>& GPUMatrix<ElemType>::AssignNonZeroCountsOfSequences(const GPUMatrix<ElemType>& condition, size_t conditionStride, const GPUMatrix<ElemType>& sequences)
+{
+    if (condition.GetNumRows() != 1 || sequences.GetNumRows() != 2)
+        InvalidArgument("AssignNonZeroCountsOfSequences: Condition must be a row vector and sequences must have two rows.");
+    if (condition.GetComputeDeviceId() != sequences.GetComputeDeviceId() || GetComputeDeviceId() != condition.GetComputeDeviceId())
+        InvalidArgument("All matrices must be on the same GPU");
+
+    RequireSize(1, sequences.GetNumCols());
+    if (IsEmpty())
+        return *this;
+
+    condition.PrepareDevice();
+    CUDA_LONG N = (CUDA_LONG)sequences.GetNumCols();
+    SyncGuard syncGuard;
+    GridDim grid(N);
+    _assignNonZeroCountsOfSequences<ElemType><<<grid.m_blocksPerGrid, grid.m_threadsPerBlock, 0, t_stream>>>(Data(), condition.Data(), conditionStride, sequences.Data(), N);
+
+    return *this;
+}
+
+// *this[0, outputFirstColumns[0,i] + k * outputStride] = time step of the k-th non-zero value of sequence i of 'condition'
+template <class ElemType>
+GPUMatrix<ElemType>& GPUMatrix<ElemType>::DoScatterNonZeroStepsOfSequences(const GPUMatrix<ElemType>& condition, size_t conditionStride, const GPUMatrix<ElemType>& sequences, const GPUMatrix<ElemType>& outputFirstColumns, size_t outputStride)
+{
+    if (condition.GetNumRows() != 1 || sequences.GetNumRows() != 2 || GetNumRows() != 1)
+        InvalidArgument("DoScatterNonZeroStepsOfSequences: Condition and output must be row vectors and sequences must have two rows.");
+    if (outputFirstColumns.GetNumElements() != sequences.GetNumCols())
+        InvalidArgument("DoScatterNonZeroStepsOfSequences: There must be one output column per sequence.");
+    if (condition.GetComputeDeviceId() != sequences.GetComputeDeviceId() || GetComputeDeviceId() != condition.GetComputeDeviceId())
+        InvalidArgument("All matrices must be on the same GPU");
+
+    CUDA_LONG N = (CUDA_LONG)sequences.GetNumCols();
+    if (N == 0)
+        return *this;
+
+    condition.PrepareDevice();
+    SyncGuard syncGuard;
+    GridDim grid(N);
+    _doScatterNonZeroStepsOfSequences<ElemType><<<grid.m_blocksPerGrid, grid.m_threadsPerBlock, 0, t_stream>>>(Data(), condition.Data(), conditionStride, sequences.Data(), outputFirstColumns.Data(), outputStride, N);
+
+    return *this;
+}
+
 template <class ElemType>
 void GPUMatrix<ElemType>::SetValue(const ElemType v)
 {
@@ -1133,6 +1484,38 @@ void GPUMatrix<ElemType>::MaskColumnsValue(const GPUMatrix<char>& columnsMask, E
     _maskColumnsValue<ElemType><<<blocksPerGrid, GridDim::maxThreadsPerBlock, 0, t_stream>>>(Data(), columnsMask.Data(), (CUDA_LONG) GetNumCols(), (CUDA_LONG) GetNumRows(), val);
 }
 
+template <class ElemType>
+void GPUMatrix<ElemType>::AssignAugmentedImages(const GPUMatrix<char>& images, GPUMatrix<ElemType>& params, const GPUMatrix<ElemType>& mean,
+                                                size_t width, size_t height, size_t channels, bool toCHW)
+{
+    size_t numPixels = width * height;
+    size_t numImages = images.GetNumCols();
+    if (channels == 0 || channels > 4 || images.GetNumRows() < numPixels * channels)
+        InvalidArgument("AssignAugmentedImages: The images must have 1 to 4 channels and fit into the columns.");
+    if (params.GetNumRows() != 3 + channels || params.GetNumCols() != numImages)
+        InvalidArgument("AssignAugmentedImages: There must be %d parameters for each image.", (int) (3 + channels));
+    if (!mean.IsEmpty() && mean.GetNumElements() != numPixels * channels)
+        InvalidArgument("AssignAugmentedImages: The mean must have the dimensions of the images.");
+    if (GetComputeDeviceId() != images.GetComputeDeviceId() || GetComputeDeviceId() != params.GetComputeDeviceId() ||
+        (!mean.IsEmpty() && GetComputeDeviceId() != mean.GetComputeDeviceId()))
+        InvalidArgument("AssignAugmentedImages: All matrices must be on the same device.");
+
+    RequireSize(numPixels * channels, numImages);
+    if (numImages == 0)
+        return;
+
+    PrepareDevice();
+    SyncGuard syncGuard;
+    const unsigned char* pixels = reinterpret_cast<const unsigned char*>(images.Data());
+    _scaleBrightnessByImageMeansOf512Threads<ElemType><<<(int) numImages, 512, 0, t_stream>>>(pixels, (CUDA_LONG) images.GetNumRows(), (CUDA_LONG) (numPixels * channels),
+                                                                                              params.Data(), (CUDA_LONG) params.GetNumRows());
+    CUDA_LONG N = (CUDA_LONG) (numPixels * numImages);
+    int blocksPerGrid = (int) ceil(1.0 * N / GridDim::maxThreadsPerBlock);
+    _assignAugmentedImages<ElemType><<<blocksPerGrid, GridDim::maxThreadsPerBlock, 0, t_stream>>>(Data(), pixels, (CUDA_LONG) images.GetNumRows(),
+                                                                                                   params.Data(), mean.IsEmpty() ? nullptr : mean.Data(),
+                                                                                                   (CUDA_LONG) numPixels, (CUDA_LONG) channels, (CUDA_LONG) numImages, toCHW);
+}
+
 template <class ElemType>
 void GPUMatrix<ElemType>::SetColumn(const ElemType* colPointer, size_t colInd)
 {
@@ -1346,6 +1729,23 @@ void GPUMatrix<ElemType>::SetUniformRandomMask(const ElemType maskRate, const El
     _setMaskAndScale<ElemType><<<blocksPerGrid, GridDim::maxThreadsPerBlock, 0, t_stream>>>(Data(), N, maskRate, scaleValue);
 }
 
+template <class ElemType>
+GPUMatrix<ElemType>& GPUMatrix<ElemType>::DoElementProductOfCounterBasedMask(ElemType beta, const GPUMatrix<ElemType>& a, const ElemType maskRate, const ElemType scaleValue, uint64_t seed, uint64_t offset)
+{
+    if (a.IsEmpty())
+        LogicError("DoElementProductOfCounterBasedMask: Matrix is empty.");
+
+    if (!(a.GetNumRows() == GetNumRows() && a.GetNumCols() == GetNumCols()))
+        InvalidArgument("DoElementProductOfCounterBasedMask: The input matrix dimensions do not match [this].");
+
+    CUDA_LONG N = (CUDA_LONG) GetNumElements();
+    int blocksPerGrid = (int) ceil(1.0 * N / GridDim::maxThreadsPerBlock);
+    a.PrepareDevice();
+    SyncGuard syncGuard;
+    _elementProductOfCounterBasedMask<ElemType><<<blocksPerGrid, GridDim::maxThreadsPerBlock, 0, t_stream>>>(Data(), a.Data(), N, beta, maskRate, scaleValue, seed, offset);
+    return *this;
+}
+
 template <class ElemType>
 ElemType GPUMatrix<ElemType>::Adagrad(GPUMatrix<ElemType>& gradients, const bool needAveMultiplier)
 {
@@ -1412,6 +1812,35 @@ void GPUMatrix<ElemType>::FSAdagrad(GPUMatrix<ElemType>& gradients,
                                                                          learnRatePerSample, momentum, adaWeight, adaMul);
 }
 
+template <class ElemType>
+void GPUMatrix<ElemType>::Adam(GPUMatrix<ElemType>& gradients,
+                               GPUMatrix<ElemType>& functionValues,
+                               ElemType learnRatePerSample,
+                               ElemType meanMomentum,
+                               ElemType varMomentum,
+                               ElemType meanCorrection,
+                               ElemType varCorrection,
+                               ElemType epsilon,
+                               ElemType weightDecay,
+                               bool updateFunctionValues)
+{
+    size_t numColsNeeded = 2 * gradients.GetNumCols();
+
+    if (IsEmpty() || (GetNumCols() < numColsNeeded))
+    {
+        RequireSize(gradients.GetNumRows(), numColsNeeded);
+        SetValue(0.0);
+    }
+
+    assert((GetNumRows() == gradients.GetNumRows()) && (GetNumCols() == numColsNeeded));
+
+    size_t n = gradients.GetNumElements();
+    int blocksPerGrid = (n + GridDim::maxThreadsPerBlock - 1) / GridDim::maxThreadsPerBlock;
+    _adam<ElemType><<<blocksPerGrid, GridDim::maxThreadsPerBlock, 0, t_stream>>>(n, gradients.Data(), Data(), Data() + n, functionValues.Data(),
+                                                                                 learnRatePerSample, meanMomentum, varMomentum, meanCorrection, varCorrection,
+                                                                                 epsilon, weightDecay, updateFunctionValues);
+}
+
 template <class ElemType>
 ElemType GPUMatrix<ElemType>::RmsProp(GPUMatrix<ElemType>& gradients,
                                       ElemType RMS_GAMMA,
@@ -1493,6 +1922,223 @@ ElemType GPUMatrix<ElemType>::RmsProp(GPUMatrix<ElemType>& gradients,
     }
 }
 
+// checks the matrices of a multi-tensor update, and allocates and zeroes smoothed gradients that do not yet hold 'numAccumulators'
+// accumulators of the size of their gradients, as the single-tensor updates do
+template <class ElemType>
+static void PrepareMultiTensorUpdate(const std::vector<GPUMatrix<ElemType>*>& smoothedGradients, const std::vector<GPUMatrix<ElemType>*>& gradients,
+                                     const std::vector<GPUMatrix<ElemType>*>& functionValues, size_t numAccumulators)
+{
+    if (smoothedGradients.size() != gradients.size() || functionValues.size() != gradients.size())
+        LogicError("MultiTensorUpdate: The numbers of smoothed gradients, gradients and parameters differ.");
+
+    for (size_t i = 0; i < gradients.size(); i++)
+    {
+        auto& smoothedGradient = *smoothedGradients[i];
+        const auto& gradient = *gradients[i];
+        const auto& functionValue = *functionValues[i];
+        if (functionValue.GetNumRows() != gradient.GetNumRows() || functionValue.GetNumCols() != gradient.GetNumCols())
+            InvalidArgument("MultiTensorUpdate: The gradient [%d x %d] does not match the parameter [%d x %d].",
+                            (int) gradient.GetNumRows(), (int) gradient.GetNumCols(), (int) functionValue.GetNumRows(), (int) functionValue.GetNumCols());
+        if (smoothedGradient.GetComputeDeviceId() != gradients[0]->GetComputeDeviceId() || gradient.GetComputeDeviceId() != gradients[0]->GetComputeDeviceId() ||
+            functionValue.GetComputeDeviceId() != gradients[0]->GetComputeDeviceId())
+            InvalidArgument("All matrices must be on the same GPU");
+
+        size_t numColsNeeded = numAccumulators * gradient.GetNumCols();
+        if (smoothedGradient.IsEmpty() || smoothedGradient.GetNumCols() < numColsNeeded)
+        {
+            smoothedGradient.RequireSize(gradient.GetNumRows(), numColsNeeded);
+            smoothedGradient.SetValue(0.0);
+        }
+
+        if (smoothedGradient.GetNumRows() != gradient.GetNumRows())
+            InvalidArgument("MultiTensorUpdate: The smoothed gradients [%d x %d] do not match the gradient [%d x %d].",
+                            (int) smoothedGradient.GetNumRows(), (int) smoothedGradient.GetNumCols(), (int) gradient.GetNumRows(), (int) gradient.GetNumCols());
+    }
+}
+
+// launches _multiTensorUpdate() for up to MultiTensorSlices::maxTensors tensors at a time
+template <class ElemType, class UpdateOp>
+static void LaunchMultiTensorUpdate(const std::vector<GPUMatrix<ElemType>*>& smoothedGradients, const std::vector<GPUMatrix<ElemType>*>& gradients,
+                                    const std::vector<GPUMatrix<ElemType>*>& functionValues, const std::vector<ElemType>* scalars, const UpdateOp& op,
+                                    const UpdateRegularization<ElemType>& regularization)
+{
+    if (gradients.empty())
+        return;
+    gradients[0]->PrepareDevice();
+
+    MultiTensorSlices<ElemType> slices;
+    slices.numTensors = 0;
+    CUDA_LONG numBlocks = 0;
+    for (size_t i = 0; i < gradients.size(); i++)
+    {
+        const CUDA_LONG n = (CUDA_LONG) gradients[i]->GetNumElements();
+        if (n == 0)
+            continue;
+
+        const int t = slices.numTensors++;
+        slices.smoothedGradients[t] = smoothedGradients[i]->Data();
+        slices.gradients[t] = gradients[i]->Data();
+        slices.functionValues[t] = functionValues[i]->Data();
+        slices.sizes[t] = n;
+        slices.firstBlocks[t] = numBlocks;
+        slices.scalars[t] = scalars ? (*scalars)[i] : 0;
+        numBlocks += (n + GridDim::maxThreadsPerBlock - 1) / GridDim::maxThreadsPerBlock;
+
+        if (slices.numTensors == MultiTensorSlices<ElemType>::maxTensors)
+        {
+            _multiTensorUpdate<ElemType, UpdateOp><<<numBlocks, GridDim::maxThreadsPerBlock, 0, t_stream>>>(slices, op, regularization);
+            slices.numTensors = 0;
+            numBlocks = 0;
+        }
+    }
+
+    if (slices.numTensors > 0)
+        _multiTensorUpdate<ElemType, UpdateOp><<<numBlocks, GridDim::maxThreadsPerBlock, 0, t_stream>>>(slices, op, regularization);
+}
+
+template <class ElemType>
+/*static*/ void GPUMatrix<ElemType>::MultiNormalGrad(const std::vector<GPUMatrix<ElemType>*>& smoothedGradients, const std::vector<GPUMatrix<ElemType>*>& gradients,
+                                                     const std::vector<GPUMatrix<ElemType>*>& functionValues,
+                                                     ElemType learnRatePerSample, ElemType momentum, bool useNAG, const UpdateRegularization<ElemType>& regularization)
+{
+    PrepareMultiTensorUpdate(smoothedGradients, gradients, functionValues, 1);
+
+    MultiTensorNormalGradOp<ElemType> op;
+    op.learnRatePerSample = learnRatePerSample;
+    op.momentum = momentum;
+    op.useNAG = useNAG;
+    LaunchMultiTensorUpdate(smoothedGradients, gradients, functionValues, (const std::vector<ElemType>*) nullptr, op, regularization);
+}
+
+template <class ElemType>
+/*static*/ void GPUMatrix<ElemType>::MultiAdagrad(const std::vector<GPUMatrix<ElemType>*>& smoothedGradients, const std::vector<GPUMatrix<ElemType>*>& gradients,
+                                                  const std::vector<GPUMatrix<ElemType>*>& functionValues,
+                                                  ElemType learnRatePerSample, const UpdateRegularization<ElemType>& regularization)
+{
+    PrepareMultiTensorUpdate(smoothedGradients, gradients, functionValues, 1);
+
+    MultiTensorAdagradOp<ElemType> op;
+    op.learnRatePerSample = learnRatePerSample;
+    LaunchMultiTensorUpdate(smoothedGradients, gradients, functionValues, (const std::vector<ElemType>*) nullptr, op, regularization);
+}
+
+template <class ElemType>
+/*static*/ void GPUMatrix<ElemType>::MultiFSAdagrad(const std::vector<GPUMatrix<ElemType>*>& smoothedGradients, const std::vector<GPUMatrix<ElemType>*>& gradients,
+                                                    const std::vector<GPUMatrix<ElemType>*>& functionValues,
+                                                    const std::vector<ElemType>& adaMuls, ElemType learnRatePerSample, ElemType momentum, ElemType adaWeight,
+                                                    const UpdateRegularization<ElemType>& regularization)
+{
+    PrepareMultiTensorUpdate(smoothedGradients, gradients, functionValues, 2);
+    if (adaMuls.size() != gradients.size())
+        LogicError("MultiFSAdagrad: The numbers of multipliers and gradients differ.");
+
+    MultiTensorFSAdagradOp<ElemType> op;
+    op.learnRatePerSample = learnRatePerSample;
+    op.momentum = momentum;
+    op.adaWeight = adaWeight;
+    LaunchMultiTensorUpdate(smoothedGradients, gradients, functionValues, &adaMuls, op, regularization);
+}
+
+template <class ElemType>
+/*static*/ void GPUMatrix<ElemType>::MultiRmsProp(const std::vector<GPUMatrix<ElemType>*>& smoothedGradients, const std::vector<GPUMatrix<ElemType>*>& gradients,
+                                                  const std::vector<GPUMatrix<ElemType>*>& functionValues,
+                                                  ElemType learnRatePerSample, ElemType RMS_GAMMA, ElemType RMS_WGT_INC, ElemType RMS_WGT_MAX, ElemType RMS_WGT_DEC, ElemType RMS_WGT_MIN,
+                                                  const UpdateRegularization<ElemType>& regularization)
+{
+    // the smoothed gradients allocated here are initialized from the gradients as by RmsProp()
+    for (size_t i = 0; i < gradients.size() && i < smoothedGradients.size(); i++)
+    {
+        auto& smoothedGradient = *smoothedGradients[i];
+        const size_t n = gradients[i]->GetNumElements();
+        const size_t numColsNeeded = gradients[i]->GetNumCols() * 3;
+        if (smoothedGradient.IsEmpty() || smoothedGradient.GetNumCols() < numColsNeeded)
+        {
+            smoothedGradient.RequireSize(gradients[i]->GetNumRows(), numColsNeeded);
+            smoothedGradient.SetValue(0.0);
+
+            int blocksPerGrid = (n + GridDim::maxThreadsPerBlock - 1) / GridDim::maxThreadsPerBlock;
+            _rmsprop_init<ElemType><<<blocksPerGrid, GridDim::maxThreadsPerBlock>>>(smoothedGradient.Data(), smoothedGradient.Data() + n, smoothedGradient.Data() + 2 * n, gradients[i]->Data(), n);
+        }
+    }
+    PrepareMultiTensorUpdate(smoothedGradients, gradients, functionValues, 3);
+
+    MultiTensorRmsPropOp<ElemType> op;
+    op.learnRatePerSample = learnRatePerSample;
+    op.RMS_GAMMA = RMS_GAMMA;
+    op.RMS_WGT_INC = RMS_WGT_INC;
+    op.RMS_WGT_MAX = RMS_WGT_MAX;
+    op.RMS_WGT_DEC = RMS_WGT_DEC;
+    op.RMS_WGT_MIN = RMS_WGT_MIN;
+    LaunchMultiTensorUpdate(smoothedGradients, gradients, functionValues, (const std::vector<ElemType>*) nullptr, op, regularization);
+}
+
+// calls launch(list, numBlocks) for up to MultiTensorList::maxTensors of the tensors at a time
+template <class ElemType, class LaunchFn>
+static void ForEachMultiTensorList(const std::vector<GPUMatrix<ElemType>*>& tensors, bool globalNorm, const LaunchFn& launch)
+{
+    const CUDA_LONG elementsPerBlock = MultiTensorList<ElemType>::elementsPerBlock;
+
+    MultiTensorList<ElemType> list;
+    list.numTensors = 0;
+    CUDA_LONG numBlocks = 0;
+    for (size_t i = 0; i < tensors.size(); i++)
+    {
+        const CUDA_LONG n = (CUDA_LONG) tensors[i]->GetNumElements();
+        if (n == 0)
+            continue;
+
+        const int t = list.numTensors++;
+        list.data[t] = tensors[i]->Data();
+        list.sizes[t] = n;
+        list.firstBlocks[t] = numBlocks;
+        list.normIndices[t] = globalNorm ? 0 : (int) i;
+        numBlocks += (n + elementsPerBlock - 1) / elementsPerBlock;
+
+        if (list.numTensors == MultiTensorList<ElemType>::maxTensors)
+        {
+            launch(list, numBlocks);
+            list.numTensors = 0;
+            numBlocks = 0;
+        }
+    }
+
+    if (list.numTensors > 0)
+        launch(list, numBlocks);
+}
+
+// The norms and factors never leave the GPU: 'factors' first accumulates the sums of squares, which one launch per
+// MultiTensorList::maxTensors gradients adds to, then a single launch turns them into the factors, which the scaling reads.
+template <class ElemType>
+/*static*/ void GPUMatrix<ElemType>::MultiClipByNorm(const std::vector<GPUMatrix<ElemType>*>& gradients, ElemType maxNorm, bool globalNorm, GPUMatrix<ElemType>& factors)
+{
+    if (gradients.empty())
+        return;
+    for (auto gradient : gradients)
+    {
+        if (gradient->GetComputeDeviceId() != factors.GetComputeDeviceId())
+            InvalidArgument("All matrices must be on the same GPU");
+    }
+    factors.PrepareDevice();
+
+    const CUDA_LONG numFactors = globalNorm ? 1 : (CUDA_LONG) gradients.size();
+    factors.RequireSize(1, numFactors);
+    factors.SetValue((ElemType) 0);
+    ElemType* sumsOfSquares = factors.Data();
+
+    ForEachMultiTensorList(gradients, globalNorm, [sumsOfSquares](const MultiTensorList<ElemType>& list, CUDA_LONG numBlocks)
+    {
+        _multiTensorSumOfSquares<ElemType><<<numBlocks, GridDim::maxThreadsPerBlock, 0, t_stream>>>(list, sumsOfSquares);
+    });
+
+    const int blocksPerGrid = (numFactors + GridDim::maxThreadsPerBlock - 1) / GridDim::maxThreadsPerBlock;
+    _clippingFactorsOfSumsOfSquares<ElemType><<<blocksPerGrid, GridDim::maxThreadsPerBlock, 0, t_stream>>>(sumsOfSquares, numFactors, maxNorm);
+
+    ForEachMultiTensorList(gradients, globalNorm, [sumsOfSquares](const MultiTensorList<ElemType>& list, CUDA_LONG numBlocks)
+    {
+        _multiTensorScale<ElemType><<<numBlocks, GridDim::maxThreadsPerBlock, 0, t_stream>>>(list, sumsOfSquares);
+    });
+}
+
 template <class ElemType>
 void GPUMatrix<ElemType>::Reshape(const size_t numRows, const size_t numCols)
 {
@@ -2793,6 +3439,20 @@ void GPUMatrix<ElemType>::VectorMax(GPUMatrix<ElemType>& maxIndexes, GPUMatrix<E
     maxValues.RequireSize(topK, n);
     maxIndexes.RequireSize(topK, n);
 
+    // Up to a few thousand, the top values of each column are selected by one block, e.g. for the best classes of a
+    // large output layer at inference, see _selectTopKPerColumn(). The results are the same as those of the sort below.
+    const int maxTopKForSelection = 2048;
+    if (topK <= maxTopKForSelection)
+    {
+        int sortSize = 1;
+        while (sortSize < topK)
+            sortSize *= 2;
+        const int ThreadsPerBlock = 256;
+        size_t cbShared = sortSize * (sizeof(ElemType) + sizeof(int));
+        _selectTopKPerColumn<ThreadsPerBlock, ElemType><<<n, ThreadsPerBlock, cbShared, t_stream>>>(us.Data(), m, topK, sortSize, maxIndexes.Data(), maxValues.Data());
+        return;
+    }
+
     // To sort matrix columns we use 2-pass _stable_ sort algorithm:
     // 1. Sort by values (descending) with corresponding row/col indexes.
     // 2. Sort by col indices (ascending) with corresponding values/row indices.
@@ -2913,6 +3573,114 @@ GPUMatrix<ElemType>& GPUMatrix<ElemType>::AssignNumOfDiff(const GPUMatrix<ElemTy
     return *this;
 }
 
+// The urls of a query are ranked by one thread each, which counts the urls of the query that precede it;
+// like the pairs of the gradient this is quadratic in the number of urls of a query, and nothing is copied to the host.
+template <class ElemType>
+GPUMatrix<ElemType>& GPUMatrix<ElemType>::AssignLambdaRankMetricOf(const GPUMatrix<ElemType>& gains, const GPUMatrix<ElemType>& scores, const GPUMatrix<ElemType>& queryIds, GPUMatrix<ElemType>& discounts)
+{
+    const CUDA_LONG n = (CUDA_LONG) gains.GetNumCols();
+    if (scores.GetNumCols() != n || queryIds.GetNumCols() != n)
+        InvalidArgument("AssignLambdaRankMetricOf: gains, scores and query ids must have the same number of columns.");
+
+    RequireSize(1, 1);
+    discounts.RequireSize(1, n);
+    if (n == 0)
+        return *this;
+
+    PrepareDevice();
+    SyncGuard syncGuard;
+    int blocksPerGrid = (int) ceil(1.0 * n / GridDim::maxThreadsPerBlock);
+    _lambdaRankDiscounts<ElemType><<<blocksPerGrid, GridDim::maxThreadsPerBlock, 0, t_stream>>>(gains.Data(), scores.Data(), queryIds.Data(), discounts.Data(), n);
+    const int blockSize = 1024;
+    _lambdaRankMetric<blockSize><<<1, blockSize, 0, t_stream>>>(gains.Data(), queryIds.Data(), discounts.Data(), Data(), n);
+    return *this;
+}
+
+template <class ElemType>
+GPUMatrix<ElemType>& GPUMatrix<ElemType>::AddLambdaRankGradientOf(ElemType sigma, const GPUMatrix<ElemType>& gains, const GPUMatrix<ElemType>& scores, const GPUMatrix<ElemType>& queryIds, const GPUMatrix<ElemType>& discounts)
+{
+    const CUDA_LONG n = (CUDA_LONG) gains.GetNumCols();
+    if (scores.GetNumCols() != n || queryIds.GetNumCols() != n || discounts.GetNumCols() != n)
+        InvalidArgument("AddLambdaRankGradientOf: gains, scores, query ids and discounts must have the same number of columns.");
+    if (GetNumRows() != 1 || GetNumCols() != n)
+        InvalidArgument("AddLambdaRankGradientOf: the gradient must be a row vector with a column for each url.");
+    if (n == 0)
+        return *this;
+
+    PrepareDevice();
+    SyncGuard syncGuard;
+    int blocksPerGrid = (int) ceil(1.0 * n / GridDim::maxThreadsPerBlock);
+    _lambdaRankAddGradient<ElemType><<<blocksPerGrid, GridDim::maxThreadsPerBlock, 0, t_stream>>>(sigma, gains.Data(), scores.Data(), queryIds.Data(), discounts.Data(), Data(), n);
+    return *this;
+}
+
+// column stride of a parameter of AssignGMMLogLikelihoodOf() with 'rows' rows: 0 if all samples share its single column
+template <class ElemType>
+static CUDA_LONG GMMParameterStride(const char* function, const char* name, const GPUMatrix<ElemType>& parameter, size_t rows, size_t numSamples)
+{
+    if (parameter.GetNumRows() != rows || (parameter.GetNumCols() != 1 && parameter.GetNumCols() != numSamples))
+        InvalidArgument("%s: %s must have %d rows and either one column or a column for each sample.", function, name, (int) rows);
+    return parameter.GetNumCols() == 1 ? 0 : (CUDA_LONG) rows;
+}
+
+// The [K x D] differences to the means are never formed: each component's distance is reduced by the thread that
+// takes it, and only the posteriors are stored for the gradients.
+template <class ElemType>
+GPUMatrix<ElemType>& GPUMatrix<ElemType>::AssignGMMLogLikelihoodOf(const GPUMatrix<ElemType>& unnormedPriors, const GPUMatrix<ElemType>& means, const GPUMatrix<ElemType>& logStddevs,
+                                                                   const GPUMatrix<ElemType>& features, GPUMatrix<ElemType>& posteriors)
+{
+    const size_t numComponents = unnormedPriors.GetNumRows();
+    const size_t dim = features.GetNumRows();
+    const size_t numSamples = features.GetNumCols();
+    CUDA_LONG priorsStride = GMMParameterStride("AssignGMMLogLikelihoodOf", "unnormedPriors", unnormedPriors, numComponents, numSamples);
+    CUDA_LONG meansStride = GMMParameterStride("AssignGMMLogLikelihoodOf", "means", means, numComponents * dim, numSamples);
+    CUDA_LONG logStddevsStride = GMMParameterStride("AssignGMMLogLikelihoodOf", "logStddevs", logStddevs, numComponents, numSamples);
+
+    RequireSize(1, numSamples);
+    posteriors.RequireSize(numComponents, numSamples);
+    if (numSamples == 0)
+        return *this;
+
+    PrepareDevice();
+    SyncGuard syncGuard;
+    const int blockSize = 128;
+    _assignGMMLogLikelihood<blockSize><<<(unsigned int) numSamples, blockSize, 0, t_stream>>>(unnormedPriors.Data(), priorsStride, means.Data(), meansStride,
+                                                                                            logStddevs.Data(), logStddevsStride, features.Data(), (ElemType) (dim * 0.5 * log(TWO_PI)),
+                                                                                            Data(), posteriors.Data(), (CUDA_LONG) numComponents, (CUDA_LONG) dim);
+    return *this;
+}
+
+template <class ElemType>
+GPUMatrix<ElemType>& GPUMatrix<ElemType>::AddGMMLogLikelihoodGradientOf(size_t inputIndex, const GPUMatrix<ElemType>& gradient, const GPUMatrix<ElemType>& unnormedPriors, const GPUMatrix<ElemType>& means,
+                                                                        const GPUMatrix<ElemType>& logStddevs, const GPUMatrix<ElemType>& features, const GPUMatrix<ElemType>& posteriors)
+{
+    const size_t numComponents = unnormedPriors.GetNumRows();
+    const size_t dim = features.GetNumRows();
+    const size_t numSamples = features.GetNumCols();
+    CUDA_LONG priorsStride = GMMParameterStride("AddGMMLogLikelihoodGradientOf", "unnormedPriors", unnormedPriors, numComponents, numSamples);
+    CUDA_LONG meansStride = GMMParameterStride("AddGMMLogLikelihoodGradientOf", "means", means, numComponents * dim, numSamples);
+    CUDA_LONG logStddevsStride = GMMParameterStride("AddGMMLogLikelihoodGradientOf", "logStddevs", logStddevs, numComponents, numSamples);
+    if (gradient.GetNumElements() != numSamples || posteriors.GetNumRows() != numComponents || posteriors.GetNumCols() != numSamples)
+        InvalidArgument("AddGMMLogLikelihoodGradientOf: gradient and posteriors must have a column for each sample.");
+
+    const GPUMatrix<ElemType>& input = inputIndex == 0 ? unnormedPriors : inputIndex == 1 ? means : inputIndex == 2 ? logStddevs : features;
+    if (inputIndex > 3 || GetNumRows() != input.GetNumRows() || GetNumCols() != input.GetNumCols())
+        InvalidArgument("AddGMMLogLikelihoodGradientOf: the gradient of input %d must have the dimensions of that input.", (int) inputIndex);
+    CUDA_LONG gradientStride = GetNumCols() == 1 && numSamples != 1 ? 0 : (CUDA_LONG) GetNumRows();
+    if (IsEmpty())
+        return *this;
+
+    PrepareDevice();
+    SyncGuard syncGuard;
+    CUDA_LONG n = (CUDA_LONG) GetNumElements();
+    int blocksPerGrid = (int) ceil(1.0 * n / GridDim::maxThreadsPerBlock);
+    _addGMMLogLikelihoodGradient<ElemType><<<blocksPerGrid, GridDim::maxThreadsPerBlock, 0, t_stream>>>((int) inputIndex, Data(), (CUDA_LONG) GetNumRows(), (CUDA_LONG) GetNumCols(), gradientStride,
+                                                                                                       gradient.Data(), unnormedPriors.Data(), priorsStride, means.Data(), meansStride,
+                                                                                                       logStddevs.Data(), logStddevsStride, features.Data(), posteriors.Data(),
+                                                                                                       (CUDA_LONG) numComponents, (CUDA_LONG) dim, (CUDA_LONG) numSamples);
+    return *this;
+}
+
 #pragma endregion Member BLAS Functions
 
 #pragma region Other helper functions
@@ -3175,7 +3943,8 @@ void GPUMatrix<ElemType>::ROIPoolingBackward(const size_t numRois, const size_t
     PrepareDevice();
     SyncGuard syncGuard;
 
-    int count = numImg * channels * height * width;
+    // One thread per output location, which accumulates its gradient into the input gradient.
+    int count = numRois * numImg * channels * pooledHeight * pooledWidth;
     const int blockSize = GridDim::maxThreadsPerBlock;
     auto numThreads = dim3((int)floor((double)(count + blockSize - 1) / blockSize));
     kROIPoolingBackward<<<numThreads, blockSize, 0, t_stream>>>(count, numRois, numImg, channels, width, height, 
@@ -3345,6 +4114,47 @@ static cublasStatus_t cublas_gemm(cublasHandle_t handle, cublasOperation_t trans
 {
     return cublasDgemm(handle, transa, transb, m, n, k, alpha, A, lda, B, ldb, beta, C, ldc);
 }
+#if CUDA_VERSION >= 8000
+// float/double overloads of cublasSgemmStridedBatched()/cublasDgemmStridedBatched()
+static cublasStatus_t cublas_gemmStridedBatched(cublasHandle_t handle, cublasOperation_t transa, cublasOperation_t transb, int m, int n, int k, const float* alpha,
+                                                const float* A, int lda, long long strideA, const float* B, int ldb, long long strideB, const float* beta, float* C, int ldc, long long strideC, int batchCount)
+{
+    return cublasSgemmStridedBatched(handle, transa, transb, m, n, k, alpha, A, lda, strideA, B, ldb, strideB, beta, C, ldc, strideC, batchCount);
+}
+static cublasStatus_t cublas_gemmStridedBatched(cublasHandle_t handle, cublasOperation_t transa, cublasOperation_t transb, int m, int n, int k, const double* alpha,
+                                                const double* A, int lda, long long strideA, const double* B, int ldb, long long strideB, const double* beta, double* C, int ldc, long long strideC, int batchCount)
+{
+    return cublasDgemmStridedBatched(handle, transa, transb, m, n, k, alpha, A, lda, strideA, B, ldb, strideB, beta, C, ldc, strideC, batchCount);
+}
+#endif
+// GEMM with the operands converted to fp16 and the products accumulated in fp32, see EnableHalfPrecisionGEMM()
+static void HalfPrecisionGemm(int deviceId, cublasHandle_t handle, cublasOperation_t transa, cublasOperation_t transb, int m, int n, int k, const float* alpha,
+                              const float* A, int lda, size_t numElementsA, const float* B, int ldb, size_t numElementsB, const float* beta, float* C, int ldc)
+{
+    __half* halfA = TracingGPUMemoryAllocator::Allocate<__half>(deviceId, numElementsA + numElementsB);
+    __half* halfB = halfA + numElementsA;
+    {
+        SyncGuard syncGuard;
+        _convertToHalf<<<GridDim((CUDA_LONG) numElementsA).m_blocksPerGrid, GridDim::maxThreadsPerBlock, 0, t_stream>>>(A, halfA, (CUDA_LONG) numElementsA);
+        _convertToHalf<<<GridDim((CUDA_LONG) numElementsB).m_blocksPerGrid, GridDim::maxThreadsPerBlock, 0, t_stream>>>(B, halfB, (CUDA_LONG) numElementsB);
+    }
+#if CUDA_VERSION >= 9000
+    CUBLAS_CALL(cublasSetMathMode(handle, CUBLAS_TENSOR_OP_MATH));
+    cublasGemmAlgo_t algo = CUBLAS_GEMM_DEFAULT_TENSOR_OP;
+#else
+    cublasGemmAlgo_t algo = CUBLAS_GEMM_DFALT;
+#endif
+    CUBLAS_CALL(cublasGemmEx(handle, transa, transb, m, n, k, alpha, halfA, CUDA_R_16F, lda, halfB, CUDA_R_16F, ldb, beta, C, CUDA_R_32F, ldc, CUDA_R_32F, algo));
+#if CUDA_VERSION >= 9000
+    CUBLAS_CALL(cublasSetMathMode(handle, CUBLAS_DEFAULT_MATH));
+#endif
+    TracingGPUMemoryAllocator::Free<__half>(deviceId, halfA);
+}
+// double products are always computed in full precision
+static void HalfPrecisionGemm(int, cublasHandle_t, cublasOperation_t, cublasOperation_t, int, int, int, const double*, const double*, int, size_t, const double*, int, size_t, const double*, double*, int)
+{
+    LogicError("HalfPrecisionGemm: Only float matrices can be multiplied in half precision.");
+}
 static cublasStatus_t cublas_axpy(cublasHandle_t handle, int n, const float* alpha, const float* x, int incx, float* y, int incy)
 {
     return cublasSaxpy(handle, n, alpha, x, incx, y, incy);
@@ -3376,11 +4186,42 @@ void GPUMatrix<ElemType>::MultiplyAndWeightedAdd(ElemType alpha, const GPUMatrix
         RuntimeError("!(m>0 && k>0 && l>0 && n>0)"); // converting from size_t to int may cause overflow
     if (k != l)
         RuntimeError("matrix dim mismatch in MultiplyAndWeightedAdd");
-    CUBLAS_CALL(cublas_gemm(cuHandle, transA, transB, m, n, k, &alpha, a.Data(), (int) a.m_numRows, b.Data(), (int) b.m_numRows, &beta, c.Data(), (int) c.m_numRows));
+    if (IsHalfPrecisionGEMMEnabled() && std::is_same<ElemType, float>::value)
+        HalfPrecisionGemm(a.GetComputeDeviceId(), cuHandle, transA, transB, m, n, k, &alpha, a.Data(), (int) a.m_numRows, a.GetNumElements(), b.Data(), (int) b.m_numRows, b.GetNumElements(), &beta, c.Data(), (int) c.m_numRows);
+    else
+        CUBLAS_CALL(cublas_gemm(cuHandle, transA, transB, m, n, k, &alpha, a.Data(), (int) a.m_numRows, b.Data(), (int) b.m_numRows, &beta, c.Data(), (int) c.m_numRows));
     c.m_numRows = m;
     c.m_numCols = n;
 }
 
+// batch of independent products: column j of c = alpha * op(A_j) * op(B_j) + beta * column j of c, see Matrix::BatchMultiplyAndWeightedAdd()
+// All products are computed by a single strided-batched GEMM; a or b of a single column is used for all of them (stride 0).
+template <class ElemType>
+void GPUMatrix<ElemType>::BatchMultiplyAndWeightedAdd(ElemType alpha, const GPUMatrix<ElemType>& a, const bool transposeA, const GPUMatrix<ElemType>& b, const bool transposeB,
+                                                      ElemType beta, GPUMatrix<ElemType>& c, size_t m, size_t n, size_t k)
+{
+    a.PrepareDevice();
+    if ((a.GetComputeDeviceId() != b.GetComputeDeviceId()) || (b.GetComputeDeviceId() != c.GetComputeDeviceId())) // different GPUs
+        InvalidArgument("All matrices must be on the same GPU");
+
+    cublasHandle_t cuHandle = GetCublasHandle(b.GetComputeDeviceId());
+    cublasOperation_t transA = transposeA ? CUBLAS_OP_T : CUBLAS_OP_N;
+    cublasOperation_t transB = transposeB ? CUBLAS_OP_T : CUBLAS_OP_N;
+    int lda = (int) (transposeA ? k : m);
+    int ldb = (int) (transposeB ? n : k);
+    int ldc = (int) m;
+    size_t strideA = a.GetNumCols() == 1 ? 0 : a.GetNumRows();
+    size_t strideB = b.GetNumCols() == 1 ? 0 : b.GetNumRows();
+    size_t strideC = c.GetNumRows();
+#if CUDA_VERSION >= 8000
+    CUBLAS_CALL(cublas_gemmStridedBatched(cuHandle, transA, transB, (int) m, (int) n, (int) k, &alpha, a.Data(), lda, (long long) strideA, b.Data(), ldb, (long long) strideB,
+                                          &beta, c.Data(), ldc, (long long) strideC, (int) c.GetNumCols()));
+#else
+    for (size_t j = 0; j < c.GetNumCols(); j++)
+        CUBLAS_CALL(cublas_gemm(cuHandle, transA, transB, (int) m, (int) n, (int) k, &alpha, a.Data() + j * strideA, lda, b.Data() + j * strideB, ldb, &beta, c.Data() + j * strideC, ldc));
+#endif
+}
+
 template <class ElemType>
 void GPUMatrix<ElemType>::Multiply1x1AndWeightedAdd(ElemType alpha, const GPUMatrix<ElemType>& a, const GPUMatrix<ElemType>& b, ElemType beta, GPUMatrix<ElemType>& c)
 {
@@ -4204,6 +5045,65 @@ void GPUMatrix<ElemType>::InnerProductWithShiftNeg(const GPUMatrix<ElemType>& a,
     }
 }
 
+template <class ElemType>
+GPUMatrix<ElemType>& GPUMatrix<ElemType>::AssignCosDistanceWithNegativeSamplesOf(const GPUMatrix<ElemType>& a, const GPUMatrix<ElemType>& b, const size_t shift, const size_t negnumber, GPUMatrix<ElemType>& invNormA, GPUMatrix<ElemType>& invNormB)
+{
+    if (a.GetComputeDeviceId() != b.GetComputeDeviceId() || b.GetComputeDeviceId() != GetComputeDeviceId()) // different GPUs
+        InvalidArgument("All matrices must be on the same GPU");
+
+    if (a.IsEmpty() || b.IsEmpty())
+        LogicError("AssignCosDistanceWithNegativeSamplesOf: one of the input matrices is empty.");
+
+    const CUDA_LONG m = (CUDA_LONG) a.GetNumRows();
+    const CUDA_LONG n = (CUDA_LONG) a.GetNumCols();
+    if (b.GetNumRows() != m || b.GetNumCols() != n)
+        InvalidArgument("AssignCosDistanceWithNegativeSamplesOf: Matrices a and b should have same dimension.");
+
+    const CUDA_LONG numRows = (CUDA_LONG) negnumber + 1;
+    RequireSize(numRows, n);
+    invNormA.RequireSize(1, n);
+    invNormB.RequireSize(1, n);
+
+    PrepareDevice();
+    SyncGuard syncGuard;
+    GridDim grid(n);
+    _assignInverseColumnNorms<ElemType><<<grid.m_blocksPerGrid, grid.m_threadsPerBlock, 0, t_stream>>>(invNormA.Data(), invNormB.Data(), a.Data(), b.Data(), m, n);
+
+    // stage the columns of a in shared memory unless they are too tall for it
+    const size_t sharedMemSize = m * sizeof(ElemType);
+    const bool useSharedMemory = sharedMemSize <= 32 * 1024;
+    const CUDA_LONG threadsPerBlock = min(GridDim::maxThreadsPerBlock, (numRows + 31) / 32 * 32);
+    _assignCosDistanceWithNegativeSamples<ElemType><<<n, threadsPerBlock, useSharedMemory ? sharedMemSize : 0, t_stream>>>(Data(), a.Data(), b.Data(), invNormA.Data(), invNormB.Data(), m, n, (CUDA_LONG) shift, numRows, useSharedMemory);
+    return *this;
+}
+
+template <class ElemType>
+GPUMatrix<ElemType>& GPUMatrix<ElemType>::AddCosDistanceWithNegativeSamplesGradientOf(const GPUMatrix<ElemType>& gradient, const GPUMatrix<ElemType>& value, const GPUMatrix<ElemType>& a, const GPUMatrix<ElemType>& b,
+                                                                                      const GPUMatrix<ElemType>& invNormA, const GPUMatrix<ElemType>& invNormB, const size_t shift, const bool isRightInput)
+{
+    if (a.GetComputeDeviceId() != b.GetComputeDeviceId() || gradient.GetComputeDeviceId() != GetComputeDeviceId() || a.GetComputeDeviceId() != GetComputeDeviceId()) // different GPUs
+        InvalidArgument("All matrices must be on the same GPU");
+
+    const auto& x        = isRightInput ? b : a; // the input whose gradient this is
+    const auto& y        = isRightInput ? a : b; // its partner
+    const auto& invNormX = isRightInput ? invNormB : invNormA;
+    const auto& invNormY = isRightInput ? invNormA : invNormB;
+
+    const CUDA_LONG m = (CUDA_LONG) x.GetNumRows();
+    const CUDA_LONG n = (CUDA_LONG) x.GetNumCols();
+    const CUDA_LONG numRows = (CUDA_LONG) gradient.GetNumRows();
+    if (n == 0)
+        return *this;
+
+    PrepareDevice();
+    SyncGuard syncGuard;
+    const size_t sharedMemSize = numRows * (2 * sizeof(ElemType) + sizeof(CUDA_LONG));
+    const CUDA_LONG threadsPerBlock = min(GridDim::maxThreadsPerBlock, (max(m, numRows) + 31) / 32 * 32);
+    _addCosDistanceWithNegativeSamplesGradient<ElemType><<<n, threadsPerBlock, sharedMemSize, t_stream>>>(Data(), gradient.Data(), value.Data(), x.Data(), y.Data(), invNormX.Data(), invNormY.Data(),
+                                                                                                          m, n, (CUDA_LONG) shift, numRows, isRightInput);
+    return *this;
+}
+
 template <class ElemType>
 GPUMatrix<ElemType>& GPUMatrix<ElemType>::GetARowByIndex(const GPUMatrix<ElemType>& a, const size_t m)
 {
@@ -4423,6 +5323,69 @@ void GPUMatrix<ElemType>::RCRFTransGrdCompute(const GPUMatrix<ElemType>& lbls,
     TracingGPUMemoryAllocator::Free<ElemType>(alpha.GetComputeDeviceId(), d_zeta);
 };
 
+// batched over all sequences of the minibatch: a single kernel launch, one block per sequence
+template <class ElemType>
+void GPUMatrix<ElemType>::RCRFForwardBackward(const GPUMatrix<ElemType>& lbls, const GPUMatrix<ElemType>& pos_scores, const GPUMatrix<ElemType>& pair_scores,
+                                              const std::vector<CRFSequence>& sequences, size_t numParallelSequences,
+                                              GPUMatrix<ElemType>& alpha, GPUMatrix<ElemType>& beta, GPUMatrix<ElemType>& objectives)
+{
+    if (pos_scores.IsEmpty() || pair_scores.IsEmpty() || lbls.GetNumRows() != pos_scores.GetNumRows() || lbls.GetNumCols() != pos_scores.GetNumCols())
+        LogicError("RCRFForwardBackward: matrix dimensions mismatched.");
+
+    int iNumLab = (int) pos_scores.GetNumRows();
+    alpha.RequireSize(iNumLab, pos_scores.GetNumCols());
+    beta.RequireSize(iNumLab, pos_scores.GetNumCols());
+    objectives.RequireSize(1, sequences.size());
+    alpha.SetValue((ElemType) LZERO); // (gaps)
+    beta.SetValue((ElemType) LZERO);
+    if (sequences.empty())
+        return;
+
+    pos_scores.PrepareDevice();
+    CRFSequence* d_sequences = reinterpret_cast<CRFSequence*>(TracingGPUMemoryAllocator::Allocate<char>(pos_scores.GetComputeDeviceId(), sizeof(CRFSequence) * sequences.size()));
+    CUDA_CALL(cudaMemcpy(d_sequences, sequences.data(), sizeof(CRFSequence) * sequences.size(), cudaMemcpyHostToDevice));
+
+    int threadsPerBlock = (int) min((size_t) GridDim::maxThreadsPerBlock, CeilDiv((size_t) iNumLab, 32) * 32);
+    SyncGuard syncGuard;
+    _rcrfForwardBackwardBatched<ElemType><<<(int) sequences.size(), threadsPerBlock, sizeof(ElemType) * iNumLab, t_stream>>>(
+        lbls.Data(), pos_scores.Data(), pair_scores.Data(), d_sequences, (int) numParallelSequences, iNumLab,
+        alpha.Data(), beta.Data(), objectives.Data());
+
+    TracingGPUMemoryAllocator::Free<char>(pos_scores.GetComputeDeviceId(), reinterpret_cast<char*>(d_sequences));
+}
+
+template <class ElemType>
+void GPUMatrix<ElemType>::RCRFViterbiDecode(const GPUMatrix<ElemType>& lbls, const GPUMatrix<ElemType>& pos_scores, const GPUMatrix<ElemType>& pair_scores,
+                                            const std::vector<CRFSequence>& sequences, size_t numParallelSequences,
+                                            GPUMatrix<ElemType>& decodedPath)
+{
+    if (pos_scores.IsEmpty() || pair_scores.IsEmpty() || lbls.GetNumRows() != pos_scores.GetNumRows() || lbls.GetNumCols() != pos_scores.GetNumCols())
+        LogicError("RCRFViterbiDecode: matrix dimensions mismatched.");
+
+    int iNumLab = (int) pos_scores.GetNumRows();
+    decodedPath.RequireSize(iNumLab, pos_scores.GetNumCols());
+    decodedPath.SetValue(0);
+    if (sequences.empty())
+        return;
+
+    pos_scores.PrepareDevice();
+    DEVICEID_TYPE deviceId = pos_scores.GetComputeDeviceId();
+    CRFSequence* d_sequences = reinterpret_cast<CRFSequence*>(TracingGPUMemoryAllocator::Allocate<char>(deviceId, sizeof(CRFSequence) * sequences.size()));
+    CUDA_CALL(cudaMemcpy(d_sequences, sequences.data(), sizeof(CRFSequence) * sequences.size(), cudaMemcpyHostToDevice));
+    ElemType* d_delta = TracingGPUMemoryAllocator::Allocate<ElemType>(deviceId, pos_scores.GetNumElements());
+    int* d_backtrace = TracingGPUMemoryAllocator::Allocate<int>(deviceId, pos_scores.GetNumElements());
+
+    int threadsPerBlock = (int) min((size_t) GridDim::maxThreadsPerBlock, CeilDiv((size_t) iNumLab, 32) * 32);
+    SyncGuard syncGuard;
+    _rcrfViterbiDecodeBatched<ElemType><<<(int) sequences.size(), threadsPerBlock, 0, t_stream>>>(
+        lbls.Data(), pos_scores.Data(), pair_scores.Data(), d_sequences, (int) numParallelSequences, iNumLab,
+        d_delta, d_backtrace, decodedPath.Data());
+
+    TracingGPUMemoryAllocator::Free<int>(deviceId, d_backtrace);
+    TracingGPUMemoryAllocator::Free<ElemType>(deviceId, d_delta);
+    TracingGPUMemoryAllocator::Free<char>(deviceId, reinterpret_cast<char*>(d_sequences));
+}
+
 // -----------------------------------------------------------------------
 // TensorView entry points from Matrix.cpp
 // -----------------------------------------------------------------------
@@ -4547,6 +5510,23 @@ void GPUMatrix<ElemType>::TensorOp(ElemType beta, const GPUMatrix<ElemType>& a,
     return TensorOpN<ElemType, 4>(beta, array<ElemType*, 4>{a.Data(), b.Data(), c.Data(), Data()}, alpha, op, reductionOp, offsets, regularOpDims, regularStrides, reducingOpDims, reducingStrides);
 }
 
+// this = program(inputs) elementwise in a single kernel, see Matrix::FusedElementwiseOp()
+template <class ElemType>
+void GPUMatrix<ElemType>::FusedElementwiseOp(const FusedElementwiseProgram& program, const std::vector<const GPUMatrix<ElemType>*>& inputs)
+{
+    PrepareDevice();
+    std::vector<const ElemType*> inputPointers;
+    std::vector<bool> inputIsColumn;
+    for (const auto* input : inputs)
+    {
+        if (input->GetComputeDeviceId() != GetComputeDeviceId())
+            InvalidArgument("All matrices must be on the same GPU");
+        inputPointers.push_back(input->Data());
+        inputIsColumn.push_back(input->GetNumCols() != GetNumCols());
+    }
+    LaunchFusedElementwiseOp<ElemType>(program, inputPointers, inputIsColumn, Data(), GetNumRows(), GetNumElements());
+}
+
 // =======================================================================
 // explicit instantiations business
 // =======================================================================
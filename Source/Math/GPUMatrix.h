@@ -197,6 +197,8 @@ public:
 
     static void SetDevice(DEVICEID_TYPE deviceId);
     DEVICEID_TYPE PrepareDevice(DEVICEID_TYPE deviceId = -1) const;
+    // creates the CUDA context, the cuBLAS handle and the cuDNN handle, see Matrix::InitializeDevice()
+    static void InitializeDevice(DEVICEID_TYPE deviceId);
 
     static cublasHandle_t GetCublasHandle(int computeDevice = -1);
     ElemType* CopyToArray() const;                                              // allocated by the callee but need to be deleted by the caller
@@ -225,8 +227,24 @@ public:
 
     ElemType Adagrad(GPUMatrix<ElemType>& gradients, const bool needAveMultiplier);
     void FSAdagrad(GPUMatrix<ElemType>& gradients, GPUMatrix<ElemType>& functionValues, ElemType learnRatePerSample, ElemType momentum, ElemType adaWeight, ElemType adaMul);
+    void Adam(GPUMatrix<ElemType>& gradients, GPUMatrix<ElemType>& functionValues, ElemType learnRatePerSample, ElemType meanMomentum, ElemType varMomentum,
+              ElemType meanCorrection, ElemType varCorrection, ElemType epsilon, ElemType weightDecay, bool updateFunctionValues);
     ElemType RmsProp(GPUMatrix<ElemType>& gradients, ElemType RMS_GAMMA, ElemType RMS_WGT_INC, ElemType RMS_WGT_MAX, ElemType RMS_WGT_DEC, ElemType RMS_WGT_MIN, const bool needAveMultiplier);
 
+    // multi-tensor updates of dense parameters on one GPU, see Matrix::MultiNormalGrad()
+    static void MultiNormalGrad(const std::vector<GPUMatrix<ElemType>*>& smoothedGradients, const std::vector<GPUMatrix<ElemType>*>& gradients, const std::vector<GPUMatrix<ElemType>*>& functionValues,
+                                ElemType learnRatePerSample, ElemType momentum, bool useNAG, const UpdateRegularization<ElemType>& regularization);
+    static void MultiAdagrad(const std::vector<GPUMatrix<ElemType>*>& smoothedGradients, const std::vector<GPUMatrix<ElemType>*>& gradients, const std::vector<GPUMatrix<ElemType>*>& functionValues,
+                             ElemType learnRatePerSample, const UpdateRegularization<ElemType>& regularization);
+    static void MultiFSAdagrad(const std::vector<GPUMatrix<ElemType>*>& smoothedGradients, const std::vector<GPUMatrix<ElemType>*>& gradients, const std::vector<GPUMatrix<ElemType>*>& functionValues,
+                               const std::vector<ElemType>& adaMuls, ElemType learnRatePerSample, ElemType momentum, ElemType adaWeight,
+                               const UpdateRegularization<ElemType>& regularization);
+    static void MultiRmsProp(const std::vector<GPUMatrix<ElemType>*>& smoothedGradients, const std::vector<GPUMatrix<ElemType>*>& gradients, const std::vector<GPUMatrix<ElemType>*>& functionValues,
+                             ElemType learnRatePerSample, ElemType RMS_GAMMA, ElemType RMS_WGT_INC, ElemType RMS_WGT_MAX, ElemType RMS_WGT_DEC, ElemType RMS_WGT_MIN,
+                             const UpdateRegularization<ElemType>& regularization);
+    // gradient clipping by norm of dense gradients on one GPU, see Matrix::MultiClipByNorm()
+    static void MultiClipByNorm(const std::vector<GPUMatrix<ElemType>*>& gradients, ElemType maxNorm, bool globalNorm, GPUMatrix<ElemType>& factors);
+
     void Reshape(const size_t numRows, const size_t numCols);
 
     // RequireSize is now the new preferred method of ensuring the correct size inside of the Matrix class. Since Resize will fail if the storage object has
@@ -249,6 +267,8 @@ public:
     void SetColumn(const GPUMatrix<ElemType>& valMat, size_t colInd);
 
     void MaskColumnsValue(const GPUMatrix<char>& columnsMask, ElemType val);
+    void AssignAugmentedImages(const GPUMatrix<char>& images, GPUMatrix<ElemType>& params, const GPUMatrix<ElemType>& mean,
+                               size_t width, size_t height, size_t channels, bool toCHW);
 
     //void SetValue(const CPUMatrix<ElemType>& deepCopyFrom);
     void SetValue(const GPUMatrix<ElemType>& deepCopyFrom);
@@ -261,6 +281,9 @@ public:
     void SetUniformRandomValue(const ElemType low, const ElemType high, unsigned long seed = USE_TIME_BASED_SEED);
     void SetGaussianRandomValue(const ElemType mean, const ElemType sigma, unsigned long seed = USE_TIME_BASED_SEED);
     void SetUniformRandomMask(const ElemType maskRate, const ElemType scaleValue, RNGHandle& rngHandle);
+    // this = beta * this + a .* mask, with mask(i) = 0 with probability maskRate and scaleValue otherwise, for the element i
+    // in column-major order: mask(i) is drawn by PhiloxRNG for (seed, offset + i), so the same arguments give the same mask.
+    GPUMatrix<ElemType>& DoElementProductOfCounterBasedMask(ElemType beta, const GPUMatrix<ElemType>& a, const ElemType maskRate, const ElemType scaleValue, uint64_t seed, uint64_t offset);
 
     GPUMatrix<ElemType> Transpose() const;
     GPUMatrix<ElemType>& AssignTransposeOf(const GPUMatrix<ElemType>& a);
@@ -268,6 +291,9 @@ public:
     GPUMatrix<ElemType>& DoGatherColumnsOf (ElemType beta, const GPUMatrix<ElemType>& idx, const GPUMatrix<ElemType>& a, ElemType alpha);
     GPUMatrix<ElemType>& DoScatterColumnsOf(ElemType beta, const GPUMatrix<ElemType>& idx, const GPUMatrix<ElemType>& a, ElemType alpha);
 
+    GPUMatrix<ElemType>& AssignNonZeroCountsOfSequences(const GPUMatrix<ElemType>& condition, size_t conditionStride, const GPUMatrix<ElemType>& sequences);
+    GPUMatrix<ElemType>& DoScatterNonZeroStepsOfSequences(const GPUMatrix<ElemType>& condition, size_t conditionStride, const GPUMatrix<ElemType>& sequences, const GPUMatrix<ElemType>& outputFirstColumns, size_t outputStride);
+
     GPUMatrix<ElemType>& operator+=(const ElemType alpha);
     GPUMatrix<ElemType> operator+(const ElemType alpha) const;
     GPUMatrix<ElemType>& AssignSumOf(const ElemType alpha, const GPUMatrix<ElemType>& a);
@@ -416,6 +442,13 @@ public:
 
     GPUMatrix<ElemType>& AssignNumOfDiff(const GPUMatrix<ElemType>& a, const GPUMatrix<ElemType>& b, bool searchInCol = false);
 
+    GPUMatrix<ElemType>& AssignLambdaRankMetricOf(const GPUMatrix<ElemType>& gains, const GPUMatrix<ElemType>& scores, const GPUMatrix<ElemType>& queryIds, GPUMatrix<ElemType>& discounts);
+    GPUMatrix<ElemType>& AddLambdaRankGradientOf(ElemType sigma, const GPUMatrix<ElemType>& gains, const GPUMatrix<ElemType>& scores, const GPUMatrix<ElemType>& queryIds, const GPUMatrix<ElemType>& discounts);
+
+    GPUMatrix<ElemType>& AssignGMMLogLikelihoodOf(const GPUMatrix<ElemType>& unnormedPriors, const GPUMatrix<ElemType>& means, const GPUMatrix<ElemType>& logStddevs, const GPUMatrix<ElemType>& features, GPUMatrix<ElemType>& posteriors);
+    GPUMatrix<ElemType>& AddGMMLogLikelihoodGradientOf(size_t inputIndex, const GPUMatrix<ElemType>& gradient, const GPUMatrix<ElemType>& unnormedPriors, const GPUMatrix<ElemType>& means, const GPUMatrix<ElemType>& logStddevs,
+                                               const GPUMatrix<ElemType>& features, const GPUMatrix<ElemType>& posteriors);
+
     GPUMatrix<ElemType>& AssignInnerProductOfMatrices(const GPUMatrix<ElemType>& a, const GPUMatrix<ElemType>& b);
 
     void AssignNoiseContrastiveEstimation(const GPUMatrix<ElemType>& a, const GPUMatrix<ElemType>& b, const GPUMatrix<ElemType>& bias,
@@ -499,6 +532,7 @@ public:
     static void Multiply(const GPUMatrix<ElemType>& a, const bool transposeA, const GPUMatrix<ElemType>& b, const bool transposeB, GPUMatrix<ElemType>& c);
     static void Multiply(const GPUMatrix<ElemType>& a, const GPUMatrix<ElemType>& b, GPUMatrix<ElemType>& c);
     static void Multiply1x1AndWeightedAdd(ElemType alpha, const GPUMatrix<ElemType>& a, const GPUMatrix<ElemType>& b, ElemType beta, GPUMatrix<ElemType>& c);
+    static void BatchMultiplyAndWeightedAdd(ElemType alpha, const GPUMatrix<ElemType>& a, const bool transposeA, const GPUMatrix<ElemType>& b, const bool transposeB, ElemType beta, GPUMatrix<ElemType>& c, size_t m, size_t n, size_t k);
 
     static void ScaleAndAdd(ElemType alpha, const GPUMatrix<ElemType>& a, GPUMatrix<ElemType>& c);
     static void ScaleAndAdd(ElemType alpha, const GPUMatrix<ElemType>& a, const GPUMatrix<ElemType>& b, GPUMatrix<ElemType>& c);
@@ -535,6 +569,7 @@ public:
                   const std::array<size_t, 4>& offsets,
                   const SmallVector<size_t>& regularOpDims, const std::array<SmallVector<ptrdiff_t>, 4>& regularStrides,
                   const SmallVector<size_t>& reducingOpDims, const std::array<SmallVector<ptrdiff_t>, 4>& reducingStrides);
+    void FusedElementwiseOp(const FusedElementwiseProgram& program, const std::vector<const GPUMatrix<ElemType>*>& inputs);
 
     static void CreateCurandObject(unsigned long seed, const char* caller);
     static void ResetCurandObject(unsigned long seed, const char* caller);
@@ -557,6 +592,9 @@ public:
     static void ConductRowElementMultiplyWithShift(const GPUMatrix<ElemType>& a, const GPUMatrix<ElemType>& b, GPUMatrix<ElemType>& c, const size_t shift, const bool isafixed);
 
     GPUMatrix<ElemType>& AssignElementProductOfWithShift(const GPUMatrix<ElemType>& a, const GPUMatrix<ElemType>& b, const size_t shift);
+    GPUMatrix<ElemType>& AssignCosDistanceWithNegativeSamplesOf(const GPUMatrix<ElemType>& a, const GPUMatrix<ElemType>& b, const size_t shift, const size_t negnumber, GPUMatrix<ElemType>& invNormA, GPUMatrix<ElemType>& invNormB);
+    GPUMatrix<ElemType>& AddCosDistanceWithNegativeSamplesGradientOf(const GPUMatrix<ElemType>& gradient, const GPUMatrix<ElemType>& value, const GPUMatrix<ElemType>& a, const GPUMatrix<ElemType>& b,
+                                                                     const GPUMatrix<ElemType>& invNormA, const GPUMatrix<ElemType>& invNormB, const size_t shift, const bool isRightInput);
 
 public:
     static void RCRFBackwardCompute(
@@ -570,22 +608,26 @@ public:
                                     GPUMatrix<ElemType>& grd,
                                     const int startLbl, // the time 0 start symbol in the output layer
                                     const int shift);
+    // batched over all sequences of a minibatch
+    static void RCRFForwardBackward(const GPUMatrix<ElemType>& lbls, const GPUMatrix<ElemType>& pos_scores, const GPUMatrix<ElemType>& pair_scores,
+                                    const std::vector<CRFSequence>& sequences, size_t numParallelSequences,
+                                    GPUMatrix<ElemType>& alpha, GPUMatrix<ElemType>& beta, GPUMatrix<ElemType>& objectives);
+    static void RCRFViterbiDecode(const GPUMatrix<ElemType>& lbls, const GPUMatrix<ElemType>& pos_scores, const GPUMatrix<ElemType>& pair_scores,
+                                  const std::vector<CRFSequence>& sequences, size_t numParallelSequences,
+                                  GPUMatrix<ElemType>& decodedPath);
 
 public:
     friend File& operator>>(File& stream, GPUMatrix<ElemType>& us)
     {
         stream.GetMarker(fileMarkerBeginSection, std::wstring(L"BMAT"));
-        size_t elsize;
+        size_t elsize; // (a matrix of the other precision is converted, e.g. when a double model is loaded as float)
         stream >> elsize;
-        if (sizeof(ElemType) != elsize)
-            LogicError("Template argument size doesn't match those in file");
         std::wstring matrixNameDummy; // Note this is not used anymore, just a dummy for compatability.
         size_t numRows, numCols;
         int format;
         stream >> matrixNameDummy >> format >> numRows >> numCols;
         ElemType* d_array = new ElemType[numRows * numCols];
-        for (size_t i = 0; i < numRows * numCols; ++i)
-            stream >> d_array[i];
+        stream.GetFloatingPointArray(d_array, numRows * numCols, elsize);
         stream.GetMarker(fileMarkerEndSection, std::wstring(L"EMAT"));
         us.SetValue(numRows, numCols, us.GetComputeDeviceId(), d_array, matrixFlagNormal | format);
         delete[] d_array;
@@ -603,9 +645,7 @@ public:
 
         stream << us.m_numRows << us.m_numCols;
         ElemType* pArray = us.CopyToArray();
-        for (size_t i = 0; i < us.GetNumElements(); ++i)
-            stream << pArray[i];
-        
+        stream.PutArray(pArray, us.GetNumElements());
         delete[] pArray;
 
         stream.PutMarker(fileMarkerEndSection, std::wstring(L"EMAT"));
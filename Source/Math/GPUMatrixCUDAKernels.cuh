@@ -14,10 +14,13 @@
 #include "CommonMatrix.h"
 #include "GPUMatrix.h"
 #include "TensorOps.h" // for exp_() etc.
+#include "PhiloxRNG.h"
 #include "device_functions.h"
 #include <cuda_runtime.h>
+#include <cuda_fp16.h>
 #include <assert.h>
 #include <float.h>
+#include <limits.h>
 #pragma pop_macro("TENSOR_OPS_DECL")
 
 // REVIEW alexeyk: disable warnings properly for GCC/clang
@@ -1453,6 +1456,30 @@ __global__ void _fsadagrad(CUDA_LONG size, ElemType* grad, ElemType* smoothAda,
     }
 }
 
+// Adam update with bias corrected accumulators and decoupled weight decay, see Matrix::AdamUpdate()
+template <class ElemType>
+__global__ void _adam(CUDA_LONG size, ElemType* grad, ElemType* smoothVar, ElemType* smoothMean, ElemType* val,
+                      ElemType lr, ElemType meanMomentum, ElemType varMomentum, ElemType meanCorrection, ElemType varCorrection,
+                      ElemType epsilon, ElemType weightDecay, bool updateFunctionValues)
+{
+    CUDA_LONG idx = blockIdx.x * blockDim.x + threadIdx.x;
+    CUDA_LONG stride = blockDim.x * gridDim.x;
+    for (; idx < size; idx += stride)
+    {
+        ElemType g = grad[idx];
+        ElemType mean = meanMomentum * smoothMean[idx] + (1.0f - meanMomentum) * g;
+        ElemType var = varMomentum * smoothVar[idx] + (1.0f - varMomentum) * g * g;
+        smoothMean[idx] = mean;
+        smoothVar[idx] = var;
+
+        ElemType step = meanCorrection * mean / (sqrt(varCorrection * var) + epsilon) + weightDecay * val[idx];
+        if (updateFunctionValues)
+            val[idx] -= lr * step;
+        else
+            grad[idx] = step;
+    }
+}
+
 template <class ElemType>
 __global__ void _rmsprop_init(
     ElemType* avars, ElemType* signs, ElemType* steps,
@@ -1522,6 +1549,252 @@ __global__ void _rmsprop(
         multipliers[i] = temp;
 }
 
+// multi-tensor updates (cf. GPUMatrix::MultiNormalGrad() etc.): one launch updates up to MultiTensorSlices::maxTensors dense
+// parameters of the same learner. The tensors are passed by value, so that a launch needs no transfer to the device; each
+// block updates maxThreadsPerBlock consecutive elements of one tensor. The regularization (UpdateRegularization) is applied
+// in the same pass, so that it costs no passes over the parameters and gradients of its own.
+template <class ElemType>
+struct MultiTensorSlices
+{
+    static const int maxTensors = 64;
+    int numTensors;
+    ElemType* smoothedGradients[maxTensors]; // the accumulators of a tensor are consecutive, each of its size
+    const ElemType* gradients[maxTensors];
+    ElemType* functionValues[maxTensors];
+    CUDA_LONG sizes[maxTensors];
+    CUDA_LONG firstBlocks[maxTensors]; // the block that updates the first elements of the tensor
+    ElemType scalars[maxTensors];      // a value of the update rule that differs between tensors, e.g. the FSAdaGrad multiplier
+};
+
+// the tensor of this block of a multi-tensor launch: the last one that starts at or before it
+__device__ __forceinline__ int _multiTensorOfBlock(const CUDA_LONG* firstBlocks, int numTensors)
+{
+    int lo = 0;
+    int hi = numTensors - 1;
+    while (lo < hi)
+    {
+        int mid = (lo + hi + 1) / 2;
+        if (firstBlocks[mid] <= (CUDA_LONG) blockIdx.x)
+            lo = mid;
+        else
+            hi = mid - 1;
+    }
+    return lo;
+}
+
+template <class ElemType, class UpdateOp>
+__global__ void _multiTensorUpdate(const MultiTensorSlices<ElemType> slices, const UpdateOp op, const UpdateRegularization<ElemType> regularization)
+{
+    const int lo = _multiTensorOfBlock(slices.firstBlocks, slices.numTensors);
+    const CUDA_LONG n = slices.sizes[lo];
+    const CUDA_LONG id = ((CUDA_LONG) blockIdx.x - slices.firstBlocks[lo]) * blockDim.x + threadIdx.x;
+    if (id >= n)
+        return;
+
+    ElemType val = slices.functionValues[lo][id];
+    const ElemType g = slices.gradients[lo][id] + regularization.l2Weight * val;
+    val -= regularization.weightDecay * val;
+
+    op(slices.smoothedGradients[lo], g, val, n, id, slices.scalars[lo]);
+
+    // L1 regularizer with proximal gradient descent method, as by _inplaceSoftThreshold
+    const ElemType threshold = regularization.l1Threshold;
+    if (threshold > 0)
+    {
+        if (val > threshold)
+            val -= threshold;
+        else if (val < -threshold)
+            val += threshold;
+        else
+            val = 0;
+    }
+    slices.functionValues[lo][id] = val;
+}
+
+// momentum SGD as by NormalGrad() for dense gradients
+template <class ElemType>
+struct MultiTensorNormalGradOp
+{
+    ElemType learnRatePerSample;
+    ElemType momentum;
+    bool useNAG;
+
+    __device__ void operator()(ElemType* smoothed, ElemType g, ElemType& val, CUDA_LONG /*n*/, CUDA_LONG id, ElemType /*scalar*/) const
+    {
+        const ElemType scaledGradient = (1 - momentum) * learnRatePerSample * g;
+        const ElemType s = momentum * smoothed[id] + scaledGradient;
+        smoothed[id] = s;
+        // w_t = w_{t-1} - momentum * v_t - (1-momentum) * learnRatePerSample * gradient for Nesterov momentum
+        val -= useNAG ? momentum * s + scaledGradient : s;
+    }
+};
+
+// AdaGrad as by _adagrad without multipliers, followed by the step
+template <class ElemType>
+struct MultiTensorAdagradOp
+{
+    ElemType learnRatePerSample;
+
+    __device__ void operator()(ElemType* smoothed, ElemType g, ElemType& val, CUDA_LONG /*n*/, CUDA_LONG id, ElemType /*scalar*/) const
+    {
+        const ElemType floor = 1e-16f;
+
+        const ElemType a = smoothed[id] + g * g;
+        smoothed[id] = a;
+        val -= learnRatePerSample * (g / sqrt(a + floor));
+    }
+};
+
+// FSAdaGrad as by _fsadagrad, with the multiplier of each tensor as its scalar
+template <class ElemType>
+struct MultiTensorFSAdagradOp
+{
+    ElemType learnRatePerSample;
+    ElemType momentum;
+    ElemType adaWeight;
+
+    __device__ void operator()(ElemType* smoothed, ElemType g, ElemType& val, CUDA_LONG n, CUDA_LONG id, ElemType adaMul) const
+    {
+        ElemType* smoothAda = smoothed;
+        ElemType* smoothMom = smoothed + n;
+
+        ElemType adaSqr = adaWeight * smoothAda[id] + (1.0f - adaWeight) * g * g;
+        smoothAda[id] = adaSqr;
+        if (adaSqr != 0.0f)
+        {
+            ElemType w;
+            if (sizeof(ElemType) == sizeof(double))
+            {
+                w = adaMul * rsqrt(adaSqr);
+            }
+            else
+            {
+                w = adaMul * rsqrtf(adaSqr);
+            }
+
+            if (w > 10.0f)
+                w = 10.0f;
+            g *= w;
+        }
+
+        if (momentum > 0.0f)
+        {
+            g = momentum * smoothMom[id] + (1.0f - momentum) * g;
+            smoothMom[id] = g;
+        }
+
+        val -= learnRatePerSample * g;
+    }
+};
+
+// RMSProp as by _rmsprop without multipliers, followed by the step
+template <class ElemType>
+struct MultiTensorRmsPropOp
+{
+    ElemType learnRatePerSample;
+    ElemType RMS_GAMMA;
+    ElemType RMS_WGT_INC;
+    ElemType RMS_WGT_MAX;
+    ElemType RMS_WGT_DEC;
+    ElemType RMS_WGT_MIN;
+
+    __device__ void operator()(ElemType* smoothed, ElemType g, ElemType& val, CUDA_LONG n, CUDA_LONG id, ElemType /*scalar*/) const
+    {
+        const ElemType floor = 1e-6f;
+
+        ElemType* avars = smoothed;         // accumulated variances for RMS scaling
+        ElemType* signs = smoothed + n;     // sign of previous gradient
+        ElemType* steps = smoothed + 2 * n; // current step size
+
+        const ElemType avar = RMS_GAMMA * avars[id] + (ElemType(1.0) - RMS_GAMMA) * (g * g);
+        avars[id] = avar;
+
+        const int grad_sign = (ElemType(0) < g) - (g < ElemType(0));
+
+        ElemType step = steps[id];
+        if (signs[id] * grad_sign > 0)
+            step = min(step * RMS_WGT_INC, RMS_WGT_MAX);
+        else
+            step = max(step * RMS_WGT_DEC, RMS_WGT_MIN);
+        steps[id] = step;
+        signs[id] = grad_sign;
+
+        val -= learnRatePerSample * (g * (step / sqrt(avar + floor)));
+    }
+};
+
+// gradient clipping by norm (cf. GPUMatrix::MultiClipByNorm()): one launch covers up to MultiTensorList::maxTensors tensors,
+// passed by value as for the multi-tensor updates. Each block covers elementsPerBlock consecutive elements of one tensor. The
+// squares of the elements of a tensor are summed up into the entry normIndices[] of the norms: its own, or with a global norm
+// the one shared by all tensors.
+template <class ElemType>
+struct MultiTensorList
+{
+    static const int maxTensors = 64;
+    static const CUDA_LONG elementsPerBlock = 8 * GridDim::maxThreadsPerBlock;
+    int numTensors;
+    ElemType* data[maxTensors];
+    CUDA_LONG sizes[maxTensors];
+    CUDA_LONG firstBlocks[maxTensors]; // the block that covers the first elements of the tensor
+    int normIndices[maxTensors];
+};
+
+// adds the sum of the squares of the elements of each tensor to its entry of 'sumsOfSquares'
+template <class ElemType>
+__global__ void _multiTensorSumOfSquares(const MultiTensorList<ElemType> list, ElemType* sumsOfSquares)
+{
+    __shared__ ElemType partialSums[GridDim::maxThreadsPerBlock];
+
+    const int t = _multiTensorOfBlock(list.firstBlocks, list.numTensors);
+    const ElemType* data = list.data[t];
+    const CUDA_LONG begin = ((CUDA_LONG) blockIdx.x - list.firstBlocks[t]) * MultiTensorList<ElemType>::elementsPerBlock;
+    const CUDA_LONG end = min(begin + MultiTensorList<ElemType>::elementsPerBlock, list.sizes[t]);
+
+    ElemType sum = 0;
+    for (CUDA_LONG id = begin + threadIdx.x; id < end; id += blockDim.x)
+        sum += data[id] * data[id];
+    partialSums[threadIdx.x] = sum;
+    __syncthreads();
+
+    for (int i = blockDim.x / 2; i > 0; i /= 2)
+    {
+        if (threadIdx.x < i)
+            partialSums[threadIdx.x] += partialSums[threadIdx.x + i];
+        __syncthreads();
+    }
+
+    if (threadIdx.x == 0)
+        atomicAdd(&sumsOfSquares[list.normIndices[t]], partialSums[0]);
+}
+
+// replaces sums of squares by the factors that scale their norms down to at most maxNorm
+template <class ElemType>
+__global__ void _clippingFactorsOfSumsOfSquares(ElemType* sumsOfSquares, const CUDA_LONG n, const ElemType maxNorm)
+{
+    const CUDA_LONG id = blockIdx.x * blockDim.x + threadIdx.x;
+    if (id >= n)
+        return;
+
+    const ElemType norm = sqrt(sumsOfSquares[id]);
+    sumsOfSquares[id] = norm > maxNorm ? maxNorm / norm : 1;
+}
+
+// scales the elements of each tensor by its entry of 'factors'
+template <class ElemType>
+__global__ void _multiTensorScale(const MultiTensorList<ElemType> list, const ElemType* factors)
+{
+    const int t = _multiTensorOfBlock(list.firstBlocks, list.numTensors);
+    const ElemType factor = factors[list.normIndices[t]];
+    if (factor == 1)
+        return;
+
+    ElemType* data = list.data[t];
+    const CUDA_LONG begin = ((CUDA_LONG) blockIdx.x - list.firstBlocks[t]) * MultiTensorList<ElemType>::elementsPerBlock;
+    const CUDA_LONG end = min(begin + MultiTensorList<ElemType>::elementsPerBlock, list.sizes[t]);
+    for (CUDA_LONG id = begin + threadIdx.x; id < end; id += blockDim.x)
+        data[id] *= factor;
+}
+
 template <class ElemType>
 __global__ void _rescaleToRange(
     ElemType* a,
@@ -1548,6 +1821,26 @@ __global__ void _setMaskAndScale(
     a[id] = a[id] <= maskRate ? 0 : scaleValue;
 }
 
+// us = beta * us + a .* mask, see DoElementProductOfCounterBasedMask()
+template <class ElemType>
+__global__ void _elementProductOfCounterBasedMask(
+    ElemType* us,
+    const ElemType* a,
+    const CUDA_LONG N,
+    const ElemType beta,
+    const ElemType maskRate,
+    const ElemType scaleValue,
+    const uint64_t seed,
+    const uint64_t offset)
+{
+    CUDA_LONG id = blockDim.x * blockIdx.x + threadIdx.x;
+    if (id >= N)
+        return;
+    uint32_t random = Microsoft::MSR::CNTK::PhiloxRNG::Generate(seed, offset + id);
+    ElemType value = Microsoft::MSR::CNTK::PhiloxRNG::ToUniform(random) <= maskRate ? 0 : a[id] * scaleValue;
+    us[id] = beta == 0 ? value : beta * us[id] + value;
+}
+
 template <class ElemType>
 __global__ void _vectorSum(
     ElemType* c,       // output
@@ -3090,6 +3383,46 @@ __global__ void _denseMulSparseCSCTransposeToSparseBlockCol2(
     }
 }
 
+// same as _denseMulSparseCSCTransposeToSparseBlockCol2(), but balanced over the non-zero values of rhs instead of its columns,
+// for columns with very different numbers of non-zeros: each thread handles one row of lhs for one non-zero value, whose
+// column is found by a binary search in the column offsets (merge path). Consecutive threads handle consecutive rows.
+// rhsNZValues and rhsRows are indexed by the absolute offsets in rhsCols, which start at firstNz.
+template <class ElemType>
+__global__ void _denseMulSparseCSCTransposeToSparseBlockColBalanced(
+    const ElemType alpha,
+    const ElemType* lhsValues,
+    const size_t numRowsLhs,
+    const size_t numColsRhs,
+    const ElemType* rhsNZValues,
+    const GPUSPARSE_INDEX_TYPE* rhsRows,
+    const GPUSPARSE_INDEX_TYPE* rhsCols,
+    const GPUSPARSE_INDEX_TYPE firstNz,
+    const LONG64 nz,
+    const GPUSPARSE_INDEX_TYPE* col2blockIds,
+    ElemType* resultValues)
+{
+    const LONG64 index = (LONG64) blockIdx.x * blockDim.x + threadIdx.x;
+    if (index >= nz * (LONG64) numRowsLhs)
+        return;
+    const CUDA_LONG p = firstNz + (CUDA_LONG) (index / numRowsLhs);
+    const CUDA_LONG lhsRow = (CUDA_LONG) (index % numRowsLhs);
+
+    // find the column of p: the last one that starts at or before it
+    CUDA_LONG lo = 0, hi = (CUDA_LONG) numColsRhs - 1;
+    while (lo < hi)
+    {
+        CUDA_LONG mid = (lo + hi + 1) / 2;
+        if (rhsCols[mid] <= p)
+            lo = mid;
+        else
+            hi = mid - 1;
+    }
+    const CUDA_LONG lhsCol = lo; // rhsCol == lhsCol
+
+    CUDA_LONG resultCol = col2blockIds[rhsRows[p]];
+    atomicAdd(&resultValues[IDX2C(lhsRow, resultCol, numRowsLhs)], alpha * lhsValues[IDX2C(lhsRow, lhsCol, numRowsLhs)] * rhsNZValues[p]);
+}
+
 // backward pass from hidden layer to feature weight
 //result (sparse BlockCol)= alpha * (lhs (dense) X rhs^T (sparse CSC)
 //assume resultValues are 0-initialized
@@ -3869,6 +4202,190 @@ __global__ void _normalGradForSparseBlock(
     lhsValues[index] = rhs[IDX2C(row, col, numRows)];
 }
 
+// applies the steps skipped since a column of a SparseBlockCol gradient was last updated, see Matrix::CatchUpLazyMomentum()
+// lastUpdates is only read here; it is set by _setLastUpdatesForSparseBlockCol afterwards
+template <class ElemType>
+__global__ void _catchUpLazyMomentumForSparseBlockCol(
+    const CUDA_LONG numRows,
+    const CUDA_LONG numBlocks,
+    const GPUSPARSE_INDEX_TYPE* blockId2Col,
+    const ElemType* lastUpdates,
+    const ElemType timestamp,
+    const ElemType learnRateScale,
+    const ElemType momentum,
+    const ElemType varMomentum,
+    ElemType* smoothedMomentum,
+    ElemType* smoothedVariance, // or nullptr
+    ElemType* functionValues)
+{
+    const CUDA_LONG index = blockIdx.x * blockDim.x + threadIdx.x;
+    const CUDA_LONG blockId = index / numRows;
+    if (blockId >= numBlocks)
+        return;
+    const CUDA_LONG row = index - numRows * blockId;
+    const CUDA_LONG col = blockId2Col[blockId];
+
+    const ElemType numSkipped = timestamp - 1 - lastUpdates[col];
+    if (numSkipped <= 0)
+        return;
+
+    ElemType momentumDecay, varianceDecay;
+    if (sizeof(ElemType) == sizeof(double))
+    {
+        momentumDecay = pow(momentum, numSkipped);
+        varianceDecay = pow(varMomentum, numSkipped);
+    }
+    else
+    {
+        momentumDecay = powf(momentum, numSkipped);
+        varianceDecay = powf(varMomentum, numSkipped);
+    }
+    // sum of momentum^i for i = 1..numSkipped
+    const ElemType decaySum = (momentum == 1) ? numSkipped : momentum * (1 - momentumDecay) / (1 - momentum);
+
+    const CUDA_LONG i = IDX2C(row, col, numRows);
+    functionValues[i] -= learnRateScale * decaySum * smoothedMomentum[i];
+    smoothedMomentum[i] *= momentumDecay;
+    if (smoothedVariance)
+        smoothedVariance[i] *= varianceDecay;
+}
+
+template <class ElemType>
+__global__ void _setLastUpdatesForSparseBlockCol(
+    const CUDA_LONG numBlocks,
+    const GPUSPARSE_INDEX_TYPE* blockId2Col,
+    const ElemType timestamp,
+    ElemType* lastUpdates)
+{
+    const CUDA_LONG blockId = blockIdx.x * blockDim.x + threadIdx.x;
+    if (blockId >= numBlocks)
+        return;
+    lastUpdates[blockId2Col[blockId]] = timestamp;
+}
+
+// FSAdagrad update (cf. _fsadagrad) of the elements of a SparseBlockCol gradient, in place of the dense ones it holds
+template <class ElemType>
+__global__ void _fsadagradForSparseBlockCol(
+    const CUDA_LONG numRows,
+    const CUDA_LONG numElements, // of the dense matrix
+    const CUDA_LONG nz,
+    const ElemType* gradientValues,
+    const GPUSPARSE_INDEX_TYPE* blockId2Col,
+    ElemType* smoothAda,
+    ElemType* functionValues,
+    const ElemType lr,
+    const ElemType mom,
+    const ElemType adaWeight,
+    const ElemType adaMul)
+{
+    const CUDA_LONG index = blockIdx.x * blockDim.x + threadIdx.x;
+    if (index >= nz)
+        return;
+    const CUDA_LONG blockId = index / numRows;
+    const CUDA_LONG row = index - numRows * blockId;
+    const CUDA_LONG i = IDX2C(row, blockId2Col[blockId], numRows);
+    ElemType* smoothMom = smoothAda + numElements;
+
+    ElemType g = gradientValues[index];
+    ElemType adaSqr = adaWeight * smoothAda[i] + (1.0f - adaWeight) * g * g;
+    smoothAda[i] = adaSqr;
+    if (adaSqr != 0.0f)
+    {
+        ElemType w;
+        if (sizeof(ElemType) == sizeof(double))
+        {
+            w = adaMul * rsqrt(adaSqr);
+        }
+        else
+        {
+            w = adaMul * rsqrtf(adaSqr);
+        }
+
+        if (w > 10.0f)
+            w = 10.0f;
+        g *= w;
+    }
+
+    if (mom > 0.0f)
+    {
+        g = mom * smoothMom[i] + (1.0f - mom) * g;
+        smoothMom[i] = g;
+    }
+
+    functionValues[i] -= lr * g;
+}
+
+// Adam update (cf. _adam) of the elements of a SparseBlockCol gradient, in place of the dense ones it holds
+template <class ElemType>
+__global__ void _adamForSparseBlockCol(
+    const CUDA_LONG numRows,
+    const CUDA_LONG numElements, // of the dense matrix
+    const CUDA_LONG nz,
+    ElemType* gradientValues,
+    const GPUSPARSE_INDEX_TYPE* blockId2Col,
+    ElemType* smoothVar,
+    ElemType* functionValues,
+    const ElemType lr,
+    const ElemType meanMomentum,
+    const ElemType varMomentum,
+    const ElemType meanCorrection,
+    const ElemType varCorrection,
+    const ElemType epsilon,
+    const ElemType weightDecay,
+    const bool updateFunctionValues)
+{
+    const CUDA_LONG index = blockIdx.x * blockDim.x + threadIdx.x;
+    if (index >= nz)
+        return;
+    const CUDA_LONG blockId = index / numRows;
+    const CUDA_LONG row = index - numRows * blockId;
+    const CUDA_LONG i = IDX2C(row, blockId2Col[blockId], numRows);
+    ElemType* smoothMean = smoothVar + numElements;
+
+    ElemType g = gradientValues[index];
+    ElemType mean = meanMomentum * smoothMean[i] + (1.0f - meanMomentum) * g;
+    ElemType var = varMomentum * smoothVar[i] + (1.0f - varMomentum) * g * g;
+    smoothMean[i] = mean;
+    smoothVar[i] = var;
+
+    ElemType step = meanCorrection * mean / (sqrt(varCorrection * var) + epsilon) + weightDecay * functionValues[i];
+    if (updateFunctionValues)
+        functionValues[i] -= lr * step;
+    else
+        gradientValues[index] = step;
+}
+
+// copies the blocks of a SparseBlockCol matrix into the layout given by newBlockId2Col, zeros where it has no block
+template <class ElemType>
+__global__ void _relayoutSparseBlockCol(
+    const CUDA_LONG numRows,
+    const CUDA_LONG numNewBlocks,
+    const GPUSPARSE_INDEX_TYPE* newBlockId2Col,
+    const GPUSPARSE_INDEX_TYPE* col2BlockId,
+    const ElemType* values,
+    ElemType* newValues)
+{
+    const CUDA_LONG index = blockIdx.x * blockDim.x + threadIdx.x;
+    const CUDA_LONG newBlockId = index / numRows;
+    if (newBlockId >= numNewBlocks)
+        return;
+    const CUDA_LONG row = index - numRows * newBlockId;
+    const GPUSPARSE_INDEX_TYPE blockId = col2BlockId[newBlockId2Col[newBlockId]];
+    newValues[index] = (blockId == Id_NotAssigned) ? 0 : values[blockId * numRows + row];
+}
+
+template <class ElemType>
+__global__ void _setCol2BlockIdsForSparseBlockCol(
+    const CUDA_LONG numBlocks,
+    const GPUSPARSE_INDEX_TYPE* blockId2Col,
+    GPUSPARSE_INDEX_TYPE* col2BlockId)
+{
+    const CUDA_LONG blockId = blockIdx.x * blockDim.x + threadIdx.x;
+    if (blockId >= numBlocks)
+        return;
+    col2BlockId[blockId2Col[blockId]] = blockId;
+}
+
 //This function should be called with 1024 threads per block and 1 block
 //THIS IS NOT THE MOST EFFICIENT IMPLEMENTATION!!!
 template <class ElemType>
@@ -4506,6 +5023,130 @@ __global__ void _innerProductWithShiftNeg(
     c[IDX2C(idx, idy, NTPlusOne)] = sum;
 }
 
+// column of b that row m of the CosDistanceWithNegativeSamples result pairs with column j of a
+__device__ __forceinline__ CUDA_LONG _cosDistanceWithNegativeSamplesColumn(const CUDA_LONG j, const CUDA_LONG m, const CUDA_LONG shift, const CUDA_LONG n)
+{
+    return m == 0 ? j : (j + shift + m - 1) % n;
+}
+
+// inverse 2-norms of the columns of a and b, one thread per column
+template <class ElemType>
+__global__ void _assignInverseColumnNorms(
+    ElemType* invNormA,
+    ElemType* invNormB,
+    const ElemType* a,
+    const ElemType* b,
+    const CUDA_LONG N, // a.GetNumRows();
+    const CUDA_LONG M) // a.GetNumCols();
+{
+    CUDA_LONG j = blockDim.x * blockIdx.x + threadIdx.x;
+    if (j >= M)
+        return;
+
+    ElemType sumA = 0;
+    ElemType sumB = 0;
+    for (CUDA_LONG i = 0; i < N; ++i)
+    {
+        sumA += a[IDX2C(i, j, N)] * a[IDX2C(i, j, N)];
+        sumB += b[IDX2C(i, j, N)] * b[IDX2C(i, j, N)];
+    }
+    invNormA[j] = 1 / max(sqrt_(sumA), (ElemType) EPS_IN_INVERSE);
+    invNormB[j] = 1 / max(sqrt_(sumB), (ElemType) EPS_IN_INVERSE);
+}
+
+// all cosines of column j of a, one block per column j and one thread per result row.
+// Column j of a is staged in shared memory once and read by all rows, if it fits (useSharedMemory).
+template <class ElemType>
+__global__ void _assignCosDistanceWithNegativeSamples(
+    ElemType* c,
+    const ElemType* a,
+    const ElemType* b,
+    const ElemType* invNormA,
+    const ElemType* invNormB,
+    const CUDA_LONG N, // a.GetNumRows();
+    const CUDA_LONG M, // a.GetNumCols();
+    const CUDA_LONG shift,
+    const CUDA_LONG NTPlusOne,
+    const bool useSharedMemory)
+{
+    extern __shared__ double sh_aCol[]; // [N] if useSharedMemory
+    const CUDA_LONG j = blockIdx.x;
+    const ElemType* aCol = a + IDX2C(0, j, N);
+    if (useSharedMemory)
+    {
+        ElemType* aColShared = (ElemType*) sh_aCol;
+        for (CUDA_LONG i = threadIdx.x; i < N; i += blockDim.x)
+            aColShared[i] = aCol[i];
+        __syncthreads();
+        aCol = aColShared;
+    }
+
+    for (CUDA_LONG m = threadIdx.x; m < NTPlusOne; m += blockDim.x)
+    {
+        const CUDA_LONG p = _cosDistanceWithNegativeSamplesColumn(j, m, shift, M);
+        const ElemType* bCol = b + IDX2C(0, p, N);
+        ElemType sum = 0;
+        for (CUDA_LONG i = 0; i < N; ++i)
+            sum += aCol[i] * bCol[i];
+        c[IDX2C(m, j, NTPlusOne)] = sum * invNormA[j] * invNormB[p];
+    }
+}
+
+// us(:,q) += gradient of all cosines that x(:,q) takes part in, one block per column q.
+// The per-row coefficients are computed once into shared memory; then the threads run over the elements of the column.
+// x is a if the partner column is found by shifting forward (isRightInput false), and b otherwise.
+template <class ElemType>
+__global__ void _addCosDistanceWithNegativeSamplesGradient(
+    ElemType* us,
+    const ElemType* gradient,
+    const ElemType* value,
+    const ElemType* x,
+    const ElemType* y,
+    const ElemType* invNormX,
+    const ElemType* invNormY,
+    const CUDA_LONG N, // x.GetNumRows();
+    const CUDA_LONG M, // x.GetNumCols();
+    const CUDA_LONG shift,
+    const CUDA_LONG NTPlusOne,
+    const bool isRightInput)
+{
+    extern __shared__ double sh_coefs[]; // [NTPlusOne] coefficients, [NTPlusOne] self terms, [NTPlusOne] partner columns
+    __shared__ ElemType selfCoef[1];
+    ElemType* coef = (ElemType*) sh_coefs;
+    ElemType* self = coef + NTPlusOne;
+    CUDA_LONG* partner = (CUDA_LONG*) (self + NTPlusOne);
+
+    const CUDA_LONG q = blockIdx.x;
+    for (CUDA_LONG m = threadIdx.x; m < NTPlusOne; m += blockDim.x)
+    {
+        const CUDA_LONG s = _cosDistanceWithNegativeSamplesColumn(0, m, shift, M);
+        const CUDA_LONG p = isRightInput ? (q + M - s) % M : (q + s) % M;
+        const CUDA_LONG j = isRightInput ? p : q;
+        const ElemType g = gradient[IDX2C(m, j, NTPlusOne)];
+        coef[m] = g * invNormX[q] * invNormY[p];
+        self[m] = g * value[IDX2C(m, j, NTPlusOne)];
+        partner[m] = p;
+    }
+    __syncthreads();
+
+    if (threadIdx.x == 0)
+    {
+        ElemType sum = 0;
+        for (CUDA_LONG m = 0; m < NTPlusOne; ++m)
+            sum += self[m];
+        selfCoef[0] = sum * invNormX[q] * invNormX[q];
+    }
+    __syncthreads();
+
+    for (CUDA_LONG i = threadIdx.x; i < N; i += blockDim.x)
+    {
+        ElemType sum = 0;
+        for (CUDA_LONG m = 0; m < NTPlusOne; ++m)
+            sum += coef[m] * y[IDX2C(i, partner[m], N)];
+        us[IDX2C(i, q, N)] += sum - selfCoef[0] * x[IDX2C(i, q, N)];
+    }
+}
+
 template <class ElemType>
 __global__ void _getARowByIndex(
     ElemType* us,
@@ -4800,6 +5441,168 @@ __global__ void _rcrfTransGrdComputeMax1024Labels(
     }
 };
 
+// index of the (one-hot) label in column j of lbls, or -1 if the column has none
+template <class ElemType>
+__device__ int _rcrfLabelOf(const ElemType* lbls, size_t j, int iNumLab)
+{
+    for (int k = 0; k < iNumLab; k++)
+        if (lbls[IDX2C(k, j, iNumLab)] != 0)
+            return k;
+    return -1;
+}
+
+// batched R-CRF forward-backward, see CPUMatrix::RCRFForwardBackward()
+// One block per sequence, each thread loops over labels k = threadIdx.x + n * blockDim.x.
+// Shared memory: zeta [iNumLab].
+template <class ElemType>
+__global__ void _rcrfForwardBackwardBatched(const ElemType* lbls, const ElemType* pos_scores, const ElemType* pair_scores,
+                                            const CRFSequence* sequences, const int numParallelSequences, const int iNumLab,
+                                            ElemType* alpha, ElemType* beta, ElemType* objectives)
+{
+    extern __shared__ double sh_zeta[];
+    ElemType* zeta = (ElemType*) sh_zeta;
+    __shared__ int firstLbl;
+    __shared__ ElemType logZ;
+
+    const CRFSequence seq = sequences[blockIdx.x];
+    const int T = seq.numFrames;
+#define COL(t) ((size_t) (seq.tBegin + (t)) * numParallelSequences + seq.s)
+
+    if (threadIdx.x == 0)
+        firstLbl = _rcrfLabelOf(lbls, COL(0), iNumLab);
+    __syncthreads();
+
+    // forward
+    for (int t = 0; t < T; t++)
+    {
+        for (int k = threadIdx.x; k < iNumLab; k += blockDim.x)
+        {
+            ElemType fTmp;
+            if (t == 0)
+                fTmp = firstLbl >= 0 ? pair_scores[IDX2C(k, firstLbl, iNumLab)] : 0;
+            else
+            {
+                fTmp = LZERO;
+                for (int j = 0; j < iNumLab; j++)
+                    fTmp = logaddk(fTmp, alpha[IDX2C(j, COL(t - 1), iNumLab)] + pair_scores[IDX2C(k, j, iNumLab)]);
+            }
+            alpha[IDX2C(k, COL(t), iNumLab)] = fTmp + pos_scores[IDX2C(k, COL(t), iNumLab)];
+        }
+        __syncthreads();
+    }
+
+    // objective: score of all paths minus the score of the labeled path
+    if (threadIdx.x == 0)
+    {
+        ElemType fSum = LZERO;
+        for (int k = 0; k < iNumLab; k++)
+            fSum = logaddk(fSum, alpha[IDX2C(k, COL(T - 1), iNumLab)]);
+        logZ = fSum;
+        ElemType pathScore = 0;
+        int prevLbl = -1;
+        for (int t = 0; t < T; t++)
+        {
+            int lbl = _rcrfLabelOf(lbls, COL(t), iNumLab);
+            if (lbl >= 0)
+                pathScore += pos_scores[IDX2C(lbl, COL(t), iNumLab)];
+            if (lbl >= 0 && prevLbl >= 0)
+                pathScore += pair_scores[IDX2C(lbl, prevLbl, iNumLab)];
+            prevLbl = lbl;
+        }
+        objectives[blockIdx.x] = logZ - pathScore;
+    }
+    __syncthreads();
+
+    // backward
+    for (int k = threadIdx.x; k < iNumLab; k += blockDim.x)
+        beta[IDX2C(k, COL(T - 1), iNumLab)] = alpha[IDX2C(k, COL(T - 1), iNumLab)] - logZ;
+    for (int t = T - 2; t >= 0; t--)
+    {
+        for (int j = threadIdx.x; j < iNumLab; j += blockDim.x)
+        {
+            ElemType fSum = LZERO;
+            for (int m = 0; m < iNumLab; m++)
+                fSum = logaddk(fSum, alpha[IDX2C(m, COL(t), iNumLab)] + pair_scores[IDX2C(j, m, iNumLab)]);
+            zeta[j] = fSum;
+        }
+        __syncthreads(); // (also makes beta(:,t+1) visible)
+        for (int k = threadIdx.x; k < iNumLab; k += blockDim.x)
+        {
+            ElemType fTmp = LZERO;
+            ElemType a = alpha[IDX2C(k, COL(t), iNumLab)];
+            for (int j = 0; j < iNumLab; j++)
+                fTmp = logaddk(fTmp, beta[IDX2C(j, COL(t + 1), iNumLab)] + a + pair_scores[IDX2C(j, k, iNumLab)] - zeta[j]);
+            beta[IDX2C(k, COL(t), iNumLab)] = fTmp;
+        }
+        __syncthreads(); // (zeta gets overwritten next)
+    }
+#undef COL
+}
+
+// batched Viterbi decoding, see CPUMatrix::RCRFViterbiDecode()
+// One block per sequence, threads over labels as above. 'delta' has the layout of pos_scores and serves as work space.
+// 'backtrace' is [iNumLab x #columns]. decodedPath must be zeroed.
+template <class ElemType>
+__global__ void _rcrfViterbiDecodeBatched(const ElemType* lbls, const ElemType* pos_scores, const ElemType* pair_scores,
+                                          const CRFSequence* sequences, const int numParallelSequences, const int iNumLab,
+                                          ElemType* delta, int* backtrace, ElemType* decodedPath)
+{
+    __shared__ int firstLbl;
+
+    const CRFSequence seq = sequences[blockIdx.x];
+    const int T = seq.numFrames;
+#define COL(t) ((size_t) (seq.tBegin + (t)) * numParallelSequences + seq.s)
+
+    if (threadIdx.x == 0)
+        firstLbl = _rcrfLabelOf(lbls, COL(0), iNumLab);
+    __syncthreads();
+
+    for (int t = 0; t < T; t++)
+    {
+        for (int k = threadIdx.x; k < iNumLab; k += blockDim.x)
+        {
+            ElemType fMax = LZERO;
+            int iMax = firstLbl;
+            if (t == 0)
+                fMax = (firstLbl < 0 || k == firstLbl) ? 0 : LZERO;
+            else
+            {
+                for (int j = 0; j < iNumLab; j++)
+                {
+                    ElemType fTmp = delta[IDX2C(j, COL(t - 1), iNumLab)] + pair_scores[IDX2C(k, j, iNumLab)];
+                    if (j == 0 || fTmp > fMax)
+                    {
+                        fMax = fTmp;
+                        iMax = j;
+                    }
+                }
+            }
+            delta[IDX2C(k, COL(t), iNumLab)] = fMax + pos_scores[IDX2C(k, COL(t), iNumLab)];
+            backtrace[IDX2C(k, COL(t), iNumLab)] = iMax;
+        }
+        __syncthreads();
+    }
+
+    // trace back the best path  --sequential, but only O(T)
+    if (threadIdx.x == 0)
+    {
+        int lbl = _rcrfLabelOf(lbls, COL(T - 1), iNumLab);
+        if (lbl < 0) // unconstrained end: best final score
+        {
+            lbl = 0;
+            for (int k = 1; k < iNumLab; k++)
+                if (delta[IDX2C(k, COL(T - 1), iNumLab)] > delta[IDX2C(lbl, COL(T - 1), iNumLab)])
+                    lbl = k;
+        }
+        for (int t = T - 1; t >= 0; t--)
+        {
+            decodedPath[IDX2C(lbl, COL(t), iNumLab)] = 1;
+            lbl = backtrace[IDX2C(lbl, COL(t), iNumLab)];
+        }
+    }
+#undef COL
+}
+
 template <class ElemType>
 __global__ void _reductionLogAddSum(
     const ElemType* data,
@@ -4903,6 +5706,149 @@ __global__ void _copyTopKResults(const uint64_t* indexes, const ElemType* values
     maxValues[id] = values[icol * crow + irow];
 }
 
+// Integer keys in the order of the values, for the radix selection of the top values below: -0 and +0 get the same
+// key, and NaN sorts above +inf.
+template <class ElemType>
+struct TopKKey;
+template <>
+struct TopKKey<float>
+{
+    typedef unsigned int Type;
+    static __device__ Type Of(float v)
+    {
+        Type bits = __float_as_uint(v == 0 ? 0.0f : v);
+        return (bits & 0x80000000u) ? ~bits : (bits | 0x80000000u);
+    }
+};
+template <>
+struct TopKKey<double>
+{
+    typedef unsigned long long Type;
+    static __device__ Type Of(double v)
+    {
+        Type bits = (Type) __double_as_longlong(v == 0 ? 0.0 : v);
+        return (bits >> 63) ? ~bits : (bits | (1ull << 63));
+    }
+};
+
+// The topK largest values of each column and their row indices, in descending order; equal values are ordered by
+// the row index. One block per column, which
+//  1. finds the key of the topK-th largest value by a radix selection, 8 bits at a time from the most significant,
+//     with a histogram in shared memory of the elements that match the digits found so far,
+//  2. gathers the elements above that key and the first ones equal to it, in the order of the rows, and
+//  3. sorts these by a bitonic sort in shared memory, over 'sortSize' (the power of 2 >= topK) keys and row indices.
+// Only reads the column, (sizeof(ElemType) + 1) times; unlike a sort, needs no memory besides the results.
+template <int BlockSize, class ElemType>
+__global__ void _selectTopKPerColumn(const ElemType* values, CUDA_LONG crow, int topK, int sortSize, ElemType* maxIndexes, ElemType* maxValues)
+{
+    typedef typename TopKKey<ElemType>::Type Key;
+    const int RadixBits = 8;
+    const int RadixSize = 1 << RadixBits;
+    typedef cub::BlockScan<int, BlockSize> BlockScan;
+    __shared__ typename BlockScan::TempStorage scanStorage;
+    __shared__ int histogram[RadixSize];
+    __shared__ Key selectedPrefix;
+    __shared__ int selectedRemaining;
+    extern __shared__ char topKBuffer[]; // sortSize keys, then sortSize row indices
+    Key* sortKeys = reinterpret_cast<Key*>(topKBuffer);
+    int* sortRows = reinterpret_cast<int*>(sortKeys + sortSize);
+
+    const ElemType* column = values + (size_t) blockIdx.x * crow;
+
+    // 1. radix selection
+    Key prefix = 0, prefixMask = 0;
+    int remaining = topK; // how many of the elements that match the prefix are among the top
+    for (int shift = sizeof(Key) * 8 - RadixBits; shift >= 0; shift -= RadixBits)
+    {
+        for (int i = threadIdx.x; i < RadixSize; i += BlockSize)
+            histogram[i] = 0;
+        __syncthreads();
+        for (CUDA_LONG i = threadIdx.x; i < crow; i += BlockSize)
+        {
+            Key key = TopKKey<ElemType>::Of(column[i]);
+            if ((key & prefixMask) == prefix)
+                atomicAdd(&histogram[(key >> shift) & (RadixSize - 1)], 1);
+        }
+        __syncthreads();
+        if (threadIdx.x == 0)
+        {
+            int digit = RadixSize - 1;
+            while (histogram[digit] < remaining)
+                remaining -= histogram[digit--];
+            selectedPrefix = prefix | ((Key) digit << shift);
+            selectedRemaining = remaining;
+        }
+        __syncthreads();
+        prefix = selectedPrefix;
+        remaining = selectedRemaining;
+        prefixMask |= (Key)(RadixSize - 1) << shift;
+    }
+    const Key threshold = prefix; // the key of the topK-th largest value
+    const int numAbove = topK - remaining;
+
+    // 2. gather; the counts of a round fit into 16 bits each, so that one scan gives the positions of both kinds
+    int numAboveSoFar = 0, numEqualSoFar = 0;
+    for (CUDA_LONG start = 0; start < crow && (numAboveSoFar < numAbove || numEqualSoFar < remaining); start += BlockSize)
+    {
+        CUDA_LONG i = start + threadIdx.x;
+        Key key = i < crow ? TopKKey<ElemType>::Of(column[i]) : 0;
+        int isAbove = i < crow && key > threshold;
+        int isEqual = i < crow && key == threshold;
+        int offsets, counts;
+        BlockScan(scanStorage).ExclusiveSum(isAbove | (isEqual << 16), offsets, counts);
+        int slot = -1;
+        if (isAbove)
+            slot = numAboveSoFar + (offsets & 0xffff);
+        else if (isEqual && numEqualSoFar + (offsets >> 16) < remaining)
+            slot = numAbove + numEqualSoFar + (offsets >> 16);
+        if (slot >= 0)
+        {
+            sortKeys[slot] = key;
+            sortRows[slot] = (int) i;
+        }
+        numAboveSoFar += counts & 0xffff;
+        numEqualSoFar += counts >> 16;
+        __syncthreads(); // before scanStorage is reused
+    }
+    for (int slot = topK + threadIdx.x; slot < sortSize; slot += BlockSize) // padding, sorts last
+    {
+        sortKeys[slot] = 0;
+        sortRows[slot] = INT_MAX;
+    }
+    __syncthreads();
+
+    // 3. bitonic sort, larger keys first, then smaller rows
+    for (int size = 2; size <= sortSize; size <<= 1)
+    {
+        for (int stride = size / 2; stride > 0; stride >>= 1)
+        {
+            for (int t = threadIdx.x; t < sortSize / 2; t += BlockSize)
+            {
+                int a = 2 * t - (t & (stride - 1));
+                int b = a + stride;
+                bool bBeforeA = sortKeys[b] > sortKeys[a] || (sortKeys[b] == sortKeys[a] && sortRows[b] < sortRows[a]);
+                if (((a & size) == 0) == bBeforeA)
+                {
+                    Key key = sortKeys[a];
+                    sortKeys[a] = sortKeys[b];
+                    sortKeys[b] = key;
+                    int row = sortRows[a];
+                    sortRows[a] = sortRows[b];
+                    sortRows[b] = row;
+                }
+            }
+            __syncthreads();
+        }
+    }
+
+    for (int r = threadIdx.x; r < topK; r += BlockSize)
+    {
+        size_t id = (size_t) blockIdx.x * topK + r;
+        maxIndexes[id] = (ElemType) sortRows[r];
+        maxValues[id] = column[sortRows[r]];
+    }
+}
+
 template <int BlockSize, class ElemType>
 __global__ void _assignNumOfDiffCol(const ElemType* a, const ElemType* b, ElemType* c, CUDA_LONG crowB, CUDA_LONG ccol)
 {
@@ -4932,6 +5878,268 @@ __global__ void _assignNumOfDiffCol(const ElemType* a, const ElemType* b, ElemTy
         *c = res;
 }
 
+// LambdaRank, see GPUMatrix::AssignLambdaRankMetricOf(). The urls of a query are the consecutive columns with the same
+// query id; every thread finds the bounds of its query itself, so that no segment offsets have to be computed first.
+template <class ElemType>
+__device__ void _lambdaRankQueryBounds(const ElemType* queryIds, CUDA_LONG n, CUDA_LONG i, CUDA_LONG& begin, CUDA_LONG& end)
+{
+    int queryId = (int) queryIds[i];
+    for (begin = i; begin > 0 && (int) queryIds[begin - 1] == queryId; begin--)
+        ;
+    for (end = i + 1; end < n && (int) queryIds[end] == queryId; end++)
+        ;
+}
+
+// whether url j is ranked before url i of the same query: by descending score, with NaN scores last,
+// and ties broken by ascending gain and then by position; must match LambdaRankPrecedes() in CPUMatrix.cpp
+template <class ElemType>
+__device__ bool _lambdaRankPrecedes(ElemType scoreJ, ElemType gainJ, CUDA_LONG j, ElemType scoreI, ElemType gainI, CUDA_LONG i)
+{
+    bool nanJ = ::isnan(scoreJ), nanI = ::isnan(scoreI);
+    if (nanJ != nanI)
+        return nanI;
+    if (!nanJ && scoreJ != scoreI)
+        return scoreJ > scoreI;
+    if (gainJ != gainI)
+        return gainJ < gainI;
+    return j < i;
+}
+
+// NDCG of the ideal ranking, i.e. of the given order of the urls
+template <class ElemType>
+__device__ ElemType _lambdaRankIdealMetric(const ElemType* gains, CUDA_LONG begin, CUDA_LONG end)
+{
+    ElemType idealMetric = 0;
+    for (CUDA_LONG k = begin; k < end; k++)
+        idealMetric += gains[k] / log_((ElemType) (2 + k - begin));
+    return idealMetric;
+}
+
+// discounts[i] = log(2 + rank of url i in its query); the rank is counted, one thread per url
+template <class ElemType>
+__global__ void _lambdaRankDiscounts(const ElemType* gains, const ElemType* scores, const ElemType* queryIds, ElemType* discounts, CUDA_LONG n)
+{
+    CUDA_LONG i = blockIdx.x * blockDim.x + threadIdx.x;
+    if (i >= n)
+        return;
+
+    CUDA_LONG begin, end;
+    _lambdaRankQueryBounds(queryIds, n, i, begin, end);
+    ElemType scoreI = scores[i], gainI = gains[i];
+    CUDA_LONG rank = 0;
+    for (CUDA_LONG j = begin; j < end; j++)
+        rank += _lambdaRankPrecedes(scores[j], gains[j], j, scoreI, gainI, i);
+    discounts[i] = log_((ElemType) (2 + rank));
+}
+
+// metric = (1 - NDCG averaged over the queries) * 100 * n, from the discounts of _lambdaRankDiscounts(); one thread per query
+template <int BlockSize, class ElemType>
+__global__ void _lambdaRankMetric(const ElemType* gains, const ElemType* queryIds, const ElemType* discounts, ElemType* metric, CUDA_LONG n)
+{
+    assert(gridDim.x == 1 && gridDim.y == 1 && gridDim.z == 1);
+
+    ElemType sum = 0;
+    int numQueries = 0;
+    for (CUDA_LONG begin = threadIdx.x; begin < n; begin += blockDim.x)
+    {
+        if (begin > 0 && (int) queryIds[begin - 1] == (int) queryIds[begin])
+            continue;
+
+        int queryId = (int) queryIds[begin];
+        CUDA_LONG end = begin + 1;
+        while (end < n && (int) queryIds[end] == queryId)
+            end++;
+        ElemType idealMetric = _lambdaRankIdealMetric(gains, begin, end);
+        ElemType queryMetric = 0;
+        for (CUDA_LONG k = begin; k < end; k++)
+            queryMetric += gains[k] / discounts[k];
+        if (idealMetric != 0)
+            sum += queryMetric / idealMetric;
+        numQueries++;
+    }
+
+    using BlockReduceSumT = cub::BlockReduce<ElemType, BlockSize>;
+    using BlockReduceCountT = cub::BlockReduce<int, BlockSize>;
+    __shared__ typename BlockReduceSumT::TempStorage tmpSum;
+    __shared__ typename BlockReduceCountT::TempStorage tmpCount;
+
+    sum = BlockReduceSumT(tmpSum).Sum(sum);
+    numQueries = BlockReduceCountT(tmpCount).Sum(numQueries);
+    if (threadIdx.x == 0)
+        *metric = (1 - sum / numQueries) * 100 * n;
+}
+
+// gradient[i] += the lambdas of the pairs (i, j) of urls of the query where i has the larger gain: one thread per url,
+// which sums over the urls j after it and subtracts the lambdas of the urls j before it, so that no atomics are needed
+template <class ElemType>
+__global__ void _lambdaRankAddGradient(ElemType sigma, const ElemType* gains, const ElemType* scores, const ElemType* queryIds, const ElemType* discounts, ElemType* gradient, CUDA_LONG n)
+{
+    CUDA_LONG i = blockIdx.x * blockDim.x + threadIdx.x;
+    if (i >= n)
+        return;
+
+    CUDA_LONG begin, end;
+    _lambdaRankQueryBounds(queryIds, n, i, begin, end);
+    ElemType idealMetric = _lambdaRankIdealMetric(gains, begin, end);
+    if (idealMetric == 0)
+        return;
+
+    // urls with the smallest gain of the query, the last one, only appear as the second url of a pair
+    ElemType minGain = gains[end - 1];
+    ElemType gainI = gains[i], scoreI = scores[i], discountI = discounts[i];
+    ElemType lambdaSum = 0;
+    CUDA_LONG last = gainI > minGain ? end : i;
+    for (CUDA_LONG j = begin; j < last; j++)
+    {
+        if (j == i || (j < i && !(gains[j] > minGain)))
+            continue;
+        ElemType gainJ = gains[j];
+        if (fabs_(gainI - gainJ) < (ElemType) 0.0000001)
+            continue;
+
+        // the first url of the pair is the one that comes first
+        bool first = i < j;
+        ElemType gain1 = first ? gainI : gainJ, gain2 = first ? gainJ : gainI;
+        ElemType discount1 = first ? discountI : discounts[j], discount2 = first ? discounts[j] : discountI;
+        ElemType score1 = first ? scoreI : scores[j], score2 = first ? scores[j] : scoreI;
+
+        // |delta NDCG| * -sigma / (1 + exp(sigma * (s1 - s2)))
+        ElemType deltaMetric = fabs_((gain1 - gain2) * (discount1 - discount2) / (discount1 * discount2) / idealMetric);
+        ElemType lambda = -sigma / (1 + exp_(sigma * (score1 - score2))) * deltaMetric;
+        lambdaSum += first ? lambda : -lambda;
+    }
+    gradient[i] += lambdaSum;
+}
+
+// log of the normalizer of the softmax of the K unnormed priors
+template <class ElemType>
+__device__ ElemType _gmmLogPriorNormalizer(const ElemType* u, CUDA_LONG numComponents)
+{
+    ElemType maxU = -FLT_MAX;
+    for (CUDA_LONG c = 0; c < numComponents; c++)
+        maxU = max(maxU, u[c]);
+    ElemType sumU = 0;
+    for (CUDA_LONG c = 0; c < numComponents; c++)
+        sumU += exp_(u[c] - maxU);
+    return maxU + log_(sumU);
+}
+
+// GMM log-likelihood, see GPUMatrix::AssignGMMLogLikelihoodOf(): one block per sample, whose threads take the components
+// in turn and keep a running log-sum-exp of their log-likelihoods, which are combined across the block at the end.
+// The strides of the parameters are 0 if all samples share their column.
+template <int BlockSize, class ElemType>
+__global__ void _assignGMMLogLikelihood(const ElemType* unnormedPriors, CUDA_LONG priorsStride, const ElemType* means, CUDA_LONG meansStride,
+                                        const ElemType* logStddevs, CUDA_LONG logStddevsStride, const ElemType* features, ElemType logNormalizer,
+                                        ElemType* logLikelihoods, ElemType* posteriors, CUDA_LONG numComponents, CUDA_LONG dim)
+{
+    using BlockReduceT = cub::BlockReduce<ElemType, BlockSize>;
+    __shared__ typename BlockReduceT::TempStorage tmp;
+    __shared__ ElemType blockMax;
+    __shared__ ElemType logPriorNormalizer;
+
+    const CUDA_LONG t = blockIdx.x;
+    const ElemType* u = unnormedPriors + t * priorsStride;
+    const ElemType* mean = means + t * meansStride;
+    const ElemType* logStddev = logStddevs + t * logStddevsStride;
+    const ElemType* x = features + t * dim;
+    ElemType* posterior = posteriors + t * numComponents;
+
+    if (threadIdx.x == 0)
+        logPriorNormalizer = _gmmLogPriorNormalizer(u, numComponents);
+    __syncthreads();
+
+    ElemType maxLL = -FLT_MAX;
+    ElemType sumLL = 0;
+    for (CUDA_LONG c = threadIdx.x; c < numComponents; c += BlockSize)
+    {
+        ElemType distance = 0;
+        for (CUDA_LONG d = 0; d < dim; d++)
+        {
+            ElemType diff = x[d] - mean[c * dim + d];
+            distance += diff * diff;
+        }
+        ElemType ll = u[c] - logPriorNormalizer - (ElemType) 0.5 * distance * exp_(-2 * logStddev[c]) - dim * logStddev[c] - logNormalizer;
+        posterior[c] = ll;
+        if (ll > maxLL)
+        {
+            sumLL = sumLL * exp_(maxLL - ll) + 1;
+            maxLL = ll;
+        }
+        else
+            sumLL += exp_(ll - maxLL);
+    }
+
+    // combine the running sums of the threads
+    ElemType m = BlockReduceT(tmp).Reduce(maxLL, cub::Max());
+    if (threadIdx.x == 0)
+        blockMax = m;
+    __syncthreads();
+    ElemType sum = BlockReduceT(tmp).Sum(sumLL * exp_(maxLL - blockMax));
+    __shared__ ElemType logLikelihood;
+    if (threadIdx.x == 0)
+    {
+        logLikelihood = blockMax + log_(sum);
+        logLikelihoods[t] = logLikelihood;
+    }
+    __syncthreads();
+
+    for (CUDA_LONG c = threadIdx.x; c < numComponents; c += BlockSize)
+        posterior[c] = exp_(posterior[c] - logLikelihood);
+}
+
+// adds the gradient for input 'inputIndex' of _assignGMMLogLikelihood(), see CPUMatrix::AddGMMLogLikelihoodGradientOf():
+// one thread per element of the gradient, which sums over the samples if the input is shared by them (gradientStride 0)
+template <class ElemType>
+__global__ void _addGMMLogLikelihoodGradient(int inputIndex, ElemType* result, CUDA_LONG numRows, CUDA_LONG numCols, CUDA_LONG gradientStride, const ElemType* gradient,
+                                             const ElemType* unnormedPriors, CUDA_LONG priorsStride, const ElemType* means, CUDA_LONG meansStride,
+                                             const ElemType* logStddevs, CUDA_LONG logStddevsStride, const ElemType* features, const ElemType* posteriors,
+                                             CUDA_LONG numComponents, CUDA_LONG dim, CUDA_LONG numSamples)
+{
+    const CUDA_LONG id = blockIdx.x * blockDim.x + threadIdx.x;
+    if (id >= numRows * numCols)
+        return;
+    const CUDA_LONG row = id % numRows;
+    const CUDA_LONG col = id / numRows;
+
+    CUDA_LONG tBegin = gradientStride == 0 ? 0 : col;
+    CUDA_LONG tEnd = gradientStride == 0 ? numSamples : col + 1;
+    ElemType sum = 0;
+    for (CUDA_LONG t = tBegin; t < tEnd; t++)
+    {
+        const ElemType g = gradient[t];
+        const ElemType* mean = means + t * meansStride;
+        const ElemType* logStddev = logStddevs + t * logStddevsStride;
+        const ElemType* x = features + t * dim;
+        const ElemType* posterior = posteriors + t * numComponents;
+        if (inputIndex == 0) // unnormedPriors
+        {
+            const ElemType* u = unnormedPriors + t * priorsStride;
+            sum += g * (posterior[row] - exp_(u[row] - _gmmLogPriorNormalizer(u, numComponents)));
+        }
+        else if (inputIndex == 1) // means
+        {
+            CUDA_LONG c = row / dim, d = row % dim;
+            sum += g * posterior[c] * exp_(-2 * logStddev[c]) * (x[d] - mean[row]);
+        }
+        else if (inputIndex == 2) // logStddevs
+        {
+            ElemType distance = 0;
+            for (CUDA_LONG d = 0; d < dim; d++)
+            {
+                ElemType diff = x[d] - mean[row * dim + d];
+                distance += diff * diff;
+            }
+            sum += g * posterior[row] * (distance * exp_(-2 * logStddev[row]) - dim);
+        }
+        else // features
+        {
+            for (CUDA_LONG c = 0; c < numComponents; c++)
+                sum -= g * posterior[c] * exp_(-2 * logStddev[c]) * (x[row] - mean[c * dim + row]);
+        }
+    }
+    result[id] += sum;
+}
+
 template <class ElemType>
 __global__ void _maskColumnsValue(ElemType* a, const char* columnsMask, CUDA_LONG numCols, CUDA_LONG numRows, ElemType val)
 {
@@ -4948,6 +6156,103 @@ __global__ void _maskColumnsValue(ElemType* a, const char* columnsMask, CUDA_LON
         a[IDX2C(rowIdx, colIdx, numRows)] = val;
     }
 }
+
+// scales the brightness parameter of each of the 8 bit images in the columns of 'images' by the mean value of the image, see AssignAugmentedImages()
+// each block processes one image. There must be 512 threads in a block
+template <class ElemType>
+__global__ void _scaleBrightnessByImageMeansOf512Threads(const unsigned char* images, CUDA_LONG stride, CUDA_LONG numValues, ElemType* params, CUDA_LONG numParams)
+{
+    __shared__ unsigned long long partials[512];
+    const unsigned char* image = images + (size_t) blockIdx.x * stride;
+
+    unsigned long long sum = 0;
+    for (CUDA_LONG i = threadIdx.x; i < numValues; i += 512)
+        sum += image[i];
+    partials[threadIdx.x] = sum;
+    __syncthreads();
+
+    for (int s = 256; s > 0; s /= 2)
+    {
+        if (threadIdx.x < s)
+            partials[threadIdx.x] += partials[threadIdx.x + s];
+        __syncthreads();
+    }
+
+    if (threadIdx.x == 0)
+        params[blockIdx.x * numParams + 1] *= (ElemType) ((double) partials[0] / numValues);
+}
+
+// color jitter, mean subtraction and layout of AssignAugmentedImages(), a thread per pixel
+template <class ElemType>
+__global__ void _assignAugmentedImages(ElemType* us, const unsigned char* images, CUDA_LONG stride, const ElemType* params, const ElemType* mean, CUDA_LONG numPixels, CUDA_LONG channels, CUDA_LONG numImages, bool toCHW)
+{
+    CALCULATE_ELEMENTWISE_INDEX_OR_EXIT(id, numPixels * numImages);
+    CUDA_LONG pixel = id % numPixels;
+    CUDA_LONG image = id / numPixels;
+
+    const ElemType* p = params + image * (3 + channels);
+    const ElemType contrast = p[0];
+    const ElemType brightness = p[1];
+    const ElemType saturation = p[2];
+
+    ElemType values[4];
+    const unsigned char* src = images + (size_t) image * stride + pixel * channels;
+    for (CUDA_LONG c = 0; c < channels; c++)
+        values[c] = min(max(src[c] * contrast + brightness, (ElemType) 0), (ElemType) 255);
+
+    // Scaling the saturation of HSV keeps hue and value, which moves each channel towards or away from the value (the maximum).
+    if (channels == 3 && saturation != 1)
+    {
+        ElemType v = max(max(values[0], values[1]), values[2]);
+        ElemType s = v > 0 ? (v - min(min(values[0], values[1]), values[2])) / v : 0;
+        if (s > 0)
+        {
+            ElemType ratio = min(s * saturation, (ElemType) 1) / s;
+            for (CUDA_LONG c = 0; c < 3; c++)
+                values[c] = v - ratio * (v - values[c]);
+        }
+    }
+
+    ElemType* dst = us + (size_t) image * numPixels * channels;
+    for (CUDA_LONG c = 0; c < channels; c++)
+    {
+        ElemType value = min(max(values[c] + p[3 + c], (ElemType) 0), (ElemType) 255);
+        if (mean)
+            value -= mean[pixel * channels + c];
+        dst[toCHW ? c * numPixels + pixel : pixel * channels + c] = value;
+    }
+}
+
+// the fp16 operands of a half-precision GEMM, see EnableHalfPrecisionGEMM()
+__global__ void _convertToHalf(const float* a, __half* res, CUDA_LONG N)
+{
+    CALCULATE_ELEMENTWISE_INDEX_OR_EXIT(id, N);
+    res[id] = __float2half(a[id]);
+}
+
+// magnitudes of 'numSamples' entries of 'data' at equal distance, for estimating the threshold of GradientSparsifier
+template <class ElemType>
+__global__ void _sampleMagnitudes(const ElemType* data, CUDA_LONG N, CUDA_LONG numSamples, ElemType* samples)
+{
+    CALCULATE_ELEMENTWISE_INDEX_OR_EXIT(id, numSamples);
+    samples[id] = fabs_(data[(CUDA_LONG) ((long long) id * N / numSamples)]);
+}
+
+// moves the non-zero entries of 'data' of at least 'threshold' magnitude, up to 'capacity' of them, to 'indices' and 'values'
+template <class ElemType>
+__global__ void _selectAboveThreshold(ElemType* data, CUDA_LONG N, ElemType threshold, unsigned int capacity, unsigned int* indices, ElemType* values, unsigned int* numSelected)
+{
+    CALCULATE_ELEMENTWISE_INDEX_OR_EXIT(id, N);
+    ElemType value = data[id];
+    if (value == 0 || fabs_(value) < threshold)
+        return;
+    unsigned int slot = atomicAdd(numSelected, 1u);
+    if (slot >= capacity) // stays in the residual
+        return;
+    indices[slot] = id;
+    values[slot] = value;
+    data[id] = 0;
+}
 }
 }
 }
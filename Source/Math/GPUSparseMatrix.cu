@@ -15,6 +15,7 @@
 #include "cublas_v2.h"
 #include "GPUMatrixCUDAKernels.cuh"
 #include <functional>
+#include <mutex>
 #include "CommonMatrix.h"
 #include <iostream> // for cout/cerr
 #include <assert.h>
@@ -1029,6 +1030,88 @@ void GPUSparseMatrix<ElemType>::GetMatrixFromCSCFormat(GPUSPARSE_INDEX_TYPE*& h_
 
 #pragma region Static BLAS Functions
 
+// Sparse inputs with many non-zero values per column, e.g. bag-of-words features whose counts follow a power law, are
+// multiplied by cuSPARSE (forward) and by a kernel balanced over the non-zero values (gradient) instead of the kernels that
+// give each output element or column its own thread, which are best for few values per column such as one-hot input.
+static const size_t c_minAverageNzPerColumnForBalancedProducts = 4;
+
+// a cuSPARSE handle for the given GPU, bound to the current stream. Like the cuBLAS handles of GPUMatrix, it is never freed.
+// It may be created by InitializeDevice() on another thread.
+static cusparseHandle_t GetCusparseHandle(int deviceId)
+{
+    static cusparseHandle_t s_cusparseHandles[MAX_GPUS] = {};
+    static std::mutex s_cusparseHandlesMutex;
+    if (deviceId < 0 || deviceId >= MAX_GPUS)
+        LogicError("GetCusparseHandle: Maximum GPU exceeded");
+    cusparseHandle_t handle;
+    {
+        std::lock_guard<std::mutex> lock(s_cusparseHandlesMutex);
+        if (!s_cusparseHandles[deviceId])
+            CUSPARSE_CALL(cusparseCreate(&s_cusparseHandles[deviceId]));
+        handle = s_cusparseHandles[deviceId];
+    }
+    CUSPARSE_CALL(cusparseSetStream(handle, t_stream));
+    return handle;
+}
+
+template <class ElemType>
+void GPUSparseMatrix<ElemType>::InitializeDevice(DEVICEID_TYPE deviceId)
+{
+    Microsoft::MSR::CNTK::PrepareDevice(deviceId);
+    GetCusparseHandle(deviceId);
+}
+
+// float/double overloads of cusparseScsrmm2()/cusparseDcsrmm2()
+static cusparseStatus_t cusparse_csrmm2(cusparseHandle_t handle, cusparseOperation_t transA, cusparseOperation_t transB, int m, int n, int k, int nnz, const float* alpha, const cusparseMatDescr_t descrA,
+                                        const float* csrValA, const int* csrRowPtrA, const int* csrColIndA, const float* B, int ldb, const float* beta, float* C, int ldc)
+{
+    return cusparseScsrmm2(handle, transA, transB, m, n, k, nnz, alpha, descrA, csrValA, csrRowPtrA, csrColIndA, B, ldb, beta, C, ldc);
+}
+static cusparseStatus_t cusparse_csrmm2(cusparseHandle_t handle, cusparseOperation_t transA, cusparseOperation_t transB, int m, int n, int k, int nnz, const double* alpha, const cusparseMatDescr_t descrA,
+                                        const double* csrValA, const int* csrRowPtrA, const int* csrColIndA, const double* B, int ldb, const double* beta, double* C, int ldc)
+{
+    return cusparseDcsrmm2(handle, transA, transB, m, n, k, nnz, alpha, descrA, csrValA, csrRowPtrA, csrColIndA, B, ldb, beta, C, ldc);
+}
+static cublasStatus_t cublas_geam(cublasHandle_t handle, cublasOperation_t transA, cublasOperation_t transB, int m, int n, const float* alpha, const float* A, int lda, const float* beta, const float* B, int ldb, float* C, int ldc)
+{
+    return cublasSgeam(handle, transA, transB, m, n, alpha, A, lda, beta, B, ldb, C, ldc);
+}
+static cublasStatus_t cublas_geam(cublasHandle_t handle, cublasOperation_t transA, cublasOperation_t transB, int m, int n, const double* alpha, const double* A, int lda, const double* beta, const double* B, int ldb, double* C, int ldc)
+{
+    return cublasDgeam(handle, transA, transB, m, n, alpha, A, lda, beta, B, ldb, C, ldc);
+}
+
+// c = alpha * lhs * rhs + beta * c for a dense lhs and a CSC rhs, by cuSPARSE
+// The CSC rhs is the CSR form of rhs', so cuSPARSE computes c' = rhs' * lhs', which is then transposed into c.
+template <class ElemType>
+static void DenseTimesSparseCSCByCusparse(ElemType alpha, const GPUMatrix<ElemType>& lhs, const GPUSparseMatrix<ElemType>& rhs, ElemType beta, GPUMatrix<ElemType>& c)
+{
+    int m = (int) lhs.GetNumRows();
+    int k = (int) lhs.GetNumCols();
+    int n = (int) rhs.GetNumCols();
+    GPUMatrix<ElemType> cTransposed(n, m, c.GetComputeDeviceId());
+
+    cusparseHandle_t cusparseHandle = GetCusparseHandle(c.GetComputeDeviceId());
+    cusparseMatDescr_t descr = 0;
+    CUSPARSE_CALL(cusparseCreateMatDescr(&descr));
+    cusparseSetMatType(descr, CUSPARSE_MATRIX_TYPE_GENERAL);
+    cusparseSetMatIndexBase(descr, CUSPARSE_INDEX_BASE_ZERO);
+    ElemType zero = 0;
+    SyncGuard syncGuard;
+    CUSPARSE_CALL(cusparse_csrmm2(cusparseHandle, CUSPARSE_OPERATION_NON_TRANSPOSE, CUSPARSE_OPERATION_TRANSPOSE, n, m, k, (int) rhs.GetNumElemAllocated(), &alpha, descr,
+                                  rhs.Buffer(), rhs.ColLocation(), rhs.RowLocation(), lhs.Data(), m, &zero, cTransposed.Data(), n));
+    CUSPARSE_CALL(cusparseDestroyMatDescr(descr));
+
+    if (beta == 0)
+        c.AssignTransposeOf(cTransposed);
+    else // in place: c = cTransposed' + beta * c
+    {
+        ElemType one = 1;
+        cublasHandle_t cublasHandle = GPUMatrix<ElemType>::GetCublasHandle(c.GetComputeDeviceId());
+        CUBLAS_CALL(cublas_geam(cublasHandle, CUBLAS_OP_T, CUBLAS_OP_N, m, n, &one, cTransposed.Data(), n, &beta, c.Data(), m, c.Data(), m));
+    }
+}
+
 // dense X sparse = dense
 template <class ElemType>
 void GPUSparseMatrix<ElemType>::MultiplyAndWeightedAdd(ElemType alpha, const GPUMatrix<ElemType>& lhs, const bool transposeA,
@@ -1060,7 +1143,11 @@ void GPUSparseMatrix<ElemType>::MultiplyAndWeightedAdd(ElemType alpha, const GPU
         c.VerifySize(m, n); // Can't resize if beta != 0
 
     c.PrepareDevice();
-    if (rhs.GetFormat() == MatrixFormat::matrixFormatSparseCSC)
+    if (rhs.GetFormat() == MatrixFormat::matrixFormatSparseCSC && !transposeA && !transposeB && rhs.NzCount() >= c_minAverageNzPerColumnForBalancedProducts * n)
+    {
+        DenseTimesSparseCSCByCusparse(alpha, lhs, rhs, beta, c);
+    }
+    else if (rhs.GetFormat() == MatrixFormat::matrixFormatSparseCSC)
     {
         ConvolveAndWeightedAdd(alpha, lhs, transposeA, rhs, transposeB, beta, c, 1, 1, false, false);
     }
@@ -1292,18 +1379,38 @@ void GPUSparseMatrix<ElemType>::MultiplyAndAdd(ElemType alpha, const GPUMatrix<E
             CUDA_CALL(cudaMemset(c.Data() + m * blockSizePrev, 0, sizeof(ElemType) * m * (blockSizeCurr - blockSizePrev)));
         }
 
-        LONG64 N = (LONG64) lhs.GetNumElements(); // here we process for each row in lhs and each column in rhs (==columns in lhs)
-        blocksPerGrid = (int) ceil(((double) N) / GridDim::maxThreadsPerBlock);
-        _denseMulSparseCSCTransposeToSparseBlockCol2<ElemType><<<blocksPerGrid, GridDim::maxThreadsPerBlock, 0, t_stream>>>(
-            alpha,
-            lhs.Data(),
-            m,
-            l,
-            rhs.Data(),
-            rhs.RowLocation(),
-            rhs.ColLocation(),
-            c.ColOrRow2BlockId(),
-            c.Data());
+        if (rhs_nz >= c_minAverageNzPerColumnForBalancedProducts * l)
+        {
+            LONG64 N = (LONG64) m * rhs_nz; // here we process for each row in lhs and each non-zero value in rhs
+            blocksPerGrid = (int) ceil(((double) N) / GridDim::maxThreadsPerBlock);
+            _denseMulSparseCSCTransposeToSparseBlockColBalanced<ElemType><<<blocksPerGrid, GridDim::maxThreadsPerBlock, 0, t_stream>>>(
+                alpha,
+                lhs.Data(),
+                m,
+                l,
+                rhs.Buffer(),
+                rhs.RowLocation(),
+                rhs.ColLocation(),
+                rhs.SecondaryIndexValueAt(0),
+                (LONG64) rhs_nz,
+                c.ColOrRow2BlockId(),
+                c.Data());
+        }
+        else
+        {
+            LONG64 N = (LONG64) lhs.GetNumElements(); // here we process for each row in lhs and each column in rhs (==columns in lhs)
+            blocksPerGrid = (int) ceil(((double) N) / GridDim::maxThreadsPerBlock);
+            _denseMulSparseCSCTransposeToSparseBlockCol2<ElemType><<<blocksPerGrid, GridDim::maxThreadsPerBlock, 0, t_stream>>>(
+                alpha,
+                lhs.Data(),
+                m,
+                l,
+                rhs.Data(),
+                rhs.RowLocation(),
+                rhs.ColLocation(),
+                c.ColOrRow2BlockId(),
+                c.Data());
+        }
     }
     else if (transposeA && !transposeB)
     {
@@ -1500,6 +1607,153 @@ ElemType GPUSparseMatrix<ElemType>::Adagrad(GPUMatrix<ElemType>& c, const bool n
     }
 }
 
+// FSAdagrad update (cf. GPUMatrix::FSAdagrad()) of the elements of a SparseBlockCol gradient (this)
+template <class ElemType>
+void GPUSparseMatrix<ElemType>::FSAdagrad(GPUMatrix<ElemType>& c, GPUMatrix<ElemType>& functionValues, ElemType learnRatePerSample, ElemType momentum, ElemType adaWeight, ElemType adaMul) const
+{
+    if (GetFormat() != matrixFormatSparseBlockCol)
+        NOT_IMPLEMENTED;
+
+    size_t numColsNeeded = 2 * GetNumCols();
+    if (c.IsEmpty() || (c.GetNumCols() < numColsNeeded))
+    {
+        c.RequireSize(GetNumRows(), numColsNeeded);
+        c.SetValue(0.0);
+    }
+
+    assert((c.GetNumRows() == GetNumRows()) && (c.GetNumCols() == numColsNeeded));
+
+    let nz = NzCount();
+    if (nz == 0)
+        return;
+
+    int blocksPerGrid = (nz + GridDim::maxThreadsPerBlock - 1) / GridDim::maxThreadsPerBlock;
+    SyncGuard syncGuard;
+    _fsadagradForSparseBlockCol<ElemType><<<blocksPerGrid, GridDim::maxThreadsPerBlock, 0, t_stream>>>(
+        (CUDA_LONG) GetNumRows(), (CUDA_LONG) GetNumElements(), nz, Data(), BlockId2ColOrRow(),
+        c.Data(), functionValues.Data(), learnRatePerSample, momentum, adaWeight, adaMul);
+}
+
+// Adam update (cf. GPUMatrix::Adam()) of the elements of a SparseBlockCol gradient (this); the accumulators of the other columns are left as they are
+template <class ElemType>
+void GPUSparseMatrix<ElemType>::Adam(GPUMatrix<ElemType>& c, GPUMatrix<ElemType>& functionValues, ElemType learnRatePerSample, ElemType meanMomentum, ElemType varMomentum,
+                                     ElemType meanCorrection, ElemType varCorrection, ElemType epsilon, ElemType weightDecay, bool updateFunctionValues)
+{
+    if (GetFormat() != matrixFormatSparseBlockCol)
+        NOT_IMPLEMENTED;
+
+    size_t numColsNeeded = 2 * GetNumCols();
+    if (c.IsEmpty() || (c.GetNumCols() < numColsNeeded))
+    {
+        c.RequireSize(GetNumRows(), numColsNeeded);
+        c.SetValue(0.0);
+    }
+
+    assert((c.GetNumRows() == GetNumRows()) && (c.GetNumCols() == numColsNeeded));
+
+    let nz = NzCount();
+    if (nz == 0)
+        return;
+
+    int blocksPerGrid = (nz + GridDim::maxThreadsPerBlock - 1) / GridDim::maxThreadsPerBlock;
+    SyncGuard syncGuard;
+    _adamForSparseBlockCol<ElemType><<<blocksPerGrid, GridDim::maxThreadsPerBlock, 0, t_stream>>>(
+        (CUDA_LONG) GetNumRows(), (CUDA_LONG) GetNumElements(), nz, Data(), BlockId2ColOrRow(),
+        c.Data(), functionValues.Data(), learnRatePerSample, meanMomentum, varMomentum, meanCorrection, varCorrection,
+        epsilon, weightDecay, updateFunctionValues);
+}
+
+// applies the steps skipped since the columns of a SparseBlockCol gradient (this) were last updated, see Matrix::CatchUpLazyMomentum()
+template <class ElemType>
+void GPUSparseMatrix<ElemType>::CatchUpLazyMomentum(GPUMatrix<ElemType>& c, GPUMatrix<ElemType>& functionValues, GPUMatrix<ElemType>& lastUpdates, ElemType timestamp,
+                                                    ElemType learnRateScale, ElemType momentum, bool hasVarianceAccumulator, ElemType varMomentum) const
+{
+    if (GetFormat() != matrixFormatSparseBlockCol)
+        NOT_IMPLEMENTED;
+
+    const size_t numBlocks = GetBlockSize();
+    if (numBlocks == 0)
+        return;
+
+    ElemType* smoothedVariance = hasVarianceAccumulator ? c.Data() : nullptr;
+    ElemType* smoothedMomentum = c.Data() + (hasVarianceAccumulator ? GetNumElements() : 0);
+
+    SyncGuard syncGuard;
+    CUDA_LONG N = (CUDA_LONG) (GetNumRows() * numBlocks);
+    int blocksPerGrid = (int) ceil(((double) N) / GridDim::maxThreadsPerBlock);
+    _catchUpLazyMomentumForSparseBlockCol<ElemType><<<blocksPerGrid, GridDim::maxThreadsPerBlock, 0, t_stream>>>(
+        (CUDA_LONG) GetNumRows(), (CUDA_LONG) numBlocks, BlockId2ColOrRow(), lastUpdates.Data(), timestamp,
+        learnRateScale, momentum, varMomentum, smoothedMomentum, smoothedVariance, functionValues.Data());
+    blocksPerGrid = (int) ceil(((double) numBlocks) / GridDim::maxThreadsPerBlock);
+    _setLastUpdatesForSparseBlockCol<ElemType><<<blocksPerGrid, GridDim::maxThreadsPerBlock, 0, t_stream>>>(
+        (CUDA_LONG) numBlocks, BlockId2ColOrRow(), timestamp, lastUpdates.Data());
+}
+
+template <class ElemType>
+void GPUSparseMatrix<ElemType>::GetBlockColumnIds(std::vector<size_t>& columnIds) const
+{
+    if (GetFormat() != matrixFormatSparseBlockCol)
+        NOT_IMPLEMENTED;
+
+    std::vector<GPUSPARSE_INDEX_TYPE> blockId2Col(GetBlockSize());
+    if (!blockId2Col.empty())
+    {
+        PrepareDevice();
+        CUDA_CALL(cudaMemcpy(blockId2Col.data(), BlockId2ColOrRow(), sizeof(GPUSPARSE_INDEX_TYPE) * blockId2Col.size(), cudaMemcpyDeviceToHost));
+    }
+    columnIds.assign(blockId2Col.begin(), blockId2Col.end());
+}
+
+template <class ElemType>
+void GPUSparseMatrix<ElemType>::ExpandBlockColumns(const std::vector<size_t>& columnIds)
+{
+    VerifyWritable(__FUNCTION__);
+
+    if (GetFormat() != matrixFormatSparseBlockCol)
+        NOT_IMPLEMENTED;
+    if (columnIds.size() < GetBlockSize())
+        InvalidArgument("GPUSparseMatrix::ExpandBlockColumns: The %d new blocks must include the %d current ones.", (int) columnIds.size(), (int) GetBlockSize());
+
+    const size_t numRows = GetNumRows();
+    const size_t numCols = GetNumCols();
+    const size_t numBlocks = columnIds.size();
+    const size_t nz = numRows * numBlocks;
+    std::vector<GPUSPARSE_INDEX_TYPE> blockId2Col(columnIds.begin(), columnIds.end());
+
+    PrepareDevice();
+    SyncGuard syncGuard;
+    GPUSPARSE_INDEX_TYPE* newBlockId2Col = TracingGPUMemoryAllocator::Allocate<GPUSPARSE_INDEX_TYPE>(GetComputeDeviceId(), max(numBlocks, (size_t) 1));
+    ElemType* newValues = TracingGPUMemoryAllocator::Allocate<ElemType>(GetComputeDeviceId(), max(nz, (size_t) 1));
+    if (numBlocks > 0)
+    {
+        CUDA_CALL(cudaMemcpy(newBlockId2Col, blockId2Col.data(), sizeof(GPUSPARSE_INDEX_TYPE) * numBlocks, cudaMemcpyHostToDevice));
+        if (GetBlockSize() > 0)
+        {
+            int blocksPerGrid = (int) ceil(((double) nz) / GridDim::maxThreadsPerBlock);
+            _relayoutSparseBlockCol<ElemType><<<blocksPerGrid, GridDim::maxThreadsPerBlock, 0, t_stream>>>(
+                (CUDA_LONG) numRows, (CUDA_LONG) numBlocks, newBlockId2Col, ColOrRow2BlockId(), Data(), newValues);
+        }
+        else
+            CUDA_CALL(cudaMemset(newValues, 0, sizeof(ElemType) * nz));
+    }
+
+    RequireSizeAndAllocate(numRows, numCols, nz, true, false);
+    CUDA_CALL(cudaMemset(ColOrRow2BlockId(), Id_NotAssigned, sizeof(GPUSPARSE_INDEX_TYPE) * numCols));
+    CUDA_CALL(cudaMemset(BlockId2ColOrRow(), Id_NotAssigned, sizeof(GPUSPARSE_INDEX_TYPE) * numCols));
+    SetBlockSize(numBlocks);
+    if (numBlocks > 0)
+    {
+        CUDA_CALL(cudaMemcpy(Data(), newValues, sizeof(ElemType) * nz, cudaMemcpyDeviceToDevice));
+        CUDA_CALL(cudaMemcpy(BlockId2ColOrRow(), newBlockId2Col, sizeof(GPUSPARSE_INDEX_TYPE) * numBlocks, cudaMemcpyDeviceToDevice));
+        int blocksPerGrid = (int) ceil(((double) numBlocks) / GridDim::maxThreadsPerBlock);
+        _setCol2BlockIdsForSparseBlockCol<ElemType><<<blocksPerGrid, GridDim::maxThreadsPerBlock, 0, t_stream>>>(
+            (CUDA_LONG) numBlocks, BlockId2ColOrRow(), ColOrRow2BlockId());
+    }
+
+    TracingGPUMemoryAllocator::Free<ElemType>(GetComputeDeviceId(), newValues);
+    TracingGPUMemoryAllocator::Free<GPUSPARSE_INDEX_TYPE>(GetComputeDeviceId(), newBlockId2Col);
+}
+
 // sparse X dense = dense
 template <class ElemType>
 void GPUSparseMatrix<ElemType>::MultiplyAndWeightedAdd(ElemType alpha, const GPUSparseMatrix<ElemType>& a, const bool transposeA,
@@ -1516,9 +1770,9 @@ void GPUSparseMatrix<ElemType>::MultiplyAndWeightedAdd(ElemType alpha, const GPU
     if (a.GetComputeDeviceId() != b.GetComputeDeviceId() || (b.GetComputeDeviceId() != a.GetComputeDeviceId()))
         RuntimeError("MultiplyAndWeightedAdd: All matrices must be on the same GPU");
 
+    // (products by sparse weights run once per layer and minibatch in inference, so the handle is not created each time)
     a.PrepareDevice();
-    cusparseHandle_t cusparseHandle = 0;
-    CUSPARSE_CALL(cusparseCreate(&cusparseHandle));
+    cusparseHandle_t cusparseHandle = GetCusparseHandle(a.GetComputeDeviceId());
     cusparseMatDescr_t descr = 0;
     CUSPARSE_CALL(cusparseCreateMatDescr(&descr));
     cusparseSetMatType(descr, CUSPARSE_MATRIX_TYPE_GENERAL);
@@ -1547,7 +1801,7 @@ void GPUSparseMatrix<ElemType>::MultiplyAndWeightedAdd(ElemType alpha, const GPU
                                      aRowLocation, aColLocation, reinterpret_cast<double*>(b.Data()),
                                      (int) b.GetNumRows(), reinterpret_cast<double*>(&beta), reinterpret_cast<double*>(c.Data()), (int) c.GetNumRows()));
     }
-    CUSPARSE_CALL(cusparseDestroy(cusparseHandle));
+    CUSPARSE_CALL(cusparseDestroyMatDescr(descr));
 }
 
 template <class ElemType>
@@ -2774,10 +3028,8 @@ MATH_API File& operator>>(File& stream, GPUSparseMatrix<ElemType>& us)
     us.VerifyWritable(__FUNCTION__);
 
     stream.GetMarker(fileMarkerBeginSection, std::wstring(L"BMAT"));
-    size_t elsize;
+    size_t elsize; // (a matrix of the other precision is converted, see File::GetFloatingPointArray())
     stream >> elsize;
-    if (sizeof(ElemType) != elsize)
-        RuntimeError("Template argument size doesn't match those in file");
     std::wstring matrixName;
 
     // now prepare this header to receive the data being read
@@ -2801,10 +3053,7 @@ MATH_API File& operator>>(File& stream, GPUSparseMatrix<ElemType>& us)
         CPUSPARSE_INDEX_TYPE* compressedIndex = new CPUSPARSE_INDEX_TYPE[compressedSize];
 
         // read in the sparse matrix info
-        for (size_t i = 0; i < nz; ++i)
-        {
-            stream >> dataBuffer[i];
-        }
+        stream.GetFloatingPointArray(dataBuffer, nz, elsize);
         for (size_t i = 0; i < nz; ++i)
         {
             size_t val;
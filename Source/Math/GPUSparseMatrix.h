@@ -396,6 +396,9 @@ public:
     };
 
 public:
+    // creates the cuSPARSE handle, see Matrix::InitializeDevice()
+    static void InitializeDevice(DEVICEID_TYPE deviceId);
+
     // Performs C = alpha ? op ( S ) ? D + beta ? C; Where S is sparse and D and C are dense
     static void MultiplyAndWeightedAdd(ElemType alpha, const GPUMatrix<ElemType>& a, const bool transposeA, const GPUSparseMatrix<ElemType>& b,
                                        const bool transposeB, ElemType beta, GPUMatrix<ElemType>& c);
@@ -410,6 +413,14 @@ public:
 
     void NormalGrad(GPUMatrix<ElemType>& c, const ElemType momentum);
     ElemType Adagrad(GPUMatrix<ElemType>& c, const bool needAveMultiplier);
+    void FSAdagrad(GPUMatrix<ElemType>& c, GPUMatrix<ElemType>& functionValues, ElemType learnRatePerSample, ElemType momentum, ElemType adaWeight, ElemType adaMul) const;
+    void Adam(GPUMatrix<ElemType>& c, GPUMatrix<ElemType>& functionValues, ElemType learnRatePerSample, ElemType meanMomentum, ElemType varMomentum,
+              ElemType meanCorrection, ElemType varCorrection, ElemType epsilon, ElemType weightDecay, bool updateFunctionValues);
+    void CatchUpLazyMomentum(GPUMatrix<ElemType>& c, GPUMatrix<ElemType>& functionValues, GPUMatrix<ElemType>& lastUpdates, ElemType timestamp,
+                             ElemType learnRateScale, ElemType momentum, bool hasVarianceAccumulator, ElemType varMomentum) const;
+
+    void GetBlockColumnIds(std::vector<size_t>& columnIds) const;
+    void ExpandBlockColumns(const std::vector<size_t>& columnIds);
 
     static void Multiply(const GPUSparseMatrix<ElemType>& S, const GPUMatrix<ElemType>& D, GPUMatrix<ElemType>& C);
     static void Multiply(const GPUMatrix<ElemType>& D, const GPUSparseMatrix<ElemType>& S, GPUMatrix<ElemType>& C);
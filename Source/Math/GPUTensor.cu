@@ -197,6 +197,50 @@ struct FixedMatrix<T, N, 0>
     }
 };
 
+// -----------------------------------------------------------------------
+// division by a divisor that is the same for all threads
+// -----------------------------------------------------------------------
+
+// The kernels map each thread index to a tensor index by dividing it by the op strides, and integer division is a
+// long instruction sequence on the GPU. Since the divisor is known at launch, the division is replaced by a
+// multiplication with a precomputed 'magic' number and a shift, cf. Granlund and Montgomery, "Division by Invariant
+// Integers using Multiplication" (1994). This is exact for dividends below 2^31, which all CUDA_LONG indices are.
+struct FastDivisor
+{
+    C_size_t m_divisor;
+    unsigned int m_multiplier;
+    unsigned int m_shift;
+
+    __device__ __host__ FastDivisor()
+    {
+    }
+    explicit FastDivisor(C_size_t divisor) // (host only)
+        : m_divisor(divisor), m_multiplier(0), m_shift(0)
+    {
+        if (divisor <= 0) // (a stride of an empty tensor, nothing is launched)
+            return;
+        // shift = ceil(log2(divisor)), multiplier = floor(2^32 * (2^shift - divisor) / divisor) + 1 < 2^32
+        while (((uint64_t) 1 << m_shift) < (uint64_t) divisor)
+            m_shift++;
+        m_multiplier = (unsigned int) ((((uint64_t) 1 << 32) * (((uint64_t) 1 << m_shift) - divisor)) / divisor + 1);
+    }
+
+    // for FixedArray's overflow check
+    __device__ __host__ operator C_size_t() const
+    {
+        return m_divisor;
+    }
+
+    // quotient = n / divisor, remainder = n % divisor, for 0 <= n < 2^31
+    __device__ void DivMod(CUDA_LONG n, C_size_t& quotient, CUDA_LONG& remainder) const
+    {
+        // (mulhi(n, multiplier) <= n, so the sum does not overflow)
+        unsigned int q = (__umulhi((unsigned int) n, m_multiplier) + (unsigned int) n) >> m_shift;
+        quotient = (C_size_t) q;
+        remainder = n - (CUDA_LONG) q * m_divisor;
+    }
+};
+
 // -----------------------------------------------------------------------
 // function to actually compute a function of (N-1) inputs based on the opcode
 // -----------------------------------------------------------------------
@@ -273,7 +317,7 @@ template<> __device__ float NeutralValue<float>(ElementWiseOperator op)
     case ElementWiseOperator::opSum:    return 0;
     case ElementWiseOperator::opLogSum: return -INFINITY;
     case ElementWiseOperator::opMin:    return FLT_MAX;
-    case ElementWiseOperator::opMax:    return FLT_MIN;
+    case ElementWiseOperator::opMax:    return -FLT_MAX;
     default:                            return 0; // error
     }
 };
@@ -285,7 +329,7 @@ template<> __device__ double NeutralValue<double>(ElementWiseOperator op)
     case ElementWiseOperator::opSum:    return 0;
     case ElementWiseOperator::opLogSum: return -INFINITY;
     case ElementWiseOperator::opMin:    return DBL_MAX;
-    case ElementWiseOperator::opMax:    return DBL_MIN;
+    case ElementWiseOperator::opMax:    return -DBL_MAX;
     default:                            return 0; // error
     }
 };
@@ -411,14 +455,13 @@ struct TensorOpElement
 {
     // template-recursive version loops over indices
     static __device__ void Compute(CUDA_LONG id, ElemType beta, FixedArray<ElemType*, N>& pointers, ElemType alpha, ElementWiseOperator op, ElementWiseOperator reductionOp,
-                                   const FixedArray<C_unsigned_int, K>& regularOpStrides, const FixedMatrix<C_int, N, K>& regularStrides,
+                                   const FixedArray<FastDivisor, K>& regularOpStrides, const FixedMatrix<C_int, N, K>& regularStrides,
                                    const FixedArray<C_unsigned_int, M>& reducingOpDims, const FixedMatrix<C_int, N, M>& reducingStrides,
                                    CUDA_LONG reductionBegin, CUDA_LONG reductionChunkSize)
     {
         // map id (location on grid) to index[k]
-        C_size_t stride = regularOpStrides[(C_size_t) k];
-        C_size_t index = id / stride; // this dimension
-        id = id % stride;             // remaining dimensions inside this
+        C_size_t index;
+        regularOpStrides[(C_size_t) k].DivMod(id, index, id); // index in this dimension, and id in the remaining dimensions inside this
         // apply this index to the pointers
         for (C_size_t i = 0; i < N; i++)
             pointers[i] += index * regularStrides(i, (C_size_t) k); // now this dimension is taken care of
@@ -433,7 +476,7 @@ struct TensorOpElement<ElemType, N, M, K, parallelReduce, /*k=*/0>
 {
     // template-recursive version loops over indices
     static __device__ void Compute(CUDA_LONG id, ElemType beta, FixedArray<ElemType*, N>& pointers, ElemType alpha, ElementWiseOperator op, ElementWiseOperator reductionOp,
-                                   const FixedArray<C_unsigned_int, K>& regularOpStrides, const FixedMatrix<C_int, N, K>& regularStrides,
+                                   const FixedArray<FastDivisor, K>& regularOpStrides, const FixedMatrix<C_int, N, K>& regularStrides,
                                    const FixedArray<C_unsigned_int, M>& reducingOpDims, const FixedMatrix<C_int, N, M>& reducingStrides,
                                    CUDA_LONG reductionBegin, CUDA_LONG reductionChunkSize)
     {
@@ -454,7 +497,7 @@ struct TensorOpElement<ElemType, N, M, K, /*parallelReduce=*/false, /*k=*/-1>
     // template-recursion-teminating version computes the actual value for this output location
     // now the output pointers point to the right element (input pointers may still iterate for reduction)
     static __device__ void Compute(CUDA_LONG /*id*/, ElemType beta, FixedArray<ElemType*, N>& pointers, ElemType alpha, ElementWiseOperator op, ElementWiseOperator reductionOp,
-                                   const FixedArray<C_unsigned_int, K>& /*regularOpStrides*/, const FixedMatrix<C_int, N, K>& /*regularStrides*/,
+                                   const FixedArray<FastDivisor, K>& /*regularOpStrides*/, const FixedMatrix<C_int, N, K>& /*regularStrides*/,
                                    const FixedArray<C_unsigned_int, M>& reducingOpDims, const FixedMatrix<C_int, N, M>& reducingStrides, CUDA_LONG /*reductionBegin*/, CUDA_LONG /*reductionChunkSize*/)
     {
         // compute the operation for this output coordinate
@@ -483,7 +526,7 @@ struct TensorOpElement<ElemType, N, M, K, /*parallelReduce=*/true, /*k=*/-1>
     // template-recursion-teminating version computes the actual value for this output location
     // now the output pointers point to the right element (input pointers may still iterate for reduction)
     static __device__ void Compute(CUDA_LONG /*id*/, ElemType beta, FixedArray<ElemType*, N>& pointers, ElemType alpha, ElementWiseOperator op, ElementWiseOperator reductionOp,
-                                   const FixedArray<C_unsigned_int, K>& /*regularOpStrides*/, const FixedMatrix<C_int, N, K>& /*regularStrides*/,
+                                   const FixedArray<FastDivisor, K>& /*regularOpStrides*/, const FixedMatrix<C_int, N, K>& /*regularStrides*/,
                                    const FixedArray<C_unsigned_int, M>& reducingOpDims, const FixedMatrix<C_int, N, M>& reducingStrides, CUDA_LONG reductionBegin, CUDA_LONG reductionChunkSize)
     {
         CUDA_LONG reductionBlock = blockIdx.z; // reduction-block index  --larger reductions are split into blocks
@@ -561,7 +604,7 @@ struct TensorOpElement<ElemType, N, M, K, /*parallelReduce=*/true, /*k=*/-1>
 // launch tensor op with CUDA
 template <class ElemType, C_size_t N, C_int M, C_int K>
 __global__ void _launchTensorOp(ElemType beta, FixedArray<ElemType*, N> pointers, ElemType alpha, ElementWiseOperator op, ElementWiseOperator reductionOp,
-                                FixedArray<C_unsigned_int, K> regularOpStrides, FixedMatrix<C_int, N, K> regularStrides, CUDA_LONG numElements,
+                                FixedArray<FastDivisor, K> regularOpStrides, FixedMatrix<C_int, N, K> regularStrides, CUDA_LONG numElements,
                                 FixedArray<C_unsigned_int, M> reducingOpDims, FixedMatrix<C_int, N, M> reducingStrides)
 {
     CUDA_LONG id = GridDim::GetLinearThreadId();
@@ -582,7 +625,7 @@ static void LaunchTensorOp(ElemType beta, array<ElemType*, N> pointerVector, Ele
         regularOpStrideVector.push_back(numElements);
         numElements *= (C_size_t) regularOpDims[k];
     }
-    FixedArray<C_unsigned_int, K> regularOpStrides(regularOpStrideVector);
+    FixedArray<FastDivisor, K> regularOpStrides(regularOpStrideVector);
     FixedMatrix<C_int, N, K> regularStrides(regularStrideVectors);
     FixedArray<C_unsigned_int, /*M=*/0> reducingOpDims; // empty reduction dimensions
     FixedMatrix<C_int, N, /*M=*/0> reducingStrides;
@@ -600,7 +643,7 @@ static void LaunchTensorOp(ElemType beta, array<ElemType*, N> pointerVector, Ele
 
 template <class ElemType, C_size_t N, C_int M, C_int K>
 __global__ void _launchTensorOpWithReduction(ElemType beta, FixedArray<ElemType*, N> pointers, ElemType alpha, ElementWiseOperator op, ElementWiseOperator reductionOp,
-                                             FixedArray<C_unsigned_int, K> regularOpStrides, FixedMatrix<C_int, N, K> regularStrides, CUDA_LONG numElements,
+                                             FixedArray<FastDivisor, K> regularOpStrides, FixedMatrix<C_int, N, K> regularStrides, CUDA_LONG numElements,
                                              FixedArray<C_unsigned_int, M> reducingOpDims, FixedMatrix<C_int, N, M> reducingStrides,
                                              CUDA_LONG reductionBegin, CUDA_LONG reductionChunkSize)
 {
@@ -634,13 +677,11 @@ static shared_ptr<ElemType> GetReductionBuffer(size_t N)
     let deviceId = GridDim::GetCurrentDeviceId();
     if (deviceId >= _countof(reductionBuffersCache)) // index check w.r.t. our hard-coded dimensions
         return AllocateReductionBuffer<ElemType>(N); // out of bounds: don't cache
-    if (!reductionBuffersCache[deviceId])
+    if (!reductionBuffersCache[deviceId] || N > reductionBuffersCacheSize[deviceId]) // grow as needed (segmented reductions ask for more than the number of multiprocs)
     {
-        reductionBuffersCache[deviceId] = AllocateReductionBuffer<ElemType>(N);
+        reductionBuffersCache[deviceId] = AllocateReductionBuffer<ElemType>(N); // (cudaFree() of a replaced buffer waits for kernels still using it)
         reductionBuffersCacheSize[deviceId] = N;
     }
-    if (N > reductionBuffersCacheSize[deviceId]) // buffer size check
-        LogicError("GetReductionBuffer: Must be called with the number of multiprocs, which may not change.");
     return reductionBuffersCache[deviceId];
 }
 
@@ -659,7 +700,7 @@ static void LaunchTensorOpWithReduction(ElemType beta, array<ElemType*, N> point
         regularOpStrideVector.push_back(numElements); // stride for dense representation of our output elements (if they were flattened)
         numElements *= (C_size_t) regularOpDims[k];
     }
-    FixedArray<C_unsigned_int,    K> regularOpStrides(regularOpStrideVector);
+    FixedArray<FastDivisor,       K> regularOpStrides(regularOpStrideVector);
     FixedMatrix<C_int,         N, K> regularStrides(regularStrideVectors);
     FixedArray<C_unsigned_int,    M> reducingOpDims(reducingOpDimVector);
     FixedMatrix<C_int,         N, M> reducingStrides(reducingStrideVectors);
@@ -847,6 +888,269 @@ static void LaunchTensorOpWithReduction(ElemType beta, array<ElemType*, N> point
     }
 }
 
+// -----------------------------------------------------------------------
+// kernels and launch  --segmented unary reductions
+// -----------------------------------------------------------------------
+
+// The generic kernels above convert every thread index back into a multi-dimensional tensor index,
+// which dominates the cost of reductions over inner or middle axes of large tensors (ReduceElementsNode,
+// aggregation of criterion values). Once flattened, a unary reduction with a single reduction axis is just
+// a set of equal-length segments, one per output element, which is handled by one of these kernels:
+//  - contiguous segments: one warp per output element, combined with warp shuffles
+//  - strided segments whose output elements are adjacent in the input (inner axis kept, e.g. a middle axis
+//    reduced): 32-column tiles that read rows coalesced and reduce down the columns in shared memory
+//  - few output elements over huge segments: each block reduces one chunk of a segment into a buffer of
+//    partial results, which a second pass then combines
+
+static const CUDA_LONG segmentedReductionWarpSize = 32;      // threads combined by WarpReduce()
+static const CUDA_LONG segmentedReductionWarpsPerBlock = 8;  // for the warp-per-output kernel
+static const CUDA_LONG segmentedReductionTileColumns = 32;   // output elements per tile of the strided kernel
+static const CUDA_LONG segmentedReductionTileRows = 16;      // segment elements read concurrently per tile column
+static const CUDA_LONG segmentedReductionChunkThreads = 512; // threads per block of the chunked kernel
+
+// same as UpdateAggregate() but guards against LogAdd(-inf, -inf) = NaN when a thread has not seen any element
+template <class ElemType>
+static __device__ void UpdateSegmentAggregate(ElemType& aggregate, ElemType val, ElementWiseOperator reductionOp)
+{
+    if (reductionOp == ElementWiseOperator::opLogSum && val == -INFINITY)
+        return;
+    UpdateAggregate<ElemType, ElemType>(aggregate, val, reductionOp);
+}
+
+template <class ElemType>
+static __device__ ElemType ComputeSegmentElement(ElemType a, ElementWiseOperator op)
+{
+    if (op == ElementWiseOperator::opCopy) // (the common case, e.g. ReduceElementsNode)
+        return a;
+    switch (op)
+    {
+        ForAllUnaryOps(CaseUnaryTensorOp);
+    default:
+        return 0; // (failure)
+    }
+}
+
+template <class ElemType>
+static __device__ void StoreSegmentResult(ElemType beta, ElemType* pout, ElemType alpha, ElemType val)
+{
+    val *= alpha;
+    if (beta != 0) // (skip memory access if not needed, and allow for ignoring NaNs)
+        val += beta * *pout;
+    *pout = val;
+}
+
+template <class ElemType>
+static __device__ ElemType WarpShuffleDown(ElemType val, int offset)
+{
+#if CUDA_VERSION >= 9000
+    return __shfl_down_sync(0xffffffff, val, offset);
+#else
+    return __shfl_down(val, offset);
+#endif
+}
+
+// combine the aggregates of all lanes of a warp; the result is valid in lane 0
+// All 32 lanes must be active.
+template <class ElemType>
+static __device__ ElemType WarpReduce(ElemType aggregate, ElementWiseOperator reductionOp)
+{
+    for (int offset = segmentedReductionWarpSize / 2; offset > 0; offset /= 2)
+        UpdateSegmentAggregate(aggregate, WarpShuffleDown(aggregate, offset), reductionOp);
+    return aggregate;
+}
+
+// combine the aggregates of all threads of a block; the result is valid in thread 0
+template <class ElemType>
+static __device__ ElemType BlockReduce(ElemType aggregate, ElementWiseOperator reductionOp)
+{
+    __shared__ ElemType warpAggregates[GridDim::maxThreadsPerBlock / segmentedReductionWarpSize];
+    CUDA_LONG lane = threadIdx.x % segmentedReductionWarpSize;
+    CUDA_LONG warp = threadIdx.x / segmentedReductionWarpSize;
+    aggregate = WarpReduce(aggregate, reductionOp);
+    if (lane == 0)
+        warpAggregates[warp] = aggregate;
+    __syncthreads();
+    if (warp == 0)
+    {
+        CUDA_LONG numWarps = (blockDim.x + segmentedReductionWarpSize - 1) / segmentedReductionWarpSize;
+        aggregate = lane < numWarps ? warpAggregates[lane] : NeutralValue<ElemType>(reductionOp);
+        aggregate = WarpReduce(aggregate, reductionOp);
+    }
+    return aggregate;
+}
+
+// one warp per output element; segment elements are read with stride segmentStride (1 for coalesced reads)
+template <class ElemType>
+__global__ void _launchWarpSegmentReduction(ElemType beta, const ElemType* pin, ElemType* pout, ElemType alpha, ElementWiseOperator op, ElementWiseOperator reductionOp,
+                                            CUDA_LONG numOutputs, CUDA_LONG inStride, CUDA_LONG outStride, CUDA_LONG segmentDim, CUDA_LONG segmentStride)
+{
+    CUDA_LONG outId = (blockIdx.x * blockDim.x + threadIdx.x) / segmentedReductionWarpSize;
+    CUDA_LONG lane = threadIdx.x % segmentedReductionWarpSize;
+    if (outId >= numOutputs) // (uniform across the warp, so WarpReduce() below sees all lanes)
+        return;
+    const ElemType* segment = pin + outId * inStride;
+    ElemType aggregate = NeutralValue<ElemType>(reductionOp);
+    for (CUDA_LONG i = lane; i < segmentDim; i += segmentedReductionWarpSize)
+        UpdateSegmentAggregate(aggregate, ComputeSegmentElement(segment[i * segmentStride], op), reductionOp);
+    aggregate = WarpReduce(aggregate, reductionOp);
+    if (lane == 0)
+        StoreSegmentResult(beta, pout + outId * outStride, alpha, aggregate);
+}
+
+// tiles of [segmentedReductionTileColumns x segmentedReductionTileRows] threads; grid is [column tiles x chunks x outer index]
+// Each warp reads consecutive output columns of one segment row. The outer index is for reductions over a middle axis.
+// With more than one chunk, results go to 'partials' (dense [numChunks x numOuter x numOutputs]) instead.
+template <class ElemType>
+__global__ void _launchStridedSegmentReduction(ElemType beta, const ElemType* pin, ElemType* pout, ElemType* partials, ElemType alpha, ElementWiseOperator op, ElementWiseOperator reductionOp,
+                                               CUDA_LONG numOutputs, CUDA_LONG inStride, CUDA_LONG outStride, CUDA_LONG outerInStride, CUDA_LONG outerOutStride,
+                                               CUDA_LONG segmentDim, CUDA_LONG segmentStride, CUDA_LONG chunkSize)
+{
+    __shared__ ElemType tile[segmentedReductionTileRows][segmentedReductionTileColumns];
+    CUDA_LONG col = blockIdx.x * segmentedReductionTileColumns + threadIdx.x;
+    CUDA_LONG begin = blockIdx.y * chunkSize;
+    CUDA_LONG end = min(begin + chunkSize, segmentDim);
+    pin += blockIdx.z * outerInStride;
+    ElemType aggregate = NeutralValue<ElemType>(reductionOp);
+    if (col < numOutputs)
+    {
+        for (CUDA_LONG i = begin + threadIdx.y; i < end; i += segmentedReductionTileRows)
+            UpdateSegmentAggregate(aggregate, ComputeSegmentElement(pin[col * inStride + i * segmentStride], op), reductionOp);
+    }
+    tile[threadIdx.y][threadIdx.x] = aggregate;
+    __syncthreads();
+    if (threadIdx.y != 0 || col >= numOutputs)
+        return;
+    for (CUDA_LONG y = 1; y < segmentedReductionTileRows; y++)
+        UpdateSegmentAggregate(aggregate, tile[y][threadIdx.x], reductionOp);
+    if (gridDim.y > 1)
+        partials[(blockIdx.y * gridDim.z + blockIdx.z) * numOutputs + col] = aggregate;
+    else
+        StoreSegmentResult(beta, pout + blockIdx.z * outerOutStride + col * outStride, alpha, aggregate);
+}
+
+// first pass for huge segments: grid is [chunks x output elements]; writes one partial result per block
+template <class ElemType>
+__global__ void _launchChunkedSegmentReduction(const ElemType* pin, ElemType* partials, ElementWiseOperator op, ElementWiseOperator reductionOp,
+                                               CUDA_LONG numOutputs, CUDA_LONG inStride, CUDA_LONG segmentDim, CUDA_LONG segmentStride, CUDA_LONG chunkSize)
+{
+    CUDA_LONG outId = blockIdx.y;
+    const ElemType* segment = pin + outId * inStride;
+    CUDA_LONG begin = blockIdx.x * chunkSize;
+    CUDA_LONG end = min(begin + chunkSize, segmentDim);
+    ElemType aggregate = NeutralValue<ElemType>(reductionOp);
+    for (CUDA_LONG i = begin + threadIdx.x; i < end; i += blockDim.x)
+        UpdateSegmentAggregate(aggregate, ComputeSegmentElement(segment[i * segmentStride], op), reductionOp);
+    aggregate = BlockReduce(aggregate, reductionOp);
+    if (threadIdx.x == 0)
+        partials[blockIdx.x * numOutputs + outId] = aggregate;
+}
+
+// second pass: combine the [numChunks x numOuter x numOutputs] partial results and write the output
+template <class ElemType>
+__global__ void _launchSegmentPartialsReduction(ElemType beta, const ElemType* partials, ElemType* pout, ElemType alpha, ElementWiseOperator reductionOp,
+                                                CUDA_LONG numOutputs, CUDA_LONG outStride, CUDA_LONG numOuter, CUDA_LONG outerOutStride, CUDA_LONG numChunks)
+{
+    CUDA_LONG id = GridDim::GetLinearThreadId();
+    if (id >= numOutputs * numOuter)
+        return;
+    ElemType aggregate = partials[id];
+    for (CUDA_LONG chunk = 1; chunk < numChunks; chunk++)
+        UpdateSegmentAggregate(aggregate, partials[chunk * numOutputs * numOuter + id], reductionOp);
+    StoreSegmentResult(beta, pout + (id / numOutputs) * outerOutStride + (id % numOutputs) * outStride, alpha, aggregate);
+}
+
+// only unary reductions are specialized
+template <class ElemType, C_size_t N>
+static bool TryLaunchSegmentedReduction(ElemType /*beta*/, const array<ElemType*, N>& /*pointers*/, ElemType /*alpha*/, ElementWiseOperator /*op*/, ElementWiseOperator /*reductionOp*/,
+                                        const SmallVector<size_t>& /*regularOpDims*/, const array<SmallVector<ptrdiff_t>, N>& /*regularStrides*/,
+                                        const SmallVector<size_t>& /*reducingOpDims*/, const array<SmallVector<ptrdiff_t>, N>& /*reducingStrides*/)
+{
+    return false;
+}
+
+// launch one of the segmented reduction kernels if the (flattened) shape is a set of equal-length segments
+// Returns false if the shape is not handled, in which case the caller falls back to the generic kernels.
+template <class ElemType>
+static bool TryLaunchSegmentedReduction(ElemType beta, const array<ElemType*, 2>& pointers, ElemType alpha, ElementWiseOperator op, ElementWiseOperator reductionOp,
+                                        const SmallVector<size_t>& regularOpDims, const array<SmallVector<ptrdiff_t>, 2>& regularStrides,
+                                        const SmallVector<size_t>& reducingOpDims, const array<SmallVector<ptrdiff_t>, 2>& reducingStrides)
+{
+    if (reducingOpDims.size() != 1 || regularOpDims.size() > 2)
+        return false;
+    if (reductionOp != ElementWiseOperator::opSum && reductionOp != ElementWiseOperator::opLogSum &&
+        reductionOp != ElementWiseOperator::opMin && reductionOp != ElementWiseOperator::opMax)
+        return false;
+
+    let segmentDim     = (CUDA_LONG) reducingOpDims[0];
+    let segmentStride  = (CUDA_LONG) reducingStrides[0][0];
+    let numOutputs     = regularOpDims.size() > 0 ? (CUDA_LONG) regularOpDims[0]     : 1;
+    let inStride       = regularOpDims.size() > 0 ? (CUDA_LONG) regularStrides[0][0] : 0;
+    let outStride      = regularOpDims.size() > 0 ? (CUDA_LONG) regularStrides[1][0] : 0;
+    let numOuter       = regularOpDims.size() > 1 ? (CUDA_LONG) regularOpDims[1]     : 1; // only for a middle axis
+    let outerInStride  = regularOpDims.size() > 1 ? (CUDA_LONG) regularStrides[0][1] : 0;
+    let outerOutStride = regularOpDims.size() > 1 ? (CUDA_LONG) regularStrides[1][1] : 0;
+    let& props = GridDim::GetDeviceProps();
+    if (segmentDim < 2 || (size_t) segmentDim * numOutputs * numOuter <= 2 * props.warpSize) // trivial operation, the generic kernel does fine
+        return false;
+
+    const ElemType* pin = pointers[0];
+    ElemType* pout = pointers[1];
+
+    // --- strided segments, output elements adjacent in the input: tiles of columns
+    if (segmentStride != 1 && inStride == 1 && numOutputs > 1 && numOuter <= props.maxGridSize[2])
+    {
+        SyncGuard syncGuard;
+        let numColumnTiles = CeilDiv(numOutputs, segmentedReductionTileColumns);
+        let maxChunks = CeilDiv(segmentDim, 8 * segmentedReductionTileRows); // keep at least 8 rows per thread
+        let numChunksWanted = max(min(CeilDiv(2 * props.multiProcessorCount, numColumnTiles * numOuter), maxChunks), 1);
+        let chunkSize = CeilDiv(segmentDim, numChunksWanted);
+        let numChunks = CeilDiv(segmentDim, chunkSize);
+        let block = dim3(segmentedReductionTileColumns, segmentedReductionTileRows);
+        if (numChunks == 1)
+        {
+            _launchStridedSegmentReduction<ElemType><<<dim3(numColumnTiles, 1, numOuter), block, 0, t_stream>>>(
+                beta, pin, pout, nullptr, alpha, op, reductionOp, numOutputs, inStride, outStride, outerInStride, outerOutStride, segmentDim, segmentStride, chunkSize);
+            return true;
+        }
+        shared_ptr<ElemType> partials = GetReductionBuffer<ElemType>((size_t) numChunks * numOuter * numOutputs);
+        _launchStridedSegmentReduction<ElemType><<<dim3(numColumnTiles, numChunks, numOuter), block, 0, t_stream>>>(
+            beta, pin, pout, partials.get(), alpha, op, reductionOp, numOutputs, inStride, outStride, outerInStride, outerOutStride, segmentDim, segmentStride, chunkSize);
+        GridDim grid(numOutputs * numOuter);
+        _launchSegmentPartialsReduction<ElemType><<<grid.m_blocksPerGrid, grid.m_threadsPerBlock, 0, t_stream>>>(
+            beta, partials.get(), pout, alpha, reductionOp, numOutputs, outStride, numOuter, outerOutStride, numChunks);
+        return true;
+    }
+
+    // the remaining kernels take a single set of segments; a strided segment per scattered output gains nothing over the generic kernel
+    if (numOuter > 1 || (segmentStride != 1 && numOutputs > 1))
+        return false;
+
+    SyncGuard syncGuard;
+
+    // --- huge segments that would not fill the GPU with one warp each: two-pass block reduction
+    let numWarpBlocks = CeilDiv(numOutputs, segmentedReductionWarpsPerBlock);
+    if (numWarpBlocks < props.multiProcessorCount && segmentDim >= 4 * segmentedReductionChunkThreads && numOutputs <= props.maxGridSize[1])
+    {
+        let maxChunks = CeilDiv(segmentDim, 4 * segmentedReductionChunkThreads); // keep at least 4 elements per thread
+        let numChunksWanted = max(min(CeilDiv(2 * props.multiProcessorCount, numOutputs), maxChunks), 1);
+        let chunkSize = CeilDiv(segmentDim, numChunksWanted);
+        let numChunks = CeilDiv(segmentDim, chunkSize);
+        shared_ptr<ElemType> partials = GetReductionBuffer<ElemType>((size_t) numChunks * numOutputs);
+        _launchChunkedSegmentReduction<ElemType><<<dim3(numChunks, numOutputs), segmentedReductionChunkThreads, 0, t_stream>>>(
+            pin, partials.get(), op, reductionOp, numOutputs, inStride, segmentDim, segmentStride, chunkSize);
+        GridDim grid(numOutputs);
+        _launchSegmentPartialsReduction<ElemType><<<grid.m_blocksPerGrid, grid.m_threadsPerBlock, 0, t_stream>>>(
+            beta, partials.get(), pout, alpha, reductionOp, numOutputs, outStride, /*numOuter=*/1, /*outerOutStride=*/0, numChunks);
+        return true;
+    }
+
+    // --- contiguous segments: one warp each
+    let threadsPerBlock = segmentedReductionWarpsPerBlock * segmentedReductionWarpSize;
+    _launchWarpSegmentReduction<ElemType><<<numWarpBlocks, threadsPerBlock, 0, t_stream>>>(
+        beta, pin, pout, alpha, op, reductionOp, numOutputs, inStride, outStride, segmentDim, segmentStride);
+    return true;
+}
+
 // -----------------------------------------------------------------------
 // kernel and launch  --linear unary
 // -----------------------------------------------------------------------
@@ -914,6 +1218,86 @@ void LaunchUnaryTensorOp(ElemType beta, const ElemType* pa, ElemType* pb, ElemTy
     }
 }
 
+// -----------------------------------------------------------------------
+// kernel and launch  --fused chain of elementwise ops
+// -----------------------------------------------------------------------
+
+// the input pointers of a FusedElementwiseProgram, by value
+template <class ElemType>
+struct FusedElementwiseInputs
+{
+    const ElemType* pointers[FusedElementwiseProgram::MaxInputs];
+    bool isColumn[FusedElementwiseProgram::MaxInputs]; // single column, used for all columns
+};
+
+template <class ElemType>
+static __device__ ElemType ComputeFusedElementwiseStep(const FusedElementwiseStep& step, const ElemType* values)
+{
+    ElemType a = values[step.args[0]];
+    if (step.arity == 1)
+    {
+        switch (step.op)
+        {
+            ForAllUnaryOps(CaseUnaryTensorOp);
+        default:
+            return 0; // (failure)
+        }
+    }
+    ElemType b = values[step.args[1]];
+    if (step.arity == 2)
+    {
+        switch (step.op)
+        {
+            ForAllBinaryOps(CaseBinaryTensorOp);
+        default:
+            return 0; // (failure)
+        }
+    }
+    ElemType c = values[step.args[2]];
+#define CaseFusedTernaryTensorOp(oper)  \
+    case ElementWiseOperator::op##oper: \
+        return Op##oper(a, b, c)
+    switch (step.op)
+    {
+        ForAllTernaryOps(CaseFusedTernaryTensorOp);
+    default:
+        return 0; // (failure)
+    }
+}
+
+// Each thread reads its element of every input once, computes all steps in registers, and writes the output once.
+template <class ElemType>
+__global__ void _launchFusedElementwiseOp(FusedElementwiseProgram program, FusedElementwiseInputs<ElemType> inputs, ElemType* output, CUDA_LONG numRows, CUDA_LONG numElements)
+{
+    CUDA_LONG id = GridDim::GetLinearThreadId();
+    if (id >= numElements)
+        return;
+    ElemType values[FusedElementwiseProgram::MaxInputs + FusedElementwiseProgram::MaxSteps];
+    for (int i = 0; i < program.numInputs; i++)
+        values[i] = inputs.pointers[i][inputs.isColumn[i] ? id % numRows : id];
+    for (int k = 0; k < program.numSteps; k++)
+        values[program.numInputs + k] = ComputeFusedElementwiseStep(program.steps[k], values);
+    output[id] = values[program.numInputs + program.numSteps - 1];
+}
+
+template <class ElemType>
+void LaunchFusedElementwiseOp(const FusedElementwiseProgram& program, const std::vector<const ElemType*>& inputs, const std::vector<bool>& inputIsColumn,
+                              ElemType* output, size_t numRows, size_t numElements)
+{
+    if (numElements == 0)
+        return;
+    FusedElementwiseInputs<ElemType> kernelInputs;
+    for (size_t i = 0; i < inputs.size(); i++)
+    {
+        kernelInputs.pointers[i] = inputs[i];
+        kernelInputs.isColumn[i] = inputIsColumn[i];
+    }
+    CUDA_LONG NN = (CUDA_LONG) numElements;
+    SyncGuard syncGuard;
+    GridDim grid(NN);
+    _launchFusedElementwiseOp<ElemType><<<grid.m_blocksPerGrid, grid.m_threadsPerBlock, 0, t_stream>>>(program, kernelInputs, output, (CUDA_LONG) numRows, NN);
+}
+
 // -----------------------------------------------------------------------
 // map runtime parameters N to template parameters
 // -----------------------------------------------------------------------
@@ -948,6 +1332,9 @@ void TensorOpN(ElemType beta, array<ElemType*, N> pointers, ElemType alpha, Elem
 {
     for (C_size_t i = 0; i < N; i++) // N = a small constant, this will be unrolled
         pointers[i] += offsets[i];
+    // unary reductions over a single flattened axis have specialized kernels
+    if (TryLaunchSegmentedReduction(beta, pointers, alpha, op, reductionOp, regularOpDims, regularStrides, reducingOpDims, reducingStrides))
+        return;
     size_t dims = regularOpDims.size();
     switch (dims)
     {
@@ -998,6 +1385,11 @@ template void TensorOpN<double, 4>(double beta, array<double*, 4> pointers, doub
 template void LaunchUnaryTensorOp(float beta, const float* pa, float* pb, float alpha, ElementWiseOperator op, size_t regularOpDim);
 template void LaunchUnaryTensorOp(double beta, const double* pa, double* pb, double alpha, ElementWiseOperator op, size_t regularOpDim);
 
+template void LaunchFusedElementwiseOp(const FusedElementwiseProgram& program, const std::vector<const float*>& inputs, const std::vector<bool>& inputIsColumn,
+                                       float* output, size_t numRows, size_t numElements);
+template void LaunchFusedElementwiseOp(const FusedElementwiseProgram& program, const std::vector<const double*>& inputs, const std::vector<bool>& inputIsColumn,
+                                       double* output, size_t numRows, size_t numElements);
+
 }}}
 
 #endif // CPUONLY
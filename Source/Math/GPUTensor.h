@@ -26,4 +26,9 @@ void TensorOpN(ElemType beta, array<ElemType*, N> pointers, ElemType alpha, Elem
 template <class ElemType>
 void LaunchUnaryTensorOp(ElemType beta, const ElemType* pa, ElemType* pb, ElemType alpha, ElementWiseOperator op, size_t regularOpDim);
 
+// output = program(inputs) elementwise; inputs flagged in 'inputIsColumn' hold a single column of 'numRows' for all columns
+template <class ElemType>
+void LaunchFusedElementwiseOp(const FusedElementwiseProgram& program, const std::vector<const ElemType*>& inputs, const std::vector<bool>& inputIsColumn,
+                              ElemType* output, size_t numRows, size_t numElements);
+
 }}}
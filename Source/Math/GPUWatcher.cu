@@ -9,8 +9,17 @@
 #ifndef CPUONLY
 
 #include "GPUWatcher.h"
+#include "Telemetry.h"
 #include <cuda.h>
 #include <cuda_runtime.h>
+#include <atomic>
+#include <limits>
+#include <string>
+
+using namespace Microsoft::MSR::CNTK;
+
+static const int s_maxNumDevices = 64;
+static std::atomic<size_t> s_peakWorkspaceBytes[s_maxNumDevices];
 
 int GPUWatcher::GetGPUIdWithTheMostFreeMemory()
 {
@@ -53,6 +62,49 @@ size_t GPUWatcher::GetFreeMemoryOnCUDADevice(int devId)
         return free;
 }
 
+/*static*/ void GPUWatcher::AddTelemetryGauges(int devId)
+{
+    std::string labels = "device=\"" + std::to_string(devId) + "\"";
+    // the samplers run on the telemetry thread, which needs the device to be current
+    auto memoryInfo = [devId](bool total) -> double
+    {
+        size_t free = 0, totalBytes = 0;
+        if (cudaSetDevice(devId) != cudaSuccess || cudaMemGetInfo(&free, &totalBytes) != cudaSuccess)
+        {
+            cudaGetLastError();
+            return std::numeric_limits<double>::quiet_NaN();
+        }
+        return (double) (total ? totalBytes : totalBytes - free);
+    };
+    Telemetry::AddGauge("cntk_gpu_memory_used_bytes", labels, "GPU memory used on the device, by all processes.",
+                        [memoryInfo]() { return memoryInfo(false); });
+    Telemetry::AddGauge("cntk_gpu_memory_total_bytes", labels, "GPU memory of the device.",
+                        [memoryInfo]() { return memoryInfo(true); });
+    Telemetry::AddGauge("cntk_gpu_allocator_in_use_bytes", labels, "GPU memory handed out by the caching allocator.",
+                        [devId]() { return (double) TracingGPUMemoryAllocator::GetCachingStatistics(devId).m_inUseBytes; });
+    Telemetry::AddGauge("cntk_gpu_allocator_cached_bytes", labels, "Free GPU memory held in the cache of the caching allocator.",
+                        [devId]() { return (double) TracingGPUMemoryAllocator::GetCachingStatistics(devId).m_cachedBytes; });
+    Telemetry::AddGauge("cntk_gpu_cudnn_workspace_peak_bytes", labels, "Largest cuDNN workspace since the previous sample.",
+                        [devId]() { return (double) TakePeakWorkspaceBytes(devId); });
+}
+
+/*static*/ void GPUWatcher::RecordWorkspaceBytes(int devId, size_t bytes)
+{
+    if (devId < 0 || devId >= s_maxNumDevices)
+        return;
+    auto& peak = s_peakWorkspaceBytes[devId];
+    size_t previous = peak.load(std::memory_order_relaxed);
+    while (bytes > previous && !peak.compare_exchange_weak(previous, bytes, std::memory_order_relaxed))
+        ;
+}
+
+/*static*/ size_t GPUWatcher::TakePeakWorkspaceBytes(int devId)
+{
+    if (devId < 0 || devId >= s_maxNumDevices)
+        return 0;
+    return s_peakWorkspaceBytes[devId].exchange(0, std::memory_order_relaxed);
+}
+
 GPUWatcher::GPUWatcher(void)
 {
 }
@@ -12,6 +12,14 @@ class MATH_API GPUWatcher
 public:
     static size_t GetFreeMemoryOnCUDADevice(int devId);
     static int GetGPUIdWithTheMostFreeMemory();
+
+    // Registers Telemetry gauges for the memory of the device: used and total as the driver sees it,
+    // and what the caching allocator holds in use and cached.
+    static void AddTelemetryGauges(int devId);
+    // cuDNN workspaces; the gauge shows the peak since the previous sample
+    static void RecordWorkspaceBytes(int devId, size_t bytes);
+    static size_t TakePeakWorkspaceBytes(int devId);
+
     GPUWatcher(void);
     ~GPUWatcher(void);
 };
@@ -0,0 +1,95 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE.md file in the project root for full license information.
+//
+// GradientSparsifier.cpp -- top-k sparsification of gradients with error feedback
+//
+
+#include "stdafx.h"
+#include "GradientSparsifier.h"
+#include "Matrix.h"
+#include <algorithm>
+#include <functional>
+#include <climits>
+#include <cmath>
+
+namespace Microsoft { namespace MSR { namespace CNTK {
+
+template <class ElemType>
+GradientSparsifier<ElemType>::GradientSparsifier(double fraction)
+    : m_fraction(fraction)
+{
+    if (fraction <= 0 || fraction > 1)
+        InvalidArgument("GradientSparsifier: The fraction of entries to select must be in (0, 1], but is %g.", fraction);
+}
+
+template <class ElemType>
+size_t GradientSparsifier<ElemType>::NumToSelect(size_t numElements) const
+{
+    size_t k = (size_t) ceil(m_fraction * numElements);
+    return std::min(std::max(k, (size_t) 1), numElements);
+}
+
+template <class ElemType>
+size_t GradientSparsifier<ElemType>::MaxNumSelected(size_t numElements) const
+{
+    // room for the estimate of the GPU threshold to be off
+    return std::min(2 * NumToSelect(numElements) + 1024, numElements);
+}
+
+template <class ElemType>
+size_t GradientSparsifier<ElemType>::Sparsify(const Matrix<ElemType>& gradient, Matrix<ElemType>& residual, std::vector<unsigned int>& indices, std::vector<ElemType>& values)
+{
+    if (gradient.GetNumRows() != residual.GetNumRows() || gradient.GetNumCols() != residual.GetNumCols() || gradient.GetDeviceId() != residual.GetDeviceId())
+        LogicError("GradientSparsifier: The residual must have the dimensions and the device of the gradient.");
+    size_t numElements = gradient.GetNumElements();
+    if (numElements > UINT_MAX)
+        InvalidArgument("GradientSparsifier: Gradients of more than %u elements are not supported.", UINT_MAX);
+
+    indices.resize(MaxNumSelected(numElements));
+    values.resize(indices.size());
+    if (numElements == 0)
+        return 0;
+
+    Matrix<ElemType>::ScaleAndAdd(1, gradient, residual);
+
+    size_t k = NumToSelect(numElements);
+    size_t numSelected;
+    if (residual.GetDeviceId() == CPUDEVICE)
+        numSelected = SparsifyCPU(residual.Data(), numElements, k, indices.data(), values.data());
+    else
+        numSelected = SparsifyGPU(residual.GetDeviceId(), residual.Data(), numElements, k, indices.size(), indices.data(), values.data());
+
+    indices.resize(numSelected);
+    values.resize(numSelected);
+    return numSelected;
+}
+
+template <class ElemType>
+size_t GradientSparsifier<ElemType>::SparsifyCPU(ElemType* data, size_t numElements, size_t k, unsigned int* indices, ElemType* values)
+{
+    // the magnitude of the k-th largest entry
+    m_magnitudes.resize(numElements);
+    for (size_t i = 0; i < numElements; i++)
+        m_magnitudes[i] = fabs(data[i]);
+    std::nth_element(m_magnitudes.begin(), m_magnitudes.begin() + (k - 1), m_magnitudes.end(), std::greater<ElemType>());
+    ElemType threshold = m_magnitudes[k - 1];
+
+    // zeros are not worth sending; with ties at the threshold the first ones are taken
+    size_t numSelected = 0;
+    for (size_t i = 0; i < numElements && numSelected < k; i++)
+    {
+        if (data[i] == 0 || fabs(data[i]) < threshold)
+            continue;
+        indices[numSelected] = (unsigned int) i;
+        values[numSelected] = data[i];
+        data[i] = 0;
+        numSelected++;
+    }
+    return numSelected;
+}
+
+template class GradientSparsifier<float>;
+template class GradientSparsifier<double>;
+
+}}}
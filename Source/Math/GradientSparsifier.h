@@ -0,0 +1,51 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE.md file in the project root for full license information.
+//
+// GradientSparsifier.h -- top-k sparsification of gradients with error feedback
+//
+
+#pragma once
+
+#include "CommonMatrix.h" // for MATH_API, DEVICEID_TYPE
+#include <vector>
+
+namespace Microsoft { namespace MSR { namespace CNTK {
+
+template <class ElemType>
+class Matrix;
+
+// Selects the entries of largest magnitude of a gradient for communication, as an alternative to the
+// quantization of MatrixQuantizer. As with the 1-bit residual, what is not sent is kept in a residual
+// matrix and added to the gradient of the next minibatch, so no update is lost, only delayed.
+// On the CPU exactly the k largest entries are selected. On the GPU the threshold is estimated from a
+// sample of the entries, so the number selected varies around k, up to MaxNumSelected().
+template <class ElemType>
+class MATH_API GradientSparsifier
+{
+public:
+    // 'fraction' of the entries of each gradient (at least one) are selected
+    GradientSparsifier(double fraction);
+
+    // Adds 'gradient' to 'residual' and moves the selected entries of the sum out of it, to 'indices'
+    // (element positions in column-major order) and 'values' on the CPU. Returns the number selected.
+    size_t Sparsify(const Matrix<ElemType>& gradient, Matrix<ElemType>& residual, std::vector<unsigned int>& indices, std::vector<ElemType>& values);
+
+    // k for a gradient of 'numElements'
+    size_t NumToSelect(size_t numElements) const;
+    // bound of the number of entries Sparsify() returns for a gradient of 'numElements'
+    size_t MaxNumSelected(size_t numElements) const;
+
+    double Fraction() const { return m_fraction; }
+
+private:
+    size_t SparsifyCPU(ElemType* data, size_t numElements, size_t k, unsigned int* indices, ElemType* values);
+
+    // implemented in GPUMatrix.cu, and as a stub in NoGPU.cpp
+    static size_t SparsifyGPU(DEVICEID_TYPE deviceId, ElemType* data, size_t numElements, size_t k, size_t capacity, unsigned int* indices, ElemType* values);
+
+    double m_fraction;
+    std::vector<ElemType> m_magnitudes; // scratch for the CPU selection
+};
+
+}}}
@@ -18,6 +18,7 @@
 #include <memory>
 #include <atomic>
 #include "Quantizers.h"
+#include "MatrixTransitionTracker.h"
 #ifndef CPUONLY
 #pragma comment(lib, "MathCUDA.lib") // built by CNTKMathCUDA project
 #endif
@@ -156,6 +157,18 @@ int GetMathLibTraceLevel()
     return m_mathLibTraceLevel.load();
 }
 
+static std::atomic<bool> s_halfPrecisionGEMMEnabled(false);
+
+void EnableHalfPrecisionGEMM(bool enable)
+{
+    s_halfPrecisionGEMMEnabled.store(enable);
+}
+
+bool IsHalfPrecisionGEMMEnabled()
+{
+    return s_halfPrecisionGEMMEnabled.load();
+}
+
 MatrixBase::~MatrixBase() { }
 
 #pragma region BufferManagement
@@ -473,6 +486,22 @@ Matrix<ElemType> Matrix<ElemType>::DeepClone() const
     return Matrix<ElemType>(*this, GetDeviceId());
 }
 
+template <class ElemType>
+Matrix<ElemType> Matrix<ElemType>::DeepCloneToCPU() const
+{
+    if (GetDeviceId() == CPUDEVICE || GetMatrixType() != MatrixType::DENSE)
+        return Matrix<ElemType>(*this, CPUDEVICE);
+
+    Matrix<ElemType> copy(GetNumRows(), GetNumCols(), CPUDEVICE);
+    size_t numElements = copy.GetNumElements();
+    if (numElements > 0)
+    {
+        ElemType* data = copy.Data();
+        CopyToArray(data, numElements); // fills the buffer in place since it is large enough
+    }
+    return copy;
+}
+
 template <class ElemType>
 Matrix<ElemType>::Matrix(const Matrix<ElemType>& deepCopyFrom, DEVICEID_TYPE deviceId)
 {
@@ -619,6 +648,16 @@ void Matrix<ElemType>::SetDevice(DEVICEID_TYPE deviceId)
         GPUMatrix<ElemType>::SetDevice(deviceId);
 }
 
+template <class ElemType>
+void Matrix<ElemType>::InitializeDevice(DEVICEID_TYPE deviceId)
+{
+    if (deviceId >= 0)
+    {
+        GPUMatrix<ElemType>::InitializeDevice(deviceId);
+        GPUSparseMatrix<ElemType>::InitializeDevice(deviceId);
+    }
+}
+
 template <class ElemType>
 void Matrix<ElemType>::Read(File& stream)
 {
@@ -646,7 +685,10 @@ void Matrix<ElemType>::Read(File& stream)
     {
         if (M.GetDeviceId() < 0)
         {
-            NOT_IMPLEMENTED; // You might want to tranfer your matrix to GPU
+            if (!M.m_CPUSparseMatrix)
+                M.m_CPUSparseMatrix = make_shared<CPUSparseMatrix<ElemType>>(matrixFormatSparseCSC);
+            stream >> (*M.m_CPUSparseMatrix);
+            M.SetDataLocation(CPU, SPARSE);
         }
         else
         {
@@ -676,9 +718,9 @@ void Matrix<ElemType>::Write(File& stream) const
     {
         stream << 's';
         if (M.GetDeviceId() < 0)
-            NOT_IMPLEMENTED // stream<<(*M.m_CPUMatrix);
-                else stream
-                << (*M.m_GPUSparseMatrix);
+            stream << (*M.m_CPUSparseMatrix);
+        else
+            stream << (*M.m_GPUSparseMatrix);
     }
 }
 
@@ -936,6 +978,8 @@ void Matrix<ElemType>::SwitchToMatrixType(MatrixType newMatrixType, MatrixFormat
 
 #define NUM_MATRIXTYPE_CHANGED_WARN 20
     m_numTimesMatrixTypeChanged++;
+    if (m_baseMatrix && m_matrixType != MatrixType::UNDETERMINED) // (else there is nothing to switch yet)
+        MatrixTransitionTracker::RecordMatrixTypeSwitch(newMatrixType == MatrixType::SPARSE, GetNumRows(), GetNumCols());
 
     if ((GetMathLibTraceLevel() > 0) && (m_numTimesMatrixTypeChanged == NUM_MATRIXTYPE_CHANGED_WARN))
         fprintf(stderr, "WARNING: The same matrix with dim [%lu, %lu] has been transferred between different devices for %d times.\n", (unsigned long) GetNumRows(), (unsigned long) GetNumCols(), NUM_MATRIXTYPE_CHANGED_WARN);
@@ -1130,6 +1174,42 @@ Matrix<ElemType>& Matrix<ElemType>::DoScatterColumnsOf(ElemType beta, const Matr
     return *this;
 }
 
+// Stream compaction of the sequences of the row vector 'condition', as needed by WhereNode, so that only the
+// per-sequence counts have to be brought to the CPU to create the MBLayout of the result.
+// 'sequences' has one column per sequence: its first column in 'condition' (row 0) and its number of time steps (row 1),
+// which are 'conditionStride' columns apart (the number of parallel sequences of the MBLayout).
+// *this[0,i] = number of non-zero values of sequence i
+template <class ElemType>
+Matrix<ElemType>& Matrix<ElemType>::AssignNonZeroCountsOfSequences(const Matrix<ElemType>& condition, size_t conditionStride, const Matrix<ElemType>& sequences)
+{
+    DecideAndMoveToRightDevice(condition, sequences, *this);
+    SwitchToMatrixType(MatrixType::DENSE, matrixFormatDense, false);
+
+    DISPATCH_MATRIX_ON_FLAG(&condition, this,
+        { m_CPUMatrix->AssignNonZeroCountsOfSequences(*condition.m_CPUMatrix, conditionStride, *sequences.m_CPUMatrix); },
+        { m_GPUMatrix->AssignNonZeroCountsOfSequences(*condition.m_GPUMatrix, conditionStride, *sequences.m_GPUMatrix); },
+        { NOT_IMPLEMENTED; },
+        { NOT_IMPLEMENTED; });
+
+    return *this;
+}
+
+// *this[0, outputFirstColumns[0,i] + k * outputStride] = time step of the k-th non-zero value of sequence i of 'condition'
+// 'this' must have been sized already; columns that do not receive a time step are left unchanged.
+template <class ElemType>
+Matrix<ElemType>& Matrix<ElemType>::DoScatterNonZeroStepsOfSequences(const Matrix<ElemType>& condition, size_t conditionStride, const Matrix<ElemType>& sequences, const Matrix<ElemType>& outputFirstColumns, size_t outputStride)
+{
+    DecideAndMoveToRightDevice(condition, sequences, outputFirstColumns, *this);
+
+    DISPATCH_MATRIX_ON_FLAG(&condition, this,
+        { m_CPUMatrix->DoScatterNonZeroStepsOfSequences(*condition.m_CPUMatrix, conditionStride, *sequences.m_CPUMatrix, *outputFirstColumns.m_CPUMatrix, outputStride); },
+        { m_GPUMatrix->DoScatterNonZeroStepsOfSequences(*condition.m_GPUMatrix, conditionStride, *sequences.m_GPUMatrix, *outputFirstColumns.m_GPUMatrix, outputStride); },
+        { NOT_IMPLEMENTED; },
+        { NOT_IMPLEMENTED; });
+
+    return *this;
+}
+
 // set all elements of a matrix to a scalar value
 // For sparse matrices, the only allowed value is 0.
 template <class ElemType>
@@ -1207,6 +1287,22 @@ void Matrix<ElemType>::MaskColumnsValue(const Matrix<char>& columnsMask, ElemTyp
         { m_GPUSparseMatrix->MaskColumnsValue(*columnsMask.m_GPUMatrix, val); });
 }
 
+template <class ElemType>
+void Matrix<ElemType>::AssignAugmentedImages(const Matrix<char>& images, Matrix<ElemType>& params, const Matrix<ElemType>& mean,
+                                             size_t width, size_t height, size_t channels, bool toCHW)
+{
+    DecideAndMoveToRightDevice(*this, params, mean);
+    if (images.GetDeviceId() != GetDeviceId())
+        RuntimeError("AssignAugmentedImages: The images must be on the device of the matrix.");
+
+    SwitchToMatrixType(MatrixType::DENSE, MatrixFormat::matrixFormatDense, false);
+    DISPATCH_MATRIX_ON_FLAG(this, this,
+        { m_CPUMatrix->AssignAugmentedImages(*images.m_CPUMatrix, *params.m_CPUMatrix, *mean.m_CPUMatrix, width, height, channels, toCHW); },
+        { m_GPUMatrix->AssignAugmentedImages(*images.m_GPUMatrix, *params.m_GPUMatrix, *mean.m_GPUMatrix, width, height, channels, toCHW); },
+        NOT_IMPLEMENTED,
+        NOT_IMPLEMENTED);
+}
+
 template <class ElemType>
 void Matrix<ElemType>::SetColumn(const ElemType* colPointer, size_t colInd)
 {
@@ -1484,6 +1580,30 @@ void Matrix<ElemType>::SetUniformRandomMask(const ElemType maskRate, const ElemT
                             NOT_IMPLEMENTED);
 }
 
+template <class ElemType>
+Matrix<ElemType>& Matrix<ElemType>::DoElementProductOfCounterBasedMask(ElemType beta, const Matrix<ElemType>& a, const ElemType maskRate, const ElemType scaleValue, uint64_t seed, uint64_t offset)
+{
+    if (a.IsEmpty())
+        LogicError("DoElementProductOfCounterBasedMask: Matrix is empty.");
+
+    if (!(a.GetNumRows() == GetNumRows() && a.GetNumCols() == GetNumCols()))
+        InvalidArgument("DoElementProductOfCounterBasedMask: The input matrix dimensions do not match [this].");
+
+    DecideAndMoveToRightDevice(*this, a);
+
+    if (GetMatrixType() != a.GetMatrixType())
+        NOT_IMPLEMENTED;
+
+    DISPATCH_MATRIX_ON_FLAG(this,
+                            nullptr,
+                            m_CPUMatrix->DoElementProductOfCounterBasedMask(beta, *a.m_CPUMatrix, maskRate, scaleValue, seed, offset),
+                            m_GPUMatrix->DoElementProductOfCounterBasedMask(beta, *a.m_GPUMatrix, maskRate, scaleValue, seed, offset),
+                            NOT_IMPLEMENTED,
+                            NOT_IMPLEMENTED);
+
+    return *this;
+}
+
 template <class ElemType>
 void Matrix<ElemType>::NormalGrad(Matrix<ElemType>& gradients,
                                   Matrix<ElemType>& functionValues,
@@ -1533,7 +1653,8 @@ void Matrix<ElemType>::NormalGrad(Matrix<ElemType>& gradients,
                     Matrix<ElemType> gradientCache(gradients.GetDeviceId());
                     gradientCache.AssignValuesOf(gradients);
                     gradients.m_CPUSparseMatrix->NormalGrad(*m_CPUMatrix, momentum);
-                    ScaleAndAdd(-momentum, *this, functionValues);
+                    // as without Nesterov momentum, only the columns of the gradients, which now hold their smoothed gradients (for the others, see CatchUpLazyMomentum())
+                    ScaleAndAdd(-momentum * learnRatePerSample, gradients, functionValues);
                     ScaleAndAdd(-(1 - momentum) * learnRatePerSample, gradientCache, functionValues);
                 }
             },
@@ -1543,7 +1664,8 @@ void Matrix<ElemType>::NormalGrad(Matrix<ElemType>& gradients,
                     Matrix<ElemType> gradientCache(gradients.GetDeviceId());
                     gradientCache.AssignValuesOf(gradients);
                     gradients.m_GPUSparseMatrix->NormalGrad(*m_GPUMatrix, momentum);
-                    ScaleAndAdd(-momentum, *this, functionValues);
+                    // as without Nesterov momentum, only the columns of the gradients, which now hold their smoothed gradients (for the others, see CatchUpLazyMomentum())
+                    ScaleAndAdd(-momentum * learnRatePerSample, gradients, functionValues);
                     ScaleAndAdd(-(1 - momentum) * learnRatePerSample, gradientCache, functionValues);
                 }
             });
@@ -1588,8 +1710,29 @@ void Matrix<ElemType>::FSAdagradUpdate(size_t mbSize,
     DISPATCH_MATRIX_ON_FLAG(&gradients, &gradients,
         { m_CPUMatrix->FSAdagrad(*gradients.m_CPUMatrix, *functionValues.m_CPUMatrix, (ElemType)learnRatePerSample, (ElemType)meanMomentum, (ElemType)varMomentum, targetAdagradAvDenom_x_sqrtAdagradSqrFrames); SetDataLocation(CPU); },
         { m_GPUMatrix->FSAdagrad(*gradients.m_GPUMatrix, *functionValues.m_GPUMatrix, (ElemType)learnRatePerSample, (ElemType)meanMomentum, (ElemType)varMomentum, targetAdagradAvDenom_x_sqrtAdagradSqrFrames); SetDataLocation(GPU); },
-        { NOT_IMPLEMENTED; },
-        { NOT_IMPLEMENTED; });
+        { gradients.m_CPUSparseMatrix->FSAdagrad(*m_CPUMatrix, *functionValues.m_CPUMatrix, (ElemType)learnRatePerSample, (ElemType)meanMomentum, (ElemType)varMomentum, targetAdagradAvDenom_x_sqrtAdagradSqrFrames); SetDataLocation(CPU); },
+        { gradients.m_GPUSparseMatrix->FSAdagrad(*m_GPUMatrix, *functionValues.m_GPUMatrix, (ElemType)learnRatePerSample, (ElemType)meanMomentum, (ElemType)varMomentum, targetAdagradAvDenom_x_sqrtAdagradSqrFrames); SetDataLocation(GPU); });
+    // Note: Since both 'this' and gradients are changed, we must call SetDataLocation() on 'this' as well.
+}
+
+template <class ElemType>
+void Matrix<ElemType>::AdamUpdate(Matrix<ElemType>& gradients, Matrix<ElemType>& functionValues, size_t timestep,
+                                  const double learnRatePerSample, const double meanMomentum, const double varMomentum,
+                                  const double epsilon, const double weightDecay, const bool updateFunctionValues)
+{
+    DecideAndMoveToRightDevice(*this, gradients, functionValues);
+
+    // the accumulators start at zero, which biases them towards it by meanMomentum^timestep resp. varMomentum^timestep
+    const double meanBias = 1.0 - pow(meanMomentum, (double) timestep);
+    const double varBias = 1.0 - pow(varMomentum, (double) timestep);
+    let meanCorrection = (ElemType)(meanBias > 0 ? 1.0 / meanBias : 1.0);
+    let varCorrection = (ElemType)(varBias > 0 ? 1.0 / varBias : 1.0);
+
+    DISPATCH_MATRIX_ON_FLAG(&gradients, &gradients,
+        { m_CPUMatrix->Adam(*gradients.m_CPUMatrix, *functionValues.m_CPUMatrix, (ElemType)learnRatePerSample, (ElemType)meanMomentum, (ElemType)varMomentum, meanCorrection, varCorrection, (ElemType)epsilon, (ElemType)weightDecay, updateFunctionValues); SetDataLocation(CPU); },
+        { m_GPUMatrix->Adam(*gradients.m_GPUMatrix, *functionValues.m_GPUMatrix, (ElemType)learnRatePerSample, (ElemType)meanMomentum, (ElemType)varMomentum, meanCorrection, varCorrection, (ElemType)epsilon, (ElemType)weightDecay, updateFunctionValues); SetDataLocation(GPU); },
+        { gradients.m_CPUSparseMatrix->Adam(*m_CPUMatrix, *functionValues.m_CPUMatrix, (ElemType)learnRatePerSample, (ElemType)meanMomentum, (ElemType)varMomentum, meanCorrection, varCorrection, (ElemType)epsilon, (ElemType)weightDecay, updateFunctionValues); SetDataLocation(CPU); },
+        { gradients.m_GPUSparseMatrix->Adam(*m_GPUMatrix, *functionValues.m_GPUMatrix, (ElemType)learnRatePerSample, (ElemType)meanMomentum, (ElemType)varMomentum, meanCorrection, varCorrection, (ElemType)epsilon, (ElemType)weightDecay, updateFunctionValues); SetDataLocation(GPU); });
     // Note: Since both 'this' and gradients are changed, we must call SetDataLocation() on 'this' as well.
 }
 
@@ -1612,6 +1755,349 @@ ElemType Matrix<ElemType>::RmsProp(Matrix<ElemType>& gradients,
     // Note: Since both 'this' and gradients are changed, we must call SetDataLocation() on 'this' as well.
 }
 
+template <class ElemType>
+/*static*/ bool Matrix<ElemType>::GetDenseGPUMatrices(const std::vector<Matrix<ElemType>*>& smoothedGradients, const std::vector<Matrix<ElemType>*>& gradients, const std::vector<Matrix<ElemType>*>& functionValues,
+                                                     std::vector<GPUMatrix<ElemType>*>& gpuSmoothedGradients, std::vector<GPUMatrix<ElemType>*>& gpuGradients, std::vector<GPUMatrix<ElemType>*>& gpuFunctionValues)
+{
+    if (smoothedGradients.size() != gradients.size() || functionValues.size() != gradients.size())
+        LogicError("MultiTensorUpdate: The numbers of smoothed gradients, gradients and parameters differ.");
+
+    if (gradients.empty() || gradients[0]->GetDeviceId() == CPUDEVICE)
+        return false;
+
+    const auto deviceId = gradients[0]->GetDeviceId();
+    auto isDenseOnDevice = [deviceId](const Matrix<ElemType>* matrix)
+    {
+        return matrix->GetDeviceId() == deviceId && matrix->GetMatrixType() == DENSE && matrix->GetCurrentMatrixLocation() == GPU;
+    };
+
+    for (size_t i = 0; i < gradients.size(); i++)
+    {
+        if (!isDenseOnDevice(smoothedGradients[i]) || !isDenseOnDevice(gradients[i]) || !isDenseOnDevice(functionValues[i]))
+            return false;
+    }
+
+    gpuSmoothedGradients.clear();
+    gpuGradients.clear();
+    gpuFunctionValues.clear();
+    for (size_t i = 0; i < gradients.size(); i++)
+    {
+        gpuSmoothedGradients.push_back(smoothedGradients[i]->m_GPUMatrix.get());
+        gpuGradients.push_back(gradients[i]->m_GPUMatrix.get());
+        gpuFunctionValues.push_back(functionValues[i]->m_GPUMatrix.get());
+    }
+    return true;
+}
+
+// the regularization of one parameter that precedes its update if it is not updated by a multi-tensor kernel
+template <class ElemType>
+static void RegularizeBeforeUpdate(const UpdateRegularization<ElemType>& regularization, Matrix<ElemType>& gradient, Matrix<ElemType>& functionValues)
+{
+    if (regularization.l2Weight != 0)
+        Matrix<ElemType>::ScaleAndAdd(regularization.l2Weight, functionValues, gradient);
+    // the updates do not depend on the parameter, so it may decay before them
+    if (regularization.weightDecay != 0)
+        functionValues *= 1 - regularization.weightDecay;
+}
+
+// ... and the one that follows it
+template <class ElemType>
+static void RegularizeAfterUpdate(const UpdateRegularization<ElemType>& regularization, Matrix<ElemType>& functionValues)
+{
+    if (regularization.l1Threshold > 0)
+        functionValues.InplaceSoftThreshold(regularization.l1Threshold);
+}
+
+template <class ElemType>
+/*static*/ void Matrix<ElemType>::MultiNormalGrad(const std::vector<Matrix<ElemType>*>& smoothedGradients, const std::vector<Matrix<ElemType>*>& gradients, const std::vector<Matrix<ElemType>*>& functionValues,
+                                                 const ElemType learnRatePerSample, const ElemType momentum, const bool useNAG,
+                                                 const UpdateRegularization<ElemType>& regularization)
+{
+    std::vector<GPUMatrix<ElemType>*> gpuSmoothedGradients, gpuGradients, gpuFunctionValues;
+    if (GetDenseGPUMatrices(smoothedGradients, gradients, functionValues, gpuSmoothedGradients, gpuGradients, gpuFunctionValues))
+    {
+        GPUMatrix<ElemType>::MultiNormalGrad(gpuSmoothedGradients, gpuGradients, gpuFunctionValues, learnRatePerSample, momentum, useNAG, regularization);
+        return;
+    }
+
+    for (size_t i = 0; i < gradients.size(); i++)
+    {
+        RegularizeBeforeUpdate(regularization, *gradients[i], *functionValues[i]);
+        smoothedGradients[i]->NormalGrad(*gradients[i], *functionValues[i], learnRatePerSample, momentum, useNAG);
+        RegularizeAfterUpdate(regularization, *functionValues[i]);
+    }
+}
+
+template <class ElemType>
+/*static*/ void Matrix<ElemType>::MultiAdagrad(const std::vector<Matrix<ElemType>*>& smoothedGradients, const std::vector<Matrix<ElemType>*>& gradients, const std::vector<Matrix<ElemType>*>& functionValues,
+                                              const ElemType learnRatePerSample,
+                                              const UpdateRegularization<ElemType>& regularization)
+{
+    std::vector<GPUMatrix<ElemType>*> gpuSmoothedGradients, gpuGradients, gpuFunctionValues;
+    if (GetDenseGPUMatrices(smoothedGradients, gradients, functionValues, gpuSmoothedGradients, gpuGradients, gpuFunctionValues))
+    {
+        GPUMatrix<ElemType>::MultiAdagrad(gpuSmoothedGradients, gpuGradients, gpuFunctionValues, learnRatePerSample, regularization);
+        return;
+    }
+
+    for (size_t i = 0; i < gradients.size(); i++)
+    {
+        RegularizeBeforeUpdate(regularization, *gradients[i], *functionValues[i]);
+        smoothedGradients[i]->Adagrad(*gradients[i], /*needAveMultiplier*/ false);
+        ScaleAndAdd(-learnRatePerSample, *gradients[i], *functionValues[i]);
+        RegularizeAfterUpdate(regularization, *functionValues[i]);
+    }
+}
+
+// The smoothed count of each parameter is updated as by FSAdagradUpdate(), which also determines its multiplier.
+template <class ElemType>
+/*static*/ void Matrix<ElemType>::MultiFSAdagradUpdate(size_t mbSize,
+                                                      const std::vector<Matrix<ElemType>*>& smoothedGradients, const std::vector<Matrix<ElemType>*>& gradients, const std::vector<Matrix<ElemType>*>& functionValues,
+                                                      const std::vector<double*>& smoothedCounts,
+                                                      const double learnRatePerSample, const double targetAdagradAvDenom,
+                                                      const double meanMomentum, const double varMomentum,
+                                                      const UpdateRegularization<ElemType>& regularization)
+{
+    if (smoothedCounts.size() != gradients.size())
+        LogicError("MultiFSAdagradUpdate: The numbers of smoothed counts and gradients differ.");
+
+    std::vector<GPUMatrix<ElemType>*> gpuSmoothedGradients, gpuGradients, gpuFunctionValues;
+    if (GetDenseGPUMatrices(smoothedGradients, gradients, functionValues, gpuSmoothedGradients, gpuGradients, gpuFunctionValues))
+    {
+        std::vector<ElemType> adaMuls;
+        adaMuls.reserve(smoothedCounts.size());
+        for (auto smoothedCount : smoothedCounts)
+        {
+            *smoothedCount = varMomentum * *smoothedCount + (1.0 - varMomentum) * mbSize;
+            adaMuls.push_back((ElemType)(targetAdagradAvDenom * sqrt(*smoothedCount)));
+        }
+
+        GPUMatrix<ElemType>::MultiFSAdagrad(gpuSmoothedGradients, gpuGradients, gpuFunctionValues, adaMuls, (ElemType) learnRatePerSample, (ElemType) meanMomentum, (ElemType) varMomentum,
+                                            regularization);
+        return;
+    }
+
+    for (size_t i = 0; i < gradients.size(); i++)
+    {
+        RegularizeBeforeUpdate(regularization, *gradients[i], *functionValues[i]);
+        smoothedGradients[i]->FSAdagradUpdate(mbSize, *gradients[i], *functionValues[i], *smoothedCounts[i], learnRatePerSample, targetAdagradAvDenom, meanMomentum, varMomentum);
+        RegularizeAfterUpdate(regularization, *functionValues[i]);
+    }
+}
+
+template <class ElemType>
+/*static*/ void Matrix<ElemType>::MultiRmsProp(const std::vector<Matrix<ElemType>*>& smoothedGradients, const std::vector<Matrix<ElemType>*>& gradients, const std::vector<Matrix<ElemType>*>& functionValues,
+                                              const ElemType learnRatePerSample, ElemType RMS_GAMMA, ElemType RMS_WGT_INC, ElemType RMS_WGT_MAX, ElemType RMS_WGT_DEC, ElemType RMS_WGT_MIN,
+                                              const UpdateRegularization<ElemType>& regularization)
+{
+    std::vector<GPUMatrix<ElemType>*> gpuSmoothedGradients, gpuGradients, gpuFunctionValues;
+    if (GetDenseGPUMatrices(smoothedGradients, gradients, functionValues, gpuSmoothedGradients, gpuGradients, gpuFunctionValues))
+    {
+        GPUMatrix<ElemType>::MultiRmsProp(gpuSmoothedGradients, gpuGradients, gpuFunctionValues, learnRatePerSample, RMS_GAMMA, RMS_WGT_INC, RMS_WGT_MAX, RMS_WGT_DEC, RMS_WGT_MIN, regularization);
+        return;
+    }
+
+    for (size_t i = 0; i < gradients.size(); i++)
+    {
+        RegularizeBeforeUpdate(regularization, *gradients[i], *functionValues[i]);
+        smoothedGradients[i]->RmsProp(*gradients[i], RMS_GAMMA, RMS_WGT_INC, RMS_WGT_MAX, RMS_WGT_DEC, RMS_WGT_MIN, /*needAveMultiplier*/ false);
+        ScaleAndAdd(-learnRatePerSample, *gradients[i], *functionValues[i]);
+        RegularizeAfterUpdate(regularization, *functionValues[i]);
+    }
+}
+
+template <class ElemType>
+/*static*/ void Matrix<ElemType>::MultiClipByNorm(const std::vector<Matrix<ElemType>*>& gradients, const ElemType maxNorm, const bool globalNorm, Matrix<ElemType>& factors)
+{
+    if (gradients.empty())
+        return;
+
+    const auto deviceId = gradients[0]->GetDeviceId();
+    bool areDenseOnGPU = deviceId != CPUDEVICE;
+    for (auto gradient : gradients)
+        areDenseOnGPU = areDenseOnGPU && gradient->GetDeviceId() == deviceId && gradient->GetMatrixType() == DENSE && gradient->GetCurrentMatrixLocation() == GPU;
+
+    const size_t numFactors = globalNorm ? 1 : gradients.size();
+    if (areDenseOnGPU)
+    {
+        if (factors.GetDeviceId() != deviceId || factors.GetMatrixType() != DENSE)
+            factors = Matrix<ElemType>(1, numFactors, deviceId);
+        std::vector<GPUMatrix<ElemType>*> gpuGradients;
+        for (auto gradient : gradients)
+            gpuGradients.push_back(gradient->m_GPUMatrix.get());
+
+        GPUMatrix<ElemType>::MultiClipByNorm(gpuGradients, maxNorm, globalNorm, *factors.m_GPUMatrix);
+        factors.SetDataLocation(GPU, DENSE);
+        return;
+    }
+
+    std::vector<double> norms;
+    for (auto gradient : gradients)
+        norms.push_back(gradient->FrobeniusNorm());
+    if (globalNorm)
+    {
+        double sumOfSquares = 0;
+        for (auto norm : norms)
+            sumOfSquares += norm * norm;
+        norms.assign(1, sqrt(sumOfSquares));
+    }
+
+    std::vector<ElemType> hostFactors;
+    for (auto norm : norms)
+        hostFactors.push_back(norm > maxNorm ? (ElemType) (maxNorm / norm) : (ElemType) 1);
+    for (size_t i = 0; i < gradients.size(); i++)
+    {
+        if (hostFactors[globalNorm ? 0 : i] != 1)
+            *gradients[i] *= hostFactors[globalNorm ? 0 : i];
+    }
+    factors.SetValue(1, numFactors, deviceId, hostFactors.data());
+}
+
+// lazy momentum for SparseBlockCol gradients, see declaration
+// The steps skipped by a column are those without a gradient since 'lastUpdates' (minibatches are counted in ElemType, which is exact
+// up to 2^24 minibatches in float). Each of them decays the momentum accumulator M and moves the parameter by the decayed value, i.e.
+// k skipped steps decay M by momentum^k and move the parameter by learnRatePerSample * (momentum + ... + momentum^k) * M, where
+// Nesterov momentum contributes one more factor 'momentum'. When the learning rate or momentum change, the current ones are used.
+template <class ElemType>
+void Matrix<ElemType>::CatchUpLazyMomentum(const Matrix<ElemType>& gradients, Matrix<ElemType>& functionValues, Matrix<ElemType>& lastUpdates, size_t timestamp,
+                                           const ElemType learnRatePerSample, const ElemType momentum, const bool useNAG,
+                                           const bool hasVarianceAccumulator, const ElemType varMomentum)
+{
+    DecideAndMoveToRightDevice(*this, gradients, functionValues, lastUpdates);
+
+    const size_t numCols = functionValues.GetNumCols();
+    if (lastUpdates.GetNumRows() != 1 || lastUpdates.GetNumCols() != numCols || GetNumCols() != (hasVarianceAccumulator ? 2 : 1) * numCols)
+        InvalidArgument("CatchUpLazyMomentum: The smoothed gradients [%d x %d] and last updates [%d x %d] do not match the parameter [%d x %d].",
+                        (int) GetNumRows(), (int) GetNumCols(), (int) lastUpdates.GetNumRows(), (int) lastUpdates.GetNumCols(), (int) functionValues.GetNumRows(), (int) numCols);
+
+    const ElemType learnRateScale = useNAG ? learnRatePerSample * momentum : learnRatePerSample;
+
+    if (gradients.GetMatrixType() == MatrixType::SPARSE)
+    {
+        DISPATCH_MATRIX_ON_FLAG(&gradients, nullptr,
+            NOT_IMPLEMENTED,
+            NOT_IMPLEMENTED,
+            gradients.m_CPUSparseMatrix->CatchUpLazyMomentum(*m_CPUMatrix, *functionValues.m_CPUMatrix, *lastUpdates.m_CPUMatrix, (ElemType) timestamp,
+                                                             learnRateScale, momentum, hasVarianceAccumulator, varMomentum),
+            gradients.m_GPUSparseMatrix->CatchUpLazyMomentum(*m_GPUMatrix, *functionValues.m_GPUMatrix, *lastUpdates.m_GPUMatrix, (ElemType) timestamp,
+                                                             learnRateScale, momentum, hasVarianceAccumulator, varMomentum));
+        return;
+    }
+
+    // dense: all columns, as rows of per-column factors
+    Matrix<ElemType> numSkipped(GetDeviceId());
+    numSkipped.AssignDifferenceOf((ElemType) timestamp - 1, lastUpdates);
+    numSkipped.InplaceTruncateBottom(0);
+    // base^numSkipped
+    auto decayOf = [&](ElemType base)
+    {
+        Matrix<ElemType> decay(GetDeviceId());
+        if (base > 0)
+        {
+            decay.AssignProductOf(log(base), numSkipped);
+            decay.InplaceExp();
+        }
+        else // 0^0 = 1
+        {
+            decay.AssignTruncateTopOf(numSkipped, 1);
+            decay.AssignDifferenceOf(1, decay);
+        }
+        return decay;
+    };
+
+    auto smoothedMomentum = ColumnSlice(hasVarianceAccumulator ? numCols : 0, numCols);
+    if (momentum != 0)
+    {
+        Matrix<ElemType> momentumDecay = decayOf(momentum);
+        Matrix<ElemType> decaySum(GetDeviceId());
+        if (momentum == 1)
+            decaySum.AssignProductOf(learnRateScale, numSkipped);
+        else
+            decaySum.AssignDifferenceOf(1, momentumDecay) *= learnRateScale * momentum / (1 - momentum);
+
+        Matrix<ElemType> step(GetDeviceId());
+        step.AssignValuesOf(smoothedMomentum);
+        step.RowElementMultiplyWith(decaySum);
+        functionValues -= step;
+        smoothedMomentum.RowElementMultiplyWith(momentumDecay);
+    }
+    else
+        smoothedMomentum.RowElementMultiplyWith(decayOf(momentum));
+
+    if (hasVarianceAccumulator)
+    {
+        auto smoothedVariance = ColumnSlice(0, numCols);
+        smoothedVariance.RowElementMultiplyWith(decayOf(varMomentum));
+    }
+
+    lastUpdates.SetValue((ElemType) timestamp);
+}
+
+template <class ElemType>
+void Matrix<ElemType>::GetSparseBlockColumnIds(std::vector<size_t>& columnIds) const
+{
+    DISPATCH_MATRIX_ON_FLAG(this, nullptr,
+        NOT_IMPLEMENTED,
+        NOT_IMPLEMENTED,
+        m_CPUSparseMatrix->GetBlockColumnIds(columnIds),
+        m_GPUSparseMatrix->GetBlockColumnIds(columnIds));
+}
+
+template <class ElemType>
+void Matrix<ElemType>::GetSparseCSCData(std::vector<CPUSPARSE_INDEX_TYPE>& columnStarts, std::vector<CPUSPARSE_INDEX_TYPE>& rowIndices, std::vector<ElemType>& values) const
+{
+    if (GetMatrixType() != MatrixType::SPARSE || GetFormat() != matrixFormatSparseCSC)
+        LogicError("GetSparseCSCData: The matrix must be sparse in CSC format.");
+
+    DISPATCH_MATRIX_ON_FLAG(this, nullptr,
+        NOT_IMPLEMENTED,
+        NOT_IMPLEMENTED,
+        {
+            const CPUSPARSE_INDEX_TYPE* starts = m_CPUSparseMatrix->SecondaryIndexLocation();
+            size_t nz = m_CPUSparseMatrix->NzCount();
+            if (starts)
+                columnStarts.assign(starts, starts + GetNumCols() + 1);
+            else
+                columnStarts.assign(GetNumCols() + 1, 0);
+            rowIndices.assign(m_CPUSparseMatrix->MajorIndexLocation(), m_CPUSparseMatrix->MajorIndexLocation() + nz);
+            values.assign(m_CPUSparseMatrix->Data(), m_CPUSparseMatrix->Data() + nz);
+        },
+        {
+            GPUSPARSE_INDEX_TYPE* starts = nullptr;
+            GPUSPARSE_INDEX_TYPE* rows = nullptr;
+            ElemType* vals = nullptr;
+            size_t numElemAllocated = 0;
+            size_t nz = 0;
+            size_t numRows = 0;
+            size_t numCols = 0;
+            m_GPUSparseMatrix->GetMatrixFromCSCFormat(starts, rows, vals, numElemAllocated, nz, numRows, numCols);
+            if (starts)
+                columnStarts.assign(starts, starts + numCols + 1);
+            else
+                columnStarts.assign(numCols + 1, 0);
+            rowIndices.assign(rows, rows + (rows ? nz : 0));
+            values.assign(vals, vals + (vals ? nz : 0));
+            delete[] starts;
+            delete[] rows;
+            delete[] vals;
+        });
+
+    // a column slice starts in the middle of the buffers
+    CPUSPARSE_INDEX_TYPE first = columnStarts.front();
+    for (auto& start : columnStarts)
+        start -= first;
+}
+
+template <class ElemType>
+void Matrix<ElemType>::ExpandSparseBlockColumns(const std::vector<size_t>& columnIds)
+{
+    DISPATCH_MATRIX_ON_FLAG(this, this,
+        NOT_IMPLEMENTED,
+        NOT_IMPLEMENTED,
+        m_CPUSparseMatrix->ExpandBlockColumns(columnIds),
+        m_GPUSparseMatrix->ExpandBlockColumns(columnIds));
+}
+
 template <class ElemType>
 void Matrix<ElemType>::Reshape(const size_t numRows, const size_t numCols)
 {
@@ -2558,6 +3044,76 @@ Matrix<ElemType>& Matrix<ElemType>::AssignNumOfDiff(const Matrix<ElemType>& a, c
 
     return *this;
 }
+template <class ElemType>
+Matrix<ElemType>& Matrix<ElemType>::AssignLambdaRankMetricOf(const Matrix<ElemType>& gains, const Matrix<ElemType>& scores, const Matrix<ElemType>& queryIds, Matrix<ElemType>& discounts)
+{
+    DecideAndMoveToRightDevice(gains, scores, queryIds, discounts);
+    DecideAndMoveToRightDevice(gains, *this);
+    SwitchToMatrixType(MatrixType::DENSE, matrixFormatDense, false);
+    discounts.SwitchToMatrixType(MatrixType::DENSE, matrixFormatDense, false);
+
+    DISPATCH_MATRIX_ON_FLAG(&gains,
+                            this,
+                            m_CPUMatrix->AssignLambdaRankMetricOf(*gains.m_CPUMatrix, *scores.m_CPUMatrix, *queryIds.m_CPUMatrix, *discounts.m_CPUMatrix),
+                            m_GPUMatrix->AssignLambdaRankMetricOf(*gains.m_GPUMatrix, *scores.m_GPUMatrix, *queryIds.m_GPUMatrix, *discounts.m_GPUMatrix),
+                            NOT_IMPLEMENTED,
+                            NOT_IMPLEMENTED);
+
+    return *this;
+}
+
+template <class ElemType>
+Matrix<ElemType>& Matrix<ElemType>::AddLambdaRankGradientOf(ElemType sigma, const Matrix<ElemType>& gains, const Matrix<ElemType>& scores, const Matrix<ElemType>& queryIds, const Matrix<ElemType>& discounts)
+{
+    DecideAndMoveToRightDevice(gains, scores, queryIds, discounts);
+    DecideAndMoveToRightDevice(gains, *this);
+
+    DISPATCH_MATRIX_ON_FLAG(&gains,
+                            this,
+                            m_CPUMatrix->AddLambdaRankGradientOf(sigma, *gains.m_CPUMatrix, *scores.m_CPUMatrix, *queryIds.m_CPUMatrix, *discounts.m_CPUMatrix),
+                            m_GPUMatrix->AddLambdaRankGradientOf(sigma, *gains.m_GPUMatrix, *scores.m_GPUMatrix, *queryIds.m_GPUMatrix, *discounts.m_GPUMatrix),
+                            NOT_IMPLEMENTED,
+                            NOT_IMPLEMENTED);
+
+    return *this;
+}
+
+template <class ElemType>
+Matrix<ElemType>& Matrix<ElemType>::AssignGMMLogLikelihoodOf(const Matrix<ElemType>& unnormedPriors, const Matrix<ElemType>& means, const Matrix<ElemType>& logStddevs,
+                                                             const Matrix<ElemType>& features, Matrix<ElemType>& posteriors)
+{
+    DecideAndMoveToRightDevice(features, unnormedPriors, means, logStddevs);
+    DecideAndMoveToRightDevice(features, posteriors, *this);
+    SwitchToMatrixType(MatrixType::DENSE, matrixFormatDense, false);
+    posteriors.SwitchToMatrixType(MatrixType::DENSE, matrixFormatDense, false);
+
+    DISPATCH_MATRIX_ON_FLAG(&features,
+                            this,
+                            m_CPUMatrix->AssignGMMLogLikelihoodOf(*unnormedPriors.m_CPUMatrix, *means.m_CPUMatrix, *logStddevs.m_CPUMatrix, *features.m_CPUMatrix, *posteriors.m_CPUMatrix),
+                            m_GPUMatrix->AssignGMMLogLikelihoodOf(*unnormedPriors.m_GPUMatrix, *means.m_GPUMatrix, *logStddevs.m_GPUMatrix, *features.m_GPUMatrix, *posteriors.m_GPUMatrix),
+                            NOT_IMPLEMENTED,
+                            NOT_IMPLEMENTED);
+
+    return *this;
+}
+
+template <class ElemType>
+Matrix<ElemType>& Matrix<ElemType>::AddGMMLogLikelihoodGradientOf(size_t inputIndex, const Matrix<ElemType>& gradient, const Matrix<ElemType>& unnormedPriors, const Matrix<ElemType>& means,
+                                                                  const Matrix<ElemType>& logStddevs, const Matrix<ElemType>& features, const Matrix<ElemType>& posteriors)
+{
+    DecideAndMoveToRightDevice(features, unnormedPriors, means, logStddevs);
+    DecideAndMoveToRightDevice(features, gradient, posteriors, *this);
+
+    DISPATCH_MATRIX_ON_FLAG(&features,
+                            this,
+                            m_CPUMatrix->AddGMMLogLikelihoodGradientOf(inputIndex, *gradient.m_CPUMatrix, *unnormedPriors.m_CPUMatrix, *means.m_CPUMatrix, *logStddevs.m_CPUMatrix, *features.m_CPUMatrix, *posteriors.m_CPUMatrix),
+                            m_GPUMatrix->AddGMMLogLikelihoodGradientOf(inputIndex, *gradient.m_GPUMatrix, *unnormedPriors.m_GPUMatrix, *means.m_GPUMatrix, *logStddevs.m_GPUMatrix, *features.m_GPUMatrix, *posteriors.m_GPUMatrix),
+                            NOT_IMPLEMENTED,
+                            NOT_IMPLEMENTED);
+
+    return *this;
+}
+
 //[this]=tanh([this]) element wise
 template <class ElemType>
 Matrix<ElemType>& Matrix<ElemType>::InplaceTanh()
@@ -3685,6 +4241,9 @@ void Matrix<ElemType>::_transferFromDeviceToDevice(int from_id, int to_id, bool
     }
     if ((GetMathLibTraceLevel() > 0) && (m_numTimesDeviceChanged == NUM_DEVICE_CHANGED_WARN && m_devicesTransferedTo[1] >= CPUDEVICE))
         fprintf(stderr, "WARNING: The same matrix with dim [%lu, %lu] has been transferred between different devices for %d times.\n", (unsigned long) GetNumRows(), (unsigned long) GetNumCols(), NUM_DEVICE_CHANGED_WARN);
+    // (an empty transfer only allocates)
+    if (!emptyTransfer)
+        MatrixTransitionTracker::RecordDeviceTransfer(from_id, to_id, GetNumRows(), GetNumCols());
 
     // do the transfer
     if (m_matrixType == MatrixType::SPARSE)
@@ -4425,7 +4984,7 @@ void Matrix<ElemType>::RNNForward(const Matrix<ElemType> &inputX, const Matrix<E
 
     DISPATCH_MATRIX_ON_FLAG(this,
                             this,
-                            NOT_IMPLEMENTED,
+                            m_CPUMatrix->RNNForward(*(inputX.m_CPUMatrix), *(paramW.m_CPUMatrix), xDim, yDim, numSequencesForFrame, rnnAttributes, *(reserve.m_CPUMatrix), *(workspace.m_CPUMatrix)),
                             m_GPUMatrix->RNNForward(*(inputX.m_GPUMatrix), *(paramW.m_GPUMatrix), xDim, yDim, numSequencesForFrame, rnnAttributes, *(reserve.m_GPUMatrix), *(workspace.m_GPUMatrix)),
                             NOT_IMPLEMENTED,
                             NOT_IMPLEMENTED);
@@ -4503,7 +5062,7 @@ void Matrix<ElemType>::SVD(const Matrix<ElemType>& A, Matrix<ElemType>& SIGMA, M
 /// <param name="c">Resulting matrix, user is responsible for allocating this</param>
 template <class ElemType>
 void Matrix<ElemType>::MultiplyAndWeightedAdd(ElemType alpha, const Matrix<ElemType>& a, const bool transposeA, const Matrix<ElemType>& b, const bool transposeB,
-                                              ElemType beta, Matrix<ElemType>& c, shared_ptr<QuantizedMultiplier<ElemType>> pQuantizedMultiplier)
+                                              ElemType beta, Matrix<ElemType>& c, shared_ptr<QuantizedMultiplier<ElemType>> pQuantizedMultiplier, shared_ptr<PackedGemmMatrix<ElemType>> pPackedA)
 {
     DecideAndMoveToRightDevice(a, b, c);
 
@@ -4564,7 +5123,7 @@ void Matrix<ElemType>::MultiplyAndWeightedAdd(ElemType alpha, const Matrix<ElemT
             else // CPU, DENSE * DENSE -> DENSE (matrix c enforced to be DENSE)
             {
                 c.SwitchToMatrixType(MatrixType::DENSE, matrixFormatDense, false);
-                CPUMatrix<ElemType>::MultiplyAndWeightedAdd(alpha, *a.m_CPUMatrix, transposeA, *b.m_CPUMatrix, transposeB, beta, *c.m_CPUMatrix, pQuantizedMultiplier);
+                CPUMatrix<ElemType>::MultiplyAndWeightedAdd(alpha, *a.m_CPUMatrix, transposeA, *b.m_CPUMatrix, transposeB, beta, *c.m_CPUMatrix, pQuantizedMultiplier, pPackedA);
                 c.SetDataLocation(CPU, DENSE);
             }
         }
@@ -4660,6 +5219,37 @@ template <class ElemType>
                             NOT_IMPLEMENTED);
 }
 
+template <class ElemType>
+/*static*/ void Matrix<ElemType>::BatchMultiplyAndWeightedAdd(ElemType alpha, const Matrix<ElemType>& a, size_t aRows, const bool transposeA, const Matrix<ElemType>& b, size_t bRows, const bool transposeB, ElemType beta, Matrix<ElemType>& c)
+{
+    if (a.GetMatrixType() != DENSE || b.GetMatrixType() != DENSE || c.GetMatrixType() != DENSE)
+        NOT_IMPLEMENTED;
+    if (aRows == 0 || bRows == 0 || a.GetNumRows() % aRows != 0 || b.GetNumRows() % bRows != 0)
+        InvalidArgument("BatchMultiplyAndWeightedAdd: The rows of a and b must hold whole matrices of %d and %d rows.", (int) aRows, (int) bRows);
+    size_t aCols = a.GetNumRows() / aRows;
+    size_t bCols = b.GetNumRows() / bRows;
+    size_t m = transposeA ? aCols : aRows;
+    size_t k = transposeA ? aRows : aCols;
+    size_t n = transposeB ? bRows : bCols;
+    if ((transposeB ? bCols : bRows) != k)
+        InvalidArgument("BatchMultiplyAndWeightedAdd: The inner dimensions of the products do not match.");
+    size_t batchSize = c.GetNumCols();
+    if (c.GetNumRows() != m * n || (a.GetNumCols() != batchSize && a.GetNumCols() != 1) || (b.GetNumCols() != batchSize && b.GetNumCols() != 1))
+        InvalidArgument("BatchMultiplyAndWeightedAdd: The output [%d x %d] does not match %d products of [%d x %d] matrices.",
+                        (int) c.GetNumRows(), (int) c.GetNumCols(), (int) max(a.GetNumCols(), b.GetNumCols()), (int) m, (int) n);
+    if (c.IsEmpty())
+        return;
+
+    DecideAndMoveToRightDevice(a, b, c);
+
+    DISPATCH_MATRIX_ON_FLAG(&c,
+                            nullptr,
+                            CPUMatrix<ElemType>::BatchMultiplyAndWeightedAdd(alpha, *a.m_CPUMatrix, transposeA, *b.m_CPUMatrix, transposeB, beta, *c.m_CPUMatrix, m, n, k),
+                            GPUMatrix<ElemType>::BatchMultiplyAndWeightedAdd(alpha, *a.m_GPUMatrix, transposeA, *b.m_GPUMatrix, transposeB, beta, *c.m_GPUMatrix, m, n, k),
+                            NOT_IMPLEMENTED,
+                            NOT_IMPLEMENTED);
+}
+
 /// <summary>Matrix-matrix multiply with col-major matrices (a and b may be transposed): c =  op(a) * op(b) + c</summary>
 /// <param name="a">Input matrix</param>
 /// <param name="transposeA">Whether matrix a is transposed</param>
@@ -5353,6 +5943,66 @@ void Matrix<ElemType>::InnerProductWithShiftNeg(const Matrix<ElemType>& a, const
                             NOT_IMPLEMENTED);
 }
 
+// The following two implement CosDistanceWithNegativeSamplesNode in one pass each, without the shifted copies of the inputs.
+// this = cosines [(negnumber + 1) x n]; invNormA and invNormB receive the inverse column norms [1 x n], for use in the gradient
+template <class ElemType>
+Matrix<ElemType>& Matrix<ElemType>::AssignCosDistanceWithNegativeSamplesOf(const Matrix<ElemType>& a, const Matrix<ElemType>& b, size_t shift, size_t negnumber, Matrix<ElemType>& invNormA, Matrix<ElemType>& invNormB)
+{
+    if (a.IsEmpty() || b.IsEmpty())
+        LogicError("AssignCosDistanceWithNegativeSamplesOf: one of the input matrices is empty.");
+    if (a.GetNumRows() != b.GetNumRows() || a.GetNumCols() != b.GetNumCols())
+        InvalidArgument("AssignCosDistanceWithNegativeSamplesOf: Matrices a and b should have same dimension.");
+
+    DecideAndMoveToRightDevice(a, b, *this);
+    invNormA._transferToDevice(GetDeviceId());
+    invNormB._transferToDevice(GetDeviceId());
+
+    if (a.GetMatrixType() != MatrixType::DENSE || b.GetMatrixType() != MatrixType::DENSE)
+        NOT_IMPLEMENTED;
+
+    SwitchToMatrixType(MatrixType::DENSE, matrixFormatDense, false);
+    invNormA.SwitchToMatrixType(MatrixType::DENSE, matrixFormatDense, false);
+    invNormB.SwitchToMatrixType(MatrixType::DENSE, matrixFormatDense, false);
+
+    DISPATCH_MATRIX_ON_FLAG(this,
+                            this,
+                            m_CPUMatrix->AssignCosDistanceWithNegativeSamplesOf(*a.m_CPUMatrix, *b.m_CPUMatrix, shift, negnumber, *invNormA.m_CPUMatrix, *invNormB.m_CPUMatrix),
+                            m_GPUMatrix->AssignCosDistanceWithNegativeSamplesOf(*a.m_GPUMatrix, *b.m_GPUMatrix, shift, negnumber, *invNormA.m_GPUMatrix, *invNormB.m_GPUMatrix),
+                            NOT_IMPLEMENTED,
+                            NOT_IMPLEMENTED);
+
+    return *this;
+}
+
+// this += gradient of the cosines w.r.t. a (or b if isRightInput), given the gradient and value of the cosines and the inverse norms from the forward pass
+template <class ElemType>
+Matrix<ElemType>& Matrix<ElemType>::AddCosDistanceWithNegativeSamplesGradientOf(const Matrix<ElemType>& gradient, const Matrix<ElemType>& value, const Matrix<ElemType>& a, const Matrix<ElemType>& b,
+                                                                                const Matrix<ElemType>& invNormA, const Matrix<ElemType>& invNormB, size_t shift, bool isRightInput)
+{
+    if (GetNumRows() != a.GetNumRows() || GetNumCols() != a.GetNumCols())
+        InvalidArgument("AddCosDistanceWithNegativeSamplesGradientOf: The gradient must have the dimensions of the input.");
+    if (gradient.GetNumRows() != value.GetNumRows() || gradient.GetNumCols() != value.GetNumCols() || gradient.GetNumCols() != a.GetNumCols())
+        InvalidArgument("AddCosDistanceWithNegativeSamplesGradientOf: The output gradient and value dimensions do not match.");
+
+    DecideAndMoveToRightDevice(gradient, value, *this);
+    a._transferToDevice(GetDeviceId());
+    b._transferToDevice(GetDeviceId());
+    invNormA._transferToDevice(GetDeviceId());
+    invNormB._transferToDevice(GetDeviceId());
+
+    if (GetMatrixType() != MatrixType::DENSE || gradient.GetMatrixType() != MatrixType::DENSE)
+        NOT_IMPLEMENTED;
+
+    DISPATCH_MATRIX_ON_FLAG(this,
+                            this,
+                            m_CPUMatrix->AddCosDistanceWithNegativeSamplesGradientOf(*gradient.m_CPUMatrix, *value.m_CPUMatrix, *a.m_CPUMatrix, *b.m_CPUMatrix, *invNormA.m_CPUMatrix, *invNormB.m_CPUMatrix, shift, isRightInput),
+                            m_GPUMatrix->AddCosDistanceWithNegativeSamplesGradientOf(*gradient.m_GPUMatrix, *value.m_GPUMatrix, *a.m_GPUMatrix, *b.m_GPUMatrix, *invNormA.m_GPUMatrix, *invNormB.m_GPUMatrix, shift, isRightInput),
+                            NOT_IMPLEMENTED,
+                            NOT_IMPLEMENTED);
+
+    return *this;
+}
+
 template <class ElemType>
 Matrix<ElemType>& Matrix<ElemType>::GetARowByIndex(const Matrix<ElemType>& a, size_t index)
 {
@@ -5482,6 +6132,70 @@ void Matrix<ElemType>::RCRFTransGrdCompute(const Matrix<ElemType>& lbls,
                             NOT_IMPLEMENTED);
 }
 
+template <class ElemType>
+void Matrix<ElemType>::RCRFForwardBackward(const Matrix<ElemType>& lbls, const Matrix<ElemType>& pos_scores, const Matrix<ElemType>& pair_scores,
+                                           const std::vector<CRFSequence>& sequences, size_t numParallelSequences,
+                                           Matrix<ElemType>& alpha, Matrix<ElemType>& beta, Matrix<ElemType>& objectives)
+{
+    DecideAndMoveToRightDevice(pos_scores, lbls, pair_scores);
+    alpha._transferToDevice(pos_scores.GetDeviceId());
+    beta._transferToDevice(pos_scores.GetDeviceId());
+    objectives._transferToDevice(pos_scores.GetDeviceId());
+    alpha.SwitchToMatrixType(MatrixType::DENSE, MatrixFormat::matrixFormatDense, false);
+    beta.SwitchToMatrixType(MatrixType::DENSE, MatrixFormat::matrixFormatDense, false);
+    objectives.SwitchToMatrixType(MatrixType::DENSE, MatrixFormat::matrixFormatDense, false);
+
+    DISPATCH_MATRIX_ON_FLAG(&pos_scores,
+                            &alpha,
+                            CPUMatrix<ElemType>::RCRFForwardBackward(
+                                *lbls.m_CPUMatrix,
+                                *pos_scores.m_CPUMatrix,
+                                *pair_scores.m_CPUMatrix,
+                                sequences, numParallelSequences,
+                                *alpha.m_CPUMatrix,
+                                *beta.m_CPUMatrix,
+                                *objectives.m_CPUMatrix),
+                            GPUMatrix<ElemType>::RCRFForwardBackward(
+                                *lbls.m_GPUMatrix,
+                                *pos_scores.m_GPUMatrix,
+                                *pair_scores.m_GPUMatrix,
+                                sequences, numParallelSequences,
+                                *alpha.m_GPUMatrix,
+                                *beta.m_GPUMatrix,
+                                *objectives.m_GPUMatrix),
+                            NOT_IMPLEMENTED,
+                            NOT_IMPLEMENTED);
+    beta.SetDataLocation(alpha.GetCurrentMatrixLocation(), DENSE);
+    objectives.SetDataLocation(alpha.GetCurrentMatrixLocation(), DENSE);
+}
+
+template <class ElemType>
+void Matrix<ElemType>::RCRFViterbiDecode(const Matrix<ElemType>& lbls, const Matrix<ElemType>& pos_scores, const Matrix<ElemType>& pair_scores,
+                                         const std::vector<CRFSequence>& sequences, size_t numParallelSequences,
+                                         Matrix<ElemType>& decodedPath)
+{
+    DecideAndMoveToRightDevice(pos_scores, lbls, pair_scores);
+    decodedPath._transferToDevice(pos_scores.GetDeviceId());
+    decodedPath.SwitchToMatrixType(MatrixType::DENSE, MatrixFormat::matrixFormatDense, false);
+
+    DISPATCH_MATRIX_ON_FLAG(&pos_scores,
+                            &decodedPath,
+                            CPUMatrix<ElemType>::RCRFViterbiDecode(
+                                *lbls.m_CPUMatrix,
+                                *pos_scores.m_CPUMatrix,
+                                *pair_scores.m_CPUMatrix,
+                                sequences, numParallelSequences,
+                                *decodedPath.m_CPUMatrix),
+                            GPUMatrix<ElemType>::RCRFViterbiDecode(
+                                *lbls.m_GPUMatrix,
+                                *pos_scores.m_GPUMatrix,
+                                *pair_scores.m_GPUMatrix,
+                                sequences, numParallelSequences,
+                                *decodedPath.m_GPUMatrix),
+                            NOT_IMPLEMENTED,
+                            NOT_IMPLEMENTED);
+}
+
 template <class ElemType>
 Matrix<ElemType>& Matrix<ElemType>::DropFrame(const Matrix<ElemType>& label, const Matrix<ElemType>& gamma, const ElemType& threshhold)
 {
@@ -5591,6 +6305,55 @@ void Matrix<ElemType>::TensorOp(ElemType beta, const Matrix<ElemType>& a, const
                             NOT_IMPLEMENTED);
 }
 
+static void VerifyFusedElementwiseProgram(const FusedElementwiseProgram& program, size_t numInputs)
+{
+    if (program.numInputs != (int) numInputs || numInputs > FusedElementwiseProgram::MaxInputs)
+        InvalidArgument("FusedElementwiseOp: The program has %d inputs, but %d were passed.", program.numInputs, (int) numInputs);
+    if (program.numSteps < 1 || program.numSteps > FusedElementwiseProgram::MaxSteps)
+        InvalidArgument("FusedElementwiseOp: A program must have 1 to %d steps.", FusedElementwiseProgram::MaxSteps);
+    for (int k = 0; k < program.numSteps; k++)
+    {
+        const auto& step = program.steps[k];
+        if (step.arity < 1 || step.arity > 3)
+            InvalidArgument("FusedElementwiseOp: Step %d has an invalid arity %d.", k, step.arity);
+        for (int i = 0; i < step.arity; i++)
+        {
+            if (step.args[i] < 0 || step.args[i] >= program.numInputs + k)
+                InvalidArgument("FusedElementwiseOp: Argument %d of step %d refers to a value that is not computed before.", i, k);
+        }
+    }
+}
+
+// this = program(inputs), elementwise
+template <class ElemType>
+void Matrix<ElemType>::FusedElementwiseOp(const FusedElementwiseProgram& program, const std::vector<const Matrix<ElemType>*>& inputs)
+{
+    VerifyFusedElementwiseProgram(program, inputs.size());
+    VerifyIsDense(*this);
+    for (const auto* input : inputs)
+    {
+        VerifyIsDense(*input);
+        if (input->GetNumRows() != GetNumRows() || (input->GetNumCols() != GetNumCols() && input->GetNumCols() != 1))
+            InvalidArgument("FusedElementwiseOp: Input dimensions [%d x %d] do not match the output [%d x %d].",
+                            (int) input->GetNumRows(), (int) input->GetNumCols(), (int) GetNumRows(), (int) GetNumCols());
+        input->_transferToDevice(GetDeviceId());
+    }
+
+    std::vector<const CPUMatrix<ElemType>*> cpuInputs;
+    std::vector<const GPUMatrix<ElemType>*> gpuInputs;
+    for (const auto* input : inputs)
+    {
+        cpuInputs.push_back(input->m_CPUMatrix.get());
+        gpuInputs.push_back(input->m_GPUMatrix.get());
+    }
+    DISPATCH_MATRIX_ON_FLAG(this,
+                            this,
+                            m_CPUMatrix->FusedElementwiseOp(program, cpuInputs),
+                            m_GPUMatrix->FusedElementwiseOp(program, gpuInputs),
+                            NOT_IMPLEMENTED,
+                            NOT_IMPLEMENTED);
+}
+
 //template class Matrix<short>;
 template class Matrix<float>;
 template class Matrix<double>;
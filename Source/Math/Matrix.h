@@ -20,6 +20,7 @@
 #include <array>
 #include <initializer_list>
 #include "QuantizedOperations.h"
+#include "PackedGemm.h"
 
 // Forward declarations
 namespace CNTK
@@ -97,6 +98,9 @@ private:
     static void DecideAndMoveToRightDevice(const Matrix<ElemType>& a, const Matrix<ElemType2>& b);
     static void DecideAndMoveToRightDevice(const Matrix<ElemType>& a, const Matrix<ElemType>& b, const Matrix<ElemType>& c);
     static void DecideAndMoveToRightDevice(const Matrix<ElemType>& a, const Matrix<ElemType>& b, const Matrix<ElemType>& c, const Matrix<ElemType>& d);
+    // gets the GPU matrices of the matrices of a multi-tensor update, if all of them are dense and on the same GPU
+    static bool GetDenseGPUMatrices(const std::vector<Matrix<ElemType>*>& smoothedGradients, const std::vector<Matrix<ElemType>*>& gradients, const std::vector<Matrix<ElemType>*>& functionValues,
+                                    std::vector<GPUMatrix<ElemType>*>& gpuSmoothedGradients, std::vector<GPUMatrix<ElemType>*>& gpuGradients, std::vector<GPUMatrix<ElemType>*>& gpuFunctionValues);
     static void CopyElementsFromDenseToSparse(CPUMatrix<ElemType>& from, CPUSparseMatrix<ElemType>& dest);
 
 public:
@@ -117,6 +121,8 @@ public:
     Matrix<ElemType>& operator=(Matrix<ElemType>&& moveFrom);                               // move assignment operator, shallow copy
 
     Matrix<ElemType> DeepClone() const;
+    // deep copy on the CPU that, unlike Matrix(*this, CPUDEVICE), does not move this matrix (dense: one device-to-host copy)
+    Matrix<ElemType> DeepCloneToCPU() const;
 
     // Disallow deep copy construction and assignment to avoid
     // inadvertent silent deep copying
@@ -132,6 +138,9 @@ public:
     static Matrix<ElemType> RandomGaussian(const size_t rows, const size_t cols, DEVICEID_TYPE deviceId, const ElemType mean, const ElemType sigma, unsigned long seed = USE_TIME_BASED_SEED);
 
     static void SetDevice(DEVICEID_TYPE deviceId); // TODO: unify with PrepareDevice()
+    // Creates the CUDA context of a GPU and the cuBLAS, cuSPARSE and cuDNN handles for it, which otherwise happens on
+    // first use and takes seconds. May be called on another thread, e.g. while the model is loaded. No-op for the CPU.
+    static void InitializeDevice(DEVICEID_TYPE deviceId);
 
     void ReleaseMemory();
     ~Matrix();
@@ -214,6 +223,56 @@ public:
                          const double learnRatePerSample, const double targetAdagradAvDenom,
                          const double meanMomentum, const double varMomentum);
     ElemType RmsProp(Matrix<ElemType>& gradients, ElemType RMS_GAMMA, ElemType RMS_WGT_INC, ElemType RMS_WGT_MAX, ElemType RMS_WGT_DEC, ElemType RMS_WGT_MIN, const bool needAveMultiplier);
+    // Adam update in one pass: updates the variance and mean accumulators (this, laid out as for FSAdagradUpdate()) with the gradients, and
+    // computes the step mean / (sqrt(variance) + epsilon) + weightDecay * functionValues from the accumulators bias corrected for 'timestep'
+    // (1-based), i.e. with AdamW's decoupled weight decay. If 'updateFunctionValues', the functionValues move by -learnRatePerSample * step,
+    // otherwise the gradients are replaced by the step, e.g. for LAMB to scale it per parameter. SparseBlockCol gradients update their columns only.
+    void AdamUpdate(Matrix<ElemType>& gradients, Matrix<ElemType>& functionValues, size_t timestep,
+                    const double learnRatePerSample, const double meanMomentum, const double varMomentum,
+                    const double epsilon, const double weightDecay, const bool updateFunctionValues);
+
+    // multi-tensor updates: update each of 'functionValues' from the corresponding dense gradient and smoothed gradients as NormalGrad(),
+    // Adagrad() and RmsProp() without average multipliers followed by the step -learnRatePerSample * gradient, and FSAdagradUpdate() would.
+    // If all matrices are dense and on one GPU, there is one kernel launch per few dozen parameters instead of one or more per parameter,
+    // and the gradients are left unchanged; otherwise the parameters are updated one by one. 'regularization' is applied in the same
+    // pass over the parameters as the update (see UpdateRegularization), or one by one with it.
+    static void MultiNormalGrad(const std::vector<Matrix<ElemType>*>& smoothedGradients, const std::vector<Matrix<ElemType>*>& gradients, const std::vector<Matrix<ElemType>*>& functionValues,
+                                const ElemType learnRatePerSample, const ElemType momentum, const bool useNAG,
+                                const UpdateRegularization<ElemType>& regularization = UpdateRegularization<ElemType>());
+    static void MultiAdagrad(const std::vector<Matrix<ElemType>*>& smoothedGradients, const std::vector<Matrix<ElemType>*>& gradients, const std::vector<Matrix<ElemType>*>& functionValues,
+                             const ElemType learnRatePerSample,
+                             const UpdateRegularization<ElemType>& regularization = UpdateRegularization<ElemType>());
+    static void MultiFSAdagradUpdate(size_t mbSize,
+                                     const std::vector<Matrix<ElemType>*>& smoothedGradients, const std::vector<Matrix<ElemType>*>& gradients, const std::vector<Matrix<ElemType>*>& functionValues,
+                                     const std::vector<double*>& smoothedCounts,
+                                     const double learnRatePerSample, const double targetAdagradAvDenom,
+                                     const double meanMomentum, const double varMomentum,
+                                     const UpdateRegularization<ElemType>& regularization = UpdateRegularization<ElemType>());
+    static void MultiRmsProp(const std::vector<Matrix<ElemType>*>& smoothedGradients, const std::vector<Matrix<ElemType>*>& gradients, const std::vector<Matrix<ElemType>*>& functionValues,
+                             const ElemType learnRatePerSample, ElemType RMS_GAMMA, ElemType RMS_WGT_INC, ElemType RMS_WGT_MAX, ElemType RMS_WGT_DEC, ElemType RMS_WGT_MIN,
+                             const UpdateRegularization<ElemType>& regularization = UpdateRegularization<ElemType>());
+
+    // gradient clipping by norm: scales each of 'gradients' by min(1, maxNorm / norm), where norm is the Frobenius norm of the gradient, or with
+    // 'globalNorm' the one of all gradients together. 'factors' receives the factors ([1 x 1] with 'globalNorm', else [1 x gradients.size()]).
+    // If all gradients are dense and on one GPU, there are two launches per few dozen gradients, and neither the norms nor the factors are
+    // transferred to the host, so clipping does not wait for the GPU; otherwise the norms are computed one by one.
+    static void MultiClipByNorm(const std::vector<Matrix<ElemType>*>& gradients, const ElemType maxNorm, const bool globalNorm, Matrix<ElemType>& factors);
+
+    // lazy momentum for SparseBlockCol gradients: the columns of a parameter that get no gradient in a minibatch still decay their
+    // smoothed gradients (this) and move by them. Instead of doing so in every minibatch, 'lastUpdates' [1 x numCols] remembers the
+    // minibatch at which each column was last updated, and the skipped steps are applied at once before the column is updated again:
+    // for the columns of 'gradients' if it is sparse, for all columns if it is dense. The smoothed gradients are laid out as for
+    // NormalGrad(), or as for FSAdagradUpdate() if 'hasVarianceAccumulator', whose variance accumulator decays with 'varMomentum'.
+    void CatchUpLazyMomentum(const Matrix<ElemType>& gradients, Matrix<ElemType>& functionValues, Matrix<ElemType>& lastUpdates, size_t timestamp,
+                             const ElemType learnRatePerSample, const ElemType momentum, const bool useNAG,
+                             const bool hasVarianceAccumulator, const ElemType varMomentum);
+
+    // SparseBlockCol only: the columns that hold blocks, and re-laying out the blocks so that they are exactly 'columnIds' (a superset
+    // of the current ones) in this order, with zeros for new ones. Matrices laid out alike can be reduced through their value buffers (Data()).
+    void GetSparseBlockColumnIds(std::vector<size_t>& columnIds) const;
+    void ExpandSparseBlockColumns(const std::vector<size_t>& columnIds);
+    // SparseCSC only: copy of the column starts (starting at 0), row indices and values on the CPU
+    void GetSparseCSCData(std::vector<CPUSPARSE_INDEX_TYPE>& columnStarts, std::vector<CPUSPARSE_INDEX_TYPE>& rowIndices, std::vector<ElemType>& values) const;
 
     void Resize(const size_t numRows, const size_t numCols, const size_t numNZElemToReserve = 10000, bool growOnly = true); // by default we only reallocate if need to grow
     void Resize(const Matrix<ElemType>& other) // TODO: Should this carry over numNZElemToReserve for sparse matrices?
@@ -280,6 +339,13 @@ public:
 
     void MaskColumnsValue(const Matrix<char>& columnsMask, ElemType val);
 
+    // Converts 8 bit images with interleaved channels (HWC), one per column of 'images' (which may be followed by other data),
+    // with the color jitter of the ImageReader's transforms. Per image, the column of 'params' has the contrast factor,
+    // the brightness as a fraction of the mean value of the image (replaced by the brightness), the saturation factor and
+    // an intensity shift per channel. Then 'mean' (HWC, or empty) is subtracted and the images are stored as HWC or CHW columns.
+    void AssignAugmentedImages(const Matrix<char>& images, Matrix<ElemType>& params, const Matrix<ElemType>& mean,
+                               size_t width, size_t height, size_t channels, bool toCHW);
+
     void SetColumn(const ElemType* colPointer, size_t colInd);
     void SetColumn(const ElemType val, size_t colInd);
     void SetColumn(const Matrix<ElemType>& valMat, size_t colInd);
@@ -289,6 +355,9 @@ public:
     void SetUniformRandomValue(const ElemType low, const ElemType high, unsigned long seed = USE_TIME_BASED_SEED);
     void SetGaussianRandomValue(const ElemType mean, const ElemType sigma, unsigned long seed = USE_TIME_BASED_SEED);
     void SetUniformRandomMask(const ElemType maskRate, const ElemType scaleValue, RNGHandle& rngHandle);
+    // this = beta * this + a .* mask, with mask(i) = 0 with probability maskRate and scaleValue otherwise, for the element i
+    // in column-major order: mask(i) is drawn by PhiloxRNG for (seed, offset + i), so the same arguments give the same mask.
+    Matrix<ElemType>& DoElementProductOfCounterBasedMask(ElemType beta, const Matrix<ElemType>& a, const ElemType maskRate, const ElemType scaleValue, uint64_t seed, uint64_t offset);
     void AddGaussianRandomValue(const ElemType mean, const ElemType sigma, unsigned long seed = USE_TIME_BASED_SEED);
     Matrix<ElemType>& AssignNoiseContrastiveEstimation(const Matrix<ElemType>& a, const Matrix<ElemType>& b, const Matrix<ElemType>& c, const Matrix<ElemType>& bias, Matrix<ElemType>& tmp);
 
@@ -302,6 +371,10 @@ public:
     Matrix<ElemType>& DoGatherColumnsOf (ElemType beta, const Matrix<ElemType>& idx, const Matrix<ElemType>& a, ElemType alpha);
     Matrix<ElemType>& DoScatterColumnsOf(ElemType beta, const Matrix<ElemType>& idx, const Matrix<ElemType>& a, ElemType alpha);
 
+    // stream compaction of the sequences of a row vector, for WhereNode (see Matrix.cpp)
+    Matrix<ElemType>& AssignNonZeroCountsOfSequences(const Matrix<ElemType>& condition, size_t conditionStride, const Matrix<ElemType>& sequences);
+    Matrix<ElemType>& DoScatterNonZeroStepsOfSequences(const Matrix<ElemType>& condition, size_t conditionStride, const Matrix<ElemType>& sequences, const Matrix<ElemType>& outputFirstColumns, size_t outputStride);
+
     Matrix<ElemType>& operator+=(const ElemType alpha);
     Matrix<ElemType>  operator+(const ElemType alpha) const;
     Matrix<ElemType>& AssignSumOf(const ElemType alpha, const Matrix<ElemType>& a);
@@ -460,6 +533,23 @@ public:
 
     Matrix<ElemType>& AssignNumOfDiff(const Matrix<ElemType>& a, const Matrix<ElemType>& b, bool searchInCol = false);
 
+    // LambdaRank (see LambdaRankNode). The urls of a query are consecutive columns of the [1 x N] gains, scores and query ids,
+    // in descending order of gain. The metric is (1 - NDCG averaged over the queries) * 100 * N, this is resized to [1 x 1];
+    // 'discounts' gets log(2 + rank) of each url, for the ranks by descending score within the query.
+    Matrix<ElemType>& AssignLambdaRankMetricOf(const Matrix<ElemType>& gains, const Matrix<ElemType>& scores, const Matrix<ElemType>& queryIds, Matrix<ElemType>& discounts);
+    // adds the gradient of the metric with respect to the scores, given the discounts from AssignLambdaRankMetricOf()
+    Matrix<ElemType>& AddLambdaRankGradientOf(ElemType sigma, const Matrix<ElemType>& gains, const Matrix<ElemType>& scores, const Matrix<ElemType>& queryIds, const Matrix<ElemType>& discounts);
+
+    // Log-likelihood of the [D x T] features under a mixture of K Gaussians whose dimensions share the standard deviation
+    // of their component (see GMMLogLikelihoodNode). The prior is softmax(unnormedPriors) [K x 1 or T], the means are
+    // [K*D x 1 or T] and the log standard deviations [K x 1 or T]. This is resized to [1 x T] and 'posteriors' gets the
+    // [K x T] posteriors of the components, which is all that the gradients need besides the inputs.
+    Matrix<ElemType>& AssignGMMLogLikelihoodOf(const Matrix<ElemType>& unnormedPriors, const Matrix<ElemType>& means, const Matrix<ElemType>& logStddevs, const Matrix<ElemType>& features, Matrix<ElemType>& posteriors);
+    // adds the gradient for input 'inputIndex' of AssignGMMLogLikelihoodOf() (0: unnormedPriors, 1: means, 2: logStddevs, 3: features)
+    // given the [1 x T] gradient of the log-likelihoods; the gradient of a parameter with one column is summed over the samples
+    Matrix<ElemType>& AddGMMLogLikelihoodGradientOf(size_t inputIndex, const Matrix<ElemType>& gradient, const Matrix<ElemType>& unnormedPriors, const Matrix<ElemType>& means, const Matrix<ElemType>& logStddevs,
+                                            const Matrix<ElemType>& features, const Matrix<ElemType>& posteriors);
+
     Matrix<ElemType>& AssignInnerProductOfMatrices(const Matrix<ElemType>& a, const Matrix<ElemType>& b); // this method will resize(1,1) first
 
     bool HasNan(const char* name) const;
@@ -549,11 +639,14 @@ public:
     // singular value decomposition of A as A = U*SIGMA*VT
     static void SVD(const Matrix<ElemType>& A, Matrix<ElemType>& SIGMA, Matrix<ElemType>& U, Matrix<ElemType>& VT, Matrix<ElemType>& W);
 
-    static void MultiplyAndWeightedAdd(ElemType alpha, const Matrix<ElemType>& a, const bool transposeA, const Matrix<ElemType>& b, const bool transposeB, ElemType beta, Matrix<ElemType>& c, shared_ptr<QuantizedMultiplier<ElemType>> pQuantizedMultiplier=nullptr); // SGEMM
+    static void MultiplyAndWeightedAdd(ElemType alpha, const Matrix<ElemType>& a, const bool transposeA, const Matrix<ElemType>& b, const bool transposeB, ElemType beta, Matrix<ElemType>& c, shared_ptr<QuantizedMultiplier<ElemType>> pQuantizedMultiplier=nullptr, shared_ptr<PackedGemmMatrix<ElemType>> pPackedA=nullptr); // SGEMM
     static void MultiplyAndAdd(const Matrix<ElemType>& a, const bool transposeA, const Matrix<ElemType>& b, const bool transposeB, Matrix<ElemType>& c);
     static void Multiply(const Matrix<ElemType>& a, const bool transposeA, const Matrix<ElemType>& b, const bool transposeB, Matrix<ElemType>& c);
     static void Multiply(const Matrix<ElemType>& a, const Matrix<ElemType>& b, Matrix<ElemType>& c);
     static void Multiply1x1AndWeightedAdd(ElemType alpha, const Matrix<ElemType>& a, const Matrix<ElemType>& b, ElemType beta, Matrix<ElemType>& c);
+    // batch of independent products: column j of c = alpha * op(A_j) * op(B_j) + beta * column j of c, where column j of a, b and c
+    // holds the matrix A_j with aRows rows (B_j with bRows rows, C_j), column-major. An a or b of a single column is used for all j.
+    static void BatchMultiplyAndWeightedAdd(ElemType alpha, const Matrix<ElemType>& a, size_t aRows, const bool transposeA, const Matrix<ElemType>& b, size_t bRows, const bool transposeB, ElemType beta, Matrix<ElemType>& c);
     static void ConvolveAndWeightedAdd(ElemType alpha, const Matrix<ElemType>& a, const bool transposeA, const Matrix<ElemType>& b, const bool transposeB, ElemType beta, Matrix<ElemType>& c, size_t numChannels, size_t horizontalSubsample, bool padding, bool channelwise);
 
     static void ScaleAndAdd(ElemType alpha, const Matrix<ElemType>& a, Matrix<ElemType>& c);
@@ -592,6 +685,9 @@ public:
                   const std::array<size_t, 4>& offsets,
                   const SmallVector<size_t>& regularOpDims, const std::array<SmallVector<ptrdiff_t>, 4>& regularStrides,
                   const SmallVector<size_t>& reducingOpDims, const std::array<SmallVector<ptrdiff_t>, 4>& reducingStrides);
+    // this = program(inputs) elementwise in one pass (see FusedElementwiseProgram). The inputs have the dimensions of
+    // this matrix, or its number of rows and a single column, which then applies to all columns.
+    void FusedElementwiseOp(const FusedElementwiseProgram& program, const std::vector<const Matrix<ElemType>*>& inputs);
 
 public:
     void Read(File& stream);
@@ -605,6 +701,10 @@ public:
     Matrix<ElemType>& GetARowByIndex(const Matrix<ElemType>& a, size_t index);
     static void ConductRowElementMultiplyWithShift(const Matrix<ElemType>& a, const Matrix<ElemType>& b, Matrix<ElemType>& c, size_t shift, bool bFirstmatrixfixed);
     Matrix<ElemType>& AssignElementProductOfWithShift(const Matrix<ElemType>& a, const Matrix<ElemType>& b, size_t shift);
+    // fused CosDistanceWithNegativeSamples: row 0 is the cosine of a(:,j) and b(:,j), row m the one of a(:,j) and b(:,(j + shift + m - 1) % n)
+    Matrix<ElemType>& AssignCosDistanceWithNegativeSamplesOf(const Matrix<ElemType>& a, const Matrix<ElemType>& b, size_t shift, size_t negnumber, Matrix<ElemType>& invNormA, Matrix<ElemType>& invNormB);
+    Matrix<ElemType>& AddCosDistanceWithNegativeSamplesGradientOf(const Matrix<ElemType>& gradient, const Matrix<ElemType>& value, const Matrix<ElemType>& a, const Matrix<ElemType>& b,
+                                                                  const Matrix<ElemType>& invNormA, const Matrix<ElemType>& invNormB, size_t shift, bool isRightInput);
 
 public:
     static void RCRFBackwardCompute(const Matrix<ElemType>& alpha, Matrix<ElemType>& beta,
@@ -619,6 +719,18 @@ public:
                                     const int startLbl, // the time 0 start symbol in the output layer
                                     const int shift);
 
+    // batched R-CRF over all sequences of a minibatch, one sequence per thread block on the GPU
+    //  - alpha: forward scores; beta: log posteriors of the labels (same layout as pos_scores; gaps are set to LZERO)
+    //  - objectives: [1 x #sequences] negative log likelihood of the labeled path of each sequence
+    static void RCRFForwardBackward(const Matrix<ElemType>& lbls, const Matrix<ElemType>& pos_scores, const Matrix<ElemType>& pair_scores,
+                                    const std::vector<CRFSequence>& sequences, size_t numParallelSequences,
+                                    Matrix<ElemType>& alpha, Matrix<ElemType>& beta, Matrix<ElemType>& objectives);
+    // batched Viterbi decoding; decodedPath gets a one-hot column per frame (0 in gaps)
+    // If lbls has a label in the first/last frame of a sequence, the best path is constrained to start/end with it.
+    static void RCRFViterbiDecode(const Matrix<ElemType>& lbls, const Matrix<ElemType>& pos_scores, const Matrix<ElemType>& pair_scores,
+                                  const std::vector<CRFSequence>& sequences, size_t numParallelSequences,
+                                  Matrix<ElemType>& decodedPath);
+
     template <typename T>
     friend class MatrixQuantizer;
 
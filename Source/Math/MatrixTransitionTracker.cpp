@@ -0,0 +1,150 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE.md file in the project root for full license information.
+//
+// MatrixTransitionTracker.cpp -- finds the implicit moves of matrices between devices and between dense and sparse
+//
+
+#define _CRT_SECURE_NO_WARNINGS
+
+#include "stdafx.h"
+#include "MatrixTransitionTracker.h"
+#include "Basics.h"
+#include "ExceptionWithCallStack.h"
+#include <algorithm>
+
+namespace Microsoft { namespace MSR { namespace CNTK {
+
+std::atomic<MatrixTransitionTracker::Mode> MatrixTransitionTracker::s_mode(MatrixTransitionTracker::Mode::Off);
+std::mutex MatrixTransitionTracker::s_mutex;
+std::vector<std::wstring> MatrixTransitionTracker::s_allowedScopes;
+std::map<MatrixTransitionTracker::Key, MatrixTransitionTracker::Stats> MatrixTransitionTracker::s_stats;
+
+/*static*/ const MatrixTransitionTracker::ScopeInfo*& MatrixTransitionTracker::CurrentScope()
+{
+    static THREAD_LOCAL const ScopeInfo* scope = nullptr;
+    return scope;
+}
+
+/*static*/ void MatrixTransitionTracker::SetMode(const std::wstring& mode)
+{
+    if (mode == L"off")
+        SetMode(Mode::Off);
+    else if (mode == L"report")
+        SetMode(Mode::Report);
+    else if (mode == L"strict")
+        SetMode(Mode::Strict);
+    else
+        InvalidArgument("MatrixTransitionTracker: Invalid mode '%ls', expected 'off', 'report' or 'strict'.", mode.c_str());
+}
+
+/*static*/ void MatrixTransitionTracker::SetMode(Mode mode)
+{
+    s_mode = mode;
+}
+
+/*static*/ bool MatrixTransitionTracker::IsEnabled()
+{
+    return s_mode.load(std::memory_order_relaxed) != Mode::Off;
+}
+
+/*static*/ void MatrixTransitionTracker::SetAllowedScopes(const std::vector<std::wstring>& names)
+{
+    std::lock_guard<std::mutex> lock(s_mutex);
+    s_allowedScopes = names;
+}
+
+/*static*/ bool MatrixTransitionTracker::IsAllowed(const ScopeInfo& scope)
+{
+    // the scopes that a scope is nested in, e.g. a recurrent loop, allow for it too
+    for (auto s = &scope; s; s = s->m_outer)
+    {
+        for (const auto& name : s_allowedScopes)
+        {
+            if (name == *s->m_name || name == *s->m_operation)
+                return true;
+        }
+    }
+    return false;
+}
+
+static std::string DeviceName(DEVICEID_TYPE deviceId)
+{
+    return deviceId < 0 ? "CPU" : "GPU " + std::to_string(deviceId);
+}
+
+/*static*/ void MatrixTransitionTracker::RecordDeviceTransfer(DEVICEID_TYPE from, DEVICEID_TYPE to, size_t numRows, size_t numCols)
+{
+    if (IsEnabled())
+        Record("device", DeviceName(from), DeviceName(to), numRows, numCols);
+}
+
+/*static*/ void MatrixTransitionTracker::RecordMatrixTypeSwitch(bool toSparse, size_t numRows, size_t numCols)
+{
+    if (IsEnabled())
+        Record("type", toSparse ? "dense" : "sparse", toSparse ? "sparse" : "dense", numRows, numCols);
+}
+
+/*static*/ void MatrixTransitionTracker::Record(const char* kind, std::string&& from, std::string&& to, size_t numRows, size_t numCols)
+{
+    const ScopeInfo* scope = CurrentScope();
+    std::wstring scopeName = scope ? msra::strfun::wstrprintf(L"%s %ls %ls operation", scope->m_pass, scope->m_name->c_str(), scope->m_operation->c_str()) : L"(outside of nodes)";
+
+    bool isError = false;
+    {
+        std::lock_guard<std::mutex> lock(s_mutex);
+        auto& stats = s_stats[Key(scopeName, kind, from, to)];
+        if (stats.m_count++ == 0 && scope)
+            stats.m_callStack = ExceptionWithCallStack<std::runtime_error>::GetCallStack(/*skipLevels=*/3);
+        stats.m_numElements += (double) numRows * numCols;
+        isError = scope && s_mode == Mode::Strict && !IsAllowed(*scope);
+    }
+
+    if (isError)
+        LogicError("Unexpected %s transition of a [%d x %d] matrix from %s to %s in %ls. If it is intended, allow it with 'allowedMatrixTransitions'.",
+                   kind, (int) numRows, (int) numCols, from.c_str(), to.c_str(), scopeName.c_str());
+}
+
+/*static*/ void MatrixTransitionTracker::LogSummary(FILE* f, size_t maxNumRows, size_t maxNumStacks)
+{
+    std::lock_guard<std::mutex> lock(s_mutex);
+    std::vector<std::pair<Key, Stats>> rows(s_stats.begin(), s_stats.end());
+    std::stable_sort(rows.begin(), rows.end(), [](const std::pair<Key, Stats>& a, const std::pair<Key, Stats>& b) { return a.second.m_count > b.second.m_count; });
+
+    size_t total = 0;
+    for (const auto& row : rows)
+        total += row.second.m_count;
+    fprintf(f, "\nMatrix transitions: %d, of %d kinds\n", (int) total, (int) rows.size());
+    if (rows.empty())
+        return;
+
+    fprintf(f, "%10s %12s  %-6s %-14s %s\n", "count", "MElements", "kind", "from -> to", "scope");
+    for (size_t i = 0; i < rows.size() && i < maxNumRows; i++)
+    {
+        const auto& key = rows[i].first;
+        const auto& stats = rows[i].second;
+        std::string fromTo = std::get<2>(key) + " -> " + std::get<3>(key);
+        fprintf(f, "%10d %12.3f  %-6s %-14s %ls\n", (int) stats.m_count, stats.m_numElements / 1e6, std::get<1>(key).c_str(), fromTo.c_str(), std::get<0>(key).c_str());
+    }
+    if (rows.size() > maxNumRows)
+        fprintf(f, "... and %d more\n", (int) (rows.size() - maxNumRows));
+
+    size_t numStacks = 0;
+    for (size_t i = 0; i < rows.size() && numStacks < maxNumStacks; i++)
+    {
+        if (rows[i].second.m_callStack.empty())
+            continue;
+        fprintf(f, "\nFirst %s transition %s -> %s in %ls:\n%s", std::get<1>(rows[i].first).c_str(), std::get<2>(rows[i].first).c_str(),
+                std::get<3>(rows[i].first).c_str(), std::get<0>(rows[i].first).c_str(), rows[i].second.m_callStack.c_str());
+        numStacks++;
+    }
+    fflush(f);
+}
+
+/*static*/ void MatrixTransitionTracker::Reset()
+{
+    std::lock_guard<std::mutex> lock(s_mutex);
+    s_stats.clear();
+}
+
+}}}
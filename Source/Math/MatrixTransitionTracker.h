@@ -0,0 +1,117 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE.md file in the project root for full license information.
+//
+// MatrixTransitionTracker.h -- finds the implicit moves of matrices between devices and between dense and sparse
+//
+
+#pragma once
+
+#include "CommonMatrix.h" // for MATH_API, DEVICEID_TYPE
+#include <atomic>
+#include <map>
+#include <mutex>
+#include <string>
+#include <tuple>
+#include <vector>
+
+namespace Microsoft { namespace MSR { namespace CNTK {
+
+// Records the transitions of matrices between devices (Matrix::TransferToDeviceIfNotThere(), and the moves of the operands of
+// an operation that are not on its device) and between dense and sparse (Matrix::SwitchToMatrixType()). Each one synchronizes
+// and copies, so the computation of a node should need none; the ones it does are hidden costs. A transition is attributed to
+// the innermost MatrixTransitionScope of its thread, e.g. the ForwardProp() or Backprop() of a node, and counted per scope,
+// kind, source and destination, with the call stack of the first one. In strict mode, a transition within a scope that is not
+// allowed to have any (SetAllowedScopes()) is a LogicError, which carries the call stack. Transitions outside of scopes, e.g.
+// of the minibatch data or of the model, are counted, but never errors.
+class MATH_API MatrixTransitionTracker
+{
+public:
+    enum class Mode
+    {
+        Off,
+        Report, // count and log them
+        Strict  // also fail on unexpected ones
+    };
+
+    // "off", "report" or "strict"
+    static void SetMode(const std::wstring& mode);
+    static void SetMode(Mode mode);
+    static bool IsEnabled();
+
+    // names of the nodes, or operations, whose scopes may have transitions in strict mode
+    static void SetAllowedScopes(const std::vector<std::wstring>& names);
+
+    // called by Matrix for each transition; does nothing unless enabled
+    static void RecordDeviceTransfer(DEVICEID_TYPE from, DEVICEID_TYPE to, size_t numRows, size_t numCols);
+    static void RecordMatrixTypeSwitch(bool toSparse, size_t numRows, size_t numCols);
+
+    // prints the transitions recorded since the last Reset(), most frequent first, with the call stacks of the 'maxNumStacks'
+    // most frequent ones within scopes
+    static void LogSummary(FILE* f, size_t maxNumRows = 30, size_t maxNumStacks = 5);
+    static void Reset();
+
+private:
+    friend class MatrixTransitionScope;
+
+    // what a transition happened in, see MatrixTransitionScope
+    struct ScopeInfo
+    {
+        const char* m_pass;
+        const std::wstring* m_name;
+        const std::wstring* m_operation;
+        const ScopeInfo* m_outer;
+    };
+
+    // (scope, kind, from, to)
+    typedef std::tuple<std::wstring, std::string, std::string, std::string> Key;
+    struct Stats
+    {
+        size_t m_count = 0;
+        double m_numElements = 0;
+        std::string m_callStack; // of the first one
+    };
+
+    static void Record(const char* kind, std::string&& from, std::string&& to, size_t numRows, size_t numCols);
+    static bool IsAllowed(const ScopeInfo& scope);
+
+    static std::atomic<Mode> s_mode;
+    static std::mutex s_mutex;
+    static std::vector<std::wstring> s_allowedScopes;
+    static std::map<Key, Stats> s_stats;
+    static const ScopeInfo*& CurrentScope();
+};
+
+// Attributes the transitions of matrices of the current thread to 'pass' (e.g. "ForwardProp") of 'node' (a pointer to a
+// ComputationNodeBase, which must outlive the object) for the lifetime of the object, if the MatrixTransitionTracker is enabled.
+class MatrixTransitionScope
+{
+public:
+    template <class NodePtr>
+    MatrixTransitionScope(const char* pass, const NodePtr& node)
+        : m_enabled(MatrixTransitionTracker::IsEnabled())
+    {
+        if (!m_enabled)
+            return;
+        m_operation = node->OperationName();
+        auto& current = MatrixTransitionTracker::CurrentScope();
+        m_info = MatrixTransitionTracker::ScopeInfo{ pass, &node->NodeName(), &m_operation, current };
+        current = &m_info;
+    }
+
+    ~MatrixTransitionScope()
+    {
+        if (m_enabled)
+            MatrixTransitionTracker::CurrentScope() = m_info.m_outer;
+    }
+
+private:
+    MatrixTransitionScope(const MatrixTransitionScope&) = delete;
+    MatrixTransitionScope& operator=(const MatrixTransitionScope&) = delete;
+
+    bool m_enabled;
+    std::wstring m_operation;
+    MatrixTransitionTracker::ScopeInfo m_info;
+};
+
+}}}
@@ -9,6 +9,7 @@
 #include "GPUMatrix.h"
 #include <nccl.h>
 #include <cuda_runtime.h>
+#include <algorithm>
 
 namespace Microsoft { namespace MSR { namespace CNTK {
 
@@ -20,32 +21,53 @@ static void operator||(cudaError_t rc, const char *msg)
 }
 
 NcclComm::NcclComm(int deviceId, const MPIWrapperPtr& mpi)
-    : m_ncclComm(nullptr), m_stream(nullptr)
+    : m_ncclComm(nullptr), m_stream(nullptr), m_computeEvent(nullptr),
+      m_localComm(MPI_COMM_NULL), m_crossComm(MPI_COMM_NULL), m_localRank(0), m_numHosts(1), m_hostBuffer(nullptr), m_hostBufferSize(0),
+      m_numQueuedReductions(0)
 {
-    if (mpi->IsMultiHost())
-        return;
-
-    size_t numRanks = mpi->NumNodesInUse();
     MPI_Comm mpiComm = mpi->Communicator();
-    std::vector<int> allDevs(numRanks);
-    MPI_Allgather(&deviceId, 1, MPI_INT, allDevs.data(), 1, MPI_INT, mpiComm)
+    int rank = (int) mpi->CurrentNodeRank();
+
+    // NCCL runs among the workers on the same host
+    MPI_Comm_split_type(mpiComm, MPI_COMM_TYPE_SHARED, rank, MPI_INFO_NULL, &m_localComm)
+        || MpiFail("NcclComm: MPI_Comm_split_type");
+    int numLocalRanks;
+    MPI_Comm_size(m_localComm, &numLocalRanks) || MpiFail("NcclComm: MPI_Comm_size");
+    MPI_Comm_rank(m_localComm, &m_localRank) || MpiFail("NcclComm: MPI_Comm_rank");
+
+    std::vector<int> localDevs(numLocalRanks);
+    MPI_Allgather(&deviceId, 1, MPI_INT, localDevs.data(), 1, MPI_INT, m_localComm)
         || MpiFail("NcclComm: MPI_Allgather");
 
-    for (size_t r = 0; r<numRanks; r++)
+    const char* disabledReason = nullptr;
+    for (int r = 0; r<numLocalRanks; r++)
     {
-        if (allDevs[r] == CPUDEVICE)
-        {
-            fprintf(stderr, "NcclComm: disabled, at least one rank using CPU device\n");
-            return;
-        }
-        for (size_t s = 0; s<r; s++)
-            if (allDevs[r] == allDevs[s])
-            {
-                fprintf(stderr, "NcclComm: disabled, same device used by more than one rank\n");
-                return;
-            }
+        if (localDevs[r] == CPUDEVICE)
+            disabledReason = "at least one rank using CPU device";
+        for (int s = 0; s<r; s++)
+            if (localDevs[r] == localDevs[s])
+                disabledReason = "same device used by more than one rank";
+    }
+
+    // all workers must take the same aggregation path
+    int disabled = disabledReason != nullptr;
+    MPI_Allreduce(MPI_IN_PLACE, &disabled, 1, MPI_INT, MPI_MAX, mpiComm)
+        || MpiFail("NcclComm: MPI_Allreduce");
+    if (disabled)
+    {
+        fprintf(stderr, "NcclComm: disabled, %s\n", disabledReason ? disabledReason : "not usable on another host");
+        MPI_Comm_free(&m_localComm);
+        m_localComm = MPI_COMM_NULL;
+        return;
     }
 
+    // the first worker of each host reduces across the hosts
+    MPI_Comm_split(mpiComm, m_localRank == 0 ? 0 : MPI_UNDEFINED, rank, &m_crossComm)
+        || MpiFail("NcclComm: MPI_Comm_split");
+    m_numHosts = m_localRank == 0 ? 1 : 0;
+    MPI_Allreduce(MPI_IN_PLACE, &m_numHosts, 1, MPI_INT, MPI_SUM, mpiComm)
+        || MpiFail("NcclComm: MPI_Allreduce");
+
     ncclUniqueId ncclId;
     ncclResult_t res;
 
@@ -53,25 +75,40 @@ NcclComm::NcclComm(int deviceId, const MPIWrapperPtr& mpi)
     if (res != ncclSuccess)
         RuntimeError("NcclComm failed to obtain ncclUniqueId: %s", ncclGetErrorString(res));
 
-    MPI_Bcast(&ncclId, NCCL_UNIQUE_ID_BYTES, MPI_CHAR, 0, mpiComm)
+    MPI_Bcast(&ncclId, NCCL_UNIQUE_ID_BYTES, MPI_CHAR, 0, m_localComm)
         || MpiFail("NcclComm: MPI_Bcase");
 
     PrepareDevice(deviceId);
-    res = ncclCommInitRank(&m_ncclComm, numRanks, ncclId, mpi->CurrentNodeRank());
+    res = ncclCommInitRank(&m_ncclComm, numLocalRanks, ncclId, m_localRank);
     if (res != ncclSuccess)
       RuntimeError("NcclComm failed to initialize ncclComm_t: %s", ncclGetErrorString(res));
 
     cudaStreamCreateWithFlags(&m_stream, cudaStreamNonBlocking)
         || "cudaStreamCreateWithFlags failed";
-    fprintf(stderr, "NcclComm: initialized\n");
+    cudaEventCreateWithFlags(&m_computeEvent, cudaEventDisableTiming)
+        || "cudaEventCreateWithFlags failed";
+    if (m_numHosts > 1)
+        fprintf(stderr, "NcclComm: initialized, %d ranks on this host, reducing across %d hosts with MPI\n", numLocalRanks, m_numHosts);
+    else
+        fprintf(stderr, "NcclComm: initialized\n");
 }
 
 NcclComm::~NcclComm()
 {
+    if (m_hostBuffer != nullptr)
+        cudaFreeHost(m_hostBuffer);
+    for (auto event : m_reductionEvents)
+        cudaEventDestroy(event);
+    if (m_computeEvent != nullptr)
+        cudaEventDestroy(m_computeEvent);
     if (m_stream != nullptr)
         cudaStreamDestroy(m_stream);
     if (m_ncclComm != nullptr)
         ncclCommDestroy(m_ncclComm);
+    if (m_crossComm != MPI_COMM_NULL)
+        MPI_Comm_free(&m_crossComm);
+    if (m_localComm != MPI_COMM_NULL)
+        MPI_Comm_free(&m_localComm);
 }
 
 bool NcclComm::IsSupported()
@@ -79,26 +116,238 @@ bool NcclComm::IsSupported()
     return m_ncclComm != nullptr;
 }
 
+// The gradients may be handed over while the backprop that computes the later ones is still queued,
+// so the reduction stream must wait for the compute stream explicitly (it does not synchronize with it).
+void NcclComm::WaitForComputeStream()
+{
+    cudaEventRecord(m_computeEvent, GetStream()) || "NcclComm: cudaEventRecord failed";
+    cudaStreamWaitEvent(m_stream, m_computeEvent, 0) || "NcclComm: cudaStreamWaitEvent failed";
+}
+
 void NcclComm::AllReduceImpl(void* buffer, size_t count, DataType dtype)
 {
+    assert(dtype == DataType::FLOAT || dtype == DataType::DOUBLE);
+    ncclDataType_t ncclType = dtype == DataType::FLOAT ? ncclFloat : ncclDouble;
+
     ncclResult_t res;
-    if (dtype == DataType::FLOAT)
+    if (m_numHosts == 1)
+        res = ncclAllReduce(buffer, buffer, count, ncclType, ncclSum, m_ncclComm, m_stream);
+    else
     {
-        res = ncclAllReduce(buffer, buffer, count, ncclFloat, ncclSum, m_ncclComm, m_stream);
+        // the rest is done by Sync()
+        res = ncclReduce(buffer, buffer, count, ncclType, ncclSum, /*root=*/0, m_ncclComm, m_stream);
+        m_pendingReductions.push_back(PendingReduction{ buffer, count, dtype });
     }
-    else
+    if (res != ncclSuccess)
+        RuntimeError("NcclComm ncclAllReduce failed: %s", ncclGetErrorString(res));
+
+    if (m_numHosts == 1)
+    {
+        if (m_reductionEvents.size() <= m_numQueuedReductions)
+        {
+            cudaEvent_t event;
+            cudaEventCreateWithFlags(&event, cudaEventDisableTiming) || "NcclComm: cudaEventCreateWithFlags failed";
+            m_reductionEvents.push_back(event);
+        }
+        cudaEventRecord(m_reductionEvents[m_numQueuedReductions], m_stream) || "NcclComm: cudaEventRecord failed";
+    }
+    m_numQueuedReductions++;
+}
+
+bool NcclComm::MakeComputeStreamWaitForReduction(size_t reduction)
+{
+    if (m_numHosts > 1)
+        return false;
+
+    assert(reduction < m_numQueuedReductions);
+    cudaStreamWaitEvent(GetStream(), m_reductionEvents[reduction], 0) || "NcclComm: cudaStreamWaitEvent failed";
+    return true;
+}
+
+// reduces the pending buffers across the hosts on the first worker of each host, and broadcasts them within the host
+void NcclComm::ReduceAcrossHosts()
+{
+    if (m_localRank == 0)
+    {
+        cudaStreamSynchronize(m_stream) || "NcclComm: cudaStreamSynchronize failed";
+        for (auto dtype : { DataType::FLOAT, DataType::DOUBLE })
+        {
+            size_t elementSize = dtype == DataType::FLOAT ? sizeof(float) : sizeof(double);
+            size_t totalCount = 0;
+            for (const auto& pending : m_pendingReductions)
+                totalCount += pending.m_dtype == dtype ? pending.m_count : 0;
+            if (totalCount == 0)
+                continue;
+
+            if (m_hostBufferSize < totalCount * elementSize)
+            {
+                if (m_hostBuffer != nullptr)
+                    cudaFreeHost(m_hostBuffer) || "NcclComm: cudaFreeHost failed";
+                m_hostBufferSize = totalCount * elementSize;
+                cudaMallocHost(&m_hostBuffer, m_hostBufferSize) || "NcclComm: cudaMallocHost failed";
+            }
+
+            // copy all buffers of this type next to each other, so that they are reduced with one call
+            char* hostBuffer = (char*) m_hostBuffer;
+            for (const auto& pending : m_pendingReductions)
+            {
+                if (pending.m_dtype != dtype)
+                    continue;
+                cudaMemcpyAsync(hostBuffer, pending.m_buffer, pending.m_count * elementSize, cudaMemcpyDeviceToHost, m_stream) || "NcclComm: cudaMemcpyAsync failed";
+                hostBuffer += pending.m_count * elementSize;
+            }
+            cudaStreamSynchronize(m_stream) || "NcclComm: cudaStreamSynchronize failed";
+
+            MPI_Allreduce(MPI_IN_PLACE, m_hostBuffer, (int) totalCount, dtype == DataType::FLOAT ? MPI_FLOAT : MPI_DOUBLE, MPI_SUM, m_crossComm)
+                || MpiFail("NcclComm: MPI_Allreduce");
+
+            hostBuffer = (char*) m_hostBuffer;
+            for (const auto& pending : m_pendingReductions)
+            {
+                if (pending.m_dtype != dtype)
+                    continue;
+                cudaMemcpyAsync(pending.m_buffer, hostBuffer, pending.m_count * elementSize, cudaMemcpyHostToDevice, m_stream) || "NcclComm: cudaMemcpyAsync failed";
+                hostBuffer += pending.m_count * elementSize;
+            }
+            // the host buffer is reused for the next type
+            cudaStreamSynchronize(m_stream) || "NcclComm: cudaStreamSynchronize failed";
+        }
+    }
+
+    for (const auto& pending : m_pendingReductions)
     {
-        assert(dtype == DataType::DOUBLE);
-        res = ncclAllReduce(buffer, buffer, count, ncclDouble, ncclSum, m_ncclComm, m_stream);
+        ncclResult_t res = ncclBcast(pending.m_buffer, pending.m_count, pending.m_dtype == DataType::FLOAT ? ncclFloat : ncclDouble, /*root=*/0, m_ncclComm, m_stream);
+        if (res != ncclSuccess)
+            RuntimeError("NcclComm ncclBcast failed: %s", ncclGetErrorString(res));
     }
+    m_pendingReductions.clear();
+}
 
+void NcclComm::BroadcastImpl(void* buffer, size_t count, DataType dtype)
+{
+    assert(dtype == DataType::FLOAT || dtype == DataType::DOUBLE);
+    ncclDataType_t ncclType = dtype == DataType::FLOAT ? ncclFloat : ncclDouble;
+
+    // the main node is the first worker of its host, and the first one of m_crossComm
+    if (m_numHosts > 1 && m_localRank == 0)
+    {
+        size_t numBytes = count * (dtype == DataType::FLOAT ? sizeof(float) : sizeof(double));
+        if (m_hostBufferSize < numBytes)
+        {
+            if (m_hostBuffer != nullptr)
+                cudaFreeHost(m_hostBuffer) || "NcclComm: cudaFreeHost failed";
+            m_hostBufferSize = numBytes;
+            cudaMallocHost(&m_hostBuffer, m_hostBufferSize) || "NcclComm: cudaMallocHost failed";
+        }
+
+        int crossRank;
+        MPI_Comm_rank(m_crossComm, &crossRank) || MpiFail("NcclComm: MPI_Comm_rank");
+        if (crossRank == 0)
+            cudaMemcpyAsync(m_hostBuffer, buffer, numBytes, cudaMemcpyDeviceToHost, m_stream) || "NcclComm: cudaMemcpyAsync failed";
+        // (on the others, the copy from the host buffer of the previous broadcast must be complete)
+        cudaStreamSynchronize(m_stream) || "NcclComm: cudaStreamSynchronize failed";
+        MPI_Bcast(m_hostBuffer, (int) count, dtype == DataType::FLOAT ? MPI_FLOAT : MPI_DOUBLE, 0, m_crossComm)
+            || MpiFail("NcclComm: MPI_Bcast");
+        if (crossRank != 0)
+            cudaMemcpyAsync(buffer, m_hostBuffer, numBytes, cudaMemcpyHostToDevice, m_stream) || "NcclComm: cudaMemcpyAsync failed";
+    }
+
+    ncclResult_t res = ncclBcast(buffer, count, ncclType, /*root=*/0, m_ncclComm, m_stream);
     if (res != ncclSuccess)
-        RuntimeError("NcclComm ncclAllReduce failed: %s", ncclGetErrorString(res));
+        RuntimeError("NcclComm ncclBcast failed: %s", ncclGetErrorString(res));
 }
 
 void NcclComm::Sync()
 {
+    if (!m_pendingReductions.empty())
+        ReduceAcrossHosts();
     cudaStreamSynchronize(m_stream) || "NcclComm: cudaStreamSynchronize failed";
+    m_numQueuedReductions = 0;
+}
+
+LocalNcclComm::LocalNcclComm(const std::vector<int>& deviceIds)
+    : m_deviceIds(deviceIds)
+{
+    for (size_t i = 0; i < deviceIds.size(); i++)
+    {
+        const char* disabledReason = nullptr;
+        if (deviceIds[i] == CPUDEVICE)
+            disabledReason = "at least one replica on the CPU device";
+        else if (std::find(deviceIds.begin(), deviceIds.begin() + i, deviceIds[i]) != deviceIds.begin() + i)
+            disabledReason = "same device used by more than one replica";
+        if (disabledReason)
+        {
+            fprintf(stderr, "LocalNcclComm: disabled, %s\n", disabledReason);
+            return;
+        }
+    }
+
+    std::vector<ncclComm_t> ncclComms(deviceIds.size());
+    ncclResult_t res = ncclCommInitAll(ncclComms.data(), (int) deviceIds.size(), deviceIds.data());
+    if (res != ncclSuccess)
+        RuntimeError("LocalNcclComm failed to initialize ncclComm_t: %s", ncclGetErrorString(res));
+    m_ncclComms = std::move(ncclComms);
+
+    for (auto deviceId : deviceIds)
+    {
+        PrepareDevice(deviceId);
+        cudaStream_t stream;
+        cudaStreamCreateWithFlags(&stream, cudaStreamNonBlocking) || "cudaStreamCreateWithFlags failed";
+        m_streams.push_back(stream);
+        cudaEvent_t event;
+        cudaEventCreateWithFlags(&event, cudaEventDisableTiming) || "cudaEventCreateWithFlags failed";
+        m_computeEvents.push_back(event);
+    }
+    fprintf(stderr, "LocalNcclComm: initialized for %d devices\n", (int) deviceIds.size());
+}
+
+LocalNcclComm::~LocalNcclComm()
+{
+    for (auto event : m_computeEvents)
+        cudaEventDestroy(event);
+    for (auto stream : m_streams)
+        cudaStreamDestroy(stream);
+    for (auto ncclComm : m_ncclComms)
+        ncclCommDestroy(ncclComm);
+}
+
+bool LocalNcclComm::IsSupported()
+{
+    return !m_ncclComms.empty();
+}
+
+void LocalNcclComm::CollectiveImpl(const std::vector<void*>& buffers, size_t count, DataType dtype, bool isBroadcast)
+{
+    assert(dtype == DataType::FLOAT || dtype == DataType::DOUBLE);
+    ncclDataType_t ncclType = dtype == DataType::FLOAT ? ncclFloat : ncclDouble;
+
+    // one thread drives all devices, so the calls for the devices must not block each other
+#if NCCL_MAJOR >= 2
+    ncclGroupStart();
+#endif
+    for (size_t i = 0; i < m_deviceIds.size(); i++)
+    {
+        PrepareDevice(m_deviceIds[i]);
+        // as in NcclComm, the buffers may be handed over while the work that computes them is still queued
+        cudaEventRecord(m_computeEvents[i], GetStream()) || "LocalNcclComm: cudaEventRecord failed";
+        cudaStreamWaitEvent(m_streams[i], m_computeEvents[i], 0) || "LocalNcclComm: cudaStreamWaitEvent failed";
+        ncclResult_t res = isBroadcast ? ncclBcast(buffers[i], count, ncclType, /*root=*/0, m_ncclComms[i], m_streams[i])
+                                       : ncclReduce(buffers[i], buffers[i], count, ncclType, ncclSum, /*root=*/0, m_ncclComms[i], m_streams[i]);
+        if (res != ncclSuccess)
+            RuntimeError("LocalNcclComm %s failed: %s", isBroadcast ? "ncclBcast" : "ncclReduce", ncclGetErrorString(res));
+    }
+#if NCCL_MAJOR >= 2
+    ncclGroupEnd();
+#endif
+}
+
+void LocalNcclComm::Sync()
+{
+    for (size_t i = 0; i < m_streams.size(); i++)
+    {
+        PrepareDevice(m_deviceIds[i]);
+        cudaStreamSynchronize(m_streams[i]) || "LocalNcclComm: cudaStreamSynchronize failed";
+    }
 }
 
 }}} // end namespaces
@@ -117,5 +366,21 @@ bool NcclComm::IsSupported()
 
 void NcclComm::Sync() { }
 
+bool NcclComm::MakeComputeStreamWaitForReduction(size_t /*reduction*/)
+{
+    return false;
+}
+
+LocalNcclComm::LocalNcclComm(const std::vector<int>& /*deviceIds*/) { }
+
+LocalNcclComm::~LocalNcclComm() { }
+
+bool LocalNcclComm::IsSupported()
+{
+    return false;
+}
+
+void LocalNcclComm::Sync() { }
+
 }}} // end namespaces
 #endif
@@ -3,6 +3,11 @@
 // Licensed under the MIT license. See LICENSE.md file in the project root for full license information.
 //
 // Encapsulates NCCLs dependencies
+//
+// Reduces GPU buffers across all workers. With workers on more than one host the reduction is hierarchical:
+// NCCL reduces onto the first worker of each host, these reduce across the hosts with MPI (through a page-locked
+// buffer), and NCCL broadcasts the result back within each host. The intra-host reductions are queued by AllReduce(),
+// the rest is done by Sync().
 #pragma once
 
 #include "Matrix.h"
@@ -13,6 +18,7 @@
 
 // Forward declare CUDA stuff
 typedef struct CUstream_st* cudaStream_t;
+typedef struct CUevent_st* cudaEvent_t;
 typedef struct ncclComm* ncclComm_t;
 
 namespace Microsoft { namespace MSR { namespace CNTK {
@@ -23,8 +29,31 @@ class NcclComm
 private:
     enum class DataType : int {FLOAT, DOUBLE};
     void AllReduceImpl(void* buffer, size_t count, DataType dtype);
+    void BroadcastImpl(void* buffer, size_t count, DataType dtype);
+    void WaitForComputeStream(); // makes the reductions wait for the work queued on the compute stream so far
+    void ReduceAcrossHosts();
     cudaStream_t m_stream;
+    cudaEvent_t m_computeEvent;
     ncclComm_t m_ncclComm;
+
+    // hierarchical reduction
+    MPI_Comm m_localComm; // the workers on this host
+    MPI_Comm m_crossComm; // the first worker of each host (MPI_COMM_NULL on the others)
+    int m_localRank;
+    int m_numHosts;
+    struct PendingReduction
+    {
+        void* m_buffer;
+        size_t m_count;
+        DataType m_dtype;
+    };
+    std::vector<PendingReduction> m_pendingReductions; // reduced onto the first worker of the host, not across hosts yet
+
+    // [i] recorded on m_stream after the i-th reduction queued since the last Sync() (on a single host)
+    std::vector<cudaEvent_t> m_reductionEvents;
+    size_t m_numQueuedReductions;
+    void* m_hostBuffer;
+    size_t m_hostBufferSize;
 #endif
 
 public:
@@ -33,22 +62,118 @@ public:
     bool IsSupported();
     void Sync(); // waits for outstanding reductions to complete
 
+    // Makes the compute stream wait for the i-th reduction queued since the last Sync(), so that work on its result
+    // can be queued while the later ones are still running. Returns false if the reductions across hosts are only done by Sync().
+    bool MakeComputeStreamWaitForReduction(size_t reduction);
+
     template <typename ElemType>
     void AllReduce(const std::vector<Matrix<ElemType>*>& grads)
     {
 #ifdef USE_NCCL
-        DataType dtype = DataType::FLOAT;
+        WaitForComputeStream();
+        for (size_t i=0; i<grads.size(); ++i)
+        {
+            AllReduceImpl(grads[i]->Data(), grads[i]->GetNumElements(), GetDataType<ElemType>());
+        }
+#else
+        RuntimeError("NcclComm: CNTK was built without NCCL support.");
+#endif
+    }
+
+    // version for raw GPU buffers
+    template <typename ElemType>
+    void AllReduce(ElemType* buffer, size_t count)
+    {
+#ifdef USE_NCCL
+        WaitForComputeStream();
+        AllReduceImpl(buffer, count, GetDataType<ElemType>());
+#else
+        buffer; count;
+        RuntimeError("NcclComm: CNTK was built without NCCL support.");
+#endif
+    }
+
+    // Copies the buffer of the main node (rank 0) into the ones of the other workers, done by the next Sync(). With more
+    // than one host, the first worker of each host receives it with MPI (through the page-locked buffer) right away,
+    // and NCCL broadcasts it within the host.
+    template <typename ElemType>
+    void Broadcast(ElemType* buffer, size_t count)
+    {
+#ifdef USE_NCCL
+        WaitForComputeStream();
+        BroadcastImpl(buffer, count, GetDataType<ElemType>());
+#else
+        buffer; count;
+        RuntimeError("NcclComm: CNTK was built without NCCL support.");
+#endif
+    }
+
+#ifdef USE_NCCL
+private:
+    template <typename ElemType>
+    static DataType GetDataType()
+    {
         if (std::is_same<ElemType, double>::value)
-            dtype = DataType::DOUBLE;
+            return DataType::DOUBLE;
         else if (!std::is_same<ElemType, float>::value)
             RuntimeError("NcclComm Unsupported reduction type");
+        return DataType::FLOAT;
+    }
+#endif
+};
 
-        for (size_t i=0; i<grads.size(); ++i)
+// Reduces GPU buffers across the devices of this process, e.g. the gradients of the replicas of a model that are
+// trained on the GPUs of one host without MPI. There is one buffer per device (in the order of the devices passed
+// to the constructor) for each reduction; they are summed into the first one, which Broadcast() copies back into
+// the others. Reduce() and Broadcast() only queue the work; Sync() waits for it.
+class LocalNcclComm
+{
+#ifdef USE_NCCL
+private:
+    enum class DataType : int {FLOAT, DOUBLE};
+    void CollectiveImpl(const std::vector<void*>& buffers, size_t count, DataType dtype, bool isBroadcast);
+    std::vector<int> m_deviceIds;
+    std::vector<cudaStream_t> m_streams;        // [i] for m_deviceIds[i]
+    std::vector<cudaEvent_t> m_computeEvents;
+    std::vector<ncclComm_t> m_ncclComms;
+#endif
+
+public:
+    LocalNcclComm(const std::vector<int>& deviceIds);
+    ~LocalNcclComm();
+    bool IsSupported();
+    void Sync(); // waits for outstanding reductions and broadcasts to complete
+
+    template <typename ElemType>
+    void Reduce(const std::vector<Matrix<ElemType>*>& buffers)
+    {
+        Collective(buffers, /*isBroadcast=*/false);
+    }
+
+    template <typename ElemType>
+    void Broadcast(const std::vector<Matrix<ElemType>*>& buffers)
+    {
+        Collective(buffers, /*isBroadcast=*/true);
+    }
+
+private:
+    template <typename ElemType>
+    void Collective(const std::vector<Matrix<ElemType>*>& buffers, bool isBroadcast)
+    {
+#ifdef USE_NCCL
+        if (buffers.size() != m_deviceIds.size())
+            LogicError("LocalNcclComm: Expected %d buffers, one per device, got %d.", (int) m_deviceIds.size(), (int) buffers.size());
+        std::vector<void*> data(buffers.size());
+        for (size_t i = 0; i < buffers.size(); i++)
         {
-            AllReduceImpl(grads[i]->Data(), grads[i]->GetNumElements(), dtype);
+            if (buffers[i]->GetNumElements() != buffers[0]->GetNumElements() || buffers[i]->GetDeviceId() != m_deviceIds[i])
+                LogicError("LocalNcclComm: The buffers must have the same size and be on the devices of the communicator.");
+            data[i] = buffers[i]->Data();
         }
+        CollectiveImpl(data, buffers[0]->GetNumElements(), std::is_same<ElemType, double>::value ? DataType::DOUBLE : DataType::FLOAT, isBroadcast);
 #else
-        RuntimeError("NcclComm: CNTK was built without NCCL support.");
+        buffers; isBroadcast;
+        RuntimeError("LocalNcclComm: CNTK was built without NCCL support.");
 #endif
     }
 };
@@ -15,16 +15,102 @@
 #include "CuDnnFactories.h"
 #include "TensorShape.h"
 #include "GPUDataTransferer.h"
+#include "TimelineTracer.h"
+#include "GradientSparsifier.h"
+#include "GPUGraph.h"
 
 #pragma warning(disable : 4100) // unreferenced formal parameter, which is OK since all functions in here are dummies; disabling this allows to copy-paste prototypes here when we add new functions
 #pragma warning(disable : 4702) // unreachable code, which we get from the NOT_IMPLEMENTED macro which is OK
 
+void MATH_API SetStream(cudaStream_t stream)
+{
+}
+
+cudaStream_t MATH_API GetStream()
+{
+    return nullptr;
+}
+
 namespace Microsoft { namespace MSR { namespace CNTK {
 
 // the reset below are dummy implementations
 
 void PrepareDevice(DEVICEID_TYPE deviceId);
 
+void TracingGPUMemoryAllocator::EmptyCache(int deviceId)
+{
+}
+
+CachingBlockAllocator::Statistics TracingGPUMemoryAllocator::GetCachingStatistics(int deviceId)
+{
+    return CachingBlockAllocator::Statistics();
+}
+
+std::pair<size_t, size_t> TracingGPUMemoryAllocator::GetFreeAndTotalMemoryInMBs(int deviceId)
+{
+    return {0, 0};
+}
+
+void* TimelineTracer::RecordGPUEvent(DEVICEID_TYPE deviceId)
+{
+    return nullptr;
+}
+
+float TimelineTracer::GPUEventElapsedMilliseconds(void* from, void* to)
+{
+    return 0;
+}
+
+void TimelineTracer::DestroyGPUEvent(void* event)
+{
+}
+
+struct GPUGraph::Impl
+{
+};
+
+GPUGraph::GPUGraph(DEVICEID_TYPE deviceId)
+{
+}
+
+GPUGraph::~GPUGraph()
+{
+}
+
+/*static*/ bool GPUGraph::IsSupported(DEVICEID_TYPE deviceId)
+{
+    return false;
+}
+
+void GPUGraph::BeginCapture()
+{
+    LogicError("GPUGraph: Not supported by the CPU-only build.");
+}
+
+bool GPUGraph::EndCapture()
+{
+    return false;
+}
+
+bool GPUGraph::IsCaptured() const
+{
+    return false;
+}
+
+void GPUGraph::Launch()
+{
+    LogicError("GPUGraph: Not supported by the CPU-only build.");
+}
+
+template <class ElemType>
+size_t GradientSparsifier<ElemType>::SparsifyGPU(DEVICEID_TYPE deviceId, ElemType* data, size_t numElements, size_t k, size_t capacity, unsigned int* indices, ElemType* values)
+{
+    return 0;
+}
+
+template size_t GradientSparsifier<float>::SparsifyGPU(DEVICEID_TYPE, float*, size_t, size_t, size_t, unsigned int*, float*);
+template size_t GradientSparsifier<double>::SparsifyGPU(DEVICEID_TYPE, double*, size_t, size_t, size_t, unsigned int*, double*);
+
 template <class ElemType>
 GPUSPARSE_INDEX_TYPE GPUSparseMatrix<ElemType>::SecondaryIndexValueAt(size_t idx) const
 {
@@ -67,6 +153,11 @@ DEVICEID_TYPE GPUSparseMatrix<ElemType>::PrepareDevice(DEVICEID_TYPE deviceId /*
     return deviceId;
 }
 
+template <class ElemType>
+void GPUSparseMatrix<ElemType>::InitializeDevice(DEVICEID_TYPE deviceId)
+{
+}
+
 template <class ElemType>
 void GPUSparseMatrix<ElemType>::DeepCopy(const GPUSparseMatrix<ElemType>& deepCopy)
 {
@@ -255,8 +346,32 @@ ElemType GPUSparseMatrix<ElemType>::Adagrad(GPUMatrix<ElemType>& c, const bool n
 {
     return 1;
 }
-//template<class ElemType>
-//void GPUSparseMatrix<ElemType>::FSAdagrad(CPUMatrix<ElemType>& gradients, CPUMatrix<ElemType>&, ElemType, ElemType, ElemType, ElemType) { }
+template <class ElemType>
+void GPUSparseMatrix<ElemType>::FSAdagrad(GPUMatrix<ElemType>& c, GPUMatrix<ElemType>& functionValues, ElemType learnRatePerSample, ElemType momentum, ElemType adaWeight, ElemType adaMul) const
+{
+}
+
+template <class ElemType>
+void GPUSparseMatrix<ElemType>::Adam(GPUMatrix<ElemType>& c, GPUMatrix<ElemType>& functionValues, ElemType learnRatePerSample, ElemType meanMomentum, ElemType varMomentum,
+                                     ElemType meanCorrection, ElemType varCorrection, ElemType epsilon, ElemType weightDecay, bool updateFunctionValues)
+{
+}
+
+template <class ElemType>
+void GPUSparseMatrix<ElemType>::CatchUpLazyMomentum(GPUMatrix<ElemType>& c, GPUMatrix<ElemType>& functionValues, GPUMatrix<ElemType>& lastUpdates, ElemType timestamp,
+                                                    ElemType learnRateScale, ElemType momentum, bool hasVarianceAccumulator, ElemType varMomentum) const
+{
+}
+
+template <class ElemType>
+void GPUSparseMatrix<ElemType>::GetBlockColumnIds(std::vector<size_t>& columnIds) const
+{
+}
+
+template <class ElemType>
+void GPUSparseMatrix<ElemType>::ExpandBlockColumns(const std::vector<size_t>& columnIds)
+{
+}
 
 template <class ElemType>
 void GPUSparseMatrix<ElemType>::MultiplyAndWeightedAdd(ElemType alpha, const GPUSparseMatrix<ElemType>& a, const bool transposeA,
@@ -770,6 +885,9 @@ DeviceBoundNumber<ElemType>::~DeviceBoundNumber()
 template <class ElemType>
 void GPUMatrix<ElemType>::SetDevice(DEVICEID_TYPE deviceId){};
 
+template <class ElemType>
+void GPUMatrix<ElemType>::InitializeDevice(DEVICEID_TYPE deviceId){};
+
 // PrepareDevice - Setup the correct cuda context for an operation
 // deviceId - the device on which the operation will take place
 //            defaults to -1, which means use matrices current device
@@ -971,6 +1089,18 @@ GPUMatrix<ElemType>& GPUMatrix<ElemType>::DoScatterColumnsOf(ElemType beta, cons
     return *this;
 }
 
+template <class ElemType>
+GPUMatrix<ElemType>& GPUMatrix<ElemType>::AssignNonZeroCountsOfSequences(const GPUMatrix<ElemType>& condition, size_t conditionStride, const GPUMatrix<ElemType>& sequences)
+{
+    return *this;
+}
+
+template <class ElemType>
+GPUMatrix<ElemType>& GPUMatrix<ElemType>::DoScatterNonZeroStepsOfSequences(const GPUMatrix<ElemType>& condition, size_t conditionStride, const GPUMatrix<ElemType>& sequences, const GPUMatrix<ElemType>& outputFirstColumns, size_t outputStride)
+{
+    return *this;
+}
+
 template <class ElemType>
 void GPUMatrix<ElemType>::SetValue(const ElemType v)
 {
@@ -995,6 +1125,12 @@ void GPUMatrix<ElemType>::MaskColumnsValue(const GPUMatrix<char>& columnsMask, E
 {
 }
 
+template <class ElemType>
+void GPUMatrix<ElemType>::AssignAugmentedImages(const GPUMatrix<char>& images, GPUMatrix<ElemType>& params, const GPUMatrix<ElemType>& mean,
+                                                size_t width, size_t height, size_t channels, bool toCHW)
+{
+}
+
 template <class ElemType>
 void GPUMatrix<ElemType>::CopyColumnsStrided(const GPUMatrix<ElemType>& fromMatrix, size_t numCols, size_t srcNumColsStride, size_t destNumColsStride)
 {
@@ -1052,6 +1188,12 @@ void GPUMatrix<ElemType>::SetUniformRandomMask(const ElemType maskRate, const El
 {
 }
 
+template <class ElemType>
+GPUMatrix<ElemType>& GPUMatrix<ElemType>::DoElementProductOfCounterBasedMask(ElemType beta, const GPUMatrix<ElemType>& a, const ElemType maskRate, const ElemType scaleValue, uint64_t seed, uint64_t offset)
+{
+    return *this;
+}
+
 template <class ElemType>
 ElemType GPUMatrix<ElemType>::Adagrad(GPUMatrix<ElemType>& gradients, const bool needAveMultiplier)
 {
@@ -1062,12 +1204,49 @@ void GPUMatrix<ElemType>::FSAdagrad(GPUMatrix<ElemType>& gradients, GPUMatrix<El
 {
 }
 
+template <class ElemType>
+void GPUMatrix<ElemType>::Adam(GPUMatrix<ElemType>& gradients, GPUMatrix<ElemType>& functionValues, ElemType learnRatePerSample, ElemType meanMomentum, ElemType varMomentum,
+                               ElemType meanCorrection, ElemType varCorrection, ElemType epsilon, ElemType weightDecay, bool updateFunctionValues)
+{
+}
+
 template <class ElemType>
 ElemType GPUMatrix<ElemType>::RmsProp(GPUMatrix<ElemType>& gradients, ElemType RMS_GAMMA, ElemType RMS_WGT_INC, ElemType RMS_WGT_MAX, ElemType RMS_WGT_DEC, ElemType RMS_WGT_MIN, const bool needAveMultiplier)
 {
     return 0;
 }
 
+template <class ElemType>
+void GPUMatrix<ElemType>::MultiNormalGrad(const std::vector<GPUMatrix<ElemType>*>& smoothedGradients, const std::vector<GPUMatrix<ElemType>*>& gradients, const std::vector<GPUMatrix<ElemType>*>& functionValues,
+                                          ElemType learnRatePerSample, ElemType momentum, bool useNAG, const UpdateRegularization<ElemType>& regularization)
+{
+}
+
+template <class ElemType>
+void GPUMatrix<ElemType>::MultiAdagrad(const std::vector<GPUMatrix<ElemType>*>& smoothedGradients, const std::vector<GPUMatrix<ElemType>*>& gradients, const std::vector<GPUMatrix<ElemType>*>& functionValues,
+                                       ElemType learnRatePerSample, const UpdateRegularization<ElemType>& regularization)
+{
+}
+
+template <class ElemType>
+void GPUMatrix<ElemType>::MultiFSAdagrad(const std::vector<GPUMatrix<ElemType>*>& smoothedGradients, const std::vector<GPUMatrix<ElemType>*>& gradients, const std::vector<GPUMatrix<ElemType>*>& functionValues,
+                                         const std::vector<ElemType>& adaMuls, ElemType learnRatePerSample, ElemType momentum, ElemType adaWeight,
+                                         const UpdateRegularization<ElemType>& regularization)
+{
+}
+
+template <class ElemType>
+void GPUMatrix<ElemType>::MultiRmsProp(const std::vector<GPUMatrix<ElemType>*>& smoothedGradients, const std::vector<GPUMatrix<ElemType>*>& gradients, const std::vector<GPUMatrix<ElemType>*>& functionValues,
+                                       ElemType learnRatePerSample, ElemType RMS_GAMMA, ElemType RMS_WGT_INC, ElemType RMS_WGT_MAX, ElemType RMS_WGT_DEC, ElemType RMS_WGT_MIN,
+                                       const UpdateRegularization<ElemType>& regularization)
+{
+}
+
+template <class ElemType>
+void GPUMatrix<ElemType>::MultiClipByNorm(const std::vector<GPUMatrix<ElemType>*>& gradients, ElemType maxNorm, bool globalNorm, GPUMatrix<ElemType>& factors)
+{
+}
+
 template <class ElemType>
 void GPUMatrix<ElemType>::Reshape(const size_t numRows, const size_t numCols)
 {
@@ -1540,6 +1719,19 @@ void GPUMatrix<ElemType>::InnerProductWithShiftNeg(const GPUMatrix<ElemType>& a,
 {
 }
 
+template <class ElemType>
+GPUMatrix<ElemType>& GPUMatrix<ElemType>::AssignCosDistanceWithNegativeSamplesOf(const GPUMatrix<ElemType>& a, const GPUMatrix<ElemType>& b, const size_t shift, const size_t negnumber, GPUMatrix<ElemType>& invNormA, GPUMatrix<ElemType>& invNormB)
+{
+    return *this;
+}
+
+template <class ElemType>
+GPUMatrix<ElemType>& GPUMatrix<ElemType>::AddCosDistanceWithNegativeSamplesGradientOf(const GPUMatrix<ElemType>& gradient, const GPUMatrix<ElemType>& value, const GPUMatrix<ElemType>& a, const GPUMatrix<ElemType>& b,
+                                                                                      const GPUMatrix<ElemType>& invNormA, const GPUMatrix<ElemType>& invNormB, const size_t shift, const bool isRightInput)
+{
+    return *this;
+}
+
 template <class ElemType>
 void GPUMatrix<ElemType>::ConductRowElementMultiplyWithShift(const GPUMatrix<ElemType>& a, const GPUMatrix<ElemType>& b, GPUMatrix<ElemType>& c, const size_t shift, const bool isafixed)
 {
@@ -1714,6 +1906,32 @@ GPUMatrix<ElemType>& GPUMatrix<ElemType>::AssignNumOfDiff(const GPUMatrix<ElemTy
     return *this;
 }
 
+template <class ElemType>
+GPUMatrix<ElemType>& GPUMatrix<ElemType>::AssignLambdaRankMetricOf(const GPUMatrix<ElemType>& /*gains*/, const GPUMatrix<ElemType>& /*scores*/, const GPUMatrix<ElemType>& /*queryIds*/, GPUMatrix<ElemType>& /*discounts*/)
+{
+    return *this;
+}
+
+template <class ElemType>
+GPUMatrix<ElemType>& GPUMatrix<ElemType>::AddLambdaRankGradientOf(ElemType /*sigma*/, const GPUMatrix<ElemType>& /*gains*/, const GPUMatrix<ElemType>& /*scores*/, const GPUMatrix<ElemType>& /*queryIds*/, const GPUMatrix<ElemType>& /*discounts*/)
+{
+    return *this;
+}
+
+template <class ElemType>
+GPUMatrix<ElemType>& GPUMatrix<ElemType>::AssignGMMLogLikelihoodOf(const GPUMatrix<ElemType>& /*unnormedPriors*/, const GPUMatrix<ElemType>& /*means*/, const GPUMatrix<ElemType>& /*logStddevs*/,
+                                                                   const GPUMatrix<ElemType>& /*features*/, GPUMatrix<ElemType>& /*posteriors*/)
+{
+    return *this;
+}
+
+template <class ElemType>
+GPUMatrix<ElemType>& GPUMatrix<ElemType>::AddGMMLogLikelihoodGradientOf(size_t /*inputIndex*/, const GPUMatrix<ElemType>& /*gradient*/, const GPUMatrix<ElemType>& /*unnormedPriors*/, const GPUMatrix<ElemType>& /*means*/,
+                                                                        const GPUMatrix<ElemType>& /*logStddevs*/, const GPUMatrix<ElemType>& /*features*/, const GPUMatrix<ElemType>& /*posteriors*/)
+{
+    return *this;
+}
+
 #pragma endregion Member BLAS Functions
 
 #pragma region Other helper functions
@@ -1885,6 +2103,10 @@ template <class ElemType>
 void GPUMatrix<ElemType>::Multiply1x1AndWeightedAdd(ElemType alpha, const GPUMatrix<ElemType>& lhs, const GPUMatrix<ElemType>& rhs, ElemType beta, GPUMatrix<ElemType>& c)
 {
 }
+template <class ElemType>
+void GPUMatrix<ElemType>::BatchMultiplyAndWeightedAdd(ElemType alpha, const GPUMatrix<ElemType>& a, const bool transposeA, const GPUMatrix<ElemType>& b, const bool transposeB, ElemType beta, GPUMatrix<ElemType>& c, size_t m, size_t n, size_t k)
+{
+}
 
 template <class ElemType>
 void GPUMatrix<ElemType>::MultiplyAndAdd(const GPUMatrix<ElemType>& /*a*/, const bool transposeA, const GPUMatrix<ElemType>& /*b*/, const bool transposeB, GPUMatrix<ElemType>& c)
@@ -2051,6 +2273,10 @@ void GPUMatrix<ElemType>::TensorOp(ElemType beta, const GPUMatrix<ElemType>& a,
                                    const SmallVector<size_t>& reducingOpDims, const array<SmallVector<ptrdiff_t>, 4>& reducingStrides)
 {
 }
+template <class ElemType>
+void GPUMatrix<ElemType>::FusedElementwiseOp(const FusedElementwiseProgram& program, const std::vector<const GPUMatrix<ElemType>*>& inputs)
+{
+}
 
 template <class ElemType>
 void GPUMatrix<ElemType>::CreateCurandObject(unsigned long seed, const char* caller)
@@ -2128,6 +2354,20 @@ void GPUMatrix<ElemType>::RCRFTransGrdCompute(const GPUMatrix<ElemType>& lbls,
 {
 }
 
+template <class ElemType>
+void GPUMatrix<ElemType>::RCRFForwardBackward(const GPUMatrix<ElemType>& lbls, const GPUMatrix<ElemType>& pos_scores, const GPUMatrix<ElemType>& pair_scores,
+                                              const std::vector<CRFSequence>& sequences, size_t numParallelSequences,
+                                              GPUMatrix<ElemType>& alpha, GPUMatrix<ElemType>& beta, GPUMatrix<ElemType>& objectives)
+{
+}
+
+template <class ElemType>
+void GPUMatrix<ElemType>::RCRFViterbiDecode(const GPUMatrix<ElemType>& lbls, const GPUMatrix<ElemType>& pos_scores, const GPUMatrix<ElemType>& pair_scores,
+                                            const std::vector<CRFSequence>& sequences, size_t numParallelSequences,
+                                            GPUMatrix<ElemType>& decodedPath)
+{
+}
+
 template <class ElemType>
 void GPUMatrix<ElemType>::AssignNoiseContrastiveEstimation(const GPUMatrix<ElemType>& a,
                                                            const GPUMatrix<ElemType>& b, const GPUMatrix<ElemType>& bias, size_t sampleCount, GPUMatrix<ElemType>& tmp, GPUMatrix<ElemType>& c)
@@ -2234,9 +2474,21 @@ GPUDataTransferer::GPUDataTransferer(int, bool){}
 GPUDataTransferer::~GPUDataTransferer(){}
 void GPUDataTransferer::CopyGPUToCPUAsync(void*, size_t, void*){}
 void GPUDataTransferer::WaitForCopyGPUToCPUAsync(){}
+bool GPUDataTransferer::IsCopyGPUToCPUAsyncComplete(){ return true; }
 void GPUDataTransferer::CopyCPUToGPUAsync(void*, size_t, void*){}
 void GPUDataTransferer::WaitForCopyCPUToGPUAsync(){}
 
+OffloadGPUDataTransferer::OffloadGPUDataTransferer(int deviceId) : m_deviceId(deviceId), m_stallSeconds(0) {}
+OffloadGPUDataTransferer::~OffloadGPUDataTransferer() {}
+void OffloadGPUDataTransferer::CopyGPUToCPUAsync(const void*, size_t, void*) {}
+void OffloadGPUDataTransferer::CopyCPUToGPUAsync(const void*, size_t, void*) {}
+void OffloadGPUDataTransferer::WaitForCopyOnComputeStreamAsync() {}
+double OffloadGPUDataTransferer::CollectStallSeconds() { return 0; }
+
+PeerGPUDataTransferer::PeerGPUDataTransferer(int fromDeviceId, int toDeviceId) : m_fromDeviceId(fromDeviceId), m_toDeviceId(toDeviceId) {}
+PeerGPUDataTransferer::~PeerGPUDataTransferer() {}
+void PeerGPUDataTransferer::CopyAsync(const void*, size_t, void*) {}
+
 #pragma endregion GPUDataTransferer functions
 
 #pragma region GPURNGHandle functions
@@ -2278,7 +2530,7 @@ std::unique_ptr<ConvolutionEngine<ElemType>> CuDnnConvolutionEngineFactory<ElemT
 }
 
 template <class ElemType>
-bool CuDnnConvolutionEngineFactory<ElemType>::IsSupported(DEVICEID_TYPE, ConvolveGeometryPtr, PoolKind)
+bool CuDnnConvolutionEngineFactory<ElemType>::IsSupported(DEVICEID_TYPE, ConvolveGeometryPtr, PoolKind, ImageLayoutKind)
 {
     return false;
 }
@@ -2286,6 +2538,11 @@ bool CuDnnConvolutionEngineFactory<ElemType>::IsSupported(DEVICEID_TYPE, Convolv
 template class CuDnnConvolutionEngineFactory<float>;
 template class CuDnnConvolutionEngineFactory<double>;
 
+std::string CuDnnDeviceDescription(DEVICEID_TYPE)
+{
+    RuntimeError("The code is compiled with CPUONLY macro.");
+}
+
 template <class ElemType>
 std::unique_ptr<BatchNormEngine<ElemType>> CuDnnBatchNormEngineFactory<ElemType>::Create(DEVICEID_TYPE deviceId, const TensorShape& inOutT,
                                                                                          bool spatial, ImageLayoutKind imageLayout)
@@ -2328,6 +2585,19 @@ size_t GPUWatcher::GetFreeMemoryOnCUDADevice(int /*devId*/)
     return 0;
 }
 
+/*static*/ void GPUWatcher::AddTelemetryGauges(int /*devId*/)
+{
+}
+
+/*static*/ void GPUWatcher::RecordWorkspaceBytes(int /*devId*/, size_t /*bytes*/)
+{
+}
+
+/*static*/ size_t GPUWatcher::TakePeakWorkspaceBytes(int /*devId*/)
+{
+    return 0;
+}
+
 GPUWatcher::GPUWatcher(void)
 {
 }
@@ -0,0 +1,50 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE.md file in the project root for full license information.
+//
+// PackedGemm.h -- constant left factor of CPU matrix products, kept in the internal layout of the GEMM kernels
+//
+#pragma once
+#include "Basics.h"       // for DISABLE_COPY_AND_MOVE
+#include "CommonMatrix.h" // for MATH_API
+
+namespace Microsoft { namespace MSR { namespace CNTK {
+
+// op(A) of products C = op(A) * op(B) + beta * C on the CPU where A does not change, e.g. the weights of a TimesNode
+// at inference. With MKL, A is converted once by cblas_?gemm_pack into the layout that cblas_?gemm otherwise copies
+// it into for every call, and the products go to cblas_?gemm_compute; this saves most for small minibatches, where
+// that copy is a large part of the work. Without MKL nothing is packed and IsPacked() is false.
+// The packed copy is taken when the object is created: the owner must not change A afterwards.
+// Used by CPUMatrix::MultiplyAndWeightedAdd() when it multiplies the same A, see Matches().
+// Implemented in CPUMatrix.cpp.
+template <class ElemType>
+class MATH_API PackedGemmMatrix
+{
+public:
+    // A is column-major with leading dimension transposeA ? k : m, and op(A) is [m x k]
+    PackedGemmMatrix(const ElemType* a, int m, int k, bool transposeA);
+    ~PackedGemmMatrix();
+
+    bool IsPacked() const { return m_packed != nullptr; }
+    size_t SizeInBytes() const { return m_sizeInBytes; }
+
+    // whether a product by op(A) with these arguments can use the packed copy
+    bool Matches(const ElemType* a, int m, int k, bool transposeA) const
+    {
+        return IsPacked() && a == m_source && m == m_m && k == m_k && transposeA == m_transposeA;
+    }
+
+    // C = op(A) * op(B) + beta * C, where op(B) is [k x n]
+    void MultiplyAndWeightedAdd(int n, const ElemType* b, int ldb, bool transposeB, ElemType beta, ElemType* c, int ldc) const;
+
+private:
+    const ElemType* m_source;
+    int m_m, m_k;
+    bool m_transposeA;
+    ElemType* m_packed;
+    size_t m_sizeInBytes;
+
+    DISABLE_COPY_AND_MOVE(PackedGemmMatrix);
+};
+
+}}}
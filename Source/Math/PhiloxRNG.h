@@ -0,0 +1,66 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE.md file in the project root for full license information.
+//
+// PhiloxRNG.h -- counter-based random numbers (Philox4x32-10), shared by the CPU and CUDA code
+//
+
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+#include "cudabasetypes.h" // for cudasharedcode
+
+namespace Microsoft { namespace MSR { namespace CNTK {
+
+// Philox4x32-10 of Salmon et al., "Parallel random numbers: as easy as 1, 2, 3" (SC 2011), as in cuRAND and Random123.
+// The random numbers are a pure function of (key, counter), so any of them can be computed at any time, in any order,
+// on any device: e.g. a dropout mask can be recomputed in backprop instead of being stored.
+// 'index' is the position in the stream of 32-bit random numbers of 'key'; each counter yields four of these.
+struct PhiloxRNG
+{
+    static cudasharedcode uint32_t MulHi(uint32_t a, uint32_t b, uint32_t& lo)
+    {
+        uint64_t product = (uint64_t) a * b;
+        lo = (uint32_t) product;
+        return (uint32_t) (product >> 32);
+    }
+
+    // the four random numbers of a counter, i.e. of the indices 4 * counter to 4 * counter + 3
+    static cudasharedcode void Generate4(uint64_t key, uint64_t counter, uint32_t result[4])
+    {
+        uint32_t c0 = (uint32_t) counter, c1 = (uint32_t) (counter >> 32), c2 = 0, c3 = 0;
+        uint32_t k0 = (uint32_t) key, k1 = (uint32_t) (key >> 32);
+        for (int round = 0; round < 10; round++)
+        {
+            uint32_t lo0, lo1;
+            uint32_t hi0 = MulHi(0xD2511F53u, c0, lo0);
+            uint32_t hi1 = MulHi(0xCD9E8D57u, c2, lo1);
+            c0 = hi1 ^ c1 ^ k0;
+            c1 = lo1;
+            c2 = hi0 ^ c3 ^ k1;
+            c3 = lo0;
+            k0 += 0x9E3779B9u;
+            k1 += 0xBB67AE85u;
+        }
+        result[0] = c0;
+        result[1] = c1;
+        result[2] = c2;
+        result[3] = c3;
+    }
+
+    static cudasharedcode uint32_t Generate(uint64_t key, uint64_t index)
+    {
+        uint32_t result[4];
+        Generate4(key, index / 4, result);
+        return result[index % 4];
+    }
+
+    // uniform in (0, 1], as curandGenerateUniform()
+    static cudasharedcode float ToUniform(uint32_t value)
+    {
+        return ((value >> 8) + 1) * (1.0f / 16777216.0f);
+    }
+};
+
+}}}
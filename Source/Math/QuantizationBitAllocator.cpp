@@ -0,0 +1,72 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE.md file in the project root for full license information.
+//
+// QuantizationBitAllocator.cpp -- choice of the number of bits of each gradient for adaptive gradient quantization
+//
+
+#include "stdafx.h"
+#include "QuantizationBitAllocator.h"
+#include "Basics.h"
+#include <cmath>
+
+namespace Microsoft { namespace MSR { namespace CNTK {
+
+QuantizationBitAllocator::QuantizationBitAllocator(double bitsBudget, double targetError)
+    : m_bitsBudget(bitsBudget), m_targetError(targetError)
+{
+    if (bitsBudget < 1)
+        InvalidArgument("QuantizationBitAllocator: The budget of bits per gradient entry must be at least 1, but is %g.", bitsBudget);
+    if (targetError < 0)
+        InvalidArgument("QuantizationBitAllocator: The target quantization error must not be negative, but is %g.", targetError);
+}
+
+/*static*/ double QuantizationBitAllocator::EstimateError(double error, size_t measuredBits, size_t bits)
+{
+    return ldexp(error, (int) measuredBits - (int) bits);
+}
+
+std::vector<size_t> QuantizationBitAllocator::Allocate(const std::vector<size_t>& numElements, const std::vector<size_t>& bits, const std::vector<double>& errors) const
+{
+    if (bits.size() != numElements.size() || errors.size() != numElements.size())
+        LogicError("QuantizationBitAllocator: Got %d bit counts and %d errors for %d gradients.", (int) bits.size(), (int) errors.size(), (int) numElements.size());
+
+    double totalNumElements = 0;
+    for (auto n : numElements)
+        totalNumElements += (double) n;
+
+    std::vector<size_t> result(numElements.size(), 1);
+    std::vector<bool> exceedsBudget(numElements.size(), false);
+    double remainingBits = (m_bitsBudget - 1) * totalNumElements;
+    for (;;)
+    {
+        size_t worst = SIZE_MAX;
+        double worstError = m_targetError;
+        for (size_t i = 0; i < numElements.size(); i++)
+        {
+            if (exceedsBudget[i] || result[i] >= MaxBits)
+                continue;
+            double error = EstimateError(errors[i], bits[i], result[i]);
+            if (error > worstError)
+            {
+                worst = i;
+                worstError = error;
+            }
+        }
+        if (worst == SIZE_MAX)
+            break;
+
+        // doubling b bits adds b bits per entry
+        double cost = (double) result[worst] * numElements[worst];
+        if (cost > remainingBits)
+        {
+            exceedsBudget[worst] = true;
+            continue;
+        }
+        remainingBits -= cost;
+        result[worst] *= 2;
+    }
+    return result;
+}
+
+}}}
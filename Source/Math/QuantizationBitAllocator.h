@@ -0,0 +1,44 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE.md file in the project root for full license information.
+//
+// QuantizationBitAllocator.h -- choice of the number of bits of each gradient for adaptive gradient quantization
+//
+
+#pragma once
+
+#include "CommonMatrix.h" // for MATH_API
+#include <vector>
+
+namespace Microsoft { namespace MSR { namespace CNTK {
+
+// Chooses how many bits (1, 2, 4 or 8) MatrixQuantizer uses for each of a set of gradients, from the quantization
+// error measured for each at its current number of bits, and from what sending it costs.
+// The error is the norm of the residual relative to that of the gradient. It is assumed to halve with each added bit,
+// as for the linear quantization of more than 1 bit. Starting from 1 bit for all gradients, the gradient with the largest
+// estimated error above the target gets twice its bits, as long as the average number of bits per gradient entry stays
+// within the budget; so small gradients are cheap to give more bits, and large ones only get them if their error is large.
+class MATH_API QuantizationBitAllocator
+{
+public:
+    static const size_t MaxBits = 8;
+
+    // 'bitsBudget': bound of the average number of bits per gradient entry, at least 1
+    // 'targetError': the error up to which a gradient gets no more bits
+    QuantizationBitAllocator(double bitsBudget, double targetError);
+
+    // Returns the bits of each gradient; 'errors[i]' was measured for gradient i, of 'numElements[i]' entries, quantized with 'bits[i]' bits.
+    std::vector<size_t> Allocate(const std::vector<size_t>& numElements, const std::vector<size_t>& bits, const std::vector<double>& errors) const;
+
+    // the error expected with 'bits' bits from the 'error' measured with 'measuredBits'
+    static double EstimateError(double error, size_t measuredBits, size_t bits);
+
+    double BitsBudget() const { return m_bitsBudget; }
+    double TargetError() const { return m_targetError; }
+
+private:
+    double m_bitsBudget;
+    double m_targetError;
+};
+
+}}}
@@ -0,0 +1,138 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE.md file in the project root for full license information.
+//
+// QuantizedOperations.cpp -- 16-bit integer matrix product for QuantizedMultiplier
+//
+
+#include "stdafx.h"
+#include "QuantizedOperations.h"
+#include <cstring>
+
+// The block handlers need SSE, see BlockHandlerSSE.cpp; other platforms take the reference product.
+#if !defined(__aarch64__)
+#include "BlockMultiplier.h"
+#endif
+
+namespace Microsoft { namespace MSR { namespace CNTK {
+
+#if !defined(__aarch64__)
+// The block multiplier for one block handler; which one is decided at run time, see CreateBlockProductKernel().
+class BlockProductKernel
+{
+public:
+    virtual ~BlockProductKernel() {}
+    virtual short* PrepareA(const short* A, int m, int k) = 0;
+    virtual void FreeA(short* preparedA) = 0;
+    virtual void Multiply(const short* B, int n, int k, short* preparedA, int m, int32_t* C) = 0;
+};
+
+template <class BlockHandlerT>
+class BlockProductKernelT : public BlockProductKernel
+{
+    BlockMultiplier<BlockHandlerT> m_multiplier;
+
+public:
+    short* PrepareA(const short* A, int m, int k) override
+    {
+        return m_multiplier.PrepareB(const_cast<short*>(A), k, m);
+    }
+
+    void FreeA(short* preparedA) override
+    {
+        BlockMultiplier<BlockHandlerT>::FreeMatrix(preparedA);
+    }
+
+    void Multiply(const short* B, int n, int k, short* preparedA, int m, int32_t* C) override
+    {
+        m_multiplier.SetNumThreads(omp_get_max_threads());
+        m_multiplier.MultiplyMatrices(const_cast<short*>(B), n, k, preparedA, m, C);
+    }
+};
+
+// The widest handler the host supports, so that one binary runs everywhere. BlockHandlerAVX is not used:
+// it loads with 32-byte alignment from blocks BlockMultiplier only aligns for SSE, and needs a build for AVX2.
+static BlockProductKernel* CreateBlockProductKernel()
+{
+    if (BlockHandlerAVX512::IsSupported())
+        return new BlockProductKernelT<BlockHandlerAVX512>();
+    return new BlockProductKernelT<BlockHandlerSSE>();
+}
+#endif
+
+// BlockMultiplier multiplies row-major matrices and lays out its right operand. A column-major matrix is the
+// row-major transpose, so C = A * B is computed as C^T = B^T * A^T, which makes A the operand laid out once.
+struct QuantizedBlockProduct::Impl
+{
+    int m = 0;
+    int k = 0;
+#if !defined(__aarch64__)
+    std::unique_ptr<BlockProductKernel> kernel;
+    short* preparedA = nullptr;
+
+    Impl()
+        : kernel(CreateBlockProductKernel())
+    {
+    }
+
+    ~Impl()
+    {
+        if (preparedA)
+            kernel->FreeA(preparedA);
+    }
+#else
+    std::vector<short> A;
+#endif
+};
+
+QuantizedBlockProduct::QuantizedBlockProduct()
+    : m_impl(new Impl())
+{
+}
+
+QuantizedBlockProduct::~QuantizedBlockProduct()
+{
+}
+
+void QuantizedBlockProduct::SetA(const short* A, int m, int k)
+{
+    m_impl->m = m;
+    m_impl->k = k;
+#if !defined(__aarch64__)
+    if (m_impl->preparedA)
+        m_impl->kernel->FreeA(m_impl->preparedA);
+    m_impl->preparedA = m_impl->kernel->PrepareA(A, m, k);
+#else
+    m_impl->A.assign(A, A + (size_t)m * k);
+#endif
+}
+
+bool QuantizedBlockProduct::HasA(int m, int k) const
+{
+    return m_impl->m == m && m_impl->k == k && m > 0 && k > 0;
+}
+
+void QuantizedBlockProduct::Multiply(const short* B, int n, int32_t* C)
+{
+    int m = m_impl->m;
+    int k = m_impl->k;
+    if (m == 0 || k == 0)
+        LogicError("QuantizedBlockProduct: SetA() must be called before Multiply().");
+
+    memset(C, 0, sizeof(int32_t) * m * n);
+#if !defined(__aarch64__)
+    m_impl->kernel->Multiply(B, n, k, m_impl->preparedA, m, C);
+#else
+    const short* A = m_impl->A.data();
+    for (int j = 0; j < n; j++)
+        for (int i = 0; i < m; i++)
+        {
+            int32_t dotProduct = 0;
+            for (int l = 0; l < k; l++)
+                dotProduct += A[i + l * m] * B[l + k * j];
+            C[i + j * m] = dotProduct;
+        }
+#endif
+}
+
+}}}
@@ -4,9 +4,38 @@
 //
 #pragma once
 #include "Quantizers.h"
+#include "CommonMatrix.h" // for MATH_API
+#include <cstdint>
+#include <memory>
+#include <vector>
 
 namespace Microsoft { namespace MSR { namespace CNTK {
 
+// Product C[m,n] = A[m,k]*B[k,n] of 16-bit integer matrices in column-major order, accumulated in (saturating) 32 bit.
+// A is rewritten into the block order of BlockMultiplier by SetA(), so a constant A (weights) is laid out only once
+// and reused for every product with it, with the SSE block handler.
+// Implemented in QuantizedOperations.cpp, which keeps the SIMD headers out of here.
+class MATH_API QuantizedBlockProduct
+{
+public:
+    // The kernels add up several products in 32 bit before saturating, which only cannot overflow
+    // for entries of up to this magnitude, see BlockMultiplier::MAXRANGE.
+    static const int MaxMagnitude = 1 << 13;
+
+    QuantizedBlockProduct();
+    ~QuantizedBlockProduct();
+
+    void SetA(const short* A, int m, int k);
+    bool HasA(int m, int k) const;
+
+    // C must have room for m*n elements
+    void Multiply(const short* B, int n, int32_t* C);
+
+private:
+    struct Impl;
+    std::unique_ptr<Impl> m_impl;
+};
+
 
 // Quantized product of two dense matrices A and B, where each matrix has its own quantizer.
 // This class handles quantization of both matrices, product and de-quantization of the result.
@@ -18,8 +47,12 @@ class QuantizedMultiplier
     shared_ptr<QuantizerBase<ElemType, short>> m_pQuantizerA;
     shared_ptr<QuantizerBase<ElemType, short>> m_pQuantizerB;
 
-    // Placeholders for quantized matrices A and B
+    // Placeholders for quantized matrices A and B, and the integer product
     vector<short> m_pMatA, m_pMatB;
+    vector<int32_t> m_product;
+
+    // A in the layout of the block multiplier
+    shared_ptr<QuantizedBlockProduct> m_pBlockProduct;
 
     // Whether matrices A and B are constant (i.e. weights)
     // If the matrix is constant, the size of the underlying container for quatized values will be preserved for
@@ -29,10 +62,16 @@ class QuantizedMultiplier
 
     bool m_firstPass;
 
+    // whether the quantized ranges allow the block product; otherwise the reference product is used
+    bool m_useBlockProduct;
+
 public: 
     QuantizedMultiplier(shared_ptr<QuantizerBase<ElemType, short>> pQuantizerA, bool isAConstant, shared_ptr<QuantizerBase<ElemType, short>> pQuantizerB, bool isBConstant) :
-        m_pQuantizerA(pQuantizerA), m_pQuantizerB(pQuantizerB), m_isAConstant(isAConstant), m_isBConstant(isBConstant), m_firstPass(true)
+        m_pQuantizerA(pQuantizerA), m_pQuantizerB(pQuantizerB), m_isAConstant(isAConstant), m_isBConstant(isBConstant), m_firstPass(true),
+        m_useBlockProduct(pQuantizerA->MaxQuantizedMagnitude() <= QuantizedBlockProduct::MaxMagnitude && pQuantizerB->MaxQuantizedMagnitude() <= QuantizedBlockProduct::MaxMagnitude)
     {
+        if (m_useBlockProduct)
+            m_pBlockProduct = make_shared<QuantizedBlockProduct>();
         if (isAConstant && isBConstant)
             LogicError("Quantized multiplication is applied to two constant matrices -- it is highly inefficient. Better approach is to replace the operation with the resulting matrix.");
     };
@@ -41,18 +80,24 @@ public:
     {
     };
 
+    // Quantizes the constant matrix A[m,k] and lays it out for the product now, e.g. at model load,
+    // rather than in the first Multiply()
+    void PrepareConstantA(int m, int k, const ElemType* A)
+    {
+        if (!m_isAConstant)
+            LogicError("QuantizedMultiplier: Only a constant matrix A can be prepared ahead of the product.");
+        QuantizeA(m, k, A);
+    }
+
     // A[m,k]*B[k,n] = C[m,n]
     void Multiply(int m, int n, int k, ElemType* A, ElemType* B, ElemType* C)
     {
         // Quantize
-        if (!m_isAConstant || m_firstPass)
-        {
-            m_pMatA.resize(m*k);
-            ArrayRef<short> refMatA(m_pMatA.data(), m_pMatA.size());
-            m_pQuantizerA->Quantize(ArrayRef<ElemType>(A, m_pMatA.size()), refMatA);
-        }
-        
-        if (!m_isBConstant || m_firstPass)
+        bool hasA = m_useBlockProduct ? m_pBlockProduct->HasA(m, k) : m_pMatA.size() == (size_t)m*k;
+        if (!m_isAConstant || m_firstPass || !hasA)
+            QuantizeA(m, k, A);
+
+        if (!m_isBConstant || m_firstPass || m_pMatB.size() != (size_t)n*k)
         {
             m_pMatB.resize(n*k);
             ArrayRef<short> refMatB(m_pMatB.data(), m_pMatB.size());
@@ -62,28 +107,53 @@ public:
         m_firstPass = false;
 
         // Do multiply
-        // Naive inefficient product, just for demonstation
-        // TODO: replace with an efficient version, e.g. IPG, block multiplier, Eigen, gemmlowp, etc.
-        for (size_t i = 0; i < m; i++)
-            for (size_t j = 0; j < n; j++)
-            {
-                int dotProduct=0;
-                for (size_t l = 0; l < k; l++)
+        int mn = m*n;
+        if (m_useBlockProduct)
+        {
+            m_product.resize(mn);
+            m_pBlockProduct->Multiply(m_pMatB.data(), n, m_product.data());
+            for (int i = 0; i < mn; i++)
+                C[i] = (ElemType)m_product[i];
+        }
+        else
+        {
+            // reference product
+            for (size_t i = 0; i < m; i++)
+                for (size_t j = 0; j < n; j++)
                 {
-                    // CNTK is using column-major storage
-                    dotProduct += m_pMatA[i + l*m] * m_pMatB[l + k*j];
+                    int dotProduct=0;
+                    for (size_t l = 0; l < k; l++)
+                    {
+                        // CNTK is using column-major storage
+                        dotProduct += m_pMatA[i + l*m] * m_pMatB[l + k*j];
+                    }
+                    C[i + j*m] = (ElemType)dotProduct;
                 }
-                C[i + j*m] = (ElemType)dotProduct;
-            }
+        }
 
         // De-quantize
-        int mn = m*n;
         m_pQuantizerB->Dequantize(C, C, mn);
         m_pQuantizerA->Dequantize(C, C, mn);
     }
 
     void SetIsAConstant(bool v) { m_isAConstant = v; }
     void SetIsBConstant(bool v) { m_isBConstant = v; }
+    bool UsesBlockProduct() const { return m_useBlockProduct; }
+
+private:
+    void QuantizeA(int m, int k, const ElemType* A)
+    {
+        m_pMatA.resize(m*k);
+        ArrayRef<short> refMatA(m_pMatA.data(), m_pMatA.size());
+        m_pQuantizerA->Quantize(ArrayRef<ElemType>(const_cast<ElemType*>(A), m_pMatA.size()), refMatA);
+        if (m_useBlockProduct)
+        {
+            m_pBlockProduct->SetA(m_pMatA.data(), m, k);
+            // a constant A is only needed in the block layout from now on
+            if (m_isAConstant)
+                vector<short>().swap(m_pMatA);
+        }
+    }
 };
 
 }}}
\ No newline at end of file
@@ -21,6 +21,8 @@ public:
     virtual void Dequantize(const ArrayRef<RawType>& input, ArrayRef<RawType>& output) = 0;
     virtual void Dequantize(const RawType* input, RawType* output, size_t size) = 0;
 
+    // Bound of the magnitude of the quantized values
+    virtual int MaxQuantizedMagnitude() const { return rangeMax; }
 
 protected:
     QuantizedType rangeMax;
@@ -28,7 +30,7 @@ protected:
 
 // Symmetric quantizer. 
 // Quantization is achieved by 
-//    1. Finding the absolute max of values to be quantized.
+//    1. Finding the absolute max of values to be quantized, or taking a calibrated one, beyond which values are clipped.
 //    2. Adjusting the max with bit shifting specified with the bitShift parameter (see comment at the declaration of the parameter)
 //    3. Scaling all values in the collection to be within the symmetric range of the signed integer (QuantizedType)
 template <class RawType, class QuantizedType>
@@ -37,6 +39,10 @@ class SymmetricQuantizer : public QuantizerBase<RawType, QuantizedType>
     RawType m_quantizeFactor;
     RawType m_inverseQuantizerFactor;
 
+    // Absolute max to quantize with instead of the one of each collection, e.g. one picked from the histogram of
+    // the values seen in calibration, so that a few outliers don't cost the precision of all other values; 0 if none.
+    RawType m_calibratedMax;
+
     // Decreases the maximum range of quantziation by 2^bitShift to prevent integer overflow during BLAS routines.
     // bitShift=0 doesn't change the range; higher bitShift will decrease precision of quantization, but will make BLAS routines less prone to overflow.
     // For quantization with shorts, recommended value of bitShift is from 1 to 3, but it's model and feature dependent and should be experimented with for optimal results
@@ -44,7 +50,8 @@ class SymmetricQuantizer : public QuantizerBase<RawType, QuantizedType>
 public:
     // elements - collection to be quantized
     // bitShift - see comment above
-    SymmetricQuantizer(size_t bitShift) : m_bitShift(bitShift)
+    // calibratedMax - see comment above
+    SymmetricQuantizer(size_t bitShift, RawType calibratedMax = 0) : m_bitShift(bitShift), m_calibratedMax(calibratedMax)
     {
     }
 
@@ -55,7 +62,7 @@ public:
             return;
         assert(input.size() == output.size());
 
-        RawType absoluteMax = FindAbsMax(input);
+        RawType absoluteMax = m_calibratedMax > 0 ? m_calibratedMax : FindAbsMax(input);
 
         RawType shiftedMax = absoluteMax * (1 << m_bitShift);
         if (shiftedMax == 0)
@@ -71,12 +78,25 @@ public:
             m_inverseQuantizerFactor = 1 / m_quantizeFactor;
         }
 
+        if (m_calibratedMax > 0)
+        {
+            // clip, which keeps the quantized values within MaxQuantizedMagnitude()
+            for (size_t i = 0; i < input.size(); i++)
+                output[i] = (QuantizedType)round(std::max(-absoluteMax, std::min(input[i], absoluteMax)) * m_quantizeFactor);
+            return;
+        }
+
         for (size_t i = 0; i < input.size(); i++)
         {
             output[i] = (QuantizedType)round(input[i] * m_quantizeFactor);
         }
     }
 
+    RawType CalibratedMax() const { return m_calibratedMax; }
+
+    // The range is decreased by 2^bitShift, and rounding may add one
+    virtual int MaxQuantizedMagnitude() const { return (this->rangeMax >> m_bitShift) + 1; }
+
     // Accept quantized collection as input, put de-quantization result into pre-allocated output collection.
     virtual void Dequantize(const ArrayRef<RawType>& input, ArrayRef<RawType>& output)
     {
@@ -0,0 +1,203 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE.md file in the project root for full license information.
+//
+// Telemetry.cpp -- gauges sampled periodically on a background thread, logged and written as a Prometheus text file
+//
+
+#define _CRT_SECURE_NO_WARNINGS
+
+#include "stdafx.h"
+#include "Telemetry.h"
+#include "fileutil.h"
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <limits>
+#include <vector>
+
+namespace Microsoft { namespace MSR { namespace CNTK {
+
+// held while the samplers run, so that a sampler does not run anymore once RemoveGauge() returned
+static std::mutex s_samplingMutex;
+
+std::atomic<bool> Telemetry::s_enabled(false);
+std::mutex Telemetry::s_mutex;
+std::condition_variable Telemetry::s_stopRequested;
+bool Telemetry::s_stop = false;
+std::thread Telemetry::s_thread;
+double Telemetry::s_periodInSeconds = 0;
+bool Telemetry::s_toLog = false;
+std::wstring Telemetry::s_prometheusFile;
+std::map<size_t, Telemetry::Gauge> Telemetry::s_gauges;
+size_t Telemetry::s_nextGaugeId = 0;
+
+/*static*/ void Telemetry::Start(double periodInSeconds, bool toLog, const std::wstring& prometheusFile)
+{
+    if (periodInSeconds <= 0 || (!toLog && prometheusFile.empty()))
+        return;
+
+    std::lock_guard<std::mutex> lock(s_mutex);
+    if (s_enabled)
+        LogicError("Telemetry: Sampling has already been started.");
+
+    s_periodInSeconds = periodInSeconds;
+    s_toLog = toLog;
+    s_prometheusFile = prometheusFile;
+    s_stop = false;
+    s_enabled = true;
+    s_thread = std::thread(&Telemetry::Run);
+    fprintf(stderr, "Starting telemetry every %.3gs%s%ls\n", periodInSeconds, prometheusFile.empty() ? "" : " to ", prometheusFile.c_str());
+}
+
+/*static*/ void Telemetry::Stop()
+{
+    {
+        std::lock_guard<std::mutex> lock(s_mutex);
+        if (!s_enabled || s_stop)
+            return;
+        s_stop = true;
+    }
+    s_stopRequested.notify_all();
+    s_thread.join();
+
+    // the last values of the gauges, e.g. the peaks since the previous sample
+    Sample();
+
+    std::lock_guard<std::mutex> lock(s_mutex);
+    s_enabled = false;
+    // the values Set() belong to this run, the samplers stay registered for the next one
+    for (auto iter = s_gauges.begin(); iter != s_gauges.end();)
+    {
+        if (!iter->second.m_sampler)
+            iter = s_gauges.erase(iter);
+        else
+            ++iter;
+    }
+    fprintf(stderr, "Stopping telemetry\n");
+}
+
+/*static*/ bool Telemetry::IsEnabled()
+{
+    return s_enabled.load(std::memory_order_relaxed);
+}
+
+/*static*/ size_t Telemetry::FindOrAddGauge(const std::string& name, const std::string& labels, const std::string& help)
+{
+    for (const auto& gauge : s_gauges)
+    {
+        if (gauge.second.m_name == name && gauge.second.m_labels == labels)
+            return gauge.first;
+    }
+
+    size_t id = s_nextGaugeId++;
+    Gauge& gauge = s_gauges[id];
+    gauge.m_name = name;
+    gauge.m_labels = labels;
+    gauge.m_help = help;
+    gauge.m_value = std::numeric_limits<double>::quiet_NaN();
+    return id;
+}
+
+/*static*/ size_t Telemetry::AddGauge(const std::string& name, const std::string& labels, const std::string& help, Sampler&& sampler)
+{
+    std::lock_guard<std::mutex> samplingLock(s_samplingMutex);
+    std::lock_guard<std::mutex> lock(s_mutex);
+    size_t id = FindOrAddGauge(name, labels, help);
+    s_gauges[id].m_sampler = std::move(sampler);
+    return id;
+}
+
+/*static*/ void Telemetry::RemoveGauge(size_t id)
+{
+    std::lock_guard<std::mutex> samplingLock(s_samplingMutex);
+    std::lock_guard<std::mutex> lock(s_mutex);
+    s_gauges.erase(id);
+}
+
+/*static*/ void Telemetry::Set(const std::string& name, const std::string& labels, const std::string& help, double value)
+{
+    if (!IsEnabled())
+        return;
+
+    std::lock_guard<std::mutex> lock(s_mutex);
+    s_gauges[FindOrAddGauge(name, labels, help)].m_value = value;
+}
+
+/*static*/ void Telemetry::Run()
+{
+    std::unique_lock<std::mutex> lock(s_mutex);
+    auto period = std::chrono::duration<double>(s_periodInSeconds);
+    while (!s_stopRequested.wait_for(lock, period, [] { return s_stop; }))
+    {
+        lock.unlock();
+        Sample();
+        lock.lock();
+    }
+}
+
+/*static*/ void Telemetry::Sample()
+{
+    std::lock_guard<std::mutex> samplingLock(s_samplingMutex);
+
+    // the samplers run without s_mutex, so that Set() does not wait for them
+    std::vector<Gauge> gauges;
+    {
+        std::lock_guard<std::mutex> lock(s_mutex);
+        for (const auto& gauge : s_gauges)
+            gauges.push_back(gauge.second);
+    }
+    for (auto& gauge : gauges)
+    {
+        if (gauge.m_sampler)
+            gauge.m_value = gauge.m_sampler();
+    }
+
+    // the exposition format wants the samples of a metric next to each other
+    std::sort(gauges.begin(), gauges.end(), [](const Gauge& a, const Gauge& b)
+    {
+        return a.m_name != b.m_name ? a.m_name < b.m_name : a.m_labels < b.m_labels;
+    });
+
+    if (s_toLog)
+    {
+        for (const auto& gauge : gauges)
+            fprintf(stderr, "Telemetry: %s{%s} %.6g\n", gauge.m_name.c_str(), gauge.m_labels.c_str(), gauge.m_value);
+    }
+
+    if (s_prometheusFile.empty())
+        return;
+
+    // write to a temporary file that replaces the previous one, so that a reader never sees a partial sample
+    try
+    {
+        std::wstring tempFile = s_prometheusFile + L".tmp";
+        FILE* f = fopenOrDie(tempFile, L"w");
+        for (size_t i = 0; i < gauges.size(); i++)
+        {
+            const auto& gauge = gauges[i];
+            if (i == 0 || gauge.m_name != gauges[i - 1].m_name)
+            {
+                if (!gauge.m_help.empty())
+                    fprintf(f, "# HELP %s %s\n", gauge.m_name.c_str(), gauge.m_help.c_str());
+                fprintf(f, "# TYPE %s gauge\n", gauge.m_name.c_str());
+            }
+            fprintf(f, "%s", gauge.m_name.c_str());
+            if (!gauge.m_labels.empty())
+                fprintf(f, "{%s}", gauge.m_labels.c_str());
+            if (std::isnan(gauge.m_value))
+                fprintf(f, " NaN\n");
+            else
+                fprintf(f, " %.17g\n", gauge.m_value);
+        }
+        fcloseOrDie(f);
+        renameOrDie(tempFile, s_prometheusFile);
+    }
+    catch (const std::exception& e)
+    {
+        // telemetry must not stop the training
+        fprintf(stderr, "Telemetry: failed to write %ls: %s\n", s_prometheusFile.c_str(), e.what());
+    }
+}
+
+}}}
@@ -0,0 +1,71 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE.md file in the project root for full license information.
+//
+// Telemetry.h -- gauges sampled periodically on a background thread, logged and written as a Prometheus text file
+//
+
+#pragma once
+
+#include "CommonMatrix.h" // for MATH_API
+#include <string>
+#include <functional>
+#include <map>
+#include <mutex>
+#include <atomic>
+#include <thread>
+#include <condition_variable>
+
+namespace Microsoft { namespace MSR { namespace CNTK {
+
+// Samples the registered gauges every period on a background thread, and logs them to stderr and/or
+// writes them in the Prometheus text exposition format to a file, which is replaced atomically at every
+// sample, so that a node_exporter textfile collector (or anything else polling the file) can scrape it.
+// A gauge either has a sampler, which runs on the telemetry thread and thus must be thread-safe, or holds
+// the last value Set() by the thread that owns the measured state, e.g. the training loop or the reader.
+// Gauges are identified by their name and labels, e.g. "cntk_gpu_memory_used_bytes" and "device=\"0\"".
+class MATH_API Telemetry
+{
+public:
+    typedef std::function<double()> Sampler;
+
+    // starts the sampling thread; no-op if the period is not positive
+    static void Start(double periodInSeconds, bool toLog, const std::wstring& prometheusFile);
+    // stops the sampling thread, after a last sample
+    static void Stop();
+    static bool IsEnabled();
+
+    // (re-)registers a gauge with a sampler; returns an id for RemoveGauge()
+    static size_t AddGauge(const std::string& name, const std::string& labels, const std::string& help, Sampler&& sampler);
+    static void RemoveGauge(size_t id);
+
+    // sets the value of a gauge, registering it on first use; no-op if telemetry is not enabled
+    static void Set(const std::string& name, const std::string& labels, const std::string& help, double value);
+
+private:
+    struct Gauge
+    {
+        std::string m_name;
+        std::string m_labels;
+        std::string m_help;
+        Sampler m_sampler; // empty for gauges that are Set()
+        double m_value;
+    };
+
+    static void Run();
+    static void Sample();
+    static size_t FindOrAddGauge(const std::string& name, const std::string& labels, const std::string& help); // expects s_mutex to be held
+
+    static std::atomic<bool> s_enabled;
+    static std::mutex s_mutex;
+    static std::condition_variable s_stopRequested;
+    static bool s_stop;
+    static std::thread s_thread;
+    static double s_periodInSeconds;
+    static bool s_toLog;
+    static std::wstring s_prometheusFile;
+    static std::map<size_t, Gauge> s_gauges;
+    static size_t s_nextGaugeId;
+};
+
+}}}
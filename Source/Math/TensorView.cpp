@@ -310,6 +310,19 @@ static void FlattenToMatrix(TensorShape& shape, bool trans, size_t splitPoint)
     shape.FlattenTo2DInPlace(splitPoint, "DoMatrixProductOf");
 }
 
+// A flattened [I x J] tensor with strides [J, 1] is a transposed view of a dense [J x I] matrix, e.g. the weights read
+// through a TransposeDimensions that TimesNodeBase absorbed (see SetTransposedArgument()). GEMM can read the dense
+// matrix with the opposite transposition flag, so turn the view into that instead of failing in AsMatrix().
+static void UntransposeMatrixView(TensorShape& shape, bool& trans)
+{
+    let& strides = shape.GetStrides();
+    if (shape[0] != 1 && shape[1] != 1 && strides[0] == (ptrdiff_t)shape[1] && strides[1] == 1)
+    {
+        shape.SwapDimsInPlace(0, 1);
+        trans = !trans;
+    }
+}
+
 // convert tensor into a Matrix object
 template <class ElemType>
 shared_ptr<Matrix<ElemType>> TensorView<ElemType>::AsMatrix() const
@@ -352,7 +365,7 @@ shared_ptr<Matrix<ElemType>> TensorView<ElemType>::AsMatrix() const
 }
 
 template <class ElemType>
-void TensorView<ElemType>::DoMatrixProductOf(ElemType beta, bool transC, const TensorView& a, bool transA, const TensorView& b, bool transB, ElemType alpha, shared_ptr<QuantizedMultiplier<ElemType>> pQuantizedMultiplier)
+void TensorView<ElemType>::DoMatrixProductOf(ElemType beta, bool transC, const TensorView& a, bool transA, const TensorView& b, bool transB, ElemType alpha, shared_ptr<QuantizedMultiplier<ElemType>> pQuantizedMultiplier, shared_ptr<PackedGemmMatrix<ElemType>> pPackedA)
 {
     // determine integration dimension offset
     auto shapeA = a.m_shape;
@@ -377,17 +390,68 @@ void TensorView<ElemType>::DoMatrixProductOf(ElemType beta, bool transC, const T
     {
         InvalidArgument("DoMatrixProductOf: Flattened tensor dimensions %s mismatch.", MatrixProductFormat(shapeA, transA, shapeB, transB, shapeC, transC).c_str());
     }
+    // fold transposed views into the transposition flags
+    UntransposeMatrixView(shapeA, transA);
+    UntransposeMatrixView(shapeB, transB);
+    UntransposeMatrixView(shapeC, transC);
     // create Matrix objects out of this
     let  A = a.Reshaped(shapeA).AsMatrix();
     let  B = b.Reshaped(shapeB).AsMatrix();
     auto C =   Reshaped(shapeC).AsMatrix();
     // and go
     if (!transC)
-        Matrix<ElemType>::MultiplyAndWeightedAdd(alpha, *A, transA, *B, transB, beta, *C, pQuantizedMultiplier);
+        Matrix<ElemType>::MultiplyAndWeightedAdd(alpha, *A, transA, *B, transB, beta, *C, pQuantizedMultiplier, pPackedA);
     else // C' = A * B  <==>  C = (A * B)' = B' * A'
         Matrix<ElemType>::MultiplyAndWeightedAdd(alpha, *B, !transB, *A, !transA, beta, *C, pQuantizedMultiplier);
 }
 
+// number of rows of the matrix that a tensor is flattened to by FlattenToMatrix(); the dimensions [0, rank) must be dense
+static size_t FlattenedRows(const TensorShape& shape, size_t rank, bool trans, size_t splitPoint)
+{
+    if (trans)
+        splitPoint = rank - splitPoint;
+    size_t rows = 1;
+    for (size_t k = 0; k < splitPoint; k++)
+        rows *= shape[k];
+    return rows;
+}
+
+template <class ElemType>
+void TensorView<ElemType>::DoBatchMatrixProductOf(ElemType beta, const TensorView& a, bool transA, const TensorView& b, bool transB, ElemType alpha, size_t numBatchAxes)
+{
+    // the sample part of each tensor is a matrix as in DoMatrixProductOf(); the batch axes are flattened into the columns of a Matrix
+    auto shapeA = a.m_shape;
+    auto shapeB = b.m_shape;
+    auto shapeC =   m_shape;
+    if (shapeA.GetRank() < numBatchAxes || shapeB.GetRank() < numBatchAxes || shapeC.GetRank() < numBatchAxes)
+        InvalidArgument("DoBatchMatrixProductOf: Ranks %s must include %d batch axes.", MatrixProductFormat(shapeA, transA, shapeB, transB, shapeC, false).c_str(), (int)numBatchAxes);
+    let rankA = shapeA.GetRank() - numBatchAxes;
+    let rankB = shapeB.GetRank() - numBatchAxes;
+    let rankC = shapeC.GetRank() - numBatchAxes;
+    if (rankA + rankB < rankC || (rankA + rankB - rankC) % 2 != 0)
+        InvalidArgument("DoBatchMatrixProductOf: Ranks %s mismatch.", MatrixProductFormat(shapeA, transA, shapeB, transB, shapeC, false).c_str());
+    let numReducedDims = (rankA + rankB - rankC) / 2;
+    let firstReducedDim = rankA - numReducedDims;
+    for (size_t k = 0; k < numBatchAxes; k++)
+    {
+        let dimC = shapeC[rankC + k];
+        if ((shapeA[rankA + k] != dimC && shapeA[rankA + k] != 1) || (shapeB[rankB + k] != dimC && shapeB[rankB + k] != 1))
+            InvalidArgument("DoBatchMatrixProductOf: Batch axes %s mismatch.", MatrixProductFormat(shapeA, transA, shapeB, transB, shapeC, false).c_str());
+    }
+    let aRows = FlattenedRows(shapeA, rankA, transA, firstReducedDim);
+    let bRows = FlattenedRows(shapeB, rankB, transB, numReducedDims);
+    // one column per product
+    shapeA.FlattenTo2DInPlace(rankA, "DoBatchMatrixProductOf");
+    shapeB.FlattenTo2DInPlace(rankB, "DoBatchMatrixProductOf");
+    shapeC.FlattenTo2DInPlace(rankC, "DoBatchMatrixProductOf");
+    if ((shapeA[1] != shapeC[1] && shapeA[1] != 1) || (shapeB[1] != shapeC[1] && shapeB[1] != 1))
+        InvalidArgument("DoBatchMatrixProductOf: Batch axes %s must be equal or all 1.", MatrixProductFormat(a.m_shape, transA, b.m_shape, transB, m_shape, false).c_str());
+    let  A = a.Reshaped(shapeA).AsMatrix();
+    let  B = b.Reshaped(shapeB).AsMatrix();
+    auto C =   Reshaped(shapeC).AsMatrix();
+    Matrix<ElemType>::BatchMultiplyAndWeightedAdd(alpha, *A, aRows, transA, *B, bRows, transB, beta, *C);
+}
+
 template class TensorView<float>;
 template class TensorView<double>;
 
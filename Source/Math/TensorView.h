@@ -144,10 +144,21 @@ public:
     // If beta == 0, c is not read out, i.e. it can be uninitialized or contain NaNs.
     // -------------------------------------------------------------------
 
-    void DoMatrixProductOf(ElemType beta, bool transC, const TensorView& a, bool transA, const TensorView& b, bool transB, ElemType alpha, shared_ptr<QuantizedMultiplier<ElemType>> pQuantizedMultiplier = nullptr);
-    void AssignMatrixProductOf(           bool transC, const TensorView& a, bool transA, const TensorView& b, bool transB, ElemType alpha = 1.0f, shared_ptr<QuantizedMultiplier<ElemType>> pQuantizedMultiplier = nullptr) { DoMatrixProductOf(0, transC, a, transA, b, transB, alpha, pQuantizedMultiplier); }
+    void DoMatrixProductOf(ElemType beta, bool transC, const TensorView& a, bool transA, const TensorView& b, bool transB, ElemType alpha, shared_ptr<QuantizedMultiplier<ElemType>> pQuantizedMultiplier = nullptr, shared_ptr<PackedGemmMatrix<ElemType>> pPackedA = nullptr);
+    void AssignMatrixProductOf(           bool transC, const TensorView& a, bool transA, const TensorView& b, bool transB, ElemType alpha = 1.0f, shared_ptr<QuantizedMultiplier<ElemType>> pQuantizedMultiplier = nullptr, shared_ptr<PackedGemmMatrix<ElemType>> pPackedA = nullptr) { DoMatrixProductOf(0, transC, a, transA, b, transB, alpha, pQuantizedMultiplier, pPackedA); }
     void AddMatrixProductOf   (           bool transC, const TensorView& a, bool transA, const TensorView& b, bool transB, ElemType alpha = 1.0f) { DoMatrixProductOf(1.0f, transC, a, transA, b, transB, alpha); }
 
+    // -------------------------------------------------------------------
+    // batched matrix product -- one independent matrix product per index of the trailing 'numBatchAxes' axes
+    // [I x J x K x S x T] * [K x M x S x T] -> [I x J x M x S x T] reducing over K, with batch axes (S,T)
+    // The batch axes of a or b may all be 1, to use the same matrix in all products.
+    // Each operand must be dense as a whole, e.g. a column range of a minibatch.
+    // -------------------------------------------------------------------
+
+    void DoBatchMatrixProductOf(ElemType beta, const TensorView& a, bool transA, const TensorView& b, bool transB, ElemType alpha, size_t numBatchAxes);
+    void AssignBatchMatrixProductOf(           const TensorView& a, bool transA, const TensorView& b, bool transB, size_t numBatchAxes) { DoBatchMatrixProductOf(0,    a, transA, b, transB, 1.0f, numBatchAxes); }
+    void AddBatchMatrixProductOf   (           const TensorView& a, bool transA, const TensorView& b, bool transB, size_t numBatchAxes) { DoBatchMatrixProductOf(1.0f, a, transA, b, transB, 1.0f, numBatchAxes); }
+
     shared_ptr<Matrix<ElemType>> AsMatrix() const;
     const TensorShape& GetShape() const { return m_shape; }
 
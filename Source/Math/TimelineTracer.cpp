@@ -0,0 +1,205 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE.md file in the project root for full license information.
+//
+// TimelineTracer.cpp -- in-process timeline of scoped events, written as a Chrome trace-event file
+//
+
+#define _CRT_SECURE_NO_WARNINGS
+
+#include "stdafx.h"
+#include "TimelineTracer.h"
+#include "fileutil.h"
+#include <chrono>
+#include <set>
+
+namespace Microsoft { namespace MSR { namespace CNTK {
+
+// beyond these the events are dropped, to bound the memory used by a trace that runs for too long
+static const size_t s_maxNumEvents = 1 << 22;
+// beyond these the pending GPU events are resolved, which waits for the GPU
+static const size_t s_maxNumPendingGPUEvents = 1 << 14;
+
+static std::chrono::steady_clock::time_point s_startTime;
+static std::atomic<int> s_numThreads(0);
+
+std::atomic<bool> TimelineTracer::s_enabled(false);
+std::mutex TimelineTracer::s_mutex;
+std::wstring TimelineTracer::s_path;
+std::vector<TimelineTracer::Event> TimelineTracer::s_events;
+std::vector<TimelineTracer::PendingGPUEvent> TimelineTracer::s_pendingGPUEvents;
+std::map<DEVICEID_TYPE, TimelineTracer::GPUReference> TimelineTracer::s_gpuReferences;
+size_t TimelineTracer::s_numDroppedEvents = 0;
+
+/*static*/ void TimelineTracer::Start(const std::wstring& path)
+{
+    std::lock_guard<std::mutex> lock(s_mutex);
+    if (s_enabled)
+        LogicError("TimelineTracer: Tracing has already been started.");
+
+    s_path = path;
+    s_events.clear();
+    s_numDroppedEvents = 0;
+    s_startTime = std::chrono::steady_clock::now();
+    s_enabled = true;
+    fprintf(stderr, "Starting timeline trace to %ls\n", path.c_str());
+}
+
+/*static*/ bool TimelineTracer::IsEnabled()
+{
+    return s_enabled.load(std::memory_order_relaxed);
+}
+
+/*static*/ long long TimelineTracer::NowMicroseconds()
+{
+    return std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - s_startTime).count();
+}
+
+/*static*/ int TimelineTracer::CurrentThreadIndex()
+{
+    static THREAD_LOCAL int threadIndex = -1;
+    if (threadIndex < 0)
+        threadIndex = s_numThreads++;
+    return threadIndex;
+}
+
+/*static*/ void TimelineTracer::AddEvent(Event&& event)
+{
+    if (s_events.size() < s_maxNumEvents)
+        s_events.push_back(std::move(event));
+    else
+        s_numDroppedEvents++;
+}
+
+/*static*/ void TimelineTracer::AddCPUEvent(const char* category, const std::string& name, long long beginMicroseconds, long long endMicroseconds)
+{
+    int threadIndex = CurrentThreadIndex();
+    std::lock_guard<std::mutex> lock(s_mutex);
+    if (!s_enabled)
+        return;
+    AddEvent(Event{ name, category, beginMicroseconds, endMicroseconds - beginMicroseconds, 0, threadIndex });
+}
+
+/*static*/ void* TimelineTracer::BeginGPUEvent(DEVICEID_TYPE deviceId)
+{
+    if (deviceId < 0)
+        return nullptr;
+
+    {
+        std::lock_guard<std::mutex> lock(s_mutex);
+        if (!s_enabled)
+            return nullptr;
+        if (s_gpuReferences.find(deviceId) == s_gpuReferences.end())
+        {
+            // wait for the reference event, so that its completion is about now on the CPU clock
+            void* reference = RecordGPUEvent(deviceId);
+            GPUEventElapsedMilliseconds(reference, reference);
+            s_gpuReferences[deviceId] = GPUReference{ reference, NowMicroseconds() };
+        }
+    }
+    return RecordGPUEvent(deviceId);
+}
+
+/*static*/ void TimelineTracer::EndGPUEvent(const char* category, const std::string& name, DEVICEID_TYPE deviceId, void* beginEvent)
+{
+    void* endEvent = RecordGPUEvent(deviceId);
+    std::lock_guard<std::mutex> lock(s_mutex);
+    if (!s_enabled) // stopped within the event
+    {
+        DestroyGPUEvent(beginEvent);
+        DestroyGPUEvent(endEvent);
+        return;
+    }
+    s_pendingGPUEvents.push_back(PendingGPUEvent{ name, category, deviceId, beginEvent, endEvent });
+    if (s_pendingGPUEvents.size() >= s_maxNumPendingGPUEvents)
+        ResolveGPUEvents();
+}
+
+/*static*/ void TimelineTracer::ResolveGPUEvents()
+{
+    for (auto& pending : s_pendingGPUEvents)
+    {
+        const auto& reference = s_gpuReferences.at(pending.m_deviceId);
+        float beginMilliseconds = GPUEventElapsedMilliseconds(reference.m_event, pending.m_begin);
+        float durationMilliseconds = GPUEventElapsedMilliseconds(pending.m_begin, pending.m_end);
+        if (s_enabled)
+        {
+            AddEvent(Event{ std::move(pending.m_name), pending.m_category,
+                            reference.m_time + (long long) (beginMilliseconds * 1000), (long long) (durationMilliseconds * 1000),
+                            1 + pending.m_deviceId, 0 });
+        }
+        DestroyGPUEvent(pending.m_begin);
+        DestroyGPUEvent(pending.m_end);
+    }
+    s_pendingGPUEvents.clear();
+}
+
+// escapes a string for inclusion in JSON
+static std::string JsonEscape(const std::string& s)
+{
+    std::string result;
+    result.reserve(s.size());
+    for (char c : s)
+    {
+        if (c == '"' || c == '\\')
+        {
+            result += '\\';
+            result += c;
+        }
+        else if ((unsigned char) c < 0x20)
+        {
+            char buffer[8];
+            sprintf(buffer, "\\u%04x", (int) (unsigned char) c);
+            result += buffer;
+        }
+        else
+            result += c;
+    }
+    return result;
+}
+
+/*static*/ void TimelineTracer::Stop()
+{
+    std::lock_guard<std::mutex> lock(s_mutex);
+    if (!s_enabled)
+        return;
+
+    ResolveGPUEvents();
+    s_enabled = false;
+
+    FILE* f = fopenOrDie(s_path, L"w");
+    fprintf(f, "{\"displayTimeUnit\": \"ms\", \"traceEvents\": [\n");
+
+    // names of the rows in the viewer
+    std::set<int> pids;
+    for (const auto& event : s_events)
+        pids.insert(event.m_pid);
+    for (int pid : pids)
+    {
+        fprintf(f, "{\"name\": \"process_name\", \"ph\": \"M\", \"pid\": %d, \"args\": {\"name\": \"%s%s\"}},\n",
+                pid, pid == 0 ? "CPU" : "GPU ", pid == 0 ? "" : std::to_string(pid - 1).c_str());
+    }
+
+    for (size_t i = 0; i < s_events.size(); i++)
+    {
+        const auto& event = s_events[i];
+        fprintf(f, "{\"name\": \"%s\", \"cat\": \"%s\", \"ph\": \"X\", \"ts\": %lld, \"dur\": %lld, \"pid\": %d, \"tid\": %d}%s\n",
+                JsonEscape(event.m_name).c_str(), event.m_category, event.m_begin, event.m_duration, event.m_pid, event.m_tid,
+                i + 1 < s_events.size() ? "," : "");
+    }
+    fprintf(f, "]}\n");
+    fcloseOrDie(f);
+
+    fprintf(stderr, "Stopping timeline trace: %d events written to %ls", (int) s_events.size(), s_path.c_str());
+    if (s_numDroppedEvents > 0)
+        fprintf(stderr, ", %d more dropped", (int) s_numDroppedEvents);
+    fprintf(stderr, "\n");
+
+    s_events.clear();
+    s_events.shrink_to_fit();
+    for (auto& reference : s_gpuReferences)
+        DestroyGPUEvent(reference.second.m_event);
+    s_gpuReferences.clear();
+}
+
+}}}
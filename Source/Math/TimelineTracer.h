@@ -0,0 +1,136 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE.md file in the project root for full license information.
+//
+// TimelineTracer.h -- in-process timeline of scoped events, written as a Chrome trace-event file
+//
+
+#pragma once
+
+#include "CommonMatrix.h" // for MATH_API, DEVICEID_TYPE
+#include <string>
+#include <vector>
+#include <map>
+#include <mutex>
+#include <atomic>
+
+namespace Microsoft { namespace MSR { namespace CNTK {
+
+// Records begin and duration of named events per CPU thread, and of the GPU work queued within
+// them (timed with CUDA events on the current stream), and writes them as a trace-event JSON file that
+// chrome://tracing or https://ui.perfetto.dev can show. Use it through TimelineEvent below.
+// The GPU timestamps are put on the CPU clock through one CUDA event per device recorded at its first use.
+// GPU events are resolved when the trace is written (or when many of them are pending), which waits for them.
+class MATH_API TimelineTracer
+{
+public:
+    // starts recording; the trace is written to 'path' by Stop()
+    static void Start(const std::wstring& path);
+    // stops recording and writes the trace file
+    static void Stop();
+    static bool IsEnabled();
+
+    // microseconds since the process started tracing
+    static long long NowMicroseconds();
+
+    static void AddCPUEvent(const char* category, const std::string& name, long long beginMicroseconds, long long endMicroseconds);
+
+    // returns a CUDA event for the current stream of the device, nullptr for the CPU
+    static void* BeginGPUEvent(DEVICEID_TYPE deviceId);
+    static void EndGPUEvent(const char* category, const std::string& name, DEVICEID_TYPE deviceId, void* beginEvent);
+
+private:
+    struct Event
+    {
+        std::string m_name;
+        const char* m_category;
+        long long m_begin;
+        long long m_duration;
+        int m_pid; // 0 for CPU threads, 1 + device id for GPUs
+        int m_tid;
+    };
+
+    struct PendingGPUEvent
+    {
+        std::string m_name;
+        const char* m_category;
+        DEVICEID_TYPE m_deviceId;
+        void* m_begin;
+        void* m_end;
+    };
+
+    // the CUDA event a device's timestamps are measured from, and when it completed on the CPU clock
+    struct GPUReference
+    {
+        void* m_event;
+        long long m_time;
+    };
+
+    static void AddEvent(Event&& event);
+    static void ResolveGPUEvents(); // expects s_mutex to be held
+    static int CurrentThreadIndex();
+
+    // implemented in GPUMatrix.cu, and as no-ops in NoGPU.cpp
+    static void* RecordGPUEvent(DEVICEID_TYPE deviceId);
+    static float GPUEventElapsedMilliseconds(void* from, void* to); // waits for 'to'
+    static void DestroyGPUEvent(void* event);
+
+    static std::atomic<bool> s_enabled;
+    static std::mutex s_mutex;
+    static std::wstring s_path;
+    static std::vector<Event> s_events;
+    static std::vector<PendingGPUEvent> s_pendingGPUEvents;
+    static std::map<DEVICEID_TYPE, GPUReference> s_gpuReferences;
+    static size_t s_numDroppedEvents;
+};
+
+// Adds an event for the lifetime of the object to the timeline, if tracing is enabled.
+// Pass the device the work in the scope runs on to also get an event for its GPU work.
+class TimelineEvent
+{
+public:
+    TimelineEvent(const char* category, const char* name, DEVICEID_TYPE deviceId = CPUDEVICE)
+        : m_enabled(TimelineTracer::IsEnabled())
+    {
+        if (m_enabled)
+            Begin(category, name, deviceId);
+    }
+
+    TimelineEvent(const char* category, const std::wstring& name, DEVICEID_TYPE deviceId = CPUDEVICE)
+        : m_enabled(TimelineTracer::IsEnabled())
+    {
+        if (m_enabled)
+            Begin(category, msra::strfun::utf8(name), deviceId);
+    }
+
+    ~TimelineEvent()
+    {
+        if (!m_enabled)
+            return;
+        if (m_gpuBegin)
+            TimelineTracer::EndGPUEvent(m_category, m_name, m_deviceId, m_gpuBegin);
+        TimelineTracer::AddCPUEvent(m_category, m_name, m_begin, TimelineTracer::NowMicroseconds());
+    }
+
+private:
+    TimelineEvent(const TimelineEvent&) = delete;
+    TimelineEvent& operator=(const TimelineEvent&) = delete;
+
+    void Begin(const char* category, std::string&& name, DEVICEID_TYPE deviceId)
+    {
+        m_category = category;
+        m_name = std::move(name);
+        m_deviceId = deviceId;
+        m_gpuBegin = TimelineTracer::BeginGPUEvent(deviceId);
+        m_begin = TimelineTracer::NowMicroseconds();
+    }
+
+    bool m_enabled;
+    const char* m_category;
+    std::string m_name;
+    DEVICEID_TYPE m_deviceId;
+    void* m_gpuBegin;
+    long long m_begin;
+};
+
+}}}
@@ -24,7 +24,7 @@ void BinaryChunkDeserializer::ReadOffsetsTable(FILE* infile)
 void BinaryChunkDeserializer::ReadOffsetsTable(FILE* infile, size_t startOffset, size_t numChunks)
 {
     assert((int64_t)(startOffset + numChunks) <= m_numChunks);
-    size_t startPos = startOffset * sizeof(DiskOffsetsTable) + m_offsetStart;
+    size_t startPos = startOffset * m_offsetsEntrySize + m_offsetStart;
 
     // Seek to the offsets table start
     CNTKBinaryFileHelper::seekOrDie(infile, startPos, SEEK_SET);
@@ -32,27 +32,48 @@ void BinaryChunkDeserializer::ReadOffsetsTable(FILE* infile, size_t startOffset,
     // Note we create numChunks + 1 since we want to be consistent with determining the size of each chunk.
     DiskOffsetsTable* offsetsTable = new DiskOffsetsTable[numChunks + 1];
 
-    // Read in all of the offsets for the chunks of interest
-    CNTKBinaryFileHelper::readOrDie(offsetsTable, sizeof(DiskOffsetsTable), numChunks, infile);
+    // Read in all of the offsets for the chunks of interest, plus the next entry if it exists.
+    bool hasNextEntry = (int64_t)(startOffset + numChunks) < m_numChunks;
+    size_t numEntries = numChunks + (hasNextEntry ? 1 : 0);
+    if (m_offsetsEntrySize == sizeof(DiskOffsetsTable))
+        CNTKBinaryFileHelper::readOrDie(offsetsTable, sizeof(DiskOffsetsTable), numEntries, infile);
+    else
+    {
+        // Older entries lack the compression fields.
+        vector<char> entries(numEntries * m_offsetsEntrySize);
+        CNTKBinaryFileHelper::readOrDie(entries.data(), m_offsetsEntrySize, numEntries, infile);
+        for (size_t c = 0; c < numEntries; c++)
+        {
+            memcpy(offsetsTable + c, entries.data() + c * m_offsetsEntrySize, m_offsetsEntrySize);
+            offsetsTable[c].compression = (int32_t)ChunkCompression::None;
+        }
+    }
 
-    // Now read the final entry. It is either the next offset entry (if we're reading a subset and the
+    // The final entry is either the next offset entry (if we're reading a subset and the
     // entry exists), or we just fill it with the correct information based on file size if it doesn't
-    if ((int64_t)(startOffset + numChunks) == m_numChunks)
+    if (!hasNextEntry)
     {
         CNTKBinaryFileHelper::seekOrDie(infile, 0, SEEK_END);
         offsetsTable[numChunks].offset = CNTKBinaryFileHelper::tellOrDie(infile) - m_dataStart;
         offsetsTable[numChunks].numSamples = 0;
         offsetsTable[numChunks].numSequences = 0;
+        offsetsTable[numChunks].compression = (int32_t)ChunkCompression::None;
+        offsetsTable[numChunks].uncompressedSize = 0;
+    }
+
+    // Uncompressed chunks have the size they take in the file.
+    for (size_t c = 0; c < numChunks; c++)
+    {
+        if (offsetsTable[c].compression == (int32_t)ChunkCompression::None)
+            offsetsTable[c].uncompressedSize = offsetsTable[c + 1].offset - offsetsTable[c].offset;
     }
-    else
-        CNTKBinaryFileHelper::readOrDie(offsetsTable + numChunks, sizeof(DiskOffsetsTable), 1, infile);
 
     m_offsetsTable = make_unique<OffsetsTable>(numChunks, offsetsTable);
 
 }
 
 BinaryChunkDeserializer::BinaryChunkDeserializer(const BinaryConfigHelper& helper) :
-    BinaryChunkDeserializer(helper.GetFilePath())
+    BinaryChunkDeserializer(helper.GetFilePath(), helper.ShouldUseMemoryMapping())
 {
     SetTraceLevel(helper.GetTraceLevel());
 
@@ -60,12 +81,15 @@ BinaryChunkDeserializer::BinaryChunkDeserializer(const BinaryConfigHelper& helpe
 }
 
 
-BinaryChunkDeserializer::BinaryChunkDeserializer(const std::wstring& filename) : 
+BinaryChunkDeserializer::BinaryChunkDeserializer(const std::wstring& filename, bool useMemoryMapping) : 
     m_filename(filename),
     m_file(nullptr),
     m_offsetStart(0),
     m_dataStart(0),
-    m_traceLevel(0)
+    m_fileVersionNumber(0),
+    m_offsetsEntrySize(sizeof(DiskOffsetsTable)),
+    m_traceLevel(0),
+    m_useMemoryMapping(useMemoryMapping)
 {
 }
 
@@ -85,11 +109,12 @@ void BinaryChunkDeserializer::Initialize(const std::map<std::wstring, std::wstri
     // We are now parsing the header. Seek to the head of the header to start.
     CNTKBinaryFileHelper::seekOrDie(m_file, 0, SEEK_SET);
 
-    // First read the version number of the data file, and make sure the reader version is the same.
-    int64_t versionNumber;
-    CNTKBinaryFileHelper::readOrDie(&versionNumber, sizeof(versionNumber), 1, m_file);
-    if (versionNumber != m_versionNumber)
-        LogicError("The reader version is %d, but the data file was created for version %d.", (int)m_versionNumber, (int)versionNumber);
+    // First read the version number of the data file, and make sure the reader understands it.
+    // Version 2 added the compression of chunks to the offsets table.
+    CNTKBinaryFileHelper::readOrDie(&m_fileVersionNumber, sizeof(m_fileVersionNumber), 1, m_file);
+    if (m_fileVersionNumber < 1 || m_fileVersionNumber > m_versionNumber)
+        LogicError("The reader version is %d, but the data file was created for version %d.", (int)m_versionNumber, (int)m_fileVersionNumber);
+    m_offsetsEntrySize = m_fileVersionNumber == 1 ? DiskOffsetsTableV1Size : sizeof(DiskOffsetsTable);
 
     // Next is the number of chunks in the input file.
     CNTKBinaryFileHelper::readOrDie(&m_numChunks, sizeof(m_numChunks), 1, m_file);
@@ -144,12 +169,15 @@ void BinaryChunkDeserializer::Initialize(const std::map<std::wstring, std::wstri
     m_offsetStart = CNTKBinaryFileHelper::tellOrDie(m_file);
 
     // After the header is the data start. Compute that now.
-    m_dataStart = m_offsetStart + m_numChunks * sizeof(DiskOffsetsTable);
+    m_dataStart = m_offsetStart + m_numChunks * m_offsetsEntrySize;
 
     // We only have to read in the offsets table once, so do that now.
     // Note it's possible in distributed reading mode to only want to read
     // a subset of the offsets table.
     ReadOffsetsTable(m_file);
+
+    if (m_useMemoryMapping)
+        m_mappedFile = make_shared<MappedFile>(m_filename);
 }
 
 ChunkDescriptions BinaryChunkDeserializer::GetChunkDescriptions()
@@ -212,15 +240,17 @@ void BinaryChunkDeserializer::GetSequencesForChunk(ChunkIdType chunkId, std::vec
 
 unique_ptr<byte[]> BinaryChunkDeserializer::ReadChunk(ChunkIdType chunkId)
 {
-    // Seek to the start of the chunk
-    CNTKBinaryFileHelper::seekOrDie(m_file, m_dataStart + m_offsetsTable->GetOffset(chunkId), SEEK_SET);
-
     // Determine how big the chunk is.
     size_t chunkSize = m_offsetsTable->GetChunkSize(chunkId);
-    
+
     // Create buffer
     unique_ptr<byte[]> buffer(new byte[chunkSize]);
 
+    std::lock_guard<std::mutex> lock(m_fileMutex);
+
+    // Seek to the start of the chunk
+    CNTKBinaryFileHelper::seekOrDie(m_file, m_dataStart + m_offsetsTable->GetOffset(chunkId), SEEK_SET);
+
     // Read the chunk from disk
     CNTKBinaryFileHelper::readOrDie(buffer.get(), sizeof(byte), chunkSize, m_file);
 
@@ -230,10 +260,40 @@ unique_ptr<byte[]> BinaryChunkDeserializer::ReadChunk(ChunkIdType chunkId)
 
 ChunkPtr BinaryChunkDeserializer::GetChunk(ChunkIdType chunkId)
 {
-    // Read the chunk into memory
-    unique_ptr<byte[]> chunkBuffer = ReadChunk(chunkId);
+    ChunkCompression compression = m_offsetsTable->GetCompression(chunkId);
+    size_t chunkSize = m_offsetsTable->GetChunkSize(chunkId);
+
+    const char* compressedData = nullptr;
+    unique_ptr<byte[]> chunkBuffer;
+    if (m_mappedFile)
+    {
+        size_t offset = m_dataStart + m_offsetsTable->GetOffset(chunkId);
+        if (offset + chunkSize > m_mappedFile->GetSize())
+            RuntimeError("Chunk %u ends beyond the end of the mapped file.", (unsigned int)chunkId);
+        m_mappedFile->WillNeed(offset, chunkSize);
+
+        // No copy, the chunk refers to the pages of the mapping that are shared through the OS page cache.
+        if (compression == ChunkCompression::None)
+            return make_shared<BinaryDataChunk>(chunkId, m_offsetsTable->GetStartIndex(chunkId), m_offsetsTable->GetNumSequences(chunkId), m_mappedFile, offset, m_deserializers);
+
+        compressedData = (const char*)m_mappedFile->GetData() + offset;
+    }
+    else
+    {
+        // Read the chunk into memory
+        chunkBuffer = ReadChunk(chunkId);
+        if (compression == ChunkCompression::None)
+            return make_shared<BinaryDataChunk>(chunkId, m_offsetsTable->GetStartIndex(chunkId), m_offsetsTable->GetNumSequences(chunkId), std::move(chunkBuffer), m_deserializers);
+
+        compressedData = (const char*)chunkBuffer.get();
+    }
+
+    // Decompressed on the thread loading the chunk, without holding the file lock.
+    size_t uncompressedSize = m_offsetsTable->GetUncompressedSize(chunkId);
+    unique_ptr<byte[]> uncompressed(new byte[uncompressedSize]);
+    CNTKBinaryCompression::Decompress(compression, compressedData, chunkSize, (char*)uncompressed.get(), uncompressedSize);
 
-    return make_shared<BinaryDataChunk>(chunkId, m_offsetsTable->GetStartIndex(chunkId), m_offsetsTable->GetNumSequences(chunkId), std::move(chunkBuffer), m_deserializers);
+    return make_shared<BinaryDataChunk>(chunkId, m_offsetsTable->GetStartIndex(chunkId), m_offsetsTable->GetNumSequences(chunkId), std::move(uncompressed), m_deserializers);
 }
 
 void BinaryChunkDeserializer::SetTraceLevel(unsigned int traceLevel)
@@ -10,6 +10,8 @@
 #include "CorpusDescriptor.h"
 #include "BinaryDataChunk.h"
 #include "BinaryDataDeserializer.h"
+#include "ChunkCompression.h"
+#include <mutex>
 
 namespace Microsoft { namespace MSR { namespace CNTK {
 
@@ -20,9 +22,14 @@ struct DiskOffsetsTable
     int64_t offset;
     int32_t numSequences;
     int32_t numSamples;
+    int32_t compression;      // ChunkCompression of the chunk, since version 2
+    int64_t uncompressedSize; // size of the chunk after decompression, since version 2
 };
 #pragma pack(pop)
 
+// Files of version 1 store only the first three fields of each entry, their chunks are not compressed.
+static const size_t DiskOffsetsTableV1Size = sizeof(int64_t) + 2 * sizeof(int32_t);
+
     // Offsets table used to find the chunks in the binary file. Added some helper methods around the core data.
 class OffsetsTable {
 public:
@@ -38,6 +45,8 @@ public:
     int32_t GetNumSamples(size_t index) { return (*m_diskOffsetsTable)[index].numSamples; }
     int64_t GetStartIndex(size_t index) { return m_startIndex[index]; }
     size_t GetChunkSize(size_t index) { return (*m_diskOffsetsTable)[index + 1].offset - (*m_diskOffsetsTable)[index].offset; }
+    ChunkCompression GetCompression(size_t index) { return (ChunkCompression)(*m_diskOffsetsTable)[index].compression; }
+    size_t GetUncompressedSize(size_t index) { return (size_t)(*m_diskOffsetsTable)[index].uncompressedSize; }
 
 private:
     void Initialize()
@@ -85,10 +94,10 @@ private:
     void ReadOffsetsTable(FILE* infile, size_t startOffset, size_t numChunks);
     void ReadOffsetsTable(FILE* infile);
 
-    // Reads a chunk from disk into buffer
+    // Reads a chunk from disk into buffer, as it is stored (possibly compressed).
     unique_ptr<byte[]> ReadChunk(ChunkIdType chunkId);
 
-    BinaryChunkDeserializer(const wstring& filename);
+    BinaryChunkDeserializer(const wstring& filename, bool useMemoryMapping = false);
 
     void SetTraceLevel(unsigned int traceLevel);
 
@@ -96,6 +105,9 @@ private:
     const wstring m_filename;
     FILE* m_file;
 
+    // If set, chunks are not read but point directly into this mapping of the file.
+    MappedFilePtr m_mappedFile;
+
     int64_t m_offsetStart;
     int64_t m_dataStart;
 
@@ -104,11 +116,20 @@ private:
     OffsetsTablePtr m_offsetsTable;
     void* m_chunkBuffer;
 
-    int64_t m_versionNumber = 1;
+    // Newest version the reader understands, and the version of the file.
+    int64_t m_versionNumber = 2;
+    int64_t m_fileVersionNumber;
+
+    // Size of an offsets table entry in the file.
+    size_t m_offsetsEntrySize;
     int64_t m_numChunks;
     int32_t m_numInputs;
     
     unsigned int m_traceLevel;
+    bool m_useMemoryMapping;
+
+    // Chunks are loaded from several threads (see BlockRandomizer), they share m_file.
+    std::mutex m_fileMutex;
 
     friend class CNTKBinaryReaderTestRunner;
 
@@ -0,0 +1,289 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE.md file in the project root for full license information.
+//
+
+#pragma once
+
+#include <string>
+#include <vector>
+#include "FileHelper.h"
+#include "BinaryChunkDeserializer.h"
+#include "ChunkCompression.h"
+
+namespace Microsoft { namespace MSR { namespace CNTK {
+
+// Writes a file in the format read by BinaryChunkDeserializer:
+//   header: int64_t version, int64_t number of chunks, int32_t number of inputs, then for each input
+//     int32_t name length, the name, int32_t deserializer type (0 dense, 1 sparse) followed by
+//       dense:  int32_t element type, int32_t dimension
+//       sparse: int32_t storage type (0 is csc), int32_t element type, int32_t is sequence, int32_t dimension
+//   offsets table: a DiskOffsetsTable per chunk, the offsets are relative to the end of the table.
+//     Version 1 entries end after numSamples, version 2 entries add the compression and uncompressed size.
+//   chunks: for the sequences of the chunk, the data of all inputs, one input after the other
+//     dense:  ElemType[numSequences * dimension], for Int8 float scale, int8_t[numSequences * dimension]
+//     sparse: int32_t nnz, ElemType[nnz] values, int32_t[nnz] sample * dimension + row,
+//             int32_t[numSequences + 1] offsets of the sequences into the values
+// The number of chunks has to be known upfront. The header is written again on Close(),
+// so that inputs can still be marked as sequences while the chunks are written.
+// Without compression version 1 files are written, so that older readers can still read them.
+class BinaryChunkWriter
+{
+public:
+    // Have to be understood by BinaryChunkDeserializer.
+    static const int64_t VersionNumber = 1;
+    static const int64_t CompressedVersionNumber = 2;
+
+    struct Input
+    {
+        std::string m_name;
+        StorageType m_storageType;
+        BinaryElementType m_elementType;
+        size_t m_dimension;
+        bool m_isSequence;
+    };
+
+    // 'compressionLevel' is passed to the codec, currently only Zstd uses it.
+    BinaryChunkWriter(const std::wstring& filename, const std::vector<Input>& inputs, size_t numChunks,
+                      ChunkCompression compression = ChunkCompression::None, int compressionLevel = 0)
+        : m_filename(filename), m_inputs(inputs), m_offsetsTable(numChunks), m_numChunksWritten(0), m_offset(0),
+          m_compression(compression), m_compressionLevel(compressionLevel)
+    {
+        if (!CNTKBinaryCompression::IsSupported(m_compression))
+            InvalidArgument("Chunk compression '%s' is not supported by this build of CNTK.", CNTKBinaryCompression::GetName(m_compression));
+
+        for (const auto& input : m_inputs)
+        {
+            if (input.m_storageType != StorageType::dense && input.m_storageType != StorageType::sparse_csc)
+                InvalidArgument("Input '%s' has a storage type that the binary format does not support.", input.m_name.c_str());
+            if ((input.m_elementType == BinaryElementType::Half || input.m_elementType == BinaryElementType::Int8) && input.m_storageType != StorageType::dense)
+                InvalidArgument("Input '%s' is sparse; only dense inputs can be stored in half precision or int8.", input.m_name.c_str());
+        }
+
+        m_file = CNTKBinaryFileHelper::openOrDie(filename, L"wb");
+        WriteHeader();
+    }
+
+    ~BinaryChunkWriter()
+    {
+        if (m_file)
+            fclose(m_file);
+    }
+
+    // Serializes the sequences of a chunk, 'sequences[i][j]' being the data of input j of sequence i.
+    // 'hasMultipleSamples[j]' is set if a sequence of input j has more than one sample.
+    // The buffer is compressed with the codec of the writer, the size before compression is returned.
+    // Can be called from several threads at once.
+    template <class ElemType>
+    size_t SerializeChunk(const std::vector<std::vector<SequenceDataPtr>>& sequences, std::vector<char>& buffer, std::vector<bool>& hasMultipleSamples) const
+    {
+        buffer.clear();
+        hasMultipleSamples.assign(m_inputs.size(), false);
+        for (size_t j = 0; j < m_inputs.size(); j++)
+        {
+            const auto& input = m_inputs[j];
+            for (const auto& sequence : sequences)
+                hasMultipleSamples[j] = hasMultipleSamples[j] || sequence[j]->m_numberOfSamples > 1;
+
+            if (input.m_storageType == StorageType::dense)
+            {
+                for (const auto& sequence : sequences)
+                {
+                    if (sequence[j]->m_numberOfSamples != 1)
+                        RuntimeError("Dense input '%s' has a sequence of %u samples, but the binary format stores exactly one sample"
+                                     " for each dense sequence. Consider using the sparse format for this input.",
+                                     input.m_name.c_str(), (unsigned int)sequence[j]->m_numberOfSamples);
+                }
+
+                if (input.m_elementType == BinaryElementType::Int8)
+                {
+                    SerializeInt8<ElemType>(sequences, j, buffer);
+                    continue;
+                }
+
+                for (const auto& sequence : sequences)
+                {
+                    if (input.m_elementType == BinaryElementType::Half)
+                    {
+                        const ElemType* values = (const ElemType*)sequence[j]->GetDataBuffer();
+                        for (size_t k = 0; k < input.m_dimension; k++)
+                            Append(buffer, CNTKBinaryHalf::FromFloat((float)values[k]));
+                    }
+                    else
+                        Append(buffer, sequence[j]->GetDataBuffer(), input.m_dimension * sizeof(ElemType));
+                }
+                continue;
+            }
+
+            size_t totalNnzCount = 0;
+            for (const auto& sequence : sequences)
+                totalNnzCount += static_cast<SparseSequenceData*>(sequence[j].get())->m_totalNnzCount;
+            if (totalNnzCount > INT32_MAX)
+                RuntimeError("Sparse input '%s' has too many values in a chunk for the binary format, use a smaller chunk size.", input.m_name.c_str());
+
+            Append(buffer, (int32_t)totalNnzCount);
+            for (const auto& sequence : sequences)
+            {
+                auto sparse = static_cast<SparseSequenceData*>(sequence[j].get());
+                Append(buffer, sparse->GetDataBuffer(), sparse->m_totalNnzCount * sizeof(ElemType));
+            }
+
+            // Row indices are stored past the samples before them, which is how the deserializer splits them into samples.
+            for (const auto& sequence : sequences)
+            {
+                auto sparse = static_cast<SparseSequenceData*>(sequence[j].get());
+                size_t valueIndex = 0;
+                for (size_t sample = 0; sample < sparse->m_nnzCounts.size(); sample++)
+                {
+                    for (IndexType k = 0; k < sparse->m_nnzCounts[sample]; k++, valueIndex++)
+                    {
+                        size_t rowOffset = sample * input.m_dimension + sparse->m_indices[valueIndex];
+                        if (rowOffset > INT32_MAX)
+                            RuntimeError("Sparse input '%s' has a sequence too long for the binary format.", input.m_name.c_str());
+                        Append(buffer, (int32_t)rowOffset);
+                    }
+                }
+            }
+
+            int32_t sequenceOffset = 0;
+            Append(buffer, sequenceOffset);
+            for (const auto& sequence : sequences)
+            {
+                sequenceOffset += static_cast<SparseSequenceData*>(sequence[j].get())->m_totalNnzCount;
+                Append(buffer, sequenceOffset);
+            }
+        }
+
+        size_t uncompressedSize = buffer.size();
+        if (m_compression != ChunkCompression::None)
+        {
+            std::vector<char> compressed;
+            CNTKBinaryCompression::Compress(m_compression, m_compressionLevel, buffer.data(), buffer.size(), compressed);
+            buffer.swap(compressed);
+        }
+        return uncompressedSize;
+    }
+
+    // Marks an input as having sequences of more than one sample.
+    void SetIsSequence(size_t input)
+    {
+        m_inputs[input].m_isSequence = true;
+    }
+
+    // Appends the next chunk, as produced by SerializeChunk().
+    void WriteChunk(const std::vector<char>& data, size_t uncompressedSize, size_t numSequences, size_t numSamples)
+    {
+        if (m_numChunksWritten == m_offsetsTable.size())
+            LogicError("More chunks written to '%ls' than announced (%d).", m_filename.c_str(), (int)m_offsetsTable.size());
+        if (numSequences > INT32_MAX || numSamples > INT32_MAX)
+            RuntimeError("Chunk %d of '%ls' has too many sequences or samples, use a smaller chunk size.", (int)m_numChunksWritten, m_filename.c_str());
+
+        auto& entry = m_offsetsTable[m_numChunksWritten++];
+        entry.offset = m_offset;
+        entry.numSequences = (int32_t)numSequences;
+        entry.numSamples = (int32_t)numSamples;
+        entry.compression = (int32_t)m_compression;
+        entry.uncompressedSize = (int64_t)uncompressedSize;
+
+        CNTKBinaryFileHelper::writeOrDie(data.data(), sizeof(char), data.size(), m_file);
+        m_offset += data.size();
+    }
+
+    // Writes the final header and closes the file.
+    void Close()
+    {
+        if (m_numChunksWritten != m_offsetsTable.size())
+            LogicError("Only %d of %d chunks were written to '%ls'.", (int)m_numChunksWritten, (int)m_offsetsTable.size(), m_filename.c_str());
+
+        CNTKBinaryFileHelper::seekOrDie(m_file, 0, SEEK_SET);
+        WriteHeader();
+        CNTKBinaryFileHelper::closeOrDie(m_file);
+        m_file = nullptr;
+    }
+
+private:
+    // Dense input j of the chunk in int8, with the scale of the chunk in front.
+    template <class ElemType>
+    void SerializeInt8(const std::vector<std::vector<SequenceDataPtr>>& sequences, size_t j, std::vector<char>& buffer) const
+    {
+        size_t dimension = m_inputs[j].m_dimension;
+        std::vector<float> values(sequences.size() * dimension);
+        for (size_t i = 0; i < sequences.size(); i++)
+        {
+            const ElemType* sequence = (const ElemType*)sequences[i][j]->GetDataBuffer();
+            for (size_t k = 0; k < dimension; k++)
+                values[i * dimension + k] = (float)sequence[k];
+        }
+
+        float scale = CNTKBinaryInt8::GetScale(values.data(), values.size());
+        Append(buffer, scale);
+        for (float value : values)
+            Append(buffer, CNTKBinaryInt8::FromFloat(value, scale));
+    }
+
+    template <class T>
+    static void Append(std::vector<char>& buffer, const T& value)
+    {
+        Append(buffer, &value, sizeof(value));
+    }
+
+    static void Append(std::vector<char>& buffer, const void* data, size_t size)
+    {
+        buffer.insert(buffer.end(), (const char*)data, (const char*)data + size);
+    }
+
+    template <class T>
+    void Write(const T& value)
+    {
+        CNTKBinaryFileHelper::writeOrDie(&value, sizeof(value), 1, m_file);
+    }
+
+    void WriteHeader()
+    {
+        Write(m_compression == ChunkCompression::None ? (int64_t)VersionNumber : (int64_t)CompressedVersionNumber);
+        Write((int64_t)m_offsetsTable.size());
+        Write((int32_t)m_inputs.size());
+        for (const auto& input : m_inputs)
+        {
+            Write((int32_t)input.m_name.size());
+            CNTKBinaryFileHelper::writeOrDie(input.m_name.data(), sizeof(char), input.m_name.size(), m_file);
+            if (input.m_storageType == StorageType::dense)
+            {
+                Write((int32_t)0);
+                Write((int32_t)input.m_elementType);
+            }
+            else
+            {
+                Write((int32_t)1);
+                Write((int32_t)0);
+                Write((int32_t)input.m_elementType);
+                Write((int32_t)(input.m_isSequence ? 1 : 0));
+            }
+            Write((int32_t)input.m_dimension);
+        }
+
+        if (m_compression != ChunkCompression::None)
+        {
+            if (!m_offsetsTable.empty())
+                CNTKBinaryFileHelper::writeOrDie(m_offsetsTable.data(), sizeof(DiskOffsetsTable), m_offsetsTable.size(), m_file);
+        }
+        else
+        {
+            for (const auto& entry : m_offsetsTable)
+                CNTKBinaryFileHelper::writeOrDie(&entry, DiskOffsetsTableV1Size, 1, m_file);
+        }
+    }
+
+    std::wstring m_filename;
+    FILE* m_file;
+    std::vector<Input> m_inputs;
+    std::vector<DiskOffsetsTable> m_offsetsTable;
+    size_t m_numChunksWritten;
+    int64_t m_offset;
+    ChunkCompression m_compression;
+    int m_compressionLevel;
+
+    DISABLE_COPY_AND_MOVE(BinaryChunkWriter);
+};
+
+}}}
@@ -48,6 +48,10 @@ namespace Microsoft { namespace MSR { namespace CNTK {
 
         m_filepath = msra::strfun::utf16(config(L"file"));
         m_keepDataInMemory = config(L"keepDataInMemory", false);
+        m_useMemoryMapping = config(L"useMemoryMapping", false);
+        m_chunkCacheSizeInMB = config(L"chunkCacheSizeInMB", (size_t)0);
+        m_chunkCacheEvictionPolicy = (wstring)config(L"chunkCacheEvictionPolicy", L"sweep");
+        m_maxParallelChunkLoads = config(L"maxParallelChunkLoads", (size_t)1);
 
         // EvalActions inserts randomize = "none" into the reader config in DoWriteOutoput. We would like this to be true/false,
         // but we can't for this reason. So we will assume false unless we specifically get "true"
@@ -34,6 +34,14 @@ public:
 
     bool ShouldKeepDataInMemory() const { return m_keepDataInMemory; }
 
+    bool ShouldUseMemoryMapping() const { return m_useMemoryMapping; }
+
+    size_t GetChunkCacheSizeInMB() const { return m_chunkCacheSizeInMB; }
+
+    const wstring& GetChunkCacheEvictionPolicy() const { return m_chunkCacheEvictionPolicy; }
+
+    size_t GetMaxParallelChunkLoads() const { return m_maxParallelChunkLoads; }
+
     DISABLE_COPY_AND_MOVE(BinaryConfigHelper);
 
 private:
@@ -43,6 +51,10 @@ private:
     bool m_randomize;
     unsigned int m_traceLevel;
     bool m_keepDataInMemory; // if true the whole dataset is kept in memory
+    bool m_useMemoryMapping; // if true chunks point directly into a memory mapping of the file
+    size_t m_chunkCacheSizeInMB; // if not 0, at most this much data is kept in memory
+    std::wstring m_chunkCacheEvictionPolicy; // which chunks to drop from memory first
+    size_t m_maxParallelChunkLoads; // number of chunks read and decompressed at the same time by the randomizer
 };
 
 } } }
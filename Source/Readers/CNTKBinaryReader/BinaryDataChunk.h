@@ -18,6 +18,15 @@ public:
     explicit BinaryDataChunk(ChunkIdType chunkId, size_t startSequence, size_t numSequences, unique_ptr<byte[]> buffer, std::vector<BinaryDataDeserializerPtr> deserializer)
         : m_chunkId(chunkId), m_startSequence(startSequence), m_numSequences(numSequences), m_buffer(std::move(buffer)), m_deserializers(deserializer)
     {
+        m_chunkData = m_buffer.get();
+    }
+
+    // A chunk that lives in a memory mapped file. The sequences point directly into the mapping, which is kept
+    // alive as long as the chunk is.
+    BinaryDataChunk(ChunkIdType chunkId, size_t startSequence, size_t numSequences, MappedFilePtr mappedFile, size_t offset, std::vector<BinaryDataDeserializerPtr> deserializer)
+        : m_chunkId(chunkId), m_startSequence(startSequence), m_numSequences(numSequences), m_mappedFile(mappedFile), m_deserializers(deserializer)
+    {
+        m_chunkData = (byte*)mappedFile->GetData() + offset;
     }
 
     // Gets sequences by id.
@@ -51,7 +60,7 @@ protected:
         size_t bytesProcessed = 0;
         // Now call all of the deserializers on the chunk, in order
         for (size_t c = 0; c < m_deserializers.size(); c++)
-            bytesProcessed += m_deserializers[c]->GetSequenceDataForChunk(m_numSequences, 0, (byte*)m_buffer.get() + bytesProcessed, m_data[c]);
+            bytesProcessed += m_deserializers[c]->GetSequenceDataForChunk(m_numSequences, 0, m_chunkData + bytesProcessed, m_mappedFile != nullptr, m_data[c]);
     }
 
     // chunk id (copied from the descriptor)
@@ -66,6 +75,12 @@ protected:
     // This is the actual chunk read from disk. We will call back to the deserializer for it to be deserialized
     unique_ptr<byte[]> m_buffer;
 
+    // Or the file mapping the chunk lives in, in which case the data must not be modified.
+    MappedFilePtr m_mappedFile;
+
+    // The start of the chunk data, in either of the above.
+    byte* m_chunkData;
+
     // This is the deserializer who knows how to interpret the m_data chunk that we read in
     std::vector<BinaryDataDeserializerPtr> m_deserializers;
     
@@ -16,7 +16,10 @@ namespace Microsoft { namespace MSR { namespace CNTK {
 
 class BinaryDataDeserialzer {
 public:
-    virtual size_t GetSequenceDataForChunk(size_t numSequences, size_t startIndex, void* data, std::vector<SequenceDataPtr>& result) = 0;
+    // Parses the data of this input for the sequences of a chunk, returns the number of bytes processed.
+    // The sequences point into 'data'. If 'isReadOnly' is set (e.g. the data is a read-only file mapping),
+    // 'data' is not modified; otherwise it may be fixed up in place.
+    virtual size_t GetSequenceDataForChunk(size_t numSequences, size_t startIndex, void* data, bool isReadOnly, std::vector<SequenceDataPtr>& result) = 0;
 
     StorageType GetStorageType() { return m_storageType; }
     ElementType GetElementType() { return m_elemType; }
@@ -43,6 +46,7 @@ protected:
         }
 
         void* m_data;
+        PooledVector<float> m_convertedBuffer; // values of a half precision or int8 stream converted to float
     };
 
     // In case of sparse input, we also need a vector of
@@ -60,7 +64,7 @@ protected:
             return m_data;
         }
         
-        std::vector<IndexType> m_indicesBuffer;
+        PooledVector<IndexType> m_indicesBuffer;
         void* m_data;
     };
 
@@ -83,14 +87,18 @@ public:
         m_storageType = StorageType::dense;
 
         // Read the element type, note it's stored as an int32
-        int32_t elemType;
-        CNTKBinaryFileHelper::readOrDie(&elemType, sizeof(elemType), 1, infile);
-        if (elemType == 0)
+        CNTKBinaryFileHelper::readOrDie(&m_storedType, sizeof(m_storedType), 1, infile);
+        if (m_storedType == BinaryElementType::Float)
             m_elemType = ElementType::tfloat;
-        else if (elemType == 1)
+        else if (m_storedType == BinaryElementType::Double)
             m_elemType = ElementType::tdouble;
+        else if (m_storedType == BinaryElementType::Half || m_storedType == BinaryElementType::Int8)
+        {
+            // Stored in half precision or int8, exposed as float.
+            m_elemType = ElementType::tfloat;
+        }
         else
-            RuntimeError("Unsupported element type %d.", elemType);
+            RuntimeError("Unsupported element type %d.", (int)m_storedType);
 
         // Read the number of columns
         int32_t numCols;
@@ -98,24 +106,57 @@ public:
         m_numCols = numCols;
     }
 
-    size_t GetSequenceDataForChunk(size_t numSequences, size_t startIndex, void* data, std::vector<SequenceDataPtr>& result)
+    size_t GetSequenceDataForChunk(size_t numSequences, size_t startIndex, void* data, bool /*isReadOnly*/, std::vector<SequenceDataPtr>& result) override
     {
-        size_t elemSize = GetElemSizeBytes();
+        // The int8 values of a chunk follow its scale.
+        size_t headerSize = 0;
+        float scale = 0;
+        if (m_storedType == BinaryElementType::Int8)
+        {
+            memcpy(&scale, data, sizeof(scale));
+            headerSize = sizeof(scale);
+        }
+
+        size_t elemSize = GetStoredElemSizeBytes();
+        auto sampleLayout = GetSampleLayout(); // shared by all sequences of the chunk
         result.resize(numSequences);
         for (size_t c = 0; c < numSequences; c++)
         {
-            shared_ptr<DenseInputStreamBuffer> sequence = make_shared<DenseInputStreamBuffer>();
-            sequence->m_data            = (char*)data + c*m_numCols*elemSize;
+            shared_ptr<DenseInputStreamBuffer> sequence = MakeSequenceData<DenseInputStreamBuffer>();
+            sequence->m_data            = (char*)data + headerSize + c*m_numCols*elemSize;
+            if (m_storedType == BinaryElementType::Half)
+            {
+                sequence->m_convertedBuffer.resize(m_numCols);
+                CNTKBinaryHalf::ToFloat((const uint16_t*)sequence->m_data, sequence->m_convertedBuffer.data(), m_numCols);
+                sequence->m_data = sequence->m_convertedBuffer.data();
+            }
+            else if (m_storedType == BinaryElementType::Int8)
+            {
+                sequence->m_convertedBuffer.resize(m_numCols);
+                CNTKBinaryInt8::ToFloat((const int8_t*)sequence->m_data, scale, sequence->m_convertedBuffer.data(), m_numCols);
+                sequence->m_data = sequence->m_convertedBuffer.data();
+            }
             sequence->m_id              = startIndex + c;
             sequence->m_numberOfSamples = 1;
-            sequence->m_sampleLayout    = std::make_shared<TensorShape>(m_numCols);
+            sequence->m_sampleLayout    = sampleLayout;
             result[c]                   = sequence;
         }
 
         // For dense, the number of bytes processed is just numRows * numCols * elemSize;
-        return numSequences * m_numCols * elemSize;
+        return headerSize + numSequences * m_numCols * elemSize;
+    }
+
+private:
+    size_t GetStoredElemSizeBytes()
+    {
+        if (m_storedType == BinaryElementType::Half)
+            return sizeof(uint16_t);
+        if (m_storedType == BinaryElementType::Int8)
+            return sizeof(int8_t);
+        return GetElemSizeBytes();
     }
 
+    BinaryElementType m_storedType;
 };
 
 class SparseBinaryDataDeserializer : public BinaryDataDeserialzer
@@ -164,7 +205,7 @@ public:
     // ElemType[nnz]: the values for the sparse sequences
     // int32_t[nnz]: the row offsets for the sparse sequences
     // int32_t[numSequences]: the column offsets for the sparse sequences
-    size_t GetSequenceDataForChunk(size_t numSequences, size_t startIndex, void* data, std::vector<SequenceDataPtr>& result)
+    size_t GetSequenceDataForChunk(size_t numSequences, size_t startIndex, void* data, bool isReadOnly, std::vector<SequenceDataPtr>& result) override
     {
         size_t elemSize = GetElemSizeBytes();
         result.resize(numSequences);
@@ -186,7 +227,7 @@ public:
         // Now we setup some helper members to process the chunk
         for (size_t colIndex = 0; colIndex < numSequences; colIndex++)
         {
-            shared_ptr<SparseInputStreamBuffer> sequence = make_shared<SparseInputStreamBuffer>();
+            shared_ptr<SparseInputStreamBuffer> sequence = MakeSequenceData<SparseInputStreamBuffer>();
             // We can't popuplate sequence->m_chunk here, so delay that for later
             sequence->m_id = startIndex + colIndex;
 
@@ -197,19 +238,25 @@ public:
             sequence->m_data = values;
             
             // The indices are correct (note they MUST BE IN INCREASING ORDER), but we will have to fix them up a 
-            // little bit, for now just use them
-            sequence->m_indices = rowOffsets;
+            // little bit, for now just use them. Read-only data is fixed up into a buffer of the sequence instead.
+            if (isReadOnly)
+            {
+                sequence->m_indicesBuffer.assign(rowOffsets, rowOffsets + sequence->m_totalNnzCount);
+                sequence->m_indices = sequence->m_indicesBuffer.data();
+            }
+            else
+                sequence->m_indices = rowOffsets;
             for (int32_t curRow = 0; curRow < sequence->m_totalNnzCount; curRow++)
             {
                 // Get the sample for the current index
-                size_t sampleNum = rowOffsets[curRow] / m_numCols;
+                size_t sampleNum = sequence->m_indices[curRow] / m_numCols;
                 // The current sample might be OOB, if so, fill in the the missing ones.
                 while(sequence->m_nnzCounts.size() < sampleNum+1)
                     sequence->m_nnzCounts.push_back(0);
                 // Now that we have enough samples, increment the nnz for the sample
                 sequence->m_nnzCounts[sampleNum] += 1;
                 // Now that we've found it's sample, fix up the index.
-                rowOffsets[curRow] %= m_numCols;
+                sequence->m_indices[curRow] %= m_numCols;
             }
             sequence->m_numberOfSamples = (uint32_t)sequence->m_nnzCounts.size();
             // update values, rowOffsets pointers
@@ -31,7 +31,10 @@ CNTKBinaryReader::CNTKBinaryReader(const ConfigParameters& config)
 
         if (configHelper.ShouldKeepDataInMemory())
         {
-            m_deserializer = shared_ptr<IDataDeserializer>(new ChunkCache(m_deserializer));
+            m_deserializer = shared_ptr<IDataDeserializer>(new ChunkCache(m_deserializer,
+                ChunkCache::GetMemoryBudgetInBytes(configHelper.GetChunkCacheSizeInMB()),
+                ChunkCache::ParseEvictionPolicy(configHelper.GetChunkCacheEvictionPolicy()),
+                configHelper.GetTraceLevel() > 1 ? 1 : 0));
             log += " | keeping data in memory";
         }
 
@@ -47,7 +50,8 @@ CNTKBinaryReader::CNTKBinaryReader(const ConfigParameters& config)
                 m_deserializer, /* deserializer */
                 true, /* shouldPrefetch */
                 false, /* useLegacyRandomization */
-                false /* multithreadedGetNextSequences */
+                false, /* multithreadedGetNextSequences */
+                configHelper.GetMaxParallelChunkLoads() /* maxParallelChunkLoads */
                 );
         }
         else
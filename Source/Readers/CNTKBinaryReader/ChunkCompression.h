@@ -0,0 +1,161 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE.md file in the project root for full license information.
+//
+
+#pragma once
+
+#include <inttypes.h>
+#include <limits.h>
+#include <string.h>
+#include <string>
+#include <vector>
+#include "Basics.h"
+#ifdef USE_LZ4
+#include <lz4.h>
+#endif
+#ifdef USE_ZSTD
+#include <zstd.h>
+#endif
+
+namespace Microsoft { namespace MSR { namespace CNTK {
+
+// Codec a chunk of the binary format is compressed with, as stored in the offsets table.
+enum class ChunkCompression : int32_t
+{
+    None = 0,
+    LZ4 = 1,
+    Zstd = 2
+};
+
+// Compression and decompression of whole chunks. The codecs are only available if CNTK was built
+// with the corresponding library (see configure --with-lz4 and --with-zstd).
+class CNTKBinaryCompression
+{
+public:
+    static const char* GetName(ChunkCompression compression)
+    {
+        switch (compression)
+        {
+        case ChunkCompression::None:
+            return "none";
+        case ChunkCompression::LZ4:
+            return "lz4";
+        case ChunkCompression::Zstd:
+            return "zstd";
+        default:
+            return "unknown";
+        }
+    }
+
+    // Parses the name of a codec: 'none', 'lz4' or 'zstd'.
+    static ChunkCompression Parse(const std::wstring& name)
+    {
+        if (name == L"none")
+            return ChunkCompression::None;
+        if (name == L"lz4")
+            return ChunkCompression::LZ4;
+        if (name == L"zstd")
+            return ChunkCompression::Zstd;
+        InvalidArgument("Unknown chunk compression '%ls', expected 'none', 'lz4' or 'zstd'.", name.c_str());
+    }
+
+    static bool IsSupported(ChunkCompression compression)
+    {
+        switch (compression)
+        {
+        case ChunkCompression::None:
+            return true;
+#ifdef USE_LZ4
+        case ChunkCompression::LZ4:
+            return true;
+#endif
+#ifdef USE_ZSTD
+        case ChunkCompression::Zstd:
+            return true;
+#endif
+        default:
+            return false;
+        }
+    }
+
+    // Compresses 'size' bytes at 'data' into 'result'. 'level' is only used by Zstd.
+    static void Compress(ChunkCompression compression, int level, const char* data, size_t size, std::vector<char>& result)
+    {
+        CheckSupported(compression);
+        switch (compression)
+        {
+#ifdef USE_LZ4
+        case ChunkCompression::LZ4:
+        {
+            if (size > LZ4_MAX_INPUT_SIZE)
+                RuntimeError("A chunk of %" PRIu64 " bytes is too large for LZ4 compression, use a smaller chunk size.", (uint64_t)size);
+            result.resize(LZ4_compressBound((int)size));
+            int compressedSize = LZ4_compress_default(data, result.data(), (int)size, (int)result.size());
+            if (compressedSize <= 0)
+                RuntimeError("LZ4 compression of a chunk failed.");
+            result.resize(compressedSize);
+            break;
+        }
+#endif
+#ifdef USE_ZSTD
+        case ChunkCompression::Zstd:
+        {
+            result.resize(ZSTD_compressBound(size));
+            size_t compressedSize = ZSTD_compress(result.data(), result.size(), data, size, level);
+            if (ZSTD_isError(compressedSize))
+                RuntimeError("Zstd compression of a chunk failed: %s.", ZSTD_getErrorName(compressedSize));
+            result.resize(compressedSize);
+            break;
+        }
+#endif
+        default:
+            UNUSED(level);
+            result.assign(data, data + size);
+        }
+    }
+
+    // Decompresses 'size' bytes at 'data' into exactly 'resultSize' bytes at 'result'.
+    static void Decompress(ChunkCompression compression, const char* data, size_t size, char* result, size_t resultSize)
+    {
+        CheckSupported(compression);
+        switch (compression)
+        {
+#ifdef USE_LZ4
+        case ChunkCompression::LZ4:
+        {
+            if (size > INT_MAX || resultSize > INT_MAX ||
+                LZ4_decompress_safe(data, result, (int)size, (int)resultSize) != (int)resultSize)
+                RuntimeError("LZ4 decompression of a chunk failed, the file is corrupt.");
+            break;
+        }
+#endif
+#ifdef USE_ZSTD
+        case ChunkCompression::Zstd:
+        {
+            size_t decompressedSize = ZSTD_decompress(result, resultSize, data, size);
+            if (ZSTD_isError(decompressedSize))
+                RuntimeError("Zstd decompression of a chunk failed: %s.", ZSTD_getErrorName(decompressedSize));
+            if (decompressedSize != resultSize)
+                RuntimeError("Zstd decompression of a chunk failed, the file is corrupt.");
+            break;
+        }
+#endif
+        default:
+            if (size != resultSize)
+                RuntimeError("An uncompressed chunk of %" PRIu64 " bytes was expected to have %" PRIu64 " bytes.", (uint64_t)size, (uint64_t)resultSize);
+            memcpy(result, data, size);
+        }
+    }
+
+private:
+    static void CheckSupported(ChunkCompression compression)
+    {
+        if (!IsSupported(compression))
+            RuntimeError("Chunk compression '%s' (%d) is not supported by this build of CNTK.", GetName(compression), (int)compression);
+    }
+
+    CNTKBinaryCompression();
+};
+
+}}}
@@ -21,11 +21,21 @@
 #ifdef __unix__
 #include <sys/types.h>
 #include <sys/stat.h>
+#include <sys/mman.h>
+#include <fcntl.h>
+#include <unistd.h>
 #endif
 #include <errno.h>
 #include <stdint.h>
 #include <assert.h>
+#include <memory>
+#include <string.h>
+#include <math.h>
 #include "Basics.h"
+#include "MappedFile.h"
+#if defined(__F16C__) || defined(__SSE4_1__)
+#include <immintrin.h>
+#endif
 
 namespace Microsoft { namespace MSR { namespace CNTK {
 
@@ -90,9 +100,146 @@ public:
             RuntimeError("Error reading: %s.", strerror(errno));
     }
 
+    static void writeOrDie(const void* ptr, size_t size, size_t count, FILE* f)
+    {
+        size_t rc;
+        rc = fwrite(ptr, size, count, f);
+        if (rc != count)
+            RuntimeError("Error writing: %s.", strerror(errno));
+    }
+
 private:
     CNTKBinaryFileHelper();
 };
 
+// Element types as they are stored in the file.
+enum class BinaryElementType : int32_t
+{
+    Float = 0,
+    Double = 1,
+    Half = 2, // dense inputs only, read as float
+    Int8 = 3  // dense inputs only, read as float: each chunk starts with a float scale followed by the int8 values
+};
+
+// Conversion between float and IEEE 754 half precision, in which dense streams can be stored.
+class CNTKBinaryHalf
+{
+public:
+    // Rounds to the nearest half, ties to even. Values too large for a half become infinity.
+    static uint16_t FromFloat(float value)
+    {
+        uint32_t bits;
+        memcpy(&bits, &value, sizeof(bits));
+        uint32_t sign = (bits >> 16) & 0x8000;
+        int32_t exponent = (int32_t)((bits >> 23) & 0xff) - 127 + 15;
+        uint32_t mantissa = bits & 0x7fffff;
+
+        if (((bits >> 23) & 0xff) == 0xff) // infinity or NaN
+            return (uint16_t)(sign | 0x7c00 | (mantissa ? 0x200 : 0));
+        if (exponent >= 0x1f)
+            return (uint16_t)(sign | 0x7c00);
+
+        uint32_t shift = 13;
+        if (exponent <= 0) // a subnormal half, or zero
+        {
+            if (exponent < -10)
+                return (uint16_t)sign;
+            mantissa |= 0x800000;
+            shift = 14 - exponent;
+            exponent = 0;
+        }
+
+        uint32_t half = ((uint32_t)exponent << 10) + (mantissa >> shift);
+        uint32_t rest = mantissa & ((1u << shift) - 1);
+        uint32_t halfway = 1u << (shift - 1);
+        if (rest > halfway || (rest == halfway && (half & 1)))
+            half++; // a carry into the exponent is still the correctly rounded value
+        return (uint16_t)(sign | half);
+    }
+
+    static float ToFloat(uint16_t value)
+    {
+        uint32_t sign = (uint32_t)(value & 0x8000) << 16;
+        uint32_t exponent = (value >> 10) & 0x1f;
+        uint32_t mantissa = value & 0x3ff;
+
+        if (exponent == 0) // zero or a subnormal half, which is a normal float
+        {
+            float result = ldexpf((float)mantissa, -24);
+            return sign ? -result : result;
+        }
+
+        uint32_t bits = exponent == 0x1f ?
+            sign | 0x7f800000 | (mantissa << 13) :
+            sign | ((exponent + 127 - 15) << 23) | (mantissa << 13);
+        float result;
+        memcpy(&result, &bits, sizeof(result));
+        return result;
+    }
+
+    // Widens 'count' halves, with F16C if the build targets it.
+    static void ToFloat(const uint16_t* values, float* result, size_t count)
+    {
+        size_t i = 0;
+#ifdef __F16C__
+        for (; i + 8 <= count; i += 8)
+            _mm256_storeu_ps(result + i, _mm256_cvtph_ps(_mm_loadu_si128((const __m128i*)(values + i))));
+#endif
+        for (; i < count; i++)
+            result[i] = ToFloat(values[i]);
+    }
+
+private:
+    CNTKBinaryHalf();
+};
+
+// Linear quantization of dense values to int8: a value is stored as round(value / scale) in [-127, 127],
+// with one scale for all values of an input in a chunk.
+class CNTKBinaryInt8
+{
+public:
+    // The scale that maps the largest absolute value to 127.
+    static float GetScale(const float* values, size_t count)
+    {
+        float maxAbs = 0;
+        for (size_t i = 0; i < count; i++)
+        {
+            if (!isfinite(values[i]))
+                RuntimeError("Value %f cannot be stored as int8.", values[i]);
+            maxAbs = std::max(maxAbs, fabsf(values[i]));
+        }
+        return maxAbs / 127;
+    }
+
+    static int8_t FromFloat(float value, float scale)
+    {
+        if (scale == 0)
+            return 0;
+        float quantized = roundf(value / scale);
+        return (int8_t)std::max(-127.0f, std::min(127.0f, quantized));
+    }
+
+    // Widens 'count' int8 values, with SSE4.1 if the build targets it.
+    static void ToFloat(const int8_t* values, float scale, float* result, size_t count)
+    {
+        size_t i = 0;
+#ifdef __SSE4_1__
+        __m128 scales = _mm_set1_ps(scale);
+        for (; i + 4 <= count; i += 4)
+        {
+            int32_t packed;
+            memcpy(&packed, values + i, sizeof(packed));
+            __m128i widened = _mm_cvtepi8_epi32(_mm_cvtsi32_si128(packed));
+            _mm_storeu_ps(result + i, _mm_mul_ps(_mm_cvtepi32_ps(widened), scales));
+        }
+#endif
+        for (; i < count; i++)
+            result[i] = values[i] * scale;
+    }
+
+private:
+    CNTKBinaryInt8();
+};
+
 }}}
 #endif
\ No newline at end of file
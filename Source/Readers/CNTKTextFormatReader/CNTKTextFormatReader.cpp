@@ -13,6 +13,7 @@
 #include "TextParser.h"
 #include "SequencePacker.h"
 #include "FramePacker.h"
+#include "LengthBucketingEnumerator.h"
 
 namespace Microsoft { namespace MSR { namespace CNTK {
 
@@ -34,7 +35,10 @@ CNTKTextFormatReader::CNTKTextFormatReader(const ConfigParameters& config)
             m_deserializer = make_shared<TextParser<double>>(corpus, configHelper, true);
 
         if (configHelper.ShouldKeepDataInMemory())
-            m_deserializer = make_shared<ChunkCache>(m_deserializer);
+            m_deserializer = make_shared<ChunkCache>(m_deserializer,
+                ChunkCache::GetMemoryBudgetInBytes(configHelper.GetChunkCacheSizeInMB()),
+                ChunkCache::ParseEvictionPolicy(configHelper.GetChunkCacheEvictionPolicy()),
+                configHelper.GetTraceLevel() > 1 ? 1 : 0);
 
         size_t window = configHelper.GetRandomizationWindow();
         if (window > 0)
@@ -56,6 +60,11 @@ CNTKTextFormatReader::CNTKTextFormatReader(const ConfigParameters& config)
         }
         else
         {
+            // Minibatches of sequences of similar length, bucketed over the given number of minibatches.
+            size_t bucketingWindow = config(L"bucketingWindow", (size_t)0);
+            if (bucketingWindow > 0)
+                m_sequenceEnumerator = make_shared<LengthBucketingEnumerator>(m_sequenceEnumerator, bucketingWindow, config(L"verbosity", 0));
+
             m_packer = std::make_shared<SequencePacker>(
                 m_sequenceEnumerator,
                 ReaderBase::GetStreamDescriptions());
@@ -6,6 +6,8 @@
 #include "stdafx.h"
 #define __STDC_FORMAT_MACROS
 #include <inttypes.h>
+#include <sys/stat.h>
+#include <future>
 #include "Indexer.h"
 #include "TextReaderConstants.h"
 
@@ -23,6 +25,7 @@ Indexer::Indexer(FILE* file, bool isPrimary, bool skipSequenceIds, size_t chunkS
     m_pos(nullptr),
     m_done(false),
     m_hasSequenceIds(!skipSequenceIds),
+    m_skipSequenceIds(skipSequenceIds),
     m_index(chunkSize, isPrimary)
 {
     if (m_file == nullptr)
@@ -91,14 +94,15 @@ void Indexer::BuildFromLines(CorpusDescriptorPtr corpus)
     }
 }
 
-void Indexer::Build(CorpusDescriptorPtr corpus)
+void Indexer::Build(CorpusDescriptorPtr corpus, const std::wstring& filename, size_t numberOfWorkers)
 {
     if (!m_index.IsEmpty())
     {
         return;
     }
 
-    m_index.Reserve(filesize(m_file));
+    int64_t fileSize = filesize(m_file);
+    m_index.Reserve(fileSize);
 
     RefillBuffer(); // read the first block of data
     if (m_done)
@@ -116,7 +120,26 @@ void Indexer::Build(CorpusDescriptorPtr corpus)
     }
 
     // check the first byte and decide what to do next
-    if (!m_hasSequenceIds || m_bufferStart[0] == NAME_PREFIX)
+    bool fromLines = !m_hasSequenceIds || m_bufferStart[0] == NAME_PREFIX;
+
+    int64_t dataStart = GetFileOffset();
+    numberOfWorkers = std::min(numberOfWorkers, (size_t)(fileSize - dataStart) / MinBytesPerWorker);
+    if (numberOfWorkers > 1 && !filename.empty())
+    {
+        if (!fromLines)
+        {
+            size_t id = 0;
+            if (!TryGetSequenceId(id))
+            {
+                RuntimeError("Expected a sequence id at the offset %" PRIi64 ", none was found.", dataStart);
+            }
+        }
+
+        BuildInParallel(corpus, filename, fromLines, dataStart, fileSize, numberOfWorkers);
+        return;
+    }
+
+    if (fromLines)
     {
         // skip sequence id parsing, treat lines as individual sequences
         BuildFromLines(corpus);
@@ -158,6 +181,116 @@ void Indexer::Build(CorpusDescriptorPtr corpus)
     AddSequenceIfIncluded(corpus, currentKey, sd);
 }
 
+void Indexer::IndexRange(int64_t start, int64_t end, bool atLineStart, bool fromLines, std::vector<LineRun>& runs)
+{
+    // Starting one byte early, so that a line starting exactly at 'start' is not skipped.
+    int64_t readFrom = atLineStart ? start : start - 1;
+    if (_fseeki64(m_file, readFrom, SEEK_SET) != 0)
+    {
+        RuntimeError("Error seeking to position %" PRId64 " in the input file.", readFrom);
+    }
+
+    m_fileOffsetEnd = readFrom;
+    RefillBuffer();
+    if (!atLineStart)
+    {
+        SkipLine();
+    }
+
+    while (!m_done && GetFileOffset() < end)
+    {
+        int64_t offset = GetFileOffset();
+        size_t id = 0;
+        bool hasKey = !fromLines && TryGetSequenceId(id);
+        if (m_done)
+        {
+            // A last line that consists of digits only is not counted, as in Build().
+            break;
+        }
+
+        if (!fromLines && !runs.empty() && (!hasKey || (runs.back().m_hasKey && runs.back().m_key == id)))
+        {
+            runs.back().m_numberOfLines++;
+        }
+        else
+        {
+            runs.push_back({ offset, id, 1, hasKey });
+        }
+
+        SkipLine();
+    }
+}
+
+void Indexer::BuildInParallel(CorpusDescriptorPtr corpus, const std::wstring& filename, bool fromLines,
+    int64_t dataStart, int64_t fileSize, size_t numberOfWorkers)
+{
+    int64_t rangeSize = (fileSize - dataStart + numberOfWorkers - 1) / numberOfWorkers;
+
+    std::vector<std::future<std::vector<LineRun>>> workers;
+    for (size_t i = 0; i < numberOfWorkers; ++i)
+    {
+        int64_t start = dataStart + i * rangeSize;
+        int64_t end = std::min(fileSize, start + rangeSize);
+        workers.push_back(std::async(std::launch::async, [this, &filename, start, end, i, fromLines]()
+        {
+            std::vector<LineRun> runs;
+            FILE* file = fopenOrDie(filename, L"rbS");
+            try
+            {
+                Indexer worker(file, m_index.m_isPrimary, m_skipSequenceIds, m_index.m_maxChunkSize);
+                worker.IndexRange(start, end, i == 0, fromLines, runs);
+            }
+            catch (...)
+            {
+                fclose(file);
+                throw;
+            }
+            fclose(file);
+            return runs;
+        }));
+    }
+
+    // Merging the runs in file order. A run without a sequence id or with the id of the current sequence
+    // (e.g. a sequence crossing a range boundary) continues the current sequence.
+    SequenceDescriptor sd = {};
+    size_t currentKey = 0;
+    size_t lines = 0;
+    bool started = false;
+    for (auto& worker : workers)
+    {
+        std::vector<LineRun> runs = worker.get();
+        for (const auto& run : runs)
+        {
+            if (!fromLines && started && (!run.m_hasKey || run.m_key == currentKey))
+            {
+                sd.m_numberOfSamples += run.m_numberOfLines;
+                continue;
+            }
+
+            if (started)
+            {
+                sd.m_byteSize = run.m_fileOffsetBytes - sd.m_fileOffsetBytes;
+                AddSequenceIfIncluded(corpus, currentKey, sd);
+            }
+
+            sd = {};
+            sd.m_fileOffsetBytes = run.m_fileOffsetBytes;
+            sd.m_numberOfSamples = run.m_numberOfLines;
+            currentKey = fromLines ? lines++ : run.m_key;
+            started = true;
+        }
+    }
+
+    if (started)
+    {
+        sd.m_byteSize = fileSize - sd.m_fileOffsetBytes;
+        AddSequenceIfIncluded(corpus, currentKey, sd);
+    }
+
+    m_hasSequenceIds = !fromLines;
+    m_done = true;
+}
+
 void Indexer::AddSequenceIfIncluded(CorpusDescriptorPtr corpus, size_t sequenceId, SequenceDescriptor& sd)
 {
     auto key = std::to_string(sequenceId);
@@ -215,4 +348,206 @@ bool Indexer::TryGetSequenceId(size_t& id)
     return false;
 }
 
+// Layout of the index cache file: a header, followed by a record for each chunk and then
+// the records of its sequences. Chunk and sequence ids are implied by the record positions.
+static const char s_indexCacheMagic[8] = { 'C', 'T', 'F', 'I', 'N', 'D', 'E', 'X' };
+static const uint32_t s_indexCacheVersion = 1;
+
+#pragma pack(push, 1)
+struct IndexCacheHeader
+{
+    char m_magic[sizeof(s_indexCacheMagic)];
+    uint32_t m_version;
+    uint64_t m_inputFileSize;
+    int64_t m_inputFileTime;
+    uint64_t m_maxChunkSize;
+    uint8_t m_isPrimary;
+    uint8_t m_skipSequenceIds;
+    uint8_t m_hasSequenceIds;
+    uint64_t m_numberOfChunks;
+};
+
+struct IndexCacheChunk
+{
+    uint64_t m_numberOfSequences;
+    uint64_t m_numberOfSamples;
+    uint64_t m_byteSize;
+};
+
+struct IndexCacheSequence
+{
+    int64_t m_fileOffsetBytes;
+    uint64_t m_byteSize;
+    uint64_t m_key;
+    uint32_t m_numberOfSamples;
+};
+#pragma pack(pop)
+
+// Gets the size and the modification time of the input file, which identify the version the index was built for.
+static bool TryGetFileStamp(const std::wstring& path, uint64_t& size, int64_t& time)
+{
+#ifdef _WIN32
+    struct _stat64 buf;
+    if (_wstat64(path.c_str(), &buf) != 0)
+        return false;
+#else
+    struct stat buf;
+    if (stat(wtocharpath(path.c_str()).c_str(), &buf) != 0)
+        return false;
+#endif
+    size = buf.st_size;
+    time = buf.st_mtime;
+    return true;
+}
+
+bool Indexer::TryLoadCache(const std::wstring& cacheFile, const std::wstring& inputFile)
+{
+    if (!m_index.IsEmpty())
+    {
+        return true;
+    }
+
+    IndexCacheHeader expected = {};
+    if (!TryGetFileStamp(inputFile, expected.m_inputFileSize, expected.m_inputFileTime))
+    {
+        return false;
+    }
+
+    FILE* f = _wfopen(cacheFile.c_str(), L"rb");
+    if (f == nullptr)
+    {
+        return false;
+    }
+
+    IndexCacheHeader header;
+    bool valid = fread(&header, sizeof(header), 1, f) == 1 &&
+        memcmp(header.m_magic, s_indexCacheMagic, sizeof(s_indexCacheMagic)) == 0 &&
+        header.m_version == s_indexCacheVersion &&
+        header.m_inputFileSize == expected.m_inputFileSize &&
+        header.m_inputFileTime == expected.m_inputFileTime &&
+        header.m_maxChunkSize == m_index.m_maxChunkSize &&
+        header.m_isPrimary == (uint8_t)m_index.m_isPrimary &&
+        header.m_skipSequenceIds == (uint8_t)m_skipSequenceIds &&
+        header.m_numberOfChunks > 0 && header.m_numberOfChunks <= CHUNKID_MAX;
+
+    std::vector<IndexCacheChunk> chunks;
+    if (valid)
+    {
+        chunks.resize(header.m_numberOfChunks);
+        valid = fread(chunks.data(), sizeof(IndexCacheChunk), chunks.size(), f) == chunks.size();
+    }
+
+    std::vector<IndexCacheSequence> sequences;
+    m_index.m_chunks.reserve(chunks.size());
+    for (size_t i = 0; valid && i < chunks.size(); ++i)
+    {
+        sequences.resize(chunks[i].m_numberOfSequences);
+        if (fread(sequences.data(), sizeof(IndexCacheSequence), sequences.size(), f) != sequences.size())
+        {
+            valid = false;
+            break;
+        }
+
+        m_index.m_chunks.push_back({});
+        ChunkDescriptor& chunk = m_index.m_chunks.back();
+        chunk.m_id = (ChunkIdType)i;
+        chunk.m_numberOfSequences = chunks[i].m_numberOfSequences;
+        chunk.m_numberOfSamples = chunks[i].m_numberOfSamples;
+        chunk.m_byteSize = chunks[i].m_byteSize;
+        chunk.m_sequences.resize(sequences.size());
+        for (size_t j = 0; j < sequences.size(); ++j)
+        {
+            SequenceDescriptor& sd = chunk.m_sequences[j];
+            sd.m_id = j;
+            sd.m_chunkId = chunk.m_id;
+            sd.m_numberOfSamples = sequences[j].m_numberOfSamples;
+            sd.m_key.m_sequence = sequences[j].m_key;
+            sd.m_key.m_sample = 0;
+            sd.m_fileOffsetBytes = sequences[j].m_fileOffsetBytes;
+            sd.m_byteSize = sequences[j].m_byteSize;
+            if (!m_index.m_isPrimary)
+            {
+                m_index.m_keyToSequenceInChunk.insert(std::make_pair((size_t)sd.m_key.m_sequence, std::make_pair(sd.m_chunkId, j)));
+            }
+        }
+    }
+
+    fclose(f);
+
+    if (!valid)
+    {
+        // A stale or truncated cache, the index will have to be rebuilt.
+        m_index.m_chunks.clear();
+        m_index.m_keyToSequenceInChunk.clear();
+        return false;
+    }
+
+    m_hasSequenceIds = header.m_hasSequenceIds != 0;
+    m_done = true;
+    return true;
+}
+
+bool Indexer::SaveCache(const std::wstring& cacheFile, const std::wstring& inputFile) const
+{
+    IndexCacheHeader header = {};
+    if (m_index.IsEmpty() || !TryGetFileStamp(inputFile, header.m_inputFileSize, header.m_inputFileTime))
+    {
+        return false;
+    }
+
+    memcpy(header.m_magic, s_indexCacheMagic, sizeof(s_indexCacheMagic));
+    header.m_version = s_indexCacheVersion;
+    header.m_maxChunkSize = m_index.m_maxChunkSize;
+    header.m_isPrimary = (uint8_t)m_index.m_isPrimary;
+    header.m_skipSequenceIds = (uint8_t)m_skipSequenceIds;
+    header.m_hasSequenceIds = (uint8_t)m_hasSequenceIds;
+    header.m_numberOfChunks = m_index.m_chunks.size();
+
+    // Several processes (e.g. MPI workers) may index the same file at the same time,
+    // each of them writes a file of its own and then renames it into place.
+    std::wstring tempFile = cacheFile + L"." + std::to_wstring(GetCurrentProcessId()) + L".tmp";
+    FILE* f = _wfopen(tempFile.c_str(), L"wb");
+    if (f == nullptr)
+    {
+        return false;
+    }
+
+    bool written = fwrite(&header, sizeof(header), 1, f) == 1;
+
+    std::vector<IndexCacheChunk> chunks;
+    chunks.reserve(m_index.m_chunks.size());
+    for (const auto& chunk : m_index.m_chunks)
+    {
+        chunks.push_back({ chunk.m_sequences.size(), chunk.m_numberOfSamples, chunk.m_byteSize });
+    }
+    written = written && fwrite(chunks.data(), sizeof(IndexCacheChunk), chunks.size(), f) == chunks.size();
+
+    std::vector<IndexCacheSequence> sequences;
+    for (size_t i = 0; written && i < m_index.m_chunks.size(); ++i)
+    {
+        sequences.clear();
+        for (const auto& sd : m_index.m_chunks[i].m_sequences)
+        {
+            sequences.push_back({ sd.m_fileOffsetBytes, sd.m_byteSize, sd.m_key.m_sequence, sd.m_numberOfSamples });
+        }
+        written = fwrite(sequences.data(), sizeof(IndexCacheSequence), sequences.size(), f) == sequences.size();
+    }
+
+    written = (fclose(f) == 0) && written;
+
+    try
+    {
+        if (written)
+        {
+            renameOrDie(tempFile, cacheFile);
+            return true;
+        }
+        unlinkOrDie(tempFile);
+    }
+    catch (const std::exception&)
+    {
+    }
+    return false;
+}
+
 }}}
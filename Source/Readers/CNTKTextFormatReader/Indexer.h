@@ -23,8 +23,23 @@ public:
     Indexer(FILE* file, bool isPrimary, bool skipSequenceIds = false, size_t chunkSize = 32 * 1024 * 1024);
 
     // Reads the input file, building and index of chunks and corresponding
-    // sequences.
-    void Build(CorpusDescriptorPtr corpus);
+    // sequences. If more than one worker is requested and the file is large enough, 
+    // byte ranges of the file are indexed in parallel, each worker opening the file
+    // (given by its name) on its own. The resulting index is the same in both cases.
+    void Build(CorpusDescriptorPtr corpus, const std::wstring& filename = std::wstring(), size_t numberOfWorkers = 1);
+
+    // Minimum number of bytes indexed by a single worker.
+    static const size_t MinBytesPerWorker = 32 * 1024 * 1024;
+
+    // Loads the index from a cache file previously written by SaveCache() for the given input file.
+    // Returns false and leaves the index empty if the cache file does not exist, cannot be read,
+    // or was written for a different version of the input file (size or modification time differ)
+    // or with different indexing parameters.
+    bool TryLoadCache(const std::wstring& cacheFile, const std::wstring& inputFile);
+
+    // Writes the index to a cache file, so that later runs can load it instead of scanning
+    // the input file again. Returns false if the cache file could not be written.
+    bool SaveCache(const std::wstring& cacheFile, const std::wstring& inputFile) const;
 
     // Returns input data index (chunk and sequence metadata)
     const Index& GetIndex() const { return m_index; }
@@ -50,6 +65,8 @@ private:
     bool m_hasSequenceIds; // true, when input contains one sequence per line 
                            // or when sequence id column was ignored during indexing.
 
+    bool m_skipSequenceIds; // as passed to the constructor
+
     // a collection of chunk descriptors and sequence keys.
     Index m_index;
 
@@ -70,6 +87,25 @@ private:
     // Otherwise, writes sequence id value to the provided reference, returns true.
     bool TryGetSequenceId(size_t& id);
 
+    // Consecutive lines of the input sharing a sequence id (m_hasKey), or a single line when
+    // building from lines, as found by a worker.
+    struct LineRun
+    {
+        int64_t m_fileOffsetBytes;
+        size_t m_key;
+        uint32_t m_numberOfLines;
+        bool m_hasKey; // false for lines without a sequence id, which continue the previous sequence
+    };
+
+    // Collects the lines starting in the [start, end) byte range of the file. If the range
+    // does not start at the beginning of a line, the partial line is skipped (it belongs to the previous range).
+    void IndexRange(int64_t start, int64_t end, bool atLineStart, bool fromLines, std::vector<LineRun>& runs);
+
+    // Indexes the data in [dataStart, fileSize) using the given number of workers and merges the
+    // results into the index, exactly as BuildFromLines() or the sequential Build() would.
+    void BuildInParallel(CorpusDescriptorPtr corpus, const std::wstring& filename, bool fromLines,
+        int64_t dataStart, int64_t fileSize, size_t numberOfWorkers);
+
     // Build a chunk/sequence index, treating each line as an individual sequence.
     // Does not do any sequence parsing, instead uses line number as 
     // the corresponding sequence id.
@@ -7,6 +7,8 @@
 #define __STDC_FORMAT_MACROS
 #include <inttypes.h>
 #include <limits>
+#include <thread>
+#include <algorithm>
 #include "TextConfigHelper.h"
 #include "DataReader.h"
 #include "StringUtil.h"
@@ -144,10 +146,18 @@ TextConfigHelper::TextConfigHelper(const ConfigParameters& config)
     }
 
     m_skipSequenceIds = config(L"skipSequenceIds", false);
+    m_cacheIndex = config(L"cacheIndex", false);
+    m_numIndexingThreads = config(L"numIndexingThreads", (size_t)1);
+    if (m_numIndexingThreads == 0)
+    {
+        m_numIndexingThreads = std::max(1u, std::thread::hardware_concurrency());
+    }
     m_maxErrors = config(L"maxErrors", 0);
     m_traceLevel = config(L"traceLevel", 1);
     m_chunkSizeBytes = config(L"chunkSizeInBytes", 32 * 1024 * 1024); // 32 MB by default
     m_keepDataInMemory = config(L"keepDataInMemory", false);
+    m_chunkCacheSizeInMB = config(L"chunkCacheSizeInMB", (size_t)0);
+    m_chunkCacheEvictionPolicy = (wstring)config(L"chunkCacheEvictionPolicy", L"sweep");
     m_frameMode = config(L"frameMode", false);
 }
 
@@ -29,6 +29,10 @@ public:
 
     bool ShouldSkipSequenceIds() const { return m_skipSequenceIds; }
 
+    bool ShouldCacheIndex() const { return m_cacheIndex; }
+
+    size_t GetNumIndexingThreads() const { return m_numIndexingThreads; }
+
     unsigned int GetMaxAllowedErrors() const { return m_maxErrors; }
 
     unsigned int GetTraceLevel() const { return m_traceLevel; }
@@ -37,6 +41,10 @@ public:
 
     bool ShouldKeepDataInMemory() const { return m_keepDataInMemory; }
 
+    size_t GetChunkCacheSizeInMB() const { return m_chunkCacheSizeInMB; }
+
+    const wstring& GetChunkCacheEvictionPolicy() const { return m_chunkCacheEvictionPolicy; }
+
     bool IsInFrameMode() const { return m_frameMode; }
 
     ElementType GetElementType() const { return m_elementType; }
@@ -49,10 +57,14 @@ private:
     size_t m_randomizationWindow;
     ElementType m_elementType;
     bool m_skipSequenceIds;
+    bool m_cacheIndex; // if true, the index of the input file is stored in (and loaded from) '<file>.index'
+    size_t m_numIndexingThreads; // number of threads indexing the input file, 0 for one per core
     unsigned int m_maxErrors;
     unsigned int m_traceLevel;
     size_t m_chunkSizeBytes; // chunks size in bytes
     bool m_keepDataInMemory; // if true the whole dataset is kept in memory
+    size_t m_chunkCacheSizeInMB; // if not 0, at most this much data is kept in memory
+    std::wstring m_chunkCacheEvictionPolicy; // which chunks to drop from memory first
     bool m_frameMode; // if true, the maximum expected sequence length in the dataset is one sample.
 };
 
@@ -11,6 +11,12 @@
 #include "TextParser.h"
 #include "TextReaderConstants.h"
 
+#if !defined(__aarch64__)
+#define TEXT_PARSER_SIMD
+#include <emmintrin.h>
+#include <tmmintrin.h>
+#endif
+
 #define isSign(c) ((c == '-' || c == '+'))
 #define isE(c) ((c == 'e' || c == 'E'))
 
@@ -21,6 +27,82 @@ inline bool IsDigit(char c)
     return '0' <= c && c <= '9';
 }
 
+#ifdef TEXT_PARSER_SIMD
+// The fast number parsing path classifies this many bytes at once,
+// numbers that are not terminated within them are left to the scalar parser.
+static const size_t FastParsingWindow = 32;
+
+// The fast path also loads 16 bytes starting at any of the digits, so it
+// needs this many bytes in the buffer.
+static const size_t FastParsingMinBytes = FastParsingWindow + 16;
+
+// Up to this many decimal digits are accumulated exactly in a double,
+// so the fast path produces the same values as the scalar parser.
+static const size_t MaxExactDigits = 15;
+
+// At most this many digits are converted at once.
+static const size_t MaxFastDigits = 16;
+
+static const double s_powersOf10[MaxExactDigits + 1] =
+{
+    1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11, 1e12, 1e13, 1e14, 1e15
+};
+
+// 16 bytes at offset n form a shuffle mask that moves n leading bytes
+// to the end of a vector and zeroes the bytes in front of them.
+static const int8_t s_rightAlignMasks[2 * MaxFastDigits] =
+{
+    -128, -128, -128, -128, -128, -128, -128, -128, -128, -128, -128, -128, -128, -128, -128, -128,
+    0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15
+};
+
+// Returns a mask with bit i set if p[i] is a decimal digit, for the FastParsingWindow bytes at p.
+inline uint32_t GetDigitMask(const char* p)
+{
+    const __m128i belowZero = _mm_set1_epi8('0' - 1);
+    const __m128i aboveNine = _mm_set1_epi8('9' + 1);
+    __m128i low = _mm_loadu_si128(reinterpret_cast<const __m128i*>(p));
+    __m128i high = _mm_loadu_si128(reinterpret_cast<const __m128i*>(p + 16));
+    uint32_t lowMask = _mm_movemask_epi8(_mm_and_si128(_mm_cmpgt_epi8(low, belowZero), _mm_cmplt_epi8(low, aboveNine)));
+    uint32_t highMask = _mm_movemask_epi8(_mm_and_si128(_mm_cmpgt_epi8(high, belowZero), _mm_cmplt_epi8(high, aboveNine)));
+    return lowMask | (highMask << 16);
+}
+
+// Returns the number of consecutive digits starting at the given position of the digit mask.
+inline size_t CountDigits(uint32_t digitMask, size_t start)
+{
+    uint32_t nonDigits = ~(digitMask >> start);
+    if (nonDigits == 0)
+    {
+        return FastParsingWindow - start;
+    }
+#ifdef _MSC_VER
+    unsigned long index;
+    _BitScanForward(&index, nonDigits);
+    return index;
+#else
+    return __builtin_ctz(nonDigits);
+#endif
+}
+
+// Converts 'count' (at most MaxFastDigits) decimal digits at p into their value, without a loop over
+// the digits: the digits are right-aligned in a vector and pairs, quadruples and octets of them are
+// combined with multiply-adds. At least 16 bytes must be readable at p.
+inline uint64_t ParseDigits(const char* p, size_t count)
+{
+    assert(count <= MaxFastDigits);
+    __m128i digits = _mm_sub_epi8(_mm_loadu_si128(reinterpret_cast<const __m128i*>(p)), _mm_set1_epi8('0'));
+    digits = _mm_shuffle_epi8(digits, _mm_loadu_si128(reinterpret_cast<const __m128i*>(s_rightAlignMasks + count)));
+    __m128i pairs = _mm_maddubs_epi16(digits, _mm_setr_epi8(10, 1, 10, 1, 10, 1, 10, 1, 10, 1, 10, 1, 10, 1, 10, 1));
+    __m128i quadruples = _mm_madd_epi16(pairs, _mm_setr_epi16(100, 1, 100, 1, 100, 1, 100, 1));
+    quadruples = _mm_packs_epi32(quadruples, quadruples);
+    __m128i octets = _mm_madd_epi16(quadruples, _mm_setr_epi16(10000, 1, 10000, 1, 10000, 1, 10000, 1));
+    uint64_t high = static_cast<uint32_t>(_mm_cvtsi128_si32(octets));
+    uint64_t low = static_cast<uint32_t>(_mm_cvtsi128_si32(_mm_srli_si128(octets, 4)));
+    return high * 100000000 + low;
+}
+#endif
+
 enum State
 {
     Init = 0,
@@ -68,6 +150,8 @@ TextParser(corpus, helper.GetFilePath(), helper.GetStreams(), isPrimary)
     SetMaxAllowedErrors(helper.GetMaxAllowedErrors());
     SetChunkSize(helper.GetChunkSize());
     SetSkipSequenceIds(helper.ShouldSkipSequenceIds());
+    SetCacheIndex(helper.ShouldCacheIndex());
+    SetNumIndexingThreads(helper.GetNumIndexingThreads());
 
     Initialize();
 }
@@ -90,6 +174,9 @@ TextParser<ElemType>::TextParser(CorpusDescriptorPtr corpus, const std::wstring&
     m_hadWarnings(false),
     m_numAllowedErrors(0),
     m_skipSequenceIds(false),
+    m_cacheIndex(false),
+    m_numIndexingThreads(1),
+    m_useFastParsing(true),
     m_numRetries(5),
     m_corpus(corpus),
     m_isPrimary(isPrimary)
@@ -170,7 +257,26 @@ void TextParser<ElemType>::Initialize()
 
         m_indexer = make_unique<Indexer>(m_file, m_isPrimary, m_skipSequenceIds, m_chunkSizeBytes);
 
-        m_indexer->Build(m_corpus);
+        // The cached index is only valid for the whole input, not for a subset selected by the corpus.
+        bool useIndexCache = m_cacheIndex && m_corpus->IsIncludingAll();
+        std::wstring cacheFile = m_filename + L".index";
+        if (useIndexCache && m_indexer->TryLoadCache(cacheFile, m_filename))
+        {
+            if (m_traceLevel >= Info)
+            {
+                fprintf(stderr, "INFO: Loaded the index of the input file (%ls) from '%ls'.\n",
+                    m_filename.c_str(), cacheFile.c_str());
+            }
+            return;
+        }
+
+        m_indexer->Build(m_corpus, m_filename, m_numIndexingThreads);
+
+        if (useIndexCache && !m_indexer->SaveCache(cacheFile, m_filename) && m_traceLevel >= Warning)
+        {
+            fprintf(stderr, "WARNING: Could not write the index of the input file (%ls) to '%ls'.\n",
+                m_filename.c_str(), cacheFile.c_str());
+        }
     });
 
     assert(m_indexer != nullptr);
@@ -347,12 +453,12 @@ typename TextParser<ElemType>::SequenceBuffer TextParser<ElemType>::LoadSequence
     {
         if (stream.m_type == StorageType::dense)
         {
-            sequence.push_back(make_unique<DenseInputStreamBuffer>(
+            sequence.push_back(MakeSequenceData<DenseInputStreamBuffer>(
                 stream.m_sampleDimension * sequenceDsc.m_numberOfSamples));
         }
         else
         {
-            sequence.push_back(make_unique<SparseInputStreamBuffer>());
+            sequence.push_back(MakeSequenceData<SparseInputStreamBuffer>());
         }
     }
 
@@ -590,7 +696,7 @@ bool TextParser<ElemType>::TryReadSample(SequenceBuffer& sequence, size_t& bytes
     if (stream.m_type == StorageType::dense)
     {
         DenseInputStreamBuffer* data = reinterpret_cast<DenseInputStreamBuffer*>(sequence[id].get());
-        vector<ElemType>& values = data->m_buffer;
+        PooledVector<ElemType>& values = data->m_buffer;
         size_t size = values.size();
         assert(size % stream.m_sampleDimension == 0);
         if (!TryReadDenseSample(values, stream.m_sampleDimension, bytesToRead))
@@ -610,8 +716,8 @@ bool TextParser<ElemType>::TryReadSample(SequenceBuffer& sequence, size_t& bytes
     else
     {
         SparseInputStreamBuffer* data = reinterpret_cast<SparseInputStreamBuffer*>(sequence[id].get());
-        vector<ElemType>& values = data->m_buffer;
-        vector<IndexType>& indices = data->m_indicesBuffer;
+        PooledVector<ElemType>& values = data->m_buffer;
+        PooledVector<IndexType>& indices = data->m_indicesBuffer;
         assert(values.size() == indices.size());
         size_t size = values.size();
         if (!TryReadSparseSample(values, indices, stream.m_sampleDimension, bytesToRead))
@@ -720,7 +826,7 @@ bool TextParser<ElemType>::TryGetInputId(size_t& id, size_t& bytesToRead)
 }
 
 template <class ElemType>
-bool TextParser<ElemType>::TryReadDenseSample(vector<ElemType>& values, size_t sampleSize, size_t& bytesToRead)
+bool TextParser<ElemType>::TryReadDenseSample(PooledVector<ElemType>& values, size_t sampleSize, size_t& bytesToRead)
 {
     size_t counter = 0;
     ElemType value;
@@ -793,7 +899,7 @@ bool TextParser<ElemType>::TryReadDenseSample(vector<ElemType>& values, size_t s
 }
 
 template <class ElemType>
-bool TextParser<ElemType>::TryReadSparseSample(std::vector<ElemType>& values, std::vector<IndexType>& indices,
+bool TextParser<ElemType>::TryReadSparseSample(PooledVector<ElemType>& values, PooledVector<IndexType>& indices,
     size_t sampleSize, size_t& bytesToRead)
 {
     size_t index = 0;
@@ -913,6 +1019,21 @@ void TextParser<ElemType>::SkipToNextInput(size_t& bytesToRead)
 template <class ElemType>
 bool TextParser<ElemType>::TryReadUint64(size_t& value, size_t& bytesToRead)
 {
+#ifdef TEXT_PARSER_SIMD
+    // Fast path: an index of up to 16 digits (cannot overflow) followed by a non-digit.
+    if (m_useFastParsing && bytesToRead >= FastParsingMinBytes && (size_t)(m_bufferEnd - m_pos) >= FastParsingMinBytes)
+    {
+        size_t numDigits = CountDigits(GetDigitMask(m_pos), 0);
+        if (numDigits > 0 && numDigits <= MaxFastDigits)
+        {
+            value = ParseDigits(m_pos, numDigits);
+            m_pos += numDigits;
+            bytesToRead -= numDigits;
+            return true;
+        }
+    }
+#endif
+
     value = 0;
     bool found = false;
     while (bytesToRead && CanRead())
@@ -965,6 +1086,11 @@ bool TextParser<ElemType>::TryReadUint64(size_t& value, size_t& bytesToRead)
 template <class ElemType>
 bool TextParser<ElemType>::TryReadRealNumber(ElemType& value, size_t& bytesToRead)
 {
+    if (m_useFastParsing && TryReadRealNumberFast(value, bytesToRead))
+    {
+        return true;
+    }
+
     State state = State::Init;
     double coefficient = .0, number = .0, divider = .0;
     bool negative = false;
@@ -1159,6 +1285,67 @@ bool TextParser<ElemType>::TryReadRealNumber(ElemType& value, size_t& bytesToRea
     return false;
 }
 
+// Fast path for the common forms of real numbers: an optional sign, at most 15 integral digits and
+// optionally a period followed by at most 15 fractional digits. The digits and the terminating character
+// are found with SIMD compares over a window of the buffer and converted with SIMD multiply-adds.
+// The value is computed with exactly the same floating point operations as in TryReadRealNumber(),
+// so that both give identical results.
+// Returns false without consuming any input if the number is of some other form (e.g., has an exponent)
+// or not completely inside the window; it is then left to the scalar state machine.
+template <class ElemType>
+bool TextParser<ElemType>::TryReadRealNumberFast(ElemType& value, size_t& bytesToRead)
+{
+#ifdef TEXT_PARSER_SIMD
+    if (bytesToRead < FastParsingMinBytes || (size_t)(m_bufferEnd - m_pos) < FastParsingMinBytes)
+    {
+        return false;
+    }
+
+    const char* p = m_pos;
+    uint32_t digitMask = GetDigitMask(p);
+
+    bool negative = (p[0] == '-');
+    size_t start = isSign(p[0]) ? 1 : 0;
+    size_t integralDigits = CountDigits(digitMask, start);
+    if (integralDigits == 0 || integralDigits > MaxExactDigits)
+    {
+        return false;
+    }
+
+    size_t end = start + integralDigits;
+    size_t fractionalDigits = 0;
+    if (p[end] == '.')
+    {
+        fractionalDigits = CountDigits(digitMask, end + 1);
+        if (fractionalDigits > MaxExactDigits)
+        {
+            return false;
+        }
+        end += 1 + fractionalDigits;
+    }
+
+    if (end >= FastParsingWindow || p[end] == '.' || isE(p[end]))
+    {
+        return false;
+    }
+
+    double number = static_cast<double>(ParseDigits(p + start, integralDigits));
+    if (fractionalDigits > 0)
+    {
+        number += static_cast<double>(ParseDigits(p + end - fractionalDigits, fractionalDigits)) / s_powersOf10[fractionalDigits];
+    }
+
+    value = static_cast<ElemType>((negative) ? -number : number);
+    m_pos += end;
+    bytesToRead -= end;
+    return true;
+#else
+    UNUSED(value);
+    UNUSED(bytesToRead);
+    return false;
+#endif
+}
+
 template <class ElemType>
 void TextParser<ElemType>::SetTraceLevel(unsigned int traceLevel)
 {
@@ -1177,6 +1364,24 @@ void TextParser<ElemType>::SetSkipSequenceIds(bool skip)
     m_skipSequenceIds = skip;
 }
 
+template <class ElemType>
+void TextParser<ElemType>::SetCacheIndex(bool cacheIndex)
+{
+    m_cacheIndex = cacheIndex;
+}
+
+template <class ElemType>
+void TextParser<ElemType>::SetNumIndexingThreads(size_t numThreads)
+{
+    m_numIndexingThreads = numThreads;
+}
+
+template <class ElemType>
+void TextParser<ElemType>::SetUseFastParsing(bool useFastParsing)
+{
+    m_useFastParsing = useFastParsing;
+}
+
 template <class ElemType>
 void TextParser<ElemType>::SetChunkSize(size_t size)
 {
@@ -54,7 +54,7 @@ private:
             return m_buffer.data();
         }
 
-        std::vector<ElemType> m_buffer;
+        PooledVector<ElemType> m_buffer;
     };
 
     // In case of sparse input, we also need a vector of
@@ -72,8 +72,8 @@ private:
             return m_buffer.data();
         }
 
-        std::vector<IndexType> m_indicesBuffer;
-        std::vector<ElemType> m_buffer;
+        PooledVector<IndexType> m_indicesBuffer;
+        PooledVector<ElemType> m_buffer;
     };
 
     // A sequence buffer is a vector that contains sequence data for each input stream.
@@ -120,6 +120,9 @@ private:
     bool m_hadWarnings;
     unsigned int m_numAllowedErrors;
     bool m_skipSequenceIds;
+    bool m_cacheIndex; // if true, the index is kept in a file next to the input and reused by later runs
+    size_t m_numIndexingThreads; // number of threads indexing the input file in parallel
+    bool m_useFastParsing; // if false, numbers are always parsed by the scalar state machine (used in tests)
     unsigned int m_numRetries; // specifies the number of times an unsuccessful
     // file operation should be repeated (default value is 5).
 
@@ -155,13 +158,16 @@ private:
 
     bool TryReadRealNumber(ElemType& value, size_t& bytesToRead);
 
+    // Vectorized fast path of TryReadRealNumber() for the common decimal forms.
+    bool TryReadRealNumberFast(ElemType& value, size_t& bytesToRead);
+
     bool TryReadUint64(size_t& value, size_t& bytesToRead);
 
     // Reads dense sample values into the provided vector.
-    bool TryReadDenseSample(std::vector<ElemType>& values, size_t sampleSize, size_t& bytesToRead);
+    bool TryReadDenseSample(PooledVector<ElemType>& values, size_t sampleSize, size_t& bytesToRead);
 
     // Reads sparse sample values and corresponding indices into the provided vectors.
-    bool TryReadSparseSample(std::vector<ElemType>& values, std::vector<IndexType>& indices,
+    bool TryReadSparseSample(PooledVector<ElemType>& values, PooledVector<IndexType>& indices,
         size_t sampleSize, size_t& bytesToRead);
 
     // Reads one sample (an input identifier followed by a list of values)
@@ -191,6 +197,12 @@ private:
 
     void SetSkipSequenceIds(bool skip);
 
+    void SetCacheIndex(bool cacheIndex);
+
+    void SetNumIndexingThreads(size_t numThreads);
+
+    void SetUseFastParsing(bool useFastParsing);
+
     void SetChunkSize(size_t size);
 
     void SetNumRetries(unsigned int numRetries);
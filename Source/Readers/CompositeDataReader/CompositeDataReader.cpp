@@ -18,6 +18,7 @@
 #include "FramePacker.h"
 #include "SequencePacker.h"
 #include "TruncatedBpttPacker.h"
+#include "LengthBucketingEnumerator.h"
 #include "CorpusDescriptor.h"
 #include "ConfigUtil.h"
 #include "StringUtil.h"
@@ -104,6 +105,9 @@ CompositeDataReader::CompositeDataReader(const ConfigParameters& config) :
     // It makes sense to put it to true for cases when deserialization is CPU intensive,
     // i.e. decompression of images.
     bool multiThreadedDeserialization = config(L"multiThreadedDeserialization", ContainsDeserializer(config, L"ImageDeserializer"));
+
+    // Number of chunks loaded concurrently. Only for deserializers that can load different chunks at the same time.
+    size_t maxParallelChunkLoads = config(L"maxParallelChunkLoads", (size_t)1);
     if (randomize)
     {
         // By default randomizing the whole data set.
@@ -120,11 +124,21 @@ CompositeDataReader::CompositeDataReader(const ConfigParameters& config) :
 
         // By default using STL random number generator.
         bool useLegacyRandomization = config(L"useLegacyRandomization", false);
-        m_sequenceEnumerator = std::make_shared<BlockRandomizer>(verbosity, randomizationWindow, deserializer, true /* should Prefetch */, useLegacyRandomization, multiThreadedDeserialization);
+
+        // In frame mode, frames can be randomized without a description of each frame of the randomization window.
+        bool frameRandomization = m_packingMode == PackingMode::sample && config(L"frameRandomization", false);
+        auto randomizer = std::make_shared<BlockRandomizer>(verbosity, randomizationWindow, deserializer, true /* should Prefetch */, useLegacyRandomization, multiThreadedDeserialization, maxParallelChunkLoads, frameRandomization);
+
+        // Across workers, the samples of a minibatch can be balanced instead of only distributing the chunks.
+        if (config(L"sampleBalancedDecimation", false))
+            randomizer->SetSampleBalancedDecimation(config(L"decimationTolerance", 0.1));
+        m_sequenceEnumerator = randomizer;
     }
     else
     {
-        m_sequenceEnumerator = std::make_shared<NoRandomizer>(deserializer, multiThreadedDeserialization);
+        // Without randomization, as many chunks are loaded ahead, up to 'prefetchWindow' samples.
+        size_t prefetchWindow = config(L"prefetchWindow", requestDataSize);
+        m_sequenceEnumerator = std::make_shared<NoRandomizer>(deserializer, multiThreadedDeserialization, maxParallelChunkLoads, prefetchWindow);
     }
 
     // In case when there are transforms, applying them to the data.
@@ -132,6 +146,11 @@ CompositeDataReader::CompositeDataReader(const ConfigParameters& config) :
         ? m_sequenceEnumerator
         : std::make_shared<TransformController>(m_transforms, m_sequenceEnumerator);
 
+    // Minibatches of sequences of similar length, bucketed over the given number of minibatches.
+    size_t bucketingWindow = config(L"bucketingWindow", (size_t)0);
+    if (bucketingWindow > 0 && m_packingMode == PackingMode::sequence)
+        m_sequenceEnumerator = std::make_shared<LengthBucketingEnumerator>(m_sequenceEnumerator, bucketingWindow, verbosity);
+
     // TODO: Creating output stream descriptions - this should come from the network so that we can check 
     // that input matches what the network expects (including tensor shape, etc.).
     for (const auto& streamDescription : m_sequenceEnumerator->GetStreamDescriptions())
@@ -12,6 +12,7 @@
 #include "DataReader.h"
 #include "CompositeDataReader.h"
 #include "ReaderShim.h"
+#include "SyntheticDataDeserializer.h"
 
 namespace Microsoft { namespace MSR { namespace CNTK {
 
@@ -49,4 +50,16 @@ extern "C" DATAREADER_API Reader* CreateCompositeDataReader(const ConfigParamete
     return new CompositeDataReader(*parameters);
 }
 
+// A deserializer of generated data, to measure the reader pipeline without input files.
+extern "C" DATAREADER_API bool CreateDeserializer(IDataDeserializer** deserializer, const std::wstring& type, const ConfigParameters& deserializerConfig, CorpusDescriptorPtr corpus, bool isPrimary)
+{
+    if (type == L"SyntheticDataDeserializer")
+        *deserializer = new SyntheticDataDeserializer(corpus, deserializerConfig, isPrimary);
+    else
+        InvalidArgument("Unknown deserializer type '%ls'", type.c_str());
+
+    // Deserializer created.
+    return true;
+}
+
 }}}
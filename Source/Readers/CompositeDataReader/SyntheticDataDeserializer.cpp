@@ -0,0 +1,244 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE.md file in the project root for full license information.
+//
+// SyntheticDataDeserializer.cpp -- deserializer of generated data, to measure the reader pipeline without any input files
+//
+
+#include "stdafx.h"
+#include "SyntheticDataDeserializer.h"
+#include "SequenceData.h"
+#include "StringUtil.h"
+#include <algorithm>
+#include <numeric>
+#include <random>
+
+namespace Microsoft { namespace MSR { namespace CNTK {
+
+template <class ElemType>
+static void FillValues(std::vector<char>& buffer, size_t count, std::mt19937& rng, bool ones)
+{
+    buffer.resize(count * sizeof(ElemType));
+    ElemType* values = reinterpret_cast<ElemType*>(buffer.data());
+    if (ones)
+    {
+        std::fill(values, values + count, (ElemType) 1);
+        return;
+    }
+    std::uniform_real_distribution<ElemType> uniform(0, 1);
+    std::generate(values, values + count, [&] { return uniform(rng); });
+}
+
+// The data of all sequences of a chunk, generated when the chunk is loaded.
+class SyntheticDataDeserializer::SyntheticChunk : public Chunk, public std::enable_shared_from_this<Chunk>
+{
+public:
+    SyntheticChunk(const SyntheticDataDeserializer& parent, ChunkIdType chunkId)
+        : m_parent(parent), m_firstSequence(chunkId * parent.m_sequencesPerChunk)
+    {
+        size_t numSequences = m_parent.ChunkSize(chunkId);
+        m_sampleOffsets.resize(numSequences + 1, 0);
+        for (size_t i = 0; i < numSequences; i++)
+            m_sampleOffsets[i + 1] = m_sampleOffsets[i] + m_parent.m_sequenceLengths[m_firstSequence + i];
+        size_t numSamples = m_sampleOffsets.back();
+
+        std::mt19937 rng(m_parent.m_seed + chunkId);
+        const auto& streams = m_parent.m_streamInfos;
+        m_values.resize(streams.size());
+        m_rows.resize(streams.size());
+        for (size_t s = 0; s < streams.size(); s++)
+        {
+            bool isSparse = streams[s].m_nnzPerSample > 0;
+            size_t numValues = numSamples * (isSparse ? streams[s].m_nnzPerSample : streams[s].m_dim);
+            if (m_parent.m_elementType == ElementType::tfloat)
+                FillValues<float>(m_values[s], numValues, rng, isSparse);
+            else
+                FillValues<double>(m_values[s], numValues, rng, isSparse);
+            if (!isSparse)
+                continue;
+
+            // distinct rows, evenly spaced from a random one
+            size_t dim = streams[s].m_dim, nnz = streams[s].m_nnzPerSample;
+            size_t step = dim / nnz;
+            std::uniform_int_distribution<size_t> firstRow(0, dim - 1);
+            m_rows[s].resize(numValues);
+            for (size_t i = 0; i < numSamples; i++)
+            {
+                IndexType* rows = &m_rows[s][i * nnz];
+                size_t row = firstRow(rng);
+                for (size_t k = 0; k < nnz; k++)
+                    rows[k] = (IndexType) ((row + k * step) % dim);
+                std::sort(rows, rows + nnz);
+            }
+        }
+    }
+
+    void GetSequence(size_t sequenceId, std::vector<SequenceDataPtr>& result) override
+    {
+        size_t index = sequenceId - m_firstSequence;
+        assert(index + 1 < m_sampleOffsets.size());
+        size_t firstSample = m_sampleOffsets[index];
+        uint32_t numSamples = (uint32_t) (m_sampleOffsets[index + 1] - firstSample);
+        const auto& streams = m_parent.m_streamInfos;
+
+        result.resize(streams.size());
+        for (size_t s = 0; s < streams.size(); s++)
+        {
+            size_t nnz = streams[s].m_nnzPerSample;
+            if (nnz > 0)
+            {
+                auto sequence = MakeSequenceData<ChunkBackedSparseSequenceData>();
+                sequence->m_id = sequenceId;
+                sequence->m_numberOfSamples = numSamples;
+                sequence->m_elementType = m_parent.m_elementType;
+                sequence->m_chunk = shared_from_this();
+                sequence->m_data = m_values[s].data() + firstSample * nnz * m_parent.m_elementSize;
+                sequence->m_indices = &m_rows[s][firstSample * nnz];
+                sequence->m_nnzCounts.assign(numSamples, (IndexType) nnz);
+                sequence->m_totalNnzCount = (IndexType) (numSamples * nnz);
+                result[s] = sequence;
+            }
+            else
+            {
+                auto sequence = MakeSequenceData<ChunkBackedDenseSequenceData>();
+                sequence->m_id = sequenceId;
+                sequence->m_numberOfSamples = numSamples;
+                sequence->m_elementType = m_parent.m_elementType;
+                sequence->m_chunk = shared_from_this();
+                sequence->m_data = m_values[s].data() + firstSample * streams[s].m_dim * m_parent.m_elementSize;
+                result[s] = sequence;
+            }
+        }
+    }
+
+private:
+    const SyntheticDataDeserializer& m_parent;
+    size_t m_firstSequence;
+    std::vector<size_t> m_sampleOffsets;      // [numSequences + 1], of the first sample of each sequence in the chunk
+    std::vector<std::vector<char>> m_values;  // per stream
+    std::vector<std::vector<IndexType>> m_rows; // per stream, for the sparse ones
+
+    DISABLE_COPY_AND_MOVE(SyntheticChunk);
+};
+
+SyntheticDataDeserializer::SyntheticDataDeserializer(CorpusDescriptorPtr, const ConfigParameters& config, bool)
+{
+    std::string precision = config.Find("precision", "float");
+    if (AreEqualIgnoreCase(precision, "float"))
+    {
+        m_elementType = ElementType::tfloat;
+        m_elementSize = sizeof(float);
+    }
+    else if (AreEqualIgnoreCase(precision, "double"))
+    {
+        m_elementType = ElementType::tdouble;
+        m_elementSize = sizeof(double);
+    }
+    else
+        InvalidArgument("SyntheticDataDeserializer: Unsupported precision '%s'.", precision.c_str());
+
+    size_t numSequences = config(L"numSequences", (size_t) 100000);
+    size_t minSequenceLength = config(L"minSequenceLength", (size_t) 1);
+    size_t maxSequenceLength = config(L"maxSequenceLength", minSequenceLength);
+    m_sequencesPerChunk = config(L"sequencesPerChunk", (size_t) 1000);
+    m_seed = config(L"seed", (unsigned long) 0);
+    if (numSequences == 0 || m_sequencesPerChunk == 0)
+        InvalidArgument("SyntheticDataDeserializer: numSequences and sequencesPerChunk must be positive.");
+    if (minSequenceLength == 0 || maxSequenceLength < minSequenceLength)
+        InvalidArgument("SyntheticDataDeserializer: Invalid sequence lengths %d to %d.", (int) minSequenceLength, (int) maxSequenceLength);
+
+    if (!config.ExistsCurrent(L"input"))
+        InvalidArgument("SyntheticDataDeserializer: The configuration does not contain an \"input\" section.");
+    const ConfigParameters& input = config(L"input");
+    for (const std::pair<std::string, ConfigParameters>& section : input)
+    {
+        const ConfigParameters& streamConfig = section.second;
+        StreamInfo info;
+        info.m_dim = streamConfig(L"dim");
+        std::string format = streamConfig.Find("format", "dense");
+        if (AreEqualIgnoreCase(format, "sparse"))
+            info.m_nnzPerSample = streamConfig(L"nnzPerSample", (size_t) 1);
+        else if (AreEqualIgnoreCase(format, "dense"))
+            info.m_nnzPerSample = 0;
+        else
+            InvalidArgument("SyntheticDataDeserializer: Unknown format '%s' of input '%s', expected 'dense' or 'sparse'.", format.c_str(), section.first.c_str());
+        if (info.m_dim == 0 || info.m_nnzPerSample > info.m_dim)
+            InvalidArgument("SyntheticDataDeserializer: Invalid dimension or nnzPerSample of input '%s'.", section.first.c_str());
+
+        auto stream = std::make_shared<StreamDescription>();
+        stream->m_id = m_streams.size();
+        stream->m_name = msra::strfun::utf16(section.first);
+        stream->m_storageType = info.m_nnzPerSample > 0 ? StorageType::sparse_csc : StorageType::dense;
+        stream->m_elementType = m_elementType;
+        stream->m_sampleLayout = std::make_shared<TensorShape>(info.m_dim);
+        m_streams.push_back(stream);
+        m_streamInfos.push_back(info);
+    }
+    if (m_streams.empty())
+        InvalidArgument("SyntheticDataDeserializer: The \"input\" section is empty.");
+
+    std::mt19937 rng(m_seed);
+    std::uniform_int_distribution<uint32_t> length((uint32_t) minSequenceLength, (uint32_t) maxSequenceLength);
+    m_sequenceLengths.resize(numSequences);
+    std::generate(m_sequenceLengths.begin(), m_sequenceLengths.end(), [&] { return length(rng); });
+}
+
+size_t SyntheticDataDeserializer::ChunkSize(ChunkIdType chunkId) const
+{
+    size_t firstSequence = chunkId * m_sequencesPerChunk;
+    return std::min(m_sequencesPerChunk, m_sequenceLengths.size() - firstSequence);
+}
+
+ChunkDescriptions SyntheticDataDeserializer::GetChunkDescriptions()
+{
+    ChunkDescriptions result;
+    size_t numChunks = (m_sequenceLengths.size() + m_sequencesPerChunk - 1) / m_sequencesPerChunk;
+    result.reserve(numChunks);
+    for (ChunkIdType i = 0; i < numChunks; i++)
+    {
+        auto chunk = std::make_shared<ChunkDescription>();
+        chunk->m_id = i;
+        chunk->m_numberOfSequences = ChunkSize(i);
+        auto first = m_sequenceLengths.begin() + i * m_sequencesPerChunk;
+        chunk->m_numberOfSamples = std::accumulate(first, first + chunk->m_numberOfSequences, (size_t) 0);
+        result.push_back(chunk);
+    }
+    return result;
+}
+
+void SyntheticDataDeserializer::GetSequencesForChunk(ChunkIdType chunkId, std::vector<SequenceDescription>& result)
+{
+    size_t firstSequence = chunkId * m_sequencesPerChunk;
+    size_t numSequences = ChunkSize(chunkId);
+    result.reserve(result.size() + numSequences);
+    for (size_t i = 0; i < numSequences; i++)
+    {
+        SequenceDescription sequence;
+        sequence.m_id = firstSequence + i;
+        sequence.m_numberOfSamples = m_sequenceLengths[sequence.m_id];
+        sequence.m_chunkId = chunkId;
+        sequence.m_key.m_sequence = sequence.m_id;
+        sequence.m_key.m_sample = 0;
+        result.push_back(sequence);
+    }
+}
+
+ChunkPtr SyntheticDataDeserializer::GetChunk(ChunkIdType chunkId)
+{
+    return std::make_shared<SyntheticChunk>(*this, chunkId);
+}
+
+bool SyntheticDataDeserializer::GetSequenceDescriptionByKey(const KeyType& key, SequenceDescription& result)
+{
+    size_t id = key.m_sequence;
+    if (id >= m_sequenceLengths.size())
+        return false;
+
+    result.m_id = id;
+    result.m_numberOfSamples = m_sequenceLengths[id];
+    result.m_chunkId = (ChunkIdType) (id / m_sequencesPerChunk);
+    result.m_key = key;
+    return true;
+}
+
+}}}
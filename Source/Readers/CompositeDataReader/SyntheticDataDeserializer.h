@@ -0,0 +1,56 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE.md file in the project root for full license information.
+//
+// SyntheticDataDeserializer.h -- deserializer of generated data, to measure the reader pipeline without any input files
+//
+
+#pragma once
+
+#include "DataDeserializerBase.h"
+#include "CorpusDescriptor.h"
+#include "Config.h"
+
+namespace Microsoft { namespace MSR { namespace CNTK {
+
+// Generates 'numSequences' sequences of between 'minSequenceLength' and 'maxSequenceLength' samples, in chunks of
+// 'sequencesPerChunk' sequences, for each stream of the 'input' section:
+//     input = [
+//         features = [ dim = 784 ]                                  # dense, uniform in [0, 1)
+//         labels = [ dim = 10 ; format = "sparse" ; nnzPerSample = 1 ] # sparse, ones at random rows
+//     ]
+// The data of a chunk is generated when the chunk is loaded, from 'seed' and the chunk id, so that every run sees
+// the same data; the sequences point into it. The keys are the indices of the sequences, which makes it possible to
+// bundle it with other deserializers.
+class SyntheticDataDeserializer : public DataDeserializerBase
+{
+public:
+    SyntheticDataDeserializer(CorpusDescriptorPtr corpus, const ConfigParameters& config, bool primary);
+
+    ChunkDescriptions GetChunkDescriptions() override;
+    void GetSequencesForChunk(ChunkIdType chunkId, std::vector<SequenceDescription>& result) override;
+    ChunkPtr GetChunk(ChunkIdType chunkId) override;
+
+protected:
+    bool GetSequenceDescriptionByKey(const KeyType& key, SequenceDescription& result) override;
+
+private:
+    class SyntheticChunk;
+
+    struct StreamInfo
+    {
+        size_t m_dim;
+        size_t m_nnzPerSample; // 0 for dense streams
+    };
+
+    size_t ChunkSize(ChunkIdType chunkId) const;
+
+    ElementType m_elementType;
+    size_t m_elementSize;
+    std::vector<StreamInfo> m_streamInfos;
+    std::vector<uint32_t> m_sequenceLengths;
+    size_t m_sequencesPerChunk;
+    unsigned long m_seed;
+};
+
+}}}
@@ -0,0 +1,258 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE.md file in the project root for full license information.
+//
+// DSSMDeserializer.cpp -- deserializer of the binary format of the DSSMReader
+//
+
+#include "stdafx.h"
+#include "DSSMDeserializer.h"
+#include "SequenceData.h"
+#include "StringUtil.h"
+
+namespace Microsoft { namespace MSR { namespace CNTK {
+
+static_assert(sizeof(IndexType) == sizeof(int32_t), "the row indices of the files are used as the indices of the sparse sequences");
+
+static const size_t c_headerSize = sizeof(int64_t) + sizeof(int32_t) + sizeof(int64_t);
+
+// The rows of a chunk, which are located and checked when the chunk is loaded.
+class DSSMDeserializer::DSSMChunk : public Chunk, public std::enable_shared_from_this<Chunk>
+{
+public:
+    DSSMChunk(const DSSMDeserializer& parent, ChunkIdType chunkId)
+        : m_parent(parent),
+          m_firstRow(chunkId * parent.m_rowsPerChunk),
+          m_numRows(std::min(parent.m_rowsPerChunk, parent.m_numRows - m_firstRow))
+    {
+        m_rows.resize(m_parent.m_inputs.size());
+        for (size_t s = 0; s < m_parent.m_inputs.size(); s++)
+        {
+            const Input& input = m_parent.m_inputs[s];
+            if (!input.m_file)
+                continue;
+
+            const MappedFile& file = *input.m_file;
+            size_t begin = RowOffset(input, m_firstRow);
+            size_t end = m_firstRow + m_numRows < m_parent.m_numRows ? RowOffset(input, m_firstRow + m_numRows) : file.GetSize();
+            if (begin < end) // (the rows are usually in order)
+                file.WillNeed(begin, end - begin);
+
+            std::vector<Row>& rows = m_rows[s];
+            rows.resize(m_numRows);
+            for (size_t i = 0; i < m_numRows; i++)
+            {
+                size_t offset = RowOffset(input, m_firstRow + i);
+                int32_t nnz = Read<int32_t>(file, offset);
+                offset += sizeof(int32_t);
+                if (nnz < 0 || offset + nnz * (m_parent.m_elementSize + sizeof(int32_t)) > file.GetSize())
+                    RuntimeError("DSSMDeserializer: Row %d of stream '%ls' is truncated.", (int) (m_firstRow + i), m_parent.m_streams[s]->m_name.c_str());
+
+                Row& row = rows[i];
+                row.m_nnz = nnz;
+                row.m_values = file.GetData() + offset;
+                row.m_indices = (const IndexType*) (file.GetData() + offset + nnz * m_parent.m_elementSize);
+                for (int32_t j = 0; j < nnz; j++)
+                {
+                    IndexType index = row.m_indices[j];
+                    if (index < 0 || (size_t) index >= input.m_dim)
+                        RuntimeError("DSSMDeserializer: Row %d of stream '%ls' has index %d, but the dimension is %d.",
+                                     (int) (m_firstRow + i), m_parent.m_streams[s]->m_name.c_str(), (int) index, (int) input.m_dim);
+                }
+            }
+        }
+    }
+
+    void GetSequence(size_t sequenceId, std::vector<SequenceDataPtr>& result) override
+    {
+        assert(sequenceId >= m_firstRow && sequenceId < m_firstRow + m_numRows);
+        size_t i = sequenceId - m_firstRow;
+
+        result.resize(m_parent.m_inputs.size());
+        for (size_t s = 0; s < m_parent.m_inputs.size(); s++)
+        {
+            if (!m_parent.m_inputs[s].m_file)
+            {
+                auto sequence = MakeSequenceData<ChunkBackedDenseSequenceData>();
+                sequence->m_id = sequenceId;
+                sequence->m_numberOfSamples = 1;
+                sequence->m_elementType = m_parent.m_elementType;
+                sequence->m_chunk = shared_from_this();
+                sequence->m_data = m_parent.m_label.data();
+                result[s] = sequence;
+                continue;
+            }
+
+            const Row& row = m_rows[s][i];
+            auto sequence = MakeSequenceData<ChunkBackedSparseSequenceData>();
+            sequence->m_id = sequenceId;
+            sequence->m_numberOfSamples = 1;
+            sequence->m_elementType = m_parent.m_elementType;
+            sequence->m_chunk = shared_from_this();
+            sequence->m_data = row.m_values;
+            sequence->m_indices = const_cast<IndexType*>(row.m_indices);
+            sequence->m_nnzCounts.assign(1, row.m_nnz);
+            sequence->m_totalNnzCount = row.m_nnz;
+            result[s] = sequence;
+        }
+    }
+
+private:
+    // pointers into the mapping
+    struct Row
+    {
+        IndexType m_nnz;
+        const char* m_values;
+        const IndexType* m_indices;
+    };
+
+    static size_t RowOffset(const Input& input, size_t row)
+    {
+        int64_t offset = Read<int64_t>(*input.m_file, c_headerSize + row * sizeof(int64_t));
+        if (offset < 0)
+            RuntimeError("DSSMDeserializer: Invalid offset of row %d.", (int) row);
+        return input.m_rowsStart + (size_t) offset;
+    }
+
+    const DSSMDeserializer& m_parent;
+    size_t m_firstRow;
+    size_t m_numRows;
+    std::vector<std::vector<Row>> m_rows; // [stream][row in the chunk], empty for the label stream
+
+    DISABLE_COPY_AND_MOVE(DSSMChunk);
+};
+
+template <class T>
+T DSSMDeserializer::Read(const MappedFile& file, size_t offset)
+{
+    if (offset + sizeof(T) > file.GetSize())
+        RuntimeError("DSSMDeserializer: Unexpected end of file at offset %lu.", (unsigned long) offset);
+
+    // the file is not aligned
+    T value;
+    memcpy(&value, file.GetData() + offset, sizeof(value));
+    return value;
+}
+
+DSSMDeserializer::DSSMDeserializer(CorpusDescriptorPtr, const ConfigParameters& config, bool)
+    : m_numRows(SIZE_MAX)
+{
+    std::string precision = config.Find("precision", "float");
+    if (AreEqualIgnoreCase(precision, "float"))
+    {
+        m_elementType = ElementType::tfloat;
+        m_elementSize = sizeof(float);
+    }
+    else if (AreEqualIgnoreCase(precision, "double"))
+    {
+        m_elementType = ElementType::tdouble;
+        m_elementSize = sizeof(double);
+    }
+    else
+        InvalidArgument("DSSMDeserializer: Unsupported precision '%s'.", precision.c_str());
+
+    size_t chunkSizeInBytes = config(L"chunkSizeInBytes", (size_t) 32 * 1024 * 1024);
+
+    size_t bytesPerRow = 0; // on average, in all files together
+    size_t labelDim = 0;
+    const ConfigParameters& input = config(L"input");
+    for (const std::pair<std::string, ConfigParameters>& section : input)
+    {
+        const ConfigParameters& streamConfig = section.second;
+        Input stream;
+        stream.m_dim = streamConfig(L"dim");
+        stream.m_rowsStart = 0;
+        if (streamConfig.ExistsCurrent(L"file"))
+        {
+            std::wstring filename = streamConfig(L"file");
+            stream.m_file = std::make_shared<MappedFile>(filename);
+            int64_t numRows = Read<int64_t>(*stream.m_file, 0);
+            stream.m_rowsStart = c_headerSize + numRows * sizeof(int64_t);
+            if (numRows <= 0 || stream.m_rowsStart > stream.m_file->GetSize())
+                RuntimeError("DSSMDeserializer: Invalid header of '%ls'.", filename.c_str());
+            if (m_numRows == SIZE_MAX)
+                m_numRows = (size_t) numRows;
+            else if (m_numRows != (size_t) numRows)
+                RuntimeError("DSSMDeserializer: '%ls' has %d rows, but the first file has %d.", filename.c_str(), (int) numRows, (int) m_numRows);
+            bytesPerRow += (stream.m_file->GetSize() - stream.m_rowsStart) / numRows;
+        }
+        else
+            labelDim = std::max(labelDim, stream.m_dim);
+
+        auto description = std::make_shared<StreamDescription>();
+        description->m_id = m_streams.size();
+        description->m_name = msra::strfun::utf16(section.first);
+        description->m_storageType = stream.m_file ? StorageType::sparse_csc : StorageType::dense;
+        description->m_elementType = m_elementType;
+        description->m_sampleLayout = std::make_shared<TensorShape>(stream.m_dim);
+        m_streams.push_back(description);
+        m_inputs.push_back(stream);
+    }
+    if (m_numRows == SIZE_MAX)
+        InvalidArgument("DSSMDeserializer: At least one input must have a 'file'.");
+
+    m_label.assign(labelDim * m_elementSize, 0);
+    if (labelDim > 0)
+    {
+        if (m_elementType == ElementType::tfloat)
+            *(float*) m_label.data() = 1;
+        else
+            *(double*) m_label.data() = 1;
+    }
+
+    m_rowsPerChunk = std::max<size_t>(1, chunkSizeInBytes / std::max<size_t>(1, bytesPerRow));
+}
+
+ChunkDescriptions DSSMDeserializer::GetChunkDescriptions()
+{
+    ChunkDescriptions result;
+    size_t numChunks = (m_numRows + m_rowsPerChunk - 1) / m_rowsPerChunk;
+    result.reserve(numChunks);
+    for (ChunkIdType i = 0; i < numChunks; i++)
+    {
+        auto chunk = std::make_shared<ChunkDescription>();
+        chunk->m_id = i;
+        chunk->m_numberOfSequences = std::min(m_rowsPerChunk, m_numRows - i * m_rowsPerChunk);
+        chunk->m_numberOfSamples = chunk->m_numberOfSequences;
+        result.push_back(chunk);
+    }
+    return result;
+}
+
+void DSSMDeserializer::GetSequencesForChunk(ChunkIdType chunkId, std::vector<SequenceDescription>& result)
+{
+    size_t firstRow = chunkId * m_rowsPerChunk;
+    size_t numRows = std::min(m_rowsPerChunk, m_numRows - firstRow);
+    result.reserve(result.size() + numRows);
+    for (size_t i = 0; i < numRows; i++)
+    {
+        SequenceDescription sequence;
+        sequence.m_id = firstRow + i;
+        sequence.m_numberOfSamples = 1;
+        sequence.m_chunkId = chunkId;
+        sequence.m_key.m_sequence = sequence.m_id;
+        sequence.m_key.m_sample = 0;
+        result.push_back(sequence);
+    }
+}
+
+ChunkPtr DSSMDeserializer::GetChunk(ChunkIdType chunkId)
+{
+    return std::make_shared<DSSMChunk>(*this, chunkId);
+}
+
+// the keys are the indices of the rows
+bool DSSMDeserializer::GetSequenceDescriptionByKey(const KeyType& key, SequenceDescription& result)
+{
+    size_t id = key.m_sequence;
+    if (id >= m_numRows)
+        return false;
+
+    result.m_id = id;
+    result.m_numberOfSamples = 1;
+    result.m_chunkId = (ChunkIdType) (id / m_rowsPerChunk);
+    result.m_key = key;
+    return true;
+}
+
+}}}
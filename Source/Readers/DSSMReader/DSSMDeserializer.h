@@ -0,0 +1,63 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE.md file in the project root for full license information.
+//
+// DSSMDeserializer.h -- deserializer of the binary format of the DSSMReader
+//
+
+#pragma once
+
+#include "DataDeserializerBase.h"
+#include "CorpusDescriptor.h"
+#include "Config.h"
+#include "MappedFile.h"
+
+namespace Microsoft { namespace MSR { namespace CNTK {
+
+// Exposes the query and document files of the DSSMReader to the CompositeDataReader, so that they get the randomizers,
+// the chunk cache, the distributed decimation and the prefetching of the ReaderShim, on all platforms:
+//     deserializers = ([
+//         type = "DSSMDeserializer" ; module = "DSSMReader"
+//         input = [ Query = [ file = "query.bin" ; dim = 49292 ] ; Keyword = [ file = "doc.bin" ; dim = 49292 ] ; DSSMLabel = [ dim = 51 ] ]
+//     ])
+// A file starts with int64 numRows, int32 numCols, int64 totalNnz and int64 offsets[numRows] of the rows, relative to
+// the end of the offsets. A row is int32 nnz, ElemType values[nnz], int32 rowIndices[nnz], in the precision of the
+// reader as for the DSSMReader. Every row is a sequence of one sparse sample; all files must have the same number of
+// rows, and the row with the same index is taken from each. An input without a file is the label stream of the DSSM
+// criterion, whose samples are [1, 0, ..., 0], the positive document being the first of the 'dim' compared ones.
+// The files are memory-mapped, a chunk is a range of rows of about 'chunkSizeInBytes' bytes in all files together,
+// and the sequences point into the mappings.
+class DSSMDeserializer : public DataDeserializerBase
+{
+public:
+    DSSMDeserializer(CorpusDescriptorPtr corpus, const ConfigParameters& config, bool primary);
+
+    ChunkDescriptions GetChunkDescriptions() override;
+    void GetSequencesForChunk(ChunkIdType chunkId, std::vector<SequenceDescription>& result) override;
+    ChunkPtr GetChunk(ChunkIdType chunkId) override;
+
+protected:
+    bool GetSequenceDescriptionByKey(const KeyType& key, SequenceDescription& result) override;
+
+private:
+    class DSSMChunk;
+
+    struct Input
+    {
+        MappedFilePtr m_file; // nullptr for the label stream
+        size_t m_dim;
+        size_t m_rowsStart; // offset of the rows in the file, which the offsets are relative to
+    };
+
+    template <class T>
+    static T Read(const MappedFile& file, size_t offset);
+
+    ElementType m_elementType;
+    size_t m_elementSize;
+    std::vector<Input> m_inputs; // [stream]
+    std::vector<char> m_label;   // a sample of the label stream of the largest dimension
+    size_t m_numRows;
+    size_t m_rowsPerChunk;
+};
+
+}}}
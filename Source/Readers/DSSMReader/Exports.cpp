@@ -8,10 +8,14 @@
 #include "stdafx.h"
 #define DATAREADER_EXPORTS
 #include "DataReader.h"
-#include "DSSMReader.h"
+#ifdef __WINDOWS__
+#include "DSSMReader.h" // the legacy reader uses the Win32 file mapping
+#endif
+#include "DSSMDeserializer.h"
 
 namespace Microsoft { namespace MSR { namespace CNTK {
 
+#ifdef __WINDOWS__
 extern "C" DATAREADER_API void GetReaderF(IDataReader** preader)
 {
     *preader = new DSSMReader<float>();
@@ -20,5 +24,18 @@ extern "C" DATAREADER_API void GetReaderD(IDataReader** preader)
 {
     *preader = new DSSMReader<double>();
 }
+#endif
+
+// A factory method for creating the deserializer for the CompositeDataReader.
+extern "C" DATAREADER_API bool CreateDeserializer(IDataDeserializer** deserializer, const std::wstring& type, const ConfigParameters& deserializerConfig, CorpusDescriptorPtr corpus, bool isPrimary)
+{
+    if (type == L"DSSMDeserializer")
+        *deserializer = new DSSMDeserializer(corpus, deserializerConfig, isPrimary);
+    else
+        InvalidArgument("Unknown deserializer type '%ls'", type.c_str());
+
+    // Deserializer created.
+    return true;
+}
 
 }}}
@@ -5,16 +5,19 @@
 
 #pragma once
 
+#include "Platform.h"
 #include "targetver.h"
 
 #ifndef _CRT_SECURE_NO_WARNINGS
 #define _CRT_SECURE_NO_WARNINGS // "secure" CRT not available on all platforms  --add this at the top of all CPP files that give "function or variable may be unsafe" warnings
 #endif
 
+#ifdef __WINDOWS__
 #define WIN32_LEAN_AND_MEAN // Exclude rarely-used stuff from Windows headers
 // Windows Header Files:
 #define NOMINMAX
 #include "Windows.h"
+#endif
 
 // standard C stuff
 #include <stdio.h>
@@ -217,34 +217,32 @@ wstring ConfigHelper::GetRandomizer()
     return randomizer;
 }
 
-vector<wstring> ConfigHelper::GetSequencePaths()
+wstring ConfigHelper::GetScriptPath() const
 {
-    wstring scriptPath = m_config(L"scpFile");
-    wstring rootPath = m_config(L"prefixPathInSCP", L"");
-
-    vector<wstring> filelist;
-    fprintf(stderr, "Reading script file %ls ...", scriptPath.c_str());
+    return m_config(L"scpFile");
+}
 
-    // TODO: possibly change to class File, we should be able to read data from pipelines.E.g.
-    //  scriptPath = "gzip -c -d FILE.txt |", or do a popen with C++ streams, so that we can have a generic open function that returns an ifstream.
-    ifstream scp(msra::strfun::utf8(scriptPath).c_str());
-    if (!scp)
-        RuntimeError("Failed to open input file: %ls", scriptPath.c_str());
+wstring ConfigHelper::GetScriptPrefixPath() const
+{
+    return m_config(L"prefixPathInSCP", L"");
+}
 
-    string line;
-    while (getline(scp, line))
-    {
-        filelist.push_back(msra::strfun::utf16(line));
-    }
+wstring ConfigHelper::GetScriptCachePath() const
+{
+    return m_config(L"scpCacheFile", L"");
+}
 
-    if (scp.bad())
-        RuntimeError("An error occurred while reading input file: %ls", scriptPath.c_str());
+void ConfigHelper::ForEachSequencePath(const function<void(const wstring&)>& action) const
+{
+    wstring scriptPath = GetScriptPath();
+    wstring rootPath = GetScriptPrefixPath();
 
-    fprintf(stderr, " %d entries\n", static_cast<int>(filelist.size()));
+    fprintf(stderr, "Reading script file %ls ...", scriptPath.c_str());
 
-    // post processing file list :
+    // post processing of the entries:
     //  - if users specified PrefixPath, add the prefix to each of path in filelist
     //  - else do the dotdotdot expansion if necessary
+    bool expandDotDotDot = rootPath.empty();
     if (!rootPath.empty()) // user has specified a path prefix for this feature
     {
         // first make slash consistent (sorry for Linux users:this is not necessary for you)
@@ -253,55 +251,73 @@ vector<wstring> ConfigHelper::GetSequencePaths()
         // second, remove trailing slash if there is any
         wregex trailer(L"/+$");
         rootPath = regex_replace(rootPath, trailer, wstring());
+    }
 
-        // third, join the rootPath with each entry in filelist
-        if (!rootPath.empty())
+    /*
+            do "..." expansion if SCP uses relative path names
+            "..." in the SCP means full path is the same as the SCP file
+            for example, if scp file is "//aaa/bbb/ccc/ddd.scp"
+            and contains entry like
+            .../file1.feat
+            .../file2.feat
+            etc.
+            the features will be read from
+            //aaa/bbb/ccc/file1.feat
+            //aaa/bbb/ccc/file2.feat
+            etc.
+            This works well if you store the scp file with the features but
+            do not want different scp files everytime you move or create new features
+            */
+    wstring scpDirCached;
+    auto postProcess = [&](wstring& path)
+    {
+        if (expandDotDotDot)
         {
-            for (wstring& path : filelist)
-            {
-                if (path.find_first_of(L'=') != wstring::npos)
-                {
-                    vector<wstring> strarr = msra::strfun::split(path, L"=");
+            ExpandDotDotDot(path, scriptPath, scpDirCached);
+        }
+        else if (rootPath.empty())
+        {
+            return;
+        }
+        // join the rootPath with the entry
+        else if (path.find_first_of(L'=') != wstring::npos)
+        {
+            vector<wstring> strarr = msra::strfun::split(path, L"=");
 #ifdef WIN32
-                    replace(strarr[1].begin(), strarr[1].end(), L'\\', L'/');
+            replace(strarr[1].begin(), strarr[1].end(), L'\\', L'/');
 #endif
-                    path = strarr[0] + L"=" + rootPath + L"/" + strarr[1];
-                }
-                else
-                {
+            path = strarr[0] + L"=" + rootPath + L"/" + strarr[1];
+        }
+        else
+        {
 #ifdef WIN32
-                    replace(path.begin(), path.end(), L'\\', L'/');
+            replace(path.begin(), path.end(), L'\\', L'/');
 #endif
-                    path = rootPath + L"/" + path;
-                }
-            }
+            path = rootPath + L"/" + path;
         }
-    }
-    else
+    };
+
+    // TODO: possibly change to class File, we should be able to read data from pipelines.E.g.
+    //  scriptPath = "gzip -c -d FILE.txt |", or do a popen with C++ streams, so that we can have a generic open function that returns an ifstream.
+    ifstream scp(msra::strfun::utf8(scriptPath).c_str());
+    if (!scp)
+        RuntimeError("Failed to open input file: %ls", scriptPath.c_str());
+
+    size_t numEntries = 0;
+    string line;
+    wstring path;
+    while (getline(scp, line))
     {
-        /*
-                do "..." expansion if SCP uses relative path names
-                "..." in the SCP means full path is the same as the SCP file
-                for example, if scp file is "//aaa/bbb/ccc/ddd.scp"
-                and contains entry like
-                .../file1.feat
-                .../file2.feat
-                etc.
-                the features will be read from
-                //aaa/bbb/ccc/file1.feat
-                //aaa/bbb/ccc/file2.feat
-                etc.
-                This works well if you store the scp file with the features but
-                do not want different scp files everytime you move or create new features
-                */
-        wstring scpDirCached;
-        for (auto& entry : filelist)
-        {
-            ExpandDotDotDot(entry, scriptPath, scpDirCached);
-        }
+        path = msra::strfun::utf16(line);
+        postProcess(path);
+        action(path);
+        numEntries++;
     }
 
-    return filelist;
+    if (scp.bad())
+        RuntimeError("An error occurred while reading input file: %ls", scriptPath.c_str());
+
+    fprintf(stderr, " %d entries\n", static_cast<int>(numEntries));
 }
 
 intargvector ConfigHelper::GetNumberOfUtterancesPerMinibatchForAllEppochs()
@@ -4,6 +4,7 @@
 //
 #pragma once
 
+#include <functional>
 #include <utility>
 #include <string>
 #include <vector>
@@ -49,8 +50,16 @@ public:
     // Gets mlf file paths from the configuraiton.
     std::vector<std::wstring> GetMlfPaths() const;
 
-    // Gets utterance paths from the configuration.
-    std::vector<std::wstring> GetSequencePaths();
+    // Passes the utterance paths from the configuration to 'action' one at a time, in the order of the script file,
+    // so that they do not all have to be kept in memory.
+    void ForEachSequencePath(const std::function<void(const std::wstring&)>& action) const;
+
+    // Gets the script file and the path prefix for its entries, which together determine the utterance paths.
+    std::wstring GetScriptPath() const;
+    std::wstring GetScriptPrefixPath() const;
+
+    // Gets the path of the binary cache of the parsed script file, or an empty string if none is configured.
+    std::wstring GetScriptCachePath() const;
 
     // Gets randomization window.
     size_t GetRandomizationWindow();
@@ -65,7 +74,7 @@ private:
     DISABLE_COPY_AND_MOVE(ConfigHelper);
 
     // Expands ... in the name of the feature path.
-    void ExpandDotDotDot(std::wstring& featPath, const std::wstring& scpPath, std::wstring& scpDirCached);
+    static void ExpandDotDotDot(std::wstring& featPath, const std::wstring& scpPath, std::wstring& scpDirCached);
 
     const ConfigParameters& m_config;
 };
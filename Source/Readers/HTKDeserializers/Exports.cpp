@@ -16,6 +16,7 @@
 #include "HeapMemoryProvider.h"
 #include "HTKDataDeserializer.h"
 #include "MLFDataDeserializer.h"
+#include "KaldiDataDeserializer.h"
 #include "StringUtil.h"
 
 namespace Microsoft { namespace MSR { namespace CNTK {
@@ -62,6 +63,10 @@ extern "C" DATAREADER_API bool CreateDeserializer(IDataDeserializer** deserializ
     {
         *deserializer = new MLFDataDeserializer(corpus, deserializerConfig, primary);
     }
+    else if (type == L"KaldiFeatureDeserializer")
+    {
+        *deserializer = new KaldiDataDeserializer(corpus, deserializerConfig, primary);
+    }
     else
     {
         // Unknown type.
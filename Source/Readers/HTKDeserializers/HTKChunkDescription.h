@@ -7,6 +7,8 @@
 
 #define __STDC_FORMAT_MACROS
 #include <inttypes.h>
+#include <algorithm>
+#include <numeric>
 #include "DataDeserializer.h"
 #include "../HTKMLFReader/htkfeatio.h"
 #include "UtteranceDescription.h"
@@ -20,14 +22,25 @@ namespace Microsoft { namespace MSR { namespace CNTK {
 // TODO: We should consider splitting data load from the description in the future versions.
 class HTKChunkDescription
 {
-    // All utterances in the chunk.
-    std::vector<UtteranceDescription> m_utterances;
+    // All utterances in the chunk, as a table with one column per property, since there can be very many of them.
+    // Archive file of each utterance (index of the path interned by htkfeatreader::parsedpath).
+    std::vector<unsigned int> m_archivePathIndices;
+
+    // First frame of each utterance inside its archive file.
+    std::vector<size_t> m_firstFramesInArchive;
+
+    // Id of each utterance.
+    std::vector<size_t> m_ids;
+
+    // Expansion length of each utterance in case if it should be expanded; allocated with the first one set.
+    std::vector<uint32_t> m_expansionLengths;
 
     // Stores all frames of the chunk consecutively (mutable since this is a cache).
     mutable msra::dbn::matrix m_frames;
 
     // First frames of all utterances. m_firstFrames[utteranceIndex] == index of the first frame of the utterance.
-    // Size of m_firstFrames should be equal to the number of utterances.
+    // Size of m_firstFrames should be equal to the number of utterances; the number of frames of an utterance is
+    // the distance to the next one.
     std::vector<size_t> m_firstFrames;
 
     // Total number of frames in this chunk
@@ -45,7 +58,7 @@ public:
     // Gets number of utterances in the chunk.
     size_t GetNumberOfUtterances() const
     {
-        return m_utterances.size();
+        return m_ids.size();
     }
 
     ChunkIdType GetChunkId() const
@@ -54,16 +67,18 @@ public:
     }
 
     // Adds an utterance to the chunk.
-    void Add(UtteranceDescription&& utterance)
+    void Add(const UtteranceDescription& utterance)
     {
         if (IsInRam())
         {
             LogicError("Frames already paged into RAM -- too late to add data.");
         }
 
+        m_archivePathIndices.push_back(utterance.GetArchivePathIndex());
+        m_firstFramesInArchive.push_back(utterance.GetFirstFrame());
+        m_ids.push_back(utterance.GetId());
         m_firstFrames.push_back(m_totalFrames);
         m_totalFrames += utterance.GetNumberOfFrames();
-        m_utterances.push_back(std::move(utterance));
     }
 
     // Gets total number of frames in the chunk.
@@ -72,16 +87,44 @@ public:
         return m_totalFrames;
     }
 
-    // Get utterance description by its index.
-    const UtteranceDescription* GetUtterance(size_t index) const
+    // Get utterance id by its index.
+    size_t GetUtteranceId(size_t index) const
+    {
+        return m_ids[index];
+    }
+
+    // Get number of frames of an utterance by its index.
+    size_t GetUtteranceNumberOfFrames(size_t index) const
     {
-        return &m_utterances[index];
+        return (index + 1 < m_firstFrames.size() ? m_firstFrames[index + 1] : m_totalFrames) - m_firstFrames[index];
     }
 
-    // Get utterance description by its index.
-    UtteranceDescription* GetUtterance(size_t index)
+    // Get the path to read the frames of an utterance from by its index.
+    msra::asr::htkfeatreader::parsedpath GetUtterancePath(size_t index) const
     {
-        return &m_utterances[index];
+        size_t firstFrame = m_firstFramesInArchive[index];
+        return msra::asr::htkfeatreader::parsedpath(m_archivePathIndices[index], firstFrame, firstFrame + GetUtteranceNumberOfFrames(index) - 1);
+    }
+
+    // Get expansion length of an utterance by its index.
+    size_t GetUtteranceExpansionLength(size_t index) const
+    {
+        return m_expansionLengths.empty() ? 0 : m_expansionLengths[index];
+    }
+
+    // Set expansion length of an utterance by its index.
+    void SetUtteranceExpansionLength(size_t index, size_t length)
+    {
+        if (length > UINT32_MAX)
+        {
+            RuntimeError("Maximum expansion length of an utterance exceeded.");
+        }
+
+        if (m_expansionLengths.empty())
+        {
+            m_expansionLengths.resize(m_ids.size(), 0);
+        }
+        m_expansionLengths[index] = (uint32_t)length;
     }
 
     // Get start frame index inside chunk.
@@ -111,7 +154,7 @@ public:
         }
 
         const size_t ts = m_firstFrames[index];
-        const size_t n = m_utterances[index].GetNumberOfFrames();
+        const size_t n = GetUtteranceNumberOfFrames(index);
         return msra::dbn::matrixstripe(m_frames, ts, n);
     }
 
@@ -136,20 +179,40 @@ public:
             // if this is the first feature read ever, we explicitly open the first file to get the information such as feature dimension
             msra::asr::htkfeatreader reader;
 
+            // Utterances are read in the order they are stored on disk, after all of them have been requested
+            // from the OS at once, instead of one synchronous seek and read per utterance.
+            std::vector<msra::asr::htkfeatreader::parsedpath> utterancePaths;
+            utterancePaths.reserve(GetNumberOfUtterances());
+            for (size_t i = 0; i < GetNumberOfUtterances(); ++i)
+                utterancePaths.push_back(GetUtterancePath(i));
+
+            std::vector<size_t> readOrder(utterancePaths.size());
+            std::iota(readOrder.begin(), readOrder.end(), 0);
+            std::stable_sort(readOrder.begin(), readOrder.end(), [&utterancePaths](size_t a, size_t b)
+            {
+                return msra::asr::htkfeatreader::parsedpath::diskorder(utterancePaths[a], utterancePaths[b]);
+            });
+
+            std::vector<const msra::asr::htkfeatreader::parsedpath*> paths;
+            paths.reserve(readOrder.size());
+            for (size_t i : readOrder)
+                paths.push_back(&utterancePaths[i]);
+            reader.willneed(paths);
+
             // read all utterances; if they are in the same archive, htkfeatreader will be efficient in not closing the file
             m_frames.resize(featureDimension, m_totalFrames);
-            foreach_index(i, m_utterances)
+            for (size_t i : readOrder)
             {
                 // read features for this file
                 auto framesWrapper = GetUtteranceFrames(i);
-                reader.read(m_utterances[i].GetPath(), featureKind, samplePeriod, framesWrapper);
+                reader.read(utterancePaths[i], featureKind, samplePeriod, framesWrapper);
             }
 
             if (verbosity)
             {
                 fprintf(stderr, "HTKChunkDescription::RequireData: read physical chunk %u (%" PRIu64 " utterances, %" PRIu64 " frames, %" PRIu64 " bytes)\n",
                         m_chunkId,
-                        m_utterances.size(),
+                        GetNumberOfUtterances(),
                         m_totalFrames,
                         sizeof(float) * m_frames.rows() * m_frames.cols());
             }
@@ -179,7 +242,7 @@ public:
         {
             fprintf(stderr, "HTKChunkDescription::ReleaseData: release physical chunk %u (%" PRIu64 " utterances, %" PRIu64 " frames, %" PRIu64 " bytes)\n",
                     m_chunkId,
-                    m_utterances.size(),
+                    GetNumberOfUtterances(),
                     m_totalFrames,
                     sizeof(float) * m_frames.rows() * m_frames.cols());
         }
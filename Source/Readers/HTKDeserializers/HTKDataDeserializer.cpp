@@ -10,6 +10,8 @@
 #include "ConfigHelper.h"
 #include "Basics.h"
 #include "StringUtil.h"
+#include "MappedFile.h"
+#include <random>
 
 // TODO: This will be removed when dependency on old code is eliminated.
 // Currently this fixes the linking.
@@ -54,6 +56,7 @@ HTKDataDeserializer::HTKDataDeserializer(
     }
 
     ConfigParameters streamConfig = input(inputName);
+    m_expandContextOnDevice = streamConfig(L"expandContextOnDevice", false);
 
     ConfigHelper config(streamConfig);
     auto context = config.GetContextWindow();
@@ -62,10 +65,11 @@ HTKDataDeserializer::HTKDataDeserializer(
     m_dimension = config.GetFeatureDimension();
     m_dimension = m_dimension * (1 + context.first + context.second);
 
-    InitializeChunkDescriptions(config.GetSequencePaths());
-    InitializeStreams(inputName);
+    InitializeChunkDescriptions(config);
     InitializeFeatureInformation();
     InitializeAugmentationWindow(config.GetContextWindow());
+    InitializeContextExpansionOnDevice(inputName);
+    InitializeStreams(inputName);
 }
 
 HTKDataDeserializer::HTKDataDeserializer(
@@ -98,10 +102,13 @@ HTKDataDeserializer::HTKDataDeserializer(
         InvalidArgument("Cannot expand utterances of the primary stream %ls, please change your configuration.", featureName.c_str());
     }
 
-    InitializeChunkDescriptions(config.GetSequencePaths());
-    InitializeStreams(featureName);
+    m_expandContextOnDevice = feature(L"expandContextOnDevice", false);
+
+    InitializeChunkDescriptions(config);
     InitializeFeatureInformation();
     InitializeAugmentationWindow(config.GetContextWindow());
+    InitializeContextExpansionOnDevice(featureName);
+    InitializeStreams(featureName);
 }
 
 void HTKDataDeserializer::InitializeAugmentationWindow(const std::pair<size_t, size_t>& augmentationWindow)
@@ -116,45 +123,243 @@ void HTKDataDeserializer::InitializeAugmentationWindow(const std::pair<size_t, s
     }
 }
 
-// Initializes chunks based on the configuration and utterance descriptions.
-void HTKDataDeserializer::InitializeChunkDescriptions(const vector<wstring>& paths)
+// With the context expanded on the device, the stream carries the raw frames, and the network splices them by
+// ContextWindow(features, leftContext, rightContext), which needs the utterances as sequences to find their boundaries.
+void HTKDataDeserializer::InitializeContextExpansionOnDevice(const wstring& featureName)
+{
+    if (!m_expandContextOnDevice)
+        return;
+
+    if (m_frameMode)
+        InvalidArgument("Cannot expand the context of stream %ls on the device in frame mode, please change your configuration.", featureName.c_str());
+
+    m_dimension = m_ioFeatureDimension;
+    fprintf(stderr, "HTKDataDeserializer::HTKDataDeserializer: stream %ls delivers raw %d-dimensional frames, expand them with ContextWindow(%ls, %d, %d)\n",
+        featureName.c_str(), (int)m_dimension, featureName.c_str(), (int)m_augmentationWindow.first, (int)m_augmentationWindow.second);
+}
+
+// The binary cache of a parsed script file (configured by "scpCacheFile"), so that the script file does not have to be
+// parsed again on every start: a ScriptCacheHeader, then for each entry of the script file the key of its utterance
+// (uint32 length and UTF-8 text), its archive file (uint32 index into the archive paths of the cache), first frame
+// (uint64) and number of frames (uint32), then the archive paths (uint32 length and UTF-16 text each).
+// It is only used if it is newer than the script file and was written for the same script file and path prefix.
+struct ScriptCacheHeader
 {
-    // Read utterance descriptions.
-    vector<UtteranceDescription> utterances;
-    utterances.reserve(paths.size());
-    size_t allUtterances = 0, allFrames = 0;
+    char m_magic[8];
+    uint64_t m_source;         // hash of the script file path and path prefix, see ScriptCacheSource()
+    uint64_t m_numUtterances;
+    uint64_t m_numArchives;
+    uint64_t m_archivesOffset; // of the archive paths from the start of the file
+};
+
+static const char s_scriptCacheMagic[8] = "HTKSCP1";
 
-    for (const auto& u : paths)
+static uint64_t ScriptCacheSource(const wstring& scriptPath, const wstring& prefixPath)
+{
+    uint64_t hash = 14695981039346656037ull; // FNV-1a
+    for (wchar_t c : scriptPath + L"\n" + prefixPath)
+        hash = (hash ^ (uint64_t)c) * 1099511628211ull;
+    return hash;
+}
+
+// Writes the cache of a script file while it is parsed. The cache only appears once Commit() has written it
+// completely. Failing to write it is not an error; the script file is then parsed again next time.
+class ScriptCacheWriter
+{
+public:
+    ScriptCacheWriter(const wstring& path, uint64_t source)
+        : m_path(path), m_tmpPath(path + L".tmp" + to_wstring(random_device()())), m_file(nullptr), m_offset(0)
     {
-        UtteranceDescription description(move(msra::asr::htkfeatreader::parsedpath(u)));
-        size_t numberOfFrames = description.GetNumberOfFrames();
+        memset(&m_header, 0, sizeof(m_header));
+        memcpy(m_header.m_magic, s_scriptCacheMagic, sizeof(m_header.m_magic));
+        m_header.m_source = source;
+        Try([&]
+        {
+            m_file = fopenOrDie(m_tmpPath, L"wb");
+            Write(&m_header, sizeof(m_header));
+        });
+    }
 
-        if (m_expandToPrimary && numberOfFrames != 1)
+    ~ScriptCacheWriter()
+    {
+        Discard();
+    }
+
+    void Add(const string& key, const UtteranceDescription& utterance)
+    {
+        Try([&]
         {
-            RuntimeError("Expanded stream should only contain sequences of length 1, utterance '%s' has %d",
-                description.GetKey().c_str(),
-                (int)numberOfFrames);
+            unsigned int archive = utterance.GetArchivePathIndex();
+            if (m_cacheArchiveIndices.size() <= archive)
+                m_cacheArchiveIndices.resize(archive + 1, UINT_MAX);
+            if (m_cacheArchiveIndices[archive] == UINT_MAX)
+            {
+                m_cacheArchiveIndices[archive] = (unsigned int)m_archives.size();
+                m_archives.push_back(archive);
+            }
+
+            WriteValue((uint32_t)key.size());
+            Write(key.data(), key.size());
+            WriteValue((uint32_t)m_cacheArchiveIndices[archive]);
+            WriteValue((uint64_t)utterance.GetFirstFrame());
+            WriteValue((uint32_t)utterance.GetNumberOfFrames());
+            m_header.m_numUtterances++;
+        });
+    }
+
+    void Commit()
+    {
+        Try([&]
+        {
+            m_header.m_numArchives = m_archives.size();
+            m_header.m_archivesOffset = m_offset;
+            for (unsigned int archive : m_archives)
+            {
+                const wstring& archivePath = msra::asr::htkfeatreader::parsedpath::archivePathStringVector[archive];
+                WriteValue((uint32_t)archivePath.size());
+                for (wchar_t c : archivePath)
+                    WriteValue((uint16_t)c);
+            }
+
+            fseekOrDie(m_file, 0);
+            Write(&m_header, sizeof(m_header));
+            fflushOrDie(m_file);
+            fcloseOrDie(m_file);
+            m_file = nullptr;
+            renameOrDie(m_tmpPath, m_path);
+        });
+    }
+
+private:
+    DISABLE_COPY_AND_MOVE(ScriptCacheWriter);
+
+    template <class F>
+    void Try(F action)
+    {
+        if (m_failed)
+            return;
+
+        try
+        {
+            action();
+        }
+        catch (const exception& e)
+        {
+            fprintf(stderr, "HTKDataDeserializer: could not write the script file cache '%ls', parsing the script file again next time: %s\n",
+                    m_path.c_str(), e.what());
+            Discard();
+            m_failed = true;
         }
+    }
 
-        // For logging, also account for utterances and frames that we skip
-        allUtterances++;
-        allFrames += numberOfFrames;
+    void Write(const void* data, size_t size)
+    {
+        fwriteOrDie(data, 1, size, m_file);
+        m_offset += size;
+    }
 
-        string key = description.GetKey();
-        if (!m_corpus->IsIncluded(key))
+    template <class T>
+    void WriteValue(T value)
+    {
+        Write(&value, sizeof(value));
+    }
+
+    void Discard()
+    {
+        if (m_file)
         {
-            continue;
+            fclose(m_file);
+            m_file = nullptr;
         }
+        if (fexists(m_tmpPath))
+            _wunlink(m_tmpPath.c_str());
+    }
 
-        // No need to store key, releasing it.
-        description.ClearLogicalPath();
+    wstring m_path;
+    wstring m_tmpPath;
+    FILE* m_file;
+    bool m_failed = false;
+    uint64_t m_offset;
+    ScriptCacheHeader m_header;
 
-        size_t id = m_corpus->KeyToId(key);
-        description.SetId(id);
-        utterances.push_back(description);
-        m_totalNumberOfFrames += numberOfFrames;
+    // Archive paths of the cache, as indices into parsedpath::archivePathStringVector, and the other way round.
+    vector<unsigned int> m_archives;
+    vector<unsigned int> m_cacheArchiveIndices;
+};
+
+// Reads the utterances from the cache of a script file and passes them to 'action' in the order of the script file.
+// Returns false if there is no cache that can be used.
+static bool ReadScriptCache(const wstring& path, const wstring& scriptPath, uint64_t source,
+                            const function<void(const string&, const UtteranceDescription&)>& action)
+{
+    if (!msra::files::fuptodate(path, scriptPath))
+        return false;
+
+    MappedFile cache(path);
+    const char* data = cache.GetData();
+    const size_t size = cache.GetSize();
+
+    ScriptCacheHeader header;
+    if (size < sizeof(header))
+        return false;
+    memcpy(&header, data, sizeof(header));
+    if (memcmp(header.m_magic, s_scriptCacheMagic, sizeof(header.m_magic)) != 0 || header.m_source != source ||
+        header.m_archivesOffset < sizeof(header) || header.m_archivesOffset > size)
+        return false;
+
+    size_t offset = 0;
+    auto read = [&](void* value, size_t valueSize, size_t end)
+    {
+        if (offset + valueSize > end)
+            RuntimeError("HTKDataDeserializer: the script file cache '%ls' is corrupt, please delete it.", path.c_str());
+        memcpy(value, data + offset, valueSize);
+        offset += valueSize;
+    };
+
+    // The archive paths of the cache, interned as those of the script file.
+    vector<unsigned int> archives;
+    archives.reserve(header.m_numArchives);
+    offset = header.m_archivesOffset;
+    for (uint64_t i = 0; i < header.m_numArchives; ++i)
+    {
+        uint32_t length;
+        read(&length, sizeof(length), size);
+        wstring archivePath(length, L'\0');
+        for (wchar_t& c : archivePath)
+        {
+            uint16_t value;
+            read(&value, sizeof(value), size);
+            c = (wchar_t)value;
+        }
+        archives.push_back(msra::asr::htkfeatreader::parsedpath::internarchivepath(archivePath));
     }
 
+    offset = sizeof(header);
+    string key;
+    for (uint64_t i = 0; i < header.m_numUtterances; ++i)
+    {
+        uint32_t keyLength, archive, numberOfFrames;
+        uint64_t firstFrame;
+        read(&keyLength, sizeof(keyLength), header.m_archivesOffset);
+        key.resize(keyLength);
+        read(&key[0], keyLength, header.m_archivesOffset);
+        read(&archive, sizeof(archive), header.m_archivesOffset);
+        read(&firstFrame, sizeof(firstFrame), header.m_archivesOffset);
+        read(&numberOfFrames, sizeof(numberOfFrames), header.m_archivesOffset);
+        if (archive >= archives.size())
+            RuntimeError("HTKDataDeserializer: the script file cache '%ls' is corrupt, please delete it.", path.c_str());
+
+        action(key, UtteranceDescription(archives[archive], firstFrame, numberOfFrames));
+    }
+
+    fprintf(stderr, "HTKDataDeserializer::HTKDataDeserializer: read %" PRIu64 " entries of script file %ls from cache %ls\n",
+            header.m_numUtterances, scriptPath.c_str(), path.c_str());
+    return true;
+}
+
+// Initializes chunks based on the configuration and utterance descriptions.
+void HTKDataDeserializer::InitializeChunkDescriptions(const ConfigHelper& config)
+{
     // TODO: We should be able to configure IO chunks based on size.
     // distribute utterances over chunks
     // We simply count off frames until we reach the chunk size.
@@ -167,11 +372,36 @@ void HTKDataDeserializer::InitializeChunkDescriptions(const vector<wstring>& pat
     const size_t ChunkFrames = 15 * 60 * FramesPerSec; // number of frames to target for each chunk
 
     m_chunks.resize(0);
-    m_chunks.reserve(m_totalNumberOfFrames / ChunkFrames);
 
+    // Utterances are added to the chunks as they are read from the script file.
+    size_t selectedUtterances = 0, allUtterances = 0, allFrames = 0;
     ChunkIdType chunkId = 0;
-    foreach_index(i, utterances)
+    auto addUtterance = [&](const string& key, const UtteranceDescription& utterance)
     {
+        size_t numberOfFrames = utterance.GetNumberOfFrames();
+
+        if (m_expandToPrimary && numberOfFrames != 1)
+        {
+            RuntimeError("Expanded stream should only contain sequences of length 1, utterance '%s' has %d",
+                key.c_str(),
+                (int)numberOfFrames);
+        }
+
+        // For logging, also account for utterances and frames that we skip
+        allUtterances++;
+        allFrames += numberOfFrames;
+
+        if (!m_corpus->IsIncluded(key))
+        {
+            return;
+        }
+
+        UtteranceDescription description(utterance);
+        size_t id = m_corpus->KeyToId(key);
+        description.SetId(id);
+        selectedUtterances++;
+        m_totalNumberOfFrames += numberOfFrames;
+
         // if exceeding current entry--create a new one
         // I.e. our chunks are a little larger than wanted (on av. half the av. utterance length).
         if (m_chunks.empty() || m_chunks.back().GetTotalFrames() > ChunkFrames)
@@ -184,10 +414,44 @@ void HTKDataDeserializer::InitializeChunkDescriptions(const vector<wstring>& pat
         if (!m_primary)
         {
             // Have to store key <-> utterance mapping for non primary deserializers.
-            m_keyToChunkLocation[utterances[i].GetId()] = make_pair(currentChunk.GetChunkId(), currentChunk.GetNumberOfUtterances());
+            if (m_keyToChunkLocation.size() <= id)
+            {
+                m_keyToChunkLocation.resize(id + 1, make_pair(CHUNKID_MAX, 0u));
+            }
+            m_keyToChunkLocation[id] = make_pair(currentChunk.GetChunkId(), (uint32_t)currentChunk.GetNumberOfUtterances());
         }
 
-        currentChunk.Add(move(utterances[i]));
+        currentChunk.Add(description);
+    };
+
+    // Read utterance descriptions, from the cache of the script file if there is one.
+    wstring scriptPath = config.GetScriptPath();
+    wstring cachePath = config.GetScriptCachePath();
+    uint64_t source = ScriptCacheSource(scriptPath, config.GetScriptPrefixPath());
+    if (cachePath.empty() || !ReadScriptCache(cachePath, scriptPath, source, addUtterance))
+    {
+        unique_ptr<ScriptCacheWriter> cache;
+        if (!cachePath.empty())
+        {
+            cache = make_unique<ScriptCacheWriter>(cachePath, source);
+        }
+
+        config.ForEachSequencePath([&](const wstring& path)
+        {
+            msra::asr::htkfeatreader::parsedpath parsedPath(path);
+            string key = parsedPath.GetLogicalPath();
+            UtteranceDescription utterance(parsedPath);
+            if (cache)
+            {
+                cache->Add(key, utterance);
+            }
+            addUtterance(key, utterance);
+        });
+
+        if (cache)
+        {
+            cache->Commit();
+        }
     }
 
     fprintf(stderr,
@@ -195,14 +459,14 @@ void HTKDataDeserializer::InitializeChunkDescriptions(const vector<wstring>& pat
         "selected %" PRIu64 " utterances grouped into %" PRIu64 " chunks, "
         "average chunk size: %.1f utterances, %.1f frames "
         "(for I/O: %.1f utterances, %.1f frames)\n",
-        utterances.size(),
+        selectedUtterances,
         m_chunks.size(),
-        utterances.size() / (double)m_chunks.size(),
+        selectedUtterances / (double)m_chunks.size(),
         m_totalNumberOfFrames / (double)m_chunks.size(),
         allUtterances / (double)m_chunks.size(),
         allFrames / (double)m_chunks.size());
 
-    if (utterances.empty())
+    if (selectedUtterances == 0)
     {
         RuntimeError("HTKDataDeserializer: No utterances to process.");
     }
@@ -227,7 +491,7 @@ void HTKDataDeserializer::InitializeFeatureInformation()
     msra::util::attempt(5, [&]()
     {
         msra::asr::htkfeatreader reader;
-        reader.getinfo(m_chunks.front().GetUtterance(0)->GetPath(), m_featureKind, m_ioFeatureDimension, m_samplePeriod);
+        reader.getinfo(m_chunks.front().GetUtterancePath(0), m_featureKind, m_ioFeatureDimension, m_samplePeriod);
         fprintf(stderr, "HTKDataDeserializer::HTKDataDeserializer: determined feature kind as %d-dimensional '%s' with frame shift %.1f ms\n",
             (int)m_ioFeatureDimension, m_featureKind.c_str(), m_samplePeriod / 1e4);
     });
@@ -261,14 +525,14 @@ void HTKDataDeserializer::GetSequencesForChunk(ChunkIdType chunkId, vector<Seque
     size_t offsetInChunk = 0;
     for (size_t i = 0; i < chunk.GetNumberOfUtterances(); ++i)
     {
-        auto utterance = chunk.GetUtterance(i);
         // Currently we do not support common prefix, so simply assign the minor to the key.
-        size_t sequence = utterance->GetId();
+        size_t sequence = chunk.GetUtteranceId(i);
+        size_t numberOfFrames = chunk.GetUtteranceNumberOfFrames(i);
 
         if (m_frameMode)
         {
             // Because it is a frame mode, creating a sequence for each frame.
-            for (size_t k = 0; k < utterance->GetNumberOfFrames(); ++k)
+            for (size_t k = 0; k < numberOfFrames; ++k)
             {
                 SequenceDescription f;
                 f.m_chunkId = chunkId;
@@ -287,12 +551,12 @@ void HTKDataDeserializer::GetSequencesForChunk(ChunkIdType chunkId, vector<Seque
             f.m_key.m_sequence = sequence;
             f.m_key.m_sample = 0;
             f.m_id = offsetInChunk++;
-            if (SEQUENCELEN_MAX < utterance->GetNumberOfFrames())
+            if (SEQUENCELEN_MAX < numberOfFrames)
             {
                 RuntimeError("Maximum number of samples per sequence exceeded");
             }
 
-            f.m_numberOfSamples = (uint32_t) utterance->GetNumberOfFrames();
+            f.m_numberOfSamples = (uint32_t) numberOfFrames;
             result.push_back(f);
         }
     }
@@ -403,7 +667,7 @@ public:
 
 private:
     // Features
-    std::vector<float> m_data;
+    PooledVector<float> m_data;
     // Number of rows = dimension of the feature
     size_t m_numRows;
     // Number of columns = number of samples in utterance.
@@ -413,10 +677,10 @@ private:
 // This class stores sequence data for HTK for floats.
 struct HTKFloatSequenceData : DenseSequenceData
 {
-    HTKFloatSequenceData(FeatureMatrix&& data) : m_buffer(data)
+    HTKFloatSequenceData(FeatureMatrix&& data) : m_buffer(std::move(data))
     {
-        m_numberOfSamples = (uint32_t)data.GetNumberOfColumns();
-        if (m_numberOfSamples != data.GetNumberOfColumns())
+        m_numberOfSamples = (uint32_t)m_buffer.GetNumberOfColumns();
+        if (m_numberOfSamples != m_buffer.GetNumberOfColumns())
         {
             RuntimeError("Maximum number of samples per sequence exceeded.");
         }
@@ -449,7 +713,7 @@ struct HTKDoubleSequenceData : DenseSequenceData
     }
 
 private:
-    std::vector<double> m_buffer;
+    PooledVector<double> m_buffer;
 };
 
 // Copies a source into a destination with the specified destination offset.
@@ -491,35 +755,40 @@ void HTKDataDeserializer::GetSequenceById(ChunkIdType chunkId, size_t id, vector
 {
     const auto& chunkDescription = m_chunks[chunkId];
     size_t utteranceIndex = m_frameMode ? chunkDescription.GetUtteranceForChunkFrameIndex(id) : id;
-    const UtteranceDescription* utterance = chunkDescription.GetUtterance(utteranceIndex);
+    size_t numberOfFrames = chunkDescription.GetUtteranceNumberOfFrames(utteranceIndex);
+    size_t expansionLength = chunkDescription.GetUtteranceExpansionLength(utteranceIndex);
     auto utteranceFrames = chunkDescription.GetUtteranceFrames(utteranceIndex);
 
     // wrapper that allows m[j].size() and m[j][i] as required by augmentneighbors()
     MatrixAsVectorOfVectors utteranceFramesWrapper(utteranceFrames);
-    size_t utteranceLength = m_frameMode ? 1  : (m_expandToPrimary ? utterance->GetExpansionLength() : utterance->GetNumberOfFrames());
+    size_t utteranceLength = m_frameMode ? 1  : (m_expandToPrimary ? expansionLength : numberOfFrames);
     FeatureMatrix features(m_dimension, utteranceLength);
 
+    // the frames are delivered unaugmented if the context is expanded on the device
+    size_t leftExtent = m_expandContextOnDevice ? 0 : m_augmentationWindow.first;
+    size_t rightExtent = m_expandContextOnDevice ? 0 : m_augmentationWindow.second;
+
     if (m_frameMode)
     {
         // For frame mode augment a single frame.
         size_t frameIndex = id - chunkDescription.GetStartFrameIndexInsideChunk(utteranceIndex);
         auto fillIn = features.col(0);
-        AugmentNeighbors(utteranceFramesWrapper, frameIndex, m_augmentationWindow.first, m_augmentationWindow.second, fillIn);
+        AugmentNeighbors(utteranceFramesWrapper, frameIndex, leftExtent, rightExtent, fillIn);
     }
     else if (m_expandToPrimary) // Broadcast a single frame to the complete utterance.
     {
-        for (size_t resultingIndex = 0; resultingIndex < utterance->GetExpansionLength(); ++resultingIndex)
+        for (size_t resultingIndex = 0; resultingIndex < expansionLength; ++resultingIndex)
         {
             auto fillIn = features.col(resultingIndex);
-            AugmentNeighbors(utteranceFramesWrapper, 0, m_augmentationWindow.first, m_augmentationWindow.second, fillIn);
+            AugmentNeighbors(utteranceFramesWrapper, 0, leftExtent, rightExtent, fillIn);
         }
     }
     else // Augment the complete utterance.
     {
-        for (size_t frameIndex = 0; frameIndex < utterance->GetNumberOfFrames(); ++frameIndex)
+        for (size_t frameIndex = 0; frameIndex < numberOfFrames; ++frameIndex)
         {
             auto fillIn = features.col(frameIndex);
-            AugmentNeighbors(utteranceFramesWrapper, frameIndex, m_augmentationWindow.first, m_augmentationWindow.second, fillIn);
+            AugmentNeighbors(utteranceFramesWrapper, frameIndex, leftExtent, rightExtent, fillIn);
         }
     }
 
@@ -527,11 +796,11 @@ void HTKDataDeserializer::GetSequenceById(ChunkIdType chunkId, size_t id, vector
     DenseSequenceDataPtr result;
     if (m_elementType == ElementType::tdouble)
     {
-        result = make_shared<HTKDoubleSequenceData>(features);
+        result = MakeSequenceData<HTKDoubleSequenceData>(features);
     }
     else if (m_elementType == ElementType::tfloat)
     {
-        result = make_shared<HTKFloatSequenceData>(std::move(features));
+        result = MakeSequenceData<HTKFloatSequenceData>(std::move(features));
     }
     else
     {
@@ -545,16 +814,15 @@ void HTKDataDeserializer::GetSequenceById(ChunkIdType chunkId, size_t id, vector
 bool HTKDataDeserializer::GetSequenceDescription(const SequenceDescription& primary, SequenceDescription& d)
 {
     assert(!m_primary);
-    auto iter = m_keyToChunkLocation.find(primary.m_key.m_sequence);
-    if (iter == m_keyToChunkLocation.end())
+    if (primary.m_key.m_sequence >= m_keyToChunkLocation.size() ||
+        m_keyToChunkLocation[primary.m_key.m_sequence].first == CHUNKID_MAX)
     {
         return false;
     }
 
-    auto chunkId = iter->second.first;
-    auto utteranceIndexInsideChunk = iter->second.second;
+    auto chunkId = m_keyToChunkLocation[primary.m_key.m_sequence].first;
+    size_t utteranceIndexInsideChunk = m_keyToChunkLocation[primary.m_key.m_sequence].second;
     auto& chunk = m_chunks[chunkId];
-    auto utterance = chunk.GetUtterance(utteranceIndexInsideChunk);
 
     d.m_chunkId = (ChunkIdType)chunkId;
 
@@ -565,9 +833,9 @@ bool HTKDataDeserializer::GetSequenceDescription(const SequenceDescription& prim
     {
         // Expanding for sequence length/or max seen frame.
         size_t maxLength = max(primary.m_numberOfSamples, (uint32_t)primary.m_key.m_sample + 1);
-        if (utterance->GetExpansionLength() < maxLength)
+        if (chunk.GetUtteranceExpansionLength(utteranceIndexInsideChunk) < maxLength)
         {
-            utterance->SetExpansionLength(maxLength);
+            chunk.SetUtteranceExpansionLength(utteranceIndexInsideChunk, maxLength);
         }
         d.m_id = utteranceIndexInsideChunk;
     }
@@ -575,7 +843,7 @@ bool HTKDataDeserializer::GetSequenceDescription(const SequenceDescription& prim
     {
         d.m_id = m_frameMode ? chunk.GetStartFrameIndexInsideChunk(utteranceIndexInsideChunk) + primary.m_key.m_sample : utteranceIndexInsideChunk;
     }
-    d.m_numberOfSamples = m_frameMode ? 1 : (uint32_t)utterance->GetNumberOfFrames();
+    d.m_numberOfSamples = m_frameMode ? 1 : (uint32_t)chunk.GetUtteranceNumberOfFrames(utteranceIndexInsideChunk);
     return true;
 }
 
@@ -42,10 +42,11 @@ private:
     DISABLE_COPY_AND_MOVE(HTKDataDeserializer);
 
     // Initialization functions.
-    void InitializeChunkDescriptions(const vector<wstring>& paths);
+    void InitializeChunkDescriptions(const ConfigHelper& config);
     void InitializeStreams(const std::wstring& featureName);
     void InitializeFeatureInformation();
     void InitializeAugmentationWindow(const std::pair<size_t, size_t>& augmentationWindow);
+    void InitializeContextExpansionOnDevice(const std::wstring& featureName);
 
     // Gets sequence by its chunk id and id inside the chunk.
     void GetSequenceById(ChunkIdType chunkId, size_t id, std::vector<SequenceDataPtr>&);
@@ -77,8 +78,8 @@ private:
     bool m_primary;
 
     // Used to correlate a sequence key with the sequence inside the chunk when deserializer is running not in primary mode.
-    // Key -> <chunkid, offset inside chunk>
-    std::map<size_t, std::pair<size_t, size_t>> m_keyToChunkLocation;
+    // Key -> <chunkid, offset inside chunk>, <CHUNKID_MAX, 0> if the key is not assigned.
+    std::vector<std::pair<ChunkIdType, uint32_t>> m_keyToChunkLocation;
 
     // Auxiliary data for checking against the data in the feature file.
     unsigned int m_samplePeriod = 0;
@@ -88,6 +89,10 @@ private:
     // A flag that indicates whether the utterance should be extended to match the lenght of the utterance from the primary deserializer.
     // TODO: This should be moved to the packers when deserializers work in sequence mode only.
     bool m_expandToPrimary;
+
+    // A flag that indicates whether only the raw frames are delivered, leaving the expansion of the augmentation window
+    // to a ContextWindow node in the network, which builds it on the device from the utterance boundaries.
+    bool m_expandContextOnDevice;
 };
 
 typedef std::shared_ptr<HTKDataDeserializer> HTKDataDeserializerPtr;
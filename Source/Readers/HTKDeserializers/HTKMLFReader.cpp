@@ -16,6 +16,8 @@
 #include "TruncatedBpttPacker.h"
 #include "BlockRandomizer.h"
 #include "NoRandomizer.h"
+#include "SharedChunkCache.h"
+#include "LengthBucketingEnumerator.h"
 
 namespace Microsoft { namespace MSR { namespace CNTK {
 
@@ -106,14 +108,26 @@ HTKMLFReader::HTKMLFReader(const ConfigParameters& readerConfig)
     }
 
     bool cleanse = readerConfig(L"checkData", true);
-    auto bundler = std::make_shared<Bundler>(readerConfig, deserializers[0], deserializers, cleanse);
+    IDataDeserializerPtr bundler = std::make_shared<Bundler>(readerConfig, deserializers[0], deserializers, cleanse);
     int verbosity = readerConfig(L"verbosity", 0);
+
+    // Processes on the same node that use the same name share the chunks they load, e.g. the ranks of a multi-GPU job.
+    std::wstring sharedChunkCacheName = readerConfig(L"sharedChunkCacheName", L"");
+    if (!sharedChunkCacheName.empty())
+        bundler = std::make_shared<SharedChunkCache>(bundler, sharedChunkCacheName, verbosity);
     std::wstring readMethod = config.GetRandomizer();
 
+    // Number of chunks loaded concurrently. HTK chunks are independent files, so on network storage
+    // loading several of them at once hides the latency.
+    size_t maxParallelChunkLoads = readerConfig(L"maxParallelChunkLoads", (size_t)1);
+
     // TODO: this should be bool. Change when config per deserializer is allowed.
     if (AreEqualIgnoreCase(readMethod, std::wstring(L"blockRandomize")))
     {
-        m_sequenceEnumerator = std::make_shared<BlockRandomizer>(verbosity, window, bundler, true  /* should Prefetch */, true /* useLegacyRandomization */);
+        // In frame mode, frames can be randomized without a description of each frame of the randomization window.
+        bool frameRandomization = m_packingMode == PackingMode::sample && readerConfig(L"frameRandomization", false);
+        m_sequenceEnumerator = std::make_shared<BlockRandomizer>(verbosity, window, bundler, true  /* should Prefetch */, true /* useLegacyRandomization */,
+            false /* multithreadedGetNextSequences */, maxParallelChunkLoads, frameRandomization);
     }
     else if (AreEqualIgnoreCase(readMethod, std::wstring(L"none")))
     {
@@ -124,6 +138,11 @@ HTKMLFReader::HTKMLFReader(const ConfigParameters& readerConfig)
         RuntimeError("readMethod must be 'blockRandomize' or 'none'.");
     }
 
+    // Minibatches of utterances of similar length, bucketed over the given number of minibatches.
+    size_t bucketingWindow = readerConfig(L"bucketingWindow", (size_t)0);
+    if (bucketingWindow > 0 && m_packingMode == PackingMode::sequence)
+        m_sequenceEnumerator = std::make_shared<LengthBucketingEnumerator>(m_sequenceEnumerator, bucketingWindow, verbosity);
+
     // Create output stream descriptions (all dense)
     for (auto d : deserializers)
     {
@@ -0,0 +1,437 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE.md file in the project root for full license information.
+//
+// KaldiDataDeserializer.cpp -- features from Kaldi archives (.ark), located by the byte offsets of a script file (.scp)
+//
+
+#include "stdafx.h"
+#define __STDC_FORMAT_MACROS
+#include <inttypes.h>
+#include "KaldiDataDeserializer.h"
+#include "ConfigHelper.h"
+#include "SequenceData.h"
+#include "StringUtil.h"
+#include "fileutil.h"
+#include <algorithm>
+#include <fstream>
+#include <numeric>
+#include <sstream>
+#include <unordered_map>
+
+namespace Microsoft { namespace MSR { namespace CNTK {
+
+using namespace std;
+
+// Kaldi writes a binary object as "\0B", then a type token, e.g. "FM " for a float matrix, and integers as
+// their size in bytes followed by their value.
+static uint32_t ReadKaldiInt32(FILE* f, const wstring& path)
+{
+    char size;
+    int32_t value;
+    freadOrDie(&size, 1, 1, f);
+    if (size != sizeof(value))
+        RuntimeError("KaldiDataDeserializer: Unexpected integer size %d in '%ls'.", (int) size, path.c_str());
+    freadOrDie(&value, sizeof(value), 1, f);
+    if (value < 0)
+        RuntimeError("KaldiDataDeserializer: Negative matrix dimension in '%ls'.", path.c_str());
+    return (uint32_t) value;
+}
+
+// Reads the header of the matrix at 'offset' of the archive and leaves the file at its data, rows (frames) first.
+static void ReadKaldiMatrixHeader(FILE* f, const wstring& path, uint64_t offset, uint32_t& numRows, uint32_t& numCols, bool& isDouble)
+{
+    fsetpos(f, offset);
+    char header[5] = {};
+    freadOrDie(header, 1, 5, f);
+    if (header[0] != '\0' || header[1] != 'B')
+        RuntimeError("KaldiDataDeserializer: No binary Kaldi matrix at offset %" PRIu64 " of '%ls', text archives are not supported.", offset, path.c_str());
+    if (memcmp(header + 2, "FM ", 3) == 0)
+        isDouble = false;
+    else if (memcmp(header + 2, "DM ", 3) == 0)
+        isDouble = true;
+    else if (header[2] == 'C')
+        RuntimeError("KaldiDataDeserializer: The matrix at offset %" PRIu64 " of '%ls' is compressed, please uncompress the archive with 'copy-feats'.", offset, path.c_str());
+    else
+        RuntimeError("KaldiDataDeserializer: Unsupported object '%.3s' at offset %" PRIu64 " of '%ls', expected a float or double matrix.", header + 2, offset, path.c_str());
+    numRows = ReadKaldiInt32(f, path);
+    numCols = ReadKaldiInt32(f, path);
+}
+
+KaldiDataDeserializer::KaldiDataDeserializer(CorpusDescriptorPtr corpus, const ConfigParameters& cfg, bool primary)
+    : m_corpus(corpus), m_primary(primary)
+{
+    m_frameMode = (ConfigValue) cfg("frameMode", "true");
+    m_verbosity = cfg(L"verbosity", 0);
+
+    argvector<ConfigValue> inputs = cfg("input");
+    if (inputs.size() != 1)
+        InvalidArgument("KaldiDataDeserializer supports a single input stream only.");
+
+    ConfigParameters input = inputs.front();
+    auto inputName = input.GetMemberIds().front();
+    std::wstring precision = cfg(L"precision", L"float");
+    m_elementType = AreEqualIgnoreCase(precision, L"float") ? ElementType::tfloat : ElementType::tdouble;
+
+    ConfigParameters streamConfig = input(inputName);
+    ConfigHelper config(streamConfig);
+    m_featureDimension = config.GetFeatureDimension();
+    m_contextWindow = config.GetContextWindow();
+    m_dimension = m_featureDimension * (1 + m_contextWindow.first + m_contextWindow.second);
+
+    ReadScript(config.GetScriptPath(), streamConfig(L"utt2numFramesFile", L""));
+    InitializeChunks();
+
+    auto stream = make_shared<StreamDescription>();
+    stream->m_id = 0;
+    stream->m_name = inputName;
+    stream->m_sampleLayout = make_shared<TensorShape>(m_dimension);
+    stream->m_elementType = m_elementType;
+    stream->m_storageType = StorageType::dense;
+    m_streams.push_back(stream);
+}
+
+// Indexes the script file: the archive and offset of each selected utterance, and its number of frames.
+void KaldiDataDeserializer::ReadScript(const wstring& scriptPath, const wstring& numFramesPath)
+{
+    unordered_map<string, uint32_t> numFramesByKey;
+    if (!numFramesPath.empty())
+    {
+        ifstream numFramesFile(msra::strfun::utf8(numFramesPath).c_str());
+        if (!numFramesFile)
+            RuntimeError("KaldiDataDeserializer: Failed to open '%ls'.", numFramesPath.c_str());
+        string key;
+        uint32_t numFrames;
+        while (numFramesFile >> key >> numFrames)
+            numFramesByKey[key] = numFrames;
+    }
+
+    ifstream script(msra::strfun::utf8(scriptPath).c_str());
+    if (!script)
+        RuntimeError("KaldiDataDeserializer: Failed to open script file '%ls'.", scriptPath.c_str());
+
+    unordered_map<wstring, uint32_t> archiveIndices;
+    auto_file_ptr archive;
+    uint32_t openArchive = UINT32_MAX;
+    size_t numEntries = 0, numProbed = 0;
+    string line;
+    while (getline(script, line))
+    {
+        istringstream fields(line);
+        string key, location;
+        if (!(fields >> key))
+            continue; // empty line
+        getline(fields >> ws, location);
+        while (!location.empty() && isspace((unsigned char) location.back()))
+            location.pop_back();
+        if (location.empty() || location.back() == '|' || location.back() == ']')
+            RuntimeError("KaldiDataDeserializer: Unsupported entry '%s' in '%ls', expected 'utterance-id archive:offset'.", line.c_str(), scriptPath.c_str());
+        numEntries++;
+        if (!m_corpus->IsIncluded(key))
+            continue;
+
+        // "path:offset", the path may contain colons itself; without an offset the file holds just this matrix
+        Utterance utterance;
+        uint64_t offset = 0;
+        auto colon = location.find_last_of(':');
+        if (colon != string::npos && colon + 1 < location.size() && all_of(location.begin() + colon + 1, location.end(), ::isdigit))
+        {
+            offset = stoull(location.substr(colon + 1));
+            location.resize(colon);
+        }
+        wstring path = msra::strfun::utf16(location);
+        auto inserted = archiveIndices.insert(make_pair(path, (uint32_t) m_archivePaths.size()));
+        if (inserted.second)
+            m_archivePaths.push_back(path);
+
+        utterance.m_key = m_corpus->KeyToId(key);
+        utterance.m_archive = inserted.first->second;
+        utterance.m_offset = offset;
+
+        auto numFrames = numFramesByKey.find(key);
+        if (numFrames != numFramesByKey.end())
+            utterance.m_numFrames = numFrames->second;
+        else
+        {
+            // no length given, read it from the header of the matrix
+            if (openArchive != utterance.m_archive)
+            {
+                archive = fopenOrDie(path, L"rb");
+                openArchive = utterance.m_archive;
+            }
+            uint32_t numCols;
+            bool isDouble;
+            ReadKaldiMatrixHeader(archive, path, offset, utterance.m_numFrames, numCols, isDouble);
+            if (numCols != m_featureDimension)
+                RuntimeError("KaldiDataDeserializer: Utterance '%s' has %d-dimensional features, expected %d.", key.c_str(), (int) numCols, (int) m_featureDimension);
+            numProbed++;
+        }
+        if (utterance.m_numFrames == 0)
+            continue;
+        if (utterance.m_numFrames > SEQUENCELEN_MAX)
+            RuntimeError("KaldiDataDeserializer: Utterance '%s' exceeds the maximum number of samples per sequence.", key.c_str());
+        m_utterances.push_back(utterance);
+    }
+    if (script.bad())
+        RuntimeError("KaldiDataDeserializer: An error occurred while reading script file '%ls'.", scriptPath.c_str());
+
+    fprintf(stderr, "KaldiDataDeserializer::KaldiDataDeserializer: selected %d of %d utterances of %ls in %d archives",
+            (int) m_utterances.size(), (int) numEntries, scriptPath.c_str(), (int) m_archivePaths.size());
+    if (numProbed > 0)
+        fprintf(stderr, ", read the number of frames of %d of them from the archives", (int) numProbed);
+    fprintf(stderr, "\n");
+    if (m_utterances.empty())
+        RuntimeError("KaldiDataDeserializer: No utterances to process.");
+
+    if (!m_primary)
+    {
+        for (size_t i = 0; i < m_utterances.size(); i++)
+        {
+            size_t key = m_utterances[i].m_key;
+            if (m_keyToUtterance.size() <= key)
+                m_keyToUtterance.resize(key + 1, SIZE_MAX);
+            m_keyToUtterance[key] = i;
+        }
+    }
+}
+
+// Groups the utterances into chunks in the order of the script file, which is usually that of the archives.
+void KaldiDataDeserializer::InitializeChunks()
+{
+    // like the HTKDataDeserializer: 15 minutes at 100 frames per second
+    const size_t ChunkFrames = 15 * 60 * 100;
+    size_t totalFrames = 0;
+    for (size_t i = 0; i < m_utterances.size(); i++)
+    {
+        if (m_chunks.empty() || m_chunks.back().m_numFrames > ChunkFrames)
+            m_chunks.push_back(ChunkInfo{ i, 0, 0 });
+        m_chunks.back().m_numUtterances++;
+        m_chunks.back().m_numFrames += m_utterances[i].m_numFrames;
+        totalFrames += m_utterances[i].m_numFrames;
+    }
+    fprintf(stderr, "KaldiDataDeserializer::KaldiDataDeserializer: %d chunks, average chunk size: %.1f utterances, %.1f frames\n",
+            (int) m_chunks.size(), m_utterances.size() / (double) m_chunks.size(), totalFrames / (double) m_chunks.size());
+}
+
+ChunkDescriptions KaldiDataDeserializer::GetChunkDescriptions()
+{
+    ChunkDescriptions chunks;
+    chunks.reserve(m_chunks.size());
+    for (ChunkIdType i = 0; i < m_chunks.size(); ++i)
+    {
+        auto chunk = make_shared<ChunkDescription>();
+        chunk->m_id = i;
+        chunk->m_numberOfSamples = m_chunks[i].m_numFrames;
+        // in frame mode, each frame is a sequence
+        chunk->m_numberOfSequences = m_frameMode ? m_chunks[i].m_numFrames : m_chunks[i].m_numUtterances;
+        chunks.push_back(chunk);
+    }
+    return chunks;
+}
+
+void KaldiDataDeserializer::GetSequencesForChunk(ChunkIdType chunkId, vector<SequenceDescription>& result)
+{
+    const ChunkInfo& chunk = m_chunks[chunkId];
+    result.reserve(result.size() + (m_frameMode ? chunk.m_numFrames : chunk.m_numUtterances));
+    size_t idInChunk = 0;
+    for (size_t i = 0; i < chunk.m_numUtterances; ++i)
+    {
+        const Utterance& utterance = m_utterances[chunk.m_firstUtterance + i];
+        SequenceDescription sequence;
+        sequence.m_chunkId = chunkId;
+        sequence.m_key.m_sequence = utterance.m_key;
+        if (m_frameMode)
+        {
+            for (uint32_t k = 0; k < utterance.m_numFrames; ++k)
+            {
+                sequence.m_id = idInChunk++;
+                sequence.m_key.m_sample = k;
+                sequence.m_numberOfSamples = 1;
+                result.push_back(sequence);
+            }
+        }
+        else
+        {
+            sequence.m_id = idInChunk++;
+            sequence.m_key.m_sample = 0;
+            sequence.m_numberOfSamples = utterance.m_numFrames;
+            result.push_back(sequence);
+        }
+    }
+}
+
+bool KaldiDataDeserializer::GetSequenceDescriptionByKey(const KeyType& key, SequenceDescription& result)
+{
+    assert(!m_primary);
+    if (key.m_sequence >= m_keyToUtterance.size() || m_keyToUtterance[key.m_sequence] == SIZE_MAX)
+        return false;
+
+    size_t index = m_keyToUtterance[key.m_sequence];
+    auto chunk = upper_bound(m_chunks.begin(), m_chunks.end(), index, [](size_t i, const ChunkInfo& c) { return i < c.m_firstUtterance; }) - 1;
+    const Utterance& utterance = m_utterances[index];
+    result.m_chunkId = (ChunkIdType) (chunk - m_chunks.begin());
+    result.m_key = key;
+    if (m_frameMode)
+    {
+        if (key.m_sample >= utterance.m_numFrames)
+            return false;
+        size_t firstFrame = 0;
+        for (size_t i = chunk->m_firstUtterance; i < index; i++)
+            firstFrame += m_utterances[i].m_numFrames;
+        result.m_id = firstFrame + key.m_sample;
+        result.m_numberOfSamples = 1;
+    }
+    else
+    {
+        result.m_id = index - chunk->m_firstUtterance;
+        result.m_numberOfSamples = utterance.m_numFrames;
+    }
+    return true;
+}
+
+// Appends the 'left' and 'right' neighbors to each of the frames [first, first + count) of an utterance,
+// repeating the first and last frame at the boundaries, as the HTKDataDeserializer does.
+template <class ElemType>
+static void ExpandContext(const float* frames, size_t numFrames, size_t dim, size_t left, size_t right,
+                          size_t first, size_t count, ElemType* result)
+{
+    for (size_t t = first; t < first + count; t++)
+    {
+        for (size_t k = 0; k <= left + right; k++)
+        {
+            ptrdiff_t source = (ptrdiff_t) t + (ptrdiff_t) k - (ptrdiff_t) left;
+            source = max<ptrdiff_t>(0, min<ptrdiff_t>(source, (ptrdiff_t) numFrames - 1));
+            copy(frames + source * dim, frames + (source + 1) * dim, result);
+            result += dim;
+        }
+    }
+}
+
+// The frames of all utterances of a chunk, read from the archives when the chunk is requested by the randomizer.
+class KaldiDataDeserializer::KaldiChunk : public Chunk, public std::enable_shared_from_this<Chunk>
+{
+public:
+    KaldiChunk(const KaldiDataDeserializer& parent, ChunkIdType chunkId)
+        : m_parent(parent), m_info(parent.m_chunks[chunkId])
+    {
+        const auto& utterances = m_parent.m_utterances;
+        const size_t dim = m_parent.m_featureDimension;
+        m_firstFrames.resize(m_info.m_numUtterances + 1, 0);
+        for (size_t i = 0; i < m_info.m_numUtterances; i++)
+            m_firstFrames[i + 1] = m_firstFrames[i] + utterances[m_info.m_firstUtterance + i].m_numFrames;
+        m_frames.resize(m_firstFrames.back() * dim);
+
+        // read in the order of the archives, to seek forward only
+        vector<size_t> order(m_info.m_numUtterances);
+        iota(order.begin(), order.end(), 0);
+        sort(order.begin(), order.end(), [&](size_t a, size_t b)
+        {
+            const Utterance& ua = utterances[m_info.m_firstUtterance + a];
+            const Utterance& ub = utterances[m_info.m_firstUtterance + b];
+            return ua.m_archive != ub.m_archive ? ua.m_archive < ub.m_archive : ua.m_offset < ub.m_offset;
+        });
+
+        // possibly on a network file system, so making several attempts
+        msra::util::attempt(5, [&]()
+        {
+            auto_file_ptr archive;
+            uint32_t openArchive = UINT32_MAX;
+            vector<double> doubles;
+            for (size_t i : order)
+            {
+                const Utterance& utterance = utterances[m_info.m_firstUtterance + i];
+                const wstring& path = m_parent.m_archivePaths[utterance.m_archive];
+                if (openArchive != utterance.m_archive)
+                {
+                    archive = fopenOrDie(path, L"rb");
+                    openArchive = utterance.m_archive;
+                }
+
+                uint32_t numRows, numCols;
+                bool isDouble;
+                ReadKaldiMatrixHeader(archive, path, utterance.m_offset, numRows, numCols, isDouble);
+                if (numRows != utterance.m_numFrames || numCols != dim)
+                    RuntimeError("KaldiDataDeserializer: The matrix at offset %" PRIu64 " of '%ls' is %d x %d, expected %d x %d.",
+                                 utterance.m_offset, path.c_str(), (int) numRows, (int) numCols, (int) utterance.m_numFrames, (int) dim);
+
+                float* frames = m_frames.data() + m_firstFrames[i] * dim;
+                size_t numValues = (size_t) numRows * numCols;
+                if (isDouble)
+                {
+                    doubles.resize(numValues);
+                    freadOrDie(doubles.data(), sizeof(double), numValues, archive);
+                    transform(doubles.begin(), doubles.end(), frames, [](double value) { return (float) value; });
+                }
+                else
+                    freadOrDie(frames, sizeof(float), numValues, archive);
+            }
+        });
+
+        if (m_parent.m_verbosity > 0)
+            fprintf(stderr, "KaldiDataDeserializer: read chunk %d with %d utterances, %d frames\n",
+                    (int) chunkId, (int) m_info.m_numUtterances, (int) m_firstFrames.back());
+    }
+
+    void GetSequence(size_t sequenceId, vector<SequenceDataPtr>& result) override
+    {
+        size_t utterance, first, count;
+        if (m_parent.m_frameMode)
+        {
+            assert(sequenceId < m_firstFrames.back());
+            utterance = upper_bound(m_firstFrames.begin(), m_firstFrames.end(), sequenceId) - m_firstFrames.begin() - 1;
+            first = sequenceId - m_firstFrames[utterance];
+            count = 1;
+        }
+        else
+        {
+            assert(sequenceId < m_info.m_numUtterances);
+            utterance = sequenceId;
+            first = 0;
+            count = m_firstFrames[utterance + 1] - m_firstFrames[utterance];
+        }
+
+        const size_t dim = m_parent.m_featureDimension;
+        const float* frames = m_frames.data() + m_firstFrames[utterance] * dim;
+        size_t numFrames = m_firstFrames[utterance + 1] - m_firstFrames[utterance];
+        size_t left = m_parent.m_contextWindow.first, right = m_parent.m_contextWindow.second;
+
+        auto sequence = MakeSequenceData<ChunkBackedDenseSequenceData>();
+        sequence->m_id = sequenceId;
+        sequence->m_numberOfSamples = (uint32_t) count;
+        sequence->m_elementType = m_parent.m_elementType;
+        sequence->m_chunk = shared_from_this();
+        if (left + right == 0 && m_parent.m_elementType == ElementType::tfloat)
+        {
+            // the frames as they are in the chunk
+            sequence->m_data = frames + first * dim;
+        }
+        else if (m_parent.m_elementType == ElementType::tfloat)
+        {
+            sequence->m_buffer.resize(count * m_parent.m_dimension * sizeof(float));
+            ExpandContext(frames, numFrames, dim, left, right, first, count, reinterpret_cast<float*>(sequence->m_buffer.data()));
+            sequence->m_data = sequence->m_buffer.data();
+        }
+        else
+        {
+            sequence->m_buffer.resize(count * m_parent.m_dimension * sizeof(double));
+            ExpandContext(frames, numFrames, dim, left, right, first, count, reinterpret_cast<double*>(sequence->m_buffer.data()));
+            sequence->m_data = sequence->m_buffer.data();
+        }
+        result.push_back(sequence);
+    }
+
+private:
+    const KaldiDataDeserializer& m_parent;
+    const ChunkInfo& m_info;
+    vector<size_t> m_firstFrames; // [numUtterances + 1], of each utterance in m_frames
+    vector<float> m_frames;       // all frames of the chunk, one after the other
+
+    DISABLE_COPY_AND_MOVE(KaldiChunk);
+};
+
+ChunkPtr KaldiDataDeserializer::GetChunk(ChunkIdType chunkId)
+{
+    return make_shared<KaldiChunk>(*this, chunkId);
+}
+
+}}}
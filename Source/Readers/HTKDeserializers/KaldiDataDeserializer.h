@@ -0,0 +1,82 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE.md file in the project root for full license information.
+//
+// KaldiDataDeserializer.h -- features from Kaldi archives (.ark), located by the byte offsets of a script file (.scp)
+//
+
+#pragma once
+
+#include "DataDeserializerBase.h"
+#include "Config.h"
+#include "CorpusDescriptor.h"
+
+namespace Microsoft { namespace MSR { namespace CNTK {
+
+// Reads the feature matrices of a Kaldi script file, e.g. feats.scp with lines "utt-id /path/raw_fbank.1.ark:1234",
+// from the binary archives they point into:
+//     deserializers = ([
+//         type = "KaldiFeatureDeserializer" ; module = "HTKDeserializers"
+//         input = [ features = [ dim = 40 ; scpFile = "feats.scp" ; utt2numFramesFile = "utt2num_frames" ; contextWindow = 11 ] ]
+//     ])
+// The script file is only indexed when the deserializer is created: the utterances are grouped into chunks of about
+// 15 minutes in the order of the script file, and a chunk is read from the archives when the randomizer asks for it,
+// so that the randomization window and the prefetch of ReaderLib apply. The number of frames of an utterance comes
+// from the optional utt2num_frames file of the Kaldi data directory, otherwise from the matrix headers in the archives.
+// Uncompressed float and double matrices are supported; compressed ones have to be converted with 'copy-feats'.
+// The keys are the utterance ids, so that labels can be bundled from any deserializer with the same keys,
+// e.g. an HTKMLFDeserializer.
+class KaldiDataDeserializer : public DataDeserializerBase
+{
+public:
+    KaldiDataDeserializer(CorpusDescriptorPtr corpus, const ConfigParameters& config, bool primary);
+
+    ChunkDescriptions GetChunkDescriptions() override;
+    void GetSequencesForChunk(ChunkIdType chunkId, std::vector<SequenceDescription>& result) override;
+    ChunkPtr GetChunk(ChunkIdType chunkId) override;
+
+protected:
+    bool GetSequenceDescriptionByKey(const KeyType& key, SequenceDescription& result) override;
+
+private:
+    class KaldiChunk;
+
+    struct Utterance
+    {
+        size_t m_key;         // id of the utterance in the corpus
+        uint32_t m_archive;   // index into m_archivePaths
+        uint64_t m_offset;    // of the matrix in the archive
+        uint32_t m_numFrames;
+    };
+
+    struct ChunkInfo
+    {
+        size_t m_firstUtterance; // index into m_utterances
+        size_t m_numUtterances;
+        size_t m_numFrames;
+    };
+
+    void ReadScript(const std::wstring& scriptPath, const std::wstring& numFramesPath);
+    void InitializeChunks();
+
+    CorpusDescriptorPtr m_corpus;
+    bool m_primary;
+    bool m_frameMode;
+    int m_verbosity;
+
+    size_t m_featureDimension;                // of a frame in the archives
+    std::pair<size_t, size_t> m_contextWindow; // frames to the left and right that are appended to a frame
+    size_t m_dimension;                       // of a sample of the stream
+    ElementType m_elementType;
+
+    std::vector<std::wstring> m_archivePaths;
+    std::vector<Utterance> m_utterances; // in the order of the script file
+    std::vector<ChunkInfo> m_chunks;
+
+    // For the non-primary deserializer: corpus key -> index into m_utterances, SIZE_MAX if it has no features.
+    std::vector<size_t> m_keyToUtterance;
+
+    DISABLE_COPY_AND_MOVE(KaldiDataDeserializer);
+};
+
+}}}
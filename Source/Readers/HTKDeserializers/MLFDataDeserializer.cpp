@@ -14,6 +14,8 @@
 #include "../HTKMLFReader/msra_mgram.h"
 #include "latticearchive.h"
 #include "StringUtil.h"
+#include "MappedFile.h"
+#include "CPUThreadPool.h"
 
 
 #undef max // max is defined in minwindef.h
@@ -25,8 +27,8 @@ using namespace std;
 static float s_oneFloat = 1.0;
 static double s_oneDouble = 1.0;
 
-// Currently we only have a single mlf chunk that contains a vector of all labels.
-// TODO: In the future MLF should be converted to a more compact format that is amenable to chunking.
+// Currently we only have a single mlf chunk that contains the labels of all utterances.
+// TODO: In the future MLF should be converted to a format that is amenable to chunking.
 class MLFDataDeserializer::MLFChunk : public Chunk
 {
     MLFDataDeserializer* m_parent;
@@ -40,12 +42,6 @@ public:
     }
 };
 
-// Inner class for an utterance.
-struct MLFUtterance : SequenceDescription
-{
-    size_t m_sequenceStart;
-};
-
 MLFDataDeserializer::MLFDataDeserializer(CorpusDescriptorPtr corpus, const ConfigParameters& cfg, bool primary)
 {
     // TODO: This should be read in one place, potentially given by SGD.
@@ -105,92 +101,254 @@ MLFDataDeserializer::MLFDataDeserializer(CorpusDescriptorPtr corpus, const Confi
     InitializeStream(name, dimension);
 }
 
-// Currently we create a single chunk only.
-void MLFDataDeserializer::InitializeChunkDescriptions(CorpusDescriptorPtr corpus, const ConfigHelper& config, const wstring& stateListPath, size_t dimension)
+// Labels of the utterances in one shard of an MLF file, run-length encoded.
+struct MLFShard
 {
-    // TODO: Similarly to the old reader, currently we assume all Mlfs will have same root name (key)
-    // restrict MLF reader to these files--will make stuff much faster without having to use shortened input files
+    vector<string> m_keys;
+    vector<size_t> m_numSegments;                   // [utterance]
+    vector<msra::dbn::CLASSIDTYPE> m_segmentClassIds; // [segment]
+    vector<uint32_t> m_segmentEnds;                 // [segment] end frame relative to the start of its utterance
+};
 
-    // TODO: currently we do not use symbol and word tables.
-    const msra::lm::CSymbolSet* wordTable = nullptr;
-    unordered_map<const char*, int>* symbolTable = nullptr;
-    vector<wstring> mlfPaths = config.GetMlfPaths();
+static inline bool IsLineEnd(char c)
+{
+    return c == '\r' || c == '\n';
+}
 
-    // TODO: Currently we still use the old IO module. This will be refactored later.
-    const double htkTimeToFrame = 100000.0; // default is 10ms
-    msra::asr::htkmlfreader<msra::asr::htkmlfentry, msra::lattices::lattice::htkmlfwordsequence> labels(mlfPaths, set<wstring>(), stateListPath, wordTable, symbolTable, htkTimeToFrame);
+// Next line in [p, end), skipping empty ones; false if there is none.
+static bool NextMlfLine(const char*& p, const char* end, const char*& line, size_t& length)
+{
+    while (p < end && IsLineEnd(*p))
+        p++;
+    if (p == end)
+        return false;
+    line = p;
+    while (p < end && !IsLineEnd(*p))
+        p++;
+    length = p - line;
+    return true;
+}
 
-    // Make sure 'msra::asr::htkmlfreader' type has a move constructor
-    static_assert(
-        is_move_constructible<
-        msra::asr::htkmlfreader<msra::asr::htkmlfentry,
-        msra::lattices::lattice::htkmlfwordsequence >> ::value,
-        "Type 'msra::asr::htkmlfreader' should be move constructible!");
+static inline bool IsUtteranceEnd(const char* line, size_t length)
+{
+    return length == 1 && line[0] == '.';
+}
 
-    MLFUtterance description;
-    size_t numClasses = 0;
-    size_t totalFrames = 0;
+// Start of the first utterance at or after 'p', i.e. the line after the next utterance end delimiter.
+static const char* NextUtteranceStart(const char* begin, const char* p, const char* end)
+{
+    if (p > begin && !IsLineEnd(p[-1])) // in the middle of a line
+    {
+        while (p < end && !IsLineEnd(*p))
+            p++;
+    }
+    const char* line;
+    size_t length;
+    while (NextMlfLine(p, end, line, length))
+    {
+        if (IsUtteranceEnd(line, length))
+            return p;
+    }
+    return end;
+}
 
-    // TODO resize m_keyToSequence with number of IDs from string registry
-    for (const auto& l : labels)
+// Parses the utterances in [begin, end), which starts at an utterance and ends after one, as htkmlfreader does.
+static void ParseMlfShard(const char* begin, const char* end, const wstring& path, const unordered_map<string, size_t>& stateList,
+                          size_t dimension, double htkTimeToFrame, MLFShard& shard)
+{
+    unordered_map<string, size_t> noHmms;
+    vector<char> buffer;
+    vector<char*> tokens;
+    bool inUtterance = false;
+    bool skipping = false; // current utterance has a malformed name
+    size_t numFrames = 0;  // in the current utterance so far
+    size_t numSegments = 0;
+
+    const char* p = begin;
+    const char* line;
+    size_t length;
+    while (NextMlfLine(p, end, line, length))
     {
-        auto key = msra::strfun::utf8(l.first);
-        if (!corpus->IsIncluded(key))
-            continue;
+        if (!inUtterance)
+        {
+            if (length == 7 && strncmp(line, "#!MLF!#", 7) == 0) // skip embedded duplicate MLF headers (so user can 'cat' MLFs)
+                continue;
 
-        size_t id = corpus->KeyToId(key);
-        description.m_key.m_sequence = id;
+            // some mlf file have write errors, so skip malformed entry
+            inUtterance = true;
+            skipping = length < 3 || line[0] != '"' || line[length - 1] != '"';
+            if (skipping)
+            {
+                fprintf(stderr, "warning: filename entry (%s), skipping MLF entry in '%ls'\n", string(line, length).c_str(), path.c_str());
+                continue;
+            }
 
-        const auto& utterance = l.second;
-        description.m_sequenceStart = m_classIds.size();
-        uint32_t numberOfFrames = 0;
+            string filename(line + 1, length - 2); // strip quotes
+            if (filename.find("*/") == 0)
+                filename = filename.substr(2);
+#ifdef _MSC_VER
+            shard.m_keys.push_back(regex_replace(filename, regex("\\.[^\\.\\\\/:]*$"), string())); // delete extension (or not if none)
+#else
+            shard.m_keys.push_back(msra::dbn::removeExtension(filename));
+#endif
+            numFrames = 0;
+            numSegments = 0;
+            continue;
+        }
 
-        foreach_index(i, utterance)
+        if (IsUtteranceEnd(line, length))
         {
-            const auto& timespan = utterance[i];
-            if ((i == 0 && timespan.firstframe != 0) ||
-                (i > 0 && utterance[i - 1].firstframe + utterance[i - 1].numframes != timespan.firstframe))
-            {
-                RuntimeError("Labels are not in the consecutive order MLF in label set: %ls", l.first.c_str());
-            }
+            if (!skipping)
+                shard.m_numSegments.push_back(numSegments);
+            inUtterance = false;
+            continue;
+        }
+        if (skipping)
+            continue;
 
-            if (timespan.classid >= dimension)
-            {
-                RuntimeError("Class id %d exceeds the model output dimension %d.", (int)timespan.classid, (int)dimension);
-            }
+        buffer.assign(line, line + length);
+        buffer.push_back(0);
+        tokens.clear();
+        char* context = nullptr;
+        for (char* token = strtok_s(buffer.data(), " \t", &context); token; token = strtok_s(NULL, " \t", &context))
+            tokens.push_back(token);
 
-            if (timespan.classid != static_cast<msra::dbn::CLASSIDTYPE>(timespan.classid))
-            {
-                RuntimeError("CLASSIDTYPE has too few bits");
-            }
+        msra::asr::htkmlfentry timespan;
+        if (stateList.empty())
+            timespan.parse(tokens, htkTimeToFrame);
+        else
+            timespan.parsewithstatelist(tokens, stateList, htkTimeToFrame, noHmms);
 
-            if (SEQUENCELEN_MAX < timespan.firstframe + timespan.numframes)
-            {
-                RuntimeError("Maximum number of sample per sequence exceeded.");
-            }
+        if (timespan.firstframe != numFrames)
+            RuntimeError("Labels are not in the consecutive order MLF in label set: %s", shard.m_keys.back().c_str());
 
-            numClasses = max(numClasses, (size_t)(1u + timespan.classid));
+        if (timespan.classid >= dimension)
+            RuntimeError("Class id %d exceeds the model output dimension %d.", (int)timespan.classid, (int)dimension);
 
-            for (size_t t = timespan.firstframe; t < timespan.firstframe + timespan.numframes; t++)
-            {
-                m_classIds.push_back(timespan.classid);
-                numberOfFrames++;
-            }
+        if (SEQUENCELEN_MAX < timespan.firstframe + timespan.numframes)
+            RuntimeError("Maximum number of sample per sequence exceeded.");
+
+        if (timespan.numframes == 0)
+            continue;
+        numFrames += timespan.numframes;
+        if (numSegments > 0 && shard.m_segmentClassIds.back() == timespan.classid)
+            shard.m_segmentEnds.back() = (uint32_t)numFrames;
+        else
+        {
+            shard.m_segmentClassIds.push_back(timespan.classid);
+            shard.m_segmentEnds.push_back((uint32_t)numFrames);
+            numSegments++;
         }
+    }
+
+    if (inUtterance)
+        RuntimeError("htkmlfreader: unexpected end in mid-utterance in '%ls'", path.c_str());
+}
+
+// Reads a state list, one state name per line; its index is the line number, from 0.
+static unordered_map<string, size_t> ReadStateList(const wstring& stateListPath)
+{
+    unordered_map<string, size_t> stateList;
+    if (stateListPath.empty())
+        return stateList;
+
+    vector<char> buffer;
+    auto lines = msra::files::fgetfilelines(stateListPath, buffer);
+    for (size_t index = 0; index < lines.size(); index++)
+        stateList[lines[index]] = index;
+    if (stateList.size() != lines.size())
+        RuntimeError("readstatelist: lines (%d) not equal to statelistmap size (%d)", (int)lines.size(), (int)stateList.size());
+    fprintf(stderr, "total %lu state names in state list %ls\n", (unsigned long)stateList.size(), stateListPath.c_str());
+    return stateList;
+}
+
+// Currently we create a single chunk only.
+// Each MLF file is mapped into memory and cut into shards at utterance boundaries, which are parsed in parallel.
+// The labels are kept as segments of frames with the same class id, in the order of the files.
+void MLFDataDeserializer::InitializeChunkDescriptions(CorpusDescriptorPtr corpus, const ConfigHelper& config, const wstring& stateListPath, size_t dimension)
+{
+    // TODO: Similarly to the old reader, currently we assume all Mlfs will have same root name (key)
+    // restrict MLF reader to these files--will make stuff much faster without having to use shortened input files
+
+    // TODO: currently we do not use symbol and word tables.
+    vector<wstring> mlfPaths = config.GetMlfPaths();
+
+    const double htkTimeToFrame = 100000.0; // default is 10ms
+    const unordered_map<string, size_t> stateList = ReadStateList(stateListPath);
 
-        description.m_numberOfSamples = numberOfFrames;
-        m_utteranceIndex.push_back(totalFrames);
-        totalFrames += numberOfFrames;
+    size_t numClasses = 0;
+    size_t totalFrames = 0;
 
-        if (m_keyToSequence.size() <= description.m_key.m_sequence)
+    // TODO resize m_keyToSequence with number of IDs from string registry
+    for (const auto& path : mlfPaths)
+    {
+        fprintf(stderr, "MLFDataDeserializer: reading MLF file %ls ...", path.c_str());
+        MappedFile mlf(path);
+        const char* begin = mlf.GetData();
+        const char* end = begin + mlf.GetSize();
+
+        const char* line;
+        size_t length;
+        const char* p = begin;
+        if (!NextMlfLine(p, end, line, length) || length != 7 || strncmp(line, "#!MLF!#", 7) != 0)
+            RuntimeError("htkmlfreader: header missing in '%ls'", path.c_str());
+        begin = p;
+
+        // shards of at least a megabyte, several per thread for balance
+        const size_t minShardBytes = 1 << 20;
+        size_t numShards = min(max((size_t)(end - begin) / minShardBytes, (size_t)1), 4 * CPUThreadPool::Instance().NumThreads());
+        vector<const char*> shardBegins(numShards + 1, end);
+        shardBegins[0] = begin;
+        for (size_t i = 1; i < numShards; i++)
+            shardBegins[i] = NextUtteranceStart(begin, max(shardBegins[i - 1], begin + (end - begin) * i / numShards), end);
+
+        vector<MLFShard> shards(numShards);
+        CPUThreadPool::Instance().ParallelFor(numShards, 1, [&](size_t first, size_t last)
         {
-            m_keyToSequence.resize(description.m_key.m_sequence + 1, SIZE_MAX);
+            for (size_t i = first; i < last; i++)
+                ParseMlfShard(shardBegins[i], shardBegins[i + 1], path, stateList, dimension, htkTimeToFrame, shards[i]);
+        });
+
+        size_t numUtterances = 0;
+        for (auto& shard : shards)
+        {
+            size_t segment = 0;
+            for (size_t u = 0; u < shard.m_keys.size(); u++)
+            {
+                const size_t segmentsBegin = segment;
+                segment += shard.m_numSegments[u];
+                numUtterances++;
+
+                const auto& key = shard.m_keys[u];
+                if (!corpus->IsIncluded(key))
+                    continue;
+
+                size_t id = corpus->KeyToId(key);
+                if (m_keyToSequence.size() <= id)
+                {
+                    m_keyToSequence.resize(id + 1, SIZE_MAX);
+                }
+                if (m_keyToSequence[id] != SIZE_MAX)
+                    RuntimeError("htkmlfreader: duplicate entry '%s' in '%ls'", key.c_str(), path.c_str());
+                m_keyToSequence[id] = m_utteranceIndex.size();
+
+                m_utteranceIndex.push_back(totalFrames);
+                m_utteranceSegmentIndex.push_back(m_segmentClassIds.size());
+                for (size_t s = segmentsBegin; s < segment; s++)
+                {
+                    m_segmentClassIds.push_back(shard.m_segmentClassIds[s]);
+                    m_segmentEnds.push_back(shard.m_segmentEnds[s]);
+                    numClasses = max(numClasses, (size_t)(1u + shard.m_segmentClassIds[s]));
+                }
+                totalFrames += segment > segmentsBegin ? shard.m_segmentEnds[segment - 1] : 0;
+                m_numberOfSequences++;
+            }
+            shard = MLFShard(); // release it early
         }
-        assert(m_keyToSequence[description.m_key.m_sequence] == SIZE_MAX);
-        m_keyToSequence[description.m_key.m_sequence] = m_utteranceIndex.size() - 1;
-        m_numberOfSequences++;
+        fprintf(stderr, " total %lu entries\n", (unsigned long)numUtterances);
     }
     m_utteranceIndex.push_back(totalFrames);
+    m_utteranceSegmentIndex.push_back(m_segmentClassIds.size());
 
     m_totalNumberOfFrames = totalFrames;
 
@@ -265,12 +423,12 @@ ChunkPtr MLFDataDeserializer::GetChunk(ChunkIdType chunkId)
 template <class ElemType>
 struct MLFSequenceData : SparseSequenceData
 {
-    vector<ElemType> m_values;
-    unique_ptr<IndexType[]> m_indicesPtr;
+    PooledVector<ElemType> m_values;
+    PooledVector<IndexType> m_indicesBuffer;
 
     MLFSequenceData(size_t numberOfSamples) :
         m_values(numberOfSamples, 1),
-        m_indicesPtr(new IndexType[numberOfSamples])
+        m_indicesBuffer(numberOfSamples)
     {
         if (numberOfSamples > numeric_limits<IndexType>::max())
         {
@@ -282,7 +440,7 @@ struct MLFSequenceData : SparseSequenceData
         m_nnzCounts.resize(numberOfSamples, static_cast<IndexType>(1));
         m_numberOfSamples = (uint32_t) numberOfSamples;
         m_totalNnzCount = static_cast<IndexType>(numberOfSamples);
-        m_indices = m_indicesPtr.get();
+        m_indices = m_indicesBuffer.data();
     }
 
     const void* GetDataBuffer() override
@@ -295,7 +453,7 @@ void MLFDataDeserializer::GetSequenceById(size_t sequenceId, vector<SequenceData
 {
     if (m_frameMode)
     {
-        size_t label = m_classIds[sequenceId];
+        size_t label = GetClassId(sequenceId);
         assert(label < m_categories.size());
         result.push_back(m_categories[label]);
     }
@@ -307,24 +465,53 @@ void MLFDataDeserializer::GetSequenceById(size_t sequenceId, vector<SequenceData
         SparseSequenceDataPtr s;
         if (m_elementType == ElementType::tfloat)
         {
-            s = make_shared<MLFSequenceData<float>>(numberOfSamples);
+            s = MakeSequenceData<MLFSequenceData<float>>(numberOfSamples);
         }
         else
         {
             assert(m_elementType == ElementType::tdouble);
-            s = make_shared<MLFSequenceData<double>>(numberOfSamples);
+            s = MakeSequenceData<MLFSequenceData<double>>(numberOfSamples);
         }
 
-        for (size_t i = 0; i < numberOfSamples; i++)
+        size_t i = 0;
+        for (size_t segment = m_utteranceSegmentIndex[sequenceId]; segment < m_utteranceSegmentIndex[sequenceId + 1]; segment++)
         {
-            size_t frameIndex = startFrameIndex + i;
-            size_t label = m_classIds[frameIndex];
-            s->m_indices[i] = static_cast<IndexType>(label);
+            IndexType label = static_cast<IndexType>(m_segmentClassIds[segment]);
+            for (; i < m_segmentEnds[segment]; i++)
+                s->m_indices[i] = label;
         }
+        assert(i == numberOfSamples);
         result.push_back(s);
     }
 }
 
+msra::dbn::CLASSIDTYPE MLFDataDeserializer::GetClassId(size_t frameIndex) const
+{
+    // the utterance: the last one that starts at or before the frame, so not an empty one
+    size_t low = 0, high = m_utteranceIndex.size() - 1; // m_utteranceIndex[high] is the total number of frames
+    while (high - low > 1)
+    {
+        size_t middle = (low + high) / 2;
+        if (m_utteranceIndex[middle] <= frameIndex)
+            low = middle;
+        else
+            high = middle;
+    }
+
+    // the segment: the first one that ends after the frame
+    const size_t frame = frameIndex - m_utteranceIndex[low];
+    size_t first = m_utteranceSegmentIndex[low], last = m_utteranceSegmentIndex[low + 1];
+    while (first < last)
+    {
+        size_t middle = (first + last) / 2;
+        if (m_segmentEnds[middle] <= frame)
+            first = middle + 1;
+        else
+            last = middle;
+    }
+    return m_segmentClassIds[first];
+}
+
 bool MLFDataDeserializer::GetSequenceDescriptionByKey(const KeyType& key, SequenceDescription& result)
 {
 
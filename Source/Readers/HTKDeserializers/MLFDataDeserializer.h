@@ -46,6 +46,9 @@ private:
 
     void GetSequenceById(size_t sequenceId, std::vector<SequenceDataPtr>& result);
 
+    // Label of a frame, given by its index in all frames.
+    msra::dbn::CLASSIDTYPE GetClassId(size_t frameIndex) const;
+
     // Vector that maps KeyType.m_sequence into an utterance ID (or SIZE_MAX if the key is not assigned).
     // This assumes that IDs introduced by the corpus are dense (which they right now, depending on the number of invalid / filtered sequences).
     // TODO compare perf to map we had before.
@@ -54,10 +57,16 @@ private:
     // Number of sequences
     size_t m_numberOfSequences = 0;
 
-    // Array of all labels.
-    msra::dbn::biggrowablevector<msra::dbn::CLASSIDTYPE> m_classIds;
+    // Labels of all utterances, run-length encoded: each segment is a range of frames with the same class id.
+    // They are expanded to frames only when a sequence is requested.
+    msra::dbn::biggrowablevector<msra::dbn::CLASSIDTYPE> m_segmentClassIds;
+    // End frame of each segment, relative to the start of its utterance.
+    msra::dbn::biggrowablevector<uint32_t> m_segmentEnds;
+
+    // Index of the first segment of each utterance (and the total number of segments).
+    msra::dbn::biggrowablevector<size_t> m_utteranceSegmentIndex;
 
-    // Index of utterances in the m_classIds.
+    // Index of the first frame of each utterance in all frames (and the total number of frames).
     msra::dbn::biggrowablevector<size_t> m_utteranceIndex;
 
     // Type of the data this serializer provides.
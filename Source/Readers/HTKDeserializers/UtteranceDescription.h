@@ -11,49 +11,45 @@
 namespace Microsoft { namespace MSR { namespace CNTK {
 
 // This class represents a descriptor for a single utterance.
-// It is only used internally by the HTK deserializer.
+// It is only used internally by the HTK deserializer, while the script file is read; chunks keep their utterances
+// in a packed table instead (see HTKChunkDescription).
 class UtteranceDescription
 {
-    // Archive filename and frame range in that file.
-    msra::asr::htkfeatreader::parsedpath m_path;
+    // Archive file (index of the path interned by htkfeatreader::parsedpath) and frame range in that file.
+    unsigned int m_archivePathIndex;
+    size_t m_firstFrame;
+    uint32_t m_numberOfFrames;
 
     // Utterance id.
     size_t m_id;
 
-    // Expansion length in case if utterance should be expanded.
-    size_t m_expansionLength;
-
 public:
-    UtteranceDescription(msra::asr::htkfeatreader::parsedpath&& path)
-        : m_path(std::move(path)), m_expansionLength(0)
+    UtteranceDescription(const msra::asr::htkfeatreader::parsedpath& path)
+        : UtteranceDescription(path.archivepathindex(), path.firstframe(), path.numframes())
     {
     }
 
-    const msra::asr::htkfeatreader::parsedpath& GetPath() const
+    UtteranceDescription(unsigned int archivePathIndex, size_t firstFrame, size_t numberOfFrames)
+        : m_archivePathIndex(archivePathIndex), m_firstFrame(firstFrame), m_numberOfFrames((uint32_t)numberOfFrames), m_id(SIZE_MAX)
     {
-        return m_path;
+        if (m_numberOfFrames != numberOfFrames)
+        {
+            RuntimeError("Maximum number of frames per utterance exceeded in archive '%ls'.", GetPath().physicallocation().c_str());
+        }
     }
 
-    void ClearLogicalPath()
+    // Gets the path to read the frames from.
+    msra::asr::htkfeatreader::parsedpath GetPath() const
     {
-        m_path.ClearLogicalPath();
+        return msra::asr::htkfeatreader::parsedpath(m_archivePathIndex, m_firstFrame, m_firstFrame + m_numberOfFrames - 1);
     }
 
-    size_t GetNumberOfFrames() const
-    {
-        return m_path.numframes();
-    }
-
-    string GetKey() const
-    {
-        return m_path.GetLogicalPath();
-    }
+    unsigned int GetArchivePathIndex() const { return m_archivePathIndex; }
+    size_t GetFirstFrame() const { return m_firstFrame; }
+    size_t GetNumberOfFrames() const { return m_numberOfFrames; }
 
     size_t GetId() const  { return m_id; }
     void SetId(size_t id) { m_id = id; }
-
-    size_t GetExpansionLength() const { return m_expansionLength; }
-    void SetExpansionLength(size_t length) { m_expansionLength = length; }
 };
 
 }}}
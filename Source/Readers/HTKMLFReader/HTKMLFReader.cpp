@@ -26,6 +26,8 @@
 #include "ScriptableObjects.h"
 #include "HTKMLFReader.h"
 #include "TimerUtility.h"
+#include "BestGpu.h"     // for GetDeviceNumaNode()
+#include "numahelpers.h" // for bindcurrentthreadtonode()
 #ifdef LEAKDETECT
 #include <vld.h> // for memory leak detection
 #endif
@@ -66,6 +68,20 @@ void HTKMLFReader<ElemType>::InitFromConfig(const ConfigRecordType& readerConfig
     m_maxUtteranceLength = readerConfig(L"maxUtteranceLength", 10000);
     m_convertLabelsToTargets = false;
 
+    // numaNode: "none" (default), "auto" for the node of the GPU the minibatches go to, or a node number.
+    // On a multi-socket machine, the reading thread then runs on that node, and so do the frame buffers it fills.
+    m_numaNode = m_numaNodeNone;
+    m_boundNumaNode = -1;
+    if (readerConfig.Exists(L"numaNode"))
+    {
+        wstring numaNodeString = readerConfig.CanBeString(L"numaNode") ? readerConfig(L"numaNode") : wstring();
+        if      (EqualCI(numaNodeString, L"none")) m_numaNode = m_numaNodeNone;
+        else if (EqualCI(numaNodeString, L"auto")) m_numaNode = m_numaNodeAuto;
+        else                                       m_numaNode = readerConfig(L"numaNode");
+        if (m_numaNode < m_numaNodeAuto)
+            InvalidArgument("'numaNode' must be 'none', 'auto', or a NUMA node number.");
+    }
+
     intargvector numberOfuttsPerMinibatchForAllEpochs = readerConfig(L"nbruttsineachrecurrentiter", ConfigRecordType::Array(intargvector(vector<int>{1})));
     m_numSeqsPerMBForAllEpochs = numberOfuttsPerMinibatchForAllEpochs;
 
@@ -442,6 +458,9 @@ void HTKMLFReader<ElemType>::PrepareForTrainingOrTesting(const ConfigRecordType&
 
     if (readerConfig.Exists(L"unigram"))
         unigrampath = (const wstring&) readerConfig(L"unigram");
+    // 'compiledUnigram' names a binary copy of the unigram, which is read instead of parsing the ARPA file.
+    // If it does not exist yet, it is written after reading the ARPA file, for the next runs and the other workers.
+    wstring compiledunigrampath(readerConfig(L"compiledUnigram", L""));
 
     // load a unigram if needed (this is used for MMI training)
     msra::lm::CSymbolSet unigramsymbols;
@@ -452,7 +471,18 @@ void HTKMLFReader<ElemType>::PrepareForTrainingOrTesting(const ConfigRecordType&
     if (unigrampath != L"")
     {
         unigram.reset(new msra::lm::CMGramLM());
-        unigram->read(unigrampath, unigramsymbols, false /*filterVocabulary--false will build the symbol map*/, 1 /*maxM--unigram only*/);
+        if (!compiledunigrampath.empty() && fexists(compiledunigrampath))
+            unigram->read(compiledunigrampath, unigramsymbols, false /*filterVocabulary--false will build the symbol map*/, 1 /*maxM--unigram only*/);
+        else
+        {
+            unigram->read(unigrampath, unigramsymbols, false /*filterVocabulary--false will build the symbol map*/, 1 /*maxM--unigram only*/);
+            if (!compiledunigrampath.empty()) // write it under a name of our own and rename it, as other workers may be doing the same
+            {
+                wstring tmppath = msra::strfun::wstrprintf(L"%ls.%d.tmp", compiledunigrampath.c_str(), (int) GetCurrentProcessId());
+                unigram->writebinary(tmppath);
+                renameOrDie(tmppath, compiledunigrampath);
+            }
+        }
         silencewordid = unigramsymbols["!silence"]; // give this an id (even if not in the LM vocabulary)
         startwordid = unigramsymbols["<s>"];
         endwordid = unigramsymbols["</s>"];
@@ -713,6 +743,41 @@ void HTKMLFReader<ElemType>::PrepareForWriting(const ConfigRecordType& readerCon
 // requestedMBSize - [in] size of the minibatch (number of frames, etc.)
 // epoch - [in] epoch number for this loop
 // requestedEpochSamples - [in] number of samples to randomize, defaults to requestDataSize which uses the number of samples there are in the dataset
+// Bind the calling thread, which reads the data, to the NUMA node selected by 'numaNode', before it loads any chunks.
+// This is done once; the binding stays for the following epochs, and for the threads created afterwards.
+template <class ElemType>
+void HTKMLFReader<ElemType>::BindToNumaNode(const std::unordered_set<InputStreamDescription>& requiredStreams)
+{
+    if (m_numaNode == m_numaNodeNone || m_boundNumaNode >= 0)
+        return;
+
+    int node = m_numaNode;
+    if (node == m_numaNodeAuto)
+    {
+        node = -1;
+        for (const auto& stream : requiredStreams)
+        {
+            if (stream.GetDeviceId() >= 0)
+            {
+                node = GetDeviceNumaNode(stream.GetDeviceId());
+                break;
+            }
+        }
+        if (node < 0 || msra::numa::getnumnodes() < 2) // CPU training, or nothing to choose from
+            return;
+    }
+
+    if (!msra::numa::bindcurrentthreadtonode(node))
+    {
+        fprintf(stderr, "HTKMLFReader: Failed to bind the reading thread to NUMA node %d.\n", node);
+        m_numaNode = m_numaNodeNone; // don't try again
+        return;
+    }
+    m_boundNumaNode = node;
+    if (m_verbosity > 0)
+        fprintf(stderr, "HTKMLFReader: Reading on NUMA node %d.\n", node);
+}
+
 template <class ElemType>
 void HTKMLFReader<ElemType>::StartDistributedMinibatchLoop(size_t requestedMBSize, size_t epoch, size_t subsetNum, size_t numSubsets, size_t requestedEpochSamples /*= requestDataSize*/)
 {
@@ -26,6 +26,8 @@ class HTKMLFReader : public DataReaderBase
 private:
     const static size_t m_htkRandomizeAuto = 0;
     const static size_t m_htkRandomizeDisable = (size_t) -1;
+    const static int m_numaNodeNone = -1;
+    const static int m_numaNodeAuto = -2;
 
     unique_ptr<msra::dbn::minibatchiterator> m_mbiter;
     unique_ptr<msra::dbn::minibatchsource> m_frameSource;
@@ -103,6 +105,11 @@ private:
 
     int m_verbosity;
 
+    // 'numaNode': the NUMA node whose CPUs read the data, so that the frame buffers they fill are allocated there
+    int m_numaNode;      // m_numaNodeNone, m_numaNodeAuto (that of the GPU of the minibatches), or a node
+    int m_boundNumaNode; // to which the reading thread has been bound, or -1
+    void BindToNumaNode(const std::unordered_set<InputStreamDescription>& requiredStreams);
+
     template <class ConfigRecordType>
     void PrepareForTrainingOrTesting(const ConfigRecordType& config);
     template <class ConfigRecordType>
@@ -185,6 +192,19 @@ public:
 
     virtual void StartDistributedMinibatchLoop(size_t mbSize, size_t epoch, size_t subsetNum, size_t numSubsets, size_t requestedEpochSamples = requestDataSize) override;
 
+    // the stream descriptions tell the device of the minibatches, for 'numaNode'
+    virtual void StartMinibatchLoop(size_t mbSize, size_t epoch, const std::unordered_set<InputStreamDescription>& requiredStreams, size_t requestedEpochSamples = requestDataSize) override
+    {
+        BindToNumaNode(requiredStreams);
+        StartMinibatchLoop(mbSize, epoch, requestedEpochSamples);
+    }
+
+    virtual void StartDistributedMinibatchLoop(size_t mbSize, size_t epoch, size_t subsetNum, size_t numSubsets, const std::unordered_set<InputStreamDescription>& requiredStreams, size_t requestedEpochSamples = requestDataSize) override
+    {
+        BindToNumaNode(requiredStreams);
+        StartDistributedMinibatchLoop(mbSize, epoch, subsetNum, numSubsets, requestedEpochSamples);
+    }
+
     virtual bool TryGetMinibatch(StreamMinibatchInputs& matrices);
     virtual const std::map<LabelIdType, LabelType>& GetLabelMapping(const std::wstring& sectionName);
     virtual void SetLabelMapping(const std::wstring& sectionName, const std::map<LabelIdType, LabelType>& labelMapping);
@@ -100,6 +100,7 @@ void HTKMLFWriter<ElemType>::InitFromConfig(const ConfigRecordType& writerConfig
 template <class ElemType>
 void HTKMLFWriter<ElemType>::Destroy()
 {
+    WaitForPendingWrite();
     delete[] m_tempArray;
     m_tempArray = nullptr;
     m_tempArraySize = 0;
@@ -153,17 +154,32 @@ void HTKMLFWriter<ElemType>::Save(std::wstring& outputFile, Matrix<ElemType>& ou
         }
     }
 
-    const size_t nansinf = output.countnaninf();
-    if (nansinf > 0)
-        fprintf(stderr, "chunkeval: %d NaNs or INF detected in '%ls' (%d frames)\n", (int) nansinf, outputFile.c_str(), (int) output.cols());
-    // save it
-    msra::files::make_intermediate_dirs(outputFile);
-    msra::util::attempt(5, [&]()
-                        {
-                            msra::asr::htkfeatwriter::write(outputFile, "USER", this->sampPeriod, output);
-                        });
-
-    fprintf(stderr, "evaluate: writing %d frames of %ls\n", (int) output.cols(), outputFile.c_str());
+    // write the file in the background; only one write is pending at a time, which keeps the files in order
+    WaitForPendingWrite();
+    auto pOutput = std::make_shared<msra::dbn::matrix>(std::move(output));
+    m_pendingWrite = std::async(std::launch::async, [this, outputFile, pOutput]()
+    {
+        const msra::dbn::matrix& output = *pOutput;
+        const size_t nansinf = output.countnaninf();
+        if (nansinf > 0)
+            fprintf(stderr, "chunkeval: %d NaNs or INF detected in '%ls' (%d frames)\n", (int) nansinf, outputFile.c_str(), (int) output.cols());
+        // save it
+        msra::files::make_intermediate_dirs(outputFile);
+        msra::util::attempt(5, [&]()
+                            {
+                                msra::asr::htkfeatwriter::write(outputFile, "USER", this->sampPeriod, output);
+                            });
+
+        fprintf(stderr, "evaluate: writing %d frames of %ls\n", (int) output.cols(), outputFile.c_str());
+    });
+}
+
+// wait for the background write started by Save(), and pass on its errors
+template <class ElemType>
+void HTKMLFWriter<ElemType>::WaitForPendingWrite()
+{
+    if (m_pendingWrite.valid())
+        m_pendingWrite.get();
 }
 
 template <class ElemType>
@@ -9,6 +9,7 @@
 #include "ScriptableObjects.h"
 #include <map>
 #include <vector>
+#include <future>
 
 namespace Microsoft { namespace MSR { namespace CNTK {
 
@@ -26,8 +27,10 @@ private:
     unsigned int sampPeriod;
     size_t outputFileIndex;
     void Save(std::wstring& outputFile, Matrix<ElemType>& outputData);
+    void WaitForPendingWrite();
     ElemType* m_tempArray;
     size_t m_tempArraySize;
+    std::future<void> m_pendingWrite; // the last file is written in the background while the next minibatch is computed
 
     enum OutputTypes
     {
@@ -19,6 +19,9 @@
 #include <stdint.h>
 #include <limits.h>
 #include <wchar.h>
+#ifdef __unix__
+#include <fcntl.h>
+#endif
 #include "simplesenonehmm.h"
 #include <array>
 #include "minibatchsourcehelpers.h"
@@ -433,19 +436,38 @@ public:
                 }
             }
 
+            archivePathIdx = internarchivepath(archivepath);
+            logicalpath = msra::strfun::utf8(localLogicalpath);
+        }
+
+        // constructor for the frame range [s,e] of an archive that has been interned by internarchivepath(),
+        // e.g. from a compact table of utterances; the logical path is empty
+        parsedpath(unsigned int archivePathIdx, size_t s, size_t e)
+            : logicalpath(""), archivePathIdx(archivePathIdx), isarchive(true), isidxformat(false), s(s), e(e)
+        {
+        }
+
+        // index of an archive path in archivePathStringVector; the path is added if it is new
+        static unsigned int internarchivepath(const wstring& archivepath)
+        {
             auto iter = archivePathStringMap.find(archivepath);
             if (iter != archivePathStringMap.end())
-            {
-                archivePathIdx = iter->second;
-            }
-            else
-            {
-                archivePathIdx = (unsigned int)archivePathStringMap.size();
-                archivePathStringMap[archivepath] = archivePathIdx;
-                archivePathStringVector.push_back(archivepath);
-            }
+                return iter->second;
 
-            logicalpath = msra::strfun::utf8(localLogicalpath);
+            unsigned int idx = (unsigned int)archivePathStringMap.size();
+            archivePathStringMap[archivepath] = idx;
+            archivePathStringVector.push_back(archivepath);
+            return idx;
+        }
+
+        // index of the archive file in archivePathStringVector, and first frame inside it
+        unsigned int archivepathindex() const
+        {
+            return archivePathIdx;
+        }
+        size_t firstframe() const
+        {
+            return s;
         }
 
         // get the physical path for 'make' test
@@ -454,6 +476,14 @@ public:
             return archivepath();
         }
 
+        // order of the data on disk: by archive file, then by first frame
+        static bool diskorder(const parsedpath& a, const parsedpath& b)
+        {
+            if (a.archivePathIdx != b.archivePathIdx)
+                return a.archivepath() < b.archivepath();
+            return a.s < b.s;
+        }
+
         // Gets logical path of the utterance.
         string GetLogicalPath() const
         {
@@ -645,6 +675,33 @@ public:
         }
         return numframes;
     }
+    // ask the OS to read the frames of the given files ahead, in the background
+    // All requests are issued at once, so that the disk or network file system can serve them sorted by offset
+    // while the caller is still busy; the paths should be sorted by parsedpath::diskorder() so that adjacent ranges are merged.
+    // Only implemented on Linux (posix_fadvise), a no-op elsewhere. This will alter the state of this object in that it opens the files.
+    void willneed(const vector<const parsedpath*>& ppaths)
+    {
+        for (size_t i = 0; i < ppaths.size();)
+        {
+            // a run of adjacent frame ranges in one file
+            const parsedpath& first = *ppaths[i];
+            size_t s = first.s, e = first.e;
+            for (i++; i < ppaths.size() && ppaths[i]->physicallocation() == first.physicallocation() && ppaths[i]->s <= e + 1; i++)
+                e = max(e, ppaths[i]->e);
+
+            if (f == NULL || first.physicallocation() != physicalpath)
+                openphysical(first);
+            if (physicalframes == 0)
+                continue;
+            e = min(e, physicalframes - 1); // full files are given as [0, INT_MAX]
+            if (s > e)
+                continue;
+#ifdef __unix__
+            posix_fadvise(fileno(f), physicaldatastart + s * vecbytesize, (e + 1 - s) * vecbytesize, POSIX_FADV_WILLNEED);
+#endif
+        }
+    }
+
     // get dimension and type information for a feature file
     // This will alter the state of this object in that it opens the file. It is efficient to read it right afterwards
     void getinfo(const parsedpath& ppath, string& featkind2, size_t& featdim2, unsigned int& featperiod2)
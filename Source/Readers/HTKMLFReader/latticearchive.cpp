@@ -82,6 +82,7 @@ static size_t tryfind(const MAPTYPE &map, const KEYTYPE &key, VALTYPE deflt)
 //     - OUTPATH                --the resulting archive (a huge file), simple concatenation of binary blocks
 //     - OUTPATH.toc            --contains keys and offsets; this is how content in archive is found
 //       KEY=ARCHIVE[BYTEOFFSET]        // where ARCHIVE can be empty, meaning same as previous
+//     - OUTPATH.toc.idx        --binary index compiled from the .toc when it is first opened (see archive::open())
 //     - OUTPATH.symlist    --list of all unit names encountered, in order of numeric index used in archive (first = index 0)
 //                                This file is suitable as an input to HHEd's AU command.
 //  - in actual use,
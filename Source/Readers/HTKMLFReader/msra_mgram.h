@@ -346,6 +346,20 @@ public:
         r = value;
         assert(value == back());
     }
+
+    // binary image, for CMGramLM::writebinary()
+    void write(FILE *f) const
+    {
+        const std::vector<unsigned char> &base = *this;
+        fputint(f, (int) size());
+        fwriteOrDie(base, f);
+    }
+    void read(FILE *f)
+    {
+        std::vector<unsigned char> &base = *this;
+        size_t n = fgetint(f);
+        freadOrDie(base, n * 3, f);
+    }
 };
 
 // maps from m-grams to m-gram storage locations.
@@ -485,6 +499,39 @@ public:
         std::swap(idmax, other.idmax);
     }
 
+    // binary image of the map, without the w->id mapping, which read() callers establish through created()
+    void write(FILE *f) const
+    {
+        fputTag(f, "MAP ");
+        fputint(f, M);
+        fputint(f, idmax);
+        fputint(f, level1nonsparse ? 1 : 0);
+        fputint(f, (int) level1lookup.size());
+        fwriteOrDie(level1lookup, f);
+        for (int m = 0; m < M; m++)
+        {
+            fputint(f, (int) firsts[m].size());
+            fwriteOrDie(firsts[m], f);
+        }
+        for (int m = 0; m <= M; m++)
+            ids[m].write(f);
+    }
+    void read(FILE *f)
+    {
+        clear();
+        fcheckTag(f, "MAP ");
+        M = fgetint(f);
+        idmax = fgetint(f);
+        level1nonsparse = fgetint(f) != 0;
+        freadOrDie(level1lookup, (size_t) fgetint(f), f);
+        firsts.resize(M);
+        for (int m = 0; m < M; m++)
+            freadOrDie(firsts[m], (size_t) fgetint(f), f);
+        ids.resize(M + 1);
+        for (int m = 0; m <= M; m++)
+            ids[m].read(f);
+    }
+
     // --- id mapping
 
     // test whether a word id is known in this model
@@ -1117,6 +1164,22 @@ public:
     {
         data.swap(other.data);
     }
+    // binary image, for CMGramLM::writebinary()
+    void write(FILE *f) const
+    {
+        fputint(f, (int) data.size());
+        foreach_index (m, data)
+        {
+            fputint(f, (int) data[m].size());
+            fwriteOrDie(data[m], f);
+        }
+    }
+    void read(FILE *f)
+    {
+        data.resize(fgetint(f));
+        foreach_index (m, data)
+            freadOrDie(data[m], (size_t) fgetint(f), f);
+    }
     // access existing elements. Usage:
     // DATATYPE & element = mgram_data[mgram_map[mgram_map::key (mgram, m)]]
     __forceinline DATATYPE &operator[](const mgram_map::coord &c)
@@ -1444,9 +1507,13 @@ public:
     // Otherwise the userSymMap is updated with the words from the LM.
     // 'maxM' allows to restrict the loading to a smaller LM order.
     // SYMMAP can be e.g. CSymMap or CSymbolSet.
+    // A binary file written by writebinary() is recognized and read by readbinary() instead.
     template <class SYMMAP>
     void read(const std::wstring &pathname, SYMMAP &userSymMap, bool filterVocabulary, int maxM)
     {
+        if (isbinary(pathname))
+            return readbinary(pathname, userSymMap, filterVocabulary, maxM);
+
         int lineNo = 0;
         auto_file_ptr f(fopenOrDie(pathname, L"rbS"));
         fprintf(stderr, "read: reading %ls", pathname.c_str());
@@ -1641,6 +1708,88 @@ public:
         map.created(userToLMSymMap);
     }
 
+    // -----------------------------------------------------------------------
+    // binary format -- the model as read() has built it in memory
+    // -----------------------------------------------------------------------
+    // Parsing a large ARPA file takes minutes, while this format is read with a few
+    // large fread() calls. The scores are stored unchanged, so a model read back
+    // scores exactly like the ARPA file it was compiled from.
+
+    static bool isbinary(const std::wstring &pathname)
+    {
+        auto_file_ptr f(fopenOrDie(pathname, L"rbS"));
+        char tag[4];
+        return fread(tag, sizeof(tag), 1, f) == 1 && memcmp(tag, "MGLM", sizeof(tag)) == 0;
+    }
+
+    // write the model in the binary format
+    void writebinary(const std::wstring &pathname) const
+    {
+        auto_file_ptr f(fopenOrDie(pathname, L"wbS"));
+        fputTag(f, "MGLM");
+        fputint(f, 1); // version
+        fputint(f, M);
+        fputint(f, (int) lmSymbols.size()); // words in order of their LM ids
+        for (int id = 0; id < (int) lmSymbols.size(); id++)
+            fputstring(f, idToSymbol(id));
+        map.write(f);
+        logP.write(f);
+        logB.write(f);
+        fputTag(f, "EMGL");
+        fflushOrDie(f);
+    }
+
+    // read a binary model
+    // Same arguments as for read(). With 'filterVocabulary', the m-grams with words outside of 'userSymMap'
+    // remain in memory but cannot be reached by score() (the zerogram score is that of the unfiltered model).
+    template <class SYMMAP>
+    void readbinary(const std::wstring &pathname, SYMMAP &userSymMap, bool filterVocabulary, int maxM)
+    {
+        auto_file_ptr f(fopenOrDie(pathname, L"rbS"));
+        fprintf(stderr, "read: reading binary %ls", pathname.c_str());
+        filename = pathname;
+
+        fcheckTag(f, "MGLM");
+        if (fgetint(f) != 1)
+            RuntimeError("read: unsupported version of binary LM file: %ls", pathname.c_str());
+        M = fgetint(f);
+
+        int numSymbols = fgetint(f);
+        lmSymbols.clear();
+        lmSymbols.reserve(numSymbols);
+        for (int id = 0; id < numSymbols; id++)
+        {
+            lmSymbols.push_back(SYMBOL(id, fgetstring(f).c_str()));
+            if (!filterVocabulary)
+                userSymMap.sym2id(lmSymbols.back().symbol); // create it in user's space
+        }
+        std::sort(lmSymbols.begin(), lmSymbols.end());
+        idToSymIndex.assign(lmSymbols.size(), -1);
+        for (int i = 0; i < (int) lmSymbols.size(); i++)
+            idToSymIndex[lmSymbols[i].id] = i;
+
+        map.read(f);
+        logP.read(f);
+        logB.read(f);
+        fcheckTag(f, "EMGL");
+
+        if (M > maxM) // caller wants a lower order
+        {
+            M = maxM;
+            map.resize(M);
+            logP.resize(M);
+            logB.resize(M - 1);
+        }
+        for (int m = 1; m <= M; m++)
+            fprintf(stderr, ", %d %d-grams", map.size(m), m);
+        fprintf(stderr, "\n");
+
+        std::vector<int> userToLMSymMap(userSymMap.size());
+        for (int i = 0; i < (int) userSymMap.size(); i++)
+            userToLMSymMap[i] = symbolToId(userSymMap.id2sym(i));
+        map.created(userToLMSymMap);
+    }
+
 protected:
     // sort LM such that iterators will iterate in increasing order w.r.t. w2id[w]
     // This is achieved by replacing all internal ids by w2id[w].
@@ -8,9 +8,6 @@
 #pragma once
 
 #include "Basics.h" // for attempt()
-#ifdef _WIN32
-#include "numahelpers.h" // for NUMA allocation
-#endif
 #include "minibatchsourcehelpers.h"
 #include "minibatchiterator.h"
 #include "biggrowablevectors.h"
@@ -38,15 +35,9 @@ class biggrowablevectorarray : public growablevectorbase<msra::dbn::matrix>
     // allocate a block
     msra::dbn::matrix *newblock() const
     {
-// we stripe the data across NUMA nodes as to not fill up one node with the feature data
-#ifdef _WIN32
-        msra::numa::overridenode((int) msra::numa::getmostspaciousnumanode());
-#endif
-        msra::dbn::matrix *res = new msra::dbn::matrix(m, elementsperblock);
-#ifdef _WIN32
-        msra::numa::overridenode(-1); // note: we really should reset it also in case of failure
-#endif
-        return res;
+        // The pages of the block are placed on the NUMA node of the thread that first writes them, i.e. the reading thread.
+        // (ssematrix does not allocate through msra::numa::malloc(), so there is no node to override here; see 'numaNode' of the reader.)
+        return new msra::dbn::matrix(m, elementsperblock);
     }
 
     // handling of page file
@@ -5,16 +5,31 @@
 
 #pragma once
 #include <opencv2/core/mat.hpp>
+#include <opencv2/core/version.hpp>
 #include "Config.h"
 #ifdef USE_ZIP
 #include <zip.h>
 #include <unordered_map>
 #include <memory>
 #include "ConcStack.h"
+#include "MappedFile.h"
+#endif
+
+// The IMREAD_REDUCED_* modes of OpenCV 3.1 and later decode JPEG images at a reduced size.
+#if CV_VERSION_MAJOR > 3 || (CV_VERSION_MAJOR == 3 && CV_VERSION_MINOR >= 1)
+#define CNTK_REDUCED_IMAGE_DECODE
 #endif
 
 namespace Microsoft { namespace MSR { namespace CNTK {
 
+// Decodes an encoded image. JPEG images are decoded at 1/2, 1/4 or 1/8 of their size (scaling in the DCT domain,
+// which saves most of the decoding work) as long as their shorter side stays at least 'minDecodedSide'.
+// 0 decodes all images at full size.
+cv::Mat DecodeImage(const unsigned char* data, size_t size, bool grayscale, size_t minDecodedSide);
+
+// Gets the width and height from the header of a JPEG image, false if it is not a JPEG image.
+bool GetJpegSize(const unsigned char* data, size_t size, size_t& width, size_t& height);
+
 class ByteReader
 {
 public:
@@ -22,7 +37,9 @@ public:
     virtual ~ByteReader() = default;
 
     virtual void Register(const std::map<std::string, size_t>& sequences) = 0;
-    virtual cv::Mat Read(size_t seqId, const std::string& path, bool grayscale) = 0;
+
+    // Reads and decodes an image, see DecodeImage() for 'minDecodedSide'.
+    virtual cv::Mat Read(size_t seqId, const std::string& path, bool grayscale, size_t minDecodedSide = 0) = 0;
 
     DISABLE_COPY_AND_MOVE(ByteReader);
 };
@@ -34,24 +51,44 @@ public:
     {}
 
     void Register(const std::map<std::string, size_t>&) override {}
-    cv::Mat Read(size_t seqId, const std::string& path, bool grayscale) override;
+    cv::Mat Read(size_t seqId, const std::string& path, bool grayscale, size_t minDecodedSide = 0) override;
 
     std::string m_expandDirectory;
 };
 
 #ifdef USE_ZIP
+// Reads images from a zip file.
+// If 'memoryMap' is set, the file is mapped into memory instead of being read through libzip: its central directory
+// is parsed once, stored (uncompressed) entries are decoded right where they are mapped without copying them, and
+// deflated entries are inflated by the reading threads concurrently.
 class ZipByteReader : public ByteReader
 {
 public:
-    ZipByteReader(const std::string& zipPath);
+    ZipByteReader(const std::string& zipPath, bool memoryMap = false);
 
     void Register(const std::map<std::string, size_t>& sequences) override;
-    cv::Mat Read(size_t seqId, const std::string& path, bool grayscale) override;
+    cv::Mat Read(size_t seqId, const std::string& path, bool grayscale, size_t minDecodedSide = 0) override;
 
 private:
     using ZipPtr = std::unique_ptr<zip_t, void(*)(zip_t*)>;
     ZipPtr OpenZip();
 
+    // An entry of a memory mapped zip file.
+    struct MappedEntry
+    {
+        uint64_t m_offset;         // of the data in the file
+        uint64_t m_compressedSize;
+        uint64_t m_size;
+        uint16_t m_method;         // 0 stored, 8 deflated
+    };
+
+    void RegisterMapped(const std::map<std::string, size_t>& sequences);
+    cv::Mat ReadMapped(size_t seqId, const std::string& path, bool grayscale, size_t minDecodedSide);
+
+    bool m_memoryMap;
+    MappedFilePtr m_mappedFile;
+    std::unordered_map<size_t, MappedEntry> m_seqIdToEntry;
+
     std::string m_zipPath;
     conc_stack<ZipPtr> m_zips;
     std::unordered_map<size_t, std::pair<zip_uint64_t, zip_uint64_t>> m_seqIdToIndex;
@@ -93,6 +93,7 @@ ImageConfigHelper::ImageConfigHelper(const ConfigParameters& config)
     }
 
     m_cpuThreadCount = config(L"numCPUThreads", 0);
+    m_pinCpuThreads = config(L"pinCPUThreads", false);
 
     m_cropType = ParseCropType(featureSection(L"cropType", ""));
 }
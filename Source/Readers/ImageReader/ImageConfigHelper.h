@@ -48,6 +48,12 @@ public:
         return m_cpuThreadCount;
     }
 
+    // Whether the threads decoding images are pinned to the CPUs the process may run on, one thread to a CPU.
+    bool ShouldPinCpuThreads() const
+    {
+        return m_pinCpuThreads;
+    }
+
     bool ShouldRandomize() const
     {
         return m_randomize;
@@ -78,6 +84,7 @@ private:
     std::vector<StreamDescriptionPtr> m_streams;
     ImageLayoutKind m_dataFormat;
     int m_cpuThreadCount;
+    bool m_pinCpuThreads;
     bool m_randomize;
     bool m_grayscale;
     CropType m_cropType;
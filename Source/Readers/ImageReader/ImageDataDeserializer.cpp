@@ -9,6 +9,7 @@
 #include <opencv2/opencv.hpp>
 #include <numeric>
 #include <limits>
+#include <mutex>
 #include "ImageDataDeserializer.h"
 #include "ImageConfigHelper.h"
 #include "StringUtil.h"
@@ -17,6 +18,9 @@
 #include "ImageTransformers.h"
 #include "SequenceData.h"
 #include "ImageUtil.h"
+#ifdef __linux__
+#include <sched.h>
+#endif
 
 namespace Microsoft { namespace MSR { namespace CNTK {
 
@@ -60,31 +64,45 @@ private:
     vector<IndexType> m_indices;
 };
 
-// For image, chunks correspond to a single image.
+// For image, chunks correspond to a single image: to a single sequence, or to the sequences of its views
+// in the multi-view mode, which share one decoded image.
 class ImageDataDeserializer::ImageChunk : public Chunk, public std::enable_shared_from_this<ImageChunk>
 {
-    ImageSequenceDescription m_description;
     ImageDataDeserializer& m_parent;
+    size_t m_firstSequence; // index into m_parent.m_imageSequences
+    size_t m_numberOfViews;
+
+    std::once_flag m_decodeOnce;
+    cv::Mat m_decoded;
 
 public:
-    ImageChunk(ImageSequenceDescription& description, ImageDataDeserializer& parent)
-        : m_description(description), m_parent(parent)
+    ImageChunk(size_t firstSequence, size_t numberOfViews, ImageDataDeserializer& parent)
+        : m_parent(parent), m_firstSequence(firstSequence), m_numberOfViews(numberOfViews)
     {
     }
 
     virtual void GetSequence(size_t sequenceId, std::vector<SequenceDataPtr>& result) override
     {
-        assert(sequenceId == m_description.m_id);
-        const auto& imageSequence = m_description;
+        assert(m_firstSequence <= sequenceId && sequenceId < m_firstSequence + m_numberOfViews);
+        const auto& imageSequence = m_parent.m_imageSequences[sequenceId];
+        m_parent.PinCurrentThread();
 
-        auto image = std::make_shared<ImageSequenceData>();
-        image->m_image = std::move(m_parent.ReadImage(m_description.m_id, imageSequence.m_path, m_parent.m_grayscale));
+        auto image = MakeSequenceData<ImageSequenceData>();
         auto& cvImage = image->m_image;
-        if (!cvImage.data)
-            RuntimeError("Cannot open file '%s'", imageSequence.m_path.c_str());
+        auto& cache = m_parent.m_decodedImageCache;
+        if (!cache || !cache->TryGet(sequenceId, cvImage))
+        {
+            cvImage = DecodeImage();
+            if (!cvImage.data)
+                RuntimeError("Cannot open file '%s'", imageSequence.m_path.c_str());
+
+            // Convert element type.
+            ConvertImageToSupportedDataType(cvImage);
+            if (cache)
+                cache->TransformAndAdd(sequenceId, cvImage);
+        }
 
-        // Convert element type.
-        ElementType dataType = ConvertImageToSupportedDataType(cvImage);
+        ElementType dataType = GetElementTypeFromOpenCVType(cvImage.depth());
         if (!cvImage.isContinuous())
             cvImage = cvImage.clone();
         assert(cvImage.isContinuous());
@@ -97,7 +115,7 @@ public:
         image->m_elementType = dataType;
         result.push_back(image);
 
-        auto label = std::make_shared<CategorySequenceData>();
+        auto label = MakeSequenceData<CategorySequenceData>();
         label->m_chunk = shared_from_this();
         m_parent.m_labelGenerator->CreateLabelFor(imageSequence.m_classId, *label);
         label->m_numberOfSamples = 1;
@@ -105,6 +123,20 @@ public:
     }
 
 private:
+    // Decodes the image. The views decode it only once; each gets a copy, as the transforms change it in place.
+    cv::Mat DecodeImage()
+    {
+        const auto& first = m_parent.m_imageSequences[m_firstSequence];
+        if (m_numberOfViews == 1)
+            return m_parent.ReadImage(first.m_id, first.m_path, m_parent.m_grayscale);
+
+        std::call_once(m_decodeOnce, [this, &first]()
+        {
+            m_decoded = m_parent.ReadImage(first.m_id, first.m_path, m_parent.m_grayscale);
+        });
+        return m_decoded.clone();
+    }
+
     ElementType ConvertImageToSupportedDataType(cv::Mat& image)
     {
         ElementType resultType;
@@ -173,7 +205,10 @@ ImageDataDeserializer::ImageDataDeserializer(CorpusDescriptorPtr corpus, const C
     // TODO: multiview should be done on the level of randomizer/transformers - it is responsiblity of the
     // TODO: randomizer to collect how many copies each transform needs and request same sequence several times.
     bool multiViewCrop = config(L"multiViewCrop", false);
+    m_zipMemoryMap = config(L"zipMemoryMap", false);
     CreateSequenceDescriptions(corpus, config(L"file"), labelDimension, multiViewCrop);
+
+    InitializeThreadPinning(config(L"pinCPUThreads", false));
 }
 
 // TODO: Should be removed at some point.
@@ -217,20 +252,69 @@ ImageDataDeserializer::ImageDataDeserializer(const ConfigParameters& config)
         RuntimeError("Unsupported label element type '%d'.", (int)label->m_elementType);
     }
 
+    m_zipMemoryMap = config(L"zipMemoryMap", false);
     CreateSequenceDescriptions(std::make_shared<CorpusDescriptor>(false), configHelper.GetMapPath(), labelDimension, configHelper.IsMultiViewCrop());
+
+    InitializeThreadPinning(configHelper.ShouldPinCpuThreads());
+}
+
+void ImageDataDeserializer::InitializeThreadPinning(bool pinCpuThreads)
+{
+    m_pinCpuThreads = pinCpuThreads;
+    m_numPinnedThreads = 0;
+    if (!m_pinCpuThreads)
+        return;
+
+#ifdef __linux__
+    cpu_set_t cpus;
+    if (sched_getaffinity(0, sizeof(cpus), &cpus) != 0)
+        RuntimeError("Cannot get the CPUs of the process to pin the image decoding threads: %s.", strerror(errno));
+    for (int cpu = 0; cpu < CPU_SETSIZE; cpu++)
+    {
+        if (CPU_ISSET(cpu, &cpus))
+            m_cpus.push_back(cpu);
+    }
+#else
+    fprintf(stderr, "WARNING: ImageDataDeserializer: pinCPUThreads is only supported on Linux, the threads are not pinned.\n");
+    m_pinCpuThreads = false;
+#endif
+}
+
+void ImageDataDeserializer::PinCurrentThread()
+{
+    if (!m_pinCpuThreads)
+        return;
+
+    static thread_local bool pinned = false;
+    if (pinned)
+        return;
+    pinned = true;
+
+#ifdef __linux__
+    // The decoding threads come from several OpenMP thread pools (the prefetch thread has its own),
+    // so threads are pinned as they show up. Failing to pin only costs performance.
+    int cpu = m_cpus[m_numPinnedThreads++ % m_cpus.size()];
+    cpu_set_t cpus;
+    CPU_ZERO(&cpus);
+    CPU_SET(cpu, &cpus);
+    if (sched_setaffinity(0, sizeof(cpus), &cpus) != 0)
+        fprintf(stderr, "WARNING: ImageDataDeserializer: cannot pin a thread to CPU %d: %s.\n", cpu, strerror(errno));
+    else if (m_verbosity > 0)
+        fprintf(stderr, "ImageDataDeserializer: pinned a decoding thread to CPU %d.\n", cpu);
+#endif
 }
 
 // Descriptions of chunks exposed by the image reader.
 ChunkDescriptions ImageDataDeserializer::GetChunkDescriptions()
 {
     ChunkDescriptions result;
-    result.reserve(m_imageSequences.size());
-    for (auto const& s : m_imageSequences)
+    result.reserve(m_imageSequences.size() / m_numberOfViews);
+    for (size_t i = 0; i < m_imageSequences.size(); i += m_numberOfViews)
     {
         auto chunk = std::make_shared<ChunkDescription>();
-        chunk->m_id = s.m_chunkId;
-        chunk->m_numberOfSamples = 1;
-        chunk->m_numberOfSequences = 1;
+        chunk->m_id = m_imageSequences[i].m_chunkId;
+        chunk->m_numberOfSamples = m_numberOfViews;
+        chunk->m_numberOfSequences = m_numberOfViews;
         result.push_back(chunk);
     }
 
@@ -239,8 +323,9 @@ ChunkDescriptions ImageDataDeserializer::GetChunkDescriptions()
 
 void ImageDataDeserializer::GetSequencesForChunk(ChunkIdType chunkId, std::vector<SequenceDescription>& result)
 {
-    // Currently a single sequence per chunk.
-    result.push_back(m_imageSequences[chunkId]);
+    // A single sequence per chunk, or one per view of the image.
+    for (size_t i = chunkId * m_numberOfViews; i < (chunkId + 1) * m_numberOfViews; i++)
+        result.push_back(m_imageSequences[i]);
 }
 
 void ImageDataDeserializer::CreateSequenceDescriptions(CorpusDescriptorPtr corpus, std::string mapPath, size_t labelDimension, bool isMultiCrop)
@@ -255,7 +340,7 @@ void ImageDataDeserializer::CreateSequenceDescriptions(CorpusDescriptorPtr corpu
     auto mapFileDirectory = ExtractDirectory(mapPath);
     m_defaultReader = make_unique<FileByteReader>(mapFileDirectory);
 
-    size_t itemsPerLine = isMultiCrop ? 10 : 1;
+    m_numberOfViews = isMultiCrop ? 10 : 1;
     size_t curId = 0;
     std::string line;
     PathReaderMap knownReaders;
@@ -302,15 +387,15 @@ void ImageDataDeserializer::CreateSequenceDescriptions(CorpusDescriptorPtr corpu
                 imagePath.c_str(), cid, labelDimension, lineIndex, mapPath.c_str());
         }
 
-        if (CHUNKID_MAX < curId + itemsPerLine)
+        if (CHUNKID_MAX < curId / m_numberOfViews + 1)
         {
             RuntimeError("Maximum number of chunks exceeded.");
         }
 
-        for (size_t start = curId; curId < start + itemsPerLine; curId++)
+        for (size_t start = curId; curId < start + m_numberOfViews; curId++)
         {
             description.m_id = curId;
-            description.m_chunkId = (ChunkIdType)curId;
+            description.m_chunkId = (ChunkIdType)(start / m_numberOfViews);
             description.m_path = imagePath;
             description.m_classId = cid;
             description.m_key.m_sequence = corpus->KeyToId(sequenceKey);
@@ -336,8 +421,7 @@ void ImageDataDeserializer::CreateSequenceDescriptions(CorpusDescriptorPtr corpu
 
 ChunkPtr ImageDataDeserializer::GetChunk(ChunkIdType chunkId)
 {
-    auto sequenceDescription = m_imageSequences[chunkId];
-    return std::make_shared<ImageChunk>(sequenceDescription, *this);
+    return std::make_shared<ImageChunk>(chunkId * m_numberOfViews, m_numberOfViews, *this);
 }
 
 void ImageDataDeserializer::RegisterByteReader(size_t seqId, const std::string& seqPath, PathReaderMap& knownReaders, ReaderSequenceMap& readerSequences, const std::string& expandDirectory)
@@ -363,7 +447,7 @@ void ImageDataDeserializer::RegisterByteReader(size_t seqId, const std::string&
     auto r = knownReaders.find(containerPath);
     if (r == knownReaders.end())
     {
-        reader = std::make_shared<ZipByteReader>(containerPath);
+        reader = std::make_shared<ZipByteReader>(containerPath, m_zipMemoryMap);
         knownReaders[containerPath] = reader;
         readerSequences[containerPath] = std::map<std::string, size_t>();
     }
@@ -388,16 +472,109 @@ cv::Mat ImageDataDeserializer::ReadImage(size_t seqId, const std::string& path,
 
     ImageDataDeserializer::SeqReaderMap::const_iterator r;
     if (m_readers.empty() || (r = m_readers.find(seqId)) == m_readers.end())
-        return m_defaultReader->Read(seqId, path, grayscale);
-    return (*r).second->Read(seqId, path, grayscale);
+        return m_defaultReader->Read(seqId, path, grayscale, m_minDecodedSide);
+    return (*r).second->Read(seqId, path, grayscale, m_minDecodedSide);
 }
 
-cv::Mat FileByteReader::Read(size_t, const std::string& seqPath, bool grayscale)
+void ImageDataDeserializer::SetMinDecodedSide(size_t minDecodedSide)
+{
+#ifndef CNTK_REDUCED_IMAGE_DECODE
+    if (minDecodedSide > 0)
+        fprintf(stderr, "WARNING: ImageDataDeserializer: decoding images at a reduced size requires OpenCV 3.1 or later, images are decoded at full size.\n");
+#endif
+    m_minDecodedSide = minDecodedSide;
+}
+
+cv::Mat FileByteReader::Read(size_t, const std::string& seqPath, bool grayscale, size_t minDecodedSide)
 {
     assert(!seqPath.empty());
     auto path = Expand3Dots(seqPath, m_expandDirectory);
 
-    return cv::imread(path, grayscale ? cv::IMREAD_GRAYSCALE : cv::IMREAD_COLOR);
+    if (minDecodedSide == 0)
+        return cv::imread(path, grayscale ? cv::IMREAD_GRAYSCALE : cv::IMREAD_COLOR);
+
+    // The size of the image is needed before decoding it, so the file is read here instead of by OpenCV.
+    std::vector<unsigned char> contents;
+    FILE* file = fopen(path.c_str(), "rb");
+    if (!file)
+        return cv::Mat();
+    unsigned char buffer[65536];
+    size_t count;
+    while ((count = fread(buffer, 1, sizeof(buffer), file)) > 0)
+        contents.insert(contents.end(), buffer, buffer + count);
+    fclose(file);
+
+    return DecodeImage(contents.data(), contents.size(), grayscale, minDecodedSide);
+}
+
+bool GetJpegSize(const unsigned char* data, size_t size, size_t& width, size_t& height)
+{
+    if (size < 4 || data[0] != 0xFF || data[1] != 0xD8)
+        return false;
+
+    // Walks the marker segments up to the start of frame, which holds the dimensions.
+    size_t position = 2;
+    while (position + 4 <= size)
+    {
+        if (data[position] != 0xFF)
+            return false;
+        unsigned char marker = data[position + 1];
+        if (marker == 0xFF) // fill byte
+        {
+            position++;
+            continue;
+        }
+
+        if (marker == 0x01 || (marker >= 0xD0 && marker <= 0xD7)) // no segment
+        {
+            position += 2;
+            continue;
+        }
+
+        size_t length = ((size_t)data[position + 2] << 8) | data[position + 3];
+        bool isStartOfFrame = marker >= 0xC0 && marker <= 0xCF && marker != 0xC4 && marker != 0xC8 && marker != 0xCC;
+        if (isStartOfFrame)
+        {
+            if (length < 7 || position + 9 > size)
+                return false;
+            height = ((size_t)data[position + 5] << 8) | data[position + 6];
+            width = ((size_t)data[position + 7] << 8) | data[position + 8];
+            return width > 0 && height > 0;
+        }
+
+        if (marker == 0xD9 || marker == 0xDA || length < 2) // end of image or scan before a frame
+            return false;
+        position += 2 + length;
+    }
+
+    return false;
+}
+
+cv::Mat DecodeImage(const unsigned char* data, size_t size, bool grayscale, size_t minDecodedSide)
+{
+    if (size == 0)
+        return cv::Mat();
+
+    int flags = grayscale ? cv::IMREAD_GRAYSCALE : cv::IMREAD_COLOR;
+#ifdef CNTK_REDUCED_IMAGE_DECODE
+    size_t width, height;
+    if (minDecodedSide > 0 && GetJpegSize(data, size, width, height))
+    {
+        size_t shorterSide = std::min(width, height);
+        if (shorterSide / 8 >= minDecodedSide)
+            flags = grayscale ? cv::IMREAD_REDUCED_GRAYSCALE_8 : cv::IMREAD_REDUCED_COLOR_8;
+        else if (shorterSide / 4 >= minDecodedSide)
+            flags = grayscale ? cv::IMREAD_REDUCED_GRAYSCALE_4 : cv::IMREAD_REDUCED_COLOR_4;
+        else if (shorterSide / 2 >= minDecodedSide)
+            flags = grayscale ? cv::IMREAD_REDUCED_GRAYSCALE_2 : cv::IMREAD_REDUCED_COLOR_2;
+    }
+#else
+    UNUSED(minDecodedSide);
+#endif
+
+    // The buffer is only read.
+    cv::Mat encoded(1, (int)size, CV_8UC1, const_cast<unsigned char*>(data));
+    return cv::imdecode(encoded, flags);
 }
 
 bool ImageDataDeserializer::GetSequenceDescriptionByKey(const KeyType& key, SequenceDescription& result)
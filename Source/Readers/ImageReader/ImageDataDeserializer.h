@@ -8,11 +8,14 @@
 #include "DataDeserializerBase.h"
 #include "Config.h"
 #include "ByteReader.h"
+#include <atomic>
 #include <unordered_map>
 #include "CorpusDescriptor.h"
 
 namespace Microsoft { namespace MSR { namespace CNTK {
 
+class DecodedImageCache;
+
 // Image data deserializer based on the OpenCV library.
 // The deserializer currently supports two output streams only: a feature and a label stream.
 // All sequences consist only of a single sample (image/label).
@@ -40,6 +43,16 @@ public:
     // Gets sequence description by key.
     bool GetSequenceDescriptionByKey(const KeyType&, SequenceDescription&) override;
 
+    // Lets JPEG images be decoded at a reduced size as long as their shorter side stays at least 'minDecodedSide',
+    // e.g. when they are cropped and scaled down afterwards anyway. 0 (the default) decodes them at full size.
+    void SetMinDecodedSide(size_t minDecodedSide);
+
+    // Lets the images be transformed by the transforms of 'cache' right after decoding, and kept by it for later epochs.
+    void SetDecodedImageCache(std::shared_ptr<DecodedImageCache> cache)
+    {
+        m_decodedImageCache = cache;
+    }
+
     // A helper class for generation of type specific labels (currently float/double only).
     class LabelGenerator;
     typedef std::shared_ptr<LabelGenerator> LabelGeneratorPtr;
@@ -62,6 +75,10 @@ private:
     // Sequence descriptions for all input data.
     std::vector<ImageSequenceDescription> m_imageSequences;
 
+    // Sequences per image: 10 with multi-view crops, where the sequences of the views of an image form one chunk,
+    // so that the image is decoded once for all of them.
+    size_t m_numberOfViews = 1;
+
     // Mapping of logical sequence key into sequence description.
     std::map<size_t, size_t> m_keyToSequence;
 
@@ -83,6 +100,21 @@ private:
 
     std::unique_ptr<FileByteReader> m_defaultReader;
     int m_verbosity;
+    size_t m_minDecodedSide = 0;
+    std::shared_ptr<DecodedImageCache> m_decodedImageCache;
+
+    // Whether zip containers are memory mapped instead of being read through libzip, see ZipByteReader.
+    bool m_zipMemoryMap = false;
+
+    void InitializeThreadPinning(bool pinCpuThreads);
+
+    // Pins the calling thread to the next CPU of the process if m_pinCpuThreads is set, once per thread.
+    // Restricting the process to the CPUs of a NUMA node (numactl, mpirun --bind-to) keeps the threads on it.
+    void PinCurrentThread();
+
+    bool m_pinCpuThreads;
+    std::vector<int> m_cpus; // the process may run on
+    std::atomic<size_t> m_numPinnedThreads;
 };
 
 }}}
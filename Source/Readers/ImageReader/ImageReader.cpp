@@ -10,9 +10,11 @@
 #include "ImageTransformers.h"
 #include "BlockRandomizer.h"
 #include "NoRandomizer.h"
+#include "SharedChunkCache.h"
 #include "ImageDataDeserializer.h"
 #include "FramePacker.h"
-#include <omp.h>
+#include "CPUThreadPool.h"
+#include <cmath>
 #include "TransformController.h"
 
 namespace Microsoft { namespace MSR { namespace CNTK {
@@ -32,13 +34,45 @@ ImageReader::ImageReader(const ConfigParameters& config)
     m_streams = configHelper.GetStreams();
     assert(m_streams.size() == 2);
 
-    int threadCount = configHelper.GetCpuThreadCount();
-    if (threadCount > 0)
+    m_threadCount = configHelper.GetCpuThreadCount();
+    if (m_threadCount > 0)
     {
-        omp_set_num_threads(threadCount);
+        CPUThreadPool::SetThreadParallelism(m_threadCount);
     }
 
-    auto deserializer = std::make_shared<ImageDataDeserializer>(config);
+    std::wstring featureName = m_streams[configHelper.GetFeatureStreamId()]->m_name;
+    ConfigParameters featureStream = config(featureName);
+    auto crop = std::make_shared<CropTransformer>(featureStream);
+    auto scale = std::make_shared<ScaleTransformer>(featureStream);
+
+    auto imageDeserializer = std::make_shared<ImageDataDeserializer>(config);
+
+    // Images are cropped and then scaled to the size of the network. Large JPEG images can be decoded at a reduced size
+    // instead, as long as the smallest possible crop is still not smaller than the target size.
+    if (config(L"decodeAtReducedSize", false))
+        imageDeserializer->SetMinDecodedSide((size_t)std::ceil(scale->GetMaxTargetSide() / crop->GetMinCropFraction()));
+
+    // If the images are cropped the same way in every epoch, the cropped and scaled images can be kept in memory,
+    // up to the given number of megabytes, so that later epochs do not decode them again.
+    std::shared_ptr<DecodedImageCache> decodedImageCache;
+    size_t decodedImageCacheMB = config(L"decodedImageCacheMB", (size_t)0);
+    if (decodedImageCacheMB > 0)
+    {
+        if (crop->IsDeterministic())
+        {
+            decodedImageCache = std::make_shared<DecodedImageCache>(std::vector<TransformerPtr>{ crop, scale }, decodedImageCacheMB, config(L"verbosity", 0));
+            imageDeserializer->SetDecodedImageCache(decodedImageCache);
+        }
+        else
+            fprintf(stderr, "WARNING: ImageReader: decodedImageCacheMB is ignored, as the images are cropped or flipped at random.\n");
+    }
+
+    IDataDeserializerPtr deserializer = imageDeserializer;
+
+    // Processes on the same node that use the same name share the decoded images, e.g. the ranks of a multi-GPU job.
+    std::wstring sharedChunkCacheName = config(L"sharedChunkCacheName", L"");
+    if (!sharedChunkCacheName.empty())
+        deserializer = std::make_shared<SharedChunkCache>(deserializer, sharedChunkCacheName);
 
     SequenceEnumeratorPtr randomizer;
     // Request multi-threaded randomizer operation to speed up CPU-intensive image-decoding and transformations.
@@ -57,24 +91,47 @@ ImageReader::ImageReader(const ConfigParameters& config)
     }
 
     // Create transformations for a single feature stream.
-    std::wstring featureName = m_streams[configHelper.GetFeatureStreamId()]->m_name;
-    ConfigParameters featureStream = config(featureName);
-
     std::vector<Transformation> transformations;
-    transformations.push_back(Transformation{ std::make_shared<CropTransformer>(featureStream), featureName });
-    transformations.push_back(Transformation{ std::make_shared<ScaleTransformer>(featureStream), featureName });
-    transformations.push_back(Transformation{ std::make_shared<ColorTransformer>(featureStream), featureName });
-    transformations.push_back(Transformation{ std::make_shared<IntensityTransformer>(featureStream), featureName });
-    transformations.push_back(Transformation{ std::make_shared<MeanTransformer>(featureStream), featureName });
+    if (decodedImageCache)
+    {
+        transformations.push_back(Transformation{ decodedImageCache, featureName });
+    }
+    else
+    {
+        transformations.push_back(Transformation{ crop, featureName });
+        transformations.push_back(Transformation{ scale, featureName });
+    }
 
-    if (configHelper.GetDataFormat() == CHW)
+    auto color = std::make_shared<ColorTransformer>(featureStream);
+    auto intensity = std::make_shared<IntensityTransformer>(featureStream);
+    auto mean = std::make_shared<MeanTransformer>(featureStream);
+
+    // The per pixel work after the scaling can be left to the device of the input, where the images go as bytes.
+    if (config(L"deviceAugmentation", false))
     {
-        transformations.push_back(Transformation{ std::make_shared<TransposeTransformer>(featureStream), featureName });
+        auto device = std::make_shared<DeviceAugmentationTransformer>(featureStream, configHelper.GetDataFormat(), color, intensity, mean);
+        transformations.push_back(Transformation{ device, featureName });
+
+        auto features = m_streams[configHelper.GetFeatureStreamId()];
+        features->m_elementType = ElementType::tuchar;
+        features->m_sampleLayout = std::make_shared<TensorShape>(device->GetPackedSampleSize());
+        features->m_deviceTransform = device;
     }
+    else
+    {
+        transformations.push_back(Transformation{ color, featureName });
+        transformations.push_back(Transformation{ intensity, featureName });
+        transformations.push_back(Transformation{ mean, featureName });
+
+        if (configHelper.GetDataFormat() == CHW)
+        {
+            transformations.push_back(Transformation{ std::make_shared<TransposeTransformer>(featureStream), featureName });
+        }
 
-    // We should always have cast at the end. 
-    // It is noop if the matrix element type is already expected by the packer.
-    transformations.push_back(Transformation{ std::make_shared<CastTransformer>(featureStream), featureName });
+        // We should always have cast at the end.
+        // It is noop if the matrix element type is already expected by the packer.
+        transformations.push_back(Transformation{ std::make_shared<CastTransformer>(featureStream), featureName });
+    }
 
     m_sequenceEnumerator = std::make_shared<TransformController>(transformations, randomizer);
     bool useLocalTimeline = true;
@@ -90,4 +147,15 @@ std::vector<StreamDescriptionPtr> ImageReader::GetStreamDescriptions()
     return m_streams;
 }
 
+Minibatch ImageReader::ReadMinibatch()
+{
+    // Minibatches are usually read on the prefetch thread of the ReaderShim, and the limit is per thread.
+    if (m_threadCount > 0)
+    {
+        CPUThreadPool::SetThreadParallelism(m_threadCount);
+    }
+
+    return ReaderBase::ReadMinibatch();
+}
+
 } } }
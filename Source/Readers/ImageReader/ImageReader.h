@@ -21,12 +21,18 @@ public:
     // Description of streams that this reader provides.
     std::vector<StreamDescriptionPtr> GetStreamDescriptions() override;
 
+    // Reads a single minibatch.
+    Minibatch ReadMinibatch() override;
+
 private:
     // All streams this reader provides.
     std::vector<StreamDescriptionPtr> m_streams;
 
     // Seed for the random generator.
     unsigned int m_seed;
+
+    // Number of threads decoding and transforming images, 0 for the OpenMP default.
+    int m_threadCount;
 };
 
 }}}
@@ -19,14 +19,54 @@
 namespace Microsoft { namespace MSR { namespace CNTK 
 {
 
+// Gets the image of a sequence. Images that do not come from the ImageDataDeserializer directly (e.g. the read-only
+// images of a SharedChunkCache) are copied into an OpenCV image in HWC layout, as the transforms change it in place.
+static std::shared_ptr<ImageSequenceData> ToImageSequence(const SequenceDataPtr& sequence)
+{
+    auto image = std::dynamic_pointer_cast<ImageSequenceData>(sequence);
+    if (image)
+        return image;
+
+    const auto& layout = sequence->m_sampleLayout;
+    if (!layout || layout->GetRank() != 3 || sequence->m_numberOfSamples != 1 || !dynamic_cast<DenseSequenceData*>(sequence.get()))
+        return nullptr;
+
+    int depth;
+    switch (sequence->m_elementType)
+    {
+    case ElementType::tuchar:
+        depth = CV_8U;
+        break;
+    case ElementType::tfloat:
+        depth = CV_32F;
+        break;
+    case ElementType::tdouble:
+        depth = CV_64F;
+        break;
+    default:
+        return nullptr;
+    }
+
+    // HWC tensor shapes are channels x width x height.
+    cv::Mat view((int)layout->GetDim(2), (int)layout->GetDim(1), CV_MAKETYPE(depth, (int)layout->GetDim(0)),
+                 const_cast<void*>(sequence->GetDataBuffer()));
+    image = MakeSequenceData<ImageSequenceData>();
+    image->m_image = view.clone();
+    image->m_id = sequence->m_id;
+    image->m_numberOfSamples = sequence->m_numberOfSamples;
+    image->m_elementType = sequence->m_elementType;
+    image->m_sampleLayout = layout;
+    return image;
+}
+
 // Transforms a single sequence as open cv dense image. Called once per sequence.
 SequenceDataPtr ImageTransformerBase::Transform(SequenceDataPtr sequence)
 {
-    auto inputSequence = dynamic_cast<ImageSequenceData*>(sequence.get());
+    auto inputSequence = ToImageSequence(sequence);
     if (inputSequence == nullptr)
         RuntimeError("Unexpected sequence provided");
 
-    auto result = std::make_shared<ImageSequenceData>();
+    auto result = MakeSequenceData<ImageSequenceData>();
     Apply(sequence->m_id, inputSequence->m_image);
 
     result->m_image = inputSequence->m_image;
@@ -75,6 +115,29 @@ CropTransformer::CropTransformer(const ConfigParameters& config) : ImageTransfor
     m_aspectRatioRadius = config(L"aspectRatioRadius", ConfigParameters::Array(doubleargvector(vector<double>{0.0})));
 }
 
+double CropTransformer::GetMinCropFraction() const
+{
+    // An aspect ratio change by a factor of up to 1 + radius shrinks one side of the crop by up to its square root.
+    double maxRadius = 0;
+    for (double radius : m_aspectRatioRadius)
+        maxRadius = std::max(maxRadius, radius);
+    return m_cropRatioMin / std::sqrt(1.0 + maxRadius);
+}
+
+bool CropTransformer::IsDeterministic() const
+{
+    if (m_cropType == CropType::Random || m_hFlip)
+        return false;
+    if (m_jitterType != RatioJitterType::None && m_cropRatioMin != m_cropRatioMax)
+        return false;
+    for (double radius : m_aspectRatioRadius)
+    {
+        if (radius != 0)
+            return false;
+    }
+    return true;
+}
+
 void CropTransformer::StartEpoch(const EpochConfiguration &config)
 {
     m_curAspectRatioRadius = m_aspectRatioRadius[config.m_epochIndex];
@@ -85,8 +148,8 @@ void CropTransformer::StartEpoch(const EpochConfiguration &config)
 
 void CropTransformer::Apply(size_t id, cv::Mat &mat)
 {
-    auto seed = GetSeed();
-    auto rng = m_rngs.pop_or_create([seed]() { return std::make_unique<std::mt19937>(seed); });
+    auto rng = m_rngs.pop_or_create([]() { return std::make_unique<std::mt19937>(); });
+    rng->seed(GetSequenceSeed(id));
 
     double ratio = 1;
     switch (m_jitterType)
@@ -337,6 +400,81 @@ void ScaleTransformer::Apply(size_t id, cv::Mat &mat)
 
 //////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
 
+DecodedImageCache::DecodedImageCache(const std::vector<TransformerPtr>& transforms, size_t maxMegabytes, int verbosity)
+    : m_transforms(transforms), m_maxBytes(maxMegabytes << 20), m_verbosity(verbosity), m_bytes(0), m_hits(0), m_misses(0)
+{
+}
+
+void DecodedImageCache::StartEpoch(const EpochConfiguration& config)
+{
+    if (m_verbosity > 0 && m_hits + m_misses > 0)
+    {
+        std::lock_guard<std::mutex> lock(m_lock);
+        fprintf(stderr, "DecodedImageCache: %d of %d images of the last epoch were read from the cache, %d images (%d MB) are cached.\n",
+                (int)m_hits, (int)(m_hits + m_misses), (int)m_images.size(), (int)(m_bytes >> 20));
+    }
+    m_hits = 0;
+    m_misses = 0;
+
+    for (auto& transform : m_transforms)
+        transform->StartEpoch(config);
+}
+
+StreamDescription DecodedImageCache::Transform(const StreamDescription& inputStream)
+{
+    StreamDescription stream = inputStream;
+    for (auto& transform : m_transforms)
+        stream = transform->Transform(stream);
+    return stream;
+}
+
+bool DecodedImageCache::TryGet(size_t id, cv::Mat& image)
+{
+    {
+        std::lock_guard<std::mutex> lock(m_lock);
+        auto cached = m_images.find(id);
+        if (cached != m_images.end())
+            image = cached->second;
+    }
+
+    if (!image.data)
+    {
+        m_misses++;
+        return false;
+    }
+
+    // The transforms that follow change the image in place.
+    image = image.clone();
+    m_hits++;
+    return true;
+}
+
+void DecodedImageCache::TransformAndAdd(size_t id, cv::Mat& image)
+{
+    auto sequence = MakeSequenceData<ImageSequenceData>();
+    sequence->m_image = image;
+    sequence->m_id = id;
+    sequence->m_numberOfSamples = 1;
+    sequence->m_elementType = GetElementTypeFromOpenCVType(image.depth());
+    sequence->m_sampleLayout = std::make_shared<TensorShape>(ImageDimensions(image.cols, image.rows, image.channels()).AsTensorShape(HWC));
+
+    SequenceDataPtr result = sequence;
+    for (auto& transform : m_transforms)
+        result = transform->Transform(result);
+    image = std::static_pointer_cast<ImageSequenceData>(result)->m_image;
+
+    if (image.depth() != CV_8U)
+        return;
+
+    size_t bytes = image.total() * image.elemSize();
+    std::lock_guard<std::mutex> lock(m_lock);
+    if (m_bytes + bytes <= m_maxBytes && m_images.find(id) == m_images.end())
+    {
+        m_images[id] = image.clone();
+        m_bytes += bytes;
+    }
+}
+
 MeanTransformer::MeanTransformer(const ConfigParameters& config) : ImageTransformerBase(config)
 {
     std::wstring meanFile = config(L"meanFile", L"");
@@ -404,7 +542,8 @@ StreamDescription TransposeTransformer::Transform(const StreamDescription& input
 // Transformation of the sequence.
 SequenceDataPtr TransposeTransformer::Transform(SequenceDataPtr sequence)
 {
-    auto inputSequence = dynamic_cast<ImageSequenceData*>(sequence.get());
+    auto image = ToImageSequence(sequence);
+    auto inputSequence = image.get();
     if (inputSequence == nullptr)
         RuntimeError("Currently Transpose transform only works with images.");
 
@@ -532,9 +671,7 @@ void IntensityTransformer::StartEpoch(const EpochConfiguration &config)
 
 void IntensityTransformer::Apply(size_t id, cv::Mat &mat)
 {
-    UNUSED(id);
-
-    if (m_eigVal.empty() || m_eigVec.empty() || m_curStdDev == 0)
+    if (!IsEnabled())
         return;
 
     // Have to convert to float.
@@ -543,18 +680,17 @@ void IntensityTransformer::Apply(size_t id, cv::Mat &mat)
         mat.convertTo(mat, type);
 
     if (mat.type() == CV_64FC(mat.channels()))
-        Apply<double>(mat);
+        Apply<double>(id, mat);
     else if (mat.type() == CV_32FC(mat.channels()))
-        Apply<float>(mat);
+        Apply<float>(id, mat);
     else
         RuntimeError("Unsupported type");
 }
 
-template <typename ElemType>
-void IntensityTransformer::Apply(cv::Mat &mat)
+cv::Mat IntensityTransformer::GetShifts(size_t id)
 {
-    auto seed = GetSeed();
-    auto rng = m_rngs.pop_or_create([seed]() { return std::make_unique<std::mt19937>(seed); } );
+    auto rng = m_rngs.pop_or_create([]() { return std::make_unique<std::mt19937>(); });
+    rng->seed(GetSequenceSeed(id));
 
     // Using single precision as EigVal and EigVec matrices are single precision.
     boost::random::normal_distribution<float> d(0, (float)m_curStdDev);
@@ -566,8 +702,13 @@ void IntensityTransformer::Apply(cv::Mat &mat)
     m_rngs.push(std::move(rng));
 
     assert(m_eigVec.rows == 3 && m_eigVec.cols == 3);
+    return m_eigVec * alphas.t();
+}
 
-    cv::Mat shifts = m_eigVec * alphas.t();
+template <typename ElemType>
+void IntensityTransformer::Apply(size_t id, cv::Mat &mat)
+{
+    cv::Mat shifts = GetShifts(id);
 
     // For multi-channel images data is in BGR format.
     size_t cdst = mat.rows * mat.cols * mat.channels();
@@ -611,27 +752,49 @@ void ColorTransformer::StartEpoch(const EpochConfiguration &config)
 
 void ColorTransformer::Apply(size_t id, cv::Mat &mat)
 {
-    UNUSED(id);
-
-    if (m_curBrightnessRadius == 0 && m_curContrastRadius == 0 && m_curSaturationRadius == 0)
+    if (!IsEnabled())
         return;
 
     // Have to convert to float
     ConvertToFloatingPointIfRequired(mat);
 
     if (mat.type() == CV_64FC(mat.channels()))
-        Apply<double>(mat);
+        Apply<double>(id, mat);
     else if (mat.type() == CV_32FC(mat.channels()))
-        Apply<float>(mat);
+        Apply<float>(id, mat);
     else
         RuntimeError("Unsupported type");
 }
 
+ColorTransformer::Jitter ColorTransformer::GetJitter(size_t id, int channels)
+{
+    Jitter jitter = { 0, 1, 1 };
+    if (!IsEnabled())
+        return jitter;
+
+    auto rng = m_rngs.pop_or_create([]() { return std::make_unique<std::mt19937>(); });
+    rng->seed(GetSequenceSeed(id));
+
+    if (m_curBrightnessRadius > 0)
+        jitter.m_brightness = UniRealT(-m_curBrightnessRadius, m_curBrightnessRadius)(*rng);
+
+    if (m_curContrastRadius > 0)
+        jitter.m_contrast = 1 + UniRealT(-m_curContrastRadius, m_curContrastRadius)(*rng);
+
+    if (m_curSaturationRadius > 0 && channels == 3)
+    {
+        jitter.m_saturation = 1.0 + UniRealT(-m_curSaturationRadius, m_curSaturationRadius)(*rng);
+        assert(0 <= jitter.m_saturation && jitter.m_saturation <= 2);
+    }
+
+    m_rngs.push(std::move(rng));
+    return jitter;
+}
+
 template <typename ElemType>
-void ColorTransformer::Apply(cv::Mat &mat)
+void ColorTransformer::Apply(size_t id, cv::Mat &mat)
 {
-    auto seed = GetSeed();
-    auto rng = m_rngs.pop_or_create([seed]() { return std::make_unique<std::mt19937>(seed); });
+    Jitter jitter = GetJitter(id, mat.channels());
 
     if (m_curBrightnessRadius > 0 || m_curContrastRadius > 0)
     {
@@ -641,19 +804,13 @@ void ColorTransformer::Apply(cv::Mat &mat)
         ElemType beta = 0;
         if (m_curBrightnessRadius > 0)
         {
-            UniRealT d(-m_curBrightnessRadius, m_curBrightnessRadius);
             // Compute mean value of the image.
             cv::Scalar imgMean = cv::sum(cv::sum(mat));
             // Compute beta as a fraction of the mean.
-            beta = (ElemType)(d(*rng) * imgMean[0] / (mat.rows * mat.cols * mat.channels()));
+            beta = (ElemType)(jitter.m_brightness * imgMean[0] / (mat.rows * mat.cols * mat.channels()));
         }
 
-        ElemType alpha = 1;
-        if (m_curContrastRadius > 0)
-        {
-            UniRealT d(-m_curContrastRadius, m_curContrastRadius);
-            alpha = (ElemType)(1 + d(*rng));
-        }
+        ElemType alpha = (ElemType)jitter.m_contrast;
 
         // Could potentially use mat.convertTo(mat, -1, alpha, beta) 
         // but it does not do range checking for single/double precision matrix. saturate_cast won't work either.
@@ -667,9 +824,7 @@ void ColorTransformer::Apply(cv::Mat &mat)
 
     if (m_curSaturationRadius > 0 && mat.channels() == 3)
     {
-        UniRealT d(-m_curSaturationRadius, m_curSaturationRadius);
-        double ratio = 1.0 + d(*rng);
-        assert(0 <= ratio && ratio <= 2);
+        double ratio = jitter.m_saturation;
 
         auto hsv = m_hsvTemp.pop_or_create([]() { return std::make_unique<cv::Mat>(); });
 
@@ -688,8 +843,6 @@ void ColorTransformer::Apply(cv::Mat &mat)
 
         m_hsvTemp.push(std::move(hsv));
     }
-
-    m_rngs.push(std::move(rng));
 }
 
 CastTransformer::CastTransformer(const ConfigParameters& config) : TransformBase(config), m_floatTransform(this), m_doubleTransform(this)
@@ -769,4 +922,138 @@ SequenceDataPtr CastTransformer::TypedCast<TElementTo>::Apply(SequenceDataPtr se
     return result;
 }
 
+//////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+DeviceAugmentationTransformer::DeviceAugmentationTransformer(const ConfigParameters& config, ImageLayoutKind layout,
+                                                             std::shared_ptr<ColorTransformer> color,
+                                                             std::shared_ptr<IntensityTransformer> intensity,
+                                                             std::shared_ptr<MeanTransformer> mean)
+    : TransformBase(config), m_layout(layout), m_color(color), m_intensity(intensity), m_mean(mean)
+{
+    m_width = config(L"width");
+    m_height = config(L"height");
+    m_channels = config(L"channels");
+    if (m_channels != 1 && m_channels != 3)
+        InvalidArgument("deviceAugmentation supports images with 1 or 3 channels only.");
+    m_imageSize = m_width * m_height * m_channels;
+}
+
+void DeviceAugmentationTransformer::StartEpoch(const EpochConfiguration &config)
+{
+    // The replaced transforms draw the parameters, so they need the settings of the epoch.
+    static_cast<Transformer&>(*m_color).StartEpoch(config);
+    static_cast<Transformer&>(*m_intensity).StartEpoch(config);
+    static_cast<Transformer&>(*m_mean).StartEpoch(config);
+    TransformBase::StartEpoch(config);
+}
+
+StreamDescription DeviceAugmentationTransformer::Transform(const StreamDescription& inputStream)
+{
+    m_outputStream = TransformBase::Transform(inputStream);
+    m_outputStream.m_elementType = ElementType::tuchar;
+    m_outputStream.m_sampleLayout = std::make_shared<TensorShape>(GetPackedSampleSize());
+    return m_outputStream;
+}
+
+SequenceDataPtr DeviceAugmentationTransformer::Transform(SequenceDataPtr sequence)
+{
+    auto image = ToImageSequence(sequence);
+    if (image == nullptr)
+        RuntimeError("Unexpected sequence provided");
+
+    const cv::Mat& mat = image->m_image;
+    if (mat.depth() != CV_8U || mat.cols != (int)m_width || mat.rows != (int)m_height || mat.channels() != (int)m_channels)
+        RuntimeError("deviceAugmentation requires 8 bit images of %dx%dx%d after scaling.", (int)m_width, (int)m_height, (int)m_channels);
+
+    auto result = std::make_shared<DenseSequenceWithBuffer<unsigned char>>(m_memBuffers, GetPackedSampleSize());
+    auto dst = result->GetBuffer();
+    memcpy(dst, image->GetDataBuffer(), m_imageSize);
+
+    // The parameters of the color and intensity changes, in the order of Matrix::AssignAugmentedImages().
+    std::vector<float> parameters(GetNumParameters(), 0.0f);
+    ColorTransformer::Jitter jitter = m_color->GetJitter(sequence->m_id, (int)m_channels);
+    parameters[0] = (float)jitter.m_contrast;
+    parameters[1] = (float)jitter.m_brightness;
+    parameters[2] = (float)jitter.m_saturation;
+    if (m_intensity->IsEnabled())
+    {
+        // For multi-channel images data is in BGR format.
+        cv::Mat shifts = m_intensity->GetShifts(sequence->m_id);
+        for (size_t c = 0; c < m_channels; c++)
+            parameters[3 + c] = shifts.at<float>((int)(m_channels - c - 1));
+    }
+    memcpy(dst + m_imageSize, parameters.data(), parameters.size() * sizeof(float));
+
+    result->m_sampleLayout = m_outputStream.m_sampleLayout;
+    result->m_numberOfSamples = 1;
+    result->m_elementType = ElementType::tuchar;
+    result->m_id = sequence->m_id;
+    return result;
+}
+
+void DeviceAugmentationTransformer::Apply(const StreamMinibatch& stream, Matrix<float>& result, DataTransferer* transferer)
+{
+    Apply(stream, result, transferer, m_floatBuffers);
+}
+
+void DeviceAugmentationTransformer::Apply(const StreamMinibatch& stream, Matrix<double>& result, DataTransferer* transferer)
+{
+    Apply(stream, result, transferer, m_doubleBuffers);
+}
+
+template <class ElemType>
+void DeviceAugmentationTransformer::Apply(const StreamMinibatch& stream, Matrix<ElemType>& result, DataTransferer* transferer, DeviceBuffers<ElemType>& buffers)
+{
+    size_t numImages = stream.m_layout->GetNumCols();
+    size_t sampleSize = GetPackedSampleSize();
+    size_t numParameters = GetNumParameters();
+    DEVICEID_TYPE deviceId = result.GetDeviceId();
+
+    // Each prefetch slot has its own buffers, since the copy into them only waits for the compute of the same slot.
+    auto& slot = buffers.m_slots[transferer];
+    if (!slot.first)
+    {
+        slot.first = std::make_shared<Matrix<char>>(0, 0, deviceId, DENSE, matrixFormatDense);
+        slot.second = std::make_shared<Matrix<ElemType>>(deviceId);
+    }
+
+    auto& mean = buffers.m_means[deviceId];
+    if (!mean)
+    {
+        mean = std::make_shared<Matrix<ElemType>>(deviceId);
+        // As in the MeanTransformer, a mean image of a different size is ignored.
+        cv::Mat meanImage = m_mean->GetMeanImage();
+        if (meanImage.cols == (int)m_width && meanImage.rows == (int)m_height && meanImage.channels() == (int)m_channels)
+        {
+            meanImage.convertTo(meanImage, sizeof(ElemType) == sizeof(float) ? CV_32F : CV_64F);
+            if (!meanImage.isContinuous())
+                meanImage = meanImage.clone();
+            mean->SetValue(m_imageSize, 1, deviceId, reinterpret_cast<ElemType*>(meanImage.data));
+        }
+    }
+
+    // The parameters follow the pixels of each image.
+    auto data = static_cast<char*>(stream.m_data);
+    buffers.m_hostParameters.resize(numParameters * numImages);
+    std::vector<float> parameters(numParameters);
+    for (size_t i = 0; i < numImages; i++)
+    {
+        memcpy(parameters.data(), data + i * sampleSize + m_imageSize, numParameters * sizeof(float));
+        for (size_t k = 0; k < numParameters; k++)
+            buffers.m_hostParameters[i * numParameters + k] = (ElemType)parameters[k];
+    }
+
+    slot.first->SetValue(sampleSize, numImages, deviceId, data, matrixFlagNormal, transferer);
+    slot.second->SetValue(numParameters, numImages, deviceId, buffers.m_hostParameters.data(), matrixFlagNormal, transferer);
+
+    // The kernels run on the compute stream, so the copies have to be done first.
+    if (transferer)
+    {
+        transferer->RecordCPUToGPUCopy();
+        transferer->WaitForCopyCPUToGPU();
+    }
+
+    result.AssignAugmentedImages(*slot.first, *slot.second, *mean, m_width, m_height, m_channels, m_layout == CHW);
+}
+
 }}}
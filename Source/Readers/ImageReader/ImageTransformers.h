@@ -5,6 +5,10 @@
 
 #pragma once
 
+#include <algorithm>
+#include <atomic>
+#include <map>
+#include <mutex>
 #include <unordered_map>
 #include <random>
 #include <opencv2/opencv.hpp>
@@ -82,6 +86,12 @@ class CropTransformer : public ImageTransformerBase
 public:
     explicit CropTransformer(const ConfigParameters& config);
 
+    // Lower bound of the width and height of a crop relative to the shorter side of the image, over all epochs.
+    double GetMinCropFraction() const;
+
+    // Whether an image is cropped the same way in every epoch: a center or multi-view crop of a fixed size, no flip.
+    bool IsDeterministic() const;
+
 private:
     void Apply(size_t id, cv::Mat &mat) override;
 
@@ -118,6 +128,12 @@ public:
 
     StreamDescription Transform(const StreamDescription& inputStream) override;
 
+    // The larger of the target width and height.
+    size_t GetMaxTargetSide() const
+    {
+        return std::max(m_imgWidth, m_imgHeight);
+    }
+
 private:
     enum class ScaleMode
     {
@@ -137,12 +153,58 @@ private:
     int m_padValue;
 };
 
+// Keeps the images after the transforms that are the same in every epoch, a deterministic crop and the scaling,
+// so that from the second epoch on they are neither decoded nor transformed again. The ImageDataDeserializer applies
+// these transforms itself and asks the cache first, see ImageDataDeserializer::SetDecodedImageCache(); in the list of
+// transforms the cache stands in for them and only passes on the epoch and the stream description.
+// The images are kept by sequence id: the cache belongs to one reader, whose transforms do not change.
+// Only 8 bit images are kept, up to 'maxMegabytes'. No image is evicted once that is reached: the images are
+// randomized anew in every epoch, so that any subset saves as much as another, and replacing them would only cost.
+class DecodedImageCache : public Transformer
+{
+public:
+    DecodedImageCache(const std::vector<TransformerPtr>& transforms, size_t maxMegabytes, int verbosity);
+
+    void StartEpoch(const EpochConfiguration& config) override;
+    StreamDescription Transform(const StreamDescription& inputStream) override;
+
+    // The images are transformed already when they come from the deserializer.
+    SequenceDataPtr Transform(SequenceDataPtr sequence) override
+    {
+        return sequence;
+    }
+
+    // Sets 'image' to a copy of the transformed image of the sequence 'id' if that is cached.
+    bool TryGet(size_t id, cv::Mat& image);
+
+    // Transforms the decoded 'image' of the sequence 'id' in place and keeps it if there is room.
+    void TransformAndAdd(size_t id, cv::Mat& image);
+
+private:
+    std::vector<TransformerPtr> m_transforms;
+    size_t m_maxBytes;
+    int m_verbosity;
+
+    std::mutex m_lock;
+    std::unordered_map<size_t, cv::Mat> m_images;
+    size_t m_bytes;
+
+    std::atomic<size_t> m_hits;
+    std::atomic<size_t> m_misses;
+};
+
 // Mean transformation.
 class MeanTransformer : public ImageTransformerBase
 {
 public:
     explicit MeanTransformer(const ConfigParameters& config);
 
+    // The mean image in HWC layout, empty if none is configured.
+    const cv::Mat& GetMeanImage() const
+    {
+        return m_meanImg;
+    }
+
 private:
     void Apply(size_t id, cv::Mat &mat) override;
 
@@ -192,12 +254,21 @@ class IntensityTransformer : public ImageTransformerBase
 public:
     explicit IntensityTransformer(const ConfigParameters& config);
 
+    // Whether the intensity of the images changes in the current epoch.
+    bool IsEnabled() const
+    {
+        return !m_eigVal.empty() && !m_eigVec.empty() && m_curStdDev != 0;
+    }
+
+    // The random shifts of the principal components of the sequence, in RGB order.
+    cv::Mat GetShifts(size_t id);
+
 private:
     void StartEpoch(const EpochConfiguration &config) override;
 
     void Apply(size_t id, cv::Mat &mat) override;
     template <typename ElemType>
-    void Apply(cv::Mat &mat);
+    void Apply(size_t id, cv::Mat &mat);
 
     doubleargvector m_stdDev;
     double m_curStdDev;
@@ -215,12 +286,28 @@ class ColorTransformer : public ImageTransformerBase
 public:
     explicit ColorTransformer(const ConfigParameters& config);
 
+    // The random color changes of a sequence.
+    struct Jitter
+    {
+        double m_brightness; // fraction of the mean value of the image that is added
+        double m_contrast;   // factor of the values
+        double m_saturation; // factor of the saturation, 1 keeps it
+    };
+
+    // Whether the colors of the images change in the current epoch.
+    bool IsEnabled() const
+    {
+        return m_curBrightnessRadius > 0 || m_curContrastRadius > 0 || m_curSaturationRadius > 0;
+    }
+
+    Jitter GetJitter(size_t id, int channels);
+
 private:
     void StartEpoch(const EpochConfiguration &config) override;
 
     void Apply(size_t id, cv::Mat &mat) override;
     template <typename ElemType>
-    void Apply(cv::Mat &mat);
+    void Apply(size_t id, cv::Mat &mat);
 
     doubleargvector m_brightnessRadius;
     double m_curBrightnessRadius;
@@ -268,5 +355,65 @@ private:
     TypedCast<double> m_doubleTransform;
 };
 
+// Moves the color, intensity and mean transforms over to the device, for 'deviceAugmentation = true'.
+// Instead of them, the transpose and the cast, the sequences get the random parameters of the color and intensity changes
+// appended to their 8 bit HWC image, and are packed as bytes. The packed minibatch is then converted to the network's
+// element type and layout on the device of the input in a few batched kernels, see Matrix::AssignAugmentedImages().
+// The parameters are drawn as by the replaced transforms, so that both ways apply the same changes to a sequence.
+class DeviceAugmentationTransformer : public TransformBase, public DeviceStreamTransform
+{
+public:
+    DeviceAugmentationTransformer(const ConfigParameters& config, ImageLayoutKind layout,
+                                  std::shared_ptr<ColorTransformer> color,
+                                  std::shared_ptr<IntensityTransformer> intensity,
+                                  std::shared_ptr<MeanTransformer> mean);
+
+    void StartEpoch(const EpochConfiguration &config) override;
+
+    // The samples of the stream are bytes, the image followed by its parameters.
+    StreamDescription Transform(const StreamDescription& inputStream) override;
+
+    SequenceDataPtr Transform(SequenceDataPtr sequence) override;
+
+    void Apply(const StreamMinibatch& stream, Matrix<float>& result, DataTransferer* transferer) override;
+    void Apply(const StreamMinibatch& stream, Matrix<double>& result, DataTransferer* transferer) override;
+
+    size_t GetPackedSampleSize() const
+    {
+        return m_imageSize + GetNumParameters() * sizeof(float);
+    }
+
+private:
+    size_t GetNumParameters() const
+    {
+        return 3 + m_channels;
+    }
+
+    template <class ElemType>
+    struct DeviceBuffers
+    {
+        std::vector<ElemType> m_hostParameters;
+        std::map<DataTransferer*, std::pair<std::shared_ptr<Matrix<char>>, std::shared_ptr<Matrix<ElemType>>>> m_slots; // images and parameters of each prefetch slot
+        std::map<DEVICEID_TYPE, std::shared_ptr<Matrix<ElemType>>> m_means;
+    };
+
+    template <class ElemType>
+    void Apply(const StreamMinibatch& stream, Matrix<ElemType>& result, DataTransferer* transferer, DeviceBuffers<ElemType>& buffers);
+
+    size_t m_width;
+    size_t m_height;
+    size_t m_channels;
+    size_t m_imageSize; // in bytes
+    ImageLayoutKind m_layout;
+
+    std::shared_ptr<ColorTransformer> m_color;
+    std::shared_ptr<IntensityTransformer> m_intensity;
+    std::shared_ptr<MeanTransformer> m_mean;
+
+    conc_stack<std::vector<unsigned char>> m_memBuffers;
+    DeviceBuffers<float> m_floatBuffers;
+    DeviceBuffers<double> m_doubleBuffers;
+};
+
 
 }}}
@@ -9,9 +9,32 @@
 
 #ifdef USE_ZIP
 #include <File.h>
+#include <zlib.h>
 
 namespace Microsoft { namespace MSR { namespace CNTK {
 
+namespace
+{
+// Signatures of the zip records read by the memory mapped mode.
+const uint32_t LocalFileHeaderSignature = 0x04034b50;
+const uint32_t CentralDirectoryHeaderSignature = 0x02014b50;
+const uint32_t EndOfCentralDirectorySignature = 0x06054b50;
+const uint32_t Zip64EndOfCentralDirectorySignature = 0x06064b50;
+const uint32_t Zip64EndOfCentralDirectoryLocatorSignature = 0x07064b50;
+
+const size_t EndOfCentralDirectorySize = 22;
+const size_t MaxZipCommentSize = 0xFFFF;
+
+// Zip records are little endian and not aligned.
+template <class T>
+T ReadField(const char* data)
+{
+    T value;
+    memcpy(&value, data, sizeof(T));
+    return value;
+}
+}
+
 std::string GetZipError(int err)
 {
     zip_error_t error;
@@ -21,8 +44,8 @@ std::string GetZipError(int err)
     return errS;
 }
 
-ZipByteReader::ZipByteReader(const std::string& zipPath)
-    : m_zipPath(zipPath)
+ZipByteReader::ZipByteReader(const std::string& zipPath, bool memoryMap)
+    : m_zipPath(zipPath), m_memoryMap(memoryMap)
 {
     assert(!m_zipPath.empty());
 }
@@ -47,6 +70,12 @@ ZipByteReader::ZipPtr ZipByteReader::OpenZip()
 
 void ZipByteReader::Register(const std::map<std::string, size_t>& sequences)
 {
+    if (m_memoryMap)
+    {
+        RegisterMapped(sequences);
+        return;
+    }
+
     auto zipFile = m_zips.pop_or_create([this]() { return OpenZip(); });
     zip_stat_t stat;
     zip_stat_init(&stat);
@@ -87,8 +116,11 @@ void ZipByteReader::Register(const std::map<std::string, size_t>& sequences)
     }
 }
 
-cv::Mat ZipByteReader::Read(size_t seqId, const std::string& path, bool grayscale)
+cv::Mat ZipByteReader::Read(size_t seqId, const std::string& path, bool grayscale, size_t minDecodedSide)
 {
+    if (m_memoryMap)
+        return ReadMapped(seqId, path, grayscale, minDecodedSide);
+
     // Find index of the file in .zip file.
     auto r = m_seqIdToIndex.find(seqId);
     if (r == m_seqIdToIndex.end())
@@ -131,11 +163,179 @@ cv::Mat ZipByteReader::Read(size_t seqId, const std::string& path, bool grayscal
     });
     m_zips.push(std::move(zipFile));
 
-    cv::Mat img = cv::imdecode(contents, grayscale ? cv::IMREAD_GRAYSCALE : cv::IMREAD_COLOR);
+    cv::Mat img = DecodeImage(contents.data(), size, grayscale, minDecodedSide);
     assert(nullptr != img.data);
     m_workspace.push(std::move(contents));
     return img;
 }
+
+void ZipByteReader::RegisterMapped(const std::map<std::string, size_t>& sequences)
+{
+    m_mappedFile = std::make_shared<MappedFile>(msra::strfun::utf16(m_zipPath));
+    const char* data = m_mappedFile->GetData();
+    size_t fileSize = m_mappedFile->GetSize();
+
+    auto check = [&](uint64_t offset, uint64_t size)
+    {
+        if (offset > fileSize || size > fileSize - offset)
+            RuntimeError("Zip file %s is truncated or corrupted.", m_zipPath.c_str());
+    };
+
+    // The end of central directory record is followed only by the archive comment.
+    if (fileSize < EndOfCentralDirectorySize)
+        RuntimeError("File %s is not a zip file.", m_zipPath.c_str());
+    size_t end = fileSize - EndOfCentralDirectorySize;
+    size_t last = end > MaxZipCommentSize ? end - MaxZipCommentSize : 0;
+    size_t endOfDirectory = end;
+    while (ReadField<uint32_t>(data + endOfDirectory) != EndOfCentralDirectorySignature)
+    {
+        if (endOfDirectory == last)
+            RuntimeError("File %s is not a zip file, its central directory is not found.", m_zipPath.c_str());
+        endOfDirectory--;
+    }
+
+    uint64_t numEntries = ReadField<uint16_t>(data + endOfDirectory + 10);
+    uint64_t directorySize = ReadField<uint32_t>(data + endOfDirectory + 12);
+    uint64_t directoryOffset = ReadField<uint32_t>(data + endOfDirectory + 16);
+
+    // Archives with more than 65535 entries or larger than 4GB keep the values in the zip64 record.
+    const size_t locatorSize = 20;
+    if (endOfDirectory >= locatorSize && ReadField<uint32_t>(data + endOfDirectory - locatorSize) == Zip64EndOfCentralDirectoryLocatorSignature)
+    {
+        uint64_t recordOffset = ReadField<uint64_t>(data + endOfDirectory - locatorSize + 8);
+        check(recordOffset, 56);
+        if (ReadField<uint32_t>(data + recordOffset) != Zip64EndOfCentralDirectorySignature)
+            RuntimeError("Zip file %s is corrupted, invalid zip64 end of central directory.", m_zipPath.c_str());
+        numEntries = ReadField<uint64_t>(data + recordOffset + 32);
+        directorySize = ReadField<uint64_t>(data + recordOffset + 40);
+        directoryOffset = ReadField<uint64_t>(data + recordOffset + 48);
+    }
+    check(directoryOffset, directorySize);
+
+    // Index the entries by name in one pass over the central directory.
+    std::unordered_map<std::string, MappedEntry> entries(numEntries);
+    const char* entry = data + directoryOffset;
+    const char* directoryEnd = entry + directorySize;
+    const size_t headerSize = 46;
+    for (uint64_t i = 0; i < numEntries; i++)
+    {
+        if (directoryEnd - entry < (ptrdiff_t)headerSize || ReadField<uint32_t>(entry) != CentralDirectoryHeaderSignature)
+            RuntimeError("Zip file %s is corrupted, invalid central directory entry %d.", m_zipPath.c_str(), (int)i);
+
+        uint16_t flags = ReadField<uint16_t>(entry + 8);
+        uint16_t method = ReadField<uint16_t>(entry + 10);
+        uint64_t compressedSize = ReadField<uint32_t>(entry + 20);
+        uint64_t size = ReadField<uint32_t>(entry + 24);
+        uint16_t nameLength = ReadField<uint16_t>(entry + 28);
+        uint16_t extraLength = ReadField<uint16_t>(entry + 30);
+        uint16_t commentLength = ReadField<uint16_t>(entry + 32);
+        uint64_t localHeaderOffset = ReadField<uint32_t>(entry + 42);
+        if (directoryEnd - entry < (ptrdiff_t)(headerSize + nameLength + extraLength + commentLength))
+            RuntimeError("Zip file %s is corrupted, invalid central directory entry %d.", m_zipPath.c_str(), (int)i);
+        std::string name(entry + headerSize, nameLength);
+
+        // The zip64 extra field holds those of the values that do not fit, in this order.
+        const char* extra = entry + headerSize + nameLength;
+        const char* extraEnd = extra + extraLength;
+        while (extraEnd - extra >= 4)
+        {
+            uint16_t id = ReadField<uint16_t>(extra);
+            uint16_t length = ReadField<uint16_t>(extra + 2);
+            const char* value = extra + 4;
+            const char* valueEnd = std::min(value + length, extraEnd);
+            if (id == 0x0001)
+            {
+                for (uint64_t* field : { &size, &compressedSize, &localHeaderOffset })
+                {
+                    if (*field == 0xFFFFFFFF && valueEnd - value >= 8)
+                    {
+                        *field = ReadField<uint64_t>(value);
+                        value += 8;
+                    }
+                }
+                break;
+            }
+            extra = valueEnd;
+        }
+
+        entry += headerSize + nameLength + extraLength + commentLength;
+
+        if (sequences.find(name) == sequences.end())
+            continue;
+
+        if (flags & 1)
+            RuntimeError("File %s in zip file %s is encrypted, which is not supported.", name.c_str(), m_zipPath.c_str());
+
+        // The data follows the local header, whose name and extra field may differ from the central directory.
+        const size_t localHeaderSize = 30;
+        check(localHeaderOffset, localHeaderSize);
+        const char* localHeader = data + localHeaderOffset;
+        if (ReadField<uint32_t>(localHeader) != LocalFileHeaderSignature)
+            RuntimeError("Zip file %s is corrupted, invalid local header of file %s.", m_zipPath.c_str(), name.c_str());
+        uint64_t offset = localHeaderOffset + localHeaderSize + ReadField<uint16_t>(localHeader + 26) + ReadField<uint16_t>(localHeader + 28);
+        check(offset, compressedSize);
+
+        entries[name] = MappedEntry{ offset, compressedSize, size, method };
+    }
+
+    for (const auto& s : sequences)
+    {
+        auto e = entries.find(s.first);
+        if (e != entries.end())
+            m_seqIdToEntry[s.second] = e->second;
+    }
+
+    if (m_seqIdToEntry.size() != sequences.size())
+    {
+        // Not all sequences have been found. Let's print them out and throw.
+        for (const auto& s : sequences)
+        {
+            if (m_seqIdToEntry.find(s.second) == m_seqIdToEntry.end())
+                fprintf(stderr, "Sequence %s is not found in container %s.\n", s.first.c_str(), m_zipPath.c_str());
+        }
+
+        RuntimeError("Cannot retrieve image data for some sequences. For more detail, please see the log file.");
+    }
+}
+
+cv::Mat ZipByteReader::ReadMapped(size_t seqId, const std::string& path, bool grayscale, size_t minDecodedSide)
+{
+    auto r = m_seqIdToEntry.find(seqId);
+    if (r == m_seqIdToEntry.end())
+        RuntimeError("Could not find file %s in the zip file, sequence id = %lu", path.c_str(), (long)seqId);
+
+    const MappedEntry& entry = r->second;
+    const unsigned char* compressed = (const unsigned char*)m_mappedFile->GetData() + entry.m_offset;
+
+    // Stored files are decoded right from the mapping.
+    if (entry.m_method == 0)
+        return DecodeImage(compressed, (size_t)entry.m_compressedSize, grayscale, minDecodedSide);
+
+    if (entry.m_method != Z_DEFLATED)
+        RuntimeError("File %s in zip file %s uses unsupported compression method %d.", path.c_str(), m_zipPath.c_str(), (int)entry.m_method);
+
+    size_t size = (size_t)entry.m_size;
+    auto contents = m_workspace.pop_or_create([size]() { return vector<unsigned char>(size); });
+    if (contents.size() < size)
+        contents.resize(size);
+
+    // Zip entries are raw deflate streams without zlib header.
+    z_stream stream = {};
+    if (inflateInit2(&stream, -MAX_WBITS) != Z_OK)
+        RuntimeError("Could not initialize zlib to read file %s in the zip file.", path.c_str());
+    stream.next_in = const_cast<unsigned char*>(compressed);
+    stream.avail_in = (uInt)entry.m_compressedSize;
+    stream.next_out = contents.data();
+    stream.avail_out = (uInt)size;
+    int err = inflate(&stream, Z_FINISH);
+    inflateEnd(&stream);
+    if (err != Z_STREAM_END || stream.total_out != size)
+        RuntimeError("Could not inflate file %s in the zip file, sequence id = %lu, zlib error %d.", path.c_str(), (long)seqId, err);
+
+    cv::Mat img = DecodeImage(contents.data(), size, grayscale, minDecodedSide);
+    m_workspace.push(std::move(contents));
+    return img;
+}
 }}}
 
 #endif
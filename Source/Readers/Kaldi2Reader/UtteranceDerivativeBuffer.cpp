@@ -138,11 +138,17 @@ bool UtteranceDerivativeBuffer<ElemType>::SetLikelihood(
                 m_uttPool[uttID].progress += numFrames;
                 if (m_uttPool[uttID].progress == m_uttPool[uttID].uttLength)
                 {
-                    m_derivativeInterface->ComputeDerivative(
-                        uttID,
-                        m_uttPool[uttID].logLikelihood,
-                        &m_uttPool[uttID].derivative,
-                        &m_uttPool[uttID].objective);
+                    // Computes the derivative in the background. The unit
+                    // stays where it is in <m_uttPool> until GetDerivative()
+                    // has waited for it.
+                    UtteranceDerivativeUnit* unit = &m_uttPool[uttID];
+                    unit->derivativeTask = std::async(std::launch::async, [this, uttID, unit]()
+                    {
+                        std::lock_guard<std::mutex> lock(m_derivativeMutex);
+                        m_derivativeInterface->ComputeDerivative(
+                            uttID, unit->logLikelihood,
+                            &unit->derivative, &unit->objective);
+                    });
                     m_uttPool[uttID].hasDerivative = true;
                     m_uttPool[uttID].progress = 0;
                     m_uttReady[m_uttPool[uttID].streamID] = true;
@@ -161,6 +167,7 @@ bool UtteranceDerivativeBuffer<ElemType>::SetLikelihood(
             break;
         }
     }
+    return true;
 }
 
 // Suppose we have a, b, c 3 streams, the <derivativesOut> should be in the
@@ -198,6 +205,12 @@ bool UtteranceDerivativeBuffer<ElemType>::GetDerivative(
                              uttID.c_str());
             }
 
+            // Waits for the derivatives (and passes on their errors).
+            if (m_uttPool[uttID].derivativeTask.valid())
+            {
+                m_uttPool[uttID].derivativeTask.get();
+            }
+
             // Assign the derivatives.
             assert(uttID == uttInfoInMinibatch[i][j].first);
             size_t startFrame = uttInfoInMinibatch[i][j].second.first;
@@ -270,6 +283,7 @@ template <class ElemType>
 bool UtteranceDerivativeBuffer<ElemType>::HasResourceForDerivative(
     const wstring& uttID) const
 {
+    std::lock_guard<std::mutex> lock(m_derivativeMutex);
     return m_derivativeInterface->HasResourceForDerivative(uttID);
 }
 
@@ -306,9 +320,22 @@ bool UtteranceDerivativeBuffer<ElemType>::CompareUttInfo(
     return match;
 }
 
+template <class ElemType>
+void UtteranceDerivativeBuffer<ElemType>::WaitForDerivatives()
+{
+    for (auto& utt : m_uttPool)
+    {
+        if (utt.second.derivativeTask.valid())
+        {
+            utt.second.derivativeTask.wait();
+        }
+    }
+}
+
 template <class ElemType>
 void UtteranceDerivativeBuffer<ElemType>::ResetEpoch()
 {
+    WaitForDerivatives();
     m_needLikelihood = true;
     m_currentObj = 0;
     m_epochEnd = false;
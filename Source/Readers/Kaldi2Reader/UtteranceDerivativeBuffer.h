@@ -4,12 +4,17 @@
 #include "basetypes.h"
 #include "Sequences.h"
 #include "UtteranceDerivativeComputationInterface.h"
+#include <future>
+#include <mutex>
 
 namespace Microsoft { namespace MSR { namespace CNTK {
 
 // This class "gules" together the log-likelihood from different minibatches,
 // and then calls <UtteranceDerivativeComputationInterface> class to compute
 // the derivative for given utterance.
+// The derivative of an utterance is computed in the background as soon as its
+// log-likelihood is complete, while the network computes the log-likelihoods of
+// the utterances of the other streams; GetDerivative() waits for it.
 template <class ElemType>
 class UtteranceDerivativeBuffer
 {
@@ -23,6 +28,7 @@ private:
         Matrix<ElemType> logLikelihood;
         Matrix<ElemType> derivative;
         ElemType objective;
+        std::future<void> derivativeTask; // computes <derivative> and <objective>
 
         UtteranceDerivativeUnit()
             : logLikelihood(CPUDEVICE), derivative(CPUDEVICE)
@@ -45,6 +51,13 @@ private:
     unordered_map<wstring, UtteranceDerivativeUnit> m_uttPool;
     UtteranceDerivativeComputationInterface<ElemType>* m_derivativeInterface;
 
+    // <m_derivativeInterface> is not thread-safe, e.g. the Kaldi readers of
+    // lattices and alignments, so it is used by one thread at a time.
+    mutable std::mutex m_derivativeMutex;
+
+    // Waits for the derivatives that are being computed in the background.
+    void WaitForDerivatives();
+
     // <uttInfoInMinibatch> is a vector of vector of the following:
     //     uttID startFrameIndexInMinibatch numFrames
     void ProcessUttInfo(
@@ -67,6 +80,7 @@ public:
     // Destructor.
     ~UtteranceDerivativeBuffer()
     {
+        WaitForDerivatives();
     }
 
     bool NeedLikelihoodToComputeDerivative() const
@@ -1571,6 +1571,19 @@ void BatchSequenceReader<ElemType>::InitFromConfig(const ConfigRecordType& reade
     const LabelInfo& labelOut = m_labelInfo[labelInfoOut];
     m_parser.ParseInit(pathName.c_str(), m_featureDim, labelIn.dim, labelOut.dim, labelIn.beginSequence, labelIn.endSequence, labelOut.beginSequence, labelOut.endSequence);
 
+    // for large corpora: instead of parsing the text in every epoch, tokenize it once in parallel into a memory-mapped cache of token ids
+    bool useTokenCache = readerConfig(L"tokenCache", false);
+    if (useTokenCache)
+    {
+        if (labelOut.type == labelCategory)
+            InvalidArgument("BatchSequenceReader: tokenCache requires output labels of type 'nextWord' or 'none'.");
+        wstring tokenCacheFile = readerConfig(L"tokenCacheFile", L"");
+        if (tokenCacheFile.empty())
+            tokenCacheFile = pathName + L".tokens";
+        size_t numParserThreads = readerConfig(L"numParserThreads", (size_t) 0); // 0 means one per core
+        m_tokenCache.Open(pathName, tokenCacheFile, labelIn.mapLabelToId, mUnk, numParserThreads, m_traceLevel);
+    }
+
     mRequestedNumParallelSequences = readerConfig(L"nbruttsineachrecurrentiter", (size_t) 1); // 0 indicates auto-fill mbSize
     // TODO: ^^ This should depend on the sequences themselves.
 }
@@ -1673,10 +1686,28 @@ void BatchSequenceReader<ElemType>::StartMinibatchLoop(size_t mbSize, size_t epo
     m_idx2clsRead = false;
 
     m_parser.ParseReset();
+    m_nextCachedSentence = 0;
 
     Reset();
 }
 
+// the counterpart of m_parser.Parse() for the token cache: appends the next sentences of the corpus, with at least
+// recordsRequested tokens in total unless the end is reached, to mSentenceIndex2SentenceInfo[]; returns their number
+template <class ElemType>
+size_t BatchSequenceReader<ElemType>::ReadCachedSentences(size_t recordsRequested)
+{
+    size_t numRead = 0;
+    for (size_t numTokens = 0; numTokens < recordsRequested && m_nextCachedSentence < m_tokenCache.GetNumSentences(); m_nextCachedSentence++, numRead++)
+    {
+        SentenceInfo stinfo;
+        stinfo.sBegin = m_tokenCache.GetSentenceBegin(m_nextCachedSentence);
+        stinfo.sLen = m_tokenCache.GetSentenceLength(m_nextCachedSentence);
+        m_parser.mSentenceIndex2SentenceInfo.push_back(stinfo);
+        numTokens += stinfo.sLen;
+    }
+    return numRead;
+}
+
 // fill mToProcess[] with the next set of sequences of the same length
 // This function updates mToProcess[] (only, except it also lazily initializes mProcessed[]).
 // If mToProcess[] is not empty, then it will check whether those sequences are done, and if not, just return with mToProcess[] unchanged.
@@ -1785,7 +1816,10 @@ bool BatchSequenceReader<ElemType>::GetMinibatchData(size_t& /*out*/ firstPosInS
 
         std::vector<SequencePosition> seqPos;
         fprintf(stderr, "LMSequenceReader: Reading epoch data..."), fflush(stderr);
-        mNumRead = m_parser.Parse(m_cacheBlockSize, &m_labelTemp, &m_featureTemp, &seqPos);
+        if (m_tokenCache.IsOpen())
+            mNumRead = ReadCachedSentences(m_cacheBlockSize);
+        else
+            mNumRead = m_parser.Parse(m_cacheBlockSize, &m_labelTemp, &m_featureTemp, &seqPos);
         fprintf(stderr, " %d sequences read.\n", (int) mNumRead);
         firstPosInSentence = mLastPosInSentence;
         if (mNumRead == 0)
@@ -1817,6 +1851,8 @@ bool BatchSequenceReader<ElemType>::GetMinibatchData(size_t& /*out*/ firstPosInS
 
     firstPosInSentence = mLastPosInSentence;
 
+    const uint32_t* tokenIds = m_tokenCache.IsOpen() ? m_tokenCache.GetTokenIds() : nullptr; // if set, used instead of m_labelTemp[]
+
     size_t & i = mLastPosInSentence;
     size_t iend = sLn - (labelOut.type != labelNone);       // exclude the last token since it is the last label to be predicted
     // ############### BREAKING CHANGE ################
@@ -1831,13 +1867,13 @@ bool BatchSequenceReader<ElemType>::GetMinibatchData(size_t& /*out*/ firstPosInS
             size_t pos = m_parser.mSentenceIndex2SentenceInfo[seq].sBegin + i;
 
             // labelIn should be a category label
-            const auto& labelValue = m_labelTemp[pos];
+            size_t labelPos = pos;
             pos++; // consume it
 
             // generate the feature token
             if (labelIn.type == labelCategory)
             {
-                LabelIdType labelId = GetIdFromLabel(labelValue, labelIn);
+                LabelIdType labelId = tokenIds ? tokenIds[labelPos] : GetIdFromLabel(m_labelTemp[labelPos], labelIn);
 
                 // use the found value, and set the appropriate location to a 1.0
                 assert(labelIn.dim > labelId); // if this goes off labelOut dimension is too small
@@ -1849,16 +1885,19 @@ bool BatchSequenceReader<ElemType>::GetMinibatchData(size_t& /*out*/ firstPosInS
             // generate the output label token
             if (labelOut.type != labelNone)
             {
-                const auto& labelValue2 = m_labelTemp[pos];
                 LabelIdType labelId;
-                if (labelOut.type == labelCategory)
+                if (tokenIds) // nextWord (checked in InitFromConfig()), the cached id of the next word in the input vocabulary
+                    labelId = tokenIds[pos];
+                else if (labelOut.type == labelCategory)
                 {
+                    const auto& labelValue2 = m_labelTemp[pos];
                     pos++; // consume it   --TODO: value is not used after this
                     labelId = GetIdFromLabel(labelValue2, labelOut);
                 }
                 else if (nextWord)
                 {
                     // this is the next word (pos was already incremented above when reading out labelValue)
+                    const auto& labelValue2 = m_labelTemp[pos];
                     if (EqualCI(labelValue2, labelIn.endSequence)) // end symbol may differ between input and output
                         labelId = GetIdFromLabel(labelIn.endSequence, labelIn);
                     else
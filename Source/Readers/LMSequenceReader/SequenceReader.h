@@ -11,6 +11,7 @@
 #include "DataWriter.h"
 #include "Config.h"
 #include "SequenceParser.h"
+#include "TokenCache.h"
 #include "RandomOrdering.h"
 #include <string>
 #include <map>
@@ -380,6 +381,11 @@ private:
     std::vector<ElemType> m_featureTemp;
     std::vector<LabelType> m_labelTemp;
 
+    // if tokenCache=true: the token ids of the corpus, memory-mapped; replaces m_parser.Parse() and m_labelTemp[]
+    // mSentenceIndex2SentenceInfo[].sBegin is then the position in m_tokenCache.GetTokenIds().
+    LMTokenCache m_tokenCache;
+    size_t m_nextCachedSentence; // next sentence of m_tokenCache to read
+
     bool mSentenceEnd;
     //bool mSentenceBegin;
 
@@ -396,6 +402,7 @@ public:
         mLastPosInSentence = 0;
         mNumRead = 0;
         mSentenceEnd = false;
+        m_nextCachedSentence = 0;
     }
 
     template <class ConfigRecordType>
@@ -410,6 +417,7 @@ public:
     }
 private:
     void Reset();
+    size_t ReadCachedSentences(size_t recordsRequested);
     size_t DetermineSequencesToProcess();
     bool GetMinibatchData(size_t& firstPosInSentence);
     void GetLabelOutput(StreamMinibatchInputs& matrices, size_t m_mbStartSample, size_t actualmbsize);
@@ -0,0 +1,343 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE.md file in the project root for full license information.
+//
+// TokenCache.cpp : a text corpus tokenized into word ids in parallel, kept in a memory-mapped cache file
+//
+
+#include "stdafx.h"
+#define __STDC_FORMAT_MACROS
+#include <inttypes.h>
+#include "TokenCache.h"
+#include "fileutil.h"
+#include <algorithm>
+#include <exception>
+#include <functional>
+#include <thread>
+#include <string.h>
+#include <errno.h>
+#ifndef _WIN32
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+namespace Microsoft { namespace MSR { namespace CNTK {
+
+// A new file of the given size, mapped writable into memory.
+class WritableMappedFile
+{
+public:
+    WritableMappedFile(const std::wstring& path, size_t size)
+        : m_data(nullptr), m_size(size)
+    {
+#ifdef _WIN32
+        m_mapping = NULL;
+        m_file = CreateFileW(path.c_str(), GENERIC_READ | GENERIC_WRITE, 0, NULL, CREATE_ALWAYS, FILE_ATTRIBUTE_NORMAL, NULL);
+        if (m_file == INVALID_HANDLE_VALUE)
+            RuntimeError("Error creating file '%ls', error %d.", path.c_str(), (int) GetLastError());
+        m_mapping = CreateFileMappingW(m_file, NULL, PAGE_READWRITE, (DWORD) ((uint64_t) size >> 32), (DWORD) size, NULL);
+        if (m_mapping == NULL)
+        {
+            CloseHandle(m_file);
+            RuntimeError("Error mapping file '%ls', error %d.", path.c_str(), (int) GetLastError());
+        }
+        m_data = (char*) MapViewOfFile(m_mapping, FILE_MAP_WRITE, 0, 0, size);
+        if (m_data == nullptr)
+        {
+            CloseHandle(m_mapping);
+            CloseHandle(m_file);
+            RuntimeError("Error mapping file '%ls', error %d.", path.c_str(), (int) GetLastError());
+        }
+#else
+        std::string name = msra::strfun::utf8(path);
+        int fd = open(name.c_str(), O_RDWR | O_CREAT | O_TRUNC, 0644);
+        if (fd < 0)
+            RuntimeError("Error creating file '%s': %s.", name.c_str(), strerror(errno));
+        if (ftruncate(fd, (off_t) size) != 0)
+        {
+            close(fd);
+            RuntimeError("Error resizing file '%s': %s.", name.c_str(), strerror(errno));
+        }
+        void* data = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+        close(fd);
+        if (data == MAP_FAILED)
+            RuntimeError("Error mapping file '%s': %s.", name.c_str(), strerror(errno));
+        m_data = (char*) data;
+#endif
+    }
+
+    ~WritableMappedFile()
+    {
+#ifdef _WIN32
+        UnmapViewOfFile(m_data);
+        CloseHandle(m_mapping);
+        CloseHandle(m_file);
+#else
+        munmap(m_data, m_size);
+#endif
+    }
+
+    char* GetData() const { return m_data; }
+
+private:
+    char* m_data;
+    size_t m_size;
+#ifdef _WIN32
+    HANDLE m_file;
+    HANDLE m_mapping;
+#endif
+
+    DISABLE_COPY_AND_MOVE(WritableMappedFile);
+};
+
+// ---------------------------------------------------------------------------
+// LMTokenCache
+// ---------------------------------------------------------------------------
+
+// Layout of the cache file: the header, the begin of each sentence and the total number of tokens as uint64, then the token ids as uint32.
+struct LMTokenCacheHeader
+{
+    char m_magic[8];
+    uint64_t m_corpusSize;     // in bytes, to detect a changed corpus
+    uint64_t m_vocabularyHash; // to detect a changed vocabulary
+    uint64_t m_numSentences;
+    uint64_t m_numTokens;
+};
+
+static const char s_tokenCacheMagic[8] = { 'L', 'M', 'T', 'O', 'K', 'E', 'N', '1' };
+
+static size_t GetTokenCacheSize(uint64_t numSentences, uint64_t numTokens)
+{
+    return sizeof(LMTokenCacheHeader) + (numSentences + 1) * sizeof(uint64_t) + numTokens * sizeof(uint32_t);
+}
+
+// FNV-1a
+static uint64_t HashBytes(uint64_t hash, const void* data, size_t size)
+{
+    for (size_t i = 0; i < size; i++)
+        hash = (hash ^ ((const unsigned char*) data)[i]) * 1099511628211ull;
+    return hash;
+}
+
+static bool IsTokenDelimiter(char c)
+{
+    return c == ' ' || c == '\t' || c == '\r'; // (lines are split at '\n' before)
+}
+
+void LMTokenCache::Open(const std::wstring& corpusPath, const std::wstring& cachePath, const std::map<std::string, unsigned>& vocabulary, const std::string& unk, size_t numThreads, int traceLevel)
+{
+    if (vocabulary.empty())
+        InvalidArgument("LMTokenCache: A vocabulary (word class or label mapping file) is required to tokenize '%ls'.", corpusPath.c_str());
+
+    m_vocabulary.clear();
+    m_vocabulary.reserve(vocabulary.size());
+    uint64_t vocabularyHash = 14695981039346656037ull;
+    for (const auto& word : vocabulary)
+    {
+        uint32_t id = (uint32_t) word.second;
+        m_vocabulary[word.first] = id;
+        vocabularyHash = HashBytes(vocabularyHash, word.first.c_str(), word.first.size() + 1);
+        vocabularyHash = HashBytes(vocabularyHash, &id, sizeof(id));
+    }
+    vocabularyHash = HashBytes(vocabularyHash, unk.c_str(), unk.size() + 1);
+
+    auto unkEntry = m_vocabulary.find(unk);
+    m_hasUnk = unkEntry != m_vocabulary.end();
+    m_unkId = m_hasUnk ? unkEntry->second : 0;
+
+    int64_t corpusSize = filesize64(corpusPath.c_str());
+    if (corpusSize < 0)
+        RuntimeError("LMTokenCache: cannot open '%ls'.", corpusPath.c_str());
+
+    if (!TryMapCache(cachePath, (uint64_t) corpusSize, vocabularyHash))
+    {
+        Build(corpusPath, cachePath, vocabularyHash, numThreads, traceLevel);
+        if (!TryMapCache(cachePath, (uint64_t) corpusSize, vocabularyHash))
+            RuntimeError("LMTokenCache: the newly built token cache '%ls' is invalid.", cachePath.c_str());
+    }
+    else if (traceLevel > 0)
+        fprintf(stderr, "LMTokenCache: Using the token cache '%ls'.\n", cachePath.c_str());
+
+    fprintf(stderr, "LMTokenCache: %" PRIu64 " sentences with %" PRIu64 " tokens in '%ls'.\n", (uint64_t) m_numSentences, (uint64_t) m_numTokens, cachePath.c_str());
+}
+
+// maps the cache file if it exists and matches the corpus and vocabulary
+bool LMTokenCache::TryMapCache(const std::wstring& cachePath, uint64_t corpusSize, uint64_t vocabularyHash)
+{
+    m_cache.reset();
+    if (!fexists(cachePath) || filesize64(cachePath.c_str()) < (int64_t) sizeof(LMTokenCacheHeader))
+        return false;
+
+    std::unique_ptr<MappedFile> cache(new MappedFile(cachePath));
+    const auto* header = (const LMTokenCacheHeader*) cache->GetData();
+    if (memcmp(header->m_magic, s_tokenCacheMagic, sizeof(s_tokenCacheMagic)) != 0 ||
+        header->m_corpusSize != corpusSize ||
+        header->m_vocabularyHash != vocabularyHash ||
+        cache->GetSize() != GetTokenCacheSize(header->m_numSentences, header->m_numTokens))
+    {
+        return false;
+    }
+
+    m_numSentences = (size_t) header->m_numSentences;
+    m_numTokens = (size_t) header->m_numTokens;
+    m_sentenceBegins = (const uint64_t*) (cache->GetData() + sizeof(LMTokenCacheHeader));
+    m_tokenIds = (const uint32_t*) (m_sentenceBegins + m_numSentences + 1);
+    m_cache = std::move(cache);
+    return true;
+}
+
+// Tokenizes the corpus into a temporary file that then replaces the cache, in two parallel passes over the shards of the corpus:
+// the first counts the sentences and tokens of each shard, which determines where the shards go in the cache; the second stores them.
+void LMTokenCache::Build(const std::wstring& corpusPath, const std::wstring& cachePath, uint64_t vocabularyHash, size_t numThreads, int traceLevel)
+{
+    auto startTime = std::chrono::high_resolution_clock::now();
+
+    std::unique_ptr<MappedFile> corpus(filesize64(corpusPath.c_str()) > 0 ? new MappedFile(corpusPath) : nullptr); // (empty files cannot be mapped)
+    const char* data = corpus ? corpus->GetData() : nullptr;
+    const size_t size = corpus ? corpus->GetSize() : 0;
+
+    if (numThreads == 0)
+        numThreads = std::max<size_t>(std::thread::hardware_concurrency(), 1);
+    // shards of at least 1 MB
+    numThreads = std::max<size_t>(std::min<size_t>(numThreads, size >> 20), 1);
+
+    // shard boundaries, each at the beginning of a line
+    std::vector<const char*> shardBegins(numThreads + 1, data + size);
+    shardBegins[0] = data;
+    for (size_t k = 1; k < numThreads; k++)
+    {
+        const char* begin = std::max(data + size / numThreads * k, shardBegins[k - 1]);
+        while (begin < data + size && begin[-1] != '\n')
+            begin++;
+        shardBegins[k] = begin;
+    }
+
+    // runs f(k) for all shards k in parallel, and rethrows the first error
+    auto forAllShards = [numThreads](const std::function<void(size_t)>& f)
+    {
+        std::vector<std::exception_ptr> errors(numThreads);
+        std::vector<std::thread> threads;
+        for (size_t k = 0; k < numThreads; k++)
+        {
+            threads.push_back(std::thread([&f, &errors, k]
+            {
+                try
+                {
+                    f(k);
+                }
+                catch (...)
+                {
+                    errors[k] = std::current_exception();
+                }
+            }));
+        }
+        for (auto& thread : threads)
+            thread.join();
+        for (const auto& error : errors)
+        {
+            if (error)
+                std::rethrow_exception(error);
+        }
+    };
+
+    std::vector<ShardCounts> counts(numThreads);
+    forAllShards([&](size_t k)
+    {
+        counts[k] = TokenizeShard(shardBegins[k], shardBegins[k + 1], nullptr, nullptr, 0);
+    });
+
+    // the first sentence and token of each shard
+    std::vector<ShardCounts> firsts(numThreads + 1);
+    firsts[0].m_numSentences = firsts[0].m_numTokens = 0;
+    for (size_t k = 0; k < numThreads; k++)
+    {
+        firsts[k + 1].m_numSentences = firsts[k].m_numSentences + counts[k].m_numSentences;
+        firsts[k + 1].m_numTokens = firsts[k].m_numTokens + counts[k].m_numTokens;
+    }
+    const size_t numSentences = firsts[numThreads].m_numSentences;
+    const size_t numTokens = firsts[numThreads].m_numTokens;
+
+    std::wstring tempPath = cachePath + L".tmp";
+    {
+        WritableMappedFile cache(tempPath, GetTokenCacheSize(numSentences, numTokens));
+        auto* header = (LMTokenCacheHeader*) cache.GetData();
+        auto* sentenceBegins = (uint64_t*) (cache.GetData() + sizeof(LMTokenCacheHeader));
+        auto* tokenIds = (uint32_t*) (sentenceBegins + numSentences + 1);
+
+        forAllShards([&](size_t k)
+        {
+            TokenizeShard(shardBegins[k], shardBegins[k + 1], tokenIds + firsts[k].m_numTokens, sentenceBegins + firsts[k].m_numSentences, firsts[k].m_numTokens);
+        });
+        sentenceBegins[numSentences] = numTokens;
+
+        header->m_corpusSize = size;
+        header->m_vocabularyHash = vocabularyHash;
+        header->m_numSentences = numSentences;
+        header->m_numTokens = numTokens;
+        memcpy(header->m_magic, s_tokenCacheMagic, sizeof(s_tokenCacheMagic));
+    } // unmap and close before the rename
+    renameOrDie(tempPath, cachePath);
+
+    if (traceLevel > 0)
+    {
+        double seconds = std::chrono::duration<double>(std::chrono::high_resolution_clock::now() - startTime).count();
+        fprintf(stderr, "LMTokenCache: Tokenized '%ls' into '%ls' with %d threads in %.1f seconds.\n", corpusPath.c_str(), cachePath.c_str(), (int) numThreads, seconds);
+    }
+}
+
+// Tokenizes the lines in [begin, end), and returns the number of their sentences and tokens.
+// If tokenIds is given, it also stores the ids of the tokens there, and the begins of the sentences, offset by firstToken.
+LMTokenCache::ShardCounts LMTokenCache::TokenizeShard(const char* begin, const char* end, uint32_t* tokenIds, uint64_t* sentenceBegins, uint64_t firstToken) const
+{
+    ShardCounts counts = { 0, 0 };
+    std::vector<std::pair<const char*, const char*>> tokens;
+    std::string word;
+    for (const char* line = begin; line < end;)
+    {
+        const char* lineEnd = std::find(line, end, '\n');
+
+        tokens.clear();
+        for (const char* p = line; p < lineEnd;)
+        {
+            while (p < lineEnd && IsTokenDelimiter(*p))
+                p++;
+            const char* tokenBegin = p;
+            while (p < lineEnd && !IsTokenDelimiter(*p))
+                p++;
+            if (p > tokenBegin)
+                tokens.push_back(std::make_pair(tokenBegin, p));
+        }
+        line = lineEnd < end ? lineEnd + 1 : end;
+
+        if (tokens.size() < 3) // as LMSequenceParser::Parse()
+            continue;
+
+        if (tokenIds)
+        {
+            sentenceBegins[counts.m_numSentences] = firstToken + counts.m_numTokens;
+            for (size_t i = 0; i < tokens.size(); i++)
+            {
+                word.assign(tokens[i].first, tokens[i].second);
+                tokenIds[counts.m_numTokens + i] = GetId(word);
+            }
+        }
+        counts.m_numSentences++;
+        counts.m_numTokens += tokens.size();
+    }
+    return counts;
+}
+
+// as SequenceReader::GetIdFromLabel()
+uint32_t LMTokenCache::GetId(const std::string& word) const
+{
+    auto found = m_vocabulary.find(word);
+    if (found != m_vocabulary.end())
+        return found->second;
+    if (!m_hasUnk)
+        RuntimeError("%s not in vocabulary", word.c_str());
+    return m_unkId;
+}
+
+}}}
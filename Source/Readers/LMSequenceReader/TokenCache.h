@@ -0,0 +1,69 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE.md file in the project root for full license information.
+//
+// TokenCache.h : a text corpus tokenized into word ids in parallel, kept in a memory-mapped cache file
+//
+
+#pragma once
+
+#include <string>
+#include <vector>
+#include <map>
+#include <unordered_map>
+#include <memory>
+#include <stdint.h>
+#include "Basics.h"
+#include "MappedFile.h"
+
+namespace Microsoft { namespace MSR { namespace CNTK {
+
+// The token ids of the sentences of a text corpus (one sentence per line) for the LMSequenceReader, as one uint32 per token.
+// The ids are cached in a file, which is memory-mapped, so that a corpus of billions of tokens is neither held in RAM nor
+// parsed again in the next epochs or runs. The cache is built by memory-mapping the corpus, splitting it into shards at line
+// boundaries, and tokenizing the shards in parallel against the vocabulary; it is rebuilt if the size of the corpus or the
+// vocabulary changed.
+// As LMSequenceParser::Parse(), lines with less than 3 tokens are skipped, and words not in the vocabulary map to 'unk'.
+class LMTokenCache
+{
+public:
+    LMTokenCache()
+        : m_numSentences(0), m_numTokens(0), m_sentenceBegins(nullptr), m_tokenIds(nullptr)
+    {
+    }
+
+    // numThreads - number of tokenizing threads if the cache has to be built, 0 for the number of cores
+    void Open(const std::wstring& corpusPath, const std::wstring& cachePath, const std::map<std::string, unsigned>& vocabulary, const std::string& unk, size_t numThreads, int traceLevel);
+    bool IsOpen() const { return m_cache != nullptr; }
+
+    size_t GetNumSentences() const { return m_numSentences; }
+    size_t GetNumTokens() const { return m_numTokens; }
+    // position of the first token of sentence i in GetTokenIds()
+    size_t GetSentenceBegin(size_t i) const { return (size_t) m_sentenceBegins[i]; }
+    size_t GetSentenceLength(size_t i) const { return (size_t) (m_sentenceBegins[i + 1] - m_sentenceBegins[i]); }
+    const uint32_t* GetTokenIds() const { return m_tokenIds; }
+
+private:
+    struct ShardCounts
+    {
+        size_t m_numSentences;
+        size_t m_numTokens;
+    };
+
+    bool TryMapCache(const std::wstring& cachePath, uint64_t corpusSize, uint64_t vocabularyHash);
+    void Build(const std::wstring& corpusPath, const std::wstring& cachePath, uint64_t vocabularyHash, size_t numThreads, int traceLevel);
+    ShardCounts TokenizeShard(const char* begin, const char* end, uint32_t* tokenIds, uint64_t* sentenceBegins, uint64_t firstToken) const;
+    uint32_t GetId(const std::string& word) const;
+
+    std::unordered_map<std::string, uint32_t> m_vocabulary;
+    uint32_t m_unkId;
+    bool m_hasUnk;
+
+    std::unique_ptr<MappedFile> m_cache;
+    size_t m_numSentences;
+    size_t m_numTokens;
+    const uint64_t* m_sentenceBegins; // [m_numSentences + 1] in m_cache
+    const uint32_t* m_tokenIds;       // [m_numTokens] in m_cache
+};
+
+}}}
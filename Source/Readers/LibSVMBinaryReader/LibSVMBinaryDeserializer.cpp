@@ -0,0 +1,290 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE.md file in the project root for full license information.
+//
+// LibSVMBinaryDeserializer.cpp -- deserializer of the binary format of the LibSVMBinaryReader
+//
+
+#include "stdafx.h"
+#include "LibSVMBinaryDeserializer.h"
+#include "SequenceData.h"
+#include "StringUtil.h"
+
+namespace Microsoft { namespace MSR { namespace CNTK {
+
+static_assert(sizeof(IndexType) == sizeof(int32_t), "the row indices of the file are used as the indices of the sparse sequences");
+
+// The batches of a chunk, which are parsed when the chunk is loaded.
+class LibSVMBinaryDeserializer::LibSVMBinaryChunk : public Chunk, public std::enable_shared_from_this<Chunk>
+{
+public:
+    LibSVMBinaryChunk(const LibSVMBinaryDeserializer& parent, const ChunkInfo& info)
+        : m_parent(parent), m_info(info)
+    {
+        size_t begin = m_parent.m_batchOffsets[m_info.m_firstBatch];
+        size_t end = m_parent.m_batchOffsets[m_info.m_firstBatch + m_info.m_numBatches];
+        m_parent.m_file->WillNeed(begin, end - begin);
+
+        const size_t numStreams = m_parent.m_dims.size();
+        size_t firstSequence = m_info.m_firstSequence;
+        m_batches.resize(m_info.m_numBatches);
+        for (size_t b = 0; b < m_info.m_numBatches; b++)
+        {
+            Batch& batch = m_batches[b];
+            size_t offset = m_parent.m_batchOffsets[m_info.m_firstBatch + b];
+            end = m_parent.m_batchOffsets[m_info.m_firstBatch + b + 1];
+
+            batch.m_firstSequence = firstSequence;
+            batch.m_numSamples = (size_t) m_parent.Read<int32_t>(offset);
+            firstSequence += batch.m_numSamples;
+            batch.m_values.resize(numStreams);
+            batch.m_rows.resize(numStreams);
+            batch.m_columns.resize(numStreams);
+            for (size_t s = 0; s < m_parent.m_numFeatures; s++)
+            {
+                size_t nnz = (size_t) m_parent.Read<int32_t>(offset);
+                batch.m_values[s] = m_parent.m_file->GetData() + offset;
+                offset += nnz * m_parent.m_elementSize;
+                batch.m_rows[s] = (const IndexType*) (m_parent.m_file->GetData() + offset);
+                offset += nnz * sizeof(int32_t);
+                batch.m_columns[s] = (const int32_t*) (m_parent.m_file->GetData() + offset);
+                offset += (batch.m_numSamples + 1) * sizeof(int32_t);
+                if (offset > end)
+                    RuntimeError("LibSVMBinaryDeserializer: Batch %d is truncated.", (int) (m_info.m_firstBatch + b));
+
+                const int32_t* columns = batch.m_columns[s];
+                if (columns[0] != 0 || (size_t) columns[batch.m_numSamples] != nnz)
+                    RuntimeError("LibSVMBinaryDeserializer: Invalid column indices of feature %d in batch %d.", (int) s, (int) (m_info.m_firstBatch + b));
+                for (size_t i = 0; i < batch.m_numSamples; i++)
+                {
+                    if (columns[i + 1] < columns[i])
+                        RuntimeError("LibSVMBinaryDeserializer: Invalid column indices of feature %d in batch %d.", (int) s, (int) (m_info.m_firstBatch + b));
+                }
+            }
+            for (size_t s = m_parent.m_numFeatures; s < numStreams; s++)
+            {
+                batch.m_values[s] = m_parent.m_file->GetData() + offset;
+                offset += batch.m_numSamples * m_parent.m_dims[s] * m_parent.m_elementSize;
+                if (offset > end)
+                    RuntimeError("LibSVMBinaryDeserializer: Batch %d is truncated.", (int) (m_info.m_firstBatch + b));
+            }
+        }
+        if (firstSequence != m_info.m_firstSequence + m_info.m_numSequences)
+            LogicError("LibSVMBinaryDeserializer: The number of samples of chunk changed.");
+    }
+
+    void GetSequence(size_t sequenceId, std::vector<SequenceDataPtr>& result) override
+    {
+        assert(sequenceId >= m_info.m_firstSequence && sequenceId < m_info.m_firstSequence + m_info.m_numSequences);
+        auto batch = std::upper_bound(m_batches.begin(), m_batches.end(), sequenceId, [](size_t id, const Batch& b) { return id < b.m_firstSequence; });
+        --batch;
+        size_t sample = sequenceId - batch->m_firstSequence;
+
+        result.resize(m_parent.m_dims.size());
+        for (size_t s = 0; s < m_parent.m_numFeatures; s++)
+        {
+            auto sequence = MakeSequenceData<ChunkBackedSparseSequenceData>();
+            sequence->m_id = sequenceId;
+            sequence->m_numberOfSamples = 1;
+            sequence->m_elementType = m_parent.m_elementType;
+            sequence->m_chunk = shared_from_this();
+            IndexType begin = batch->m_columns[s][sample];
+            IndexType nnz = batch->m_columns[s][sample + 1] - begin;
+            sequence->m_data = batch->m_values[s] + begin * m_parent.m_elementSize;
+            sequence->m_indices = const_cast<IndexType*>(batch->m_rows[s] + begin);
+            sequence->m_nnzCounts.assign(1, nnz);
+            sequence->m_totalNnzCount = nnz;
+            result[s] = sequence;
+        }
+        for (size_t s = m_parent.m_numFeatures; s < m_parent.m_dims.size(); s++)
+        {
+            auto sequence = MakeSequenceData<ChunkBackedDenseSequenceData>();
+            sequence->m_id = sequenceId;
+            sequence->m_numberOfSamples = 1;
+            sequence->m_elementType = m_parent.m_elementType;
+            sequence->m_chunk = shared_from_this();
+            sequence->m_data = batch->m_values[s] + sample * m_parent.m_dims[s] * m_parent.m_elementSize;
+            result[s] = sequence;
+        }
+    }
+
+private:
+    // pointers into the mapping, by stream
+    struct Batch
+    {
+        size_t m_firstSequence;
+        size_t m_numSamples;
+        std::vector<const char*> m_values;
+        std::vector<const IndexType*> m_rows;     // of the features
+        std::vector<const int32_t*> m_columns;    // of the features, [m_numSamples + 1]
+    };
+
+    const LibSVMBinaryDeserializer& m_parent;
+    ChunkInfo m_info;
+    std::vector<Batch> m_batches;
+
+    DISABLE_COPY_AND_MOVE(LibSVMBinaryChunk);
+};
+
+template <class T>
+T LibSVMBinaryDeserializer::Read(size_t& offset) const
+{
+    if (offset + sizeof(T) > m_file->GetSize())
+        RuntimeError("LibSVMBinaryDeserializer: Unexpected end of file at offset %lu.", (unsigned long) offset);
+
+    // the file is not aligned
+    T value;
+    memcpy(&value, m_file->GetData() + offset, sizeof(value));
+    offset += sizeof(value);
+    return value;
+}
+
+LibSVMBinaryDeserializer::LibSVMBinaryDeserializer(CorpusDescriptorPtr, const ConfigParameters& config, bool)
+{
+    std::string precision = config.Find("precision", "float");
+    if (AreEqualIgnoreCase(precision, "float"))
+    {
+        m_elementType = ElementType::tfloat;
+        m_elementSize = sizeof(float);
+    }
+    else if (AreEqualIgnoreCase(precision, "double"))
+    {
+        m_elementType = ElementType::tdouble;
+        m_elementSize = sizeof(double);
+    }
+    else
+        InvalidArgument("LibSVMBinaryDeserializer: Unsupported precision '%s'.", precision.c_str());
+
+    size_t chunkSizeInBytes = config(L"chunkSizeInBytes", (size_t) 32 * 1024 * 1024);
+    std::wstring filename = config(L"file");
+
+    // names in the file -> names of the streams
+    std::map<std::wstring, std::wstring> rename;
+    if (config.ExistsCurrent(L"input"))
+    {
+        const ConfigParameters& input = config(L"input");
+        for (const std::pair<std::string, ConfigParameters>& section : input)
+        {
+            if (section.second.ExistsCurrent(L"alias"))
+                rename[msra::strfun::utf16(section.second(L"alias"))] = msra::strfun::utf16(section.first);
+        }
+    }
+
+    m_file = std::make_shared<MappedFile>(filename);
+    size_t offset = 0;
+    Read<int64_t>(offset); // number of samples, which the batches tell
+    int64_t numBatches = Read<int64_t>(offset);
+    int32_t numFeatures = Read<int32_t>(offset);
+    int32_t numLabels = Read<int32_t>(offset);
+    if (numBatches < 0 || numFeatures < 0 || numLabels < 0)
+        RuntimeError("LibSVMBinaryDeserializer: Invalid header of '%ls'.", filename.c_str());
+
+    m_numFeatures = numFeatures;
+    for (int32_t i = 0; i < numFeatures + numLabels; i++)
+    {
+        int32_t length = Read<int32_t>(offset);
+        if (length < 0 || offset + length > m_file->GetSize())
+            RuntimeError("LibSVMBinaryDeserializer: Invalid header of '%ls'.", filename.c_str());
+        std::wstring name = msra::strfun::utf16(std::string(m_file->GetData() + offset, length));
+        offset += length;
+        int32_t dim = Read<int32_t>(offset);
+
+        auto found = rename.find(name);
+        auto stream = std::make_shared<StreamDescription>();
+        stream->m_id = m_streams.size();
+        stream->m_name = found == rename.end() ? name : found->second;
+        stream->m_storageType = i < numFeatures ? StorageType::sparse_csc : StorageType::dense;
+        stream->m_elementType = m_elementType;
+        stream->m_sampleLayout = std::make_shared<TensorShape>((size_t) dim);
+        m_streams.push_back(stream);
+        m_dims.push_back(dim);
+    }
+
+    // the offsets are relative to the end of the header, the last batch ends with the file
+    size_t dataStart = offset + numBatches * sizeof(int64_t);
+    m_batchOffsets.resize(numBatches + 1);
+    for (int64_t b = 0; b < numBatches; b++)
+        m_batchOffsets[b] = dataStart + Read<int64_t>(offset);
+    m_batchOffsets[numBatches] = m_file->GetSize();
+
+    // group consecutive batches into chunks
+    ChunkInfo chunk = { 0, 0, 0, 0 };
+    for (size_t b = 0; b < (size_t) numBatches; b++)
+    {
+        if (m_batchOffsets[b + 1] < m_batchOffsets[b])
+            RuntimeError("LibSVMBinaryDeserializer: Invalid offset of batch %d in '%ls'.", (int) b, filename.c_str());
+        offset = m_batchOffsets[b];
+        int32_t numSamples = Read<int32_t>(offset);
+        if (numSamples < 0)
+            RuntimeError("LibSVMBinaryDeserializer: Invalid number of samples of batch %d in '%ls'.", (int) b, filename.c_str());
+
+        chunk.m_numBatches++;
+        chunk.m_numSequences += numSamples;
+        if (m_batchOffsets[b + 1] - m_batchOffsets[chunk.m_firstBatch] >= chunkSizeInBytes)
+        {
+            m_chunks.push_back(chunk);
+            chunk = { b + 1, 0, chunk.m_firstSequence + chunk.m_numSequences, 0 };
+        }
+    }
+    if (chunk.m_numBatches > 0)
+        m_chunks.push_back(chunk);
+
+    if (m_chunks.empty())
+        RuntimeError("LibSVMBinaryDeserializer: '%ls' contains no batches.", filename.c_str());
+}
+
+ChunkDescriptions LibSVMBinaryDeserializer::GetChunkDescriptions()
+{
+    ChunkDescriptions result;
+    result.reserve(m_chunks.size());
+    for (ChunkIdType i = 0; i < m_chunks.size(); i++)
+    {
+        auto chunk = std::make_shared<ChunkDescription>();
+        chunk->m_id = i;
+        chunk->m_numberOfSequences = m_chunks[i].m_numSequences;
+        chunk->m_numberOfSamples = m_chunks[i].m_numSequences;
+        result.push_back(chunk);
+    }
+    return result;
+}
+
+void LibSVMBinaryDeserializer::GetSequencesForChunk(ChunkIdType chunkId, std::vector<SequenceDescription>& result)
+{
+    const ChunkInfo& chunk = m_chunks[chunkId];
+    result.reserve(result.size() + chunk.m_numSequences);
+    for (size_t i = 0; i < chunk.m_numSequences; i++)
+    {
+        SequenceDescription sequence;
+        sequence.m_id = chunk.m_firstSequence + i;
+        sequence.m_numberOfSamples = 1;
+        sequence.m_chunkId = chunkId;
+        sequence.m_key.m_sequence = sequence.m_id;
+        sequence.m_key.m_sample = 0;
+        result.push_back(sequence);
+    }
+}
+
+ChunkPtr LibSVMBinaryDeserializer::GetChunk(ChunkIdType chunkId)
+{
+    return std::make_shared<LibSVMBinaryChunk>(*this, m_chunks[chunkId]);
+}
+
+// the keys are the indices of the samples in the file
+bool LibSVMBinaryDeserializer::GetSequenceDescriptionByKey(const KeyType& key, SequenceDescription& result)
+{
+    size_t id = key.m_sequence;
+    auto chunk = std::upper_bound(m_chunks.begin(), m_chunks.end(), id, [](size_t i, const ChunkInfo& c) { return i < c.m_firstSequence; });
+    if (chunk == m_chunks.begin())
+        return false;
+    --chunk;
+    if (id >= chunk->m_firstSequence + chunk->m_numSequences)
+        return false;
+
+    result.m_id = id;
+    result.m_numberOfSamples = 1;
+    result.m_chunkId = (ChunkIdType) (chunk - m_chunks.begin());
+    result.m_key = key;
+    return true;
+}
+
+}}}
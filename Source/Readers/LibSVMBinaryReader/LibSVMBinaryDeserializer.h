@@ -0,0 +1,61 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE.md file in the project root for full license information.
+//
+// LibSVMBinaryDeserializer.h -- deserializer of the binary format of the LibSVMBinaryReader
+//
+
+#pragma once
+
+#include "DataDeserializerBase.h"
+#include "CorpusDescriptor.h"
+#include "Config.h"
+#include "MappedFile.h"
+
+namespace Microsoft { namespace MSR { namespace CNTK {
+
+// Exposes a LibSVMBinaryReader file to the CompositeDataReader, so that it gets the randomizers, the chunk cache,
+// the distributed decimation and the prefetching of the ReaderShim instead of the reader's own queue.
+// The file starts with a header: int64 numRows, int64 numBatches, int32 numFeatures, int32 numLabels; for each feature
+// and then each label, int32 length, char name[length], int32 dim; and int64 offsets[numBatches] of the batches,
+// relative to the end of the header. A batch is int32 numSamples; for each feature, int32 nnz, ElemType values[nnz],
+// int32 rows[nnz] and int32 columns[numSamples + 1]; for each label, ElemType values[numSamples * dim].
+// Every sample is a sequence of its own. The file is memory-mapped, the chunks are consecutive batches of about
+// 'chunkSizeInBytes' bytes, and the sequences point into the mapping.
+// As in the CNTKBinaryReader, the streams can be renamed by input = [ <name> = [ alias = <name in the file> ] ].
+class LibSVMBinaryDeserializer : public DataDeserializerBase
+{
+public:
+    LibSVMBinaryDeserializer(CorpusDescriptorPtr corpus, const ConfigParameters& config, bool primary);
+
+    ChunkDescriptions GetChunkDescriptions() override;
+    void GetSequencesForChunk(ChunkIdType chunkId, std::vector<SequenceDescription>& result) override;
+    ChunkPtr GetChunk(ChunkIdType chunkId) override;
+
+protected:
+    bool GetSequenceDescriptionByKey(const KeyType& key, SequenceDescription& result) override;
+
+private:
+    class LibSVMBinaryChunk;
+
+    struct ChunkInfo
+    {
+        size_t m_firstBatch;
+        size_t m_numBatches;
+        size_t m_firstSequence; // global index of the first sequence
+        size_t m_numSequences;
+    };
+
+    template <class T>
+    T Read(size_t& offset) const;
+
+    MappedFilePtr m_file;
+    ElementType m_elementType;
+    size_t m_elementSize;
+    size_t m_numFeatures;              // the first streams, the labels follow
+    std::vector<size_t> m_dims;        // [stream]
+    std::vector<size_t> m_batchOffsets; // [numBatches + 1], in the file
+    std::vector<ChunkInfo> m_chunks;
+};
+
+}}}
@@ -9,11 +9,14 @@
 #include <inttypes.h>
 #include "BlockRandomizer.h"
 #include <algorithm>
+#include <cstdlib>
+#include <numeric>
 #include <utility>
 #include <deque>
+#include <set>
 
 #include "DataReader.h"
-#include "ExceptionCapture.h"
+#include "CPUThreadPool.h"
 
 namespace Microsoft { namespace MSR { namespace CNTK {
 
@@ -23,7 +26,9 @@ BlockRandomizer::BlockRandomizer(
     IDataDeserializerPtr deserializer,
     bool shouldPrefetch,
     bool useLegacyRandomization,
-    bool multithreadedGetNextSequence)
+    bool multithreadedGetNextSequence,
+    size_t maxParallelChunkLoads,
+    bool frameRandomization)
     : m_verbosity(verbosity),
       m_deserializer(deserializer),
       m_sweep(SIZE_MAX),
@@ -33,21 +38,32 @@ BlockRandomizer::BlockRandomizer(
       m_sweepTotalNumberOfSamples(0),
       m_chunkRandomizer(std::make_shared<ChunkRandomizer>(deserializer, randomizationRangeInSamples, useLegacyRandomization)),
       m_multithreadedGetNextSequences(multithreadedGetNextSequence),
-      m_prefetchedChunk(CHUNKID_MAX)
+      m_maxParallelChunkLoads(maxParallelChunkLoads),
+      m_balanceSamples(false),
+      m_balanceTolerance(0)
 {
     assert(deserializer != nullptr);
 
+    if (m_maxParallelChunkLoads == 0)
+        InvalidArgument("BlockRandomizer: the number of parallel chunk loads must be at least 1.");
+
     m_launchType = shouldPrefetch ? launch::async : launch::deferred;
 
     m_streams = m_deserializer->GetStreamDescriptions();
-    m_sequenceRandomizer = std::make_shared<SequenceRandomizer>(verbosity, m_deserializer, m_chunkRandomizer);
 
     // Calculate total number of samples.
     m_sweepTotalNumberOfSamples = 0;
     for (auto const & chunk : m_deserializer->GetChunkDescriptions())
     {
         m_sweepTotalNumberOfSamples += chunk->m_numberOfSamples;
+        if (frameRandomization && chunk->m_numberOfSamples != chunk->m_numberOfSequences)
+            InvalidArgument("BlockRandomizer: frame randomization requires sequences of a single frame, please use it in frame mode only.");
     }
+
+    if (frameRandomization)
+        m_frameRandomizer = std::make_shared<FrameRandomizer>(verbosity, randomizationRangeInSamples, m_deserializer, m_chunkRandomizer);
+    else
+        m_sequenceRandomizer = std::make_shared<SequenceRandomizer>(verbosity, m_deserializer, m_chunkRandomizer);
 }
 
 size_t BlockRandomizer::GetCurrentSamplePosition()
@@ -74,6 +90,15 @@ void BlockRandomizer::StartEpoch(const EpochConfiguration& config)
     if (m_epochSize > std::numeric_limits<size_t>::max() / 2)
         InvalidArgument("Too big epoch size can cause bit overflow");
 
+    if (m_verbosity >= Notification && m_decimationStatistics.m_numMinibatches > 0)
+    {
+        fprintf(stderr, "BlockRandomizer::StartEpoch: samples per worker in the last epoch: mean imbalance %.4g, max imbalance %.4g, %" PRIu64 " sequences moved\n",
+                m_decimationStatistics.MeanImbalance(),
+                m_decimationStatistics.m_maxImbalance,
+                m_decimationStatistics.m_numMovedSequences);
+    }
+    m_decimationStatistics = DecimationStatistics();
+
     m_epochStartPosition = m_epochSize * config.m_epochIndex;
     SetCurrentSamplePosition(m_epochStartPosition);
     if (m_verbosity >= Notification)
@@ -106,7 +131,10 @@ void BlockRandomizer::PrepareNewSweepIfNeeded(size_t samplePosition)
         m_chunkRandomizer->Randomize((unsigned int)m_sweep);
 
         // Resetting sequence randomizer.
-        m_sequenceRandomizer->Reset(m_sweep);
+        if (m_frameRandomizer)
+            m_frameRandomizer->Reset(m_sweep);
+        else
+            m_sequenceRandomizer->Reset(m_sweep);
         m_currentWindowRange = {};
     }
 }
@@ -145,6 +173,17 @@ Sequences BlockRandomizer::GetNextSequences(size_t sampleCount)
 
     result.m_data.resize(m_streams.size(), std::vector<SequenceDataPtr>(decimated.size()));
 
+    std::set<ChunkIdType> chunkIds;
+    for (const auto& description : decimated)
+        chunkIds.insert(description.m_chunk->m_original->m_id);
+    for (auto id : chunkIds)
+    {
+        auto chunk = m_chunks.find(id);
+        if (chunk == m_chunks.end())
+            chunk = m_chunks.insert(std::make_pair(id, GetChunkOfOtherWorker(id))).first;
+        result.m_chunks.push_back(chunk->second);
+    }
+
     auto process = [&](int i) -> void {
         const auto& description = decimated[i];
         std::vector<SequenceDataPtr> sequence;
@@ -155,6 +194,8 @@ Sequences BlockRandomizer::GetNextSequences(size_t sampleCount)
         }
 
         it->second->GetSequence(description.m_id, sequence);
+        if (m_sequenceTransform)
+            m_sequenceTransform(sequence);
         for (int j = 0; j < m_streams.size(); ++j)
         {
             result.m_data[j][i] = sequence[j];
@@ -163,11 +204,12 @@ Sequences BlockRandomizer::GetNextSequences(size_t sampleCount)
 
     if (m_multithreadedGetNextSequences)
     {
-        ExceptionCapture capture;
-#pragma omp parallel for schedule(dynamic)
-        for (int i = 0; i < decimated.size(); ++i)
-            capture.SafeRun(process, i);
-        capture.RethrowIfHappened();
+        // the thread pool rethrows the first exception of 'process'
+        CPUThreadPool::Instance().ParallelFor(decimated.size(), 1, [&](size_t begin, size_t end)
+        {
+            for (size_t i = begin; i < end; ++i)
+                process((int) i);
+        });
     }
     else
     {
@@ -176,8 +218,7 @@ Sequences BlockRandomizer::GetNextSequences(size_t sampleCount)
     }
 
     // Now it is safe to start the new chunk prefetch.
-    ChunkIdType chunkToPrefetchNext = GetChunkToPrefetch(windowRange);
-    Prefetch(chunkToPrefetchNext);
+    Prefetch(windowRange);
 
     return result;
 }
@@ -204,7 +245,9 @@ bool BlockRandomizer::GetNextSequenceDescriptions(size_t sampleCount, std::vecto
     assert(sampleCount != 0);
 
     // Randomizing sequences
-    result = m_sequenceRandomizer->GetNextSequenceDescriptions(sampleCount, windowRange);
+    result = m_frameRandomizer ?
+        m_frameRandomizer->GetNextSequenceDescriptions(sampleCount, windowRange) :
+        m_sequenceRandomizer->GetNextSequenceDescriptions(sampleCount, windowRange);
 
     size_t minibatchSize = 0; // the actual size of the current minibatch in samples
     for (const auto& sequence : result)
@@ -225,16 +268,115 @@ void BlockRandomizer::Decimate(const std::vector<RandomizedSequenceDescription>&
         m_globalSamplePosition += sequence.m_numberOfSamples;
     }
 
+    // A worker gets the sequences of the chunks it loads.
+    size_t numberOfWorkers = m_config.m_numberOfWorkers;
+    std::vector<size_t> workers(all.size());
+    std::vector<size_t> numSamples(numberOfWorkers, 0);
+    for (size_t i = 0; i < all.size(); ++i)
+    {
+        workers[i] = all[i].m_chunk->m_chunkId % numberOfWorkers;
+        numSamples[workers[i]] += all[i].m_numberOfSamples;
+    }
+
+    if (numberOfWorkers > 1)
+    {
+        if (m_balanceSamples)
+            BalanceSamples(all, workers, numSamples);
+
+        size_t total = std::accumulate(numSamples.begin(), numSamples.end(), (size_t)0);
+        double imbalance = total > 0 ? *std::max_element(numSamples.begin(), numSamples.end()) * numberOfWorkers / (double)total : 1;
+        m_decimationStatistics.m_numMinibatches++;
+        m_decimationStatistics.m_sumImbalance += imbalance;
+        m_decimationStatistics.m_maxImbalance = std::max(m_decimationStatistics.m_maxImbalance, imbalance);
+
+        if (m_verbosity >= Debug)
+            fprintf(stderr, "BlockRandomizer::Decimate: %" PRIu64 " to %" PRIu64 " samples per worker, imbalance %.4g\n",
+                *std::min_element(numSamples.begin(), numSamples.end()),
+                *std::max_element(numSamples.begin(), numSamples.end()),
+                imbalance);
+    }
+
     decimated.reserve(all.size());
-    for (const auto& sequence : all)
+    for (size_t i = 0; i < all.size(); ++i)
     {
-        if (sequence.m_chunk->m_chunkId % m_config.m_numberOfWorkers == m_config.m_workerRank)
+        if (workers[i] == m_config.m_workerRank)
         {
-            decimated.push_back(sequence);
+            decimated.push_back(all[i]);
         }
     }
 }
 
+// All workers see the same sequences, so that they come to the same assignment. A sequence is moved from the worker
+// with the most samples to the one with the least as long as their difference is above the tolerance, choosing
+// the sequence that comes closest to halving it, so that few are moved.
+void BlockRandomizer::BalanceSamples(const std::vector<RandomizedSequenceDescription>& all, std::vector<size_t>& workers, std::vector<size_t>& numSamples)
+{
+    double mean = std::accumulate(numSamples.begin(), numSamples.end(), (size_t)0) / (double)numSamples.size();
+    for (;;)
+    {
+        auto minMax = std::minmax_element(numSamples.begin(), numSamples.end());
+        size_t from = minMax.second - numSamples.begin();
+        size_t to = minMax.first - numSamples.begin();
+        size_t difference = numSamples[from] - numSamples[to];
+        if (difference <= m_balanceTolerance * mean)
+            break;
+
+        // Moving a sequence shorter than the difference reduces it; the sum of the squares of the samples per
+        // worker decreases with every move, so that this ends.
+        size_t best = SIZE_MAX;
+        size_t bestDistance = SIZE_MAX;
+        for (size_t i = 0; i < all.size(); ++i)
+        {
+            size_t length = all[i].m_numberOfSamples;
+            if (workers[i] != from || length == 0 || length >= difference)
+                continue;
+
+            size_t distance = (size_t)std::abs((long long)(2 * length) - (long long)difference);
+            if (distance < bestDistance)
+            {
+                best = i;
+                bestDistance = distance;
+            }
+        }
+
+        if (best == SIZE_MAX)
+            break;
+
+        workers[best] = to;
+        numSamples[from] -= all[best].m_numberOfSamples;
+        numSamples[to] += all[best].m_numberOfSamples;
+        m_decimationStatistics.m_numMovedSequences++;
+    }
+}
+
+ChunkPtr BlockRandomizer::GetChunkOfOtherWorker(ChunkIdType chunkId)
+{
+    auto load = m_chunkLoads.find(chunkId);
+    if (load != m_chunkLoads.end())
+    {
+        auto chunk = load->second.get();
+        m_chunkLoads.erase(load);
+        return chunk;
+    }
+
+    // The deserializer may not support concurrent loads.
+    for (auto& inFlight : m_chunkLoads)
+        inFlight.second.wait();
+
+    if (m_verbosity >= Information)
+        fprintf(stderr, "BlockRandomizer::GetChunkOfOtherWorker: paged in original chunk %u for the sample balancing\n", chunkId);
+    return m_deserializer->GetChunk(chunkId);
+}
+
+void BlockRandomizer::SetSampleBalancedDecimation(double tolerance)
+{
+    if (tolerance < 0)
+        InvalidArgument("BlockRandomizer: the tolerance of the sample balancing must not be negative.");
+
+    m_balanceSamples = true;
+    m_balanceTolerance = tolerance;
+}
+
 // Retrieves chunk data based on the window information provided by SequenceRandomizer
 void BlockRandomizer::LoadDataChunks(const ClosedOpenChunkInterval& windowRange)
 {
@@ -280,40 +422,51 @@ void BlockRandomizer::LoadDataChunks(const ClosedOpenChunkInterval& windowRange)
     // TODO diagnostics for paged out chunks?
     m_chunks.swap(chunks);
 
-    // Adding new ones.
+    // Loads in flight for chunks this window does not need are of no use anymore.
+    std::set<ChunkIdType> neededChunks;
+    std::deque<ChunkIdType> toLoad;
     for (size_t i = windowRange.m_begin; i < windowRange.m_end; ++i)
     {
-        if (!needed[i - windowRange.m_begin])
+        if (needed[i - windowRange.m_begin])
         {
-            continue;
+            auto id = m_chunkRandomizer->GetRandomizedChunks()[i].m_original->m_id;
+            neededChunks.insert(id);
+            if (m_chunkLoads.find(id) == m_chunkLoads.end())
+                toLoad.push_back(id);
         }
+    }
+    CancelChunkLoads(neededChunks);
 
-        auto const& chunk = m_chunkRandomizer->GetRandomizedChunks()[i];
-        if (chunk.m_original->m_id == m_prefetchedChunk && m_prefetch.valid())
+    // Adding new ones. Prefetched chunks come first, the rest of the window is loaded
+    // with at most m_maxParallelChunkLoads loads in flight.
+    std::deque<ChunkIdType> inFlight;
+    for (const auto& load : m_chunkLoads)
+        inFlight.push_back(load.first);
+    size_t numPrefetched = inFlight.size();
+
+    while (!inFlight.empty() || !toLoad.empty())
+    {
+        while (!toLoad.empty() && m_chunkLoads.size() < m_maxParallelChunkLoads)
         {
-            // Taking prefetched chunk.
-            m_chunks[chunk.m_original->m_id] = m_prefetch.get();
-            if (m_verbosity >= Information)
-                fprintf(stderr, "BlockRandomizer::RetrieveDataChunks: paged in prefetched chunk %u (original chunk: %u), now %" PRIu64 " chunks in memory\n",
-                chunk.m_chunkId,
-                chunk.m_original->m_id,
-                ++numLoadedChunks);
+            StartChunkLoad(toLoad.front());
+            inFlight.push_back(toLoad.front());
+            toLoad.pop_front();
         }
-        else
-        {
-            // Make sure we have no outstanding prefetches.
-            if (m_prefetch.valid())
-            {
-                m_prefetch.wait();
-            }
 
-            m_chunks[chunk.m_original->m_id] = m_deserializer->GetChunk(chunk.m_original->m_id);
-            if (m_verbosity >= Information)
-                fprintf(stderr, "BlockRandomizer::RetrieveDataChunks: paged in randomized chunk %u (original chunk: %u), now %" PRIu64 " chunks in memory\n",
-                chunk.m_chunkId,
-                chunk.m_original->m_id,
+        auto id = inFlight.front();
+        inFlight.pop_front();
+        auto load = m_chunkLoads.find(id);
+        m_chunks[id] = load->second.get();
+        m_chunkLoads.erase(load);
+
+        if (m_verbosity >= Information)
+            fprintf(stderr, "BlockRandomizer::RetrieveDataChunks: paged in %s chunk (original chunk: %u), now %" PRIu64 " chunks in memory\n",
+                numPrefetched > 0 ? "prefetched" : "randomized",
+                id,
                 ++numLoadedChunks);
-        }
+
+        if (numPrefetched > 0)
+            numPrefetched--;
     }
 
     if (m_verbosity >= Notification)
@@ -323,45 +476,70 @@ void BlockRandomizer::LoadDataChunks(const ClosedOpenChunkInterval& windowRange)
                 m_chunkRandomizer->GetRandomizedChunks()[windowRange.m_end - 1].m_chunkId);
 }
 
-// Identifies chunk id that should be prefetched.
-ChunkIdType BlockRandomizer::GetChunkToPrefetch(const ClosedOpenChunkInterval& windowRange)
+// Identifies chunk ids that should be prefetched.
+std::vector<ChunkIdType> BlockRandomizer::GetChunksToPrefetch(const ClosedOpenChunkInterval& windowRange)
 {
-    ChunkIdType toBePrefetched = CHUNKID_MAX;
+    std::vector<ChunkIdType> toBePrefetched;
     auto current = windowRange.m_end;
-    while (current < m_chunkRandomizer->GetRandomizedChunks().size())
+    while (current < m_chunkRandomizer->GetRandomizedChunks().size() && toBePrefetched.size() < m_maxParallelChunkLoads)
     {
         const auto& chunk = m_chunkRandomizer->GetRandomizedChunks()[current];
         if (chunk.m_chunkId % m_config.m_numberOfWorkers == m_config.m_workerRank &&
             m_chunks.find(chunk.m_original->m_id) == m_chunks.end())
         {
-            toBePrefetched = chunk.m_original->m_id;
-            break;
+            toBePrefetched.push_back(chunk.m_original->m_id);
         }
         ++current;
     }
     return toBePrefetched;
 }
 
-// Performs io prefetch of the specified chunk if needed.
-void BlockRandomizer::Prefetch(ChunkIdType chunkId)
+// Performs io prefetch of the chunks following the window if needed.
+void BlockRandomizer::Prefetch(const ClosedOpenChunkInterval& windowRange)
 {
-    // Start new prefetch if necessary.
-    if (m_prefetchedChunk != chunkId && chunkId != CHUNKID_MAX)
+    auto chunkIds = GetChunksToPrefetch(windowRange);
+
+    // Wait to make sure there is no outstanding prefetches we do not need anymore.
+    CancelChunkLoads(std::set<ChunkIdType>(chunkIds.begin(), chunkIds.end()));
+
+    // Start new prefetches if necessary.
+    for (auto chunkId : chunkIds)
     {
-        // Wait to make sure there is no outstanding prefetches.
-        if (m_prefetch.valid())
-        {
-            m_prefetch.wait();
-        }
+        if (m_chunkLoads.size() >= m_maxParallelChunkLoads)
+            break;
+
+        if (m_chunkLoads.find(chunkId) != m_chunkLoads.end())
+            continue;
 
-        m_prefetchedChunk = chunkId;
-        m_prefetch = std::async(m_launchType, [this, chunkId]() { return m_deserializer->GetChunk(chunkId); });
+        StartChunkLoad(chunkId);
 
         if (m_verbosity >= Debug)
             fprintf(stderr, "BlockRandomizer::Prefetch: prefetching original chunk: %u\n", chunkId);
     }
 }
 
+void BlockRandomizer::StartChunkLoad(ChunkIdType chunkId)
+{
+    assert(m_chunkLoads.size() < m_maxParallelChunkLoads);
+    m_chunkLoads[chunkId] = std::async(m_launchType, [this, chunkId]() { return m_deserializer->GetChunk(chunkId); });
+}
+
+void BlockRandomizer::CancelChunkLoads(const std::set<ChunkIdType>& chunkIds)
+{
+    for (auto load = m_chunkLoads.begin(); load != m_chunkLoads.end();)
+    {
+        if (chunkIds.find(load->first) != chunkIds.end())
+        {
+            ++load;
+            continue;
+        }
+
+        // Loads cannot be interrupted, and the deserializer may not support concurrent loads.
+        load->second.wait();
+        load = m_chunkLoads.erase(load);
+    }
+}
+
 void BlockRandomizer::SetCurrentSamplePosition(size_t currentSamplePosition)
 {
     PrepareNewSweepIfNeeded(currentSamplePosition);
@@ -369,7 +547,9 @@ void BlockRandomizer::SetCurrentSamplePosition(size_t currentSamplePosition)
     // Sets sequence cursor to the sequence that corresponds to the epoch start position.
     // If last epoch ended in the middle of a sequence, the cursor is moved to the next sequence in the sweep.
     size_t offsetInSweep = currentSamplePosition % m_sweepTotalNumberOfSamples;
-    size_t newOffset = m_sequenceRandomizer->Seek(offsetInSweep, m_sweep);
+    size_t newOffset = m_frameRandomizer ?
+        m_frameRandomizer->Seek(offsetInSweep, m_sweep) :
+        m_sequenceRandomizer->Seek(offsetInSweep, m_sweep);
     m_globalSamplePosition = m_sweep * m_sweepTotalNumberOfSamples + newOffset;
 }
 
@@ -378,4 +558,12 @@ void BlockRandomizer::SetConfiguration(const ReaderConfiguration& config)
     *((ReaderConfiguration*)&m_config) = config;
 }
 
+bool BlockRandomizer::SetSequenceTransform(const SequenceTransform& transform)
+{
+    if (!m_multithreadedGetNextSequences)
+        return false;
+    m_sequenceTransform = transform;
+    return true;
+}
+
 }}}
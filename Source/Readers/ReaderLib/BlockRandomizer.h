@@ -11,7 +11,9 @@
 #include "DataDeserializer.h"
 #include "ChunkRandomizer.h"
 #include "SequenceRandomizer.h"
+#include "FrameRandomizer.h"
 #include <future>
+#include <set>
 
 namespace Microsoft { namespace MSR { namespace CNTK {
 
@@ -30,7 +32,12 @@ namespace Microsoft { namespace MSR { namespace CNTK {
 //         6) request chunks of data based on decimated sequences and return sequence data
 //
 // This class is responsible for decimation and loading the data chunks in to memory.
+// A worker gets the sequences of the chunks it loads, i.e. of every m_numberOfWorkers-th randomized chunk. With uneven
+// chunks and sequence lengths, the workers can get quite different numbers of samples per minibatch, and all wait
+// for the slowest one in the gradient aggregation; SetSampleBalancedDecimation() evens them out.
 // Actual randomization happens in ChunkRandomizer and SequenceRandomizer.
+// With frame randomization (for deserializers that expose each frame as a sequence), FrameRandomizer takes the place
+// of SequenceRandomizer, see there.
 // TODO: The behavior can be simplified by only randomizing sequences forward.
 class BlockRandomizer : public SequenceEnumerator
 {
@@ -41,7 +48,9 @@ public:
         IDataDeserializerPtr deserializer,
         bool shouldPrefetch,
         bool useLegacyRandomization = false,
-        bool multithreadedGetNextSequences = false);
+        bool multithreadedGetNextSequences = false,
+        size_t maxParallelChunkLoads = 1,
+        bool frameRandomization = false);
 
     // Starts a new epoch.
     virtual void StartEpoch(const EpochConfiguration& config) override;
@@ -60,16 +69,40 @@ public:
 
     ~BlockRandomizer()
     {
-        if (m_prefetch.valid())
-        {
-            m_prefetch.wait();
-        }
+        for (auto& load : m_chunkLoads)
+            load.second.wait();
     }
 
     void SetCurrentSamplePosition(size_t currentSamplePosition) override;
 
     void SetConfiguration(const ReaderConfiguration& config) override;
 
+    bool SetSequenceTransform(const SequenceTransform& transform) override;
+
+    // Lets the decimation move sequences of a minibatch from the workers with the most samples to the ones with the
+    // least, until the difference is at most 'tolerance' times the mean number of samples per worker. A worker reads
+    // the sequences it gets this way from chunks that it does not load otherwise, so as few as possible are moved.
+    void SetSampleBalancedDecimation(double tolerance);
+
+    // How evenly the samples of the minibatches of the current epoch were spread across the workers.
+    struct DecimationStatistics
+    {
+        size_t m_numMinibatches = 0;
+        double m_sumImbalance = 0;     // of the imbalances, i.e. the largest number of samples of a worker relative to the mean
+        double m_maxImbalance = 0;
+        size_t m_numMovedSequences = 0; // by the sample balancing
+
+        double MeanImbalance() const
+        {
+            return m_numMinibatches > 0 ? m_sumImbalance / m_numMinibatches : 0;
+        }
+    };
+
+    const DecimationStatistics& GetDecimationStatistics() const
+    {
+        return m_decimationStatistics;
+    }
+
 private:
     // Load data for chunks if needed.
     void LoadDataChunks(const ClosedOpenChunkInterval& windowRange);
@@ -81,14 +114,26 @@ private:
     // Decimates sequence descriptions and loads chunks of data.
     void Decimate(const std::vector<RandomizedSequenceDescription>& all, std::vector<RandomizedSequenceDescription>& decimated);
 
+    // Moves sequences between the workers until their samples are balanced, see SetSampleBalancedDecimation().
+    void BalanceSamples(const std::vector<RandomizedSequenceDescription>& all, std::vector<size_t>& workers, std::vector<size_t>& numSamples);
+
+    // Gets a chunk that the worker does not load for the window, for a sequence moved to it by BalanceSamples().
+    ChunkPtr GetChunkOfOtherWorker(ChunkIdType chunkId);
+
     // Prepares a new sweep if needed.
     void PrepareNewSweepIfNeeded(size_t samplePosition);
 
-    // Performs io prefetch of the specified chunk if needed.
-    void Prefetch(ChunkIdType chunkId);
+    // Performs io prefetch of the chunks following the window if needed.
+    void Prefetch(const ClosedOpenChunkInterval& windowRange);
 
-    // Returns next candidate for the prefetch in the given range.
-    ChunkIdType GetChunkToPrefetch(const ClosedOpenChunkInterval& windowRange);
+    // Returns up to m_maxParallelChunkLoads next candidates for the prefetch after the given range, in the order they will be needed.
+    std::vector<ChunkIdType> GetChunksToPrefetch(const ClosedOpenChunkInterval& windowRange);
+
+    // Starts loading the original chunk.
+    void StartChunkLoad(ChunkIdType chunkId);
+
+    // Waits for and drops the loads of chunks that are not in 'chunkIds'.
+    void CancelChunkLoads(const std::set<ChunkIdType>& chunkIds);
 
     // Global sample position on the timeline.
     size_t m_globalSamplePosition;
@@ -116,8 +161,9 @@ private:
     // Chunk randomizer.
     ChunkRandomizerPtr m_chunkRandomizer;
 
-    // Sequence randomizer.
+    // Sequence randomizer, or frame randomizer in case of frame randomization.
     SequenceRandomizerPtr m_sequenceRandomizer;
+    FrameRandomizerPtr m_frameRandomizer;
 
     // Exposed streams.
     std::vector<StreamDescriptionPtr> m_streams;
@@ -128,6 +174,9 @@ private:
     // Whether to get sequences using multiple thread.
     bool m_multithreadedGetNextSequences;
 
+    // Applied to each sequence by the thread that gets it, see SetSequenceTransform().
+    SequenceTransform m_sequenceTransform;
+
     // General configuration
     // TODO generalize those for ReaderLib / Reader / CNTK
     enum VerbosityLevel
@@ -140,15 +189,23 @@ private:
 
     int m_verbosity;
 
-    // Prefetch future.
-    std::future<ChunkPtr> m_prefetch;
+    // Chunk loads in flight (prefetches or loads for the current window), by original chunk id.
+    // Loads run in parallel, so with more than one the deserializer has to support concurrent GetChunk() calls
+    // for different chunks.
+    std::map<ChunkIdType, std::future<ChunkPtr>> m_chunkLoads;
+    // Maximum number of chunk loads in flight.
+    size_t m_maxParallelChunkLoads;
     // Whether to have async or deferred prefetch.
     launch m_launchType;
-    // Prefetched original chunk id.
-    ChunkIdType m_prefetchedChunk;
 
     // Current loaded chunks.
     ClosedOpenChunkInterval m_currentWindowRange;
+
+    // Whether to balance the samples across the workers, and the allowed imbalance.
+    bool m_balanceSamples;
+    double m_balanceTolerance;
+
+    DecimationStatistics m_decimationStatistics;
 };
 
 }}}
@@ -5,9 +5,11 @@
 #define _CRT_SECURE_NO_WARNINGS
 
 #include "Bundler.h"
+#include "ExceptionCapture.h"
 #define __STDC_FORMAT_MACROS
 #include <inttypes.h>
 #include <set>
+#include <thread>
 
 namespace Microsoft { namespace MSR { namespace CNTK {
 
@@ -25,7 +27,7 @@ Bundler::Bundler(
     IDataDeserializerPtr driver,
     std::vector<IDataDeserializerPtr> deserializers,
     bool cleanse)
-    : m_deserializers(deserializers), m_driver(driver)
+    : m_deserializers(deserializers), m_driver(driver), m_weakChunkTableMutexes(deserializers.size())
 {
     m_verbosity = readerConfig(L"verbosity", 0);
 
@@ -236,7 +238,6 @@ public:
 
         // Creating chunk mapping.
         m_parent->m_driver->GetSequencesForChunk(original->m_id, sequences);
-        ChunkPtr drivingChunk = m_parent->m_driver->GetChunk(original->m_id);
         m_sequenceToSequence.resize(deserializers.size() * sequences.size());
         m_innerChunks.resize(deserializers.size() * sequences.size());
         for (size_t sequenceIndex = 0; sequenceIndex < sequences.size(); ++sequenceIndex)
@@ -248,14 +249,13 @@ public:
 
             size_t currentIndex = sequenceIndex * deserializers.size();
             m_sequenceToSequence[currentIndex] = sequences[sequenceIndex].m_id;
-            m_innerChunks[currentIndex] = drivingChunk;
         }
 
-        // Creating sequence mapping and requiring underlying chunks.
+        // Creating sequence mapping of the other deserializers, and remembering which of their chunks are required.
+        std::vector<ChunkIdType> innerChunkIds(m_innerChunks.size(), CHUNKID_MAX);
         SequenceDescription s;
         for (size_t deserializerIndex = 1; deserializerIndex < deserializers.size(); ++deserializerIndex)
         {
-            auto& chunkTable = m_parent->m_weakChunkTable[deserializerIndex];
             for (size_t sequenceIndex = 0; sequenceIndex < sequences.size(); ++sequenceIndex)
             {
                 if (chunk->m_invalid.find(sequenceIndex) != chunk->m_invalid.end())
@@ -266,16 +266,70 @@ public:
                 size_t currentIndex = sequenceIndex * deserializers.size() + deserializerIndex;
                 deserializers[deserializerIndex]->GetSequenceDescription(sequences[sequenceIndex], s);
                 m_sequenceToSequence[currentIndex] = s.m_id;
+                innerChunkIds[currentIndex] = s.m_chunkId;
+            }
+        }
 
-                ChunkPtr secondaryChunk = chunkTable[s.m_chunkId].lock();
+        // Loading the chunks, those of each secondary deserializer on a thread of its own,
+        // e.g. features, labels and lattices of speech are read from different files at the same time.
+        ExceptionCapture capture;
+        std::vector<std::thread> threads;
+        for (size_t deserializerIndex = 1; deserializerIndex < deserializers.size(); ++deserializerIndex)
+        {
+            threads.push_back(std::thread([this, &capture, &innerChunkIds, deserializerIndex]
+            {
+                capture.SafeRun([this, &innerChunkIds, deserializerIndex]
+                {
+                    RequireChunks(deserializerIndex, innerChunkIds);
+                });
+            }));
+        }
+
+        capture.SafeRun([this, original]
+        {
+            ChunkPtr drivingChunk = m_parent->m_driver->GetChunk(original->m_id);
+            for (size_t currentIndex = 0; currentIndex < m_innerChunks.size(); currentIndex += m_parent->m_deserializers.size())
+            {
+                m_innerChunks[currentIndex] = drivingChunk;
+            }
+        });
+
+        for (auto& thread : threads)
+        {
+            thread.join();
+        }
+        capture.RethrowIfHappened();
+    }
+
+    // Fills in the inner chunks of the given secondary deserializer, loading those that are not loaded yet.
+    void RequireChunks(size_t deserializerIndex, const std::vector<ChunkIdType>& innerChunkIds)
+    {
+        auto& deserializer = m_parent->m_deserializers[deserializerIndex];
+        auto& chunkTable = m_parent->m_weakChunkTable[deserializerIndex];
+        ChunkIdType lastChunkId = CHUNKID_MAX;
+        ChunkPtr secondaryChunk;
+        for (size_t currentIndex = deserializerIndex; currentIndex < m_innerChunks.size(); currentIndex += m_parent->m_deserializers.size())
+        {
+            ChunkIdType chunkId = innerChunkIds[currentIndex];
+            if (chunkId == CHUNKID_MAX) // invalid sequence
+            {
+                continue;
+            }
+
+            // Consecutive sequences are mostly in the same chunk.
+            if (chunkId != lastChunkId)
+            {
+                std::lock_guard<std::mutex> lock(m_parent->m_weakChunkTableMutexes[deserializerIndex]);
+                secondaryChunk = chunkTable[chunkId].lock();
                 if (!secondaryChunk)
                 {
-                    secondaryChunk = deserializers[deserializerIndex]->GetChunk(s.m_chunkId);
-                    chunkTable[s.m_chunkId] = secondaryChunk;
+                    secondaryChunk = deserializer->GetChunk(chunkId);
+                    chunkTable[chunkId] = secondaryChunk;
                 }
-
-                m_innerChunks[currentIndex] = secondaryChunk;
+                lastChunkId = chunkId;
             }
+
+            m_innerChunks[currentIndex] = secondaryChunk;
         }
     }
 
@@ -8,6 +8,8 @@
 #include "DataDeserializer.h"
 #include "DataDeserializerBase.h"
 #include "Config.h"
+#include <mutex>
+#include <vector>
 
 namespace Microsoft { namespace MSR { namespace CNTK {
 
@@ -63,6 +65,10 @@ private:
     // Inner vector is the table of chunk id into weak pointer, the outer vector has an element per deserializer.
     std::vector<std::vector<std::weak_ptr<Chunk>>> m_weakChunkTable;
 
+    // Guard the tables of m_weakChunkTable, one per deserializer, chunks can be requested from several threads.
+    // The chunks of different deserializers are loaded in parallel.
+    std::vector<std::mutex> m_weakChunkTableMutexes;
+
     // General configuration
     int m_verbosity;
 };
@@ -5,22 +5,128 @@
 
 #define _CRT_SECURE_NO_WARNINGS
 
+#define __STDC_FORMAT_MACROS
+#include <inttypes.h>
 #include "ChunkCache.h"
+#include "ElementTypeUtils.h"
 
 namespace Microsoft { namespace MSR { namespace CNTK {
 
+ChunkCache::ChunkCache(IDataDeserializerPtr deserializer, size_t memoryBudgetInBytes, ChunkCacheEvictionPolicy policy, int verbosity)
+    : m_deserializer(deserializer),
+      m_memoryBudgetInBytes(memoryBudgetInBytes),
+      m_policy(policy),
+      m_verbosity(verbosity),
+      m_sweep(0)
+{
+    m_streams = m_deserializer->GetStreamDescriptions();
+}
+
 ChunkPtr ChunkCache::GetChunk(ChunkIdType chunkId)
 {
-    auto it = m_chunkMap.find(chunkId);
-    if (it != m_chunkMap.end())
     {
-        return it->second;
+        std::lock_guard<std::mutex> lock(m_mutex);
+
+        // A chunk requested for the second time means the randomizer has started a new sweep.
+        auto lastRequest = m_lastRequestSweep.find(chunkId);
+        if (lastRequest != m_lastRequestSweep.end() && lastRequest->second == m_sweep)
+        {
+            if (m_verbosity > 0)
+                fprintf(stderr, "ChunkCache: sweep %" PRIu64 ": %" PRIu64 " hits, %" PRIu64 " misses, %" PRIu64 " evictions, %" PRIu64 " chunks (%" PRIu64 " MB) cached\n",
+                        m_sweep, m_statistics.m_numHits, m_statistics.m_numMisses, m_statistics.m_numEvictions,
+                        m_statistics.m_numCachedChunks, m_statistics.m_cachedBytes >> 20);
+            m_sweep++;
+        }
+        m_lastRequestSweep[chunkId] = m_sweep;
+
+        auto it = m_chunkMap.find(chunkId);
+        if (it != m_chunkMap.end())
+        {
+            m_statistics.m_numHits++;
+            m_lruList.splice(m_lruList.begin(), m_lruList, it->second.m_lru);
+            return it->second.m_chunk;
+        }
+
+        m_statistics.m_numMisses++;
     }
- 
+
+    // Loading without holding the lock, other chunks can be served meanwhile.
     ChunkPtr chunk = m_deserializer->GetChunk(chunkId);
-    m_chunkMap[chunkId] = chunk;
- 
+    size_t sizeInBytes = m_memoryBudgetInBytes == SIZE_MAX ? 0 : EstimateChunkSize(chunkId, chunk);
+
+    std::lock_guard<std::mutex> lock(m_mutex);
+    if (sizeInBytes > m_memoryBudgetInBytes || m_chunkMap.find(chunkId) != m_chunkMap.end())
+        return chunk;
+
+    MakeRoom(sizeInBytes);
+    m_lruList.push_front(chunkId);
+    m_chunkMap[chunkId] = CachedChunk{ chunk, sizeInBytes, m_lruList.begin() };
+    m_statistics.m_numCachedChunks++;
+    m_statistics.m_cachedBytes += sizeInBytes;
     return chunk;
 }
 
+void ChunkCache::MakeRoom(size_t bytes)
+{
+    while (!m_lruList.empty() && m_statistics.m_cachedBytes + bytes > m_memoryBudgetInBytes)
+    {
+        // The least recently used chunk, unless a chunk already used in this sweep is to be evicted first.
+        auto victim = std::prev(m_lruList.end());
+        if (m_policy == ChunkCacheEvictionPolicy::Sweep)
+        {
+            for (auto candidate = m_lruList.rbegin(); candidate != m_lruList.rend(); ++candidate)
+            {
+                if (m_lastRequestSweep[*candidate] == m_sweep)
+                {
+                    victim = std::prev(candidate.base());
+                    break;
+                }
+            }
+        }
+
+        auto cached = m_chunkMap.find(*victim);
+        m_statistics.m_cachedBytes -= cached->second.m_sizeInBytes;
+        m_statistics.m_numCachedChunks--;
+        m_statistics.m_numEvictions++;
+        m_chunkMap.erase(cached);
+        m_lruList.erase(victim);
+    }
+}
+
+size_t ChunkCache::EstimateChunkSize(ChunkIdType chunkId, const ChunkPtr& chunk)
+{
+    std::vector<SequenceDescription> sequences;
+    m_deserializer->GetSequencesForChunk(chunkId, sequences);
+
+    size_t sizeInBytes = 0;
+    std::vector<SequenceDataPtr> data;
+    for (const auto& sequence : sequences)
+    {
+        data.clear();
+        chunk->GetSequence(sequence.m_id, data);
+        for (size_t i = 0; i < data.size() && i < m_streams.size(); ++i)
+        {
+            size_t elementSize = GetSizeByType(m_streams[i]->m_elementType);
+            if (m_streams[i]->m_storageType == StorageType::sparse_csc)
+            {
+                auto sparse = std::static_pointer_cast<SparseSequenceData>(data[i]);
+                sizeInBytes += sparse->m_totalNnzCount * (elementSize + sizeof(IndexType)) + sparse->m_nnzCounts.size() * sizeof(IndexType);
+            }
+            else
+            {
+                auto layout = data[i]->m_sampleLayout ? data[i]->m_sampleLayout : m_streams[i]->m_sampleLayout;
+                sizeInBytes += data[i]->m_numberOfSamples * layout->GetNumElements() * elementSize;
+            }
+        }
+    }
+
+    return sizeInBytes;
+}
+
+ChunkCache::Statistics ChunkCache::GetStatistics() const
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return m_statistics;
+}
+
 } } }
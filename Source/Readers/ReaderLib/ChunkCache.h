@@ -5,22 +5,49 @@
 
 #pragma once
 
+#include <list>
 #include <map>
+#include <mutex>
 #include "DataDeserializer.h"
 
 namespace Microsoft { namespace MSR { namespace CNTK {
 
-// A cache to store the complete dataset (all chunks) in memory. The caching can
-// be switched on/off by a boolean flag in the reader config section, independent 
-// of the randomization and chunking parameters. The caching should only be enabled 
-// when the whole dataset fits in memory.
-// Implemented as a wrapping proxy around a deserializer that stores pointers to
-// all chunks it sees in an internal map.
+// Decides which chunk leaves the cache when the memory budget is exceeded.
+enum class ChunkCacheEvictionPolicy
+{
+    // Least recently used chunk first.
+    LeastRecentlyUsed,
+
+    // The randomizer requests each chunk once per sweep, so a chunk already used in the current
+    // sweep will not be needed before the next one, while a chunk not used yet will be needed soon.
+    // Chunks used in the current sweep are evicted first (least recently used among them), then the rest by LRU.
+    // The start of a sweep is detected when a chunk is requested for the second time.
+    Sweep,
+};
+
+// A cache for chunks of the dataset. The caching can be switched on/off by a boolean flag in the
+// reader config section, independent of the randomization and chunking parameters.
+// Without a memory budget the cache keeps every chunk it sees, so it should only be used when the
+// whole dataset fits in memory. With a budget, chunks are evicted according to the eviction policy
+// once the estimated size of the cached chunks exceeds it. Chunks still held by the randomizer stay
+// in memory after eviction, so the budget does not include the current randomization window.
+// Implemented as a wrapping proxy around a deserializer.
 class ChunkCache : public IDataDeserializer
 {
 public:
+    struct Statistics
+    {
+        size_t m_numHits = 0;
+        size_t m_numMisses = 0;
+        size_t m_numEvictions = 0;
+        size_t m_numCachedChunks = 0;
+        size_t m_cachedBytes = 0; // estimated size of the cached chunks
+    };
 
-    ChunkCache(IDataDeserializerPtr deserializer) : m_deserializer(deserializer) { }
+    ChunkCache(IDataDeserializerPtr deserializer,
+        size_t memoryBudgetInBytes = SIZE_MAX,
+        ChunkCacheEvictionPolicy policy = ChunkCacheEvictionPolicy::Sweep,
+        int verbosity = 0);
 
     virtual std::vector<StreamDescriptionPtr> GetStreamDescriptions() const override
     {
@@ -45,10 +72,58 @@ public:
     // Gets chunk data given its id.
     virtual ChunkPtr GetChunk(ChunkIdType chunkId);
 
+    Statistics GetStatistics() const;
+
+    // Returns the budget in bytes for the given config value in megabytes, 0 meaning no budget.
+    static size_t GetMemoryBudgetInBytes(size_t budgetInMB)
+    {
+        return budgetInMB == 0 ? SIZE_MAX : budgetInMB << 20;
+    }
+
+    // Parses the eviction policy config value: 'sweep' or 'lru'.
+    static ChunkCacheEvictionPolicy ParseEvictionPolicy(const std::wstring& policy)
+    {
+        if (policy == L"sweep")
+            return ChunkCacheEvictionPolicy::Sweep;
+        if (policy == L"lru")
+            return ChunkCacheEvictionPolicy::LeastRecentlyUsed;
+        InvalidArgument("Unknown chunk cache eviction policy '%ls', expected 'sweep' or 'lru'.", policy.c_str());
+    }
+
 private:
-    // A map of currently loaded chunks
-    std::map<size_t, ChunkPtr> m_chunkMap;
+    struct CachedChunk
+    {
+        ChunkPtr m_chunk;
+        size_t m_sizeInBytes;
+        std::list<ChunkIdType>::iterator m_lru; // position in m_lruList
+    };
+
+    // Estimates the memory taken by the chunk from the sizes of its sequences.
+    size_t EstimateChunkSize(ChunkIdType chunkId, const ChunkPtr& chunk);
+
+    // Evicts chunks till 'bytes' more fit into the budget.
+    void MakeRoom(size_t bytes);
+
+    // A map of currently cached chunks.
+    std::map<ChunkIdType, CachedChunk> m_chunkMap;
+
+    // Cached chunk ids, most recently used first.
+    std::list<ChunkIdType> m_lruList;
+
     IDataDeserializerPtr m_deserializer;
+    std::vector<StreamDescriptionPtr> m_streams;
+    size_t m_memoryBudgetInBytes;
+    ChunkCacheEvictionPolicy m_policy;
+    int m_verbosity;
+
+    // Current sweep as seen from the requests, and the last sweep each chunk was requested in.
+    size_t m_sweep;
+    std::map<ChunkIdType, size_t> m_lastRequestSweep;
+
+    Statistics m_statistics;
+
+    // Chunks can be requested from several threads (see BlockRandomizer).
+    mutable std::mutex m_mutex;
 
     DISABLE_COPY_AND_MOVE(ChunkCache);
 };
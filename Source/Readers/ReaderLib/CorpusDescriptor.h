@@ -92,6 +92,12 @@ public:
         return m_sequenceIds.find(id) != m_sequenceIds.end();
     }
 
+    // True if all sequences are used for reading.
+    bool IsIncludingAll() const
+    {
+        return m_includeAll;
+    }
+
     std::function<size_t(const std::string&)> KeyToId;
     std::function<std::string(size_t)> IdToKey;
 
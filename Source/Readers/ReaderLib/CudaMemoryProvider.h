@@ -7,27 +7,67 @@
 
 #include <memory>
 #include <CUDAPageLockedMemAllocator.h>
+#include <CachingBlockAllocator.h>
 
+#include "Basics.h"
 #include "MemoryProvider.h"
 
 namespace Microsoft { namespace MSR { namespace CNTK {
 
+// Pool of page-locked host buffers for a single device. Allocating and freeing page-locked memory
+// (cudaHostAlloc()/cudaFreeHost()) is expensive and cudaFreeHost() synchronizes the device, so staging buffers
+// that are dropped when a packer buffer grows or an epoch starts are kept here and handed out again.
+typedef CachingBlockAllocator PinnedMemoryPool;
+typedef std::shared_ptr<PinnedMemoryPool> PinnedMemoryPoolPtr;
+
 /// TODO: Memory provider should reside on the matrix. It is responsibility of the network
 /// to decide what memory to use per stream. This class will be moved in the near future.
 class CudaMemoryProvider : public MemoryProvider
 {
-    std::unique_ptr<CUDAPageLockedMemAllocator> m_allocator;
+    PinnedMemoryPoolPtr m_pool;
 
 public:
-    CudaMemoryProvider(int deviceId)
+    CudaMemoryProvider(int deviceId) : CudaMemoryProvider(CreatePinnedMemoryPool(deviceId))
+    {
+    }
+
+    // Several providers (e.g. one per stream) can share the pool of the device.
+    explicit CudaMemoryProvider(PinnedMemoryPoolPtr pool) : m_pool(pool)
     {
-        m_allocator = std::make_unique<CUDAPageLockedMemAllocator>(deviceId);
+        if (!m_pool)
+            LogicError("CudaMemoryProvider: no page-locked memory pool given.");
+    }
+
+    static PinnedMemoryPoolPtr CreatePinnedMemoryPool(int deviceId)
+    {
+        return std::make_shared<PinnedMemoryPool>(
+            [deviceId](size_t size) -> void*
+            {
+                // The pool expects a null pointer, not an exception, when memory is exhausted.
+                try
+                {
+                    return CUDAPageLockedMemAllocator::Malloc(size, deviceId);
+                }
+                catch (const std::exception&)
+                {
+                    return nullptr;
+                }
+            },
+            [deviceId](void* p)
+            {
+                CUDAPageLockedMemAllocator::Free(p, deviceId);
+            });
     }
 
     virtual void* Alloc(size_t elementSize, size_t numberOfElements) override
     {
         size_t totalSize = elementSize * numberOfElements;
-        return m_allocator->Malloc(totalSize);
+        // Host memory is not tied to a stream; the packer only reuses a buffer after its copy to the device
+        // has completed, so all blocks go into the same free list.
+        void* p = m_pool->Allocate(totalSize, nullptr);
+        if (!p)
+            RuntimeError("CudaMemoryProvider: failed to allocate %zu bytes of page-locked memory.", totalSize);
+        return p;
     }
 
     virtual void Free(void* p) override
@@ -37,7 +77,8 @@ public:
             return;
         }
 
-        m_allocator->Free(reinterpret_cast<char*>(p));
+        if (!m_pool->Free(p))
+            LogicError("CudaMemoryProvider: attempt to free memory that was not allocated by this provider.");
     }
 };
 } } }
@@ -7,6 +7,7 @@
 
 #include <vector>
 #include "Reader.h"
+#include "PooledMemoryProvider.h"
 
 namespace Microsoft { namespace MSR { namespace CNTK {
 
@@ -91,7 +92,7 @@ typedef std::shared_ptr<DenseSequenceData> DenseSequenceDataPtr;
 struct SparseSequenceData : SequenceDataBase
 {
     IndexType* m_indices; // an index for every value in the m_data array
-    std::vector<IndexType> m_nnzCounts; // nnz count for each sample in the sequence
+    PooledVector<IndexType> m_nnzCounts; // nnz count for each sample in the sequence
     IndexType m_totalNnzCount; // sum of all nzzCounts of all samples
     // Using IndexType for both properties above since the nnzCount should fit inside
     // the index type (in CSC format, the last value in the column index array == nnzCount)
@@ -18,6 +18,8 @@ inline size_t GetSizeByType(ElementType type)
         return sizeof(float);
     case ElementType::tdouble:
         return sizeof(double);
+    case ElementType::tuchar:
+        return sizeof(unsigned char);
     default:
         RuntimeError("Unsupported type '%d'", static_cast<int>(type));
     }
@@ -40,7 +40,7 @@ Sequences FramePacker::GetNextSequences()
     result.m_data.resize(m_inputStreamDescriptions.size());
     while (localMinibatchSize > 0 && !result.m_endOfEpoch)
     {
-        auto s = m_sequenceEnumerator->GetNextSequences(localMinibatchSize);
+        auto s = FetchSequences(localMinibatchSize);
         result.m_endOfEpoch = s.m_endOfEpoch;
 
         if (s.m_data.empty()) // Iterate till we find some data for us.
@@ -0,0 +1,251 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE.md file in the project root for full license information.
+//
+
+#define _CRT_SECURE_NO_WARNINGS
+
+#define __STDC_FORMAT_MACROS
+#include <inttypes.h>
+#include "FrameRandomizer.h"
+#include <algorithm>
+
+namespace Microsoft { namespace MSR { namespace CNTK {
+
+    // Mixes the bits of a value (the finalizer of splitmix64).
+    static uint64_t MixBits(uint64_t value)
+    {
+        value = (value ^ (value >> 30)) * 0xbf58476d1ce4e5b9ull;
+        value = (value ^ (value >> 27)) * 0x94d049bb133111ebull;
+        return value ^ (value >> 31);
+    }
+
+    static const size_t NumberOfFeistelRounds = 4;
+
+    FeistelPermutation::FeistelPermutation(size_t size, uint64_t key)
+        : m_size(size), m_key(key)
+    {
+        unsigned int bits = 2;
+        while (bits < 64 && ((uint64_t)1 << bits) < size)
+        {
+            bits += 2;
+        }
+
+        m_halfBits = bits / 2;
+        m_halfMask = ((uint64_t)1 << m_halfBits) - 1;
+    }
+
+    uint64_t FeistelPermutation::Round(uint64_t value, size_t round) const
+    {
+        return MixBits(value + m_key + (round + 1) * 0x9e3779b97f4a7c15ull) & m_halfMask;
+    }
+
+    size_t FeistelPermutation::operator()(size_t position) const
+    {
+        assert(position < m_size);
+
+        // Every value in [0, m_size) is reached from a value in [0, m_size), so walking the cycle of the permutation of
+        // the larger range until we are back inside is a permutation of [0, m_size).
+        uint64_t value = position;
+        do
+        {
+            uint64_t left = value >> m_halfBits;
+            uint64_t right = value & m_halfMask;
+            for (size_t round = 0; round < NumberOfFeistelRounds; ++round)
+            {
+                uint64_t next = left ^ Round(right, round);
+                left = right;
+                right = next;
+            }
+            value = (left << m_halfBits) | right;
+        } while (value >= m_size);
+
+        return (size_t)value;
+    }
+
+    FrameRandomizer::FrameRandomizer(
+        int verbosity,
+        size_t randomizationRangeInSamples,
+        IDataDeserializerPtr deserializer,
+        ChunkRandomizerPtr chunkRandomizer)
+        : m_verbosity(verbosity),
+        m_randomizationRangeInSamples(randomizationRangeInSamples),
+        m_deserializer(deserializer),
+        m_chunkRandomizer(chunkRandomizer),
+        m_currentFramePosition(0),
+        m_seed(SIZE_MAX)
+    {
+    }
+
+    // Resets the current sweep according to the randomization seed provided.
+    void FrameRandomizer::Reset(size_t seed)
+    {
+        m_seed = seed;
+        m_currentFramePosition = 0;
+        m_sequenceIds.clear();
+        m_firstSequenceIds.clear();
+
+        // Group the randomized chunks into blocks of at least the randomization range.
+        const auto& chunks = m_chunkRandomizer->GetRandomizedChunks();
+        m_blocks.clear();
+        for (ChunkIdType i = 0; i < chunks.size();)
+        {
+            Block block;
+            block.m_chunks.m_begin = i;
+            block.m_framePositionStart = chunks[i].m_sequencePositionStart;
+            block.m_numberOfFrames = 0;
+            while (i < chunks.size() && (block.m_numberOfFrames == 0 || block.m_numberOfFrames < m_randomizationRangeInSamples))
+            {
+                block.m_numberOfFrames += chunks[i].m_original->m_numberOfSequences;
+                i++;
+            }
+            block.m_chunks.m_end = i;
+            m_blocks.push_back(block);
+        }
+
+        // A short last block is permuted together with the one before it.
+        if (m_blocks.size() > 1 && m_blocks.back().m_numberOfFrames < m_randomizationRangeInSamples / 2)
+        {
+            Block last = m_blocks.back();
+            m_blocks.pop_back();
+            m_blocks.back().m_chunks.m_end = last.m_chunks.m_end;
+            m_blocks.back().m_numberOfFrames += last.m_numberOfFrames;
+        }
+
+        for (size_t i = 0; i < m_blocks.size(); ++i)
+        {
+            m_blocks[i].m_permutation = FeistelPermutation(m_blocks[i].m_numberOfFrames, MixBits(MixBits(seed) + i));
+        }
+
+        if (m_verbosity)
+            fprintf(stderr,
+                "FrameRandomizer::Reset(): "
+                "randomizing %" PRIu64 " chunks in %" PRIu64 " blocks for sweep %" PRIu64 "\n",
+                chunks.size(),
+                m_blocks.size(),
+                seed);
+    }
+
+    // Sets the current cursor to the given sample offset, which is a frame position.
+    size_t FrameRandomizer::Seek(size_t sweepSampleOffset, size_t sweep)
+    {
+        if (m_seed != sweep)
+        {
+            Reset(sweep);
+        }
+
+        size_t numberOfFrames = m_blocks.empty() ? 0 : m_blocks.back().m_framePositionStart + m_blocks.back().m_numberOfFrames;
+        m_currentFramePosition = std::min(sweepSampleOffset, numberOfFrames);
+
+        if (m_verbosity)
+            fprintf(stderr, "FrameRandomizer::Seek(): seeking offset %" PRIu64 " in sweep %" PRIu64 "\n",
+                sweepSampleOffset,
+                sweep);
+
+        return m_currentFramePosition;
+    }
+
+    // Gets next randomized sequence descriptions not exceeding the sample count.
+    std::vector<RandomizedSequenceDescription> FrameRandomizer::GetNextSequenceDescriptions(size_t sampleCount, ClosedOpenChunkInterval& requiredChunks)
+    {
+        std::vector<RandomizedSequenceDescription> result;
+        size_t numberOfFrames = m_blocks.empty() ? 0 : m_blocks.back().m_framePositionStart + m_blocks.back().m_numberOfFrames;
+        if (numberOfFrames == 0)
+        {
+            return result;
+        }
+
+        const auto& chunks = m_chunkRandomizer->GetRandomizedChunks();
+        size_t blockIndex = GetBlockForFramePosition(std::min(m_currentFramePosition, numberOfFrames - 1));
+        requiredChunks = m_blocks[blockIndex].m_chunks;
+
+        // Sequence ids of the chunks of earlier blocks are not needed anymore.
+        m_sequenceIds.erase(m_sequenceIds.begin(), m_sequenceIds.lower_bound(requiredChunks.m_begin));
+        m_firstSequenceIds.erase(m_firstSequenceIds.begin(), m_firstSequenceIds.lower_bound(requiredChunks.m_begin));
+
+        size_t count = std::min(sampleCount, numberOfFrames - m_currentFramePosition);
+        result.reserve(count);
+        for (size_t i = 0; i < count; ++i, ++m_currentFramePosition)
+        {
+            while (m_currentFramePosition >= m_blocks[blockIndex].m_framePositionStart + m_blocks[blockIndex].m_numberOfFrames)
+            {
+                blockIndex++;
+                requiredChunks.m_end = m_blocks[blockIndex].m_chunks.m_end;
+            }
+
+            const Block& block = m_blocks[blockIndex];
+            size_t framePosition = block.m_framePositionStart + block.m_permutation(m_currentFramePosition - block.m_framePositionStart);
+
+            // The chunk of the block that contains the frame.
+            auto chunk = std::upper_bound(
+                chunks.begin() + block.m_chunks.m_begin,
+                chunks.begin() + block.m_chunks.m_end,
+                framePosition,
+                [](size_t fp, const RandomizedChunk& c) { return fp < c.m_sequencePositionStart; }) - 1;
+            ChunkIdType chunkIndex = (ChunkIdType)(chunk - chunks.begin());
+
+            RandomizedSequenceDescription sequence;
+            sequence.m_id = GetSequenceId(chunkIndex, framePosition - chunk->m_sequencePositionStart);
+            sequence.m_chunk = &*chunk;
+            sequence.m_numberOfSamples = 1;
+            result.push_back(sequence);
+        }
+
+        return result;
+    }
+
+    // Gets the block that contains a frame position in the sweep.
+    size_t FrameRandomizer::GetBlockForFramePosition(size_t framePosition) const
+    {
+        auto result = std::upper_bound(
+            m_blocks.begin(),
+            m_blocks.end(),
+            framePosition,
+            [](size_t fp, const Block& b) { return fp < b.m_framePositionStart; });
+        return result - 1 - m_blocks.begin();
+    }
+
+    // Gets the sequence id of a frame of a randomized chunk, getting the sequences of the chunk from the deserializer
+    // the first time the chunk is needed in the blocks of the current minibatch.
+    size_t FrameRandomizer::GetSequenceId(ChunkIdType chunkIndex, size_t frameInChunk)
+    {
+        auto first = m_firstSequenceIds.find(chunkIndex);
+        if (first == m_firstSequenceIds.end())
+        {
+            const RandomizedChunk& chunk = m_chunkRandomizer->GetRandomizedChunks()[chunkIndex];
+            m_bufferOriginalSequences.clear();
+            m_deserializer->GetSequencesForChunk(chunk.m_original->m_id, m_bufferOriginalSequences);
+            if (m_bufferOriginalSequences.size() != chunk.m_original->m_numberOfSequences)
+            {
+                LogicError("FrameRandomizer: chunk %u has %" PRIu64 " sequences instead of %" PRIu64 ".",
+                    chunk.m_original->m_id, m_bufferOriginalSequences.size(), chunk.m_original->m_numberOfSequences);
+            }
+
+            bool consecutive = true;
+            for (size_t k = 0; k < m_bufferOriginalSequences.size(); ++k)
+            {
+                if (m_bufferOriginalSequences[k].m_numberOfSamples != 1)
+                {
+                    RuntimeError("FrameRandomizer: frame randomization requires sequences of a single sample, chunk %u has a sequence of %u samples.",
+                        chunk.m_original->m_id, m_bufferOriginalSequences[k].m_numberOfSamples);
+                }
+
+                consecutive = consecutive && m_bufferOriginalSequences[k].m_id == m_bufferOriginalSequences[0].m_id + k;
+            }
+
+            first = m_firstSequenceIds.insert(std::make_pair(chunkIndex, m_bufferOriginalSequences.empty() ? 0 : m_bufferOriginalSequences[0].m_id)).first;
+            if (!consecutive)
+            {
+                auto& ids = m_sequenceIds[chunkIndex];
+                ids.reserve(m_bufferOriginalSequences.size());
+                for (const auto& s : m_bufferOriginalSequences)
+                {
+                    ids.push_back(s.m_id);
+                }
+            }
+        }
+
+        auto ids = m_sequenceIds.find(chunkIndex);
+        return ids == m_sequenceIds.end() ? first->second + frameInChunk : ids->second[frameInChunk];
+    }
+}}}
@@ -0,0 +1,102 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE.md file in the project root for full license information.
+//
+
+#pragma once
+
+#include <vector>
+#include <map>
+
+#include "DataDeserializer.h"
+#include "ChunkRandomizer.h"
+#include "SequenceRandomizer.h"
+
+namespace Microsoft { namespace MSR { namespace CNTK {
+
+// A pseudo-random bijection of [0, size) onto itself, given by a Feistel network over the smallest even number of
+// bits that covers 'size'; values outside the range are mapped again until they fall inside it (cycle walking).
+// It needs no memory, and each value is mapped in constant expected time.
+class FeistelPermutation
+{
+public:
+    FeistelPermutation(size_t size = 0, uint64_t key = 0);
+
+    size_t operator()(size_t position) const;
+
+private:
+    uint64_t Round(uint64_t value, size_t round) const;
+
+    size_t m_size;
+    uint64_t m_key;
+    unsigned int m_halfBits;
+    uint64_t m_halfMask;
+};
+
+// Randomizes the frames of a deserializer whose sequences are all single frames (frame mode), without keeping a
+// description of each frame in the window as SequenceRandomizer does.
+// The randomized chunks are grouped into consecutive blocks of about the size of the randomization window. Each block
+// is read in the order of a FeistelPermutation of its frames, keyed by the sweep and the block, so a position in the sweep
+// is mapped to a frame by one permutation and one binary search over the chunks of its block. Only the chunks of the
+// blocks of the current minibatch are required.
+// Sequence ids inside a chunk are only kept for chunks whose ids are not consecutive, which deserializers rarely produce.
+class FrameRandomizer
+{
+public:
+    FrameRandomizer(
+        int verbosity,
+        size_t randomizationRangeInSamples,
+        IDataDeserializerPtr deserializer,
+        ChunkRandomizerPtr chunkRandomizer);
+
+    // Resets the current sweep according to the randomization seed provided.
+    void Reset(size_t seed);
+
+    // Sets the current cursor to the given sample offset, and returns it (or the end of the sweep).
+    size_t Seek(size_t sweepSampleOffset, size_t sweep);
+
+    // Gets the next randomized sequence descriptions not exceeding the sample count.
+    std::vector<RandomizedSequenceDescription> GetNextSequenceDescriptions(size_t sampleCount, ClosedOpenChunkInterval& requiredChunks);
+
+private:
+    DISABLE_COPY_AND_MOVE(FrameRandomizer);
+
+    // A block of consecutive randomized chunks whose frames are permuted among each other.
+    struct Block
+    {
+        ClosedOpenChunkInterval m_chunks;
+        size_t m_framePositionStart; // of the first frame of the block in the sweep
+        size_t m_numberOfFrames;
+        FeistelPermutation m_permutation;
+    };
+
+    // Gets the block that contains a frame position in the sweep.
+    size_t GetBlockForFramePosition(size_t framePosition) const;
+
+    // Gets the sequence id of a frame of a randomized chunk.
+    size_t GetSequenceId(ChunkIdType chunkIndex, size_t frameInChunk);
+
+    IDataDeserializerPtr m_deserializer;
+    ChunkRandomizerPtr m_chunkRandomizer;
+    size_t m_randomizationRangeInSamples;
+
+    // Blocks of the current sweep.
+    std::vector<Block> m_blocks;
+
+    // Sequence ids of the frames of the randomized chunks needed so far in the current blocks, by randomized chunk index;
+    // empty if the ids are consecutive, in which case m_firstSequenceIds holds the first one.
+    std::map<ChunkIdType, std::vector<size_t>> m_sequenceIds;
+    std::map<ChunkIdType, size_t> m_firstSequenceIds;
+
+    // Used only as a buffer to get sequence descriptions without memory reallocation.
+    std::vector<SequenceDescription> m_bufferOriginalSequences;
+
+    // Position of the next frame to return in the sweep.
+    size_t m_currentFramePosition;
+    size_t m_seed;
+
+    int m_verbosity;
+};
+
+typedef std::shared_ptr<FrameRandomizer> FrameRandomizerPtr;
+}}}
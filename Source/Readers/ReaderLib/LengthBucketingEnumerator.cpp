@@ -0,0 +1,168 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE.md file in the project root for full license information.
+//
+
+#define _CRT_SECURE_NO_WARNINGS
+
+#include <algorithm>
+#include <numeric>
+#include "LengthBucketingEnumerator.h"
+
+namespace Microsoft { namespace MSR { namespace CNTK {
+
+LengthBucketingEnumerator::LengthBucketingEnumerator(SequenceEnumeratorPtr sequenceProvider, size_t windowInMinibatches, int verbosity)
+    : m_sequenceProvider(sequenceProvider),
+      m_windowInMinibatches(windowInMinibatches),
+      m_verbosity(verbosity)
+{
+    assert(m_sequenceProvider != nullptr);
+    if (m_windowInMinibatches == 0)
+        InvalidArgument("LengthBucketingEnumerator: the bucketing window has to contain at least one minibatch.");
+    Reset(0);
+}
+
+void LengthBucketingEnumerator::Reset(size_t seed)
+{
+    m_buckets.clear();
+    m_bucketSamples.clear();
+    m_windowChunks.clear();
+    m_bufferedSamples = 0;
+    m_providerEndOfEpoch = false;
+    m_transformSeconds = 0;
+    m_rng.seed(seed);
+}
+
+void LengthBucketingEnumerator::StartEpoch(const EpochConfiguration& config)
+{
+    m_sequenceProvider->StartEpoch(config);
+    Reset(m_sequenceProvider->GetCurrentSamplePosition());
+}
+
+void LengthBucketingEnumerator::SetConfiguration(const ReaderConfiguration& config)
+{
+    // The sequences already taken from the provider are kept, the new minibatch size applies to the next window.
+    m_sequenceProvider->SetConfiguration(config);
+    m_providerEndOfEpoch = false;
+}
+
+void LengthBucketingEnumerator::SetCurrentSamplePosition(size_t currentSamplePosition)
+{
+    m_sequenceProvider->SetCurrentSamplePosition(currentSamplePosition);
+    Reset(m_sequenceProvider->GetCurrentSamplePosition());
+}
+
+size_t LengthBucketingEnumerator::GetCurrentSamplePosition()
+{
+    size_t position = m_sequenceProvider->GetCurrentSamplePosition();
+    return position > m_bufferedSamples ? position - m_bufferedSamples : 0;
+}
+
+size_t LengthBucketingEnumerator::GetSequenceLength(const Bucket& sequences, size_t index)
+{
+    size_t length = 0;
+    for (const auto& stream : sequences)
+        length = std::max<size_t>(length, stream[index]->m_numberOfSamples);
+    return length;
+}
+
+Sequences LengthBucketingEnumerator::GetNextSequences(size_t sampleCount)
+{
+    if (m_buckets.empty() && !m_providerEndOfEpoch)
+        FillBuckets(sampleCount);
+
+    Sequences result;
+    if (!m_buckets.empty())
+    {
+        result.m_data = std::move(m_buckets.back());
+        m_buckets.pop_back();
+        m_bufferedSamples -= m_bucketSamples.back();
+        m_bucketSamples.pop_back();
+        result.m_chunks = m_windowChunks;
+    }
+
+    result.m_endOfEpoch = m_providerEndOfEpoch && m_buckets.empty();
+    result.m_transformSeconds = m_transformSeconds;
+    m_transformSeconds = 0;
+    return result;
+}
+
+void LengthBucketingEnumerator::FillBuckets(size_t sampleCount)
+{
+    assert(m_buckets.empty());
+
+    // The packer is done with the sequences of the previous window.
+    m_windowChunks.clear();
+
+    // Sequences of the window, indexed by stream id, then by sequence.
+    Bucket window;
+    size_t numMinibatches = 0;
+    while (numMinibatches < m_windowInMinibatches && !m_providerEndOfEpoch)
+    {
+        Sequences sequences = m_sequenceProvider->GetNextSequences(sampleCount);
+        m_providerEndOfEpoch = sequences.m_endOfEpoch;
+        m_transformSeconds += sequences.m_transformSeconds;
+        m_windowChunks.insert(m_windowChunks.end(), sequences.m_chunks.begin(), sequences.m_chunks.end());
+        numMinibatches++;
+
+        if (sequences.m_data.empty())
+            continue;
+        if (window.empty())
+            window.resize(sequences.m_data.size());
+        for (size_t streamId = 0; streamId < window.size(); ++streamId)
+            window[streamId].insert(window[streamId].end(), sequences.m_data[streamId].begin(), sequences.m_data[streamId].end());
+    }
+
+    if (window.empty() || window.front().empty())
+        return;
+
+    size_t numSequences = window.front().size();
+    std::vector<size_t> lengths(numSequences);
+    for (size_t i = 0; i < numSequences; ++i)
+        lengths[i] = GetSequenceLength(window, i);
+    size_t totalSamples = std::accumulate(lengths.begin(), lengths.end(), (size_t)0);
+
+    std::vector<size_t> order(numSequences);
+    std::iota(order.begin(), order.end(), 0);
+    std::stable_sort(order.begin(), order.end(), [&lengths](size_t a, size_t b) { return lengths[a] < lengths[b]; });
+
+    // Buckets get the average number of samples of the minibatches the sequences came in,
+    // which also accounts for the decimation among the workers in distributed reading.
+    size_t bucketSize = (totalSamples + numMinibatches - 1) / numMinibatches;
+    size_t begin = 0;
+    while (begin < numSequences)
+    {
+        size_t samples = lengths[order[begin]];
+        size_t end = begin + 1;
+        while (end < numSequences && samples + lengths[order[end]] <= bucketSize)
+            samples += lengths[order[end++]];
+
+        Bucket bucket(window.size());
+        for (size_t streamId = 0; streamId < window.size(); ++streamId)
+        {
+            bucket[streamId].reserve(end - begin);
+            for (size_t i = begin; i < end; ++i)
+                bucket[streamId].push_back(window[streamId][order[i]]);
+        }
+        m_buckets.push_back(std::move(bucket));
+        m_bucketSamples.push_back(samples);
+        begin = end;
+    }
+    m_bufferedSamples = totalSamples;
+
+    // Returning the buckets in random order, two vectors shuffled the same way.
+    for (size_t i = m_buckets.size() - 1; i > 0; --i)
+    {
+        size_t j = std::uniform_int_distribution<size_t>(0, i)(m_rng);
+        std::swap(m_buckets[i], m_buckets[j]);
+        std::swap(m_bucketSamples[i], m_bucketSamples[j]);
+    }
+
+    if (m_verbosity > 1)
+    {
+        fprintf(stderr, "LengthBucketingEnumerator: %d sequences of %d to %d samples in %d buckets of %d samples.\n",
+                (int)numSequences, (int)lengths[order.front()], (int)lengths[order.back()], (int)m_buckets.size(), (int)bucketSize);
+    }
+}
+
+}}}
@@ -0,0 +1,80 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE.md file in the project root for full license information.
+//
+
+#pragma once
+
+#include <random>
+#include "SequenceEnumerator.h"
+
+namespace Microsoft { namespace MSR { namespace CNTK {
+
+// Groups sequences of similar length into the same minibatch, so that the minibatch layout
+// built by the packer has less padding.
+// The sequences of 'windowInMinibatches' minibatches are taken from the wrapped enumerator (usually the randomizer),
+// sorted by length and cut into minibatches of about the same number of samples as the ones they came in.
+// These minibatches (buckets) are then returned in random order, so randomness is kept at the level of buckets
+// within the randomization window.
+// The sample position is the one of the wrapped enumerator less the samples not returned yet, so restarting
+// from a checkpoint may return some sequences of the last window of sequences again, but never skips any.
+// Implemented as a wrapper around the sequence enumerator the packer reads from.
+class LengthBucketingEnumerator : public SequenceEnumerator
+{
+public:
+    LengthBucketingEnumerator(SequenceEnumeratorPtr sequenceProvider, size_t windowInMinibatches, int verbosity = 0);
+
+    virtual std::vector<StreamDescriptionPtr> GetStreamDescriptions() const override
+    {
+        return m_sequenceProvider->GetStreamDescriptions();
+    }
+
+    virtual void StartEpoch(const EpochConfiguration& config) override;
+
+    virtual void SetConfiguration(const ReaderConfiguration& config) override;
+
+    virtual void SetCurrentSamplePosition(size_t currentSamplePosition) override;
+
+    virtual size_t GetCurrentSamplePosition() override;
+
+    virtual Sequences GetNextSequences(size_t sampleCount) override;
+
+    virtual bool SetSequenceTransform(const SequenceTransform& transform) override
+    {
+        return m_sequenceProvider->SetSequenceTransform(transform);
+    }
+
+private:
+    // A minibatch of sequences of similar length, indexed by stream id, then by sequence.
+    typedef std::vector<std::vector<SequenceDataPtr>> Bucket;
+
+    // Takes the sequences of the next window from the wrapped enumerator and cuts them into buckets.
+    void FillBuckets(size_t sampleCount);
+
+    void Reset(size_t seed);
+
+    // Length of a sequence in samples, the longest of its streams.
+    static size_t GetSequenceLength(const Bucket& sequences, size_t index);
+
+    SequenceEnumeratorPtr m_sequenceProvider;
+    size_t m_windowInMinibatches;
+    int m_verbosity;
+
+    // Buckets of the current window not returned yet, returned from the back.
+    std::vector<Bucket> m_buckets;
+    std::vector<size_t> m_bucketSamples;
+    size_t m_bufferedSamples;
+
+    // Chunks of the sequences of the current window, keeping their data valid.
+    std::vector<ChunkPtr> m_windowChunks;
+
+    // Whether the wrapped enumerator has reached the end of the epoch.
+    bool m_providerEndOfEpoch;
+
+    // Transform time of the sequences of the current window not accounted yet.
+    double m_transformSeconds;
+
+    std::mt19937_64 m_rng;
+};
+
+}}}
@@ -8,12 +8,15 @@
 
 #include "NoRandomizer.h"
 #include "DataReader.h"
-#include "ExceptionCapture.h"
+#include "CPUThreadPool.h"
 
 namespace Microsoft { namespace MSR { namespace CNTK {
 
-NoRandomizer::NoRandomizer(IDataDeserializerPtr deserializer, bool multithreadedGetNextSequences)
+NoRandomizer::NoRandomizer(IDataDeserializerPtr deserializer, bool multithreadedGetNextSequences,
+                           size_t maxPrefetchedChunks, size_t prefetchWindowInSamples)
     : m_deserializer(deserializer),
+      m_maxPrefetchedChunks(maxPrefetchedChunks),
+      m_prefetchWindowInSamples(prefetchWindowInSamples),
       m_currentChunkPosition(CHUNKID_MAX),
       m_globalSamplePosition(0),
       m_totalNumberOfSamples(0),
@@ -138,27 +141,22 @@ Sequences NoRandomizer::GetNextSequences(size_t sampleCount)
     result.m_data.resize(m_streams.size(), std::vector<SequenceDataPtr>(subsetSize));
 
     // Collect all the chunks that we need
-    std::map<ChunkIdType, ChunkPtr> chunks;
+    std::vector<ChunkIdType> chunkIds;
     for (int i = 0; i < subsetSize; ++i)
     {
-        const auto& sequenceDescription = descriptions[start + i];
-        auto it = chunks.find(sequenceDescription.m_chunkId);
-        if (it == chunks.end())
-        {
-            auto old = m_chunks.find(sequenceDescription.m_chunkId);
-            if (old != m_chunks.end())
-            {
-                chunks.insert(std::make_pair(sequenceDescription.m_chunkId, old->second));
-            }
-            else
-            {
-                chunks[sequenceDescription.m_chunkId] = m_deserializer->GetChunk(sequenceDescription.m_chunkId);
-            }
-        }
+        auto chunkId = descriptions[start + i].m_chunkId;
+        if (chunkIds.empty() || chunkIds.back() != chunkId)
+            chunkIds.push_back(chunkId);
     }
 
     // swap current chunks with new ones:
+    auto chunks = RetrieveChunks(chunkIds);
     m_chunks.swap(chunks);
+    for (const auto& chunk : m_chunks)
+        result.m_chunks.push_back(chunk.second);
+
+    // The following chunks are loaded while the sequences of this minibatch are processed.
+    Prefetch();
 
     auto process = [&](int i) -> void {
         std::vector<SequenceDataPtr> sequence;
@@ -171,6 +169,8 @@ Sequences NoRandomizer::GetNextSequences(size_t sampleCount)
         }
 
         it->second->GetSequence(sequenceDescription.m_id, sequence);
+        if (m_sequenceTransform)
+            m_sequenceTransform(sequence);
         for (int j = 0; j < m_streams.size(); ++j)
         {
             result.m_data[j][i] = sequence[j];
@@ -180,11 +180,12 @@ Sequences NoRandomizer::GetNextSequences(size_t sampleCount)
     // TODO: This will be changed, when we move transformers under the (no-) randomizer, should not deal with multithreading here.
     if (m_multithreadedGetNextSequences)
     {
-        ExceptionCapture capture;
-#pragma omp parallel for schedule(dynamic)
-        for (int i = 0; i < subsetSize; ++i)
-            capture.SafeRun(process, i);
-        capture.RethrowIfHappened();
+        // the thread pool rethrows the first exception of 'process'
+        CPUThreadPool::Instance().ParallelFor(subsetSize, 1, [&](size_t begin, size_t end)
+        {
+            for (size_t i = begin; i < end; ++i)
+                process((int) i);
+        });
     }
     else
     {
@@ -195,6 +196,84 @@ Sequences NoRandomizer::GetNextSequences(size_t sampleCount)
     return result;
 }
 
+std::map<ChunkIdType, ChunkPtr> NoRandomizer::RetrieveChunks(const std::vector<ChunkIdType>& chunkIds)
+{
+    std::map<ChunkIdType, ChunkPtr> chunks;
+    bool missing = false;
+    for (auto id : chunkIds)
+    {
+        auto old = m_chunks.find(id);
+        auto load = m_chunkLoads.find(id);
+        if (old != m_chunks.end())
+        {
+            chunks[id] = old->second;
+        }
+        else if (load != m_chunkLoads.end())
+        {
+            chunks[id] = load->second.get();
+            m_chunkLoads.erase(load);
+        }
+        else
+            missing = true;
+    }
+
+    if (missing)
+    {
+        // The deserializer may not support concurrent loads.
+        for (auto& load : m_chunkLoads)
+            load.second.wait();
+
+        for (auto id : chunkIds)
+        {
+            if (chunks.find(id) == chunks.end())
+                chunks[id] = m_deserializer->GetChunk(id);
+        }
+    }
+    return chunks;
+}
+
+void NoRandomizer::Prefetch()
+{
+    if (m_maxPrefetchedChunks == 0)
+        return;
+
+    // The chunks that follow the cursor, which may be current already if the minibatch ended inside of it.
+    std::vector<ChunkIdType> toPrefetch;
+    size_t numSamples = 0;
+    ChunkIdType id = m_currentChunkPosition;
+    for (size_t i = 0; i < m_chunkDescriptions.size() && toPrefetch.size() < m_maxPrefetchedChunks; ++i)
+    {
+        if (m_chunks.find(id) == m_chunks.end())
+        {
+            numSamples += m_chunkDescriptions[id]->m_numberOfSamples;
+            if (numSamples > m_prefetchWindowInSamples)
+                break;
+            toPrefetch.push_back(id);
+        }
+        id = (ChunkIdType)((id + 1) % m_chunkDescriptions.size());
+    }
+
+    // Loads of chunks that are not needed soon (after a change of the position) are of no use anymore.
+    // They cannot be interrupted, and the deserializer may not support concurrent loads.
+    for (auto load = m_chunkLoads.begin(); load != m_chunkLoads.end();)
+    {
+        if (std::find(toPrefetch.begin(), toPrefetch.end(), load->first) != toPrefetch.end())
+        {
+            ++load;
+            continue;
+        }
+
+        load->second.wait();
+        load = m_chunkLoads.erase(load);
+    }
+
+    for (auto chunkId : toPrefetch)
+    {
+        if (m_chunkLoads.find(chunkId) == m_chunkLoads.end())
+            m_chunkLoads[chunkId] = std::async(std::launch::async, [this, chunkId]() { return m_deserializer->GetChunk(chunkId); });
+    }
+}
+
 void NoRandomizer::SetCurrentSamplePosition(size_t samplePosition)
 {
     m_currentSequencePositionInChunk = 0;
@@ -237,4 +316,12 @@ void NoRandomizer::SetConfiguration(const ReaderConfiguration& config)
     m_config.m_epochIndex = 0;
 }
 
+bool NoRandomizer::SetSequenceTransform(const SequenceTransform& transform)
+{
+    if (!m_multithreadedGetNextSequences)
+        return false;
+    m_sequenceTransform = transform;
+    return true;
+}
+
 } } }
@@ -5,6 +5,8 @@
 
 #pragma once
 
+#include <future>
+#include <map>
 #include <vector>
 #include "SequenceEnumerator.h"
 #include "DataDeserializer.h"
@@ -15,10 +17,15 @@ namespace Microsoft { namespace MSR { namespace CNTK {
 // Used training where the training data has already been pre - randomized.
 // TODO: currently this code moved from the old block randomizer.
 // TODO: The class will be further refactored and common based will be extracted with BlockRandomizer.
+// With maxPrefetchedChunks > 0, the chunks that follow the current minibatch are loaded asynchronously while it is
+// processed, up to maxPrefetchedChunks chunks with at most prefetchWindowInSamples samples in total, so that reading
+// does not stall at every chunk boundary. Loads run in parallel, so with more than one the deserializer has to
+// support concurrent GetChunk() calls for different chunks.
 class NoRandomizer : public SequenceEnumerator
 {
 public:
-    NoRandomizer(IDataDeserializerPtr deserializer, bool multithreadedGetNextSequences = false);
+    NoRandomizer(IDataDeserializerPtr deserializer, bool multithreadedGetNextSequences = false,
+                 size_t maxPrefetchedChunks = 0, size_t prefetchWindowInSamples = SIZE_MAX);
 
     virtual void StartEpoch(const EpochConfiguration& config) override;
     virtual Sequences GetNextSequences(size_t sampleCount) override;
@@ -32,6 +39,8 @@ public:
 
     void SetConfiguration(const ReaderConfiguration& config) override;
 
+    bool SetSequenceTransform(const SequenceTransform& transform) override;
+
 private:
     // Gets next sequence descriptions with total size less than sampleCount.
     std::vector<SequenceDescription> GetNextSequenceDescriptions(size_t sampleCount);
@@ -42,12 +51,21 @@ private:
     // Moves the cursor to the sequence possibly updating the chunk.
     void MoveToNextSequence();
 
+    // Gets the chunks, from the prefetched ones if possible; 'chunkIds' are in the order of the sweep.
+    std::map<ChunkIdType, ChunkPtr> RetrieveChunks(const std::vector<ChunkIdType>& chunkIds);
+
+    // Starts loading the chunks that follow the cursor and are not loaded yet.
+    void Prefetch();
+
     IDataDeserializerPtr m_deserializer;
 
     // Whether to get sequences using multiple thread.
     // TODO temporary; should go away when transformers are moved closer to the deserializer
     bool m_multithreadedGetNextSequences;
 
+    // Applied to each sequence by the thread that gets it, see SetSequenceTransform().
+    SequenceTransform m_sequenceTransform;
+
     // Stream descriptions
     std::vector<StreamDescriptionPtr> m_streams;
 
@@ -64,6 +82,11 @@ private:
     // Current chunk data.
     std::map<ChunkIdType, ChunkPtr> m_chunks;
 
+    // Asynchronous loads of the chunks after the current ones, see Prefetch().
+    std::map<ChunkIdType, std::future<ChunkPtr>> m_chunkLoads;
+    size_t m_maxPrefetchedChunks;
+    size_t m_prefetchWindowInSamples;
+
     // Current chunk data id.
     ChunkIdType m_currentChunkId;
 
@@ -14,8 +14,13 @@ namespace Microsoft { namespace MSR { namespace CNTK {
 using namespace std;
 
 // Resizing the buffer with the current memory provider.
+// When an existing buffer has to grow, some headroom is added so that minibatches of slowly growing size
+// do not cause a reallocation (for page-locked memory, a device synchronization) each time.
 void PackerBase::StreamBuffer::Resize(size_t newSize)
 {
+    if (m_size > 0 && newSize > m_size)
+        newSize += newSize / 4;
+
     m_size = newSize;
     auto provider = m_memoryProvider;
     m_data.reset(reinterpret_cast<char*>(provider->Alloc(1, newSize)),
@@ -75,15 +80,16 @@ PackerBase::PackerBase(SequenceEnumeratorPtr sequenceEnumerator,
         const auto& stream = m_outputStreamDescriptions[i];
         UNUSED(stream);
 
-        // Check the input.
+        // Check the input. Bytes are only packed for streams that are converted on the device.
         if(m_inputStreamDescriptions[i]->m_elementType != ElementType::tdouble &&
-            m_inputStreamDescriptions[i]->m_elementType != ElementType::tfloat)
+            m_inputStreamDescriptions[i]->m_elementType != ElementType::tfloat &&
+            !(m_inputStreamDescriptions[i]->m_elementType == ElementType::tuchar && stream->m_deviceTransform))
         {
             RuntimeError("Please specify the type of the '%ls' stream. You can use 'Cast' transform for that.", m_inputStreamDescriptions[i]->m_name.c_str());
         }
 
         // Input and output should match in everything except for sparse/dense storage type.
-        assert(stream->m_elementType == ElementType::tfloat || stream->m_elementType == ElementType::tdouble);
+        assert(stream->m_elementType == m_inputStreamDescriptions[i]->m_elementType);
         assert(stream->m_name == m_inputStreamDescriptions[i]->m_name);
         assert(stream->m_id == m_inputStreamDescriptions[i]->m_id);
 
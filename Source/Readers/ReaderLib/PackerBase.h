@@ -46,7 +46,7 @@ protected:
     // at the offset equal to value index * elementSize. sampleOffset specifies the offset of the
     // first value from the given sample in the sequence data/indices array (sampleOffset is equal
     // to the sum of non-zero value counts of all preceding samples).
-    void PackSparseSampleAsDense(char* destination, SparseSequenceDataPtr sequence,
+    void PackSparseSampleAsDense(char* destination, SparseSequenceData& sequence,
         size_t sampleIndex, size_t sampleOffset, size_t sampleSize, size_t elementSize);
 
     // Packs a dense sample as dense. Copies sampleSize bytes staring at the sampleOffset from 
@@ -57,7 +57,34 @@ protected:
 
     virtual Sequences GetNextSequences()
     {
-        return m_sequenceEnumerator->GetNextSequences(m_config.m_minibatchSizeInSamples);
+        return FetchSequences(m_config.m_minibatchSizeInSamples);
+    }
+
+    // Gets sequences from the enumerator, accounting the time spent into m_timings.
+    Sequences FetchSequences(size_t sampleCount)
+    {
+        auto start = ReaderStageTimings::Clock::now();
+        Sequences sequences = m_sequenceEnumerator->GetNextSequences(sampleCount);
+        m_timings.m_transformSeconds += sequences.m_transformSeconds;
+        m_timings.m_deserializeSeconds += ReaderStageTimings::SecondsSince(start) - sequences.m_transformSeconds;
+        if (!sequences.m_data.empty())
+            m_timings.m_numSequences += sequences.m_data.front().size();
+        return sequences;
+    }
+
+    // Starts timing a new minibatch.
+    ReaderStageTimings::Clock::time_point StartTimings()
+    {
+        m_timings = ReaderStageTimings();
+        return ReaderStageTimings::Clock::now();
+    }
+
+    // Timings of the minibatch started at 'start'; packing is what is not spent fetching sequences.
+    ReaderStageTimings GetTimings(ReaderStageTimings::Clock::time_point start) const
+    {
+        ReaderStageTimings timings = m_timings;
+        timings.m_packSeconds = ReaderStageTimings::SecondsSince(start) - timings.m_deserializeSeconds - timings.m_transformSeconds;
+        return timings;
     }
 
     SequenceEnumeratorPtr m_sequenceEnumerator;
@@ -89,27 +116,30 @@ protected:
     // Current config.
     ReaderConfiguration m_config;
 
+    // Time spent fetching sequences for the current minibatch.
+    ReaderStageTimings m_timings;
+
 public:
     // Sets current epoch configuration.
     virtual void SetConfiguration(const ReaderConfiguration& config, const std::vector<MemoryProviderPtr>& memoryProviders) override;
 };
 
-inline void PackerBase::PackSparseSampleAsDense(char* destination, SparseSequenceDataPtr sequence,
+inline void PackerBase::PackSparseSampleAsDense(char* destination, SparseSequenceData& sequence,
     size_t sampleIndex, size_t sampleOffset, size_t sampleSize, size_t elementSize)
 {
     //The sample is sparse, first, need to zero out the buffer.
     memset(destination, 0, sampleSize);
     // Get the nnz count of the sample.
-    size_t nonZeroCount = sequence->m_nnzCounts[sampleIndex];
+    size_t nonZeroCount = sequence.m_nnzCounts[sampleIndex];
     // In a sparse sequence, m_data points to the array of non zero elements,
     // m_indices stores the corresponding indices for each element. 
     // Iterate through non zero elements and copy from m_data them into the 
     // destination at the offset given by the corresponding row index (m_index).
-    const void* buffer = sequence->GetDataBuffer();
+    const void* buffer = sequence.GetDataBuffer();
     for (size_t nonZeroIndex = 0; nonZeroIndex < nonZeroCount; ++nonZeroIndex)
     {
         auto sourceOffset = sampleOffset + nonZeroIndex;
-        auto elementIndex = sequence->m_indices[sourceOffset];
+        auto elementIndex = sequence.m_indices[sourceOffset];
         auto destinationOffset = elementIndex * elementSize;
         assert(destinationOffset < sampleSize);
         const auto* source = (const char*)buffer + (sourceOffset)* elementSize;
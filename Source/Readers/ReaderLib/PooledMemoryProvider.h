@@ -0,0 +1,277 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE.md file in the project root for full license information.
+//
+
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <memory>
+#include <mutex>
+#include <new>
+#include <utility>
+#include <vector>
+#include "MemoryProvider.h"
+
+namespace Microsoft { namespace MSR { namespace CNTK {
+
+// A memory provider that keeps freed blocks for reuse instead of returning them to the heap.
+// Sequence data is allocated per sequence by the deserializers and freed right after packing, so in steady state
+// almost all allocations are served from the blocks of the previous minibatches, without malloc/free.
+// Blocks are binned by size classes of powers of two, and each block starts with a header with its class.
+// Blocks above the largest class, and freed blocks beyond 'maxCachedBytes', go to the heap. Thread-safe.
+// With 'useThreadCaches', each thread keeps a few blocks per class of its own, which it allocates and frees
+// without locking, and exchanges with the shared bins in batches. Only a pool that is never destroyed may use them,
+// since the caches are returned to it when their threads end.
+class PooledMemoryProvider : public MemoryProvider
+{
+    static const size_t s_headerSize = 16;   // keeps the alignment of ::operator new
+    static const size_t s_minBlockSize = 64; // bytes including the header, i.e. the size of class 0
+    static const size_t s_numClasses = 15;   // i.e. up to 1 MB
+    static const size_t s_maxThreadCacheBytes = 1024 * 1024; // per class and thread
+
+public:
+    explicit PooledMemoryProvider(size_t maxCachedBytes = 256 * 1024 * 1024, bool useThreadCaches = false)
+        : m_maxCachedBytes(maxCachedBytes), m_cachedBytes(0), m_useThreadCaches(useThreadCaches)
+    {
+    }
+
+    ~PooledMemoryProvider()
+    {
+        for (auto& bin : m_bins)
+        {
+            while (bin.m_head)
+            {
+                FreeBlock* next = bin.m_head->m_next;
+                ::operator delete(bin.m_head);
+                bin.m_head = next;
+            }
+        }
+    }
+
+    virtual void* Alloc(size_t elementSize, size_t numberOfElements) override
+    {
+        size_t size = elementSize * numberOfElements + s_headerSize;
+        size_t sizeClass = GetSizeClass(size);
+        char* block = nullptr;
+        ThreadCache* cache = sizeClass < s_numClasses ? GetThreadCache() : nullptr;
+        if (cache)
+        {
+            if (!cache->m_heads[sizeClass])
+                Exchange(*cache, sizeClass, /*refill=*/true);
+            if (cache->m_heads[sizeClass])
+            {
+                block = reinterpret_cast<char*>(cache->m_heads[sizeClass]);
+                cache->m_heads[sizeClass] = cache->m_heads[sizeClass]->m_next;
+                cache->m_counts[sizeClass]--;
+            }
+        }
+        else if (sizeClass < s_numClasses)
+        {
+            auto& bin = m_bins[sizeClass];
+            std::lock_guard<std::mutex> lock(bin.m_mutex);
+            if (bin.m_head)
+            {
+                block = reinterpret_cast<char*>(bin.m_head);
+                bin.m_head = bin.m_head->m_next;
+                m_cachedBytes -= GetBlockSize(sizeClass);
+            }
+        }
+
+        if (!block)
+            block = static_cast<char*>(::operator new(sizeClass < s_numClasses ? GetBlockSize(sizeClass) : size));
+
+        *reinterpret_cast<size_t*>(block) = sizeClass;
+        return block + s_headerSize;
+    }
+
+    virtual void Free(void* p) override
+    {
+        if (!p)
+            return;
+
+        char* block = static_cast<char*>(p) - s_headerSize;
+        size_t sizeClass = *reinterpret_cast<size_t*>(block);
+        ThreadCache* cache = sizeClass < s_numClasses ? GetThreadCache() : nullptr;
+        if (cache)
+        {
+            auto freeBlock = reinterpret_cast<FreeBlock*>(block);
+            freeBlock->m_next = cache->m_heads[sizeClass];
+            cache->m_heads[sizeClass] = freeBlock;
+            if (++cache->m_counts[sizeClass] > GetThreadCacheCapacity(sizeClass))
+                Exchange(*cache, sizeClass, /*refill=*/false);
+            return;
+        }
+
+        if (sizeClass < s_numClasses && m_cachedBytes + GetBlockSize(sizeClass) <= m_maxCachedBytes)
+        {
+            auto& bin = m_bins[sizeClass];
+            std::lock_guard<std::mutex> lock(bin.m_mutex);
+            auto freeBlock = reinterpret_cast<FreeBlock*>(block);
+            freeBlock->m_next = bin.m_head;
+            bin.m_head = freeBlock;
+            m_cachedBytes += GetBlockSize(sizeClass);
+            return;
+        }
+
+        ::operator delete(block);
+    }
+
+private:
+    static size_t GetBlockSize(size_t sizeClass)
+    {
+        return s_minBlockSize << sizeClass;
+    }
+
+    static size_t GetSizeClass(size_t size)
+    {
+        size_t sizeClass = 0;
+        while (sizeClass < s_numClasses && GetBlockSize(sizeClass) < size)
+            sizeClass++;
+        return sizeClass; // s_numClasses if too large for the bins
+    }
+
+    static size_t GetThreadCacheCapacity(size_t sizeClass)
+    {
+        return std::max<size_t>(2, std::min<size_t>(256, s_maxThreadCacheBytes / GetBlockSize(sizeClass)));
+    }
+
+    // a freed block, linked into the list of its bin in place of its header
+    struct FreeBlock
+    {
+        FreeBlock* m_next;
+    };
+
+    struct ThreadCache
+    {
+        ThreadCache() : m_owner(nullptr), m_heads(), m_counts() {}
+        ~ThreadCache()
+        {
+            if (m_owner)
+                for (size_t sizeClass = 0; sizeClass < s_numClasses; sizeClass++)
+                    m_owner->Exchange(*this, sizeClass, /*refill=*/false, /*all=*/true);
+        }
+
+        PooledMemoryProvider* m_owner; // the pool the blocks belong to, the first one with thread caches used by the thread
+        FreeBlock* m_heads[s_numClasses];
+        size_t m_counts[s_numClasses];
+    };
+
+    // the cache of the calling thread, or null if this pool does not use them
+    ThreadCache* GetThreadCache()
+    {
+        if (!m_useThreadCaches)
+            return nullptr;
+        static thread_local ThreadCache cache;
+        if (!cache.m_owner)
+            cache.m_owner = this;
+        return cache.m_owner == this ? &cache : nullptr;
+    }
+
+    // moves half of the capacity (or all blocks) of a class between a thread cache and the shared bin
+    void Exchange(ThreadCache& cache, size_t sizeClass, bool refill, bool all = false)
+    {
+        size_t blockSize = GetBlockSize(sizeClass);
+        size_t numBlocks = all ? cache.m_counts[sizeClass] : GetThreadCacheCapacity(sizeClass) / 2;
+        auto& bin = m_bins[sizeClass];
+        std::lock_guard<std::mutex> lock(bin.m_mutex);
+        auto& from = refill ? bin.m_head : cache.m_heads[sizeClass];
+        auto& to   = refill ? cache.m_heads[sizeClass] : bin.m_head;
+        for (size_t k = 0; k < numBlocks && from; k++)
+        {
+            FreeBlock* block = from;
+            from = block->m_next;
+            if (refill)
+            {
+                cache.m_counts[sizeClass]++;
+                m_cachedBytes -= blockSize;
+            }
+            else
+            {
+                cache.m_counts[sizeClass]--;
+                if (m_cachedBytes + blockSize > m_maxCachedBytes)
+                {
+                    ::operator delete(block);
+                    continue;
+                }
+                m_cachedBytes += blockSize;
+            }
+            block->m_next = to;
+            to = block;
+        }
+    }
+
+    struct Bin
+    {
+        Bin() : m_head(nullptr) {}
+        std::mutex m_mutex;
+        FreeBlock* m_head;
+    };
+
+    Bin m_bins[s_numClasses];
+    const size_t m_maxCachedBytes;
+    std::atomic<size_t> m_cachedBytes; // of the shared bins; the limit is approximate in case of concurrent frees
+    const bool m_useThreadCaches;
+};
+
+// The pool all sequence data of the readers is allocated from, see MakeSequenceData().
+// It is never destroyed, since sequences may still be released by other threads during shutdown.
+inline MemoryProvider& GetSequenceDataPool()
+{
+    static PooledMemoryProvider* pool = new PooledMemoryProvider(256 * 1024 * 1024, /*useThreadCaches=*/true);
+    return *pool;
+}
+
+// STL allocator on top of a memory provider, by default the sequence data pool. The provider must outlive the allocations.
+template <class T>
+class PooledAllocator
+{
+public:
+    typedef T value_type;
+
+    template <class U>
+    struct rebind
+    {
+        typedef PooledAllocator<U> other;
+    };
+
+    PooledAllocator() : m_provider(&GetSequenceDataPool()) {}
+    explicit PooledAllocator(MemoryProvider* provider) : m_provider(provider) {}
+    template <class U>
+    PooledAllocator(const PooledAllocator<U>& other) : m_provider(other.GetProvider()) {}
+
+    T* allocate(size_t n)
+    {
+        return static_cast<T*>(m_provider->Alloc(sizeof(T), n));
+    }
+
+    void deallocate(T* p, size_t)
+    {
+        m_provider->Free(p);
+    }
+
+    MemoryProvider* GetProvider() const { return m_provider; }
+
+    template <class U>
+    bool operator==(const PooledAllocator<U>& other) const { return m_provider == other.GetProvider(); }
+    template <class U>
+    bool operator!=(const PooledAllocator<U>& other) const { return m_provider != other.GetProvider(); }
+
+private:
+    MemoryProvider* m_provider;
+};
+
+// Vector whose buffer comes from the sequence data pool.
+template <class T>
+using PooledVector = std::vector<T, PooledAllocator<T>>;
+
+// Creates sequence data from the sequence data pool, the object and the control block of the shared pointer in one block.
+template <class T, class... Args>
+std::shared_ptr<T> MakeSequenceData(Args&&... args)
+{
+    return std::allocate_shared<T>(PooledAllocator<T>(), std::forward<Args>(args)...);
+}
+
+}}}
@@ -7,6 +7,7 @@
 
 #include <vector>
 #include <memory>
+#include <chrono>
 #include "Sequences.h"
 #include "TensorShape.h"
 
@@ -41,6 +42,20 @@ struct EpochConfiguration : public ReaderConfiguration
     size_t m_epochIndex;                    // Current epoch index [0 .. max number of epochs)
 };
 
+struct StreamMinibatch;
+
+// Finishes the samples of a packed stream on the device of the input they are read into, batched over the minibatch.
+// Lets a reader ship compact data to the GPU, e.g. 8 bit images, and leave the per element work to it. The stream then
+// describes the packed samples, and the transform resizes the matrix to the rows the network expects.
+class DeviceStreamTransform
+{
+public:
+    virtual void Apply(const StreamMinibatch& stream, Matrix<float>& result, DataTransferer* transferer) = 0;
+    virtual void Apply(const StreamMinibatch& stream, Matrix<double>& result, DataTransferer* transferer) = 0;
+    virtual ~DeviceStreamTransform() {}
+};
+typedef std::shared_ptr<DeviceStreamTransform> DeviceStreamTransformPtr;
+
 // Supported primitive element types, will be extended in the future.
 enum class ElementType
 {
@@ -70,6 +85,7 @@ struct StreamDescription
     ElementType m_elementType;     // Element type of the stream
     TensorShapePtr m_sampleLayout; // Layout of the sample for the stream
                                    // If not specified - can be specified per sequence
+    DeviceStreamTransformPtr m_deviceTransform; // Applied to the packed samples on the device, if any
 };
 typedef std::shared_ptr<StreamDescription> StreamDescriptionPtr;
 
@@ -84,6 +100,43 @@ struct StreamMinibatch
 };
 typedef std::shared_ptr<StreamMinibatch> StreamMinibatchPtr;
 
+// Wall clock time in seconds spent in the stages of the reader pipeline.
+struct ReaderStageTimings
+{
+    typedef std::chrono::high_resolution_clock Clock;
+
+    double m_deserializeSeconds = 0; // getting sequences from the randomizer, including chunk loading
+    double m_transformSeconds = 0;   // applying the transforms
+    double m_packSeconds = 0;        // packing the sequences into the minibatch buffers
+    double m_copySeconds = 0;        // filling the input matrices, including the host to device copy
+    size_t m_numSequences = 0;       // sequences that went through the stages
+    size_t m_numLayoutColumns = 0;   // columns of the minibatch layouts of all streams (filled by SequencePacker)
+    size_t m_numGapColumns = 0;      // of which padding
+
+    ReaderStageTimings& operator+=(const ReaderStageTimings& other)
+    {
+        m_deserializeSeconds += other.m_deserializeSeconds;
+        m_transformSeconds += other.m_transformSeconds;
+        m_packSeconds += other.m_packSeconds;
+        m_copySeconds += other.m_copySeconds;
+        m_numSequences += other.m_numSequences;
+        m_numLayoutColumns += other.m_numLayoutColumns;
+        m_numGapColumns += other.m_numGapColumns;
+        return *this;
+    }
+
+    // Fraction of the minibatch layouts that is padding.
+    double GetPaddingRatio() const
+    {
+        return m_numLayoutColumns > 0 ? (double)m_numGapColumns / m_numLayoutColumns : 0.0;
+    }
+
+    static double SecondsSince(Clock::time_point start)
+    {
+        return std::chrono::duration<double>(Clock::now() - start).count();
+    }
+};
+
 // Represents a single minibatch, that contains information about all streams.
 struct Minibatch
 {
@@ -95,6 +148,9 @@ struct Minibatch
     // Minibatch data
     std::vector<StreamMinibatchPtr> m_data;
 
+    // Time it took to produce the minibatch; the copy time is filled in by the consumer.
+    ReaderStageTimings m_timings;
+
     Minibatch() : m_endOfEpoch(false)
     {
     }
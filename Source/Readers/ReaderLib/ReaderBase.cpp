@@ -5,7 +5,6 @@
 
 #include "Config.h"
 #include "ReaderBase.h"
-#include "CudaMemoryProvider.h"
 #include "HeapMemoryProvider.h"
 
 namespace Microsoft { namespace MSR { namespace CNTK {
@@ -49,7 +48,12 @@ void ReaderBase::StartEpoch(const EpochConfiguration& config, const std::map<std
             if (deviceId < 0)
                 m_memoryProviders[i] = std::make_shared<HeapMemoryProvider>();
             else
-                m_memoryProviders[i] = std::make_shared<CudaMemoryProvider>(deviceId);
+            {
+                auto& pool = m_pinnedMemoryPools[deviceId];
+                if (!pool)
+                    pool = CudaMemoryProvider::CreatePinnedMemoryPool(deviceId);
+                m_memoryProviders[i] = std::make_shared<CudaMemoryProvider>(pool);
+            }
         }
     }
 
@@ -8,6 +8,7 @@
 #include "Reader.h"
 #include "Packer.h"
 #include "SequenceEnumerator.h"
+#include "CudaMemoryProvider.h"
 
 namespace Microsoft { namespace MSR { namespace CNTK {
 
@@ -51,5 +52,8 @@ namespace Microsoft { namespace MSR { namespace CNTK {
 
         // Memory provider per input.
         std::vector<MemoryProviderPtr> m_memoryProviders;
+
+        // Page-locked staging memory per device, shared by the streams and kept across epochs.
+        std::map<int, PinnedMemoryPoolPtr> m_pinnedMemoryPools;
     };
 }}}
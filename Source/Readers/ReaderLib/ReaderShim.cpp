@@ -18,16 +18,20 @@
 #include "DataReader.h"
 #include "ReaderShim.h"
 #include "DataTransferer.h"
+#include "TimelineTracer.h"
+#include "Telemetry.h"
 
 namespace Microsoft { namespace MSR { namespace CNTK {
 
 template <class ElemType>
 ReaderShim<ElemType>::ReaderShim() :
     m_deviceId(CPUDEVICE),
-    m_dataTransferers(2, DataTransfererPtr()),
-    m_currentDataTransferIndex(0),
+    m_prefetchDepth(1),
+    m_nextPrefetchSlot(0),
     m_endOfEpoch(false),
     m_currentSamplePosition(0),
+    m_prefetchWaitSeconds(0),
+    m_verbosity(0),
     m_reader(nullptr),
     m_factory(nullptr)
 {
@@ -58,6 +62,14 @@ void ReaderShim<ElemType>::Init(const ConfigParameters& config)
     // otherwise deferring - synchronous execution during .get() call
     m_launchType = prefetch ? launch::async : launch::deferred;
 
+    // Number of minibatches read ahead. Each one keeps its own set of input matrices.
+    // Without prefetch the minibatch is only read when requested.
+    m_prefetchDepth = prefetch ? (size_t)config(L"prefetchDepth", (size_t)1) : 1;
+    if (m_prefetchDepth == 0)
+        InvalidArgument("ReaderShim: prefetchDepth must be at least 1.");
+
+    m_verbosity = config(L"verbosity", 0);
+
     m_numParallelSequences = numberOfuttsPerMinibatchForAllEpochs[0];
 
     if (!m_reader)
@@ -96,73 +108,65 @@ void ReaderShim<ElemType>::StartDistributedMinibatchLoop(
 }
 
 template <class ElemType>
-void ReaderShim<ElemType>::SetCurrentSamplePosition(size_t currentSamplePosition)
+void ReaderShim<ElemType>::StartPrefetch()
+{
+    // Each prefetch reads the next minibatch after the previous one has been read, and fills the oldest free slot.
+    // When the network requests a new minibatch, we wait for the oldest prefetch to finish, swap the buffers
+    // and kick off a new prefetch. So there are always m_prefetchDepth reads in flight or done.
+    while (m_prefetchTasks.size() < m_prefetchDepth)
+    {
+        auto slotIndex = m_nextPrefetchSlot;
+        m_nextPrefetchSlot = (m_nextPrefetchSlot + 1) % m_prefetchDepth;
+
+        PrefetchTask previousTask = m_prefetchTasks.empty() ? PrefetchTask() : m_prefetchTasks.back().second;
+        PrefetchTask task = std::async(m_launchType,
+            [this, slotIndex, previousTask]()
+        {
+            return PrefetchMinibatch(slotIndex, previousTask);
+        }).share();
+        m_prefetchTasks.push_back(std::make_pair(slotIndex, task));
+    }
+}
+
+template <class ElemType>
+void ReaderShim<ElemType>::CancelPrefetch()
 {
     // Make sure there are no outstanding reads.
-    if (m_prefetchTask.valid())
-        m_prefetchTask.wait();
+    // Each prefetch waits for its copies to finish, so after that there are no outstanding memcopies either.
+    for (auto& task : m_prefetchTasks)
+        task.second.wait();
+    m_prefetchTasks.clear();
+}
 
-    // Let's check that there is no outstanding copies.
-    // Wait on all events if there are any pending copy operations in flight.
-    if (m_dataTransferers[m_currentDataTransferIndex])
-        m_dataTransferers[m_currentDataTransferIndex]->WaitForCopyCPUToGPU();
+template <class ElemType>
+void ReaderShim<ElemType>::SetCurrentSamplePosition(size_t currentSamplePosition)
+{
+    CancelPrefetch();
 
     // Set current position.
     m_reader->SetCurrentSamplePosition(currentSamplePosition);
     m_currentSamplePosition = m_reader->GetCurrentSamplePosition();
 
-    // Start prefetch.
-    auto localCurrentDataTransferIndex = m_currentDataTransferIndex;
-    // Starting the prefetch task. There is always a single async read in flight.
-    // When the network requests a new minibatch, we wait for the current async to finish, swap the buffers
-    // and kick off the new prefetch.
-    m_prefetchTask = std::async(m_launchType,
-        [this, localCurrentDataTransferIndex]()
-    {
-        return PrefetchMinibatch(localCurrentDataTransferIndex);
-    });
+    StartPrefetch();
 }
 
 template <class ElemType>
 void ReaderShim<ElemType>::SetConfiguration(const ReaderConfiguration& config, const std::map<std::wstring, int>& inputDescriptions)
 {
-    // Make sure there are no outstanding reads.
-    if (m_prefetchTask.valid())
-        m_prefetchTask.wait();
-
-    // Let's check that there is no outstanding copies.
-    // Wait on all events if there are any pending copy operations in flight.
-    if (m_dataTransferers[m_currentDataTransferIndex])
-        m_dataTransferers[m_currentDataTransferIndex]->WaitForCopyCPUToGPU();
+    // The reader may be ahead of the network, rewind it to the position of the last minibatch returned.
+    CancelPrefetch();
 
     m_reader->SetConfiguration(config, inputDescriptions);
     m_reader->SetCurrentSamplePosition(m_currentSamplePosition);
 
-    // Start prefetch.
-    auto localCurrentDataTransferIndex = m_currentDataTransferIndex;
-    // Starting the prefetch task. There is always a single async read in flight.
-    // When the network requests a new minibatch, we wait for the current async to finish, swap the buffers
-    // and kick off the new prefetch.
-    m_prefetchTask = std::async(m_launchType,
-        [this, localCurrentDataTransferIndex]()
-    {
-        return PrefetchMinibatch(localCurrentDataTransferIndex);
-    });
+    StartPrefetch();
 }
 
 template <class ElemType>
 void ReaderShim<ElemType>::StartEpoch(const EpochConfiguration& config, const std::unordered_set<InputStreamDescription>& inputs)
 {
     // For adaptive minibatch, make sure there are no outstanding reads.
-    if (m_prefetchTask.valid())
-    {
-        m_prefetchTask.wait();
-    }
-
-    // Let's check that there is no outstanding copies.
-    // Wait on all events if there are any pending copy operations in flight.
-    if (m_dataTransferers[m_currentDataTransferIndex])
-        m_dataTransferers[m_currentDataTransferIndex]->WaitForCopyCPUToGPU();
+    CancelPrefetch();
 
     // Now we can be sure, no prefetch thread is running and there are no outstanding memcopies.
     // Let's check that requested devices are ok and see whether we need to change our data transferers.
@@ -178,14 +182,15 @@ void ReaderShim<ElemType>::StartEpoch(const EpochConfiguration& config, const st
         LogicError("Readers do not support running on several GPUs in the same process, at least two devices found '%d', '%d'", deviceId, secondDevice->GetDeviceId());
     }
 
-    if (m_deviceId != deviceId)
+    if (m_deviceId != deviceId || m_prefetchSlots.size() != m_prefetchDepth)
     {
-        // Device changed. Let's change the data transferers.
+        // Device changed. Let's change the data transferers, one per slot, so that
+        // the copy of each read-ahead minibatch can be waited on separately.
         m_deviceId = deviceId;
-        m_dataTransferers.clear();
-        // We need two in order to support two operations in flight.
-        m_dataTransferers.push_back(m_deviceId == CPUDEVICE ? nullptr : CreatePrefetchDataTransferer(m_deviceId));
-        m_dataTransferers.push_back(m_deviceId == CPUDEVICE ? nullptr : CreatePrefetchDataTransferer(m_deviceId));
+        m_prefetchSlots.clear();
+        m_prefetchSlots.resize(m_prefetchDepth);
+        for (auto& slot : m_prefetchSlots)
+            slot.m_dataTransferer = m_deviceId == CPUDEVICE ? nullptr : CreatePrefetchDataTransferer(m_deviceId);
     }
 
     // Let's create the buffers for the prefetch thread.
@@ -194,26 +199,23 @@ void ReaderShim<ElemType>::StartEpoch(const EpochConfiguration& config, const st
     {
         inputDescriptions[i.GetStreamName()] = i.GetDeviceId();
         // Creating buffers with the same properties the network expects.
-        m_prefetchBuffers[i.GetStreamName()] = StreamPrefetchBuffer
+        for (auto& slot : m_prefetchSlots)
         {
-            std::make_shared<Matrix<ElemType>>(0, 0, i.GetDeviceId(), i.GetMatrixType(), i.GetMatrixFormat()),
-            std::make_shared<MBLayout>()
-        };
+            slot.m_buffers[i.GetStreamName()] = StreamPrefetchBuffer
+            {
+                std::make_shared<Matrix<ElemType>>(0, 0, i.GetDeviceId(), i.GetMatrixType(), i.GetMatrixFormat()),
+                std::make_shared<MBLayout>()
+            };
+        }
     }
 
     m_endOfEpoch = false;
+    m_stageTimings = ReaderStageTimings();
+    m_prefetchWaitSeconds = 0;
     m_reader->StartEpoch(config, inputDescriptions);
     m_currentSamplePosition = m_reader->GetCurrentSamplePosition();
 
-    auto localCurrentDataTransferIndex = m_currentDataTransferIndex;
-    // Starting the prefetch task. There is always a single async read in flight.
-    // When the network requests a new minibatch, we wait for the current async to finish, swap the buffers
-    // and kick off the new prefetch.
-    m_prefetchTask = std::async(m_launchType,
-    [this, localCurrentDataTransferIndex]()
-    {
-        return PrefetchMinibatch(localCurrentDataTransferIndex);
-    });
+    StartPrefetch();
 }
 
 string EnumerateInputs(const unordered_map<wstring, size_t>& nameToStreamId)
@@ -244,6 +246,8 @@ bool ReaderShim<ElemType>::GetMinibatch(StreamMinibatchInputs& matrices)
         return false;
     }
 
+    TimelineEvent event("Reader", "GetMinibatch");
+
     //TODO: Set proper format on matrices?
 
     // Check that all matrices have the same device id.
@@ -263,37 +267,69 @@ bool ReaderShim<ElemType>::GetMinibatch(StreamMinibatchInputs& matrices)
         }
     }
 
-    // Make sure the prefetch has finished.
-    assert(m_prefetchTask.valid());
-    auto result = m_prefetchTask.get();
+    // The depth of the queue of read-ahead minibatches: 0 means training waits for the reader.
+    if (Telemetry::IsEnabled())
+    {
+        size_t numReady = 0;
+        for (const auto& task : m_prefetchTasks)
+        {
+            if (task.second.wait_for(std::chrono::seconds(0)) == std::future_status::ready)
+                numReady++;
+        }
+        Telemetry::Set("cntk_reader_ready_minibatches", "", "Prefetched minibatches ready when training asked for the next one.", (double) numReady);
+        Telemetry::Set("cntk_reader_prefetch_depth", "", "Minibatches the reader reads ahead.", (double) m_prefetchDepth);
+    }
+
+    // Make sure the oldest prefetch has finished.
+    assert(!m_prefetchTasks.empty());
+    auto slotIndex = m_prefetchTasks.front().first;
+    auto waitStart = ReaderStageTimings::Clock::now();
+    auto result = m_prefetchTasks.front().second.get();
+    m_prefetchTasks.pop_front();
+    m_prefetchWaitSeconds += ReaderStageTimings::SecondsSince(waitStart);
 
     // Ok, prefetch is done.
+    m_stageTimings += result.m_timings;
+    if (m_verbosity > 1 && result.m_timings.m_numLayoutColumns > 0)
+        fprintf(stderr, "ReaderShim: minibatch padding ratio %.1f%%.\n", 100 * result.m_timings.GetPaddingRatio());
 
     // Let's update our sample position.
-    m_currentSamplePosition = m_reader->GetCurrentSamplePosition();
+    m_currentSamplePosition = result.m_samplePosition;
 
     m_endOfEpoch = result.m_isEndOfEpoch;
-    if (m_endOfEpoch && !result.m_isDataAvailable)
+    if (m_endOfEpoch)
     {
-        // No data and end of epoch, simply return.
-        return false;
-    }
+        if (m_verbosity > 0)
+        {
+            fprintf(stderr, "ReaderShim: epoch read pipeline time: deserialize = %.3gs, transform = %.3gs, pack = %.3gs, copy = %.3gs; waited for data %.3gs (prefetch depth %d).\n",
+                m_stageTimings.m_deserializeSeconds, m_stageTimings.m_transformSeconds, m_stageTimings.m_packSeconds,
+                m_stageTimings.m_copySeconds, m_prefetchWaitSeconds, (int)m_prefetchDepth);
+            auto rate = [this](double seconds) { return seconds > 0 ? m_stageTimings.m_numSequences / seconds : 0.0; };
+            fprintf(stderr, "ReaderShim: epoch read pipeline throughput for %d sequences: deserialize = %.0f/s, transform = %.0f/s, pack = %.0f/s, copy = %.0f/s.\n",
+                (int)m_stageTimings.m_numSequences, rate(m_stageTimings.m_deserializeSeconds), rate(m_stageTimings.m_transformSeconds),
+                rate(m_stageTimings.m_packSeconds), rate(m_stageTimings.m_copySeconds));
+            if (m_stageTimings.m_numLayoutColumns > 0)
+                fprintf(stderr, "ReaderShim: epoch padding ratio %.1f%%.\n", 100 * m_stageTimings.GetPaddingRatio());
+        }
 
-    // Remember current data transfer, async memcpy for it already started on the prefetch thread.
-    auto currentDataTransferIndex = m_currentDataTransferIndex;
+        if (!result.m_isDataAvailable)
+        {
+            // No data and end of epoch, simply return.
+            return false;
+        }
+    }
 
-    // Let's update the current data transferer.
-    m_currentDataTransferIndex = (m_currentDataTransferIndex + 1) % 2;
+    auto& slot = m_prefetchSlots[slotIndex];
 
-    // Record an event that prefetch can wait on to ensure that prior compute has finished.
-    if (m_dataTransferers[m_currentDataTransferIndex])
-        m_dataTransferers[m_currentDataTransferIndex]->RecordComputeStreamSyncPoint();
+    // Record an event that the next prefetch into this slot can wait on to ensure that prior compute has finished.
+    if (slot.m_dataTransferer)
+        slot.m_dataTransferer->RecordComputeStreamSyncPoint();
 
     // We have some data - let's swap the matrices.
     // We cannot simply change pointers because it seems they are remembered deeper in the network.
     for (auto i = matrices.begin(); i != matrices.end(); ++i)
     {
-        std::swap(i->second.GetMatrix<ElemType>(), *m_prefetchBuffers[i->first].m_matrix);
+        std::swap(i->second.GetMatrix<ElemType>(), *slot.m_buffers[i->first].m_matrix);
 
         // Resetting layouts.
         i->second.pMBLayout->Init(1, 0);
@@ -305,7 +341,7 @@ bool ReaderShim<ElemType>::GetMinibatch(StreamMinibatchInputs& matrices)
     // Let's now check the layouts and throw if the same layout is being assigned twice.
     for (auto i = matrices.begin(); i != matrices.end(); ++i)
     {
-        auto streamLayout = m_prefetchBuffers[i->first].m_mbLayout;
+        auto streamLayout = slot.m_buffers[i->first].m_mbLayout;
         auto& layout = i->second.pMBLayout;
         if (layout->GetNumCols() == 0) // just initialized, let's take the layout of the reader.
         {
@@ -326,58 +362,82 @@ bool ReaderShim<ElemType>::GetMinibatch(StreamMinibatchInputs& matrices)
     // So pick up the first one.
     m_numParallelSequences = matrices.begin()->second.pMBLayout->GetNumParallelSequences();
 
-    // It is time to issue the next prefetch.
+    // It is time to issue the next prefetch, into the slot we have just emptied.
     if (!m_endOfEpoch)
-    {
-        // Starting the prefetch task. There is always a single async read in flight.
-        // When the network requests a new minibatch, we wait for the current async to finish, swap the buffers
-        // and kick off the new prefetch.
-        auto localCurrentDataTransferIndex = m_currentDataTransferIndex;
-        m_prefetchTask = std::async(m_launchType, [this, localCurrentDataTransferIndex]() { return PrefetchMinibatch(localCurrentDataTransferIndex); });
-    }
-
-    // Let's wait till the previous memcopy has finished.
-    if (m_dataTransferers[currentDataTransferIndex])
-        m_dataTransferers[currentDataTransferIndex]->WaitForCopyCPUToGPU();
+        StartPrefetch();
 
     return result.m_isDataAvailable;
 }
 
 template <class ElemType>
-typename ReaderShim<ElemType>::PrefetchResult ReaderShim<ElemType>::PrefetchMinibatch(size_t currentDataTransferIndex)
+typename ReaderShim<ElemType>::PrefetchResult ReaderShim<ElemType>::PrefetchMinibatch(size_t slotIndex, PrefetchTask previousTask)
 {
+    // The reader is not thread safe and the minibatches have to be read in order,
+    // so let the previous prefetch finish first. Nothing to read past the end of the epoch.
+    if (previousTask.valid())
+    {
+        auto previous = previousTask.get();
+        if (previous.m_isEndOfEpoch)
+            return PrefetchResult{ true, false, previous.m_samplePosition, ReaderStageTimings() };
+    }
+
+    TimelineEvent event("Reader", "PrefetchMinibatch");
+    auto& slot = m_prefetchSlots[slotIndex];
+
     // Resetting layouts.
-    for (auto& mx : m_prefetchBuffers)
+    for (auto& mx : slot.m_buffers)
         mx.second.m_mbLayout = std::make_shared<MBLayout>();
 
     Minibatch minibatch = m_reader->ReadMinibatch();
+    size_t samplePosition = m_reader->GetCurrentSamplePosition();
 
     // If there is no data we can simply return.
     if (minibatch.m_data.empty())
-        return PrefetchResult{ minibatch.m_endOfEpoch, false };
+        return PrefetchResult{ minibatch.m_endOfEpoch, false, samplePosition, minibatch.m_timings };
 
     // Ok we have some data. Let's load it to GPU.
     // But before we need to make sure that corresponding compute has already finished from the last iteration.
+    auto copyStart = ReaderStageTimings::Clock::now();
 
     // We need to make sure that the compute for the current transfer is finished before we start prefetch.
-    if (m_dataTransferers[currentDataTransferIndex])
-        m_dataTransferers[currentDataTransferIndex]->WaitForSyncPointOnAssignStreamAsync();
+    if (slot.m_dataTransferer)
+        slot.m_dataTransferer->WaitForSyncPointOnAssignStreamAsync();
 
-    for (auto& mx : m_prefetchBuffers)
+    for (auto& mx : slot.m_buffers)
     {
         size_t streamId = m_nameToStreamId[mx.first];
         const auto& stream = minibatch.m_data[streamId];
         mx.second.m_mbLayout = stream->m_layout;
 
+        if (m_streams[streamId]->m_deviceTransform)
+        {
+            m_streams[streamId]->m_deviceTransform->Apply(*stream, *mx.second.m_matrix, slot.m_dataTransferer.get());
+            continue;
+        }
+
         size_t sampleSize = m_streams[streamId]->m_sampleLayout->GetNumElements();
-        FillMatrixFromStream(m_streams[streamId]->m_storageType, mx.second.m_matrix.get(), sampleSize, stream, m_dataTransferers[currentDataTransferIndex].get());
+        FillMatrixFromStream(m_streams[streamId]->m_storageType, mx.second.m_matrix.get(), sampleSize, stream, slot.m_dataTransferer.get());
+    }
+
+    // The gap masks go to the device with the data instead of on first use in the network, where identical
+    // layouts find them cached. (Streams often share a layout, which then has its mask already.)
+    for (auto& mx : slot.m_buffers)
+    {
+        const auto& layout = mx.second.m_mbLayout;
+        if (layout->HasGaps())
+            layout->GetColumnsValidityMask(mx.second.m_matrix->GetDeviceId(), slot.m_dataTransferer.get());
     }
 
-    // Let's record that we started the copy, so that the main thread can wait afterwards.
-    if (m_dataTransferers[currentDataTransferIndex])
-        m_dataTransferers[currentDataTransferIndex]->RecordCPUToGPUCopy();
+    // Let's record that we started the copy and wait for it: the packer reuses its buffers
+    // after a few reads, and the next prefetch may run before the main thread takes this one.
+    if (slot.m_dataTransferer)
+    {
+        slot.m_dataTransferer->RecordCPUToGPUCopy();
+        slot.m_dataTransferer->WaitForCopyCPUToGPU();
+    }
 
-    return PrefetchResult{ minibatch.m_endOfEpoch, true };
+    minibatch.m_timings.m_copySeconds = ReaderStageTimings::SecondsSince(copyStart);
+    return PrefetchResult{ minibatch.m_endOfEpoch, true, samplePosition, minibatch.m_timings };
 }
 
 
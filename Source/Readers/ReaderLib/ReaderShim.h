@@ -11,6 +11,7 @@
 #include <unordered_map>
 #include <string>
 #include <future>
+#include <deque>
 #include "DataReader.h"
 #include "Reader.h"
 
@@ -47,10 +48,11 @@ public:
         // Make sure there are no outstanding reads.
         // Future destructor does not wait as of 2013 so probably it is not in VS2013:
         // More info can be found here http://www.open-std.org/jtc1/sc22/wg21/docs/papers/2013/n3679.html.
-        if (m_prefetchTask.valid())
+        // The prefetches run one after another, so it is enough to wait for the last one.
+        if (!m_prefetchTasks.empty())
         {
             // If there are some, give them time to finish.
-            m_prefetchTask.wait_for(std::chrono::seconds(5));
+            m_prefetchTasks.back().second.wait_for(std::chrono::seconds(5));
         }
 
         delete this;
@@ -91,7 +93,7 @@ public:
 
     virtual size_t GetCurrentSamplePosition() override;
 
-    void SetCurrentSamplePosition(size_t currentSamplePosition);
+    virtual void SetCurrentSamplePosition(size_t currentSamplePosition) override;
 
     void SetConfiguration(const ReaderConfiguration& config, const std::map<std::wstring, int>& inputDescriptions);
 
@@ -100,16 +102,47 @@ public:
         return m_endOfEpoch;
     }
 
+    // Time spent in the reader pipeline stages for the minibatches returned in the current epoch.
+    const ReaderStageTimings& GetStageTimings() const
+    {
+        return m_stageTimings;
+    }
+
+    // Time GetMinibatch() had to wait for prefetched data in the current epoch.
+    double GetPrefetchWaitSeconds() const
+    {
+        return m_prefetchWaitSeconds;
+    }
+
 private:
     struct PrefetchResult
     {
         bool m_isEndOfEpoch;
         bool m_isDataAvailable;
+        size_t m_samplePosition; // position of the reader after this minibatch
+        ReaderStageTimings m_timings;
     };
 
-    PrefetchResult PrefetchMinibatch(size_t currentDataTransferIndex);
+    typedef std::shared_future<PrefetchResult> PrefetchTask;
+
+    PrefetchResult PrefetchMinibatch(size_t slotIndex, PrefetchTask previousTask);
+
+    // Launches prefetches till there are m_prefetchDepth minibatches in flight.
+    void StartPrefetch();
+
+    // Waits for all prefetches and the copies started by them, discarding their data.
+    void CancelPrefetch();
+
+    // Prefetches in the order they were started, with the slot each one fills.
+    // Each prefetch waits for the previous one, so the reader is only called from one thread at a time.
+    std::deque<std::pair<size_t, PrefetchTask>> m_prefetchTasks;
+
+    // Number of minibatches that are read ahead (config 'prefetchDepth').
+    size_t m_prefetchDepth;
+
+    // Slot to be used by the next prefetch.
+    size_t m_nextPrefetchSlot;
 
-    std::future<PrefetchResult> m_prefetchTask;
     ReaderPtr m_reader;
     ReaderFactory m_factory;
     bool m_endOfEpoch;
@@ -127,19 +160,18 @@ private:
         MBLayoutPtr m_mbLayout;
     };
 
-    // Intermediate buffer where the prefetch thread puts its data to.
-    // When the main thread enters GetMinibatch it swaps the matrices from this buffer,
-    // triggers the next prefetch and waits if memCpy is still in progress.
-    std::unordered_map<std::wstring, StreamPrefetchBuffer> m_prefetchBuffers;
-
-    // Alternating data transfer operations. In the current version these are only two - 
-    // currently waiting on the main thread and the one that can be started by the prefetch thread 
-    // in the meantime.
-    std::vector<DataTransfererPtr> m_dataTransferers;
+    // One read-ahead minibatch: intermediate buffers where a prefetch puts its data to,
+    // and the data transfer used for copying it to the device.
+    // When the main thread enters GetMinibatch it swaps the matrices from the oldest slot
+    // and starts a new prefetch into it.
+    struct PrefetchSlot
+    {
+        std::unordered_map<std::wstring, StreamPrefetchBuffer> m_buffers;
+        DataTransfererPtr m_dataTransferer;
+    };
 
-    // Current data transfer. Flips 0 and 1.
-    // Can be changed only from the main thread with no ongoing prefetch.
-    size_t m_currentDataTransferIndex; 
+    // m_prefetchDepth slots, used round robin.
+    std::vector<PrefetchSlot> m_prefetchSlots;
 
     // Device id.
     int m_deviceId;
@@ -149,6 +181,11 @@ private:
     // The value is updated only from the main thread (in StartEpoch/GetMinibatch)
     size_t m_currentSamplePosition;
 
+    // Statistics of the current epoch, printed at its end if verbosity > 0.
+    ReaderStageTimings m_stageTimings;
+    double m_prefetchWaitSeconds;
+    int m_verbosity;
+
     static void FillMatrixFromStream(
         StorageType type,
         Matrix<ElemType>* matrix,
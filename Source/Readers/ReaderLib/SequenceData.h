@@ -61,4 +61,30 @@ namespace Microsoft { namespace MSR { namespace CNTK {
         DISABLE_COPY_AND_MOVE(DenseSequenceWithBuffer);
     };
 
+    // A dense sequence whose data either lives in its chunk, e.g. in a memory mapping of the file the chunk is kept
+    // alive by m_chunk, or in its own buffer if the samples of the sequence are not contiguous there.
+    struct ChunkBackedDenseSequenceData : DenseSequenceData
+    {
+        const void* GetDataBuffer() override
+        {
+            return m_data;
+        }
+
+        const void* m_data;
+        PooledVector<char> m_buffer;
+    };
+
+    // The sparse counterpart, m_indices points into the chunk or into m_indexBuffer.
+    struct ChunkBackedSparseSequenceData : SparseSequenceData
+    {
+        const void* GetDataBuffer() override
+        {
+            return m_data;
+        }
+
+        const void* m_data;
+        PooledVector<char> m_valueBuffer;
+        PooledVector<IndexType> m_indexBuffer;
+    };
+
 } } }
\ No newline at end of file
@@ -5,6 +5,7 @@
 
 #pragma once
 
+#include <functional>
 #include <vector>
 #include "DataDeserializer.h"
 
@@ -22,11 +23,21 @@ struct Sequences
 
     // Indicates whether the epoch ends with the data returned.
     bool m_endOfEpoch = false;
+
+    // Time in seconds spent transforming the data returned (see TransformController).
+    double m_transformSeconds = 0;
+
+    // Chunks the data of the sequences may point into. The data stays valid as long as these are held,
+    // which enumerators that keep sequences beyond the next call (see LengthBucketingEnumerator) have to do.
+    std::vector<ChunkPtr> m_chunks;
 };
 
 class SequenceEnumerator;
 typedef std::shared_ptr<SequenceEnumerator> SequenceEnumeratorPtr;
 
+// Transforms the data of one sequence in place, indexed by stream id.
+typedef std::function<void(std::vector<SequenceDataPtr>& sequence)> SequenceTransform;
+
 // Sequence enumerator is internal interface used by the packer to get a set of new sequences.
 // It is implemented either by different randomizers or by TransformController that can wrap the randomizer
 // and apply different transforms on top of data.
@@ -54,6 +65,14 @@ public:
     // Returns current position in the global timeline. The returned value is in samples.
     virtual size_t GetCurrentSamplePosition() = 0;
 
+    // Asks the enumerator to apply the transform to every sequence right after getting it from its chunk,
+    // on the same thread, so that getting and transforming a sequence is one task of the worker threads.
+    // Returns false if the enumerator does not get sequences in parallel; the caller then transforms them itself.
+    virtual bool SetSequenceTransform(const SequenceTransform&)
+    {
+        return false;
+    }
+
     virtual ~SequenceEnumerator()
     {
     }
@@ -38,12 +38,14 @@ MBLayoutPtr SequencePacker::CreateMBLayout(const StreamBatch& batch)
 
 Minibatch SequencePacker::ReadMinibatch()
 {
+    auto start = StartTimings();
     auto sequences = GetNextSequences();
     const auto& batch = sequences.m_data;
 
     Minibatch minibatch(sequences.m_endOfEpoch);
     if (batch.empty())
     {
+        minibatch.m_timings = GetTimings(start);
         return minibatch;
     }
 
@@ -70,9 +72,13 @@ Minibatch SequencePacker::ReadMinibatch()
         streamMinibatch->m_data = buffer.m_data.get();
         streamMinibatch->m_layout = pMBLayout;
         minibatch.m_data.push_back(streamMinibatch);
+
+        m_timings.m_numLayoutColumns += pMBLayout->GetNumCols();
+        m_timings.m_numGapColumns += pMBLayout->GetNumCols() - pMBLayout->GetActualNumSamples();
     }
 
     m_currentBufferIndex = (m_currentBufferIndex + 1) % m_numberOfBuffers;
+    minibatch.m_timings = GetTimings(start);
     return minibatch;
 }
 
@@ -158,15 +164,15 @@ MBLayoutPtr SequencePacker::PackDenseStream(const StreamBatch& batch, size_t str
             else if (stream->m_storageType == StorageType::sparse_csc)
             {
                 // TODO: make type casts members of the SparseSequenceData
-                SparseSequenceDataPtr sparseSequence = static_pointer_cast<SparseSequenceData>(sequence);
+                auto& sparseSequence = static_cast<SparseSequenceData&>(*sequence);
                 // make sure that the sequence meta-data is correct.
-                assert(numSamples == sparseSequence->m_nnzCounts.size());
+                assert(numSamples == sparseSequence.m_nnzCounts.size());
                 PackSparseSampleAsDense(destination, sparseSequence, sampleIndex, sampleOffset, sampleSize, elementSize);
                 // move the offset by nnz count of the sample.
-                sampleOffset += sparseSequence->m_nnzCounts[sampleIndex];
+                sampleOffset += sparseSequence.m_nnzCounts[sampleIndex];
                 // verify that the offset is within the bounds (less or equal 
                 // to the total nnz count of the sequence).
-                assert(sampleOffset <= sparseSequence->m_totalNnzCount);
+                assert(sampleOffset <= sparseSequence.m_totalNnzCount);
             }
             else
             {
@@ -183,11 +189,16 @@ MBLayoutPtr SequencePacker::PackSparseStream(const StreamBatch& batch, size_t st
     assert(m_outputStreamDescriptions[streamIndex]->m_storageType == StorageType::sparse_csc);
 
     // compute the aggregate nnz count of all the sequence in the batch.
+    // The sequences are kept as plain pointers, casting shared pointers for each sample costs reference counting.
     size_t nnzCount = 0;
+    size_t numSamples = 0;
+    m_sparseSequences.clear();
     for (const auto& sequence : batch)
     {
-        SparseSequenceDataPtr sparseSequence = static_pointer_cast<SparseSequenceData>(sequence);
+        auto sparseSequence = static_cast<SparseSequenceData*>(sequence.get());
+        m_sparseSequences.push_back(sparseSequence);
         nnzCount += sparseSequence->m_totalNnzCount;
+        numSamples += sparseSequence->m_numberOfSamples;
     }
 
     if (nnzCount > numeric_limits<IndexType>::max())
@@ -205,78 +216,100 @@ MBLayoutPtr SequencePacker::PackSparseStream(const StreamBatch& batch, size_t st
     // Compute the required buffer size:
     // size of nnz type + nnz * (size of the element type) + nnz * (size of the row index type) + 
     // (number of columns + 1) * (size of the column index type). 
-    size_t requiredSize =
-        sizeof(nnzCount) +
-        nnzCount * (elementSize + indexSize) +
-        indexSize * (pMBLayout->GetNumCols() + 1);
+    auto bufferSize = [&](size_t nnz, size_t numColumns)
+    {
+        return sizeof(nnzCount) + nnz * (elementSize + indexSize) + indexSize * (numColumns + 1);
+    };
+    size_t requiredSize = bufferSize(nnzCount, pMBLayout->GetNumCols());
+
+    // A buffer that has to grow is sized for a full minibatch at the density of the stream seen so far,
+    // so that minibatches with more non-zero values than the previous ones do not reallocate it each time.
+    if (m_sparseStatistics.size() <= streamIndex)
+        m_sparseStatistics.resize(m_outputStreamDescriptions.size());
+    auto& statistics = m_sparseStatistics[streamIndex];
+    statistics.first += nnzCount;
+    statistics.second += numSamples;
 
     auto& buffer = m_streamBuffers[m_currentBufferIndex][streamIndex];
     if (buffer.m_size < requiredSize)
     {
-        buffer.Resize(requiredSize);
+        size_t minibatchSize = max(m_config.m_minibatchSizeInSamples, pMBLayout->GetNumCols());
+        size_t expectedNnz = statistics.second > 0 ? (size_t)((double)statistics.first / statistics.second * minibatchSize) : 0;
+        buffer.Resize(max(requiredSize, bufferSize(expectedNnz, minibatchSize)));
     }
 
     auto* destination = buffer.m_data.get();
     // insert the nnzCount as the first element in the buffer.
     memcpy(destination, &nnzCount, sizeof(nnzCount));
 
-    // create two pointers to the memory blocks inside the buffer,
-    // one for data portion and anther -- for indices.
+    // create three pointers to the memory blocks inside the buffer,
+    // for the values, the row indices and the column starts of the CSC matrix.
     auto* dataDst = destination + sizeof(nnzCount);
-    auto* indicesDst = dataDst + elementSize* nnzCount;
+    auto* indicesDst = dataDst + elementSize * nnzCount;
+    auto* columnStartsDst = indicesDst + indexSize * nnzCount;
     // column index for the current sample (= number of nnz value packed so far).
     IndexType columnOffset = 0;
-    // a vector to store column index for each sample in the resulting (packed) matrix.
-    vector<IndexType> sparseColumnIndices;
-    // a vector to keep track of the offsets into each input sequence,
+
+    // keep track of the offsets into each input sequence,
     // there an offset is the number of nnz values packed so far. Current sample
     // values/indices start of the offset position in the sequence data/index array
-    vector<IndexType>  sequenceOffsets(batch.size(), 0); 
-
-    vector<MBLayout::SequenceInfo> sequenceInfos(pMBLayout->GetAllSequences());
-
-    // sort the vector in ascending order of the parallel sequence index.
-    sort(sequenceInfos.begin(), sequenceInfos.end(),
-        [](const MBLayout::SequenceInfo& a, const MBLayout::SequenceInfo& b){ return a.s < b.s; });
+    m_sequenceOffsets.assign(batch.size(), 0);
+
+    // The sequences (and gaps) of each parallel sequence of the layout, in time order.
+    size_t numParallelSequences = pMBLayout->GetNumParallelSequences();
+    if (m_parallelSequences.size() < numParallelSequences)
+        m_parallelSequences.resize(numParallelSequences);
+    for (size_t s = 0; s < numParallelSequences; ++s)
+        m_parallelSequences[s].clear();
+    for (const auto& sequenceInfo : pMBLayout->GetAllSequences())
+        m_parallelSequences[sequenceInfo.s].push_back(&sequenceInfo);
+    for (size_t s = 0; s < numParallelSequences; ++s)
+    {
+        sort(m_parallelSequences[s].begin(), m_parallelSequences[s].end(),
+            [](const MBLayout::SequenceInfo* a, const MBLayout::SequenceInfo* b) { return a->tBegin < b->tBegin; });
+    }
+    m_parallelSequenceCursors.assign(numParallelSequences, 0);
 
     // Iterate over the all time steps in the layout (total number of samples/columns 
-    // in a parallel sequence), traversing the layout in horizontal direction.
-    for (auto timeStep = 0; timeStep < pMBLayout->GetNumTimeSteps(); ++timeStep)
+    // in a parallel sequence), traversing the layout in horizontal direction,
+    // and for each time step over the parallel sequences, which is the column order of the matrix.
+    for (size_t timeStep = 0; timeStep < pMBLayout->GetNumTimeSteps(); ++timeStep)
     {
-        // For each time step, iterate over all sequences in the minibatch,
-        // traversing the layout in vertical direction.
-        for (const auto& sequenceInfo : sequenceInfos)
+        for (size_t s = 0; s < numParallelSequences; ++s)
         {
-            // skip the sequence if it does not intersect with the time step
-            if (timeStep < sequenceInfo.tBegin || timeStep >= sequenceInfo.tEnd)
-            {
+            // store the offset of the current column.
+            memcpy(columnStartsDst, &columnOffset, indexSize);
+            columnStartsDst += indexSize;
+
+            // find the sequence of the parallel sequence that intersects with the time step, if any.
+            const auto& sequences = m_parallelSequences[s];
+            auto& cursor = m_parallelSequenceCursors[s];
+            while (cursor < sequences.size() && sequences[cursor]->tEnd <= timeStep)
+                cursor++;
+            if (cursor == sequences.size())
                 continue;
-            }
-
-            // store the offset of the current column )...
-            sparseColumnIndices.push_back(columnOffset);
 
+            const auto& sequenceInfo = *sequences[cursor];
             auto seqId = sequenceInfo.seqId;
-            if (seqId == GAP_SEQUENCE_ID)
+            if (seqId == GAP_SEQUENCE_ID || sequenceInfo.tBegin > (ptrdiff_t)timeStep)
             {
                 continue;
             }
 
             // compute the index of the sample inside the sequence.
             size_t sampleIndex = timeStep - sequenceInfo.tBegin;
-            const auto& sequence = batch[seqId];
-            
+            SparseSequenceData* sparseSequence = m_sparseSequences[seqId];
+
             // make sure the index less than the sequence length in samples.
-            assert(sampleIndex < sequence->m_numberOfSamples);
+            assert(sampleIndex < sparseSequence->m_numberOfSamples);
 
-            auto& sequenceOffset = sequenceOffsets[seqId];
-            SparseSequenceDataPtr sparseSequence = static_pointer_cast<SparseSequenceData>(sequence);
+            auto& sequenceOffset = m_sequenceOffsets[seqId];
             IndexType nnz = sparseSequence->m_nnzCounts[sampleIndex];
 
             // compute the sample offset in bytes.
             size_t sampleOffset = sequenceOffset * elementSize;
             // copy all nzz values from source sequence into the buffer.
-            const auto* dataSrc = reinterpret_cast<const char*>(sequence->GetDataBuffer()) + sampleOffset;
+            const auto* dataSrc = reinterpret_cast<const char*>(sparseSequence->GetDataBuffer()) + sampleOffset;
             memcpy(dataDst, dataSrc, nnz * elementSize);
             dataDst += nnz * elementSize; // advance the destination pointer
 
@@ -293,21 +326,17 @@ MBLayoutPtr SequencePacker::PackSparseStream(const StreamBatch& batch, size_t st
     // at this point each element in sequenceOffsets should be equal to the total
     // nnz count of the respective sequence and the sum of all elements - to the 
     // overall nnz count.
-    assert(accumulate(sequenceOffsets.begin(), sequenceOffsets.end(), 0) == nnzCount);
+    assert(accumulate(m_sequenceOffsets.begin(), m_sequenceOffsets.end(), (size_t)0) == nnzCount);
 
     // check the distance between data and index destination pointers.
     assert(indicesDst == dataDst + nnzCount * indexSize);
     // after we packed all samples, the column offset must be equal to the total nnz count.
     assert(columnOffset == nnzCount);
-    sparseColumnIndices.push_back(columnOffset);
-    // check that the number of column indices == N + 1 (where N is the number of
-    // column in the packed matrix)
-    assert((pMBLayout->GetNumCols() + 1) == sparseColumnIndices.size());
-
-    // verify that there's enough space in the buffer for the array of column indices.
-    assert(indicesDst + sparseColumnIndices.size()*indexSize <= destination + requiredSize);
-    // copy column indices into the buffer.
-    memcpy(indicesDst, sparseColumnIndices.data(), sparseColumnIndices.size() * indexSize);
+
+    // the last column start closes the matrix, N + 1 of them for N columns.
+    memcpy(columnStartsDst, &columnOffset, indexSize);
+    columnStartsDst += indexSize;
+    assert(columnStartsDst == destination + requiredSize);
 
     return pMBLayout;
 }
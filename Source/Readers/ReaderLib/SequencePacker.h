@@ -34,6 +34,16 @@ protected:
 
     // Helper function to check the sample shape of input samples.
     void CheckSampleShape(const std::vector<SequenceDataPtr>& minibatch, StreamDescriptionPtr outputStream);
+
+private:
+    // Scratch space of PackSparseStream, kept between minibatches so that packing does not allocate.
+    std::vector<SparseSequenceData*> m_sparseSequences;
+    std::vector<std::vector<const MBLayout::SequenceInfo*>> m_parallelSequences;
+    std::vector<size_t> m_parallelSequenceCursors;
+    std::vector<size_t> m_sequenceOffsets;
+
+    // Non-zero values and samples packed so far, for each sparse stream.
+    std::vector<std::pair<size_t, size_t>> m_sparseStatistics;
 };
 
 typedef std::shared_ptr<SequencePacker> SequencePackerPtr;
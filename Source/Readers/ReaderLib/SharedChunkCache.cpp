@@ -0,0 +1,490 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE.md file in the project root for full license information.
+//
+
+#define _CRT_SECURE_NO_WARNINGS
+
+#define __STDC_FORMAT_MACROS
+#include <inttypes.h>
+#include <atomic>
+#include <chrono>
+#include <thread>
+#include <unordered_map>
+#include "SharedChunkCache.h"
+#include "ElementTypeUtils.h"
+#ifndef _WIN32
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+namespace Microsoft { namespace MSR { namespace CNTK {
+
+#ifndef _WIN32
+
+// Layout of a shared chunk: a SharedChunkHeader, a SharedSequenceEntry for each sequence, then the records
+// of the sequences. A record holds all streams of a sequence one after the other: a SharedStreamHeader, the
+// dimensions of the sample layout, for sparse streams the nnz counts and the indices, then the values in the
+// element type of the sequence.
+// Every part starts at a multiple of SharedChunkAlignment.
+enum SharedChunkState : uint32_t
+{
+    Loading = 0,
+    Ready = 1,
+    Failed = 2
+};
+
+struct SharedChunkHeader
+{
+    uint32_t m_state; // SharedChunkState, accessed atomically as the processes poll it
+    uint32_t m_numSequences;
+    uint64_t m_size; // of the whole object in bytes
+};
+
+struct SharedSequenceEntry
+{
+    uint64_t m_id;
+    uint64_t m_offset; // of the record from the start of the object
+};
+
+struct SharedStreamHeader
+{
+    uint32_t m_numberOfSamples;
+    uint32_t m_elementType;
+    uint32_t m_rank; // of the sample layout of the sequence, 0 if it uses the one of the stream
+    uint32_t m_numNnzCounts;
+    uint32_t m_totalNnzCount;
+    uint32_t m_reserved;
+};
+
+static const size_t SharedChunkAlignment = 8;
+
+static_assert(sizeof(std::atomic<uint32_t>) == sizeof(uint32_t), "The state of a shared chunk has to be usable as an atomic.");
+
+static size_t AlignUp(size_t size)
+{
+    return (size + SharedChunkAlignment - 1) / SharedChunkAlignment * SharedChunkAlignment;
+}
+
+static const std::atomic<uint32_t>& GetState(const SharedChunkHeader* header)
+{
+    return *reinterpret_cast<const std::atomic<uint32_t>*>(&header->m_state);
+}
+
+static std::atomic<uint32_t>& GetState(SharedChunkHeader* header)
+{
+    return *reinterpret_cast<std::atomic<uint32_t>*>(&header->m_state);
+}
+
+static void Append(std::vector<char>& buffer, const void* data, size_t size)
+{
+    buffer.insert(buffer.end(), (const char*)data, (const char*)data + size);
+    buffer.resize(AlignUp(buffer.size()));
+}
+
+// A mapping of a shared memory object, unmapped when the last chunk or sequence referring to it goes away.
+class SharedMemoryRegion
+{
+public:
+    SharedMemoryRegion(const std::string& name, int fd, size_t size, bool writable)
+        : m_size(size)
+    {
+        void* data = mmap(nullptr, size, writable ? PROT_READ | PROT_WRITE : PROT_READ, MAP_SHARED, fd, 0);
+        if (data == MAP_FAILED)
+            RuntimeError("SharedChunkCache: cannot map shared memory object '%s': %s.", name.c_str(), strerror(errno));
+        m_data = (char*)data;
+    }
+
+    ~SharedMemoryRegion()
+    {
+        munmap(m_data, m_size);
+        if (!m_ownedName.empty())
+            shm_unlink(m_ownedName.c_str());
+    }
+
+    char* GetData() const { return m_data; }
+
+    // The name is removed with the mapping of the process that created the object.
+    void SetOwnedName(const std::string& name) { m_ownedName = name; }
+
+private:
+    char* m_data;
+    size_t m_size;
+    std::string m_ownedName;
+
+    DISABLE_COPY_AND_MOVE(SharedMemoryRegion);
+};
+
+typedef std::shared_ptr<SharedMemoryRegion> SharedMemoryRegionPtr;
+
+// Sequences point into the shared memory and keep it mapped.
+struct SharedDenseSequenceData : DenseSequenceData
+{
+    const void* GetDataBuffer() override
+    {
+        return m_data;
+    }
+
+    const void* m_data;
+    SharedMemoryRegionPtr m_region;
+};
+
+struct SharedSparseSequenceData : SparseSequenceData
+{
+    const void* GetDataBuffer() override
+    {
+        return m_data;
+    }
+
+    const void* m_data;
+    SharedMemoryRegionPtr m_region;
+};
+
+// A chunk in shared memory.
+class SharedChunk : public Chunk
+{
+public:
+    SharedChunk(SharedMemoryRegionPtr region, const std::vector<StreamDescriptionPtr>& streams)
+        : m_region(region), m_streams(streams)
+    {
+        auto header = (const SharedChunkHeader*)m_region->GetData();
+        auto entries = (const SharedSequenceEntry*)(m_region->GetData() + AlignUp(sizeof(SharedChunkHeader)));
+        m_offsets.reserve(header->m_numSequences);
+        for (uint32_t i = 0; i < header->m_numSequences; i++)
+            m_offsets[entries[i].m_id] = entries[i].m_offset;
+    }
+
+    void GetSequence(size_t sequenceId, std::vector<SequenceDataPtr>& result) override
+    {
+        auto offset = m_offsets.find(sequenceId);
+        if (offset == m_offsets.end())
+            LogicError("SharedChunkCache: sequence %" PRIu64 " is not part of the chunk.", (uint64_t)sequenceId);
+
+        const char* position = m_region->GetData() + offset->second;
+        for (const auto& stream : m_streams)
+        {
+            auto header = (const SharedStreamHeader*)position;
+            position += AlignUp(sizeof(SharedStreamHeader));
+
+            TensorShapePtr layout;
+            if (header->m_rank > 0)
+            {
+                auto dims = (const uint64_t*)position;
+                SmallVector<size_t> shape(header->m_rank);
+                for (uint32_t k = 0; k < header->m_rank; k++)
+                    shape[k] = (size_t)dims[k];
+                layout = std::make_shared<TensorShape>(shape);
+                position += AlignUp(header->m_rank * sizeof(uint64_t));
+            }
+
+            size_t elementSize = GetSizeByType((ElementType)header->m_elementType);
+            SequenceDataPtr data;
+            if (stream->m_storageType == StorageType::sparse_csc)
+            {
+                auto sparse = MakeSequenceData<SharedSparseSequenceData>();
+                auto nnzCounts = (const IndexType*)position;
+                sparse->m_nnzCounts.assign(nnzCounts, nnzCounts + header->m_numNnzCounts);
+                position += AlignUp(header->m_numNnzCounts * sizeof(IndexType));
+                sparse->m_totalNnzCount = header->m_totalNnzCount;
+                sparse->m_indices = (IndexType*)position; // read-only, as for any sequence handed out by a deserializer
+                position += AlignUp(header->m_totalNnzCount * sizeof(IndexType));
+                sparse->m_data = position;
+                position += AlignUp(header->m_totalNnzCount * elementSize);
+                sparse->m_region = m_region;
+                data = sparse;
+            }
+            else
+            {
+                auto dense = MakeSequenceData<SharedDenseSequenceData>();
+                dense->m_data = position;
+                size_t numElements = (layout ? layout : stream->m_sampleLayout)->GetNumElements();
+                position += AlignUp(header->m_numberOfSamples * numElements * elementSize);
+                dense->m_region = m_region;
+                data = dense;
+            }
+
+            data->m_id = sequenceId;
+            data->m_numberOfSamples = header->m_numberOfSamples;
+            data->m_elementType = (ElementType)header->m_elementType;
+            data->m_sampleLayout = layout;
+            result.push_back(data);
+        }
+    }
+
+private:
+    SharedMemoryRegionPtr m_region;
+    std::vector<StreamDescriptionPtr> m_streams;
+    std::unordered_map<size_t, size_t> m_offsets; // sequence id -> offset of its record
+};
+
+#endif
+
+SharedChunkCache::SharedChunkCache(IDataDeserializerPtr deserializer, const std::wstring& name, int verbosity, size_t timeoutInSeconds)
+    : m_deserializer(deserializer),
+      m_verbosity(verbosity),
+      m_timeoutInSeconds(timeoutInSeconds)
+{
+    if (name.empty())
+        InvalidArgument("SharedChunkCache: the name of the cache must not be empty.");
+
+    // POSIX names start with a slash and contain no other.
+    m_name = "/cntk-chunks-";
+    for (char c : msra::strfun::utf8(name))
+        m_name += isalnum((unsigned char)c) || c == '-' || c == '_' || c == '.' ? c : '_';
+
+    m_streams = m_deserializer->GetStreamDescriptions();
+
+    if (!IsSupported())
+        fprintf(stderr, "WARNING: SharedChunkCache: sharing chunks across processes is not supported on this platform, every process loads its own chunks.\n");
+}
+
+SharedChunkCache::~SharedChunkCache()
+{
+    if (m_verbosity > 0)
+        fprintf(stderr, "SharedChunkCache: %" PRIu64 " chunks loaded and shared, %" PRIu64 " mapped from other processes, %" PRIu64 " loaded without sharing\n",
+                (uint64_t)m_statistics.m_numLoaded, (uint64_t)m_statistics.m_numMapped, (uint64_t)m_statistics.m_numLocal);
+}
+
+bool SharedChunkCache::IsSupported()
+{
+#ifdef _WIN32
+    return false;
+#else
+    return true;
+#endif
+}
+
+void SharedChunkCache::CountChunk(size_t Statistics::*counter)
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_statistics.*counter += 1;
+}
+
+SharedChunkCache::Statistics SharedChunkCache::GetStatistics() const
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return m_statistics;
+}
+
+#ifdef _WIN32
+
+ChunkPtr SharedChunkCache::GetChunk(ChunkIdType chunkId)
+{
+    CountChunk(&Statistics::m_numLocal);
+    return m_deserializer->GetChunk(chunkId);
+}
+
+ChunkPtr SharedChunkCache::LoadAndShare(ChunkIdType, const std::string&, int)
+{
+    NOT_IMPLEMENTED;
+}
+
+ChunkPtr SharedChunkCache::MapShared(const std::string&, int)
+{
+    NOT_IMPLEMENTED;
+}
+
+std::vector<char> SharedChunkCache::SerializeChunk(ChunkIdType)
+{
+    NOT_IMPLEMENTED;
+}
+
+#else
+
+ChunkPtr SharedChunkCache::GetChunk(ChunkIdType chunkId)
+{
+    std::string name = m_name + "-" + std::to_string(chunkId);
+    for (;;)
+    {
+        // Whoever creates the object loads the chunk, the others wait for it.
+        int fd = shm_open(name.c_str(), O_RDWR | O_CREAT | O_EXCL, 0600);
+        if (fd >= 0)
+            return LoadAndShare(chunkId, name, fd);
+        if (errno != EEXIST)
+            RuntimeError("SharedChunkCache: cannot create shared memory object '%s': %s.", name.c_str(), strerror(errno));
+
+        fd = shm_open(name.c_str(), O_RDONLY, 0);
+        if (fd < 0)
+        {
+            if (errno == ENOENT) // released meanwhile, try to create it again
+                continue;
+            RuntimeError("SharedChunkCache: cannot open shared memory object '%s': %s.", name.c_str(), strerror(errno));
+        }
+
+        ChunkPtr chunk;
+        try
+        {
+            chunk = MapShared(name, fd);
+        }
+        catch (...)
+        {
+            close(fd);
+            throw;
+        }
+        close(fd);
+
+        if (chunk)
+        {
+            CountChunk(&Statistics::m_numMapped);
+            return chunk;
+        }
+
+        // The other process failed, or takes so long that it may be gone; in the latter case its object
+        // would keep everybody waiting, so the name is removed. The chunk is loaded without sharing it,
+        // which also reports the error if loading fails.
+        shm_unlink(name.c_str());
+        if (m_verbosity > 0)
+            fprintf(stderr, "SharedChunkCache: chunk %u was not loaded by another process, loading it without sharing.\n", chunkId);
+        CountChunk(&Statistics::m_numLocal);
+        return m_deserializer->GetChunk(chunkId);
+    }
+}
+
+ChunkPtr SharedChunkCache::LoadAndShare(ChunkIdType chunkId, const std::string& name, int fd)
+{
+    SharedMemoryRegionPtr headerRegion;
+    try
+    {
+        // The header comes first, so that the waiting processes see that the chunk is being loaded
+        // (the object is zero filled, i.e. in the Loading state).
+        if (ftruncate(fd, sizeof(SharedChunkHeader)) != 0)
+            RuntimeError("SharedChunkCache: cannot resize shared memory object '%s': %s.", name.c_str(), strerror(errno));
+        headerRegion = std::make_shared<SharedMemoryRegion>(name, fd, sizeof(SharedChunkHeader), true);
+
+        std::vector<char> buffer = SerializeChunk(chunkId);
+        if (ftruncate(fd, buffer.size()) != 0)
+            RuntimeError("SharedChunkCache: cannot resize shared memory object '%s' to %" PRIu64 " bytes: %s.", name.c_str(), (uint64_t)buffer.size(), strerror(errno));
+
+        auto region = std::make_shared<SharedMemoryRegion>(name, fd, buffer.size(), true);
+        memcpy(region->GetData(), buffer.data(), buffer.size());
+        region->SetOwnedName(name);
+        GetState((SharedChunkHeader*)region->GetData()).store(SharedChunkState::Ready, std::memory_order_release);
+        close(fd);
+
+        CountChunk(&Statistics::m_numLoaded);
+        return std::make_shared<SharedChunk>(region, m_streams);
+    }
+    catch (...)
+    {
+        if (headerRegion)
+            GetState((SharedChunkHeader*)headerRegion->GetData()).store(SharedChunkState::Failed, std::memory_order_release);
+        shm_unlink(name.c_str());
+        close(fd);
+        throw;
+    }
+}
+
+ChunkPtr SharedChunkCache::MapShared(const std::string& name, int fd)
+{
+    auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(m_timeoutInSeconds);
+    auto wait = [&]()
+    {
+        if (std::chrono::steady_clock::now() > deadline)
+            return false;
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        return true;
+    };
+
+    // The loading process may not have written the header yet.
+    struct stat status;
+    for (;;)
+    {
+        if (fstat(fd, &status) != 0)
+            RuntimeError("SharedChunkCache: cannot get the size of shared memory object '%s': %s.", name.c_str(), strerror(errno));
+        if ((size_t)status.st_size >= sizeof(SharedChunkHeader))
+            break;
+        if (!wait())
+            return nullptr;
+    }
+
+    SharedMemoryRegion headerRegion(name, fd, sizeof(SharedChunkHeader), false);
+    auto header = (const SharedChunkHeader*)headerRegion.GetData();
+    uint32_t state;
+    while ((state = GetState(header).load(std::memory_order_acquire)) == SharedChunkState::Loading)
+    {
+        if (!wait())
+            return nullptr;
+    }
+
+    if (state != SharedChunkState::Ready)
+        return nullptr;
+
+    auto region = std::make_shared<SharedMemoryRegion>(name, fd, (size_t)header->m_size, false);
+    return std::make_shared<SharedChunk>(region, m_streams);
+}
+
+std::vector<char> SharedChunkCache::SerializeChunk(ChunkIdType chunkId)
+{
+    std::vector<SequenceDescription> sequences;
+    m_deserializer->GetSequencesForChunk(chunkId, sequences);
+    ChunkPtr chunk = m_deserializer->GetChunk(chunkId);
+
+    size_t indexStart = AlignUp(sizeof(SharedChunkHeader));
+    std::vector<char> buffer(indexStart + AlignUp(sequences.size() * sizeof(SharedSequenceEntry)));
+    std::vector<SharedSequenceEntry> entries(sequences.size());
+    std::vector<SequenceDataPtr> data;
+    for (size_t i = 0; i < sequences.size(); i++)
+    {
+        entries[i].m_id = sequences[i].m_id;
+        entries[i].m_offset = buffer.size();
+
+        data.clear();
+        chunk->GetSequence(sequences[i].m_id, data);
+        if (data.size() != m_streams.size())
+            LogicError("SharedChunkCache: sequence %" PRIu64 " has %d streams, expected %d.", (uint64_t)sequences[i].m_id, (int)data.size(), (int)m_streams.size());
+
+        for (size_t j = 0; j < data.size(); j++)
+        {
+            SharedStreamHeader header = {};
+            header.m_numberOfSamples = data[j]->m_numberOfSamples;
+            header.m_elementType = (uint32_t)data[j]->m_elementType;
+            header.m_rank = data[j]->m_sampleLayout ? (uint32_t)data[j]->m_sampleLayout->GetRank() : 0;
+
+            size_t elementSize = GetSizeByType(data[j]->m_elementType);
+            if (m_streams[j]->m_storageType == StorageType::sparse_csc)
+            {
+                auto sparse = std::static_pointer_cast<SparseSequenceData>(data[j]);
+                header.m_numNnzCounts = (uint32_t)sparse->m_nnzCounts.size();
+                header.m_totalNnzCount = (uint32_t)sparse->m_totalNnzCount;
+                Append(buffer, &header, sizeof(header));
+                if (header.m_rank > 0)
+                {
+                    std::vector<uint64_t> dims(data[j]->m_sampleLayout->GetDims().begin(), data[j]->m_sampleLayout->GetDims().end());
+                    Append(buffer, dims.data(), dims.size() * sizeof(uint64_t));
+                }
+                Append(buffer, sparse->m_nnzCounts.data(), sparse->m_nnzCounts.size() * sizeof(IndexType));
+                Append(buffer, sparse->m_indices, sparse->m_totalNnzCount * sizeof(IndexType));
+                Append(buffer, sparse->GetDataBuffer(), sparse->m_totalNnzCount * elementSize);
+            }
+            else
+            {
+                Append(buffer, &header, sizeof(header));
+                auto layout = data[j]->m_sampleLayout ? data[j]->m_sampleLayout : m_streams[j]->m_sampleLayout;
+                if (header.m_rank > 0)
+                {
+                    std::vector<uint64_t> dims(layout->GetDims().begin(), layout->GetDims().end());
+                    Append(buffer, dims.data(), dims.size() * sizeof(uint64_t));
+                }
+                Append(buffer, data[j]->GetDataBuffer(), data[j]->m_numberOfSamples * layout->GetNumElements() * elementSize);
+            }
+        }
+    }
+
+    if (sequences.size() > UINT32_MAX)
+        RuntimeError("SharedChunkCache: chunk %u has too many sequences to be shared.", chunkId);
+
+    SharedChunkHeader header = {};
+    header.m_state = SharedChunkState::Loading;
+    header.m_numSequences = (uint32_t)sequences.size();
+    header.m_size = buffer.size();
+    memcpy(buffer.data(), &header, sizeof(header));
+    if (!entries.empty())
+        memcpy(buffer.data() + indexStart, entries.data(), entries.size() * sizeof(SharedSequenceEntry));
+    return buffer;
+}
+
+#endif
+
+} } }
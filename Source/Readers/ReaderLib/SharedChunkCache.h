@@ -0,0 +1,94 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE.md file in the project root for full license information.
+//
+
+#pragma once
+
+#include <mutex>
+#include <string>
+#include "DataDeserializer.h"
+
+namespace Microsoft { namespace MSR { namespace CNTK {
+
+// A chunk store shared by the processes of one node, e.g. the MPI ranks of a multi-GPU machine.
+// The first process that needs a chunk loads it from the wrapped deserializer and copies all of its
+// sequences into a named shared memory object; the other processes that need the chunk while it is
+// loaded map that object read-only instead of loading and decoding their own copy. Every process keeps
+// its own randomization and decimation, only the chunk data is shared.
+// The loading process removes the name when it releases the chunk, the mappings of the others stay valid.
+// Processes that share a name have to wrap deserializers with identical configuration.
+// Only implemented on Linux (POSIX shared memory), elsewhere every process loads its own chunks.
+// Implemented as a wrapping proxy around a deserializer.
+class SharedChunkCache : public IDataDeserializer
+{
+public:
+    struct Statistics
+    {
+        size_t m_numLoaded = 0; // chunks loaded by this process and shared with the others
+        size_t m_numMapped = 0; // chunks loaded by another process
+        size_t m_numLocal = 0;  // chunks loaded by this process without sharing them
+    };
+
+    // 'name' identifies the cache among the processes of the node.
+    // A process waits at most 'timeoutInSeconds' for another one loading the chunk, then loads it itself.
+    SharedChunkCache(IDataDeserializerPtr deserializer, const std::wstring& name, int verbosity = 0, size_t timeoutInSeconds = 600);
+
+    ~SharedChunkCache();
+
+    virtual std::vector<StreamDescriptionPtr> GetStreamDescriptions() const override
+    {
+        return m_streams;
+    }
+
+    virtual ChunkDescriptions GetChunkDescriptions() override
+    {
+        return m_deserializer->GetChunkDescriptions();
+    }
+
+    virtual void GetSequencesForChunk(ChunkIdType chunkId, std::vector<SequenceDescription>& descriptions) override
+    {
+        return m_deserializer->GetSequencesForChunk(chunkId, descriptions);
+    }
+
+    virtual bool GetSequenceDescription(const SequenceDescription& primary, SequenceDescription& description) override
+    {
+        return m_deserializer->GetSequenceDescription(primary, description);
+    }
+
+    // Gets chunk data given its id.
+    virtual ChunkPtr GetChunk(ChunkIdType chunkId) override;
+
+    Statistics GetStatistics() const;
+
+    // Whether chunks can be shared on this platform.
+    static bool IsSupported();
+
+private:
+    // Loads the chunk and publishes it under the given name, 'fd' being the newly created shared memory object.
+    ChunkPtr LoadAndShare(ChunkIdType chunkId, const std::string& name, int fd);
+
+    // Maps the chunk another process loads into the given shared memory object.
+    // Returns nullptr if that process failed or did not finish in time.
+    ChunkPtr MapShared(const std::string& name, int fd);
+
+    // Copies all sequences of the chunk into a buffer in the shared layout.
+    std::vector<char> SerializeChunk(ChunkIdType chunkId);
+
+    void CountChunk(size_t Statistics::*counter);
+
+    IDataDeserializerPtr m_deserializer;
+    std::vector<StreamDescriptionPtr> m_streams;
+    std::string m_name; // prefix of the names of the shared memory objects
+    int m_verbosity;
+    size_t m_timeoutInSeconds;
+
+    Statistics m_statistics;
+
+    // Chunks can be requested from several threads (see BlockRandomizer).
+    mutable std::mutex m_mutex;
+
+    DISABLE_COPY_AND_MOVE(SharedChunkCache);
+};
+
+} } }
@@ -17,7 +17,7 @@ namespace Microsoft { namespace MSR { namespace CNTK {
 class TransformBase : public Transformer
 {
 public:
-    explicit TransformBase(const ConfigParameters& config)
+    explicit TransformBase(const ConfigParameters& config) : m_epochIndex(0)
     {
         m_seed = config(L"seed", 0u);
         std::wstring precision = config(L"precision", L"float");
@@ -29,7 +29,10 @@ public:
             RuntimeError("Unsupported precision type is specified, '%ls'", precision.c_str());
     }
 
-    void StartEpoch(const EpochConfiguration&) override {}
+    void StartEpoch(const EpochConfiguration& config) override
+    {
+        m_epochIndex = config.m_epochIndex;
+    }
 
     // The method describes how input stream is transformed to the output stream. Called once per applied stream.
     // Currently we only support transforms of dense streams.
@@ -54,14 +57,37 @@ protected:
         return m_seed;
     }
 
+    // Seed for the random numbers of a sequence in the current epoch, derived from the seed, the epoch and the sequence id.
+    // The sequences are transformed in parallel, so that a random generator per thread would make the augmentation
+    // depend on the scheduling; this way it is reproducible.
+    unsigned int GetSequenceSeed(size_t sequenceId) const
+    {
+        uint64_t x = Mix(m_seed);
+        x = Mix(x ^ m_epochIndex);
+        x = Mix(x ^ sequenceId);
+        return (unsigned int)x;
+    }
+
     // Input stream.
     StreamDescription m_inputStream;
     // Output stream.
     StreamDescription m_outputStream;
     // Seed.
     unsigned int m_seed;
+    // Current epoch, for GetSequenceSeed().
+    size_t m_epochIndex;
     // Required precision.
     ElementType m_precision;
+
+private:
+    // the finalizer of splitmix64
+    static uint64_t Mix(uint64_t x)
+    {
+        x += 0x9E3779B97F4A7C15ull;
+        x = (x ^ (x >> 30)) * 0xBF58476D1CE4E5B9ull;
+        x = (x ^ (x >> 27)) * 0x94D049BB133111EBull;
+        return x ^ (x >> 31);
+    }
 };
 
 }}}
@@ -5,11 +5,14 @@
 
 #pragma once
 
+#include <algorithm>
+#include <atomic>
 #include <set>
+#include <chrono>
 
 #include "Transformer.h"
 #include "SequenceEnumerator.h"
-#include "ExceptionCapture.h"
+#include "CPUThreadPool.h"
 
 namespace Microsoft { namespace MSR { namespace CNTK {
 
@@ -23,11 +26,14 @@ struct Transformation
 // A class responsible for applying a list of transformers to sequences and stream descriptions.
 // Delegates retrieving of sequences to another sequence provider(such as randomizer) and applies transformations after retrieving.
 // Usually used by the packer to get next set of sequences.
+// If the sequence provider gets sequences in parallel, the transforms are applied by the same tasks
+// (see SequenceEnumerator::SetSequenceTransform), so that a worker thread deserializes and transforms
+// a sequence in one go instead of all threads waiting for the slowest one between the two stages.
 class TransformController : public SequenceEnumerator
 {
 public:
     TransformController(const std::vector<Transformation>& transformations, SequenceEnumeratorPtr sequenceProvider)
-        : m_sequenceProvider(sequenceProvider)
+        : m_sequenceProvider(sequenceProvider), m_transformNanoseconds(0)
     {
         // Applying transformations to stream descriptions,
         // i.e. a transformation can change a stream from dense to sparse.
@@ -39,6 +45,13 @@ public:
             transformedStreams[streamId] = std::make_shared<StreamDescription>(t.m_transformer->Transform(*transformedStreams[streamId]));
         }
         m_outputStreams = transformedStreams;
+
+        m_transformsWithProvider = m_sequenceProvider->SetSequenceTransform([this](std::vector<SequenceDataPtr>& sequence)
+        {
+            auto start = std::chrono::high_resolution_clock::now();
+            Apply(sequence);
+            m_transformNanoseconds += std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::high_resolution_clock::now() - start).count();
+        });
     }
 
     // Returns current position in the global timeline. The returned value is in samples.
@@ -76,26 +89,37 @@ public:
     virtual Sequences GetNextSequences(size_t sampleCount) override
     {
         assert(m_sequenceProvider != nullptr);
+        auto start = std::chrono::high_resolution_clock::now();
+        if (m_transformsWithProvider)
+        {
+            // The stages overlap, the transforms are accounted with their share of the wall time,
+            // assuming all threads were busy.
+            m_transformNanoseconds = 0;
+            Sequences sequences = m_sequenceProvider->GetNextSequences(sampleCount);
+            double seconds = std::chrono::duration<double>(std::chrono::high_resolution_clock::now() - start).count();
+            sequences.m_transformSeconds += std::min(seconds, m_transformNanoseconds * 1e-9 / CPUThreadPool::Instance().NumThreads());
+            return sequences;
+        }
+
         Sequences sequences = m_sequenceProvider->GetNextSequences(sampleCount);
         if (sequences.m_data.empty())
         {
             return sequences;
         }
 
-        ExceptionCapture capture;
-#pragma omp parallel for schedule(dynamic)
-        for (int j = 0; j < sequences.m_data.front().size(); ++j)
+        start = std::chrono::high_resolution_clock::now();
+        // the thread pool rethrows the first exception of the transformers
+        CPUThreadPool::Instance().ParallelFor(sequences.m_data.front().size(), 1, [this, &sequences](size_t begin, size_t end)
         {
-            capture.SafeRun([this, &sequences](int sequenceId)
+            for (size_t sequenceId = begin; sequenceId < end; ++sequenceId)
             {
                 for (auto& t : m_transformations)
                 {
                     sequences.m_data[t.second][sequenceId] = t.first.m_transformer->Transform(sequences.m_data[t.second][sequenceId]);
                 }
-            }, j);
-        }
-
-        capture.RethrowIfHappened();
+            }
+        });
+        sequences.m_transformSeconds += std::chrono::duration<double>(std::chrono::high_resolution_clock::now() - start).count();
         return sequences;
     }
 
@@ -105,6 +129,15 @@ public:
     }
 
 private:
+    // Applies the transforms to the streams of one sequence.
+    void Apply(std::vector<SequenceDataPtr>& sequence) const
+    {
+        for (auto& t : m_transformations)
+        {
+            sequence[t.second] = t.first.m_transformer->Transform(sequence[t.second]);
+        }
+    }
+
     size_t GetStreamId(const std::wstring streamName, const std::vector<StreamDescriptionPtr>& streams) const
     {
         for (const auto& s : streams)
@@ -122,6 +155,12 @@ private:
     SequenceEnumeratorPtr m_sequenceProvider;
     std::vector<StreamDescriptionPtr> m_outputStreams;
     std::vector<std::pair<Transformation, size_t>> m_transformations;
+
+    // Whether the sequence provider applies the transforms.
+    bool m_transformsWithProvider;
+
+    // Time spent in the transforms by all threads during the current GetNextSequences().
+    std::atomic<int64_t> m_transformNanoseconds;
 };
 
 }}}
@@ -10,6 +10,7 @@
 #include <deque>
 #include "TruncatedBpttPacker.h"
 #include "ElementTypeUtils.h"
+#include "CPUThreadPool.h"
 
 namespace Microsoft { namespace MSR { namespace CNTK {
 
@@ -44,7 +45,7 @@ public:
         m_length += s->m_numberOfSamples;
     }
 
-    SequenceDataPtr FrontSequence() const
+    const SequenceDataPtr& FrontSequence() const
     {
         assert(!m_sequences.empty());
         return m_sequences.front();
@@ -154,6 +155,8 @@ void TruncatedBPTTPacker::SetConfiguration(const ReaderConfiguration& config, co
             (config.m_workerRank < (m_numParallelSequences % config.m_numberOfWorkers) ? 1 : 0);
 
         m_sequenceBufferPerStream.clear();
+        for (int i = 0; i < m_outputStreamDescriptions.size(); ++i)
+            m_sequenceBufferPerStream.push_back(make_shared<SequenceBuffer>(m_numParallelSequences));
 
         // Preparing the buffers.
         for (int j = 0; j < m_streamBuffers.size(); ++j)
@@ -162,7 +165,6 @@ void TruncatedBPTTPacker::SetConfiguration(const ReaderConfiguration& config, co
                 const auto& stream = m_outputStreamDescriptions[i];
                 auto& buffer = m_streamBuffers[j][i];
                 buffer.Resize(m_numParallelSequences * m_config.m_truncationSize * GetSampleSize(stream));
-                m_sequenceBufferPerStream.push_back(make_shared<SequenceBuffer>(m_numParallelSequences));
             }
     }
 
@@ -175,6 +177,7 @@ void TruncatedBPTTPacker::SetConfiguration(const ReaderConfiguration& config, co
 
 Minibatch TruncatedBPTTPacker::ReadMinibatch()
 {
+    auto start = StartTimings();
     Minibatch result;
 
     // Currently all we expect sequences of identical length between different streams,
@@ -190,10 +193,13 @@ Minibatch TruncatedBPTTPacker::ReadMinibatch()
     {
         m_currentLayouts[streamIndex]->Init(m_numParallelSequences, m_config.m_truncationSize);
         size_t sequenceId = 0;
+        m_segments.clear();
         for (size_t slotIndex = 0; slotIndex < m_numParallelSequences; ++slotIndex)
         {
             PackSlot(streamIndex, slotIndex, sequenceId);
         }
+        CopySegments(streamIndex);
+        m_segments.clear();
 
         StreamMinibatchPtr m = make_shared<StreamMinibatch>();
         m->m_data = m_streamBuffers[m_currentBufferIndex][streamIndex].m_data.get();
@@ -203,6 +209,7 @@ Minibatch TruncatedBPTTPacker::ReadMinibatch()
 
     m_currentBufferIndex = (m_currentBufferIndex + 1) % m_numberOfBuffers;
 
+    result.m_timings = GetTimings(start);
     return result;
 }
 
@@ -228,10 +235,6 @@ void TruncatedBPTTPacker::PackSlot(size_t streamIndex, size_t slotIndex, size_t&
 
     size_t sampleSize = GetSampleSize(m_inputStreamDescriptions[streamIndex]);
     StorageType storageType = m_inputStreamDescriptions[streamIndex]->m_storageType;
-    size_t elementSize = GetSizeByType(m_inputStreamDescriptions[streamIndex]->m_elementType);
-
-    // Distance between two samples of the same sequence in bytes.
-    size_t strideSize = m_numParallelSequences * sampleSize;
 
     // Add current sequence to the minibatch layout.
     m_currentLayouts[streamIndex]->AddSequence(
@@ -240,8 +243,9 @@ void TruncatedBPTTPacker::PackSlot(size_t streamIndex, size_t slotIndex, size_t&
         -(int)slot.m_sampleCursor,
         slot.FrontSequence()->m_numberOfSamples - slot.m_sampleCursor);
 
-    // Ok, now fill in the buffer with data.
-    for (size_t currentTimestep = 0; currentTimestep < numberOfSamples; ++currentTimestep)
+    // Ok, now take the samples, a segment at a time, each from one sequence of the slot.
+    size_t currentTimestep = 0;
+    while (currentTimestep < numberOfSamples)
     {
         // Check if reach the end of the front sequence.
         if (slot.m_sampleCursor >= slot.FrontSequence()->m_numberOfSamples)
@@ -257,34 +261,27 @@ void TruncatedBPTTPacker::PackSlot(size_t streamIndex, size_t slotIndex, size_t&
                 currentTimestep + slot.FrontSequence()->m_numberOfSamples);
         }
 
-        // Fill in the data from the first sequence in the slot.
-        auto data = slot.FrontSequence();
-        // Get buffer destination for the current sample.
-        auto& buffer = m_streamBuffers[m_currentBufferIndex][streamIndex];
-        auto offset = strideSize * currentTimestep + slotIndex * sampleSize;
-        assert(offset >= 0 && offset < buffer.m_size);
-        char* destination = buffer.m_data.get() + offset;
+        const auto& data = slot.FrontSequence();
+        size_t count = min(numberOfSamples - currentTimestep, data->m_numberOfSamples - slot.m_sampleCursor);
+        m_segments.push_back(PackSegment{ data, slotIndex, currentTimestep, slot.m_sampleCursor, slot.m_sampleOffset, count });
 
-        // Pack the sample.
         if (storageType == StorageType::dense)
         {
             assert(slot.m_sampleOffset == slot.m_sampleCursor * sampleSize);
-            PackDenseSample(destination, data, slot.m_sampleOffset, sampleSize);
-            slot.m_sampleOffset += sampleSize;
+            slot.m_sampleOffset += count * sampleSize;
         }
         else
         {
             assert(storageType == StorageType::sparse_csc);
-            // TODO: make type casts members of the SparseSequenceData
-            SparseSequenceDataPtr sparseSequence = static_pointer_cast<SparseSequenceData>(data);
-            assert(slot.m_sampleCursor < sparseSequence->m_nnzCounts.size());
-            PackSparseSampleAsDense(destination, sparseSequence, slot.m_sampleCursor, 
-                slot.m_sampleOffset, sampleSize, elementSize);
-            slot.m_sampleOffset += sparseSequence->m_nnzCounts[slot.m_sampleCursor];
-            assert(slot.m_sampleOffset <= sparseSequence->m_totalNnzCount);
+            const auto& sparseSequence = static_cast<const SparseSequenceData&>(*data);
+            assert(slot.m_sampleCursor + count <= sparseSequence.m_nnzCounts.size());
+            for (size_t i = 0; i < count; ++i)
+                slot.m_sampleOffset += sparseSequence.m_nnzCounts[slot.m_sampleCursor + i];
+            assert(slot.m_sampleOffset <= sparseSequence.m_totalNnzCount);
         }
 
-        slot.m_sampleCursor++;
+        slot.m_sampleCursor += count;
+        currentTimestep += count;
     }
 
     // Cleaning up the last sequence we have just read if needed.
@@ -304,6 +301,55 @@ void TruncatedBPTTPacker::PackSlot(size_t streamIndex, size_t slotIndex, size_t&
     }
 }
 
+void TruncatedBPTTPacker::CopySegments(size_t streamIndex)
+{
+    size_t sampleSize = GetSampleSize(m_inputStreamDescriptions[streamIndex]);
+    bool isDense = m_inputStreamDescriptions[streamIndex]->m_storageType == StorageType::dense;
+    size_t elementSize = GetSizeByType(m_inputStreamDescriptions[streamIndex]->m_elementType);
+    auto& buffer = m_streamBuffers[m_currentBufferIndex][streamIndex];
+
+    // Distance between two samples of the same sequence in bytes.
+    size_t strideSize = m_numParallelSequences * sampleSize;
+
+    auto copy = [&](size_t begin, size_t end)
+    {
+        for (size_t k = begin; k < end; ++k)
+        {
+            const auto& segment = m_segments[k];
+            auto offset = strideSize * segment.m_firstTimestep + segment.m_slotIndex * sampleSize;
+            assert(offset + strideSize * (segment.m_numSamples - 1) < buffer.m_size);
+            char* destination = buffer.m_data.get() + offset;
+
+            if (isDense)
+            {
+                // The samples of the segment are contiguous in the sequence.
+                const char* source = (const char*)segment.m_sequence->GetDataBuffer() + segment.m_sampleOffset;
+                for (size_t i = 0; i < segment.m_numSamples; ++i, destination += strideSize, source += sampleSize)
+                    memcpy(destination, source, sampleSize);
+            }
+            else
+            {
+                // TODO: make type casts members of the SparseSequenceData
+                auto& sparseSequence = static_cast<SparseSequenceData&>(*segment.m_sequence);
+                size_t sampleOffset = segment.m_sampleOffset;
+                for (size_t i = 0; i < segment.m_numSamples; ++i, destination += strideSize)
+                {
+                    PackSparseSampleAsDense(destination, sparseSequence, segment.m_firstSample + i, sampleOffset, sampleSize, elementSize);
+                    sampleOffset += sparseSequence.m_nnzCounts[segment.m_firstSample + i];
+                }
+            }
+        }
+    };
+
+    // The slots go to disjoint columns, so the segments can be copied in parallel when that pays off.
+    const size_t minBytesPerRange = 256 * 1024;
+    size_t numBytes = 0;
+    for (const auto& segment : m_segments)
+        numBytes += segment.m_numSamples * sampleSize;
+    size_t minGrain = max<size_t>(1, minBytesPerRange * m_segments.size() / max<size_t>(1, numBytes));
+    CPUThreadPool::Instance().ParallelFor(m_segments.size(), minGrain, copy);
+}
+
 void TruncatedBPTTPacker::ReadSequencesToSlot(size_t slotIndex)
 {
     const auto& slot = m_sequenceBufferPerStream.front()->m_slots[slotIndex];
@@ -311,7 +357,7 @@ void TruncatedBPTTPacker::ReadSequencesToSlot(size_t slotIndex)
     {
         // We need a single sequence, potentially we can request (m_truncationSize - slot.AvailableNumberOfSamples())
         // to be more efficient. In reality the truncation size usually is less the sequence size.
-        auto s = m_sequenceEnumerator->GetNextSequences(1);
+        auto s = FetchSequences(1);
 
         // Adding sequence to the slot for all streams.
         for (size_t i = 0; i < s.m_data.size(); ++i)
@@ -34,13 +34,27 @@ private:
     // Number of slots = m_parallelNumberOfSequences
     void ReadSequencesToSlot(size_t slotIndex);
 
-    // Packs a slot into the data buffer.
+    // Packs a slot into the data buffer: adds its sequences to the layout and its samples to m_segments.
     // SequenceId specifies the starting value to be used as sequence identifier.
     // For each new input, sequence id is reset to 0, and incremented each time
     // a sequence is added to the layout. This allows layouts corresponding to different
     // inputs to have consistent sequence ids.
     void PackSlot(size_t streamIndex, size_t slotIndex, size_t& sequenceId);
 
+    // Copies the samples of m_segments into the current buffer of the stream, in parallel if there are many.
+    void CopySegments(size_t streamIndex);
+
+    // Consecutive samples of a sequence that go to consecutive time steps of a slot.
+    struct PackSegment
+    {
+        SequenceDataPtr m_sequence; // keeps the data until it is copied, the slot may have dropped it already
+        size_t m_slotIndex;
+        size_t m_firstTimestep;
+        size_t m_firstSample;
+        size_t m_sampleOffset;      // of the first sample, see Slot::m_sampleOffset
+        size_t m_numSamples;
+    };
+
     virtual MBLayoutPtr CreateMBLayout(const StreamBatch& batch)
     {
         UNUSED(batch);
@@ -59,6 +73,9 @@ private:
     // Layout per stream.
     // TODO: currently assume that layout is the same between different streams, this will change.
     std::vector<MBLayoutPtr> m_currentLayouts;
+
+    // Segments of the stream being packed, kept to reuse the memory.
+    std::vector<PackSegment> m_segments;
 };
 
 typedef std::shared_ptr<TruncatedBPTTPacker> TruncatedBPTTPackerPtr;
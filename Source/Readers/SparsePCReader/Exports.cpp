@@ -9,6 +9,7 @@
 #define DATAREADER_EXPORTS
 #include "DataReader.h"
 #include "SparsePCReader.h"
+#include "SparsePCDeserializer.h"
 
 namespace Microsoft { namespace MSR { namespace CNTK {
 
@@ -21,4 +22,16 @@ extern "C" DATAREADER_API void GetReaderD(IDataReader** preader)
     *preader = new SparsePCReader<double>();
 }
 
+// A factory method for creating the deserializer for the CompositeDataReader.
+extern "C" DATAREADER_API bool CreateDeserializer(IDataDeserializer** deserializer, const std::wstring& type, const ConfigParameters& deserializerConfig, CorpusDescriptorPtr corpus, bool isPrimary)
+{
+    if (type == L"SparsePCDeserializer")
+        *deserializer = new SparsePCDeserializer(corpus, deserializerConfig, isPrimary);
+    else
+        InvalidArgument("Unknown deserializer type '%ls'", type.c_str());
+
+    // Deserializer created.
+    return true;
+}
+
 }}}
@@ -0,0 +1,303 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE.md file in the project root for full license information.
+//
+// SparsePCDeserializer.cpp -- deserializer of the sparse parallel corpus format of the SparsePCReader
+//
+
+#include "stdafx.h"
+#include "SparsePCDeserializer.h"
+#include "SequenceData.h"
+#include "StringUtil.h"
+
+namespace Microsoft { namespace MSR { namespace CNTK {
+
+static_assert(sizeof(IndexType) == sizeof(int32_t), "the row indices of the file are used as the indices of the sparse sequences");
+
+// The records of a chunk, which are indexed when the chunk is loaded.
+class SparsePCDeserializer::SparsePCChunk : public Chunk, public std::enable_shared_from_this<Chunk>
+{
+public:
+    SparsePCChunk(const SparsePCDeserializer& parent, const ChunkInfo& info)
+        : m_parent(parent), m_info(info)
+    {
+        m_parent.m_file->WillNeed(m_info.m_offset, m_info.m_size);
+
+        size_t numRecords = m_info.m_numSequences * m_parent.m_sequenceLength;
+        m_recordOffsets.resize(numRecords + 1);
+        m_recordOffsets[0] = m_info.m_offset;
+        for (size_t r = 0; r < numRecords; r++)
+            m_recordOffsets[r + 1] = m_parent.SkipRecord(m_recordOffsets[r]);
+    }
+
+    void GetSequence(size_t sequenceId, std::vector<SequenceDataPtr>& result) override
+    {
+        assert(sequenceId >= m_info.m_firstSequence && sequenceId < m_info.m_firstSequence + m_info.m_numSequences);
+        const char* data = m_parent.m_file->GetData();
+        const size_t numFeatures = m_parent.m_featureDims.size();
+        const size_t numRecords = m_parent.m_sequenceLength;
+        const size_t* records = &m_recordOffsets[(sequenceId - m_info.m_firstSequence) * numRecords];
+
+        result.resize(numFeatures + 1);
+        for (size_t f = 0; f < numFeatures; f++)
+        {
+            auto sequence = MakeSequenceData<ChunkBackedSparseSequenceData>();
+            sequence->m_id = sequenceId;
+            sequence->m_numberOfSamples = (uint32_t) numRecords;
+            sequence->m_elementType = m_parent.m_elementType;
+            sequence->m_chunk = shared_from_this();
+            sequence->m_nnzCounts.resize(numRecords);
+            sequence->m_totalNnzCount = 0;
+
+            if (numRecords == 1)
+            {
+                int32_t nnz;
+                size_t offset = m_parent.LocateFeature(records[0], f, nnz);
+                sequence->m_nnzCounts[0] = nnz;
+                sequence->m_totalNnzCount = nnz;
+                sequence->m_data = data + offset;
+                sequence->m_indices = (IndexType*) (data + offset + nnz * m_parent.m_elementSize);
+            }
+            else
+            {
+                // the values and rows of consecutive records are interleaved with the other features, so they are gathered
+                for (size_t r = 0; r < numRecords; r++)
+                {
+                    int32_t nnz;
+                    size_t offset = m_parent.LocateFeature(records[r], f, nnz);
+                    const char* values = data + offset;
+                    const IndexType* rows = (const IndexType*) (values + nnz * m_parent.m_elementSize);
+                    sequence->m_valueBuffer.insert(sequence->m_valueBuffer.end(), values, values + nnz * m_parent.m_elementSize);
+                    sequence->m_indexBuffer.insert(sequence->m_indexBuffer.end(), rows, rows + nnz);
+                    sequence->m_nnzCounts[r] = nnz;
+                    sequence->m_totalNnzCount += nnz;
+                }
+                sequence->m_data = sequence->m_valueBuffer.data();
+                sequence->m_indices = sequence->m_indexBuffer.data();
+            }
+            result[f] = sequence;
+        }
+
+        // the label precedes the verification code at the end of the record
+        const size_t labelTrailer = m_parent.m_elementSize + (m_parent.m_verificationCode != 0 ? sizeof(int32_t) : 0);
+        auto label = MakeSequenceData<ChunkBackedDenseSequenceData>();
+        label->m_id = sequenceId;
+        label->m_numberOfSamples = (uint32_t) numRecords;
+        label->m_elementType = m_parent.m_elementType;
+        label->m_chunk = shared_from_this();
+        if (numRecords == 1)
+        {
+            label->m_data = data + records[1] - labelTrailer;
+        }
+        else
+        {
+            label->m_buffer.resize(numRecords * m_parent.m_elementSize);
+            for (size_t r = 0; r < numRecords; r++)
+                memcpy(&label->m_buffer[r * m_parent.m_elementSize], data + records[r + 1] - labelTrailer, m_parent.m_elementSize);
+            label->m_data = label->m_buffer.data();
+        }
+        result[numFeatures] = label;
+    }
+
+private:
+    const SparsePCDeserializer& m_parent;
+    ChunkInfo m_info;
+    std::vector<size_t> m_recordOffsets; // [m_numSequences * m_sequenceLength + 1]
+
+    DISABLE_COPY_AND_MOVE(SparsePCChunk);
+};
+
+SparsePCDeserializer::SparsePCDeserializer(CorpusDescriptorPtr, const ConfigParameters& config, bool)
+{
+    std::string precision = config.Find("precision", "float");
+    if (AreEqualIgnoreCase(precision, "float"))
+    {
+        m_elementType = ElementType::tfloat;
+        m_elementSize = sizeof(float);
+    }
+    else if (AreEqualIgnoreCase(precision, "double"))
+    {
+        m_elementType = ElementType::tdouble;
+        m_elementSize = sizeof(double);
+    }
+    else
+        InvalidArgument("SparsePCDeserializer: Unsupported precision '%s'.", precision.c_str());
+
+    m_sequenceLength = config(L"microbatchSize", (size_t) 1);
+    if (m_sequenceLength == 0)
+        InvalidArgument("SparsePCDeserializer: microbatchSize must be positive.");
+    m_verificationCode = (int32_t) config(L"verificationCode", (size_t) 0);
+    size_t chunkSizeInBytes = config(L"chunkSizeInBytes", (size_t) 32 * 1024 * 1024);
+    std::wstring filename = config(L"file");
+
+    // the streams, in the order of the file
+    const ConfigParameters& input = config(L"input");
+    std::vector<std::wstring> featureNames;
+    std::vector<std::wstring> labelNames;
+    GetFileConfigNames(input, featureNames, labelNames);
+    if (labelNames.size() != 1)
+        InvalidArgument("SparsePCDeserializer: Exactly one label input is required.");
+    if (featureNames.empty())
+        InvalidArgument("SparsePCDeserializer: At least one feature input is required.");
+
+    // as in the SparsePCReader, the features are stored in the reverse order of their sections
+    for (size_t i = 0; i < featureNames.size(); i++)
+    {
+        const std::wstring& name = featureNames[featureNames.size() - i - 1];
+        const ConfigParameters& featureConfig = input(name);
+        size_t dim = featureConfig(L"dim");
+
+        auto stream = std::make_shared<StreamDescription>();
+        stream->m_id = m_streams.size();
+        stream->m_name = name;
+        stream->m_storageType = StorageType::sparse_csc;
+        stream->m_elementType = m_elementType;
+        stream->m_sampleLayout = std::make_shared<TensorShape>(dim);
+        m_streams.push_back(stream);
+        m_featureDims.push_back(dim);
+    }
+
+    auto label = std::make_shared<StreamDescription>();
+    label->m_id = m_streams.size();
+    label->m_name = labelNames[0];
+    label->m_storageType = StorageType::dense;
+    label->m_elementType = m_elementType;
+    label->m_sampleLayout = std::make_shared<TensorShape>(1);
+    m_streams.push_back(label);
+
+    // index the chunks by walking the records once
+    m_file = std::make_shared<MappedFile>(filename);
+    const size_t fileSize = m_file->GetSize();
+    ChunkInfo chunk = { 0, 0, 0, 0 };
+    size_t offset = 0;
+    while (offset < fileSize)
+    {
+        size_t end = offset;
+        size_t r = 0;
+        for (; r < m_sequenceLength && end < fileSize; r++)
+            end = SkipRecord(end);
+        if (r < m_sequenceLength)
+        {
+            fprintf(stderr, "SparsePCDeserializer: Ignoring %d trailing records of '%ls' that do not form a complete sequence of %d records.\n",
+                    (int) r, filename.c_str(), (int) m_sequenceLength);
+            break;
+        }
+
+        offset = end;
+        chunk.m_numSequences++;
+        if (offset - chunk.m_offset >= chunkSizeInBytes)
+        {
+            chunk.m_size = offset - chunk.m_offset;
+            m_chunks.push_back(chunk);
+            chunk = { offset, 0, chunk.m_firstSequence + chunk.m_numSequences, 0 };
+        }
+    }
+    if (chunk.m_numSequences > 0)
+    {
+        chunk.m_size = offset - chunk.m_offset;
+        m_chunks.push_back(chunk);
+    }
+
+    if (m_chunks.empty())
+        RuntimeError("SparsePCDeserializer: '%ls' contains no sequences.", filename.c_str());
+}
+
+int32_t SparsePCDeserializer::ReadInt32(size_t offset) const
+{
+    if (offset + sizeof(int32_t) > m_file->GetSize())
+        RuntimeError("SparsePCDeserializer: Unexpected end of file at offset %lu.", (unsigned long) offset);
+
+    // records are not aligned
+    int32_t value;
+    memcpy(&value, m_file->GetData() + offset, sizeof(value));
+    return value;
+}
+
+size_t SparsePCDeserializer::LocateFeature(size_t offset, size_t feature, int32_t& nnz) const
+{
+    for (size_t f = 0;; f++)
+    {
+        nnz = ReadInt32(offset);
+        if (nnz < 0 || (size_t) nnz > m_featureDims[f])
+            RuntimeError("SparsePCDeserializer: Invalid number of non-zero values %d of feature %d at offset %lu.", (int) nnz, (int) f, (unsigned long) offset);
+        offset += sizeof(int32_t);
+        if (f == feature)
+            return offset;
+        offset += nnz * (m_elementSize + sizeof(int32_t));
+    }
+}
+
+size_t SparsePCDeserializer::SkipRecord(size_t offset) const
+{
+    int32_t nnz;
+    offset = LocateFeature(offset, m_featureDims.size() - 1, nnz);
+    offset += nnz * (m_elementSize + sizeof(int32_t)) + m_elementSize;
+
+    if (m_verificationCode != 0)
+    {
+        int32_t code = ReadInt32(offset);
+        if (code != m_verificationCode)
+            RuntimeError("SparsePCDeserializer: Verification code did not match (expected %d, found %d) at offset %lu.", (int) m_verificationCode, (int) code, (unsigned long) offset);
+        offset += sizeof(int32_t);
+    }
+
+    if (offset > m_file->GetSize())
+        RuntimeError("SparsePCDeserializer: Unexpected end of file at offset %lu.", (unsigned long) offset);
+    return offset;
+}
+
+ChunkDescriptions SparsePCDeserializer::GetChunkDescriptions()
+{
+    ChunkDescriptions result;
+    result.reserve(m_chunks.size());
+    for (ChunkIdType i = 0; i < m_chunks.size(); i++)
+    {
+        auto chunk = std::make_shared<ChunkDescription>();
+        chunk->m_id = i;
+        chunk->m_numberOfSequences = m_chunks[i].m_numSequences;
+        chunk->m_numberOfSamples = m_chunks[i].m_numSequences * m_sequenceLength;
+        result.push_back(chunk);
+    }
+    return result;
+}
+
+void SparsePCDeserializer::GetSequencesForChunk(ChunkIdType chunkId, std::vector<SequenceDescription>& result)
+{
+    const ChunkInfo& chunk = m_chunks[chunkId];
+    result.reserve(result.size() + chunk.m_numSequences);
+    for (size_t i = 0; i < chunk.m_numSequences; i++)
+    {
+        SequenceDescription sequence;
+        sequence.m_id = chunk.m_firstSequence + i;
+        sequence.m_numberOfSamples = (uint32_t) m_sequenceLength;
+        sequence.m_chunkId = chunkId;
+        sequence.m_key.m_sequence = sequence.m_id;
+        sequence.m_key.m_sample = 0;
+        result.push_back(sequence);
+    }
+}
+
+ChunkPtr SparsePCDeserializer::GetChunk(ChunkIdType chunkId)
+{
+    return std::make_shared<SparsePCChunk>(*this, m_chunks[chunkId]);
+}
+
+// the keys are the indices of the sequences in the file
+bool SparsePCDeserializer::GetSequenceDescriptionByKey(const KeyType& key, SequenceDescription& result)
+{
+    size_t id = key.m_sequence;
+    auto chunk = std::upper_bound(m_chunks.begin(), m_chunks.end(), id, [](size_t i, const ChunkInfo& c) { return i < c.m_firstSequence; });
+    if (chunk == m_chunks.begin())
+        return false;
+    --chunk;
+    if (id >= chunk->m_firstSequence + chunk->m_numSequences)
+        return false;
+
+    result.m_id = id;
+    result.m_numberOfSamples = (uint32_t) m_sequenceLength;
+    result.m_chunkId = (ChunkIdType) (chunk - m_chunks.begin());
+    result.m_key = key;
+    return true;
+}
+
+}}}
@@ -0,0 +1,63 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE.md file in the project root for full license information.
+//
+// SparsePCDeserializer.h -- deserializer of the sparse parallel corpus format of the SparsePCReader
+//
+
+#pragma once
+
+#include "DataDeserializerBase.h"
+#include "CorpusDescriptor.h"
+#include "Config.h"
+#include "MappedFile.h"
+
+namespace Microsoft { namespace MSR { namespace CNTK {
+
+// Exposes a SparsePCReader file to the CompositeDataReader, so that it gets the randomizers, the chunk cache,
+// the distributed decimation and the prefetching of the ReaderShim instead of the reader's own queue.
+// The file is a sequence of records, one per sample: for each feature, int32 nnz, ElemType values[nnz] and int32 rows[nnz],
+// where the features are stored in the reverse order of their sections in the config, as by the SparsePCReader;
+// then the ElemType label, and an int32 'verificationCode' if one is configured.
+// As in the SparsePCReader, 'microbatchSize' consecutive records form one sequence.
+// The file is memory-mapped and split into chunks of about 'chunkSizeInBytes' bytes, which are indexed once by walking the records;
+// the sequences of a chunk point into the mapping where their samples are contiguous.
+class SparsePCDeserializer : public DataDeserializerBase
+{
+public:
+    SparsePCDeserializer(CorpusDescriptorPtr corpus, const ConfigParameters& config, bool primary);
+
+    ChunkDescriptions GetChunkDescriptions() override;
+    void GetSequencesForChunk(ChunkIdType chunkId, std::vector<SequenceDescription>& result) override;
+    ChunkPtr GetChunk(ChunkIdType chunkId) override;
+
+protected:
+    bool GetSequenceDescriptionByKey(const KeyType& key, SequenceDescription& result) override;
+
+private:
+    class SparsePCChunk;
+
+    struct ChunkInfo
+    {
+        size_t m_offset;        // of the first record in the file
+        size_t m_size;          // in bytes
+        size_t m_firstSequence; // global index of the first sequence
+        size_t m_numSequences;
+    };
+
+    // returns the offset of the record that follows the one at 'offset'
+    size_t SkipRecord(size_t offset) const;
+    // returns the offset of the values of the given feature (in file order) of the record at 'offset'
+    size_t LocateFeature(size_t offset, size_t feature, int32_t& nnz) const;
+    int32_t ReadInt32(size_t offset) const;
+
+    MappedFilePtr m_file;
+    ElementType m_elementType;
+    size_t m_elementSize;
+    std::vector<size_t> m_featureDims; // in file order
+    size_t m_sequenceLength;           // records per sequence
+    int32_t m_verificationCode;        // 0 if the records have none
+    std::vector<ChunkInfo> m_chunks;
+};
+
+}}}
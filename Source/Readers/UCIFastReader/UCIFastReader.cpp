@@ -258,6 +258,8 @@ void UCIFastReader<ElemType>::Destroy()
 //  readerType=UCIFastReader
 //  miniBatchMode=Partial
 //  randomize=None
+//  # number of threads that parse large requests, 0 for one per core
+//  numParserThreads=1
 //  features=[
 //    dim=784
 //    start=1
@@ -398,7 +400,12 @@ void UCIFastReader<ElemType>::InitFromConfig(const ConfigRecordType& readerConfi
 
     // Simple heuristic to ensure buffer size and avoid breaking existing experiments.
     size_t bufSize = max(dimFeatures * 16, (size_t) 256 * 1024);
+    // lines are parsed in parallel in blocks of at least 1 MB of the buffer
+    size_t numParserThreads = readerConfig(L"numParserThreads", (size_t) 1);
+    if (numParserThreads != 1)
+        bufSize = max(bufSize, (size_t) 16 * 1024 * 1024);
     m_parser->ParseInit(file.c_str(), startFeatures, dimFeatures, startLabels, dimLabels, bufSize);
+    m_parser->SetNumThreads(numParserThreads);
 
     // if we have labels and labels are categorical values, we need a label Mapping file, it will be a file with one label per line
     if (m_labelType == labelCategory)
@@ -10,6 +10,10 @@
 #include "UCIParser.h"
 #include <stdexcept>
 #include <stdint.h>
+#include <string.h>
+#include <ctype.h>
+#include <thread>
+#include <exception>
 
 #if WIN32
 #define ftell64 _ftelli64
@@ -46,6 +50,15 @@ void UCIParser<NumType, LabelType>::SetupStateTables(char customDelimiter, char
     if (customDelimiter == customDecimalPoint && customDelimiter != 0)
         InvalidArgument("The delimiter and decimal point cannot be the same.");
 
+    // the same separators and decimal point for ParseLines()
+    memset(m_isSeparator, 0, sizeof(m_isSeparator));
+    m_isSeparator[(unsigned char) ' '] = true;
+    m_isSeparator[(unsigned char) '\t'] = true;
+    m_isSeparator[(unsigned char) '\r'] = true;
+    if (customDelimiter != 0)
+        m_isSeparator[(unsigned char) customDelimiter] = true;
+    m_decimalPoint = customDecimalPoint != 0 ? customDecimalPoint : '.';
+
     // =========================
     // STATE = WHITESPACE
     // =========================
@@ -263,6 +276,7 @@ void UCIParser<NumType, LabelType>::Init(char customDelimiter, char customDecima
     PrepareStartPosition(0);
     m_fileBuffer = NULL;
     m_pFile = NULL;
+    m_numThreads = 1;
     m_stateTable = new DWORD[AllStateMax * 256];
     SetupStateTables(customDelimiter, customDecimalPoint);
 }
@@ -507,6 +521,16 @@ void UCIParser<NumType, LabelType>::SetTraceLevel(int traceLevel)
     m_traceLevel = traceLevel;
 }
 
+// SetNumThreads - Set the number of threads that parse the lines of large requests
+// numThreads - number of threads, zero means one per core
+template <typename NumType, typename LabelType>
+void UCIParser<NumType, LabelType>::SetNumThreads(size_t numThreads)
+{
+    if (numThreads == 0)
+        numThreads = std::max<size_t>(std::thread::hardware_concurrency(), 1);
+    m_numThreads = numThreads;
+}
+
 // Parse - Parse the data
 // recordsRequested - number of records requested
 // numbers - pointer to vector to return the numbers (must be allocated)
@@ -522,6 +546,9 @@ long UCIParser<NumType, LabelType>::Parse(size_t recordsRequested, std::vector<N
     m_numbers = numbers;
     m_labels = labels;
 
+    if (m_parseMode == ParseNormal)
+        return ParseLines(recordsRequested);
+
     long TickStart = GetTickCount();
     long recordCount = 0;
     size_t bufferIndex = m_byteCounter - m_bufferStart;
@@ -683,6 +710,261 @@ long UCIParser<NumType, LabelType>::Parse(size_t recordsRequested, std::vector<N
     return recordCount;
 }
 
+// FillBuffer - load a buffer full of data from the given position
+template <typename NumType, typename LabelType>
+void UCIParser<NumType, LabelType>::FillBuffer(int64_t position)
+{
+    int rc = _fseeki64(m_pFile, position, SEEK_SET);
+    if (rc)
+        RuntimeError("UCIParser::FillBuffer - error seeking in file");
+
+    m_bufferStart = position;
+    size_t bytesToRead = min(m_bufferSize, (size_t)(m_fileSize - m_bufferStart));
+    size_t bytesRead = fread(m_fileBuffer, 1, bytesToRead, m_pFile);
+    if (bytesRead != bytesToRead)
+        RuntimeError("UCIParser::FillBuffer - error reading file");
+}
+
+// ConvertNumber - the value of the number [begin, end), computed as by the state machine
+// returns - false if it is not a number
+template <typename NumType, typename LabelType>
+bool UCIParser<NumType, LabelType>::ConvertNumber(const char *begin, const char *end, NumType &value) const
+{
+    const char *p = begin;
+    double wholeNumberMultiplier = 1;
+    if (*p == '-' || *p == '+')
+    {
+        if (*p == '-')
+            wholeNumberMultiplier = -1;
+        p++;
+    }
+    if (p == end || !isdigit((unsigned char) *p))
+        return false;
+
+    double builtUpNumber = 0;
+    for (; p < end && isdigit((unsigned char) *p); p++)
+        builtUpNumber = builtUpNumber * 10 + (*p - '0');
+
+    double partialResult = 0;
+    double divider = 0;
+    if (p < end && *p == m_decimalPoint)
+    {
+        p++;
+        if (p == end || !isdigit((unsigned char) *p))
+            return false;
+        partialResult = builtUpNumber;
+        divider = 1;
+        builtUpNumber = 0;
+        for (; p < end && isdigit((unsigned char) *p); p++)
+        {
+            builtUpNumber = builtUpNumber * 10 + (*p - '0');
+            divider *= 10;
+        }
+    }
+
+    double result;
+    if (p < end && (*p == 'e' || *p == 'E'))
+    {
+        p++;
+        double exponentMultiplier = 1;
+        if (p < end && (*p == '-' || *p == '+'))
+        {
+            if (*p == '-')
+                exponentMultiplier = -1;
+            p++;
+        }
+        if (p == end || !isdigit((unsigned char) *p))
+            return false;
+        if (divider != 0) // decimal number
+            partialResult += builtUpNumber / divider;
+        else // integer
+            partialResult = builtUpNumber;
+        builtUpNumber = 0;
+        for (; p < end && isdigit((unsigned char) *p); p++)
+            builtUpNumber = builtUpNumber * 10 + (*p - '0');
+        result = partialResult * pow(10.0, exponentMultiplier * builtUpNumber);
+    }
+    else if (divider != 0)
+        result = partialResult + (builtUpNumber / divider);
+    else
+        result = builtUpNumber;
+
+    if (p != end)
+        return false;
+
+    value = (NumType) result;
+    value = (NumType)(value * wholeNumberMultiplier);
+    return true;
+}
+
+// AppendLabel - append a label column, numeric label types need a number
+template <typename NumType, typename LabelType>
+static bool AppendLabel(std::vector<LabelType> &labels, const char * /*begin*/, const char * /*end*/, bool isNumber, NumType value)
+{
+    if (!isNumber)
+        return false;
+    labels.push_back((LabelType) value);
+    return true;
+}
+
+template <typename NumType>
+static bool AppendLabel(std::vector<std::string> &labels, const char *begin, const char *end, bool /*isNumber*/, NumType /*value*/)
+{
+    labels.emplace_back(begin, end);
+    return true;
+}
+
+// ParseLine - append the features and labels of the line [begin, end)
+template <typename NumType, typename LabelType>
+void UCIParser<NumType, LabelType>::ParseLine(const char *begin, const char *end, std::vector<NumType> &numbers, std::vector<LabelType> &labels) const
+{
+    const size_t endColumn = std::max(m_startFeatures + m_dimFeatures, m_startLabels + m_dimLabels);
+    const char *p = begin;
+    for (size_t column = 0; column < endColumn; column++)
+    {
+        while (p < end && m_isSeparator[(unsigned char) *p])
+            p++;
+        if (p == end)
+            break;
+        const char *tokenBegin = p;
+        while (p < end && !m_isSeparator[(unsigned char) *p])
+            p++;
+
+        // the other columns are skipped without conversion
+        bool isFeature = m_startFeatures <= column && column < m_startFeatures + m_dimFeatures;
+        bool isLabel = m_startLabels <= column && column < m_startLabels + m_dimLabels;
+        if (!isFeature && !isLabel)
+            continue;
+
+        NumType value = 0;
+        bool isNumber = ConvertNumber(tokenBegin, p, value);
+        bool stored = isLabel && AppendLabel(labels, tokenBegin, p, isNumber, value);
+        if (isFeature && isNumber)
+        {
+            numbers.push_back(value);
+            stored = true;
+        }
+        if (!stored || (isFeature && !isNumber))
+            fprintf(stderr, "\n** String found in numeric-only file: %s\n", std::string(tokenBegin, p).c_str());
+    }
+}
+
+// ParseLines - Parse() in ParseNormal mode, line by line instead of by the state machine: the lines are found with memchr(),
+// the columns that are neither features nor labels are skipped without being converted, and large blocks of lines are
+// parsed in parallel
+// As by the state machine, a record is ended by every newline that does not directly follow another one, and an incomplete last line is ignored.
+template <typename NumType, typename LabelType>
+long UCIParser<NumType, LabelType>::ParseLines(size_t recordsRequested)
+{
+    std::vector<NumType> noNumbers;
+    std::vector<LabelType> noLabels;
+    std::vector<NumType> &numbers = m_numbers != NULL ? *m_numbers : noNumbers;
+    std::vector<LabelType> &labels = m_labels != NULL ? *m_labels : noLabels;
+    const size_t numbersBefore = numbers.size();
+
+    long TickStart = GetTickCount();
+    long recordCount = 0;
+    bool afterNewline = m_current_state == EndOfLine;
+    std::vector<std::pair<const char *, const char *>> lines;
+    while (m_byteCounter < m_fileSize && recordCount < recordsRequested)
+    {
+        const size_t bufferValid = min(m_bufferSize, (size_t)(m_fileSize - m_bufferStart));
+        const char *buffer = (const char *) m_fileBuffer;
+        const char *p = buffer + (m_byteCounter - m_bufferStart);
+
+        // the complete lines in the buffer
+        lines.clear();
+        while (p < buffer + bufferValid && recordCount + lines.size() < recordsRequested)
+        {
+            const char *endOfLine = (const char *) memchr(p, '\n', buffer + bufferValid - p);
+            if (endOfLine == NULL)
+                break;
+            if (endOfLine != p || !afterNewline)
+                lines.push_back(std::make_pair(p, endOfLine));
+            afterNewline = true;
+            p = endOfLine + 1;
+        }
+        m_byteCounter = m_bufferStart + (p - buffer);
+
+        // blocks of at least 1 MB per thread
+        size_t numThreads = 1;
+        if (m_numThreads > 1 && !lines.empty())
+            numThreads = std::max<size_t>(min<size_t>(m_numThreads, (lines.back().second - lines.front().first) >> 20), 1);
+        if (numThreads == 1)
+        {
+            for (const auto &line : lines)
+                ParseLine(line.first, line.second, numbers, labels);
+        }
+        else
+        {
+            std::vector<std::vector<NumType>> blockNumbers(numThreads);
+            std::vector<std::vector<LabelType>> blockLabels(numThreads);
+            std::vector<std::exception_ptr> errors(numThreads);
+            std::vector<std::thread> threads;
+            for (size_t k = 0; k < numThreads; k++)
+            {
+                threads.push_back(std::thread([&, k]
+                {
+                    try
+                    {
+                        for (size_t i = lines.size() * k / numThreads; i < lines.size() * (k + 1) / numThreads; i++)
+                            ParseLine(lines[i].first, lines[i].second, blockNumbers[k], blockLabels[k]);
+                    }
+                    catch (...)
+                    {
+                        errors[k] = std::current_exception();
+                    }
+                }));
+            }
+            for (auto &thread : threads)
+                thread.join();
+            for (const auto &error : errors)
+            {
+                if (error)
+                    std::rethrow_exception(error);
+            }
+            for (size_t k = 0; k < numThreads; k++)
+            {
+                numbers.insert(numbers.end(), blockNumbers[k].begin(), blockNumbers[k].end());
+                labels.insert(labels.end(), std::make_move_iterator(blockLabels[k].begin()), std::make_move_iterator(blockLabels[k].end()));
+            }
+        }
+        recordCount += (long) lines.size();
+
+        if (recordCount >= recordsRequested)
+            break;
+        // the rest of the file is an incomplete line
+        if (m_bufferStart + bufferValid >= m_fileSize)
+        {
+            m_byteCounter = m_fileSize;
+            break;
+        }
+        // a line that does not fit into the buffer
+        if (m_byteCounter == m_bufferStart)
+        {
+            delete[] m_fileBuffer;
+            m_bufferSize *= 2;
+            m_fileBuffer = new BYTE[m_bufferSize];
+        }
+        FillBuffer(m_byteCounter);
+    }
+
+    // leave the state machine at the beginning of the next line
+    if (afterNewline)
+        m_current_state = EndOfLine;
+    PrepareStartNumber();
+    PrepareStartLine();
+    m_totalNumbersConverted += numbers.size() - numbersBefore;
+
+    long TickStop = GetTickCount();
+
+    long TickDelta = TickStop - TickStart;
+
+    if (m_traceLevel > 2)
+        fprintf(stderr, "\n%ld ms, %ld records parsed\n\n", TickDelta, recordCount);
+    return recordCount;
+}
+
 // StoreLabel - string version gets last space delimited string and stores in labels vector
 template <>
 void UCIParser<float, std::string>::StoreLabel(float /*finalResult*/)
@@ -11,6 +11,7 @@
 #include <assert.h>
 #include <stdint.h>
 #include <algorithm>
+#include <utility>
 
 #ifdef min
 #undef min
@@ -132,6 +133,26 @@ private:
     // returns - number of records read
     size_t UpdateBuffer();
 
+    // FillBuffer - load a buffer full of data from the given position
+    void FillBuffer(int64_t position);
+
+    // separators of the columns, for the lines parsed by ParseLines()
+    bool m_isSeparator[256];
+    char m_decimalPoint;
+    size_t m_numThreads;
+
+    // ParseLines - Parse() in ParseNormal mode, line by line instead of by the state machine: the lines are found with memchr(),
+    // the columns that are neither features nor labels are skipped without being converted, and large blocks of lines are
+    // parsed in parallel
+    long ParseLines(size_t recordsRequested);
+
+    // ParseLine - append the features and labels of the line [begin, end)
+    void ParseLine(const char *begin, const char *end, std::vector<NumType> &numbers, std::vector<LabelType> &labels) const;
+
+    // ConvertNumber - the value of the number [begin, end), computed as by the state machine
+    // returns - false if it is not a number
+    bool ConvertNumber(const char *begin, const char *end, NumType &value) const;
+
 public:
     // UCIParser constructor
     UCIParser(char customDelimiter, char customDecimalPoint);
@@ -164,6 +185,10 @@ public:
     // traceLevel - traceLevel, zero means no output, 1 epoch related output, > 1 all output
     void SetTraceLevel(int traceLevel);
 
+    // SetNumThreads - Set the number of threads that parse the lines of large requests
+    // numThreads - number of threads, zero means one per core
+    void SetNumThreads(size_t numThreads);
+
     // ParseInit - Initialize a parse of a file
     // fileName - path to the file to open
     // startFeatures - column (zero based) where features start
@@ -14,6 +14,8 @@
 
 #include <functional>
 #include <thread>
+#include <chrono>
+#include <climits>
 #include <unordered_map>
 #include <numeric>
 #include <algorithm>
@@ -23,6 +25,7 @@
 #include <multiverso/multiverso.h>
 #include <multiverso/util/configure.h>
 #include <multiverso/table/array_table.h>
+#include <multiverso/table/matrix_table.h>
 #include <multiverso/updater/updater.h>
 
 #pragma comment(lib, "Multiverso.lib")
@@ -92,12 +95,20 @@ public:
         double adjustCoef = 0.2,                                                        // see in DecayCoefficient()
         size_t adjustPerMinibatches = 600,                                              //
         int traceLevel = 0,                                                             // log level
-        int syncPerfStats = 0) :                                                        // shown perf data every syncPerfStats
+        int syncPerfStats = 0,                                                          // shown perf data every syncPerfStats
+        size_t sparseSyncMinColumns = 0,                                                // parameters with at least this many columns only sync their changed columns
+        size_t sparseSyncFullPullPeriod = 10,                                           // ... and pull all columns every this many syncs
+        size_t stalenessBound = 0,                                                      // a node more than this many syncs ahead of the slowest one waits, 0: unbounded
+        bool adaptiveStaleness = false,                                                 // adapt the bound to the time spent waiting
+        size_t maxStalenessBound = 0) :                                                 // upper limit of the adapted bound, 0: 4 * stalenessBound
         m_parameterSyncCounter(0), m_adjustLearningRateAtBeginningType(adjusttype),
         m_adjustCoefficient(adjustCoef), m_adjustMBNumber(adjustPerMinibatches),
         m_totalClientNumber(nodeNumRanks), m_useAsyncBuffer(useAsyncBuffer),
         m_traceLevel(traceLevel), m_ModelAveragingSGDSimulating(isSimulatedModelAveragingSGD), m_doesEveryNodesShouldSynced(false),
-        m_syncPerfStats(syncPerfStats)
+        m_syncPerfStats(syncPerfStats), m_sparseSyncMinColumns(sparseSyncMinColumns), m_sparseSyncFullPullPeriod(sparseSyncFullPullPeriod),
+        m_serverArray(nullptr), m_workerArray(nullptr), m_denseModelSize(0),
+        m_stalenessBound(stalenessBound), m_adaptiveStaleness(adaptiveStaleness), m_maxStalenessBound(maxStalenessBound != 0 ? maxStalenessBound : 4 * stalenessBound),
+        m_serverClocks(nullptr), m_workerClocks(nullptr), m_clock(0), m_secondsWaitedInWindow(0), m_maxStalenessInWindow(0)
     {
         if (m_ModelAveragingSGDSimulating)
         {
@@ -130,7 +141,12 @@ public:
         multiverso::SetCMDFlag("logtostderr", true);
 
         if (m_doesEveryNodesShouldSynced)
+        {
             multiverso::SetCMDFlag("sync", true);
+            m_stalenessBound = 0; // all nodes sync together anyway
+        }
+        if (m_stalenessBound > 0 && m_maxStalenessBound < m_stalenessBound)
+            InvalidArgument("MultiversoHelper: maxStalenessBound (%d) must not be less than stalenessBound (%d).", (int)m_maxStalenessBound, (int)m_stalenessBound);
 
         MultiversoInit(learnableNodes);
     }
@@ -145,6 +161,18 @@ public:
 
         delete m_bufferSwapIndex, m_deltaArray;
 
+        if (m_stalenessBound > 0)
+        {
+            ReportStaleness();
+            delete m_workerClocks;
+            delete m_serverClocks;
+        }
+        for (auto& table : m_sparseTables)
+        {
+            delete table.worker;
+            delete table.server;
+        }
+
         for (size_t i = 0; i < m_localBufferNum; i++)
         {
 #ifndef CPUONLY
@@ -186,10 +214,13 @@ public:
         // because the parameter server will minus the delta on the server, so that we should send the minus initial model to the server.
         std::transform(m_deltaArray, m_deltaArray + m_totalModelSize, m_deltaArray, std::bind1st(std::multiplies<ElemType>(), -factor));
 
-        m_workerArray->Add(m_deltaArray, m_totalModelSize);
-        m_workerArray->Get(m_deltaArray, m_totalModelSize);
+        if (m_denseModelSize > 0)
+            m_workerArray->Add(m_deltaArray, m_denseModelSize);
+        for (auto& table : m_sparseTables)
+            table.worker->Add(m_deltaArray + table.offset, table.numRows * table.numCols);
+        PullAll(m_deltaArray);
         WaitAll();
-        m_workerArray->Get(m_deltaArray, m_totalModelSize);
+        PullAll(m_deltaArray);
 
         if (std::equal(m_deltaArray, m_deltaArray + m_totalModelSize, m_cpuAsyncBuffer[0]))
             fprintf(stderr, "multiverso initial model loaded.\n");
@@ -208,6 +239,9 @@ public:
         WaitAsyncBuffer();
         m_reportTimer.Stop();
 
+        if (m_stalenessBound > 0)
+            AdvanceClock();
+
         // reset statics for profiling
         if (m_traceLevel > 2 && m_syncPerfStats > 0 && m_parameterSyncCounter % m_syncPerfStats == 0)
         {
@@ -296,10 +330,7 @@ public:
                     std::bind1st(std::multiplies<ElemType>(), factor));
 
 
-                ElemType* px = m_deltaArray;
-                ElemType* py = m_cpuAsyncBuffer[m_bufferIndexInUse];
-                m_workerArray->AddAsync(px, m_totalModelSize);
-                m_workerArray->Get(py, m_totalModelSize);
+                PushAndPullTables(m_deltaArray, m_cpuAsyncBuffer[m_bufferIndexInUse]);
 
                 threadTimer.Stop();
                 if (m_traceLevel > 3)
@@ -337,11 +368,7 @@ public:
                 std::transform(m_cpuAsyncBuffer[t_cacheIdx], m_cpuAsyncBuffer[t_cacheIdx] + m_totalModelSize, m_deltaArray, m_deltaArray, std::minus<ElemType>());
                 std::transform(m_deltaArray, m_deltaArray + m_totalModelSize, m_deltaArray, std::bind1st(std::multiplies<ElemType>(), factor));
 
-                ElemType* px = m_deltaArray;
-                ElemType* py = m_cpuAsyncBuffer[t_cacheIdx];
-                m_workerArray->AddAsync(px, m_totalModelSize);
-                m_workerArray->Get(py, m_totalModelSize);
-
+                PushAndPullTables(m_deltaArray, m_cpuAsyncBuffer[t_cacheIdx]);
             });
 #endif
         }
@@ -387,10 +414,7 @@ public:
             }
             m_reportTimer.Restart();
 
-            ElemType* px = m_deltaArray;
-            ElemType* py = m_cpuAsyncBuffer[0];
-            m_workerArray->AddAsync(px, m_totalModelSize);
-            m_workerArray->Get(py, m_totalModelSize);
+            PushAndPullTables(m_deltaArray, m_cpuAsyncBuffer[0]);
 
             m_reportTimer.Stop();
             if (m_traceLevel > 3)
@@ -423,6 +447,18 @@ public:
         multiverso::MV_Barrier();
     }
 
+    void FinishTraining() override
+    {
+        WaitAsyncBuffer();
+        if (m_stalenessBound > 0)
+        {
+            // move our clock out of reach, so that the others do not wait for us anymore
+            std::vector<int> delta(m_totalClientNumber, 0);
+            delta[multiverso::MV_WorkerId()] = -FinishedClock;
+            m_workerClocks->Add(delta.data(), delta.size());
+        }
+    }
+
     void WaitAsyncBuffer() override
     {
         if (m_aysncBufferThread != nullptr && m_aysncBufferThread->joinable())
@@ -440,33 +476,75 @@ private:
         multiverso::SetCMDFlag<std::string>(std::string("updater_type"), std::string("sgd"));
         multiverso::MV_Init();
 
-        int i = 0;
-        for (auto nodeIter = learnableNodes.begin(); nodeIter != learnableNodes.end(); nodeIter++, i++)
+        std::vector<bool> isSparse;
+        for (auto nodeIter = learnableNodes.begin(); nodeIter != learnableNodes.end(); nodeIter++)
         {
             ComputationNodePtr node = dynamic_pointer_cast<ComputationNode<ElemType>>(*nodeIter);
             Matrix<ElemType> &mat = node->Value();
             size_t layerSize = mat.GetNumElements();
 
             m_tableLength.push_back(layerSize);
+            isSparse.push_back(m_sparseSyncMinColumns > 0 && mat.GetNumCols() >= m_sparseSyncMinColumns);
         }
 
         m_tableCount = m_tableLength.size();
 
         // cacluate total of learnable node's size
-        m_totalModelSize = accumulate(m_tableLength.begin(), m_tableLength.end(), 0);
+        m_totalModelSize = accumulate(m_tableLength.begin(), m_tableLength.end(), (size_t)0);
 
-        m_serverArray = new multiverso::ArrayServer<ElemType>(m_totalModelSize);
-        m_workerArray = new multiverso::ArrayWorker<ElemType>(m_totalModelSize);
+        // The dense parameters come first in the buffers and are synced as one array, each of the sparse ones is a matrix table
+        // with a row per column of the parameter (the columns are contiguous). Multiverso partitions every table evenly
+        // over all servers, so the large tables are spread over them by size.
+        m_tableOffsets.resize(m_tableCount);
+        size_t idx = 0;
+        for (int i = 0; i < m_tableCount; i++)
+        {
+            if (!isSparse[i])
+            {
+                m_tableOffsets[i] = idx;
+                idx += m_tableLength[i];
+            }
+        }
+        m_denseModelSize = idx;
 
-        multiverso::MV_Barrier();
+        int i = 0;
+        for (auto nodeIter = learnableNodes.begin(); nodeIter != learnableNodes.end(); nodeIter++, i++)
+        {
+            if (!isSparse[i])
+                continue;
+
+            Matrix<ElemType> &mat = dynamic_pointer_cast<ComputationNode<ElemType>>(*nodeIter)->Value();
+            SparseTable table;
+            table.offset = idx;
+            table.numRows = mat.GetNumCols();
+            table.numCols = mat.GetNumRows();
+            table.server = new multiverso::MatrixServerTable<ElemType>((int)table.numRows, (int)table.numCols);
+            table.worker = new multiverso::MatrixWorkerTable<ElemType>((int)table.numRows, (int)table.numCols);
+            m_sparseTables.push_back(table);
+
+            m_tableOffsets[i] = idx;
+            idx += m_tableLength[i];
+            if (m_traceLevel > 0)
+                fprintf(stderr, "MultiversoHelper: %ls (%d columns) syncs its changed columns only.\n", (*nodeIter)->NodeName().c_str(), (int)table.numRows);
+        }
 
-        size_t idx = 0;
-        for (size_t len : m_tableLength)
+        if (m_denseModelSize > 0)
+        {
+            m_serverArray = new multiverso::ArrayServer<ElemType>(m_denseModelSize);
+            m_workerArray = new multiverso::ArrayWorker<ElemType>(m_denseModelSize);
+        }
+
+        // the number of syncs of each node, for the bounded staleness
+        if (m_stalenessBound > 0)
         {
-            m_tableOffsets.push_back(idx);
-            idx += len;
+            m_serverClocks = new multiverso::ArrayServer<int>(m_totalClientNumber);
+            m_workerClocks = new multiverso::ArrayWorker<int>(m_totalClientNumber);
+            m_stalenessHistogram.assign(m_maxStalenessBound + 2, 0);
+            m_stalenessTimer.Start();
         }
 
+        multiverso::MV_Barrier();
+
 #ifndef CPUONLY
         for (int i2 = 0; i2 < m_localBufferNum; i2++)
             m_gpuAsyncBuffer[i2].reserve(m_tableCount);
@@ -482,6 +560,119 @@ private:
 #endif
     }
 
+    // pulls the whole model from the servers into 'model'
+    void PullAll(ElemType* model)
+    {
+        if (m_denseModelSize > 0)
+            m_workerArray->Get(model, m_denseModelSize);
+        for (auto& table : m_sparseTables)
+            table.worker->Get(model + table.offset, table.numRows * table.numCols);
+    }
+
+    // Pushes 'delta' to the servers and pulls the model into 'model'. For the sparse tables only the columns with a non-zero
+    // delta are pushed and pulled, every m_sparseSyncFullPullPeriod-th sync all of them are pulled, to get the columns
+    // the other workers changed.
+    void PushAndPullTables(ElemType* delta, ElemType* model)
+    {
+        if (m_denseModelSize > 0)
+        {
+            m_workerArray->AddAsync(delta, m_denseModelSize);
+            m_workerArray->Get(model, m_denseModelSize);
+        }
+
+        bool pullAll = m_sparseSyncFullPullPeriod <= 1 || m_parameterSyncCounter % m_sparseSyncFullPullPeriod == 0;
+        size_t numRowsSynced = 0, numRows = 0;
+        for (auto& table : m_sparseTables)
+        {
+            std::vector<int> rowIds;
+            std::vector<ElemType*> deltaRows;
+            std::vector<ElemType*> modelRows;
+            for (size_t r = 0; r < table.numRows; r++)
+            {
+                ElemType* row = delta + table.offset + r * table.numCols;
+                if (std::any_of(row, row + table.numCols, [](ElemType v) { return v != 0; }))
+                {
+                    rowIds.push_back((int)r);
+                    deltaRows.push_back(row);
+                    modelRows.push_back(model + table.offset + r * table.numCols);
+                }
+            }
+
+            if (!rowIds.empty())
+                table.worker->Add(rowIds, deltaRows, table.numCols);
+            if (pullAll)
+                table.worker->Get(model + table.offset, table.numRows * table.numCols);
+            else if (!rowIds.empty())
+                table.worker->Get(rowIds, modelRows, table.numCols);
+
+            numRowsSynced += rowIds.size();
+            numRows += table.numRows;
+        }
+
+        if (m_traceLevel > 3 && numRows > 0)
+            fprintf(stderr, "\t\t -- pullAndRequest, %d of %d columns of the sparse tables pushed%s\n", (int)numRowsSynced, (int)numRows, pullAll ? ", all pulled" : "");
+    }
+
+    // Counts a sync of this node and, if it is then more than m_stalenessBound syncs ahead of the slowest node, waits until
+    // it is not anymore (stale synchronous parallel). The others run free.
+    void AdvanceClock()
+    {
+        // the servers subtract what is added (see InitModel())
+        std::vector<int> clocks(m_totalClientNumber, 0);
+        clocks[multiverso::MV_WorkerId()] = -1;
+        m_workerClocks->Add(clocks.data(), clocks.size());
+        m_clock++;
+
+        Timer waitTimer;
+        waitTimer.Start();
+        size_t staleness;
+        for (;;)
+        {
+            m_workerClocks->Get(clocks.data(), clocks.size());
+            int slowest = *std::max_element(clocks.begin(), clocks.end()); // clocks are negated, ours is among them
+            staleness = (size_t)std::max(0, (int)m_clock + slowest);
+            if (staleness <= m_stalenessBound)
+                break;
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        }
+        waitTimer.Stop();
+
+        // the staleness we continue with; the last bucket counts all larger ones
+        m_stalenessHistogram[std::min(staleness, m_stalenessHistogram.size() - 1)]++;
+        m_secondsWaitedInWindow += waitTimer.ElapsedSeconds();
+        m_maxStalenessInWindow = std::max(m_maxStalenessInWindow, staleness);
+
+        if (m_clock % StalenessAdaptationInterval == 0)
+        {
+            m_stalenessTimer.Stop();
+            double waitedFraction = m_stalenessTimer.ElapsedSeconds() > 0 ? m_secondsWaitedInWindow / m_stalenessTimer.ElapsedSeconds() : 0;
+            size_t bound = m_stalenessBound;
+            // waiting much: allow more staleness; never reaching the bound: tighten it, as that costs nothing
+            if (m_adaptiveStaleness && waitedFraction > 0.1 && m_stalenessBound < m_maxStalenessBound)
+                m_stalenessBound++;
+            else if (m_adaptiveStaleness && m_secondsWaitedInWindow == 0 && m_maxStalenessInWindow < m_stalenessBound && m_stalenessBound > 1)
+                m_stalenessBound--;
+            if (m_traceLevel > 1)
+                fprintf(stderr, "\t\t(staleness stats) %d-th sync: %.1f%% of the time waited for slower nodes, maximum staleness %d, bound %d -> %d\n",
+                        (int)m_clock, 100 * waitedFraction, (int)m_maxStalenessInWindow, (int)bound, (int)m_stalenessBound);
+            if (m_traceLevel > 2)
+                ReportStaleness();
+
+            m_secondsWaitedInWindow = 0;
+            m_maxStalenessInWindow = 0;
+            m_stalenessTimer.Restart();
+        }
+    }
+
+    void ReportStaleness()
+    {
+        std::string histogram;
+        for (size_t s = 0; s + 1 < m_stalenessHistogram.size(); s++)
+            histogram += msra::strfun::strprintf(" %d: %d;", (int)s, (int)m_stalenessHistogram[s]);
+        histogram += msra::strfun::strprintf(" more than %d: %d", (int)m_stalenessHistogram.size() - 2, (int)m_stalenessHistogram.back());
+        fprintf(stderr, "\t\t(staleness stats) syncs of node %d by the number of syncs it was ahead of the slowest node:%s\n", multiverso::MV_WorkerId(), histogram.c_str());
+    }
+
     float DecayCoefficient()
     {
         float f = 1.f;
@@ -547,8 +738,36 @@ private:
 
     }
 
-    multiverso::ArrayServer<ElemType>* m_serverArray;
+    multiverso::ArrayServer<ElemType>* m_serverArray; // the dense parameters
     multiverso::ArrayWorker<ElemType>* m_workerArray;
+    size_t m_denseModelSize;
+
+    // a parameter with at least m_sparseSyncMinColumns columns, at 'offset' in the buffers
+    struct SparseTable
+    {
+        size_t offset;
+        size_t numRows; // the columns of the parameter
+        size_t numCols;
+        multiverso::MatrixServerTable<ElemType>* server;
+        multiverso::MatrixWorkerTable<ElemType>* worker;
+    };
+    std::vector<SparseTable> m_sparseTables;
+    size_t m_sparseSyncMinColumns;
+    size_t m_sparseSyncFullPullPeriod;
+
+    // bounded staleness
+    static const size_t StalenessAdaptationInterval = 100; // syncs
+    static const int FinishedClock = INT_MAX / 2;          // added to the clock of a node that finished training
+    size_t m_stalenessBound;
+    bool m_adaptiveStaleness;
+    size_t m_maxStalenessBound;
+    multiverso::ArrayServer<int>* m_serverClocks;         // [k] minus the number of syncs of node k
+    multiverso::ArrayWorker<int>* m_workerClocks;
+    size_t m_clock;
+    std::vector<size_t> m_stalenessHistogram;             // [s] number of our syncs after which we were s syncs ahead of the slowest node
+    Timer m_stalenessTimer;
+    double m_secondsWaitedInWindow;
+    size_t m_maxStalenessInWindow;
 
     thread * m_aysncBufferThread;
     bool m_doesEveryNodesShouldSynced;
@@ -609,6 +828,11 @@ public:
         size_t adjustnbmb = 600,
         int traceLevel = 0,
         int syncPerfStats = 0,
+        size_t sparseSyncMinColumns = 0,
+        size_t sparseSyncFullPullPeriod = 10,
+        size_t stalenessBound = 0,
+        bool adaptiveStaleness = false,
+        size_t maxStalenessBound = 0,
         const MPIWrapperPtr& pMPI = nullptr) { }
 
     ~NoneASGDHelper() { }
@@ -622,6 +846,8 @@ public:
     void WaitAll() override { }
 
     void WaitAsyncBuffer() override { }
+
+    void FinishTraining() override { }
 };
 
 template<class ElemType>
@@ -634,14 +860,21 @@ ASGDHelper<ElemType>* NewASGDHelper(
     double adjustCoef,
     size_t adjustPerMinibatches,
     int traceLevel,
-    int syncPerfStats) 
+    int syncPerfStats,
+    size_t sparseSyncMinColumns,
+    size_t sparseSyncFullPullPeriod,
+    size_t stalenessBound,
+    bool adaptiveStaleness,
+    size_t maxStalenessBound)
 {
 #ifdef ASGD_PARALLEL_SUPPORT
     return new MultiversoHelper<ElemType>(learnableNodes, nodeNumRanks, useAsyncBuffer, isSimulatedModelAveragingSGD, 
-                                      adjusttype, adjustCoef, adjustPerMinibatches, traceLevel, syncPerfStats);
+                                      adjusttype, adjustCoef, adjustPerMinibatches, traceLevel, syncPerfStats,
+                                      sparseSyncMinColumns, sparseSyncFullPullPeriod, stalenessBound, adaptiveStaleness, maxStalenessBound);
 #else
     return new NoneASGDHelper<ElemType>(learnableNodes, nodeNumRanks, useAsyncBuffer, isSimulatedModelAveragingSGD, 
-                                      adjusttype, adjustCoef, adjustPerMinibatches, traceLevel, syncPerfStats); 
+                                      adjusttype, adjustCoef, adjustPerMinibatches, traceLevel, syncPerfStats,
+                                      sparseSyncMinColumns, sparseSyncFullPullPeriod, stalenessBound, adaptiveStaleness, maxStalenessBound); 
 #endif
 }
 
@@ -654,7 +887,12 @@ template ASGDHelper<float>* NewASGDHelper<float>(
     double adjustCoef,
     size_t adjustPerMinibatches,
     int traceLevel,
-    int syncPerfStats); 
+    int syncPerfStats,
+    size_t sparseSyncMinColumns,
+    size_t sparseSyncFullPullPeriod,
+    size_t stalenessBound,
+    bool adaptiveStaleness,
+    size_t maxStalenessBound); 
 
 template ASGDHelper<double>* NewASGDHelper<double>(
     const std::list<ComputationNodeBasePtr> & learnableNodes,
@@ -665,6 +903,11 @@ template ASGDHelper<double>* NewASGDHelper<double>(
     double adjustCoef,
     size_t adjustPerMinibatches,
     int traceLevel,
-    int syncPerfStats); 
+    int syncPerfStats,
+    size_t sparseSyncMinColumns,
+    size_t sparseSyncFullPullPeriod,
+    size_t stalenessBound,
+    bool adaptiveStaleness,
+    size_t maxStalenessBound); 
 
 }}} 
@@ -303,6 +303,7 @@ namespace Microsoft { namespace MSR { namespace CNTK {
         shared_ptr<Matrix<ElemType>> m_netCriterionAccumulator;
         shared_ptr<Matrix<ElemType>> m_netEvaluationAccumulator;
         std::map<wstring, vector<shared_ptr<INodeState>>> m_netStates; // m_netStatefulNodes[node][i] caches the state of i-th subminibatch of node
+        std::map<wstring, vector<shared_ptr<INodeState>>> m_pipelineNextStates; // pipelined: the states for the next minibatch, while m_netStates are still needed
         bool m_hasLattices;
 
         Matrices m_cachedGradient;
@@ -567,39 +568,30 @@ namespace Microsoft { namespace MSR { namespace CNTK {
         // TODO: encapsulate it into a destructor? Note: Cannot throw exceptions in destructor.
         void DoneWithCurrentSubMinibatch(size_t iSubminibatch)
         {
-            // accumulate gradient here
-            for (auto x : m_cachedGradient)
-            {
-                wstring nodename = x.first;
-                if (m_LearnableNodePtr.find(nodename) == m_LearnableNodePtr.end())
-                {
-                    RuntimeError("ERROR: in DoneWithCurrentSubMinibatch: node %ls not found in LeanrableNode", nodename.c_str());
-                }
-                shared_ptr<ComputationNode<ElemType>> pNode = m_LearnableNodePtr[nodename];
-                m_cachedGradient.GetInputMatrix<ElemType>(nodename) += pNode->Gradient();
-                pNode->Gradient().SetValue(0);
-            }
-            // accumulate criterion value
-            if (!m_netCriterionNodes.empty())
-            {
-                Matrix<ElemType>::AddElementToElement(m_netCriterionNodes[0]->Value(), 0, 0,
-                                                      *m_netCriterionAccumulator, 0, 0);
-                m_netCriterionNodes[0]->Value().SetValue(0);
-            }
-            // accumulate evaluation value
-            for (size_t i = 0; i < m_netEvaluationNodes.size(); i++)
-            {
-                Matrix<ElemType>::AddElementToElement(m_netEvaluationNodes[i]->Value(), 0, 0,
-                                                      *m_netEvaluationAccumulator, 0, i);
-                m_netEvaluationNodes[i]->Value().SetValue(0);
-            }
+            AccumulateGradients();
+            AccumulateCriteria();
+            ResetCriteria();
+            ExportStates(m_netStates, iSubminibatch);
+        }
 
-            // Export node state
-            for (auto& x : m_netStatefulNodes)
-            {
-                const wstring& name = x.first;
-                m_netStates[name][iSubminibatch] = x.second->ExportState();
-            }
+        // pipeline parallelism (ComputationNetwork::CreatePipelined()): forward prop runs for all sub-minibatches before
+        // backprop of any, and backprop of all but the last one recomputes the values from the states they started with
+        void DoneWithPipelinedForwardProp(size_t iSubminibatch)
+        {
+            AccumulateCriteria();
+            ExportStates(m_pipelineNextStates, iSubminibatch);
+        }
+
+        void DoneWithPipelinedBackprop()
+        {
+            AccumulateGradients();
+        }
+
+        void DoneWithPipelinedMinibatch()
+        {
+            ResetCriteria();
+            m_netStates.swap(m_pipelineNextStates);
+            DoneWithCurrentMinibatch();
         }
 
         void DoneWithCurrentMinibatch()
@@ -633,6 +625,58 @@ namespace Microsoft { namespace MSR { namespace CNTK {
             }
             m_netEvaluationAccumulator->SetValue(0);
         }
+
+    private:
+        void AccumulateGradients()
+        {
+            for (auto x : m_cachedGradient)
+            {
+                wstring nodename = x.first;
+                if (m_LearnableNodePtr.find(nodename) == m_LearnableNodePtr.end())
+                {
+                    RuntimeError("ERROR: in DoneWithCurrentSubMinibatch: node %ls not found in LeanrableNode", nodename.c_str());
+                }
+                shared_ptr<ComputationNode<ElemType>> pNode = m_LearnableNodePtr[nodename];
+                m_cachedGradient.GetInputMatrix<ElemType>(nodename) += pNode->Gradient();
+                pNode->Gradient().SetValue(0);
+            }
+        }
+
+        void AccumulateCriteria()
+        {
+            // accumulate criterion value
+            if (!m_netCriterionNodes.empty())
+            {
+                Matrix<ElemType>::AddElementToElement(m_netCriterionNodes[0]->Value(), 0, 0,
+                                                      *m_netCriterionAccumulator, 0, 0);
+            }
+            // accumulate evaluation value
+            for (size_t i = 0; i < m_netEvaluationNodes.size(); i++)
+            {
+                Matrix<ElemType>::AddElementToElement(m_netEvaluationNodes[i]->Value(), 0, 0,
+                                                      *m_netEvaluationAccumulator, 0, i);
+            }
+        }
+
+        // DoneWithCurrentMinibatch() adds the accumulated values to these
+        void ResetCriteria()
+        {
+            if (!m_netCriterionNodes.empty())
+                m_netCriterionNodes[0]->Value().SetValue(0);
+            for (size_t i = 0; i < m_netEvaluationNodes.size(); i++)
+                m_netEvaluationNodes[i]->Value().SetValue(0);
+        }
+
+        void ExportStates(std::map<wstring, vector<shared_ptr<INodeState>>>& states, size_t iSubminibatch)
+        {
+            for (auto& x : m_netStatefulNodes)
+            {
+                auto& nodeStates = states[x.first];
+                if (nodeStates.size() < m_numSubminibatches)
+                    nodeStates.resize(m_numSubminibatches);
+                nodeStates[iSubminibatch] = x.second->ExportState();
+            }
+        }
     };
 };
 
@@ -19,6 +19,15 @@ public:
     // Returns a boolean indicating if any samples were processed
     virtual bool AggregateGradients(const std::vector<Matrix<ElemType>*>& gradients, DistGradHeader* headerCPU, bool resetState) = 0;
 
+    // Called during backprop once one of the gradients passed to AggregateGradients() is final for the current minibatch,
+    // for aggregators that can start exchanging it before backprop is done.
+    virtual void OnGradientComputed(Matrix<ElemType>* /*gradient*/)
+    {}
+
+    // Called at the end of each epoch in which gradients were aggregated, e.g. to report statistics of the epoch.
+    virtual void OnEpochEnd()
+    {}
+
     size_t NumProc()
     {
         return m_mpi->NumNodesInUse();
@@ -35,6 +44,42 @@ public:
     }
 
 protected:
+    // Sums up the headers of all workers, for aggregators that exchange the gradients with all-gathers; 'buffer' receives
+    // the headers of all workers.
+    void AllGatherHeaders(DistGradHeader* headerCPU, std::vector<char>& buffer)
+    {
+        size_t size = headerCPU->Size();
+        buffer.resize(size * NumProc());
+        m_mpi->AllGather((const char*) headerCPU, size, buffer.data(), size);
+        headerCPU->Clear();
+        for (size_t j = 0; j < NumProc(); j++)
+            headerCPU->Aggregate((DistGradHeader*) (buffer.data() + j * size), /*add=*/true);
+    }
+
+    // Groups the gradients, in the given order, into buckets (fusion buffers) that are exchanged with one reduction each,
+    // to save the latency of reducing many small gradients. A bucket is closed once it holds 'bucketSizeInBytes';
+    // gradients of at least that size, or without elements, get a bucket of their own, so are reduced without a copy.
+    static std::vector<std::vector<size_t>> GroupIntoBuckets(const std::vector<Matrix<ElemType>*>& gradients, const std::vector<size_t>& order, size_t bucketSizeInBytes)
+    {
+        std::vector<std::vector<size_t>> buckets;
+        size_t currentBucketSizeInBytes = 0;
+        bool currentBucketIsOpen = false;
+        for (size_t i : order)
+        {
+            size_t sizeInBytes = gradients[i]->GetNumElements() * sizeof(ElemType);
+            bool ownBucket = sizeInBytes >= bucketSizeInBytes || sizeInBytes == 0;
+            if (!currentBucketIsOpen || ownBucket)
+            {
+                buckets.push_back(std::vector<size_t>());
+                currentBucketSizeInBytes = 0;
+            }
+            buckets.back().push_back(i);
+            currentBucketSizeInBytes += sizeInBytes;
+            currentBucketIsOpen = !ownBucket && currentBucketSizeInBytes < bucketSizeInBytes;
+        }
+        return buckets;
+    }
+
     MPIWrapperPtr m_mpi;
 };
 
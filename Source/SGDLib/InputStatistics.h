@@ -0,0 +1,166 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE.md file in the project root for full license information.
+//
+// InputStatistics.h -- per-dimension mean and variance of an input, accumulated from the reader without the network
+//
+#pragma once
+
+#include "Basics.h"
+#include "CPUThreadPool.h"
+#include "File.h"
+#include "MPIWrapper.h"
+#include "Sequences.h"
+#include <algorithm>
+#include <vector>
+
+namespace Microsoft { namespace MSR { namespace CNTK {
+
+// Number of samples, mean and sum of squared deviations from the mean (M2) per dimension, updated with Welford's method.
+// A minibatch is split into fixed blocks of columns that are accumulated in parallel and merged in order, so that the
+// result does not depend on the number of threads. Statistics of disjoint parts of the data merge exactly, which is how
+// the ranks of a distributed pre-computation combine theirs, see AllReduce().
+class InputStatistics
+{
+    static const size_t s_blockColumns = 256;
+
+public:
+    explicit InputStatistics(size_t dim = 0)
+        : m_numSamples(0), m_mean(dim, 0.0), m_m2(dim, 0.0)
+    {
+    }
+
+    size_t GetDim() const { return m_mean.size(); }
+    size_t GetNumSamples() const { return m_numSamples; }
+    const std::vector<double>& GetMean() const { return m_mean; }
+
+    // the variance of the samples (not the unbiased estimate), like InvStdDevNode
+    std::vector<double> GetVariance() const
+    {
+        std::vector<double> variance(m_m2);
+        if (m_numSamples > 0)
+        {
+            for (auto& v : variance)
+                v /= m_numSamples;
+        }
+        return variance;
+    }
+
+    // accumulates the columns of a column-major [dim x numCols] minibatch, except for the gaps of its layout
+    template <class ElemType>
+    void Accumulate(const ElemType* data, size_t numCols, const MBLayoutPtr& pMBLayout)
+    {
+        std::vector<char> isGap;
+        if (pMBLayout && pMBLayout->HasGaps())
+        {
+            isGap.assign(numCols, 0);
+            const size_t numParallelSequences = pMBLayout->GetNumParallelSequences();
+            const ptrdiff_t numTimeSteps = (ptrdiff_t) pMBLayout->GetNumTimeSteps();
+            for (const auto& seq : pMBLayout->GetAllSequences())
+            {
+                if (seq.seqId != GAP_SEQUENCE_ID)
+                    continue;
+                for (ptrdiff_t t = std::max<ptrdiff_t>(seq.tBegin, 0); t < std::min<ptrdiff_t>(seq.tEnd, numTimeSteps); t++)
+                    isGap[t * numParallelSequences + seq.s] = 1;
+            }
+        }
+
+        const size_t dim = GetDim();
+        const size_t numBlocks = (numCols + s_blockColumns - 1) / s_blockColumns;
+        std::vector<InputStatistics> blocks(numBlocks, InputStatistics(dim));
+        CPUThreadPool::Instance().ParallelFor(numBlocks, 1, [&](size_t begin, size_t end)
+        {
+            for (size_t b = begin; b < end; b++)
+            {
+                const size_t colEnd = std::min(numCols, (b + 1) * s_blockColumns);
+                for (size_t j = b * s_blockColumns; j < colEnd; j++)
+                {
+                    if (isGap.empty() || !isGap[j])
+                        blocks[b].Add(data + j * dim);
+                }
+            }
+        });
+
+        for (const auto& block : blocks)
+            Merge(block);
+    }
+
+    // adds the statistics of other samples (Chan et al.)
+    void Merge(const InputStatistics& other)
+    {
+        if (other.GetDim() != GetDim())
+            LogicError("InputStatistics: Cannot merge statistics of dimension %d into dimension %d.", (int) other.GetDim(), (int) GetDim());
+        if (other.m_numSamples == 0)
+            return;
+
+        const size_t numSamples = m_numSamples + other.m_numSamples;
+        const double otherWeight = (double) other.m_numSamples / numSamples;
+        const double crossWeight = (double) m_numSamples * otherWeight;
+        for (size_t i = 0; i < GetDim(); i++)
+        {
+            const double delta = other.m_mean[i] - m_mean[i];
+            m_mean[i] += delta * otherWeight;
+            m_m2[i] += other.m_m2[i] + delta * delta * crossWeight;
+        }
+        m_numSamples = numSamples;
+    }
+
+    // merges the statistics of all ranks, which then each hold the statistics of all data
+    // The global mean is reduced first, then the M2 of each rank relative to it.
+    void AllReduce(const MPIWrapper& mpi)
+    {
+        const size_t dim = GetDim();
+        std::vector<double> buffer(1 + dim);
+        buffer[0] = (double) m_numSamples;
+        for (size_t i = 0; i < dim; i++)
+            buffer[1 + i] = m_numSamples * m_mean[i];
+        mpi.AllReduce(buffer.data(), buffer.size());
+
+        const double numSamples = buffer[0];
+        if (numSamples == 0)
+            return;
+        std::vector<double> mean(dim);
+        for (size_t i = 0; i < dim; i++)
+            mean[i] = buffer[1 + i] / numSamples;
+
+        for (size_t i = 0; i < dim; i++)
+            buffer[i] = m_m2[i] + m_numSamples * (m_mean[i] - mean[i]) * (m_mean[i] - mean[i]);
+        mpi.AllReduce(buffer.data(), dim);
+
+        m_m2.assign(buffer.begin(), buffer.begin() + dim);
+        m_mean.swap(mean);
+        m_numSamples = (size_t) numSamples;
+    }
+
+    void Save(File& fstream) const
+    {
+        fstream << m_numSamples << m_mean << m_m2;
+    }
+
+    void Load(File& fstream)
+    {
+        fstream >> m_numSamples >> m_mean >> m_m2;
+        if (m_m2.size() != m_mean.size())
+            RuntimeError("InputStatistics: Inconsistent dimensions %d and %d.", (int) m_mean.size(), (int) m_m2.size());
+    }
+
+private:
+    template <class ElemType>
+    void Add(const ElemType* x)
+    {
+        m_numSamples++;
+        const double invNumSamples = 1.0 / m_numSamples;
+        for (size_t i = 0; i < GetDim(); i++)
+        {
+            const double delta = x[i] - m_mean[i];
+            m_mean[i] += delta * invNumSamples;
+            m_m2[i] += delta * (x[i] - m_mean[i]);
+        }
+    }
+
+    size_t m_numSamples;
+    std::vector<double> m_mean;
+    std::vector<double> m_m2;
+};
+
+}}}
@@ -11,12 +11,14 @@
 #include "SGD.h"
 #include "Matrix.h"
 #include "MPIWrapper.h"
+#include "ParameterBroadcaster.h"
 #include "TimerUtility.h"
 #include <vector>
 #include <string>
 #include <stdexcept>
 #include <chrono> 
 #include <random>
+#include <future>
 
 
 namespace Microsoft { namespace MSR { namespace CNTK {
@@ -39,12 +41,16 @@ namespace Microsoft { namespace MSR { namespace CNTK {
         size_t m_localSamplesProcessedSinceLastReport; 
         double m_accumulatedSecondsOnSyncPointInOneEpoch;
         size_t m_syncPointHitCounterInOneEpoch;
+        // communication of model aggregations that overlapped with local training (DelayedBlockMomentumSGD)
+        double m_accumulatedSecondsOnCommunicationInOneEpoch;
+        double m_accumulatedSecondsOfHiddenCommunicationInOneEpoch;
         Timer  m_Timer; 
 
     public:
         MASGDPerfStats(size_t myRank, size_t numWorkers):
             m_numWorkers(numWorkers), m_myRank(myRank), m_numSyncPerformedInCurrentEpoch(0), m_reportFrequency(1), 
-            m_totalSamplesProcessedSinceLastReport(0), m_localSamplesProcessedSinceLastReport(0)
+            m_totalSamplesProcessedSinceLastReport(0), m_localSamplesProcessedSinceLastReport(0),
+            m_accumulatedSecondsOnCommunicationInOneEpoch(0), m_accumulatedSecondsOfHiddenCommunicationInOneEpoch(0)
         {
             m_Timer.Start();
         }
@@ -60,14 +66,24 @@ namespace Microsoft { namespace MSR { namespace CNTK {
             m_numSyncPerformedInCurrentEpoch = 0; 
             m_accumulatedSecondsOnSyncPointInOneEpoch = 0;
             m_syncPointHitCounterInOneEpoch = 0;
+            m_accumulatedSecondsOnCommunicationInOneEpoch = 0;
+            m_accumulatedSecondsOfHiddenCommunicationInOneEpoch = 0;
         }
         void OnEpochEnd()
         {
             m_Timer.Stop();
+            if (m_accumulatedSecondsOfHiddenCommunicationInOneEpoch > 0)
+            {
+                fprintf(stderr, "\t\t(model aggregation stats): %.2f of %.2f seconds on comm. in this epoch were hidden behind local training\n",
+                        m_accumulatedSecondsOfHiddenCommunicationInOneEpoch, m_accumulatedSecondsOnCommunicationInOneEpoch);
+            }
         }
-        void OnMAPerformed(size_t localSamplesProcessedSinceLastSync, size_t totalSamplesProcessedSinceLastSync, float secondsOnCommunication)
+        // secondsOfCommunicationHidden: the part of secondsOnCommunication that overlapped with local training
+        void OnMAPerformed(size_t localSamplesProcessedSinceLastSync, size_t totalSamplesProcessedSinceLastSync, float secondsOnCommunication, float secondsOfCommunicationHidden = 0.0f)
         {
             m_numSyncPerformedInCurrentEpoch++;
+            m_accumulatedSecondsOnCommunicationInOneEpoch += secondsOnCommunication;
+            m_accumulatedSecondsOfHiddenCommunicationInOneEpoch += secondsOfCommunicationHidden;
             m_totalSamplesProcessedSinceLastReport += totalSamplesProcessedSinceLastSync; 
             m_localSamplesProcessedSinceLastReport += localSamplesProcessedSinceLastSync; 
             if ( m_reportFrequency > 0 && 
@@ -81,6 +97,11 @@ namespace Microsoft { namespace MSR { namespace CNTK {
                 ReportMAPerfStats(m_totalSamplesProcessedSinceLastReport, 
                                   m_localSamplesProcessedSinceLastReport, 
                                   secondsOnCommunication );
+                if (secondsOfCommunicationHidden > 0)
+                {
+                    fprintf(stderr, "\t\t(model aggregation stats) %d-th sync: %.2f of %.2f seconds on comm. hidden behind local training\n",
+                            (int)m_numSyncPerformedInCurrentEpoch, secondsOfCommunicationHidden, secondsOnCommunication);
+                }
 
                 m_totalSamplesProcessedSinceLastReport = 0; 
                 m_localSamplesProcessedSinceLastReport = 0; 
@@ -404,4 +425,301 @@ namespace Microsoft { namespace MSR { namespace CNTK {
         }
     };
 
+    // Block momentum (BMUF) with the model aggregation delayed by one block, so that its communication overlaps with local training.
+    // At a sync point each worker takes a snapshot of its model and starts the all-reduce of the snapshots in the background,
+    // and continues training. At the next sync point the block momentum update is computed from the average of the snapshots:
+    //     G(t) = W(t-1) - average of the snapshots
+    //     D(t) = blockMomentum * D(t-1) + blockLearningRate * G(t)
+    //     W(t) = W(t-1) - D(t)
+    // and each worker's model is moved to W(t) (W(t) - blockMomentum * D(t) with Nesterov momentum) plus the progress it made since
+    // its snapshot. Block momentum 0 with block learning rate 1 is model averaging.
+    // The aggregation runs MPI on another thread, so it is completed before the status exchange of the next sync point and before
+    // the end of the epoch, which ends with a blocking aggregation so that all workers leave the epoch with the same model.
+    template<typename ElemType>
+    class DelayedBlockMomentumSGD : public IMASGD<ElemType>
+    {
+        typedef IMASGD<ElemType> Base;
+        using Base::m_pMPI;
+        using Base::m_numSyncPerformed;
+        using Base::m_perfReporter;
+        using Base::m_deviceId;
+        using Base::DownCast;
+        using Base::UpdateWorkerStatus;
+
+    public:
+        DelayedBlockMomentumSGD(const MPIWrapperPtr& pMPI, size_t reportFreq, DEVICEID_TYPE devID,
+                                bool useNesterovMomentum, bool resetSGDMomentum, double blockLearningRate, double blockMomentum)
+            : Base(pMPI, reportFreq, devID),
+              m_useNesterovMomentum(useNesterovMomentum),
+              m_resetSGDMomentum(resetSGDMomentum),
+              m_blockLearningRate(blockLearningRate),
+              m_blockMomentum(blockMomentum),
+              m_pendingLocalSamples(0),
+              m_pendingTotalSamples(0),
+              m_pendingSecondsOnCommunication(0)
+        {
+            fprintf(stderr, "Parallel training (%d workers) using delayed BlockMomentumSGD with block momentum = %6.4f, block learning rate = %6.4f\n",
+                    (int)m_pMPI->NumNodesInUse(), m_blockMomentum, m_blockLearningRate);
+            if (m_useNesterovMomentum)
+                fprintf(stderr, "delayed BlockMomentumSGD uses Nesterov-style block momentum\n");
+            if (m_resetSGDMomentum)
+                fprintf(stderr, "delayed BlockMomentumSGD resets the SGD momentum after each model aggregation\n");
+        }
+
+        ~DelayedBlockMomentumSGD()
+        {
+            if (m_pendingAggregation.valid())
+                m_pendingAggregation.wait();
+        }
+
+        // conversions between the block momentum per synchronization of blockSize samples and its time constant (in samples)
+        static double TimeConstant2Momentum(double timeConstant, size_t blockSize)
+        {
+            if (timeConstant == 0)
+                return 0;
+            return exp(-((double)blockSize) / timeConstant);
+        }
+
+        static double Momentum2TimeConstant(double blockMomentum, size_t blockSize)
+        {
+            if (blockMomentum < 0 || blockMomentum >= 1)
+                InvalidArgument("Block momentum must be in [0, 1), got %f.", blockMomentum);
+            if (blockMomentum == 0)
+                return 0;
+            return -((double)blockSize) / log(blockMomentum);
+        }
+
+        void OnEpochStart(const std::list<ComputationNodeBasePtr>& learnableNodes) override
+        {
+            if (m_blockStartValues.empty())
+            {
+                // the first block starts from the model of the main node
+                std::vector<Matrix<ElemType>*> values;
+                for (auto& pBaseNode : learnableNodes)
+                {
+                    if (pBaseNode->IsParameterUpdateRequired())
+                        values.push_back(&DownCast(pBaseNode)->Value());
+                }
+                ParameterBroadcaster<ElemType>(m_pMPI, m_deviceId).Broadcast(values);
+
+                for (auto& pBaseNode : learnableNodes)
+                {
+                    if (!pBaseNode->IsParameterUpdateRequired())
+                    {
+                        continue;
+                    }
+                    auto pNode = DownCast(pBaseNode);
+                    Matrix<ElemType>& value = pNode->Value();
+                    m_blockStartValues[pNode->NodeName()] = make_shared<Matrix<ElemType>>(value.DeepClone());
+                    auto blockSmoothedGradient = make_shared<Matrix<ElemType>>(value.GetNumRows(), value.GetNumCols(), value.GetDeviceId());
+                    blockSmoothedGradient->SetValue((ElemType)0);
+                    m_blockSmoothedGradients[pNode->NodeName()] = blockSmoothedGradient;
+                }
+            }
+            Base::OnEpochStart(learnableNodes);
+        }
+
+        void OnEpochEnd(const std::list<ComputationNodeBasePtr>& learnableNodes,
+                        std::list<Matrix<ElemType>>&             smoothedGradient,
+                        size_t                                   samplesSinceLastSync) override
+        {
+            // the status exchange uses MPI, which the aggregation in flight is still using
+            FinishPendingAggregation(learnableNodes, smoothedGradient, /*report=*/true);
+            Base::OnEpochEnd(learnableNodes, smoothedGradient, samplesSinceLastSync);
+        }
+
+        bool OnArrivingAtSyncPoint(
+            const std::list<ComputationNodeBasePtr>& learnableNodes,
+            std::list<Matrix<ElemType>>&             smoothedGradient,
+            size_t                                   samplesSinceLastSync) override
+        {
+            Timer syncPointTimer;
+            syncPointTimer.Start();
+            FinishPendingAggregation(learnableNodes, smoothedGradient, /*report=*/true);
+            bool read2Sync = UpdateWorkerStatus(MAWorkerStatus::DataProcessing);
+            syncPointTimer.Stop();
+            m_perfReporter.OnArriveAtSyncPoint(syncPointTimer.ElapsedSeconds(), read2Sync);
+
+            if (read2Sync)
+            {
+                m_numSyncPerformed++;
+                StartAggregation(learnableNodes, samplesSinceLastSync);
+            }
+            return read2Sync;
+        }
+
+        // blocking aggregation, at the end of the epoch
+        void ModelAggregationProcessing(
+            size_t samplesSinceLastSync,                                       /* in */
+            const std::list<ComputationNodeBasePtr>&  learnableNodes,          /* in/out */
+            std::list<Matrix<ElemType>>&              smoothedGradient,        /* in/out */
+            size_t&                                   totalSamplesProcessed,   /* out */
+            float&                                    secondsOnCommunication   /* out */) override
+        {
+            StartAggregation(learnableNodes, samplesSinceLastSync);
+            FinishPendingAggregation(learnableNodes, smoothedGradient, /*report=*/false);
+            totalSamplesProcessed = (size_t)m_pendingTotalSamples;
+            secondsOnCommunication = (float)m_pendingSecondsOnCommunication;
+        }
+
+        // The aggregation in flight, if any, is not saved; its block is aggregated with the next one after a restart.
+        void SaveToCheckPoint(File& fstream) override
+        {
+            fstream.PutMarker(FileMarker::fileMarkerBeginSection, L"BDelayedBlockMomentum");
+            fstream << m_blockStartValues.size();
+            for (auto& blockStartValue : m_blockStartValues)
+            {
+                fstream << blockStartValue.first << *blockStartValue.second << *m_blockSmoothedGradients[blockStartValue.first];
+            }
+            fstream.PutMarker(FileMarker::fileMarkerEndSection, L"EDelayedBlockMomentum");
+        }
+
+        void LoadFromCheckPoint(File& fstream) override
+        {
+            // checkpoints of other parallelization methods start from the model at the next epoch
+            if (!fstream.TryGetMarker(FileMarker::fileMarkerBeginSection, L"BDelayedBlockMomentum"))
+            {
+                return;
+            }
+
+            m_blockStartValues.clear();
+            m_blockSmoothedGradients.clear();
+            size_t numParameters;
+            fstream >> numParameters;
+            for (size_t i = 0; i < numParameters; i++)
+            {
+                std::wstring name;
+                auto blockStartValue = make_shared<Matrix<ElemType>>(m_deviceId);
+                auto blockSmoothedGradient = make_shared<Matrix<ElemType>>(m_deviceId);
+                fstream >> name >> *blockStartValue >> *blockSmoothedGradient;
+                m_blockStartValues[name] = blockStartValue;
+                m_blockSmoothedGradients[name] = blockSmoothedGradient;
+            }
+            fstream.GetMarker(FileMarker::fileMarkerEndSection, L"EDelayedBlockMomentum");
+        }
+
+    private:
+        // Takes the snapshots of the models and starts their all-reduce, weighted by the samples of each worker, in the background.
+        void StartAggregation(const std::list<ComputationNodeBasePtr>& learnableNodes, size_t samplesSinceLastSync)
+        {
+            size_t numElements = 0;
+            for (auto& pBaseNode : learnableNodes)
+            {
+                if (pBaseNode->IsParameterUpdateRequired())
+                    numElements += DownCast(pBaseNode)->Value().GetNumElements();
+            }
+            m_aggregationBuffer.resize(numElements);
+
+            size_t offset = 0;
+            for (auto& pBaseNode : learnableNodes)
+            {
+                if (!pBaseNode->IsParameterUpdateRequired())
+                {
+                    continue;
+                }
+                auto pNode = DownCast(pBaseNode);
+                const Matrix<ElemType>& value = pNode->Value();
+                auto& snapshot = m_snapshots[pNode->NodeName()];
+                if (!snapshot)
+                    snapshot = make_shared<Matrix<ElemType>>(value.GetNumRows(), value.GetNumCols(), value.GetDeviceId());
+                snapshot->SetValue(value);
+                value.CopySection(value.GetNumRows(), value.GetNumCols(), m_aggregationBuffer.data() + offset, value.GetNumRows());
+                offset += value.GetNumElements();
+            }
+
+            m_pendingLocalSamples = samplesSinceLastSync;
+            m_pendingAggregation = std::async(std::launch::async, [this]()
+            {
+                Timer commTimer;
+                commTimer.Start();
+                ElemType weight = (ElemType)m_pendingLocalSamples;
+                for (auto& x : m_aggregationBuffer)
+                    x *= weight;
+                double totalSamples = (double)m_pendingLocalSamples;
+                m_pMPI->AllReduce(&totalSamples, 1);
+                m_pMPI->AllReduce(m_aggregationBuffer.data(), m_aggregationBuffer.size());
+                commTimer.Stop();
+                m_pendingTotalSamples = totalSamples;
+                m_pendingSecondsOnCommunication = commTimer.ElapsedSeconds();
+            });
+        }
+
+        // Waits for the aggregation in flight, if any, and applies the block momentum update to the models.
+        void FinishPendingAggregation(const std::list<ComputationNodeBasePtr>& learnableNodes, std::list<Matrix<ElemType>>& smoothedGradient, bool report)
+        {
+            if (!m_pendingAggregation.valid())
+            {
+                return;
+            }
+
+            Timer waitTimer;
+            waitTimer.Start();
+            m_pendingAggregation.get();
+            waitTimer.Stop();
+
+            if (report)
+            {
+                float secondsOnCommunication = (float)m_pendingSecondsOnCommunication;
+                float secondsOfCommunicationHidden = std::max(0.0f, secondsOnCommunication - (float)waitTimer.ElapsedSeconds());
+                m_perfReporter.OnMAPerformed(m_pendingLocalSamples, (size_t)m_pendingTotalSamples, secondsOnCommunication, secondsOfCommunicationHidden);
+            }
+
+            if (m_pendingTotalSamples <= 0)
+            {
+                return;
+            }
+
+            ElemType factor = (ElemType)(1.0 / m_pendingTotalSamples);
+            size_t offset = 0;
+            auto smoothedGradientIter = smoothedGradient.begin();
+            for (auto nodeIter = learnableNodes.begin(); nodeIter != learnableNodes.end(); nodeIter++, smoothedGradientIter++)
+            {
+                if (!(*nodeIter)->IsParameterUpdateRequired())
+                {
+                    continue;
+                }
+                auto pNode = DownCast(*nodeIter);
+                Matrix<ElemType>& value = pNode->Value();
+                Matrix<ElemType>& blockStartValue = *m_blockStartValues.at(pNode->NodeName());
+                Matrix<ElemType>& blockSmoothedGradient = *m_blockSmoothedGradients.at(pNode->NodeName());
+                Matrix<ElemType>& snapshot = *m_snapshots.at(pNode->NodeName());
+
+                // keep the progress since the snapshot, and reuse the snapshot for the average
+                Matrix<ElemType>::ScaleAndAdd((ElemType)-1, snapshot, value);
+                snapshot.SetValue(value.GetNumRows(), value.GetNumCols(), value.GetDeviceId(), m_aggregationBuffer.data() + offset);
+                Matrix<ElemType>::Scale(factor, snapshot);
+
+                // -G(t) = average - W(t-1); D(t) = blockMomentum * D(t-1) + blockLearningRate * G(t); W(t) = W(t-1) - D(t)
+                Matrix<ElemType>::ScaleAndAdd((ElemType)-1, blockStartValue, snapshot);
+                Matrix<ElemType>::ScaleAndAdd((ElemType)-m_blockLearningRate, snapshot, (ElemType)m_blockMomentum, blockSmoothedGradient);
+                Matrix<ElemType>::ScaleAndAdd((ElemType)-1, blockSmoothedGradient, blockStartValue);
+
+                Matrix<ElemType>::ScaleAndAdd((ElemType)1, blockStartValue, value);
+                if (m_useNesterovMomentum)
+                    Matrix<ElemType>::ScaleAndAdd((ElemType)-m_blockMomentum, blockSmoothedGradient, value);
+                if (m_resetSGDMomentum)
+                    smoothedGradientIter->SetValue((ElemType)0);
+
+                offset += value.GetNumElements();
+            }
+        }
+
+        const bool   m_useNesterovMomentum;
+        const bool   m_resetSGDMomentum;
+        const double m_blockLearningRate;
+        const double m_blockMomentum;
+
+        // by node name
+        std::map<std::wstring, shared_ptr<Matrix<ElemType>>> m_blockStartValues;       // W(t-1)
+        std::map<std::wstring, shared_ptr<Matrix<ElemType>>> m_blockSmoothedGradients; // D(t-1)
+        std::map<std::wstring, shared_ptr<Matrix<ElemType>>> m_snapshots;              // the models of the aggregation in flight
+
+        // the aggregation in flight; its buffer and results are only accessed by the main thread after it completed
+        std::future<void>     m_pendingAggregation;
+        std::vector<ElemType> m_aggregationBuffer;
+        size_t                m_pendingLocalSamples;
+        double                m_pendingTotalSamples;
+        double                m_pendingSecondsOnCommunication;
+    };
+
 } } }
@@ -0,0 +1,239 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE.md file in the project root for full license information.
+//
+// ParameterBroadcaster.h -- copies values, e.g. the parameters of the model, from the main node to all other workers
+//
+
+#pragma once
+
+#include "Basics.h"
+#include "Matrix.h"
+#include "MPIWrapper.h"
+#include "NcclComm.h"
+#include "GPUDataTransferer.h"
+#include "CUDAPageLockedMemAllocator.h"
+#include <cstring>
+#include <memory>
+#include <vector>
+
+namespace Microsoft { namespace MSR { namespace CNTK {
+
+// Broadcasts a list of values with a few large collectives instead of one per value. The values are taken as one
+// sequence of elements, which is cut into chunks of 'chunkSizeInBytes' that are broadcast one after the other:
+//  - With NCCL (see NcclComm), on the GPUs. A chunk that lies within one value is broadcast in place, the others are
+//    packed into a fusion buffer.
+//  - Otherwise with MPI, through two page-locked buffers: the copies of one chunk from or to the GPU overlap the
+//    broadcast of the next one, which MPI pipelines along its broadcast tree.
+// All workers must call Broadcast() with values of the same sizes, in the same order.
+template <class ElemType>
+class ParameterBroadcaster
+{
+public:
+    ParameterBroadcaster(const MPIWrapperPtr& mpi, DEVICEID_TYPE deviceId, size_t chunkSizeInBytes = 64 * 1024 * 1024)
+        : m_mpi(mpi), m_deviceId(deviceId), m_chunkSize(std::max(chunkSizeInBytes / sizeof(ElemType), (size_t) 1)), m_nccl(deviceId, mpi)
+    {
+    }
+
+    void Broadcast(const std::vector<Matrix<ElemType>*>& values)
+    {
+        size_t numElements = 0;
+        for (auto value : values)
+        {
+            if (value->GetMatrixType() != DENSE || value->GetDeviceId() != m_deviceId)
+                LogicError("ParameterBroadcaster: The values must be dense matrices on device %d.", (int) m_deviceId);
+            numElements += value->GetNumElements();
+        }
+
+        // a mismatch would hang or corrupt the collectives below
+        size_t mainNumElements = numElements;
+        m_mpi->Bcast(&mainNumElements, 1, m_mpi->MainNodeRank());
+        if (mainNumElements != numElements)
+            RuntimeError("ParameterBroadcaster: The model of this worker has %d elements, the one of the main node %d.", (int) numElements, (int) mainNumElements);
+
+        auto chunks = CutIntoChunks(values);
+        if (m_nccl.IsSupported())
+            BroadcastWithNccl(chunks);
+        else
+            BroadcastWithMpi(chunks);
+    }
+
+private:
+    // a part of a value that is in a chunk
+    struct Segment
+    {
+        Matrix<ElemType>* m_value;
+        size_t m_offset;      // of the first element in the value
+        size_t m_numElements;
+        size_t m_chunkOffset; // of the first element in the chunk
+    };
+    typedef std::vector<Segment> Chunk;
+
+    std::vector<Chunk> CutIntoChunks(const std::vector<Matrix<ElemType>*>& values) const
+    {
+        std::vector<Chunk> chunks;
+        size_t chunkNumElements = m_chunkSize; // (of the last chunk; full, so that the first value starts a new one)
+        for (auto value : values)
+        {
+            for (size_t offset = 0; offset < value->GetNumElements();)
+            {
+                if (chunkNumElements == m_chunkSize)
+                {
+                    chunks.push_back(Chunk());
+                    chunkNumElements = 0;
+                }
+                size_t n = std::min(value->GetNumElements() - offset, m_chunkSize - chunkNumElements);
+                chunks.back().push_back(Segment{ value, offset, n, chunkNumElements });
+                offset += n;
+                chunkNumElements += n;
+            }
+        }
+        return chunks;
+    }
+
+    static size_t NumElements(const Chunk& chunk)
+    {
+        return chunk.back().m_chunkOffset + chunk.back().m_numElements;
+    }
+
+    void BroadcastWithNccl(const std::vector<Chunk>& chunks)
+    {
+        bool isMainNode = m_mpi->IsMainNode();
+        std::unique_ptr<Matrix<ElemType>> fusionBuffer;
+        for (const auto& chunk : chunks)
+        {
+            if (chunk.size() == 1)
+            {
+                m_nccl.Broadcast(chunk[0].m_value->Data() + chunk[0].m_offset, chunk[0].m_numElements);
+                m_nccl.Sync();
+                continue;
+            }
+
+            if (!fusionBuffer)
+                fusionBuffer = std::make_unique<Matrix<ElemType>>(1, m_chunkSize, m_deviceId);
+            if (isMainNode)
+            {
+                for (const auto& segment : chunk)
+                    fusionBuffer->SetColumnSlice(Flattened(segment).ColumnSlice(segment.m_offset, segment.m_numElements), segment.m_chunkOffset, segment.m_numElements);
+            }
+            // the next chunk is packed, or unpacked, only once this one has been broadcast
+            m_nccl.Broadcast(fusionBuffer->Data(), NumElements(chunk));
+            m_nccl.Sync();
+            if (!isMainNode)
+            {
+                for (const auto& segment : chunk)
+                    Flattened(segment).SetColumnSlice(fusionBuffer->ColumnSlice(segment.m_chunkOffset, segment.m_numElements), segment.m_offset, segment.m_numElements);
+            }
+        }
+    }
+
+    // a reference to the value of the segment as a row vector
+    static Matrix<ElemType> Flattened(const Segment& segment)
+    {
+        return segment.m_value->Reshaped(1, segment.m_value->GetNumElements());
+    }
+
+    // Chunk i is broadcast from m_buffers[i % 2], so the main node copies chunk i + 1 from the GPU while chunk i is
+    // broadcast, and the other workers copy chunk i to the GPU while chunk i + 1 is received.
+    void BroadcastWithMpi(const std::vector<Chunk>& chunks)
+    {
+        if (chunks.empty())
+            return;
+
+        for (size_t slot = 0; slot < 2; slot++)
+        {
+            if (!m_buffers[slot])
+                m_buffers[slot] = AllocateBuffer(m_chunkSize);
+            if (m_deviceId >= 0 && !m_transferers[slot])
+                m_transferers[slot] = std::make_unique<GPUDataTransferer>(m_deviceId, /*useConcurrentStreams=*/true);
+        }
+        MPI_Request requests[2] = { MPI_REQUEST_NULL, MPI_REQUEST_NULL };
+        size_t mainNodeRank = m_mpi->MainNodeRank();
+
+        if (m_mpi->IsMainNode())
+        {
+            for (size_t i = 0; i < chunks.size(); i++)
+            {
+                size_t slot = i % 2;
+                m_mpi->Wait(&requests[slot]); // until chunk i - 2 is sent
+                CopyToBuffer(chunks[i], slot);
+                m_mpi->BcastAsync(m_buffers[slot].get(), NumElements(chunks[i]), mainNodeRank, &requests[slot]);
+            }
+        }
+        else
+        {
+            m_mpi->BcastAsync(m_buffers[0].get(), NumElements(chunks[0]), mainNodeRank, &requests[0]);
+            for (size_t i = 0; i < chunks.size(); i++)
+            {
+                size_t slot = i % 2;
+                if (i + 1 < chunks.size())
+                {
+                    if (i > 0 && m_transferers[1 - slot])
+                        m_transferers[1 - slot]->WaitForCopyCPUToGPUAsync(); // chunk i - 1 is on the GPU
+                    m_mpi->BcastAsync(m_buffers[1 - slot].get(), NumElements(chunks[i + 1]), mainNodeRank, &requests[1 - slot]);
+                }
+                m_mpi->Wait(&requests[slot]);
+                CopyFromBuffer(chunks[i], slot);
+            }
+            for (auto& transferer : m_transferers)
+            {
+                if (transferer)
+                    transferer->WaitForCopyCPUToGPUAsync();
+            }
+        }
+        m_mpi->Wait(&requests[0]);
+        m_mpi->Wait(&requests[1]);
+    }
+
+    // returns once the chunk is in the buffer
+    void CopyToBuffer(const Chunk& chunk, size_t slot)
+    {
+        ElemType* buffer = m_buffers[slot].get();
+        for (const auto& segment : chunk)
+        {
+            ElemType* data = segment.m_value->Data() + segment.m_offset;
+            if (m_deviceId >= 0)
+                m_transferers[slot]->CopyGPUToCPUAsync(data, segment.m_numElements, buffer + segment.m_chunkOffset);
+            else
+                memcpy(buffer + segment.m_chunkOffset, data, segment.m_numElements * sizeof(ElemType));
+        }
+        if (m_deviceId >= 0)
+            m_transferers[slot]->WaitForCopyGPUToCPUAsync();
+    }
+
+    // only queues the copies to the GPU
+    void CopyFromBuffer(const Chunk& chunk, size_t slot)
+    {
+        ElemType* buffer = m_buffers[slot].get();
+        for (const auto& segment : chunk)
+        {
+            ElemType* data = segment.m_value->Data() + segment.m_offset;
+            if (m_deviceId >= 0)
+                m_transferers[slot]->CopyCPUToGPUAsync(buffer + segment.m_chunkOffset, segment.m_numElements, data);
+            else
+                memcpy(data, buffer + segment.m_chunkOffset, segment.m_numElements * sizeof(ElemType));
+        }
+    }
+
+    std::shared_ptr<ElemType> AllocateBuffer(size_t numElements) const
+    {
+        if (m_deviceId < 0)
+            return std::shared_ptr<ElemType>(new ElemType[numElements], [](ElemType* p) { delete[] p; });
+
+        // page-locked, for the asynchronous copies
+        DEVICEID_TYPE deviceId = m_deviceId;
+        return std::shared_ptr<ElemType>((ElemType*) CUDAPageLockedMemAllocator::Malloc(numElements * sizeof(ElemType), deviceId), [deviceId](ElemType* p)
+                                         {
+                                             CUDAPageLockedMemAllocator::Free(p, deviceId);
+                                         });
+    }
+
+    MPIWrapperPtr m_mpi;
+    DEVICEID_TYPE m_deviceId;
+    size_t m_chunkSize; // in elements
+    NcclComm m_nccl;
+    std::shared_ptr<ElemType> m_buffers[2];
+    std::unique_ptr<GPUDataTransferer> m_transferers[2];
+};
+
+}}}
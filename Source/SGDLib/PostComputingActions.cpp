@@ -6,6 +6,8 @@
 #include "PostComputingActions.h"
 
 #include "TrainingNodes.h"
+#include "LinearAlgebraNodes.h"
+#include "InputAndParamNodes.h"
 #include "ProgressTracing.h"
 #include "DataReaderHelpers.h"
 #include "SimpleDistGradAggregator.h"
@@ -38,10 +40,10 @@ void PostComputingActions<ElemType>::BatchNormalizationStatistics(IDataReader *
             {
                 if (bnNodesLogged.insert(node).second)
                 {
-                    // reset the statistics states of bn nodes
+                    // Reset the statistics states of bn nodes. With both time constants at 0, every forward prop
+                    // normalizes with the minibatch statistics and overwrites the running mean and variance with them,
+                    // from where they are picked up by the accumulation below.
                     bnNode->ResetStatisticsState();
-                    bnNode->SetNormalizationTimeConstants(-1, bnNode->NormalizationTimeConstant(),
-                        0, bnNode->BlendTimeConstant());
                     bnNodes.push_back(node);
                     // add BN nodes into the evaluation group, then they will be added into root nodes when
                     // the network re-compile
@@ -66,7 +68,22 @@ void PostComputingActions<ElemType>::BatchNormalizationStatistics(IDataReader *
 
     bool useParallelTrain = (m_mpi != nullptr);
     bool useDistributedMBReading = useParallelTrain && m_enableDistributedMBReading && dataReader->SupportsDistributedMBRead();
-    size_t totalEpochSize = bnNodes.size() * mbSize * iters;
+    size_t totalEpochSize = mbSize * iters;
+
+    // Per bn node sums of the input values and of their squares, for exact corpus-level statistics.
+    // A bn node normalizes each element of its running mean over 'samplesPerColumn' values of a minibatch column
+    // (the spatial positions for spatial bn, 1 otherwise).
+    std::vector<Matrix<ElemType>> sums, sumsOfSquares;
+    std::vector<size_t> samplesPerColumn;
+    std::vector<size_t> numSamples(bnNodes.size(), 0);
+    for (auto& node : bnNodes)
+    {
+        let& runMean = static_pointer_cast<ComputationNode<ElemType>>(node->Input(3))->Value();
+        sums.push_back(Matrix<ElemType>::Zeros(runMean.GetNumRows(), runMean.GetNumCols(), m_net->GetDeviceId()));
+        sumsOfSquares.push_back(Matrix<ElemType>::Zeros(runMean.GetNumRows(), runMean.GetNumCols(), m_net->GetDeviceId()));
+        samplesPerColumn.push_back(node->Input(0)->GetSampleLayout().GetNumElements() / runMean.GetNumElements());
+    }
+    Matrix<ElemType> temp(m_net->GetDeviceId());
 
     m_net->StartEvaluateMinibatchLoop(bnNodes);
 
@@ -75,82 +92,278 @@ void PostComputingActions<ElemType>::BatchNormalizationStatistics(IDataReader *
     else
         dataReader->StartMinibatchLoop(mbSize, 0, inputMatrices.GetStreamDescriptions(), totalEpochSize);
 
-    for (auto& node : bnNodes)
+    LOGPRINTF(stderr, "Estimating Statistics of %d batch normalization nodes in a single pass over %d minibatches.\n", (int)bnNodes.size(), iters);
+
+    // All bn nodes are estimated in the same forward prop, which stops at the last bn node in evaluation order.
+    // Note that the bn nodes further up see the output of the bn nodes below them normalized with the minibatch statistics.
+    size_t numColumns = 0;
+    for (int iter = 0; iter < iters; iter++)
     {
-        let bnNode = static_pointer_cast<BatchNormalizationNode<ElemType>>(node);
         size_t actualMBSize = 0;
+        // during the bn stat, dataRead must be ensured
+        bool wasDataRead = DataReaderHelpers::GetMinibatchIntoNetwork<ElemType>(*dataReader, m_net,
+            nullptr, useDistributedMBReading, useParallelTrain, inputMatrices, actualMBSize, m_mpi);
+
+        if (!wasDataRead) LogicError("DataRead Failure in batch normalization statistics");
 
-        LOGPRINTF(stderr, "Estimating Statistics --> %ls\n", bnNode->GetName().c_str());
+        ComputationNetwork::BumpEvalTimeStamp(featureNodes);
 
+        m_net->ForwardProp(bnNodes);
 
-        // for every single bn node, the statistics is the average of mean and variance for several times in forward prop
-        // the forward prop is from the feature to the current bn node
-        for (int iter = 0; iter < iters; iter++)
+        // The running mean and (unbiased) variance of every bn node now hold the statistics of this minibatch.
+        // Accumulate sum(x) = n * mean and sum(x^2) = (n-1) * variance + n * mean^2 from them.
+        for (size_t i = 0; actualMBSize > 0 && i < bnNodes.size(); i++) // (a worker may get no data near the end of a distributed pass)
         {
-            // during the bn stat, dataRead must be ensured
-            bool wasDataRead = DataReaderHelpers::GetMinibatchIntoNetwork<ElemType>(*dataReader, m_net,
-                nullptr, useDistributedMBReading, useParallelTrain, inputMatrices, actualMBSize, m_mpi);
+            let& mbMean     = static_pointer_cast<ComputationNode<ElemType>>(bnNodes[i]->Input(3))->Value();
+            let& mbVariance = static_pointer_cast<ComputationNode<ElemType>>(bnNodes[i]->Input(4))->Value();
+            size_t n = bnNodes[i]->GetMBLayout()->GetNumCols() * samplesPerColumn[i];
+
+            Matrix<ElemType>::ScaleAndAdd((ElemType)n, mbMean, sums[i]);
+            Matrix<ElemType>::ScaleAndAdd((ElemType)(n - 1), mbVariance, sumsOfSquares[i]);
+            temp.AssignElementProductOf(mbMean, mbMean);
+            Matrix<ElemType>::ScaleAndAdd((ElemType)n, temp, sumsOfSquares[i]);
+            numSamples[i] += n;
+        }
+        numColumns += actualMBSize;
+    }
 
-            if (!wasDataRead) LogicError("DataRead Failure in batch normalization statistics");
+    dataReader->DataEnd();
 
-            ComputationNetwork::BumpEvalTimeStamp(featureNodes);
+    // Sum up the statistics of all the workers in one aggregation.
+    if (useParallelTrain)
+    {
+        if (m_gradHeader == nullptr)
+        {
+            m_gradHeader.reset(DistGradHeader::Create(0), [](DistGradHeader* ptr)
+            {
+                DistGradHeader::Destroy(ptr);
+            });
+        }
 
-            // forward prop till reaching the current bn node
-            m_net->ForwardProp(node);
+        std::vector<Matrix<ElemType>*> statistics;
+        for (size_t i = 0; i < bnNodes.size(); i++)
+        {
+            statistics.push_back(&sums[i]);
+            statistics.push_back(&sumsOfSquares[i]);
         }
 
+        SimpleDistGradAggregator<ElemType> distGradAgg(m_mpi, false /*useAsyncAggregation*/, m_net->GetDeviceId(), 0 /*syncStatsTrace*/);
+
+        m_gradHeader->Clear();
+        m_gradHeader->numSamples = numColumns;
+        distGradAgg.AggregateGradients(statistics, m_gradHeader.get(), 0);
+        m_mpi->AllReduce(numSamples);
+    }
+
+    // set the corpus-level mean and unbiased variance, and freeze them
+    for (size_t i = 0; i < bnNodes.size(); i++)
+    {
+        let bnNode = static_pointer_cast<BatchNormalizationNode<ElemType>>(bnNodes[i]);
+        auto& runMean     = static_pointer_cast<ComputationNode<ElemType>>(bnNodes[i]->Input(3))->Value();
+        auto& runVariance = static_pointer_cast<ComputationNode<ElemType>>(bnNodes[i]->Input(4))->Value();
+        double n = (double)numSamples[i];
+        if (n == 0)
+            LogicError("%ls: No samples seen in batch normalization statistics", bnNode->NodeName().c_str());
+
+        runMean.SetValue(sums[i]);
+        runMean *= (ElemType)(1 / n);
+        temp.AssignElementProductOf(runMean, runMean);
+        runVariance.SetValue(sumsOfSquares[i]);
+        Matrix<ElemType>::ScaleAndAdd((ElemType)-n, temp, runVariance);
+        runVariance *= (ElemType)(n > 1 ? 1 / (n - 1) : 0);
+
         // after finished statistics, the mean and variance of the bn node should be freezd.
         bnNode->FreezeParameters();
 
-        // Sync during or after all iters of a BN node are equivalent
-        if (useParallelTrain)
+        if (m_traceLevel > 0)
+            LOGPRINTF(stderr, "Estimated Statistics --> %ls\n", bnNode->GetName().c_str());
+    }
+
+    // remove all the added BN nodes from evaluation group
+    for (auto& bnNode : bnNodes)
+    {
+        m_net->RemoveFromNodeGroup(L"evaluation", bnNode);
+    }
+
+    // save model
+    if (!useParallelTrain || m_mpi->CurrentNodeRank() == m_mpi->MainNodeRank())
+        m_net->Save(newModelPath);
+
+    return;
+}
+
+// Histogram of absolute values over [0, max], where max is doubled, by merging pairs of bins, whenever a larger value comes.
+class AbsoluteValueHistogram
+{
+public:
+    static const size_t NumBins = 2048;
+
+    AbsoluteValueHistogram() : m_counts(NumBins, 0), m_max(0), m_numZeros(0)
+    {
+    }
+
+    template <class ElemType>
+    void Add(const ElemType* values, size_t n)
+    {
+        double absMax = 0;
+        for (size_t i = 0; i < n; i++)
+            absMax = max(absMax, (double)fabs(values[i]));
+
+        if (m_max == 0)
         {
-            if (m_gradHeader == nullptr)
+            if (absMax == 0)
             {
-                m_gradHeader.reset(DistGradHeader::Create(evalNodes.size()), [](DistGradHeader* ptr)
-                {
-                    DistGradHeader::Destroy(ptr);
-                });
+                m_numZeros += n;
+                return;
             }
+            m_max = absMax;
+            m_counts[0] += m_numZeros;
+        }
+        while (absMax > m_max)
+        {
+            for (size_t i = 0; i < NumBins / 2; i++)
+                m_counts[i] = m_counts[2 * i] + m_counts[2 * i + 1];
+            fill(m_counts.begin() + NumBins / 2, m_counts.end(), 0);
+            m_max *= 2;
+        }
 
-            // push the statistics results of mean and variance of bn nodes into mpi updating vector
-            std::vector<Matrix<ElemType>*> learnParamsValues(2, nullptr);
+        for (size_t i = 0; i < n; i++)
+            m_counts[min(NumBins - 1, (size_t)(fabs(values[i]) / m_max * NumBins))]++;
+    }
 
-            SimpleDistGradAggregator<ElemType> distGradAgg(m_mpi, false /*useAsyncAggregation*/, m_net->GetDeviceId(), 0 /*syncStatsTrace*/);
+    // upper edge of the bin that holds the given percentile, 0 if there were only zeros
+    double Percentile(double percentile) const
+    {
+        size_t total = 0;
+        for (auto count : m_counts)
+            total += count;
+        double target = percentile / 100 * total;
+        size_t sum = 0;
+        for (size_t i = 0; i < NumBins; i++)
+        {
+            sum += m_counts[i];
+            if (sum >= target)
+                return (i + 1) * m_max / NumBins;
+        }
+        return m_max;
+    }
 
-            auto runMeanParameterPtr = node->Input(3);
-            auto runStdParameterPtr  = node->Input(4);
+    double Max() const { return m_max; }
 
-            shared_ptr<ComputationNode<ElemType>> runMeanNode = static_pointer_cast<ComputationNode<ElemType>>(runMeanParameterPtr);
-            shared_ptr<ComputationNode<ElemType>> runStdNode  = static_pointer_cast<ComputationNode<ElemType>>(runStdParameterPtr);
+private:
+    vector<size_t> m_counts;
+    double m_max;
+    size_t m_numZeros; // before the first non-zero value
+};
 
-            learnParamsValues[0] = &(runMeanNode->Value());
-            learnParamsValues[1] = &(runStdNode->Value());
+template <class ElemType>
+void PostComputingActions<ElemType>::QuantizationCalibration(IDataReader* dataReader, const vector<wstring>& evalNodeNames, const wstring newModelPath,
+    const size_t mbSize, const int iters, const double percentile, const size_t bitShiftWeights, const size_t bitShiftData,
+    const set<wstring>& excludedNodeNames)
+{
+    ScopedNetworkOperationMode modeGuard(m_net, NetworkOperationMode::inferring);
+
+    // find the Times nodes by weights, and their data inputs
+    let evalNodes = m_net->GetEvalNodesWithName(evalNodeNames);
+    std::vector<ComputationNodeBasePtr> timesNodes, dataNodes;
+    std::set<ComputationNodeBasePtr> timesNodesLogged;
+    for (auto& evalNode : evalNodes)
+    {
+        for (auto& node : m_net->GetEvalOrder(evalNode))
+        {
+            if (!dynamic_pointer_cast<TimesNode<ElemType>>(node) || excludedNodeNames.find(node->NodeName()) != excludedNodeNames.end())
+                continue;
+            if (!dynamic_pointer_cast<LearnableParameter<ElemType>>(node->Input(0)) || dynamic_pointer_cast<LearnableParameter<ElemType>>(node->Input(1)))
+                continue;
+            if (timesNodesLogged.insert(node).second)
+            {
+                timesNodes.push_back(node);
+                dataNodes.push_back(node->Input(1));
+                // keep the values of the data nodes, as BatchNormalizationStatistics() does for its nodes
+                m_net->AddToNodeGroup(L"evaluation", node->Input(1));
+            }
+        }
+    }
+    if (timesNodes.empty())
+        InvalidArgument("QuantizationCalibration: There are no Times operations by weights to quantize.");
 
-            m_gradHeader->numSamples = actualMBSize ? 1 : actualMBSize;
-            distGradAgg.AggregateGradients(learnParamsValues, m_gradHeader.get(), 0);
+    m_net->CompileNetwork();
+    m_net->AllocateAllMatrices(dataNodes, std::vector<ComputationNodeBasePtr>(), nullptr);
 
-            // get the average mean and variance across all the workers
-            for (auto& parameter : learnParamsValues)
+    auto& featureNodes = m_net->FeatureNodes();
+    StreamMinibatchInputs inputMatrices;
+    for (auto& node : featureNodes)
+        inputMatrices.AddInput(node->NodeName(), node->ValuePtr(), node->GetMBLayout(), node->GetSampleLayout());
+
+    bool useParallelTrain = (m_mpi != nullptr);
+    dataReader->StartMinibatchLoop(mbSize, 0, inputMatrices.GetStreamDescriptions(), mbSize * iters);
+    m_net->StartEvaluateMinibatchLoop(dataNodes);
+
+    LOGPRINTF(stderr, "Calibrating the quantization of %d Times operations over %d minibatches.\n", (int)timesNodes.size(), iters);
+
+    std::vector<AbsoluteValueHistogram> histograms(timesNodes.size());
+    std::vector<bool> isSparse(timesNodes.size(), false);
+    ElemType* values = nullptr;
+    size_t valuesSize = 0;
+    int numMinibatches = 0;
+    for (; numMinibatches < iters; numMinibatches++)
+    {
+        size_t actualMBSize = 0;
+        if (!DataReaderHelpers::GetMinibatchIntoNetwork<ElemType>(*dataReader, m_net, nullptr, /*useDistributedMBReading=*/false, useParallelTrain, inputMatrices, actualMBSize, m_mpi))
+            break;
+
+        ComputationNetwork::BumpEvalTimeStamp(featureNodes);
+        m_net->ForwardProp(dataNodes);
+
+        for (size_t i = 0; i < dataNodes.size(); i++)
+        {
+            auto dataNode = static_pointer_cast<ComputationNode<ElemType>>(dataNodes[i]);
+            if (dataNode->Value().GetMatrixType() != DENSE)
             {
-                (*parameter) /= (ElemType)m_mpi->NumNodesInUse();
+                isSparse[i] = true;
+                continue;
             }
+            // gaps count as zeros
+            if (dataNode->HasMBLayout())
+                dataNode->MaskMissingValueColumnsToZero(FrameRange(dataNode->GetMBLayout()));
+            size_t n = dataNode->Value().CopyToArray(values, valuesSize);
+            histograms[i].Add(values, n);
         }
     }
+    delete[] values;
 
     dataReader->DataEnd();
+    if (numMinibatches == 0)
+        LogicError("QuantizationCalibration: No data read for the calibration.");
 
-    // remove all the added BN nodes from evaluation group
-    for (auto& bnNode : bnNodes)
+    for (auto& dataNode : dataNodes)
+        m_net->RemoveFromNodeGroup(L"evaluation", dataNode);
+
+    // replace the Times nodes
+    size_t numQuantized = 0;
+    for (size_t i = 0; i < timesNodes.size(); i++)
     {
-        m_net->RemoveFromNodeGroup(L"evaluation", bnNode);
+        let timesNode = static_pointer_cast<TimesNode<ElemType>>(timesNodes[i]);
+        if (isSparse[i])
+        {
+            LOGPRINTF(stderr, "%ls: sparse data, left unquantized.\n", timesNode->NodeName().c_str());
+            continue;
+        }
+        double range = histograms[i].Percentile(percentile);
+        auto quantizedNode = make_shared<QuantizedTimesNode<ElemType>>(m_net->GetDeviceId(), timesNode->NodeName(), bitShiftWeights, bitShiftData,
+                                                                        timesNode->OutputRank(), timesNode->InferInputRankToMap(), range);
+        m_net->ReplaceNode(timesNode->NodeName(), quantizedNode);
+        numQuantized++;
+        if (m_traceLevel > 0)
+            LOGPRINTF(stderr, "%ls: data range %.6g (absolute max below %.6g)\n", timesNode->NodeName().c_str(), range, histograms[i].Max());
     }
+    LOGPRINTF(stderr, "Calibrated %d QuantizedTimes operations over %d minibatches (percentile %g, weight bit shift %d, data bit shift %d).\n",
+              (int)numQuantized, numMinibatches, percentile, (int)bitShiftWeights, (int)bitShiftData);
+
+    m_net->CompileNetwork();
 
-    // save model
     if (!useParallelTrain || m_mpi->CurrentNodeRank() == m_mpi->MainNodeRank())
         m_net->Save(newModelPath);
-
-    return;
 }
 
 template class PostComputingActions<float>;
@@ -46,12 +46,24 @@ public:
     //      seem useless, like error statistics etc.
     // 3. Finding the BN nodes in the network and put them into a vector with evaluate order (This links the nestedNode vector I got in 
     //      ControlFlowNetwork)
-    // 4. From node to node in the BN vector to generate the mean and various (This links to the changes of BatchNormalizationNode 
-    //      in TrainingNodes.h, since I need to make the nodes "learn" mean and variance in inferring mode)
-    // 5. Consider the multi-GPU, we need to sync up the BN results between all the worker and average the value.
+    // 4. Estimate the mean and variance of all the BN nodes in a single pass of 'iters' minibatches. The forward prop only goes up to
+    //      the last BN node, and accumulates the exact sums of the values and of their squares seen by every BN node.
+    // 5. Consider the multi-GPU, we need to sum up the BN statistics of all the workers once at the end of the pass.
     void BatchNormalizationStatistics(IDataReader* dataReader, const vector<wstring>& evalNodeNames, const wstring newModelPath, 
         const size_t mbSize, const int iters = 30);
 
+    // Post-training calibration of quantized inference: replaces the Times nodes by weights below 'evalNodeNames' with
+    // QuantizedTimes nodes, whose range for the data is picked from sample data rather than taken from each minibatch.
+    // 1. The data inputs of all the Times nodes are computed in a single pass of 'iters' minibatches, and a histogram of
+    //      their absolute values is collected per node.
+    // 2. The range of a node is the 'percentile' of its histogram, so that the few largest values get clipped instead of
+    //      costing the precision of all others. The weights keep being quantized with their absolute max.
+    // 3. Nodes in 'excludedNodeNames', and those with sparse data, are left unchanged.
+    // The histograms are not aggregated across workers, so with MPI, each worker reads all the data.
+    void QuantizationCalibration(IDataReader* dataReader, const vector<wstring>& evalNodeNames, const wstring newModelPath,
+        const size_t mbSize, const int iters, const double percentile, const size_t bitShiftWeights, const size_t bitShiftData,
+        const set<wstring>& excludedNodeNames);
+
 private:
     ComputationNetworkPtr m_net;
     MPIWrapperPtr m_mpi;
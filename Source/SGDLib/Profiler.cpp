@@ -6,6 +6,7 @@
 #include <stdio.h>
 #include "Profiler.h"
 #include "BestGpu.h" // for CPUONLY flag only
+#include "TimelineTracer.h"
 
 #ifndef CPUONLY
 #include <cuda_profiler_api.h>
@@ -19,9 +20,10 @@ void cudaProfilerStop()
 }
 #endif
 
-Profiler::Profiler(int numSamples)
+Profiler::Profiler(int numSamples, const std::wstring& timelineTraceFile)
     : m_numSamples(numSamples),
-      m_isProfilingActive(false)
+      m_isProfilingActive(false),
+      m_timelineTraceFile(timelineTraceFile)
 {
 }
 
@@ -35,6 +37,11 @@ void Profiler::Start()
 {
     assert(!m_isProfilingActive);
     m_isProfilingActive = true;
+    if (!m_timelineTraceFile.empty())
+    {
+        Microsoft::MSR::CNTK::TimelineTracer::Start(m_timelineTraceFile);
+        return;
+    }
     fprintf(stderr, "Starting profiling\n");
     cudaProfilerStart();
 }
@@ -56,7 +63,12 @@ void Profiler::NextSample()
 void Profiler::Stop()
 {
     assert(m_isProfilingActive);
+    m_isProfilingActive = false;
+    if (!m_timelineTraceFile.empty())
+    {
+        Microsoft::MSR::CNTK::TimelineTracer::Stop();
+        return;
+    }
     cudaProfilerStop();
     fprintf(stderr, "Stopping profiling\n");
-    m_isProfilingActive = false;
 }
@@ -4,11 +4,15 @@
 //
 #pragma once
 
+#include <string>
+
 class Profiler
 {
 public:
-    // Initializes profiler asking it to take given number of samples (0 to disable) and then stop
-    Profiler(int numSamples);
+    // Initializes profiler asking it to take given number of samples (0 to disable) and then stop.
+    // Without a timeline trace file this starts and stops an external (CUDA) profiler, with one the
+    // in-process TimelineTracer records the samples into that file.
+    Profiler(int numSamples, const std::wstring& timelineTraceFile = std::wstring());
     ~Profiler(); // stops the profiler
     // Notifies transition to the next sample
     void NextSample();
@@ -19,4 +23,5 @@ private:
 
     int m_numSamples;
     bool m_isProfilingActive;
+    std::wstring m_timelineTraceFile;
 };
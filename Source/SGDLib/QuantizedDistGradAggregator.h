@@ -0,0 +1,347 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE.md file in the project root for full license information.
+//
+
+#pragma once
+
+#include "IDistGradAggregator.h"
+#include "MatrixQuantizerImpl.h"
+#include "QuantizationBitAllocator.h"
+#include "MemAllocator.h"
+#include "TimerUtility.h"
+#include "TimelineTracer.h"
+#include <climits>
+#include <map>
+
+namespace Microsoft { namespace MSR { namespace CNTK {
+
+// Aggregates quantized gradients: each worker quantizes each gradient with MatrixQuantizer, keeping the quantization
+// error in a residual that is added to the gradient of the next minibatch. The quantized gradients of all workers are
+// exchanged with MPI_Iallgather, and every worker unquantizes and adds them up in worker order, so that all get the
+// same sum. Gradients larger than ChunkSizeInElements are split into chunks of columns, and the chunks are pipelined, so
+// that the GPU transfers and the exchange of successive chunks overlap. (AllReduceDistGradAggregator of the 1bit submodule instead reduces stripes of the gradients on their owners,
+// which sends less with many workers.)
+// With a QuantizationBitAllocator the number of bits of each gradient is chosen again every AdaptationInterval aggregations,
+// from the residual errors of the workers in the last one; the main node decides, so it is the same on all workers.
+template <class ElemType>
+class QuantizedDistGradAggregator : public IDistGradAggregator<ElemType>
+{
+    UsingIDistGradAggregatorMembers;
+
+    static const size_t AdaptationInterval = 100;
+    static const size_t ChunkSizeInElements = 1 << 22;
+
+public:
+    // 'numGradientBits' of all gradients, or, with a 'bitAllocator', only until the first adaptation
+    QuantizedDistGradAggregator(const MPIWrapperPtr& mpi, size_t numGradientBits, std::shared_ptr<QuantizationBitAllocator> bitAllocator,
+                                bool zeroThresholdFor1Bit, int syncStatsTrace)
+        : IDistGradAggregator<ElemType>(mpi), m_initialNumBits(numGradientBits), m_bitAllocator(bitAllocator), m_zeroThresholdFor1Bit(zeroThresholdFor1Bit),
+          m_syncStatsTrace(syncStatsTrace), m_iterationCount(0), m_numElementsInTotal(0), m_bytesPerWorker(0), m_bytesSentInEpoch(0), m_entriesSentInEpoch(0)
+    {}
+
+    bool AggregateGradients(const std::vector<Matrix<ElemType>*>& gradients, DistGradHeader* headerCPU, bool resetState) override
+    {
+        ResetState(gradients, resetState);
+        bool showSyncPerfStats = (m_syncStatsTrace > 0) && ((m_iterationCount % m_syncStatsTrace) == 0);
+        m_iterationCount++;
+        bool adapt = m_bitAllocator && (m_iterationCount % AdaptationInterval) == 0;
+
+        Timer aggregationTimer;
+        int deviceId = gradients.empty() ? CPUDEVICE : gradients[0]->GetDeviceId();
+        TimelineEvent event("Aggregation", "AggregateQuantizedGradients", deviceId);
+
+        // If the current node did not process any samples, the gradients should be zero'd; the residual is still sent
+        if (headerCPU->numSamples == 0)
+        {
+            for (auto gradient : gradients)
+                gradient->SetValue(0);
+        }
+
+        // The quantization runs on its own compute stream, which has to wait for the gradients on the main one.
+        std::unique_ptr<MatrixComputeStreamEvent> mainStreamSyncEvent(MatrixComputeStreamEvent::Create(deviceId));
+        mainStreamSyncEvent->SynchronizeQuantizationComputeStreamWithEvent<ElemType>();
+        if (showSyncPerfStats)
+        {
+            mainStreamSyncEvent->SynchronizeEvent();
+            aggregationTimer.Start();
+        }
+
+        this->AllGatherHeaders(headerCPU, m_headers);
+
+        m_gradientChunks.clear();
+        for (const auto& chunk : m_chunks)
+            m_gradientChunks.push_back(std::make_unique<Matrix<ElemType>>(gradients[chunk.gradient]->ColumnSlice(chunk.firstColumn, chunk.numColumns)));
+        if (adapt)
+        {
+            m_squaredGradientNorms.assign(gradients.size(), 0);
+            m_squaredResidualNorms.assign(gradients.size(), 0);
+        }
+
+        // The chunks go through a pipeline: while chunk c is exchanged, c + 1 is quantized and fetched from the GPU,
+        // and c - 1 is copied back and unquantized, on the compute, fetch and assign streams of the quantizers.
+        for (size_t c = 0; c < m_chunks.size() + 2; c++)
+        {
+            if (c < m_chunks.size())
+                StartQuantization(c);
+
+            MPI_Request request = MPI_REQUEST_NULL;
+            if (c >= 1 && c - 1 < m_chunks.size())
+            {
+                FinishQuantization(c - 1, adapt);
+                const Chunk& chunk = m_chunks[c - 1];
+                MPI_Iallgather(MPI_IN_PLACE, 0, MPI_DATATYPE_NULL, m_buffer.data() + chunk.offset, (int) chunk.bytesPerWorker, MPI_CHAR, m_mpi->Communicator(), &request)
+                    || MpiFail("MPI_Iallgather");
+            }
+
+            if (c >= 2)
+                Unquantize(c - 2);
+
+            if (request != MPI_REQUEST_NULL)
+                m_mpi->Wait(&request);
+        }
+        m_gradientChunks.clear();
+
+        size_t bytesSent = m_bytesPerWorker;
+        m_bytesSentInEpoch += bytesSent;
+        m_entriesSentInEpoch += m_numElementsInTotal;
+
+        if (adapt)
+        {
+            for (size_t i = 0; i < gradients.size(); i++)
+                m_errors[i] = m_squaredGradientNorms[i] > 0 ? sqrt(m_squaredResidualNorms[i] / m_squaredGradientNorms[i]) : 0;
+            AdaptBits();
+        }
+
+        if (showSyncPerfStats)
+        {
+            aggregationTimer.Stop();
+            fprintf(stderr, "Quantized gradient aggregation: sent %d bytes for %d gradient entries in %d chunks (%.3g bits per entry), %.6g seconds\n",
+                    (int) bytesSent, (int) m_numElementsInTotal, (int) m_chunks.size(), m_numElementsInTotal == 0 ? 0.0 : 8.0 * bytesSent / m_numElementsInTotal, aggregationTimer.ElapsedSeconds());
+        }
+
+        return (headerCPU->numSamples != 0);
+    }
+
+    void OnEpochEnd() override
+    {
+        if (m_entriesSentInEpoch == 0)
+            return;
+
+        std::map<size_t, size_t> numGradientsByBits;
+        for (size_t i = 0; i < m_bits.size(); i++)
+        {
+            if (m_numElements[i] > 0)
+                numGradientsByBits[m_bits[i]]++;
+        }
+        std::string distribution;
+        for (auto& count : numGradientsByBits)
+            distribution += msra::strfun::strprintf(" %d with %d bits;", (int) count.second, (int) count.first);
+
+        fprintf(stderr, "Quantized gradient aggregation: %.3g bits per gradient entry in this epoch, %.4g MB sent by each worker; gradients now quantized:%s\n",
+                8.0 * m_bytesSentInEpoch / m_entriesSentInEpoch, m_bytesSentInEpoch / (1024.0 * 1024.0), distribution.c_str());
+        m_bytesSentInEpoch = 0;
+        m_entriesSentInEpoch = 0;
+    }
+
+private:
+    // Places the quantized matrices one after the other in a buffer.
+    class BufferAllocator : public MemAllocator
+    {
+    public:
+        void Reset(char* buffer)
+        {
+            m_next = buffer;
+        }
+        void* Malloc(size_t size) override
+        {
+            char* p = m_next;
+            m_next += size;
+            return p;
+        }
+        void Free(void*) override
+        {
+        }
+
+    private:
+        char* m_next = nullptr;
+    };
+
+    // (re)creates the residuals at zero, once per epoch, and the chunks and buffers if the gradients changed
+    void ResetState(const std::vector<Matrix<ElemType>*>& gradients, bool resetState)
+    {
+        bool matching = !m_quantized.empty() && m_residuals.size() == gradients.size();
+        for (size_t i = 0; matching && i < gradients.size(); i++)
+        {
+            matching = m_residuals[i]->GetNumRows() == gradients[i]->GetNumRows() && m_residuals[i]->GetNumCols() == gradients[i]->GetNumCols() &&
+                       m_residuals[i]->GetDeviceId() == gradients[i]->GetDeviceId();
+        }
+        if (matching)
+        {
+            if (resetState)
+            {
+                for (auto& residual : m_residuals)
+                    residual->SetValue(0);
+            }
+            return;
+        }
+
+        m_chunks.clear();
+        m_residualChunks.clear();
+        m_quantizers.clear();
+        m_residuals.clear();
+        m_numElements.clear();
+        m_numElementsInTotal = 0;
+        for (size_t i = 0; i < gradients.size(); i++)
+        {
+            Matrix<ElemType>* gradient = gradients[i];
+            m_residuals.push_back(std::make_unique<Matrix<ElemType>>(gradient->GetNumRows(), gradient->GetNumCols(), gradient->GetDeviceId()));
+            m_residuals.back()->SetValue(0);
+            m_numElements.push_back(gradient->GetNumElements());
+            m_numElementsInTotal += gradient->GetNumElements();
+
+            // large gradients are split into chunks of whole columns, as the quantization is per column
+            if (gradient->GetNumElements() == 0)
+                continue;
+            size_t columnsPerChunk = std::max<size_t>(1, ChunkSizeInElements / gradient->GetNumRows());
+            for (size_t firstColumn = 0; firstColumn < gradient->GetNumCols(); firstColumn += columnsPerChunk)
+            {
+                Chunk chunk;
+                chunk.gradient = i;
+                chunk.firstColumn = firstColumn;
+                chunk.numColumns = std::min(columnsPerChunk, gradient->GetNumCols() - firstColumn);
+                m_chunks.push_back(chunk);
+                m_residualChunks.push_back(std::make_unique<Matrix<ElemType>>(m_residuals[i]->ColumnSlice(chunk.firstColumn, chunk.numColumns)));
+                // each chunk has its own quantizer, with its own events and GPU buffer, so that chunks can be in flight together
+                m_quantizers.push_back(std::unique_ptr<MatrixQuantizerImpl<ElemType>>(MatrixQuantizerImpl<ElemType>::Create(gradient->GetDeviceId(), /*useAsync=*/true)));
+            }
+        }
+        m_bits.assign(gradients.size(), m_initialNumBits);
+        m_errors.assign(gradients.size(), 0);
+        PrepareBuffers();
+    }
+
+    // lays out the quantized chunks in the buffer, for the current bits: chunk after chunk, and the workers one after the other
+    // within a chunk, so that each chunk is exchanged with its own MPI_Iallgather
+    void PrepareBuffers()
+    {
+        m_bytesPerWorker = 0;
+        size_t offset = 0;
+        for (auto& chunk : m_chunks)
+        {
+            chunk.bytesPerWorker = QuantizedColumn<ElemType>::QuantizedColumnSize(m_bits[chunk.gradient], m_residuals[chunk.gradient]->GetNumRows()) * chunk.numColumns;
+            if (chunk.bytesPerWorker > INT_MAX)
+                RuntimeError("QuantizedDistGradAggregator: A quantized gradient chunk (%d MB) is too large to be exchanged in one MPI_Iallgather.", (int) (chunk.bytesPerWorker / (1024 * 1024)));
+            chunk.offset = offset;
+            offset += chunk.bytesPerWorker * NumProc();
+            m_bytesPerWorker += chunk.bytesPerWorker;
+        }
+
+        m_quantized.clear();
+        m_buffer.resize(offset);
+        m_allocator.Reset(m_buffer.data());
+        m_quantized.resize(NumProc());
+        for (size_t j = 0; j < NumProc(); j++)
+            m_quantized[j].resize(m_chunks.size());
+        for (size_t c = 0; c < m_chunks.size(); c++)
+        {
+            const Chunk& chunk = m_chunks[c];
+            for (size_t j = 0; j < NumProc(); j++)
+                m_quantized[j][c] = std::make_unique<QuantizedMatrix<ElemType>>(m_residuals[chunk.gradient]->GetNumRows(), chunk.numColumns, m_bits[chunk.gradient], CPUDEVICE, &m_allocator);
+        }
+    }
+
+    // quantizes chunk c into our part of the buffer
+    void StartQuantization(size_t c)
+    {
+        m_quantizers[c]->QuantizeAsync(*m_gradientChunks[c], *m_residualChunks[c], *m_quantized[MyRank()][c], *m_residualChunks[c], m_zeroThresholdFor1Bit);
+    }
+
+    void FinishQuantization(size_t c, bool measureError)
+    {
+        m_quantizers[c]->WaitQuantizeAsyncDone();
+        if (measureError)
+        {
+            double gradientNorm = m_gradientChunks[c]->FrobeniusNorm();
+            double residualNorm = m_residualChunks[c]->FrobeniusNorm();
+            m_squaredGradientNorms[m_chunks[c].gradient] += gradientNorm * gradientNorm;
+            m_squaredResidualNorms[m_chunks[c].gradient] += residualNorm * residualNorm;
+        }
+    }
+
+    // The quantizer of a chunk unquantizes through one buffer on the GPU, so we wait for each worker before the next one.
+    void Unquantize(size_t c)
+    {
+        for (size_t j = 0; j < NumProc(); j++)
+        {
+            m_quantizers[c]->UnquantizeAsync(*m_quantized[j][c], *m_gradientChunks[c], /*add=*/j > 0);
+            m_quantizers[c]->WaitUnquantizeAsyncDone();
+        }
+    }
+
+    // chooses the bits for the next aggregations from the errors of all workers
+    void AdaptBits()
+    {
+        m_mpi->AllReduce(m_errors);
+        for (auto& error : m_errors)
+            error /= NumProc();
+
+        std::vector<int> bits(m_bits.size());
+        if (m_mpi->IsMainNode())
+        {
+            auto allocated = m_bitAllocator->Allocate(m_numElements, m_bits, m_errors);
+            for (size_t i = 0; i < bits.size(); i++)
+                bits[i] = (int) allocated[i];
+        }
+        m_mpi->Bcast(bits.data(), bits.size(), m_mpi->MainNodeRank());
+
+        bool changed = false;
+        for (size_t i = 0; i < bits.size(); i++)
+        {
+            changed = changed || m_bits[i] != (size_t) bits[i];
+            m_bits[i] = (size_t) bits[i];
+        }
+        if (changed)
+            PrepareBuffers();
+    }
+
+    const size_t m_initialNumBits;
+    std::shared_ptr<QuantizationBitAllocator> m_bitAllocator;
+    const bool m_zeroThresholdFor1Bit;
+
+    struct Chunk
+    {
+        size_t gradient;
+        size_t firstColumn;
+        size_t numColumns;
+        size_t offset;         // in m_buffer, of the chunk of the first worker
+        size_t bytesPerWorker;
+    };
+
+    std::vector<std::unique_ptr<Matrix<ElemType>>> m_residuals;
+    std::vector<size_t> m_numElements;               // [i] of gradient i
+    size_t m_numElementsInTotal;
+    std::vector<size_t> m_bits;                      // [i] of gradient i
+    std::vector<double> m_errors;                    // [i] norm of the residual of gradient i relative to that of the gradient
+    std::vector<double> m_squaredGradientNorms;      // [i] of gradient i, summed over its chunks
+    std::vector<double> m_squaredResidualNorms;      // [i] of the residual of gradient i
+
+    std::vector<Chunk> m_chunks;                     // [c] the columns of a gradient
+    std::vector<std::unique_ptr<Matrix<ElemType>>> m_residualChunks;                  // [c] view of the residual of chunk c
+    std::vector<std::unique_ptr<Matrix<ElemType>>> m_gradientChunks;                  // [c] view of the gradient, during AggregateGradients()
+    std::vector<std::unique_ptr<MatrixQuantizerImpl<ElemType>>> m_quantizers;        // [c] of chunk c
+
+    // the quantized chunks of all workers: m_quantized[j][c] holds chunk c of worker j
+    std::vector<char> m_buffer;
+    size_t m_bytesPerWorker;
+    BufferAllocator m_allocator; // must outlive m_quantized
+    std::vector<std::vector<std::unique_ptr<QuantizedMatrix<ElemType>>>> m_quantized;
+    std::vector<char> m_headers;
+
+    int m_syncStatsTrace;
+    size_t m_iterationCount;
+    size_t m_bytesSentInEpoch;
+    size_t m_entriesSentInEpoch;
+};
+
+} } }
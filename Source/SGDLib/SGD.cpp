@@ -16,6 +16,8 @@
 #include "MatrixQuantizerImpl.h"
 #include "InputAndParamNodes.h"
 #include "AccumulatorAggregation.h"
+#include "PreComputeNodes.h"
+#include "InputStatistics.h"
 
 #ifdef CNTK_PARALLEL_TRAINING_SUPPORT
 //static inline bool operator==(const std::pair<double,size_t>& a, double b) { assert(b==0); return a.first == b; }
@@ -29,11 +31,23 @@
 #include "ASGDHelper.h"
 
 #include "SimpleDistGradAggregator.h"
+#include "ParameterBroadcaster.h"
+#include "SparseDistGradAggregator.h"
+#include "QuantizedDistGradAggregator.h"
 #include "V2SimpleDistGradAggregator.h"
 #include "ProgressTracing.h"
+#include "TimelineTracer.h"
+#include "Telemetry.h"
+#include "GPUWatcher.h"
+#include "BestGpu.h"
+#include "ComputationNodeProfiler.h"
+#include "MatrixTransitionTracker.h"
 
 #include <map>
 #include <set>
+#ifndef _WIN32
+#include <sys/resource.h>
+#endif
 
 namespace Microsoft { namespace MSR { namespace CNTK {
 
@@ -64,9 +78,6 @@ void SGD<ElemType>::Train(shared_ptr<ComputationNetwork> net, DEVICEID_TYPE devi
     else
         fprintf(stderr, "GPU %d.\n", (int) net->GetDeviceId());
 
-    // TODO: BUGBUG: if not starting from checkpoint, need to synchronize initial model
-    // strategy should be to run the initializer above on mpiRank==0, and then broadcast parameters.
-
     startEpoch = max(startEpoch, 0);
     m_needAdaptRegularization = false;
 
@@ -144,6 +155,30 @@ void SGD<ElemType>::TrainOrAdaptModel(int startEpoch, ComputationNetworkPtr net,
                                       IDataReader* trainSetDataReader,
                                       IDataReader* validationSetDataReader)
 {
+    // pipeline parallelism: train a copy of the network that is split into stages on several GPUs
+    if (!m_pipelineStageNodeNames.empty() || !m_pipelineDeviceIds.empty())
+    {
+        bool searches = m_autoLearnRateSearchType != LearningRateSearchAlgorithm::None || m_autoAdjustMinibatch || m_autoAdjustMinibatchByThroughput;
+        if (m_mpi != nullptr || (m_needAdaptRegularization && m_adaptationRegType == AdaptationRegType::KL) || m_doGradientCheck || searches ||
+            m_numGradientAccumulationSteps > 1 || m_maxSamplesInRAM < SIZE_MAX ||
+            m_activationCheckpointInterval > 0 || !m_activationCheckpointNodeNames.empty() ||
+            m_activationOffloadMinSampleSize > 0 || !m_activationOffloadNodeNames.empty())
+            InvalidArgument("Pipeline parallelism cannot be combined with parallel training, KL adaptation, gradient checks, learning-rate or minibatch-size searches, "
+                            "gradient accumulation, maxSamplesInRAM, or activation checkpointing or offloading.");
+        let& trainCriterionNodes = GetTrainCriterionNodes(net);
+        if (trainCriterionNodes.empty())
+            InvalidArgument("TrainOrAdaptModel: No criterion node was specified.");
+        net = ComputationNetwork::CreatePipelined<ElemType>(net, m_pipelineStageNodeNames, m_pipelineDeviceIds, trainCriterionNodes.front(),
+                                                            GetEvalCriterionNodes(net), m_modelPath + L".pipeline.tmp");
+        net->EnableNodeTracing(m_traceNodeNamesReal, m_traceNodeNamesCategory, m_traceNodeNamesSparse);
+        if (m_numSubminiBatches < 2)
+        {
+            m_numSubminiBatches = net->GetNumPipelineStages();
+            if (m_traceLevel > 0)
+                LOGPRINTF(stderr, "Pipeline parallelism: \"numSubminibatches\" is not specified, using %d micro-batches, one per stage.\n", (int) m_numSubminiBatches);
+        }
+    }
+
     let& criterionNodes = GetTrainCriterionNodes(net);
 
     fprintf(stderr, "\n");
@@ -165,6 +200,18 @@ void SGD<ElemType>::TrainOrAdaptModel(int startEpoch, ComputationNetworkPtr net,
         }
     }
 
+    if (m_mixedPrecision)
+    {
+        if (!std::is_same<ElemType, float>::value)
+            fprintf(stderr, "WARNING: mixedPrecision only applies to models of precision 'float', and is ignored.\n");
+        else
+        {
+            EnableHalfPrecisionGEMM(true);
+            if (m_traceLevel > 0)
+                LOGPRINTF(stderr, "Mixed-precision training: products in half precision, loss scale %g%s.\n", m_lossScale, m_dynamicLossScaling ? " (dynamic)" : "");
+        }
+    }
+
     // This code is only relevant for the new (V2) readers. It exist because of
     // a shortcoming in DecimateMinibatchInPlace, which does not yet work when inputs 
     // in the same minibatch have different layouts, which is something only V2 readers can
@@ -213,6 +260,35 @@ void SGD<ElemType>::TrainOrAdaptModel(int startEpoch, ComputationNetworkPtr net,
     additionalNodesToEvaluate.insert(additionalNodesToEvaluate.end(), preComputeNodesList.cbegin(), preComputeNodesList.cend());
 
     // allocate memory for forward and backward computation
+    if (m_activationCheckpointInterval > 0 || !m_activationCheckpointNodeNames.empty())
+        net->SetActivationCheckpoints(m_activationCheckpointInterval, m_activationCheckpointNodeNames);
+    if (m_activationOffloadMinSampleSize > 0 || !m_activationOffloadNodeNames.empty())
+        net->SetActivationOffloading(m_activationOffloadMinSampleSize, m_activationOffloadNodeNames);
+    if (m_inPlaceActivations)
+        net->EnableInPlaceExecution(true);
+    if (m_eliminateRowStack)
+        net->EnableRowStackElimination(true);
+    if (m_absorbTranspose)
+        net->EnableTransposeAbsorption(true);
+    if (m_useCounterBasedDropout)
+        ComputationNetwork::SetCounterBasedDropout<ElemType>(net, criterionNodes[0], true);
+    if (m_numGradientAccumulationSteps > 1)
+        net->EnableParameterGradientAccumulation(true);
+    // all workers start from the model of the main node, which may be the only one that loaded it (see DoTrain())
+    if (m_mpi != nullptr && m_mpi->NumNodesInUse() > 1)
+        BroadcastModel(net);
+    // model parallelism: the parameters of row-sharded nodes are distributed over the workers
+    if (m_mpi != nullptr)
+    {
+        net->ShardParameterRows(m_mpi);
+        bool searches = m_autoLearnRateSearchType != LearningRateSearchAlgorithm::None || m_autoAdjustMinibatch || m_autoAdjustMinibatchByThroughput;
+        if (net->HasRowShardedParameters() &&
+            (GetParallelizationMethod() != ParallelizationMethod::dataParallelSGD || m_parallelizationStartEpochNum > 0 || searches ||
+             m_numGradientAccumulationSteps > 1 || m_numSubminiBatches > 1 || m_maxSamplesInRAM < SIZE_MAX ||
+             m_intraEpochCheckPointSamples > 0 || m_intraEpochCheckPointMinutes > 0))
+            InvalidArgument("Row-sharded parameters require DataParallelSGD from the first epoch, and cannot be combined with learning-rate or minibatch-size searches, "
+                            "gradient accumulation, sub-minibatches, or intra-epoch checkpoints.");
+    }
     net->AllocateAllMatrices(evaluationNodes, additionalNodesToEvaluate, criterionNodes[0]); // TODO: use criterionNodes.front() throughout
 
     // get feature and label nodes into an array of matrices that will be passed to GetMinibatch()
@@ -280,7 +356,7 @@ void SGD<ElemType>::TrainOrAdaptModel(int startEpoch, ComputationNetworkPtr net,
         // V2 API fixes this.
         smoothedGradients.push_back(Matrix<ElemType>(node->Value().GetNumRows(),
                                                      node->Value().GetNumCols(),
-                                                     net->GetDeviceId()));
+                                                     node->GetDeviceId())); // (pipelined: the GPU of its stage)
         smoothedCounts.push_back(0);
         if (node->IsParameterUpdateRequired())
         {
@@ -356,8 +432,10 @@ void SGD<ElemType>::TrainOrAdaptModel(int startEpoch, ComputationNetworkPtr net,
 
         // In case of parallel training only the main node should we saving the model to prevent
         // the parallel training nodes from colliding to write the same file
+        net->GatherRowShardedParameters();
         if ((m_mpi == nullptr) || m_mpi->IsMainNode())
             net->Save(GetModelNameForEpoch(int(startEpoch) - 1));
+        net->RestoreRowShardedParameters();
     }
 
     size_t totalTrainingSamplesSeen = 0; // aggregated over all epochs, for logging purposes only
@@ -375,6 +453,42 @@ void SGD<ElemType>::TrainOrAdaptModel(int startEpoch, ComputationNetworkPtr net,
                                                      /*out*/ m_prevChosenMinibatchSize);
         if (learnRateInitialized)
             prevLearnRates[startEpoch % m_numPrevLearnRates] = learnRatePerSample;
+
+        // the checkpoint holds the main node's shards only
+        auto smoothedGradientIter = smoothedGradients.begin();
+        for (auto nodeIter = learnableNodes.begin(); nodeIter != learnableNodes.end(); nodeIter++, smoothedGradientIter++)
+        {
+            if (net->IsRowShardedParameter(*nodeIter))
+            {
+                const auto& value = dynamic_pointer_cast<ComputationNode<ElemType>>(*nodeIter)->Value();
+                smoothedGradientIter->Resize(value.GetNumRows(), value.GetNumCols());
+                smoothedGradientIter->SetValue(0);
+            }
+        }
+    }
+
+    if (m_intraEpochCheckPointSamples > 0 || m_intraEpochCheckPointMinutes > 0)
+    {
+        // Model averaging and ASGD keep state outside of the model and checkpoint info, legacy readers cannot seek,
+        // and the searches before an epoch would train from the model of the previous epoch instead.
+        bool searchesBeforeEpoch = m_autoLearnRateSearchType == LearningRateSearchAlgorithm::SearchBeforeEpoch || m_autoAdjustMinibatch || m_autoAdjustMinibatchByThroughput;
+        if (m_pMASGDHelper || GetParallelizationMethod() == ParallelizationMethod::dataParallelASGD || trainSetDataReader->IsLegacyReader() || searchesBeforeEpoch)
+        {
+            LOGPRINTF(stderr, "Warning: Intra-epoch checkpoints are not supported with model averaging, ASGD, legacy readers, or learning-rate or minibatch-size searches. They are disabled.\n");
+            m_intraEpochCheckPointSamples = 0;
+            m_intraEpochCheckPointMinutes = 0;
+        }
+        else if (TryLoadIntraEpochCheckPoint(net, startEpoch,
+                                             /*out*/ totalTrainingSamplesSeen,
+                                             /*out*/ learnRatePerSample,
+                                             smoothedGradients,
+                                             smoothedCounts,
+                                             /*out*/ prevCriterion,
+                                             /*out*/ m_prevChosenMinibatchSize))
+        {
+            learnRateInitialized = true;
+            prevLearnRates[startEpoch % m_numPrevLearnRates] = learnRatePerSample;
+        }
     }
 
     if (m_autoLearnRateSearchType == LearningRateSearchAlgorithm::AdjustAfterEpoch &&
@@ -403,7 +517,8 @@ void SGD<ElemType>::TrainOrAdaptModel(int startEpoch, ComputationNetworkPtr net,
     if (isSequenceTrainingCriterion)
     {
         ComputationNetwork::SetSeqParam<ElemType>(net, criterionNodes[0], m_hSmoothingWeight, m_frameDropThresh, m_doReferenceAlign,
-                                                  m_seqGammarCalcAMF, m_seqGammarCalcLMF, m_seqGammarCalcWP, m_seqGammarCalcbMMIFactor, m_seqGammarCalcUsesMBR);
+                                                  m_seqGammarCalcAMF, m_seqGammarCalcLMF, m_seqGammarCalcWP, m_seqGammarCalcbMMIFactor, m_seqGammarCalcUsesMBR,
+                                                  m_seqLatticeCacheMB);
     }
 
     // Multiverso Warpper for ASGD logic init
@@ -417,10 +532,44 @@ void SGD<ElemType>::TrainOrAdaptModel(int startEpoch, ComputationNetworkPtr net,
                                          m_adjustCoefficient,
                                          m_adjustPerMinibatches,
                                          m_traceLevel,
-                                         m_syncStatsTrace));
+                                         m_syncStatsTrace,
+                                         m_asgdSparseSyncMinColumns,
+                                         m_asgdSparseSyncFullPullPeriod,
+                                         m_asgdStalenessBound,
+                                         m_asgdAdaptiveStaleness,
+                                         m_asgdMaxStalenessBound));
         m_pASGDHelper->InitModel(learnableNodes);
     }
 
+    // each worker writes its own file, keeping the extension (the textfile collector of node_exporter wants .prom)
+    auto perRankFile = [this](wstring path)
+    {
+        if (!path.empty() && m_mpi != nullptr && m_mpi->NumNodesInUse() > 1)
+        {
+            auto extension = path.find_last_of(L'.');
+            if (extension == wstring::npos || path.find_first_of(L"/\\", extension) != wstring::npos)
+                extension = path.size();
+            path.insert(extension, msra::strfun::wstrprintf(L".rank%d", (int) m_mpi->CurrentNodeRank()));
+        }
+        return path;
+    };
+
+    // sampling of device memory and utilization, the matrix pool and the reader queue in the background
+    if (m_telemetryPeriod > 0)
+    {
+        if (net->GetDeviceId() >= 0)
+        {
+            GPUWatcher::AddTelemetryGauges(net->GetDeviceId());
+            AddNvmlTelemetryGauges(net->GetDeviceId());
+        }
+        Telemetry::Start(m_telemetryPeriod, m_telemetryToLog, perRankFile(m_telemetryFile));
+    }
+    auto stopTelemetry = MakeScopeExit(&Telemetry::Stop);
+
+    // structured progress of each log interval and epoch (unless the caller installed its own writer)
+    if (!m_metricsWriter && !m_metricsFile.empty())
+        m_metricsWriter = make_shared<JsonLinesTrainingMetricsWriter>(perRankFile(m_metricsFile));
+
     // --- MAIN EPOCH LOOP
     for (int i = startEpoch; i < (int) m_maxEpochs; i++) // TODO: why is this an int, and not a size_t?
     {
@@ -492,6 +641,20 @@ void SGD<ElemType>::TrainOrAdaptModel(int startEpoch, ComputationNetworkPtr net,
             break;
         }
 
+        // Once at start-up, pick the minibatch size the hardware processes most efficiently. It replaces the
+        // configured minibatch sizes of all epochs; the learning rates per sample are not affected by that.
+        if (m_autoAdjustMinibatchByThroughput && i == startEpoch)
+        {
+            m_throughputChosenMinibatchSize = SearchForFastestMinibatchSize(net, refNet, refNode, i,
+                                                                            trainSetDataReader, learnRatePerSample,
+                                                                            m_mbSize[i], featureNodes, labelNodes,
+                                                                            criterionNodes, evaluationNodes,
+                                                                            inputMatrices, learnableNodes,
+                                                                            smoothedGradients, smoothedCounts);
+            m_prevChosenMinibatchSize = m_throughputChosenMinibatchSize;
+        }
+        size_t configuredMinibatchSize = m_throughputChosenMinibatchSize != 0 ? m_throughputChosenMinibatchSize : m_mbSize[i];
+
         size_t chosenMinibatchSize;
         size_t actualMinibatchSize;
 
@@ -512,7 +675,7 @@ void SGD<ElemType>::TrainOrAdaptModel(int startEpoch, ComputationNetworkPtr net,
             chosenMinibatchSize = AdaptiveMinibatchSizing(net, refNet, refNode, i,
                                                           numFramesToUseInSearch,
                                                           trainSetDataReader, learnRatePerSample,
-                                                          m_mbSize[i], featureNodes, labelNodes,
+                                                          configuredMinibatchSize, featureNodes, labelNodes,
                                                           criterionNodes, evaluationNodes,
                                                           inputMatrices, learnableNodes,
                                                           smoothedGradients, smoothedCounts, learningRateAdjustmentFactor);
@@ -523,7 +686,7 @@ void SGD<ElemType>::TrainOrAdaptModel(int startEpoch, ComputationNetworkPtr net,
         else
         {
             // use the explicitly set minibatch size
-            chosenMinibatchSize = m_mbSize[i];
+            chosenMinibatchSize = configuredMinibatchSize;
         }
 
         // For legacy readers, in BPTT mode the minibatch size was not the real minibatch size but truncation.
@@ -548,6 +711,9 @@ void SGD<ElemType>::TrainOrAdaptModel(int startEpoch, ComputationNetworkPtr net,
                       i + 1, learnRatePerSample, MomentumPerMB(momentumPerSample, actualMinibatchSize), momentumAsTimeConstant);
         }
 
+        m_samplesSeenBeforeEpoch = totalTrainingSamplesSeen;
+        m_prevCriterionBeforeEpoch = prevCriterion;
+
         EpochCriterion epochCriterion; // criterion values are returned in this
         std::vector<EpochCriterion> epochEvalErrors(evaluationNodes.size());
         TrainOneEpoch(net,
@@ -582,6 +748,19 @@ void SGD<ElemType>::TrainOrAdaptModel(int startEpoch, ComputationNetworkPtr net,
         for (size_t j = 0; j < epochEvalErrors.size(); j++)
             epochEvalErrors[j].LogCriterion(evaluationNodes[j]->NodeName());
         fprintf(stderr, "totalSamplesSeen = %d; learningRatePerSample = %.8g; epochTime=%.6gs\n", (int)totalTrainingSamplesSeen, learnRatePerSample, epochTime);
+        if (net->IsActivationOffloadingEnabled())
+        {
+            auto offloadStatistics = net->CollectActivationOffloadStatistics();
+            LOGPRINTF(stderr, "Finished Epoch[%2d of %d]: Activation offloading: %d copies, %.1f MB to host, %.1f MB back; compute stream stalled %.3gs\n",
+                      i + 1, (int)m_maxEpochs, (int)offloadStatistics.m_numOffloads, offloadStatistics.m_bytesOffloaded / (1024.0 * 1024.0),
+                      offloadStatistics.m_bytesPrefetched / (1024.0 * 1024.0), offloadStatistics.m_stallSeconds);
+        }
+        if (MatrixTransitionTracker::IsEnabled())
+        {
+            LOGPRINTF(stderr, "Finished Epoch[%2d of %d]: ", i + 1, (int)m_maxEpochs);
+            MatrixTransitionTracker::LogSummary(stderr);
+            MatrixTransitionTracker::Reset();
+        }
 #if 0
         // TODO: This was only printed if >1 eval criterion. Why? Needed?
         LOGPRINTF(stderr, "Finished Epoch[%2d of %d]:     Criterion Node [%ls] Per Sample = %.8g\n",
@@ -661,6 +840,7 @@ void SGD<ElemType>::TrainOrAdaptModel(int startEpoch, ComputationNetworkPtr net,
                     // roll back
                     auto bestModelPath = GetModelNameForEpoch(i - m_learnRateAdjustInterval);
                     LOGPRINTF(stderr, "Loading (rolling back to) previous model with best training-criterion value: %ls.\n", bestModelPath.c_str());
+                    WaitForCheckPointSave();
                     net->RereadPersistableParameters<ElemType>(bestModelPath);
                     LoadCheckPointInfo(i - m_learnRateAdjustInterval,
                                        /*out*/ totalTrainingSamplesSeen,
@@ -738,8 +918,10 @@ void SGD<ElemType>::TrainOrAdaptModel(int startEpoch, ComputationNetworkPtr net,
         SynchronizeWorkers();
 
         // Persist model and check-point info
+        net->GatherRowShardedParameters();
         if ((m_mpi == nullptr) || m_mpi->IsMainNode())
         {
+            WaitForCheckPointSave(); // the files of the previous epochs may be deleted or rewritten below
             if (loadedPrevModel)
             {
                 // If previous best model is loaded, we will first remove epochs that lead to worse results
@@ -751,6 +933,8 @@ void SGD<ElemType>::TrainOrAdaptModel(int startEpoch, ComputationNetworkPtr net,
                     _wunlink(GetCheckPointFileNameForEpoch(epochToDelete).c_str());
                 }
 
+                RemoveIntraEpochCheckPoint(i);
+
                 // Set i back to the loaded model
                 i -= m_learnRateAdjustInterval;
                 LOGPRINTF(stderr, "SGD: revoke back to and update checkpoint file for epoch %d\n", i+1); // report 1 based epoch number
@@ -758,11 +942,19 @@ void SGD<ElemType>::TrainOrAdaptModel(int startEpoch, ComputationNetworkPtr net,
             }
             else
             {
-                SaveCheckPointInfo(i, totalTrainingSamplesSeen, learnRatePerSample, smoothedGradients, smoothedCounts, prevCriterion, chosenMinibatchSize);
                 auto modelName = GetModelNameForEpoch(i);
+                // the model-averaging helpers write their state from the live model, so they save synchronously
+                bool inBackground = m_asyncCheckPointSave && !m_pMASGDHelper;
                 if (m_traceLevel > 0)
-                    LOGPRINTF(stderr, "SGD: Saving checkpoint model '%ls'\n", modelName.c_str());
-                net->Save(modelName);
+                    LOGPRINTF(stderr, "SGD: Saving checkpoint model '%ls'%s\n", modelName.c_str(), inBackground ? " in the background" : "");
+                if (inBackground)
+                    SaveCheckPointInBackground(net, modelName, i, totalTrainingSamplesSeen, learnRatePerSample, smoothedGradients, smoothedCounts, prevCriterion, chosenMinibatchSize);
+                else
+                {
+                    SaveCheckPointInfo(i, totalTrainingSamplesSeen, learnRatePerSample, smoothedGradients, smoothedCounts, prevCriterion, chosenMinibatchSize);
+                    net->Save(modelName);
+                    RemoveIntraEpochCheckPoint(i);
+                }
                 if (!m_keepCheckPointFiles)
                 {
                     // delete previous checkpoint file to save space
@@ -792,6 +984,7 @@ void SGD<ElemType>::TrainOrAdaptModel(int startEpoch, ComputationNetworkPtr net,
                 i -= m_learnRateAdjustInterval;
             }
         }
+        net->RestoreRowShardedParameters();
 
         if (learnRatePerSample < 1e-12)
         {
@@ -801,9 +994,13 @@ void SGD<ElemType>::TrainOrAdaptModel(int startEpoch, ComputationNetworkPtr net,
     }
     // --- END OF MAIN EPOCH LOOP
 
+    WaitForCheckPointSave();
+
     // Synchronize all ranks before proceeding to ensure that
     // rank 0 has finished writing the model file
     // TODO[DataASGD]: should othet other rank waiting in async-mode
+    if (m_parallelizationMethod == ParallelizationMethod::dataParallelASGD)
+        m_pASGDHelper->FinishTraining();
     SynchronizeWorkers();
 
     // progress tracing for compute cluster management
@@ -825,6 +1022,24 @@ void SGD<ElemType>::TrainOrAdaptModel(int startEpoch, ComputationNetworkPtr net,
         m_pASGDHelper.reset();
 }
 
+// Memory in use, in MB, for the training metrics and the search in SearchForFastestMinibatchSize().
+// On the GPU this is all device memory in use, including the memory cached by the allocator, which CNTK keeps
+// for the largest minibatch seen so far. On the CPU it is the peak resident memory of the process (Linux only).
+static size_t GetUsedMemoryInMBs(DEVICEID_TYPE deviceId)
+{
+    if (deviceId >= 0)
+    {
+        auto freeAndTotalMemory = TracingGPUMemoryAllocator::GetFreeAndTotalMemoryInMBs(deviceId);
+        return freeAndTotalMemory.second - freeAndTotalMemory.first;
+    }
+#ifndef _WIN32
+    struct rusage usage;
+    if (getrusage(RUSAGE_SELF, &usage) == 0)
+        return (size_t) usage.ru_maxrss / 1024; // in KB
+#endif
+    return 0;
+}
+
 // -----------------------------------------------------------------------
 // TrainOneEpoch() -- train one epoch
 // -----------------------------------------------------------------------
@@ -864,6 +1079,13 @@ size_t SGD<ElemType>::TrainOneEpoch(ComputationNetworkPtr net,
     int numMBsRun = 0;
     int numMBsRunSinceLastLogged = 0;
 
+    // structured progress, see TrainingMetrics (not for the trial mini-epochs of the minibatch size searches, which have a prefix)
+    bool writeMetrics = m_metricsWriter && prefixMsg.empty();
+    bool measurePhases = m_perfTraceLevel > 0 || writeMetrics;
+    TrainingMetrics intervalMetrics, epochMetrics; // phase times since last logged and for the whole epoch
+    Timer epochTimer;
+    epochTimer.Start();
+
     bool useGradientAggregation = UsingGradientAggregation(epochNumber);
     bool useModelAggregation = UsingModelAggregation(epochNumber);
     bool useAsyncGradientAggregation = UsingAsyncGradientAggregation(epochNumber);
@@ -887,22 +1109,54 @@ size_t SGD<ElemType>::TrainOneEpoch(ComputationNetworkPtr net,
 
     std::vector<Matrix<ElemType>*> learnParamsGradients;
     Profiler profiler(m_numMBsToCUDAProfile);
+    // each worker writes its own timeline
+    wstring timelineTraceFile = m_timelineTraceFile;
+    if (!timelineTraceFile.empty() && m_mpi != nullptr && m_mpi->NumNodesInUse() > 1)
+        timelineTraceFile += msra::strfun::wstrprintf(L".rank%d", (int) m_mpi->CurrentNodeRank());
+    Profiler timelineProfiler(m_numMBsToTrace, timelineTraceFile);
+
+    // node profiling synchronizes the device around every node, so it is done for the first minibatches only
+    size_t numMBsToProfileNodes = m_numMBsToProfileNodes;
+    if (numMBsToProfileNodes > 0)
+        net->Environment().nodeProfiler = make_shared<ComputationNodeProfiler>(net->GetDeviceId());
 
     // resetting this, so profiling is performed for one epoch only
     m_numMBsToCUDAProfile = 0;
+    m_numMBsToTrace = 0;
+    m_numMBsToProfileNodes = 0;
 
     bool useDistributedMBReading = useParallelTrain &&
                                    m_enableDistributedMBReading &&
                                    trainSetDataReader->SupportsDistributedMBRead();
+
+    // with gradient accumulation, the reader delivers the minibatch in m_numGradientAccumulationSteps parts
+    size_t readerMBSize = (tunedMBSize + m_numGradientAccumulationSteps - 1) / m_numGradientAccumulationSteps;
     if (useDistributedMBReading)
     {
-        trainSetDataReader->StartDistributedMinibatchLoop(tunedMBSize, epochNumber, m_mpi->CurrentNodeRank(),
+        trainSetDataReader->StartDistributedMinibatchLoop(readerMBSize, epochNumber, m_mpi->CurrentNodeRank(),
             m_mpi->NumNodesInUse(), inputMatrices->GetStreamDescriptions(), epochSize);
     }
     else
     {
-        trainSetDataReader->StartMinibatchLoop(tunedMBSize, epochNumber, inputMatrices->GetStreamDescriptions(), epochSize);
+        trainSetDataReader->StartMinibatchLoop(readerMBSize, epochNumber, inputMatrices->GetStreamDescriptions(), epochSize);
+    }
+
+    // continue an epoch that was interrupted after an intra-epoch checkpoint
+    // The randomizers derive their state from the position, so the remaining samples come in the same order.
+    // (Not for the searches, which train on the beginning of an epoch.)
+    if (m_intraEpochResumeEpoch == epochNumber && maxNumberOfSamples == SIZE_MAX)
+    {
+        LOGPRINTF(stderr, "Continuing epoch %d after %d samples, at sample position %d.\n",
+                  epochNumber + 1, (int) m_intraEpochResumePosition.m_epochSamples, (int) m_intraEpochResumePosition.m_samplePosition);
+        trainSetDataReader->SetCurrentSamplePosition(m_intraEpochResumePosition.m_samplePosition);
+        totalEpochSamples = m_intraEpochResumePosition.m_epochSamples;
+        m_intraEpochResumeEpoch = -1;
     }
+    // only the main node writes them
+    bool useIntraEpochCheckPoints = (m_intraEpochCheckPointSamples > 0 || m_intraEpochCheckPointMinutes > 0) &&
+                                    maxNumberOfSamples == SIZE_MAX && ((m_mpi == nullptr) || m_mpi->IsMainNode());
+    size_t lastIntraEpochCheckPointSamples = totalEpochSamples;
+    auto lastIntraEpochCheckPointTime = std::chrono::steady_clock::now();
 
     net->StartEvaluateMinibatchLoop(evaluationNodes);
     net->StartEvaluateMinibatchLoop(criterionNodes);
@@ -962,6 +1216,8 @@ size_t SGD<ElemType>::TrainOneEpoch(ComputationNetworkPtr net,
             else
                 fprintf(stderr, ", with %d subminibatch", (int)numSubminibatchesNeeded);
         }
+        if (m_numGradientAccumulationSteps > 1)
+            fprintf(stderr, ", accumulating gradients over %d minibatches of %d", (int)m_numGradientAccumulationSteps, (int)readerMBSize);
         fprintf(stderr, ".\n");
     }
 
@@ -1006,15 +1262,25 @@ size_t SGD<ElemType>::TrainOneEpoch(ComputationNetworkPtr net,
 
     bool noMoreSamplesToProcess = false;
     bool isFirstMinibatch = true;
+
+    // gradient accumulation: minibatches read and backpropagated since the last model update
+    // With distributed reading, updates happen every m_numGradientAccumulationSteps reads on all workers alike,
+    // also on those that ran out of data, so that all workers take part in the same aggregations.
+    size_t numAccumulatedSteps = 0;
+    size_t numAccumulatedSamples = 0;
+    size_t numAccumulatedSamplesWithLabel = 0;
+    bool hasAccumulatedGradients = false;
     for (;;)
     {
-        // Per-minibatch performance measurements; only enabled when perfTraceLevel > 0
+        // Per-minibatch performance measurements; only enabled when perfTraceLevel > 0 or for the training metrics.
+        // Only perfTraceLevel > 0 waits for the GPU at the end of each phase.
         Timer fineGrainedPerfMeasurementTimer;
         double readTime = 0;
         double computeTime = 0;
         double parameterUpdateTime = 0;
+        double aggregationTime = 0;   // part of parameterUpdateTime
         double parameterSyncTime = 0; // perf communication time between syncs.
-        if (m_perfTraceLevel > 0)
+        if (measurePhases)
             fineGrainedPerfMeasurementTimer.Start();
 
         // get minibatch
@@ -1026,10 +1292,11 @@ size_t SGD<ElemType>::TrainOneEpoch(ComputationNetworkPtr net,
         if (maxNumSamplesExceeded) // Dropping data.
             wasDataRead = false;
 
-        if (!wasDataRead && (!useDistributedMBReading || noMoreSamplesToProcess)) // in case of distributed reading, we do a few more loops until all ranks have completed
-            break;                                                                // end of epoch
+        // (a last partial accumulation of gradients is still applied below)
+        if (!wasDataRead && numAccumulatedSteps == 0 && (!useDistributedMBReading || noMoreSamplesToProcess)) // in case of distributed reading, we do a few more loops until all ranks have completed
+            break;                                                                                           // end of epoch
 
-        if (m_perfTraceLevel > 0)
+        if (measurePhases)
         {
             fineGrainedPerfMeasurementTimer.Stop();
             readTime = fineGrainedPerfMeasurementTimer.ElapsedSeconds();
@@ -1085,43 +1352,104 @@ size_t SGD<ElemType>::TrainOneEpoch(ComputationNetworkPtr net,
             // We optionally break the minibatch into sub-minibatches.
             // This, when enabled, is used when a full minibatch does not fit into GPU RAM.
             size_t actualNumSubminibatches = numSubminibatchesNeeded <= 1 ? 1 : smbDispatcher.GetMinibatchIntoCache(*trainSetDataReader, *net, *inputMatrices, numSubminibatchesNeeded);
-            for (size_t ismb = 0; ismb < actualNumSubminibatches; ismb++)
+
+            // pipeline parallelism (ComputationNetwork::CreatePipelined()): the sub-minibatches are the micro-batches.
+            // Forward prop of all of them, then backprop of each, last one first, stage by stage from the last one,
+            // where all but the last micro-batch first recompute the stage. Since the stages are on their own GPUs and
+            // only wait for the values they get from each other, the GPUs work on different micro-batches at a time.
+            if (net->IsPipelined() && actualNumSubminibatches > 1)
             {
-                if (actualNumSubminibatches > 1)
+                for (size_t ismb = 0; ismb < actualNumSubminibatches; ismb++)
                 {
-                    smbDispatcher.GetSubMinibatchToNet(ismb); // get sub-minibatch from full-size one
+                    smbDispatcher.GetSubMinibatchToNet(ismb);
                     ComputationNetwork::BumpEvalTimeStamp(featureNodes);
                     ComputationNetwork::BumpEvalTimeStamp(labelNodes);
+                    net->SetPipelineMicroBatch(ismb, /*replay=*/false);
+                    net->ForwardProp(evaluationNodes);
+                    net->ForwardProp(criterionNodes[0]);
+                    smbDispatcher.DoneWithPipelinedForwardProp(ismb);
+                }
+                if (learnRatePerSample > 0.01 * m_minLearnRate) // only compute gradient when learning rate is large enough
+                {
+                    for (size_t ismb = actualNumSubminibatches; ismb-- > 0;)
+                    {
+                        bool recompute = ismb + 1 < actualNumSubminibatches; // (the last one still has its values)
+                        if (recompute)
+                        {
+                            smbDispatcher.GetSubMinibatchToNet(ismb);
+                            net->SetPipelineMicroBatch(ismb, /*replay=*/true);
+                        }
+                        for (size_t stage = net->GetNumPipelineStages(); stage-- > 0;)
+                        {
+                            if (recompute)
+                                net->ForwardPropPipelineStage(criterionNodes[0], stage);
+                            net->BackpropPipelineStage(criterionNodes[0], stage, m_lossScale);
+                        }
+                        smbDispatcher.DoneWithPipelinedBackprop();
+                    }
                 }
+                smbDispatcher.DoneWithPipelinedMinibatch();
+                net->SetPipelineMicroBatch(0, /*replay=*/false);
+            }
+            else
+            {
+                for (size_t ismb = 0; ismb < actualNumSubminibatches; ismb++)
+                {
+                    if (actualNumSubminibatches > 1)
+                    {
+                        smbDispatcher.GetSubMinibatchToNet(ismb); // get sub-minibatch from full-size one
+                        ComputationNetwork::BumpEvalTimeStamp(featureNodes);
+                        ComputationNetwork::BumpEvalTimeStamp(labelNodes);
+                    }
 
-                // ===========================================================
-                // forward prop for evaluate eval nodes
-                // ===========================================================
+                    // ===========================================================
+                    // forward prop for evaluate eval nodes
+                    // ===========================================================
 
-                // compute eval node first since when gradient is computed the forward function values
-                // may be changed and need to be recomputed when gradient and function value share the same matrix
-                net->ForwardProp(evaluationNodes); // the bulk of this evaluation is reused in ComputeGradient() below
+                    // compute eval node first since when gradient is computed the forward function values
+                    // may be changed and need to be recomputed when gradient and function value share the same matrix
+                    net->ForwardProp(evaluationNodes); // the bulk of this evaluation is reused in ComputeGradient() below
 
-                // ===========================================================
-                // forward prop for training criterion
-                // ===========================================================
+                    // ===========================================================
+                    // forward prop for training criterion
+                    // ===========================================================
 
-                net->ForwardProp(criterionNodes[0]);
+                    net->ForwardProp(criterionNodes[0]);
 
-                // ===========================================================
-                // backprop
-                // ===========================================================
+                    // ===========================================================
+                    // backprop
+                    // ===========================================================
 
-                if (learnRatePerSample > 0.01 * m_minLearnRate) // only compute gradient when learning rate is large enough
-                    net->Backprop(criterionNodes[0]);
+                    if (learnRatePerSample > 0.01 * m_minLearnRate) // only compute gradient when learning rate is large enough
+                    {
+                        // hand the parameter gradients to the aggregator as soon as backprop has completed them
+                        // (learnParamsGradients is formed after the first minibatch)
+                        bool overlapAggregation = useGradientAggregation && m_overlapGradientAggregation && !learnParamsGradients.empty() && ismb + 1 == actualNumSubminibatches &&
+                                                  numAccumulatedSteps + 1 >= m_numGradientAccumulationSteps;
+                        if (overlapAggregation)
+                        {
+                            net->Environment().gradientComputedCallback = [this, net](const ComputationNodeBasePtr& node)
+                            {
+                                if (node->IsParameterUpdateRequired() && !net->IsRowShardedParameter(node))
+                                    m_distGradAgg->OnGradientComputed(&dynamic_pointer_cast<ComputationNode<ElemType>>(node)->Gradient());
+                            };
+                        }
+                        net->Backprop(criterionNodes[0], m_lossScale, /*accumulateParameterGradients=*/hasAccumulatedGradients);
+                        if (overlapAggregation)
+                            net->Environment().gradientComputedCallback = nullptr;
+                        hasAccumulatedGradients = m_numGradientAccumulationSteps > 1;
+                    }
 
-                // house-keeping for sub-minibatching
+                    // house-keeping for sub-minibatching
+                    if (actualNumSubminibatches > 1)
+                        smbDispatcher.DoneWithCurrentSubMinibatch(ismb); // page state out
+                }                                                        // end sub-minibatch loop
                 if (actualNumSubminibatches > 1)
-                    smbDispatcher.DoneWithCurrentSubMinibatch(ismb); // page state out
-            }                                                        // end sub-minibatch loop
-            if (actualNumSubminibatches > 1)
-                smbDispatcher.DoneWithCurrentMinibatch();
+                    smbDispatcher.DoneWithCurrentMinibatch();
+            }
         } // if (actualMBSize > 0)
+        else if (net->HasRowShardedParameters()) // the other workers still need this one's rows of the sharded parameters
+            net->PropagateRowShardedNodesWithoutData(evaluationNodes, criterionNodes[0], /*backprop=*/learnRatePerSample > 0.01 * m_minLearnRate);
         // WARNING: If actualMBSize == 0, then criterion nodes have NOT been updated, and contain garbage (last MB's) values.
 
         // In case of mini epochs (used for adaptive minibatch size and learning rate),
@@ -1132,10 +1460,13 @@ size_t SGD<ElemType>::TrainOneEpoch(ComputationNetworkPtr net,
                 maxNumSamplesExceeded = true;
         }
 
-        if (m_perfTraceLevel > 0)
+        if (measurePhases)
         {
-            std::unique_ptr<MatrixComputeStreamEvent> mainStreamSyncEvent(MatrixComputeStreamEvent::Create(net->GetDeviceId()));
-            mainStreamSyncEvent->SynchronizeEvent();
+            if (m_perfTraceLevel > 0)
+            {
+                std::unique_ptr<MatrixComputeStreamEvent> mainStreamSyncEvent(MatrixComputeStreamEvent::Create(net->GetDeviceId()));
+                mainStreamSyncEvent->SynchronizeEvent();
+            }
             fineGrainedPerfMeasurementTimer.Stop();
             computeTime = fineGrainedPerfMeasurementTimer.ElapsedSeconds();
             fineGrainedPerfMeasurementTimer.Start();
@@ -1163,6 +1494,41 @@ size_t SGD<ElemType>::TrainOneEpoch(ComputationNetworkPtr net,
                 localEpochEvalErrors.Add(i, numSamplesWithLabelOfNetwork);
         }
         else
+        {
+            // hoist the criterion into CPU space for all-reduce
+            // With gradient accumulation, this sums over the minibatches accumulated for this update.
+            if (numAccumulatedSteps == 0)
+            {
+                localEpochCriterion.Assign(0, numSamplesWithLabelOfNetwork);
+                for (size_t i = 0; i < evaluationNodes.size(); i++)
+                    localEpochEvalErrors.Assign(i, numSamplesWithLabelOfNetwork);
+            }
+            else
+            {
+                localEpochCriterion.Add(0, numSamplesWithLabelOfNetwork);
+                for (size_t i = 0; i < evaluationNodes.size(); i++)
+                    localEpochEvalErrors.Add(i, numSamplesWithLabelOfNetwork);
+            }
+        }
+
+        // gradient accumulation: defer aggregation and model update until all parts of the minibatch are backpropagated
+        numAccumulatedSteps++;
+        numAccumulatedSamples += aggregateNumSamples;
+        numAccumulatedSamplesWithLabel += aggregateNumSamplesWithLabel;
+        if (numAccumulatedSteps < m_numGradientAccumulationSteps && (wasDataRead || useDistributedMBReading))
+        {
+            trainSetDataReader->DataEnd();
+            AttemptUtteranceDerivativeFeatures(net, trainSetDataReader, featureNodes, inputMatrices);
+            continue;
+        }
+        aggregateNumSamples = numAccumulatedSamples;
+        aggregateNumSamplesWithLabel = numAccumulatedSamplesWithLabel;
+        numAccumulatedSteps = 0;
+        numAccumulatedSamples = 0;
+        numAccumulatedSamplesWithLabel = 0;
+        hasAccumulatedGradients = false;
+
+        if (useGradientAggregation)
         {
             // distributed gradient aggregation
             if (learnParamsGradients.size() == 0)
@@ -1172,7 +1538,8 @@ size_t SGD<ElemType>::TrainOneEpoch(ComputationNetworkPtr net,
                 for (auto nodeIter = learnableNodes.begin(); nodeIter != learnableNodes.end(); nodeIter++)
                 {
                     ComputationNodePtr node = dynamic_pointer_cast<ComputationNode<ElemType>>(*nodeIter);
-                    if (node->IsParameterUpdateRequired())
+                    // (the gradients of row-sharded parameters cover the minibatches of all workers already)
+                    if (node->IsParameterUpdateRequired() && !net->IsRowShardedParameter(node))
                     {
                         Matrix<ElemType>* currParamsGradient = &(node->Gradient()); // TODO: we can use shared_ptrs now
 
@@ -1189,11 +1556,6 @@ size_t SGD<ElemType>::TrainOneEpoch(ComputationNetworkPtr net,
                 }
             }
 
-            // hoist the criterion into CPU space for all-reduce
-            localEpochCriterion.Assign(0, numSamplesWithLabelOfNetwork);
-            for (size_t i = 0; i < evaluationNodes.size(); i++)
-                localEpochEvalErrors.Assign(i, numSamplesWithLabelOfNetwork);
-
             // copy all values to be aggregated into the header
             m_gradHeader->numSamples = aggregateNumSamples;
             m_gradHeader->criterion           = localEpochCriterion.GetCriterion(0).first;
@@ -1204,8 +1566,16 @@ size_t SGD<ElemType>::TrainOneEpoch(ComputationNetworkPtr net,
 
             // aggregate
             m_gradHeader->numEvalNode = evaluationNodes.size(); // TODO: rename numEvalNode (plural)
+            Timer aggregationTimer;
+            if (measurePhases)
+                aggregationTimer.Start();
             bool samplesProcessed = m_distGradAgg->AggregateGradients(learnParamsGradients, m_gradHeader.get(), isFirstMinibatch);
             noMoreSamplesToProcess = !samplesProcessed;
+            if (measurePhases)
+            {
+                aggregationTimer.Stop();
+                aggregationTime = aggregationTimer.ElapsedSeconds();
+            }
 
             // read out the header--now everything is aggregated
             aggregateNumSamples          = m_gradHeader->numSamples;
@@ -1229,8 +1599,13 @@ size_t SGD<ElemType>::TrainOneEpoch(ComputationNetworkPtr net,
             }
         }
 
+        // undo the loss scaling; an overflow in the gradients skips the update
+        bool gradientsAreFinite = true;
+        if ((aggregateNumSamples > 0) && (learnRatePerSample > m_minLearnRate * 0.01) && (m_lossScale != 1 || m_dynamicLossScaling))
+            gradientsAreFinite = UnscaleGradients(learnableNodes);
+
         // update model parameters
-        if ((aggregateNumSamples > 0) && (learnRatePerSample > m_minLearnRate * 0.01))
+        if ((aggregateNumSamples > 0) && (learnRatePerSample > m_minLearnRate * 0.01) && gradientsAreFinite)
         {
 #if 1       // BUGBUG: We must skip gaps in our momentum, clipping, regularization etc. criteria.
             // This will break test cases. So for now, we will only enable this for per-sample criteria.
@@ -1242,6 +1617,8 @@ size_t SGD<ElemType>::TrainOneEpoch(ComputationNetworkPtr net,
             if (numSamplesInMinibatch != aggregateNumSamples)
                 fprintf(stderr, "SGD: using true #samples %d instead of MB size %d\n", (int)numSamplesInMinibatch, (int)aggregateNumSamples);
 #endif
+            TimelineEvent updateEvent("Update", "UpdateWeights", net->GetDeviceId());
+            ClipGradientNorms(learnableNodes, numSamplesInMinibatch);
             auto smoothedGradientIter = smoothedGradients.begin();
             auto smoothedCountIter = smoothedCounts.begin();
             for (auto nodeIter = learnableNodes.begin(); nodeIter != learnableNodes.end(); nodeIter++, smoothedGradientIter++, smoothedCountIter++)
@@ -1263,7 +1640,7 @@ size_t SGD<ElemType>::TrainOneEpoch(ComputationNetworkPtr net,
                                   *smoothedGradientIter, *smoothedCountIter,
                                   nodeDependentLearningRatePerSample, momentumPerSample,
                                   numSamplesInMinibatch,
-                                  m_L2RegWeight * nodeDependentRegMultiplier, m_L1RegWeight * nodeDependentRegMultiplier,
+                                  m_L2RegWeight * nodeDependentRegMultiplier, m_L1RegWeight * nodeDependentRegMultiplier, m_weightDecay * nodeDependentRegMultiplier,
                                   m_needAveMultiplier, m_useNesterovMomentum);
                     node->BumpEvalTimeStamp();
 #ifdef _DEBUG
@@ -1275,10 +1652,13 @@ size_t SGD<ElemType>::TrainOneEpoch(ComputationNetworkPtr net,
         }
 
 
-        if (m_perfTraceLevel > 0)
+        if (measurePhases)
         {
-            std::unique_ptr<MatrixComputeStreamEvent> mainStreamSyncEvent(MatrixComputeStreamEvent::Create(net->GetDeviceId()));
-            mainStreamSyncEvent->SynchronizeEvent();
+            if (m_perfTraceLevel > 0)
+            {
+                std::unique_ptr<MatrixComputeStreamEvent> mainStreamSyncEvent(MatrixComputeStreamEvent::Create(net->GetDeviceId()));
+                mainStreamSyncEvent->SynchronizeEvent();
+            }
             fineGrainedPerfMeasurementTimer.Stop();
             parameterUpdateTime = fineGrainedPerfMeasurementTimer.ElapsedSeconds();
             fineGrainedPerfMeasurementTimer.Start();
@@ -1319,7 +1699,7 @@ size_t SGD<ElemType>::TrainOneEpoch(ComputationNetworkPtr net,
         }
 
 
-        if (m_perfTraceLevel > 0)
+        if (measurePhases)
         {
             fineGrainedPerfMeasurementTimer.Stop();
             parameterSyncTime = fineGrainedPerfMeasurementTimer.ElapsedSeconds();
@@ -1329,12 +1709,29 @@ size_t SGD<ElemType>::TrainOneEpoch(ComputationNetworkPtr net,
         if (m_perfTraceLevel > 0)
         {
             PREPENDTS(stderr);
-            fprintf(stderr, "Perf trace: Worker MB size = %d, Read = %.5gs; Compute = %.5gs; Parameter update = %.5gs; Parameter sync = %.5gs; Aggregate MB size = %d\n", (int)actualMBSize, readTime, computeTime, parameterUpdateTime, parameterSyncTime, (int)aggregateNumSamples);
+            fprintf(stderr, "Perf trace: Worker MB size = %d, Read = %.5gs; Compute = %.5gs; Parameter update = %.5gs (aggregation = %.5gs); Parameter sync = %.5gs; Aggregate MB size = %d\n", (int)actualMBSize, readTime, computeTime, parameterUpdateTime, aggregationTime, parameterSyncTime, (int)aggregateNumSamples);
+        }
+        if (writeMetrics)
+        {
+            for (TrainingMetrics* metrics : { &intervalMetrics, &epochMetrics })
+            {
+                metrics->readSeconds            += readTime;
+                metrics->forwardBackwardSeconds += computeTime;
+                metrics->aggregateSeconds       += aggregationTime;
+                metrics->updateSeconds          += parameterUpdateTime - aggregationTime;
+                metrics->syncSeconds            += parameterSyncTime;
+            }
         }
 
         numMBsRun++;
         totalTimeInMBs += timer.ElapsedSeconds();
 
+        if (numMBsToProfileNodes > 0 && (size_t) numMBsRun == numMBsToProfileNodes)
+        {
+            net->Environment().nodeProfiler->LogSummary(stderr, numMBsToProfileNodes);
+            net->Environment().nodeProfiler = nullptr;
+        }
+
         // log
         // This shows the criterion since last logged.
         if (numMBsRun <= m_firstMBsToShowResult || (m_numMBsToShowResult && (numMBsRun % m_numMBsToShowResult == 0)))
@@ -1409,6 +1806,29 @@ size_t SGD<ElemType>::TrainOneEpoch(ComputationNetworkPtr net,
                         totalTimeInMBs, trainSamplesSinceLastLogged / totalTimeInMBs);
             }
 
+            if (writeMetrics)
+            {
+                intervalMetrics.rank = m_mpi ? (int) m_mpi->CurrentNodeRank() : 0;
+                intervalMetrics.epoch = epochNumber + 1;
+                intervalMetrics.firstMinibatch = numMBsRunSinceLastLogged + 1;
+                intervalMetrics.lastMinibatch = numMBsRun;
+                intervalMetrics.numSamples = trainSamplesSinceLastLogged;
+                intervalMetrics.seconds = totalTimeInMBs;
+                intervalMetrics.trainLoss = trainLossSinceLastLogged;
+                for (size_t i = 0; i < epochEvalErrors.size(); i++)
+                {
+                    // same as in the log: aggregating nodes report their result for the epoch so far
+                    let evalErrorSinceLastLogged = ContainsAccumulatedResult(evaluationNodes[i]) ? epochEvalErrors[i] : epochEvalErrors[i] - epochEvalErrorsLastLogged[i];
+                    intervalMetrics.evalErrors.push_back(make_pair(evaluationNodes[i]->NodeName(), evalErrorSinceLastLogged.Average()));
+                }
+                intervalMetrics.learningRatePerSample = learnRatePerSample;
+                intervalMetrics.memoryInUseMB = GetUsedMemoryInMBs(net->GetDeviceId());
+                epochMetrics.peakMemoryMB = max(epochMetrics.peakMemoryMB, intervalMetrics.memoryInUseMB);
+                intervalMetrics.peakMemoryMB = epochMetrics.peakMemoryMB;
+                m_metricsWriter->Write(intervalMetrics);
+                intervalMetrics = TrainingMetrics();
+            }
+
             // progress tracing for compute cluster management
             if (wasProgressPrinted)
                 ProgressTracing::TraceTrainLoss(trainLossSinceLastLogged);
@@ -1439,6 +1859,21 @@ size_t SGD<ElemType>::TrainOneEpoch(ComputationNetworkPtr net,
         timer.Restart();
         totalEpochSamples += aggregateNumSamplesWithLabel;
 
+        if (useIntraEpochCheckPoints && wasDataRead)
+        {
+            auto now = std::chrono::steady_clock::now();
+            if ((m_intraEpochCheckPointSamples > 0 && totalEpochSamples - lastIntraEpochCheckPointSamples >= m_intraEpochCheckPointSamples) ||
+                (m_intraEpochCheckPointMinutes > 0 && std::chrono::duration<double>(now - lastIntraEpochCheckPointTime).count() >= 60 * m_intraEpochCheckPointMinutes))
+            {
+                IntraEpochPosition position;
+                position.m_samplePosition = trainSetDataReader->GetCurrentSamplePosition();
+                position.m_epochSamples = totalEpochSamples;
+                SaveIntraEpochCheckPoint(net, epochNumber, position, learnRatePerSample, smoothedGradients, smoothedCounts, tunedMBSize);
+                lastIntraEpochCheckPointSamples = totalEpochSamples;
+                lastIntraEpochCheckPointTime = now;
+            }
+        }
+
         // call DataEnd function
         // This signals something from SGD to the reader.
         // DataEnd does reader specific process if sentence ending is reached
@@ -1452,17 +1887,33 @@ size_t SGD<ElemType>::TrainOneEpoch(ComputationNetworkPtr net,
         AttemptUtteranceDerivativeFeatures(net, trainSetDataReader, featureNodes, inputMatrices);
 
         profiler.NextSample();
+        timelineProfiler.NextSample();
+        if (Telemetry::IsEnabled())
+        {
+            Telemetry::Set("cntk_matrix_pool_allocated_bytes", "", "Memory allocated by the shared buffers of the matrix pool.",
+                           (double) net->GetMatrixPoolAllocatedBytes());
+        }
         isFirstMinibatch = false;
     }
 
     // --- END MAIN MINIBATCH LOOP
 
+    // the epoch ended before all minibatches to profile were run
+    if (net->Environment().nodeProfiler)
+    {
+        net->Environment().nodeProfiler->LogSummary(stderr, numMBsRun);
+        net->Environment().nodeProfiler = nullptr;
+    }
+
     if (useModelAggregation )
     {
         m_pMASGDHelper->OnEpochEnd(learnableNodes, smoothedGradients, nSamplesSinceLastModelSync);
         nSamplesSinceLastModelSync = 0;
     }
 
+    if (useGradientAggregation && m_distGradAgg)
+        m_distGradAgg->OnEpochEnd();
+
     if (useAsyncGradientAggregation && (m_mpi->NumNodesInUse() > 1))
     {
         m_pASGDHelper->PushAndPullModel(learnableNodes, nSamplesSinceLastModelSync);
@@ -1521,6 +1972,25 @@ size_t SGD<ElemType>::TrainOneEpoch(ComputationNetworkPtr net,
             localEpochEvalErrors, ContainsAccumulatedResult);
     }
 
+    if (writeMetrics)
+    {
+        epochTimer.Stop();
+        epochMetrics.isEpochSummary = true;
+        epochMetrics.rank = m_mpi ? (int) m_mpi->CurrentNodeRank() : 0;
+        epochMetrics.epoch = epochNumber + 1;
+        epochMetrics.firstMinibatch = 1;
+        epochMetrics.lastMinibatch = numMBsRun;
+        epochMetrics.numSamples = totalEpochSamples;
+        epochMetrics.seconds = epochTimer.ElapsedSeconds();
+        epochMetrics.trainLoss = epochCriterion.Average();
+        for (size_t i = 0; i < epochEvalErrors.size(); i++)
+            epochMetrics.evalErrors.push_back(make_pair(evaluationNodes[i]->NodeName(), epochEvalErrors[i].Average()));
+        epochMetrics.learningRatePerSample = learnRatePerSample;
+        epochMetrics.memoryInUseMB = GetUsedMemoryInMBs(net->GetDeviceId());
+        epochMetrics.peakMemoryMB = max(epochMetrics.peakMemoryMB, epochMetrics.memoryInUseMB);
+        m_metricsWriter->Write(epochMetrics);
+    }
+
     return totalEpochSamples;
 }
 
@@ -1555,6 +2025,79 @@ const std::vector<ComputationNodeBasePtr>& SGD<ElemType>::GetEvalCriterionNodes(
         return net->EvaluationNodes();
 }
 
+// accumulates the statistics of an input of a minibatch, from a copy in 'buffer' if it is not on the CPU
+template <class ElemType>
+static void AccumulateInputStatistics(const StreamMinibatchInputs::Input& input, InputStatistics& statistics, std::vector<ElemType>& buffer)
+{
+    const auto& matrix = input.GetMatrix<ElemType>();
+    if (matrix.GetMatrixType() != MatrixType::DENSE || matrix.GetNumRows() != statistics.GetDim())
+        LogicError("AccumulateInputStatistics: Expected a dense input of dimension %d.", (int) statistics.GetDim());
+
+    const ElemType* data;
+    if (matrix.GetDeviceId() == CPUDEVICE)
+        data = matrix.Data();
+    else
+    {
+        buffer.resize(matrix.GetNumElements());
+        matrix.CopySection(matrix.GetNumRows(), matrix.GetNumCols(), buffer.data(), matrix.GetNumRows());
+        data = buffer.data();
+    }
+    statistics.Accumulate(data, matrix.GetNumCols(), input.pMBLayout);
+}
+
+// The cache of preComputeFromReader: the key, i.e. the configuration of the data, then the statistics per input.
+static void SaveInputStatistics(const std::wstring& path, const std::string& key, const std::map<std::wstring, InputStatistics>& inputStatistics)
+{
+    const std::wstring tempPath = path + L".tmp";
+    {
+        File fstream(tempPath, FileOptions::fileOptionsBinary | FileOptions::fileOptionsWrite);
+        fstream.PutMarker(FileMarker::fileMarkerBeginSection, L"BInputStatistics");
+        fstream << key << inputStatistics.size();
+        for (const auto& statistics : inputStatistics)
+        {
+            fstream << statistics.first;
+            statistics.second.Save(fstream);
+        }
+        fstream.PutMarker(FileMarker::fileMarkerEndSection, L"EInputStatistics");
+    }
+    renameOrDie(tempPath, path);
+}
+
+// loads the statistics of all given inputs, if the cache has them for the same key
+static bool TryLoadInputStatistics(const std::wstring& path, const std::string& key, std::map<std::wstring, InputStatistics>& inputStatistics)
+{
+    if (!fexists(path))
+        return false;
+
+    File fstream(path, FileOptions::fileOptionsBinary | FileOptions::fileOptionsRead);
+    fstream.GetMarker(FileMarker::fileMarkerBeginSection, L"BInputStatistics");
+    std::string fileKey;
+    fstream >> fileKey;
+    if (fileKey != key)
+        return false;
+
+    size_t numInputs;
+    fstream >> numInputs;
+    std::map<std::wstring, InputStatistics> fileStatistics;
+    for (size_t i = 0; i < numInputs; i++)
+    {
+        std::wstring name;
+        fstream >> name;
+        fileStatistics[name].Load(fstream);
+    }
+    fstream.GetMarker(FileMarker::fileMarkerEndSection, L"EInputStatistics");
+
+    for (const auto& statistics : inputStatistics)
+    {
+        auto iter = fileStatistics.find(statistics.first);
+        if (iter == fileStatistics.end() || iter->second.GetDim() != statistics.second.GetDim())
+            return false;
+    }
+    for (auto& statistics : inputStatistics)
+        statistics.second = fileStatistics[statistics.first];
+    return true;
+}
+
 // execute PreComputeNodes
 // Returns true if precomputation was executed.
 template <class ElemType>
@@ -1583,35 +2126,103 @@ bool SGD<ElemType>::PreCompute(ComputationNetworkPtr net,
     }
     }
 
+    // Mean and InvStdDev of input values can be accumulated from the reader directly, without forward passes.
+    // The other nodes are computed by forward passes over the same minibatches.
+    std::map<std::wstring, InputStatistics> inputStatistics; // [input node name]
+    std::list<ComputationNodeBasePtr> readerNodes, forwardNodes;
+    for (const auto& node : nodes)
+    {
+        const auto& input = node->Input(0);
+        if (m_preComputeFromReader && dynamic_pointer_cast<MeanInvStdDevNodeBase<ElemType>>(node) &&
+            input->OperationName() == OperationNameOf(InputValue) && inputMatrices->HasInput(input->NodeName()))
+        {
+            inputStatistics[input->NodeName()] = InputStatistics(input->GetSampleLayout().GetNumElements());
+            readerNodes.push_back(node);
+        }
+        else
+            forwardNodes.push_back(node);
+    }
+
+    // Without forward passes, the ranks can each read a part of the data and merge their statistics at the end,
+    // and the statistics can be kept for other trainings on the same data.
+    const bool readerOnly = forwardNodes.empty();
+    const bool distributed = readerOnly && m_mpi != nullptr && m_mpi->NumNodesInUse() > 1 && trainSetDataReader->SupportsDistributedMBRead();
+    std::string cacheKey;
+    if (readerOnly && !m_preComputeCache.empty())
+    {
+        if (m_preComputeCacheKey.empty())
+            LOGPRINTF(stderr, "Precomputing --> preComputeCache is ignored, since the configuration of the reader is not known.\n");
+        else
+            cacheKey = m_preComputeCacheKey + "\nUseAllDataForPreComputedNode=" + (m_useAllDataForPreComputedNode ? "true" : ("false\nepochSize=" + std::to_string(m_epochSize)));
+    }
+    if (!inputStatistics.empty())
+        LOGPRINTF(stderr, "Precomputing --> statistics of %d inputs from the reader%s.\n", (int) inputStatistics.size(), readerOnly ? " only" : "");
+
     // compute
     ScopedNetworkOperationMode modeGuard(net, NetworkOperationMode::preComputing);
 
-    // trainSetDataReader->StartMinibatchLoop(m_mbSize[0],  0 , requestDataSize);
-    // trainSetDataReader->StartMinibatchLoop(m_mbSize[0],  0 , m_epochSize); // only based on one epoch
-    // To support large dataset, we usually partition whole dataset into several epoch's,
-    // so we need to use all the data to do precomputing
-    if (m_useAllDataForPreComputedNode) // using all the data
-        trainSetDataReader->StartMinibatchLoop(m_mbSize[0], 0, inputMatrices->GetStreamDescriptions());
-    else // using only one epoch. Note: One epoch is often enough for feature mean/stddev, but not for estimating priors.
-        trainSetDataReader->StartMinibatchLoop(m_mbSize[0], 0, inputMatrices->GetStreamDescriptions(), m_epochSize);
-    net->StartEvaluateMinibatchLoop(nodes);
-
     // initialize
     for (auto & node : nodes)
         dynamic_pointer_cast<IPreComputeNode>(node)->MarkComputed(false /*begin accumulating*/);
 
-    const size_t numIterationsBeforePrintingProgress = 100;
-    size_t numItersSinceLastPrintOfProgress = 0;
-    size_t actualMBSizeDummy;
-    while (DataReaderHelpers::GetMinibatchIntoNetwork<ElemType>(*trainSetDataReader, net, nullptr, false, false, *inputMatrices, actualMBSizeDummy, m_mpi))
+    if (!cacheKey.empty() && TryLoadInputStatistics(m_preComputeCache, cacheKey, inputStatistics))
     {
-        // TODO: move these into GetMinibatchIntoNetwork()  --but those are passed around; necessary? Can't we get them from 'net'?
-        ComputationNetwork::BumpEvalTimeStamp(featureNodes);
-        ComputationNetwork::BumpEvalTimeStamp(labelNodes);
+        LOGPRINTF(stderr, "Precomputing --> loaded the statistics from '%ls'.\n", m_preComputeCache.c_str());
+    }
+    else
+    {
+        // trainSetDataReader->StartMinibatchLoop(m_mbSize[0],  0 , requestDataSize);
+        // trainSetDataReader->StartMinibatchLoop(m_mbSize[0],  0 , m_epochSize); // only based on one epoch
+        // To support large dataset, we usually partition whole dataset into several epoch's,
+        // so we need to use all the data to do precomputing
+        // Note: One epoch is often enough for feature mean/stddev, but not for estimating priors.
+        const size_t epochSize = m_useAllDataForPreComputedNode ? requestDataSize : m_epochSize;
+        if (distributed)
+            trainSetDataReader->StartDistributedMinibatchLoop(m_mbSize[0], 0, m_mpi->CurrentNodeRank(), m_mpi->NumNodesInUse(), inputMatrices->GetStreamDescriptions(), epochSize);
+        else
+            trainSetDataReader->StartMinibatchLoop(m_mbSize[0], 0, inputMatrices->GetStreamDescriptions(), epochSize);
+        if (!readerOnly)
+            net->StartEvaluateMinibatchLoop(forwardNodes);
+
+        const size_t numIterationsBeforePrintingProgress = 100;
+        size_t numItersSinceLastPrintOfProgress = 0;
+        size_t actualMBSizeDummy;
+        std::vector<ElemType> hostBuffer;
+        while (readerOnly ? trainSetDataReader->GetMinibatch(*inputMatrices)
+                          : DataReaderHelpers::GetMinibatchIntoNetwork<ElemType>(*trainSetDataReader, net, nullptr, false, false, *inputMatrices, actualMBSizeDummy, m_mpi))
+        {
+            for (auto& statistics : inputStatistics)
+                AccumulateInputStatistics(inputMatrices->GetInput(statistics.first), statistics.second, hostBuffer);
+
+            if (!readerOnly)
+            {
+                // TODO: move these into GetMinibatchIntoNetwork()  --but those are passed around; necessary? Can't we get them from 'net'?
+                ComputationNetwork::BumpEvalTimeStamp(featureNodes);
+                ComputationNetwork::BumpEvalTimeStamp(labelNodes);
+
+                net->ForwardProp(forwardNodes);
+            }
 
-        net->ForwardProp(nodes);
+            numItersSinceLastPrintOfProgress = ProgressTracing::TraceFakeProgress(numIterationsBeforePrintingProgress, numItersSinceLastPrintOfProgress);
+        }
+
+        if (distributed)
+        {
+            for (auto& statistics : inputStatistics)
+                statistics.second.AllReduce(*m_mpi);
+        }
+
+        if (!cacheKey.empty() && (m_mpi == nullptr || m_mpi->IsMainNode()))
+        {
+            SaveInputStatistics(m_preComputeCache, cacheKey, inputStatistics);
+            LOGPRINTF(stderr, "Precomputing --> saved the statistics to '%ls'.\n", m_preComputeCache.c_str());
+        }
+    }
 
-        numItersSinceLastPrintOfProgress = ProgressTracing::TraceFakeProgress(numIterationsBeforePrintingProgress, numItersSinceLastPrintOfProgress);
+    for (auto & node : readerNodes)
+    {
+        const auto& statistics = inputStatistics.at(node->Input(0)->NodeName());
+        dynamic_pointer_cast<MeanInvStdDevNodeBase<ElemType>>(node)->SetAccumulatedStatistics(statistics.GetMean(), statistics.GetVariance(), statistics.GetNumSamples());
     }
 
     // finalize
@@ -1660,6 +2271,7 @@ double SGD<ElemType>::SearchForBestLearnRate(ComputationNetworkPtr net,
     }
 
     int baseModelEpoch = epochNumber - 1;
+    WaitForCheckPointSave();
     net->RereadPersistableParameters<ElemType>(GetModelNameForEpoch(baseModelEpoch));
 
     double learnRate = learnRatePerSample;
@@ -2002,6 +2614,111 @@ size_t SGD<ElemType>::SearchForBestMinibatchSize(ComputationNetworkPtr net,
     return lastGoodMinibatchSize;
 }
 
+// Runs a few minibatches with each of the minibatch sizes initialMinibatchSize * 2^k up to m_minibatchSizeTuningMax.
+// Unlike SearchForBestMinibatchSize(), which looks at the training criterion, this measures how many samples per second
+// are processed and how much memory is used. The search ends when the memory expected for the next size (extrapolated
+// linearly from the last two) exceeds the budget. The largest size within m_throughputSearchMargin percent of the best
+// throughput is chosen, since beyond the saturation point larger minibatches only cost convergence.
+// The measurements are logged one JSON object per line, prefixed by "ThroughputMinibatchSearch:".
+template <class ElemType>
+size_t SGD<ElemType>::SearchForFastestMinibatchSize(ComputationNetworkPtr net,
+                                                    ComputationNetworkPtr refNet,
+                                                    const ComputationNodeBasePtr& refNode,
+                                                    const int epochNumber,
+                                                    IDataReader* trainSetDataReader,
+                                                    const double learnRatePerSample,
+                                                    const size_t initialMinibatchSize,
+                                                    const std::vector<ComputationNodeBasePtr>& featureNodes,
+                                                    const std::vector<ComputationNodeBasePtr>& labelNodes,
+                                                    const std::vector<ComputationNodeBasePtr>& criterionNodes,
+                                                    const std::vector<ComputationNodeBasePtr>& evaluationNodes,
+                                                    StreamMinibatchInputs* inputMatrices,
+                                                    const std::list<ComputationNodeBasePtr>& learnableNodes,
+                                                    std::list<Matrix<ElemType>>& smoothedGradients, std::vector<double> smoothedCounts)
+{
+    DEVICEID_TYPE deviceId = net->GetDeviceId();
+    size_t memoryBudgetMB = m_throughputSearchMemoryBudgetMB;
+    if (memoryBudgetMB == 0)
+        memoryBudgetMB = deviceId >= 0 ? TracingGPUMemoryAllocator::GetFreeAndTotalMemoryInMBs(deviceId).second * 9 / 10 : SIZE_MAX;
+
+    LOGPRINTF(stderr, " ThroughputMinibatchSearch Epoch[%d]: Evaluating minibatchSizes %d..%d with %d minibatches each\n",
+              (int)epochNumber + 1, (int)initialMinibatchSize, (int)m_minibatchSizeTuningMax, (int)m_throughputSearchNumMinibatches);
+
+    struct Trial
+    {
+        size_t minibatchSize;
+        double samplesPerSecond;
+        size_t usedMemoryMB;
+    };
+    std::vector<Trial> trials;
+    for (size_t trialMinibatchSize = max(initialMinibatchSize, (size_t)1); trialMinibatchSize <= m_minibatchSizeTuningMax; trialMinibatchSize *= 2)
+    {
+        size_t numSamples = trialMinibatchSize * m_throughputSearchNumMinibatches;
+        if (m_epochSize != requestDataSize && numSamples > m_epochSize)
+            break; // the epoch is too short to time this size
+
+        std::vector<EpochCriterion> epochEvalErrors(evaluationNodes.size(), EpochCriterion::Infinity());
+        EpochCriterion epochCriterion(EpochCriterion::Infinity());
+
+        Timer timer;
+        timer.Start();
+        TrainOneMiniEpochAndReloadModel(net, refNet, refNode, epochNumber,
+                                        m_epochSize, trainSetDataReader,
+                                        learnRatePerSample, trialMinibatchSize, featureNodes,
+                                        labelNodes, criterionNodes,
+                                        evaluationNodes, inputMatrices,
+                                        learnableNodes, smoothedGradients, smoothedCounts,
+                                        /*out*/ epochCriterion, /*out*/ epochEvalErrors,
+                                        "ThroughputMinibatchSearch:", numSamples);
+        timer.Stop();
+
+        // all workers have to come to the same decision, so they go by the slowest and the most memory used
+        double measurements[3] = { timer.ElapsedSeconds(), (double)epochCriterion.second, (double)GetUsedMemoryInMBs(deviceId) };
+        if (m_mpi != nullptr)
+            m_mpi->AllReduce(measurements, 3, MPI_MAX);
+
+        Trial trial = { trialMinibatchSize, measurements[0] > 0 ? measurements[1] / measurements[0] : 0, (size_t)measurements[2] };
+        bool fits = trial.usedMemoryMB <= memoryBudgetMB;
+
+        // memory grows about linearly with the minibatch size, so by twice the last increase for the next size
+        size_t expectedMemoryMB = trial.usedMemoryMB;
+        if (!trials.empty() && trial.usedMemoryMB > trials.back().usedMemoryMB)
+            expectedMemoryMB += 2 * (trial.usedMemoryMB - trials.back().usedMemoryMB);
+
+        LOGPRINTF(stderr, "ThroughputMinibatchSearch: {\"epoch\": %d, \"minibatchSize\": %d, \"samples\": %d, \"seconds\": %.3f, \"samplesPerSecond\": %.1f, \"usedMemoryMB\": %d, \"memoryBudgetMB\": %d, \"fits\": %s}\n",
+                  (int)epochNumber + 1, (int)trial.minibatchSize, (int)measurements[1], measurements[0], trial.samplesPerSecond,
+                  (int)trial.usedMemoryMB, (int)min(memoryBudgetMB, (size_t)INT_MAX), fits ? "true" : "false");
+
+        if (!fits)
+            break;
+        trials.push_back(trial);
+        if (expectedMemoryMB > memoryBudgetMB)
+            break;
+    }
+
+    if (trials.empty())
+    {
+        LOGPRINTF(stderr, " ThroughputMinibatchSearch Epoch[%d]: No minibatchSize fits into %d MB, keeping minibatchSize of %d\n",
+                  (int)epochNumber + 1, (int)min(memoryBudgetMB, (size_t)INT_MAX), (int)initialMinibatchSize);
+        return initialMinibatchSize;
+    }
+
+    double bestSamplesPerSecond = 0;
+    for (const auto& trial : trials)
+        bestSamplesPerSecond = max(bestSamplesPerSecond, trial.samplesPerSecond);
+
+    const Trial* chosen = &trials.front();
+    for (const auto& trial : trials)
+    {
+        if (trial.samplesPerSecond >= bestSamplesPerSecond * (1.0 - m_throughputSearchMargin / 100.0))
+            chosen = &trial;
+    }
+
+    LOGPRINTF(stderr, "ThroughputMinibatchSearch: {\"epoch\": %d, \"chosenMinibatchSize\": %d, \"samplesPerSecond\": %.1f, \"bestSamplesPerSecond\": %.1f, \"usedMemoryMB\": %d}\n",
+              (int)epochNumber + 1, (int)chosen->minibatchSize, chosen->samplesPerSecond, bestSamplesPerSecond, (int)chosen->usedMemoryMB);
+    return chosen->minibatchSize;
+}
+
 // run training over a small subset of an epoch, used by automatic LR and MB-size tuning
 template <class ElemType>
 void SGD<ElemType>::TrainOneMiniEpochAndReloadModel(ComputationNetworkPtr net,
@@ -2039,8 +2756,17 @@ void SGD<ElemType>::TrainOneMiniEpochAndReloadModel(ComputationNetworkPtr net,
     int baseModelEpoch = epochNumber - 1;
     let path = GetModelNameForEpoch(baseModelEpoch);
     //fprintf(stderr, "Reverting parameters back to %ls\n", path.c_str());
+    WaitForCheckPointSave();
     net->RereadPersistableParameters<ElemType>(path);
 
+    // before the first epoch there is no checkpoint, the gradient history just starts out empty
+    if (baseModelEpoch < 0)
+    {
+        for (auto& smoothedGradient : smoothedGradients)
+            smoothedGradient.SetValue(0);
+        return;
+    }
+
     double dummyLearnRate;
     double dummyPrevCriterion;
     size_t dummyTotalTrainingSamplesSeen; // (not used)
@@ -2091,7 +2817,26 @@ void SGD<ElemType>::InitDistGradAgg(int numEvalNodes, int numGradientBits, int d
 {
     assert(GetParallelizationMethod() == ParallelizationMethod::dataParallelSGD);
 
-    if (numGradientBits != (8 * sizeof(ElemType)))
+    if (m_topKGradientPercent > 0)
+    {
+        if (numGradientBits != (8 * sizeof(ElemType)))
+            InvalidArgument("topKGradientPercent cannot be combined with gradientBits.");
+        if (traceLevel > 0)
+            fprintf(stderr, "Initializing dataParallelSGD with top-%g%% sparsified gradients.\n", m_topKGradientPercent);
+        if (m_bufferedAsyncGradientAggregation || Globals::UseV2Aggregator())
+            fprintf(stderr, "topKGradientPercent: useBufferedAsyncGradientAggregation and the V2 aggregator are not supported with sparsified gradients and are ignored.\n");
+        m_distGradAgg = std::make_shared<SparseDistGradAggregator<ElemType>>(m_mpi, m_topKGradientPercent / 100, m_syncStatsTrace);
+    }
+    else if (m_adaptiveGradientBits)
+    {
+        if (traceLevel > 0)
+            fprintf(stderr, "Initializing dataParallelSGD with adaptive quantization, %g bits per gradient entry at most.\n", m_adaptiveGradientBitsBudget);
+        if (m_bufferedAsyncGradientAggregation || Globals::UseV2Aggregator())
+            fprintf(stderr, "adaptiveGradientBits: useBufferedAsyncGradientAggregation and the V2 aggregator are not supported with adaptive quantization and are ignored.\n");
+        auto bitAllocator = std::make_shared<QuantizationBitAllocator>(m_adaptiveGradientBitsBudget, m_adaptiveGradientBitsTargetError);
+        m_distGradAgg = std::make_shared<QuantizedDistGradAggregator<ElemType>>(m_mpi, numGradientBits, bitAllocator, m_zeroThresholdFor1Bit, m_syncStatsTrace);
+    }
+    else if (numGradientBits != (8 * sizeof(ElemType)))
     {
         if (traceLevel > 0)
             fprintf(stderr, "Initializing dataParallelSGD for %d-bit quantization.\n", numGradientBits);
@@ -2104,7 +2849,10 @@ void SGD<ElemType>::InitDistGradAgg(int numEvalNodes, int numGradientBits, int d
         else
             m_distGradAgg = std::make_shared<AllReduceDistGradAggregator<ElemType>>(m_mpi, numGradientBits, m_zeroThresholdFor1Bit, true /*useQuantizationForSelfStripe*/, m_bufferedAsyncGradientAggregation, traceLevel, m_syncStatsTrace);
 #else
-        RuntimeError("Gradient quantization is unsupported in CNTK binaries built without quantized gradient aggregation support!");
+        // without the 1bit submodule, the quantized gradients are all-gathered
+        if (64 % numGradientBits != 0)
+            InvalidArgument("gradientBits must be 1, 2, 4, 8, 16 or 32 in CNTK binaries built without the 1bit submodule, but is %d.", numGradientBits);
+        m_distGradAgg = std::make_shared<QuantizedDistGradAggregator<ElemType>>(m_mpi, numGradientBits, nullptr, m_zeroThresholdFor1Bit, m_syncStatsTrace);
 #endif // !CNTK_PARALLEL_TRAINING_SUPPORT
     }
     else
@@ -2112,9 +2860,27 @@ void SGD<ElemType>::InitDistGradAgg(int numEvalNodes, int numGradientBits, int d
         if (traceLevel > 0)
             fprintf(stderr, "Initializing dataParallelSGD with FP%d aggregation.\n", numGradientBits);
         if (Globals::UseV2Aggregator()) // Currently used to check V2 against baselines.
-            m_distGradAgg = std::make_shared<V2SimpleDistGradAggregator<ElemType>>(m_mpi, m_bufferedAsyncGradientAggregation, m_syncStatsTrace, ::CNTK::MPICommunicator());
+            m_distGradAgg = std::make_shared<V2SimpleDistGradAggregator<ElemType>>(m_mpi, m_bufferedAsyncGradientAggregation, m_syncStatsTrace, ::CNTK::MPICommunicator(),
+                                                                                   m_gradientAggregationBucketSizeInMB * 1024 * 1024);
+        else
+            m_distGradAgg = std::make_shared<SimpleDistGradAggregator<ElemType>>(m_mpi, m_bufferedAsyncGradientAggregation, deviceId, m_syncStatsTrace,
+                                                                                 m_overlapGradientAggregation, m_gradientAggregationBucketSizeInMB * 1024 * 1024, m_numBackupWorkers);
+    }
+
+    if (m_numBackupWorkers > 0 && traceLevel > 0)
+    {
+        if (numGradientBits != (8 * sizeof(ElemType)) || Globals::UseV2Aggregator() || m_topKGradientPercent > 0 || m_adaptiveGradientBits)
+            fprintf(stderr, "numBackupWorkers is only supported for FP%d aggregation without the V2 aggregator and will be ignored.\n", (int) (8 * sizeof(ElemType)));
         else
-            m_distGradAgg = std::make_shared<SimpleDistGradAggregator<ElemType>>(m_mpi, m_bufferedAsyncGradientAggregation, deviceId, m_syncStatsTrace);
+            fprintf(stderr, "Aggregating the gradients of the first %d of %d workers in each step.\n", (int) (m_mpi->NumNodesInUse() - m_numBackupWorkers), (int) m_mpi->NumNodesInUse());
+    }
+
+    if (m_overlapGradientAggregation && traceLevel > 0)
+    {
+        if (numGradientBits != (8 * sizeof(ElemType)) || Globals::UseV2Aggregator() || m_topKGradientPercent > 0 || m_adaptiveGradientBits)
+            fprintf(stderr, "overlapGradientAggregation is only supported for FP%d aggregation without the V2 aggregator and will be ignored.\n", (int) (8 * sizeof(ElemType)));
+        else if (m_bufferedAsyncGradientAggregation)
+            fprintf(stderr, "overlapGradientAggregation is ignored with useBufferedAsyncGradientAggregation.\n");
     }
 
     m_gradHeader.reset(DistGradHeader::Create(numEvalNodes), [](DistGradHeader* ptr) { DistGradHeader::Destroy(ptr); });
@@ -2127,10 +2893,23 @@ void SGD<ElemType>::InitModelAggregationHandler(int traceLevel, DEVICEID_TYPE de
     {
         return; // no need to do anything if already initialized. TODO: make it singleton 
     }
-    if (GetParallelizationMethod() == ParallelizationMethod::modelAveragingSGD)
+    if (GetParallelizationMethod() == ParallelizationMethod::modelAveragingSGD && m_delayedModelAggregation)
+    {
+        // model averaging is block momentum 0 with block learning rate 1
+        m_pMASGDHelper = make_shared<DelayedBlockMomentumSGD<ElemType>>(m_mpi, traceLevel, devID, 
+                                                                        /*useNesterovMomentum=*/false, /*resetSGDMomentum=*/false, 
+                                                                        /*blockLearningRate=*/1.0, /*blockMomentum=*/0.0);
+    }
+    else if (GetParallelizationMethod() == ParallelizationMethod::modelAveragingSGD)
     {
         m_pMASGDHelper = make_shared<BasicModelAveragingSGD<ElemType>>(m_mpi, traceLevel, devID);
     }
+    else if (GetParallelizationMethod() == ParallelizationMethod::blockMomentumSGD && m_delayedModelAggregation)
+    {
+        m_pMASGDHelper = make_shared<DelayedBlockMomentumSGD<ElemType>>(m_mpi, traceLevel, devID, 
+                                                                        m_useNesterovBlockMomentum, m_resetSGDMomentum, m_blockLearningRate, 
+                                                                        DelayedBlockMomentumSGD<double>::TimeConstant2Momentum(m_blockMomentumAsTimeConstant, m_modelAggregationBlockSize));
+    }
     else if (GetParallelizationMethod() == ParallelizationMethod::blockMomentumSGD)
     {
 #ifndef CNTK_PARALLEL_TRAINING_SUPPORT
@@ -2159,6 +2938,29 @@ void SGD<ElemType>::InitModelAggregationHandler(int traceLevel, DEVICEID_TYPE de
     }
 }
 
+// copies the parameters of the main node into the models of the other workers, with a few large broadcasts
+template <class ElemType>
+void SGD<ElemType>::BroadcastModel(const ComputationNetworkPtr& net)
+{
+    std::vector<Matrix<ElemType>*> values;
+    size_t numElements = 0;
+    for (const auto& node : net->GetNodesWithType(OperationNameOf(LearnableParameter))) // (in the order of the names)
+    {
+        auto parameter = dynamic_pointer_cast<ComputationNode<ElemType>>(node);
+        if (!parameter)
+            continue;
+        values.push_back(&parameter->Value());
+        numElements += parameter->Value().GetNumElements();
+    }
+
+    Timer timer;
+    timer.Start();
+    ParameterBroadcaster<ElemType>(m_mpi, net->GetDeviceId()).Broadcast(values);
+    timer.Stop();
+    LOGPRINTF(stderr, "Broadcast the model of the main node (%d parameters, %.1f MB) in %.3f seconds.\n",
+              (int) values.size(), numElements * sizeof(ElemType) / (1024.0 * 1024.0), timer.ElapsedSeconds());
+}
+
 // public:
 // UpdateWeights() - actual weight update, implementing various update rules
 template <class ElemType>
@@ -2166,7 +2968,7 @@ void SGD<ElemType>::UpdateWeights(Matrix<ElemType>& functionValues, Matrix<ElemT
                                   Matrix<ElemType>& smoothedGradient, double& smoothedCount,
                                   const double learnRatePerSample, const double momentumPerSample,
                                               size_t actualMBSize,
-                                  const double L2RegWeight, const double L1RegWeight,
+                                  const double L2RegWeight, const double L1RegWeight, const double weightDecay,
                                               const bool needAveMultiplier,
                                   const bool useNesterovMomentum) const
 {
@@ -2184,7 +2986,7 @@ void SGD<ElemType>::UpdateWeights(Matrix<ElemType>& functionValues, Matrix<ElemT
     // make actualMBSize is a valid value
     assert(actualMBSize > 0);
 
-    // clipping gradients to prevent outliers
+    // clipping gradients to prevent outliers (by norm, this was done for all of them by ClipGradientNorms())
     ClipGradient(gradientValues, actualMBSize);
 
     GradientsUpdateType adpType = GradUpdateType();
@@ -2199,6 +3001,38 @@ void SGD<ElemType>::UpdateWeights(Matrix<ElemType>& functionValues, Matrix<ElemT
         sgdUpdateNoise.SetGaussianRandomValue(0, (ElemType) noiseStd);
     }
 
+    // Dense gradients are regularized in the pass of the multi-tensor update (of this one parameter), not in passes of their own.
+    // Noise is added before the L1 regularizer, and the average multipliers are not supported there.
+    const bool canFuseRegularization = gradientValues.GetMatrixType() == MatrixType::DENSE && noiseStd == 0 &&
+                                       (adpType == GradientsUpdateType::None || adpType == GradientsUpdateType::FSAdaGrad ||
+                                        (!needAveMultiplier && (adpType == GradientsUpdateType::AdaGrad || adpType == GradientsUpdateType::RmsProp)));
+    if (canFuseRegularization && (L2RegWeight > 0 || L1RegWeight > 0 || weightDecay > 0))
+    {
+        // multiply by actualMBSize so that it's invariant to minibatch size since learning rate is per sample
+        UpdateRegularization<ElemType> regularization;
+        regularization.l2Weight = (ElemType)(L2RegWeight * actualMBSize);
+        regularization.weightDecay = (ElemType)(learnRatePerSample * weightDecay * actualMBSize);
+        regularization.l1Threshold = (ElemType)(learnRatePerSample * L1RegWeight * actualMBSize);
+
+        std::vector<Matrix<ElemType>*> smoothedGradients{ &smoothedGradient }, gradients{ &gradientValues }, parameters{ &functionValues };
+        if (adpType == GradientsUpdateType::None)
+            Matrix<ElemType>::MultiNormalGrad(smoothedGradients, gradients, parameters, (ElemType) learnRatePerSample, (ElemType) momentum, useNesterovMomentum, regularization);
+        else if (adpType == GradientsUpdateType::AdaGrad)
+            Matrix<ElemType>::MultiAdagrad(smoothedGradients, gradients, parameters, (ElemType) learnRatePerSample, regularization);
+        else if (adpType == GradientsUpdateType::FSAdaGrad)
+            Matrix<ElemType>::MultiFSAdagradUpdate(actualMBSize, smoothedGradients, gradients, parameters, { &smoothedCount },
+                                                   learnRatePerSample, m_gradType.targetAdagradAvDenom,
+                                                   momentum, exp(-1.0 * actualMBSize / m_gradType.varianceTimeConstant), regularization);
+        else
+            Matrix<ElemType>::MultiRmsProp(smoothedGradients, gradients, parameters, (ElemType) learnRatePerSample,
+                                           (ElemType) m_rpi.gamma, (ElemType) m_rpi.inc, (ElemType) m_rpi.max,
+                                           (ElemType) m_rpi.dec, (ElemType) m_rpi.min, regularization);
+#if DUMPOUTPUT
+        functionValues.Print("Parameter Update");
+#endif
+        return;
+    }
+
     // L2 regularizer
     if (L2RegWeight > 0)
     {
@@ -2206,6 +3040,10 @@ void SGD<ElemType>::UpdateWeights(Matrix<ElemType>& functionValues, Matrix<ElemT
         Matrix<ElemType>::ScaleAndAdd((ElemType)(L2RegWeight * actualMBSize), functionValues, gradientValues);
     }
 
+    // decoupled weight decay; the update does not depend on the parameter, so it may decay before it
+    if (weightDecay > 0)
+        functionValues *= (ElemType)(1 - learnRatePerSample * weightDecay * actualMBSize);
+
     if (adpType == GradientsUpdateType::None)
     {
         smoothedGradient.NormalGrad(gradientValues, functionValues,
@@ -2261,22 +3099,84 @@ void SGD<ElemType>::UpdateWeights(Matrix<ElemType>& functionValues, Matrix<ElemT
 template <class ElemType>
 void SGD<ElemType>::ClipGradient(Matrix<ElemType>& gradient, const size_t actualMBSize) const
 {
-    if (m_clippingThresholdPerSample != std::numeric_limits<double>::infinity())
+    if (m_clippingThresholdPerSample != std::numeric_limits<double>::infinity() && m_gradientClippingWithTruncation)
     {
         double maxGradientPerMB = m_clippingThresholdPerSample * actualMBSize;
-        if (m_gradientClippingWithTruncation)
-            gradient.InplaceTruncate((ElemType)(maxGradientPerMB));
+        gradient.InplaceTruncate((ElemType)(maxGradientPerMB));
+    }
+}
+
+// protected:
+// Clipping by norm (without truncation) scales gradients down to a norm of at most the threshold times the minibatch size:
+// each gradient by its own norm, or with gradientClippingByGlobalNorm all of them by their joint norm. Matrix::MultiClipByNorm()
+// keeps the norms on the GPU, so that the update is queued without waiting for them.
+template <class ElemType>
+void SGD<ElemType>::ClipGradientNorms(const std::list<ComputationNodeBasePtr>& learnableNodes, const size_t actualMBSize)
+{
+    if (m_clippingThresholdPerSample == std::numeric_limits<double>::infinity() || m_gradientClippingWithTruncation)
+        return;
+
+    // sparse gradients would take the dense ones off the fast path, unless they share a global norm
+    std::vector<Matrix<ElemType>*> denseGradients, sparseGradients;
+    for (const auto& node : learnableNodes)
+    {
+        if (!node->IsParameterUpdateRequired())
+            continue;
+        auto& gradient = dynamic_pointer_cast<ComputationNode<ElemType>>(node)->Gradient();
+        if (gradient.GetMatrixType() == DENSE || m_gradientClippingByGlobalNorm)
+            denseGradients.push_back(&gradient);
         else
+            sparseGradients.push_back(&gradient);
+    }
+    if (denseGradients.empty() && sparseGradients.empty())
+        return;
+
+    if (!m_clippingFactors)
+        m_clippingFactors = make_shared<Matrix<ElemType>>((denseGradients.empty() ? sparseGradients : denseGradients)[0]->GetDeviceId());
+    ElemType maxGradientPerMB = (ElemType) (m_clippingThresholdPerSample * actualMBSize);
+    Matrix<ElemType>::MultiClipByNorm(sparseGradients, maxGradientPerMB, /*globalNorm=*/false, *m_clippingFactors);
+    Matrix<ElemType>::MultiClipByNorm(denseGradients, maxGradientPerMB, m_gradientClippingByGlobalNorm, *m_clippingFactors);
+}
+
+// protected:
+template <class ElemType>
+bool SGD<ElemType>::UnscaleGradients(const std::list<ComputationNodeBasePtr>& learnableNodes)
+{
+    // an overflow anywhere makes the sum of the magnitudes non-finite
+    double sumOfAbsGradients = 0;
+    for (const auto& node : learnableNodes)
+    {
+        if (node->IsParameterUpdateRequired())
+            sumOfAbsGradients += dynamic_pointer_cast<ComputationNode<ElemType>>(node)->Gradient().SumOfAbsElements();
+    }
+
+    if (!std::isfinite(sumOfAbsGradients))
+    {
+        if (m_dynamicLossScaling)
+            m_lossScale = max(m_lossScale / 2, 1.0);
+        m_numUpdatesSinceLossScaleChange = 0;
+        if (m_traceLevel > 0)
+            LOGPRINTF(stderr, "Gradients overflowed, skipping the update; loss scale is now %g.\n", m_lossScale);
+        return false;
+    }
+
+    if (m_lossScale != 1)
+    {
+        for (const auto& node : learnableNodes)
         {
-            // norm2 normalized
-            double gradientNorm = gradient.FrobeniusNorm();
-            if (gradientNorm > maxGradientPerMB)
-            {
-                double normFactor = maxGradientPerMB / gradientNorm;
-                gradient *= (ElemType) normFactor;
-            }
+            if (node->IsParameterUpdateRequired())
+                dynamic_pointer_cast<ComputationNode<ElemType>>(node)->Gradient() *= (ElemType) (1 / m_lossScale);
         }
     }
+
+    if (m_dynamicLossScaling && ++m_numUpdatesSinceLossScaleChange >= m_lossScaleWindow)
+    {
+        m_lossScale *= 2;
+        m_numUpdatesSinceLossScaleChange = 0;
+        if (m_traceLevel > 1)
+            LOGPRINTF(stderr, "No gradient overflow in %d updates; loss scale is now %g.\n", (int) m_lossScaleWindow, m_lossScale);
+    }
+    return true;
 }
 
 template <class ElemType>
@@ -2285,13 +3185,14 @@ void SGD<ElemType>::SaveCheckPointInfo(const size_t epoch, const size_t totalSam
                                        const std::list<Matrix<ElemType>>& smoothedGradients,
                                        const std::vector<double>& smoothedCounts,
                                        const double prevCriterion,
-                                       const size_t minibatchSize)
+                                       const size_t minibatchSize,
+                                       const IntraEpochPosition* intraEpochPosition)
 {
     // In case of parallel training only the main node should we saving the checkpoint to prevent
     // the parallel training nodes from colliding to write the same file
     if ((m_mpi == nullptr) || m_mpi->IsMainNode())
     {
-        wstring checkPointFileName = GetCheckPointFileNameForEpoch(int(epoch));
+        wstring checkPointFileName = intraEpochPosition ? GetIntraEpochCheckPointFileName(int(epoch)) : GetCheckPointFileNameForEpoch(int(epoch));
         // Saving into temporary file and then renaming it to the checkPointFileName
         // This is a standard trick to avoid havign corrupted checkpoints files if process dies during writing
         wstring tempFileName = checkPointFileName + L".tmp";
@@ -2333,6 +3234,13 @@ void SGD<ElemType>::SaveCheckPointInfo(const size_t epoch, const size_t totalSam
             fstream.PutMarker(FileMarker::fileMarkerEndSection, L"ECKP");
             if (m_pMASGDHelper)
                 m_pMASGDHelper->SaveToCheckPoint(fstream);
+
+            if (intraEpochPosition)
+            {
+                fstream.PutMarker(FileMarker::fileMarkerBeginSection, L"BIntraEpoch");
+                fstream << intraEpochPosition->m_samplePosition << intraEpochPosition->m_epochSamples;
+                fstream.PutMarker(FileMarker::fileMarkerEndSection, L"EIntraEpoch");
+            }
             // Ensuring that data is written
             fstream.Flush();
         }
@@ -2342,6 +3250,103 @@ void SGD<ElemType>::SaveCheckPointInfo(const size_t epoch, const size_t totalSam
     }
 }
 
+// Training goes on while the files are written. Only the device-to-host copies are made here; a save that is started
+// while the previous one is still being written waits for it.
+template <class ElemType>
+void SGD<ElemType>::SaveCheckPointInBackground(ComputationNetworkPtr net, const std::wstring& modelName,
+                                               const size_t epoch, const size_t totalSamplesSeen,
+                                               const double learnRatePerSample,
+                                               const std::list<Matrix<ElemType>>& smoothedGradients,
+                                               const std::vector<double>& smoothedCounts,
+                                               const double prevCriterion,
+                                               const size_t minibatchSize,
+                                               const IntraEpochPosition* intraEpochPosition)
+{
+    WaitForCheckPointSave();
+
+    auto snapshot = net->CreateSnapshotForSaving();
+    auto gradients = make_shared<std::list<Matrix<ElemType>>>();
+    for (const auto& smoothedGradient : smoothedGradients)
+        gradients->push_back(smoothedGradient.DeepCloneToCPU());
+
+    bool isIntraEpoch = intraEpochPosition != nullptr;
+    IntraEpochPosition position = isIntraEpoch ? *intraEpochPosition : IntraEpochPosition();
+    m_pendingCheckPointSave = std::async(std::launch::async, [=]()
+    {
+        if (isIntraEpoch) // same order as SaveIntraEpochCheckPoint()
+        {
+            snapshot->Save(modelName);
+            SaveCheckPointInfo(epoch, totalSamplesSeen, learnRatePerSample, *gradients, smoothedCounts, prevCriterion, minibatchSize, &position);
+        }
+        else
+        {
+            SaveCheckPointInfo(epoch, totalSamplesSeen, learnRatePerSample, *gradients, smoothedCounts, prevCriterion, minibatchSize);
+            snapshot->Save(modelName);
+            RemoveIntraEpochCheckPoint(int(epoch));
+        }
+    });
+}
+
+// The model is written before the checkpoint info, so that a checkpoint info file always comes with a model that is
+// at least as new. The totalSamplesSeen and prevCriterion are those of the start of the epoch, as the epoch is
+// continued rather than started again.
+template <class ElemType>
+void SGD<ElemType>::SaveIntraEpochCheckPoint(ComputationNetworkPtr net, const int epoch, const IntraEpochPosition& position,
+                                             const double learnRatePerSample,
+                                             const std::list<Matrix<ElemType>>& smoothedGradients,
+                                             const std::vector<double>& smoothedCounts,
+                                             const size_t minibatchSize)
+{
+    let modelName = GetIntraEpochModelName(epoch);
+    if (m_traceLevel > 0)
+        LOGPRINTF(stderr, "SGD: Saving intra-epoch checkpoint model '%ls' after %d samples%s\n",
+                  modelName.c_str(), (int) position.m_epochSamples, m_asyncCheckPointSave ? " in the background" : "");
+    if (m_asyncCheckPointSave)
+        SaveCheckPointInBackground(net, modelName, epoch, m_samplesSeenBeforeEpoch, learnRatePerSample, smoothedGradients, smoothedCounts, m_prevCriterionBeforeEpoch, minibatchSize, &position);
+    else
+    {
+        net->Save(modelName);
+        SaveCheckPointInfo(epoch, m_samplesSeenBeforeEpoch, learnRatePerSample, smoothedGradients, smoothedCounts, m_prevCriterionBeforeEpoch, minibatchSize, &position);
+    }
+}
+
+// An intra-epoch checkpoint is only used if it is newer than the model the epoch started from; otherwise it is left
+// over from an earlier run.
+template <class ElemType>
+bool SGD<ElemType>::TryLoadIntraEpochCheckPoint(ComputationNetworkPtr net, const int epoch,
+                                                /*out*/ size_t& totalSamplesSeen,
+                                                /*out*/ double& learnRatePerSample,
+                                                std::list<Matrix<ElemType>>& smoothedGradients,
+                                                std::vector<double>& smoothedCounts,
+                                                /*out*/ double& prevCriterion,
+                                                /*out*/ size_t& minibatchSize)
+{
+    let modelName = GetIntraEpochModelName(epoch);
+    let checkPointFileName = GetIntraEpochCheckPointFileName(epoch);
+    if (!fexists(modelName.c_str()) || !msra::files::fuptodate(checkPointFileName, GetModelNameForEpoch(epoch - 1), false))
+        return false;
+
+    LOGPRINTF(stderr, "Resuming epoch %d from intra-epoch checkpoint. Loading parameters from '%ls'.\n", epoch + 1, modelName.c_str());
+    net->RereadPersistableParameters<ElemType>(modelName);
+    LoadCheckPointInfo(epoch, totalSamplesSeen, learnRatePerSample, smoothedGradients, smoothedCounts, prevCriterion, minibatchSize, &m_intraEpochResumePosition);
+    m_intraEpochResumeEpoch = epoch;
+    return true;
+}
+
+template <class ElemType>
+void SGD<ElemType>::RemoveIntraEpochCheckPoint(const int epoch)
+{
+    _wunlink(GetIntraEpochCheckPointFileName(epoch).c_str());
+    _wunlink(GetIntraEpochModelName(epoch).c_str());
+}
+
+template <class ElemType>
+void SGD<ElemType>::WaitForCheckPointSave()
+{
+    if (m_pendingCheckPointSave.valid())
+        m_pendingCheckPointSave.get();
+}
+
 template <class ElemType>
 bool SGD<ElemType>::TryLoadCheckPointInfo(const size_t epochNumber,
                                           /*out*/ size_t& totalSamplesSeen,
@@ -2378,9 +3383,10 @@ void SGD<ElemType>::LoadCheckPointInfo(const size_t epochNumber,
                                        std::list<Matrix<ElemType>>& smoothedGradients,
                                        std::vector<double>& smoothedCounts,
                                        /*out*/ double& prevCriterion,
-                                       /*out*/ size_t& minibatchSize)
+                                       /*out*/ size_t& minibatchSize,
+                                       /*out*/ IntraEpochPosition* intraEpochPosition)
 {
-    let checkPointFileName = GetCheckPointFileNameForEpoch(int(epochNumber));
+    let checkPointFileName = intraEpochPosition ? GetIntraEpochCheckPointFileName(int(epochNumber)) : GetCheckPointFileNameForEpoch(int(epochNumber));
     //fprintf(stderr, "Loading checkpoint info from %ls\n", checkPointFileName.c_str());
     File fstream(checkPointFileName,
                  FileOptions::fileOptionsBinary | FileOptions::fileOptionsRead);
@@ -2434,6 +3440,13 @@ void SGD<ElemType>::LoadCheckPointInfo(const size_t epochNumber,
         m_pMASGDHelper->LoadFromCheckPoint(fstream);
     }
 
+    if (intraEpochPosition)
+    {
+        fstream.GetMarker(FileMarker::fileMarkerBeginSection, L"BIntraEpoch");
+        fstream >> intraEpochPosition->m_samplePosition >> intraEpochPosition->m_epochSamples;
+        fstream.GetMarker(FileMarker::fileMarkerEndSection, L"EIntraEpoch");
+    }
+
     return;
 }
 
@@ -2443,6 +3456,18 @@ wstring SGD<ElemType>::GetCheckPointFileNameForEpoch(const int epoch)
     return GetModelNameForEpoch(epoch) + L".ckp";
 }
 
+template <class ElemType>
+wstring SGD<ElemType>::GetIntraEpochModelName(const int epoch)
+{
+    return GetModelNameForEpoch(epoch) + L".partial";
+}
+
+template <class ElemType>
+wstring SGD<ElemType>::GetIntraEpochCheckPointFileName(const int epoch)
+{
+    return GetIntraEpochModelName(epoch) + L".ckp";
+}
+
 template <class ElemType>
 wstring SGD<ElemType>::GetModelNameForEpoch(const int epoch, bool bLastModel)
 {
@@ -2682,6 +3707,12 @@ SGDParams::SGDParams(const ConfigRecordType& configSGD, size_t sizeofElemType)
     m_minibatchSizeTuningFrequency = configAALR(L"minibatchSizeTuningFrequency", (size_t) 1);
     m_minibatchSizeTuningMax = configAALR(L"minibatchSizeTuningMax", (size_t) 1048576);
     m_minibatchSearchCriterionErrorMargin = configAALR(L"minibatchSearchCriterionErrorMargin", (size_t) 1);
+    m_autoAdjustMinibatchByThroughput = configAALR(L"autoAdjustMinibatchByThroughput", false);
+    m_throughputSearchNumMinibatches = configAALR(L"throughputSearchNumMinibatches", (size_t) 10);
+    m_throughputSearchMemoryBudgetMB = configAALR(L"throughputSearchMemoryBudgetMB", (size_t) 0);
+    m_throughputSearchMargin = configAALR(L"throughputSearchMargin", 5.0);
+    if (m_throughputSearchNumMinibatches == 0)
+        InvalidArgument("throughputSearchNumMinibatches must be at least 1.");
 
     m_numPrevLearnRates = configAALR(L"numPrevLearnRates", (size_t) 5);
     m_numBestSearchEpoch = configAALR(L"numBestSearchEpoch", (size_t) 1);
@@ -2696,6 +3727,11 @@ SGDParams::SGDParams(const ConfigRecordType& configSGD, size_t sizeofElemType)
     m_truncated = configSGD(L"truncated", false);
     m_maxSamplesInRAM = configSGD(L"maxSamplesInRAM", (size_t) SIZE_MAX);
     m_numSubminiBatches = configSGD(L"numSubminibatches", (size_t) 1);
+    m_numGradientAccumulationSteps = configSGD(L"numGradientAccumulationSteps", (size_t) 1);
+    if (m_numGradientAccumulationSteps == 0)
+        InvalidArgument("numGradientAccumulationSteps must be at least 1.");
+    if (m_numGradientAccumulationSteps > 1 && (m_numSubminiBatches > 1 || m_maxSamplesInRAM < SIZE_MAX))
+        InvalidArgument("numGradientAccumulationSteps cannot be combined with numSubminibatches or maxSamplesInRAM.");
 
     if (configAALR.Exists(L"numMiniBatch4LRSearch"))
     {
@@ -2743,9 +3779,29 @@ SGDParams::SGDParams(const ConfigRecordType& configSGD, size_t sizeofElemType)
     m_numMBsToShowResult = configSGD(L"numMBsToShowResult", (size_t)10);
     m_firstMBsToShowResult = configSGD(L"firstMBsToShowResult", (size_t)0);
     m_numMBsToCUDAProfile = configSGD(L"numMBsToCUDAProfile", (size_t)0);
+    m_timelineTraceFile = (const wstring&) configSGD(L"timelineTraceFile", L"");
+    m_numMBsToTrace = configSGD(L"numMBsToTrace", (size_t)10);
+    if (m_timelineTraceFile.empty())
+        m_numMBsToTrace = 0;
+    m_numMBsToProfileNodes = configSGD(L"numMBsToProfileNodes", (size_t)0);
+    m_telemetryPeriod = configSGD(L"telemetryPeriod", 0.0);
+    m_telemetryFile = (const wstring&) configSGD(L"telemetryFile", L"");
+    m_telemetryToLog = configSGD(L"telemetryToLog", m_telemetryFile.empty());
+    m_metricsFile = (const wstring&) configSGD(L"metricsFile", L"");
 
     m_gradientClippingWithTruncation = configSGD(L"gradientClippingWithTruncation", true);
     m_clippingThresholdPerSample = configSGD(L"clippingThresholdPerSample", numeric_limits<double>::infinity());
+    m_gradientClippingByGlobalNorm = configSGD(L"gradientClippingByGlobalNorm", false);
+
+    m_mixedPrecision = configSGD(L"mixedPrecision", false);
+    m_lossScale = configSGD(L"lossScale", m_mixedPrecision ? 65536.0 : 1.0);
+    m_dynamicLossScaling = configSGD(L"dynamicLossScaling", m_mixedPrecision);
+    m_lossScaleWindow = configSGD(L"lossScaleWindow", (size_t)2000);
+    m_numUpdatesSinceLossScaleChange = 0;
+    if (m_lossScale <= 0 || !std::isfinite(m_lossScale))
+        InvalidArgument("lossScale must be a positive number, but is %g.", m_lossScale);
+    if (m_lossScaleWindow == 0)
+        InvalidArgument("lossScaleWindow must be at least 1.");
 
     // sequence-training parameters
     m_hSmoothingWeight = configSGD(L"hSmoothingWeight", 0.95);
@@ -2756,9 +3812,11 @@ SGDParams::SGDParams(const ConfigRecordType& configSGD, size_t sizeofElemType)
     m_seqGammarCalcLMF = configSGD(L"seqGammarLMF", 14.0);
     m_seqGammarCalcbMMIFactor = configSGD(L"seqGammarBMMIFactor", 0.0);
     m_seqGammarCalcWP = configSGD(L"seqGammarWordPen", 0.0);
+    m_seqLatticeCacheMB = configSGD(L"seqLatticeCacheMB", (size_t) 0);
     m_disableRegInBatchNormalization = configSGD(L"disableRegInBatchNormalization", false);
 
     m_dropoutRates = configSGD(L"dropoutRate", ConfigRecordType::Array(doubleargvector(vector<double>{0.0})));
+    m_useCounterBasedDropout = configSGD(L"counterBasedDropout", false);
     m_batchNormalizationTimeConstant = configSGD(L"batchNormalizationTimeConstant", ConfigRecordType::Array(doubleargvector(vector<double>{0})));
     m_batchNormalizationBlendTimeConstant = configSGD(L"batchNormalizationBlendTimeConstant", ConfigRecordType::Array(doubleargvector(vector<double>{0})));
 
@@ -2780,6 +3838,7 @@ SGDParams::SGDParams(const ConfigRecordType& configSGD, size_t sizeofElemType)
     m_needAveMultiplier = configSGD(L"normWithAveMultiplier", true);
     m_L2RegWeight = configSGD(L"L2RegWeight", 0.0);
     m_L1RegWeight = configSGD(L"L1RegWeight", 0.0);
+    m_weightDecay = configSGD(L"weightDecay", 0.0);
 
     // for backward support. future setups should use gradUpdateType='AdaGrad', instead of useAdagrad=true
     if (configSGD(L"useAdagrad", false))
@@ -2798,6 +3857,8 @@ SGDParams::SGDParams(const ConfigRecordType& configSGD, size_t sizeofElemType)
     }
 
     m_useAllDataForPreComputedNode = configSGD(L"UseAllDataForPreComputedNode", true);
+    m_preComputeFromReader = configSGD(L"preComputeFromReader", false);
+    m_preComputeCache = (const wstring&) configSGD(L"preComputeCache", L"");
 
     // consistency checks
     for (size_t i = 0; i < m_mbSize.size(); i++)
@@ -2902,9 +3963,17 @@ SGDParams::SGDParams(const ConfigRecordType& configSGD, size_t sizeofElemType)
     m_numGradientBits = vector<int>{8 * (int)sizeofElemType}; // means no quantization
     m_zeroThresholdFor1Bit = true;
     m_bufferedAsyncGradientAggregation = false;
+    m_overlapGradientAggregation = false;
+    m_gradientAggregationBucketSizeInMB = 25;
+    m_numBackupWorkers = 0;
+    m_topKGradientPercent = 0;
+    m_adaptiveGradientBits = false;
+    m_adaptiveGradientBitsBudget = 2;
+    m_adaptiveGradientBitsTargetError = 0.25;
     m_enableDistributedMBReading = false;
     m_parallelizationStartEpochNum = 0;
     m_modelAggregationBlockSize = 0; 
+    m_delayedModelAggregation = false;
 
     if (configSGD.Exists(L"ParallelTrain"))
     {
@@ -2935,6 +4004,24 @@ SGDParams::SGDParams(const ConfigRecordType& configSGD, size_t sizeofElemType)
             m_numGradientBits = configDataParallelSGD(L"gradientBits", ConfigRecordType::Array(intargvector(vector<int>{defaultGradientBits})));
             m_zeroThresholdFor1Bit = configDataParallelSGD(L"useZeroThresholdFor1BitQuantization", true);
             m_bufferedAsyncGradientAggregation = configDataParallelSGD(L"useBufferedAsyncGradientAggregation", false);
+            m_overlapGradientAggregation = configDataParallelSGD(L"overlapGradientAggregation", false);
+            m_gradientAggregationBucketSizeInMB = configDataParallelSGD(L"gradientAggregationBucketSizeInMB", (size_t)25);
+            m_numBackupWorkers = configDataParallelSGD(L"numBackupWorkers", (size_t)0);
+            m_topKGradientPercent = configDataParallelSGD(L"topKGradientPercent", 0.0);
+            if (m_topKGradientPercent < 0 || m_topKGradientPercent > 100)
+                InvalidArgument("topKGradientPercent must be in the range [0, 100].");
+            m_adaptiveGradientBits = configDataParallelSGD(L"adaptiveGradientBits", false);
+            m_adaptiveGradientBitsBudget = configDataParallelSGD(L"adaptiveGradientBitsBudget", 2.0);
+            m_adaptiveGradientBitsTargetError = configDataParallelSGD(L"adaptiveGradientBitsTargetError", 0.25);
+            if (m_adaptiveGradientBits)
+            {
+                if (configDataParallelSGD.Exists(L"gradientBits"))
+                    InvalidArgument("gradientBits cannot be combined with adaptiveGradientBits, which chooses them.");
+                if (m_adaptiveGradientBitsBudget < 1 || m_adaptiveGradientBitsBudget > QuantizationBitAllocator::MaxBits)
+                    InvalidArgument("adaptiveGradientBitsBudget must be in the range [1, %d].", (int) QuantizationBitAllocator::MaxBits);
+                // 1 bit until the first adaptation; this also makes SGD set up quantized aggregation
+                m_numGradientBits = vector<int>{1};
+            }
             for (size_t i = 0; i < m_numGradientBits.size(); i++)
             {
                 if (m_numGradientBits[i] < 1 || m_numGradientBits[i] > defaultGradientBits)
@@ -2973,13 +4060,16 @@ SGDParams::SGDParams(const ConfigRecordType& configSGD, size_t sizeofElemType)
                 fprintf(stderr, "WARNING: option syncPeroid in ModelAveragingSGD is going to be deprecated. Please use blockSizePerWorker instead in the future.\n");
             }
 #endif
+            m_delayedModelAggregation = configMASGD(L"delayedSync", false);
         }
         if (configParallelTrain.Exists(L"BlockMomentumSGD"))
         {
-#ifndef CNTK_PARALLEL_TRAINING_SUPPORT
-            InvalidArgument("BlockMomentumSGD is not enabled in this version.\n");
-#else
             const ConfigRecordType& configBMSGD(configParallelTrain(L"BlockMomentumSGD", ConfigRecordType::Record()));
+            m_delayedModelAggregation = configBMSGD(L"delayedSync", false);
+#ifndef CNTK_PARALLEL_TRAINING_SUPPORT
+            if (!m_delayedModelAggregation)
+                InvalidArgument("BlockMomentumSGD is not enabled in this version, only its delayed variant (delayedSync=true).\n");
+#endif
             if (configBMSGD.Exists(L"blockSize") && configBMSGD.Exists(L"blockSizePerWorker"))
                 InvalidArgument("It is only allowed to set blockSizePerWorker or blockSize, not both of them");
             else if (configBMSGD.Exists(L"blockSizePerWorker"))
@@ -3017,15 +4107,14 @@ SGDParams::SGDParams(const ConfigRecordType& configSGD, size_t sizeofElemType)
             else if (configBMSGD.Exists(L"blockMomentumPerSync"))
             {
                 double blockMomentum = configBMSGD(L"blockMomentumPerSync");
-                m_blockMomentumAsTimeConstant = BlockMomentumSGD<double>::Momentum2TimeConstant(blockMomentum, m_modelAggregationBlockSize);
+                m_blockMomentumAsTimeConstant = DelayedBlockMomentumSGD<double>::Momentum2TimeConstant(blockMomentum, m_modelAggregationBlockSize);
             }
 #endif 
             else /*if (!configBMSGD.Exists(L"blockMomentumPerSync") && !configBMSGD.Exists(L"blockMomentumAsTimeConstant"))*/
             {
                 double blockMomentum = 1.0 - 1.0 / (double)numMPIWorkers;   // this is a default value which ensures each block update contributes equally
-                m_blockMomentumAsTimeConstant = BlockMomentumSGD<double>::Momentum2TimeConstant(blockMomentum, m_modelAggregationBlockSize);
+                m_blockMomentumAsTimeConstant = DelayedBlockMomentumSGD<double>::Momentum2TimeConstant(blockMomentum, m_modelAggregationBlockSize);
             }
-#endif 
         }
 
         if (configParallelTrain.Exists(L"DataParallelASGD"))
@@ -3037,6 +4126,15 @@ SGDParams::SGDParams(const ConfigRecordType& configSGD, size_t sizeofElemType)
             m_nSyncSamplesPerWorker = configDataParallelASGD(L"syncPeriod", ConfigRecordType::Array(intargvector(vector<int>{256})));
             m_isAsyncBufferEnabled = configDataParallelASGD(L"UsePipeline", false);
             m_isSimulateMA = configDataParallelASGD(L"SimModelAverage", false); // using parameter server-based version of ModelAveragingSGD
+            // parameters with at least this many columns (e.g. embeddings) only push and pull the columns they changed since the last sync
+            m_asgdSparseSyncMinColumns = configDataParallelASGD(L"sparseSyncMinColumns", (size_t)0);
+            m_asgdSparseSyncFullPullPeriod = configDataParallelASGD(L"sparseSyncFullPullPeriod", (size_t)10);
+            // stale synchronous parallel: a worker more than stalenessBound syncs ahead of the slowest one waits for it
+            m_asgdStalenessBound = configDataParallelASGD(L"stalenessBound", (size_t)0);
+            m_asgdAdaptiveStaleness = configDataParallelASGD(L"adaptiveStaleness", false);
+            m_asgdMaxStalenessBound = configDataParallelASGD(L"maxStalenessBound", (size_t)0);
+            if (m_asgdAdaptiveStaleness && m_asgdStalenessBound == 0)
+                InvalidArgument("adaptiveStaleness requires a stalenessBound.");
             if (configDataParallelASGD.Exists(L"AdjustLearningRateAtBeginning")) // adjust learning rate per m_adjustNumInBatch minibatchs until to original one,
                                                                                  // this option could be used to takcle the unstableness of DataParallelASGD if you get a chance
             {
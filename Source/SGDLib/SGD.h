@@ -16,10 +16,12 @@
 #include "fileutil.h"
 #include "Config.h"
 #include <chrono>
+#include <future>
 #include <random>
 #include "Profiler.h"
 #include "MASGD.h"
 #include "ASGDHelper.h"
+#include "TrainingMetrics.h"
 using namespace std; // ugh! TODO: get rid of this from .h files!!!
 
 #define CNTK_CHECKPOINT_VERSION_1 1     // 1 -> no version number 
@@ -186,6 +188,10 @@ protected:
     // default is 1, which means no subminibatch is used
     // if m_maxTempMemSizeInSamples = SIZE_MAX (which means users do not specify the option) and m_numSubminiBatches > 1
     // we divide one minibatch to m_numSubminiBatches subMinibatches
+    size_t m_numGradientAccumulationSteps;
+    // alternative to sub-minibatches that does not read the full minibatch at once: the reader delivers
+    // m_numGradientAccumulationSteps smaller minibatches whose gradients are summed in place, and the
+    // aggregation and model update are then done once for all of them, as for one minibatch of m_mbSize[epoch]
 
     // the number of samples in each epoch (0 means, use all the samples in each epoch).
     size_t m_epochSize;
@@ -196,6 +202,19 @@ protected:
 
     bool m_gradientClippingWithTruncation;
     double m_clippingThresholdPerSample;
+    bool m_gradientClippingByGlobalNorm; // without truncation: clip the norm of all gradients together instead of the one of each
+
+    // mixed precision: float products on the GPU are computed in half precision (see EnableHalfPrecisionGEMM()),
+    // while parameters, gradients and the update stay in single precision
+    bool m_mixedPrecision;
+    // the criterion gradient is multiplied by the loss scale, and the parameter gradients divided by it before the update,
+    // so that small gradients are not flushed to zero in half precision
+    double m_lossScale;
+    // with dynamic loss scaling, gradients that overflowed skip the update and halve the loss scale,
+    // which doubles again after m_lossScaleWindow updates without overflow
+    bool m_dynamicLossScaling;
+    size_t m_lossScaleWindow;
+    size_t m_numUpdatesSinceLossScaleChange;
 
     intargvector m_numSamples4Search;
     size_t m_numBestSearchEpoch;
@@ -224,7 +243,15 @@ protected:
     size_t m_minibatchSizeTuningFrequency;
     size_t m_minibatchSizeTuningMax;
 
+    // throughput-based minibatch size search at start-up, see SearchForFastestMinibatchSize()
+    bool m_autoAdjustMinibatchByThroughput;
+    size_t m_throughputSearchNumMinibatches;
+    size_t m_throughputSearchMemoryBudgetMB;        // 0: 90% of the GPU memory, no limit on the CPU
+    double m_throughputSearchMargin;                // in percent of the best throughput
+
     doubleargvector m_dropoutRates;
+    // dropout masks recomputed from a counter-based RNG in backprop instead of stored, see DropoutNode
+    bool m_useCounterBasedDropout;
     doubleargvector m_batchNormalizationTimeConstant;
     doubleargvector m_batchNormalizationBlendTimeConstant;
     size_t m_maxTempMemSizeInSamplesForCNN;
@@ -241,6 +268,17 @@ protected:
     size_t m_numMBsToShowResult = 0;
     size_t m_firstMBsToShowResult = 0;
     int m_numMBsToCUDAProfile;
+    // Chrome trace-event timeline of the first m_numMBsToTrace minibatches, see TimelineTracer
+    std::wstring m_timelineTraceFile;
+    int m_numMBsToTrace;
+    // per-node forward/backward times of the first m_numMBsToProfileNodes minibatches, see ComputationNodeProfiler
+    size_t m_numMBsToProfileNodes;
+    // gauges sampled every m_telemetryPeriod seconds (0: never), logged and/or written as a Prometheus text file, see Telemetry
+    double m_telemetryPeriod;
+    std::wstring m_telemetryFile;
+    bool m_telemetryToLog;
+    // JSON lines of the training progress of every log interval and epoch, see TrainingMetrics
+    std::wstring m_metricsFile;
 
     bool m_doGradientCheck;
     double m_gradientCheckSigDigit;
@@ -248,6 +286,8 @@ protected:
     bool m_doUnitTest;
 
     bool m_useAllDataForPreComputedNode;
+    bool m_preComputeFromReader;    // accumulate Mean and InvStdDev of inputs directly from the reader, see InputStatistics.h
+    std::wstring m_preComputeCache; // file to keep the statistics of m_preComputeFromReader in, for trainings on the same data
 
     int m_perfTraceLevel;
 
@@ -274,7 +314,19 @@ protected:
     // Data parallel SGD training parameters
     intargvector m_numGradientBits;
     bool m_bufferedAsyncGradientAggregation;
+    // start exchanging the gradients during backprop
+    bool m_overlapGradientAggregation;
+    // gradients smaller than this are exchanged together, packed into buffers of about this size (0: one exchange per parameter)
+    size_t m_gradientAggregationBucketSizeInMB;
+    // aggregate the gradients of all but this many workers, the slowest ones, see SimpleDistGradAggregator
+    size_t m_numBackupWorkers;
     bool m_zeroThresholdFor1Bit;
+    // send only this percentage of the entries of each gradient, those of largest magnitude, instead of quantizing (0: off)
+    double m_topKGradientPercent;
+    // choose 1, 2, 4 or 8 bits for each gradient from its quantization error, see QuantizationBitAllocator
+    bool m_adaptiveGradientBits;
+    double m_adaptiveGradientBitsBudget;
+    double m_adaptiveGradientBitsTargetError;
 
     // Parallel training related with MA / BM
     size_t m_modelAggregationBlockSize;
@@ -282,10 +334,13 @@ protected:
     bool   m_useNesterovBlockMomentum;
     double m_blockLearningRate; 
     double m_blockMomentumAsTimeConstant;
+    // overlap the model aggregation with the local training of the next block, see DelayedBlockMomentumSGD
+    bool   m_delayedModelAggregation;
 
     bool m_needAveMultiplier;
     double m_L2RegWeight;
     double m_L1RegWeight;
+    double m_weightDecay; // decoupled weight decay, scaled like m_L2RegWeight
 
     // Parallel training related with ASGD 
     intargvector m_nSyncSamplesPerWorker;
@@ -294,6 +349,11 @@ protected:
     AdjustLearningRateAtBeginning m_adjustLearningRateAtBeginning;
     double m_adjustCoefficient;
     size_t m_adjustPerMinibatches;
+    size_t m_asgdSparseSyncMinColumns;
+    size_t m_asgdSparseSyncFullPullPeriod;
+    size_t m_asgdStalenessBound;
+    bool m_asgdAdaptiveStaleness;
+    size_t m_asgdMaxStalenessBound;
 
     // sequence training
     double m_hSmoothingWeight;
@@ -304,6 +364,7 @@ protected:
     double m_seqGammarCalcWP;
     double m_seqGammarCalcbMMIFactor;
     bool m_seqGammarCalcUsesMBR;
+    size_t m_seqLatticeCacheMB; // GPU memory for lattices kept across minibatches
     
     // decide whether should apply regularization into BatchNormalizationNode
     // true: disable Regularization
@@ -335,12 +396,28 @@ public:
           // TODO: The next few do not belong into SGD any more than the network or reader we operate on. Either move network and reader in here, or move these out.
           m_modelPath((const wstring&) configSGD(L"modelPath")),
           m_keepCheckPointFiles(configSGD(L"keepCheckPointFiles", false)),
+          m_asyncCheckPointSave(configSGD(L"asyncCheckPointSave", false)),
+          m_intraEpochCheckPointSamples(configSGD(L"intraEpochCheckPointSamples", (size_t)0)),
+          m_intraEpochCheckPointMinutes(configSGD(L"intraEpochCheckPointMinutes", 0.0)),
+          m_intraEpochResumeEpoch(-1),
+          m_samplesSeenBeforeEpoch(0),
+          m_prevCriterionBeforeEpoch(0),
           m_trainCriterionNodeName((const wstring&) configSGD(L"trainCriterionNodeName", L"")),
           m_evalCriterionNodeName ((const wstring&) configSGD(L"evalCriterionNodeName", L"")),
           m_traceNodeNamesReal    (configSGD(L"traceNodeNamesReal",     ConfigRecordType::Array(stringargvector()))),
           m_traceNodeNamesCategory(configSGD(L"traceNodeNamesCategory", ConfigRecordType::Array(stringargvector()))),
           m_traceNodeNamesSparse  (configSGD(L"traceNodeNamesSparse",   ConfigRecordType::Array(stringargvector()))),
+          m_activationCheckpointNodeNames(configSGD(L"activationCheckpointNodes", ConfigRecordType::Array(stringargvector()))),
+          m_activationCheckpointInterval(configSGD(L"activationCheckpointInterval", (size_t)0)),
+          m_activationOffloadNodeNames(configSGD(L"activationOffloadNodes", ConfigRecordType::Array(stringargvector()))),
+          m_activationOffloadMinSampleSize(configSGD(L"activationOffloadMinSampleSize", (size_t)0)),
+          m_inPlaceActivations(configSGD(L"inPlaceActivations", false)),
+          m_eliminateRowStack(configSGD(L"eliminateRowStack", false)),
+          m_absorbTranspose(configSGD(L"absorbTranspose", false)),
+          m_pipelineStageNodeNames(configSGD(L"pipelineStageNodes", ConfigRecordType::Array(stringargvector()))),
+          m_pipelineDeviceIds(configSGD(L"pipelineDevices", ConfigRecordType::Array(intargvector()))),
           m_prevChosenMinibatchSize(0),
+          m_throughputChosenMinibatchSize(0),
           m_lastFinishedEpochTrainLoss(0.0),
           m_distGradAgg(nullptr),
           m_gradHeader(nullptr)
@@ -363,6 +440,19 @@ public:
             m_parallelizationMethod = ParallelizationMethod::none;
         }
 
+    // The configuration of the training data, which the entries of m_preComputeCache are valid for.
+    // Without it (e.g. with BrainScript, where the reader configuration has no text form), the cache is not used.
+    void SetPreComputeCacheKey(const std::string& key)
+    {
+        m_preComputeCacheKey = key;
+    }
+
+    // Receives the progress of every log interval and epoch, instead of the 'metricsFile' of the configuration.
+    void SetTrainingMetricsWriter(const TrainingMetricsWriterPtr& writer)
+    {
+        m_metricsWriter = writer;
+    }
+
     void Train(shared_ptr<ComputationNetwork> net, DEVICEID_TYPE deviceId,
                IDataReader* trainSetDataReader,
                IDataReader* validationSetDataReader, int startEpoch, bool loadNetworkFromCheckpoint);
@@ -461,6 +551,23 @@ protected:
                                       std::list<Matrix<ElemType>>& smoothedGradients, std::vector<double> smoothedCounts,
                                       const size_t minMinibatchSize, const size_t maxMinibatchSize);
 
+    // trains a few minibatches with doubling minibatch sizes and times them; then picks the largest one
+    // that fits into the memory budget and is about as fast (in samples per second) as the fastest one
+    size_t SearchForFastestMinibatchSize(ComputationNetworkPtr net,
+                                         ComputationNetworkPtr refNet,
+                                         const ComputationNodeBasePtr& refNode,
+                                         const int epochNumber,
+                                         IDataReader* trainSetDataReader,
+                                         const double learnRatePerSample,
+                                         const size_t initialMinibatchSize,
+                                         const std::vector<ComputationNodeBasePtr>& featureNodes,
+                                         const std::vector<ComputationNodeBasePtr>& labelNodes,
+                                         const std::vector<ComputationNodeBasePtr>& criterionNodes,
+                                         const std::vector<ComputationNodeBasePtr>& evaluationNodes,
+                                         StreamMinibatchInputs* inputMatrices,
+                                         const std::list<ComputationNodeBasePtr>& learnableNodes,
+                                         std::list<Matrix<ElemType>>& smoothedGradients, std::vector<double> smoothedCounts);
+
     // Attemps to compute the error signal for the whole utterance, which will
     // be fed to the neural network as features. Currently it is a workaround
     // for the two-forward-pass sequence and ctc training, which allows
@@ -493,13 +600,14 @@ protected:
 
     void InitDistGradAgg(int numEvalNodes, int numGradientBits, int deviceId, int traceLevel);
     void InitModelAggregationHandler(int traceLevel, DEVICEID_TYPE devID);
+    void BroadcastModel(const ComputationNetworkPtr& net);
 public:
     // UpdateWeights() - actual weight update, implementing various update rules
     void UpdateWeights(Matrix<ElemType>& functionValues, Matrix<ElemType>& gradientValues,
                        Matrix<ElemType>& smoothedGradient, double& smoothedCount,
                        const double learnRatePerSample, const double momentumPerSample,
                        size_t actualMBSize,
-                       const double L2RegWeight, const double L1RegWeight,
+                       const double L2RegWeight, const double L1RegWeight, const double weightDecay,
                        const bool needAveMultiplier,
                        const bool useNesterovMomentum) const;
     // return -1 if nothing exists
@@ -509,13 +617,26 @@ public:
 
 protected:
     void ClipGradient(Matrix<ElemType>& gradient, const size_t actualMBSize) const;
+    void ClipGradientNorms(const std::list<ComputationNodeBasePtr>& learnableNodes, const size_t actualMBSize);
+
+    // divides the gradients by the loss scale; returns false if they overflowed, and adjusts the loss scale
+    bool UnscaleGradients(const std::list<ComputationNodeBasePtr>& learnableNodes);
+
+    // where an epoch stood when an intra-epoch checkpoint was written
+    struct IntraEpochPosition
+    {
+        size_t m_samplePosition = 0; // of the reader, on its global timeline
+        size_t m_epochSamples = 0;   // trained on in this epoch so far
+    };
 
+    // with an IntraEpochPosition, the checkpoint is the intra-epoch one of that epoch
     void SaveCheckPointInfo(const size_t epoch, const size_t totalSamplesSeen, // TODO: combine totalSamplesSeen and prevCriterion into a EpochCriterion type
                             const double learnRatePerSample,
                             const std::list<Matrix<ElemType>>& smoothedGradients,
                             const std::vector<double>& smoothedCounts,
                             const double prevCriterion,
-                            const size_t minibatchSize);
+                            const size_t minibatchSize,
+                            const IntraEpochPosition* intraEpochPosition = nullptr);
 
     bool TryLoadCheckPointInfo(const size_t epochNumber,
                                /*out*/ size_t& totalSamplesSeen,
@@ -530,9 +651,39 @@ protected:
                             std::list<Matrix<ElemType>>& smoothedGradients,
                             std::vector<double>& smoothedCounts,
                             /*out*/ double& prevCriterion,
-                            /*out*/ size_t& minibatchSize);
+                            /*out*/ size_t& minibatchSize,
+                            /*out*/ IntraEpochPosition* intraEpochPosition = nullptr);
+
+    // copies the model and the checkpoint state to the CPU and writes both on a background thread
+    void SaveCheckPointInBackground(ComputationNetworkPtr net, const std::wstring& modelName,
+                                    const size_t epoch, const size_t totalSamplesSeen,
+                                    const double learnRatePerSample,
+                                    const std::list<Matrix<ElemType>>& smoothedGradients,
+                                    const std::vector<double>& smoothedCounts,
+                                    const double prevCriterion,
+                                    const size_t minibatchSize,
+                                    const IntraEpochPosition* intraEpochPosition = nullptr);
+    // waits for the checkpoint being written by SaveCheckPointInBackground(), if any, and rethrows its error
+    void WaitForCheckPointSave();
+
+    // intra-epoch checkpoints: the model and checkpoint info in the middle of an epoch, with the reader position
+    void SaveIntraEpochCheckPoint(ComputationNetworkPtr net, const int epoch, const IntraEpochPosition& position,
+                                  const double learnRatePerSample,
+                                  const std::list<Matrix<ElemType>>& smoothedGradients,
+                                  const std::vector<double>& smoothedCounts,
+                                  const size_t minibatchSize);
+    bool TryLoadIntraEpochCheckPoint(ComputationNetworkPtr net, const int epoch,
+                                     /*out*/ size_t& totalSamplesSeen,
+                                     /*out*/ double& learnRatePerSample,
+                                     std::list<Matrix<ElemType>>& smoothedGradients,
+                                     std::vector<double>& smoothedCounts,
+                                     /*out*/ double& prevCriterion,
+                                     /*out*/ size_t& minibatchSize);
+    void RemoveIntraEpochCheckPoint(const int epoch);
 
     wstring GetCheckPointFileNameForEpoch(const int epoch);
+    wstring GetIntraEpochModelName(const int epoch);
+    wstring GetIntraEpochCheckPointFileName(const int epoch);
 
     GradientsUpdateType GradUpdateType() const
     {
@@ -554,16 +705,54 @@ public:
 protected:
     std::wstring m_modelPath;
     bool m_keepCheckPointFiles;
+    bool m_asyncCheckPointSave; // write the epoch checkpoints on a background thread while training continues
+    std::future<void> m_pendingCheckPointSave;
+
+    size_t m_intraEpochCheckPointSamples; // write an intra-epoch checkpoint every so many samples (0: never)
+    double m_intraEpochCheckPointMinutes; // ... or every so many minutes (0: never)
+    int m_intraEpochResumeEpoch;          // epoch to continue from m_intraEpochResumePosition, or -1
+    IntraEpochPosition m_intraEpochResumePosition;
+    // the parts of the intra-epoch checkpoint info that TrainOneEpoch() does not know, as of the start of the epoch
+    size_t m_samplesSeenBeforeEpoch;
+    double m_prevCriterionBeforeEpoch;
 
     std::wstring m_trainCriterionNodeName;
     std::wstring m_evalCriterionNodeName;
 
+    std::string m_preComputeCacheKey;
+
+    TrainingMetricsWriterPtr m_metricsWriter; // from SetTrainingMetricsWriter() or for m_metricsFile
+
     // enable tracing. Nodes listed here get their m_traceNodeValueXXX flags set
     std::vector<std::wstring> m_traceNodeNamesReal;
     std::vector<std::wstring> m_traceNodeNamesCategory;
     std::vector<std::wstring> m_traceNodeNamesSparse;
 
+    // activation checkpointing: only the values of these nodes (and of every N-th node) are kept for backprop, the rest is recomputed
+    std::vector<std::wstring> m_activationCheckpointNodeNames;
+    size_t m_activationCheckpointInterval;
+
+    // activation offloading: the values of these nodes (and of all nodes with samples of at least this many elements)
+    // wait in page-locked host memory between forward prop and backprop
+    std::vector<std::wstring> m_activationOffloadNodeNames;
+    size_t m_activationOffloadMinSampleSize;
+
+    // compute activations like ReLU or Sigmoid in place over their input where backprop does not need it, see ComputationNetwork::EnableInPlaceExecution()
+    bool m_inPlaceActivations;
+
+    // products by a RowStack of several towers are computed from the towers, see ComputationNetwork::EnableRowStackElimination()
+    bool m_eliminateRowStack;
+
+    // products by a Transpose of weights read the weights with swapped strides, see ComputationNetwork::EnableTransposeAbsorption()
+    bool m_absorbTranspose;
+
+    // pipeline parallelism: the network is split into stages after each of these nodes, which run on these GPUs (one
+    // more than nodes), and each minibatch is trained as numSubminibatches micro-batches, see ComputationNetwork::CreatePipelined()
+    std::vector<std::wstring> m_pipelineStageNodeNames;
+    intargvector m_pipelineDeviceIds;
+
     size_t m_prevChosenMinibatchSize;
+    size_t m_throughputChosenMinibatchSize; // 0 unless SearchForFastestMinibatchSize() has run
     double m_lastFinishedEpochTrainLoss;
 
     std::shared_ptr<IDistGradAggregator<ElemType>> m_distGradAgg;
@@ -571,6 +760,8 @@ protected:
 
     shared_ptr<IMASGD<ElemType>> m_pMASGDHelper;
 
+    shared_ptr<Matrix<ElemType>> m_clippingFactors; // of the last minibatch, on the device, see ClipGradientNorms()
+
 private:
     void MarkDropoutNodesEvalTimeStampAsOutdated(const ComputationNetworkPtr& net, const ComputationNodeBasePtr& criterionNode);
     std::shared_ptr<ASGDHelper<ElemType>> m_pASGDHelper;
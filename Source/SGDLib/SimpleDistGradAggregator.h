@@ -12,7 +12,10 @@
 #include <future>
 #include "GPUDataTransferer.h"
 #include "TimerUtility.h"
+#include "TimelineTracer.h"
 #include "MatrixQuantizerImpl.h"
+#include <chrono>
+#include <climits>
 
 namespace Microsoft { namespace MSR { namespace CNTK {
 
@@ -22,12 +25,33 @@ class SimpleDistGradAggregator : public IDistGradAggregator<ElemType>
     UsingIDistGradAggregatorMembers;
 
 public:
-    SimpleDistGradAggregator(const MPIWrapperPtr& mpi, bool useAsyncAggregation, int deviceId, int syncStatsTrace)
-        : IDistGradAggregator<ElemType>(mpi), m_useAsyncAggregation(useAsyncAggregation), m_initialized(false), m_bufferedGradHeader(nullptr), m_syncStatsTrace(syncStatsTrace), m_iterationCount(0), m_nccl(deviceId, mpi)
-    {}
+    // Gradients smaller than 'bucketSizeInBytes' are exchanged together in buckets of about that size (0 for one per gradient).
+    // With 'overlapAggregation' the exchange of the buckets starts during backprop, see OnGradientComputed(). It is not used
+    // with async aggregation, which already overlaps the exchange with the next minibatch.
+    // With 'numBackupWorkers' > 0 the gradients are aggregated without waiting for the slowest workers, see
+    // AggregateGradientsWithBackupWorkers(); neither async nor overlapped aggregation is used then.
+    SimpleDistGradAggregator(const MPIWrapperPtr& mpi, bool useAsyncAggregation, int deviceId, int syncStatsTrace, bool overlapAggregation = false, size_t bucketSizeInBytes = 0,
+                             size_t numBackupWorkers = 0)
+        : IDistGradAggregator<ElemType>(mpi), m_useAsyncAggregation(useAsyncAggregation), m_initialized(false), m_bufferedGradHeader(nullptr), m_syncStatsTrace(syncStatsTrace), m_iterationCount(0), m_nccl(deviceId, mpi),
+          m_overlapAggregation(overlapAggregation && !useAsyncAggregation && numBackupWorkers == 0), m_bucketSizeInBytes(bucketSizeInBytes), m_deviceId(deviceId), m_nextBucketToCopy(0), m_nextBucketToReduce(0),
+          m_numBackupWorkers(numBackupWorkers), m_numBackupSteps(0), m_backupSendRequest(MPI_REQUEST_NULL)
+    {
+        if (m_numBackupWorkers > 0 && m_useAsyncAggregation)
+            InvalidArgument("SimpleDistGradAggregator: backup workers cannot be combined with buffered async gradient aggregation.");
+        if (m_numBackupWorkers >= NumProc())
+            InvalidArgument("SimpleDistGradAggregator: the number of backup workers (%d) must be less than the number of workers (%d).", (int) m_numBackupWorkers, (int) NumProc());
+    }
 
     ~SimpleDistGradAggregator()
     {
+        // The last messages of workers that were late in the last step are received but not aggregated anymore,
+        // so that their sends complete.
+        if (!m_backupRecvRequests.empty())
+            MPI_Waitall(m_backupRecvRequests.size(), m_backupRecvRequests.data(), MPI_STATUSES_IGNORE);
+        for (auto& requests : m_backupResultRequests)
+            MPI_Waitall(requests.size(), requests.data(), MPI_STATUSES_IGNORE);
+        MPI_Wait(&m_backupSendRequest, MPI_STATUS_IGNORE);
+
         for (size_t i = 0; i < m_recvHeaders.size(); ++i)
             DistGradHeader::Destroy(m_recvHeaders[i]);
 
@@ -116,6 +140,11 @@ public:
 
             return false;
         }
+        else if (m_numBackupWorkers > 0)
+        {
+            AggregateGradientsWithBackupWorkers(gradients, headerCPU, showSyncPerfStats);
+            return (headerCPU->numSamples != 0);
+        }
         else
         {
             AggregateGradientsImpl(gradients, headerCPU, showSyncPerfStats);
@@ -123,7 +152,38 @@ public:
         }
     }
 
+    // Starts exchanging the buckets of gradients that are all final, in the same order on all workers.
+    // Before the first AggregateGradients() the buckets are not known yet, and the call is ignored.
+    void OnGradientComputed(Matrix<ElemType>* gradient) override
+    {
+        if (!m_overlapAggregation || !m_initialized)
+            return;
+        auto iter = m_gradientIndices.find(gradient);
+        if (iter == m_gradientIndices.end() || m_gradientComputed[iter->second])
+            return;
+
+        m_gradientComputed[iter->second] = true;
+        m_buckets[m_bucketOfGradient[iter->second]].m_numComputed++;
+        StartBucketExchanges(m_gradients, /*wait=*/false);
+    }
+
 private:
+    // A group of gradients exchanged together, see IDistGradAggregator::GroupIntoBuckets().
+    struct GradientBucket
+    {
+        std::vector<size_t> m_gradientIndices;
+        size_t m_numElements = 0;
+        std::shared_ptr<ElemType> m_cpuBuffer;           // with CPU staging: the gradients of the bucket, one after the other
+        std::unique_ptr<GPUDataTransferer> m_transferer; // with CPU staging
+        std::unique_ptr<Matrix<ElemType>> m_fusionBuffer; // otherwise, for more than one gradient: the gradients of the bucket as one row
+        std::vector<MPI_Request> m_requests;             // without NCCL
+        MPIWrapper::HierarchicalAllReduceRequest m_hierarchicalRequest; // instead, with multiple hosts, see MPIWrapper::UseHierarchicalAllReduce()
+        size_t m_numComputed = 0;                        // gradients of the bucket that are final for the current minibatch
+        std::chrono::steady_clock::time_point m_startTime;
+        bool m_reductionCompleted = false;               // found completed during backprop, at m_completionTime
+        std::chrono::steady_clock::time_point m_completionTime;
+    };
+
     std::shared_ptr<ElemType> AllocateIntermediateBuffer(int deviceID, size_t numElements)
     {
         assert(deviceID >= 0);
@@ -144,7 +204,9 @@ private:
             m_initialized = true;
             int deviceId = gradients[0]->GetDeviceId();
 
-            if (!m_nccl.IsSupported() && deviceId != CPUDEVICE)
+            m_deviceId = deviceId;
+
+            if (UseCPUStaging())
                 m_allocator.reset(new CUDAPageLockedMemAllocator(deviceId));
 
             for (size_t i = 0; i < gradients.size(); i++)
@@ -153,16 +215,12 @@ private:
                 if (gradients[i]->GetMatrixType() != DENSE)
                     RuntimeError("Gradient aggregation for sparse gradient matrices is currently unsupported!");
 
-                if (!m_nccl.IsSupported() && deviceId != CPUDEVICE)
-                {
-                    m_gpuDataTransferers.push_back(std::make_unique<GPUDataTransferer>(deviceId, m_useAsyncAggregation));
-                    m_intermediateCPUBuffers.push_back(AllocateIntermediateBuffer(deviceId, gradients[i]->GetNumElements()));
-                }
-
                 if (m_useAsyncAggregation)
                     m_bufferedGradients[gradients[i]].reset(new Matrix<ElemType>(gradients[i]->GetNumRows(), gradients[i]->GetNumCols(), deviceId));
             }
 
+            CreateBuckets(gradients);
+
             if (m_useAsyncAggregation)
             {
                 m_bufferedGradHeader = DistGradHeader::Create(numEvalNodes);
@@ -196,6 +254,7 @@ private:
     {
         Timer aggregationTimer;
         int deviceId = gradients[0]->GetDeviceId();
+        TimelineEvent event("Aggregation", "AggregateGradients", deviceId);
         if (showSyncPerfStats)
         {
             std::unique_ptr<MatrixComputeStreamEvent> mainStreamSyncEvent(MatrixComputeStreamEvent::Create(deviceId));
@@ -223,13 +282,29 @@ private:
             }
         }
 
-        // Initiate transfer of the gradient matrices to the CPU if needed
-        if (!m_nccl.IsSupported() && deviceId >= 0)
+        // the buckets whose exchange started during backprop
+        size_t numOverlappedBuckets = m_nextBucketToCopy;
+        if (numOverlappedBuckets > 0 && headerCPU->numSamples == 0)
+            LogicError("SimpleDistGradAggregator: Gradients were handed over in a minibatch without samples.");
+        double overlappedSeconds = 0;
+        size_t numOverlappedElements = 0, numElements = 0;
+        auto backpropEndTime = std::chrono::steady_clock::now();
+        for (size_t b = 0; b < m_buckets.size(); b++)
         {
-            for (size_t i = 0; i < numGradMatrices; ++i)
-                m_gpuDataTransferers[i]->CopyGPUToCPUAsync(gradients[i]->Data(), gradients[i]->GetNumElements(), m_intermediateCPUBuffers[i].get());
+            auto& bucket = m_buckets[b];
+            if (b < numOverlappedBuckets)
+            {
+                auto endTime = bucket.m_reductionCompleted ? bucket.m_completionTime : backpropEndTime;
+                overlappedSeconds += std::chrono::duration<double>(endTime - bucket.m_startTime).count();
+                numOverlappedElements += bucket.m_numElements;
+            }
+            numElements += bucket.m_numElements;
+            bucket.m_numComputed = bucket.m_gradientIndices.size(); // all gradients are final now
         }
 
+        // Initiate transfer of the gradient matrices to the CPU if needed, and the allreduce of those already there
+        StartBucketExchanges(gradients, /*wait=*/false);
+
         // Initiate receive of the header on the main node
         std::vector<MPI_Request> recvHeaderRequests(NumProc() - 1);
         if (m_mpi->IsMainNode())
@@ -248,26 +323,7 @@ private:
             MPI_Isend(headerCPU, headerCPU->Size(), MPI_CHAR, m_mpi->MainNodeRank(), numGradMatrices, m_mpi->Communicator(), &sendHeaderRequest) || MpiFail("MPI_Isend");
 
         // Perform async allreduce on the gradient data
-        std::vector<MPI_Request> allReduceRequests(numGradMatrices);
-        if (!m_nccl.IsSupported())
-        {
-            for (size_t i = 0; i < numGradMatrices; ++i)
-            {
-                ElemType* reductionBuffer = gradients[i]->Data();
-                if (deviceId >= 0)
-                {
-                    m_gpuDataTransferers[i]->WaitForCopyGPUToCPUAsync();
-                    reductionBuffer = m_intermediateCPUBuffers[i].get();
-                }
-
-                // On Windows this async MPI_Iallreduce call requires MS MPI v7 or higher to be installed
-                MPI_Iallreduce(MPI_IN_PLACE, reductionBuffer, gradients[i]->GetNumElements(),
-                               MPIWrapper::GetDataType(reductionBuffer), MPI_SUM,
-                               m_mpi->Communicator(), &allReduceRequests[i]) || MpiFail("MPI_Iallreduce");
-            }
-        }
-        else
-            m_nccl.AllReduce(gradients);
+        StartBucketExchanges(gradients, /*wait=*/true);
 
         // On the main node wait for the headers to arrive and aggregate
         if (m_mpi->IsMainNode())
@@ -310,11 +366,23 @@ private:
         // Wait for the allreduce operations to finish and initiate transfer back to the GPU if needed
         if (!m_nccl.IsSupported())
         {
-            for (size_t i = 0; i < numGradMatrices; ++i)
+            for (auto& bucket : m_buckets)
             {
-                MPI_Wait(&allReduceRequests[i], MPI_STATUSES_IGNORE) || MpiFail("MPI_Wait");
-                if (deviceId >= 0)
-                    m_gpuDataTransferers[i]->CopyCPUToGPUAsync(m_intermediateCPUBuffers[i].get(), gradients[i]->GetNumElements(), gradients[i]->Data());
+                if (m_mpi->UseHierarchicalAllReduce())
+                    m_mpi->WaitHierarchicalAllReduce(&bucket.m_hierarchicalRequest);
+                else
+                    MPI_Waitall(bucket.m_requests.size(), bucket.m_requests.data(), MPI_STATUSES_IGNORE) || MpiFail("MPI_Waitall");
+                if (bucket.m_fusionBuffer)
+                    UnpackFusionBuffer(bucket, gradients);
+                else if (UseCPUStaging())
+                {
+                    size_t offset = 0;
+                    for (size_t i : bucket.m_gradientIndices)
+                    {
+                        bucket.m_transferer->CopyCPUToGPUAsync(bucket.m_cpuBuffer.get() + offset, gradients[i]->GetNumElements(), gradients[i]->Data());
+                        offset += gradients[i]->GetNumElements();
+                    }
+                }
             }
         }
 
@@ -324,11 +392,18 @@ private:
 
         // Wait for all the transfers to finish
         if (m_nccl.IsSupported())
+        {
             m_nccl.Sync();
+            for (auto& bucket : m_buckets)
+            {
+                if (bucket.m_fusionBuffer)
+                    UnpackFusionBuffer(bucket, gradients);
+            }
+        }
         else if (deviceId >= 0)
         {
-            for (size_t i = 0; i < numGradMatrices; ++i)
-                m_gpuDataTransferers[i]->WaitForCopyCPUToGPUAsync();
+            for (auto& bucket : m_buckets)
+                bucket.m_transferer->WaitForCopyCPUToGPUAsync();
         }
 
         // Wait for completion of the async send requests
@@ -337,19 +412,374 @@ private:
         else
             MPI_Waitall(sendAggHeaderRequests.size(), sendAggHeaderRequests.data(), MPI_STATUSES_IGNORE) || MpiFail("MPI_Waitall");
 
+        // ready for the next minibatch
+        for (auto& bucket : m_buckets)
+        {
+            bucket.m_numComputed = 0;
+            bucket.m_reductionCompleted = false;
+        }
+        m_gradientComputed.assign(m_gradientComputed.size(), false);
+        m_nextBucketToCopy = 0;
+        m_nextBucketToReduce = 0;
+
         if (showSyncPerfStats)
         {
             aggregationTimer.Stop();
             double gradientAggregationTime = aggregationTimer.ElapsedSeconds();
             fprintf(stderr, "Actual gradient aggregation time: %.6g\n", gradientAggregationTime);
+            if (m_overlapAggregation)
+            {
+                // the time the exchange of each bucket was in flight before backprop ended, summed over the buckets
+                fprintf(stderr, "Overlapped gradient aggregation: %d of %d buckets (%.3g of %.3g MB) started during backprop, in flight for %.6g s before its end\n",
+                        (int) numOverlappedBuckets, (int) m_buckets.size(),
+                        numOverlappedElements * sizeof(ElemType) / 1e6, numElements * sizeof(ElemType) / 1e6, overlappedSeconds);
+            }
+        }
+    }
+
+    // Synchronous SGD with backup workers (Chen et al., "Revisiting Distributed Synchronous SGD", 2016): the main node
+    // sums the gradients of the first NumProc() - m_numBackupWorkers workers to finish, itself included, and sends the
+    // sum and the aggregated header to all of them. An allreduce would have to wait for every worker, so the gradients
+    // and headers go to the main node and back in one message per worker instead, which puts the traffic of all workers
+    // on the main node. A late message is aggregated in the next step, together with the header of its samples, and the
+    // main node waits for it there, so that no worker falls behind by more than one step; the late worker does not
+    // wait, as the result of the step is already on its way to it. All workers apply the same sums in the same order,
+    // so that the models stay the same; the gradient of a late worker is one step stale.
+    void AggregateGradientsWithBackupWorkers(const std::vector<Matrix<ElemType>*>& gradients, DistGradHeader* headerCPU, bool showSyncPerfStats)
+    {
+        Timer aggregationTimer;
+        if (showSyncPerfStats)
+            aggregationTimer.Start();
+
+        // The message is the header, padded to the alignment of the gradients, and the gradients one after the other.
+        size_t headerSize = (headerCPU->Size() + sizeof(double) - 1) / sizeof(double) * sizeof(double);
+        size_t numElements = 0;
+        for (auto gradient : gradients)
+            numElements += gradient->GetNumElements();
+        size_t messageSize = headerSize + numElements * sizeof(ElemType);
+        if (messageSize > INT_MAX)
+            RuntimeError("SimpleDistGradAggregator: the gradients are too large for backup workers (%d MB).", (int) (messageSize >> 20));
+
+        // A worker without samples contributes zero gradients.
+        if (headerCPU->numSamples == 0)
+        {
+            for (auto gradient : gradients)
+                gradient->SetValue(0);
+        }
+
+        int numOthers = (int) NumProc() - 1;
+        int messageTag = (int) gradients.size() * 2 + 2;
+        int resultTag = messageTag + 1;
+
+        if (!m_mpi->IsMainNode())
+        {
+            // The send of the last step has to complete before its buffer is reused.
+            MPI_Wait(&m_backupSendRequest, MPI_STATUS_IGNORE) || MpiFail("MPI_Wait");
+            m_backupSendBuffer.resize(messageSize);
+            PackBackupMessage(gradients, headerCPU, m_backupSendBuffer.data(), headerSize);
+            MPI_Isend(m_backupSendBuffer.data(), (int) messageSize, MPI_CHAR, m_mpi->MainNodeRank(), messageTag, m_mpi->Communicator(), &m_backupSendRequest) || MpiFail("MPI_Isend");
+
+            m_backupResultBuffers[0].resize(messageSize);
+            MPI_Recv(m_backupResultBuffers[0].data(), (int) messageSize, MPI_CHAR, m_mpi->MainNodeRank(), resultTag, m_mpi->Communicator(), MPI_STATUS_IGNORE) || MpiFail("MPI_Recv");
+            UnpackBackupMessage(m_backupResultBuffers[0].data(), headerSize, gradients, headerCPU);
+        }
+        else
+        {
+            if (m_backupRecvRequests.empty())
+            {
+                m_backupRecvBuffers.resize(numOthers, std::vector<char>(messageSize));
+                m_backupRecvRequests.resize(numOthers, MPI_REQUEST_NULL);
+                m_backupLate.resize(numOthers, false);
+                m_backupNumLate.resize(numOthers, 0);
+            }
+
+            // Receives are posted for the messages of this step; those of late workers are still pending.
+            // Posting them only now leaves none pending for the workers that are done at the end of the training.
+            for (int j = 0; j < numOthers; j++)
+            {
+                if (m_backupRecvRequests[j] == MPI_REQUEST_NULL)
+                    PostBackupReceive(j, messageTag);
+            }
+
+            // Waits for the first workers, and for those that were late in the last step.
+            size_t numRequired = numOthers - m_numBackupWorkers;
+            std::vector<bool> arrived(numOthers, false);
+            size_t numArrived = 0;
+            auto mustWait = [&]()
+            {
+                if (numArrived < numRequired)
+                    return true;
+                for (int j = 0; j < numOthers; j++)
+                {
+                    if (m_backupLate[j] && !arrived[j])
+                        return true;
+                }
+                return false;
+            };
+            while (mustWait())
+            {
+                int idx = MPI_UNDEFINED;
+                MPI_Waitany(numOthers, m_backupRecvRequests.data(), &idx, MPI_STATUS_IGNORE) || MpiFail("MPI_Waitany");
+                if (idx == MPI_UNDEFINED)
+                    LogicError("SimpleDistGradAggregator: no gradients of the workers to wait for.");
+                arrived[idx] = true;
+                numArrived++;
+            }
+
+            // Messages that are there already are aggregated as well.
+            std::vector<int> indices(numOthers);
+            int numCompleted = 0;
+            MPI_Testsome(numOthers, m_backupRecvRequests.data(), &numCompleted, indices.data(), MPI_STATUSES_IGNORE) || MpiFail("MPI_Testsome");
+            for (int k = 0; k < numCompleted && numCompleted != MPI_UNDEFINED; k++)
+                arrived[indices[k]] = true;
+
+            // The result buffer of two steps ago is reused: a worker that was late then has received it by now.
+            auto& result = m_backupResultBuffers[m_numBackupSteps % 2];
+            auto& resultRequests = m_backupResultRequests[m_numBackupSteps % 2];
+            MPI_Waitall(resultRequests.size(), resultRequests.data(), MPI_STATUSES_IGNORE) || MpiFail("MPI_Waitall");
+            result.resize(messageSize);
+            PackBackupMessage(gradients, headerCPU, result.data(), headerSize);
+
+            ElemType* sum = (ElemType*) (result.data() + headerSize);
+            for (int j = 0; j < numOthers; j++)
+            {
+                m_backupLate[j] = !arrived[j];
+                if (!arrived[j])
+                {
+                    m_backupNumLate[j]++;
+                    continue;
+                }
+
+                headerCPU->Aggregate((DistGradHeader*) m_backupRecvBuffers[j].data(), true);
+                const ElemType* gradient = (const ElemType*) (m_backupRecvBuffers[j].data() + headerSize);
+#pragma omp parallel for
+                for (long long i = 0; i < (long long) numElements; i++)
+                    sum[i] += gradient[i];
+            }
+            memcpy(result.data(), headerCPU, headerCPU->Size());
+            UnpackBackupMessage(result.data(), headerSize, gradients, nullptr);
+
+            resultRequests.resize(numOthers);
+            for (int j = 0; j < numOthers; j++)
+            {
+                int dest = (j >= MyRank()) ? (j + 1) : j;
+                MPI_Isend(result.data(), (int) messageSize, MPI_CHAR, dest, resultTag, m_mpi->Communicator(), &resultRequests[j]) || MpiFail("MPI_Isend");
+            }
+            m_numBackupSteps++;
+        }
+
+        if (showSyncPerfStats)
+        {
+            aggregationTimer.Stop();
+            fprintf(stderr, "Actual gradient aggregation time: %.6g\n", aggregationTimer.ElapsedSeconds());
+            if (m_mpi->IsMainNode())
+            {
+                // Workers that are late most of the time point to a problem with their node.
+                fprintf(stderr, "Backup workers: late workers in %d steps:", (int) m_numBackupSteps);
+                for (int j = 0; j < numOthers; j++)
+                {
+                    if (m_backupNumLate[j] > 0)
+                        fprintf(stderr, " rank %d %d times%s", (j >= MyRank()) ? (j + 1) : j, (int) m_backupNumLate[j], m_backupNumLate[j] * 2 > m_numBackupSteps ? " (chronically)" : "");
+                }
+                fprintf(stderr, "\n");
+            }
+        }
+    }
+
+    void PostBackupReceive(int j, int tag)
+    {
+        int source = (j >= MyRank()) ? (j + 1) : j;
+        auto& buffer = m_backupRecvBuffers[j];
+        MPI_Irecv(buffer.data(), (int) buffer.size(), MPI_CHAR, source, tag, m_mpi->Communicator(), &m_backupRecvRequests[j]) || MpiFail("MPI_Irecv");
+    }
+
+    static void PackBackupMessage(const std::vector<Matrix<ElemType>*>& gradients, const DistGradHeader* header, char* message, size_t headerSize)
+    {
+        memcpy(message, header, header->Size());
+        ElemType* data = (ElemType*) (message + headerSize);
+        for (auto gradient : gradients)
+        {
+            gradient->CopySection(gradient->GetNumRows(), gradient->GetNumCols(), data, gradient->GetNumRows());
+            data += gradient->GetNumElements();
+        }
+    }
+
+    // 'header' may be null if only the gradients are needed.
+    static void UnpackBackupMessage(char* message, size_t headerSize, const std::vector<Matrix<ElemType>*>& gradients, DistGradHeader* header)
+    {
+        if (header)
+            header->Aggregate((DistGradHeader*) message);
+        ElemType* data = (ElemType*) (message + headerSize);
+        for (auto gradient : gradients)
+        {
+            gradient->SetValue(gradient->GetNumRows(), gradient->GetNumCols(), gradient->GetDeviceId(), data);
+            data += gradient->GetNumElements();
+        }
+    }
+
+    // Without NCCL, gradients on the GPU are exchanged through a page-locked buffer per bucket.
+    bool UseCPUStaging()
+    {
+        return !m_nccl.IsSupported() && m_deviceId != CPUDEVICE;
+    }
+
+    // Groups the gradients into buckets, in the reverse order of the gradients, which is about the order in which backprop completes them.
+    void CreateBuckets(const std::vector<Matrix<ElemType>*>& gradients)
+    {
+        m_gradients = gradients;
+        m_bucketOfGradient.resize(gradients.size());
+        m_gradientComputed.assign(gradients.size(), false);
+
+        std::vector<size_t> order(gradients.size());
+        for (size_t i = 0; i < order.size(); i++)
+            order[i] = order.size() - 1 - i;
+        for (const auto& gradientIndices : GroupIntoBuckets(gradients, order, m_bucketSizeInBytes))
+        {
+            m_buckets.emplace_back();
+            auto& bucket = m_buckets.back();
+            bucket.m_gradientIndices = gradientIndices;
+            for (size_t i : gradientIndices)
+            {
+                bucket.m_numElements += gradients[i]->GetNumElements();
+                m_bucketOfGradient[i] = m_buckets.size() - 1;
+                m_gradientIndices[gradients[i]] = i;
+            }
+
+            if (UseCPUStaging())
+            {
+                bucket.m_transferer = std::make_unique<GPUDataTransferer>(m_deviceId, m_useAsyncAggregation);
+                bucket.m_cpuBuffer = AllocateIntermediateBuffer(m_deviceId, bucket.m_numElements);
+            }
+            else if (gradientIndices.size() > 1)
+                bucket.m_fusionBuffer = std::make_unique<Matrix<ElemType>>(1, bucket.m_numElements, m_deviceId);
+
+            if (!m_nccl.IsSupported())
+                bucket.m_requests.resize(1, MPI_REQUEST_NULL);
+        }
+    }
+
+    // the memory a bucket is reduced in
+    ElemType* ReductionBuffer(const GradientBucket& bucket, const std::vector<Matrix<ElemType>*>& gradients)
+    {
+        if (bucket.m_cpuBuffer)
+            return bucket.m_cpuBuffer.get();
+        if (bucket.m_fusionBuffer)
+            return bucket.m_fusionBuffer->Data();
+        return gradients[bucket.m_gradientIndices[0]]->Data();
+    }
+
+    // copies the gradients of a bucket into its fusion buffer, and back (on the compute stream)
+    void PackFusionBuffer(GradientBucket& bucket, const std::vector<Matrix<ElemType>*>& gradients)
+    {
+        size_t offset = 0;
+        for (size_t i : bucket.m_gradientIndices)
+        {
+            size_t numElements = gradients[i]->GetNumElements();
+            bucket.m_fusionBuffer->SetColumnSlice(gradients[i]->Reshaped(1, numElements), offset, numElements);
+            offset += numElements;
+        }
+    }
+
+    void UnpackFusionBuffer(GradientBucket& bucket, const std::vector<Matrix<ElemType>*>& gradients)
+    {
+        size_t offset = 0;
+        for (size_t i : bucket.m_gradientIndices)
+        {
+            size_t numElements = gradients[i]->GetNumElements();
+            gradients[i]->AssignValuesOf(bucket.m_fusionBuffer->ColumnSlice(offset, numElements).Reshaped(gradients[i]->GetNumRows(), gradients[i]->GetNumCols()));
+            offset += numElements;
+        }
+    }
+
+    // Starts the exchange of the buckets whose gradients are all final, in bucket order, since the workers must
+    // issue their collectives in the same order. A bucket on the GPU is copied to the CPU first; with 'wait'
+    // this waits for the copies, otherwise the allreduce of a bucket is started once its copy has completed.
+    void StartBucketExchanges(const std::vector<Matrix<ElemType>*>& gradients, bool wait)
+    {
+        for (; m_nextBucketToCopy < m_buckets.size(); m_nextBucketToCopy++)
+        {
+            auto& bucket = m_buckets[m_nextBucketToCopy];
+            if (bucket.m_numComputed < bucket.m_gradientIndices.size())
+                break;
+
+            bucket.m_startTime = std::chrono::steady_clock::now();
+            if (bucket.m_fusionBuffer)
+                PackFusionBuffer(bucket, gradients);
+
+            if (m_nccl.IsSupported())
+            {
+                if (bucket.m_fusionBuffer)
+                    m_nccl.AllReduce(std::vector<Matrix<ElemType>*>{ bucket.m_fusionBuffer.get() });
+                else
+                    m_nccl.AllReduce(std::vector<Matrix<ElemType>*>{ gradients[bucket.m_gradientIndices[0]] });
+                m_nextBucketToReduce = m_nextBucketToCopy + 1;
+            }
+            else if (UseCPUStaging())
+            {
+                size_t offset = 0;
+                for (size_t i : bucket.m_gradientIndices)
+                {
+                    bucket.m_transferer->CopyGPUToCPUAsync(gradients[i]->Data(), gradients[i]->GetNumElements(), bucket.m_cpuBuffer.get() + offset);
+                    offset += gradients[i]->GetNumElements();
+                }
+            }
+        }
+
+        for (; m_nextBucketToReduce < m_nextBucketToCopy; m_nextBucketToReduce++)
+        {
+            auto& bucket = m_buckets[m_nextBucketToReduce];
+            if (UseCPUStaging())
+            {
+                if (!wait && !bucket.m_transferer->IsCopyGPUToCPUAsyncComplete())
+                    break;
+                bucket.m_transferer->WaitForCopyGPUToCPUAsync();
+            }
+
+            // On Windows this async MPI_Iallreduce call requires MS MPI v7 or higher to be installed
+            ElemType* reductionBuffer = ReductionBuffer(bucket, gradients);
+            if (m_mpi->UseHierarchicalAllReduce())
+                m_mpi->HierarchicalAllReduceAsync(reductionBuffer, bucket.m_numElements, &bucket.m_hierarchicalRequest);
+            else
+                MPI_Iallreduce(MPI_IN_PLACE, reductionBuffer, bucket.m_numElements,
+                               MPIWrapper::GetDataType(reductionBuffer), MPI_SUM,
+                               m_mpi->Communicator(), &bucket.m_requests[0]) || MpiFail("MPI_Iallreduce");
+        }
+
+        // during backprop, give MPI a chance to progress the reductions in flight, and note the ones that completed
+        if (wait || m_nccl.IsSupported())
+            return;
+        for (size_t b = 0; b < m_nextBucketToReduce; b++)
+        {
+            auto& bucket = m_buckets[b];
+            if (bucket.m_reductionCompleted)
+                continue;
+            int completed = 0;
+            if (m_mpi->UseHierarchicalAllReduce())
+                completed = m_mpi->TestHierarchicalAllReduce(&bucket.m_hierarchicalRequest);
+            else
+                MPI_Testall(bucket.m_requests.size(), bucket.m_requests.data(), &completed, MPI_STATUSES_IGNORE) || MpiFail("MPI_Testall");
+            if (completed)
+            {
+                bucket.m_reductionCompleted = true;
+                bucket.m_completionTime = std::chrono::steady_clock::now();
+            }
         }
     }
 
 private:
     std::unique_ptr<CUDAPageLockedMemAllocator> m_allocator;
-    std::vector<std::shared_ptr<ElemType>> m_intermediateCPUBuffers;
 
-    std::vector<std::unique_ptr<GPUDataTransferer>> m_gpuDataTransferers;
+    std::vector<GradientBucket> m_buckets; // in the order they are exchanged
+    std::vector<size_t> m_bucketOfGradient;
+    std::vector<bool> m_gradientComputed;
+    std::vector<Matrix<ElemType>*> m_gradients; // the gradients OnGradientComputed() refers to
+    std::unordered_map<const Matrix<ElemType>*, size_t> m_gradientIndices;
+    size_t m_nextBucketToCopy;   // buckets before this one are being exchanged (or copied for it)
+    size_t m_nextBucketToReduce; // buckets before this one have their allreduce started
+
+    bool m_overlapAggregation;
+    size_t m_bucketSizeInBytes;
+    int m_deviceId;
 
     std::vector<DistGradHeader*> m_recvHeaders;
 
@@ -371,5 +801,17 @@ private:
     bool m_initialized;
 
     NcclComm m_nccl;
+
+    // See AggregateGradientsWithBackupWorkers().
+    size_t m_numBackupWorkers;
+    size_t m_numBackupSteps;
+    std::vector<std::vector<char>> m_backupRecvBuffers; // on the main node, one message per other worker
+    std::vector<MPI_Request> m_backupRecvRequests;
+    std::vector<bool> m_backupLate;                     // whether the message of a worker was not aggregated in the last step
+    std::vector<size_t> m_backupNumLate;                // steps in which that happened
+    std::vector<char> m_backupResultBuffers[2];         // the results of the last two steps on the main node
+    std::vector<MPI_Request> m_backupResultRequests[2];
+    std::vector<char> m_backupSendBuffer;               // on the other workers
+    MPI_Request m_backupSendRequest;
 };
 } } }
@@ -100,7 +100,6 @@ public:
 
         m_net->StartEvaluateMinibatchLoop(evalNodes);
 
-        std::vector<Matrix<ElemType>*> learnParamsGradients;
         DataReaderHelpers::SubminibatchDispatcher<ElemType> smbDispatcher;
         size_t numSubminibatchesNeeded = DataReaderHelpers::GetNumSubminibatchesNeeded<ElemType>(dataReader, m_maxSamplesInRAM, m_numSubminiBatches, mbSize);
 
@@ -116,21 +115,29 @@ public:
 
         const size_t numIterationsBeforePrintingProgress = 100;
         size_t numItersSinceLastPrintOfProgress = 0;
-        bool noMoreSamplesToProcess = false;
         for (;;)
         {
             size_t actualMBSize = 0;
             bool wasDataRead = DataReaderHelpers::GetMinibatchIntoNetwork<ElemType>(*dataReader, m_net, nullptr, useDistributedMBReading, useParallelTrain, inputMatrices, actualMBSize, m_mpi);
-            // in case of distributed reading, we do a few more loops until all ranks have completed
             // end of epoch
-            if (!wasDataRead && (!useDistributedMBReading || noMoreSamplesToProcess)) 
+            // In case of distributed reading, ranks may see different numbers of minibatches. Since results are only
+            // aggregated at the end of the pass, each rank can stop as soon as its own data is exhausted.
+            // Row-sharded nodes exchange data with all workers though, so then all of them continue until the last one is done.
+            if (useParallelTrain && m_net->HasRowShardedParameters())
+            {
+                int anyDataRead = wasDataRead ? 1 : 0;
+                m_mpi->AllReduce(&anyDataRead, 1, MPI_MAX);
+                if (!anyDataRead)
+                    break;
+                if (!wasDataRead) // (nothing to accumulate)
+                {
+                    m_net->PropagateRowShardedNodesWithoutData(evalNodes, nullptr, /*backprop=*/false);
+                    continue;
+                }
+            }
+            else if (!wasDataRead)
                 break;
 
-            // Note: If !wasDataRead then the data that GetMinibatchIntoNetwork() was supposed to full in are undefined.
-            // Must not touch them.
-            if (!wasDataRead)
-                actualMBSize = 0; // (undefined if !wasDataRead)
-
             if (actualMBSize > 0)
             {
 
@@ -155,62 +162,16 @@ public:
             if (actualNumSubminibatches > 1)
                 smbDispatcher.DoneWithCurrentMinibatch();
             } // if (actualMBSize > 0)
+            else if (m_net->HasRowShardedParameters())
+                m_net->PropagateRowShardedNodesWithoutData(evalNodes, nullptr, /*backprop=*/false);
 
             // BUGBUG (Issue #95): Once we have multiple layouts, this must be done on a per-node basis.
-            size_t numSamplesWithLabel = wasDataRead ? m_net->GetNumSamplesWithLabelOfNetwork(actualMBSize) : 0;
-            size_t aggregateNumSamplesWithLabel = numSamplesWithLabel;
+            size_t numSamplesWithLabel = m_net->GetNumSamplesWithLabelOfNetwork(actualMBSize);
             if (useParallelTrain)
             {
-                if (m_gradHeader == nullptr)
-                {
-                    m_gradHeader.reset(DistGradHeader::Create(evalNodes.size()), [](DistGradHeader* ptr) {
-                        DistGradHeader::Destroy(ptr);
-                    });
-
-                    if (Globals::UseV2Aggregator())
-                        m_distGradAgg = make_shared<V2SimpleDistGradAggregator<ElemType>>(m_mpi, false /*useAsyncAggregation*/, 0 /*syncStatsTrace*/, ::CNTK::MPICommunicator());
-                    else 
-                        m_distGradAgg = make_shared<SimpleDistGradAggregator<ElemType>>(m_mpi, false /*useAsyncAggregation*/, m_net->GetDeviceId(), 0 /*syncStatsTrace*/);
-                }
-
-                m_gradHeader->numEvalNode = evalNodes.size();
-                m_gradHeader->numSamples = actualMBSize;
-                m_gradHeader->numSamplesWithLabel = numSamplesWithLabel;
-                m_gradHeader->criterion = 0.0; // (not used here)
+                // accumulate locally (on the device); the results of all workers are aggregated once at the end of the pass
                 for (size_t i = 0; i < evalNodes.size(); i++)
-                    m_gradHeader->evalErrors[i] = localEpochEvalErrors.Assign(i, numSamplesWithLabel).GetCriterion(i);
-
-                // TODO: We are reusing the aggregation logic inside SimpleDistGradAggregator, which has a heavy dependency
-                // on the gradient matrix. At some point we should refactor the aggregator class to be able to only calculating
-                // eval results and then remove this hack.
-                if (learnParamsGradients.size() == 0)
-                {
-                    Matrix<ElemType>* matrix = new Matrix<ElemType>((DEVICEID_TYPE)m_net->GetDeviceId());
-                    learnParamsGradients.push_back(matrix);
-                }
-
-                // Using SimpleDistAggregator for eval results only. At some point we should rename the class to be just
-                // IDistAggregator and SimpleDistAggregator.
-                bool samplesProcessed = m_distGradAgg->AggregateGradients(learnParamsGradients, m_gradHeader.get(), /*resetState =*/ false);
-                noMoreSamplesToProcess = !samplesProcessed;
-
-                aggregateNumSamplesWithLabel = m_gradHeader->numSamplesWithLabel;
-                for (size_t i = 0; i < evalResults.size(); i++)
-                {
-                    if (ContainsAccumulatedResult(evalNodes[i]))
-                    {
-                        // We don't accumulate error in epoch criterion as this node has already accumulated error for
-                        // all samples that passed through network in forward pass.
-                        if (samplesProcessed)
-                        {
-                            evalResults[i] = m_gradHeader->evalErrors[i];
-                        }
-                        // else: no samples processed, no aggregation happened -> we do not want to override current value
-                        // with 0.
-                    }
-                    else
-                        evalResults[i] += m_gradHeader->evalErrors[i];
-                }
+                    localEpochEvalErrors.Add(i, numSamplesWithLabel);
             }
             else
             {
@@ -231,15 +192,18 @@ public:
                 }
             }
 
-            totalEpochSamples += aggregateNumSamplesWithLabel;
+            totalEpochSamples += numSamplesWithLabel;
             numMBsRun++;
 
             if (m_traceLevel > 0)
             {
-                numSamplesLastLogged += aggregateNumSamplesWithLabel;
+                numSamplesLastLogged += numSamplesWithLabel;
 
                 if (numMBsRun <= m_firstMBsToShowResult || (m_numMBsToShowResult && (numMBsRun % m_numMBsToShowResult == 0)))
                 {
+                    // in parallel mode, progress is that of this worker, so that logging does not need to communicate
+                    if (useParallelTrain)
+                        GetLocalEvalResults(localEpochEvalErrors, evalResults);
                     DisplayEvalStatistics(numMBsRunLastLogged + 1, numMBsRun, numSamplesLastLogged, evalNodes, evalResults, evalResultsLastLogged);
 
                     for (int i = 0; i < evalResults.size(); i++)
@@ -266,12 +230,18 @@ public:
             dataReader->DataEnd();
         }
 
+        if (useParallelTrain)
+            GetLocalEvalResults(localEpochEvalErrors, evalResults);
+
         // show last batch of results
         if (m_traceLevel > 0 && numSamplesLastLogged > 0)
         {
             DisplayEvalStatistics(numMBsRunLastLogged + 1, numMBsRun, numSamplesLastLogged, evalNodes, evalResults, evalResultsLastLogged);
         }
 
+        if (useParallelTrain)
+            totalEpochSamples = AggregateEvalResults(evalResults, totalEpochSamples);
+
         if (useParallelTrain && !evalNodesWhichAccumulateResult.empty())
         {
             // Each worker contains accumulated values for part of the data set, we have to aggregate accumulated values
@@ -291,6 +261,52 @@ public:
     }
 
 protected:
+    static void GetLocalEvalResults(const CriterionAccumulator<ElemType>& localEpochEvalErrors, vector<EpochCriterion>& evalResults)
+    {
+        for (size_t i = 0; i < evalResults.size(); i++)
+            evalResults[i] = localEpochEvalErrors.GetCriterion(i);
+    }
+
+    // Sum up the eval results and sample counts of all workers in a single aggregation.
+    // Returns the total number of samples.
+    size_t AggregateEvalResults(vector<EpochCriterion>& evalResults, size_t numSamplesWithLabel)
+    {
+        if (m_gradHeader == nullptr)
+        {
+            m_gradHeader.reset(DistGradHeader::Create(evalResults.size()), [](DistGradHeader* ptr) {
+                DistGradHeader::Destroy(ptr);
+            });
+
+            if (Globals::UseV2Aggregator())
+                m_distGradAgg = make_shared<V2SimpleDistGradAggregator<ElemType>>(m_mpi, false /*useAsyncAggregation*/, 0 /*syncStatsTrace*/, ::CNTK::MPICommunicator());
+            else
+                m_distGradAgg = make_shared<SimpleDistGradAggregator<ElemType>>(m_mpi, false /*useAsyncAggregation*/, m_net->GetDeviceId(), 0 /*syncStatsTrace*/);
+        }
+
+        m_gradHeader->numEvalNode = evalResults.size();
+        m_gradHeader->numSamples = numSamplesWithLabel;
+        m_gradHeader->numSamplesWithLabel = numSamplesWithLabel;
+        m_gradHeader->criterion = 0.0; // (not used here)
+        for (size_t i = 0; i < evalResults.size(); i++)
+            m_gradHeader->evalErrors[i] = evalResults[i];
+
+        // TODO: We are reusing the aggregation logic inside SimpleDistGradAggregator, which has a heavy dependency
+        // on the gradient matrix. At some point we should refactor the aggregator class to be able to only calculating
+        // eval results and then remove this hack.
+        Matrix<ElemType> dummyGradient((DEVICEID_TYPE)m_net->GetDeviceId());
+        std::vector<Matrix<ElemType>*> learnParamsGradients = { &dummyGradient };
+
+        // Using SimpleDistAggregator for eval results only. At some point we should rename the class to be just
+        // IDistAggregator and SimpleDistAggregator.
+        bool samplesProcessed = m_distGradAgg->AggregateGradients(learnParamsGradients, m_gradHeader.get(), /*resetState =*/ false);
+        if (!samplesProcessed) // no samples on any worker: keep the (empty) local results
+            return 0;
+
+        for (size_t i = 0; i < evalResults.size(); i++)
+            evalResults[i] = m_gradHeader->evalErrors[i];
+        return m_gradHeader->numSamplesWithLabel;
+    }
+
     void DisplayEvalStatistics(const size_t startMBNum, const size_t endMBNum, const size_t numSamplesLastLogged,
                                const vector<ComputationNodeBasePtr>& evalNodes,
                                const EpochCriterion evalResults, const EpochCriterion evalResultsLastLogged, bool displayConvertedValue = false)
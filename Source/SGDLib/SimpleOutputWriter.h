@@ -16,6 +16,9 @@
 #include <stdexcept>
 #include <fstream>
 #include <cstdio>
+#include <deque>
+#include <future>
+#include <functional>
 #include "ProgressTracing.h"
 #include "ComputationNetworkBuilder.h"
 
@@ -31,10 +34,18 @@ class SimpleOutputWriter
 
 public:
     SimpleOutputWriter(ComputationNetworkPtr net, int verbosity = 0)
-        : m_net(net), m_verbosity(verbosity)
+        : m_net(net), m_verbosity(verbosity), m_maxPendingMinibatches(2), m_binaryOutput(false)
     {
     }
 
+    // The WriteOutput() variant that writes to files copies each minibatch to the CPU and formats and writes it
+    // on a background thread, so that writing overlaps with computing the next minibatches.
+    // This bounds the number of minibatches that may be waiting to be written. 0 writes synchronously.
+    void SetMaxPendingMinibatches(size_t maxPendingMinibatches) { m_maxPendingMinibatches = maxPendingMinibatches; }
+
+    // write raw values instead of formatted text, see WriteBinaryValues()
+    void SetBinaryOutput(bool binaryOutput) { m_binaryOutput = binaryOutput; }
+
     void WriteOutput(IDataReader& dataReader, size_t mbSize, IDataWriter& dataWriter, const std::vector<std::wstring>& outputNodeNames, size_t numOutputSamples = requestDataSize, bool doWriterUnitTest = false)
     {
         ScopedNetworkOperationMode modeGuard(m_net, NetworkOperationMode::inferring);
@@ -134,6 +145,112 @@ public:
             valueFormatString, gradient);
     }
 
+    // copy a node's value to the CPU and queue formatting and writing it
+    void QueueWriteMinibatch(std::deque<std::shared_future<void>>& pendingWrites, size_t maxPendingWrites, FILE* f, ComputationNodePtr node,
+        const WriteFormattingOptions& formattingOptions, const std::string& valueFormatString, const std::vector<std::string>& labelMapping,
+        size_t numMBsRun)
+    {
+        const Matrix<ElemType>& value = node->Value();
+        const size_t numRows = value.GetNumRows();
+        const size_t numCols = value.GetNumCols();
+        shared_ptr<ElemType> data(value.CopyToArray(), [](ElemType* p) { delete[] p; });
+        MBLayoutPtr pMBLayout; // must be copied since the reader updates it in-place for the next minibatch
+        if (node->HasMBLayout())
+        {
+            pMBLayout = make_shared<MBLayout>();
+            pMBLayout->CopyFrom(node->GetMBLayout());
+        }
+
+        if (m_binaryOutput)
+        {
+            QueueWrite(pendingWrites, maxPendingWrites, [=]()
+            {
+                WriteBinaryValues(f, data.get(), numRows, numCols, pMBLayout);
+            });
+            return;
+        }
+
+        const auto sequenceSeparator = formattingOptions.Processed(node->NodeName(), formattingOptions.sequenceSeparator, numMBsRun);
+        const auto sequencePrologue  = formattingOptions.Processed(node->NodeName(), formattingOptions.sequencePrologue,  numMBsRun);
+        const auto sequenceEpilogue  = formattingOptions.Processed(node->NodeName(), formattingOptions.sequenceEpilogue,  numMBsRun);
+        const auto elementSeparator  = formattingOptions.Processed(node->NodeName(), formattingOptions.elementSeparator,  numMBsRun);
+        const auto sampleSeparator   = formattingOptions.Processed(node->NodeName(), formattingOptions.sampleSeparator,   numMBsRun);
+        const auto sampleLayout = node->GetSampleLayout();
+        const bool transpose       = formattingOptions.transpose;
+        const bool isCategoryLabel = formattingOptions.isCategoryLabel;
+        const bool isSparse        = formattingOptions.isSparse;
+        const std::vector<std::string>* pLabelMapping = &labelMapping; // (outlives all pending writes)
+
+        QueueWrite(pendingWrites, maxPendingWrites, [=]()
+        {
+            ComputationNode<ElemType>::WriteValuesWithFormatting(f, data.get(), numRows, numCols, pMBLayout, sampleLayout, FrameRange(), SIZE_MAX, SIZE_MAX,
+                transpose, isCategoryLabel, isSparse, *pLabelMapping,
+                sequenceSeparator, sequencePrologue, sequenceEpilogue, elementSeparator, sampleSeparator,
+                valueFormatString);
+        });
+    }
+
+    // Binary output format: for each sequence, its number of rows and of samples as two uint32 values,
+    // followed by its samples as float32 column vectors.
+    static void WriteBinaryValues(FILE* f, const ElemType* data, size_t numRows, size_t numCols, MBLayoutPtr pMBLayout)
+    {
+        if (!pMBLayout) // no MBLayout: a single sequence consisting of the columns
+        {
+            pMBLayout = make_shared<MBLayout>();
+            pMBLayout->Init(1, numCols);
+            pMBLayout->AddSequence(0, 0, 0, numCols);
+        }
+        const size_t numParallelSequences = pMBLayout->GetNumParallelSequences();
+        const ptrdiff_t width = (ptrdiff_t)pMBLayout->GetNumTimeSteps();
+        std::vector<float> sequenceData;
+        for (const auto& seqInfo : pMBLayout->GetAllSequences())
+        {
+            if (seqInfo.seqId == GAP_SEQUENCE_ID)
+                continue;
+            const ptrdiff_t tBegin = seqInfo.tBegin >= 0    ? seqInfo.tBegin : 0;
+            const ptrdiff_t tEnd   = seqInfo.tEnd   <= width ? seqInfo.tEnd   : width;
+            sequenceData.clear();
+            for (ptrdiff_t t = tBegin; t < tEnd; t++)
+            {
+                const ElemType* column = data + (t * numParallelSequences + seqInfo.s) * numRows;
+                sequenceData.insert(sequenceData.end(), column, column + numRows);
+            }
+            const uint32_t header[2] = { (uint32_t)numRows, (uint32_t)(tEnd - tBegin) };
+            fwriteOrDie(header, sizeof(header[0]), 2, f);
+            fwriteOrDie(sequenceData.data(), sizeof(float), sequenceData.size(), f);
+        }
+        fflushOrDie(f);
+    }
+
+    // run a write after all previously queued ones, on a background thread unless maxPendingWrites is 0
+    // Waits for the oldest writes once more than maxPendingWrites are pending. Errors are passed on to the next write and to the caller.
+    static void QueueWrite(std::deque<std::shared_future<void>>& pendingWrites, size_t maxPendingWrites, const std::function<void()>& write)
+    {
+        if (maxPendingWrites == 0)
+            return write();
+        std::shared_future<void> previous = pendingWrites.empty() ? std::shared_future<void>() : pendingWrites.back();
+        pendingWrites.push_back(std::async(std::launch::async, [previous, write]()
+        {
+            if (previous.valid())
+                previous.get(); // keeps the order within the files
+            write();
+        }).share());
+        while (pendingWrites.size() > maxPendingWrites)
+        {
+            pendingWrites.front().get();
+            pendingWrites.pop_front();
+        }
+    }
+
+    static void WaitForPendingWrites(std::deque<std::shared_future<void>>& pendingWrites)
+    {
+        while (!pendingWrites.empty())
+        {
+            pendingWrites.front().get();
+            pendingWrites.pop_front();
+        }
+    }
+
     void InsertNode(std::vector<ComputationNodeBasePtr>& allNodes, ComputationNodeBasePtr parent, ComputationNodeBasePtr newNode)
     {
         newNode->SetInput(0, parent);
@@ -211,7 +328,7 @@ public:
             std::wstring nodeOutputPath = outputPath;
             if (nodeOutputPath != L"-")
                 nodeOutputPath += L"." + onode->NodeName();
-            auto f = make_shared<File>(nodeOutputPath, fileOptionsWrite | fileOptionsText);
+            auto f = make_shared<File>(nodeOutputPath, fileOptionsWrite | (m_binaryOutput ? fileOptionsBinary : fileOptionsText));
             outputStreams[onode] = f;
         }
 
@@ -222,10 +339,13 @@ public:
 
         size_t totalEpochSamples = 0;
 
-        for (auto & onode : outputNodes)
+        if (!m_binaryOutput)
         {
-            FILE* f = *outputStreams[onode];
-            fprintfOrDie(f, "%s", formattingOptions.prologue.c_str());
+            for (auto & onode : outputNodes)
+            {
+                FILE* f = *outputStreams[onode];
+                fprintfOrDie(f, "%s", formattingOptions.prologue.c_str());
+            }
         }
 
         size_t actualMBSize;
@@ -234,6 +354,11 @@ public:
         char formatChar = !formattingOptions.isCategoryLabel ? 'f' : !formattingOptions.labelMappingFile.empty() ? 's' : 'u';
         std::string valueFormatString = "%" + formattingOptions.precisionFormat + formatChar; // format string used in fprintf() for formatting the values
 
+        // minibatches being formatted and written in the background
+        // The unit test writes synchronously since it interleaves values and gradients.
+        std::deque<std::shared_future<void>> pendingWrites;
+        const size_t maxPendingWrites = nodeUnitTest ? 0 : m_maxPendingMinibatches * outputNodes.size();
+
         for (size_t numMBsRun = 0; DataReaderHelpers::GetMinibatchIntoNetwork<ElemType>(dataReader, m_net, nullptr, false, false, inputMatrices, actualMBSize, nullptr); numMBsRun++)
         {
             ComputationNetwork::BumpEvalTimeStamp(inputNodes);
@@ -245,7 +370,7 @@ public:
                 m_net->ForwardProp(onode);
 
                 FILE* file = *outputStreams[onode];
-                WriteMinibatch(file, dynamic_pointer_cast<ComputationNode<ElemType>>(onode), formattingOptions, formatChar, valueFormatString, labelMapping, numMBsRun, /* gradient */ false);
+                QueueWriteMinibatch(pendingWrites, maxPendingWrites, file, dynamic_pointer_cast<ComputationNode<ElemType>>(onode), formattingOptions, valueFormatString, labelMapping, numMBsRun);
 
                 if (nodeUnitTest)
                     m_net->Backprop(onode);
@@ -269,8 +394,8 @@ public:
             totalEpochSamples += actualMBSize;
 
             fprintf(stderr, "Minibatch[%lu]: ActualMBSize = %lu\n", (unsigned long)numMBsRun, (unsigned long)actualMBSize);
-            if (outputPath == L"-") // if we mush all nodes together on stdout, add some visual separator
-                fprintf(stdout, "\n");
+            if (outputPath == L"-" && !m_binaryOutput) // if we mush all nodes together on stdout, add some visual separator
+                QueueWrite(pendingWrites, maxPendingWrites, []() { fprintf(stdout, "\n"); });
 
             numItersSinceLastPrintOfProgress = ProgressTracing::TraceFakeProgress(numIterationsBeforePrintingProgress, numItersSinceLastPrintOfProgress);
 
@@ -279,10 +404,15 @@ public:
             dataReader.DataEnd();
         } // end loop over minibatches
 
-        for (auto & stream : outputStreams)
+        WaitForPendingWrites(pendingWrites);
+
+        if (!m_binaryOutput)
         {
-            FILE* f = *stream.second;
-            fprintfOrDie(f, "%s", formattingOptions.epilogue.c_str());
+            for (auto & stream : outputStreams)
+            {
+                FILE* f = *stream.second;
+                fprintfOrDie(f, "%s", formattingOptions.epilogue.c_str());
+            }
         }
 
         fprintf(stderr, "Written to %ls*\nTotal Samples Evaluated = %lu\n", outputPath.c_str(), (unsigned long)totalEpochSamples);
@@ -295,6 +425,8 @@ public:
 private:
     ComputationNetworkPtr m_net;
     int m_verbosity;
+    size_t m_maxPendingMinibatches;
+    bool m_binaryOutput;
     void operator=(const SimpleOutputWriter&); // (not assignable)
 };
 
@@ -0,0 +1,152 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE.md file in the project root for full license information.
+//
+
+#pragma once
+
+#include "IDistGradAggregator.h"
+#include "GradientSparsifier.h"
+#include "TimerUtility.h"
+#include "TimelineTracer.h"
+#include "MatrixQuantizerImpl.h"
+
+namespace Microsoft { namespace MSR { namespace CNTK {
+
+// Aggregates top-k sparsified gradients: each worker sends only the entries of largest magnitude of each
+// gradient as index/value pairs, see GradientSparsifier, and keeps the rest in a residual for the next minibatches.
+// The numbers of entries differ between the workers, so the pairs of all gradients are exchanged with one
+// MPI_Allgatherv, and every worker adds them up into its gradients.
+template <class ElemType>
+class SparseDistGradAggregator : public IDistGradAggregator<ElemType>
+{
+    UsingIDistGradAggregatorMembers;
+
+public:
+    // 'fraction' of the entries of each gradient are sent
+    SparseDistGradAggregator(const MPIWrapperPtr& mpi, double fraction, int syncStatsTrace)
+        : IDistGradAggregator<ElemType>(mpi), m_sparsifier(fraction), m_syncStatsTrace(syncStatsTrace), m_iterationCount(0)
+    {}
+
+    bool AggregateGradients(const std::vector<Matrix<ElemType>*>& gradients, DistGradHeader* headerCPU, bool resetState) override
+    {
+        ResetState(gradients, resetState);
+        bool showSyncPerfStats = (m_syncStatsTrace > 0) && ((m_iterationCount % m_syncStatsTrace) == 0);
+        m_iterationCount++;
+
+        Timer aggregationTimer;
+        int deviceId = gradients.empty() ? CPUDEVICE : gradients[0]->GetDeviceId();
+        TimelineEvent event("Aggregation", "AggregateSparseGradients", deviceId);
+        if (showSyncPerfStats)
+        {
+            std::unique_ptr<MatrixComputeStreamEvent> mainStreamSyncEvent(MatrixComputeStreamEvent::Create(deviceId));
+            mainStreamSyncEvent->SynchronizeEvent();
+            aggregationTimer.Start();
+        }
+
+        // If the current node did not process any samples, the gradients should be zero'd; the residual is still sent
+        if (headerCPU->numSamples == 0)
+        {
+            for (auto gradient : gradients)
+                gradient->SetValue(0);
+        }
+
+        this->AllGatherHeaders(headerCPU, m_headers);
+
+        // select the entries to send; their indices are made unique across the gradients by the offsets of the gradients
+        m_sendIndices.clear();
+        m_sendValues.clear();
+        for (size_t i = 0; i < gradients.size(); i++)
+        {
+            m_sparsifier.Sparsify(*gradients[i], *m_residuals[i], m_indices, m_values);
+            for (auto index : m_indices)
+                m_sendIndices.push_back((unsigned int) (m_gradientOffsets[i] + index));
+            m_sendValues.insert(m_sendValues.end(), m_values.begin(), m_values.end());
+        }
+
+        // exchange the pairs of all workers
+        int numSent = (int) m_sendIndices.size();
+        std::vector<int> counts(NumProc()), offsets(NumProc());
+        m_mpi->AllGather(&numSent, 1, counts.data(), 1);
+        size_t numReceived = 0;
+        for (size_t j = 0; j < NumProc(); j++)
+        {
+            offsets[j] = (int) numReceived;
+            numReceived += counts[j];
+        }
+        if (numReceived > INT_MAX)
+            RuntimeError("SparseDistGradAggregator: Too many gradient entries (%d) are exchanged in one minibatch.", (int) numReceived);
+        m_receivedIndices.resize(numReceived);
+        m_receivedValues.resize(numReceived);
+        MPI_Allgatherv(m_sendIndices.data(), numSent, MPI_UNSIGNED, m_receivedIndices.data(), counts.data(), offsets.data(), MPI_UNSIGNED, m_mpi->Communicator())
+            || MpiFail("MPI_Allgatherv");
+        MPI_Allgatherv(m_sendValues.data(), numSent, MPIWrapper::GetDataType(m_sendValues.data()), m_receivedValues.data(), counts.data(), offsets.data(),
+                       MPIWrapper::GetDataType(m_receivedValues.data()), m_mpi->Communicator())
+            || MpiFail("MPI_Allgatherv");
+
+        // sum them up, in worker order so that all workers get the same result
+        std::fill(m_aggregated.begin(), m_aggregated.end(), (ElemType) 0);
+        for (size_t j = 0; j < numReceived; j++)
+            m_aggregated[m_receivedIndices[j]] += m_receivedValues[j];
+        for (size_t i = 0; i < gradients.size(); i++)
+        {
+            auto gradient = gradients[i];
+            gradient->SetValue(gradient->GetNumRows(), gradient->GetNumCols(), gradient->GetDeviceId(), m_aggregated.data() + m_gradientOffsets[i]);
+        }
+
+        if (showSyncPerfStats)
+        {
+            aggregationTimer.Stop();
+            fprintf(stderr, "Sparse gradient aggregation: sent %d of %d gradient entries (%.3g%%), received %d, %.6g seconds\n",
+                    numSent, (int) m_aggregated.size(), m_aggregated.empty() ? 0.0 : 100.0 * numSent / m_aggregated.size(), (int) numReceived, aggregationTimer.ElapsedSeconds());
+        }
+
+        return (headerCPU->numSamples != 0);
+    }
+
+private:
+    // (re)creates the residuals, at zero
+    void ResetState(const std::vector<Matrix<ElemType>*>& gradients, bool resetState)
+    {
+        bool matching = m_residuals.size() == gradients.size();
+        for (size_t i = 0; matching && i < gradients.size(); i++)
+        {
+            matching = m_residuals[i]->GetNumRows() == gradients[i]->GetNumRows() && m_residuals[i]->GetNumCols() == gradients[i]->GetNumCols() &&
+                       m_residuals[i]->GetDeviceId() == gradients[i]->GetDeviceId();
+        }
+        if (matching && !resetState)
+            return;
+
+        m_residuals.clear();
+        m_gradientOffsets.clear();
+        size_t numElements = 0;
+        for (auto gradient : gradients)
+        {
+            m_residuals.push_back(std::make_unique<Matrix<ElemType>>(gradient->GetNumRows(), gradient->GetNumCols(), gradient->GetDeviceId()));
+            m_residuals.back()->SetValue(0);
+            m_gradientOffsets.push_back(numElements);
+            numElements += gradient->GetNumElements();
+        }
+        if (numElements > UINT_MAX)
+            InvalidArgument("SparseDistGradAggregator: Models of more than %u parameters are not supported.", UINT_MAX);
+        m_aggregated.resize(numElements);
+    }
+
+    GradientSparsifier<ElemType> m_sparsifier;
+    std::vector<std::unique_ptr<Matrix<ElemType>>> m_residuals;
+    std::vector<size_t> m_gradientOffsets; // of the gradients in the concatenation of all of them
+
+    std::vector<unsigned int> m_indices; // of one gradient
+    std::vector<ElemType> m_values;
+    std::vector<unsigned int> m_sendIndices;
+    std::vector<ElemType> m_sendValues;
+    std::vector<unsigned int> m_receivedIndices;
+    std::vector<ElemType> m_receivedValues;
+    std::vector<ElemType> m_aggregated; // all gradients, one after the other
+    std::vector<char> m_headers;
+
+    int m_syncStatsTrace;
+    size_t m_iterationCount;
+};
+
+} } }
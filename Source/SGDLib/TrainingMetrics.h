@@ -0,0 +1,111 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE.md file in the project root for full license information.
+//
+// TrainingMetrics.h -- structured training progress, for schedulers and dashboards that would otherwise parse the log
+//
+#pragma once
+
+#include "Basics.h"
+#include "fileutil.h"
+#include <cmath>
+#include <memory>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace Microsoft { namespace MSR { namespace CNTK {
+
+// What SGD reports at every log interval (the "Epoch[..]-Minibatch[..]" lines) and at the end of each epoch.
+// The times are in seconds, summed over the minibatches of the interval. They are taken on the host, so without
+// perfTraceLevel > 0, which waits for the GPU after each phase, the asynchronous GPU work of forward and backward
+// propagation is counted in the phase that first waits for it, usually 'aggregate' or 'update'.
+struct TrainingMetrics
+{
+    bool isEpochSummary = false;
+    int rank = 0;
+    int epoch = 0;                  // 1-based
+    int firstMinibatch = 0;         // 1-based, inclusive
+    int lastMinibatch = 0;
+    size_t numSamples = 0;          // with labels, aggregated over the workers
+    double seconds = 0;
+    double trainLoss = 0;           // per sample
+    std::vector<std::pair<std::wstring, double>> evalErrors; // per sample, by node name
+    double learningRatePerSample = 0;
+    double readSeconds = 0;
+    double forwardBackwardSeconds = 0;
+    double aggregateSeconds = 0;    // gradient aggregation across the workers
+    double updateSeconds = 0;       // the rest of the parameter update
+    double syncSeconds = 0;         // model averaging, block momentum and parameter server
+    size_t memoryInUseMB = 0;       // device memory in use, or the peak resident memory on the CPU
+    size_t peakMemoryMB = 0;        // high-water mark of memoryInUseMB in this epoch
+
+    double SamplesPerSecond() const { return seconds > 0 ? numSamples / seconds : 0; }
+};
+
+// Receives the TrainingMetrics. Install one with SGD::SetTrainingMetricsWriter(), or have SGD write
+// JSON lines to the file given by 'metricsFile'. Write() is called from the training loop and must be quick.
+class TrainingMetricsWriter
+{
+public:
+    virtual ~TrainingMetricsWriter() {}
+    virtual void Write(const TrainingMetrics& metrics) = 0;
+};
+typedef std::shared_ptr<TrainingMetricsWriter> TrainingMetricsWriterPtr;
+
+// Writes one JSON object per line and flushes it, so that the file can be followed while training runs, e.g.
+//   {"type":"interval","rank":0,"epoch":1,"minibatches":[1,10],"samples":2560,"seconds":0.412,"samplesPerSecond":6213.6,
+//    "trainLoss":2.1,"evalErrors":{"err":0.7},"learningRatePerSample":0.003125,"readSeconds":0.02,"forwardBackwardSeconds":0.21,
+//    "aggregateSeconds":0,"updateSeconds":0.15,"syncSeconds":0,"memoryMB":1207,"peakMemoryMB":1207}
+class JsonLinesTrainingMetricsWriter : public TrainingMetricsWriter
+{
+public:
+    explicit JsonLinesTrainingMetricsWriter(const std::wstring& path)
+    {
+        msra::files::make_intermediate_dirs(path);
+        m_file = fopenOrDie(path, L"wb");
+    }
+
+    ~JsonLinesTrainingMetricsWriter()
+    {
+        fclose(m_file);
+    }
+
+    void Write(const TrainingMetrics& m) override
+    {
+        fprintf(m_file, "{\"type\":\"%s\",\"rank\":%d,\"epoch\":%d,\"minibatches\":[%d,%d],\"samples\":%d,\"seconds\":%.6g,\"samplesPerSecond\":%.6g,",
+                m.isEpochSummary ? "epoch" : "interval", m.rank, m.epoch, m.firstMinibatch, m.lastMinibatch, (int) m.numSamples, m.seconds, m.SamplesPerSecond());
+        fprintf(m_file, "\"trainLoss\":%s,\"evalErrors\":{", Number(m.trainLoss).c_str());
+        for (size_t i = 0; i < m.evalErrors.size(); i++)
+            fprintf(m_file, "%s\"%s\":%s", i > 0 ? "," : "", Escape(m.evalErrors[i].first).c_str(), Number(m.evalErrors[i].second).c_str());
+        fprintf(m_file, "},\"learningRatePerSample\":%.8g,\"readSeconds\":%.6g,\"forwardBackwardSeconds\":%.6g,\"aggregateSeconds\":%.6g,\"updateSeconds\":%.6g,\"syncSeconds\":%.6g,",
+                m.learningRatePerSample, m.readSeconds, m.forwardBackwardSeconds, m.aggregateSeconds, m.updateSeconds, m.syncSeconds);
+        fprintf(m_file, "\"memoryMB\":%d,\"peakMemoryMB\":%d}\n", (int) m.memoryInUseMB, (int) m.peakMemoryMB);
+        fflushOrDie(m_file);
+    }
+
+private:
+    // JSON has no NaN or infinity
+    static std::string Number(double value)
+    {
+        return std::isfinite(value) ? msra::strfun::strprintf("%.8g", value) : std::string("null");
+    }
+
+    static std::string Escape(const std::wstring& name)
+    {
+        std::string result;
+        for (char c : msra::strfun::utf8(name))
+        {
+            if (c == '"' || c == '\\')
+                result += '\\';
+            result += c;
+        }
+        return result;
+    }
+
+    FILE* m_file;
+
+    DISABLE_COPY_AND_MOVE(JsonLinesTrainingMetricsWriter);
+};
+
+}}}
@@ -18,9 +18,10 @@ class V2SimpleDistGradAggregator : public IDistGradAggregator<ElemType>
     ::CNTK::DistributedCommunicatorPtr m_communicator;
 
 public:
-    V2SimpleDistGradAggregator(const MPIWrapperPtr& mpi, bool useAsyncAggregation, int syncStatsTrace, ::CNTK::DistributedCommunicatorPtr communicator)
+    // Gradients smaller than 'bucketSizeInBytes' are packed into fusion buffers of about that size, see IDistGradAggregator::GroupIntoBuckets().
+    V2SimpleDistGradAggregator(const MPIWrapperPtr& mpi, bool useAsyncAggregation, int syncStatsTrace, ::CNTK::DistributedCommunicatorPtr communicator, size_t bucketSizeInBytes = 0)
         : IDistGradAggregator<ElemType>(mpi), m_useAsyncAggregation(useAsyncAggregation), m_initialized(false), m_bufferedGradHeader(nullptr), m_syncStatsTrace(syncStatsTrace), m_iterationCount(0),
-        m_communicator(communicator)
+        m_communicator(communicator), m_bucketSizeInBytes(bucketSizeInBytes)
     {}
 
     ~V2SimpleDistGradAggregator()
@@ -133,6 +134,18 @@ private:
             m_bufferedGradHeader = DistGradHeader::Create(numEvalNodes);
             m_bufferedGradHeader->Clear();
         }
+
+        std::vector<size_t> order(gradients.size());
+        for (size_t i = 0; i < order.size(); i++)
+            order[i] = i;
+        m_buckets = GroupIntoBuckets(gradients, order, m_bucketSizeInBytes);
+        for (const auto& bucket : m_buckets)
+        {
+            size_t numElements = 0;
+            for (size_t i : bucket)
+                numElements += gradients[i]->GetNumElements();
+            m_fusionBuffers.push_back(bucket.size() > 1 ? std::make_unique<Matrix<ElemType>>(1, numElements, deviceId) : nullptr);
+        }
         m_initialized = true;
     }
 
@@ -181,15 +194,29 @@ private:
             }
         }
 
-        // Prepare gradients.
+        // Prepare gradients, the small ones packed into the fusion buffers.
         std::vector<::CNTK::NDArrayViewPtr> valuesToAggregate;
-        for (size_t i = 0; i < gradients.size(); ++i)
+        for (size_t b = 0; b < m_buckets.size(); ++b)
         {
-            if (gradients[i]->Data() == nullptr) // Hack in case of eval.
+            Matrix<ElemType>* value = m_fusionBuffers[b].get();
+            if (value)
+            {
+                size_t offset = 0;
+                for (size_t i : m_buckets[b])
+                {
+                    size_t numElements = gradients[i]->GetNumElements();
+                    value->SetColumnSlice(gradients[i]->Reshaped(1, numElements), offset, numElements);
+                    offset += numElements;
+                }
+            }
+            else
+                value = gradients[m_buckets[b].front()];
+
+            if (value->Data() == nullptr) // Hack in case of eval.
                 continue;
 
-            ::CNTK::NDShape shape{ gradients[i]->GetNumElements() };
-            auto data = ::CNTK::MakeSharedObject<::CNTK::NDArrayView>(::CNTK::AsDataType<ElemType>(), shape, gradients[i]->Data(), gradients[i]->GetNumElements() * sizeof(ElemType), ::CNTK::AsDeviceDescriptor(gradients[i]->GetDeviceId()));
+            ::CNTK::NDShape shape{ value->GetNumElements() };
+            auto data = ::CNTK::MakeSharedObject<::CNTK::NDArrayView>(::CNTK::AsDataType<ElemType>(), shape, value->Data(), value->GetNumElements() * sizeof(ElemType), ::CNTK::AsDeviceDescriptor(value->GetDeviceId()));
             valuesToAggregate.push_back(data);
         }
 
@@ -210,6 +237,20 @@ private:
 
         m_communicator->AggregateInPlace(valuesToAggregate, m_communicator->Workers());
 
+        // Scatter the fusion buffers back into the gradients
+        for (size_t b = 0; b < m_buckets.size(); ++b)
+        {
+            if (!m_fusionBuffers[b])
+                continue;
+            size_t offset = 0;
+            for (size_t i : m_buckets[b])
+            {
+                size_t numElements = gradients[i]->GetNumElements();
+                gradients[i]->AssignValuesOf(m_fusionBuffers[b]->ColumnSlice(offset, numElements).Reshaped(gradients[i]->GetNumRows(), gradients[i]->GetNumCols()));
+                offset += numElements;
+            }
+        }
+
         // Copy data back to the header
         headerCPU->criterion = headerBuffer[0];
         headerCPU->numSamples = static_cast<size_t>(headerBuffer[1]);
@@ -239,6 +280,11 @@ private:
     std::unordered_map<Matrix<ElemType>*, std::unique_ptr<Matrix<ElemType>>> m_bufferedGradients;
     DistGradHeader* m_bufferedGradHeader;
 
+    // Gradients exchanged together by index, and their fusion buffers (nullptr for a single gradient, which is exchanged in place)
+    size_t m_bucketSizeInBytes;
+    std::vector<std::vector<size_t>> m_buckets;
+    std::vector<std::unique_ptr<Matrix<ElemType>>> m_fusionBuffers;
+
     // Only used for controlling frequency of measuring/showing gradient aggregation perf stats
     int m_syncStatsTrace;
     size_t m_iterationCount;
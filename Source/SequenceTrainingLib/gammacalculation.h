@@ -7,6 +7,7 @@
 #include "ssematrix.h"
 #include "Matrix.h"
 #include "CUDAPageLockedMemAllocator.h"
+#include "CPUThreadPool.h"
 
 #include <memory>
 #include <vector>
@@ -47,6 +48,7 @@ public:
         amf = 7.0f;
         boostmmifactor = 0.0f;
         seqsMBRmode = false;
+        m_latticecachebytes = 0;
     }
     ~GammaCalculation()
     {
@@ -67,7 +69,10 @@ public:
             parallellattice.setdevice(DeviceId);
 
             if (parallellattice.enabled())                             // send hmm set to GPU if GPU computation enabled
+            {
                 parallellattice.entercomputation(m_hset, mbrclassdef); // cache senone2classmap if mpemode
+                parallellattice.setlatticecachesize(m_latticecachebytes);
+            }
             initialmark = true;
         }
     }
@@ -84,6 +89,14 @@ public:
         boostmmifactor = (float) gammarParam.bMMIfactor;
     }
 
+    // how much of the lattices to keep on the GPU across minibatches, so that they are uploaded only once
+    void SetLatticeCacheSize(size_t bytes)
+    {
+        m_latticecachebytes = bytes;
+        if (initialmark && parallellattice.enabled())
+            parallellattice.setlatticecachesize(bytes);
+    }
+
     // ========================================
     // Sec. 3 calculation functions
     // ========================================
@@ -100,7 +113,6 @@ public:
     {
         // check total frame number to be added ?
         // int deviceid = loglikelihood.GetDeviceId();
-        size_t boundaryframenum;
         std::vector<size_t> validframes; // [s] cursor pointing to next utterance begin within a single parallel sequence [s]
         validframes.assign(samplesInRecurrentStep, 0);
         ElemType objectValue = 0.0;
@@ -126,15 +138,26 @@ public:
             assert(T == pMBLayout->GetNumTimeSteps());
         }
 
+        // where utterance [i] is in the minibatch and in pred/dengammas
+        struct utterancestripe
+        {
+            size_t ts;         // first column in pred and dengammas
+            size_t numframes;
+            size_t mapi;       // parallel-sequence index
+            size_t mapt;       // first time step within that parallel sequence
+            double numavlogp;
+            double denavlogp;
+        };
+        std::vector<utterancestripe> stripes(lattices.size());
+
         size_t mapi = 0; // parallel-sequence index for utterance [i]
-        // cal gamma for each utterance
         size_t ts = 0;
-        for (size_t i = 0; i < lattices.size(); i++)
+        // get the logLLs of utterance [i] into pred (and parallellattice)
+        auto prepare = [&](size_t i)
         {
             const size_t numframes = lattices[i]->getnumframes();
 
-            msra::dbn::matrixstripe predstripe(pred, ts, numframes);           // logLLs for this utterance
-            msra::dbn::matrixstripe dengammasstripe(dengammas, ts, numframes); // denominator gammas
+            msra::dbn::matrixstripe predstripe(pred, ts, numframes); // logLLs for this utterance
 
             if (samplesInRecurrentStep == 1) // no sequence parallelism
             {
@@ -186,15 +209,25 @@ public:
                 }
             }
 
-            array_ref<size_t> uidsstripe(&uids[ts], numframes);
+            stripes[i].ts = ts;
+            stripes[i].numframes = numframes;
+            stripes[i].mapi = mapi;
+            stripes[i].mapt = samplesInRecurrentStep > 1 ? validframes[mapi] : 0;
+            if (samplesInRecurrentStep > 1)
+                validframes[mapi] += numframes; // advance the cursor within the parallel sequence
+            ts += numframes;
+        };
 
-            if (doreferencealign)
-            {
-                boundaryframenum = numframes;
-            }
-            else
-                boundaryframenum = 0;
-            array_ref<size_t> boundariesstripe(&boundaries[ts], boundaryframenum);
+        // forward-backward of utterance [i] into dengammas (and parallellattice)
+        // 'gammasbuffer' is scratch space of the calling thread (sMBR only).
+        auto computegamma = [&](size_t i, msra::dbn::matrix& gammasbuffer)
+        {
+            auto& stripe = stripes[i];
+            msra::dbn::matrixstripe predstripe(pred, stripe.ts, stripe.numframes);           // logLLs for this utterance
+            msra::dbn::matrixstripe dengammasstripe(dengammas, stripe.ts, stripe.numframes); // denominator gammas
+
+            array_ref<size_t> uidsstripe(&uids[stripe.ts], stripe.numframes);
+            array_ref<size_t> boundariesstripe(&boundaries[stripe.ts], doreferencealign ? stripe.numframes : 0);
 
             double numavlogp = 0;
             foreach_column (t, dengammasstripe) // we do not allocate memory for numgamma now, should be the same as numgammasstripe
@@ -202,24 +235,33 @@ public:
                 const size_t s = uidsstripe[t];
                 numavlogp += predstripe(s, t) / amf;
             }
-            numavlogp /= numframes;
+            stripe.numavlogp = numavlogp / stripe.numframes;
 
             // auto_timer dengammatimer;
-            double denavlogp = lattices[i]->second.forwardbackward(parallellattice,
+            stripe.denavlogp = lattices[i]->second.forwardbackward(parallellattice,
                                                                    (const msra::math::ssematrixbase&) predstripe, (const msra::asr::simplesenonehmm&) m_hset,
-                                                                   (msra::math::ssematrixbase&) dengammasstripe, (msra::math::ssematrixbase&) gammasbuffer /*empty, not used*/,
+                                                                   (msra::math::ssematrixbase&) dengammasstripe, (msra::math::ssematrixbase&) gammasbuffer,
                                                                    lmf, wp, amf, boostmmifactor, seqsMBRmode, uidsstripe, boundariesstripe);
-            objectValue += (ElemType)((numavlogp - denavlogp) * numframes);
+        };
+
+        // the gammas of utterance [i] into gammafromlattice, and its reference alignment into labels
+        auto finish = [&](size_t i)
+        {
+            const auto& stripe = stripes[i];
+            const size_t numframes = stripe.numframes;
+            const size_t mapi = stripe.mapi;
+            objectValue += (ElemType)((stripe.numavlogp - stripe.denavlogp) * numframes);
 
             if (samplesInRecurrentStep == 1)
             {
-                tempmatrix = gammafromlattice.ColumnSlice(ts, numframes);
+                tempmatrix = gammafromlattice.ColumnSlice(stripe.ts, numframes);
             }
 
             // copy gamma to tempmatrix
             if (m_deviceid == CPUDEVICE)
             {
-                CopyFromSSEMatrixToCNTKMatrix(dengammas, numrows, numframes, tempmatrix, gammafromlattice.GetDeviceId());
+                msra::dbn::matrixstripe dengammasstripe(dengammas, stripe.ts, numframes);
+                CopyFromSSEMatrixToCNTKMatrix(dengammasstripe, numrows, numframes, tempmatrix, gammafromlattice.GetDeviceId());
             }
             else
                 parallellattice.getgamma(tempmatrix);
@@ -227,7 +269,7 @@ public:
             // set gamma for multi channel
             if (samplesInRecurrentStep > 1)
             {
-                Microsoft::MSR::CNTK::Matrix<ElemType> gammaFromLatticeForCurrentParallelUtterance = gammafromlattice.ColumnSlice(mapi + (validframes[mapi] * samplesInRecurrentStep), ((numframes - 1) * samplesInRecurrentStep) + 1);
+                Microsoft::MSR::CNTK::Matrix<ElemType> gammaFromLatticeForCurrentParallelUtterance = gammafromlattice.ColumnSlice(mapi + (stripe.mapt * samplesInRecurrentStep), ((numframes - 1) * samplesInRecurrentStep) + 1);
                 gammaFromLatticeForCurrentParallelUtterance.CopyColumnsStrided(tempmatrix, numframes, 1, samplesInRecurrentStep);
             }
 
@@ -235,17 +277,40 @@ public:
             {
                 for (size_t nframe = 0; nframe < numframes; nframe++)
                 {
-                    size_t uid = uidsstripe[nframe];
+                    size_t uid = uids[stripe.ts + nframe];
                     if (samplesInRecurrentStep > 1)
-                        labels(uid, (nframe + validframes[mapi]) * samplesInRecurrentStep + mapi) = 1.0;
+                        labels(uid, (nframe + stripe.mapt) * samplesInRecurrentStep + mapi) = 1.0;
                     else
-                        labels(uid, ts + nframe) = 1.0;
+                        labels(uid, stripe.ts + nframe) = 1.0;
                 }
             }
-            if (samplesInRecurrentStep > 1)
-                validframes[mapi] += numframes; // advance the cursor within the parallel sequence
-            fprintf(stderr, "dengamma value %f\n", denavlogp);
-            ts += numframes;
+            fprintf(stderr, "dengamma value %f\n", stripe.denavlogp);
+        };
+
+        // cal gamma for each utterance
+        // On the CPU, the lattices are independent of each other and are processed concurrently, each thread with scratch
+        // space of its own. On the GPU, parallellattice holds one utterance at a time.
+        if (m_deviceid == CPUDEVICE)
+        {
+            for (size_t i = 0; i < lattices.size(); i++)
+                prepare(i);
+            Microsoft::MSR::CNTK::CPUThreadPool::Instance().ParallelFor(lattices.size(), 1, [&](size_t begin, size_t end)
+            {
+                msra::dbn::matrix threadgammasbuffer;
+                for (size_t i = begin; i < end; i++)
+                    computegamma(i, threadgammasbuffer);
+            });
+            for (size_t i = 0; i < lattices.size(); i++)
+                finish(i);
+        }
+        else
+        {
+            for (size_t i = 0; i < lattices.size(); i++)
+            {
+                prepare(i);
+                computegamma(i, gammasbuffer);
+                finish(i);
+            }
         }
         functionValues.SetValue(objectValue);
     }
@@ -376,6 +441,7 @@ protected:
     std::vector<size_t> boundary;
     float boostmmifactor;
     bool seqsMBRmode;
+    size_t m_latticecachebytes; // budget for lattices kept on the GPU (0 = none)
 
 private:
     std::unique_ptr<Microsoft::MSR::CNTK::CUDAPageLockedMemAllocator> m_cudaAllocator;
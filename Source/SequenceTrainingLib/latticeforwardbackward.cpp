@@ -12,6 +12,7 @@
 #include "simplesenonehmm.h" // the model
 #include "ssematrix.h"       // the matrices
 #include "latticestorage.h"
+#include "CPUTensorKernels.h" // for the log-sum and exp over the posterior columns
 #include <unordered_map>
 #include <list>
 #include <stdexcept>
@@ -1112,26 +1113,26 @@ void lattice::mmierrorsignal(parallelstate &parallelstate, double minlogpp, cons
 
     // check normalizedness (is that an actual English word?)
     // also count non-zero probs
+    // The columns are log-summed and exponentiated by the vectorized kernels; the zeros contribute nothing to the sum.
+    const auto &kernels = Microsoft::MSR::CNTK::CPUTensorKernels::Get();
+    const auto logsumcolumn = kernels.Reduction(Microsoft::MSR::CNTK::ElementWiseOperator::opLogSum);
+    const auto expcolumn = kernels.Unary(Microsoft::MSR::CNTK::ElementWiseOperator::opExp);
     size_t nonzerostates = 0;
     foreach_column (t, errorsignal)
     {
-        double logsum = LOGZERO;
         foreach_row (s, errorsignal)
-        {
             if (islogzero(errorsignal(s, t)))
                 nonzerostates++;
-            else
-                logadd(logsum, (double) errorsignal(s, t));
-            // TODO: count VIRGINLOGZERO, print per frame
-        }
+        // TODO: count VIRGINLOGZERO, print per frame
+        double logsum = errorsignal.rows() > 0 ? logsumcolumn(&errorsignal(0, t), errorsignal.rows()) : LOGZERO;
         if (fabs(logsum) / errorsignal.rows() > 1e-6)
             fprintf(stderr, "forwardbackward: WARNING: overall posterior column(%d) sum = exp (%.10f) != 1\n", (int) t, logsum);
     }
     fprintf(stderr, "forwardbackward: %.3f%% non-zero state posteriors\n", 100.0f - nonzerostates * 100.0f / errorsignal.rows() / errorsignal.cols());
 
     // convert to non-log posterior  --that's what we return
-    foreach_coord (i, j, errorsignal)
-        errorsignal(i, j) = expf(errorsignal(i, j));
+    foreach_column (t, errorsignal)
+        expcolumn(&errorsignal(0, t), &errorsignal(0, t), errorsignal.rows(), 1.0f, 0.0f);
 }
 
 // compute ground truth's score
@@ -13,6 +13,8 @@
 #include "latticefunctionskernels.h" // for emulation
 #include "cudalatticeops.h"
 #include <numeric> // for debug
+#include <list>
+#include <map>
 #include "cudalib.h"
 #include "Basics.h"
 
@@ -398,7 +400,10 @@ struct parallelstateimpl
           errorsignalgpustorage(new Microsoft::MSR::CNTK::Matrix<float>((int) deviceid)),
           errorsignalneggpustorage(new Microsoft::MSR::CNTK::Matrix<float>((int) deviceid)),
           backptrstoragegpu(msra::cuda::newushortvector(deviceid)),
-          backptroffsetsgpu(msra::cuda::newsizetvector(deviceid))
+          backptroffsetsgpu(msra::cuda::newsizetvector(deviceid)),
+          latticecachebudget(0),
+          latticecachebytes(0),
+          currentlatticebytes(0)
     {
     }
 
@@ -543,20 +548,142 @@ struct parallelstateimpl
     std::unique_ptr<Microsoft::MSR::CNTK::Matrix<float>> errorsignalgpu;
     std::unique_ptr<Microsoft::MSR::CNTK::Matrix<float>> errorsignalneggpu;
 
+    // lattices uploaded before
+    // Lattices are read from disk anew for every minibatch, but their edges, nodes, alignments and offsets are the same
+    // each time. Within a budget, these stay on the GPU under the lattice's key, so that the next epoch can use them
+    // without uploading them again. The current lattice (edgesgpu etc.) is not in latticecache; it goes back there
+    // when another one is set. Least recently used lattices are dropped when over budget.
+    struct cachedlattice
+    {
+        std::unique_ptr<edgeinfowithscoresvector> edgesgpu;
+        std::unique_ptr<nodeinfovector> nodesgpu;
+        std::unique_ptr<aligninfovector> aligngpu;
+        std::unique_ptr<msra::cuda::uintvector> alignoffsetsgpu;
+        std::unique_ptr<sizetvector> backptroffsetsgpu;
+        size_t bytes;
+        std::list<std::wstring>::iterator lrupos;
+    };
+    size_t latticecachebudget; // in bytes; 0 = upload each lattice every time
+    size_t latticecachebytes;  // held by latticecache and the current lattice
+    std::map<std::wstring, cachedlattice> latticecache;
+    std::list<std::wstring> latticecachelru; // keys of latticecache, least recently used first
+    std::wstring currentlatticekey;          // empty if the current lattice is not to be cached
+    size_t currentlatticebytes;
+
+    void setlatticecachesize(size_t bytes)
+    {
+        latticecachebudget = bytes;
+        if (latticecachebudget == 0)
+        {
+            latticecache.clear();
+            latticecachelru.clear();
+            currentlatticekey.clear();
+            latticecachebytes = 0;
+        }
+        trimlatticecache();
+    }
+
+    void trimlatticecache()
+    {
+        while (latticecachebytes > latticecachebudget && !latticecachelru.empty())
+        {
+            auto iter = latticecache.find(latticecachelru.front());
+            latticecachebytes -= iter->second.bytes;
+            latticecache.erase(iter);
+            latticecachelru.pop_front();
+        }
+    }
+
+    // move the current lattice into latticecache, and start a new one
+    void stashcurrentlattice()
+    {
+        if (currentlatticekey.empty())
+            return;
+        cachedlattice& entry = latticecache[currentlatticekey];
+        entry.edgesgpu = std::move(edgesgpu);
+        entry.nodesgpu = std::move(nodesgpu);
+        entry.aligngpu = std::move(aligngpu);
+        entry.alignoffsetsgpu = std::move(alignoffsetsgpu);
+        entry.backptroffsetsgpu = std::move(backptroffsetsgpu);
+        entry.bytes = currentlatticebytes;
+        entry.lrupos = latticecachelru.insert(latticecachelru.end(), currentlatticekey);
+        edgesgpu.reset(msra::cuda::newedgeinfovector(deviceid));
+        nodesgpu.reset(msra::cuda::newnodeinfovector(deviceid));
+        aligngpu.reset(msra::cuda::newaligninfovector(deviceid));
+        alignoffsetsgpu.reset(msra::cuda::newuintvector(deviceid));
+        backptroffsetsgpu.reset(msra::cuda::newsizetvector(deviceid));
+        currentlatticekey.clear();
+    }
+
+    // make the lattice cached under 'key' the current one; false if there is none or it does not match the sizes
+    bool fetchcachedlattice(const std::wstring& key, size_t numedges, size_t numnodes, size_t numalign, size_t numalignoffsets, size_t numbackptroffsets)
+    {
+        auto iter = latticecache.find(key);
+        if (iter == latticecache.end())
+            return false;
+        cachedlattice& entry = iter->second;
+        bool matches = entry.edgesgpu->size() == numedges && entry.nodesgpu->size() == numnodes && entry.aligngpu->size() == numalign &&
+                       entry.alignoffsetsgpu->size() == numalignoffsets && entry.backptroffsetsgpu->size() == numbackptroffsets;
+        if (matches)
+        {
+            edgesgpu = std::move(entry.edgesgpu);
+            nodesgpu = std::move(entry.nodesgpu);
+            aligngpu = std::move(entry.aligngpu);
+            alignoffsetsgpu = std::move(entry.alignoffsetsgpu);
+            backptroffsetsgpu = std::move(entry.backptroffsetsgpu);
+            currentlatticekey = key;
+            currentlatticebytes = entry.bytes;
+        }
+        else // a different lattice under the same key, e.g. from another archive
+            latticecachebytes -= entry.bytes;
+        latticecachelru.erase(entry.lrupos);
+        latticecache.erase(iter);
+        return matches;
+    }
+
     // cache current lattice
     // This is a weird mix of const/non-const and private lattice data... :(
+    // 'key' identifies the lattice for the cache of uploaded lattices.
     template <class edgestype, class nodestype, class aligntype, class edgealignments, class backpointers>
-    void setutterancedata(const edgestype& edges, const nodestype& nodes, const aligntype& align,
+    void setutterancedata(const std::wstring& key, const edgestype& edges, const nodestype& nodes, const aligntype& align,
                           const msra::math::ssematrixbase& /*logLLs*/, std::vector<float>& edgeacscores,
                           edgealignments& edgeAlignments, backpointers& backPointers)
     {
         // lattice data
-        edgesgpu->assign(edges, false);
-        nodesgpu->assign(nodes, false);
-        aligngpu->assign(align, false);
-        alignoffsetsgpu->assign(edgeAlignments.getalignoffsets(), false);
+        const auto& alignoffsets = edgeAlignments.getalignoffsets();
+        const auto& backptroffsets = backPointers.getbackptroffsets();
+        bool iscached = false;
+        if (latticecachebudget > 0 && !key.empty())
+        {
+            if (key != currentlatticekey)
+            {
+                stashcurrentlattice();
+                iscached = fetchcachedlattice(key, edges.size(), nodes.size(), align.size(), alignoffsets.size(), backptroffsets.size());
+            }
+            else
+                iscached = edgesgpu->size() == edges.size() && nodesgpu->size() == nodes.size() && aligngpu->size() == align.size();
+        }
+        if (!iscached)
+        {
+            edgesgpu->assign(edges, false);
+            nodesgpu->assign(nodes, false);
+            aligngpu->assign(align, false);
+            alignoffsetsgpu->assign(alignoffsets, false);
+            backptroffsetsgpu->assign(backptroffsets, false);
+
+            latticecachebytes -= currentlatticekey.empty() ? 0 : currentlatticebytes;
+            if (latticecachebudget > 0 && !key.empty())
+            {
+                currentlatticekey = key;
+                currentlatticebytes = edges.size() * sizeof(edges[0]) + nodes.size() * sizeof(nodes[0]) + align.size() * sizeof(align[0]) +
+                                      alignoffsets.size() * sizeof(alignoffsets[0]) + backptroffsets.size() * sizeof(backptroffsets[0]);
+                latticecachebytes += currentlatticebytes;
+                trimlatticecache();
+            }
+            else
+                currentlatticekey.clear();
+        }
         backptrstoragegpu->allocate(backPointers.getbackptrstoragesize());
-        backptroffsetsgpu->assign(backPointers.getbackptroffsets(), false);
 
 #ifndef PARALLEL_SIL
         alignresult->assign(edgeAlignments.getalignmentsbuffer(), false);
@@ -715,6 +842,10 @@ const size_t lattice::parallelstate::getsilunitid()
 {
     return pimpl->silalignunitid;
 }
+void lattice::parallelstate::setlatticecachesize(size_t bytes)
+{
+    pimpl->setlatticecachesize(bytes);
+}
 void lattice::parallelstate::getedgeacscores(std::vector<float>& edgeacscores)
 {
     pimpl->getedgeacscores(edgeacscores);
@@ -760,7 +891,7 @@ void lattice::parallelforwardbackwardalign(parallelstate& parallelstate,
     if (!parallelstate->emulation)
     {
         // move lattice to GPU
-        parallelstate->setutterancedata(edges, nodes, align, logLLs,                 // inputs
+        parallelstate->setutterancedata(key, edges, nodes, align, logLLs,            // inputs
                                         edgeacscores, edgealignments, backpointers); // inouts
 
         // launch the kernel
@@ -7,12 +7,14 @@
 
 #include "stdafx.h"
 #include "Basics.h"
+#include "BrainScriptEvaluator.h"
 #include "BrainScriptParser.h"
 #include "BrainScriptTestsHelper.h"
 #include "ComputationNetwork.h"
 #include "CommonMatrix.h"
 #include "boost/filesystem.hpp"
 
+#include <chrono>
 #include <utility>
 #include <vector>
 #include <istream>
@@ -72,6 +74,33 @@ BOOST_AUTO_TEST_CASE(CompareNetworkStructureFromModel)
     }
 }
 
+// Constructs a large network from BrainScript: a binary tree of Plus nodes over one parameter, all of them outputs.
+// Construction time should grow about linearly with the number of nodes; with traceLevel = 1 the network also reports
+// the times of the evaluation of its BrainScript and of the collection of its nodes.
+BOOST_AUTO_TEST_CASE(ConstructLargeNetworkFromBrainScript)
+{
+    const int numNodes = 10000;
+    let source = msra::strfun::wstrprintf(
+        L"deviceId = %d\n"
+        L"traceLevel = 1\n"
+        L"precision = 'float'\n"
+        L"c = new ComputationNode [ operation = 'LearnableParameter' ; shape = 1 ; initValue = 1 ; init = '' ; initFromFilePath = '' ; tag = '' ; learningRateMultiplier = 0 ]\n"
+        L"network = new ComputationNetwork [\n"
+        L"    h = array[0..%d](i => if i == 0 then c else h[((i - 1) - (i - 1) %% 2) / 2] + c)\n"
+        L"    outputNodes = h\n"
+        L"]\n", (int) CPUDEVICE, numNodes - 1);
+    let expr = BS::ParseConfigDictFromString(source, L"ConstructLargeNetworkFromBrainScript", vector<wstring>());
+
+    let start = chrono::steady_clock::now();
+    let net = dynamic_pointer_cast<ComputationNetwork>(BS::EvaluateField(expr, L"network"));
+    let seconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+    fprintf(stderr, "Constructed a network of %d nodes in %.3f seconds.\n", numNodes, seconds);
+
+    BOOST_REQUIRE(net);
+    BOOST_TEST(net->GetTotalNumberOfNodes() == (size_t) numNodes);
+    BOOST_TEST(net->OutputNodes().size() == (size_t) numNodes);
+}
+
 BOOST_AUTO_TEST_SUITE_END()
 
 }}}}
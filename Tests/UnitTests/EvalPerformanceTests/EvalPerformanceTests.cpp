@@ -0,0 +1,476 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE.md file in the project root for full license information.
+//
+// EvalPerformanceTests.cpp -- latency and throughput benchmark of model evaluation
+//
+// Drives a model with synthetic requests through the evaluation paths of the serving hosts: ForwardPass() and
+// ForwardPassBatch() of CNTKEvalExtended (EvalDll), and Function::Evaluate() of the V2 library. Each of 'concurrency'
+// threads has its own evaluator, which shares the parameters with the others (CreateSharedEvaluator(), Clone() with
+// ParameterCloningMethod::Share), and calls it with 'batchSize' sequences of 'sequenceLength' samples, random dense
+// values or one-hot sparse ones. For every combination it reports the latency of the first call of each evaluator
+// (allocations, and the autotuning of the engines), of the warm-up calls, and the p50/p90/p99/max latency per call
+// afterwards, together with the throughput of all threads. Usage:
+//
+//   EvalPerformanceTests model=<file> api=v1|v2|both device=cpu|<gpu id> concurrency=<n,...> batchSizes=<n,...>
+//                        sequenceLengths=<n,...> calls=<per thread> warmup=<calls per thread> output=<node> json=<file>
+//
+// Only 'model' is required. Evaluators on the same GPU do not run concurrently, so with a GPU, concurrency measures
+// the queueing of the requests rather than parallel evaluation.
+//
+#include "stdafx.h"
+#include "Eval.h"
+#include "CNTKLibrary.h"
+#include <chrono>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <fstream>
+#include <sstream>
+#include <vector>
+#include <random>
+#include <algorithm>
+#include <numeric>
+#include <functional>
+#include <memory>
+
+using namespace std;
+using namespace Microsoft::MSR::CNTK;
+
+struct Options
+{
+    string model;
+    string api = "both";
+    int deviceId = -1;
+    vector<size_t> concurrency{ 1 };
+    vector<size_t> batchSizes{ 1, 8, 32 };
+    vector<size_t> sequenceLengths{ 1 };
+    size_t calls = 200;
+    size_t warmup = 10;
+    wstring output; // default: the first output of the model
+    string json;
+};
+
+struct Result
+{
+    string api;
+    size_t concurrency;
+    size_t batchSize;
+    size_t sequenceLength;
+    double firstCallMs;     // slowest over the threads
+    double warmupMs;        // mean per call
+    vector<double> callMs;  // after warm-up, of all threads, sorted
+    double seconds;         // wall time of the calls after warm-up
+    string skipped;         // why it did not run
+
+    double Percentile(double p) const
+    {
+        return callMs[min(callMs.size() - 1, (size_t) (p * callMs.size()))];
+    }
+    double CallsPerSecond() const
+    {
+        return callMs.size() / seconds;
+    }
+};
+
+// One call of an evaluator of a thread with its inputs, with the outputs preallocated.
+typedef function<void()> Call;
+
+// Creates the evaluator of thread 'threadIndex' (which may reuse the one of an earlier combination) and the inputs of its calls.
+typedef function<Call(size_t threadIndex, size_t batchSize, size_t sequenceLength)> CallFactory;
+
+class Barrier
+{
+public:
+    explicit Barrier(size_t count)
+        : m_count(count)
+    {
+    }
+
+    void Wait()
+    {
+        unique_lock<mutex> lock(m_mutex);
+        if (--m_count == 0)
+            m_released.notify_all();
+        else
+            m_released.wait(lock, [this] { return m_count == 0; });
+    }
+
+private:
+    mutex m_mutex;
+    condition_variable m_released;
+    size_t m_count;
+};
+
+static double MillisecondsSince(chrono::high_resolution_clock::time_point start)
+{
+    return chrono::duration<double, milli>(chrono::high_resolution_clock::now() - start).count();
+}
+
+static Result Measure(const string& api, const CallFactory& createCall, size_t concurrency, size_t batchSize, size_t sequenceLength, const Options& options)
+{
+    Result result{ api, concurrency, batchSize, sequenceLength, 0, 0, {}, 0, "" };
+    try
+    {
+        vector<Call> calls;
+        for (size_t i = 0; i < concurrency; i++)
+            calls.push_back(createCall(i, batchSize, sequenceLength));
+
+        vector<double> firstCallMs(concurrency), warmupMs(concurrency);
+        vector<vector<double>> callMs(concurrency);
+        vector<string> errors(concurrency);
+        Barrier warmedUp(concurrency + 1), done(concurrency + 1);
+        vector<thread> threads;
+        for (size_t i = 0; i < concurrency; i++)
+        {
+            threads.push_back(thread([&, i]
+            {
+                try
+                {
+                    auto start = chrono::high_resolution_clock::now();
+                    calls[i]();
+                    firstCallMs[i] = MillisecondsSince(start);
+                    start = chrono::high_resolution_clock::now();
+                    for (size_t j = 0; j < options.warmup; j++)
+                        calls[i]();
+                    warmupMs[i] = options.warmup > 0 ? MillisecondsSince(start) / options.warmup : 0;
+                }
+                catch (const exception& e)
+                {
+                    errors[i] = e.what();
+                }
+                warmedUp.Wait();
+                for (size_t j = 0; j < options.calls && errors[i].empty(); j++)
+                {
+                    try
+                    {
+                        auto start = chrono::high_resolution_clock::now();
+                        calls[i]();
+                        callMs[i].push_back(MillisecondsSince(start));
+                    }
+                    catch (const exception& e)
+                    {
+                        errors[i] = e.what();
+                    }
+                }
+                done.Wait();
+            }));
+        }
+        warmedUp.Wait();
+        auto start = chrono::high_resolution_clock::now();
+        done.Wait();
+        result.seconds = MillisecondsSince(start) / 1000;
+        for (auto& t : threads)
+            t.join();
+
+        for (size_t i = 0; i < concurrency; i++)
+        {
+            if (!errors[i].empty())
+                throw runtime_error(errors[i]);
+            result.callMs.insert(result.callMs.end(), callMs[i].begin(), callMs[i].end());
+        }
+        result.firstCallMs = *max_element(firstCallMs.begin(), firstCallMs.end());
+        result.warmupMs = accumulate(warmupMs.begin(), warmupMs.end(), 0.0) / concurrency;
+        sort(result.callMs.begin(), result.callMs.end());
+        if (result.callMs.empty())
+            throw runtime_error("no calls were measured, calls=0");
+    }
+    catch (const exception& e)
+    {
+        result.skipped = e.what();
+    }
+    return result;
+}
+
+// ---------------------------------------------------------------------------
+// CNTKEvalExtended
+// ---------------------------------------------------------------------------
+
+class V1Evaluators
+{
+public:
+    explicit V1Evaluators(const Options& options)
+    {
+        IEvaluateModelExtended<float>* eval;
+        GetEvalExtendedF(&eval);
+        m_evaluators.push_back(eval);
+        eval->CreateNetwork("modelPath=\"" + options.model + "\"\ndeviceId=" + to_string(options.deviceId));
+        m_outputName = options.output.empty() ? eval->GetOutputSchema()[0].m_name : options.output;
+        eval->StartForwardEvaluation({ m_outputName });
+    }
+
+    ~V1Evaluators()
+    {
+        for (auto eval : m_evaluators)
+            eval->Destroy();
+    }
+
+    Call CreateCall(size_t threadIndex, size_t batchSize, size_t sequenceLength)
+    {
+        while (m_evaluators.size() <= threadIndex)
+        {
+            auto eval = m_evaluators[0]->CreateSharedEvaluator();
+            m_evaluators.push_back(eval);
+            eval->StartForwardEvaluation({ m_outputName });
+        }
+        auto eval = m_evaluators[threadIndex];
+        VariableSchema inputSchema = eval->GetInputSchema();
+        VariableSchema outputSchema = eval->GetOutputSchema();
+
+        mt19937 rng((unsigned int) threadIndex);
+        auto inputs = make_shared<vector<Values<float>>>(batchSize);
+        auto outputs = make_shared<vector<Values<float>>>(batchSize);
+        for (size_t s = 0; s < batchSize; s++)
+        {
+            for (const auto& layout : inputSchema)
+            {
+                ValueBuffer<float, Vector> buffer;
+                if (layout.m_storageType == VariableLayout::Sparse)
+                {
+                    uniform_int_distribution<int> index(0, (int) layout.m_numElements - 1);
+                    buffer.m_colIndices.push_back(0);
+                    for (size_t t = 0; t < sequenceLength; t++)
+                    {
+                        buffer.m_buffer.push_back(1);
+                        buffer.m_indices.push_back(index(rng));
+                        buffer.m_colIndices.push_back((int) t + 1);
+                    }
+                }
+                else
+                {
+                    uniform_real_distribution<float> value(0, 1);
+                    buffer.m_buffer.resize(layout.m_numElements * sequenceLength);
+                    generate(buffer.m_buffer.begin(), buffer.m_buffer.end(), [&] { return value(rng); });
+                }
+                (*inputs)[s].push_back(move(buffer));
+            }
+            vector<size_t> maxLengths(outputSchema.size(), sequenceLength);
+            (*outputs)[s] = outputSchema.CreateBuffers<float>(maxLengths);
+        }
+
+        if (batchSize == 1)
+            return [eval, inputs, outputs] { eval->ForwardPass((*inputs)[0], (*outputs)[0], /*resetRNN=*/true); };
+        return [eval, inputs, outputs] { eval->ForwardPassBatch(*inputs, *outputs); };
+    }
+
+private:
+    wstring m_outputName;
+    vector<IEvaluateModelExtended<float>*> m_evaluators; // [i] of thread i
+};
+
+// ---------------------------------------------------------------------------
+// V2 Function::Evaluate()
+// ---------------------------------------------------------------------------
+
+class V2Evaluators
+{
+public:
+    explicit V2Evaluators(const Options& options)
+        : m_device(options.deviceId < 0 ? ::CNTK::DeviceDescriptor::CPUDevice() : ::CNTK::DeviceDescriptor::GPUDevice(options.deviceId))
+    {
+        auto model = ::CNTK::Function::LoadModel(wstring(options.model.begin(), options.model.end()), m_device);
+        m_functions.push_back(model);
+        auto modelOutputs = model->Outputs();
+        m_outputIndex = 0;
+        if (!options.output.empty())
+        {
+            auto output = find_if(modelOutputs.begin(), modelOutputs.end(), [&](const ::CNTK::Variable& v) { return v.Name() == options.output; });
+            if (output == modelOutputs.end())
+                throw runtime_error("The model has no output named " + string(options.output.begin(), options.output.end()) + ".");
+            m_outputIndex = output - modelOutputs.begin();
+        }
+    }
+
+    Call CreateCall(size_t threadIndex, size_t batchSize, size_t sequenceLength)
+    {
+        while (m_functions.size() <= threadIndex)
+            m_functions.push_back(m_functions[0]->Clone(::CNTK::ParameterCloningMethod::Share));
+        auto function = m_functions[threadIndex];
+
+        mt19937 rng((unsigned int) threadIndex);
+        auto arguments = make_shared<unordered_map<::CNTK::Variable, ::CNTK::ValuePtr>>();
+        for (const auto& argument : function->Arguments())
+        {
+            if (argument.GetDataType() != ::CNTK::DataType::Float)
+                throw runtime_error("only models with float inputs are supported");
+            size_t dim = argument.Shape().TotalSize();
+            // inputs without a sequence axis take one sample per sequence
+            size_t length = argument.DynamicAxes().size() > 1 ? sequenceLength : 1;
+            ::CNTK::ValuePtr value;
+            if (argument.IsSparse())
+            {
+                uniform_int_distribution<size_t> index(0, dim - 1);
+                vector<vector<size_t>> sequences(batchSize, vector<size_t>(length));
+                for (auto& sequence : sequences)
+                    generate(sequence.begin(), sequence.end(), [&] { return index(rng); });
+                value = ::CNTK::Value::Create<float>(dim, sequences, m_device, /*readOnly=*/true);
+            }
+            else
+            {
+                uniform_real_distribution<float> uniform(0, 1);
+                vector<vector<float>> sequences(batchSize, vector<float>(dim * length));
+                for (auto& sequence : sequences)
+                    generate(sequence.begin(), sequence.end(), [&] { return uniform(rng); });
+                value = ::CNTK::Value::Create(argument.Shape(), sequences, m_device, /*readOnly=*/true);
+            }
+            (*arguments)[argument] = value;
+        }
+
+        auto output = function->Outputs()[m_outputIndex];
+        auto device = m_device;
+        return [function, arguments, output, device]
+        {
+            unordered_map<::CNTK::Variable, ::CNTK::ValuePtr> outputs = { { output, nullptr } };
+            function->Evaluate(*arguments, outputs, device);
+        };
+    }
+
+private:
+    ::CNTK::DeviceDescriptor m_device;
+    size_t m_outputIndex;
+    vector<::CNTK::FunctionPtr> m_functions; // [i] of thread i
+};
+
+// ---------------------------------------------------------------------------
+// reporting
+// ---------------------------------------------------------------------------
+
+static void Print(const Result& r)
+{
+    fprintf(stderr, "%-3s concurrency %3d batch %4d length %4d ", r.api.c_str(), (int) r.concurrency, (int) r.batchSize, (int) r.sequenceLength);
+    if (!r.skipped.empty())
+    {
+        fprintf(stderr, "skipped: %s\n", r.skipped.c_str());
+        return;
+    }
+    double callsPerSecond = r.CallsPerSecond();
+    fprintf(stderr, "first %9.2f ms, warm-up %8.3f ms, p50 %8.3f ms, p90 %8.3f ms, p99 %8.3f ms, max %8.3f ms, %9.1f calls/s, %10.1f samples/s\n",
+            r.firstCallMs, r.warmupMs, r.Percentile(0.5), r.Percentile(0.9), r.Percentile(0.99), r.callMs.back(),
+            callsPerSecond, callsPerSecond * r.batchSize * r.sequenceLength);
+}
+
+static void WriteJson(const string& path, const Options& options, const vector<Result>& results)
+{
+    ofstream f(path);
+    if (!f)
+        throw runtime_error("Cannot open '" + path + "' for writing.");
+    f << "{\n  \"model\": \"" << options.model << "\",\n  \"device\": " << options.deviceId << ",\n  \"results\": [\n";
+    for (size_t i = 0; i < results.size(); i++)
+    {
+        const auto& r = results[i];
+        f << "    { \"api\": \"" << r.api << "\", \"concurrency\": " << r.concurrency << ", \"batchSize\": " << r.batchSize
+          << ", \"sequenceLength\": " << r.sequenceLength;
+        if (!r.skipped.empty())
+        {
+            string skipped = r.skipped;
+            replace(skipped.begin(), skipped.end(), '"', '\'');
+            replace(skipped.begin(), skipped.end(), '\n', ' ');
+            f << ", \"skipped\": \"" << skipped << "\"";
+        }
+        else
+        {
+            f << ", \"firstCallMs\": " << r.firstCallMs << ", \"warmupMs\": " << r.warmupMs << ", \"p50Ms\": " << r.Percentile(0.5)
+              << ", \"p90Ms\": " << r.Percentile(0.9) << ", \"p99Ms\": " << r.Percentile(0.99) << ", \"maxMs\": " << r.callMs.back()
+              << ", \"callsPerSecond\": " << r.CallsPerSecond() << ", \"samplesPerSecond\": " << r.CallsPerSecond() * r.batchSize * r.sequenceLength;
+        }
+        f << " }" << (i + 1 < results.size() ? ",\n" : "\n");
+    }
+    f << "  ]\n}\n";
+}
+
+static vector<size_t> ParseList(const string& value)
+{
+    vector<size_t> list;
+    stringstream s(value);
+    string item;
+    while (getline(s, item, ','))
+        list.push_back(stoul(item));
+    if (list.empty() || find(list.begin(), list.end(), 0) != list.end())
+        throw invalid_argument("Expected a comma-separated list of positive numbers, but got '" + value + "'.");
+    return list;
+}
+
+static Options ParseOptions(int argc, char* argv[])
+{
+    Options options;
+    for (int i = 1; i < argc; i++)
+    {
+        string arg = argv[i];
+        auto pos = arg.find('=');
+        if (pos == string::npos)
+            throw invalid_argument("Arguments are of the form name=value, but got '" + arg + "'.");
+        string name = arg.substr(0, pos), value = arg.substr(pos + 1);
+        if (name == "model")
+            options.model = value;
+        else if (name == "api")
+            options.api = value;
+        else if (name == "device")
+            options.deviceId = value == "cpu" ? -1 : stoi(value);
+        else if (name == "concurrency")
+            options.concurrency = ParseList(value);
+        else if (name == "batchSizes")
+            options.batchSizes = ParseList(value);
+        else if (name == "sequenceLengths")
+            options.sequenceLengths = ParseList(value);
+        else if (name == "calls")
+            options.calls = stoul(value);
+        else if (name == "warmup")
+            options.warmup = stoul(value);
+        else if (name == "output")
+            options.output = wstring(value.begin(), value.end());
+        else if (name == "json")
+            options.json = value;
+        else
+            throw invalid_argument("Unknown argument '" + name + "'.");
+    }
+    if (options.model.empty())
+        throw invalid_argument("The model to evaluate is missing, model=<file>.");
+    if (options.api != "v1" && options.api != "v2" && options.api != "both")
+        throw invalid_argument("api is one of v1, v2 and both, but got '" + options.api + "'.");
+    return options;
+}
+
+static void RunAll(const string& api, const CallFactory& createCall, const Options& options, vector<Result>& results)
+{
+    for (size_t concurrency : options.concurrency)
+        for (size_t batchSize : options.batchSizes)
+            for (size_t sequenceLength : options.sequenceLengths)
+            {
+                results.push_back(Measure(api, createCall, concurrency, batchSize, sequenceLength, options));
+                Print(results.back());
+            }
+}
+
+int main(int argc, char* argv[])
+{
+    try
+    {
+        Options options = ParseOptions(argc, argv);
+        vector<Result> results;
+        if (options.api != "v2")
+        {
+            auto start = chrono::high_resolution_clock::now();
+            V1Evaluators evaluators(options);
+            fprintf(stderr, "v1: model loaded in %.1f ms\n", MillisecondsSince(start));
+            RunAll("v1", [&](size_t threadIndex, size_t batchSize, size_t sequenceLength) { return evaluators.CreateCall(threadIndex, batchSize, sequenceLength); }, options, results);
+        }
+        if (options.api != "v1")
+        {
+            auto start = chrono::high_resolution_clock::now();
+            V2Evaluators evaluators(options);
+            fprintf(stderr, "v2: model loaded in %.1f ms\n", MillisecondsSince(start));
+            RunAll("v2", [&](size_t threadIndex, size_t batchSize, size_t sequenceLength) { return evaluators.CreateCall(threadIndex, batchSize, sequenceLength); }, options, results);
+        }
+        if (!options.json.empty())
+        {
+            WriteJson(options.json, options, results);
+            fprintf(stderr, "\nResults written to %s\n", options.json.c_str());
+        }
+    }
+    catch (const exception& e)
+    {
+        fprintf(stderr, "EXCEPTION occurred: %s\n", e.what());
+        return EXIT_FAILURE;
+    }
+    return EXIT_SUCCESS;
+}
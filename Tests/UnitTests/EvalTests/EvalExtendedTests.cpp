@@ -4,8 +4,10 @@
 //
 #include "stdafx.h"
 #include "EvalTestHelper.h"
+#include "BatchingEvaluator.h"
 #define __STDC_FORMAT_MACROS
 #include <inttypes.h>
+#include <thread>
 
 using namespace Microsoft::MSR::CNTK;
 
@@ -128,6 +130,239 @@ BOOST_AUTO_TEST_CASE(EvalScalarTimesTest)
     eval->Destroy();
 }
 
+BOOST_AUTO_TEST_CASE(EvalSharedEvaluatorTest)
+{
+    std::string modelDefinition =
+        "deviceId = -1 \n"
+        "precision = \"float\" \n"
+        "traceLevel = 1 \n"
+        "run=NDLNetworkBuilder \n"
+        "NDLNetworkBuilder=[ \n"
+        "i1 = Input(1) \n"
+        "o1 = Times(Constant(3), i1, tag=\"output\") \n"
+        "FeatureNodes = (i1) \n"
+        "] \n";
+
+    VariableSchema inputLayouts;
+    VariableSchema outputLayouts;
+    IEvaluateModelExtended<float> *eval;
+    eval = SetupNetworkAndGetLayouts(modelDefinition, inputLayouts, outputLayouts);
+
+    // a second evaluator on the same parameters, with its own buffers
+    IEvaluateModelExtended<float> *sharedEval = eval->CreateSharedEvaluator();
+    sharedEval->StartForwardEvaluation({ outputLayouts[0].m_name });
+    BOOST_REQUIRE_EQUAL(sharedEval->GetInputSchema().size(), inputLayouts.size());
+
+    // evaluate both concurrently, many times, with different inputs
+    auto run = [&outputLayouts](IEvaluateModelExtended<float>* e, float input, bool& correct)
+    {
+        Values<float> inputBuffer(1);
+        inputBuffer[0].m_buffer = { input };
+        Values<float> outputBuffer = outputLayouts.CreateBuffers<float>({ 1 });
+        correct = true;
+        for (size_t i = 0; i < 100; i++)
+        {
+            e->ForwardPass(inputBuffer, outputBuffer);
+            correct = correct && outputBuffer[0].m_buffer.size() == 1 && outputBuffer[0].m_buffer[0] == 3 * input;
+        }
+    };
+    bool correct1, correct2;
+    std::thread thread1(run, eval, 2.0f, std::ref(correct1));
+    std::thread thread2(run, sharedEval, 5.0f, std::ref(correct2));
+    thread1.join();
+    thread2.join();
+    BOOST_CHECK(correct1);
+    BOOST_CHECK(correct2);
+
+    // the parameters outlive the evaluator they were loaded by
+    eval->Destroy();
+    Values<float> inputBuffer(1);
+    inputBuffer[0].m_buffer = { 4 };
+    Values<float> outputBuffer = outputLayouts.CreateBuffers<float>({ 1 });
+    sharedEval->ForwardPass(inputBuffer, outputBuffer);
+    std::vector<float> expected{ 12 };
+    auto buf = outputBuffer[0].m_buffer;
+    BOOST_CHECK_EQUAL_COLLECTIONS(buf.begin(), buf.end(), expected.begin(), expected.end());
+
+    sharedEval->Destroy();
+}
+
+BOOST_AUTO_TEST_CASE(EvalBatchingTest)
+{
+    std::string modelDefinition =
+        "deviceId = -1 \n"
+        "precision = \"float\" \n"
+        "traceLevel = 1 \n"
+        "run=NDLNetworkBuilder \n"
+        "NDLNetworkBuilder=[ \n"
+        "i1 = Input(1) \n"
+        "o1 = Times(Constant(3), i1, tag=\"output\") \n"
+        "FeatureNodes = (i1) \n"
+        "] \n";
+
+    VariableSchema inputLayouts;
+    VariableSchema outputLayouts;
+    IEvaluateModelExtended<float> *eval;
+    eval = SetupNetworkAndGetLayouts(modelDefinition, inputLayouts, outputLayouts);
+
+    {
+        BatchingEvaluator<float> batchingEval(eval, 8, std::chrono::milliseconds(5));
+
+        // requests of 1 to 3 samples from several threads
+        const size_t numThreads = 4, numRequestsPerThread = 25;
+        std::vector<bool> correct(numThreads, true);
+        std::vector<std::thread> threads;
+        for (size_t k = 0; k < numThreads; k++)
+        {
+            threads.push_back(std::thread([&, k]()
+            {
+                for (size_t r = 0; r < numRequestsPerThread; r++)
+                {
+                    Values<float> inputs(1);
+                    for (size_t t = 0; t <= r % 3; t++)
+                        inputs[0].m_buffer.push_back((float)(k * 1000 + r * 10 + t));
+                    std::vector<float> expected;
+                    for (auto v : inputs[0].m_buffer)
+                        expected.push_back(3 * v);
+                    auto outputs = batchingEval.Submit(std::move(inputs)).get();
+                    if (outputs.size() != 1 || outputs[0].m_buffer != expected)
+                        correct[k] = false;
+                }
+            }));
+        }
+        for (auto& thread : threads)
+            thread.join();
+        for (size_t k = 0; k < numThreads; k++)
+            BOOST_CHECK(correct[k]);
+
+        auto statistics = batchingEval.GetStatistics();
+        BOOST_CHECK_EQUAL(statistics.m_numRequests, numThreads * numRequestsPerThread);
+        size_t numBatchedRequests = 0, numBatches = 0;
+        for (size_t n = 0; n < statistics.m_batchSizeHistogram.size(); n++)
+        {
+            numBatchedRequests += n * statistics.m_batchSizeHistogram[n];
+            numBatches += statistics.m_batchSizeHistogram[n];
+        }
+        BOOST_CHECK_EQUAL(numBatchedRequests, statistics.m_numRequests);
+        BOOST_CHECK_EQUAL(numBatches, statistics.m_numBatches);
+        BOOST_CHECK(statistics.m_latencyP50 <= statistics.m_latencyP99);
+        BOOST_CHECK(statistics.m_latencyP99 <= statistics.m_latencyMax);
+
+        // a bad request gets the exception
+        Values<float> badInputs(0);
+        BOOST_REQUIRE_THROW(batchingEval.Submit(std::move(badInputs)).get(), std::exception);
+    }
+
+    eval->Destroy();
+}
+
+BOOST_AUTO_TEST_CASE(EvalStreamsTest)
+{
+    // running sum
+    std::string modelDefinition =
+        "deviceId = -1 \n"
+        "precision = \"float\" \n"
+        "traceLevel = 1 \n"
+        "run=NDLNetworkBuilder \n"
+        "NDLNetworkBuilder=[ \n"
+        "i1 = Input(1) \n"
+        "o1 = Plus(i1, PastValue(1, o1, timeStep = 1), tag=\"output\") \n"
+        "FeatureNodes = (i1) \n"
+        "] \n";
+
+    VariableSchema inputLayouts;
+    VariableSchema outputLayouts;
+    IEvaluateModelExtended<float> *eval;
+    eval = SetupNetworkAndGetLayouts(modelDefinition, inputLayouts, outputLayouts);
+
+    IEvalStreamState* streamA = eval->CreateStreamState();
+    IEvalStreamState* streamB = eval->CreateStreamState();
+    IEvalStreamState* streamC = eval->CreateStreamState();
+    auto forward = [&](const std::vector<std::vector<float>>& chunks, const std::vector<IEvalStreamState*>& states)
+    {
+        std::vector<Values<float>> inputs, outputs;
+        for (const auto& chunk : chunks)
+        {
+            inputs.push_back(inputLayouts.CreateBuffers<float>({ chunk.size() }));
+            inputs.back()[0].m_buffer = chunk;
+            outputs.push_back(outputLayouts.CreateBuffers<float>({ chunk.size() }));
+        }
+        eval->ForwardPassStreams(inputs, outputs, states);
+        std::vector<std::vector<float>> results;
+        for (const auto& output : outputs)
+            results.push_back(output[0].m_buffer);
+        return results;
+    };
+
+    // the streams continue across calls, in any mix and order
+    auto results = forward({ { 1, 2 }, { 10 } }, { streamA, streamB });
+    BOOST_CHECK(results[0] == std::vector<float>({ 1, 3 }));
+    BOOST_CHECK(results[1] == std::vector<float>({ 10 }));
+
+    results = forward({ { 20, 30, 40 }, { 5 }, { 100 } }, { streamB, streamC, streamA });
+    BOOST_CHECK(results[0] == std::vector<float>({ 30, 60, 100 }));
+    BOOST_CHECK(results[1] == std::vector<float>({ 5 }));
+    BOOST_CHECK(results[2] == std::vector<float>({ 103 }));
+
+    results = forward({ { 1 } }, { streamA });
+    BOOST_CHECK(results[0] == std::vector<float>({ 104 }));
+
+    // a stream can only have one chunk per call
+    BOOST_REQUIRE_THROW(forward({ { 1 }, { 2 } }, { streamB, streamB }), std::exception);
+
+    streamA->Destroy();
+    streamB->Destroy();
+    streamC->Destroy();
+    eval->Destroy();
+}
+
+BOOST_AUTO_TEST_CASE(EvalBeamSearchTest)
+{
+    // the score of the next token is a bias (i2) minus a decaying count of the tokens so far
+    std::string modelDefinition =
+        "deviceId = -1 \n"
+        "precision = \"float\" \n"
+        "traceLevel = 1 \n"
+        "run=NDLNetworkBuilder \n"
+        "NDLNetworkBuilder=[ \n"
+        "i1 = Input(3) \n"
+        "i2 = Input(3) \n"
+        "h = Plus(i1, Times(Constant(0.5), PastValue(3, h, timeStep = 1))) \n"
+        "o1 = Minus(i2, h, tag=\"output\") \n"
+        "FeatureNodes = (i1) \n"
+        "] \n";
+
+    VariableSchema inputLayouts;
+    VariableSchema outputLayouts;
+    IEvaluateModelExtended<float> *eval;
+    eval = SetupNetworkAndGetLayouts(modelDefinition, inputLayouts, outputLayouts);
+
+    Values<float> context(1);
+    context[0].m_buffer = { 0.0f, -0.25f, -1.125f };
+    BeamSearchOptions options = { L"i1", /*beamWidth=*/2, /*maxLength=*/4, /*startToken=*/0, /*endToken=*/2 };
+    std::vector<BeamSearchHypothesis> hypotheses;
+    eval->BeamSearch(context, options, hypotheses);
+
+    // [1, 0] is extended twice by the third step, so the PastValue state of its parallel sequence is gathered twice
+    BOOST_REQUIRE_EQUAL(hypotheses.size(), 2);
+    BOOST_CHECK(hypotheses[0].m_tokens == std::vector<size_t>({ 1, 0, 2 }));
+    BOOST_CHECK_EQUAL(hypotheses[0].m_score, -1.875);
+    BOOST_CHECK(hypotheses[1].m_tokens == std::vector<size_t>({ 1, 0, 1, 2 }));
+    BOOST_CHECK_EQUAL(hypotheses[1].m_score, -2.625);
+
+    // greedy search does not reach the end token
+    options.m_beamWidth = 1;
+    eval->BeamSearch(context, options, hypotheses);
+    BOOST_REQUIRE_EQUAL(hypotheses.size(), 1);
+    BOOST_CHECK(hypotheses[0].m_tokens == std::vector<size_t>({ 1, 0, 1, 0 }));
+    BOOST_CHECK_EQUAL(hypotheses[0].m_score, -2.125);
+
+    options.m_tokenInput = L"o1";
+    BOOST_REQUIRE_THROW(eval->BeamSearch(context, options, hypotheses), std::exception);
+
+    eval->Destroy();
+}
+
 BOOST_AUTO_TEST_CASE(EvalScalarTimesDualOutputTest)
 {
     std::string modelDefinition =
@@ -2,358 +2,788 @@
 // Copyright (c) Microsoft. All rights reserved.
 // Licensed under the MIT license. See LICENSE.md file in the project root for full license information.
 //
-// MathPerformanceTests.cpp : Defines the entry point for the console application.
+// MathPerformanceTests.cpp -- benchmarks of the kernels of the Math library
+//
+// Times GEMM in the shapes of our models, TensorView elementwise operations and reductions, sparse x dense products,
+// each ConvolutionEngineKind, the BlockMultiplier and the quantizers, on the CPU and on the GPUs. Each benchmark reports
+// the time per call, GFLOP/s and GB/s, the latter two also as fractions of the peaks of the device, and all of them
+// can be written to a JSON file, to compare them between releases. Usage (all arguments are optional):
+//
+//   MathPerformanceTests device=all|cpu|gpu|<deviceId> filter=<substring of group/name> json=<file>
+//                        minTime=<seconds per benchmark> convBatch=<images> cpuPeakGFlops=<n> cpuPeakGBps=<n>
+//
+// The peaks of a GPU are computed from its properties. The ones of the CPU cannot be found out reliably, so they
+// are taken from the spec sheet through cpuPeakGFlops and cpuPeakGBps; without them the fractions are not reported.
+// GB/s count the bytes that a kernel has to read and write at least, not what it actually moves.
 //
 #include "stdafx.h"
-//#define NOMINMAX
-//#include "Windows.h"
 #include "Matrix.h"
-#include "CPUMatrix.h"
 #include "TensorView.h"
-#include "Sequences.h"
+#include "TensorOps.h"
+#include "CPUTensorKernels.h"
+#include "ConvolutionEngine.h"
+#include "ConvolveGeometry.h"
+#include "Quantizers.h"
+#include "QuantizedMatrix.h"
+#include "MatrixQuantizerImpl.h"
+#include "BlockMultiplier.h"
+#ifndef CPUONLY
+#include <cuda_runtime_api.h>
+#endif
 #include <chrono>
 #include <iostream>
+#include <fstream>
+#include <sstream>
+#include <iomanip>
 #include <vector>
+#include <random>
 #include <algorithm>
+#include <functional>
+#include <memory>
 
 using namespace Microsoft::MSR::CNTK;
 using namespace std;
 
-template <class ElemType>
-void randomInitializeCPUMatrix(CPUMatrix<ElemType>& M, float min = -10, float max = 10)
+struct Options
+{
+    string devices = "all";
+    string filter;
+    string json;
+    double minTime = 0.5;
+    size_t convBatch = 8;
+    double cpuPeakGFlops = 0;
+    double cpuPeakGBps = 0;
+};
+
+struct Device
 {
-    foreach_coord (i, j, M)
+    DEVICEID_TYPE id;
+    string name;
+    double peakGFlops; // 0 if not known
+    double peakGBps;
+};
+
+struct Result
+{
+    string group;
+    string name;
+    const Device* device;
+    double msPerCall;
+    double gflops; // 0 if not meaningful
+    double gbps;
+    string skipped; // why it did not run
+};
+
+#ifndef CPUONLY
+// FP32 cores per multiprocessor, by compute capability
+static int CoresPerMultiprocessor(int major, int minor)
+{
+    switch (major)
     {
-        M(i, j) = (1.0 * rand() / RAND_MAX) * max + min;
+    case 2: return minor == 0 ? 32 : 48;
+    case 3: return 192;
+    case 5: return 128;
+    case 6: return minor == 0 ? 64 : 128;
+    case 7: return 64;
+    case 8: return minor == 0 ? 64 : 128;
+    default: return 64;
     }
 }
+#endif
 
-template <class ElemType>
-void randomInitializeMatrix(Matrix<ElemType>& M, float min = -10, float max = 10)
+static vector<Device> GetDevices(const Options& options)
 {
-    foreach_coord (i, j, M)
+    vector<Device> devices;
+    if (options.devices == "all" || options.devices == "cpu")
+        devices.push_back(Device{ CPUDEVICE, "CPU", options.cpuPeakGFlops, options.cpuPeakGBps });
+#ifndef CPUONLY
+    int numGpus = 0;
+    if (cudaGetDeviceCount(&numGpus) != cudaSuccess)
+        numGpus = 0;
+    for (int id = 0; id < numGpus; id++)
     {
-        M(i, j) = (1.0 * rand() / RAND_MAX) * max + min;
+        if (options.devices != "all" && options.devices != "gpu" && options.devices != to_string(id))
+            continue;
+        cudaDeviceProp props;
+        if (cudaGetDeviceProperties(&props, id) != cudaSuccess)
+            continue;
+        // clock rates are in kHz, and the memory transfers twice per clock
+        double peakGFlops = 2.0 * CoresPerMultiprocessor(props.major, props.minor) * props.multiProcessorCount * props.clockRate * 1e-6;
+        double peakGBps = 2.0 * props.memoryClockRate * (props.memoryBusWidth / 8) * 1e-6;
+        devices.push_back(Device{ id, "GPU " + to_string(id) + " (" + props.name + ")", peakGFlops, peakGBps });
     }
+#endif
+    if (devices.empty())
+        RuntimeError("No device matches device=%s.", options.devices.c_str());
+    return devices;
 }
 
-template <class ElemType>
-void MultiplyAndWeightedAddTest(int n, int k, int m)
+// waits for the kernels queued on the device
+static void Synchronize(DEVICEID_TYPE deviceId)
 {
-    cout << "Testing CPUMatrix" << endl;
-    cout << "A(" << n << "x" << k << ") and B(" << k << "," << m << ")" << endl;
-    CPUMatrix<ElemType> A(n, k);
-    randomInitializeCPUMatrix<ElemType>(A);
-    CPUMatrix<ElemType> B(k, m);
-    randomInitializeCPUMatrix<ElemType>(B);
-    CPUMatrix<ElemType> C(n, m);
-    auto t_start = clock();
-    CPUMatrix<ElemType>::MultiplyAndWeightedAdd(0.324, A, false, B, false, 0.632, C);
-    auto t_end = clock();
-    std::cout << "CPU Matrix in: " << 1.0 * (t_end - t_start) / CLOCKS_PER_SEC << " seconds" << endl;
-    std::cout << n << " " << k << " " << m << endl;
-
-    cout << "Testing Matrix" << endl;
-    Matrix<ElemType> AG((size_t) n, (size_t) k);
-    randomInitializeMatrix<ElemType>(AG);
-    Matrix<ElemType> BG((size_t) k, (size_t) m);
-    randomInitializeMatrix<ElemType>(BG);
-    Matrix<ElemType> CG((size_t) n, (size_t) m);
-    auto t_startG = clock();
-    Matrix<ElemType>::MultiplyAndWeightedAdd(0.324, AG, false, BG, false, 0.632, CG);
-    auto t_endG = clock();
-    std::cout << "Matrix in: " << 1.0 * (t_endG - t_startG) / CLOCKS_PER_SEC << " seconds" << endl;
+#ifndef CPUONLY
+    if (deviceId >= 0)
+        cudaDeviceSynchronize();
+#else
+    deviceId;
+#endif
 }
 
-template <class ElemType>
-void AddMultiplyAndInplaceSigmoidTest(int n, int k, int m)
+class Benchmarks
 {
-    cout << "Testing CPUMatrix" << endl;
-    cout << "A(" << n << "x" << k << ") and B(" << k << "," << m << ")" << endl;
-    CPUMatrix<ElemType> A(n, k);
-    randomInitializeCPUMatrix<ElemType>(A);
-    CPUMatrix<ElemType> B(k, m);
-    randomInitializeCPUMatrix<ElemType>(B);
-    CPUMatrix<ElemType> D(n, m);
-    randomInitializeCPUMatrix<ElemType>(D);
-    CPUMatrix<ElemType> C(n, m);
-    auto t_start = clock();
-    C = A * B + D;
-    // C.InplaceSigmoid();
-    auto t_end = clock();
-    std::cout << "CPU Matrix in: " << 1.0 * (t_end - t_start) / CLOCKS_PER_SEC << " seconds" << endl;
-    std::cout << n << " " << k << " " << m << endl;
-
-    cout << "Testing Matrix" << endl;
-    Matrix<ElemType> AG((size_t) n, (size_t) k);
-    randomInitializeMatrix<ElemType>(AG);
-    Matrix<ElemType> BG((size_t) k, (size_t) m);
-    randomInitializeMatrix<ElemType>(BG);
-    Matrix<ElemType> DG((size_t) n, (size_t) m);
-    randomInitializeMatrix<ElemType>(DG);
-    Matrix<ElemType> CG((size_t) n, (size_t) m);
-    auto t_startG = clock();
-    CG = AG * BG + DG;
-    // CG.InplaceSigmoid();
-    auto t_endG = clock();
-    std::cout << "Matrix in: " << 1.0 * (t_endG - t_startG) / CLOCKS_PER_SEC << " seconds" << endl;
-}
+public:
+    typedef function<void()> Kernel;
 
-template <class ElemType>
-void SquareMultiplyAndAdd10TimesAvgTest(int n, int count)
-{
-    cout << "Testing CPUMatrix" << endl;
-    cout << "A(" << n << "x" << n << ") and B(" << n << "," << n << ")" << endl;
+    Benchmarks(const Options& options)
+        : m_options(options)
+    {
+    }
 
-    double cpu_avg = 0;
-    for (int i = 0; i < count; ++i)
+    // Runs 'setup', which allocates the operands and returns the kernel to time, and calls that kernel on 'device' for at
+    // least minTime seconds. 'flops' and 'bytes' are per call, 0 if not meaningful. A benchmark that throws, e.g. because
+    // the device does not support it, is reported as skipped.
+    void Run(const string& group, const string& name, const Device& device, double flops, double bytes, const function<Kernel()>& setup)
     {
-        CPUMatrix<ElemType> A(n, n);
-        randomInitializeCPUMatrix<ElemType>(A);
-        CPUMatrix<ElemType> B(n, n);
-        randomInitializeCPUMatrix<ElemType>(B);
-        CPUMatrix<ElemType> C(n, n);
-        auto t_start = clock();
-        CPUMatrix<ElemType>::MultiplyAndWeightedAdd(0.324, A, false, B, false, 0.632, C);
-        auto t_end = clock();
-        double val = 1.0 * (t_end - t_start) / CLOCKS_PER_SEC;
-        if (i == 0)
+        if (!m_options.filter.empty() && (group + "/" + name).find(m_options.filter) == string::npos)
+            return;
+
+        Result result{ group, name, &device, 0, 0, 0, "" };
+        try
         {
-            cpu_avg = val;
+            if (device.id >= 0)
+                Matrix<float>::SetDevice(device.id);
+            auto kernel = setup();
+
+            // warm-up, which also takes the allocations and the autotuning of the engines
+            kernel();
+            Synchronize(device.id);
+
+            size_t numCalls = 0;
+            double seconds = 0;
+            for (size_t batch = 1; seconds < m_options.minTime; batch *= 2)
+            {
+                auto start = chrono::high_resolution_clock::now();
+                for (size_t i = 0; i < batch; i++)
+                    kernel();
+                Synchronize(device.id);
+                seconds += chrono::duration<double>(chrono::high_resolution_clock::now() - start).count();
+                numCalls += batch;
+            }
+            double secondsPerCall = seconds / numCalls;
+            result.msPerCall = secondsPerCall * 1e3;
+            result.gflops = flops / secondsPerCall * 1e-9;
+            result.gbps = bytes / secondsPerCall * 1e-9;
         }
-        else
+        catch (const exception& e)
         {
-            cpu_avg = cpu_avg * (i - 1) / i + val / i;
+            result.skipped = e.what();
         }
+        Print(result);
+        m_results.push_back(move(result));
     }
 
-    cout << "Testing Matrix" << endl;
-    double m_avg = 0;
-    for (int i = 0; i < count; ++i)
+    void WriteJson(const string& path, const vector<Device>& devices) const
     {
-        Matrix<ElemType> AG((size_t) n, (size_t) n);
-        randomInitializeMatrix<ElemType>(AG);
-        Matrix<ElemType> BG((size_t) n, (size_t) n);
-        randomInitializeMatrix<ElemType>(BG);
-        Matrix<ElemType> CG((size_t) n, (size_t) n);
-        auto t_startG = clock();
-        Matrix<ElemType>::MultiplyAndWeightedAdd(0.324, AG, false, BG, false, 0.632, CG);
-        auto t_endG = clock();
-        double val = 1.0 * (t_endG - t_startG) / CLOCKS_PER_SEC;
-        if (i == 0)
+        ofstream f(path);
+        if (!f)
+            RuntimeError("Cannot open '%s' for writing.", path.c_str());
+        f << "{\n  \"devices\": [\n";
+        for (size_t i = 0; i < devices.size(); i++)
         {
-            m_avg = val;
+            f << "    { \"id\": " << devices[i].id << ", \"name\": " << Quote(devices[i].name)
+              << ", \"peakGFlops\": " << Number(devices[i].peakGFlops) << ", \"peakGBps\": " << Number(devices[i].peakGBps) << " }"
+              << (i + 1 < devices.size() ? ",\n" : "\n");
         }
-        else
+        f << "  ],\n  \"results\": [\n";
+        for (size_t i = 0; i < m_results.size(); i++)
         {
-            m_avg = m_avg * (i - 1) / i + val / i;
+            const auto& r = m_results[i];
+            f << "    { \"group\": " << Quote(r.group) << ", \"name\": " << Quote(r.name) << ", \"device\": " << r.device->id;
+            if (!r.skipped.empty())
+                f << ", \"skipped\": " << Quote(r.skipped);
+            else
+            {
+                f << ", \"msPerCall\": " << Number(r.msPerCall) << ", \"gflops\": " << Number(r.gflops) << ", \"gbps\": " << Number(r.gbps)
+                  << ", \"fractionOfPeakGFlops\": " << Number(Fraction(r.gflops, r.device->peakGFlops))
+                  << ", \"fractionOfPeakGBps\": " << Number(Fraction(r.gbps, r.device->peakGBps));
+            }
+            f << " }" << (i + 1 < m_results.size() ? ",\n" : "\n");
         }
+        f << "  ]\n}\n";
     }
 
-    cout << "Based on " << count << " runs:" << endl;
-    cout << "Average time for CPUMatrix is: " << cpu_avg << " seconds" << endl;
-    cout << "Average time for Matrix is: " << m_avg << " seconds" << endl;
-    cout << "CPUMatrix/Matrix ratio is: " << cpu_avg / m_avg << " seconds" << endl;
-}
-
-// simple test suite for TensorView
-//  - this is meant for performance optimization
-//  - correctness is defined as same result between GPU and CPU
-template <class ElemType>
-struct TensorTest
-{
-    // helper to create a randomly initialized tensor object
-    static TensorView<ElemType> CreateTensor(TensorShape shape, int randomSeed, DEVICEID_TYPE deviceId, bool isResult = false)
+private:
+    static double Fraction(double value, double peak)
     {
-        let numElements = shape.GetNumElements();
-
-        if (isResult)
-            cout << " ->";
-        cout << " [" << string(shape) << "]";
-        if (isResult)
-            cout << " \t// " << (deviceId < 0 ? "C" : "G") << "PU\n   " << flush;
-
-        // random init
-        mt19937 rng(randomSeed);
-        uniform_real_distribution<float> nd(-1, 1);
-        vector<ElemType> init(numElements);
-        generate(begin(init), end(init), [&] { return nd(rng); });
-
-        // create storage object (one-column matrix)
-        let sob = make_shared<Matrix<ElemType>>(numElements/*rows*/, 1/*cols*/, init.data(), deviceId);
+        return value > 0 && peak > 0 ? value / peak : 0;
+    }
 
-        // create TensorView
-        return TensorView<ElemType>(sob, shape);
+    // JSON null for the values that are not meaningful or not known
+    static string Number(double value)
+    {
+        if (value <= 0)
+            return "null";
+        ostringstream s;
+        s.precision(6);
+        s << value;
+        return s.str();
     }
 
-    // test bias gradient (reduction)
-    static TensorView<ElemType> BiasGradientTest(TensorShape layerShape, TensorShape biasShape, DEVICEID_TYPE deviceId)
+    static string Quote(const string& s)
     {
-        int randomSeed = 1;
-        let  gradient = CreateTensor(layerShape, randomSeed++, deviceId);
-        auto bias = CreateTensor(biasShape, randomSeed++, deviceId, true);
-        //gradient.GetSOB().Print("incoming gradient", 0, 9, 0, 9);
-        //bias.GetSOB().Print("bias gradient", 0, 9, 0, 9);
-        bias.DoCopyOf(1, gradient, 1);
-        //bias.GetSOB().Print("updated bias gradient", 0, 9, 0, 9);
-        return bias;
+        string quoted = "\"";
+        for (char c : s)
+        {
+            if (c == '"' || c == '\\')
+                quoted += '\\';
+            if (c == '\n')
+                quoted += "\\n";
+            else
+                quoted += c;
+        }
+        return quoted + "\"";
     }
 
-    // test broadcast summation gradient
-    static TensorView<ElemType> BroadcastingTest(TensorShape layerShape, TensorShape biasShape, DEVICEID_TYPE deviceId)
+    void Print(const Result& r) const
     {
-        int randomSeed = 1;
-        let  input  = CreateTensor(layerShape, randomSeed++, deviceId);
-        auto bias   = CreateTensor(biasShape,  randomSeed++, deviceId);
-        //input.GetSOB().Print("input data", 0, 9, 0, 9);
-        //bias.GetSOB().Print("bias", 0, 9, 0, 9);
-        auto result = CreateTensor(layerShape, randomSeed++, deviceId, true);
-        result.AssignSumOf(input, bias);
-        return result;
+        fprintf(stderr, "%-12s %-48s %-6s ", r.group.c_str(), r.name.c_str(), r.device->id < 0 ? "CPU" : ("GPU " + to_string(r.device->id)).c_str());
+        if (!r.skipped.empty())
+        {
+            fprintf(stderr, "skipped: %s\n", r.skipped.c_str());
+            return;
+        }
+        fprintf(stderr, "%10.4f ms", r.msPerCall);
+        if (r.gflops > 0)
+            fprintf(stderr, " %9.1f GFLOP/s", r.gflops);
+        if (r.device->peakGFlops > 0 && r.gflops > 0)
+            fprintf(stderr, " (%5.1f%%)", 100 * r.gflops / r.device->peakGFlops);
+        if (r.gbps > 0)
+            fprintf(stderr, " %8.1f GB/s", r.gbps);
+        if (r.device->peakGBps > 0 && r.gbps > 0)
+            fprintf(stderr, " (%5.1f%%)", 100 * r.gbps / r.device->peakGBps);
+        fprintf(stderr, "\n");
     }
 
-    // run one test for both GPU and CPU and verify they are the same
-    template<typename FN>
-    static void OneTensorTest(const char* what, double tolerance, const FN& fn)
+    const Options& m_options;
+    vector<Result> m_results;
+};
+
+static shared_ptr<Matrix<float>> RandomMatrix(size_t rows, size_t cols, DEVICEID_TYPE deviceId, unsigned long seed)
+{
+    return make_shared<Matrix<float>>(Matrix<float>::RandomUniform(rows, cols, deviceId, -1, 1, seed));
+}
+
+// ---------------------------------------------------------------------------
+// GEMM
+// ---------------------------------------------------------------------------
+
+static void GemmBenchmarks(Benchmarks& benchmarks, const Device& device)
+{
+    struct
+    {
+        const char* model;
+        size_t m, k, n;
+        bool transposeA, transposeB;
+    } shapes[] = {
+        { "DNN hidden layer",             2048, 2048,   256, false, false },
+        { "DNN output layer",             9000, 2048,   256, false, false },
+        { "DNN weight gradient",          2048,  256,  2048, false, true  },
+        { "DNN input gradient",           2048, 2048,   256, true,  false },
+        { "LSTM gates",                   4096, 1024,    64, false, false },
+        { "LSTM gates, one sequence",     4096, 1024,     1, false, false },
+        { "ResNet 3x3 conv, unrolled",      64,  576, 12544, false, false },
+        { "ResNet 1x1 conv, unrolled",     256,   64, 12544, false, false },
+        { "square",                       4096, 4096,  4096, false, false },
+    };
+    for (const auto& s : shapes)
     {
-        cout << "===== Tensor test '" << what << "'\n   ";
-
-        // run on GPU and CPU
-        let resultGPU = fn(0);
-        let resultCPU = fn(-1);
-
-        // dump top corner of the result to get a feel for the error
-        resultGPU.GetSOB().Print("GPU result", 0, 7, 0, 9);
-        resultGPU.GetSOB().TransferToDeviceIfNotThere(-1, true, false, true);
-        resultCPU.GetSOB().Print("CPU result", 0, 7, 0, 9);
-
-        // compare
-        let isSame = resultGPU.GetSOB().IsEqualTo(resultCPU.GetSOB(), (ElemType)tolerance);
-        cout << (isSame ? " --> SUCCEEDED. =====\n" : " --> FAILED (GPU and CPU results differ). =====\n") << endl << flush;
-        if (!isSame)
-            sin(1.0);  // set breakpoint here
+        ostringstream name;
+        name << s.model << " [" << s.m << " x " << s.k << "]" << (s.transposeA ? "'" : "") << " * [" << s.k << " x " << s.n << "]" << (s.transposeB ? "'" : "");
+        double flops = 2.0 * s.m * s.k * s.n;
+        double bytes = sizeof(float) * (s.m * s.k + s.k * s.n + 2.0 * s.m * s.n);
+        benchmarks.Run("gemm", name.str(), device, flops, bytes, [&]() -> Benchmarks::Kernel
+        {
+            auto a = s.transposeA ? RandomMatrix(s.k, s.m, device.id, 1) : RandomMatrix(s.m, s.k, device.id, 1);
+            auto b = s.transposeB ? RandomMatrix(s.n, s.k, device.id, 2) : RandomMatrix(s.k, s.n, device.id, 2);
+            auto c = RandomMatrix(s.m, s.n, device.id, 3);
+            bool transposeA = s.transposeA, transposeB = s.transposeB;
+            return [=]() { Matrix<float>::MultiplyAndWeightedAdd(1.0f, *a, transposeA, *b, transposeB, 1.0f, *c); };
+        });
     }
+}
 
-    // main entry point (misusing the constructor)
-    /*void*/ TensorTest()
+// ---------------------------------------------------------------------------
+// TensorView
+// ---------------------------------------------------------------------------
+
+static TensorView<float> RandomTensor(const TensorShape& shape, DEVICEID_TYPE deviceId, unsigned long seed)
+{
+    return TensorView<float>(RandomMatrix(shape.GetNumElements(), 1, deviceId, seed), shape);
+}
+
+static void TensorBenchmarks(Benchmarks& benchmarks, const Device& device)
+{
+    // elementwise, with as many operands as the operation has inputs; flops count one per output element
+    struct
+    {
+        const char* name;
+        ElementWiseOperator op;
+        size_t arity;
+        TensorShape shape, bShape;
+    } elementwise[] = {
+        { "sum [2048 x 1024]",                                 opSum,        2, TensorShape(2048, 1024),        TensorShape(2048, 1024) },
+        { "bias [28 x 28 x 128 x 32] + [1 x 1 x 128]",         opSum,        2, TensorShape(28, 28, 128, 32),   TensorShape(1, 1, 128) },
+        { "bias [2048 x 1024] + [2048]",                       opSum,        2, TensorShape(2048, 1024),        TensorShape(2048) },
+        { "product [2048 x 1024]",                             opElementwiseProduct, 2, TensorShape(2048, 1024), TensorShape(2048, 1024) },
+        { "sigmoid [2048 x 1024]",                             opSigmoid,    1, TensorShape(2048, 1024),        TensorShape() },
+        { "tanh [2048 x 1024]",                                opTanh,       1, TensorShape(2048, 1024),        TensorShape() },
+        { "ReLU [56 x 56 x 64 x 32]",                          opLinearRectifier, 1, TensorShape(56, 56, 64, 32), TensorShape() },
+        { "sigmoid gradient [2048 x 1024]",                    opElementwiseProductWithSigmoidDerivativeFromOutput, 2, TensorShape(2048, 1024), TensorShape(2048, 1024) },
+    };
+    for (const auto& e : elementwise)
     {
-        // --- elementwise
+        double numElements = (double) e.shape.GetNumElements();
+        double bytes = sizeof(float) * (numElements * (e.arity == 1 || e.bShape.GetNumElements() < e.shape.GetNumElements() ? 2 : 3));
+        benchmarks.Run("elementwise", e.name, device, numElements, bytes, [&]() -> Benchmarks::Kernel
+        {
+            auto a = RandomTensor(e.shape, device.id, 1);
+            auto c = RandomTensor(e.shape, device.id, 3);
+            auto op = e.op;
+            if (e.arity == 1)
+                return [=]() mutable { c.DoUnaryOpOf(0, a, 1, op, opSum); };
+            auto b = RandomTensor(e.bShape, device.id, 2);
+            return [=]() mutable { c.DoBinaryOpOf(0, a, b, 1, op, opSum); };
+        });
+    }
 
-        // elementwise sum
-        OneTensorTest("elementwise addition", 1e-8, [](DEVICEID_TYPE deviceId) -> TensorView<ElemType>
+    // reductions of the first shape into the second
+    struct
+    {
+        const char* name;
+        ElementWiseOperator reductionOp;
+        TensorShape shape, reducedShape;
+    } reductions[] = {
+        { "DNN bias gradient [2048 x 1024] -> [2048]",             opSum, TensorShape(2048, 1024),      TensorShape(2048) },
+        { "conv bias gradient [56 x 56 x 64 x 32] -> [1 x 1 x 64]", opSum, TensorShape(56, 56, 64, 32), TensorShape(1, 1, 64) },
+        { "column sums [2048 x 1024] -> [1 x 1024]",                opSum, TensorShape(2048, 1024),      TensorShape(1, 1024) },
+        { "sum [16M] -> [1]",                                       opSum, TensorShape(16 * 1024 * 1024), TensorShape(1) },
+        { "max [2048 x 1024] -> [1 x 1024]",                        opMax, TensorShape(2048, 1024),      TensorShape(1, 1024) },
+    };
+    for (const auto& r : reductions)
+    {
+        double numElements = (double) r.shape.GetNumElements();
+        double bytes = sizeof(float) * (numElements + r.reducedShape.GetNumElements());
+        benchmarks.Run("reduction", r.name, device, numElements, bytes, [&]() -> Benchmarks::Kernel
         {
-            return BroadcastingTest(TensorShape{ 512, 256 }, TensorShape({ 512, 256 }), deviceId);
+            auto a = RandomTensor(r.shape, device.id, 1);
+            auto c = RandomTensor(r.reducedShape, device.id, 2);
+            auto reductionOp = r.reductionOp;
+            return [=]() mutable { c.DoUnaryOpOf(0, a, 1, opCopy, reductionOp); };
         });
+    }
+}
 
-        // --- broadcasting
+// the CPU kernels of each instruction set of the host, on one thread, which TensorView picks from
+static void CPUTensorKernelBenchmarks(Benchmarks& benchmarks, const Device& device)
+{
+    if (device.id != CPUDEVICE)
+        return;
+    const size_t n = 1024 * 1024;
+    for (auto isa : { CPUTensorKernels::ISA::Scalar, CPUTensorKernels::ISA::AVX2, CPUTensorKernels::ISA::AVX512 })
+    {
+        auto kernels = CPUTensorKernels::Get(isa);
+        if (!kernels)
+            continue;
+        auto a = make_shared<vector<float>>(n), b = make_shared<vector<float>>(n), c = make_shared<vector<float>>(n);
+        mt19937 rng(1);
+        uniform_real_distribution<float> nd(-1, 1);
+        generate(a->begin(), a->end(), [&] { return nd(rng); });
+        generate(b->begin(), b->end(), [&] { return nd(rng); });
 
-        // simple broadcasting
-        OneTensorTest("addition wth simple broadcasting", 1e-8, [](DEVICEID_TYPE deviceId) -> TensorView<ElemType>
+        string prefix = string(kernels->Name()) + " ";
+        benchmarks.Run("cpuKernels", prefix + "sigmoid [1M]", device, n, 2.0 * sizeof(float) * n, [&]() -> Benchmarks::Kernel
         {
-            return BroadcastingTest(TensorShape{ 3, 2 }, TensorShape({ 3, 1 }), deviceId);
+            auto unary = kernels->Unary(opSigmoid);
+            return [=]() { unary(a->data(), c->data(), n, 1, 0); };
         });
-        // typical bias for convolutional layer
-        OneTensorTest("bias addition (broadcasting)", 1e-8, [](DEVICEID_TYPE deviceId) -> TensorView<ElemType>
+        benchmarks.Run("cpuKernels", prefix + "sigmoid gradient [1M]", device, n, 3.0 * sizeof(float) * n, [&]() -> Benchmarks::Kernel
         {
-            return BroadcastingTest(TensorShape{ 28, 28, 128, 32 }, TensorShape({ 1, 1, 128 }), deviceId);
+            auto binary = kernels->Binary(opElementwiseProductWithSigmoidDerivativeFromOutput);
+            return [=]() { binary(a->data(), b->data(), c->data(), n, 1, 0); };
         });
-        // BUGBUG: This test is strange--Print() shows different values with depth 128 instead of 64, but IsEqual() does not fail with 1e-3 tolerance.
-        //         Something fishy going on. Dimension overflow?
-        OneTensorTest("bias addition (broadcasting)", 1e-8, [](DEVICEID_TYPE deviceId) -> TensorView<ElemType>
+        benchmarks.Run("cpuKernels", prefix + "sum [1M]", device, n, sizeof(float) * n, [&]() -> Benchmarks::Kernel
         {
-            return BroadcastingTest(TensorShape{ 256, 256, 64, 32 }, TensorShape({ 1, 1, 64 }), deviceId);
+            auto reduction = kernels->Reduction(opSum);
+            return [=]() { reduction(a->data(), n); };
         });
 
-        // --- reduction
+        // fast-math inference (see FastMathOpOf()) against the exact ops, with the largest error over the inputs in the name
+        auto x = make_shared<vector<float>>(n), positive = make_shared<vector<float>>(n);
+        uniform_real_distribution<float> wide(-8, 8);
+        generate(x->begin(), x->end(), [&] { return wide(rng); });
+        transform(x->begin(), x->end(), positive->begin(), [](float v) { return fabs(v) + 1e-6f; });
+        struct
+        {
+            const char* name;
+            ElementWiseOperator op;
+            bool isRelative; // error relative to the exact value, else absolute
+        } ops[] = {
+            { "sigmoid", opSigmoid, false },
+            { "tanh",    opTanh,    false },
+            { "exp",     opExp,     true  },
+            { "log",     opLog,     false },
+        };
+        for (const auto& o : ops)
+        {
+            auto input = o.op == opLog ? positive : x;
+            auto exact = make_shared<vector<float>>(n), fast = make_shared<vector<float>>(n);
+            for (auto op : { o.op, FastMathOpOf(o.op) })
+            {
+                auto unary = kernels->Unary(op);
+                auto output = op == o.op ? exact : fast;
+                if (unary)
+                    unary(input->data(), output->data(), n, 1, 0);
+                else // opLog has no kernel
+                    transform(input->begin(), input->end(), output->begin(), [](float v) { return OpLog(v); });
+            }
+            double maxError = 0;
+            for (size_t i = 0; i < n; i++)
+                maxError = max(maxError, fabs((double) (*fast)[i] - (*exact)[i]) / (o.isRelative ? fabs((*exact)[i]) : 1.0));
+            ostringstream fastName;
+            fastName << prefix << "fast " << o.name << " [1M], max error " << setprecision(2) << maxError;
+            for (auto op : { o.op, FastMathOpOf(o.op) })
+            {
+                if (!kernels->Unary(op))
+                    continue;
+                benchmarks.Run("cpuKernels", op == o.op ? prefix + "exact " + o.name + " [1M]" : fastName.str(), device, n, 2.0 * sizeof(float) * n, [&]() -> Benchmarks::Kernel
+                {
+                    auto unary = kernels->Unary(op);
+                    return [=]() { unary(input->data(), c->data(), n, 1, 0); };
+                });
+            }
+        }
+    }
+}
+
+// ---------------------------------------------------------------------------
+// sparse x dense
+// ---------------------------------------------------------------------------
 
-        // typical bias gradient (reduction) for FF-DNN
-        OneTensorTest("bias gradient (reduction)", 1e-4, [](DEVICEID_TYPE deviceId) -> TensorView<ElemType>
+static void SparseBenchmarks(Benchmarks& benchmarks, const Device& device)
+{
+    // embeddings [dim x vocab] of sparse inputs [vocab x batch] in CSC, with 'nnz' non-zeros per column
+    struct
+    {
+        const char* model;
+        size_t dim, vocab, batch, nnz;
+    } shapes[] = {
+        { "word embedding, one-hot",   512, 100000, 1024, 1 },
+        { "text classification, bag of words", 256, 100000,  256, 50 },
+    };
+    for (const auto& s : shapes)
+    {
+        ostringstream shape;
+        shape << " [" << s.dim << " x " << s.vocab << "], [" << s.vocab << " x " << s.batch << "] with " << s.nnz << " nnz/column";
+        double numNonZeros = (double) s.batch * s.nnz;
+        double flops = 2.0 * s.dim * numNonZeros;
+        // the columns of the dense operand that the non-zeros select, the dense result, and the CSC arrays
+        double bytes = sizeof(float) * (s.dim * numNonZeros + s.dim * s.batch) + (sizeof(float) + sizeof(CPUSPARSE_INDEX_TYPE)) * numNonZeros;
+
+        auto makeSparse = [&]() -> shared_ptr<Matrix<float>>
+        {
+            mt19937 rng(1);
+            uniform_int_distribution<CPUSPARSE_INDEX_TYPE> row(0, (CPUSPARSE_INDEX_TYPE) s.vocab - 1);
+            vector<CPUSPARSE_INDEX_TYPE> colStarts(s.batch + 1), rows(s.batch * s.nnz);
+            vector<float> values(s.batch * s.nnz, 1.0f);
+            for (size_t j = 0; j < s.batch; j++)
+            {
+                colStarts[j] = (CPUSPARSE_INDEX_TYPE) (j * s.nnz);
+                auto begin = rows.begin() + j * s.nnz;
+                generate(begin, begin + s.nnz, [&] { return row(rng); });
+                sort(begin, begin + s.nnz);
+            }
+            colStarts[s.batch] = (CPUSPARSE_INDEX_TYPE) rows.size();
+            auto x = make_shared<Matrix<float>>(s.vocab, s.batch, device.id, MatrixType::SPARSE, matrixFormatSparseCSC);
+            x->SetMatrixFromCSCFormat(colStarts.data(), rows.data(), values.data(), rows.size(), s.vocab, s.batch);
+            return x;
+        };
+
+        benchmarks.Run("sparse", string(s.model) + " forward" + shape.str(), device, flops, bytes, [&]() -> Benchmarks::Kernel
         {
-            return BiasGradientTest(TensorShape{ 2048, 1024 }, TensorShape(2048), deviceId);
+            auto w = RandomMatrix(s.dim, s.vocab, device.id, 1);
+            auto x = makeSparse();
+            auto y = RandomMatrix(s.dim, s.batch, device.id, 2);
+            return [=]() { Matrix<float>::MultiplyAndWeightedAdd(1.0f, *w, false, *x, false, 0.0f, *y); };
         });
-        // typical bias gradient (reduction) for convolutional layer
-        OneTensorTest("bias gradient (reduction)", 1e-1, [](DEVICEID_TYPE deviceId) -> TensorView<ElemType>
+        benchmarks.Run("sparse", string(s.model) + " gradient" + shape.str(), device, flops, bytes, [&]() -> Benchmarks::Kernel
         {
-            return BiasGradientTest(TensorShape{ 256, 256, 64, 32 }, TensorShape({ 1, 1, 64 }), deviceId);
+            auto g = RandomMatrix(s.dim, s.batch, device.id, 1);
+            auto x = makeSparse();
+            auto wGradient = RandomMatrix(s.dim, s.vocab, device.id, 2);
+            return [=]() { Matrix<float>::MultiplyAndWeightedAdd(1.0f, *g, false, *x, true, 1.0f, *wGradient); };
         });
     }
-};
+}
+
+// ---------------------------------------------------------------------------
+// convolution engines
+// ---------------------------------------------------------------------------
 
-template <class ElemType>
-void MandSTest(int count, int devId)
+static void ConvolutionBenchmarks(Benchmarks& benchmarks, const Device& device, size_t batch)
 {
-    ElemType* arr = new ElemType[count];
-    for (int i = 0; i < count; ++i)
-        arr[i] = (1.0 * rand()) / RAND_MAX + 1;
-
-    ElemType* data1 = new ElemType[1024 * 4096];
-    for (int i = 0; i < 1024 * 4096; ++i)
-        data1[i] = (1.0 * rand()) / RAND_MAX + 1;
-
-    ElemType* data2 = new ElemType[1024 * 4096];
-    for (int i = 0; i < 1024 * 4096; ++i)
-        data2[i] = (1.0 * rand()) / RAND_MAX + 1;
-
-    ElemType* data3 = new ElemType[1024];
-    for (int i = 0; i < 1024; ++i)
-        data3[i] = (1.0 * rand()) / RAND_MAX + 1;
-
-    cout << "Testing Matrix" << endl;
-    Matrix<ElemType> A(1024, 4096, data1, true, devId);
-    Matrix<ElemType> B(4096, 1024, data2, true, devId);
-    Matrix<ElemType> V(1024, 1, data3, true, devId);
-    Matrix<ElemType> C(1024, 1024, devId);
-
-    auto t_startG = clock();
-    for (int i = 0; i < count; ++i)
+    struct
     {
-        // Matrix<ElemType>::MultiplyAndWeightedAdd(arr[i],A,false,B,false,3.2*arr[i],C);
-        C += (A * arr[i]) * (B * (arr[i] * 2.3));
+        const char* name;
+        ConvolveGeometryPtr geometry;
+    } geometries[] = {
+        { "ResNet 7x7/2 conv [224 x 224 x 3] -> 64",
+          make_shared<ConvolveGeometry>(TensorShape(224, 224, 3), TensorShape(7, 7, 3), TensorShape(64), TensorShape(2, 2, 3),
+                                        ConvolveGeometry::BoolVec{ true }, ConvolveGeometry::BoolVec{ true, true, false }, TensorShape(0), TensorShape(0)) },
+        { "ResNet 3x3 conv [56 x 56 x 64] -> 64",
+          make_shared<ConvolveGeometry>(TensorShape(56, 56, 64), TensorShape(3, 3, 64), TensorShape(64), TensorShape(1, 1, 64),
+                                        ConvolveGeometry::BoolVec{ true }, ConvolveGeometry::BoolVec{ true, true, false }, TensorShape(0), TensorShape(0)) },
+        { "ResNet 1x1 conv [56 x 56 x 64] -> 256",
+          make_shared<ConvolveGeometry>(TensorShape(56, 56, 64), TensorShape(1, 1, 64), TensorShape(256), TensorShape(1, 1, 64),
+                                        ConvolveGeometry::BoolVec{ true }, ConvolveGeometry::BoolVec{ false }, TensorShape(0), TensorShape(0)) },
+    };
+    struct
+    {
+        const char* name;
+        ConvolutionEngineKind kind;
+    } engines[] = {
+        { "cuDNN",     ConvolutionEngineKind::CuDnn },
+        { "GEMM",      ConvolutionEngineKind::Gemm },
+        { "direct",    ConvolutionEngineKind::Direct },
+        { "legacy",    ConvolutionEngineKind::Legacy },
+        { "reference", ConvolutionEngineKind::Reference },
+    };
+    enum class Pass { Forward, BackwardData, BackwardKernel };
+    const char* passNames[] = { "forward", "backward data", "backward kernel" };
+
+    for (const auto& g : geometries)
+    {
+        const auto& geometry = g.geometry;
+        size_t inputSize = geometry->InputShape().GetNumElements();
+        size_t outputSize = geometry->OutputShape().GetNumElements();
+        size_t mapCount = geometry->GetMapCount(geometry->InputShape().GetRank() - 1);
+        size_t kernelSize = geometry->KernelShape().GetNumElements();
+        // every output element is a dot product with a kernel, and so is every gradient
+        double flops = 2.0 * outputSize * kernelSize * batch;
+        double bytes = sizeof(float) * ((double) (inputSize + outputSize) * batch + mapCount * kernelSize);
+
+        for (const auto& e : engines)
+        {
+            for (auto pass : { Pass::Forward, Pass::BackwardData, Pass::BackwardKernel })
+            {
+                ostringstream name;
+                name << g.name << ", " << e.name << " " << passNames[(int) pass] << ", batch " << batch;
+                benchmarks.Run("convolution", name.str(), device, flops, bytes, [&]() -> Benchmarks::Kernel
+                {
+                    // the legacy engine only supports HWC
+                    auto layout = e.kind == ConvolutionEngineKind::Legacy ? ImageLayoutKind::HWC : ImageLayoutKind::CHW;
+                    shared_ptr<ConvolutionEngine<float>> engine = ConvolutionEngine<float>::Create(geometry, device.id, layout, 0, PoolKind::None, e.kind);
+                    auto input = RandomMatrix(inputSize, batch, device.id, 1);
+                    auto kernel = RandomMatrix(mapCount, kernelSize, device.id, 2);
+                    auto output = RandomMatrix(outputSize, batch, device.id, 3);
+                    auto workspace = make_shared<Matrix<float>>(device.id);
+                    if (pass == Pass::Forward)
+                        return [=]() { engine->Forward(*input, *kernel, *output, *workspace); };
+                    if (pass == Pass::BackwardData)
+                        return [=]() { engine->BackwardData(*output, *kernel, *input, /*accumulateGradient=*/false, *workspace); };
+                    return [=]() { engine->BackwardKernel(*output, *input, *kernel, /*accumulateGradient=*/false, /*allowReuse=*/false, *workspace); };
+                });
+            }
+        }
     }
-    auto t_endG = clock();
-    double valM = 1.0 * (t_endG - t_startG) / (CLOCKS_PER_SEC * count);
-    cout << "Matrix C+=alpha*A*beta*B in: " << valM << " seconds" << endl;
-
-    cout << "Testing CPUMatrix" << endl;
-    CPUMatrix<ElemType> AC(1024, 4096, data1, true);
-    CPUMatrix<ElemType> BC(4096, 1024, data2, true);
-    CPUMatrix<ElemType> VC(1024, 1, data3, true);
-    CPUMatrix<ElemType> CC(1024, 1024);
-
-    auto t_startC = clock();
-    for (int i = 0; i < count; ++i)
+}
+
+// ---------------------------------------------------------------------------
+// BlockMultiplier
+// ---------------------------------------------------------------------------
+
+template <class BlockHandlerT>
+static void BlockMultiplierBenchmark(Benchmarks& benchmarks, const Device& device, const char* handlerName, int m, int k, int n, int numThreads)
+{
+    typedef BlockMultiplier<BlockHandlerT> Multiplier;
+    ostringstream name;
+    name << handlerName << " [" << m << " x " << k << "] * [" << k << " x " << n << "], " << numThreads << (numThreads == 1 ? " thread" : " threads");
+    double flops = 2.0 * m * k * n;
+    double bytes = sizeof(int16_t) * ((double) m * k + (double) k * n) + sizeof(int32_t) * (double) m * n;
+    benchmarks.Run("blockMultiplier", name.str(), device, flops, bytes, [&]() -> Benchmarks::Kernel
     {
-        CPUMatrix<ElemType>::MultiplyAndWeightedAdd(arr[i], AC, false, BC, false, 3.2 * arr[i], CC);
-        // CC+=(arr[i]*AC)*((arr[i]*2.3)*BC);
+        // the operands keep within the range for which the 32-bit accumulation cannot overflow
+        mt19937 rng(1);
+        uniform_int_distribution<int> nd(-100, 100);
+        auto multiplier = make_shared<Multiplier>(numThreads);
+        auto a = shared_ptr<int16_t>(Multiplier::CreateMatrixA(m, k), [](int16_t* p) { Multiplier::FreeMatrix(p); });
+        auto b = shared_ptr<int16_t>(Multiplier::CreateMatrixB(k, n), [](int16_t* p) { Multiplier::FreeMatrix(p); });
+        auto c = shared_ptr<int32_t>(Multiplier::CreateMatrixC(m, n), [](int32_t* p) { Multiplier::FreeMatrix(p); });
+        generate(a.get(), a.get() + m * k, [&] { return (int16_t) nd(rng); });
+        generate(b.get(), b.get() + k * n, [&] { return (int16_t) nd(rng); });
+        int16_t* preparedB = multiplier->PrepareB(b.get(), k, n);
+        auto preparedBOwner = preparedB == b.get() ? b : shared_ptr<int16_t>(preparedB, [](int16_t* p) { Multiplier::FreeMatrix(p); });
+        return [=]() { multiplier->MultiplyMatrices(a.get(), m, k, preparedBOwner.get(), n, c.get()); };
+    });
+}
+
+static void BlockMultiplierBenchmarks(Benchmarks& benchmarks, const Device& device)
+{
+    if (device.id != CPUDEVICE)
+        return;
+    // the quantized products of the evaluation of speech models, per frame and for a minibatch of frames
+    struct
+    {
+        int m, k, n;
+    } shapes[] = { { 512, 512, 1 }, { 2048, 2048, 4 }, { 2048, 2048, 64 } };
+    for (const auto& s : shapes)
+    {
+        for (int numThreads : { 1, 4 })
+        {
+            BlockMultiplierBenchmark<BlockHandlerSSE>(benchmarks, device, "SSE", s.m, s.k, s.n, numThreads);
+            if (BlockHandlerAVX512::IsSupported())
+                BlockMultiplierBenchmark<BlockHandlerAVX512>(benchmarks, device, "AVX-512", s.m, s.k, s.n, numThreads);
+        }
     }
-    auto t_endC = clock();
-    double valMC = 1.0 * (t_endC - t_startC) / (CLOCKS_PER_SEC * count);
-    cout << "CPUMatrix C+=alpha*A*beta*B in: " << valMC << " seconds" << endl;
-
-    delete[] arr;
-    delete[] data1;
-    delete[] data2;
-    delete[] data3;
 }
 
-int wmain()
+// ---------------------------------------------------------------------------
+// quantizers
+// ---------------------------------------------------------------------------
+
+static void QuantizerBenchmarks(Benchmarks& benchmarks, const Device& device)
 {
-    // MandSTest<float>(100, 2);
+    // the 16-bit quantizer of the quantized products, on the CPU only
+    if (device.id == CPUDEVICE)
+    {
+        const size_t n = 4 * 1024 * 1024;
+        benchmarks.Run("quantizer", "SymmetricQuantizer<float, short> quantize [4M]", device, 0, (sizeof(float) + sizeof(short)) * (double) n, [&]() -> Benchmarks::Kernel
+        {
+            auto input = make_shared<vector<float>>(n);
+            auto output = make_shared<vector<short>>(n);
+            mt19937 rng(1);
+            uniform_real_distribution<float> nd(-1, 1);
+            generate(input->begin(), input->end(), [&] { return nd(rng); });
+            auto quantizer = make_shared<SymmetricQuantizer<float, short>>(0);
+            return [=]()
+            {
+                ArrayRef<float> in(input->data(), n);
+                ArrayRef<short> out(output->data(), n);
+                quantizer->Quantize(in, out);
+            };
+        });
+    }
 
-    /*cout<<endl<<"********************Matrix SquareMultiplyAndWeightedAdd10TimesAvg TEST********************"<<endl;
-    SquareMultiplyAndAdd10TimesAvgTest<float>(4096,10);
+    // the quantization of the gradients for the data-parallel SGD, to a quantized matrix on the same device
+    const size_t numRows = 2048, numCols = 2048;
+    for (size_t numBits : { 1, 2, 4 })
+    {
+        string bits = to_string(numBits) + (numBits == 1 ? " bit" : " bits");
+        shared_ptr<MatrixQuantizerImpl<float>> quantizer;
+        shared_ptr<QuantizedMatrix<float>> quantized;
+        auto setUp = [&]()
+        {
+            if (!quantizer)
+            {
+                quantizer.reset(MatrixQuantizerImpl<float>::Create(device.id, /*useAsync=*/false));
+                quantized = make_shared<QuantizedMatrix<float>>(numRows, numCols, numBits, device.id);
+            }
+        };
+        double numElements = (double) numRows * numCols;
+        double quantizedBytes = numElements * numBits / 8;
+        // the gradient and the residual in, the residual out
+        benchmarks.Run("quantizer", "MatrixQuantizer quantize [2048 x 2048] to " + bits, device, 0, 3 * sizeof(float) * numElements + quantizedBytes, [&]() -> Benchmarks::Kernel
+        {
+            setUp();
+            auto gradient = RandomMatrix(numRows, numCols, device.id, 1);
+            auto residual = make_shared<Matrix<float>>(Matrix<float>::Zeros(numRows, numCols, device.id));
+            auto q = quantizer;
+            auto qMatrix = quantized;
+            return [=]()
+            {
+                q->QuantizeAsync(*gradient, *residual, *qMatrix, *residual, /*zeroThresholdFor1Bit=*/false);
+                q->WaitQuantizeAsyncDone();
+            };
+        });
+        benchmarks.Run("quantizer", "MatrixQuantizer unquantize [2048 x 2048] from " + bits, device, 0, 2 * sizeof(float) * numElements + quantizedBytes, [&]() -> Benchmarks::Kernel
+        {
+            setUp();
+            auto gradient = RandomMatrix(numRows, numCols, device.id, 1);
+            auto residual = make_shared<Matrix<float>>(Matrix<float>::Zeros(numRows, numCols, device.id));
+            auto q = quantizer;
+            auto qMatrix = quantized;
+            q->QuantizeAsync(*gradient, *residual, *qMatrix, *residual, /*zeroThresholdFor1Bit=*/false);
+            q->WaitQuantizeAsyncDone();
+            return [=]()
+            {
+                q->UnquantizeAsync(*qMatrix, *gradient, /*add=*/true);
+                q->WaitUnquantizeAsyncDone();
+            };
+        });
+    }
+}
 
-    cout<<endl<<"********************Matrix AddMultiplyAndInplaceSigmoid TEST********************"<<endl;    
-    AddMultiplyAndInplaceSigmoidTest<float>(11,10,12);    
-    AddMultiplyAndInplaceSigmoidTest<float>(110,100,120);    
-    AddMultiplyAndInplaceSigmoidTest<float>(1100,1000,1200);    
-    AddMultiplyAndInplaceSigmoidTest<float>(11000,10000,1200);
+// ---------------------------------------------------------------------------
+// main
+// ---------------------------------------------------------------------------
 
-    cout<<endl<<"********************Matrix MultiplyAndWeightedAdd TEST********************"<<endl;    
-    MultiplyAndWeightedAddTest<float>(11,10,12);    
-    MultiplyAndWeightedAddTest<float>(110,100,120);    
-    MultiplyAndWeightedAddTest<float>(1100,1000,1200);    
-    MultiplyAndWeightedAddTest<float>(11000,10000,12000);*/
+static Options ParseOptions(int argc, char* argv[])
+{
+    Options options;
+    for (int i = 1; i < argc; i++)
+    {
+        string arg = argv[i];
+        auto pos = arg.find('=');
+        if (pos == string::npos)
+            InvalidArgument("Arguments are of the form name=value, but got '%s'.", arg.c_str());
+        string name = arg.substr(0, pos), value = arg.substr(pos + 1);
+        if (name == "device")
+            options.devices = value;
+        else if (name == "filter")
+            options.filter = value;
+        else if (name == "json")
+            options.json = value;
+        else if (name == "minTime")
+            options.minTime = stod(value);
+        else if (name == "convBatch")
+            options.convBatch = stoul(value);
+        else if (name == "cpuPeakGFlops")
+            options.cpuPeakGFlops = stod(value);
+        else if (name == "cpuPeakGBps")
+            options.cpuPeakGBps = stod(value);
+        else
+            InvalidArgument("Unknown argument '%s'.", name.c_str());
+    }
+    return options;
+}
 
-    return 0;
+int main(int argc, char* argv[])
+{
+    try
+    {
+        Options options = ParseOptions(argc, argv);
+        auto devices = GetDevices(options);
+        Benchmarks benchmarks(options);
+        for (const auto& device : devices)
+        {
+            fprintf(stderr, "\n===== %s, peak %.0f GFLOP/s, %.0f GB/s (0: not known)\n", device.name.c_str(), device.peakGFlops, device.peakGBps);
+            GemmBenchmarks(benchmarks, device);
+            TensorBenchmarks(benchmarks, device);
+            CPUTensorKernelBenchmarks(benchmarks, device);
+            SparseBenchmarks(benchmarks, device);
+            ConvolutionBenchmarks(benchmarks, device, options.convBatch);
+            BlockMultiplierBenchmarks(benchmarks, device);
+            QuantizerBenchmarks(benchmarks, device);
+        }
+        if (!options.json.empty())
+        {
+            benchmarks.WriteJson(options.json, devices);
+            fprintf(stderr, "\nResults written to %s\n", options.json.c_str());
+        }
+    }
+    catch (const exception& e)
+    {
+        fprintf(stderr, "EXCEPTION occurred: %s\n", e.what());
+        return EXIT_FAILURE;
+    }
+    return EXIT_SUCCESS;
 }
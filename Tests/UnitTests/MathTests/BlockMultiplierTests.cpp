@@ -185,5 +185,32 @@ BOOST_AUTO_TEST_CASE(BlockMultiplyTestAllKFourRowsMultiThread)
     TestMultiplierSub<int16_t, int16_t, int32_t, BlockMultiplier<BlockHandlerSSE>>(4, 128 + 64 + 32 + 16 + 8 + 1, 1, 2);
 }
 
+// The AVX-512 handlers only run on hosts that support them, the tests pass trivially elsewhere.
+BOOST_AUTO_TEST_CASE(BlockMultiplyTestAVX512)
+{
+    if (!BlockHandlerAVX512::IsSupported())
+    {
+        BOOST_TEST_MESSAGE("AVX-512 is not supported, skipping BlockHandlerAVX512.");
+        return;
+    }
+    TestMultiplierSub<int16_t, int16_t, int32_t, BlockMultiplier<BlockHandlerAVX512>>(7, 128, 8, 1);
+    TestMultiplierSub<int16_t, int16_t, int32_t, BlockMultiplier<BlockHandlerAVX512>>(1, 128 + 64 + 32 + 16 + 8 + 1, 1, 2);
+    TestMultiplierSub<int16_t, int16_t, int32_t, BlockMultiplier<BlockHandlerAVX512>>(4, 128 + 64 + 32 + 16 + 8 + 1, 1, 2);
+    TestMultiplierSub<int16_t, int16_t, int32_t, BlockMultiplier<BlockHandlerAVX512>>(16, 3 * 128 + 64 + 16 + 3, 33, 2);
+}
+
+BOOST_AUTO_TEST_CASE(BlockMultiplyTestAVX512VNNI)
+{
+    if (!BlockHandlerAVX512VNNI::IsSupported())
+    {
+        BOOST_TEST_MESSAGE("AVX512_VNNI is not supported, skipping BlockHandlerAVX512VNNI.");
+        return;
+    }
+    TestMultiplierSub<int8_t, int8_t, int32_t, BlockMultiplier<BlockHandlerAVX512VNNI>>(7, 128, 8, 1);
+    TestMultiplierSub<int8_t, int8_t, int32_t, BlockMultiplier<BlockHandlerAVX512VNNI>>(1, 128 + 64 + 32 + 16 + 8 + 1, 1, 2);
+    TestMultiplierSub<int8_t, int8_t, int32_t, BlockMultiplier<BlockHandlerAVX512VNNI>>(4, 128 + 64 + 32 + 16 + 8 + 1, 1, 2);
+    TestMultiplierSub<int8_t, int8_t, int32_t, BlockMultiplier<BlockHandlerAVX512VNNI>>(16, 3 * 128 + 64 + 16 + 3, 33, 2);
+}
+
 BOOST_AUTO_TEST_SUITE_END()
 }}}} //end namespaces
@@ -4,6 +4,7 @@
 //
 #include "stdafx.h"
 #include "../../../Source/Math/CPUMatrix.h"
+#include "../../../Source/Math/RNNCommon.h"
 
 using namespace Microsoft::MSR::CNTK;
 
@@ -220,6 +221,31 @@ BOOST_FIXTURE_TEST_CASE(CPUMatrixMultiplyAndDiv, RandomSeedFixture)
     BOOST_CHECK(m3.IsEqualTo(m2));
 }
 
+BOOST_FIXTURE_TEST_CASE(CPUMatrixMultiplyByPackedMatrix, RandomSeedFixture)
+{
+    const size_t m = 17, k = 23;
+    SMatrix a = SMatrix::RandomUniform(m, k, -1, 1, IncrementCounter());
+    for (bool transposeA : { false, true })
+    {
+        auto packedA = make_shared<PackedGemmMatrix<float>>(a.Data(), transposeA ? (int) k : (int) m, transposeA ? (int) m : (int) k, transposeA);
+        BOOST_CHECK(!packedA->Matches(a.Data(), transposeA ? (int) m : (int) k, transposeA ? (int) k : (int) m, !transposeA));
+
+        // minibatches of different sizes reuse the same packed matrix; without MKL the products are plain GEMMs
+        for (size_t n : { 1, 4, 33 })
+        {
+            SMatrix b = SMatrix::RandomUniform(transposeA ? m : k, n, -1, 1, IncrementCounter());
+            for (float beta : { 0.0f, 1.0f })
+            {
+                SMatrix expected = SMatrix::RandomUniform(transposeA ? k : m, n, -1, 1, IncrementCounter());
+                SMatrix actual = expected;
+                SMatrix::MultiplyAndWeightedAdd(1, a, transposeA, b, false, beta, expected);
+                SMatrix::MultiplyAndWeightedAdd(1, a, transposeA, b, false, beta, actual, nullptr, packedA);
+                BOOST_CHECK(actual.IsEqualTo(expected, c_epsilonFloatE4));
+            }
+        }
+    }
+}
+
 BOOST_FIXTURE_TEST_CASE(CPUMatrixElementOperations, RandomSeedFixture)
 {
     // TODO: consider splitting this large test
@@ -543,6 +569,23 @@ BOOST_FIXTURE_TEST_CASE(CPUMatrixSetValues, RandomSeedFixture)
     BOOST_CHECK_CLOSE(m1.SumOfElements(), static_cast<double>(m1.GetNumElements()), 1);
 }
 
+BOOST_FIXTURE_TEST_CASE(CPUMatrixSetValueExternalBuffer, RandomSeedFixture)
+{
+    std::vector<double> buffer1{ 1, 2, 3, 4, 5, 6 };
+    std::vector<double> buffer2{ 7, 8, 9 };
+
+    DMatrix m(2, 2);
+    m.SetValue(2, 3, buffer1.data(), matrixFlagDontOwnBuffer);
+    BOOST_CHECK_EQUAL(m.Data(), buffer1.data());
+    BOOST_CHECK_EQUAL(m(1, 2), 6);
+
+    // wrapping another buffer must leave the first one alone
+    m.SetValue(3, 1, buffer2.data(), matrixFlagDontOwnBuffer);
+    BOOST_CHECK_EQUAL(m.Data(), buffer2.data());
+    BOOST_CHECK_EQUAL(m(2, 0), 9);
+    BOOST_CHECK_EQUAL(buffer1[5], 6);
+}
+
 BOOST_FIXTURE_TEST_CASE(CPUMatrixTranspose, RandomSeedFixture)
 {
     DMatrix m0(2, 3);
@@ -898,6 +941,158 @@ BOOST_FIXTURE_TEST_CASE(CPUMatrixSeedingDouble, RandomSeedFixture)
     BOOST_CHECK(m1.IsEqualTo(m2));
 }
 
+BOOST_FIXTURE_TEST_CASE(CPUElementProductOfCounterBasedMask, RandomSeedFixture)
+{
+    const size_t rows = 20;
+    const size_t cols = 30;
+    const double maskRate = 0.3;
+    const double scale = 1 / (1 - maskRate);
+    const uint64_t seed = 4711;
+    const uint64_t offset = 101; // not a multiple of the four numbers per counter
+
+    DMatrix input = DMatrix::RandomUniform(rows, cols, 1, 2, IncrementCounter());
+    DMatrix m1(rows, cols);
+    m1.DoElementProductOfCounterBasedMask(0, input, maskRate, scale, seed, offset);
+
+    // the same arguments give the same mask
+    DMatrix m2(rows, cols);
+    m2.DoElementProductOfCounterBasedMask(0, input, maskRate, scale, seed, offset);
+    BOOST_CHECK(m1.IsEqualTo(m2));
+
+    // and so does a column slice with the offset of its first element
+    DMatrix slice(rows, 10);
+    slice.DoElementProductOfCounterBasedMask(0, input.ColumnSlice(10, 10), maskRate, scale, seed, offset + 10 * rows);
+    BOOST_CHECK(slice.IsEqualTo(m1.ColumnSlice(10, 10)));
+
+    // each element is either dropped or scaled, at about the mask rate
+    size_t numDropped = 0;
+    for (size_t j = 0; j < cols; j++)
+    {
+        for (size_t i = 0; i < rows; i++)
+        {
+            if (m1(i, j) == 0)
+                numDropped++;
+            else
+                BOOST_CHECK_CLOSE(m1(i, j), input(i, j) * scale, 1e-10);
+        }
+    }
+    BOOST_CHECK_CLOSE((double) numDropped / (rows * cols), maskRate, 25);
+
+    // a different seed gives a different mask
+    m2.DoElementProductOfCounterBasedMask(0, input, maskRate, scale, seed + 1, offset);
+    BOOST_CHECK(!m1.IsEqualTo(m2));
+
+    // beta = 1 accumulates
+    m2.SetValue(m1);
+    m2.DoElementProductOfCounterBasedMask(1, input, maskRate, scale, seed, offset);
+    DMatrix::Scale(2, m1);
+    BOOST_CHECK(m1.IsEqualTo(m2, c_epsilonDoubleE11));
+}
+
+BOOST_FIXTURE_TEST_CASE(CPUAssignAugmentedImages, RandomSeedFixture)
+{
+    // two 2x1 BGR images with two bytes of other data after each
+    const size_t width = 2, height = 1, channels = 3, stride = 8;
+    unsigned char pixels[2 * stride] = { 10, 20, 30, 40, 50, 60, 0, 0,
+                                         200, 100, 0, 0, 0, 0, 0, 0 };
+    CPUMatrix<char> images(stride, 2, reinterpret_cast<char*>(pixels), matrixFlagNormal);
+    DMatrix empty;
+
+    // without changes the images are just converted, here to CHW
+    DMatrix params(6, 2);
+    params.SetValue(0);
+    params(0, 0) = params(2, 0) = params(0, 1) = params(2, 1) = 1; // contrast and saturation factors
+    DMatrix result;
+    result.AssignAugmentedImages(images, params, empty, width, height, channels, true);
+    BOOST_CHECK_EQUAL(result.GetNumRows(), 6);
+    BOOST_CHECK_EQUAL(result.GetNumCols(), 2);
+    BOOST_CHECK_EQUAL(result(0, 0), 10);
+    BOOST_CHECK_EQUAL(result(1, 0), 40);
+    BOOST_CHECK_EQUAL(result(2, 0), 20);
+    BOOST_CHECK_EQUAL(result(5, 1), 0);
+
+    // contrast, brightness relative to the mean (35, 50), intensity shifts and the mean are applied in HWC, clipped before the mean
+    DMatrix mean(6, 1);
+    mean.SetValue(1);
+    params(0, 0) = 2;
+    params(1, 0) = 0.2;
+    params(3, 0) = -100;
+    params(1, 1) = 1;
+    result.AssignAugmentedImages(images, params, mean, width, height, channels, false);
+    BOOST_CHECK_CLOSE(params(1, 0), 7, 1e-10);
+    BOOST_CHECK_CLOSE(result(1, 0), 2 * 20 + 7 - 1, 1e-10);
+    BOOST_CHECK_CLOSE(result(0, 0), 0 - 1, 1e-10);
+    BOOST_CHECK_CLOSE(result(0, 1), 250 - 1, 1e-10);
+    BOOST_CHECK_CLOSE(result(1, 1), 150 - 1, 1e-10);
+    BOOST_CHECK_CLOSE(result(3, 1), 50 - 1, 1e-10);
+
+    // no saturation leaves the value of each pixel in all channels
+    params.SetValue(0);
+    params(0, 1) = 1;
+    result.AssignAugmentedImages(images, params, empty, width, height, channels, false);
+    for (size_t c = 0; c < channels; c++)
+        BOOST_CHECK_CLOSE(result(c, 1), 200, 1e-10);
+}
+
+BOOST_FIXTURE_TEST_CASE(CPUMatrixRNNForward, RandomSeedFixture)
+{
+    // one tanh layer, against the recurrence h_t = tanh(W' x_t + bW + R' h_t-1 + bR) with the cuDNN layout [W R bW bR]
+    const size_t xDim = 3, hiddenSize = 2, numFrames = 4;
+    RnnAttributes tanhAttributes(false, 1, hiddenSize, L"rnnTanh", -1);
+    auto numParameters = tanhAttributes.GetNumParameters(xDim);
+    DMatrix params = DMatrix::RandomUniform(numParameters.first * numParameters.second, 1, -0.5, 0.5, IncrementCounter());
+    DMatrix input = DMatrix::RandomUniform(xDim, numFrames, -1, 1, IncrementCounter());
+    DMatrix output, reserve, workspace;
+    output.RNNForward(input, params, xDim, hiddenSize, vector<size_t>(numFrames, 1), tanhAttributes, reserve, workspace);
+
+    const double* W = params.Data();
+    const double* R = W + xDim * hiddenSize;
+    const double* bW = R + hiddenSize * hiddenSize;
+    const double* bR = bW + hiddenSize;
+    vector<double> h(hiddenSize, 0);
+    for (size_t t = 0; t < numFrames; t++)
+    {
+        vector<double> next(hiddenSize);
+        for (size_t k = 0; k < hiddenSize; k++)
+        {
+            double sum = bW[k] + bR[k];
+            for (size_t i = 0; i < xDim; i++)
+                sum += W[k * xDim + i] * input(i, t);
+            for (size_t i = 0; i < hiddenSize; i++)
+                sum += R[k * hiddenSize + i] * h[i];
+            next[k] = tanh(sum);
+        }
+        h = next;
+        for (size_t k = 0; k < hiddenSize; k++)
+            BOOST_CHECK_CLOSE(output(k, t), h[k], 1e-8);
+    }
+
+    // stacked bidirectional layers: packed sequences of lengths 4, 2 and 1 give the same outputs as each sequence alone
+    const size_t lengths[] = { 4, 2, 1 };
+    const vector<size_t> numSequencesForFrame = { 3, 2, 1, 1 };
+    const size_t frameBegin[] = { 0, 3, 5, 6 };
+    for (const wstring& recurrentOp : { L"lstm", L"gru", L"rnnReLU" })
+    {
+        RnnAttributes attributes(true, 2, hiddenSize, recurrentOp, -1);
+        numParameters = attributes.GetNumParameters(xDim);
+        params = DMatrix::RandomUniform(numParameters.first * numParameters.second, 1, -0.5, 0.5, IncrementCounter());
+        DMatrix packedInput = DMatrix::RandomUniform(xDim, 7, -1, 1, IncrementCounter());
+        DMatrix packedOutput;
+        packedOutput.RNNForward(packedInput, params, xDim, 2 * hiddenSize, numSequencesForFrame, attributes, reserve, workspace);
+
+        for (size_t j = 0; j < 3; j++)
+        {
+            DMatrix sequenceInput(xDim, lengths[j]), sequenceOutput;
+            for (size_t t = 0; t < lengths[j]; t++)
+                sequenceInput.SetColumn(packedInput.ColumnSlice(frameBegin[t] + j, 1).Data(), t);
+            sequenceOutput.RNNForward(sequenceInput, params, xDim, 2 * hiddenSize, vector<size_t>(lengths[j], 1), attributes, reserve, workspace);
+            for (size_t t = 0; t < lengths[j]; t++)
+                for (size_t k = 0; k < 2 * hiddenSize; k++)
+                    BOOST_CHECK_CLOSE(packedOutput(k, frameBegin[t] + j), sequenceOutput(k, t), 1e-8);
+        }
+    }
+}
+
 BOOST_AUTO_TEST_SUITE_END()
 }
 } } }
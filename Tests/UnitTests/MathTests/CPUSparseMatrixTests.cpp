@@ -7,6 +7,7 @@
 #include <crtdefs.h>
 #endif
 #include "../../../Source/Math/CPUSparseMatrix.h"
+#include <algorithm>
 
 using namespace Microsoft::MSR::CNTK;
 
@@ -116,6 +117,127 @@ BOOST_FIXTURE_TEST_CASE(CPUSparseMatrixMultiplyAndAdd, RandomSeedFixture)
     }
 }
 
+// sparse weights (CSC) times dense activations, as used for inference with pruned weights
+BOOST_FIXTURE_TEST_CASE(CPUSparseMatrixTimesDense, RandomSeedFixture)
+{
+    const size_t m = 60;
+    const size_t k = 40;
+    const size_t n = 7;
+
+    DenseMatrix dmA(m, k);
+    dmA.SetUniformRandomValue(-3, 1, IncrementCounter());
+    dmA.InplaceTruncateBottom(0); // about 3/4 zeros
+    SparseMatrix smA(MatrixFormat::matrixFormatSparseCSC, m, k, 0);
+    foreach_coord(row, col, dmA)
+    {
+        if (dmA(row, col) != 0)
+        {
+            smA.SetValue(row, col, dmA(row, col));
+        }
+    }
+
+    for (bool transposeA : { false, true })
+    {
+        DenseMatrix b(transposeA ? m : k, n);
+        b.SetUniformRandomValue(-1, 1, IncrementCounter());
+
+        for (double beta : { 0.0, 1.0 })
+        {
+            DenseMatrix expected(transposeA ? k : m, n);
+            expected.SetUniformRandomValue(-1, 1, IncrementCounter());
+            DenseMatrix actual(expected);
+
+            DenseMatrix::MultiplyAndWeightedAdd(0.5, dmA, transposeA, b, false, beta, expected);
+            SparseMatrix::MultiplyAndWeightedAdd(0.5, smA, transposeA, b, false, beta, actual);
+
+            BOOST_CHECK(actual.IsEqualTo(expected, c_epsilonFloatE4));
+        }
+    }
+}
+
+// SparseBlockCol product of dm0 and the transpose of a CSC matrix with non-zeros in rows 1 and 2 only, i.e. with the blocks of columns 1 and 2
+static void CreateBlockColOfColumns1And2(const DenseMatrix& dm0, SparseMatrix& blockCol, unsigned long seed)
+{
+    DenseMatrix dm1(4, dm0.GetNumCols());
+    dm1.SetUniformRandomValue(1, 2, seed);
+    SparseMatrix sm1(MatrixFormat::matrixFormatSparseCSC, 4, dm0.GetNumCols(), 0);
+    foreach_coord(row, col, dm1)
+    {
+        if (row == 1 || row == 2)
+        {
+            sm1.SetValue(row, col, dm1(row, col));
+        }
+    }
+    SparseMatrix::MultiplyAndAdd(1, dm0, false, sm1, true, blockCol);
+}
+
+BOOST_FIXTURE_TEST_CASE(CPUSparseMatrixCatchUpLazyMomentum, RandomSeedFixture)
+{
+    const size_t m = 3;
+    const double learnRateScale = 0.5;
+    const double momentum = 0.9;
+
+    DenseMatrix dm0(m, 5);
+    dm0.SetUniformRandomValue(-1, 1, IncrementCounter());
+    SparseMatrix gradient(MatrixFormat::matrixFormatSparseBlockCol, m, 4, 0);
+    CreateBlockColOfColumns1And2(dm0, gradient, IncrementCounter());
+
+    DenseMatrix smoothed(m, 4);
+    smoothed.SetUniformRandomValue(-1, 1, IncrementCounter());
+    DenseMatrix values(m, 4);
+    values.SetUniformRandomValue(-1, 1, IncrementCounter());
+    DenseMatrix lastUpdates(1, 4);
+    lastUpdates.SetValue(0);
+    lastUpdates(0, 2) = 2;
+
+    DenseMatrix expectedSmoothed(smoothed);
+    DenseMatrix expectedValues(values);
+
+    // at timestamp 4, column 1 skipped 3 steps, column 2 only one, the others are not touched
+    gradient.CatchUpLazyMomentum(smoothed, values, lastUpdates, 4, learnRateScale, momentum, false, 0);
+
+    const double decaySum[] = { 0, momentum + momentum * momentum + momentum * momentum * momentum, momentum, 0 };
+    const double decay[] = { 1, momentum * momentum * momentum, momentum, 1 };
+    foreach_coord(row, col, values)
+    {
+        BOOST_CHECK(abs(values(row, col) - (expectedValues(row, col) - learnRateScale * decaySum[col] * expectedSmoothed(row, col))) < c_epsilonFloatE4);
+        BOOST_CHECK(abs(smoothed(row, col) - decay[col] * expectedSmoothed(row, col)) < c_epsilonFloatE4);
+    }
+    BOOST_CHECK_EQUAL(lastUpdates(0, 0), 0);
+    BOOST_CHECK_EQUAL(lastUpdates(0, 1), 4);
+    BOOST_CHECK_EQUAL(lastUpdates(0, 2), 4);
+    BOOST_CHECK_EQUAL(lastUpdates(0, 3), 0);
+}
+
+BOOST_FIXTURE_TEST_CASE(CPUSparseMatrixExpandBlockColumns, RandomSeedFixture)
+{
+    const size_t m = 3;
+
+    DenseMatrix dm0(m, 5);
+    dm0.SetUniformRandomValue(-1, 1, IncrementCounter());
+    SparseMatrix sm(MatrixFormat::matrixFormatSparseBlockCol, m, 4, 0);
+    CreateBlockColOfColumns1And2(dm0, sm, IncrementCounter());
+
+    DenseMatrix expected(m, 4);
+    foreach_coord(row, col, expected)
+    {
+        expected(row, col) = sm(row, col);
+    }
+
+    std::vector<size_t> columnIds;
+    sm.GetBlockColumnIds(columnIds);
+    std::sort(columnIds.begin(), columnIds.end());
+    BOOST_CHECK(columnIds == std::vector<size_t>({ 1, 2 }));
+
+    sm.ExpandBlockColumns({ 0, 1, 2 });
+    sm.GetBlockColumnIds(columnIds);
+    BOOST_CHECK(columnIds == std::vector<size_t>({ 0, 1, 2 }));
+    foreach_coord(row, col, expected)
+    {
+        BOOST_CHECK_EQUAL(sm(row, col), expected(row, col));
+    }
+}
+
 BOOST_AUTO_TEST_SUITE_END()
 }
 } } }
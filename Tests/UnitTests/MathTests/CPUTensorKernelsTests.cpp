@@ -0,0 +1,202 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE.md file in the project root for full license information.
+//
+#include "stdafx.h"
+#include "../../../Source/Math/CommonMatrix.h"
+#include "../../../Source/Math/TensorOps.h"
+#include "../../../Source/Math/CPUTensorKernels.h"
+#include <cmath>
+#include <functional>
+#include <limits>
+#include <random>
+#include <vector>
+
+using namespace Microsoft::MSR::CNTK;
+namespace Microsoft { namespace MSR { namespace CNTK { namespace Test {
+
+// Odd sizes, so that the scalar tails of the vector loops are covered, and a few special values.
+static void InitTensorKernelInputs(std::vector<float>& a, std::vector<float>& b, std::vector<float>& c, size_t n)
+{
+    std::mt19937 rng(1234);
+    std::uniform_real_distribution<float> wide(-30, 30), unit(0, 1);
+    a.resize(n);
+    b.resize(n);
+    c.resize(n);
+    for (size_t i = 0; i < n; i++)
+    {
+        a[i] = wide(rng);
+        b[i] = unit(rng);
+        c[i] = wide(rng);
+    }
+    a[1] = 0;
+    a[2] = -0.625f;
+    a[3] = 100;  // exp() overflows
+    a[4] = -100; // exp() underflows to a denormal
+}
+
+static void CheckTensorKernelResult(const char* isa, const char* op, const std::vector<float>& result, const std::function<float(size_t)>& reference, float tolerance)
+{
+    for (size_t i = 0; i < result.size(); i++)
+    {
+        float expected = reference(i);
+        if (std::isinf(expected))
+            BOOST_CHECK_MESSAGE(result[i] == expected, isa << " " << op << " at " << i);
+        else
+            BOOST_CHECK_MESSAGE(fabs(result[i] - expected) <= tolerance * std::max(1.0f, fabs(expected)),
+                                isa << " " << op << " at " << i << ": " << result[i] << " != " << expected);
+    }
+}
+
+// the kernels for every instruction set of the host against the functions of TensorOps.h
+static void TestTensorKernels(const CPUTensorKernels& kernels, size_t n)
+{
+    const float tolerance = 1e-6f;
+    std::vector<float> a, b, c;
+    InitTensorKernelInputs(a, b, c, n);
+    std::vector<float> result(n);
+
+#define CheckUnaryKernel(oper)                                                                                   \
+    kernels.Unary(op##oper)(a.data(), result.data(), n, 1, 0);                                                   \
+    CheckTensorKernelResult(kernels.Name(), #oper, result, [&](size_t i) { return Op##oper(a[i]); }, tolerance)
+    CheckUnaryKernel(Copy);
+    CheckUnaryKernel(Negate);
+    CheckUnaryKernel(Sigmoid);
+    CheckUnaryKernel(Tanh);
+    CheckUnaryKernel(Exp);
+    CheckUnaryKernel(Sqr);
+    CheckUnaryKernel(LinearRectifier);
+    CheckUnaryKernel(FastSigmoid);
+    CheckUnaryKernel(FastTanh);
+    CheckUnaryKernel(FastExp);
+#undef CheckUnaryKernel
+    kernels.Unary(opFastLog)(b.data(), result.data(), n, 1, 0);
+    CheckTensorKernelResult(kernels.Name(), "FastLog", result, [&](size_t i) { return OpFastLog(b[i]); }, tolerance);
+
+#define CheckBinaryKernel(oper)                                                                                        \
+    kernels.Binary(op##oper)(a.data(), b.data(), result.data(), n, 1, 0);                                              \
+    CheckTensorKernelResult(kernels.Name(), #oper, result, [&](size_t i) { return Op##oper(a[i], b[i]); }, tolerance)
+    CheckBinaryKernel(Sum);
+    CheckBinaryKernel(Difference);
+    CheckBinaryKernel(ElementwiseProduct);
+    CheckBinaryKernel(ElementwiseProductWithSigmoidDerivativeFromOutput);
+    CheckBinaryKernel(ElementwiseProductWithTanhDerivativeFromOutput);
+    CheckBinaryKernel(ElementwiseProductWithLinearRectifierDerivativeFromOutput);
+    CheckBinaryKernel(ElementwiseProductWithLogDerivativeFromOutput);
+#undef CheckBinaryKernel
+
+#define CheckTernaryKernel(oper)                                                                                              \
+    kernels.Ternary(op##oper)(a.data(), b.data(), c.data(), result.data(), n, 1, 0);                                          \
+    CheckTensorKernelResult(kernels.Name(), #oper, result, [&](size_t i) { return Op##oper(a[i], b[i], c[i]); }, tolerance)
+    CheckTernaryKernel(ElementwiseProductWithLogSumDerivative);
+    CheckTernaryKernel(ElementwiseProductWithExpOfDiff);
+#undef CheckTernaryKernel
+
+    // no kernel for the others
+    BOOST_CHECK(kernels.Unary(opLog) == nullptr);
+    BOOST_CHECK(kernels.Binary(opLogSum) == nullptr);
+
+    // alpha and beta
+    std::vector<float> previous(b);
+    result = previous;
+    kernels.Binary(opSum)(a.data(), c.data(), result.data(), n, 0.5f, 2);
+    CheckTensorKernelResult(kernels.Name(), "Sum, alpha 0.5, beta 2", result, [&](size_t i) { return 2 * previous[i] + 0.5f * (a[i] + c[i]); }, tolerance);
+    kernels.Unary(opTanh)(a.data(), result.data(), n, 3, 0);
+    CheckTensorKernelResult(kernels.Name(), "Tanh, alpha 3", result, [&](size_t i) { return 3 * OpTanh(a[i]); }, tolerance);
+
+    // reductions, also of fewer elements than in a vector
+    for (size_t length : {(size_t) 1, (size_t) 7, (size_t) 31, n})
+    {
+        if (length > n)
+            continue;
+        double sum = 0, max = a[0], min = a[0];
+        for (size_t i = 0; i < length; i++)
+        {
+            sum += a[i];
+            max = std::max(max, (double) a[i]);
+            min = std::min(min, (double) a[i]);
+        }
+        double logSum = 0;
+        for (size_t i = 0; i < length; i++)
+            logSum += exp(a[i] - max);
+        logSum = max + log(logSum);
+
+        BOOST_CHECK_CLOSE(kernels.Reduction(opSum)(a.data(), length), sum, 1e-8);
+        BOOST_CHECK_EQUAL(kernels.Reduction(opMax)(a.data(), length), max);
+        BOOST_CHECK_EQUAL(kernels.Reduction(opMin)(a.data(), length), min);
+        BOOST_CHECK_CLOSE(kernels.Reduction(opLogSum)(a.data(), length), logSum, 1e-4);
+    }
+
+    // dot products of a with 1 to 4 vectors, here b and c stacked as b, c, b, c with stride n
+    std::vector<float> stacked(b);
+    stacked.insert(stacked.end(), c.begin(), c.end());
+    stacked.insert(stacked.end(), stacked.begin(), stacked.end());
+    for (size_t numB = 1; numB <= 4; numB++)
+    {
+        float dots[4];
+        kernels.Dot()(a.data(), stacked.data(), n, numB, n, dots);
+        for (size_t k = 0; k < numB; k++)
+        {
+            double dot = 0, magnitude = 0;
+            for (size_t i = 0; i < n; i++)
+            {
+                dot += (double) a[i] * stacked[k * n + i];
+                magnitude += fabs((double) a[i] * stacked[k * n + i]);
+            }
+            BOOST_CHECK_MESSAGE(fabs(dots[k] - dot) <= 1e-5 * magnitude, kernels.Name() << " Dot " << k << " of " << numB << ": " << dots[k] << " != " << dot);
+        }
+    }
+}
+
+BOOST_AUTO_TEST_SUITE(CPUMatrixSuite)
+
+BOOST_FIXTURE_TEST_CASE(CPUTensorKernelsMatchTensorOps, RandomSeedFixture)
+{
+    for (auto isa : {CPUTensorKernels::ISA::Scalar, CPUTensorKernels::ISA::AVX2, CPUTensorKernels::ISA::AVX512})
+    {
+        const CPUTensorKernels* kernels = CPUTensorKernels::Get(isa);
+        if (!kernels)
+        {
+            BOOST_TEST_MESSAGE("CPUTensorKernels: instruction set " << (int) isa << " not supported by the host, skipping.");
+            continue;
+        }
+        TestTensorKernels(*kernels, 1003);
+        TestTensorKernels(*kernels, 5);
+    }
+    BOOST_CHECK(CPUTensorKernels::Get(CPUTensorKernels::ISA::Scalar) != nullptr);
+}
+
+// the bounds documented with FastExp() in TensorOps.h
+BOOST_FIXTURE_TEST_CASE(FastMathOpsWithinBounds, RandomSeedFixture)
+{
+    double maxErrorExp = 0, maxErrorLog = 0, maxErrorSigmoid = 0, maxErrorTanh = 0;
+    for (float x = -87; x <= 88; x += 0.0123f)
+    {
+        maxErrorExp = std::max(maxErrorExp, fabs(OpFastExp(x) - exp((double) x)) / exp((double) x));
+        maxErrorSigmoid = std::max(maxErrorSigmoid, fabs(OpFastSigmoid(x) - 1 / (1 + exp(-(double) x))));
+        maxErrorTanh = std::max(maxErrorTanh, fabs(OpFastTanh(x) - tanh((double) x)));
+    }
+    for (float x = 1e-30f; x < 1e30f; x *= 1.0123f)
+        maxErrorLog = std::max(maxErrorLog, fabs(OpFastLog(x) - log((double) x)) / (1 + fabs(log((double) x))));
+    BOOST_CHECK_LT(maxErrorExp, 3e-6);
+    BOOST_CHECK_LT(maxErrorLog, 2e-7);
+    BOOST_CHECK_LT(maxErrorSigmoid, 1e-6);
+    BOOST_CHECK_LT(maxErrorTanh, 2e-6);
+
+    // special values
+    BOOST_CHECK(std::isnan(OpFastExp(std::nanf(""))));
+    BOOST_CHECK(std::isnan(OpFastLog(std::nanf(""))));
+    BOOST_CHECK(std::isnan(OpFastTanh(std::nanf(""))));
+    BOOST_CHECK_EQUAL(OpFastLog(std::numeric_limits<float>::infinity()), std::numeric_limits<float>::infinity());
+    BOOST_CHECK_EQUAL(OpFastLog(0.0f), OpLog(0.0f));
+    BOOST_CHECK_SMALL(OpFastSigmoid(-1000.0f), 1e-30f);
+    BOOST_CHECK_EQUAL(OpFastSigmoid(1000.0f), 1);
+    BOOST_CHECK_EQUAL(OpFastTanh(-1000.0f), -1);
+    BOOST_CHECK_EQUAL(OpFastExp(0.0f), 1);
+
+    // and double takes the same formulas
+    BOOST_CHECK_CLOSE(OpFastExp(1.0), (double) OpFastExp(1.0f), 1e-4);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
+}}}}
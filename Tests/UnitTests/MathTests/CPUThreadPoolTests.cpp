@@ -0,0 +1,121 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE.md file in the project root for full license information.
+//
+#include "stdafx.h"
+#include "../../../Source/Math/CPUThreadPool.h"
+#include <atomic>
+#include <stdexcept>
+#include <thread>
+#include <vector>
+
+using namespace Microsoft::MSR::CNTK;
+namespace Microsoft { namespace MSR { namespace CNTK { namespace Test {
+
+// Boost.Test is not thread-safe, so the loop bodies only record what the checks look at afterwards.
+
+// every index is visited exactly once, by ranges of at least minGrain
+static void TestParallelForCoverage(size_t n, size_t minGrain)
+{
+    std::vector<std::atomic<int>> visits(n);
+    for (auto& v : visits)
+        v = 0;
+    std::atomic<size_t> numRanges(0);
+    std::atomic<bool> shortRange(false), badRange(false);
+    CPUThreadPool::Instance().ParallelFor(n, minGrain, [&](size_t begin, size_t end)
+    {
+        if (begin >= end || end > n)
+        {
+            badRange = true;
+            return;
+        }
+        if (end - begin < minGrain)
+            shortRange = true;
+        numRanges++;
+        for (size_t i = begin; i < end; i++)
+            visits[i]++;
+    });
+    BOOST_REQUIRE(!badRange);
+    for (size_t i = 0; i < n; i++)
+        BOOST_CHECK_EQUAL(visits[i], 1);
+    BOOST_CHECK(!shortRange || numRanges == 1);
+    if (n < 2 * minGrain)
+        BOOST_CHECK_EQUAL(numRanges, n > 0 ? 1 : 0);
+}
+
+BOOST_AUTO_TEST_SUITE(CPUMatrixSuite)
+
+BOOST_FIXTURE_TEST_CASE(CPUThreadPoolParallelFor, RandomSeedFixture)
+{
+    TestParallelForCoverage(0, 1);
+    TestParallelForCoverage(1, 1);
+    TestParallelForCoverage(100, 64); // serial
+    TestParallelForCoverage(1000, 1);
+    TestParallelForCoverage(100003, 1000);
+}
+
+BOOST_FIXTURE_TEST_CASE(CPUThreadPoolExceptionAndNesting, RandomSeedFixture)
+{
+    auto& pool = CPUThreadPool::Instance();
+    size_t originalNumThreads = pool.NumThreads();
+    pool.SetNumThreads(4);
+    BOOST_CHECK_EQUAL(pool.NumThreads(), 4);
+
+    // the exception of one range is rethrown, after all others are done
+    std::atomic<size_t> numDone(0);
+    BOOST_CHECK_THROW(pool.ParallelFor(64, 1, [&](size_t begin, size_t end)
+                      {
+                          if (begin <= 13 && 13 < end)
+                              throw std::runtime_error("range with 13");
+                          numDone += end - begin;
+                      }),
+                      std::runtime_error);
+    BOOST_CHECK(numDone < 64);
+
+    // nested loops run serially on the thread of the outer range
+    std::atomic<size_t> sum(0);
+    std::atomic<bool> wrongThread(false);
+    pool.ParallelFor(8, 1, [&](size_t begin, size_t end)
+    {
+        for (size_t i = begin; i < end; i++)
+        {
+            std::thread::id outer = std::this_thread::get_id();
+            pool.ParallelFor(1000, 1, [&](size_t innerBegin, size_t innerEnd)
+            {
+                if (std::this_thread::get_id() != outer)
+                    wrongThread = true;
+                sum += innerEnd - innerBegin;
+            });
+        }
+    });
+    BOOST_CHECK_EQUAL(sum, 8000);
+    BOOST_CHECK(!wrongThread);
+
+    // two threads sharing the workers, like the reader prefetch and the main thread
+    std::atomic<size_t> total(0);
+    auto work = [&]()
+    {
+        for (int iteration = 0; iteration < 200; iteration++)
+            pool.ParallelFor(1000, 10, [&](size_t begin, size_t end) { total += end - begin; });
+    };
+    std::thread other(work);
+    work();
+    other.join();
+    BOOST_CHECK_EQUAL(total, 2 * 200 * 1000);
+
+    // a limit of one thread runs on the calling thread
+    CPUThreadPool::SetThreadParallelism(1);
+    std::thread::id caller = std::this_thread::get_id();
+    pool.ParallelFor(1000, 1, [&](size_t, size_t)
+    {
+        if (std::this_thread::get_id() != caller)
+            wrongThread = true;
+    });
+    CPUThreadPool::SetThreadParallelism(0);
+    BOOST_CHECK(!wrongThread);
+
+    pool.SetNumThreads(originalNumThreads);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
+}}}}
@@ -0,0 +1,170 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE.md file in the project root for full license information.
+//
+#include "stdafx.h"
+#include "../../../Source/Math/CachingBlockAllocator.h"
+
+using namespace Microsoft::MSR::CNTK;
+namespace Microsoft { namespace MSR { namespace CNTK { namespace Test {
+
+// host memory stands in for device memory; 'm_budget' simulates a device that runs out of memory
+struct CountingRawAllocator
+{
+    size_t m_numAllocations = 0;
+    size_t m_numFrees = 0;
+    size_t m_allocatedBytes = 0;
+    size_t m_budget = SIZE_MAX;
+
+    CachingBlockAllocator::RawAllocateFunction AllocateFunction()
+    {
+        return [this](size_t bytes) -> void*
+            {
+                if (m_allocatedBytes + bytes > m_budget)
+                    return nullptr;
+                m_numAllocations++;
+                m_allocatedBytes += bytes;
+                size_t* block = new size_t[1 + (bytes + sizeof(size_t) - 1) / sizeof(size_t)];
+                block[0] = bytes;
+                return block + 1;
+            };
+    }
+
+    CachingBlockAllocator::RawFreeFunction FreeFunction()
+    {
+        return [this](void* ptr)
+            {
+                size_t* block = (size_t*) ptr - 1;
+                m_numFrees++;
+                m_allocatedBytes -= block[0];
+                delete[] block;
+            };
+    }
+};
+
+BOOST_AUTO_TEST_SUITE(CachingBlockAllocatorSuite)
+
+BOOST_AUTO_TEST_CASE(CachingBlockAllocatorReuse)
+{
+    CountingRawAllocator raw;
+    {
+        CachingBlockAllocator allocator(raw.AllocateFunction(), raw.FreeFunction());
+        const void* stream = nullptr;
+
+        void* a = allocator.Allocate(1000, stream);
+        BOOST_CHECK(allocator.Free(a));
+        BOOST_CHECK_EQUAL(allocator.GetStatistics().m_cachedBytes, CachingBlockAllocator::RoundedSize(1000));
+
+        // same size class: served from the cache
+        void* b = allocator.Allocate(900, stream);
+        BOOST_CHECK_EQUAL(a, b);
+        BOOST_CHECK_EQUAL(raw.m_numAllocations, 1);
+
+        // more than twice the size: not served from the cache
+        void* c = allocator.Allocate(100, stream);
+        allocator.Free(b);
+        void* d = allocator.Allocate(100, stream);
+        BOOST_CHECK_NE(b, d);
+        BOOST_CHECK_EQUAL(raw.m_numAllocations, 3);
+
+        auto stats = allocator.GetStatistics();
+        BOOST_CHECK_EQUAL(stats.m_numRequests, 4);
+        BOOST_CHECK_EQUAL(stats.m_numCacheHits, 1);
+        BOOST_CHECK_CLOSE(stats.HitRate(), 0.25, 1e-6);
+        BOOST_CHECK_EQUAL(stats.m_requestedBytes, 200);
+        BOOST_CHECK_EQUAL(stats.m_inUseBytes, 2 * CachingBlockAllocator::RoundedSize(100));
+        BOOST_CHECK(stats.Fragmentation() > 0 && stats.Fragmentation() < 1);
+
+        BOOST_CHECK(!allocator.Free(&raw)); // not ours
+        allocator.Free(c);
+        allocator.Free(d);
+    }
+    // everything was returned to the cache and released on destruction
+    BOOST_CHECK_EQUAL(raw.m_numFrees, raw.m_numAllocations);
+}
+
+BOOST_AUTO_TEST_CASE(CachingBlockAllocatorStreams)
+{
+    CountingRawAllocator raw;
+    CachingBlockAllocator allocator(raw.AllocateFunction(), raw.FreeFunction());
+    int stream1, stream2;
+
+    void* a = allocator.Allocate(4096, &stream1);
+    allocator.Free(a);
+
+    // a block freed on one stream is not handed out to another one
+    void* b = allocator.Allocate(4096, &stream2);
+    BOOST_CHECK_NE(a, b);
+    void* c = allocator.Allocate(4096, &stream1);
+    BOOST_CHECK_EQUAL(a, c);
+
+    allocator.Free(b);
+    allocator.Free(c);
+    allocator.EmptyCache();
+    BOOST_CHECK_EQUAL(allocator.GetStatistics().m_cachedBytes, 0);
+    BOOST_CHECK_EQUAL(raw.m_numFrees, 2);
+}
+
+BOOST_AUTO_TEST_CASE(CachingBlockAllocatorEmptiesCacheWhenOutOfMemory)
+{
+    CountingRawAllocator raw;
+    raw.m_budget = 3 << 20;
+    CachingBlockAllocator allocator(raw.AllocateFunction(), raw.FreeFunction());
+
+    void* a = allocator.Allocate(2 << 20, nullptr);
+    allocator.Free(a);
+
+    // too small to reuse the cached 2 MB block, but still fits next to it
+    void* b = allocator.Allocate(256 << 10, nullptr);
+    BOOST_CHECK(b != nullptr);
+    BOOST_CHECK_EQUAL(raw.m_numFrees, 0);
+
+    // only fits once the cache has been emptied
+    void* c = allocator.Allocate(1 << 20, nullptr);
+    BOOST_CHECK(c != nullptr);
+    BOOST_CHECK_EQUAL(raw.m_numFrees, 1);
+    BOOST_CHECK_EQUAL(allocator.GetStatistics().m_cachedBytes, 0);
+
+    // does not fit at all
+    BOOST_CHECK(allocator.Allocate(4 << 20, nullptr) == nullptr);
+
+    allocator.Free(b);
+    allocator.Free(c);
+}
+
+BOOST_AUTO_TEST_CASE(CachingBlockAllocatorReservation)
+{
+    CountingRawAllocator raw;
+    CachingBlockAllocator allocator(raw.AllocateFunction(), raw.FreeFunction());
+
+    // blocks freed while a reservation is open are not reused
+    allocator.BeginReservation();
+    BOOST_CHECK_THROW(allocator.BeginReservation(), std::logic_error);
+    void* a = allocator.Allocate(4096, nullptr);
+    allocator.Free(a);
+    void* b = allocator.Allocate(4096, nullptr);
+    BOOST_CHECK_NE(a, b);
+    auto reservation = allocator.EndReservation();
+    BOOST_REQUIRE_EQUAL(reservation.m_blocks.size(), 1);
+    BOOST_CHECK_EQUAL(reservation.m_blocks[0].m_ptr, a);
+    BOOST_CHECK_EQUAL(allocator.GetStatistics().m_reservedBytes, CachingBlockAllocator::RoundedSize(4096));
+
+    // nor after it, until it is released
+    allocator.Free(b);
+    void* c = allocator.Allocate(4096, nullptr);
+    BOOST_CHECK_EQUAL(b, c);
+    void* d = allocator.Allocate(4096, nullptr);
+    BOOST_CHECK_NE(a, d);
+    allocator.ReleaseReservation(std::move(reservation));
+    BOOST_CHECK_EQUAL(allocator.GetStatistics().m_reservedBytes, 0);
+    void* e = allocator.Allocate(4096, nullptr);
+    BOOST_CHECK_EQUAL(a, e);
+
+    BOOST_CHECK_THROW(allocator.EndReservation(), std::logic_error);
+    allocator.Free(c);
+    allocator.Free(d);
+    allocator.Free(e);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
+}}}}
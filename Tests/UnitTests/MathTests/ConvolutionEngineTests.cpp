@@ -15,6 +15,9 @@
 #include "../../../Source/Math/GPUMatrix.h"
 #include "../../../Source/Math/ConvolutionEngine.h"
 #include "../../../Source/Math/CuDnnFactories.h"
+#include "../../../Source/Math/ConvolutionAutotuneCache.h"
+#include <cstdio>
+#include <fstream>
 #include "common.h"
 
 namespace Microsoft { namespace MSR { namespace CNTK { namespace Test {
@@ -50,6 +53,11 @@ size_t CountNans(const SingleMatrix& src)
     return n;
 }
 
+ConvolutionEngineKind DirectOrReference()
+{
+    return (ConvolutionEngineKind)((int)ConvolutionEngineKind::Direct | (int)ConvolutionEngineKind::Reference);
+}
+
 // Returns vector of engine config parameters: <kind, device, maxTempMemSizeInSamples>
 std::vector<std::tuple<ConvolutionEngineKind, DEVICEID_TYPE, size_t>> GetTestEngineConfigs()
 {
@@ -62,6 +70,19 @@ std::vector<std::tuple<ConvolutionEngineKind, DEVICEID_TYPE, size_t>> GetTestEng
     res.push_back(std::make_tuple(ConvolutionEngineKind::Gemm, -1, 0));
     res.push_back(std::make_tuple(ConvolutionEngineKind::Gemm, -1, 1));
     res.push_back(std::make_tuple(ConvolutionEngineKind::Gemm, -1, 3));
+
+    // Direct engine. CPU only, does not use temp memory. Falls back to the reference engine for other geometries.
+    res.push_back(std::make_tuple(DirectOrReference(), -1, 0));
+    return res;
+}
+
+// Returns vector of pooling engine config parameters: <kind, device>
+std::vector<std::tuple<ConvolutionEngineKind, DEVICEID_TYPE>> GetTestPoolEngineConfigs()
+{
+    std::vector<std::tuple<ConvolutionEngineKind, DEVICEID_TYPE>> res;
+    res.push_back(std::make_tuple(ConvolutionEngineKind::Reference, -1));
+    res.push_back(std::make_tuple(ConvolutionEngineKind::Reference, 0));
+    res.push_back(std::make_tuple(DirectOrReference(), -1));
     return res;
 }
 
@@ -233,6 +254,54 @@ BOOST_AUTO_TEST_CASE(ConvolutionForward)
     }
 }
 
+BOOST_AUTO_TEST_CASE(ConvolutionForwardHWC)
+{
+    std::mt19937 rng(0);
+    boost::random::uniform_int_distribution<> batchSizeG(1, 8);
+    boost::random::normal_distribution<float> nd;
+
+    // cuDNN handles square HWC geometries in place of the legacy engine, which is the reference here.
+    int deviceId = 0;
+    for (size_t k : {1, 3, 5})
+    {
+        for (size_t inC : {1, 3})
+        {
+            for (bool autoPad : {false, true})
+            {
+                auto g = std::make_shared<ConvolveGeometry>(TensorShape(2 * k + 3, 2 * k + 3, inC),
+                    TensorShape(k, k, inC), TensorShape(4), TensorShape(2, 2, inC),
+                    ConvolveGeometry::BoolVec{true}, ConvolveGeometry::BoolVec{autoPad, autoPad, false},
+                    TensorShape(0), TensorShape(0));
+                auto baseEng = ConvEng::Create(g, deviceId, ImageLayoutKind::HWC, 0, PoolKind::None, ConvolutionEngineKind::Legacy);
+                auto testEng = ConvEng::Create(g, deviceId, ImageLayoutKind::HWC, 0, PoolKind::None, ConvolutionEngineKind::CuDnn);
+
+                size_t n = batchSizeG(rng);
+                vec buf(g->InputShape().GetNumElements() * n);
+                std::generate(begin(buf), end(buf), [&] { return nd(rng); });
+                SingleMatrix in(g->InputShape().GetNumElements(), n, buf.data(), deviceId, matrixFlagNormal);
+
+                size_t mapCount = g->GetMapCount(g->InputShape().GetRank() - 1);
+                buf.resize(g->KernelShape().GetNumElements() * mapCount);
+                std::generate(begin(buf), end(buf), [&] { return nd(rng); });
+                SingleMatrix kernel(mapCount, g->KernelShape().GetNumElements(), buf.data(), deviceId, matrixFlagNormal);
+
+                SingleMatrix out(g->OutputShape().GetNumElements(), n, deviceId);
+                SingleMatrix outB(g->OutputShape().GetNumElements(), n, deviceId);
+                SingleMatrix workspace(deviceId);
+
+                testEng->Forward(in, kernel, out, workspace);
+                baseEng->Forward(in, kernel, outB, workspace);
+
+                std::stringstream tmsg;
+                tmsg << "Geometry: " << (std::string)(*g) << ", Batch: " << n;
+                std::string emsg;
+                BOOST_REQUIRE_MESSAGE(CheckEqual(out, outB, emsg, Err<float>::Rel * 4, Err<float>::Abs * 14),
+                                      "out are not equal, " << tmsg.str() << ". " << emsg);
+            }
+        }
+    }
+}
+
 BOOST_AUTO_TEST_CASE(ConvolutionBackwardData)
 {
     std::mt19937 rng(0);
@@ -388,11 +457,12 @@ BOOST_AUTO_TEST_CASE(PoolingForward)
     };
 
     int baseDeviceId = 0;
-    auto engKind = ConvolutionEngineKind::Reference;
     for (auto kind : {PoolKind::Max, PoolKind::Average})
     {
-        for (int deviceId : {-1, 0})
+        for (const auto& engCfg : GetTestPoolEngineConfigs())
         {
+            auto engKind = std::get<0>(engCfg);
+            auto deviceId = std::get<1>(engCfg);
             for (const auto& g : GeneratePoolTestConfigs())
             {
                 auto baseEng = ConvEng::Create(g, baseDeviceId, ImageLayoutKind::CHW, 0, kind, ConvolutionEngineKind::CuDnn);
@@ -448,11 +518,12 @@ BOOST_AUTO_TEST_CASE(PoolingBackward)
     };
 
     int baseDeviceId = 0;
-    auto engKind = ConvolutionEngineKind::Reference;
     for (auto kind : {PoolKind::Max, PoolKind::Average})
     {
-        for (int deviceId : {-1, 0})
+        for (const auto& engCfg : GetTestPoolEngineConfigs())
         {
+            auto engKind = std::get<0>(engCfg);
+            auto deviceId = std::get<1>(engCfg);
             for (const auto& g : GeneratePoolTestConfigs())
             {
                 auto baseEng = ConvEng::Create(g, baseDeviceId, ImageLayoutKind::CHW, 0, kind, ConvolutionEngineKind::CuDnn);
@@ -584,6 +655,136 @@ BOOST_AUTO_TEST_CASE(MaxUnpooling)
     }
 }
 
+BOOST_AUTO_TEST_CASE(ROIPooling)
+{
+    std::mt19937 rng(0);
+    boost::random::normal_distribution<float> nd;
+    boost::random::uniform_real_distribution<float> ud(0, 1);
+
+    int cpuDeviceId = -1;
+    int gpuDeviceId = 0;
+
+    const size_t width = 13, height = 9, channels = 3, pooledWidth = 3, pooledHeight = 2;
+    for (size_t numImg : {1, 3})
+    {
+        for (size_t numRois : {1, 16})
+        {
+            vec buf(width * height * channels * numImg);
+            std::generate(begin(buf), end(buf), [&] { return nd(rng); });
+            SingleMatrix inC(width * height * channels, numImg, buf.data(), cpuDeviceId, matrixFlagNormal);
+            SingleMatrix inG(width * height * channels, numImg, buf.data(), gpuDeviceId, matrixFlagNormal);
+
+            // Overlapping ROIs (x, y, w, h), including ones that reach out of the image.
+            vec rois(4 * numRois * numImg);
+            std::generate(begin(rois), end(rois), [&] { return ud(rng); });
+            SingleMatrix roisC(4 * numRois, numImg, rois.data(), cpuDeviceId, matrixFlagNormal);
+            SingleMatrix roisG(4 * numRois, numImg, rois.data(), gpuDeviceId, matrixFlagNormal);
+
+            size_t crowOut = pooledWidth * pooledHeight * channels * numRois;
+            SingleMatrix outC(crowOut, numImg, cpuDeviceId);
+            SingleMatrix outG(crowOut, numImg, gpuDeviceId);
+            SingleMatrix argmaxC(crowOut, numImg, cpuDeviceId);
+            SingleMatrix argmaxG(crowOut, numImg, gpuDeviceId);
+            inC.ROIPoolingForward(numRois, numImg, channels, width, height, pooledWidth, pooledHeight, roisC, outC, argmaxC);
+            inG.ROIPoolingForward(numRois, numImg, channels, width, height, pooledWidth, pooledHeight, roisG, outG, argmaxG);
+
+            std::stringstream tmsg;
+            tmsg << "Images: " << numImg << ", ROIs: " << numRois;
+            std::string msg = " are not equal, " + tmsg.str();
+            std::string emsg;
+            BOOST_REQUIRE_MESSAGE(CheckEqual(outC, outG, emsg, 0, 0), "out" << msg << ". " << emsg);
+            BOOST_REQUIRE_MESSAGE(CheckEqual(argmaxC, argmaxG, emsg, 0, 0), "argmax" << msg << ". " << emsg);
+
+            // The gradient is accumulated into the existing one.
+            buf.resize(crowOut * numImg);
+            std::generate(begin(buf), end(buf), [&] { return nd(rng); });
+            SingleMatrix pooledGradC(crowOut, numImg, buf.data(), cpuDeviceId, matrixFlagNormal);
+            SingleMatrix pooledGradG(crowOut, numImg, buf.data(), gpuDeviceId, matrixFlagNormal);
+            SingleMatrix gradC(width * height * channels, numImg, cpuDeviceId);
+            SingleMatrix gradG(width * height * channels, numImg, gpuDeviceId);
+            gradC.SetValue(1);
+            gradG.SetValue(1);
+            pooledGradC.ROIPoolingBackward(numRois, numImg, channels, width, height, pooledWidth, pooledHeight, roisC, gradC, argmaxC);
+            pooledGradG.ROIPoolingBackward(numRois, numImg, channels, width, height, pooledWidth, pooledHeight, roisG, gradG, argmaxG);
+
+            BOOST_REQUIRE_MESSAGE(CheckEqual(gradC, gradG, emsg, Err<float>::Rel, Err<float>::Abs), "grad" << msg << ". " << emsg);
+            // The gradient goes to the maxima only, so it sums up to the one of the non-empty bins.
+            float expectedSum = (float)(width * height * channels * numImg);
+            for (size_t j = 0; j < numImg; j++)
+                for (size_t i = 0; i < crowOut; i++)
+                    expectedSum += argmaxC(i, j) >= 0 ? pooledGradC(i, j) : 0;
+            BOOST_REQUIRE_MESSAGE(AreEqual(gradC.SumOfElements(), expectedSum, Err<float>::Rel, Err<float>::Abs * 8), "grad sum" << msg);
+        }
+    }
+}
+
+BOOST_AUTO_TEST_CASE(ConvolutionAutotuneCacheFile)
+{
+    const char* path = "ConvolutionAutotuneCache.txt";
+    {
+        std::ofstream file(path);
+        file << "key 1\tvalue 1\n"
+             << "cut off line\n"
+             << "key 2\tvalue 2\n"
+             << "key 1\tvalue 3\n";
+    }
+
+    auto& cache = ConvolutionAutotuneCache::Instance();
+    cache.SetFile(L"ConvolutionAutotuneCache.txt");
+    std::string value;
+    BOOST_REQUIRE(cache.TryGet("key 1", value));
+    BOOST_CHECK_EQUAL(value, "value 3");
+    BOOST_REQUIRE(cache.TryGet("key 2", value));
+    BOOST_CHECK_EQUAL(value, "value 2");
+    BOOST_CHECK(!cache.TryGet("cut off line", value));
+
+    cache.Set("key 3", "value 4");
+    cache.SetFile(L"");
+
+    std::ifstream file(path);
+    std::string line, lastLine;
+    while (std::getline(file, line))
+        lastLine = line;
+    BOOST_CHECK_EQUAL(lastLine, "key 3\tvalue 4");
+    file.close();
+    std::remove(path);
+}
+
+BOOST_AUTO_TEST_CASE(ConvolutionEngineAutotuning)
+{
+    std::mt19937 rng(0);
+    boost::random::normal_distribution<float> nd;
+
+    // on the CPU, the Gemm and the reference engines compete
+    auto& cache = ConvolutionAutotuneCache::Instance();
+    cache.SetEngineAutotuning(true);
+    for (const auto& g : GenerateConvTestConfigs())
+    {
+        auto baseEng = ConvEng::Create(g, -1, ImageLayoutKind::CHW, 0, PoolKind::None, ConvolutionEngineKind::Reference);
+        auto testEng = ConvEng::Create(g, -1, ImageLayoutKind::CHW, 0, PoolKind::None, (ConvolutionEngineKind)((int)ConvolutionEngineKind::Gemm | (int)ConvolutionEngineKind::Reference));
+
+        size_t n = 3;
+        vec buf(g->InputShape().GetNumElements() * n);
+        std::generate(begin(buf), end(buf), [&] { return nd(rng); });
+        SingleMatrix in(g->InputShape().GetNumElements(), n, buf.data(), -1, matrixFlagNormal);
+
+        size_t mapCount = g->GetMapCount(g->InputShape().GetRank() - 1);
+        buf.resize(g->KernelShape().GetNumElements() * mapCount);
+        std::generate(begin(buf), end(buf), [&] { return nd(rng); });
+        SingleMatrix kernel(mapCount, g->KernelShape().GetNumElements(), buf.data(), -1, matrixFlagNormal);
+
+        SingleMatrix out(g->OutputShape().GetNumElements(), n, -1);
+        SingleMatrix outB(g->OutputShape().GetNumElements(), n, -1);
+        SingleMatrix workspace(-1);
+        testEng->Forward(in, kernel, out, workspace);
+        baseEng->Forward(in, kernel, outB, workspace);
+
+        std::string emsg;
+        BOOST_REQUIRE_MESSAGE(CheckEqual(out, outB, emsg, Err<float>::Rel, Err<float>::Abs), "out are not equal, Geometry: " << (std::string)(*g) << ". " << emsg);
+    }
+    cache.SetEngineAutotuning(false);
+}
+
 BOOST_AUTO_TEST_SUITE_END()
 
 } } } }
@@ -261,6 +261,46 @@ BOOST_FIXTURE_TEST_CASE(GPUDenseTimesSparse, RandomSeedFixture)
     BOOST_CHECK(twiceTransposeC.IsEqualTo(matrixC, c_epsilonFloatE4));
 }
 
+BOOST_FIXTURE_TEST_CASE(GPUDenseTimesSparseRandom, RandomSeedFixture)
+{
+    // covers both the convolution kernels (few non-zeros per column) and the cuSPARSE / nnz-balanced paths (many)
+    for (size_t m : {1, 10, 100})
+    {
+        for (size_t k : {1, 10, 100})
+        {
+            for (size_t n : {1, 10, 100})
+            {
+                GPUMatrix<float> rhsDense(c_deviceIdZero);
+                rhsDense.AssignTruncateBottomOf(GPUMatrix<float>::RandomUniform(k, n, c_deviceIdZero, -1.0f, 1.0f, IncrementCounter()), 0);
+                GPUSparseMatrix<float> rhs(rhsDense, MatrixFormat::matrixFormatSparseCSC);
+
+                // Dense x Sparse = Dense
+                GPUMatrix<float> lhs = GPUMatrix<float>::RandomUniform(m, k, c_deviceIdZero, -1.0f, 1.0f, IncrementCounter());
+                for (float beta : {0.0f, 1.0f})
+                {
+                    GPUMatrix<float> resultSP = GPUMatrix<float>::Ones(m, n, c_deviceIdZero);
+                    GPUSparseMatrix<float>::MultiplyAndWeightedAdd(1, lhs, false, rhs, false, beta, resultSP);
+
+                    GPUMatrix<float> resultDS = GPUMatrix<float>::Ones(m, n, c_deviceIdZero);
+                    GPUMatrix<float>::MultiplyAndWeightedAdd(1, lhs, false, rhsDense, false, beta, resultDS);
+
+                    BOOST_CHECK(resultSP.IsEqualTo(resultDS, c_epsilonFloatE4));
+                }
+
+                // Dense x Sparse^T = SparseBlockCol, as in the gradient of an embedding
+                GPUMatrix<float> lhsGradient = GPUMatrix<float>::RandomUniform(m, n, c_deviceIdZero, -1.0f, 1.0f, IncrementCounter());
+                GPUSparseMatrix<float> resultBlock(c_deviceIdZero, MatrixFormat::matrixFormatSparseBlockCol);
+                GPUSparseMatrix<float>::MultiplyAndAdd(1, lhsGradient, false, rhs, true, resultBlock);
+
+                GPUMatrix<float> resultDS = GPUMatrix<float>::Zeros(m, k, c_deviceIdZero);
+                GPUMatrix<float>::MultiplyAndWeightedAdd(1, lhsGradient, false, rhsDense, true, 0, resultDS);
+
+                BOOST_CHECK(resultBlock.CopyToDenseMatrix().IsEqualTo(resultDS, c_epsilonFloatE4));
+            }
+        }
+    }
+}
+
 BOOST_FIXTURE_TEST_CASE(GPUSparseTimesSparse, RandomSeedFixture)
 {
     GPUSparseMatrix<float> matrixA;
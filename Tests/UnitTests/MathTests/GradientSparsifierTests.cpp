@@ -0,0 +1,107 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE.md file in the project root for full license information.
+//
+#include "stdafx.h"
+#include "../../../Source/Math/Matrix.h"
+#include "../../../Source/Math/GradientSparsifier.h"
+#include <algorithm>
+#include <memory>
+
+using namespace Microsoft::MSR::CNTK;
+namespace Microsoft { namespace MSR { namespace CNTK { namespace Test {
+
+// Sparsifies a random gradient twice and checks that nothing is lost: the selected entries and the residual
+// add up to the gradients handed in, and on the CPU exactly the k largest entries are selected.
+template <class ElemType>
+static void TestSparsification(DEVICEID_TYPE deviceId, size_t numRows, size_t numCols, double fraction, ElemType tolerance)
+{
+    GradientSparsifier<ElemType> sparsifier(fraction);
+    Matrix<ElemType> gradient(numRows, numCols, deviceId);
+    Matrix<ElemType> residual(numRows, numCols, deviceId);
+    residual.SetValue(0);
+    size_t numElements = gradient.GetNumElements();
+
+    std::vector<ElemType> sum(numElements, 0); // of the gradients handed in so far
+    std::vector<ElemType> sent(numElements, 0);
+    std::vector<unsigned int> indices;
+    std::vector<ElemType> values;
+    for (unsigned long iteration = 0; iteration < 2; iteration++)
+    {
+        gradient.SetUniformRandomValue(-1, 1, 2017 + iteration);
+        std::unique_ptr<ElemType[]> gradientValues(gradient.CopyToArray());
+        for (size_t i = 0; i < numElements; i++)
+            sum[i] += gradientValues[i];
+
+        // the magnitudes the CPU selection must take
+        std::unique_ptr<ElemType[]> accumulated(residual.CopyToArray());
+        std::vector<ElemType> magnitudes(numElements);
+        for (size_t i = 0; i < numElements; i++)
+            magnitudes[i] = fabs(accumulated[i] + gradientValues[i]);
+        std::sort(magnitudes.begin(), magnitudes.end(), std::greater<ElemType>());
+
+        size_t k = sparsifier.NumToSelect(numElements);
+        size_t numSelected = sparsifier.Sparsify(gradient, residual, indices, values);
+        BOOST_CHECK_EQUAL(numSelected, indices.size());
+        BOOST_CHECK_EQUAL(numSelected, values.size());
+        BOOST_CHECK(numSelected > 0);
+        BOOST_CHECK(numSelected <= sparsifier.MaxNumSelected(numElements));
+        if (deviceId == CPUDEVICE)
+        {
+            BOOST_CHECK_EQUAL(numSelected, k);
+            for (auto value : values)
+                BOOST_CHECK(fabs(value) >= magnitudes[k - 1]);
+        }
+
+        std::vector<bool> selected(numElements, false);
+        for (size_t j = 0; j < numSelected; j++)
+        {
+            BOOST_REQUIRE(indices[j] < numElements);
+            BOOST_CHECK(!selected[indices[j]]);
+            selected[indices[j]] = true;
+            sent[indices[j]] += values[j];
+        }
+
+        std::unique_ptr<ElemType[]> residualValues(residual.CopyToArray());
+        for (size_t i = 0; i < numElements; i++)
+        {
+            if (selected[i])
+                BOOST_CHECK_EQUAL(residualValues[i], 0);
+            BOOST_CHECK_CLOSE_FRACTION(sent[i] + residualValues[i], sum[i], tolerance);
+        }
+    }
+}
+
+BOOST_AUTO_TEST_SUITE(CPUMatrixSuite)
+
+BOOST_FIXTURE_TEST_CASE(CPUGradientSparsifyFloat, RandomSeedFixture)
+{
+    TestSparsification<float>(CPUDEVICE, 100, 50, 0.01, c_epsilonFloatE4);
+    TestSparsification<float>(CPUDEVICE, 13, 7, 0.2, c_epsilonFloatE4);
+    TestSparsification<float>(CPUDEVICE, 1, 1, 0.01, c_epsilonFloatE4);
+}
+
+BOOST_FIXTURE_TEST_CASE(CPUGradientSparsifyDouble, RandomSeedFixture)
+{
+    TestSparsification<double>(CPUDEVICE, 100, 50, 0.01, 1e-10);
+    TestSparsification<double>(CPUDEVICE, 25, 13, 1, 1e-10);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
+
+BOOST_AUTO_TEST_SUITE(GPUMatrixSuite)
+
+BOOST_FIXTURE_TEST_CASE(GPUGradientSparsifyFloat, RandomSeedFixture)
+{
+    TestSparsification<float>(c_deviceIdZero, 100, 50, 0.01, c_epsilonFloatE4);
+    TestSparsification<float>(c_deviceIdZero, 1000, 300, 0.001, c_epsilonFloatE4);
+    TestSparsification<float>(c_deviceIdZero, 13, 7, 0.2, c_epsilonFloatE4);
+}
+
+BOOST_FIXTURE_TEST_CASE(GPUGradientSparsifyDouble, RandomSeedFixture)
+{
+    TestSparsification<double>(c_deviceIdZero, 100, 50, 0.01, 1e-10);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
+}}}}
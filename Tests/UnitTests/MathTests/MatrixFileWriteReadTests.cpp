@@ -37,6 +37,45 @@ BOOST_FIXTURE_TEST_CASE(CPUMatrixFileWriteRead, RandomSeedFixture)
     BOOST_CHECK(matrixCpuCopy.IsEqualTo(matrixCpuRead, c_epsilonFloatE5));
 }
 
+BOOST_FIXTURE_TEST_CASE(CPUMatrixFileWriteReadBinary, RandomSeedFixture)
+{
+    CPUMatrix<float> matrixCpu = CPUMatrix<float>::RandomUniform(43, 10, -26.3f, 30.2f, IncrementCounter());
+
+    std::wstring fileNameCpu(L"MCPU.bin");
+    File fileCpu(fileNameCpu, fileOptionsBinary | fileOptionsReadWrite);
+
+    fileCpu << matrixCpu << matrixCpu.ColumnSlice(2, 3);
+    fileCpu.SetPosition(0);
+
+    // binary values are read back exactly, also into a matrix that had another size
+    CPUMatrix<float> matrixCpuRead(5, 7);
+    CPUMatrix<float> sliceRead;
+    fileCpu >> matrixCpuRead >> sliceRead;
+
+    BOOST_CHECK(matrixCpu.IsEqualTo(matrixCpuRead, 0));
+    BOOST_CHECK(matrixCpu.ColumnSlice(2, 3).IsEqualTo(sliceRead, 0));
+}
+
+BOOST_FIXTURE_TEST_CASE(CPUMatrixFileReadOtherPrecision, RandomSeedFixture)
+{
+    CPUMatrix<double> matrixCpu = CPUMatrix<double>::RandomUniform(43, 10, -26.3, 30.2, IncrementCounter());
+
+    std::wstring fileNameCpu(L"MCPUDouble.bin");
+    File fileCpu(fileNameCpu, fileOptionsBinary | fileOptionsReadWrite);
+
+    fileCpu << matrixCpu;
+    fileCpu.SetPosition(0);
+
+    // a double matrix is converted when read into a float one, e.g. when a double model is loaded as float
+    CPUMatrix<float> matrixCpuRead;
+    fileCpu >> matrixCpuRead;
+
+    BOOST_CHECK_EQUAL(matrixCpu.GetNumRows(), matrixCpuRead.GetNumRows());
+    BOOST_CHECK_EQUAL(matrixCpu.GetNumCols(), matrixCpuRead.GetNumCols());
+    foreach_coord (i, j, matrixCpu)
+        BOOST_CHECK_EQUAL((float) matrixCpu(i, j), matrixCpuRead(i, j));
+}
+
 BOOST_FIXTURE_TEST_CASE(MatrixFileWriteRead, RandomSeedFixture)
 {
     // Test Matrix in Dense mode
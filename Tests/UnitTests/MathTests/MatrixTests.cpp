@@ -6,6 +6,9 @@
 #include "../../../Source/Math/Matrix.h"
 #include "../../../Source/Math/CPUMatrix.h"
 #include "../../../Source/Math/Helpers.h"
+#include <algorithm>
+#include <numeric>
+#include <random>
 
 #define IDX2C(i, j, ld) (((j) * (ld)) + (i)) // 0 based indexing
 
@@ -114,6 +117,22 @@ BOOST_FIXTURE_TEST_CASE(MatrixDeepCopy, RandomSeedFixture)
     BOOST_CHECK_EQUAL(b.GetNumCols(), 0);
 }
 
+BOOST_FIXTURE_TEST_CASE(MatrixDeepCloneToCPU, RandomSeedFixture)
+{
+    SingleMatrix a = SingleMatrix::RandomGaussian(64, 23, c_deviceIdZero, 0.0f, 2.0f, IncrementCounter());
+    SingleMatrix b = a.DeepCloneToCPU();
+    BOOST_CHECK_EQUAL(a.GetDeviceId(), c_deviceIdZero); // the source stays where it is
+    BOOST_CHECK_EQUAL(b.GetDeviceId(), CPUDEVICE);
+    BOOST_CHECK_EQUAL(b.GetNumRows(), 64);
+    BOOST_CHECK_EQUAL(b.GetNumCols(), 23);
+
+    SingleMatrix c(a.DeepClone(), CPUDEVICE);
+    BOOST_CHECK(b.IsEqualTo(c));
+
+    SingleMatrix empty(0, 5, c_deviceIdZero);
+    BOOST_CHECK_EQUAL(empty.DeepCloneToCPU().GetNumCols(), 5);
+}
+
 BOOST_FIXTURE_TEST_CASE(MatrixInitZero, RandomSeedFixture)
 {
     SingleMatrix a = SingleMatrix::Zeros(12, 32, c_deviceIdZero);
@@ -1094,6 +1113,48 @@ BOOST_FIXTURE_TEST_CASE(MatrixVectorMax, RandomSeedFixture)
     }
 }
 
+// columns of a large output with many equal values: the top k in descending order, equal values by row index,
+// on the GPU from the selection per column (k <= 2048) or the sort
+BOOST_FIXTURE_TEST_CASE(MatrixVectorMaxTopKOfLargeColumns, RandomSeedFixture)
+{
+    const int rows = 5000, cols = 7;
+    std::mt19937 rng(1);
+    std::uniform_int_distribution<int> value(-50, 50);
+    std::vector<float> src(rows * cols);
+    for (auto& v : src)
+        v = value(rng) * 0.25f;
+
+    for (int topK : {2, 17, 100, 2048, 3000})
+    {
+        std::vector<float> expectedIdx(topK * cols), expectedVal(topK * cols);
+        for (int j = 0; j < cols; j++)
+        {
+            const float* column = src.data() + j * rows;
+            std::vector<int> order(rows);
+            std::iota(order.begin(), order.end(), 0);
+            std::stable_sort(order.begin(), order.end(), [column](int a, int b) { return column[a] > column[b]; });
+            for (int i = 0; i < topK; i++)
+            {
+                expectedIdx[j * topK + i] = (float) order[i];
+                expectedVal[j * topK + i] = column[order[i]];
+            }
+        }
+
+        for (auto deviceId : {CPUDEVICE, c_deviceIdZero})
+        {
+            Matrix<float> expIdx(topK, cols, expectedIdx.data(), deviceId, matrixFlagNormal);
+            Matrix<float> expVal(topK, cols, expectedVal.data(), deviceId, matrixFlagNormal);
+
+            Matrix<float> actual(rows, cols, src.data(), deviceId, matrixFlagNormal);
+            Matrix<float> actualIdx(deviceId);
+            Matrix<float> actualVal(deviceId);
+            actual.VectorMax(actualIdx, actualVal, true, topK);
+            BOOST_CHECK_MESSAGE(actualIdx.IsEqualTo(expIdx), "indices, k = " << topK << ", device " << deviceId);
+            BOOST_CHECK_MESSAGE(actualVal.IsEqualTo(expVal), "values, k = " << topK << ", device " << deviceId);
+        }
+    }
+}
+
 BOOST_FIXTURE_TEST_CASE(MatrixAssignNumOfDiff, RandomSeedFixture)
 {
     float labels[] = {1.0f, 2.0f, 3.0f};
@@ -1116,6 +1177,391 @@ BOOST_FIXTURE_TEST_CASE(MatrixAssignNumOfDiff, RandomSeedFixture)
         BOOST_CHECK_EQUAL(expectedDiff, actual.Get00Element());
     }
 }
+
+BOOST_FIXTURE_TEST_CASE(MatrixLambdaRank, RandomSeedFixture)
+{
+    // three queries; the urls of a query are in descending order of gain, and the third query has tied scores
+    float gains[] = {31, 7, 0, 3, 0, 0, 15, 15, 7, 3, 0, 0};
+    float scores[] = {0.9f, 0.3f, 0.0f, 0.4f, 0.5f, 0.3f, 0.2f, 0.7f, 0.2f, 0.7f, -0.1f, 0.2f};
+    float queryIds[] = {0, 0, 0, 1, 1, 1, 4, 4, 4, 4, 4, 4};
+    const int n = 12;
+    const float sigma = 1;
+
+    // reference: rank by descending score, ties broken by ascending gain and then by position
+    std::vector<float> expectedDiscounts(n), expectedGradient(n, 1.0f);
+    double ndcgSum = 0;
+    int numQueries = 0;
+    for (int begin = 0, end; begin < n; begin = end)
+    {
+        for (end = begin; end < n && queryIds[end] == queryIds[begin]; end++)
+            ;
+        double idealMetric = 0, metric = 0;
+        for (int i = begin; i < end; i++)
+        {
+            int rank = 0;
+            for (int j = begin; j < end; j++)
+                rank += scores[j] > scores[i] || (scores[j] == scores[i] && (gains[j] < gains[i] || (gains[j] == gains[i] && j < i)));
+            expectedDiscounts[i] = (float) log(2.0 + rank);
+            idealMetric += gains[i] / log(2.0 + (i - begin));
+            metric += gains[i] / log(2.0 + rank);
+        }
+        ndcgSum += idealMetric != 0 ? metric / idealMetric : 0;
+        numQueries++;
+
+        for (int i = begin; i < end; i++)
+        {
+            for (int j = i + 1; j < end; j++)
+            {
+                if (gains[i] == gains[j] || gains[i] == gains[end - 1] || idealMetric == 0)
+                    continue;
+                double di = expectedDiscounts[i], dj = expectedDiscounts[j];
+                double lambda = -sigma / (1 + exp(sigma * (scores[i] - scores[j]))) * fabs((gains[i] - gains[j]) * (di - dj) / (di * dj) / idealMetric);
+                expectedGradient[i] += (float) lambda;
+                expectedGradient[j] -= (float) lambda;
+            }
+        }
+    }
+    float expectedMetric = (float) ((1 - ndcgSum / numQueries) * 100 * n);
+
+    for (auto deviceId : {CPUDEVICE, c_deviceIdZero})
+    {
+        Matrix<float> gainsM(1, n, gains, deviceId, matrixFlagNormal);
+        Matrix<float> scoresM(1, n, scores, deviceId, matrixFlagNormal);
+        Matrix<float> queryIdsM(1, n, queryIds, deviceId, matrixFlagNormal);
+        Matrix<float> expDiscounts(1, n, expectedDiscounts.data(), deviceId, matrixFlagNormal);
+        Matrix<float> expGradient(1, n, expectedGradient.data(), deviceId, matrixFlagNormal);
+
+        Matrix<float> discounts(deviceId);
+        Matrix<float> metric(deviceId);
+        metric.AssignLambdaRankMetricOf(gainsM, scoresM, queryIdsM, discounts);
+        BOOST_CHECK_CLOSE(expectedMetric, metric.Get00Element(), 1e-3);
+        BOOST_CHECK(discounts.IsEqualTo(expDiscounts, 1e-6f));
+
+        Matrix<float> gradient = Matrix<float>::Ones(1, n, deviceId);
+        gradient.AddLambdaRankGradientOf(sigma, gainsM, scoresM, queryIdsM, discounts);
+        BOOST_CHECK(gradient.IsEqualTo(expGradient, 1e-5f));
+    }
+}
+
+BOOST_FIXTURE_TEST_CASE(MatrixGMMLogLikelihood, RandomSeedFixture)
+{
+    const size_t numComponents = 3, dim = 4, numSamples = 5;
+    std::mt19937 rng(1);
+    std::uniform_real_distribution<double> value(-1, 1);
+
+    // shared priors and log stddevs with means for each sample, and the other way round
+    for (bool perSampleMeans : {true, false})
+    {
+        const size_t colsU = perSampleMeans ? 1 : numSamples, colsMeans = perSampleMeans ? numSamples : 1, colsLogStddevs = colsU;
+        std::vector<double> u(numComponents * colsU), means(numComponents * dim * colsMeans), logStddevs(numComponents * colsLogStddevs), features(dim * numSamples);
+        for (auto v : {&u, &means, &logStddevs, &features})
+            for (auto& x : *v)
+                x = value(rng);
+        std::vector<double> g(numSamples, 1.0);
+        g[1] = -0.5;
+
+        // log p(x_t), computed from the densities directly
+        auto logLikelihood = [&](size_t t)
+        {
+            const double* ut = u.data() + (colsU == 1 ? 0 : t * numComponents);
+            const double* mt = means.data() + (colsMeans == 1 ? 0 : t * numComponents * dim);
+            const double* st = logStddevs.data() + (colsLogStddevs == 1 ? 0 : t * numComponents);
+            double z = 0, p = 0;
+            for (size_t c = 0; c < numComponents; c++)
+                z += exp(ut[c]);
+            for (size_t c = 0; c < numComponents; c++)
+            {
+                double stddev = exp(st[c]), density = 1;
+                for (size_t d = 0; d < dim; d++)
+                {
+                    double diff = features[t * dim + d] - mt[c * dim + d];
+                    density *= exp(-0.5 * diff * diff / (stddev * stddev)) / (sqrt(TWO_PI) * stddev);
+                }
+                p += exp(ut[c]) / z * density;
+            }
+            return log(p);
+        };
+        std::vector<double> expectedLogLikelihoods(numSamples);
+        for (size_t t = 0; t < numSamples; t++)
+            expectedLogLikelihoods[t] = logLikelihood(t);
+
+        // the gradients are added to what is there; compare them to central differences of sum_t g_t log p(x_t)
+        std::vector<double>* inputs[] = {&u, &means, &logStddevs, &features};
+        std::vector<std::vector<double>> expectedGradients(4);
+        for (size_t inputIndex = 0; inputIndex < 4; inputIndex++)
+        {
+            for (auto& x : *inputs[inputIndex])
+            {
+                const double epsilon = 1e-6, x0 = x;
+                double difference = 0;
+                for (double sign : {1.0, -1.0})
+                {
+                    x = x0 + sign * epsilon;
+                    for (size_t t = 0; t < numSamples; t++)
+                        difference += sign * g[t] * logLikelihood(t);
+                }
+                x = x0;
+                expectedGradients[inputIndex].push_back(0.5 + difference / (2 * epsilon));
+            }
+        }
+
+        for (auto deviceId : {CPUDEVICE, c_deviceIdZero})
+        {
+            Matrix<double> uM(numComponents, colsU, u.data(), deviceId, matrixFlagNormal);
+            Matrix<double> meansM(numComponents * dim, colsMeans, means.data(), deviceId, matrixFlagNormal);
+            Matrix<double> logStddevsM(numComponents, colsLogStddevs, logStddevs.data(), deviceId, matrixFlagNormal);
+            Matrix<double> featuresM(dim, numSamples, features.data(), deviceId, matrixFlagNormal);
+            Matrix<double> gM(1, numSamples, g.data(), deviceId, matrixFlagNormal);
+            Matrix<double> expLogLikelihoods(1, numSamples, expectedLogLikelihoods.data(), deviceId, matrixFlagNormal);
+
+            Matrix<double> logLikelihoods(deviceId), posteriors(deviceId);
+            logLikelihoods.AssignGMMLogLikelihoodOf(uM, meansM, logStddevsM, featuresM, posteriors);
+            BOOST_CHECK(logLikelihoods.IsEqualTo(expLogLikelihoods, 1e-6));
+            Matrix<double> posteriorSums = Matrix<double>::Ones(1, numComponents, deviceId) * posteriors;
+            BOOST_CHECK(posteriorSums.IsEqualTo(Matrix<double>::Ones(1, numSamples, deviceId), 1e-10));
+
+            const Matrix<double>* inputMatrices[] = {&uM, &meansM, &logStddevsM, &featuresM};
+            for (size_t inputIndex = 0; inputIndex < 4; inputIndex++)
+            {
+                size_t rows = inputMatrices[inputIndex]->GetNumRows(), cols = inputMatrices[inputIndex]->GetNumCols();
+                Matrix<double> expected(rows, cols, expectedGradients[inputIndex].data(), deviceId, matrixFlagNormal);
+                Matrix<double> gradient(rows, cols, deviceId);
+                gradient.SetValue(0.5);
+                gradient.AddGMMLogLikelihoodGradientOf(inputIndex, gM, uM, meansM, logStddevsM, featuresM, posteriors);
+                BOOST_CHECK_MESSAGE(gradient.IsEqualTo(expected, 1e-6), "input " << inputIndex << ", device " << deviceId);
+            }
+        }
+    }
+}
+
+BOOST_FIXTURE_TEST_CASE(MatrixBatchMultiplyAndWeightedAdd, RandomSeedFixture)
+{
+    const size_t m = 5, n = 3, k = 7, batchSize = 11;
+
+    for (auto deviceId : {CPUDEVICE, c_deviceIdZero})
+    {
+        for (bool transposeA : {false, true})
+        {
+            for (bool transposeB : {false, true})
+            {
+                for (size_t bCols : {batchSize, (size_t) 1}) // b per product, or the same for all
+                {
+                    size_t aRows = transposeA ? k : m;
+                    size_t bRows = transposeB ? n : k;
+                    SingleMatrix a = SingleMatrix::RandomUniform(m * k, batchSize, deviceId, -1.0f, 1.0f, IncrementCounter());
+                    SingleMatrix b = SingleMatrix::RandomUniform(k * n, bCols, deviceId, -1.0f, 1.0f, IncrementCounter());
+                    SingleMatrix c = SingleMatrix::RandomUniform(m * n, batchSize, deviceId, -1.0f, 1.0f, IncrementCounter());
+                    SingleMatrix expected(c.DeepClone());
+                    for (size_t j = 0; j < batchSize; j++)
+                    {
+                        SingleMatrix cj = expected.ColumnSlice(j, 1).Reshaped(m, n);
+                        SingleMatrix::MultiplyAndWeightedAdd(0.5f, a.ColumnSlice(j, 1).Reshaped(aRows, m * k / aRows), transposeA,
+                                                             b.ColumnSlice(bCols == 1 ? 0 : j, 1).Reshaped(bRows, k * n / bRows), transposeB, 2.0f, cj);
+                    }
+
+                    SingleMatrix::BatchMultiplyAndWeightedAdd(0.5f, a, aRows, transposeA, b, bRows, transposeB, 2.0f, c);
+                    BOOST_CHECK(c.IsEqualTo(expected, c_epsilonFloatE4));
+                }
+            }
+        }
+    }
+}
+
+BOOST_FIXTURE_TEST_CASE(MatrixFusedElementwiseOp, RandomSeedFixture)
+{
+    const size_t rows = 37, cols = 53;
+
+    // c = Sigmoid(a + bias) .* b, with a column 'bias' for all columns
+    FusedElementwiseProgram program;
+    program.numInputs = 3;
+    program.numSteps = 3;
+    program.steps[0] = { opSum, 2, { 0, 1, 0 } };
+    program.steps[1] = { opSigmoid, 1, { 3, 0, 0 } };
+    program.steps[2] = { opElementwiseProduct, 2, { 4, 2, 0 } };
+
+    for (auto deviceId : {CPUDEVICE, c_deviceIdZero})
+    {
+        SingleMatrix a = SingleMatrix::RandomUniform(rows, cols, deviceId, -3.0f, 3.0f, IncrementCounter());
+        SingleMatrix bias = SingleMatrix::RandomUniform(rows, 1, deviceId, -1.0f, 1.0f, IncrementCounter());
+        SingleMatrix b = SingleMatrix::RandomUniform(rows, cols, deviceId, -2.0f, 2.0f, IncrementCounter());
+        SingleMatrix c(rows, cols, deviceId);
+        c.FusedElementwiseOp(program, { &a, &bias, &b });
+
+        foreach_coord (i, j, c)
+        {
+            float expected = b(i, j) / (1.0f + exp(-(a(i, j) + bias(i, 0))));
+            BOOST_CHECK_CLOSE(expected, c(i, j), 0.001f);
+        }
+
+        // a time step in a recurrent loop: column slices of the same range, only the output slice is written
+        SingleMatrix d(rows, cols, deviceId);
+        d.SetValue(7.0f);
+        SingleMatrix aSlice = a.ColumnSlice(10, 4), bSlice = b.ColumnSlice(10, 4), dSlice = d.ColumnSlice(10, 4);
+        dSlice.FusedElementwiseOp(program, { &aSlice, &bias, &bSlice });
+        foreach_coord (i, j, d)
+        {
+            float expected = j >= 10 && j < 14 ? c(i, j) : 7.0f;
+            BOOST_CHECK_CLOSE(expected, d(i, j), 0.001f);
+        }
+
+        // programs that refer to values not yet computed are rejected
+        program.steps[0].args[1] = 4;
+        BOOST_CHECK_THROW(c.FusedElementwiseOp(program, { &a, &bias, &b }), std::invalid_argument);
+        program.steps[0].args[1] = 1;
+    }
+}
+
+BOOST_FIXTURE_TEST_CASE(MatrixCosDistanceWithNegativeSamples, RandomSeedFixture)
+{
+    const size_t dim = 23, cols = 17, shift = 3, negNumber = 5;
+
+    std::vector<SingleMatrix> grads;
+    for (auto deviceId : {CPUDEVICE, c_deviceIdZero})
+    {
+        SingleMatrix a = SingleMatrix::RandomUniform(dim, cols, deviceId, -1.0f, 1.0f, IncrementCounter());
+        SingleMatrix b = SingleMatrix::RandomUniform(dim, cols, deviceId, -1.0f, 1.0f, IncrementCounter());
+        SingleMatrix c(deviceId), invNormA(deviceId), invNormB(deviceId);
+        c.AssignCosDistanceWithNegativeSamplesOf(a, b, shift, negNumber, invNormA, invNormB);
+
+        // same as the inner products of the shifted columns, scaled by the norms
+        SingleMatrix dots(deviceId);
+        dots.AssignInnerProductOfWithShiftNeg(a, b, true, shift, negNumber);
+        BOOST_CHECK_EQUAL(c.GetNumRows(), negNumber + 1);
+        foreach_coord (k, j, c)
+        {
+            size_t p = k == 0 ? j : (j + shift + k - 1) % cols;
+            float normA = 0, normB = 0;
+            for (size_t i = 0; i < dim; i++)
+            {
+                normA += a(i, j) * a(i, j);
+                normB += b(i, p) * b(i, p);
+            }
+            BOOST_CHECK_CLOSE(dots(k, j) / sqrt(normA * normB), c(k, j), 0.01f);
+        }
+
+        // gradients w.r.t. both inputs, accumulated into the same matrix
+        SingleMatrix gradient = SingleMatrix::RandomUniform(negNumber + 1, cols, deviceId, -1.0f, 1.0f, IncrementCounter());
+        SingleMatrix grad(dim, cols, deviceId);
+        grad.SetValue(0.0f);
+        grad.AddCosDistanceWithNegativeSamplesGradientOf(gradient, c, a, b, invNormA, invNormB, shift, false);
+        grad.AddCosDistanceWithNegativeSamplesGradientOf(gradient, c, a, b, invNormA, invNormB, shift, true);
+        grads.push_back(grad.DeepClone());
+    }
+
+    // CPU and GPU agree
+    grads[1].TransferToDeviceIfNotThere(CPUDEVICE, true);
+    BOOST_CHECK(grads[0].IsEqualTo(grads[1], c_epsilonFloatE4));
+}
+
+BOOST_FIXTURE_TEST_CASE(MatrixRCRFBatched, RandomSeedFixture)
+{
+    // two parallel sequences of 6 time steps; the second one holds two sequences with a gap at t=2
+    const size_t numLab = 5, S = 2, T = 6;
+    const std::vector<CRFSequence> sequences = { { 0, 0, 6 }, { 1, 0, 2 }, { 1, 3, 3 } };
+    std::vector<float> lblsData(numLab * S * T, 0.0f);
+    std::vector<bool> isGap(S * T, true);
+    for (const auto& seq : sequences)
+        for (int t = seq.tBegin; t < seq.tBegin + seq.numFrames; t++)
+        {
+            size_t j = t * S + seq.s;
+            lblsData[j * numLab + (j * 3 + 1) % numLab] = 1.0f;
+            isGap[j] = false;
+        }
+
+    SingleMatrix posScores = SingleMatrix::RandomUniform(numLab, S * T, CPUDEVICE, -2.0f, 2.0f, IncrementCounter());
+    SingleMatrix pairScores = SingleMatrix::RandomUniform(numLab, numLab, CPUDEVICE, -1.0f, 1.0f, IncrementCounter());
+
+    std::vector<SingleMatrix> betas, objectives, paths;
+    for (auto deviceId : {CPUDEVICE, c_deviceIdZero})
+    {
+        SingleMatrix lbls(numLab, S * T, lblsData.data(), deviceId);
+        SingleMatrix pos(posScores.DeepClone()), pair(pairScores.DeepClone());
+        pos.TransferToDeviceIfNotThere(deviceId, true);
+        pair.TransferToDeviceIfNotThere(deviceId, true);
+        SingleMatrix alpha(deviceId), beta(deviceId), objective(deviceId), path(deviceId);
+        SingleMatrix::RCRFForwardBackward(lbls, pos, pair, sequences, S, alpha, beta, objective);
+        SingleMatrix::RCRFViterbiDecode(lbls, pos, pair, sequences, S, path);
+
+        BOOST_CHECK_EQUAL(objective.GetNumCols(), sequences.size());
+        for (size_t j = 0; j < S * T; j++)
+        {
+            // posteriors and decoded path are distributions over the labels, 0 in gaps
+            float posteriorSum = 0, pathSum = 0;
+            for (size_t k = 0; k < numLab; k++)
+            {
+                posteriorSum += exp(beta(k, j));
+                pathSum += path(k, j);
+            }
+            BOOST_CHECK_CLOSE(posteriorSum, isGap[j] ? 0.0f : 1.0f, 0.01f);
+            BOOST_CHECK_EQUAL(pathSum, isGap[j] ? 0.0f : 1.0f);
+        }
+        betas.push_back(beta.DeepClone());
+        objectives.push_back(objective.DeepClone());
+        paths.push_back(path.DeepClone());
+    }
+
+    // CPU and GPU agree
+    betas[1].TransferToDeviceIfNotThere(CPUDEVICE, true);
+    objectives[1].TransferToDeviceIfNotThere(CPUDEVICE, true);
+    paths[1].TransferToDeviceIfNotThere(CPUDEVICE, true);
+    BOOST_CHECK(betas[0].IsEqualTo(betas[1], c_epsilonFloatE4));
+    BOOST_CHECK(objectives[0].IsEqualTo(objectives[1], c_epsilonFloatE4));
+    BOOST_CHECK(paths[0].IsEqualTo(paths[1]));
+}
+
+BOOST_FIXTURE_TEST_CASE(MatrixMultiClipByNorm, RandomSeedFixture)
+{
+    // one gradient above the threshold, one below, and one larger than a block of the GPU kernels
+    const std::vector<std::pair<size_t, size_t>> shapes = { { 30, 20 }, { 7, 1 }, { 300, 40 } };
+    const std::vector<float> ranges = { 1.0f, 0.01f, 0.1f };
+    std::vector<SingleMatrix> originals;
+    for (size_t i = 0; i < shapes.size(); i++)
+        originals.push_back(SingleMatrix::RandomUniform(shapes[i].first, shapes[i].second, CPUDEVICE, -ranges[i], ranges[i], IncrementCounter()));
+    const float maxNorm = 2.0f;
+
+    for (bool globalNorm : { false, true })
+    {
+        std::vector<float> norms;
+        for (const auto& original : originals)
+            norms.push_back(original.FrobeniusNorm());
+        if (globalNorm)
+        {
+            float sumOfSquares = 0;
+            for (auto norm : norms)
+                sumOfSquares += norm * norm;
+            norms.assign(originals.size(), sqrt(sumOfSquares));
+        }
+
+        for (auto deviceId : { CPUDEVICE, c_deviceIdZero })
+        {
+            std::vector<SingleMatrix> gradients;
+            std::vector<SingleMatrix*> gradientPointers;
+            for (const auto& original : originals)
+            {
+                gradients.push_back(original.DeepClone());
+                gradients.back().TransferToDeviceIfNotThere(deviceId, true);
+            }
+            for (auto& gradient : gradients)
+                gradientPointers.push_back(&gradient);
+
+            SingleMatrix factors(deviceId);
+            SingleMatrix::MultiClipByNorm(gradientPointers, maxNorm, globalNorm, factors);
+
+            factors.TransferToDeviceIfNotThere(CPUDEVICE, true);
+            BOOST_CHECK_EQUAL(factors.GetNumElements(), globalNorm ? 1 : originals.size());
+            for (size_t i = 0; i < originals.size(); i++)
+            {
+                float factor = norms[i] > maxNorm ? maxNorm / norms[i] : 1.0f;
+                BOOST_CHECK_CLOSE(factors(0, globalNorm ? 0 : i), factor, 0.01f);
+
+                SingleMatrix expected(originals[i].DeepClone());
+                expected *= factor;
+                gradients[i].TransferToDeviceIfNotThere(CPUDEVICE, true);
+                BOOST_CHECK(gradients[i].IsEqualTo(expected, c_epsilonFloatE4));
+            }
+        }
+    }
+}
 BOOST_AUTO_TEST_SUITE_END()
 }
 } } }
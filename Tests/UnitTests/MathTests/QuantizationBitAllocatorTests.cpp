@@ -0,0 +1,71 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE.md file in the project root for full license information.
+//
+#include "stdafx.h"
+#include "../../../Source/Math/QuantizationBitAllocator.h"
+
+using namespace Microsoft::MSR::CNTK;
+namespace Microsoft { namespace MSR { namespace CNTK { namespace Test {
+
+BOOST_AUTO_TEST_SUITE(QuantizationBitAllocatorUnitTests)
+
+BOOST_AUTO_TEST_CASE(ErrorsBelowTarget)
+{
+    QuantizationBitAllocator allocator(4, 0.25);
+    auto bits = allocator.Allocate({ 100, 1000 }, { 1, 1 }, { 0.2, 0.1 });
+    BOOST_CHECK(bits == std::vector<size_t>({ 1, 1 }));
+}
+
+BOOST_AUTO_TEST_CASE(SmallGradientsFirst)
+{
+    // the small gradient reaches the target with 4 bits for 30 more bits, the large one would need 990 of the 100 of the budget
+    QuantizationBitAllocator allocator(1.1, 0.25);
+    auto bits = allocator.Allocate({ 10, 990 }, { 1, 1 }, { 0.8, 0.5 });
+    BOOST_CHECK(bits == std::vector<size_t>({ 4, 1 }));
+}
+
+BOOST_AUTO_TEST_CASE(LargestErrorFirst)
+{
+    // the budget allows 1 more bit per entry for one of two gradients of the same size
+    QuantizationBitAllocator allocator(1.5, 0.1);
+    auto bits = allocator.Allocate({ 500, 500 }, { 1, 1 }, { 0.3, 0.6 });
+    BOOST_CHECK(bits == std::vector<size_t>({ 1, 2 }));
+}
+
+BOOST_AUTO_TEST_CASE(ErrorsMeasuredWithMoreBits)
+{
+    // 0.01 measured with 8 bits is estimated as 1.28 with 1 bit, 0.32 with 4 and 0.16 with 8
+    QuantizationBitAllocator allocator(8, 0.25);
+    BOOST_CHECK(allocator.Allocate({ 100 }, { 8 }, { 0.01 }) == std::vector<size_t>({ 8 }));
+    QuantizationBitAllocator looserAllocator(8, 0.4);
+    BOOST_CHECK(looserAllocator.Allocate({ 100 }, { 8 }, { 0.01 }) == std::vector<size_t>({ 4 }));
+    BOOST_CHECK_CLOSE(QuantizationBitAllocator::EstimateError(0.01, 8, 1), 1.28, 1e-9);
+}
+
+BOOST_AUTO_TEST_CASE(BudgetIsKept)
+{
+    QuantizationBitAllocator allocator(2, 0);
+    std::vector<size_t> numElements = { 3, 70, 512, 1000, 1, 20000 };
+    auto bits = allocator.Allocate(numElements, std::vector<size_t>(numElements.size(), 2), { 0.5, 0.9, 0.1, 0.3, 0.2, 0.7 });
+    double totalBits = 0, totalElements = 0;
+    for (size_t i = 0; i < bits.size(); i++)
+    {
+        BOOST_CHECK(bits[i] == 1 || bits[i] == 2 || bits[i] == 4 || bits[i] == 8);
+        totalBits += (double) bits[i] * numElements[i];
+        totalElements += (double) numElements[i];
+    }
+    BOOST_CHECK(totalBits <= 2 * totalElements);
+}
+
+BOOST_AUTO_TEST_CASE(InvalidArguments)
+{
+    BOOST_CHECK_THROW(QuantizationBitAllocator(0.5, 0.1), std::invalid_argument);
+    BOOST_CHECK_THROW(QuantizationBitAllocator(2, -1), std::invalid_argument);
+    QuantizationBitAllocator allocator(2, 0.1);
+    BOOST_CHECK_THROW(allocator.Allocate({ 10, 20 }, { 1 }, { 0.1, 0.2 }), std::logic_error);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
+
+} } } }
@@ -5,6 +5,7 @@
 #include "stdafx.h"
 #include "../../../Source/Math/QuantizedOperations.h"
 #include "../../../Source/Math/Helpers.h"
+#include <random>
 
 using namespace Microsoft::MSR::CNTK;
 namespace Microsoft { namespace MSR { namespace CNTK { namespace Test {
@@ -50,6 +51,43 @@ BOOST_FIXTURE_TEST_CASE(MultiplyIntToShort, RandomSeedFixture)
         BOOST_CHECK_EQUAL(round(C_upd[i]), C_expected_upd[i]);
 }
 
+// Products by BlockMultiplier (bit shifts of 2 keep the quantized values within its range) for sizes that take all
+// of its block sizes, with the constant A prepared ahead of the product as at model load
+BOOST_FIXTURE_TEST_CASE(MultiplyBlockPrepared, RandomSeedFixture)
+{
+    std::mt19937 rng(0);
+    std::uniform_real_distribution<float> dist(-1, 1);
+    int dims[][3] = { { 512, 1, 384 }, { 300, 7, 128 + 64 + 32 + 16 + 8 + 3 }, { 64, 16, 256 } };
+    for (auto& dim : dims)
+    {
+        int m = dim[0], n = dim[1], k = dim[2];
+        std::vector<float> A(m*k), B(k*n), C(m*n);
+        for (auto& a : A)
+            a = dist(rng);
+        for (auto& b : B)
+            b = dist(rng);
+
+        shared_ptr<QuantizerBase<float, short>> quantA(new SymmetricQuantizer<float, short>(2));
+        shared_ptr<QuantizerBase<float, short>> quantB(new SymmetricQuantizer<float, short>(2));
+        QuantizedMultiplier<float> mult(quantA, true, quantB, false);
+        BOOST_CHECK(mult.UsesBlockProduct());
+        mult.PrepareConstantA(m, k, A.data());
+
+        for (int pass = 0; pass < 2; pass++)
+        {
+            mult.Multiply(m, n, k, A.data(), B.data(), C.data());
+            for (int j = 0; j < n; j++)
+                for (int i = 0; i < m; i++)
+                {
+                    double expected = 0;
+                    for (int l = 0; l < k; l++)
+                        expected += A[i + l*m] * B[l + k*j];
+                    // each operand is off by at most half a quantization step of 2^-13
+                    BOOST_CHECK_SMALL(C[i + j*m] - expected, k * 1.25e-4);
+                }
+        }
+    }
+}
 
 BOOST_AUTO_TEST_SUITE_END()
 
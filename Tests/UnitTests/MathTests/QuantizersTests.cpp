@@ -75,6 +75,35 @@ BOOST_FIXTURE_TEST_CASE(QuantizeZeros, RandomSeedFixture)
     delete[] outputFloat;
 }
 
+BOOST_FIXTURE_TEST_CASE(CalibratedRangeClips, RandomSeedFixture)
+{
+    float input[4] = { -20.0f, -1.0f, 2.0f, 8.0f };
+    short output[4] = { 0, 0, 0, 0 };
+
+    // values beyond the calibrated max of 5 are clipped, the others are scaled as if 5 was the absolute max
+    short outputCorrect[4] = { -32767, -6553, 13107, 32767 };
+
+    ArrayRef<float> inputAr(input, 4);
+    ArrayRef<short> outputAr(output, 4);
+
+    SymmetricQuantizer<float, short> symQuant(0, 5.0f);
+    symQuant.Quantize(inputAr, outputAr);
+    for (size_t i = 0; i < 4; i++)
+    {
+        BOOST_CHECK_EQUAL(output[i], outputCorrect[i]);
+        BOOST_CHECK(abs(output[i]) <= symQuant.MaxQuantizedMagnitude());
+    }
+
+    float dequantized[4];
+    float outputFloat[4];
+    for (size_t i = 0; i < 4; i++)
+        outputFloat[i] = (float)output[i];
+    symQuant.Dequantize(outputFloat, dequantized, 4);
+    BOOST_CHECK_CLOSE(dequantized[0], -5.0f, 0.01f);
+    BOOST_CHECK_CLOSE(dequantized[2], 2.0f, 0.01f);
+    BOOST_CHECK_CLOSE(dequantized[3], 5.0f, 0.01f);
+}
+
 BOOST_AUTO_TEST_SUITE_END()
 
 } } } }
\ No newline at end of file
@@ -85,6 +85,39 @@ BOOST_AUTO_TEST_CASE(BiasGradient2)
     });
 }
 
+BOOST_AUTO_TEST_CASE(ReduceInnerAxis)
+{
+    Test::TensorTest<float> tensorTester;
+
+    // contiguous segments, e.g. ReduceMax over the feature axis
+    tensorTester.OneTensorTest("max over inner axis (reduction)", 1e-8, [&tensorTester](DEVICEID_TYPE deviceId)
+    {
+        return tensorTester.ReductionTest(TensorShape{ 1000, 300 }, TensorShape{ 1, 300 }, ElementWiseOperator::opMax, deviceId);
+    });
+}
+
+BOOST_AUTO_TEST_CASE(ReduceMiddleAxis)
+{
+    Test::TensorTest<float> tensorTester;
+
+    // strided segments whose results are adjacent in memory
+    tensorTester.OneTensorTest("log-sum over middle axis (reduction)", 1e-4, [&tensorTester](DEVICEID_TYPE deviceId)
+    {
+        return tensorTester.ReductionTest(TensorShape{ 200, 3000, 2 }, TensorShape{ 200, 1, 2 }, ElementWiseOperator::opLogSum, deviceId);
+    });
+}
+
+BOOST_AUTO_TEST_CASE(ReduceAllAxes)
+{
+    Test::TensorTest<float> tensorTester;
+
+    // a single huge segment, e.g. aggregating a criterion
+    tensorTester.OneTensorTest("sum over all axes (reduction)", 1e-1, [&tensorTester](DEVICEID_TYPE deviceId)
+    {
+        return tensorTester.ReductionTest(TensorShape{ 1024, 1024 }, TensorShape{ 1, 1 }, ElementWiseOperator::opSum, deviceId);
+    });
+}
+
 BOOST_AUTO_TEST_CASE(ColumnSliceMultAndAdd)
 {
     ColumnSliceMultAndAddTest<float>(2048, 2048, 256, 0);
@@ -100,6 +133,29 @@ BOOST_AUTO_TEST_CASE(OldRnnForwardProp)
     TestOldRnnForwardPropSRP<float>();
 }
 
+BOOST_AUTO_TEST_CASE(MatrixProductOfTransposedView)
+{
+    // the swapped view of a dense matrix is multiplied by GEMM with the opposite transposition flag instead of being copied
+    const DEVICEID_TYPE deviceId = CPUDEVICE;
+    auto w = make_shared<Matrix<float>>(Matrix<float>::RandomUniform(3, 4, deviceId, -1, 1, 1));
+    auto x = make_shared<Matrix<float>>(Matrix<float>::RandomUniform(3, 5, deviceId, -1, 1, 2));
+    auto y = make_shared<Matrix<float>>(4, 5, deviceId);
+    TensorShape wTransposedShape(3, 4);
+    wTransposedShape.SwapDimsInPlace(0, 1);
+    TensorView<float>(y, TensorShape(4, 5)).AssignMatrixProductOf(false, TensorView<float>(w, wTransposedShape), false, TensorView<float>(x, TensorShape(3, 5)), false);
+
+    Matrix<float> expected(deviceId);
+    Matrix<float>::Multiply(*w, true, *x, false, expected);
+    BOOST_CHECK(y->IsEqualTo(expected, 1e-5f));
+
+    // and as the output: the gradient of W = x * dy'
+    auto wGradient = make_shared<Matrix<float>>(Matrix<float>::Zeros(3, 4, deviceId));
+    TensorView<float>(wGradient, wTransposedShape).AssignMatrixProductOf(false, TensorView<float>(y, TensorShape(4, 5)), false, TensorView<float>(x, TensorShape(3, 5)), true);
+
+    Matrix<float>::Multiply(*x, false, *y, true, expected);
+    BOOST_CHECK(wGradient->IsEqualTo(expected, 1e-5f));
+}
+
 BOOST_AUTO_TEST_SUITE_END()
 
 }}}}
@@ -75,6 +75,16 @@ struct TensorTest
         return bias;
     }
 
+    // test reduction over the axes where resultShape is 1, as done by ReduceElementsNode
+    TensorView<ElemType> ReductionTest(TensorShape inputShape, TensorShape resultShape, ElementWiseOperator reductionOp, DEVICEID_TYPE deviceId)
+    {
+        int randomSeed = 1;
+        let  input = CreateTensor(inputShape, randomSeed++, deviceId);
+        auto result = CreateTensor(resultShape, randomSeed++, deviceId, true);
+        result.DoUnaryOpOf(0, input, 1, ElementWiseOperator::opCopy, reductionOp);
+        return result;
+    }
+
     // test broadcast summation gradient
     TensorView<ElemType> BroadcastingTest(TensorShape layerShape, TensorShape biasShape, DEVICEID_TYPE deviceId)
     {
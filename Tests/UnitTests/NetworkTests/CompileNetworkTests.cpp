@@ -0,0 +1,99 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE.md file in the project root for full license information.
+//
+
+#include "stdafx.h"
+
+#include "../../../Source/ComputationNetworkLib/ComputationNetwork.h"
+#include "../../../Source/ComputationNetworkLib/ComputationNetworkBuilder.h"
+#include "../../../Source/ComputationNetworkLib/RecurrentNodes.h"
+#include <chrono>
+#include <memory>
+#include <unordered_map>
+
+using namespace Microsoft::MSR::CNTK;
+using namespace std;
+
+namespace Microsoft { namespace MSR { namespace CNTK { namespace Test {
+
+// We perform test on CPU.
+const DEVICEID_TYPE c_deviceId = CPUDEVICE;
+
+// Builds a network like an unrolled one: a deep chain of Plus nodes over an input, which passes through a small
+// recurrent loop after every 'loopSpacing'-th node. The last node of the chain is the output.
+template <class ElemType>
+ComputationNetworkPtr CreateDeepNetwork(size_t chainLength, size_t loopSpacing, vector<ComputationNodeBasePtr>& loopNodes)
+{
+    auto net = make_shared<ComputationNetwork>(c_deviceId);
+    ComputationNetworkBuilder<ElemType> builder(*net);
+
+    const size_t dim = 4;
+    auto input = builder.CreateInputNode(L"features", dim);
+    auto bias = builder.CreateLearnableParameter(L"bias", dim, 1);
+    auto h = input;
+    for (size_t i = 0; i < chainLength; i++)
+    {
+        h = builder.Plus(h, bias, msra::strfun::wstrprintf(L"h%d", (int)i));
+        if (i % loopSpacing == 0)
+        {
+            auto pastValue = builder.PastValue(nullptr, 0.1f, dim, 1, msra::strfun::wstrprintf(L"pastValue%d", (int)i));
+            auto state = builder.Plus(pastValue, h, msra::strfun::wstrprintf(L"state%d", (int)i));
+            pastValue->AttachInputs({ state });
+            loopNodes.push_back(pastValue);
+            loopNodes.push_back(state);
+            h = state;
+        }
+    }
+    net->AddToNodeGroup(L"output", h);
+    return net;
+}
+
+BOOST_AUTO_TEST_SUITE(CompileNetworkSuite)
+
+// Compiles a deep network, and verifies the loops, the evaluation orders and the inferred dimensions.
+// The network is deeper than a recursive traversal could handle on a typical call stack.
+BOOST_AUTO_TEST_CASE(CompileDeepNetwork)
+{
+    const size_t chainLength = 100000;
+    const size_t loopSpacing = 100;
+    vector<ComputationNodeBasePtr> loopNodes;
+    auto net = CreateDeepNetwork<float>(chainLength, loopSpacing, loopNodes);
+    net->SetTraceLevel(0);
+
+    auto start = chrono::steady_clock::now();
+    net->CompileNetwork();
+    double seconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+    fprintf(stderr, "CompileDeepNetwork: Compiled a network of %d nodes in %.3f seconds.\n", (int)net->GetTotalNumberOfNodes(), seconds);
+
+    BOOST_CHECK_EQUAL(net->GetTotalNumberOfNodes(), 2 + chainLength + loopNodes.size());
+    for (const auto& node : loopNodes)
+        BOOST_CHECK(node->IsPartOfLoop());
+    BOOST_CHECK(!net->GetNodeFromName(L"h1")->IsPartOfLoop());
+
+    // every node comes after its inputs, except for the inputs of delay nodes
+    BOOST_REQUIRE_EQUAL(net->OutputNodes().size(), 1);
+    const auto& root = net->OutputNodes().front();
+    const auto& evalOrder = net->GetEvalOrder(root);
+    BOOST_CHECK_EQUAL(evalOrder.size(), net->GetTotalNumberOfNodes());
+    unordered_map<ComputationNodeBasePtr, size_t> positions;
+    for (const auto& node : evalOrder)
+    {
+        size_t position = positions.size();
+        positions[node] = position;
+    }
+    for (const auto& node : evalOrder)
+    {
+        if (node->OperationName() == OperationNameOf(PastValueNode))
+            continue;
+        for (const auto& input : node->GetInputs())
+            BOOST_REQUIRE(positions.at(input) < positions.at(node));
+    }
+
+    BOOST_CHECK_EQUAL(root->GetSampleLayout().GetNumElements(), (size_t)4);
+    BOOST_CHECK(root->HasMBLayout());
+}
+
+BOOST_AUTO_TEST_SUITE_END()
+
+}}}}
@@ -0,0 +1,198 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE.md file in the project root for full license information.
+//
+
+#include "stdafx.h"
+
+#include "../../../Source/ComputationNetworkLib/MatrixPool.h"
+#include <memory>
+
+using namespace Microsoft::MSR::CNTK;
+using namespace std;
+
+namespace Microsoft { namespace MSR { namespace CNTK { namespace Test {
+
+// We perform test on CPU.
+const DEVICEID_TYPE c_deviceId = CPUDEVICE;
+
+template <class ElemType>
+void MatrixPoolPlanningBestFitTestImpl()
+{
+    MatrixPool pool;
+    pool.SetPolicy(MemorySharingPolicy::SizeAware);
+
+    shared_ptr<Matrix<ElemType>> large, small, large2, small2;
+
+    // 'large' and 'small' are alive at the same time; once both are released,
+    // 'small2' must go into the small buffer and 'large2' into the large one.
+    pool.Request<ElemType>(c_deviceId, &large, 1000);
+    pool.Request<ElemType>(c_deviceId, &small, 10);
+    pool.Release<ElemType>(&large);
+    pool.Release<ElemType>(&small);
+    pool.Request<ElemType>(c_deviceId, &small2, 8);
+    pool.Request<ElemType>(c_deviceId, &large2, 900);
+
+    pool.OptimizedMemoryAllocation();
+
+    BOOST_CHECK(large != small);
+    BOOST_CHECK(large2 == large);
+    BOOST_CHECK(small2 == small);
+
+    const auto& stats = pool.GetAllocationPlanStatistics();
+    BOOST_CHECK_EQUAL(stats.m_numRequests, 4);
+    BOOST_CHECK_EQUAL(stats.m_numBuffers, 2);
+    BOOST_CHECK_EQUAL(stats.m_plannedPeakBytes, (1000 + 10) * sizeof(ElemType));
+    BOOST_CHECK_EQUAL(stats.m_allocatedBytes, (1000 + 10) * sizeof(ElemType));
+}
+
+template <class ElemType>
+void MatrixPoolPlanningOverlappingLifetimesTestImpl()
+{
+    MatrixPool pool;
+    pool.SetPolicy(MemorySharingPolicy::SizeAware);
+
+    shared_ptr<Matrix<ElemType>> a, b, c;
+
+    // 'a' is never released, so nothing may share with it.
+    pool.Request<ElemType>(c_deviceId, &a, 100);
+    pool.Request<ElemType>(c_deviceId, &b, 100);
+    pool.Release<ElemType>(&b);
+    pool.Request<ElemType>(c_deviceId, &c, 50);
+
+    pool.OptimizedMemoryAllocation();
+
+    BOOST_CHECK(a != b);
+    BOOST_CHECK(a != c);
+    BOOST_CHECK(b == c);
+}
+
+template <class ElemType>
+void MatrixPoolPlanningRecomputeTestImpl()
+{
+    MatrixPool pool;
+    pool.SetPolicy(MemorySharingPolicy::SizeAware);
+
+    shared_ptr<Matrix<ElemType>> a, b;
+
+    // 'a' is released after forward and recomputed while 'b' is still alive,
+    // so the two must not share although their first lifetimes do not overlap.
+    pool.Request<ElemType>(c_deviceId, &a, 100);
+    pool.Release<ElemType>(&a);
+    pool.Request<ElemType>(c_deviceId, &b, 100);
+    pool.RequestForRecompute<ElemType>(&a);
+    pool.Release<ElemType>(&b);
+    pool.Release<ElemType>(&a);
+
+    pool.OptimizedMemoryAllocation();
+
+    BOOST_CHECK(a != b);
+
+    const auto& report = pool.GetMemoryReport();
+    BOOST_REQUIRE_EQUAL(report.size(), 2);
+    BOOST_CHECK_EQUAL(report[0].m_recomputeAllocStep, 3);
+    BOOST_CHECK_EQUAL(report[0].m_recomputeReleaseStep, 5);
+    BOOST_CHECK_EQUAL(report[1].m_recomputeAllocStep, SIZE_MAX);
+    BOOST_CHECK_EQUAL(pool.GetAllocationPlanStatistics().m_plannedPeakBytes, 200 * sizeof(ElemType));
+}
+
+template <class ElemType>
+void MatrixPoolSharingPolicyTestImpl(MemorySharingPolicy policy, bool expectShared)
+{
+    MatrixPool pool;
+    pool.SetPolicy(policy);
+
+    shared_ptr<Matrix<ElemType>> a, b;
+    pool.Request<ElemType>(c_deviceId, &a, 10, true, L"A", L"value");
+    pool.Release<ElemType>(&a);
+    pool.Request<ElemType>(c_deviceId, &b, 10, true, L"B", L"value");
+
+    pool.OptimizedMemoryAllocation();
+
+    BOOST_CHECK_EQUAL(a == b, expectShared);
+
+    const auto& report = pool.GetMemoryReport();
+    BOOST_REQUIRE_EQUAL(report.size(), 2);
+    BOOST_CHECK(report[0].m_nodeName == L"A");
+    BOOST_CHECK_EQUAL(report[0].m_allocStep, 0);
+    BOOST_CHECK_EQUAL(report[0].m_releaseStep, 1);
+    BOOST_CHECK_EQUAL(report[1].m_releaseStep, SIZE_MAX);
+    BOOST_CHECK_EQUAL(report[0].m_bufferId == report[1].m_bufferId, expectShared);
+    BOOST_CHECK(pool.GetBuffer(report[0].m_bufferId) == a.get());
+    BOOST_CHECK(pool.GetBuffer(report[1].m_bufferId) == b.get());
+}
+
+template <class ElemType>
+void MatrixPoolInPlaceTestImpl(MemorySharingPolicy policy)
+{
+    MatrixPool pool;
+    pool.SetPolicy(policy);
+
+    shared_ptr<Matrix<ElemType>> a, b, c, d;
+
+    // 'b' is computed in place over 'a'. Releasing 'a' afterwards must not free the matrix,
+    // so 'c' gets its own, while 'd' can reuse it once 'b' is released.
+    pool.Request<ElemType>(c_deviceId, &a, 10, true, L"A", L"value");
+    BOOST_REQUIRE(pool.RequestInPlace<ElemType>(&b, &a, L"B", L"value"));
+    pool.Release<ElemType>(&a);
+    pool.Request<ElemType>(c_deviceId, &c, 10, true, L"C", L"value");
+    pool.Release<ElemType>(&b);
+    pool.Request<ElemType>(c_deviceId, &d, 10, true, L"D", L"value");
+
+    pool.OptimizedMemoryAllocation();
+
+    BOOST_CHECK(a == b);
+    BOOST_CHECK(c != b);
+    BOOST_CHECK(d == b);
+
+    const auto& report = pool.GetMemoryReport();
+    BOOST_REQUIRE_EQUAL(report.size(), 4);
+    BOOST_CHECK(report[0].m_nodeName == L"A");
+    BOOST_CHECK(report[1].m_nodeName == L"B");
+    BOOST_CHECK_EQUAL(report[0].m_bufferId, report[1].m_bufferId);
+    BOOST_CHECK_EQUAL(report[1].m_releaseStep, 2);
+    BOOST_CHECK_EQUAL(pool.GetAllocationPlanStatistics().m_numRequests, 3);
+}
+
+BOOST_AUTO_TEST_SUITE(MatrixPoolTestSuite)
+
+BOOST_AUTO_TEST_CASE(MatrixPoolPlanningBestFitTest)
+{
+    MatrixPoolPlanningBestFitTestImpl<float>();
+    MatrixPoolPlanningBestFitTestImpl<double>();
+}
+
+BOOST_AUTO_TEST_CASE(MatrixPoolPlanningOverlappingLifetimesTest)
+{
+    MatrixPoolPlanningOverlappingLifetimesTestImpl<float>();
+    MatrixPoolPlanningOverlappingLifetimesTestImpl<double>();
+}
+
+BOOST_AUTO_TEST_CASE(MatrixPoolPlanningRecomputeTest)
+{
+    MatrixPoolPlanningRecomputeTestImpl<float>();
+    MatrixPoolPlanningRecomputeTestImpl<double>();
+}
+
+BOOST_AUTO_TEST_CASE(MatrixPoolSharingPolicyTest)
+{
+    MatrixPoolSharingPolicyTestImpl<float>(MemorySharingPolicy::Off, false);
+    MatrixPoolSharingPolicyTestImpl<float>(MemorySharingPolicy::LIFO, true);
+    MatrixPoolSharingPolicyTestImpl<double>(MemorySharingPolicy::SizeAware, true);
+}
+
+BOOST_AUTO_TEST_CASE(MatrixPoolInPlaceTest)
+{
+    MatrixPoolInPlaceTestImpl<float>(MemorySharingPolicy::LIFO);
+    MatrixPoolInPlaceTestImpl<double>(MemorySharingPolicy::SizeAware);
+
+    MatrixPool pool;
+    pool.SetPolicy(MemorySharingPolicy::Off);
+    shared_ptr<Matrix<float>> a, b;
+    pool.Request<float>(c_deviceId, &a, 10);
+    BOOST_CHECK(!pool.RequestInPlace<float>(&b, &a));
+    BOOST_CHECK(b == nullptr);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
+} } } }
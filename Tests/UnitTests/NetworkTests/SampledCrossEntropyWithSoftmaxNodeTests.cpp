@@ -0,0 +1,155 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE.md file in the project root for full license information.
+//
+
+#include "stdafx.h"
+
+#include "../../../Source/ComputationNetworkLib/TrainingNodes.h"
+#include "TestHelpers.h"
+#include <memory>
+#include <random>
+
+using namespace Microsoft::MSR::CNTK;
+using namespace std;
+
+namespace Microsoft { namespace MSR { namespace CNTK { namespace Test {
+
+// We perform test on CPU.
+const DEVICEID_TYPE c_deviceId = CPUDEVICE;
+
+// Extends the node to allocate its temporary matrices, which is done by the matrix pool in a network,
+// and to draw the same classes in every pass.
+template <class ElemType>
+class SampledCrossEntropyWithSoftmaxNodeTest : public SampledCrossEntropyWithSoftmaxNode<ElemType>
+{
+public:
+    SampledCrossEntropyWithSoftmaxNodeTest(size_t sizeOfSampledSet)
+        : SampledCrossEntropyWithSoftmaxNode<ElemType>(c_deviceId, L"SampledCrossEntropyWithSoftmaxNodeTest", sizeOfSampledSet)
+    {
+    }
+
+    ElemType ForwardPass()
+    {
+        this->CreateValueMatrixIfNull();
+        this->CreateGradientMatrixIfNull();
+        for (auto matrix : { &this->m_sampledWeights, &this->m_labelWeights, &this->m_logits, &this->m_logSumExp, &this->m_mask, &this->m_logitsGradient, &this->m_weightsGradient })
+            this->CreateMatrixIfNull(*matrix);
+        this->Value().Resize(1, 1);
+        this->SetRngState(/*seed=*/1);
+        this->ForwardPropNonLooping();
+        return this->Value().GetValue(0, 0);
+    }
+
+    void BackwardPass()
+    {
+        this->Gradient().Resize(1, 1);
+        this->Gradient().SetValue(1);
+        this->BackpropToNonLooping(1);
+        this->BackpropToNonLooping(2);
+    }
+
+    const Matrix<ElemType>& GetSampledClasses() const { return *this->m_sampledClasses; }
+};
+
+// Extends learnable parameter to provide access to its gradient.
+template <class ElemType>
+class ParameterNodeTest : public LearnableParameter<ElemType>
+{
+public:
+    ParameterNodeTest(size_t rows, size_t cols)
+        : LearnableParameter<ElemType>(c_deviceId, L"ParameterNodeTest", TensorShape(rows, cols))
+    {
+    }
+
+    void SetData(const vector<ElemType>& data)
+    {
+        this->Value().SetValue(this->GetSampleMatrixNumRows(), this->GetSampleMatrixNumCols(), c_deviceId, const_cast<ElemType*>(data.data()));
+        this->CreateGradientMatrixIfNull();
+        this->Gradient().Resize(this->GetSampleMatrixNumRows(), this->GetSampleMatrixNumCols());
+    }
+
+    Matrix<ElemType>& GetGradient() { return this->Gradient(); }
+};
+
+BOOST_AUTO_TEST_SUITE(SampledCrossEntropyWithSoftmaxNodeSuite)
+
+// Compares the gradients w.r.t. the hidden input and the weights to finite differences of the loss with the same
+// sampled classes, and checks that only the columns of the weights of the labels and the sampled classes get a gradient.
+BOOST_AUTO_TEST_CASE(SampledCrossEntropyWithSoftmaxGradient)
+{
+    const size_t numClasses = 20;
+    const size_t hiddenDim = 3;
+    const size_t minibatchSize = 4;
+    const size_t sizeOfSampledSet = 5;
+
+    std::mt19937 generator(0);
+    std::uniform_real_distribution<double> uniform(-1, 1);
+    vector<double> labelData(numClasses * minibatchSize, 0);
+    for (size_t t = 0; t < minibatchSize; t++)
+        labelData[t * numClasses + 2 * t] = 1;
+    vector<double> hiddenData(hiddenDim * minibatchSize), weightData(hiddenDim * numClasses), samplingWeightData(numClasses);
+    for (auto& x : hiddenData)
+        x = uniform(generator);
+    for (auto& x : weightData)
+        x = uniform(generator);
+    for (size_t i = 0; i < numClasses; i++)
+        samplingWeightData[i] = 1.0 / (i + 1);
+
+    auto labels = make_shared<DummyNodeTest<double>>(c_deviceId, minibatchSize, SmallVector<size_t>{numClasses}, labelData);
+    auto hidden = make_shared<DummyNodeTest<double>>(c_deviceId, minibatchSize, SmallVector<size_t>{hiddenDim}, hiddenData);
+    auto weights = make_shared<ParameterNodeTest<double>>(hiddenDim, numClasses);
+    auto samplingWeights = make_shared<ParameterNodeTest<double>>(numClasses, 1);
+    auto node = make_shared<SampledCrossEntropyWithSoftmaxNodeTest<double>>(sizeOfSampledSet);
+    node->AttachInputs({ labels, hidden, weights, samplingWeights });
+    node->Validate(/*isFinalValidationPass=*/true);
+    weights->SetData(weightData);
+    samplingWeights->SetData(samplingWeightData);
+
+    BOOST_REQUIRE(node->ForwardPass() > 0);
+    hidden->GetGradient().SetValue(0);
+    weights->GetGradient().SetValue(0);
+    node->BackwardPass();
+
+    const double epsilon = 1e-5;
+    for (size_t j = 0; j < minibatchSize; j++)
+    {
+        for (size_t i = 0; i < hiddenDim; i++)
+        {
+            const double x = hidden->Value().GetValue(i, j);
+            hidden->Value().SetValue(i, j, x + epsilon);
+            const double lossPlus = node->ForwardPass();
+            hidden->Value().SetValue(i, j, x - epsilon);
+            const double lossMinus = node->ForwardPass();
+            hidden->Value().SetValue(i, j, x);
+            BOOST_CHECK_SMALL(hidden->GetGradient().GetValue(i, j) - (lossPlus - lossMinus) / (2 * epsilon), 1e-6);
+        }
+    }
+
+    vector<bool> hasGradient(numClasses, false);
+    for (size_t t = 0; t < minibatchSize; t++)
+        hasGradient[2 * t] = true;
+    const auto& sampledClasses = node->GetSampledClasses();
+    for (size_t k = 0; k < sampledClasses.GetNumCols(); k++)
+        hasGradient[(size_t) sampledClasses.GetValue(0, k)] = true;
+    for (size_t j = 0; j < numClasses; j++)
+    {
+        for (size_t i = 0; i < hiddenDim; i++)
+        {
+            const double w = weights->Value().GetValue(i, j);
+            weights->Value().SetValue(i, j, w + epsilon);
+            const double lossPlus = node->ForwardPass();
+            weights->Value().SetValue(i, j, w - epsilon);
+            const double lossMinus = node->ForwardPass();
+            weights->Value().SetValue(i, j, w);
+            if (hasGradient[j])
+                BOOST_CHECK_SMALL(weights->GetGradient().GetValue(i, j) - (lossPlus - lossMinus) / (2 * epsilon), 1e-6);
+            else
+                BOOST_CHECK_EQUAL(weights->GetGradient().GetValue(i, j), 0);
+        }
+    }
+}
+
+BOOST_AUTO_TEST_SUITE_END()
+
+}}}}
@@ -6,6 +6,8 @@
 #include <algorithm>
 #include <boost/scope_exit.hpp>
 #include "Common/ReaderTestHelper.h"
+#include "../../../Source/Readers/CNTKBinaryReader/FileHelper.h"
+#include "../../../Source/Readers/CNTKBinaryReader/ChunkCompression.h"
 
 using namespace Microsoft::MSR::CNTK;
 
@@ -91,6 +93,134 @@ BOOST_AUTO_TEST_CASE(CNTKBinaryReader_Simple_dense2)
         1, false, false, false);
 };
 
+BOOST_AUTO_TEST_CASE(CNTKBinaryReader_sparse_seq_memory_mapped)
+{
+    HelperRunReaderTest<float>(
+        testDataPath() + "/Config/CNTKBinaryReader/test.cntk",
+        testDataPath() + "/Control/CNTKBinaryReader/Simple_sparse_seq.txt",
+        testDataPath() + "/Control/CNTKBinaryReader/Simple_sparse_seq_memory_mapped_Output.txt",
+        "SparseSeq",
+        "reader",
+        1500, // epoch size
+        250,  // mb size
+        1,   // num epochs 
+        2,
+        2,
+        0,
+        1, true, false, false,
+        { L"SparseSeq=[reader=[useMemoryMapping=true]]" });
+};
+
+BOOST_AUTO_TEST_CASE(CNTKBinaryReader_Simple_dense_memory_mapped)
+{
+    HelperRunReaderTest<float>(
+        testDataPath() + "/Config/CNTKBinaryReader/test.cntk",
+        testDataPath() + "/Control/CNTKBinaryReader/Simple_dense.txt",
+        testDataPath() + "/Control/CNTKBinaryReader/Simple_dense_memory_mapped_Output.txt",
+        "Simple",
+        "reader",
+        1600, // epoch size
+        250,  // mb size
+        1,   // num epochs 
+        4,
+        0,
+        0,
+        1, false, false, false,
+        { L"Simple=[reader=[useMemoryMapping=true]]" });
+};
+
+BOOST_AUTO_TEST_CASE(CNTKBinaryReader_half_precision_conversion)
+{
+    // Every half survives the conversion to float and back (except for the payload of NaNs).
+    for (uint32_t bits = 0; bits <= 0xffff; bits++)
+    {
+        uint16_t half = (uint16_t)bits;
+        if ((half & 0x7c00) == 0x7c00 && (half & 0x3ff) != 0)
+            continue;
+        BOOST_REQUIRE_EQUAL(CNTKBinaryHalf::FromFloat(CNTKBinaryHalf::ToFloat(half)), half);
+    }
+
+    BOOST_CHECK_EQUAL(CNTKBinaryHalf::ToFloat(0x3c00), 1.0f);
+    BOOST_CHECK_EQUAL(CNTKBinaryHalf::ToFloat(0xc000), -2.0f);
+    BOOST_CHECK_EQUAL(CNTKBinaryHalf::ToFloat(0x0001), ldexpf(1, -24)); // smallest subnormal
+    BOOST_CHECK_EQUAL(CNTKBinaryHalf::FromFloat(65504.0f), 0x7bff); // largest half
+    BOOST_CHECK_EQUAL(CNTKBinaryHalf::FromFloat(65520.0f), 0x7c00); // rounds to infinity
+    BOOST_CHECK_EQUAL(CNTKBinaryHalf::FromFloat(1.0f + ldexpf(1, -11)), 0x3c00); // ties round to even
+    BOOST_CHECK_EQUAL(CNTKBinaryHalf::FromFloat(1.0f + 3 * ldexpf(1, -11)), 0x3c02);
+    BOOST_CHECK_EQUAL(CNTKBinaryHalf::FromFloat(ldexpf(1, -25)), 0x0000);
+    BOOST_CHECK_EQUAL(CNTKBinaryHalf::FromFloat(ldexpf(3, -26)), 0x0001);
+
+    // The vectorized conversion of a whole buffer agrees with the scalar one.
+    std::vector<uint16_t> halves;
+    for (uint32_t bits = 0; bits <= 0xffff; bits++)
+    {
+        if ((bits & 0x7c00) != 0x7c00 || (bits & 0x3ff) == 0)
+            halves.push_back((uint16_t)bits);
+    }
+    std::vector<float> floats(halves.size());
+    CNTKBinaryHalf::ToFloat(halves.data(), floats.data(), halves.size());
+    for (size_t i = 0; i < halves.size(); i++)
+        BOOST_REQUIRE_EQUAL(floats[i], CNTKBinaryHalf::ToFloat(halves[i]));
+}
+
+BOOST_AUTO_TEST_CASE(CNTKBinaryReader_int8_quantization)
+{
+    std::vector<float> values = { 0.0f, 1.0f, -2.54f, 0.5f, 2.54f, -0.01f, 0.02f, 1.27f, -1.0f };
+    float scale = CNTKBinaryInt8::GetScale(values.data(), values.size());
+    BOOST_CHECK_CLOSE(scale, 0.02f, 1e-4);
+
+    std::vector<int8_t> quantized;
+    for (float value : values)
+        quantized.push_back(CNTKBinaryInt8::FromFloat(value, scale));
+    BOOST_CHECK_EQUAL(quantized[2], -127);
+    BOOST_CHECK_EQUAL(quantized[4], 127);
+
+    // Every value comes back within half a quantization step.
+    std::vector<float> restored(values.size());
+    CNTKBinaryInt8::ToFloat(quantized.data(), scale, restored.data(), restored.size());
+    for (size_t i = 0; i < values.size(); i++)
+        BOOST_CHECK_SMALL(restored[i] - values[i], scale / 2 * 1.001f);
+
+    // All zeros have a scale of 0 and stay zeros.
+    std::vector<float> zeros(5, 0.0f);
+    BOOST_CHECK_EQUAL(CNTKBinaryInt8::GetScale(zeros.data(), zeros.size()), 0.0f);
+    BOOST_CHECK_EQUAL(CNTKBinaryInt8::FromFloat(0.0f, 0.0f), 0);
+
+    float infinity = INFINITY;
+    BOOST_CHECK_THROW(CNTKBinaryInt8::GetScale(&infinity, 1), std::runtime_error);
+}
+
+BOOST_AUTO_TEST_CASE(CNTKBinaryReader_chunk_compression_round_trip)
+{
+    std::vector<char> chunk(100000);
+    for (size_t i = 0; i < chunk.size(); i++)
+        chunk[i] = (char)(i % 7 == 0 ? i % 251 : 0);
+
+    for (auto compression : { ChunkCompression::None, ChunkCompression::LZ4, ChunkCompression::Zstd })
+    {
+        if (!CNTKBinaryCompression::IsSupported(compression))
+        {
+            BOOST_TEST_MESSAGE("Chunk compression " << CNTKBinaryCompression::GetName(compression) << " is not supported by this build.");
+            continue;
+        }
+
+        std::vector<char> compressed;
+        CNTKBinaryCompression::Compress(compression, 3, chunk.data(), chunk.size(), compressed);
+        if (compression != ChunkCompression::None)
+            BOOST_CHECK_LT(compressed.size(), chunk.size());
+
+        std::vector<char> decompressed(chunk.size());
+        CNTKBinaryCompression::Decompress(compression, compressed.data(), compressed.size(), decompressed.data(), decompressed.size());
+        BOOST_CHECK(decompressed == chunk);
+
+        // A chunk of the wrong size is reported, not silently accepted.
+        BOOST_CHECK_THROW(CNTKBinaryCompression::Decompress(compression, compressed.data(), compressed.size(), decompressed.data(), decompressed.size() - 1),
+                          std::runtime_error);
+    }
+
+    BOOST_CHECK(CNTKBinaryCompression::Parse(L"zstd") == ChunkCompression::Zstd);
+    BOOST_CHECK_THROW(CNTKBinaryCompression::Parse(L"gzip"), std::invalid_argument);
+}
 
 BOOST_AUTO_TEST_SUITE_END()
 
@@ -4,6 +4,8 @@
 //
 #include "stdafx.h"
 #include <algorithm>
+#include <chrono>
+#include <random>
 #ifdef _WIN32
 #include <io.h>
 #else // On Linux
@@ -33,9 +35,10 @@ public:
     ChunkPtr m_chunk;
 
     CNTKTextFormatReaderTestRunner(const string& filename,
-        const vector<StreamDescriptor>& streams, unsigned int maxErrors) :
+        const vector<StreamDescriptor>& streams, unsigned int maxErrors, bool useFastParsing = true) :
         m_parser(std::make_shared<CorpusDescriptor>(true), wstring(filename.begin(), filename.end()), streams, true)
     {
+        m_parser.SetUseFastParsing(useFastParsing);
         m_parser.SetMaxAllowedErrors(maxErrors);
         m_parser.SetTraceLevel(TextParser<ElemType>::TraceLevel::Info);
         m_parser.SetChunkSize(SIZE_MAX);
@@ -75,6 +78,84 @@ void SortLinesInFile(string filename, size_t expectedNumLines = 1)
     ofstream.close();
 }
 
+// Writes a dense stream 'A' and a sparse stream 'B' with numbers in a variety of notations.
+void WriteMixedNumberFile(const string& filename, size_t numSequences, size_t denseDimension, size_t sparseDimension)
+{
+    const char* formats[] = { "%.0f", "%.3f", "%.6f", "%+.9f", "%.15f", "%.17g", "%e", "%.4E", "%g" };
+    std::mt19937 rng(13);
+    std::uniform_real_distribution<double> magnitude(-12, 12);
+    char number[64];
+    auto randomNumber = [&]()
+    {
+        double value = pow(10.0, magnitude(rng)) * (rng() % 2 ? -1 : 1);
+        sprintf(number, formats[rng() % _countof(formats)], value);
+        return number;
+    };
+
+    FILE* file = fopen(filename.c_str(), "w");
+    BOOST_REQUIRE(file != nullptr);
+    for (size_t i = 0; i < numSequences; ++i)
+    {
+        fprintf(file, "|A");
+        for (size_t j = 0; j < denseDimension; ++j)
+            fprintf(file, " %s", randomNumber());
+        fprintf(file, "\t|B");
+        for (size_t j = 0; j < sparseDimension; j += 1 + rng() % 10)
+            fprintf(file, " %d:%s", (int)j, randomNumber());
+        fprintf(file, "\n");
+    }
+    fclose(file);
+}
+
+vector<StreamDescriptor> MixedNumberStreams(size_t denseDimension, size_t sparseDimension)
+{
+    vector<StreamDescriptor> streams(2);
+    streams[0].m_alias = "A";
+    streams[0].m_name = L"A";
+    streams[0].m_storageType = StorageType::dense;
+    streams[0].m_sampleDimension = denseDimension;
+
+    streams[1].m_alias = "B";
+    streams[1].m_name = L"B";
+    streams[1].m_storageType = StorageType::sparse_csc;
+    streams[1].m_sampleDimension = sparseDimension;
+    return streams;
+}
+
+template <class ElemType>
+void CheckFastParsingMatchesScalarParsing()
+{
+    const size_t numSequences = 500, denseDimension = 20, sparseDimension = 1000;
+    const string filename = "mixed_numbers.txt";
+    WriteMixedNumberFile(filename, numSequences, denseDimension, sparseDimension);
+    auto streams = MixedNumberStreams(denseDimension, sparseDimension);
+
+    CNTKTextFormatReaderTestRunner<ElemType> fast(filename, streams, 0, true);
+    CNTKTextFormatReaderTestRunner<ElemType> scalar(filename, streams, 0, false);
+    fast.LoadChunk();
+    scalar.LoadChunk();
+
+    for (size_t i = 0; i < numSequences; ++i)
+    {
+        vector<SequenceDataPtr> expected, actual;
+        scalar.m_chunk->GetSequence(i, expected);
+        fast.m_chunk->GetSequence(i, actual);
+        BOOST_REQUIRE_EQUAL(expected.size(), 2);
+        BOOST_REQUIRE_EQUAL(actual.size(), 2);
+
+        auto expectedData = static_cast<const ElemType*>(expected[0]->GetDataBuffer());
+        auto actualData = static_cast<const ElemType*>(actual[0]->GetDataBuffer());
+        BOOST_REQUIRE(memcmp(expectedData, actualData, denseDimension * sizeof(ElemType)) == 0);
+
+        auto expectedSparse = static_pointer_cast<SparseSequenceData>(expected[1]);
+        auto actualSparse = static_pointer_cast<SparseSequenceData>(actual[1]);
+        BOOST_REQUIRE_EQUAL(expectedSparse->m_totalNnzCount, actualSparse->m_totalNnzCount);
+        BOOST_REQUIRE(memcmp(expectedSparse->m_indices, actualSparse->m_indices, expectedSparse->m_totalNnzCount * sizeof(IndexType)) == 0);
+        BOOST_REQUIRE(memcmp(expectedSparse->GetDataBuffer(), actualSparse->GetDataBuffer(), expectedSparse->m_totalNnzCount * sizeof(ElemType)) == 0);
+    }
+
+    boost::filesystem::remove(filename);
+}
 
 struct CNTKTextFormatReaderFixture : ReaderFixture
 {
@@ -103,6 +184,53 @@ BOOST_AUTO_TEST_CASE(CNTKTextFormatReader_Simple_dense)
         1);
 };
 
+// reading several minibatches ahead must not change the data
+BOOST_AUTO_TEST_CASE(CNTKTextFormatReader_Simple_dense_prefetch_depth)
+{
+    HelperRunReaderTest<float>(
+        testDataPath() + "/Config/CNTKTextFormatReader/dense.cntk",
+        testDataPath() + "/Control/CNTKTextFormatReader/Simple_dense.txt",
+        testDataPath() + "/Control/CNTKTextFormatReader/Simple_dense_prefetch_depth_Output.txt",
+        "Simple",
+        "reader",
+        1000, // epoch size
+        250,  // mb size
+        10,   // num epochs 
+        1,
+        1,
+        0,
+        1,
+        false,
+        false,
+        true,
+        { L"Simple=[reader=[prefetchDepth=3]]" });
+};
+
+BOOST_AUTO_TEST_CASE(CNTKTextFormatReader_Simple_dense_cached_index)
+{
+    // The first run writes the index next to the input file, the second one loads it.
+    for (int run = 0; run < 2; ++run)
+    {
+        HelperRunReaderTest<float>(
+            testDataPath() + "/Config/CNTKTextFormatReader/dense.cntk",
+            testDataPath() + "/Control/CNTKTextFormatReader/Simple_dense.txt",
+            testDataPath() + "/Control/CNTKTextFormatReader/Simple_dense_cached_index_Output.txt",
+            "Simple",
+            "reader",
+            1000, // epoch size
+            250,  // mb size
+            10,   // num epochs
+            1,
+            1,
+            0,
+            1,
+            false,
+            false,
+            true,
+            { L"Simple=[reader=[cacheIndex=true]]" });
+    }
+};
+
 BOOST_AUTO_TEST_CASE(CNTKTextFormatReader_Simple_dense_single_stream)
 {
     HelperRunReaderTest<float>(
@@ -690,6 +818,48 @@ BOOST_AUTO_TEST_CASE(CNTKTextFormatReader_invalid_inputs)
 
 // 100 sequences with N samples for each of 3 inputs, where N is chosen at random
 // from [1, 100] for each sequence
+BOOST_AUTO_TEST_CASE(CNTKTextFormatReader_fast_parsing_matches_scalar_parsing)
+{
+    CheckFastParsingMatchesScalarParsing<float>();
+    CheckFastParsingMatchesScalarParsing<double>();
+}
+
+// Reports the parsing throughput of dense data with and without the fast number parsing path.
+BOOST_AUTO_TEST_CASE(CNTKTextFormatReader_number_parsing_throughput)
+{
+    const size_t numSequences = 2000, denseDimension = 1000;
+    const string filename = "dense_numbers.txt";
+    {
+        std::mt19937 rng(7);
+        std::uniform_real_distribution<float> value(-10, 10);
+        FILE* file = fopen(filename.c_str(), "w");
+        BOOST_REQUIRE(file != nullptr);
+        for (size_t i = 0; i < numSequences; ++i)
+        {
+            fprintf(file, "|A");
+            for (size_t j = 0; j < denseDimension; ++j)
+                fprintf(file, " %.6f", value(rng));
+            fprintf(file, "\n");
+        }
+        fclose(file);
+    }
+    double megabytes = boost::filesystem::file_size(filename) / 1e6;
+
+    auto streams = MixedNumberStreams(denseDimension, 1);
+    streams.resize(1);
+    for (bool useFastParsing : { false, true })
+    {
+        CNTKTextFormatReaderTestRunner<float> testRunner(filename, streams, 0, useFastParsing);
+        auto start = std::chrono::steady_clock::now();
+        testRunner.LoadChunk();
+        std::chrono::duration<double> seconds = std::chrono::steady_clock::now() - start;
+        BOOST_TEST_MESSAGE("Parsed " << megabytes << " MB of dense data " << (useFastParsing ? "with" : "without")
+                           << " the fast path at " << megabytes / seconds.count() << " MB/s");
+    }
+
+    boost::filesystem::remove(filename);
+}
+
 BOOST_AUTO_TEST_CASE(CNTKTextFormatReader_100x100x3)
 {
     string outputFile = testDataPath() + "/Control/CNTKTextFormatReader/100x100x3_jagged_sequences_dense_Output.txt";
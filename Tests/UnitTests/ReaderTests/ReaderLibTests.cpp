@@ -5,11 +5,19 @@
 #include "stdafx.h"
 #include <numeric>
 #include <random>
+#ifndef _WIN32
+#include <unistd.h>
+#endif
 
 #include "NoRandomizer.h"
 #include "DataDeserializer.h"
 #include "BlockRandomizer.h"
+#include "FrameRandomizer.h"
 #include "CorpusDescriptor.h"
+#include "ChunkCache.h"
+#include "SharedChunkCache.h"
+#include "TransformController.h"
+#include "LengthBucketingEnumerator.h"
 
 #pragma warning(push)
 // disable warning about possible mod 0 operation in uniform_int_distribution
@@ -499,14 +507,14 @@ BOOST_AUTO_TEST_CASE(BlockRandomizerOneEpochWithChunks1)
     BlockRandomizerOneEpochWithChunks1Test(true);
 }
 
-void BlockRandomizerOneEpochWithChunks2Test(bool prefetch)
+void BlockRandomizerOneEpochWithChunks2Test(bool prefetch, size_t maxParallelChunkLoads = 1)
 {
     vector<float> data(20);
     iota(data.begin(), data.end(), 0.0f);
 
     auto mockDeserializer = make_shared<MockDeserializer>(10, 2, data);
 
-    auto randomizer = make_shared<BlockRandomizer>(0, 18, mockDeserializer, prefetch, false);
+    auto randomizer = make_shared<BlockRandomizer>(0, 18, mockDeserializer, prefetch, false, false, maxParallelChunkLoads);
 
     EpochConfiguration epochConfiguration;
     epochConfiguration.m_numberOfWorkers = 1;
@@ -544,7 +552,146 @@ BOOST_AUTO_TEST_CASE(BlockRandomizerOneEpochWithChunks2)
     BlockRandomizerOneEpochWithChunks2Test(true);
 }
 
-void BlockRandomizerChaosMonkeyTest(bool prefetch)
+BOOST_AUTO_TEST_CASE(BlockRandomizerParallelChunkLoads)
+{
+    // Loading chunks in parallel must not change the order of the sequences.
+    BlockRandomizerOneEpochWithChunks2Test(true, 3);
+    BlockRandomizerOneEpochWithChunks2Test(true, 20);
+}
+
+// Reads an epoch of sequences of 3 samples with two workers, returning the samples per minibatch and worker.
+vector<vector<size_t>> BlockRandomizerTwoWorkersTest(double balanceTolerance, vector<float>& seen, BlockRandomizer::DecimationStatistics& statistics)
+{
+    vector<float> data(40);
+    iota(data.begin(), data.end(), 0.0f);
+    auto mockDeserializer = make_shared<MockDeserializer>(10, 4, data, 3);
+
+    const size_t numberOfWorkers = 2;
+    vector<vector<size_t>> samples;
+    for (size_t rank = 0; rank < numberOfWorkers; rank++)
+    {
+        auto randomizer = make_shared<BlockRandomizer>(0, 24, mockDeserializer, false);
+        if (balanceTolerance >= 0)
+            randomizer->SetSampleBalancedDecimation(balanceTolerance);
+
+        EpochConfiguration epochConfiguration;
+        epochConfiguration.m_numberOfWorkers = numberOfWorkers;
+        epochConfiguration.m_workerRank = rank;
+        epochConfiguration.m_minibatchSizeInSamples = 0;
+        epochConfiguration.m_totalEpochSizeInSamples = data.size() * 3;
+        epochConfiguration.m_epochIndex = 0;
+        randomizer->StartEpoch(epochConfiguration);
+
+        for (size_t minibatch = 0;; minibatch++)
+        {
+            Sequences sequences = randomizer->GetNextSequences(15);
+            if (samples.size() <= minibatch)
+                samples.push_back(vector<size_t>(numberOfWorkers, 0));
+            for (const auto& sequence : sequences.m_data.empty() ? vector<SequenceDataPtr>() : sequences.m_data[0])
+            {
+                samples[minibatch][rank] += sequence->m_numberOfSamples;
+                seen.push_back(*(const float*)sequence->GetDataBuffer());
+            }
+            if (sequences.m_endOfEpoch)
+                break;
+        }
+        statistics = randomizer->GetDecimationStatistics();
+    }
+    return samples;
+}
+
+BOOST_AUTO_TEST_CASE(BlockRandomizerSampleBalancedDecimation)
+{
+    BlockRandomizer::DecimationStatistics statistics;
+    for (double tolerance : { -1.0, 0.0 })
+    {
+        // Every sequence goes to exactly one worker.
+        vector<float> seen;
+        auto samples = BlockRandomizerTwoWorkersTest(tolerance, seen, statistics);
+        sort(seen.begin(), seen.end());
+        BOOST_REQUIRE_EQUAL(seen.size(), 40);
+        for (size_t i = 0; i < seen.size(); i++)
+            BOOST_CHECK_EQUAL(seen[i], (float)i);
+
+        // The sequences have 3 samples each, so that balanced workers differ by at most one sequence.
+        bool balanced = true;
+        for (const auto& minibatch : samples)
+            balanced &= max(minibatch[0], minibatch[1]) - min(minibatch[0], minibatch[1]) <= 3;
+        BOOST_CHECK_EQUAL(balanced, tolerance >= 0);
+        BOOST_CHECK_EQUAL(statistics.m_numMovedSequences > 0, tolerance >= 0);
+        BOOST_CHECK_GE(statistics.m_maxImbalance, 1.0);
+    }
+}
+
+BOOST_AUTO_TEST_CASE(FeistelPermutationIsBijective)
+{
+    for (size_t size : { 1, 2, 3, 7, 64, 1000, 4097 })
+    {
+        FeistelPermutation permutation(size, 42);
+        vector<size_t> actual;
+        for (size_t i = 0; i < size; ++i)
+            actual.push_back(permutation(i));
+
+        sort(actual.begin(), actual.end());
+        vector<size_t> expected(size);
+        iota(expected.begin(), expected.end(), 0);
+        BOOST_CHECK_EQUAL_COLLECTIONS(expected.begin(), expected.end(), actual.begin(), actual.end());
+    }
+}
+
+vector<float> ReadFrameRandomizedEpoch(BlockRandomizer& randomizer, size_t epochSize, size_t epochIndex)
+{
+    EpochConfiguration epochConfiguration;
+    epochConfiguration.m_numberOfWorkers = 1;
+    epochConfiguration.m_workerRank = 0;
+    epochConfiguration.m_minibatchSizeInSamples = 0;
+    epochConfiguration.m_totalEpochSizeInSamples = epochSize;
+    epochConfiguration.m_epochIndex = epochIndex;
+    randomizer.StartEpoch(epochConfiguration);
+
+    vector<float> actual;
+    for (;;)
+    {
+        Sequences sequences = randomizer.GetNextSequences(7);
+        for (const auto& sequence : sequences.m_data.empty() ? vector<SequenceDataPtr>() : sequences.m_data[0])
+        {
+            auto& data = reinterpret_cast<DenseSequenceData&>(*sequence);
+            BOOST_CHECK_EQUAL(data.m_numberOfSamples, 1u);
+            actual.push_back(*((float*)data.GetDataBuffer()));
+        }
+        if (sequences.m_endOfEpoch)
+            break;
+    }
+    return actual;
+}
+
+BOOST_AUTO_TEST_CASE(BlockRandomizerFrameRandomization)
+{
+    vector<float> data(200);
+    iota(data.begin(), data.end(), 0.0f);
+    auto mockDeserializer = make_shared<MockDeserializer>(10, 20, data);
+
+    auto randomizer = make_shared<BlockRandomizer>(0, 50, mockDeserializer, true, false, false, 1, true /* frameRandomization */);
+
+    // Each sweep returns each frame once, in a different order.
+    auto first = ReadFrameRandomizedEpoch(*randomizer, data.size(), 0);
+    auto second = ReadFrameRandomizedEpoch(*randomizer, data.size(), 1);
+    BOOST_CHECK(first != data);
+    BOOST_CHECK(first != second);
+    for (auto sweep : { first, second })
+    {
+        sort(sweep.begin(), sweep.end());
+        BOOST_CHECK_EQUAL_COLLECTIONS(data.begin(), data.end(), sweep.begin(), sweep.end());
+    }
+
+    // Going back to an epoch in the middle of a sweep reproduces it.
+    auto firstHalf = ReadFrameRandomizedEpoch(*randomizer, data.size() / 2, 0);
+    auto secondHalf = ReadFrameRandomizedEpoch(*randomizer, data.size() / 2, 1);
+    firstHalf.insert(firstHalf.end(), secondHalf.begin(), secondHalf.end());
+    BOOST_CHECK_EQUAL_COLLECTIONS(first.begin(), first.end(), firstHalf.begin(), firstHalf.end());
+}
+
+void BlockRandomizerChaosMonkeyTest(bool prefetch, size_t maxParallelChunkLoads = 1)
 {
     const int sequenceLength = 3;
     const int seed = 42;
@@ -559,7 +706,7 @@ void BlockRandomizerChaosMonkeyTest(bool prefetch)
 
     auto mockDeserializer = make_shared<MockDeserializer>(numChunks, numSequencesPerChunk, data, sequenceLength);
 
-    auto randomizer = make_shared<BlockRandomizer>(0, windowSize, mockDeserializer, prefetch, false);
+    auto randomizer = make_shared<BlockRandomizer>(0, windowSize, mockDeserializer, prefetch, false, false, maxParallelChunkLoads);
 
     for (int t = 0; t < 100; t++)
     {
@@ -603,6 +750,7 @@ BOOST_AUTO_TEST_CASE(BlockRandomizerChaosMonkey)
 {
     BlockRandomizerChaosMonkeyTest(false);
     BlockRandomizerChaosMonkeyTest(true);
+    BlockRandomizerChaosMonkeyTest(true, 4);
 }
 
 void BlockRandomizerOneEpochLegacyRandomizationTest(bool prefetch)
@@ -651,13 +799,13 @@ BOOST_AUTO_TEST_CASE(BlockRandomizerOneEpochLegacyRandomization)
     BlockRandomizerOneEpochLegacyRandomizationTest(true);
 }
 
-BOOST_AUTO_TEST_CASE(NoRandomizerOneEpoch)
+void NoRandomizerOneEpochTest(size_t maxPrefetchedChunks = 0, size_t prefetchWindowInSamples = SIZE_MAX)
 {
     vector<float> data(10);
     iota(data.begin(), data.end(), 0.0f);
     auto mockDeserializer = make_shared<MockDeserializer>(5, 2, data);
 
-    auto randomizer = make_shared<NoRandomizer>(mockDeserializer);
+    auto randomizer = make_shared<NoRandomizer>(mockDeserializer, false, maxPrefetchedChunks, prefetchWindowInSamples);
 
     EpochConfiguration epochConfiguration;
     epochConfiguration.m_numberOfWorkers = 1;
@@ -688,6 +836,236 @@ BOOST_AUTO_TEST_CASE(NoRandomizerOneEpoch)
                                   actual.begin(), actual.end());
 }
 
+BOOST_AUTO_TEST_CASE(NoRandomizerOneEpoch)
+{
+    NoRandomizerOneEpochTest();
+}
+
+BOOST_AUTO_TEST_CASE(NoRandomizerPrefetch)
+{
+    // Prefetching chunks must not change the sequences.
+    NoRandomizerOneEpochTest(1);
+    NoRandomizerOneEpochTest(3);
+    NoRandomizerOneEpochTest(10);
+    NoRandomizerOneEpochTest(3, 4);
+    NoRandomizerOneEpochTest(3, 1);
+}
+
+// Adds 100 to the single float of a sequence, counting the sequences transformed.
+class MockTransformer : public Transformer
+{
+public:
+    struct Sequence : DenseSequenceData
+    {
+        const void* GetDataBuffer() override
+        {
+            return &m_value;
+        }
+
+        float m_value;
+    };
+
+    void StartEpoch(const EpochConfiguration&) override {}
+
+    StreamDescription Transform(const StreamDescription& inputStream) override
+    {
+        return inputStream;
+    }
+
+    SequenceDataPtr Transform(SequenceDataPtr inputSequence) override
+    {
+        auto result = make_shared<Sequence>();
+        result->m_value = *(const float*)inputSequence->GetDataBuffer() + 100;
+        result->m_numberOfSamples = inputSequence->m_numberOfSamples;
+        m_numTransformed++;
+        return result;
+    }
+
+    atomic<size_t> m_numTransformed{ 0 };
+};
+
+BOOST_AUTO_TEST_CASE(TransformControllerWithMultithreadedRandomizer)
+{
+    vector<float> data(10);
+    iota(data.begin(), data.end(), 0.0f);
+    auto mockDeserializer = make_shared<MockDeserializer>(5, 2, data);
+
+    // A multithreaded randomizer applies the transforms while it gets the sequences, otherwise the controller does.
+    for (bool multithreaded : { false, true })
+    {
+        auto randomizer = make_shared<NoRandomizer>(mockDeserializer, multithreaded);
+        auto transformer = make_shared<MockTransformer>();
+        TransformController controller({ Transformation{ transformer, L"input" } }, randomizer);
+
+        EpochConfiguration epochConfiguration;
+        epochConfiguration.m_numberOfWorkers = 1;
+        epochConfiguration.m_workerRank = 0;
+        epochConfiguration.m_minibatchSizeInSamples = 0;
+        epochConfiguration.m_totalEpochSizeInSamples = data.size();
+        epochConfiguration.m_epochIndex = 0;
+        controller.StartEpoch(epochConfiguration);
+
+        Sequences sequences = controller.GetNextSequences(data.size());
+        BOOST_REQUIRE_EQUAL(sequences.m_data.size(), 1);
+        BOOST_REQUIRE_EQUAL(sequences.m_data[0].size(), data.size());
+        for (size_t i = 0; i < data.size(); i++)
+            BOOST_CHECK_EQUAL(*(const float*)sequences.m_data[0][i]->GetDataBuffer(), data[i] + 100);
+        BOOST_CHECK_EQUAL(transformer->m_numTransformed, data.size());
+    }
+}
+
+// Reads an epoch of single stream sequences, returning all their samples and the padding
+// there would be if the sequences of each minibatch were laid out in parallel.
+vector<float> ReadPaddedEpoch(SequenceEnumerator& enumerator, size_t minibatchSize, size_t epochSize, size_t& padding)
+{
+    EpochConfiguration epochConfiguration;
+    epochConfiguration.m_numberOfWorkers = 1;
+    epochConfiguration.m_workerRank = 0;
+    epochConfiguration.m_minibatchSizeInSamples = minibatchSize;
+    epochConfiguration.m_totalEpochSizeInSamples = epochSize;
+    epochConfiguration.m_epochIndex = 0;
+    enumerator.StartEpoch(epochConfiguration);
+
+    vector<float> samples;
+    padding = 0;
+    Sequences sequences;
+    do
+    {
+        sequences = enumerator.GetNextSequences(minibatchSize);
+        if (sequences.m_data.empty())
+            continue;
+
+        size_t maxLength = 0, numSamples = 0;
+        for (const auto& sequence : sequences.m_data[0])
+        {
+            const float* data = (const float*)sequence->GetDataBuffer();
+            samples.insert(samples.end(), data, data + sequence->m_numberOfSamples);
+            maxLength = max<size_t>(maxLength, sequence->m_numberOfSamples);
+            numSamples += sequence->m_numberOfSamples;
+        }
+        padding += maxLength * sequences.m_data[0].size() - numSamples;
+    } while (!sequences.m_endOfEpoch);
+    return samples;
+}
+
+BOOST_AUTO_TEST_CASE(LengthBucketingEnumeratorGroupsSequencesByLength)
+{
+    const size_t sweepNumberOfSamples = 20000;
+    const size_t minibatchSize = 300;
+    auto deserializer = make_shared<SequentialDeserializer>(0, 1000, sweepNumberOfSamples, 50);
+
+    size_t padding = 0;
+    NoRandomizer randomizer(deserializer);
+    ReadPaddedEpoch(randomizer, minibatchSize, sweepNumberOfSamples, padding);
+
+    size_t bucketedPadding = 0;
+    LengthBucketingEnumerator bucketing(make_shared<NoRandomizer>(deserializer), 10);
+    vector<float> samples = ReadPaddedEpoch(bucketing, minibatchSize, sweepNumberOfSamples, bucketedPadding);
+
+    // All samples are returned exactly once, in buckets with a fraction of the padding.
+    sort(samples.begin(), samples.end());
+    vector<float> expected(sweepNumberOfSamples);
+    iota(expected.begin(), expected.end(), 0.0f);
+    BOOST_CHECK(samples == expected);
+    BOOST_CHECK_LT(bucketedPadding * 4, padding);
+    BOOST_CHECK_EQUAL(bucketing.GetCurrentSamplePosition(), sweepNumberOfSamples);
+}
+
+// Requests the chunks in order and returns how many of the requests were cache hits.
+size_t RequestChunks(ChunkCache& cache, const vector<ChunkIdType>& chunkIds)
+{
+    size_t hitsBefore = cache.GetStatistics().m_numHits;
+    for (auto id : chunkIds)
+        BOOST_CHECK(cache.GetChunk(id) != nullptr);
+    return cache.GetStatistics().m_numHits - hitsBefore;
+}
+
+BOOST_AUTO_TEST_CASE(ChunkCacheUnbounded)
+{
+    vector<float> data(10);
+    iota(data.begin(), data.end(), 0.0f);
+    auto mockDeserializer = make_shared<MockDeserializer>(5, 2, data);
+
+    ChunkCache cache(mockDeserializer);
+    BOOST_CHECK_EQUAL(RequestChunks(cache, { 0, 1, 2, 3, 4 }), 0);
+    BOOST_CHECK_EQUAL(RequestChunks(cache, { 4, 3, 2, 1, 0 }), 5);
+
+    auto stats = cache.GetStatistics();
+    BOOST_CHECK_EQUAL(stats.m_numMisses, 5);
+    BOOST_CHECK_EQUAL(stats.m_numEvictions, 0);
+    BOOST_CHECK_EQUAL(stats.m_numCachedChunks, 5);
+}
+
+BOOST_AUTO_TEST_CASE(ChunkCacheEviction)
+{
+    vector<float> data(10);
+    iota(data.begin(), data.end(), 0.0f);
+    auto mockDeserializer = make_shared<MockDeserializer>(5, 2, data);
+
+    // Each chunk has two single sample sequences of a float, room for three chunks.
+    const size_t chunkSize = 2 * sizeof(float);
+    for (auto policy : { ChunkCacheEvictionPolicy::LeastRecentlyUsed, ChunkCacheEvictionPolicy::Sweep })
+    {
+        ChunkCache cache(mockDeserializer, 3 * chunkSize, policy);
+
+        // First sweep, chunk 3 evicts chunk 0 with both policies.
+        BOOST_CHECK_EQUAL(RequestChunks(cache, { 0, 1, 2, 3 }), 0);
+        BOOST_CHECK_EQUAL(cache.GetStatistics().m_cachedBytes, 3 * chunkSize);
+        BOOST_CHECK_EQUAL(cache.GetStatistics().m_numEvictions, 1);
+
+        // Second sweep. With LRU, loading chunk 4 evicts chunk 2 and loading chunk 2 then evicts chunk 3,
+        // while the sweep policy evicts chunk 1 that has already been used in this sweep.
+        BOOST_CHECK_EQUAL(RequestChunks(cache, { 1, 4 }), 1);
+        size_t expectedHits = policy == ChunkCacheEvictionPolicy::Sweep ? 2 : 0;
+        BOOST_CHECK_EQUAL(RequestChunks(cache, { 2, 3 }), expectedHits);
+    }
+
+    // A chunk larger than the budget is not cached.
+    ChunkCache cache(mockDeserializer, chunkSize - 1);
+    BOOST_CHECK_EQUAL(RequestChunks(cache, { 0, 0 }), 0);
+    BOOST_CHECK_EQUAL(cache.GetStatistics().m_numCachedChunks, 0);
+}
+
+#ifndef _WIN32
+BOOST_AUTO_TEST_CASE(SharedChunkCacheLoadsChunksOnce)
+{
+    vector<float> data(10);
+    iota(data.begin(), data.end(), 0.0f);
+    auto mockDeserializer = make_shared<MockDeserializer>(5, 2, data);
+
+    // Two caches with the same name stand for two processes of a node.
+    wstring name = L"ReaderLibTests-" + to_wstring(getpid());
+    SharedChunkCache first(mockDeserializer, name);
+    SharedChunkCache second(mockDeserializer, name);
+
+    auto loaded = first.GetChunk(3);
+    auto mapped = second.GetChunk(3);
+    BOOST_CHECK_EQUAL(first.GetStatistics().m_numLoaded, 1);
+    BOOST_CHECK_EQUAL(second.GetStatistics().m_numMapped, 1);
+    BOOST_CHECK_EQUAL(second.GetStatistics().m_numLoaded, 0);
+
+    for (size_t id : { 6, 7 })
+    {
+        vector<SequenceDataPtr> sequence;
+        mapped->GetSequence(id, sequence);
+        BOOST_REQUIRE_EQUAL(sequence.size(), 1);
+        BOOST_CHECK_EQUAL(sequence[0]->m_numberOfSamples, 1);
+        BOOST_CHECK_EQUAL(*(const float*)sequence[0]->GetDataBuffer(), data[id]);
+    }
+
+    // The mapping outlives the release of the chunk by the loading process.
+    loaded.reset();
+    vector<SequenceDataPtr> sequence;
+    mapped->GetSequence(6, sequence);
+    mapped.reset();
+    BOOST_CHECK_EQUAL(*(const float*)sequence[0]->GetDataBuffer(), data[6]);
+
+    // Once released, the chunk is loaded again by the next process that needs it.
+    BOOST_CHECK(second.GetChunk(3) != nullptr);
+    BOOST_CHECK_EQUAL(second.GetStatistics().m_numLoaded, 1);
+}
+#endif
+
 BOOST_AUTO_TEST_CASE(DefaultCorpusDescriptor)
 {
     const int seed = 13;
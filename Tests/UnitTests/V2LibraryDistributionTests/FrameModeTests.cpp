@@ -43,7 +43,7 @@ namespace
             { { g_featureStreamName, classifier.inputDim }, { g_labelsStreamName, classifier.ouputDim } },
             totalNumberOfSamples,
             true,
-            name == L"blockmomentum" ? MinibatchSource::InfiniteSamples: 0);
+            name == L"blockmomentum" || name == L"modelaveraging" ? MinibatchSource::InfiniteSamples: 0);
 
         auto featureStreamInfo = minibatchSource->StreamInfo(g_featureStreamName);
         auto labelStreamInfo = minibatchSource->StreamInfo(g_labelsStreamName);
@@ -114,11 +114,13 @@ void TestFrameMode()
     // Create a set of trainers.
     std::map<std::wstring, std::function<DistributedLearnerPtr(LearnerPtr)>> learners;
     learners[L"simple"] = [](LearnerPtr l) { return CreateDataParallelDistributedLearner(MPICommunicator(), l, 0); };
+    learners[L"blockmomentum"] = [](LearnerPtr l) { return CreateBlockMomentumDistributedLearner(MPICommunicator(), l, 0, 1024); };
+    // no block momentum, block learning rate 1
+    learners[L"modelaveraging"] = [](LearnerPtr l) { return CreateBlockMomentumDistributedLearner(MPICommunicator(), l, 0, 1024, 0.0, false, false, 1.0); };
 
     if (Is1bitSGDAvailable())
     {
         learners[L"1bitsgd"] = [](LearnerPtr l) { return CreateQuantizedDataParallelDistributedLearner(QuantizedMPICommunicator(true, true, 32), l, 0); };
-        learners[L"blockmomentum"] = [](LearnerPtr l) { return CreateBlockMomentumDistributedLearner(MPICommunicator(), l, 0, 1024); };
     }
 
     // Create a set of devices.
@@ -104,6 +104,132 @@ void TestRMSPropLearner(size_t numParameters, size_t numMinibatches, const Devic
     TestUpdate<ElementType>(learner, shape, numMinibatches, device);
 }
 
+template <typename ElementType>
+void TestAdamLearner(size_t numParameters, size_t numMinibatches, const DeviceDescriptor& device)
+{
+    NDShape shape = CreateShape(rng() % maxNumAxes + 1, maxDimSize);
+    auto parameters = CreateParameters<ElementType>(shape, numParameters, device);
+    auto learner = AdamLearner(parameters, LearningRatePerSampleSchedule({ 0.5 }), MomentumAsTimeConstantSchedule({ 10.0, 100.0, 1000.0 }),
+                               MomentumAsTimeConstantSchedule(1000.0), /*lowMemory*/ false);
+    TestUpdate<ElementType>(learner, shape, numMinibatches, device);
+}
+
+template <typename ElementType>
+void TestAdamWLearner(size_t numParameters, size_t numMinibatches, const DeviceDescriptor& device)
+{
+    NDShape shape = CreateShape(rng() % maxNumAxes + 1, maxDimSize);
+    auto parameters = CreateParameters<ElementType>(shape, numParameters, device);
+    auto learner = AdamWLearner(parameters, LearningRatePerMinibatchSchedule({ 0.5, 0.4, 0.3 }, 2), MomentumPerSampleSchedule(0.9),
+                                MomentumPerSampleSchedule(0.999), /*weightDecay*/ 0.01);
+    TestUpdate<ElementType>(learner, shape, numMinibatches, device);
+}
+
+template <typename ElementType>
+void TestLAMBLearner(size_t numParameters, size_t numMinibatches, const DeviceDescriptor& device)
+{
+    NDShape shape = CreateShape(rng() % maxNumAxes + 1, maxDimSize);
+    auto parameters = CreateParameters<ElementType>(shape, numParameters, device);
+    auto learner = LAMBLearner(parameters, LearningRatePerSampleSchedule(0.01), MomentumPerSampleSchedule(0.9),
+                               MomentumPerSampleSchedule(0.999), /*weightDecay*/ 0.01);
+    TestUpdate<ElementType>(learner, shape, numMinibatches, device);
+}
+
+// After the first minibatch, the bias corrected accumulators of Adam are the gradient and its square, so the step of each element
+// is g / (|g| + epsilon) + weightDecay * w, which LAMB scales by ||w|| / ||step||.
+template <typename ElementType>
+void TestAdamFirstStep(bool layerwiseAdaptive, const DeviceDescriptor& device)
+{
+    const double learningRate = 0.1;
+    const double weightDecay = 0.01;
+    const double epsilon = 1e-6;
+    NDShape shape = { 4, 3 };
+    auto parameters = CreateParameters<ElementType>(shape, 1, device);
+    auto& parameter = parameters[0];
+    auto initialValue = parameter.Value()->DeepClone(DeviceDescriptor::CPUDevice());
+
+    auto learner = layerwiseAdaptive ?
+        LAMBLearner(parameters, LearningRatePerSampleSchedule(learningRate), MomentumPerSampleSchedule(0.9), MomentumPerSampleSchedule(0.999), weightDecay, epsilon) :
+        AdamWLearner(parameters, LearningRatePerSampleSchedule(learningRate), MomentumPerSampleSchedule(0.9), MomentumPerSampleSchedule(0.999), weightDecay, epsilon);
+
+    auto gradientValue = NDArrayView::RandomUniform<ElementType>(shape, -1.0, 1.0, (unsigned long) rng(), device);
+    auto gradient = gradientValue->DeepClone(DeviceDescriptor::CPUDevice());
+    unordered_map<Parameter, NDArrayViewPtr> gradientValues = { { parameter, gradientValue } };
+    learner->Update(gradientValues, 1);
+
+    const size_t numElements = shape.TotalSize();
+    const ElementType* w = initialValue->template DataBuffer<ElementType>();
+    const ElementType* g = gradient->template DataBuffer<ElementType>();
+    vector<double> steps(numElements);
+    double parameterNorm = 0, stepNorm = 0;
+    for (size_t i = 0; i < numElements; i++)
+    {
+        steps[i] = g[i] / (abs(g[i]) + epsilon) + weightDecay * w[i];
+        parameterNorm += (double) w[i] * w[i];
+        stepNorm += steps[i] * steps[i];
+    }
+    const double trustRatio = layerwiseAdaptive ? sqrt(parameterNorm) / sqrt(stepNorm) : 1.0;
+
+    vector<ElementType> expected(numElements);
+    for (size_t i = 0; i < numElements; i++)
+        expected[i] = ElementType(w[i] - learningRate * trustRatio * steps[i]);
+
+    auto updatedValue = parameter.Value()->DeepClone(DeviceDescriptor::CPUDevice());
+    vector<ElementType> actual(updatedValue->template DataBuffer<ElementType>(), updatedValue->template DataBuffer<ElementType>() + numElements);
+    FloatingPointVectorCompare(actual, expected, layerwiseAdaptive ? "LAMB learner: unexpected first update" : "AdamW learner: unexpected first update");
+}
+
+// The parameters with dense gradients of a learner are updated together (see LearnerBase::MultiTensorUpdate()); they have to
+// end up as when each of them is updated by a learner of its own.
+template <typename ElementType>
+void TestMultiTensorUpdate(const function<LearnerPtr(const vector<Parameter>&)>& createLearner, size_t numParameters, size_t numMinibatches, const DeviceDescriptor& device)
+{
+    NDShape shape = CreateShape(rng() % maxNumAxes + 1, maxDimSize);
+    auto parameters = CreateParameters<ElementType>(shape, numParameters, device);
+    auto separateParameters = CreateParameters<ElementType>(shape, numParameters, device);
+
+    auto learner = createLearner(parameters);
+    vector<LearnerPtr> separateLearners;
+    for (const auto& parameter : separateParameters)
+        separateLearners.push_back(createLearner({ parameter }));
+
+    auto seed = (unsigned long) rng();
+    for (auto i = 0; i < numMinibatches; i++)
+    {
+        unordered_map<Parameter, NDArrayViewPtr> gradientValues;
+        for (size_t j = 0; j < numParameters; j++)
+            gradientValues[parameters[j]] = NDArrayView::RandomUniform<ElementType>(shape, -1.0, 1.0, seed + i * numParameters + j, device);
+        learner->Update(gradientValues, 2);
+
+        for (size_t j = 0; j < numParameters; j++)
+        {
+            unordered_map<Parameter, NDArrayViewPtr> separateGradientValues;
+            separateGradientValues[separateParameters[j]] = NDArrayView::RandomUniform<ElementType>(shape, -1.0, 1.0, seed + i * numParameters + j, device);
+            separateLearners[j]->Update(separateGradientValues, 2);
+        }
+    }
+
+    for (size_t j = 0; j < numParameters; j++)
+    {
+        if (!Internal::AreEqual(*parameters[j].Value(), *separateParameters[j].Value(), 1e-4, 1e-6))
+            ReportFailure("Parameter %d updated together with the others differs from the one updated separately.", (int) j);
+    }
+}
+
+void TestMultiTensorUpdates(size_t numParameters, size_t numMinibatches, const DeviceDescriptor& device)
+{
+    MomentumPerSampleSchedule momentumValues = { { { 1, 1.0 }, { 3, 0.1 }, { 10, 0.01 } }, 2 };
+    TestMultiTensorUpdate<float>([&](const vector<Parameter>& parameters) { return MomentumSGDLearner(parameters, LearningRatePerSampleSchedule(0.1), momentumValues); },
+                                 numParameters, numMinibatches, device);
+    TestMultiTensorUpdate<float>([&](const vector<Parameter>& parameters) { return NesterovLearner(parameters, LearningRatePerSampleSchedule(0.1), momentumValues); },
+                                 numParameters, numMinibatches, device);
+    TestMultiTensorUpdate<double>([](const vector<Parameter>& parameters) { return AdaGradLearner(parameters, LearningRatePerSampleSchedule(0.1), /*needAveMultiplier*/ false); },
+                                  numParameters, numMinibatches, device);
+    TestMultiTensorUpdate<double>([](const vector<Parameter>& parameters) { return AdamLearner(parameters, LearningRatePerSampleSchedule(0.1), MomentumAsTimeConstantSchedule({ 10.0, 100.0 })); },
+                                  numParameters, numMinibatches, device);
+    TestMultiTensorUpdate<float>([](const vector<Parameter>& parameters) { return RMSPropLearner(parameters, LearningRatePerSampleSchedule(0.1), 0.95, 1.2, 0.7, 10.0, 0.001, /*needAveMultiplier*/ false); },
+                                 numParameters, numMinibatches, device);
+}
+
 void TestTrainingParametersSchedule()
 {
     VerifyException([]() {
@@ -241,6 +367,12 @@ void LearnerTests()
     TestAdaGradLearner<double>(2, 5, DeviceDescriptor::CPUDevice());
     TestFSAdaGradLearner<double>(10, 2, DeviceDescriptor::CPUDevice());
     TestRMSPropLearner<float>(3, 3, DeviceDescriptor::CPUDevice());
+    TestMultiTensorUpdates(4, 3, DeviceDescriptor::CPUDevice());
+    TestAdamLearner<float>(3, 4, DeviceDescriptor::CPUDevice());
+    TestAdamWLearner<double>(2, 3, DeviceDescriptor::CPUDevice());
+    TestLAMBLearner<float>(3, 3, DeviceDescriptor::CPUDevice());
+    TestAdamFirstStep<float>(/*layerwiseAdaptive*/ false, DeviceDescriptor::CPUDevice());
+    TestAdamFirstStep<double>(/*layerwiseAdaptive*/ true, DeviceDescriptor::CPUDevice());
 
     if (IsGPUAvailable())
     {
@@ -250,6 +382,11 @@ void LearnerTests()
         TestAdaGradLearner<double>(1, 2, DeviceDescriptor::GPUDevice(0));
         TestFSAdaGradLearner<double>(2, 2, DeviceDescriptor::GPUDevice(0));
         TestRMSPropLearner<float>(3, 3, DeviceDescriptor::GPUDevice(0));
+        TestMultiTensorUpdates(70, 3, DeviceDescriptor::GPUDevice(0));
+        TestAdamLearner<float>(3, 4, DeviceDescriptor::GPUDevice(0));
+        TestLAMBLearner<double>(2, 3, DeviceDescriptor::GPUDevice(0));
+        TestAdamFirstStep<float>(/*layerwiseAdaptive*/ false, DeviceDescriptor::GPUDevice(0));
+        TestAdamFirstStep<float>(/*layerwiseAdaptive*/ true, DeviceDescriptor::GPUDevice(0));
     }
 
 }
\ No newline at end of file
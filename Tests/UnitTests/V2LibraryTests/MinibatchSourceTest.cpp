@@ -189,6 +189,63 @@ void TestMinibatchSourceWarmStart(size_t numMBs, size_t minibatchSize, size_t wa
     }
 }
 
+MinibatchSourcePtr TextFormatMinibatchSourceWithPrefetch(const std::wstring& dataFilePath, const std::vector<StreamConfiguration>& streamConfigs, bool prefetch, size_t prefetchDepth)
+{
+    ::CNTK::Dictionary minibatchSourceConfiguration;
+    minibatchSourceConfiguration[L"epochSize"] = MinibatchSource::InfinitelyRepeat;
+    minibatchSourceConfiguration[L"prefetch"] = prefetch;
+    minibatchSourceConfiguration[L"prefetchDepth"] = prefetchDepth;
+
+    ::CNTK::Dictionary deserializerConfiguration;
+    deserializerConfiguration[L"type"] = L"CNTKTextFormatDeserializer";
+    deserializerConfiguration[L"file"] = dataFilePath;
+
+    ::CNTK::Dictionary inputStreamsConfig;
+    for (auto streamConfig : streamConfigs)
+    {
+        ::CNTK::Dictionary inputStreamConfig;
+        inputStreamConfig[L"dim"] = streamConfig.m_dim;
+        inputStreamConfig[L"format"] = streamConfig.m_isSparse ? L"sparse" : L"dense";
+        inputStreamsConfig[streamConfig.m_streamName] = inputStreamConfig;
+    }
+
+    deserializerConfiguration[L"input"] = inputStreamsConfig;
+    minibatchSourceConfiguration[L"deserializers"] = std::vector<::CNTK::DictionaryValue>({ deserializerConfiguration });
+    return CreateCompositeMinibatchSource(minibatchSourceConfiguration);
+}
+
+// Minibatches read ahead in the background must be the same as the ones read on demand.
+void TestMinibatchSourcePrefetch(size_t numMBs, size_t minibatchSize, size_t prefetchDepth)
+{
+    auto featureStreamName = L"features";
+    auto labelsStreamName = L"labels";
+    std::vector<StreamConfiguration> streamConfigs = { { featureStreamName, 2 }, { labelsStreamName, 2 } };
+
+    auto minibatchSource = TextFormatMinibatchSourceWithPrefetch(L"SimpleDataTrain_cntk_text.txt", streamConfigs, /*prefetch =*/ false, 1);
+    auto prefetchingMinibatchSource = TextFormatMinibatchSourceWithPrefetch(L"SimpleDataTrain_cntk_text.txt", streamConfigs, /*prefetch =*/ true, prefetchDepth);
+
+    auto featureStreamInfo = minibatchSource->StreamInfo(featureStreamName);
+    auto prefetchedFeatureStreamInfo = prefetchingMinibatchSource->StreamInfo(featureStreamName);
+    for (size_t i = 0; i < numMBs; ++i)
+    {
+        // Change the minibatch size once, which has to discard the minibatches read ahead
+        size_t currentMinibatchSize = (i < numMBs / 2) ? minibatchSize : minibatchSize / 2;
+        auto minibatchData = minibatchSource->GetNextMinibatch(currentMinibatchSize);
+        auto prefetchedMinibatchData = prefetchingMinibatchSource->GetNextMinibatch(currentMinibatchSize);
+
+        if (minibatchData[featureStreamInfo].m_numSamples != prefetchedMinibatchData[prefetchedFeatureStreamInfo].m_numSamples)
+            ReportFailure("TestMinibatchSourcePrefetch failed in sample count of minibatch %lu: expected %lu, actual %lu",
+                i, minibatchData[featureStreamInfo].m_numSamples, prefetchedMinibatchData[prefetchedFeatureStreamInfo].m_numSamples);
+
+        if (!Internal::AreEqual(*minibatchData[featureStreamInfo].m_data, *prefetchedMinibatchData[prefetchedFeatureStreamInfo].m_data))
+            ReportFailure("TestMinibatchSourcePrefetch failed: the data of minibatch %lu differ with prefetch depth %lu", i, prefetchDepth);
+    }
+
+    VerifyException([&streamConfigs]() {
+        TextFormatMinibatchSourceWithPrefetch(L"SimpleDataTrain_cntk_text.txt", streamConfigs, /*prefetch =*/ true, 0);
+    }, "Was able to create a MinibatchSource with a prefetch depth of 0.");
+}
+
 void MinibatchSourceTests()
 {
     // Test no-randomize minibatch source
@@ -199,4 +256,8 @@ void MinibatchSourceTests()
     // Test randomized minibatch source
     TestMinibatchSourceWarmStart(10, 64, 0, true);
     TestMinibatchSourceWarmStart(10, 64, 128, true);
+
+    // Test background prefetch
+    TestMinibatchSourcePrefetch(10, 64, 1);
+    TestMinibatchSourcePrefetch(10, 64, 3);
 }
\ No newline at end of file
@@ -185,11 +185,42 @@ void TestSparseCSCArrayView(size_t numAxes, const DeviceDescriptor& device)
         throw std::runtime_error("The contents of the dense vector that the sparse NDArrayView is copied into do not match the expected values");
 }
 
+template <typename ElementType>
+void TestNDArrayViewOverOwnedBuffer()
+{
+    // The buffer is owned by a shared_ptr, like a NumPy array referenced by a language binding
+    bool bufferReleased = false;
+    std::shared_ptr<std::vector<ElementType>> data(new std::vector<ElementType>(6, 2), [&bufferReleased](std::vector<ElementType>* buffer) {
+        bufferReleased = true;
+        delete buffer;
+    });
+    ElementType* dataBuffer = data->data();
+
+    auto dataView = MakeSharedObject<NDArrayView>(AsDataType<ElementType>(), NDShape({ 2, 3 }), dataBuffer, data->size() * sizeof(ElementType), DeviceDescriptor::CPUDevice(), false, data);
+    data = nullptr;
+    if (bufferReleased)
+        throw std::runtime_error("The buffer of the NDArrayView was released while the view still refers to it");
+
+    if (dataView->template DataBuffer<ElementType>() != dataBuffer)
+        throw std::runtime_error("The DataBuffer of the NDArrayView does not match the original buffer it was created over");
+
+    auto aliasView = dataView->Alias(true);
+    dataView = nullptr;
+    if (bufferReleased || aliasView->template DataBuffer<ElementType>() != dataBuffer)
+        throw std::runtime_error("The buffer of the NDArrayView was released while an alias still refers to it");
+
+    aliasView = nullptr;
+    if (!bufferReleased)
+        throw std::runtime_error("The buffer of the NDArrayView was not released with the last view referring to it");
+}
+
 void NDArrayViewTests()
 {
     fprintf(stderr, "\nNDArrayViewTests..\n");
 
     TestNDArrayView<float>(2, DeviceDescriptor::CPUDevice());
+    TestNDArrayViewOverOwnedBuffer<float>();
+    TestNDArrayViewOverOwnedBuffer<double>();
 
     if (IsGPUAvailable())
     {
@@ -317,7 +317,8 @@ void CheckEnumValuesNotModified() {
                   static_cast<size_t>(PrimitiveOpType::CosDistance) == 53 &&
                   static_cast<size_t>(PrimitiveOpType::Sin) == 54 &&
                   static_cast<size_t>(PrimitiveOpType::Cos) == 55 &&
-                  static_cast<size_t>(PrimitiveOpType::Pass) == 56,
+                  static_cast<size_t>(PrimitiveOpType::Pass) == 56 &&
+                  static_cast<size_t>(PrimitiveOpType::TopK) == 57,
                   "PrimitiveOpType enum value was modified.");
 }
 
@@ -410,6 +411,43 @@ void TestFunctionSerialization(const DeviceDescriptor& device)
     TestFunctionSaveAndLoad(BuildLSTMClassifierNet(inputVar, 5, device), device);
 }
 
+void TestStreamedModelSaving(const DeviceDescriptor& device)
+{
+    const size_t inputDim = 20;
+    auto inputVar = InputVariable({ inputDim }, false /*isSparse*/, DataType::Float, L"input_variable");
+    auto function = BuildLSTMClassifierNet(inputVar, 5, device);
+
+    // SaveModel() streams the tensors; LoadModel() reads both that and the plain protobuf format
+    const std::wstring streamedFile = L"TestStreamedModelSaving.streamed.out";
+    function->SaveModel(streamedFile);
+    {
+        char magic[7];
+        GetFstream(streamedFile, true)->read(magic, sizeof(magic));
+        if (std::string(magic, sizeof(magic)) != "CNTKV2S")
+            throw std::runtime_error("TestStreamedModelSaving: SaveModel() did not write a streamed model.");
+    }
+    if (!AreEqual(function, Function::LoadModel(streamedFile, device)))
+        throw std::runtime_error("TestStreamedModelSaving: original and reloaded functions are not identical.");
+
+    const std::wstring protobufFile = L"TestStreamedModelSaving.protobuf.out";
+    {
+        Dictionary model = function->Serialize();
+        auto stream = GetFstream(protobufFile, false);
+        *stream << model;
+        stream->flush();
+    }
+    auto reloadedFunction = Function::LoadModel(protobufFile, device);
+    if (!AreEqual(function, reloadedFunction))
+        throw std::runtime_error("TestStreamedModelSaving: original and function reloaded from protobuf are not identical.");
+
+    // parameters restored in place from a streamed model
+    for (auto parameter : reloadedFunction->Parameters())
+        parameter.Value()->SetValue(0.0f);
+    reloadedFunction->RestoreModel(streamedFile);
+    if (!AreEqual(function, reloadedFunction))
+        throw std::runtime_error("TestStreamedModelSaving: original and restored functions are not identical.");
+}
+
 Trainer BuildTrainer(const FunctionPtr& function, const Variable& labels, 
                      LearningRateSchedule lr = LearningRatePerSampleSchedule(0.005), 
                      MomentumSchedule m = MomentumAsTimeConstantSchedule(0.0))
@@ -808,6 +846,7 @@ void SerializationTests()
 
     TestFunctionsForEquality(DeviceDescriptor::CPUDevice());
     TestFunctionSerialization(DeviceDescriptor::CPUDevice());
+    TestStreamedModelSaving(DeviceDescriptor::CPUDevice());
     TestModelSerializationDuringTraining(DeviceDescriptor::CPUDevice());
     
     TestCheckpointing(DeviceDescriptor::CPUDevice());
@@ -820,6 +859,7 @@ void SerializationTests()
         TestLearnerSerialization<float>(5, DeviceDescriptor::GPUDevice(0));
         TestLearnerSerialization<double>(10, DeviceDescriptor::GPUDevice(0));
         TestFunctionSerialization(DeviceDescriptor::GPUDevice(0));
+        TestStreamedModelSaving(DeviceDescriptor::GPUDevice(0));
         TestModelSerializationDuringTraining(DeviceDescriptor::GPUDevice(0));
         TestCheckpointing(DeviceDescriptor::GPUDevice(0));
         TestLegacyModelSaving(DeviceDescriptor::GPUDevice(0));
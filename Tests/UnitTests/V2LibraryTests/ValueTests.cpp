@@ -298,6 +298,83 @@ void SparseSequenceBatchValueCreationTest(size_t vocabSize, size_t maxAllowedSeq
         ReportFailure("Sparse sequence batch does not match expectation");
 }
 
+void PaddedSequenceBatchValueCreationTest(size_t vocabSize, size_t maxAllowedSequenceLength, const DeviceDescriptor& device)
+{
+    srand(1);
+    size_t numSequences = 5;
+    auto sequenceLengths = GenerateSequenceLengths(numSequences, maxAllowedSequenceLength);
+    std::vector<NDArrayViewPtr> denseSequences(numSequences), sparseSequences(numSequences);
+    for (size_t i = 0; i < numSequences; ++i)
+        std::tie(denseSequences[i], sparseSequences[i]) = GenerateSparseSequence<float>(vocabSize, sequenceLengths[i], 5);
+
+    // Batch the sequences by copying them, and then create Values over the padded data of those batches
+    auto denseSequenceBatch = Value::Create({ vocabSize }, denseSequences, device);
+    auto sparseSequenceBatch = Value::Create({ vocabSize }, sparseSequences, device);
+    auto paddedDenseSequenceBatch = Value::Create({ vocabSize }, denseSequenceBatch->Data(), sequenceLengths);
+    auto paddedSparseSequenceBatch = Value::Create({ vocabSize }, sparseSequenceBatch->Data(), sequenceLengths, true);
+
+    if (paddedDenseSequenceBatch->Data()->DataBuffer<float>() != denseSequenceBatch->Data()->DataBuffer<float>())
+        ReportFailure("Value created from a padded sequence batch does not refer to the data of the batch");
+
+    if (!paddedSparseSequenceBatch->IsReadOnly() || !paddedSparseSequenceBatch->Data()->IsSparse())
+        ReportFailure("Value created from a padded sparse sequence batch is not read-only or not sparse");
+
+    if (!Internal::AreEqual(*denseSequenceBatch, *paddedDenseSequenceBatch))
+        ReportFailure("Padded dense sequence batch does not match expectation");
+
+    auto paddedSparseSequenceBatchDataConvertedToDense = MakeSharedObject<NDArrayView>(DataType::Float, paddedSparseSequenceBatch->Data()->Shape(), device);
+    paddedSparseSequenceBatchDataConvertedToDense->CopyFrom(*paddedSparseSequenceBatch->Data());
+    auto paddedSparseSequenceBatchValueConvertedToDense = MakeSharedObject<Value>(paddedSparseSequenceBatchDataConvertedToDense, paddedSparseSequenceBatch->Mask());
+    if (!Internal::AreEqual(*denseSequenceBatch, *paddedSparseSequenceBatchValueConvertedToDense))
+        ReportFailure("Padded sparse sequence batch does not match expectation");
+
+    // Sequences longer than the padded length are rejected
+    auto tooLongSequenceLengths = sequenceLengths;
+    tooLongSequenceLengths[0] = denseSequenceBatch->Data()->Shape()[1] + 1;
+    VerifyException([&]() {
+        Value::Create({ vocabSize }, denseSequenceBatch->Data(), tooLongSequenceLengths);
+    }, "Was able to create a Value with a sequence longer than the padded sequence length.");
+}
+
+void NDMaskContentsTest(const DeviceDescriptor device)
+{
+    const MaskKind V = MaskKind::Valid, X = MaskKind::Invalid, B = MaskKind::SequenceBegin;
+    auto checkMask = [](const NDMask& mask, const vector<MaskKind>& expected) {
+        auto cpuMask = mask.DeepClone(DeviceDescriptor::CPUDevice());
+        if (!equal(expected.begin(), expected.end(), cpuMask->DataBuffer()))
+            ReportFailure("The contents of the mask do not match the expected ones.");
+        size_t expectedMaskedCount = count(expected.begin(), expected.end(), MaskKind::Invalid);
+        if (mask.MaskedCount() != expectedMaskedCount)
+            ReportFailure("The masked count of the mask does not match. Expected: %" PRIu64 ", actual: %" PRIu64 ".", expectedMaskedCount, mask.MaskedCount());
+    };
+
+    // sequences of lengths 3, 1 and 2 out of 3 steps, the first two of them beginning in this minibatch
+    NDMask mask(NDShape({ 3, 3 }), device);
+    mask.MarkSequenceBegin({ 0, 0 }, NDShape({ 1, 2 }));
+    mask.InvalidateSection({ 1, 1 }, { NDShape::InferredDimension, 1 });
+    mask.InvalidateSection({ 2, 2 }, { NDShape::InferredDimension, 1 });
+    checkMask(mask, { B, V, V, B, X, X, V, V, X });
+
+    // copies and clones keep the contents
+    NDMask maskCopy(NDShape({ 3, 3 }), device);
+    maskCopy.CopyFrom(mask);
+    checkMask(maskCopy, { B, V, V, B, X, X, V, V, X });
+
+    // marking a step in the middle of a sequence changes the way the mask is kept, but not the contents
+    mask.InvalidateSection({ 1, 0 }, { 1, 1 });
+    checkMask(mask, { B, X, V, B, X, X, V, V, X });
+    mask.MarkSequenceBegin({ 0, 2 });
+    checkMask(mask, { B, X, V, B, X, X, B, V, X });
+
+    mask.Clear();
+    checkMask(mask, { V, V, V, V, V, V, V, V, V });
+
+    // an alias shares the contents both ways
+    auto maskAlias = maskCopy.Alias();
+    maskAlias->InvalidateSection({ 0, 2 }, { NDShape::InferredDimension, 1 });
+    checkMask(maskCopy, { B, V, V, B, X, X, X, X, X });
+}
+
 void ValueTests()
 {
     fprintf(stderr, "\nValueTests..\n");
@@ -314,6 +391,8 @@ void ValueTests()
     ValueCreationOneHotWithNDMaskTest<float>(DeviceDescriptor::CPUDevice(), true);
     SparseSequenceBatchValueCreationTest(300, 7, DeviceDescriptor::CPUDevice());
     SparseSequenceBatchValueCreationTest(2300, 1, DeviceDescriptor::CPUDevice());
+    PaddedSequenceBatchValueCreationTest(300, 7, DeviceDescriptor::CPUDevice());
+    NDMaskContentsTest(DeviceDescriptor::CPUDevice());
 
     if (IsGPUAvailable())
     {
@@ -329,5 +408,7 @@ void ValueTests()
         ValueCreationOneHotWithNDMaskTest<double>(DeviceDescriptor::GPUDevice(0), true);
         SparseSequenceBatchValueCreationTest(50000, 1, DeviceDescriptor::GPUDevice(0));
         SparseSequenceBatchValueCreationTest(6000, 6, DeviceDescriptor::GPUDevice(0));
+        PaddedSequenceBatchValueCreationTest(6000, 6, DeviceDescriptor::GPUDevice(0));
+        NDMaskContentsTest(DeviceDescriptor::GPUDevice(0));
     }
 }